@@ -0,0 +1,133 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "allocation_tracker.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace wvu {
+namespace {
+// Zero-initialized before any dynamic initialization, so the allocations of
+// the static constructors are counted too.
+std::atomic<int64_t> num_allocations(0);
+std::atomic<int64_t> num_allocated_bytes(0);
+
+}  // namespace
+
+bool AllocationTrackingEnabled() {
+#ifdef GLUTILS_TRACK_ALLOCATIONS
+  return true;
+#else
+  return false;
+#endif  // GLUTILS_TRACK_ALLOCATIONS
+}
+
+int64_t NumAllocations() {
+  return num_allocations.load(std::memory_order_relaxed);
+}
+
+int64_t NumAllocatedBytes() {
+  return num_allocated_bytes.load(std::memory_order_relaxed);
+}
+
+#ifdef GLUTILS_TRACK_ALLOCATIONS
+
+namespace {
+// Counts an allocation and allocates it with malloc. Returns nullptr if the
+// allocation failed.
+void* CountedAllocate(const std::size_t num_bytes) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  num_allocated_bytes.fetch_add(num_bytes, std::memory_order_relaxed);
+  // malloc(0) may return nullptr, while operator new must return a pointer.
+  return std::malloc(num_bytes > 0 ? num_bytes : 1);
+}
+
+// Allocates like the throwing operator new, retrying with the new handler.
+void* CountedAllocateOrThrow(const std::size_t num_bytes) {
+  void* pointer = CountedAllocate(num_bytes);
+  while (pointer == nullptr) {
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) throw std::bad_alloc();
+    handler();
+    pointer = std::malloc(num_bytes > 0 ? num_bytes : 1);
+  }
+  return pointer;
+}
+
+}  // namespace
+
+#endif  // GLUTILS_TRACK_ALLOCATIONS
+
+}  // namespace wvu
+
+#ifdef GLUTILS_TRACK_ALLOCATIONS
+
+// Replacements of the global allocation functions. The sized operator delete
+// of later standards forwards to these by default.
+void* operator new(std::size_t num_bytes) {
+  return wvu::CountedAllocateOrThrow(num_bytes);
+}
+
+void* operator new[](std::size_t num_bytes) {
+  return wvu::CountedAllocateOrThrow(num_bytes);
+}
+
+void* operator new(std::size_t num_bytes, const std::nothrow_t&) noexcept {
+  return wvu::CountedAllocate(num_bytes);
+}
+
+void* operator new[](std::size_t num_bytes, const std::nothrow_t&) noexcept {
+  return wvu::CountedAllocate(num_bytes);
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+
+#endif  // GLUTILS_TRACK_ALLOCATIONS
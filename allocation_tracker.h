@@ -0,0 +1,69 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_ALLOCATION_TRACKER_H_
+#define GLUTILS_ALLOCATION_TRACKER_H_
+
+#include <cstdint>
+
+namespace wvu {
+// Allocation counters, to verify that the frames do not allocate. The
+// counting is opt-in: building with the TRACK_ALLOCATIONS CMake option
+// (which defines GLUTILS_TRACK_ALLOCATIONS) replaces the global operator new
+// and operator delete with versions that count the calls of all the threads.
+// Otherwise the counters remain zero and cost nothing.
+//
+// The replacements count the memory requested through operator new, which
+// includes the standard containers and strings. Code calling malloc directly
+// is not counted, e.g., Eigen::aligned_allocator.
+//
+// Example:
+//
+// const int64_t num_allocations = wvu::NumAllocations();
+// RenderFrame();
+// LOG(INFO) << wvu::NumAllocations() - num_allocations << " allocations.";
+
+// Returns true if the build counts the allocations.
+bool AllocationTrackingEnabled();
+
+// Returns the number of allocations since the start of the program.
+int64_t NumAllocations();
+
+// Returns the number of bytes allocated since the start of the program. The
+// bytes of the freed allocations are not subtracted.
+int64_t NumAllocatedBytes();
+
+}  // namespace wvu
+
+#endif  // GLUTILS_ALLOCATION_TRACKER_H_
@@ -0,0 +1,373 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "ambient_occlusion_baking.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "bounding_volume_hierarchy.h"
+#include "job_system.h"
+#include "mesh_picking.h"
+#include "model.h"
+#include "transforms.h"
+#include "vertex_format.h"
+#include "vertex_quantization.h"
+
+namespace wvu {
+namespace {
+// Vertices baked by a job. Every vertex casts tens of rays, so the ranges are
+// much smaller than the ones of the normals.
+constexpr int kAmbientOcclusionGrainSize = 64;
+
+// Rounds the size up to a multiple of 4 bytes, as the other attributes.
+GLuint AlignTo4(const GLuint size) {
+  return (size + 3) & ~3u;
+}
+
+// Returns true if the occlusion can be written into the attribute.
+bool IsSupportedColorAttribute(const VertexAttribute& attribute) {
+  if (attribute.num_components != 4) return false;
+  return attribute.type == GL_FLOAT ||
+      (attribute.type == GL_UNSIGNED_BYTE && attribute.normalized == GL_TRUE);
+}
+
+// Returns true if the normals can be read from the attribute.
+bool IsSupportedNormalAttribute(const VertexAttribute& attribute) {
+  switch (attribute.type) {
+    case GL_FLOAT:
+      return attribute.num_components == 3;
+    case GL_HALF_FLOAT:
+      return attribute.num_components == 3 || attribute.num_components == 4;
+    case GL_INT_2_10_10_10_REV:
+      return attribute.normalized == GL_TRUE;
+    default:
+      return false;
+  }
+}
+
+// Reads the normal of a vertex, as mesh_normals.cc writes it.
+Eigen::Vector3f ReadNormal(const VertexAttribute& attribute,
+                           const GLubyte* vertex) {
+  const GLubyte* source = vertex + attribute.offset;
+  Eigen::Vector3f normal;
+  if (attribute.type == GL_FLOAT) {
+    std::memcpy(normal.data(), source, 3 * sizeof(float));
+  } else if (attribute.type == GL_HALF_FLOAT) {
+    GLushort halves[3];
+    std::memcpy(halves, source, sizeof(halves));
+    for (int i = 0; i < 3; ++i) normal[i] = HalfToFloat(halves[i]);
+  } else {
+    uint32_t packed;
+    std::memcpy(&packed, source, sizeof(packed));
+    float values[4];
+    UnpackSnorm10(packed, values);
+    normal = Eigen::Vector3f(values[0], values[1], values[2]);
+  }
+  return normal;
+}
+
+// Writes the occlusion into the alpha of the color of a vertex.
+void WriteOcclusion(const float occlusion,
+                    const VertexAttribute& attribute,
+                    GLubyte* vertex) {
+  GLubyte* destination = vertex + attribute.offset;
+  if (attribute.type == GL_FLOAT) {
+    std::memcpy(destination + 3 * sizeof(float), &occlusion, sizeof(float));
+  } else {
+    destination[3] = static_cast<GLubyte>(
+        std::min(std::max(occlusion, 0.0f), 1.0f) * 255.0f + 0.5f);
+  }
+}
+
+// Returns the radical inverse of i in base 2, the second coordinate of the
+// Hammersley points.
+float RadicalInverse(uint32_t i) {
+  i = (i << 16) | (i >> 16);
+  i = ((i & 0x55555555u) << 1) | ((i & 0xaaaaaaaau) >> 1);
+  i = ((i & 0x33333333u) << 2) | ((i & 0xccccccccu) >> 2);
+  i = ((i & 0x0f0f0f0fu) << 4) | ((i & 0xf0f0f0f0u) >> 4);
+  i = ((i & 0x00ff00ffu) << 8) | ((i & 0xff00ff00u) >> 8);
+  return i * 2.3283064365386963e-10f;
+}
+
+// Returns a number in [0, 1) hashed from the index of a vertex.
+float HashVertex(uint32_t vertex) {
+  vertex ^= vertex >> 16;
+  vertex *= 0x7feb352du;
+  vertex ^= vertex >> 15;
+  vertex *= 0x846ca68bu;
+  vertex ^= vertex >> 16;
+  return (vertex >> 8) * (1.0f / 16777216.0f);
+}
+
+// The directions of the rays in the frame of a normal along z, distributed by
+// the cosine over the hemisphere, as (cos(phi) r, sin(phi) r, z) with their
+// angle phi in the plane separated, so that each vertex rotates them.
+struct HemisphereSamples {
+  std::vector<float> angles;
+  std::vector<float> radii;
+  std::vector<float> heights;
+};
+
+HemisphereSamples ComputeHemisphereSamples(const int num_rays) {
+  HemisphereSamples samples;
+  samples.angles.resize(num_rays);
+  samples.radii.resize(num_rays);
+  samples.heights.resize(num_rays);
+  for (int i = 0; i < num_rays; ++i) {
+    const float u = (i + 0.5f) / num_rays;
+    samples.angles[i] = 2.0f * kPi * RadicalInverse(i);
+    samples.radii[i] = std::sqrt(u);
+    samples.heights[i] = std::sqrt(1.0f - u);
+  }
+  return samples;
+}
+
+// Returns two unit tangents completing a frame with the unit normal, without
+// a branch on the direction of the normal but its sign (Duff et al. 2017).
+void ComputeTangentFrame(const Eigen::Vector3f& normal,
+                         Eigen::Vector3f* tangent,
+                         Eigen::Vector3f* bitangent) {
+  const float sign = std::copysign(1.0f, normal.z());
+  const float a = -1.0f / (sign + normal.z());
+  const float b = normal.x() * normal.y() * a;
+  *tangent = Eigen::Vector3f(1.0f + sign * normal.x() * normal.x() * a,
+                             sign * b, -sign * normal.x());
+  *bitangent = Eigen::Vector3f(b, sign + normal.y() * normal.y() * a,
+                               -normal.y());
+}
+
+// Calls function(begin, end) on ranges covering [0, num_elements), on the
+// threads of the job system if there is one.
+void ParallelFor(JobSystem* job_system,
+                 const int num_elements,
+                 const std::function<void(int, int)>& function) {
+  if (job_system == nullptr) {
+    function(0, num_elements);
+  } else {
+    job_system->ParallelFor(num_elements, kAmbientOcclusionGrainSize,
+                            function);
+  }
+}
+
+}  // namespace
+
+void StaticOccluders::AddObject(const MeshPicker* picker,
+                                const Eigen::Matrix4f& model_matrix) {
+  Object object;
+  object.picker = picker;
+  object.world_to_model = model_matrix.inverse();
+  objects_.push_back(object);
+  // The bounds of the corners of the box of the picker in world space.
+  const Eigen::AlignedBox3f& model_bounds = picker->bounds();
+  Eigen::AlignedBox3f bounds;
+  for (int corner = 0; corner < 8; ++corner) {
+    const Eigen::Vector3f point = model_bounds.corner(
+        static_cast<Eigen::AlignedBox3f::CornerType>(corner));
+    bounds.extend((model_matrix * point.homogeneous()).head<3>());
+  }
+  object_bounds_.push_back(bounds);
+}
+
+void StaticOccluders::Build() {
+  hierarchy_.Build(object_bounds_);
+}
+
+bool StaticOccluders::Occluded(const Eigen::Vector3f& origin,
+                               const Eigen::Vector3f& direction,
+                               const float max_distance) const {
+  if (hierarchy_.num_objects() == 0) return false;
+  const int object = hierarchy_.Raycast(
+      origin, direction, max_distance,
+      [&](const int object, float* distance) {
+    const Object& occluder = objects_[object];
+    // The distances are in units of the direction, which the transform
+    // preserves.
+    const Eigen::Vector3f model_origin =
+        (occluder.world_to_model * origin.homogeneous()).head<3>();
+    const Eigen::Vector3f model_direction =
+        occluder.world_to_model.topLeftCorner<3, 3>() * direction;
+    MeshHit hit;
+    if (!occluder.picker->Raycast(model_origin, model_direction, max_distance,
+                                  &hit)) {
+      return false;
+    }
+    *distance = hit.distance;
+    return true;
+  }, nullptr);
+  return object >= 0;
+}
+
+bool BakeAmbientOcclusion(const StaticOccluders& occluders,
+                          const AmbientOcclusionBakeOptions& options,
+                          JobSystem* job_system,
+                          Model* model,
+                          AmbientOcclusionBakeStatistics* statistics,
+                          std::string* error_info_log) {
+  if (model->primitive_type() != GL_TRIANGLES) {
+    *error_info_log = "The occlusion is baked for triangle lists only.";
+    return false;
+  }
+  if (model->cpu_data_released()) {
+    *error_info_log = "The CPU data of the model was released.";
+    return false;
+  }
+  if (options.num_rays <= 0) {
+    *error_info_log = "The number of rays must be positive.";
+    return false;
+  }
+  const VertexLayout& layout = model->vertex_layout();
+  const VertexAttribute* position = layout.FindAttribute(POSITION);
+  if (position == nullptr || position->type != GL_FLOAT ||
+      position->num_components < 3) {
+    *error_info_log = "The model does not have float positions.";
+    return false;
+  }
+  const VertexAttribute* normal = layout.FindAttribute(NORMAL);
+  if (normal == nullptr || !IsSupportedNormalAttribute(*normal)) {
+    *error_info_log = "The model does not have normals.";
+    return false;
+  }
+  const VertexAttribute* color = layout.FindAttribute(COLOR);
+  if (color != nullptr && !IsSupportedColorAttribute(*color)) {
+    *error_info_log = "The color attribute of the model is not 4 floats or 4 "
+        "normalized unsigned bytes.";
+    return false;
+  }
+
+  // The layout with the colors. A white color attribute is appended after
+  // the other attributes if the model has none.
+  VertexLayout color_layout = layout;
+  if (color == nullptr) {
+    const GLuint offset = AlignTo4(layout.stride());
+    color_layout = VertexLayout(offset + 4);
+    for (int i = 0; i < layout.num_attributes(); ++i) {
+      const VertexAttribute& attribute = layout.attribute(i);
+      color_layout.AddAttribute(attribute.semantic, attribute.num_components,
+                                attribute.type, attribute.normalized,
+                                attribute.offset);
+    }
+    if (!color_layout.AddAttribute(COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                                   offset)) {
+      *error_info_log = "The layout of the model has no room for colors.";
+      return false;
+    }
+  }
+  const VertexAttribute& color_attribute = *color_layout.FindAttribute(COLOR);
+
+  const Eigen::Matrix4f& model_matrix = model->model_matrix();
+  const Eigen::Matrix3f normal_matrix =
+      model_matrix.topLeftCorner<3, 3>().inverse().transpose();
+  const HemisphereSamples samples = ComputeHemisphereSamples(options.num_rays);
+  const int num_vertices = model->num_vertices();
+  const bool relayout = color == nullptr;
+  std::vector<GLubyte> vertex_data;
+  if (relayout) vertex_data.resize(num_vertices * color_layout.stride(), 0);
+  const GLubyte* source = model->vertex_data().data();
+  GLubyte* destination =
+      relayout ? vertex_data.data() : model->mutable_vertex_data();
+  std::atomic<int64_t> num_rays(0);
+  std::atomic<int64_t> num_occluded_rays(0);
+  ParallelFor(job_system, num_vertices, [&](const int begin, const int end) {
+    int64_t num_range_rays = 0;
+    int64_t num_range_occluded_rays = 0;
+    for (int v = begin; v < end; ++v) {
+      const GLubyte* source_vertex = source + v * layout.stride();
+      Eigen::Vector3f vertex_position;
+      std::memcpy(vertex_position.data(), source_vertex + position->offset,
+                  3 * sizeof(float));
+      vertex_position =
+          (model_matrix * vertex_position.homogeneous()).head<3>();
+      const Eigen::Vector3f vertex_normal =
+          normal_matrix * ReadNormal(*normal, source_vertex);
+      float occlusion = 1.0f;
+      const float length = vertex_normal.norm();
+      if (length > 0.0f) {
+        const Eigen::Vector3f unit_normal = vertex_normal / length;
+        Eigen::Vector3f tangent, bitangent;
+        ComputeTangentFrame(unit_normal, &tangent, &bitangent);
+        const Eigen::Vector3f origin =
+            vertex_position + options.bias * unit_normal;
+        const float rotation = 2.0f * kPi * HashVertex(v);
+        int num_unoccluded_rays = 0;
+        for (int i = 0; i < options.num_rays; ++i) {
+          const float angle = samples.angles[i] + rotation;
+          const Eigen::Vector3f direction =
+              samples.radii[i] * (std::cos(angle) * tangent +
+                                  std::sin(angle) * bitangent) +
+              samples.heights[i] * unit_normal;
+          if (!occluders.Occluded(origin, direction, options.max_distance)) {
+            ++num_unoccluded_rays;
+          }
+        }
+        occlusion = static_cast<float>(num_unoccluded_rays) / options.num_rays;
+        num_range_rays += options.num_rays;
+        num_range_occluded_rays += options.num_rays - num_unoccluded_rays;
+      }
+      GLubyte* vertex = destination + v * color_layout.stride();
+      if (relayout) {
+        std::memcpy(vertex, source_vertex, layout.stride());
+        std::memset(vertex + color_attribute.offset, 255, 4);
+      }
+      WriteOcclusion(occlusion, color_attribute, vertex);
+    }
+    num_rays.fetch_add(num_range_rays, std::memory_order_relaxed);
+    num_occluded_rays.fetch_add(num_range_occluded_rays,
+                                std::memory_order_relaxed);
+  });
+  if (relayout) {
+    model->SetVertexData(color_layout, std::move(vertex_data));
+  } else {
+    model->MarkVerticesDirty(0, num_vertices);
+  }
+  if (statistics != nullptr) {
+    statistics->num_vertices += num_vertices;
+    statistics->num_rays += num_rays.load();
+    statistics->num_occluded_rays += num_occluded_rays.load();
+  }
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,158 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_AMBIENT_OCCLUSION_BAKING_H_
+#define GLUTILS_AMBIENT_OCCLUSION_BAKING_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include "bounding_volume_hierarchy.h"
+#include "job_system.h"
+#include "mesh_picking.h"
+#include "model.h"
+
+namespace wvu {
+// Parameters of BakeAmbientOcclusion().
+struct AmbientOcclusionBakeOptions {
+  // The rays cast over the hemisphere of every vertex.
+  int num_rays = 64;
+  // The distance beyond which the occluders are ignored, in world units.
+  float max_distance = 1.0f;
+  // The distance along the normal from which the rays start, in world units,
+  // so that they do not hit the triangles around their own vertex.
+  float bias = 1e-3f;
+};
+
+// Counters of BakeAmbientOcclusion(), summed over the models baked.
+struct AmbientOcclusionBakeStatistics {
+  int64_t num_vertices = 0;
+  // The vertices with a zero normal cast no ray, and are unoccluded.
+  int64_t num_rays = 0;
+  int64_t num_occluded_rays = 0;
+};
+
+// This class holds the static geometry occluding the rays of the baking: the
+// objects of a scene, each the MeshPicker of its mesh placed by a model
+// matrix. The world-space bounds of the objects are indexed in a
+// BoundingVolumeHierarchy, so that a ray only visits the pickers of the
+// objects whose bounds it hits, and intersects the triangles of their leaves
+// with IntersectRayWithTriangles() in model space. The objects sharing a mesh
+// share its picker. Queries may run on several threads at once.
+//
+// Example:
+//
+// wvu::StaticOccluders occluders;
+// for (const wvu::SceneObject& object : scene.objects) {
+//   occluders.AddObject(&pickers[object.mesh], model_matrix(object));
+// }
+// occluders.Build();
+class StaticOccluders {
+ public:
+  StaticOccluders() {}
+  ~StaticOccluders() {}
+
+  // Adds an object. The picker must outlive the occluders. The objects added
+  // are queried after the next Build().
+  void AddObject(const MeshPicker* picker, const Eigen::Matrix4f& model_matrix);
+
+  // Builds the hierarchy of the objects added.
+  void Build();
+
+  // Returns true if a ray in world space hits a triangle within max_distance,
+  // in units of its direction. Both faces of the triangles are hit.
+  bool Occluded(const Eigen::Vector3f& origin,
+                const Eigen::Vector3f& direction,
+                const float max_distance) const;
+
+  int num_objects() const {
+    return objects_.size();
+  }
+
+ private:
+  struct Object {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    const MeshPicker* picker;
+    // Maps world space to the model space of the picker.
+    Eigen::Matrix4f world_to_model;
+  };
+
+  std::vector<Object, Eigen::aligned_allocator<Object> > objects_;
+  std::vector<Eigen::AlignedBox3f> object_bounds_;
+  BoundingVolumeHierarchy hierarchy_;
+
+  StaticOccluders(const StaticOccluders&) = delete;
+  StaticOccluders& operator=(const StaticOccluders&) = delete;
+};
+
+// Bakes the ambient occlusion of the vertices of a static model placed by its
+// model matrix among the occluders, which may include the model itself, so
+// that the shading of static geometry reads it instead of computing it every
+// frame (see post_processing.h). Every vertex casts options.num_rays rays
+// distributed by the cosine over the hemisphere of its normal, and its
+// occlusion is the fraction of them that hits no occluder within
+// options.max_distance: 1 is unoccluded. The directions are a Hammersley set
+// rotated around the normal by an angle hashed from the index of the vertex,
+// so that neighboring vertices do not share the same gaps, and the results do
+// not depend on the number of threads. The vertices are baked in parallel on
+// the job system, if not nullptr.
+//
+// The occlusion is written into the alpha of the color attribute of the
+// vertices, which must be 4 normalized unsigned bytes or 4 floats, so that
+// baking again replaces it. The model gets a white color attribute of 4
+// normalized unsigned bytes, appended to its vertices, if it has none. The
+// model must be a triangle list with float positions and normals (see
+// ComputeVertexNormals()) whose CPU data was not released. Returns false
+// otherwise, in which case the error is copied into error_info_log.
+// Parameters:
+//   occluders  The built occluders of the scene.
+//   options  The rays of the baking.
+//   job_system  The threads casting the rays. Can be nullptr.
+//   model  The model whose vertices are baked.
+//   statistics  The counters the baking adds to. Can be nullptr.
+//   error_info_log  A pointer to a string that holds the error log.
+bool BakeAmbientOcclusion(const StaticOccluders& occluders,
+                          const AmbientOcclusionBakeOptions& options,
+                          JobSystem* job_system,
+                          Model* model,
+                          AmbientOcclusionBakeStatistics* statistics,
+                          std::string* error_info_log);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_AMBIENT_OCCLUSION_BAKING_H_
@@ -0,0 +1,298 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "asset_archive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "job_system.h"
+#include "lz4_block.h"
+#include "mapped_file.h"
+
+namespace wvu {
+namespace {
+constexpr char kArchiveMagic[4] = {'W', 'V', 'U', 'A'};
+constexpr uint32_t kArchiveVersion = 1;
+
+struct ArchiveHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t block_size;
+  uint32_t num_entries;
+  uint64_t index_offset;
+};
+
+template <typename Type>
+void Append(const Type& value, std::vector<uint8_t>* bytes) {
+  const uint8_t* value_bytes = reinterpret_cast<const uint8_t*>(&value);
+  bytes->insert(bytes->end(), value_bytes, value_bytes + sizeof(value));
+}
+
+template <typename Type>
+bool ReadValue(const uint8_t** bytes, const uint8_t* end, Type* value) {
+  if (end - *bytes < static_cast<ptrdiff_t>(sizeof(*value))) return false;
+  std::memcpy(value, *bytes, sizeof(*value));
+  *bytes += sizeof(*value);
+  return true;
+}
+
+}  // namespace
+
+AssetArchiveWriter::AssetArchiveWriter(const int block_size)
+    : block_size_(block_size), num_bytes_(0) {}
+
+bool AssetArchiveWriter::Add(const std::string& name,
+                             const void* data,
+                             const size_t size,
+                             const AssetCompression compression) {
+  for (const Entry& entry : entries_) {
+    if (entry.name == name) return false;
+  }
+  Entry entry;
+  entry.name = name;
+  entry.compression = compression;
+  entry.size = size;
+  entry.first_block = block_sizes_.size();
+  entry.num_blocks = (size + block_size_ - 1) / block_size_;
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t offset = 0; offset < size; offset += block_size_) {
+    const size_t block_size = std::min<size_t>(block_size_, size - offset);
+    block_offsets_.push_back(blocks_.size());
+    // A block that does not shrink is stored, which the reader tells by its
+    // size.
+    if (compression == ASSET_LZ4) {
+      compressor_.Compress(bytes + offset, block_size, &compressed_);
+    }
+    if (compression == ASSET_LZ4 && compressed_.size() < block_size) {
+      blocks_.insert(blocks_.end(), compressed_.begin(), compressed_.end());
+      block_sizes_.push_back(compressed_.size());
+    } else {
+      blocks_.insert(blocks_.end(), bytes + offset,
+                     bytes + offset + block_size);
+      block_sizes_.push_back(block_size);
+    }
+  }
+  entries_.push_back(entry);
+  num_bytes_ += size;
+  return true;
+}
+
+bool AssetArchiveWriter::Write(const std::string& filepath,
+                               std::string* error_info_log) const {
+  ArchiveHeader header;
+  std::memcpy(header.magic, kArchiveMagic, sizeof(header.magic));
+  header.version = kArchiveVersion;
+  header.block_size = block_size_;
+  header.num_entries = entries_.size();
+  header.index_offset = sizeof(header) + blocks_.size();
+  std::vector<uint8_t> index;
+  for (const Entry& entry : entries_) {
+    Append(static_cast<uint32_t>(entry.name.size()), &index);
+    index.insert(index.end(), entry.name.begin(), entry.name.end());
+    Append(static_cast<uint32_t>(entry.compression), &index);
+    Append(entry.size, &index);
+    Append(entry.first_block, &index);
+    Append(entry.num_blocks, &index);
+  }
+  for (size_t i = 0; i < block_sizes_.size(); ++i) {
+    // The offsets are from the start of the file.
+    Append(static_cast<uint64_t>(sizeof(header) + block_offsets_[i]), &index);
+    Append(block_sizes_[i], &index);
+  }
+  const std::string temporary_filepath = filepath + ".tmp";
+  std::ofstream out(temporary_filepath, std::ios::binary);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(blocks_.data()), blocks_.size());
+  out.write(reinterpret_cast<const char*>(index.data()), index.size());
+  out.close();
+  if (!out) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + temporary_filepath;
+    return false;
+  }
+  if (std::rename(temporary_filepath.c_str(), filepath.c_str()) != 0) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not rename " + temporary_filepath;
+    return false;
+  }
+  return true;
+}
+
+AssetArchive::AssetArchive() : block_size_(0) {}
+
+bool AssetArchive::Open(const std::string& filepath,
+                        std::string* error_info_log) {
+  if (!mapped_file_.Open(filepath)) {
+    *error_info_log = "Could not map " + filepath;
+    return false;
+  }
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(mapped_file_.data());
+  const uint8_t* end = bytes + mapped_file_.size();
+  ArchiveHeader header;
+  if (!ReadValue(&bytes, end, &header) ||
+      std::memcmp(header.magic, kArchiveMagic, sizeof(header.magic)) != 0 ||
+      header.version != kArchiveVersion || header.block_size == 0 ||
+      header.index_offset > mapped_file_.size()) {
+    *error_info_log = filepath + " is not an asset archive.";
+    return false;
+  }
+  block_size_ = header.block_size;
+  bytes = reinterpret_cast<const uint8_t*>(mapped_file_.data()) +
+      header.index_offset;
+  uint32_t num_blocks = 0;
+  for (uint32_t i = 0; i < header.num_entries; ++i) {
+    uint32_t name_size = 0;
+    uint32_t compression = 0;
+    Entry entry;
+    if (!ReadValue(&bytes, end, &name_size) ||
+        static_cast<size_t>(end - bytes) < name_size) {
+      *error_info_log = "The index of " + filepath + " is truncated.";
+      return false;
+    }
+    const std::string name(reinterpret_cast<const char*>(bytes), name_size);
+    bytes += name_size;
+    if (!ReadValue(&bytes, end, &compression) ||
+        !ReadValue(&bytes, end, &entry.size) ||
+        !ReadValue(&bytes, end, &entry.first_block) ||
+        !ReadValue(&bytes, end, &entry.num_blocks) ||
+        entry.first_block != num_blocks ||
+        entry.num_blocks != (entry.size + block_size_ - 1) / block_size_) {
+      *error_info_log = "The index of " + filepath + " is corrupt.";
+      return false;
+    }
+    entry.compression = static_cast<AssetCompression>(compression);
+    num_blocks += entry.num_blocks;
+    entries_[name] = entry;
+    names_.push_back(name);
+  }
+  block_offsets_.resize(num_blocks);
+  block_sizes_.resize(num_blocks);
+  for (uint32_t i = 0; i < num_blocks; ++i) {
+    if (!ReadValue(&bytes, end, &block_offsets_[i]) ||
+        !ReadValue(&bytes, end, &block_sizes_[i]) ||
+        block_offsets_[i] + block_sizes_[i] > header.index_offset) {
+      *error_info_log = "The blocks of " + filepath + " are corrupt.";
+      return false;
+    }
+  }
+  return true;
+}
+
+int64_t AssetArchive::size(const std::string& name) const {
+  const auto entry = entries_.find(name);
+  return entry != entries_.end() ? static_cast<int64_t>(entry->second.size)
+                                 : -1;
+}
+
+bool AssetArchive::Read(const std::string& name,
+                        void* output,
+                        JobSystem* job_system) const {
+  const auto found = entries_.find(name);
+  if (found == entries_.end()) return false;
+  const Entry& entry = found->second;
+  uint8_t* output_bytes = static_cast<uint8_t*>(output);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(mapped_file_.data());
+  if (job_system == nullptr || entry.num_blocks < 2) {
+    for (uint32_t i = 0; i < entry.num_blocks; ++i) {
+      const AssetBlock block = Block(entry, i);
+      if (!DecodeBlock(block, data + block.file_offset, output_bytes)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  std::atomic<bool> corrupt(false);
+  job_system->ParallelFor(entry.num_blocks, 1,
+                          [this, &entry, data, output_bytes, &corrupt](
+                              const int begin, const int end) {
+    for (int i = begin; i < end; ++i) {
+      const AssetBlock block = Block(entry, i);
+      if (!DecodeBlock(block, data + block.file_offset, output_bytes)) {
+        corrupt = true;
+      }
+    }
+  });
+  return !corrupt;
+}
+
+bool AssetArchive::Read(const std::string& name,
+                        std::string* contents,
+                        JobSystem* job_system) const {
+  const int64_t entry_size = size(name);
+  if (entry_size < 0) return false;
+  contents->resize(entry_size);
+  return Read(name, &(*contents)[0], job_system);
+}
+
+bool AssetArchive::Blocks(const std::string& name,
+                          std::vector<AssetBlock>* blocks) const {
+  const auto found = entries_.find(name);
+  if (found == entries_.end()) return false;
+  blocks->resize(found->second.num_blocks);
+  for (uint32_t i = 0; i < found->second.num_blocks; ++i) {
+    (*blocks)[i] = Block(found->second, i);
+  }
+  return true;
+}
+
+bool AssetArchive::DecodeBlock(const AssetBlock& block,
+                               const uint8_t* stored,
+                               uint8_t* output) {
+  if (block.stored_size == block.size) {
+    std::memcpy(output + block.offset, stored, block.size);
+    return true;
+  }
+  return DecompressLz4Block(stored, block.stored_size, output + block.offset,
+                            block.size);
+}
+
+AssetBlock AssetArchive::Block(const Entry& entry, const uint32_t i) const {
+  AssetBlock block;
+  block.file_offset = block_offsets_[entry.first_block + i];
+  block.stored_size = block_sizes_[entry.first_block + i];
+  block.offset = static_cast<uint64_t>(i) * block_size_;
+  block.size = std::min<uint64_t>(block_size_, entry.size - block.offset);
+  return block;
+}
+
+}  // namespace wvu
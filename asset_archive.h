@@ -0,0 +1,218 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_ASSET_ARCHIVE_H_
+#define GLUTILS_ASSET_ARCHIVE_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "lz4_block.h"
+#include "mapped_file.h"
+
+namespace wvu {
+class JobSystem;
+
+// Default size of the blocks an entry is compressed in.
+constexpr int kDefaultAssetBlockSize = 64 * 1024;
+
+// How the entries of an archive are stored.
+enum AssetCompression {
+  ASSET_STORED = 0,
+  ASSET_LZ4 = 1
+};
+
+// A block of an entry, as stored in an archive.
+struct AssetBlock {
+  // Where the block is in the file, and its bytes there.
+  uint64_t file_offset = 0;
+  uint32_t stored_size = 0;
+  // Where the block goes in the entry, and its bytes there. A block stored
+  // with as many bytes as it has is not compressed.
+  uint64_t offset = 0;
+  uint32_t size = 0;
+};
+
+// This class packs assets, e.g., shaders, meshes and textures, into one
+// archive for AssetArchive. The data of every entry is split into blocks of
+// block_size bytes, compressed one by one so that they decompress in parallel;
+// a block that does not shrink is stored. The entries follow each other in the
+// order they were added, so that a scene that adds its assets in the order it
+// loads them reads the archive sequentially.
+//
+// An archive is a header {char[4] "WVUA", uint32 version, uint32 block_size,
+// uint32 num_entries, uint64 index_offset}, the blocks, and the index: for
+// every entry {uint32 name_size, name, uint32 compression, uint64 size,
+// uint32 first_block, uint32 num_blocks}, and then for every block
+// {uint64 offset, uint32 stored_size}. The numbers are in host byte order.
+//
+// Example:
+//
+// wvu::AssetArchiveWriter writer;
+// writer.Add("shaders/lit.frag", source.data(), source.size(), wvu::ASSET_LZ4);
+// if (!writer.Write("assets.wvua", &error_info_log)) { ... }
+class AssetArchiveWriter {
+ public:
+  explicit AssetArchiveWriter(const int block_size = kDefaultAssetBlockSize);
+  ~AssetArchiveWriter() {}
+
+  // Adds an entry with a copy of the data, compressed now. Returns false if
+  // an entry has the same name.
+  bool Add(const std::string& name,
+           const void* data,
+           const size_t size,
+           const AssetCompression compression);
+
+  // Writes the archive to a temporary file renamed to filepath. Returns true
+  // if successful.
+  bool Write(const std::string& filepath, std::string* error_info_log) const;
+
+  // Bytes of the added data, and of its blocks.
+  int64_t num_bytes() const {
+    return num_bytes_;
+  }
+
+  int64_t num_stored_bytes() const {
+    return blocks_.size();
+  }
+
+ private:
+  struct Entry {
+    std::string name;
+    AssetCompression compression;
+    uint64_t size;
+    uint32_t first_block;
+    uint32_t num_blocks;
+  };
+
+  const int block_size_;
+  std::vector<Entry> entries_;
+  // The offsets of the blocks in blocks_, and their stored sizes.
+  std::vector<uint64_t> block_offsets_;
+  std::vector<uint32_t> block_sizes_;
+  std::vector<uint8_t> blocks_;
+  int64_t num_bytes_;
+  Lz4BlockCompressor compressor_;
+  std::vector<uint8_t> compressed_;
+};
+
+// This class reads the assets of an archive of AssetArchiveWriter with one
+// open and one memory mapping, instead of an open per asset. An entry is
+// decompressed straight from the mapping into the memory of the caller, and
+// its blocks are spread over the workers of a JobSystem when one is given.
+// Reads may run on several threads at once.
+//
+// Example:
+//
+// wvu::AssetArchive archive;
+// if (!archive.Open("assets.wvua", &error_info_log)) { ... }
+// std::string source;
+// if (archive.Read("shaders/lit.frag", &source, &job_system)) {
+//   program.LoadShaderFromString(wvu::ShaderProgram::FRAGMENT, source);
+// }
+class AssetArchive {
+ public:
+  AssetArchive();
+  ~AssetArchive() {}
+
+  // Maps the archive and reads its index. Returns true if successful.
+  bool Open(const std::string& filepath, std::string* error_info_log);
+
+  bool Contains(const std::string& name) const {
+    return entries_.count(name) > 0;
+  }
+
+  // Returns the size of the entry once decompressed, or -1 if there is none.
+  int64_t size(const std::string& name) const;
+
+  // Decompresses the entry into the size(name) bytes of output, in parallel
+  // if job_system is not nullptr. Returns false if there is no entry, or if
+  // it is corrupt.
+  bool Read(const std::string& name,
+            void* output,
+            JobSystem* job_system) const;
+
+  // Replaces contents with the entry. Returns false if there is no entry, or
+  // if it is corrupt.
+  bool Read(const std::string& name,
+            std::string* contents,
+            JobSystem* job_system) const;
+
+  // Replaces blocks with the blocks of the entry, e.g., to read them with an
+  // AsyncFileReader. Returns false if there is no entry.
+  bool Blocks(const std::string& name, std::vector<AssetBlock>* blocks) const;
+
+  // Decompresses the stored bytes of a block into its place in output.
+  // Returns false if the block is corrupt.
+  static bool DecodeBlock(const AssetBlock& block,
+                          const uint8_t* stored,
+                          uint8_t* output);
+
+  const std::string& filepath() const {
+    return mapped_file_.filepath();
+  }
+
+  // The names of the entries, in the order of the archive.
+  const std::vector<std::string>& names() const {
+    return names_;
+  }
+
+ private:
+  struct Entry {
+    AssetCompression compression;
+    uint64_t size;
+    uint32_t first_block;
+    uint32_t num_blocks;
+  };
+
+  // Returns block i of the entry.
+  AssetBlock Block(const Entry& entry, const uint32_t i) const;
+
+  MappedFile mapped_file_;
+  uint32_t block_size_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::vector<std::string> names_;
+  std::vector<uint64_t> block_offsets_;
+  std::vector<uint32_t> block_sizes_;
+
+  AssetArchive(const AssetArchive&) = delete;
+  AssetArchive& operator=(const AssetArchive&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_ASSET_ARCHIVE_H_
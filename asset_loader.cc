@@ -0,0 +1,198 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "asset_loader.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "asset_archive.h"
+#include "async_file_reader.h"
+#include "job_system.h"
+
+namespace wvu {
+AssetLoader::AssetLoader(const AssetArchive* archive,
+                         AsyncFileReader* reader,
+                         JobSystem* job_system)
+    : archive_(archive),
+      reader_(reader),
+      job_system_(job_system),
+      fd_(-1),
+      next_id_(0),
+      completions_(kDefaultAsyncReadQueueDepth) {}
+
+AssetLoader::~AssetLoader() {
+  Finish();
+  if (fd_ >= 0) close(fd_);
+}
+
+bool AssetLoader::Open(std::string* error_info_log) {
+  if (fd_ >= 0) close(fd_);
+  fd_ = open(archive_->filepath().c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) {
+    *error_info_log = "Could not open " + archive_->filepath() + ": " +
+        std::strerror(errno) + ".";
+    return false;
+  }
+  return true;
+}
+
+bool AssetLoader::Load(const std::string& name, Callback callback) {
+  std::unique_ptr<Asset> asset(new Asset);
+  if (fd_ < 0 || !archive_->Blocks(name, &asset->blocks)) return false;
+  asset->name = name;
+  asset->callback = std::move(callback);
+  asset->contents.resize(archive_->size(name));
+  asset->stored_offsets.resize(asset->blocks.size());
+  uint64_t stored_size = 0;
+  for (size_t i = 0; i < asset->blocks.size(); ++i) {
+    asset->stored_offsets[i] = stored_size;
+    stored_size += asset->blocks[i].stored_size;
+  }
+  asset->stored.resize(stored_size);
+  asset->num_remaining_blocks = asset->blocks.size();
+  asset->failed = false;
+  // The user data of a read is the asset and the block.
+  const uint32_t id = next_id_++;
+  for (size_t i = 0; i < asset->blocks.size(); ++i) {
+    reader_->Read(fd_, asset->blocks[i].file_offset,
+                  asset->blocks[i].stored_size,
+                  asset->stored.data() + asset->stored_offsets[i],
+                  (static_cast<uint64_t>(id) << 32) | i);
+  }
+  if (asset->blocks.empty()) {
+    std::lock_guard<std::mutex> lock(loaded_mutex_);
+    loaded_ids_.push_back(id);
+  }
+  assets_[id] = std::move(asset);
+  return true;
+}
+
+int AssetLoader::Update(const bool wait) {
+  int num_callbacks = 0;
+  std::vector<uint32_t> loaded_ids;
+  do {
+    reader_->Submit();
+    int num_completions;
+    while ((num_completions = reader_->Poll(
+                completions_.data(), completions_.size(), false)) > 0) {
+      for (int i = 0; i < num_completions; ++i) {
+        const uint32_t id = completions_[i].user_data >> 32;
+        DecompressBlock(assets_[id].get(), id,
+                        completions_[i].user_data & 0xffffffff,
+                        completions_[i].result);
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(loaded_mutex_);
+      loaded_ids.swap(loaded_ids_);
+    }
+    // Nothing loaded yet: this thread helps the jobs, or waits for a read.
+    if (wait && loaded_ids.empty() && !assets_.empty()) {
+      if (!jobs_.done()) {
+        job_system_->Wait(jobs_);
+      } else if (reader_->num_pending() > 0) {
+        num_completions = reader_->Poll(completions_.data(),
+                                        completions_.size(), true);
+        for (int i = 0; i < num_completions; ++i) {
+          const uint32_t id = completions_[i].user_data >> 32;
+          DecompressBlock(assets_[id].get(), id,
+                          completions_[i].user_data & 0xffffffff,
+                          completions_[i].result);
+        }
+      }
+    }
+    for (const uint32_t id : loaded_ids) {
+      std::unique_ptr<Asset> asset = std::move(assets_[id]);
+      assets_.erase(id);
+      if (asset->failed) {
+        ++statistics_.num_failed_assets;
+        asset->callback(asset->name, nullptr);
+      } else {
+        ++statistics_.num_loaded_assets;
+        statistics_.num_bytes += asset->contents.size();
+        asset->callback(asset->name, &asset->contents);
+      }
+      ++num_callbacks;
+    }
+    loaded_ids.clear();
+  } while (wait && num_callbacks == 0 && !assets_.empty());
+  return num_callbacks;
+}
+
+void AssetLoader::Finish() {
+  while (!assets_.empty()) Update(true);
+}
+
+AssetLoaderStatistics AssetLoader::statistics() const {
+  AssetLoaderStatistics statistics = statistics_;
+  statistics.reads = reader_->statistics();
+  return statistics;
+}
+
+void AssetLoader::DecompressBlock(Asset* asset,
+                                  const uint64_t id,
+                                  const uint32_t block,
+                                  const int64_t result) {
+  const auto finish_block = [this, asset, id]() {
+    if (asset->num_remaining_blocks.fetch_sub(1) == 1) {
+      std::lock_guard<std::mutex> lock(loaded_mutex_);
+      loaded_ids_.push_back(id);
+    }
+  };
+  if (result != asset->blocks[block].stored_size) {
+    asset->failed = true;
+    finish_block();
+    return;
+  }
+  job_system_->Run([asset, block, finish_block]() {
+    if (!AssetArchive::DecodeBlock(
+            asset->blocks[block],
+            asset->stored.data() + asset->stored_offsets[block],
+            asset->contents.data())) {
+      asset->failed = true;
+    }
+    finish_block();
+  }, &jobs_);
+}
+
+}  // namespace wvu
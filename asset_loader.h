@@ -0,0 +1,158 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_ASSET_LOADER_H_
+#define GLUTILS_ASSET_LOADER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "asset_archive.h"
+#include "async_file_reader.h"
+#include "job_system.h"
+
+namespace wvu {
+// Counters of an AssetLoader.
+struct AssetLoaderStatistics {
+  int64_t num_loaded_assets = 0;
+  int64_t num_failed_assets = 0;
+  // Bytes of the loaded assets, once decompressed.
+  int64_t num_bytes = 0;
+  // The counters of the reads.
+  AsyncReadStatistics reads;
+};
+
+// This class loads the entries of an AssetArchive as a pipeline of three
+// stages, so that the disk, the cores and the GPU all work at once: the blocks
+// of the entries are read with an AsyncFileReader (io_uring on Linux), every
+// block read is decompressed by a job of a JobSystem, and once all the blocks
+// of an entry are decompressed, its callback runs on the thread calling
+// Update(), e.g., to upload it to the GPU. The reads bypass the mapping of the
+// archive, so that the loading thread never stalls on a page fault.
+// Load() and Update() must be called by the thread that created the
+// JobSystem.
+//
+// Example:
+//
+// wvu::AssetLoader loader(&archive, &reader, &job_system);
+// if (!loader.Open(&error_info_log)) { ... }
+// loader.Load("meshes/bunny.mesh", [&](const std::string& name,
+//                                      std::vector<uint8_t>* contents) {
+//   if (contents != nullptr) ...  // Upload the mesh.
+// });
+// while (...) {  // Rendering loop.
+//   loader.Update(false);
+//   ...  // Render the frame.
+// }
+class AssetLoader {
+ public:
+  // Called with the contents of a loaded entry, or nullptr if the entry could
+  // not be loaded. The callback may take the contents.
+  typedef std::function<void(const std::string& name,
+                             std::vector<uint8_t>* contents)> Callback;
+
+  // The archive, the reader and the job system must outlive the loader.
+  AssetLoader(const AssetArchive* archive,
+              AsyncFileReader* reader,
+              JobSystem* job_system);
+  ~AssetLoader();
+
+  // Opens the file of the archive for the reads. Returns true if successful.
+  bool Open(std::string* error_info_log);
+
+  // Starts loading the entry. Returns false if there is no entry.
+  bool Load(const std::string& name, Callback callback);
+
+  // Submits the queued reads, decompresses the blocks read, and calls the
+  // callbacks of the loaded entries. If wait is true, waits until at least one
+  // entry is loaded, unless none is loading. Returns the number of callbacks
+  // called.
+  int Update(const bool wait);
+
+  // Waits for the entries loading, and calls their callbacks.
+  void Finish();
+
+  int num_loading() const {
+    return assets_.size();
+  }
+
+  AssetLoaderStatistics statistics() const;
+
+ private:
+  struct Asset {
+    std::string name;
+    Callback callback;
+    std::vector<AssetBlock> blocks;
+    // The stored bytes of the blocks, one after the other.
+    std::vector<uint8_t> stored;
+    std::vector<uint64_t> stored_offsets;
+    std::vector<uint8_t> contents;
+    std::atomic<int> num_remaining_blocks;
+    std::atomic<bool> failed;
+  };
+
+  // Runs the decompression of a block read, or marks its asset failed.
+  void DecompressBlock(Asset* asset,
+                       const uint64_t id,
+                       const uint32_t block,
+                       const int64_t result);
+
+  const AssetArchive* archive_;
+  AsyncFileReader* reader_;
+  JobSystem* job_system_;
+  int fd_;
+  uint32_t next_id_;
+  std::unordered_map<uint32_t, std::unique_ptr<Asset> > assets_;
+  // The decompression jobs in flight.
+  JobCounter jobs_;
+  // The assets whose blocks are all decompressed, added by the jobs.
+  std::mutex loaded_mutex_;
+  std::vector<uint32_t> loaded_ids_;
+  std::vector<AsyncReadCompletion> completions_;
+  AssetLoaderStatistics statistics_;
+
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_ASSET_LOADER_H_
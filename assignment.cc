@@ -32,9 +32,28 @@
 #include "assignment.h"
 
 #include <math.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define WVU_HAS_SSE
+#endif
+// AVX2 and AVX-512 kernels are compiled for their own targets and selected at
+// run time, so that the binary still runs on CPUs without them.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define WVU_HAS_AVX2
+#define WVU_HAS_AVX512
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define WVU_HAS_NEON
+#endif
+
 namespace wvu {
 // Adds two 3d points and returns the resultant added point.
 Eigen::Vector3f Add3dPoints(const Eigen::Vector3f& x,
@@ -69,8 +88,9 @@ float ComputeDotProduct(const Eigen::Vector3f& x,
 // Calculates the angle between two vectors in radians.
 float CalculateAngleBetweenTwoVectors(const Eigen::Vector3f& x,
                                       const Eigen::Vector3f& y) {
-  const float cos_theta = x.normalized().dot(y.normalized());
-  return acos(cos_theta);
+  // |x × y| = |x| |y| sin(theta) and x · y = |x| |y| cos(theta), so the norms
+  // cancel in the quotient.
+  return atan2(x.cross(y).norm(), x.dot(y));
 }
 
 // Calculates the cross product of two vectors.
@@ -79,4 +99,1138 @@ Eigen::Vector3f ComputeCrossProduct(const Eigen::Vector3f& x,
   return x.cross(y);
 }
 
+namespace {
+// The kernels below process the vectors in [begin, end) and return the index
+// of the first vector they did not process, since the SIMD kernels stop at the
+// last full register. The scalar kernels process the remaining vectors.
+// Matrices are column-major, as in Eigen.
+
+int TransformScalar(const float* matrix,
+                    const float* const input[4],
+                    float* const output[4],
+                    const int begin,
+                    const int end) {
+  for (int i = begin; i < end; ++i) {
+    // The inputs are read before writing, so the output may alias them.
+    const float x = input[0][i];
+    const float y = input[1][i];
+    const float z = input[2][i];
+    const float w = input[3][i];
+    for (int row = 0; row < 4; ++row) {
+      output[row][i] = matrix[row] * x + matrix[4 + row] * y +
+          matrix[8 + row] * z + matrix[12 + row] * w;
+    }
+  }
+  return end;
+}
+
+int DotScalar(const float* const x[3],
+              const float* const y[3],
+              float* result,
+              const int begin,
+              const int end) {
+  for (int i = begin; i < end; ++i) {
+    result[i] = x[0][i] * y[0][i] + x[1][i] * y[1][i] + x[2][i] * y[2][i];
+  }
+  return end;
+}
+
+int CrossScalar(const float* const x[3],
+                const float* const y[3],
+                float* const result[3],
+                const int begin,
+                const int end) {
+  for (int i = begin; i < end; ++i) {
+    const float cross_x = x[1][i] * y[2][i] - x[2][i] * y[1][i];
+    const float cross_y = x[2][i] * y[0][i] - x[0][i] * y[2][i];
+    const float cross_z = x[0][i] * y[1][i] - x[1][i] * y[0][i];
+    result[0][i] = cross_x;
+    result[1][i] = cross_y;
+    result[2][i] = cross_z;
+  }
+  return end;
+}
+
+// The culling kernels test bounding volumes against the six planes of a
+// frustum, stored row by row as (a, b, c, d). The volumes are spheres when
+// radius is given, and boxes of the half extents otherwise. They set the bit
+// i % 32 of visibility[i / 32] of the visible volumes, so begin must be a
+// multiple of the number of lanes.
+int CullScalar(const float* planes,
+               const float* const center[3],
+               const float* const extent[3],
+               const float* radius,
+               uint32_t* visibility,
+               const int begin,
+               const int end) {
+  for (int i = begin; i < end; ++i) {
+    bool visible = true;
+    for (int p = 0; p < 6 && visible; ++p) {
+      const float* plane = planes + 4 * p;
+      const float distance = plane[0] * center[0][i] +
+          plane[1] * center[1][i] + plane[2] * center[2][i] + plane[3];
+      const float bound = radius != nullptr ? radius[i] :
+          fabsf(plane[0]) * extent[0][i] + fabsf(plane[1]) * extent[1][i] +
+          fabsf(plane[2]) * extent[2][i];
+      visible = distance + bound >= 0.0f;
+    }
+    if (visible) visibility[i >> 5] |= 1u << (i & 31);
+  }
+  return end;
+}
+
+// The intersection kernels intersect a ray, stored as (origin, direction), with
+// triangles given by a vertex and the two edges leaving it, with the
+// Möller-Trumbore algorithm. They keep the nearest triangle hit nearer than
+// distance, updating distance and triangle.
+constexpr float kParallelDeterminant = 1e-12f;
+
+int IntersectScalar(const float* ray,
+                    const float* const vertex[3],
+                    const float* const first_edge[3],
+                    const float* const second_edge[3],
+                    float* distance,
+                    int* triangle,
+                    const int begin,
+                    const int end) {
+  const Eigen::Vector3f origin(ray[0], ray[1], ray[2]);
+  const Eigen::Vector3f direction(ray[3], ray[4], ray[5]);
+  for (int i = begin; i < end; ++i) {
+    const Eigen::Vector3f corner(vertex[0][i], vertex[1][i], vertex[2][i]);
+    const Eigen::Vector3f edge1(first_edge[0][i], first_edge[1][i],
+                                first_edge[2][i]);
+    const Eigen::Vector3f edge2(second_edge[0][i], second_edge[1][i],
+                                second_edge[2][i]);
+    const Eigen::Vector3f p = ComputeCrossProduct(direction, edge2);
+    const float determinant = ComputeDotProduct(edge1, p);
+    if (fabsf(determinant) <= kParallelDeterminant) continue;
+    const float inverse_determinant = 1.0f / determinant;
+    const Eigen::Vector3f s = origin - corner;
+    const float u = ComputeDotProduct(s, p) * inverse_determinant;
+    const Eigen::Vector3f q = ComputeCrossProduct(s, edge1);
+    const float v = ComputeDotProduct(direction, q) * inverse_determinant;
+    const float t = ComputeDotProduct(edge2, q) * inverse_determinant;
+    if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f &&
+        t < *distance) {
+      *distance = t;
+      *triangle = i;
+    }
+  }
+  return end;
+}
+
+// Keeps the nearest of the hits of the SIMD intersection kernels, whose lanes
+// are set in hits, in the order of the triangles.
+inline void KeepNearestHit(const float* distances,
+                           uint32_t hits,
+                           const int first_triangle,
+                           float* distance,
+                           int* triangle) {
+  while (hits != 0) {
+    const int lane = __builtin_ctz(hits);
+    hits &= hits - 1;
+    if (distances[lane] < *distance) {
+      *distance = distances[lane];
+      *triangle = first_triangle + lane;
+    }
+  }
+}
+
+#if defined(WVU_HAS_SSE)
+int TransformSse(const float* matrix,
+                 const float* const input[4],
+                 float* const output[4],
+                 const int begin,
+                 const int end) {
+  __m128 entries[16];
+  for (int k = 0; k < 16; ++k) entries[k] = _mm_set1_ps(matrix[k]);
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m128 x = _mm_loadu_ps(input[0] + i);
+    const __m128 y = _mm_loadu_ps(input[1] + i);
+    const __m128 z = _mm_loadu_ps(input[2] + i);
+    const __m128 w = _mm_loadu_ps(input[3] + i);
+    for (int row = 0; row < 4; ++row) {
+      const __m128 value = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(entries[row], x),
+                     _mm_mul_ps(entries[4 + row], y)),
+          _mm_add_ps(_mm_mul_ps(entries[8 + row], z),
+                     _mm_mul_ps(entries[12 + row], w)));
+      _mm_storeu_ps(output[row] + i, value);
+    }
+  }
+  return i;
+}
+
+int DotSse(const float* const x[3],
+           const float* const y[3],
+           float* result,
+           const int begin,
+           const int end) {
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m128 value = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x[0] + i), _mm_loadu_ps(y[0] + i)),
+                   _mm_mul_ps(_mm_loadu_ps(x[1] + i), _mm_loadu_ps(y[1] + i))),
+        _mm_mul_ps(_mm_loadu_ps(x[2] + i), _mm_loadu_ps(y[2] + i)));
+    _mm_storeu_ps(result + i, value);
+  }
+  return i;
+}
+
+int CrossSse(const float* const x[3],
+             const float* const y[3],
+             float* const result[3],
+             const int begin,
+             const int end) {
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m128 x0 = _mm_loadu_ps(x[0] + i);
+    const __m128 x1 = _mm_loadu_ps(x[1] + i);
+    const __m128 x2 = _mm_loadu_ps(x[2] + i);
+    const __m128 y0 = _mm_loadu_ps(y[0] + i);
+    const __m128 y1 = _mm_loadu_ps(y[1] + i);
+    const __m128 y2 = _mm_loadu_ps(y[2] + i);
+    _mm_storeu_ps(result[0] + i,
+                  _mm_sub_ps(_mm_mul_ps(x1, y2), _mm_mul_ps(x2, y1)));
+    _mm_storeu_ps(result[1] + i,
+                  _mm_sub_ps(_mm_mul_ps(x2, y0), _mm_mul_ps(x0, y2)));
+    _mm_storeu_ps(result[2] + i,
+                  _mm_sub_ps(_mm_mul_ps(x0, y1), _mm_mul_ps(x1, y0)));
+  }
+  return i;
+}
+
+int CullSse(const float* planes,
+            const float* const center[3],
+            const float* const extent[3],
+            const float* radius,
+            uint32_t* visibility,
+            const int begin,
+            const int end) {
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m128 x = _mm_loadu_ps(center[0] + i);
+    const __m128 y = _mm_loadu_ps(center[1] + i);
+    const __m128 z = _mm_loadu_ps(center[2] + i);
+    __m128 visible = _mm_cmpeq_ps(x, x);
+    for (int p = 0; p < 6; ++p) {
+      const float* plane = planes + 4 * p;
+      const __m128 a = _mm_set1_ps(plane[0]);
+      const __m128 b = _mm_set1_ps(plane[1]);
+      const __m128 c = _mm_set1_ps(plane[2]);
+      __m128 bound;
+      if (radius != nullptr) {
+        bound = _mm_loadu_ps(radius + i);
+      } else {
+        bound = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, a),
+                                  _mm_loadu_ps(extent[0] + i)),
+                       _mm_mul_ps(_mm_andnot_ps(sign_mask, b),
+                                  _mm_loadu_ps(extent[1] + i))),
+            _mm_mul_ps(_mm_andnot_ps(sign_mask, c),
+                       _mm_loadu_ps(extent[2] + i)));
+      }
+      const __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(b, y)),
+          _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(plane[3])));
+      visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, bound),
+                                                 _mm_setzero_ps()));
+    }
+    visibility[i >> 5] |=
+        static_cast<uint32_t>(_mm_movemask_ps(visible)) << (i & 31);
+  }
+  return i;
+}
+
+int IntersectSse(const float* ray,
+                 const float* const vertex[3],
+                 const float* const first_edge[3],
+                 const float* const second_edge[3],
+                 float* distance,
+                 int* triangle,
+                 const int begin,
+                 const int end) {
+  const __m128 ox = _mm_set1_ps(ray[0]);
+  const __m128 oy = _mm_set1_ps(ray[1]);
+  const __m128 oz = _mm_set1_ps(ray[2]);
+  const __m128 dx = _mm_set1_ps(ray[3]);
+  const __m128 dy = _mm_set1_ps(ray[4]);
+  const __m128 dz = _mm_set1_ps(ray[5]);
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m128 e1x = _mm_loadu_ps(first_edge[0] + i);
+    const __m128 e1y = _mm_loadu_ps(first_edge[1] + i);
+    const __m128 e1z = _mm_loadu_ps(first_edge[2] + i);
+    const __m128 e2x = _mm_loadu_ps(second_edge[0] + i);
+    const __m128 e2y = _mm_loadu_ps(second_edge[1] + i);
+    const __m128 e2z = _mm_loadu_ps(second_edge[2] + i);
+    // p = direction x second edge.
+    const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    const __m128 determinant = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)),
+        _mm_mul_ps(e1z, pz));
+    const __m128 inverse_determinant = _mm_div_ps(one, determinant);
+    // s = origin - vertex, and q = s x first edge.
+    const __m128 sx = _mm_sub_ps(ox, _mm_loadu_ps(vertex[0] + i));
+    const __m128 sy = _mm_sub_ps(oy, _mm_loadu_ps(vertex[1] + i));
+    const __m128 sz = _mm_sub_ps(oz, _mm_loadu_ps(vertex[2] + i));
+    const __m128 u = _mm_mul_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)),
+                   _mm_mul_ps(sz, pz)),
+        inverse_determinant);
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    const __m128 v = _mm_mul_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+                   _mm_mul_ps(dz, qz)),
+        inverse_determinant);
+    const __m128 t = _mm_mul_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+                   _mm_mul_ps(e2z, qz)),
+        inverse_determinant);
+    __m128 hit = _mm_cmpgt_ps(_mm_andnot_ps(sign_mask, determinant),
+                              _mm_set1_ps(kParallelDeterminant));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(t, zero));
+    hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(*distance)));
+    const int hits = _mm_movemask_ps(hit);
+    if (hits == 0) continue;
+    float distances[4];
+    _mm_storeu_ps(distances, t);
+    KeepNearestHit(distances, hits, i, distance, triangle);
+  }
+  return i;
+}
+
+// Computes result = x * y with one register per column.
+void MultiplyMatrixSse(const float* x, const float* y, float* result) {
+  const __m128 columns[4] = {_mm_loadu_ps(x), _mm_loadu_ps(x + 4),
+                             _mm_loadu_ps(x + 8), _mm_loadu_ps(x + 12)};
+  __m128 products[4];
+  for (int j = 0; j < 4; ++j) {
+    const float* y_column = y + 4 * j;
+    products[j] = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(y_column[0])),
+                   _mm_mul_ps(columns[1], _mm_set1_ps(y_column[1]))),
+        _mm_add_ps(_mm_mul_ps(columns[2], _mm_set1_ps(y_column[2])),
+                   _mm_mul_ps(columns[3], _mm_set1_ps(y_column[3]))));
+  }
+  // The columns of y are read before writing, so the result may alias it.
+  for (int j = 0; j < 4; ++j) _mm_storeu_ps(result + 4 * j, products[j]);
+}
+#endif  // WVU_HAS_SSE
+
+#if defined(WVU_HAS_AVX2)
+__attribute__((target("avx2,fma")))
+int TransformAvx2(const float* matrix,
+                  const float* const input[4],
+                  float* const output[4],
+                  const int begin,
+                  const int end) {
+  __m256 entries[16];
+  for (int k = 0; k < 16; ++k) entries[k] = _mm256_set1_ps(matrix[k]);
+  int i = begin;
+  for (; i + 8 <= end; i += 8) {
+    const __m256 x = _mm256_loadu_ps(input[0] + i);
+    const __m256 y = _mm256_loadu_ps(input[1] + i);
+    const __m256 z = _mm256_loadu_ps(input[2] + i);
+    const __m256 w = _mm256_loadu_ps(input[3] + i);
+    for (int row = 0; row < 4; ++row) {
+      __m256 value = _mm256_mul_ps(entries[row], x);
+      value = _mm256_fmadd_ps(entries[4 + row], y, value);
+      value = _mm256_fmadd_ps(entries[8 + row], z, value);
+      value = _mm256_fmadd_ps(entries[12 + row], w, value);
+      _mm256_storeu_ps(output[row] + i, value);
+    }
+  }
+  return i;
+}
+
+__attribute__((target("avx2,fma")))
+int DotAvx2(const float* const x[3],
+            const float* const y[3],
+            float* result,
+            const int begin,
+            const int end) {
+  int i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 value =
+        _mm256_mul_ps(_mm256_loadu_ps(x[0] + i), _mm256_loadu_ps(y[0] + i));
+    value = _mm256_fmadd_ps(_mm256_loadu_ps(x[1] + i),
+                            _mm256_loadu_ps(y[1] + i), value);
+    value = _mm256_fmadd_ps(_mm256_loadu_ps(x[2] + i),
+                            _mm256_loadu_ps(y[2] + i), value);
+    _mm256_storeu_ps(result + i, value);
+  }
+  return i;
+}
+
+__attribute__((target("avx2,fma")))
+int CrossAvx2(const float* const x[3],
+              const float* const y[3],
+              float* const result[3],
+              const int begin,
+              const int end) {
+  int i = begin;
+  for (; i + 8 <= end; i += 8) {
+    const __m256 x0 = _mm256_loadu_ps(x[0] + i);
+    const __m256 x1 = _mm256_loadu_ps(x[1] + i);
+    const __m256 x2 = _mm256_loadu_ps(x[2] + i);
+    const __m256 y0 = _mm256_loadu_ps(y[0] + i);
+    const __m256 y1 = _mm256_loadu_ps(y[1] + i);
+    const __m256 y2 = _mm256_loadu_ps(y[2] + i);
+    _mm256_storeu_ps(result[0] + i,
+                     _mm256_fmsub_ps(x1, y2, _mm256_mul_ps(x2, y1)));
+    _mm256_storeu_ps(result[1] + i,
+                     _mm256_fmsub_ps(x2, y0, _mm256_mul_ps(x0, y2)));
+    _mm256_storeu_ps(result[2] + i,
+                     _mm256_fmsub_ps(x0, y1, _mm256_mul_ps(x1, y0)));
+  }
+  return i;
+}
+
+__attribute__((target("avx2,fma")))
+int CullAvx2(const float* planes,
+             const float* const center[3],
+             const float* const extent[3],
+             const float* radius,
+             uint32_t* visibility,
+             const int begin,
+             const int end) {
+  const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+  int i = begin;
+  for (; i + 8 <= end; i += 8) {
+    const __m256 x = _mm256_loadu_ps(center[0] + i);
+    const __m256 y = _mm256_loadu_ps(center[1] + i);
+    const __m256 z = _mm256_loadu_ps(center[2] + i);
+    __m256 visible = _mm256_cmp_ps(x, x, _CMP_TRUE_UQ);
+    for (int p = 0; p < 6; ++p) {
+      const float* plane = planes + 4 * p;
+      const __m256 a = _mm256_set1_ps(plane[0]);
+      const __m256 b = _mm256_set1_ps(plane[1]);
+      const __m256 c = _mm256_set1_ps(plane[2]);
+      __m256 bound;
+      if (radius != nullptr) {
+        bound = _mm256_loadu_ps(radius + i);
+      } else {
+        bound = _mm256_mul_ps(_mm256_andnot_ps(sign_mask, a),
+                              _mm256_loadu_ps(extent[0] + i));
+        bound = _mm256_fmadd_ps(_mm256_andnot_ps(sign_mask, b),
+                                _mm256_loadu_ps(extent[1] + i), bound);
+        bound = _mm256_fmadd_ps(_mm256_andnot_ps(sign_mask, c),
+                                _mm256_loadu_ps(extent[2] + i), bound);
+      }
+      __m256 distance = _mm256_fmadd_ps(a, x, _mm256_set1_ps(plane[3]));
+      distance = _mm256_fmadd_ps(b, y, distance);
+      distance = _mm256_fmadd_ps(c, z, distance);
+      visible = _mm256_and_ps(
+          visible, _mm256_cmp_ps(_mm256_add_ps(distance, bound),
+                                 _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+    visibility[i >> 5] |=
+        static_cast<uint32_t>(_mm256_movemask_ps(visible)) << (i & 31);
+  }
+  return i;
+}
+
+// Leaves of a bounding volume hierarchy hold at most 8 triangles, so this
+// kernel also runs in the place of an AVX-512 one.
+__attribute__((target("avx2,fma")))
+int IntersectAvx2(const float* ray,
+                  const float* const vertex[3],
+                  const float* const first_edge[3],
+                  const float* const second_edge[3],
+                  float* distance,
+                  int* triangle,
+                  const int begin,
+                  const int end) {
+  const __m256 ox = _mm256_set1_ps(ray[0]);
+  const __m256 oy = _mm256_set1_ps(ray[1]);
+  const __m256 oz = _mm256_set1_ps(ray[2]);
+  const __m256 dx = _mm256_set1_ps(ray[3]);
+  const __m256 dy = _mm256_set1_ps(ray[4]);
+  const __m256 dz = _mm256_set1_ps(ray[5]);
+  const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  int i = begin;
+  for (; i + 8 <= end; i += 8) {
+    const __m256 e1x = _mm256_loadu_ps(first_edge[0] + i);
+    const __m256 e1y = _mm256_loadu_ps(first_edge[1] + i);
+    const __m256 e1z = _mm256_loadu_ps(first_edge[2] + i);
+    const __m256 e2x = _mm256_loadu_ps(second_edge[0] + i);
+    const __m256 e2y = _mm256_loadu_ps(second_edge[1] + i);
+    const __m256 e2z = _mm256_loadu_ps(second_edge[2] + i);
+    // p = direction x second edge.
+    const __m256 px = _mm256_fmsub_ps(dy, e2z, _mm256_mul_ps(dz, e2y));
+    const __m256 py = _mm256_fmsub_ps(dz, e2x, _mm256_mul_ps(dx, e2z));
+    const __m256 pz = _mm256_fmsub_ps(dx, e2y, _mm256_mul_ps(dy, e2x));
+    __m256 determinant = _mm256_mul_ps(e1x, px);
+    determinant = _mm256_fmadd_ps(e1y, py, determinant);
+    determinant = _mm256_fmadd_ps(e1z, pz, determinant);
+    const __m256 inverse_determinant = _mm256_div_ps(one, determinant);
+    // s = origin - vertex, and q = s x first edge.
+    const __m256 sx = _mm256_sub_ps(ox, _mm256_loadu_ps(vertex[0] + i));
+    const __m256 sy = _mm256_sub_ps(oy, _mm256_loadu_ps(vertex[1] + i));
+    const __m256 sz = _mm256_sub_ps(oz, _mm256_loadu_ps(vertex[2] + i));
+    __m256 u = _mm256_mul_ps(sx, px);
+    u = _mm256_fmadd_ps(sy, py, u);
+    u = _mm256_mul_ps(_mm256_fmadd_ps(sz, pz, u), inverse_determinant);
+    const __m256 qx = _mm256_fmsub_ps(sy, e1z, _mm256_mul_ps(sz, e1y));
+    const __m256 qy = _mm256_fmsub_ps(sz, e1x, _mm256_mul_ps(sx, e1z));
+    const __m256 qz = _mm256_fmsub_ps(sx, e1y, _mm256_mul_ps(sy, e1x));
+    __m256 v = _mm256_mul_ps(dx, qx);
+    v = _mm256_fmadd_ps(dy, qy, v);
+    v = _mm256_mul_ps(_mm256_fmadd_ps(dz, qz, v), inverse_determinant);
+    __m256 t = _mm256_mul_ps(e2x, qx);
+    t = _mm256_fmadd_ps(e2y, qy, t);
+    t = _mm256_mul_ps(_mm256_fmadd_ps(e2z, qz, t), inverse_determinant);
+    __m256 hit = _mm256_cmp_ps(_mm256_andnot_ps(sign_mask, determinant),
+                               _mm256_set1_ps(kParallelDeterminant),
+                               _CMP_GT_OQ);
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit,
+                        _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, zero, _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_set1_ps(*distance),
+                                           _CMP_LT_OQ));
+    const int hits = _mm256_movemask_ps(hit);
+    if (hits == 0) continue;
+    float distances[8];
+    _mm256_storeu_ps(distances, t);
+    KeepNearestHit(distances, hits, i, distance, triangle);
+  }
+  return i;
+}
+#endif  // WVU_HAS_AVX2
+
+#if defined(WVU_HAS_AVX512)
+// The AVX-512 kernels process the last vectors with masked loads and stores,
+// so they process all the vectors.
+__attribute__((target("avx512f")))
+inline __mmask16 RemainderMask(const int num_vectors) {
+  return num_vectors >= 16 ? 0xffff : (1u << num_vectors) - 1;
+}
+
+__attribute__((target("avx512f")))
+int TransformAvx512(const float* matrix,
+                    const float* const input[4],
+                    float* const output[4],
+                    const int begin,
+                    const int end) {
+  __m512 entries[16];
+  for (int k = 0; k < 16; ++k) entries[k] = _mm512_set1_ps(matrix[k]);
+  for (int i = begin; i < end; i += 16) {
+    const __mmask16 mask = RemainderMask(end - i);
+    const __m512 x = _mm512_maskz_loadu_ps(mask, input[0] + i);
+    const __m512 y = _mm512_maskz_loadu_ps(mask, input[1] + i);
+    const __m512 z = _mm512_maskz_loadu_ps(mask, input[2] + i);
+    const __m512 w = _mm512_maskz_loadu_ps(mask, input[3] + i);
+    for (int row = 0; row < 4; ++row) {
+      __m512 value = _mm512_mul_ps(entries[row], x);
+      value = _mm512_fmadd_ps(entries[4 + row], y, value);
+      value = _mm512_fmadd_ps(entries[8 + row], z, value);
+      value = _mm512_fmadd_ps(entries[12 + row], w, value);
+      _mm512_mask_storeu_ps(output[row] + i, mask, value);
+    }
+  }
+  return end;
+}
+
+__attribute__((target("avx512f")))
+int DotAvx512(const float* const x[3],
+              const float* const y[3],
+              float* result,
+              const int begin,
+              const int end) {
+  for (int i = begin; i < end; i += 16) {
+    const __mmask16 mask = RemainderMask(end - i);
+    __m512 value = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, x[0] + i),
+                                 _mm512_maskz_loadu_ps(mask, y[0] + i));
+    value = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x[1] + i),
+                            _mm512_maskz_loadu_ps(mask, y[1] + i), value);
+    value = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x[2] + i),
+                            _mm512_maskz_loadu_ps(mask, y[2] + i), value);
+    _mm512_mask_storeu_ps(result + i, mask, value);
+  }
+  return end;
+}
+
+__attribute__((target("avx512f")))
+int CrossAvx512(const float* const x[3],
+                const float* const y[3],
+                float* const result[3],
+                const int begin,
+                const int end) {
+  for (int i = begin; i < end; i += 16) {
+    const __mmask16 mask = RemainderMask(end - i);
+    const __m512 x0 = _mm512_maskz_loadu_ps(mask, x[0] + i);
+    const __m512 x1 = _mm512_maskz_loadu_ps(mask, x[1] + i);
+    const __m512 x2 = _mm512_maskz_loadu_ps(mask, x[2] + i);
+    const __m512 y0 = _mm512_maskz_loadu_ps(mask, y[0] + i);
+    const __m512 y1 = _mm512_maskz_loadu_ps(mask, y[1] + i);
+    const __m512 y2 = _mm512_maskz_loadu_ps(mask, y[2] + i);
+    _mm512_mask_storeu_ps(result[0] + i, mask,
+                          _mm512_fmsub_ps(x1, y2, _mm512_mul_ps(x2, y1)));
+    _mm512_mask_storeu_ps(result[1] + i, mask,
+                          _mm512_fmsub_ps(x2, y0, _mm512_mul_ps(x0, y2)));
+    _mm512_mask_storeu_ps(result[2] + i, mask,
+                          _mm512_fmsub_ps(x0, y1, _mm512_mul_ps(x1, y0)));
+  }
+  return end;
+}
+
+__attribute__((target("avx512f")))
+int CullAvx512(const float* planes,
+               const float* const center[3],
+               const float* const extent[3],
+               const float* radius,
+               uint32_t* visibility,
+               const int begin,
+               const int end) {
+  for (int i = begin; i < end; i += 16) {
+    const __mmask16 mask = RemainderMask(end - i);
+    const __m512 x = _mm512_maskz_loadu_ps(mask, center[0] + i);
+    const __m512 y = _mm512_maskz_loadu_ps(mask, center[1] + i);
+    const __m512 z = _mm512_maskz_loadu_ps(mask, center[2] + i);
+    __mmask16 visible = mask;
+    for (int p = 0; p < 6; ++p) {
+      const float* plane = planes + 4 * p;
+      const __m512 a = _mm512_set1_ps(plane[0]);
+      const __m512 b = _mm512_set1_ps(plane[1]);
+      const __m512 c = _mm512_set1_ps(plane[2]);
+      __m512 bound;
+      if (radius != nullptr) {
+        bound = _mm512_maskz_loadu_ps(mask, radius + i);
+      } else {
+        bound = _mm512_mul_ps(_mm512_abs_ps(a),
+                              _mm512_maskz_loadu_ps(mask, extent[0] + i));
+        bound = _mm512_fmadd_ps(_mm512_abs_ps(b),
+                                _mm512_maskz_loadu_ps(mask, extent[1] + i),
+                                bound);
+        bound = _mm512_fmadd_ps(_mm512_abs_ps(c),
+                                _mm512_maskz_loadu_ps(mask, extent[2] + i),
+                                bound);
+      }
+      __m512 distance = _mm512_fmadd_ps(a, x, _mm512_set1_ps(plane[3]));
+      distance = _mm512_fmadd_ps(b, y, distance);
+      distance = _mm512_fmadd_ps(c, z, distance);
+      visible = _mm512_mask_cmp_ps_mask(visible,
+                                        _mm512_add_ps(distance, bound),
+                                        _mm512_setzero_ps(), _CMP_GE_OQ);
+    }
+    visibility[i >> 5] |= static_cast<uint32_t>(visible) << (i & 31);
+  }
+  return end;
+}
+#endif  // WVU_HAS_AVX512
+
+#if defined(WVU_HAS_NEON)
+int TransformNeon(const float* matrix,
+                  const float* const input[4],
+                  float* const output[4],
+                  const int begin,
+                  const int end) {
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const float32x4_t x = vld1q_f32(input[0] + i);
+    const float32x4_t y = vld1q_f32(input[1] + i);
+    const float32x4_t z = vld1q_f32(input[2] + i);
+    const float32x4_t w = vld1q_f32(input[3] + i);
+    for (int row = 0; row < 4; ++row) {
+      float32x4_t value = vmulq_n_f32(x, matrix[row]);
+      value = vmlaq_n_f32(value, y, matrix[4 + row]);
+      value = vmlaq_n_f32(value, z, matrix[8 + row]);
+      value = vmlaq_n_f32(value, w, matrix[12 + row]);
+      vst1q_f32(output[row] + i, value);
+    }
+  }
+  return i;
+}
+
+int DotNeon(const float* const x[3],
+            const float* const y[3],
+            float* result,
+            const int begin,
+            const int end) {
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    float32x4_t value = vmulq_f32(vld1q_f32(x[0] + i), vld1q_f32(y[0] + i));
+    value = vmlaq_f32(value, vld1q_f32(x[1] + i), vld1q_f32(y[1] + i));
+    value = vmlaq_f32(value, vld1q_f32(x[2] + i), vld1q_f32(y[2] + i));
+    vst1q_f32(result + i, value);
+  }
+  return i;
+}
+
+int CrossNeon(const float* const x[3],
+              const float* const y[3],
+              float* const result[3],
+              const int begin,
+              const int end) {
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const float32x4_t x0 = vld1q_f32(x[0] + i);
+    const float32x4_t x1 = vld1q_f32(x[1] + i);
+    const float32x4_t x2 = vld1q_f32(x[2] + i);
+    const float32x4_t y0 = vld1q_f32(y[0] + i);
+    const float32x4_t y1 = vld1q_f32(y[1] + i);
+    const float32x4_t y2 = vld1q_f32(y[2] + i);
+    vst1q_f32(result[0] + i, vmlsq_f32(vmulq_f32(x1, y2), x2, y1));
+    vst1q_f32(result[1] + i, vmlsq_f32(vmulq_f32(x2, y0), x0, y2));
+    vst1q_f32(result[2] + i, vmlsq_f32(vmulq_f32(x0, y1), x1, y0));
+  }
+  return i;
+}
+
+int CullNeon(const float* planes,
+             const float* const center[3],
+             const float* const extent[3],
+             const float* radius,
+             uint32_t* visibility,
+             const int begin,
+             const int end) {
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const float32x4_t x = vld1q_f32(center[0] + i);
+    const float32x4_t y = vld1q_f32(center[1] + i);
+    const float32x4_t z = vld1q_f32(center[2] + i);
+    uint32x4_t visible = vdupq_n_u32(0xffffffff);
+    for (int p = 0; p < 6; ++p) {
+      const float* plane = planes + 4 * p;
+      float32x4_t bound;
+      if (radius != nullptr) {
+        bound = vld1q_f32(radius + i);
+      } else {
+        bound = vmulq_n_f32(vld1q_f32(extent[0] + i), fabsf(plane[0]));
+        bound = vmlaq_n_f32(bound, vld1q_f32(extent[1] + i), fabsf(plane[1]));
+        bound = vmlaq_n_f32(bound, vld1q_f32(extent[2] + i), fabsf(plane[2]));
+      }
+      float32x4_t distance = vmlaq_n_f32(vdupq_n_f32(plane[3]), x, plane[0]);
+      distance = vmlaq_n_f32(distance, y, plane[1]);
+      distance = vmlaq_n_f32(distance, z, plane[2]);
+      visible = vandq_u32(visible, vcgeq_f32(vaddq_f32(distance, bound),
+                                             vdupq_n_f32(0.0f)));
+    }
+    const uint32_t bits = (vgetq_lane_u32(visible, 0) & 1) |
+        (vgetq_lane_u32(visible, 1) & 2) | (vgetq_lane_u32(visible, 2) & 4) |
+        (vgetq_lane_u32(visible, 3) & 8);
+    visibility[i >> 5] |= bits << (i & 31);
+  }
+  return i;
+}
+
+int IntersectNeon(const float* ray,
+                  const float* const vertex[3],
+                  const float* const first_edge[3],
+                  const float* const second_edge[3],
+                  float* distance,
+                  int* triangle,
+                  const int begin,
+                  const int end) {
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const float32x4_t e1x = vld1q_f32(first_edge[0] + i);
+    const float32x4_t e1y = vld1q_f32(first_edge[1] + i);
+    const float32x4_t e1z = vld1q_f32(first_edge[2] + i);
+    const float32x4_t e2x = vld1q_f32(second_edge[0] + i);
+    const float32x4_t e2y = vld1q_f32(second_edge[1] + i);
+    const float32x4_t e2z = vld1q_f32(second_edge[2] + i);
+    // p = direction x second edge.
+    const float32x4_t px =
+        vmlsq_n_f32(vmulq_n_f32(e2z, ray[4]), e2y, ray[5]);
+    const float32x4_t py =
+        vmlsq_n_f32(vmulq_n_f32(e2x, ray[5]), e2z, ray[3]);
+    const float32x4_t pz =
+        vmlsq_n_f32(vmulq_n_f32(e2y, ray[3]), e2x, ray[4]);
+    const float32x4_t determinant =
+        vmlaq_f32(vmlaq_f32(vmulq_f32(e1x, px), e1y, py), e1z, pz);
+    // ARMv7 has no vector division, so the reciprocal estimate is refined
+    // with two Newton-Raphson steps.
+    float32x4_t inverse_determinant = vrecpeq_f32(determinant);
+    inverse_determinant = vmulq_f32(
+        vrecpsq_f32(determinant, inverse_determinant), inverse_determinant);
+    inverse_determinant = vmulq_f32(
+        vrecpsq_f32(determinant, inverse_determinant), inverse_determinant);
+    // s = origin - vertex, and q = s x first edge.
+    const float32x4_t sx = vsubq_f32(vdupq_n_f32(ray[0]),
+                                     vld1q_f32(vertex[0] + i));
+    const float32x4_t sy = vsubq_f32(vdupq_n_f32(ray[1]),
+                                     vld1q_f32(vertex[1] + i));
+    const float32x4_t sz = vsubq_f32(vdupq_n_f32(ray[2]),
+                                     vld1q_f32(vertex[2] + i));
+    const float32x4_t u = vmulq_f32(
+        vmlaq_f32(vmlaq_f32(vmulq_f32(sx, px), sy, py), sz, pz),
+        inverse_determinant);
+    const float32x4_t qx = vmlsq_f32(vmulq_f32(sy, e1z), sz, e1y);
+    const float32x4_t qy = vmlsq_f32(vmulq_f32(sz, e1x), sx, e1z);
+    const float32x4_t qz = vmlsq_f32(vmulq_f32(sx, e1y), sy, e1x);
+    const float32x4_t v = vmulq_f32(
+        vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(qx, ray[3]), qy, ray[4]), qz,
+                    ray[5]),
+        inverse_determinant);
+    const float32x4_t t = vmulq_f32(
+        vmlaq_f32(vmlaq_f32(vmulq_f32(e2x, qx), e2y, qy), e2z, qz),
+        inverse_determinant);
+    uint32x4_t hit = vcgtq_f32(vabsq_f32(determinant),
+                               vdupq_n_f32(kParallelDeterminant));
+    hit = vandq_u32(hit, vcgeq_f32(u, zero));
+    hit = vandq_u32(hit, vcgeq_f32(v, zero));
+    hit = vandq_u32(hit, vcleq_f32(vaddq_f32(u, v), one));
+    hit = vandq_u32(hit, vcgeq_f32(t, zero));
+    hit = vandq_u32(hit, vcltq_f32(t, vdupq_n_f32(*distance)));
+    const uint32_t hits = (vgetq_lane_u32(hit, 0) & 1) |
+        (vgetq_lane_u32(hit, 1) & 2) | (vgetq_lane_u32(hit, 2) & 4) |
+        (vgetq_lane_u32(hit, 3) & 8);
+    if (hits == 0) continue;
+    float distances[4];
+    vst1q_f32(distances, t);
+    KeepNearestHit(distances, hits, i, distance, triangle);
+  }
+  return i;
+}
+#endif  // WVU_HAS_NEON
+
+// Approximates atan2(y, x) for y >= 0. The arc tangent of the ratio of the
+// smaller to the larger coordinate is a polynomial in [0, 1], and the octant
+// is restored by reflections. The function has no branches, so the loops
+// calling it are vectorized by the compiler.
+inline float FastAtan2OfNonNegative(const float y, const float x) {
+  constexpr float kPi = 3.14159265358979f;
+  constexpr float kHalfPi = 1.57079632679490f;
+  const float absolute_x = fabsf(x);
+  const float larger = absolute_x > y ? absolute_x : y;
+  const float smaller = absolute_x > y ? y : absolute_x;
+  // The angle is 0 when both coordinates are 0, as with std::atan2.
+  const float ratio = larger > 0.0f ? smaller / larger : 0.0f;
+  const float squared_ratio = ratio * ratio;
+  float angle = ratio * (0.99997726f + squared_ratio * (-0.33262347f +
+      squared_ratio * (0.19354346f + squared_ratio * (-0.11643287f +
+      squared_ratio * (0.05265332f + squared_ratio * -0.01172120f)))));
+  angle = y > absolute_x ? kHalfPi - angle : angle;
+  return x < 0.0f ? kPi - angle : angle;
+}
+
+// The batched kernels of an instruction set. They return the index of the
+// first vector they did not process, and the scalar kernels process the rest.
+struct BatchedKernels {
+  int (*transform)(const float* matrix,
+                   const float* const input[4],
+                   float* const output[4],
+                   const int begin,
+                   const int end);
+  int (*dot)(const float* const x[3],
+             const float* const y[3],
+             float* result,
+             const int begin,
+             const int end);
+  int (*cross)(const float* const x[3],
+               const float* const y[3],
+               float* const result[3],
+               const int begin,
+               const int end);
+  int (*cull)(const float* planes,
+              const float* const center[3],
+              const float* const extent[3],
+              const float* radius,
+              uint32_t* visibility,
+              const int begin,
+              const int end);
+  int (*intersect)(const float* ray,
+                   const float* const vertex[3],
+                   const float* const first_edge[3],
+                   const float* const second_edge[3],
+                   float* distance,
+                   int* triangle,
+                   const int begin,
+                   const int end);
+};
+
+// The dispatch table of the kernels, indexed by instruction set. The
+// instruction sets the build does not target use the scalar kernels.
+class BatchedKernelTable {
+ public:
+  BatchedKernelTable() {
+    for (BatchedKernels& kernels : kernels_) {
+      kernels = {TransformScalar, DotScalar, CrossScalar, CullScalar,
+                 IntersectScalar};
+    }
+#if defined(WVU_HAS_SSE)
+    kernels_[SSE] = {TransformSse, DotSse, CrossSse, CullSse, IntersectSse};
+#endif
+#if defined(WVU_HAS_AVX2)
+    kernels_[AVX2] = {TransformAvx2, DotAvx2, CrossAvx2, CullAvx2,
+                      IntersectAvx2};
+#endif
+#if defined(WVU_HAS_AVX512)
+    kernels_[AVX512] = {TransformAvx512, DotAvx512, CrossAvx512,
+                         CullAvx512, IntersectAvx2};
+#endif
+#if defined(WVU_HAS_NEON)
+    kernels_[NEON] = {TransformNeon, DotNeon, CrossNeon, CullNeon,
+                      IntersectNeon};
+#endif
+  }
+
+  const BatchedKernels& operator[](const SimdInstructionSet instruction_set)
+      const {
+    return kernels_[instruction_set];
+  }
+
+ private:
+  BatchedKernels kernels_[NUM_SIMD_INSTRUCTION_SETS];
+};
+
+// Returns true if the CPU supports the instruction set, regardless of the
+// build.
+bool CpuSupports(const SimdInstructionSet instruction_set) {
+  switch (instruction_set) {
+    case SCALAR:
+      return true;
+#if defined(WVU_HAS_SSE)
+    case SSE:
+      return true;
+#endif
+#if defined(WVU_HAS_AVX2)
+    case AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#if defined(WVU_HAS_AVX512)
+    case AVX512:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx512f");
+#endif
+#if defined(WVU_HAS_NEON)
+    case NEON:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+SimdInstructionSet DetectSimdInstructionSet() {
+  // From the widest registers to the narrowest.
+  const SimdInstructionSet preferred_sets[] = {AVX512, AVX2, SSE, NEON};
+  for (const SimdInstructionSet instruction_set : preferred_sets) {
+    if (CpuSupports(instruction_set)) return instruction_set;
+  }
+  return SCALAR;
+}
+
+// The instruction set in use, or NUM_SIMD_INSTRUCTION_SETS until a kernel
+// runs or an instruction set is selected.
+std::atomic<int> active_instruction_set(NUM_SIMD_INSTRUCTION_SETS);
+
+// Returns the kernels of the instruction set in use.
+const BatchedKernels& ActiveKernels() {
+  static const BatchedKernelTable kernel_table;
+  return kernel_table[ActiveSimdInstructionSet()];
+}
+
+// Culls the spheres or the boxes of CullSpheres() and CullBoxes().
+void CullBounds(const Eigen::Matrix<float, 6, 4>& planes,
+                const float* const center[3],
+                const float* const extent[3],
+                const float* radius,
+                const int size,
+                std::vector<uint32_t>* visibility) {
+  // The kernels read the planes row by row.
+  float coefficients[24];
+  for (int p = 0; p < 6; ++p) {
+    for (int k = 0; k < 4; ++k) coefficients[4 * p + k] = planes(p, k);
+  }
+  visibility->assign((size + 31) / 32, 0);
+  const int i = ActiveKernels().cull(coefficients, center, extent, radius,
+                                     visibility->data(), 0, size);
+  CullScalar(coefficients, center, extent, radius, visibility->data(), i,
+             size);
+}
+
+}  // namespace
+
+const char* SimdInstructionSetName(const SimdInstructionSet instruction_set) {
+  switch (instruction_set) {
+    case SSE:
+      return "SSE";
+    case AVX2:
+      return "AVX2";
+    case NEON:
+      return "NEON";
+    case AVX512:
+      return "AVX-512";
+    default:
+      return "scalar";
+  }
+}
+
+bool SimdInstructionSetSupported(const SimdInstructionSet instruction_set) {
+  return instruction_set >= SCALAR &&
+      instruction_set < NUM_SIMD_INSTRUCTION_SETS &&
+      CpuSupports(instruction_set);
+}
+
+SimdInstructionSet ActiveSimdInstructionSet() {
+  int instruction_set =
+      active_instruction_set.load(std::memory_order_relaxed);
+  if (instruction_set == NUM_SIMD_INSTRUCTION_SETS) {
+    // Concurrent first calls detect the same instruction set.
+    instruction_set = DetectSimdInstructionSet();
+    active_instruction_set.store(instruction_set, std::memory_order_relaxed);
+  }
+  return static_cast<SimdInstructionSet>(instruction_set);
+}
+
+bool SetSimdInstructionSet(const SimdInstructionSet instruction_set) {
+  if (!SimdInstructionSetSupported(instruction_set)) return false;
+  active_instruction_set.store(instruction_set, std::memory_order_relaxed);
+  return true;
+}
+
+void MultiplyVectorArrayAndMatrix(const Eigen::Matrix4f& x,
+                                  const Vector4fArray& y,
+                                  Vector4fArray* result) {
+  const int size = y.size();
+  result->resize(size);
+  const float* const input[4] = {y.x.data(), y.y.data(), y.z.data(),
+                                 y.w.data()};
+  float* const output[4] = {result->x.data(), result->y.data(),
+                            result->z.data(), result->w.data()};
+  const int i = ActiveKernels().transform(x.data(), input, output, 0, size);
+  TransformScalar(x.data(), input, output, i, size);
+}
+
+void Multiply4x4MatrixArray(const Eigen::Matrix4f& x,
+                            const Eigen::Matrix4f* y,
+                            const int num_matrices,
+                            Eigen::Matrix4f* result) {
+#if defined(WVU_HAS_SSE)
+  // A 4x4 product fits in four SSE registers; AVX2 does not help it.
+  for (int i = 0; i < num_matrices; ++i) {
+    MultiplyMatrixSse(x.data(), y[i].data(), result[i].data());
+  }
+#else
+  for (int i = 0; i < num_matrices; ++i) {
+    result[i] = x * y[i];
+  }
+#endif
+}
+
+void ComputeDotProducts(const Vector3fArray& x,
+                        const Vector3fArray& y,
+                        std::vector<float>* result) {
+  const int size = x.size();
+  result->resize(size);
+  const float* const lhs[3] = {x.x.data(), x.y.data(), x.z.data()};
+  const float* const rhs[3] = {y.x.data(), y.y.data(), y.z.data()};
+  const int i = ActiveKernels().dot(lhs, rhs, result->data(), 0, size);
+  DotScalar(lhs, rhs, result->data(), i, size);
+}
+
+void ComputeCrossProducts(const Vector3fArray& x,
+                          const Vector3fArray& y,
+                          Vector3fArray* result) {
+  const int size = x.size();
+  result->resize(size);
+  const float* const lhs[3] = {x.x.data(), x.y.data(), x.z.data()};
+  const float* const rhs[3] = {y.x.data(), y.y.data(), y.z.data()};
+  float* const output[3] = {result->x.data(), result->y.data(),
+                            result->z.data()};
+  const int i = ActiveKernels().cross(lhs, rhs, output, 0, size);
+  CrossScalar(lhs, rhs, output, i, size);
+}
+
+void CalculateAnglesBetweenVectors(const Vector3fArray& x,
+                                   const Vector3fArray& y,
+                                   const AngleApproximation approximation,
+                                   std::vector<float>* result) {
+  // The cross and dot products go through the batched kernels; the angles are
+  // computed from them in a second pass.
+  Vector3fArray cross_products;
+  ComputeCrossProducts(x, y, &cross_products);
+  ComputeDotProducts(x, y, result);
+  const int size = x.size();
+  float* angles = result->data();
+  const float* cross_x = cross_products.x.data();
+  const float* cross_y = cross_products.y.data();
+  const float* cross_z = cross_products.z.data();
+  if (approximation == FAST_ANGLE) {
+    for (int i = 0; i < size; ++i) {
+      const float sine = sqrtf(cross_x[i] * cross_x[i] +
+                               cross_y[i] * cross_y[i] +
+                               cross_z[i] * cross_z[i]);
+      angles[i] = FastAtan2OfNonNegative(sine, angles[i]);
+    }
+  } else {
+    for (int i = 0; i < size; ++i) {
+      const float sine = sqrtf(cross_x[i] * cross_x[i] +
+                               cross_y[i] * cross_y[i] +
+                               cross_z[i] * cross_z[i]);
+      angles[i] = atan2f(sine, angles[i]);
+    }
+  }
+}
+
+void CullSpheres(const Eigen::Matrix<float, 6, 4>& planes,
+                 const Vector3fArray& centers,
+                 const std::vector<float>& radii,
+                 std::vector<uint32_t>* visibility) {
+  const float* const center[3] = {centers.x.data(), centers.y.data(),
+                                  centers.z.data()};
+  CullBounds(planes, center, nullptr, radii.data(), centers.size(),
+             visibility);
+}
+
+void CullBoxes(const Eigen::Matrix<float, 6, 4>& planes,
+               const Vector3fArray& centers,
+               const Vector3fArray& half_extents,
+               std::vector<uint32_t>* visibility) {
+  const float* const center[3] = {centers.x.data(), centers.y.data(),
+                                  centers.z.data()};
+  const float* const extent[3] = {half_extents.x.data(),
+                                  half_extents.y.data(),
+                                  half_extents.z.data()};
+  CullBounds(planes, center, extent, nullptr, centers.size(), visibility);
+}
+
+int IntersectRayWithTriangles(const Eigen::Vector3f& origin,
+                              const Eigen::Vector3f& direction,
+                              const TriangleArray& triangles,
+                              const int begin,
+                              const int end,
+                              float* distance) {
+  const float ray[6] = {origin.x(), origin.y(), origin.z(),
+                        direction.x(), direction.y(), direction.z()};
+  const float* const vertex[3] = {triangles.vertices.x.data(),
+                                  triangles.vertices.y.data(),
+                                  triangles.vertices.z.data()};
+  const float* const first_edge[3] = {triangles.first_edges.x.data(),
+                                      triangles.first_edges.y.data(),
+                                      triangles.first_edges.z.data()};
+  const float* const second_edge[3] = {triangles.second_edges.x.data(),
+                                       triangles.second_edges.y.data(),
+                                       triangles.second_edges.z.data()};
+  int triangle = -1;
+  const int i = ActiveKernels().intersect(ray, vertex, first_edge,
+                                          second_edge, distance, &triangle,
+                                          begin, end);
+  IntersectScalar(ray, vertex, first_edge, second_edge, distance, &triangle,
+                  i, end);
+  return triangle;
+}
+
 }  // namespace
@@ -32,6 +32,8 @@
 #ifndef ASSIGNMENT_2_H_
 #define ASSIGNMENT_2_H_
 
+#include <cstdint>
+#include <vector>
 #include <Eigen/Core>
 
 // Assignment 2. Implement the functions declared below in assignment.cc. The
@@ -74,7 +76,10 @@ Eigen::Vector4f MultiplyVectorAndMatrix(const Eigen::Matrix4f& x,
 // Calculates the dot product of two vectors.
 float ComputeDotProduct(const Eigen::Vector3f& x, const Eigen::Vector3f& y);
 
-// Calculates the angle between two vectors in radians.
+// Calculates the angle between two vectors in radians, as
+// atan2(|x × y|, x · y). Unlike the arc cosine of the normalized dot product,
+// this is accurate for nearly parallel and nearly opposite vectors, and does
+// not need to normalize the vectors.
 float CalculateAngleBetweenTwoVectors(const Eigen::Vector3f& x,
                                       const Eigen::Vector3f& y);
 
@@ -82,6 +87,182 @@ float CalculateAngleBetweenTwoVectors(const Eigen::Vector3f& x,
 Eigen::Vector3f ComputeCrossProduct(const Eigen::Vector3f& x,
                                     const Eigen::Vector3f& y);
 
+// Batched kernels. The vectors are stored as a structure of arrays (SoA): the
+// i-th vector is (x[i], y[i], z[i], w[i]), so that the lanes of a SIMD register
+// hold the same component of consecutive vectors. The kernels of every
+// instruction set the build targets are compiled into the same binary, and a
+// dispatch table selects those of the best instruction set the CPU supports
+// the first time a kernel runs: AVX-512, AVX2 and FMA, SSE, or NEON.
+
+// An array of 3d vectors as a structure of arrays.
+struct Vector3fArray {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+
+  void resize(const int size) {
+    x.resize(size);
+    y.resize(size);
+    z.resize(size);
+  }
+
+  int size() const {
+    return x.size();
+  }
+};
+
+// An array of 4d vectors as a structure of arrays.
+struct Vector4fArray {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> w;
+
+  void resize(const int size) {
+    x.resize(size);
+    y.resize(size);
+    z.resize(size);
+    w.resize(size);
+  }
+
+  int size() const {
+    return x.size();
+  }
+};
+
+// An array of triangles as a structure of arrays. The i-th triangle has the
+// corners vertices[i], vertices[i] + first_edges[i] and
+// vertices[i] + second_edges[i].
+struct TriangleArray {
+  Vector3fArray vertices;
+  Vector3fArray first_edges;
+  Vector3fArray second_edges;
+
+  void resize(const int size) {
+    vertices.resize(size);
+    first_edges.resize(size);
+    second_edges.resize(size);
+  }
+
+  int size() const {
+    return vertices.size();
+  }
+};
+
+// Instruction sets of the batched kernels.
+enum SimdInstructionSet {
+  SCALAR = 0,
+  SSE,
+  AVX2,
+  NEON,
+  AVX512,
+  NUM_SIMD_INSTRUCTION_SETS
+};
+
+// Returns the name of an instruction set, e.g., "AVX2".
+const char* SimdInstructionSetName(const SimdInstructionSet instruction_set);
+
+// Returns true if the binary has the kernels of the instruction set and the
+// CPU supports it.
+bool SimdInstructionSetSupported(const SimdInstructionSet instruction_set);
+
+// Returns the instruction set the batched kernels use on this CPU.
+SimdInstructionSet ActiveSimdInstructionSet();
+
+// Selects the kernels of a supported instruction set instead of the best one,
+// e.g., to compare them, or to avoid the lower clock that AVX-512 causes on
+// some CPUs. Thread safe, but the kernels running keep their instruction set.
+// Returns false if the instruction set is not supported.
+bool SetSimdInstructionSet(const SimdInstructionSet instruction_set);
+
+// Multiplies the matrix x with every vector of y. The result is resized to the
+// size of y.
+void MultiplyVectorArrayAndMatrix(const Eigen::Matrix4f& x,
+                                  const Vector4fArray& y,
+                                  Vector4fArray* result);
+
+// Multiplies the matrix x with num_matrices matrices y[i], e.g., a view matrix
+// with the model matrices of a scene. result may alias y.
+void Multiply4x4MatrixArray(const Eigen::Matrix4f& x,
+                            const Eigen::Matrix4f* y,
+                            const int num_matrices,
+                            Eigen::Matrix4f* result);
+
+// Calculates the dot products of the pairs of vectors x[i] and y[i]. The arrays
+// must have the same size.
+void ComputeDotProducts(const Vector3fArray& x,
+                        const Vector3fArray& y,
+                        std::vector<float>* result);
+
+// Calculates the cross products of the pairs of vectors x[i] and y[i], e.g.,
+// the face normals of a mesh. The arrays must have the same size.
+void ComputeCrossProducts(const Vector3fArray& x,
+                          const Vector3fArray& y,
+                          Vector3fArray* result);
+
+// Accuracy of the batched angles.
+enum AngleApproximation {
+  // std::atan2, accurate to the float precision.
+  EXACT_ANGLE = 0,
+  // A polynomial approximation of atan2, with an absolute error below 1e-5
+  // radians.
+  FAST_ANGLE
+};
+
+// Calculates the angles in radians between the pairs of vectors x[i] and y[i],
+// e.g., the angles of the corners of the faces when smoothing normals. The
+// arrays must have the same size.
+void CalculateAnglesBetweenVectors(const Vector3fArray& x,
+                                   const Vector3fArray& y,
+                                   const AngleApproximation approximation,
+                                   std::vector<float>* result);
+
+// Tests bounding spheres against the planes of a frustum, e.g., of
+// ExtractFrustumPlanes() in transforms.h, whose normals must be unit length.
+// The result is a bit mask resized to (centers.size() + 31) / 32 words, where
+// the bit i % 32 of visibility[i / 32] is set if the sphere i intersects the
+// frustum (see RenderQueue::AddVisible()). The test is conservative: a few
+// spheres outside the frustum near its edges pass it.
+// Parameters:
+//   planes  The planes of the frustum, as (a, b, c, d) per row, with the
+//     inside where a x + b y + c z + d >= 0.
+//   centers  The centers of the spheres.
+//   radii  The radii of the spheres, one per center.
+//   visibility  The bit mask of the visible spheres.
+void CullSpheres(const Eigen::Matrix<float, 6, 4>& planes,
+                 const Vector3fArray& centers,
+                 const std::vector<float>& radii,
+                 std::vector<uint32_t>* visibility);
+
+// Tests axis-aligned boxes, given by their centers and half extents, against
+// the planes of a frustum as CullSpheres() does. The planes need not be
+// normalized.
+void CullBoxes(const Eigen::Matrix<float, 6, 4>& planes,
+               const Vector3fArray& centers,
+               const Vector3fArray& half_extents,
+               std::vector<uint32_t>* visibility);
+
+// Intersects a ray with the triangles [begin, end) with the Möller-Trumbore
+// algorithm, i.e., the cross and dot products of ComputeCrossProduct() and
+// ComputeDotProduct() computed for 4 or 8 triangles at a time, e.g., the
+// triangles of a leaf of a BoundingVolumeHierarchy. Both faces of the
+// triangles are hit, but the rays parallel to a triangle miss it. Returns the
+// index of the nearest triangle hit nearer than distance, or -1 if none is.
+// Parameters:
+//   origin  The origin of the ray.
+//   direction  The direction of the ray. The distances are in units of its
+//     length.
+//   triangles  The triangles.
+//   begin, end  The range of the triangles tested.
+//   distance  The maximum distance of a hit. Updated to the distance of the
+//     triangle hit.
+int IntersectRayWithTriangles(const Eigen::Vector3f& origin,
+                              const Eigen::Vector3f& direction,
+                              const TriangleArray& triangles,
+                              const int begin,
+                              const int end,
+                              float* distance);
+
 }  // namespace
 
 #endif  // ASSIGNMENT_2_H_
@@ -0,0 +1,406 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "async_file_reader.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define GLUTILS_HAS_IO_URING
+#endif
+#endif  // __linux__
+
+namespace wvu {
+namespace {
+// Threads of the fallback, which mostly wait for the disk.
+constexpr int kMaxReadThreads = 4;
+
+}  // namespace
+
+AsyncFileReader::AsyncFileReader()
+    : backend_(THREAD_POOL_BACKEND),
+      queue_depth_(0),
+      num_pending_(0),
+      num_in_flight_(0),
+      ring_fd_(-1),
+      submission_ring_(nullptr),
+      submission_ring_size_(0),
+      completion_ring_(nullptr),
+      completion_ring_size_(0),
+      submission_entries_(nullptr),
+      submission_entries_size_(0),
+      submission_head_(nullptr),
+      submission_tail_(nullptr),
+      submission_mask_(nullptr),
+      submission_array_(nullptr),
+      completion_head_(nullptr),
+      completion_tail_(nullptr),
+      completion_mask_(nullptr),
+      completions_(nullptr),
+      stop_(false) {}
+
+AsyncFileReader::~AsyncFileReader() {
+  Reset();
+}
+
+bool AsyncFileReader::Initialize(const int queue_depth,
+                                 std::string* error_info_log,
+                                 const bool force_thread_pool) {
+  Reset();
+  if (queue_depth <= 0) {
+    *error_info_log = "The queue depth must be positive.";
+    return false;
+  }
+  queue_depth_ = queue_depth;
+  if (!force_thread_pool && InitializeIoUring(queue_depth)) {
+    backend_ = IO_URING_BACKEND;
+    return true;
+  }
+  backend_ = THREAD_POOL_BACKEND;
+  stop_ = false;
+  const int num_threads = std::min(queue_depth, kMaxReadThreads);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&AsyncFileReader::ReadRequests, this);
+  }
+  return true;
+}
+
+void AsyncFileReader::Read(const int fd,
+                           const uint64_t offset,
+                           const size_t size,
+                           void* buffer,
+                           const uint64_t user_data) {
+  Request request;
+  request.fd = fd;
+  request.offset = offset;
+  request.size = size;
+  request.buffer = buffer;
+  request.user_data = user_data;
+  queued_requests_.push_back(request);
+  ++num_pending_;
+  statistics_.max_queue_depth =
+      std::max(statistics_.max_queue_depth, num_pending_);
+}
+
+int AsyncFileReader::Submit() {
+  if (queued_requests_.empty()) return 0;
+  if (statistics_.num_reads == 0 && num_in_flight_ == 0) {
+    first_submit_time_ = std::chrono::steady_clock::now();
+  }
+  if (backend_ == IO_URING_BACKEND) return SubmitIoUring(false);
+  const int num_submitted = queued_requests_.size();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_requests_.insert(thread_requests_.end(), queued_requests_.begin(),
+                            queued_requests_.end());
+  }
+  queued_requests_.clear();
+  num_in_flight_ += num_submitted;
+  request_queued_.notify_all();
+  return num_submitted;
+}
+
+int AsyncFileReader::Poll(AsyncReadCompletion* completions,
+                          const int max_completions,
+                          const bool wait) {
+  int num_completions = 0;
+  if (backend_ == IO_URING_BACKEND) {
+    num_completions = ReapIoUring(completions, max_completions);
+    while (num_completions == 0 && wait && num_in_flight_ > 0) {
+      SubmitIoUring(true);
+      num_completions = ReapIoUring(completions, max_completions);
+    }
+    // The completions freed slots for the queued reads.
+    if (!queued_requests_.empty()) SubmitIoUring(false);
+  } else {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (wait && num_in_flight_ > 0) {
+      request_completed_.wait(
+          lock, [this]() { return !thread_completions_.empty(); });
+    }
+    num_completions =
+        std::min<int>(max_completions, thread_completions_.size());
+    std::copy(thread_completions_.begin(),
+              thread_completions_.begin() + num_completions, completions);
+    thread_completions_.erase(thread_completions_.begin(),
+                              thread_completions_.begin() + num_completions);
+    num_in_flight_ -= num_completions;
+  }
+  num_pending_ -= num_completions;
+  for (int i = 0; i < num_completions; ++i) {
+    ++statistics_.num_reads;
+    if (completions[i].result > 0) {
+      statistics_.num_bytes += completions[i].result;
+    }
+  }
+  if (num_completions > 0) {
+    last_completion_time_ = std::chrono::steady_clock::now();
+  }
+  return num_completions;
+}
+
+void AsyncFileReader::Reset() {
+  // Waits for the reads in flight, whose buffers the kernel or the threads
+  // may still write.
+  std::vector<AsyncReadCompletion> completions(std::max(queue_depth_, 1));
+  queued_requests_.clear();
+  while (num_in_flight_ > 0) {
+    Poll(completions.data(), completions.size(), true);
+  }
+  if (!threads_.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    request_queued_.notify_all();
+    for (std::thread& thread : threads_) thread.join();
+    threads_.clear();
+  }
+#ifdef GLUTILS_HAS_IO_URING
+  if (submission_entries_ != nullptr) {
+    munmap(submission_entries_, submission_entries_size_);
+  }
+  if (completion_ring_ != nullptr && completion_ring_ != submission_ring_) {
+    munmap(completion_ring_, completion_ring_size_);
+  }
+  if (submission_ring_ != nullptr) {
+    munmap(submission_ring_, submission_ring_size_);
+  }
+#endif  // GLUTILS_HAS_IO_URING
+  submission_entries_ = nullptr;
+  completion_ring_ = nullptr;
+  submission_ring_ = nullptr;
+  if (ring_fd_ >= 0) close(ring_fd_);
+  ring_fd_ = -1;
+  thread_completions_.clear();
+  slot_requests_.clear();
+  vectors_.clear();
+  free_slots_.clear();
+  num_pending_ = 0;
+  num_in_flight_ = 0;
+  statistics_ = AsyncReadStatistics();
+}
+
+AsyncReadStatistics AsyncFileReader::statistics() const {
+  AsyncReadStatistics statistics = statistics_;
+  statistics.queue_depth = num_pending_;
+  const double seconds = std::chrono::duration<double>(
+      last_completion_time_ - first_submit_time_).count();
+  if (statistics.num_reads > 0 && seconds > 0.0) {
+    statistics.bytes_per_second = statistics.num_bytes / seconds;
+  }
+  return statistics;
+}
+
+bool AsyncFileReader::InitializeIoUring(const int queue_depth) {
+#ifdef GLUTILS_HAS_IO_URING
+  io_uring_params parameters;
+  std::memset(&parameters, 0, sizeof(parameters));
+  ring_fd_ = syscall(__NR_io_uring_setup, queue_depth, &parameters);
+  if (ring_fd_ < 0) return false;
+  submission_ring_size_ =
+      parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned);
+  completion_ring_size_ =
+      parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe);
+  // Newer kernels map both rings at once.
+  const bool single_mapping = parameters.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mapping) {
+    submission_ring_size_ =
+        std::max(submission_ring_size_, completion_ring_size_);
+    completion_ring_size_ = submission_ring_size_;
+  }
+  submission_ring_ = mmap(nullptr, submission_ring_size_,
+                          PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring_fd_, IORING_OFF_SQ_RING);
+  if (submission_ring_ == MAP_FAILED) submission_ring_ = nullptr;
+  completion_ring_ = single_mapping ? submission_ring_ :
+      mmap(nullptr, completion_ring_size_, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+  if (completion_ring_ == MAP_FAILED) completion_ring_ = nullptr;
+  submission_entries_size_ = parameters.sq_entries * sizeof(io_uring_sqe);
+  submission_entries_ = mmap(nullptr, submission_entries_size_,
+                             PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring_fd_,
+                             IORING_OFF_SQES);
+  if (submission_entries_ == MAP_FAILED) submission_entries_ = nullptr;
+  if (submission_ring_ == nullptr || completion_ring_ == nullptr ||
+      submission_entries_ == nullptr) {
+    Reset();
+    return false;
+  }
+  uint8_t* submission_ring = static_cast<uint8_t*>(submission_ring_);
+  submission_head_ =
+      reinterpret_cast<unsigned*>(submission_ring + parameters.sq_off.head);
+  submission_tail_ =
+      reinterpret_cast<unsigned*>(submission_ring + parameters.sq_off.tail);
+  submission_mask_ = reinterpret_cast<unsigned*>(
+      submission_ring + parameters.sq_off.ring_mask);
+  submission_array_ =
+      reinterpret_cast<unsigned*>(submission_ring + parameters.sq_off.array);
+  uint8_t* completion_ring = static_cast<uint8_t*>(completion_ring_);
+  completion_head_ =
+      reinterpret_cast<unsigned*>(completion_ring + parameters.cq_off.head);
+  completion_tail_ =
+      reinterpret_cast<unsigned*>(completion_ring + parameters.cq_off.tail);
+  completion_mask_ = reinterpret_cast<unsigned*>(
+      completion_ring + parameters.cq_off.ring_mask);
+  completions_ = completion_ring + parameters.cq_off.cqes;
+  // The completion ring is at least as large, so it never overflows.
+  queue_depth_ = std::min<int>(queue_depth, parameters.sq_entries);
+  slot_requests_.resize(queue_depth_);
+  vectors_.resize(queue_depth_);
+  free_slots_.resize(queue_depth_);
+  for (int i = 0; i < queue_depth_; ++i) free_slots_[i] = i;
+  return true;
+#else
+  return false;
+#endif  // GLUTILS_HAS_IO_URING
+}
+
+int AsyncFileReader::SubmitIoUring(const bool wait) {
+#ifdef GLUTILS_HAS_IO_URING
+  // Only this thread writes the tail, and the kernel reads it.
+  unsigned tail = *submission_tail_;
+  int num_submitted = 0;
+  while (!queued_requests_.empty() && !free_slots_.empty()) {
+    const int slot = free_slots_.back();
+    free_slots_.pop_back();
+    const Request& request = queued_requests_.front();
+    slot_requests_[slot] = request;
+    vectors_[slot].iov_base = request.buffer;
+    vectors_[slot].iov_len = request.size;
+    queued_requests_.pop_front();
+    const unsigned index = tail & *submission_mask_;
+    io_uring_sqe* entry =
+        static_cast<io_uring_sqe*>(submission_entries_) + index;
+    std::memset(entry, 0, sizeof(*entry));
+    entry->opcode = IORING_OP_READV;
+    entry->fd = slot_requests_[slot].fd;
+    entry->off = slot_requests_[slot].offset;
+    entry->addr = reinterpret_cast<uintptr_t>(&vectors_[slot]);
+    entry->len = 1;
+    entry->user_data = slot;
+    submission_array_[index] = index;
+    ++tail;
+    ++num_submitted;
+  }
+  __atomic_store_n(submission_tail_, tail, __ATOMIC_RELEASE);
+  num_in_flight_ += num_submitted;
+  if (num_submitted == 0 && !wait) return 0;
+  // One call submits the whole batch, with the entries a call interrupted
+  // before left in the ring, and waits for a completion if asked.
+  const unsigned num_unconsumed =
+      tail - __atomic_load_n(submission_head_, __ATOMIC_ACQUIRE);
+  syscall(__NR_io_uring_enter, ring_fd_, num_unconsumed, wait ? 1 : 0,
+          wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+  ++statistics_.num_submit_calls;
+  return num_submitted;
+#else
+  return 0;
+#endif  // GLUTILS_HAS_IO_URING
+}
+
+int AsyncFileReader::ReapIoUring(AsyncReadCompletion* completions,
+                                 const int max_completions) {
+#ifdef GLUTILS_HAS_IO_URING
+  unsigned head = *completion_head_;
+  const unsigned tail = __atomic_load_n(completion_tail_, __ATOMIC_ACQUIRE);
+  int num_completions = 0;
+  while (head != tail && num_completions < max_completions) {
+    const io_uring_cqe& entry = static_cast<const io_uring_cqe*>(
+        completions_)[head & *completion_mask_];
+    const int slot = entry.user_data;
+    completions[num_completions].user_data = slot_requests_[slot].user_data;
+    completions[num_completions].result = entry.res;
+    free_slots_.push_back(slot);
+    ++num_completions;
+    ++head;
+  }
+  __atomic_store_n(completion_head_, head, __ATOMIC_RELEASE);
+  num_in_flight_ -= num_completions;
+  return num_completions;
+#else
+  return 0;
+#endif  // GLUTILS_HAS_IO_URING
+}
+
+void AsyncFileReader::ReadRequests() {
+  while (true) {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      request_queued_.wait(
+          lock, [this]() { return stop_ || !thread_requests_.empty(); });
+      if (thread_requests_.empty()) return;
+      request = thread_requests_.front();
+      thread_requests_.pop_front();
+    }
+    // Reads until the end of the request or of the file.
+    int64_t result = 0;
+    uint8_t* buffer = static_cast<uint8_t*>(request.buffer);
+    while (result < static_cast<int64_t>(request.size)) {
+      const ssize_t num_read = pread(request.fd, buffer + result,
+                                     request.size - result,
+                                     request.offset + result);
+      if (num_read < 0 && errno == EINTR) continue;
+      if (num_read < 0) result = -errno;
+      if (num_read <= 0) break;
+      result += num_read;
+    }
+    AsyncReadCompletion completion;
+    completion.user_data = request.user_data;
+    completion.result = result;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      thread_completions_.push_back(completion);
+    }
+    request_completed_.notify_one();
+  }
+}
+
+}  // namespace wvu
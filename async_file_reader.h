@@ -0,0 +1,212 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_ASYNC_FILE_READER_H_
+#define GLUTILS_ASYNC_FILE_READER_H_
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wvu {
+// Default number of reads an AsyncFileReader keeps in flight.
+constexpr int kDefaultAsyncReadQueueDepth = 64;
+
+// How an AsyncFileReader reads.
+enum AsyncReadBackend {
+  // One io_uring: a batch of reads is one system call, and the kernel reads
+  // them in parallel without any thread of ours.
+  IO_URING_BACKEND = 0,
+  // Threads calling pread(), where io_uring is not available.
+  THREAD_POOL_BACKEND
+};
+
+// A finished read.
+struct AsyncReadCompletion {
+  uint64_t user_data = 0;
+  // The bytes read, or -errno.
+  int64_t result = 0;
+};
+
+// Counters of an AsyncFileReader.
+struct AsyncReadStatistics {
+  int64_t num_reads = 0;
+  int64_t num_bytes = 0;
+  // System calls that submitted or waited for reads, with io_uring.
+  int64_t num_submit_calls = 0;
+  // Reads queued or in flight now, and at most.
+  int queue_depth = 0;
+  int max_queue_depth = 0;
+  // Bytes per second from the first read submitted to the last one completed.
+  double bytes_per_second = 0.0;
+};
+
+// This class reads files asynchronously, e.g., the chunks of meshes, textures
+// and shaders of a scene, so that the loading thread keeps decompressing and
+// uploading while the disk works. Read() only queues a read; Submit() sends
+// the queued reads in one batch, up to the queue depth, and Poll() takes the
+// completions, in any order, identified by their user data. On Linux it uses
+// an io_uring set up with raw system calls, so it needs no library; elsewhere,
+// or when the kernel has no io_uring, a few threads call pread().
+// The reader is used by one thread; the buffers must stay alive until their
+// reads complete.
+//
+// Example:
+//
+// wvu::AsyncFileReader reader;
+// reader.Initialize(wvu::kDefaultAsyncReadQueueDepth, &error_info_log);
+// for (int i = 0; i < num_chunks; ++i) {
+//   reader.Read(fd, chunks[i].offset, chunks[i].size, chunks[i].data, i);
+// }
+// reader.Submit();
+// std::vector<wvu::AsyncReadCompletion> completions(64);
+// while (reader.num_pending() > 0) {
+//   const int n = reader.Poll(completions.data(), completions.size(), true);
+//   ...  // Decompress the chunks of the completions.
+// }
+class AsyncFileReader {
+ public:
+  AsyncFileReader();
+  ~AsyncFileReader();
+
+  // Sets up the io_uring, or the threads when io_uring is not available or
+  // force_thread_pool is true. Returns true if successful.
+  bool Initialize(const int queue_depth,
+                  std::string* error_info_log,
+                  const bool force_thread_pool = false);
+
+  // Queues a read of size bytes of fd at offset into buffer.
+  void Read(const int fd,
+            const uint64_t offset,
+            const size_t size,
+            void* buffer,
+            const uint64_t user_data);
+
+  // Submits the queued reads, as many as the queue depth allows. Returns the
+  // number of reads submitted.
+  int Submit();
+
+  // Moves up to max_completions finished reads to completions, and submits
+  // the reads the completions made room for. If wait is true, waits for at
+  // least one completion when some reads are pending. Returns the number of
+  // completions.
+  int Poll(AsyncReadCompletion* completions,
+           const int max_completions,
+           const bool wait);
+
+  // Waits for every read, and stops the threads or closes the io_uring.
+  void Reset();
+
+  // Reads queued, in flight or completed but not polled.
+  int num_pending() const {
+    return num_pending_;
+  }
+
+  AsyncReadBackend backend() const {
+    return backend_;
+  }
+
+  AsyncReadStatistics statistics() const;
+
+ private:
+  struct Request {
+    int fd;
+    uint64_t offset;
+    size_t size;
+    void* buffer;
+    uint64_t user_data;
+  };
+
+  bool InitializeIoUring(const int queue_depth);
+  int SubmitIoUring(const bool wait);
+  int ReapIoUring(AsyncReadCompletion* completions, const int max_completions);
+  // Reads the requests of the queue on a worker thread.
+  void ReadRequests();
+
+  AsyncReadBackend backend_;
+  int queue_depth_;
+  int num_pending_;
+  int num_in_flight_;
+  std::deque<Request> queued_requests_;
+
+  // The io_uring: its descriptor and its mapped rings.
+  int ring_fd_;
+  void* submission_ring_;
+  size_t submission_ring_size_;
+  void* completion_ring_;
+  size_t completion_ring_size_;
+  void* submission_entries_;
+  size_t submission_entries_size_;
+  unsigned* submission_head_;
+  unsigned* submission_tail_;
+  unsigned* submission_mask_;
+  unsigned* submission_array_;
+  unsigned* completion_head_;
+  unsigned* completion_tail_;
+  unsigned* completion_mask_;
+  void* completions_;
+  // The request and the iovec of every read in flight, by slot, alive until
+  // the read completes.
+  std::vector<Request> slot_requests_;
+  std::vector<iovec> vectors_;
+  std::vector<int> free_slots_;
+
+  // The threads, which take the requests from thread_requests_.
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable request_queued_;
+  std::condition_variable request_completed_;
+  std::deque<Request> thread_requests_;
+  std::vector<AsyncReadCompletion> thread_completions_;
+  bool stop_;
+
+  AsyncReadStatistics statistics_;
+  std::chrono::steady_clock::time_point first_submit_time_;
+  std::chrono::steady_clock::time_point last_completion_time_;
+
+  AsyncFileReader(const AsyncFileReader&) = delete;
+  AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_ASYNC_FILE_READER_H_
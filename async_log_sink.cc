@@ -0,0 +1,273 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "async_log_sink.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <glog/logging.h>
+
+namespace wvu {
+namespace {
+// Most bytes of lines the writer writes at once.
+constexpr size_t kMaxBatchBytes = 64 * 1024;
+
+// Time the writer sleeps once the ring buffer is empty. The producers never
+// wake it, which would take a lock.
+constexpr std::chrono::milliseconds kWriterIdleWait(2);
+
+// The letters of the severities at the start of the lines, as glog writes
+// them.
+constexpr char kSeverityLetters[] = "IWEF";
+
+// The number of the line of the last FATAL message queued by the thread, plus
+// one, or 0 if the thread has none to wait for.
+thread_local uint64_t fatal_line_end = 0;
+
+// Returns the smallest power of two not less than value.
+uint64_t RoundUpToPowerOfTwo(const int value) {
+  uint64_t power = 1;
+  while (power < static_cast<uint64_t>(std::max(value, 1))) power <<= 1;
+  return power;
+}
+
+}  // namespace
+
+AsyncLogSink::AsyncLogSink(const int capacity)
+    : slots_(new Slot[RoundUpToPowerOfTwo(capacity)]),
+      mask_(RoundUpToPowerOfTwo(capacity) - 1),
+      write_position_(0),
+      read_position_(0),
+      num_flushed_lines_(0),
+      num_messages_(0),
+      num_dropped_messages_(0),
+      num_truncated_messages_(0),
+      num_written_bytes_(0),
+      num_reported_drops_(0),
+      running_(false),
+      installed_(false),
+      file_(nullptr),
+      owns_file_(false),
+      stop_(false) {
+  for (uint64_t i = 0; i <= mask_; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+    slots_[i].length = 0;
+  }
+}
+
+AsyncLogSink::~AsyncLogSink() {
+  Uninstall();
+  Stop();
+}
+
+bool AsyncLogSink::Start(const std::string& filepath,
+                         std::string* error_info_log) {
+  Stop();
+  if (filepath.empty()) {
+    file_ = stderr;
+    owns_file_ = false;
+  } else {
+    file_ = std::fopen(filepath.c_str(), "a");
+    if (file_ == nullptr) {
+      *error_info_log = "Could not open the log file " + filepath + ": " +
+          std::strerror(errno) + ".";
+      return false;
+    }
+    owns_file_ = true;
+  }
+  batch_.reserve(kMaxBatchBytes + kMaxLogLineBytes);
+  stop_ = false;
+  running_ = true;
+  thread_ = std::thread(&AsyncLogSink::WriteLines, this);
+  return true;
+}
+
+void AsyncLogSink::Stop() {
+  if (!thread_.joinable()) return;
+  running_ = false;
+  {
+    std::lock_guard<std::mutex> lock(stop_mutex_);
+    stop_ = true;
+  }
+  stop_requested_.notify_one();
+  thread_.join();
+  if (owns_file_) std::fclose(file_);
+  file_ = nullptr;
+  owns_file_ = false;
+}
+
+void AsyncLogSink::Install() {
+  for (int severity = 0; severity < google::NUM_SEVERITIES; ++severity) {
+    google::SetLogDestination(static_cast<google::LogSeverity>(severity), "");
+  }
+  FLAGS_logtostderr = false;
+  FLAGS_alsologtostderr = false;
+  FLAGS_stderrthreshold = google::FATAL;
+  if (!installed_) google::AddLogSink(this);
+  installed_ = true;
+}
+
+void AsyncLogSink::Uninstall() {
+  if (installed_) google::RemoveLogSink(this);
+  installed_ = false;
+}
+
+void AsyncLogSink::send(google::LogSeverity severity,
+                        const char* full_filename,
+                        const char* base_filename,
+                        int line,
+                        const struct ::tm* tm_time,
+                        const char* message,
+                        size_t message_len) {
+  num_messages_.fetch_add(1, std::memory_order_relaxed);
+  if (!running_.load(std::memory_order_relaxed)) {
+    num_dropped_messages_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // Claim the slot of the next line, unless the writer did not free it yet.
+  uint64_t position = write_position_.load(std::memory_order_relaxed);
+  Slot* slot;
+  while (true) {
+    slot = &slots_[position & mask_];
+    const int64_t difference = static_cast<int64_t>(
+        slot->sequence.load(std::memory_order_acquire) - position);
+    if (difference == 0) {
+      if (write_position_.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      num_dropped_messages_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      position = write_position_.load(std::memory_order_relaxed);
+    }
+  }
+  // The prefix of the lines of glog, without the microseconds and the thread,
+  // which the sink does not receive.
+  const int severity_index = std::min(std::max(static_cast<int>(severity), 0),
+                                      static_cast<int>(google::FATAL));
+  const int prefix_length = std::snprintf(
+      slot->text, kMaxLogLineBytes, "%c%02d%02d %02d:%02d:%02d %s:%d] ",
+      kSeverityLetters[severity_index], tm_time->tm_mon + 1, tm_time->tm_mday,
+      tm_time->tm_hour, tm_time->tm_min, tm_time->tm_sec, base_filename, line);
+  // Leaves room for the new line.
+  size_t length = std::min(static_cast<size_t>(std::max(prefix_length, 0)),
+                           static_cast<size_t>(kMaxLogLineBytes - 1));
+  const size_t message_length =
+      std::min(message_len, kMaxLogLineBytes - 1 - length);
+  if (message_length < message_len) {
+    num_truncated_messages_.fetch_add(1, std::memory_order_relaxed);
+  }
+  std::memcpy(slot->text + length, message, message_length);
+  length += message_length;
+  slot->text[length++] = '\n';
+  slot->length = static_cast<int>(length);
+  slot->sequence.store(position + 1, std::memory_order_release);
+  if (severity >= google::FATAL) fatal_line_end = position + 1;
+}
+
+void AsyncLogSink::WaitTillSent() {
+  if (fatal_line_end == 0) return;
+  while (running_.load(std::memory_order_relaxed) &&
+         num_flushed_lines_.load(std::memory_order_acquire) < fatal_line_end) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  fatal_line_end = 0;
+}
+
+AsyncLogStatistics AsyncLogSink::statistics() const {
+  AsyncLogStatistics statistics;
+  statistics.num_messages = num_messages_.load(std::memory_order_relaxed);
+  statistics.num_dropped_messages =
+      num_dropped_messages_.load(std::memory_order_relaxed);
+  statistics.num_truncated_messages =
+      num_truncated_messages_.load(std::memory_order_relaxed);
+  statistics.num_written_bytes =
+      num_written_bytes_.load(std::memory_order_relaxed);
+  return statistics;
+}
+
+void AsyncLogSink::WriteLines() {
+  while (true) {
+    if (WriteQueuedLines() > 0) continue;
+    std::unique_lock<std::mutex> lock(stop_mutex_);
+    if (stop_) break;
+    stop_requested_.wait_for(lock, kWriterIdleWait);
+  }
+  // The lines queued before Stop().
+  while (WriteQueuedLines() > 0) {}
+}
+
+int AsyncLogSink::WriteQueuedLines() {
+  batch_.clear();
+  int num_lines = 0;
+  while (batch_.size() < kMaxBatchBytes) {
+    Slot& slot = slots_[read_position_ & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != read_position_ + 1) {
+      break;
+    }
+    batch_.append(slot.text, slot.length);
+    // Frees the slot for the line of the next lap.
+    slot.sequence.store(read_position_ + mask_ + 1, std::memory_order_release);
+    ++read_position_;
+    ++num_lines;
+  }
+  const int64_t num_drops =
+      num_dropped_messages_.load(std::memory_order_relaxed);
+  if (num_drops > num_reported_drops_) {
+    batch_ += "W AsyncLogSink] Dropped " +
+        std::to_string(num_drops - num_reported_drops_) +
+        " log messages, since the queue was full.\n";
+    num_reported_drops_ = num_drops;
+  }
+  if (batch_.empty()) return 0;
+  std::fwrite(batch_.data(), 1, batch_.size(), file_);
+  std::fflush(file_);
+  num_written_bytes_.fetch_add(batch_.size(), std::memory_order_relaxed);
+  num_flushed_lines_.store(read_position_, std::memory_order_release);
+  return num_lines;
+}
+
+}  // namespace wvu
@@ -0,0 +1,180 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_ASYNC_LOG_SINK_H_
+#define GLUTILS_ASYNC_LOG_SINK_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <glog/logging.h>
+
+namespace wvu {
+// Default number of messages an AsyncLogSink queues before dropping new ones.
+constexpr int kDefaultLogQueueCapacity = 4096;
+
+// Longest line an AsyncLogSink queues, with its prefix and its new line.
+// Longer messages are truncated.
+constexpr int kMaxLogLineBytes = 500;
+
+// Counters of an AsyncLogSink.
+struct AsyncLogStatistics {
+  int64_t num_messages = 0;
+  // Messages dropped because the queue was full, and messages truncated to
+  // kMaxLogLineBytes.
+  int64_t num_dropped_messages = 0;
+  int64_t num_truncated_messages = 0;
+  int64_t num_written_bytes = 0;
+};
+
+// This class is a glog sink whose writes never block the threads that log.
+// send() formats the line straight into a slot of a bounded lock-free multiple
+// producer, single consumer ring buffer, and a writer thread takes the lines
+// in batches and writes them with one write and one flush per batch. When the
+// ring buffer is full, the new messages are dropped and counted, and the
+// writer reports the count in the log, so a burst of messages costs lines
+// rather than frames. The ring buffer is the bounded queue of Dmitry Vyukov:
+// every slot holds a sequence number, and the producers claim slots with a
+// compare-and-swap on the write position, so they only contend on that
+// position.
+//
+// Install() turns off the synchronous outputs of glog, i.e., the log files
+// and stderr, below FATAL, so that the sink is the only output of the other
+// messages. A FATAL message waits until the writer flushed it, since the
+// process aborts right after.
+//
+// Example:
+//
+// wvu::AsyncLogSink log_sink;
+// if (!log_sink.Start("renderer.log", &error_info_log)) { ... }
+// log_sink.Install();
+// LOG(INFO) << "Queued, and written by the writer thread.";
+// ...
+// log_sink.Uninstall();
+// log_sink.Stop();
+class AsyncLogSink : public google::LogSink {
+ public:
+  // Parameters:
+  //   capacity  The number of lines the ring buffer holds, rounded up to a
+  //     power of two.
+  explicit AsyncLogSink(const int capacity = kDefaultLogQueueCapacity);
+  // Uninstalls and stops the sink.
+  ~AsyncLogSink() override;
+
+  // Opens the file to append the lines to, or uses stderr if filepath is
+  // empty, and starts the writer thread. Returns true if successful.
+  bool Start(const std::string& filepath, std::string* error_info_log);
+
+  // Writes the queued lines, and stops the writer thread. The messages sent
+  // afterwards are dropped.
+  void Stop();
+
+  // Adds the sink to glog, and turns off the synchronous outputs of glog
+  // below FATAL.
+  void Install();
+
+  // Removes the sink from glog. The synchronous outputs stay off.
+  void Uninstall();
+
+  // Queues the line of a message, or drops it if the ring buffer is full.
+  // Never blocks. Called by glog on the thread that logs.
+  void send(google::LogSeverity severity,
+            const char* full_filename,
+            const char* base_filename,
+            int line,
+            const struct ::tm* tm_time,
+            const char* message,
+            size_t message_len) override;
+
+  // Waits until the writer flushed the last FATAL message of the calling
+  // thread. Returns right away after the other messages.
+  void WaitTillSent() override;
+
+  // Returns the counters. May be called by any thread.
+  AsyncLogStatistics statistics() const;
+
+ private:
+  struct Slot {
+    // The number of the line the slot expects next: its write number while it
+    // is free, and its write number plus one once the line is written.
+    std::atomic<uint64_t> sequence;
+    int length;
+    char text[kMaxLogLineBytes];
+  };
+
+  // Writes the lines until Stop() is called.
+  void WriteLines();
+
+  // Writes the queued lines. Returns the number of lines written.
+  int WriteQueuedLines();
+
+  std::unique_ptr<Slot[]> slots_;
+  const uint64_t mask_;
+  // The numbers of the next line written by the producers, and read by the
+  // writer.
+  std::atomic<uint64_t> write_position_;
+  uint64_t read_position_;
+  // The number of lines the writer flushed.
+  std::atomic<uint64_t> num_flushed_lines_;
+  std::atomic<int64_t> num_messages_;
+  std::atomic<int64_t> num_dropped_messages_;
+  std::atomic<int64_t> num_truncated_messages_;
+  std::atomic<int64_t> num_written_bytes_;
+  // The drops the writer reported.
+  int64_t num_reported_drops_;
+  std::atomic<bool> running_;
+  bool installed_;
+  FILE* file_;
+  bool owns_file_;
+  // The batch of lines of a write.
+  std::string batch_;
+  std::mutex stop_mutex_;
+  std::condition_variable stop_requested_;
+  bool stop_;
+  std::thread thread_;
+
+  AsyncLogSink(const AsyncLogSink&) = delete;
+  AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_ASYNC_LOG_SINK_H_
@@ -0,0 +1,208 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+// Bakes the ambient occlusion of the static objects of a scene file (see
+// scene_file.h) into the colors of their vertices (see
+// ambient_occlusion_baking.h), on all the cores. The objects occlude each
+// other, so every object gets its own copy of its mesh: the tool writes a mesh
+// file per object and a scene file using them into the output directory.
+//
+// Example:
+//
+// ./bin/bake_ambient_occlusion --scene_file=scenes/city.scene \
+//     --output_directory=scenes/city_baked --num_rays=128 --max_distance=2
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "ambient_occlusion_baking.h"
+#include "job_system.h"
+#include "mesh_file.h"
+#include "mesh_normals.h"
+#include "mesh_picking.h"
+#include "model.h"
+#include "scene_file.h"
+
+// Use the right namespace for google flags (gflags).
+#ifdef GFLAGS_NAMESPACE_GOOGLE
+#define CS470_GFLAGS_NAMESPACE google
+#else
+#define CS470_GFLAGS_NAMESPACE gflags
+#endif
+
+DEFINE_string(scene_file, "", "Scene whose objects are baked.");
+DEFINE_string(output_directory, "",
+              "Existing directory of the baked scene and mesh files.");
+DEFINE_int32(num_rays, 64, "Rays cast from every vertex.");
+DEFINE_double(max_distance, 1.0,
+              "Distance in world units beyond which the occluders are "
+              "ignored.");
+DEFINE_int32(num_threads, 0,
+             "Threads casting the rays. Zero uses every hardware thread.");
+
+// Annonymous namespace for constants and helper functions.
+namespace {
+typedef std::vector<wvu::Model, Eigen::aligned_allocator<wvu::Model> > Models;
+
+// Returns the file name of a path.
+std::string Basename(const std::string& filepath) {
+  const size_t slash = filepath.find_last_of('/');
+  return slash == std::string::npos ? filepath : filepath.substr(slash + 1);
+}
+
+// Reads the meshes of the scene, with float normals if they have none.
+bool ReadMeshes(const wvu::SceneDescription& scene,
+                wvu::JobSystem* job_system,
+                Models* meshes,
+                std::string* error_info_log) {
+  meshes->resize(scene.meshes.size());
+  for (int i = 0; i < static_cast<int>(scene.meshes.size()); ++i) {
+    wvu::MeshFile file;
+    if (!file.Open(scene.meshes[i].filepath, error_info_log)) return false;
+    wvu::Model& mesh = (*meshes)[i];
+    if (!file.ToModel(&mesh, job_system)) {
+      *error_info_log = "The mesh " + scene.meshes[i].name + " is corrupt.";
+      return false;
+    }
+    if (mesh.vertex_layout().FindAttribute(wvu::NORMAL) == nullptr &&
+        !wvu::ComputeVertexNormals(wvu::ANGLE_WEIGHTED_NORMALS,
+                                   wvu::NORMAL_FLOAT32, job_system, &mesh,
+                                   error_info_log)) {
+      *error_info_log = scene.meshes[i].name + ": " + *error_info_log;
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CS470_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  if (FLAGS_scene_file.empty() || FLAGS_output_directory.empty()) {
+    LOG(ERROR) << "--scene_file and --output_directory are required.";
+    return -1;
+  }
+  std::string error_info_log;
+  wvu::SceneDescription scene;
+  if (!wvu::ReadSceneFile(FLAGS_scene_file, &scene, &error_info_log)) {
+    LOG(ERROR) << error_info_log;
+    return -1;
+  }
+  wvu::JobSystem job_system(FLAGS_num_threads);
+  Models meshes;
+  if (!ReadMeshes(scene, &job_system, &meshes, &error_info_log)) {
+    LOG(ERROR) << error_info_log;
+    return -1;
+  }
+
+  // Every object occludes the others through the picker of its mesh.
+  std::vector<wvu::MeshPicker> pickers(meshes.size());
+  for (int i = 0; i < static_cast<int>(meshes.size()); ++i) {
+    if (!pickers[i].Build(meshes[i])) {
+      LOG(ERROR) << "The mesh " << scene.meshes[i].name
+                 << " is not a triangle list.";
+      return -1;
+    }
+  }
+  Models objects;
+  objects.reserve(scene.objects.size());
+  wvu::StaticOccluders occluders;
+  for (const wvu::SceneObject& object : scene.objects) {
+    objects.push_back(meshes[object.mesh]);
+    objects.back().SetPosition(object.position);
+    objects.back().SetOrientation(object.orientation);
+    occluders.AddObject(&pickers[object.mesh], objects.back().model_matrix());
+  }
+  occluders.Build();
+
+  wvu::AmbientOcclusionBakeOptions options;
+  options.num_rays = FLAGS_num_rays;
+  options.max_distance = FLAGS_max_distance;
+  wvu::AmbientOcclusionBakeStatistics statistics;
+  wvu::SceneDescription baked_scene;
+  baked_scene.lighting = scene.lighting;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < static_cast<int>(objects.size()); ++i) {
+    const wvu::SceneObject& object = scene.objects[i];
+    if (!wvu::BakeAmbientOcclusion(occluders, options, &job_system,
+                                   &objects[i], &statistics,
+                                   &error_info_log)) {
+      LOG(ERROR) << scene.meshes[object.mesh].name << ": " << error_info_log;
+      return -1;
+    }
+    // The paths of the meshes are relative to the baked scene file.
+    wvu::SceneMesh baked_mesh;
+    baked_mesh.name = scene.meshes[object.mesh].name + "_" + std::to_string(i);
+    baked_mesh.filepath = baked_mesh.name + ".wvum";
+    if (!wvu::WriteMeshFile(objects[i],
+                            FLAGS_output_directory + "/" + baked_mesh.filepath,
+                            &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      return -1;
+    }
+    wvu::SceneObject baked_object = object;
+    baked_object.mesh = baked_scene.meshes.size();
+    baked_scene.meshes.push_back(baked_mesh);
+    baked_scene.objects.push_back(baked_object);
+  }
+  const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  const std::string baked_scene_filepath =
+      FLAGS_output_directory + "/" + Basename(FLAGS_scene_file);
+  if (!wvu::WriteSceneFile(baked_scene, baked_scene_filepath,
+                           &error_info_log)) {
+    LOG(ERROR) << error_info_log;
+    return -1;
+  }
+  LOG(INFO) << "Baked " << statistics.num_vertices << " vertices of "
+            << objects.size() << " objects with " << statistics.num_rays
+            << " rays in " << seconds << " s on " << job_system.num_threads()
+            << " threads, " << statistics.num_rays / std::max(seconds, 1e-9)
+            << " rays/s; "
+            << 100.0 * statistics.num_occluded_rays /
+               std::max<int64_t>(statistics.num_rays, 1)
+            << "% occluded.";
+  return 0;
+}
@@ -0,0 +1,464 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "bounding_volume_hierarchy.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "transforms.h"
+
+namespace wvu {
+namespace {
+// Bins of the centroids evaluated as split positions by the build.
+constexpr int kNumBins = 16;
+
+// A range of objects to split, and the node that holds them.
+struct BuildTask {
+  int node;
+  int first;
+  int end;
+  int depth;
+};
+
+// Returns half the surface area of a non-empty box.
+float HalfArea(const Eigen::Vector3f& min_corner,
+               const Eigen::Vector3f& max_corner) {
+  const Eigen::Vector3f extent = max_corner - min_corner;
+  return extent.x() * extent.y() + extent.y() * extent.z() +
+      extent.z() * extent.x();
+}
+
+// Tests a box against the frustum planes whose bits are set in the mask.
+// Returns false if the box is outside one of them, and otherwise clears the
+// bits of the planes the box is completely inside of.
+bool ClassifyBox(const FrustumPlanes& planes,
+                 const Eigen::Vector3f& min_corner,
+                 const Eigen::Vector3f& max_corner,
+                 uint8_t* mask) {
+  const Eigen::Vector3f center = 0.5f * (min_corner + max_corner);
+  const Eigen::Vector3f half_extent = 0.5f * (max_corner - min_corner);
+  for (int i = 0; i < 6; ++i) {
+    const uint8_t bit = 1 << i;
+    if ((*mask & bit) == 0) continue;
+    const Eigen::Vector3f normal = planes.row(i).head<3>();
+    const float distance = normal.dot(center) + planes(i, 3);
+    const float radius = normal.cwiseAbs().dot(half_extent);
+    if (distance < -radius) return false;
+    if (distance >= radius) *mask &= ~bit;
+  }
+  return true;
+}
+
+// Intersects a ray with a box with the slab test. Returns the distance where
+// the ray enters the box, or 0 if it starts inside, or infinity if it misses
+// the box before max_distance.
+float IntersectBox(const Eigen::Vector3f& origin,
+                   const Eigen::Vector3f& inverse_direction,
+                   const Eigen::Vector3f& min_corner,
+                   const Eigen::Vector3f& max_corner,
+                   const float max_distance) {
+  const Eigen::Vector3f near_distances =
+      (min_corner - origin).cwiseProduct(inverse_direction);
+  const Eigen::Vector3f far_distances =
+      (max_corner - origin).cwiseProduct(inverse_direction);
+  const float entry =
+      std::max(near_distances.cwiseMin(far_distances).maxCoeff(), 0.0f);
+  const float exit =
+      std::min(near_distances.cwiseMax(far_distances).minCoeff(),
+               max_distance);
+  return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+}
+
+}  // namespace
+
+void BoundingVolumeHierarchy::Build(
+    const std::vector<Eigen::AlignedBox3f>& object_bounds) {
+  object_bounds_ = object_bounds;
+  const int num_objects = object_bounds_.size();
+  nodes_.clear();
+  parents_.clear();
+  dirty_leaves_.clear();
+  object_indices_.resize(num_objects);
+  object_leaves_.assign(num_objects, 0);
+  if (num_objects == 0) {
+    dirty_.clear();
+    return;
+  }
+  std::vector<Eigen::Vector3f> centroids(num_objects);
+  for (int i = 0; i < num_objects; ++i) {
+    object_indices_[i] = i;
+    centroids[i] = object_bounds_[i].center();
+  }
+  // Every leaf holds an object at least, so the tree has fewer than twice as
+  // many nodes as objects.
+  nodes_.reserve(2 * num_objects - 1);
+  parents_.reserve(2 * num_objects - 1);
+  nodes_.push_back(Node());
+  parents_.push_back(-1);
+  std::vector<BuildTask> tasks(1, BuildTask{0, 0, num_objects, 0});
+  while (!tasks.empty()) {
+    const BuildTask task = tasks.back();
+    tasks.pop_back();
+    const int num_task_objects = task.end - task.first;
+    std::vector<int>::iterator first_object =
+        object_indices_.begin() + task.first;
+    std::vector<int>::iterator end_object = object_indices_.begin() + task.end;
+    Eigen::AlignedBox3f box, centroid_box;
+    for (std::vector<int>::iterator it = first_object; it != end_object; ++it) {
+      box.extend(object_bounds_[*it]);
+      centroid_box.extend(centroids[*it]);
+    }
+    nodes_[task.node].min_corner = box.min();
+    nodes_[task.node].max_corner = box.max();
+
+    // Find the bin boundary along the longest axis of the centroids that
+    // minimizes the surface area heuristic, i.e., the sum of the areas of the
+    // children weighted by their number of objects.
+    int middle = -1;
+    if (num_task_objects > kMinBvhLeafObjects &&
+        task.depth + 1 < kMaxBvhDepth) {
+      int axis;
+      const float extent = centroid_box.sizes().maxCoeff(&axis);
+      const float axis_min = centroid_box.min()[axis];
+      const float scale = extent > 0.0f ? kNumBins / extent : 0.0f;
+      const auto bin_of = [&](const int object) {
+        return std::min(kNumBins - 1, static_cast<int>(
+            (centroids[object][axis] - axis_min) * scale));
+      };
+      if (extent > 0.0f) {
+        Eigen::AlignedBox3f bin_boxes[kNumBins];
+        int bin_counts[kNumBins] = {0};
+        for (std::vector<int>::iterator it = first_object; it != end_object;
+             ++it) {
+          const int bin = bin_of(*it);
+          ++bin_counts[bin];
+          bin_boxes[bin].extend(object_bounds_[*it]);
+        }
+        // The costs of the objects right of every boundary.
+        float right_costs[kNumBins];
+        Eigen::AlignedBox3f right_box;
+        int num_right_objects = 0;
+        for (int bin = kNumBins - 1; bin > 0; --bin) {
+          right_box.extend(bin_boxes[bin]);
+          num_right_objects += bin_counts[bin];
+          right_costs[bin] = num_right_objects == 0 ? 0.0f :
+              num_right_objects * HalfArea(right_box.min(), right_box.max());
+        }
+        Eigen::AlignedBox3f left_box;
+        int num_left_objects = 0;
+        int best_bin = -1;
+        float best_cost = std::numeric_limits<float>::max();
+        for (int bin = 1; bin < kNumBins; ++bin) {
+          left_box.extend(bin_boxes[bin - 1]);
+          num_left_objects += bin_counts[bin - 1];
+          if (num_left_objects == 0 || num_left_objects == num_task_objects) {
+            continue;
+          }
+          const float cost = right_costs[bin] +
+              num_left_objects * HalfArea(left_box.min(), left_box.max());
+          if (cost < best_cost) {
+            best_cost = cost;
+            best_bin = bin;
+          }
+        }
+        // Splitting costs a box test per child on top of the tests of the
+        // objects reaching them.
+        const float area = HalfArea(box.min(), box.max());
+        const bool split_cheaper =
+            area <= 0.0f || 2.0f + best_cost / area < num_task_objects;
+        if (best_bin > 0 &&
+            (split_cheaper || num_task_objects > kMaxBvhLeafObjects)) {
+          middle = std::partition(first_object, end_object,
+                                  [&](const int object) {
+                                    return bin_of(object) < best_bin;
+                                  }) - object_indices_.begin();
+        }
+      } else if (num_task_objects > kMaxBvhLeafObjects) {
+        // The centroids coincide, so any halves are as good.
+        middle = task.first + num_task_objects / 2;
+      }
+    }
+
+    Node& node = nodes_[task.node];
+    if (middle < 0) {
+      node.offset = task.first;
+      node.num_objects = num_task_objects;
+      for (std::vector<int>::iterator it = first_object; it != end_object;
+           ++it) {
+        object_leaves_[*it] = task.node;
+      }
+      continue;
+    }
+    const int child = nodes_.size();
+    node.offset = child;
+    node.num_objects = 0;
+    nodes_.resize(child + 2);
+    parents_.resize(child + 2, task.node);
+    // The first child is built first, so the nodes are in depth-first order.
+    tasks.push_back(BuildTask{child + 1, middle, task.end, task.depth + 1});
+    tasks.push_back(BuildTask{child, task.first, middle, task.depth + 1});
+  }
+  dirty_.assign(nodes_.size(), 0);
+}
+
+void BoundingVolumeHierarchy::UpdateBounds(const int object,
+                                           const Eigen::AlignedBox3f& bounds) {
+  object_bounds_[object] = bounds;
+  const int leaf = object_leaves_[object];
+  if (!dirty_[leaf]) {
+    dirty_[leaf] = 1;
+    dirty_leaves_.push_back(leaf);
+  }
+}
+
+void BoundingVolumeHierarchy::Refit() {
+  for (const int leaf : dirty_leaves_) {
+    dirty_[leaf] = 0;
+    ComputeLeafBox(&nodes_[leaf]);
+    // The boxes may also shrink, so the ancestors are recomputed from their
+    // children. An ancestor that does not change leaves the ones above it as
+    // they are.
+    for (int index = parents_[leaf]; index >= 0; index = parents_[index]) {
+      Node& node = nodes_[index];
+      const Node& first_child = nodes_[node.offset];
+      const Node& second_child = nodes_[node.offset + 1];
+      const Eigen::Vector3f min_corner =
+          first_child.min_corner.cwiseMin(second_child.min_corner);
+      const Eigen::Vector3f max_corner =
+          first_child.max_corner.cwiseMax(second_child.max_corner);
+      if (min_corner == node.min_corner && max_corner == node.max_corner) {
+        break;
+      }
+      node.min_corner = min_corner;
+      node.max_corner = max_corner;
+    }
+  }
+  dirty_leaves_.clear();
+}
+
+int BoundingVolumeHierarchy::QueryFrustum(
+    const Eigen::Matrix4f& view_projection,
+    std::vector<int>* objects) const {
+  if (nodes_.empty()) return 0;
+  const FrustumPlanes planes = ExtractFrustumPlanes(view_projection);
+  const int num_objects_before = objects->size();
+  // The nodes to visit, with the bits of the planes their boxes may cross.
+  // The children of a node inside a plane are not tested against it.
+  int stack[kMaxBvhDepth + 1];
+  uint8_t stack_masks[kMaxBvhDepth + 1];
+  int stack_size = 1;
+  stack[0] = 0;
+  stack_masks[0] = 0x3F;
+  while (stack_size > 0) {
+    --stack_size;
+    const int index = stack[stack_size];
+    uint8_t mask = stack_masks[stack_size];
+    const Node& node = nodes_[index];
+    if (!ClassifyBox(planes, node.min_corner, node.max_corner, &mask)) {
+      continue;
+    }
+    if (mask == 0) {
+      int first, end;
+      GetObjectRange(index, &first, &end);
+      objects->insert(objects->end(), object_indices_.begin() + first,
+                      object_indices_.begin() + end);
+      continue;
+    }
+    if (node.num_objects > 0) {
+      for (int i = node.offset; i < node.offset + node.num_objects; ++i) {
+        const Eigen::AlignedBox3f& bounds = object_bounds_[object_indices_[i]];
+        uint8_t object_mask = mask;
+        if (ClassifyBox(planes, bounds.min(), bounds.max(), &object_mask)) {
+          objects->push_back(object_indices_[i]);
+        }
+      }
+      continue;
+    }
+    stack[stack_size] = node.offset + 1;
+    stack_masks[stack_size++] = mask;
+    stack[stack_size] = node.offset;
+    stack_masks[stack_size++] = mask;
+  }
+  return static_cast<int>(objects->size()) - num_objects_before;
+}
+
+int BoundingVolumeHierarchy::Raycast(const Eigen::Vector3f& origin,
+                                     const Eigen::Vector3f& direction,
+                                     const float max_distance,
+                                     const RayObjectIntersection& intersection,
+                                     float* distance) const {
+  const Eigen::Vector3f inverse_direction = direction.cwiseInverse();
+  int nearest_object = -1;
+  float nearest_distance = max_distance;
+  TraverseRay(origin, direction, max_distance,
+              [&](const int first, const int end, float* leaf_distance) {
+    bool hit = false;
+    for (int i = first; i < end; ++i) {
+      const int object = object_indices_[i];
+      const Eigen::AlignedBox3f& bounds = object_bounds_[object];
+      float object_distance =
+          IntersectBox(origin, inverse_direction, bounds.min(), bounds.max(),
+                       *leaf_distance);
+      if (object_distance > *leaf_distance) continue;
+      if (intersection && (!intersection(object, &object_distance) ||
+                           object_distance > *leaf_distance)) {
+        continue;
+      }
+      *leaf_distance = object_distance;
+      nearest_object = object;
+      hit = true;
+    }
+    return hit;
+  }, &nearest_distance);
+  if (distance != nullptr && nearest_object >= 0) {
+    *distance = nearest_distance;
+  }
+  return nearest_object;
+}
+
+bool BoundingVolumeHierarchy::RaycastLeaves(
+    const Eigen::Vector3f& origin,
+    const Eigen::Vector3f& direction,
+    const float max_distance,
+    const RayLeafIntersection& intersection,
+    float* distance) const {
+  float nearest_distance = max_distance;
+  const bool hit = TraverseRay(origin, direction, max_distance, intersection,
+                               &nearest_distance);
+  if (distance != nullptr && hit) {
+    *distance = nearest_distance;
+  }
+  return hit;
+}
+
+bool BoundingVolumeHierarchy::TraverseRay(
+    const Eigen::Vector3f& origin,
+    const Eigen::Vector3f& direction,
+    const float max_distance,
+    const RayLeafIntersection& intersect_leaf,
+    float* nearest_distance) const {
+  *nearest_distance = max_distance;
+  if (nodes_.empty()) return false;
+  const Eigen::Vector3f inverse_direction = direction.cwiseInverse();
+  bool hit = false;
+  // The nodes to visit, with the distance where the ray enters them.
+  int stack[kMaxBvhDepth + 1];
+  float stack_distances[kMaxBvhDepth + 1];
+  int stack_size = 0;
+  const float root_distance =
+      IntersectBox(origin, inverse_direction, nodes_[0].min_corner,
+                   nodes_[0].max_corner, max_distance);
+  if (root_distance <= max_distance) {
+    stack[0] = 0;
+    stack_distances[0] = root_distance;
+    stack_size = 1;
+  }
+  while (stack_size > 0) {
+    --stack_size;
+    // A hit found after the node was pushed may be nearer than it.
+    if (stack_distances[stack_size] > *nearest_distance) continue;
+    const Node& node = nodes_[stack[stack_size]];
+    if (node.num_objects > 0) {
+      if (intersect_leaf(node.offset, node.offset + node.num_objects,
+                         nearest_distance)) {
+        hit = true;
+      }
+      continue;
+    }
+    // Visit the nearest child first, so that its hits prune the other one.
+    int children[2] = {node.offset, node.offset + 1};
+    float child_distances[2];
+    for (int i = 0; i < 2; ++i) {
+      const Node& child = nodes_[children[i]];
+      child_distances[i] =
+          IntersectBox(origin, inverse_direction, child.min_corner,
+                       child.max_corner, *nearest_distance);
+    }
+    if (child_distances[0] < child_distances[1]) {
+      std::swap(children[0], children[1]);
+      std::swap(child_distances[0], child_distances[1]);
+    }
+    for (int i = 0; i < 2; ++i) {
+      if (child_distances[i] > *nearest_distance) continue;
+      stack[stack_size] = children[i];
+      stack_distances[stack_size++] = child_distances[i];
+    }
+  }
+  return hit;
+}
+
+float BoundingVolumeHierarchy::ComputeCost() const {
+  if (nodes_.empty()) return 0.0f;
+  // The probability of visiting a node is the ratio of its area to the area
+  // of the root. Visiting an interior node tests the boxes of its two
+  // children, and visiting a leaf tests the bounds of its objects.
+  const float root_area = HalfArea(nodes_[0].min_corner, nodes_[0].max_corner);
+  const float scale = root_area > 0.0f ? 1.0f / root_area : 0.0f;
+  float cost = 1.0f;
+  for (const Node& node : nodes_) {
+    const float probability =
+        scale * HalfArea(node.min_corner, node.max_corner);
+    cost += probability * (node.num_objects > 0 ? node.num_objects : 2);
+  }
+  return cost;
+}
+
+void BoundingVolumeHierarchy::ComputeLeafBox(Node* node) const {
+  Eigen::AlignedBox3f box;
+  for (int i = node->offset; i < node->offset + node->num_objects; ++i) {
+    box.extend(object_bounds_[object_indices_[i]]);
+  }
+  node->min_corner = box.min();
+  node->max_corner = box.max();
+}
+
+void BoundingVolumeHierarchy::GetObjectRange(const int node,
+                                             int* first,
+                                             int* end) const {
+  // The objects of a node span from its leftmost leaf to its rightmost one.
+  int leaf = node;
+  while (nodes_[leaf].num_objects == 0) leaf = nodes_[leaf].offset;
+  *first = nodes_[leaf].offset;
+  leaf = node;
+  while (nodes_[leaf].num_objects == 0) leaf = nodes_[leaf].offset + 1;
+  *end = nodes_[leaf].offset + nodes_[leaf].num_objects;
+}
+
+}  // namespace wvu
@@ -0,0 +1,225 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_BOUNDING_VOLUME_HIERARCHY_H_
+#define GLUTILS_BOUNDING_VOLUME_HIERARCHY_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace wvu {
+// Objects per leaf below which the build stops splitting, and above which it
+// always splits.
+constexpr int kMinBvhLeafObjects = 2;
+constexpr int kMaxBvhLeafObjects = 8;
+
+// Levels of the hierarchy. Deeper nodes become leaves regardless of their
+// number of objects, so the queries traverse it with a fixed-size stack.
+constexpr int kMaxBvhDepth = 48;
+
+// Computes the exact intersection of a ray with an object whose bounds it hits,
+// e.g., with the triangles of its mesh. Returns true and the distance along
+// the ray if the ray hits the object.
+typedef std::function<bool(const int object, float* distance)>
+    RayObjectIntersection;
+
+// Intersects a ray with the objects of a leaf at once, e.g., with SIMD
+// kernels. The objects are ordered_objects()[first] to
+// ordered_objects()[end - 1]. distance holds the distance to the nearest hit
+// so far. Returns true and updates it if the ray hits an object nearer than
+// it.
+typedef std::function<bool(const int first, const int end, float* distance)>
+    RayLeafIntersection;
+
+// This class indexes the world-space bounds of the objects of a scene in a
+// bounding volume hierarchy, so that frustum culling, ray picking and the
+// selection of shadow casters test a few nodes instead of every object. The
+// tree is built top down with the surface area heuristic, binning the
+// centroids of the objects along the longest axis of their bounds. The nodes
+// are stored in a flat array of 32-byte nodes, where the two children of a
+// node are adjacent, and the objects of a node are a contiguous range of the
+// object indices.
+//
+// When objects move, UpdateBounds() and Refit() enlarge or shrink the boxes of
+// their ancestors without changing the tree, which is much cheaper than a
+// build but degrades the tree as the objects move away from where they were
+// built. Build again when ComputeCost() grows well above its value after the
+// build.
+//
+// Example:
+//
+// wvu::BoundingVolumeHierarchy bvh;
+// bvh.Build(object_bounds);
+// while (...) {  // Rendering loop.
+//   bvh.UpdateBounds(moved_object, moved_object_bounds);
+//   bvh.Refit();
+//   visible_objects.clear();
+//   bvh.QueryFrustum(projection * view, &visible_objects);
+//   for (int cascade = 0; cascade < shadows.num_cascades(); ++cascade) {
+//     casters.clear();
+//     bvh.QueryFrustum(shadows.light_view_projection(cascade), &casters);
+//   }
+// }
+//
+// Picking the object under the cursor:
+//
+// float distance;
+// const int object = bvh.Raycast(camera_position, ray_direction,
+//                                far_distance, nullptr, &distance);
+class BoundingVolumeHierarchy {
+ public:
+  BoundingVolumeHierarchy() {}
+  ~BoundingVolumeHierarchy() {}
+
+  // Builds the hierarchy of the objects, replacing the previous one.
+  // Parameters:
+  //   object_bounds  The non-empty world-space bounds of every object. The
+  //     objects are identified by their index in this vector.
+  void Build(const std::vector<Eigen::AlignedBox3f>& object_bounds);
+
+  // Sets the bounds of an object, e.g., after its transform changed. The
+  // boxes of the nodes are updated by the next Refit().
+  void UpdateBounds(const int object, const Eigen::AlignedBox3f& bounds);
+
+  // Updates the boxes of the leaves of the objects whose bounds changed since
+  // the last build or refit, and of their ancestors.
+  void Refit();
+
+  // Appends the objects whose bounds intersect the frustum of a view
+  // projection matrix to objects, and returns how many were appended. The
+  // objects of the nodes inside the frustum are appended without testing
+  // their bounds. The test is conservative: a few boxes outside the frustum
+  // near its corners pass it.
+  // Parameters:
+  //   view_projection  Maps world space to clip space, e.g., the projection *
+  //     view matrix of a camera, or the light view projection of a shadow
+  //     cascade to select its casters.
+  //   objects  The indices of the objects intersecting the frustum.
+  int QueryFrustum(const Eigen::Matrix4f& view_projection,
+                   std::vector<int>* objects) const;
+
+  // Returns the nearest object hit by a ray, or -1 if the ray hits none
+  // within max_distance.
+  // Parameters:
+  //   origin  The origin of the ray in world space.
+  //   direction  The direction of the ray. The distances are in units of its
+  //     length.
+  //   max_distance  The distance beyond which the objects are ignored.
+  //   intersection  Intersects the ray with the objects whose bounds it hits.
+  //     When empty, the objects are hit at the entry point of their bounds.
+  //   distance  The distance to the hit, if any. Can be nullptr.
+  int Raycast(const Eigen::Vector3f& origin,
+              const Eigen::Vector3f& direction,
+              const float max_distance,
+              const RayObjectIntersection& intersection,
+              float* distance) const;
+
+  // Finds the nearest hit of a ray as Raycast() does, intersecting the ray
+  // with all the objects of a leaf at once, and without testing their bounds.
+  // Returns true if a leaf reported a hit within max_distance, and its
+  // distance. The caller keeps the object hit.
+  bool RaycastLeaves(const Eigen::Vector3f& origin,
+                     const Eigen::Vector3f& direction,
+                     const float max_distance,
+                     const RayLeafIntersection& intersection,
+                     float* distance) const;
+
+  // Returns the expected cost of a ray query by the surface area heuristic, in
+  // units of the cost of a box test, which grows as refits degrade the tree.
+  float ComputeCost() const;
+
+  const Eigen::AlignedBox3f& bounds(const int object) const {
+    return object_bounds_[object];
+  }
+
+  int num_objects() const {
+    return object_bounds_.size();
+  }
+
+  int num_nodes() const {
+    return nodes_.size();
+  }
+
+  // Returns the objects in the order of the leaves, where the objects of every
+  // leaf are contiguous.
+  const std::vector<int>& ordered_objects() const {
+    return object_indices_;
+  }
+
+ private:
+  // A node of the tree. The node is a leaf when num_objects > 0, and offset is
+  // the index of its first object in object_indices_. Otherwise offset is the
+  // index of its first child, and the second child follows it.
+  struct Node {
+    Eigen::Vector3f min_corner;
+    int32_t offset;
+    Eigen::Vector3f max_corner;
+    int32_t num_objects;
+  };
+
+  // Sets the box of a leaf to the bounds of its objects.
+  void ComputeLeafBox(Node* node) const;
+
+  // Visits the leaves a ray enters, nearest first, skipping the nodes beyond
+  // the nearest hit. Returns true if a leaf reported a hit, and its distance.
+  bool TraverseRay(const Eigen::Vector3f& origin,
+                   const Eigen::Vector3f& direction,
+                   const float max_distance,
+                   const RayLeafIntersection& intersect_leaf,
+                   float* nearest_distance) const;
+
+  // Returns the range of object_indices_ of the objects below a node.
+  void GetObjectRange(const int node, int* first, int* end) const;
+
+  std::vector<Node> nodes_;
+  std::vector<Eigen::AlignedBox3f> object_bounds_;
+  // The objects, ordered so that the objects of every node are contiguous.
+  std::vector<int> object_indices_;
+  // The parent of every node, and the leaf of every object.
+  std::vector<int> parents_;
+  std::vector<int> object_leaves_;
+  // The leaves holding objects whose bounds changed since the last refit.
+  std::vector<int> dirty_leaves_;
+  std::vector<uint8_t> dirty_;
+
+  BoundingVolumeHierarchy(const BoundingVolumeHierarchy&) = delete;
+  BoundingVolumeHierarchy& operator=(const BoundingVolumeHierarchy&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_BOUNDING_VOLUME_HIERARCHY_H_
@@ -0,0 +1,210 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "buffer_allocator.h"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+#include "gpu_resources.h"
+
+namespace wvu {
+namespace {
+// Both extensions report kilobytes.
+constexpr GLint64 kBytesPerKilobyte = 1024;
+
+}  // namespace
+
+bool QueryGpuMemoryInfo(GpuMemoryInfo* info) {
+  if (GLEW_NVX_gpu_memory_info) {
+    GLint total_kilobytes = 0;
+    GLint available_kilobytes = 0;
+    glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &total_kilobytes);
+    glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX,
+                  &available_kilobytes);
+    info->total_bytes = total_kilobytes * kBytesPerKilobyte;
+    info->available_bytes = available_kilobytes * kBytesPerKilobyte;
+    return true;
+  }
+  if (GLEW_ATI_meminfo) {
+    // The first value is the free memory of the pool, followed by the largest
+    // free block and the free auxiliary memory. The total is not reported.
+    GLint free_memory[4] = {0, 0, 0, 0};
+    glGetIntegerv(GL_VBO_FREE_MEMORY_ATI, free_memory);
+    info->total_bytes = -1;
+    info->available_bytes = free_memory[0] * kBytesPerKilobyte;
+    return true;
+  }
+  return false;
+}
+
+BufferAllocator::BufferAllocator() : budget_(0), next_callback_id_(0) {}
+
+BufferAllocator* BufferAllocator::Get() {
+  static BufferAllocator allocator;
+  return &allocator;
+}
+
+GLuint BufferAllocator::CreateBuffer(const BufferCategory category) {
+  GLuint buffer_id = 0;
+  glGenBuffers(1, &buffer_id);
+  if (buffer_id == 0) return 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffers_[buffer_id] = BufferRecord{category, 0};
+  ++statistics_.num_buffers;
+  return buffer_id;
+}
+
+GLuint BufferAllocator::CreateNamedBuffer(const BufferCategory category) {
+  GLuint buffer_id = 0;
+  glCreateBuffers(1, &buffer_id);
+  if (buffer_id == 0) return 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffers_[buffer_id] = BufferRecord{category, 0};
+  ++statistics_.num_buffers;
+  return buffer_id;
+}
+
+void BufferAllocator::BufferData(const GLuint buffer_id,
+                                 const GLenum target,
+                                 const GLsizeiptr size,
+                                 const GLvoid* data,
+                                 const GLenum usage) {
+  glBufferData(target, size, data, usage);
+  Resize(buffer_id, size);
+}
+
+void BufferAllocator::BufferStorage(const GLuint buffer_id,
+                                    const GLenum target,
+                                    const GLsizeiptr size,
+                                    const GLvoid* data,
+                                    const GLbitfield flags) {
+  glBufferStorage(target, size, data, flags);
+  Resize(buffer_id, size);
+}
+
+void BufferAllocator::NamedBufferStorage(const GLuint buffer_id,
+                                         const GLsizeiptr size,
+                                         const GLvoid* data,
+                                         const GLbitfield flags) {
+  glNamedBufferStorage(buffer_id, size, data, flags);
+  Resize(buffer_id, size);
+}
+
+void BufferAllocator::DeleteBuffer(GLuint* buffer_id) {
+  if (*buffer_id == 0) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto buffer = buffers_.find(*buffer_id);
+    if (buffer != buffers_.end()) {
+      statistics_.live_bytes[buffer->second.category] -= buffer->second.size;
+      statistics_.total_live_bytes -= buffer->second.size;
+      --statistics_.num_buffers;
+      buffers_.erase(buffer);
+    }
+  }
+  // The storage is freed from the budget at once, but the buffer is only
+  // deleted after the frames in flight using it.
+  GpuResources::Get()->Retire(GPU_BUFFER, *buffer_id);
+  *buffer_id = 0;
+}
+
+void BufferAllocator::set_budget(const GLsizeiptr budget) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_ = budget;
+}
+
+GLsizeiptr BufferAllocator::budget() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return budget_;
+}
+
+int BufferAllocator::AddEvictionCallback(const EvictionCallback& callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  eviction_callbacks_.emplace_back(next_callback_id_, callback);
+  return next_callback_id_++;
+}
+
+void BufferAllocator::RemoveEvictionCallback(const int callback_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  eviction_callbacks_.erase(
+      std::remove_if(eviction_callbacks_.begin(), eviction_callbacks_.end(),
+                     [callback_id](
+                         const std::pair<int, EvictionCallback>& callback) {
+                       return callback.first == callback_id;
+                     }),
+      eviction_callbacks_.end());
+}
+
+bool BufferAllocator::EnforceBudget() {
+  std::vector<std::pair<int, EvictionCallback> > callbacks;
+  GLsizeiptr excess;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (budget_ == 0 || statistics_.total_live_bytes <= budget_) return true;
+    excess = statistics_.total_live_bytes - budget_;
+    callbacks = eviction_callbacks_;
+    ++statistics_.num_evictions;
+  }
+  // The callbacks run without the lock, since they delete buffers.
+  for (const std::pair<int, EvictionCallback>& callback : callbacks) {
+    callback.second(excess);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (statistics_.total_live_bytes <= budget_) return true;
+    excess = statistics_.total_live_bytes - budget_;
+  }
+  return false;
+}
+
+BufferMemoryStatistics BufferAllocator::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+void BufferAllocator::Resize(const GLuint buffer_id, const GLsizeiptr size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto buffer = buffers_.find(buffer_id);
+  if (buffer == buffers_.end()) return;
+  const GLsizeiptr growth = size - buffer->second.size;
+  buffer->second.size = size;
+  statistics_.live_bytes[buffer->second.category] += growth;
+  statistics_.total_live_bytes += growth;
+  statistics_.peak_bytes =
+      std::max(statistics_.peak_bytes, statistics_.total_live_bytes);
+}
+
+}  // namespace wvu
@@ -0,0 +1,185 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_BUFFER_ALLOCATOR_H_
+#define GLUTILS_BUFFER_ALLOCATOR_H_
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+// What the storage of a buffer holds, for the memory statistics.
+enum BufferCategory {
+  VERTEX_DATA = 0,
+  INDEX_DATA,
+  UNIFORM_DATA,
+  // Buffers transferring data between the CPU and the GPU, e.g., the ring
+  // buffer, the staging buffer of the mesh uploader and the readback buffers.
+  STAGING_DATA,
+  // Shader storage, atomic counter and indirect command buffers.
+  STORAGE_DATA,
+  NUM_BUFFER_CATEGORIES
+};
+
+// Memory reported by the driver, in bytes. The fields are -1 when unknown.
+struct GpuMemoryInfo {
+  // Dedicated video memory.
+  GLint64 total_bytes = -1;
+  // Video memory currently free.
+  GLint64 available_bytes = -1;
+};
+
+// Queries the memory of the GPU through GL_NVX_gpu_memory_info or
+// GL_ATI_meminfo. Returns false if neither extension is available.
+bool QueryGpuMemoryInfo(GpuMemoryInfo* info);
+
+// Live buffer storage, in bytes.
+struct BufferMemoryStatistics {
+  GLsizeiptr live_bytes[NUM_BUFFER_CATEGORIES] = {0};
+  GLsizeiptr total_live_bytes = 0;
+  // Maximum of total_live_bytes since the start.
+  GLsizeiptr peak_bytes = 0;
+  int num_buffers = 0;
+  // Number of times EnforceBudget() ran the eviction callbacks.
+  int num_evictions = 0;
+};
+
+// This class creates, resizes and deletes the buffers of the library, and
+// keeps the bytes of storage they hold per category. A budget bounds the total
+// bytes: allocations never fail because of it, but EnforceBudget() asks the
+// owners of the buffers to evict data until the total fits again. Call it once
+// per frame from the render thread, so that the callbacks may delete vertex
+// array objects, which are not shared between contexts. The allocator is
+// shared by all the threads, since the buffers of shared contexts are.
+//
+// Example:
+//
+// wvu::BufferAllocator* allocator = wvu::BufferAllocator::Get();
+// allocator->set_budget(256 << 20);
+// allocator->AddEvictionCallback([&](const GLsizeiptr num_bytes) {
+//   ...  // Delete the meshes not seen recently.
+// });
+// while (...) {  // Rendering loop.
+//   allocator->EnforceBudget();
+//   ...
+// }
+class BufferAllocator {
+ public:
+  // Asks the owner of some buffers to free at least num_bytes, if possible.
+  typedef std::function<void(const GLsizeiptr num_bytes)> EvictionCallback;
+
+  BufferAllocator();
+  ~BufferAllocator() {}
+
+  // Returns the allocator of the process.
+  static BufferAllocator* Get();
+
+  // Creates a buffer without storage. Returns the buffer id.
+  GLuint CreateBuffer(const BufferCategory category);
+
+  // Creates a buffer object through glCreateBuffers(), so that the direct
+  // state access functions edit it without binding it first. Needs OpenGL 4.5
+  // or GL_ARB_direct_state_access. Returns the buffer id.
+  GLuint CreateNamedBuffer(const BufferCategory category);
+
+  // Replaces the storage of the buffer through glBufferData(). The buffer must
+  // be bound to target.
+  void BufferData(const GLuint buffer_id,
+                  const GLenum target,
+                  const GLsizeiptr size,
+                  const GLvoid* data,
+                  const GLenum usage);
+
+  // Allocates immutable storage for the buffer through glBufferStorage(). The
+  // buffer must be bound to target.
+  void BufferStorage(const GLuint buffer_id,
+                     const GLenum target,
+                     const GLsizeiptr size,
+                     const GLvoid* data,
+                     const GLbitfield flags);
+
+  // Allocates immutable storage for a buffer of CreateNamedBuffer() through
+  // glNamedBufferStorage(), without binding it.
+  void NamedBufferStorage(const GLuint buffer_id,
+                          const GLsizeiptr size,
+                          const GLvoid* data,
+                          const GLbitfield flags);
+
+  // Deletes the buffer through the state cache of the calling thread, and sets
+  // the id to 0. Does nothing if the id is 0.
+  void DeleteBuffer(GLuint* buffer_id);
+
+  // Sets the budget of the total bytes. Zero disables it.
+  void set_budget(const GLsizeiptr budget);
+
+  GLsizeiptr budget() const;
+
+  // Registers a callback run by EnforceBudget(). Returns its id.
+  int AddEvictionCallback(const EvictionCallback& callback);
+
+  void RemoveEvictionCallback(const int callback_id);
+
+  // Runs the eviction callbacks, in the order they were added, until the total
+  // bytes fit the budget. Returns false if they still exceed it.
+  bool EnforceBudget();
+
+  BufferMemoryStatistics statistics() const;
+
+ private:
+  struct BufferRecord {
+    BufferCategory category;
+    GLsizeiptr size;
+  };
+
+  // Sets the tracked size of the buffer.
+  void Resize(const GLuint buffer_id, const GLsizeiptr size);
+
+  mutable std::mutex mutex_;
+  std::unordered_map<GLuint, BufferRecord> buffers_;
+  BufferMemoryStatistics statistics_;
+  GLsizeiptr budget_;
+  int next_callback_id_;
+  std::vector<std::pair<int, EvictionCallback> > eviction_callbacks_;
+
+  BufferAllocator(const BufferAllocator&) = delete;
+  BufferAllocator& operator=(const BufferAllocator&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_BUFFER_ALLOCATOR_H_
@@ -0,0 +1,216 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "buffer_arena.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+
+namespace wvu {
+
+BufferArena::BufferArena(const GLsizeiptr element_size,
+                         const BufferCategory category)
+    : element_size_(element_size),
+      category_(category),
+      buffer_id_(0),
+      capacity_(0),
+      num_used_elements_(0) {}
+
+BufferArena::~BufferArena() {
+  BufferAllocator::Get()->DeleteBuffer(&buffer_id_);
+}
+
+bool BufferArena::Initialize(const int capacity) {
+  if (buffer_id_ != 0 || capacity <= 0) return false;
+  BufferAllocator* allocator = BufferAllocator::Get();
+  GlStateCache* gl_state = GlStateCache::Current();
+  buffer_id_ = allocator->CreateBuffer(category_);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, buffer_id_);
+  allocator->BufferData(buffer_id_, GL_COPY_WRITE_BUFFER,
+                        capacity * element_size_, nullptr, GL_STATIC_DRAW);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  capacity_ = capacity;
+  AddFreeRange(0, capacity);
+  return buffer_id_ != 0;
+}
+
+int BufferArena::Allocate(const int num_elements) {
+  if (num_elements <= 0) return -1;
+  // The smallest free range that fits.
+  auto fit = free_ranges_by_size_.lower_bound(num_elements);
+  if (fit == free_ranges_by_size_.end()) return -1;
+  const int offset = fit->second;
+  const int free_size = fit->first;
+  RemoveFreeRange(free_ranges_by_offset_.find(offset));
+  if (free_size > num_elements) {
+    AddFreeRange(offset + num_elements, free_size - num_elements);
+  }
+  int handle;
+  if (free_handles_.empty()) {
+    handle = ranges_.size();
+    ranges_.emplace_back();
+  } else {
+    handle = free_handles_.back();
+    free_handles_.pop_back();
+  }
+  Range& range = ranges_[handle];
+  range.offset = offset;
+  range.size = num_elements;
+  range.live = true;
+  num_used_elements_ += num_elements;
+  return handle;
+}
+
+void BufferArena::Free(const int handle) {
+  Range& range = ranges_[handle];
+  if (!range.live) return;
+  AddFreeRange(range.offset, range.size);
+  num_used_elements_ -= range.size;
+  range.live = false;
+  free_handles_.push_back(handle);
+}
+
+void BufferArena::Upload(const int handle, const GLvoid* data) {
+  const Range& range = ranges_[handle];
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, buffer_id_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, range.offset * element_size_,
+                  range.size * element_size_, data);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+bool BufferArena::Defragment() {
+  std::vector<int> live_handles;
+  for (int handle = 0; handle < static_cast<int>(ranges_.size()); ++handle) {
+    if (ranges_[handle].live) live_handles.push_back(handle);
+  }
+  std::sort(live_handles.begin(), live_handles.end(),
+            [this](const int lhs, const int rhs) {
+              return ranges_[lhs].offset < ranges_[rhs].offset;
+            });
+  // Find the first range that moves; the ones before it are already packed.
+  int packed_size = 0;
+  size_t first_moved = 0;
+  while (first_moved < live_handles.size() &&
+         ranges_[live_handles[first_moved]].offset == packed_size) {
+    packed_size += ranges_[live_handles[first_moved]].size;
+    ++first_moved;
+  }
+  if (first_moved == live_handles.size()) return false;
+
+  // Source and destination ranges in the same buffer may overlap, so the
+  // moved elements are packed into a temporary buffer and copied back.
+  BufferAllocator* allocator = BufferAllocator::Get();
+  GlStateCache* gl_state = GlStateCache::Current();
+  GLuint temporary_buffer_id = allocator->CreateBuffer(STAGING_DATA);
+  gl_state->BindBuffer(GL_COPY_READ_BUFFER, buffer_id_);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, temporary_buffer_id);
+  allocator->BufferData(temporary_buffer_id, GL_COPY_WRITE_BUFFER,
+                        (num_used_elements_ - packed_size) * element_size_,
+                        nullptr, GL_STREAM_COPY);
+  int temporary_size = 0;
+  for (size_t i = first_moved; i < live_handles.size(); ++i) {
+    const Range& range = ranges_[live_handles[i]];
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        range.offset * element_size_,
+                        temporary_size * element_size_,
+                        range.size * element_size_);
+    temporary_size += range.size;
+  }
+  gl_state->BindBuffer(GL_COPY_READ_BUFFER, temporary_buffer_id);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, buffer_id_);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                      packed_size * element_size_,
+                      temporary_size * element_size_);
+  gl_state->BindBuffer(GL_COPY_READ_BUFFER, 0);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  allocator->DeleteBuffer(&temporary_buffer_id);
+
+  for (size_t i = first_moved; i < live_handles.size(); ++i) {
+    Range& range = ranges_[live_handles[i]];
+    range.offset = packed_size;
+    packed_size += range.size;
+  }
+  free_ranges_by_offset_.clear();
+  free_ranges_by_size_.clear();
+  AddFreeRange(packed_size, capacity_ - packed_size);
+  return true;
+}
+
+int BufferArena::largest_free_range() const {
+  return free_ranges_by_size_.empty() ?
+      0 : free_ranges_by_size_.rbegin()->first;
+}
+
+void BufferArena::AddFreeRange(int offset, int size) {
+  if (size <= 0) return;
+  // Merge with the free range after it.
+  auto next = free_ranges_by_offset_.lower_bound(offset);
+  if (next != free_ranges_by_offset_.end() && next->first == offset + size) {
+    size += next->second;
+    next = std::next(next);
+    RemoveFreeRange(std::prev(next));
+  }
+  // Merge with the free range before it.
+  if (next != free_ranges_by_offset_.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset) {
+      offset = previous->first;
+      size += previous->second;
+      RemoveFreeRange(previous);
+    }
+  }
+  free_ranges_by_offset_.emplace(offset, size);
+  free_ranges_by_size_.emplace(size, offset);
+}
+
+void BufferArena::RemoveFreeRange(std::map<int, int>::iterator range) {
+  auto by_size = free_ranges_by_size_.equal_range(range->second);
+  for (auto it = by_size.first; it != by_size.second; ++it) {
+    if (it->second == range->first) {
+      free_ranges_by_size_.erase(it);
+      break;
+    }
+  }
+  free_ranges_by_offset_.erase(range);
+}
+
+}  // namespace wvu
@@ -0,0 +1,155 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_BUFFER_ARENA_H_
+#define GLUTILS_BUFFER_ARENA_H_
+
+#include <map>
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_allocator.h"
+
+namespace wvu {
+// This class sub-allocates ranges of elements, e.g., vertices or indices, from
+// a single large buffer, so that thousands of small meshes do not need a
+// buffer object each. The free ranges are kept in a free list ordered by
+// offset, which merges adjacent ranges when a range is freed, and indexed by
+// size, so that an allocation takes the smallest free range that fits (best
+// fit). Freed ranges leave holes; Defragment() packs the live ranges at the
+// start of the buffer. Ranges are referenced by handles, since their offsets
+// change when the arena is defragmented.
+//
+// Example:
+//
+// wvu::BufferArena vertices(sizeof(wvu::StandardVertex), wvu::VERTEX_DATA);
+// vertices.Initialize(1 << 20);
+// const int range = vertices.Allocate(model.num_vertices());
+// vertices.Upload(range, model.vertex_data().data());
+// ...  // Draw with vertices.offset(range) as the base vertex.
+// vertices.Free(range);
+class BufferArena {
+ public:
+  // Parameters:
+  //   element_size  The size of an element in bytes. Offsets are multiples of
+  //     it.
+  //   category  The category whose memory statistics the buffer counts in.
+  BufferArena(const GLsizeiptr element_size, const BufferCategory category);
+  ~BufferArena();
+
+  // Allocates the buffer. Returns true if successful.
+  // Parameters:
+  //   capacity  The number of elements the buffer holds.
+  bool Initialize(const int capacity);
+
+  // Reserves num_elements consecutive elements. Returns the handle of the
+  // range, or -1 if no free range is large enough.
+  int Allocate(const int num_elements);
+
+  // Releases a range. Its handle may be reused by later allocations.
+  void Free(const int handle);
+
+  // Copies the elements of a range from data, which holds
+  // size(handle) * element_size() bytes.
+  void Upload(const int handle, const GLvoid* data);
+
+  // Moves the live ranges to the start of the buffer, in the order of their
+  // offsets, so that the free elements form a single range. The copies run on
+  // the GPU through a temporary buffer. Returns true if any range moved; the
+  // offsets used by recorded draws must then be refreshed.
+  bool Defragment();
+
+  // Returns the offset of a range, in elements.
+  int offset(const int handle) const {
+    return ranges_[handle].offset;
+  }
+
+  // Returns the number of elements of a range.
+  int size(const int handle) const {
+    return ranges_[handle].size;
+  }
+
+  GLuint buffer_id() const {
+    return buffer_id_;
+  }
+
+  GLsizeiptr element_size() const {
+    return element_size_;
+  }
+
+  int capacity() const {
+    return capacity_;
+  }
+
+  // Returns the number of elements held by live ranges.
+  int num_used_elements() const {
+    return num_used_elements_;
+  }
+
+  // Returns the size of the largest free range, which bounds the size of the
+  // next allocation.
+  int largest_free_range() const;
+
+ private:
+  struct Range {
+    int offset = 0;
+    int size = 0;
+    bool live = false;
+  };
+
+  // Adds a free range to the free list, merging it with its neighbors.
+  void AddFreeRange(int offset, int size);
+
+  // Removes a free range, given the iterator to its entry by offset.
+  void RemoveFreeRange(std::map<int, int>::iterator range);
+
+  const GLsizeiptr element_size_;
+  const BufferCategory category_;
+  GLuint buffer_id_;
+  int capacity_;
+  int num_used_elements_;
+  // Ranges indexed by handle, and the handles of the freed ones.
+  std::vector<Range> ranges_;
+  std::vector<int> free_handles_;
+  // Free ranges: size by offset, and offset by size.
+  std::map<int, int> free_ranges_by_offset_;
+  std::multimap<int, int> free_ranges_by_size_;
+
+  BufferArena(const BufferArena&) = delete;
+  BufferArena& operator=(const BufferArena&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_BUFFER_ARENA_H_
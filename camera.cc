@@ -0,0 +1,128 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "camera.h"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "transforms.h"
+
+namespace wvu {
+
+Camera::Camera()
+    : position_(Eigen::Vector3f::Zero()),
+      orientation_(Eigen::Quaternionf::Identity()),
+      field_of_view_(kHalfPi),
+      aspect_ratio_(1.0f),
+      near_(0.1f),
+      far_(100.0f),
+      version_(1),
+      view_dirty_(true),
+      projection_dirty_(true) {}
+
+void Camera::SetPosition(const Eigen::Vector3f& position) {
+  if (position == position_) return;
+  position_ = position;
+  view_dirty_ = true;
+  ++version_;
+}
+
+void Camera::SetOrientation(const Eigen::Quaternionf& orientation) {
+  const Eigen::Quaternionf normalized = orientation.normalized();
+  if (normalized.coeffs() == orientation_.coeffs()) return;
+  orientation_ = normalized;
+  view_dirty_ = true;
+  ++version_;
+}
+
+void Camera::LookAt(const Eigen::Vector3f& eye,
+                    const Eigen::Vector3f& target,
+                    const Eigen::Vector3f& up) {
+  // The columns of the rotation are the axes of the camera in world space.
+  const Eigen::Vector3f z = (eye - target).normalized();
+  const Eigen::Vector3f x = up.cross(z).normalized();
+  Eigen::Matrix3f rotation;
+  rotation.col(0) = x;
+  rotation.col(1) = z.cross(x);
+  rotation.col(2) = z;
+  SetPosition(eye);
+  SetOrientation(Eigen::Quaternionf(rotation));
+}
+
+void Camera::SetPerspective(const float field_of_view,
+                            const float aspect_ratio,
+                            const float near,
+                            const float far) {
+  if (field_of_view == field_of_view_ && aspect_ratio == aspect_ratio_ &&
+      near == near_ && far == far_) {
+    return;
+  }
+  field_of_view_ = field_of_view;
+  aspect_ratio_ = aspect_ratio;
+  near_ = near;
+  far_ = far;
+  projection_dirty_ = true;
+  ++version_;
+}
+
+void Camera::SetAspectRatio(const float aspect_ratio) {
+  SetPerspective(field_of_view_, aspect_ratio, near_, far_);
+}
+
+void Camera::Update() const {
+  if (!view_dirty_ && !projection_dirty_) return;
+  if (view_dirty_) {
+    // The inverse of a rigid transformation is its transpose rotation and the
+    // rotated negated translation.
+    const Eigen::Matrix3f rotation = orientation_.toRotationMatrix();
+    inverse_view_.setIdentity();
+    inverse_view_.topLeftCorner<3, 3>() = rotation;
+    inverse_view_.topRightCorner<3, 1>() = position_;
+    view_.setIdentity();
+    view_.topLeftCorner<3, 3>() = rotation.transpose();
+    view_.topRightCorner<3, 1>() = -(rotation.transpose() * position_);
+    view_dirty_ = false;
+  }
+  if (projection_dirty_) {
+    projection_ = ComputeProjectionMatrix(field_of_view_, aspect_ratio_, near_,
+                                          far_);
+    projection_dirty_ = false;
+  }
+  view_projection_ = projection_ * view_;
+  inverse_view_projection_ = view_projection_.inverse();
+  frustum_planes_ = ExtractFrustumPlanes(view_projection_);
+}
+
+}  // namespace wvu
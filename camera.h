@@ -0,0 +1,213 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_CAMERA_H_
+#define GLUTILS_CAMERA_H_
+
+#include <cstdint>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "transforms.h"
+
+namespace wvu {
+// This class holds the pose and the lens of a perspective camera, and caches
+// the matrices derived from them: the view, the projection, their product,
+// their inverses and the planes of the frustum. The setters only invalidate
+// the cache when a value actually changes, and the matrices are recomputed on
+// the first access after that: a change of the pose recomputes the view, and a
+// change of the lens recomputes the projection. Every change also increments
+// the version of the camera, so that the caches that depend on it, e.g., the
+// visible objects, the shadow cascades or the uniform buffers, compare the
+// version they were built with instead of the matrices, and update lazily.
+// The camera looks down its -z axis, with y up, as OpenGL does.
+//
+// Example:
+//
+// wvu::Camera camera;
+// camera.SetPerspective(field_of_view, width / height, 0.1f, 100.0f);
+// int64_t culled_version = 0;
+// while (...) {  // Rendering loop.
+//   camera.LookAt(eye, target, Eigen::Vector3f::UnitY());
+//   if (camera.Changed(&culled_version)) {
+//     visible_objects.clear();
+//     bvh.QueryFrustum(camera.view_projection(), &visible_objects);
+//   }
+//   frame_uniforms.Update(camera.view(), camera.projection(), time,
+//                         delta_time);
+//   ...
+// }
+//
+// The cache is computed by the accessors, so a camera that other threads read
+// must be accessed once on its thread after it changes, e.g., by calling
+// Update().
+class Camera {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  // The camera is at the origin looking down -z, with a field of view of 90
+  // degrees over a square image between the planes at 0.1 and 100.
+  Camera();
+  ~Camera() {}
+
+  // Sets the position of the camera in world space.
+  void SetPosition(const Eigen::Vector3f& position);
+
+  // Sets the rotation from the camera to world space. It is normalized.
+  void SetOrientation(const Eigen::Quaternionf& orientation);
+
+  // Places the camera at eye looking at target. The up vector must not be
+  // parallel to the direction of view.
+  void LookAt(const Eigen::Vector3f& eye,
+              const Eigen::Vector3f& target,
+              const Eigen::Vector3f& up);
+
+  // Sets the lens of the camera. See ComputePerspectiveProjection().
+  // Parameters:
+  //   field_of_view  The vertical field of view in radians.
+  //   aspect_ratio  The width over the height of the image.
+  //   near  The distance to the near plane.
+  //   far  The distance to the far plane.
+  void SetPerspective(const float field_of_view,
+                      const float aspect_ratio,
+                      const float near,
+                      const float far);
+
+  // Sets the aspect ratio of the image, e.g., when the window is resized.
+  void SetAspectRatio(const float aspect_ratio);
+
+  // Recomputes the cached matrices if the camera changed.
+  void Update() const;
+
+  // Returns true if the camera changed since the version seen_version, which
+  // is then set to the current version. Versions start at 1, so an initial
+  // seen version of 0 reports a change.
+  bool Changed(int64_t* seen_version) const {
+    if (*seen_version == version_) return false;
+    *seen_version = version_;
+    return true;
+  }
+
+  // Returns the number of changes of the camera plus one.
+  int64_t version() const {
+    return version_;
+  }
+
+  const Eigen::Vector3f& position() const {
+    return position_;
+  }
+
+  const Eigen::Quaternionf& orientation() const {
+    return orientation_;
+  }
+
+  // Returns the unit direction of view in world space.
+  Eigen::Vector3f forward() const {
+    return -(orientation_ * Eigen::Vector3f::UnitZ());
+  }
+
+  float field_of_view() const {
+    return field_of_view_;
+  }
+
+  float aspect_ratio() const {
+    return aspect_ratio_;
+  }
+
+  float near() const {
+    return near_;
+  }
+
+  float far() const {
+    return far_;
+  }
+
+  // Returns the matrix mapping world to camera coordinates.
+  const Eigen::Matrix4f& view() const {
+    Update();
+    return view_;
+  }
+
+  // Returns the matrix mapping camera to world coordinates.
+  const Eigen::Matrix4f& inverse_view() const {
+    Update();
+    return inverse_view_;
+  }
+
+  const Eigen::Matrix4f& projection() const {
+    Update();
+    return projection_;
+  }
+
+  // Returns projection * view, which maps world coordinates to clip space.
+  const Eigen::Matrix4f& view_projection() const {
+    Update();
+    return view_projection_;
+  }
+
+  // Returns the inverse of view_projection(), e.g., to unproject points of
+  // the image or the corners of the frustum.
+  const Eigen::Matrix4f& inverse_view_projection() const {
+    Update();
+    return inverse_view_projection_;
+  }
+
+  // Returns the planes of the frustum in world space, with unit normals.
+  const FrustumPlanes& frustum_planes() const {
+    Update();
+    return frustum_planes_;
+  }
+
+ private:
+  Eigen::Vector3f position_;
+  Eigen::Quaternionf orientation_;
+  float field_of_view_;
+  float aspect_ratio_;
+  float near_;
+  float far_;
+  int64_t version_;
+  // The cache, and which of its parts are out of date.
+  mutable bool view_dirty_;
+  mutable bool projection_dirty_;
+  mutable Eigen::Matrix4f view_;
+  mutable Eigen::Matrix4f inverse_view_;
+  mutable Eigen::Matrix4f projection_;
+  mutable Eigen::Matrix4f view_projection_;
+  mutable Eigen::Matrix4f inverse_view_projection_;
+  mutable FrustumPlanes frustum_planes_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_CAMERA_H_
@@ -0,0 +1,440 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "clustered_lighting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "job_system.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Floats per light in the light buffer: the position and radius, and the
+// color.
+constexpr int kLightStride = 8;
+// Unsigned integers of the header of the grid buffer: the dimensions of the
+// grid, and the scale and bias of the slices and the inverse tile size.
+constexpr int kGridHeaderSize = 8;
+
+// Replaces the storage of a shader storage buffer with size bytes of data,
+// orphaning the storage read by the previous draws.
+void UploadStorage(const GLuint buffer_id,
+                   const void* data,
+                   const GLsizeiptr size) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_id);
+  // Empty buffers cannot be bound, so they keep a few bytes.
+  BufferAllocator::Get()->BufferData(buffer_id, GL_SHADER_STORAGE_BUFFER,
+                                     std::max<GLsizeiptr>(size, 16), nullptr,
+                                     GL_STREAM_DRAW);
+  if (size > 0) glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// Returns the squared distance from a point to a box.
+float SquaredDistanceToBox(const Eigen::Vector3f& point,
+                           const Eigen::Vector3f& box_min,
+                           const Eigen::Vector3f& box_max) {
+  const Eigen::Vector3f nearest = point.cwiseMax(box_min).cwiseMin(box_max);
+  return (point - nearest).squaredNorm();
+}
+
+}  // namespace
+
+const char ClusteredLighting::kLightsBlockName[] = "ClusterLights";
+const char ClusteredLighting::kGridBlockName[] = "ClusterGrid";
+const char ClusteredLighting::kLightIndicesBlockName[] = "ClusterLightIndices";
+
+ClusteredLighting::ClusteredLighting(const int grid_width,
+                                     const int grid_height,
+                                     const int grid_depth)
+    : grid_width_(std::max(grid_width, 1)),
+      grid_height_(std::max(grid_height, 1)),
+      grid_depth_(std::max(grid_depth, 1)),
+      lights_buffer_id_(0),
+      grid_buffer_id_(0),
+      light_indices_buffer_id_(0),
+      projection_(Eigen::Matrix4f::Zero()),
+      framebuffer_width_(0),
+      framebuffer_height_(0),
+      near_distance_(0.0f),
+      far_distance_(0.0f),
+      slices_(grid_depth_) {}
+
+ClusteredLighting::~ClusteredLighting() {
+  Reset();
+}
+
+bool ClusteredLighting::Supported() {
+  return GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object;
+}
+
+bool ClusteredLighting::Initialize(std::string* error_info_log) {
+  if (!Supported()) {
+    *error_info_log = "Clustered lighting needs shader storage buffers.";
+    return false;
+  }
+  if (lights_buffer_id_ != 0) return true;
+  BufferAllocator* allocator = BufferAllocator::Get();
+  lights_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+  grid_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+  light_indices_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+  if (lights_buffer_id_ == 0 || grid_buffer_id_ == 0 ||
+      light_indices_buffer_id_ == 0) {
+    *error_info_log = "Could not create the cluster buffers.";
+    return false;
+  }
+  return true;
+}
+
+bool ClusteredLighting::Attach(ShaderProgram* shader_program) const {
+  return shader_program->BindShaderStorageBlock(kLightsBlockName,
+                                                kClusterLightsBindingPoint) &&
+      shader_program->BindShaderStorageBlock(kGridBlockName,
+                                             kClusterGridBindingPoint) &&
+      shader_program->BindShaderStorageBlock(kLightIndicesBlockName,
+                                             kClusterLightIndicesBindingPoint);
+}
+
+void ClusteredLighting::ComputeClusterBounds(
+    const Eigen::Matrix4f& projection,
+    const int framebuffer_width,
+    const int framebuffer_height) {
+  projection_ = projection;
+  framebuffer_width_ = framebuffer_width;
+  framebuffer_height_ = framebuffer_height;
+  // The depth row of a perspective projection is
+  // (-(f + n) / (f - n), -2 f n / (f - n)).
+  const float a = projection(2, 2);
+  const float b = projection(2, 3);
+  near_distance_ = b / (a - 1.0f);
+  far_distance_ = b / (a + 1.0f);
+  // Far planes at infinity have a = -1; the slices then end at a thousand
+  // times the near distance.
+  if (!(far_distance_ > near_distance_)) {
+    far_distance_ = 1000.0f * near_distance_;
+  }
+  slice_distances_.resize(grid_depth_ + 1);
+  const float ratio = far_distance_ / near_distance_;
+  for (int z = 0; z <= grid_depth_; ++z) {
+    slice_distances_[z] = near_distance_ *
+        std::pow(ratio, static_cast<float>(z) / grid_depth_);
+  }
+  // A view-space point (x, y, -d) projects to x * P(0,0) / d, y * P(1,1) / d
+  // in normalized device coordinates, so the bounds of a tile at distance d
+  // scale with d.
+  cluster_bounds_.resize(num_clusters());
+  const float x_scale = 1.0f / projection(0, 0);
+  const float y_scale = 1.0f / projection(1, 1);
+  for (int z = 0; z < grid_depth_; ++z) {
+    const float d0 = slice_distances_[z];
+    const float d1 = slice_distances_[z + 1];
+    for (int y = 0; y < grid_height_; ++y) {
+      const float ndc_y0 = 2.0f * y / grid_height_ - 1.0f;
+      const float ndc_y1 = 2.0f * (y + 1) / grid_height_ - 1.0f;
+      for (int x = 0; x < grid_width_; ++x) {
+        const float ndc_x0 = 2.0f * x / grid_width_ - 1.0f;
+        const float ndc_x1 = 2.0f * (x + 1) / grid_width_ - 1.0f;
+        ClusterBounds& bounds =
+            cluster_bounds_[(z * grid_height_ + y) * grid_width_ + x];
+        bounds.min.x() =
+            std::min(ndc_x0 * d0, ndc_x0 * d1) * x_scale;
+        bounds.max.x() =
+            std::max(ndc_x1 * d0, ndc_x1 * d1) * x_scale;
+        bounds.min.y() =
+            std::min(ndc_y0 * d0, ndc_y0 * d1) * y_scale;
+        bounds.max.y() =
+            std::max(ndc_y1 * d0, ndc_y1 * d1) * y_scale;
+        bounds.min.z() = -d1;
+        bounds.max.z() = -d0;
+      }
+    }
+  }
+}
+
+void ClusteredLighting::ComputeLightRange(const PointLight& light,
+                                          const Eigen::Matrix4f& view,
+                                          ViewLight* view_light) const {
+  const Eigen::Vector4f position =
+      view * Eigen::Vector4f(light.position.x(), light.position.y(),
+                             light.position.z(), 1.0f);
+  view_light->position = position.head<3>();
+  view_light->radius = light.radius;
+  const float distance = -position.z();
+  const float radius = light.radius;
+  // Lights behind the camera or beyond the far plane touch no cluster.
+  if (distance + radius < near_distance_ ||
+      distance - radius > far_distance_) {
+    view_light->min_slice = 1;
+    view_light->max_slice = 0;
+    return;
+  }
+  const float log_ratio = std::log(far_distance_ / near_distance_);
+  const auto slice_of = [&](const float d) {
+    if (d <= near_distance_) return 0;
+    const int slice = static_cast<int>(
+        std::log(d / near_distance_) / log_ratio * grid_depth_);
+    return std::min(slice, grid_depth_ - 1);
+  };
+  view_light->min_slice = slice_of(distance - radius);
+  view_light->max_slice = slice_of(distance + radius);
+  view_light->min_tile_x = 0;
+  view_light->max_tile_x = grid_width_ - 1;
+  view_light->min_tile_y = 0;
+  view_light->max_tile_y = grid_height_ - 1;
+  // Spheres crossing the near plane may cover any tile. Otherwise the
+  // projection of their bounding box is bounded by the projections of its
+  // corners.
+  if (distance - radius <= near_distance_) return;
+  float min_x = 1.0f, max_x = -1.0f, min_y = 1.0f, max_y = -1.0f;
+  for (int corner = 0; corner < 8; ++corner) {
+    const float x = position.x() + (corner & 1 ? radius : -radius);
+    const float y = position.y() + (corner & 2 ? radius : -radius);
+    const float d = distance + (corner & 4 ? radius : -radius);
+    const float ndc_x = x * projection_(0, 0) / d;
+    const float ndc_y = y * projection_(1, 1) / d;
+    min_x = std::min(min_x, ndc_x);
+    max_x = std::max(max_x, ndc_x);
+    min_y = std::min(min_y, ndc_y);
+    max_y = std::max(max_y, ndc_y);
+  }
+  const auto tile_of = [](const float ndc, const int num_tiles) {
+    const int tile = static_cast<int>(std::floor(0.5f * (ndc + 1.0f) *
+                                                 num_tiles));
+    return std::min(std::max(tile, 0), num_tiles - 1);
+  };
+  view_light->min_tile_x = tile_of(min_x, grid_width_);
+  view_light->max_tile_x = tile_of(max_x, grid_width_);
+  view_light->min_tile_y = tile_of(min_y, grid_height_);
+  view_light->max_tile_y = tile_of(max_y, grid_height_);
+  if (max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f) {
+    view_light->min_slice = 1;
+    view_light->max_slice = 0;
+  }
+}
+
+void ClusteredLighting::AssignSlice(const int slice) {
+  SliceLists& lists = slices_[slice];
+  const int num_slice_clusters = grid_width_ * grid_height_;
+  lists.clusters.assign(2 * num_slice_clusters, 0);
+  lists.light_indices.clear();
+  for (int y = 0; y < grid_height_; ++y) {
+    for (int x = 0; x < grid_width_; ++x) {
+      const int cluster = y * grid_width_ + x;
+      const ClusterBounds& bounds =
+          cluster_bounds_[slice * num_slice_clusters + cluster];
+      const uint32_t first_index = lists.light_indices.size();
+      for (size_t i = 0; i < view_lights_.size(); ++i) {
+        const ViewLight& light = view_lights_[i];
+        if (slice < light.min_slice || slice > light.max_slice ||
+            x < light.min_tile_x || x > light.max_tile_x ||
+            y < light.min_tile_y || y > light.max_tile_y) {
+          continue;
+        }
+        if (SquaredDistanceToBox(light.position, bounds.min, bounds.max) <=
+            light.radius * light.radius) {
+          lists.light_indices.push_back(i);
+        }
+      }
+      lists.clusters[2 * cluster] = first_index;
+      lists.clusters[2 * cluster + 1] =
+          lists.light_indices.size() - first_index;
+    }
+  }
+}
+
+void ClusteredLighting::Update(const PointLight* lights,
+                               const int num_lights,
+                               const Eigen::Matrix4f& view,
+                               const Eigen::Matrix4f& projection,
+                               const int framebuffer_width,
+                               const int framebuffer_height,
+                               JobSystem* job_system) {
+  if (projection != projection_ || framebuffer_width != framebuffer_width_ ||
+      framebuffer_height != framebuffer_height_) {
+    ComputeClusterBounds(projection, framebuffer_width, framebuffer_height);
+  }
+  statistics_ = ClusteredLightingStatistics();
+  statistics_.num_lights = num_lights;
+  view_lights_.resize(num_lights);
+  packed_lights_.resize(num_lights * kLightStride);
+  for (int i = 0; i < num_lights; ++i) {
+    ComputeLightRange(lights[i], view, &view_lights_[i]);
+    if (view_lights_[i].min_slice <= view_lights_[i].max_slice) {
+      ++statistics_.num_visible_lights;
+    }
+    float* packed = &packed_lights_[i * kLightStride];
+    packed[0] = view_lights_[i].position.x();
+    packed[1] = view_lights_[i].position.y();
+    packed[2] = view_lights_[i].position.z();
+    packed[3] = lights[i].radius;
+    packed[4] = lights[i].color.x();
+    packed[5] = lights[i].color.y();
+    packed[6] = lights[i].color.z();
+    packed[7] = 1.0f;
+  }
+  // Every slice writes its own lists, so the jobs share no data.
+  if (job_system != nullptr) {
+    job_system->ParallelFor(grid_depth_, 1,
+                            [this](const int begin, const int end) {
+      for (int slice = begin; slice < end; ++slice) AssignSlice(slice);
+    });
+  } else {
+    for (int slice = 0; slice < grid_depth_; ++slice) AssignSlice(slice);
+  }
+
+  // Concatenate the lists of the slices, offsetting their first entries.
+  const int num_slice_clusters = grid_width_ * grid_height_;
+  grid_data_.resize(kGridHeaderSize + 2 * num_clusters());
+  grid_data_[0] = grid_width_;
+  grid_data_[1] = grid_height_;
+  grid_data_[2] = grid_depth_;
+  grid_data_[3] = 0;
+  // The slice of a view distance d is log(d) * scale + bias.
+  const float log_ratio = std::log(far_distance_ / near_distance_);
+  const float depth_parameters[4] = {
+    grid_depth_ / log_ratio,
+    -grid_depth_ * std::log(near_distance_) / log_ratio,
+    static_cast<float>(grid_width_) / std::max(framebuffer_width, 1),
+    static_cast<float>(grid_height_) / std::max(framebuffer_height, 1)
+  };
+  std::memcpy(&grid_data_[4], depth_parameters, sizeof(depth_parameters));
+  light_indices_.clear();
+  for (int slice = 0; slice < grid_depth_; ++slice) {
+    const SliceLists& lists = slices_[slice];
+    const uint32_t offset = light_indices_.size();
+    uint32_t* clusters =
+        &grid_data_[kGridHeaderSize + 2 * slice * num_slice_clusters];
+    for (int cluster = 0; cluster < num_slice_clusters; ++cluster) {
+      clusters[2 * cluster] = offset + lists.clusters[2 * cluster];
+      clusters[2 * cluster + 1] = lists.clusters[2 * cluster + 1];
+      statistics_.max_lights_per_cluster =
+          std::max<int>(statistics_.max_lights_per_cluster,
+                        lists.clusters[2 * cluster + 1]);
+    }
+    light_indices_.insert(light_indices_.end(), lists.light_indices.begin(),
+                          lists.light_indices.end());
+  }
+  statistics_.num_light_indices = light_indices_.size();
+  if (lights_buffer_id_ == 0) return;
+  UploadStorage(lights_buffer_id_, packed_lights_.data(),
+                packed_lights_.size() * sizeof(float));
+  UploadStorage(grid_buffer_id_, grid_data_.data(),
+                grid_data_.size() * sizeof(uint32_t));
+  UploadStorage(light_indices_buffer_id_, light_indices_.data(),
+                light_indices_.size() * sizeof(uint32_t));
+}
+
+void ClusteredLighting::GetCluster(const int x,
+                                   const int y,
+                                   const int z,
+                                   int* first_index,
+                                   int* num_lights) const {
+  const int cluster = (z * grid_height_ + y) * grid_width_ + x;
+  *first_index = grid_data_[kGridHeaderSize + 2 * cluster];
+  *num_lights = grid_data_[kGridHeaderSize + 2 * cluster + 1];
+}
+
+void ClusteredLighting::Bind() const {
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                           kClusterLightsBindingPoint, lights_buffer_id_);
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER, kClusterGridBindingPoint,
+                           grid_buffer_id_);
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                           kClusterLightIndicesBindingPoint,
+                           light_indices_buffer_id_);
+}
+
+void ClusteredLighting::Reset() {
+  BufferAllocator* allocator = BufferAllocator::Get();
+  allocator->DeleteBuffer(&lights_buffer_id_);
+  allocator->DeleteBuffer(&grid_buffer_id_);
+  allocator->DeleteBuffer(&light_indices_buffer_id_);
+}
+
+std::string ClusteredLighting::GlslDeclaration() {
+  return std::string(
+      "#extension GL_ARB_shader_storage_buffer_object : enable\n"
+      "struct ClusterLight {\n"
+      "  vec4 position_radius;\n"
+      "  vec4 color;\n"
+      "};\n"
+      "layout (std430) readonly buffer ") + kLightsBlockName + " {\n"
+      "  ClusterLight cluster_lights[];\n"
+      "};\n"
+      "layout (std430) readonly buffer " + kGridBlockName + " {\n"
+      "  uvec4 cluster_dimensions;\n"
+      "  vec4 cluster_depth;\n"
+      "  uvec2 clusters[];\n"
+      "};\n"
+      "layout (std430) readonly buffer " + kLightIndicesBlockName + " {\n"
+      "  uint cluster_light_indices[];\n"
+      "};\n"
+      "vec3 ClusteredLighting(vec3 view_position, vec3 normal,\n"
+      "                       vec3 albedo) {\n"
+      "  float slice = log(max(-view_position.z, 1e-6)) * cluster_depth.x +\n"
+      "      cluster_depth.y;\n"
+      "  uvec3 cluster = min(uvec3(max(vec3(gl_FragCoord.xy *\n"
+      "                                     cluster_depth.zw, slice),\n"
+      "                                vec3(0.0))),\n"
+      "                      cluster_dimensions.xyz - uvec3(1u));\n"
+      "  uvec2 list = clusters[(cluster.z * cluster_dimensions.y +\n"
+      "                         cluster.y) * cluster_dimensions.x +\n"
+      "                        cluster.x];\n"
+      "  vec3 color = vec3(0.0);\n"
+      "  for (uint i = list.x; i < list.x + list.y; ++i) {\n"
+      "    ClusterLight light = cluster_lights[cluster_light_indices[i]];\n"
+      "    vec3 to_light = light.position_radius.xyz - view_position;\n"
+      "    float distance = length(to_light);\n"
+      "    float falloff = clamp(1.0 - distance / light.position_radius.w,\n"
+      "                          0.0, 1.0);\n"
+      "    color += albedo * light.color.rgb * falloff * falloff *\n"
+      "        max(dot(normal, to_light / max(distance, 1e-6)), 0.0);\n"
+      "  }\n"
+      "  return color;\n"
+      "}\n";
+}
+
+}  // namespace wvu
@@ -0,0 +1,262 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_CLUSTERED_LIGHTING_H_
+#define GLUTILS_CLUSTERED_LIGHTING_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include "job_system.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Shader storage buffer binding points reserved for the lights, the clusters
+// and the light lists of the clusters.
+constexpr GLuint kClusterLightsBindingPoint = 3;
+constexpr GLuint kClusterGridBindingPoint = 4;
+constexpr GLuint kClusterLightIndicesBindingPoint = 5;
+
+// Default number of clusters along the width, the height and the depth of the
+// view frustum.
+constexpr int kDefaultClusterGridWidth = 16;
+constexpr int kDefaultClusterGridHeight = 9;
+constexpr int kDefaultClusterGridDepth = 24;
+
+// A point light whose contribution falls to zero at its radius.
+struct PointLight {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  // The position in world space.
+  Eigen::Vector3f position = Eigen::Vector3f::Zero();
+  float radius = 1.0f;
+  // The color, scaled by the intensity.
+  Eigen::Vector3f color = Eigen::Vector3f::Ones();
+};
+
+// Contiguous array of lights. Eigen requires an aligned allocator for the
+// vectorizable members.
+typedef std::vector<PointLight, Eigen::aligned_allocator<PointLight> >
+    PointLights;
+
+// Counters of the last ClusteredLighting::Update().
+struct ClusteredLightingStatistics {
+  int num_lights = 0;
+  // Lights in front of the camera, assigned to at least one cluster.
+  int num_visible_lights = 0;
+  // Entries of all the light lists.
+  int num_light_indices = 0;
+  int max_lights_per_cluster = 0;
+};
+
+// This class shades many point lights with the clustered forward method
+// (Olsson et al., 2012): the view frustum is split into a grid of clusters,
+// tiles of the screen subdivided along depth with slices growing
+// exponentially from the near to the far plane, and every cluster lists the
+// lights whose spheres touch it. The fragment shader only loops over the lights
+// of its cluster, so the shading cost follows the lights per pixel rather than
+// the total number of lights. The lights are assigned on the CPU, one slice of
+// the grid per job of a JobSystem, and the lights, the clusters and their lists
+// are uploaded into shader storage buffers, which needs OpenGL 4.3 or
+// ARB_shader_storage_buffer_object.
+//
+// The fragment shaders include GlslDeclaration() right after their #version
+// line, of 400 or later, which declares:
+//
+//   // Returns the diffuse light reflected towards the camera by a surface
+//   // point, in view space, with the color albedo. The cluster is found from
+//   // gl_FragCoord.
+//   vec3 ClusteredLighting(vec3 view_position, vec3 normal, vec3 albedo);
+//
+// Example:
+//
+// wvu::ClusteredLighting lighting;
+// lighting.Initialize(&error_info_log);
+// lighting.Attach(&shader_program);
+// while (...) {  // Rendering loop.
+//   lighting.Update(lights.data(), lights.size(), view, projection,
+//                   framebuffer_width, framebuffer_height, &job_system);
+//   lighting.Bind();
+//   ...  // Draws.
+// }
+class ClusteredLighting {
+ public:
+  // Names of the storage blocks in the shaders.
+  static const char kLightsBlockName[];
+  static const char kGridBlockName[];
+  static const char kLightIndicesBlockName[];
+
+  // Parameters:
+  //   grid_width  The number of tiles along the width of the screen.
+  //   grid_height  The number of tiles along the height of the screen.
+  //   grid_depth  The number of slices along the depth of the frustum.
+  ClusteredLighting(const int grid_width = kDefaultClusterGridWidth,
+                    const int grid_height = kDefaultClusterGridHeight,
+                    const int grid_depth = kDefaultClusterGridDepth);
+  ~ClusteredLighting();
+
+  // Creates the buffers. Returns false if the context does not support shader
+  // storage buffers.
+  bool Initialize(std::string* error_info_log);
+
+  // Binds the storage blocks of a program declaring GlslDeclaration(). Returns
+  // false if the program does not declare them.
+  bool Attach(ShaderProgram* shader_program) const;
+
+  // Assigns the lights to the clusters of the frustum of a camera, and uploads
+  // the clusters and their lists. The bounds of the clusters are only
+  // recomputed when the projection or the size of the framebuffer change.
+  // Parameters:
+  //   lights  The num_lights lights, in world space.
+  //   num_lights  The number of lights.
+  //   view  The view matrix of the camera.
+  //   projection  A symmetric perspective projection, e.g., of
+  //     ComputeProjectionMatrix(), whose near and far planes bound the
+  //     slices.
+  //   framebuffer_width  The width in pixels of the framebuffer drawn.
+  //   framebuffer_height  The height in pixels of the framebuffer drawn.
+  //   job_system  Runs the assignment of the slices, or nullptr to assign
+  //     them on the calling thread.
+  void Update(const PointLight* lights,
+              const int num_lights,
+              const Eigen::Matrix4f& view,
+              const Eigen::Matrix4f& projection,
+              const int framebuffer_width,
+              const int framebuffer_height,
+              JobSystem* job_system);
+
+  // Binds the buffers for the next draws.
+  void Bind() const;
+
+  // Deletes the buffers.
+  void Reset();
+
+  // Returns the GLSL declaration of the blocks and of ClusteredLighting().
+  static std::string GlslDeclaration();
+
+  // Returns true if the context supports shader storage buffers.
+  static bool Supported();
+
+  int num_clusters() const {
+    return grid_width_ * grid_height_ * grid_depth_;
+  }
+
+  // Returns the index of the first entry of the list of a cluster and the
+  // number of lights in it, as uploaded by the last Update().
+  void GetCluster(const int x,
+                  const int y,
+                  const int z,
+                  int* first_index,
+                  int* num_lights) const;
+
+  // Returns the light indices of the lists of all the clusters.
+  const std::vector<uint32_t>& light_indices() const {
+    return light_indices_;
+  }
+
+  const ClusteredLightingStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // A light in view space and the clusters its sphere may touch.
+  struct ViewLight {
+    Eigen::Vector3f position;
+    float radius;
+    int min_tile_x, max_tile_x;
+    int min_tile_y, max_tile_y;
+    int min_slice, max_slice;
+  };
+
+  // The bounds of a cluster in view space.
+  struct ClusterBounds {
+    Eigen::Vector3f min;
+    Eigen::Vector3f max;
+  };
+
+  // The lists of the clusters of a slice, built by one job.
+  struct SliceLists {
+    // First entry, relative to the slice, and number of lights of every
+    // cluster of the slice.
+    std::vector<uint32_t> clusters;
+    std::vector<uint32_t> light_indices;
+  };
+
+  // Recomputes the bounds of the clusters and the depth of the slices.
+  void ComputeClusterBounds(const Eigen::Matrix4f& projection,
+                            const int framebuffer_width,
+                            const int framebuffer_height);
+
+  // Finds the clusters a light may touch.
+  void ComputeLightRange(const PointLight& light,
+                         const Eigen::Matrix4f& view,
+                         ViewLight* view_light) const;
+
+  // Builds the lists of the clusters of a slice.
+  void AssignSlice(const int slice);
+
+  const int grid_width_;
+  const int grid_height_;
+  const int grid_depth_;
+  GLuint lights_buffer_id_;
+  GLuint grid_buffer_id_;
+  GLuint light_indices_buffer_id_;
+  // The projection and the framebuffer size of the bounds.
+  Eigen::Matrix4f projection_;
+  int framebuffer_width_;
+  int framebuffer_height_;
+  float near_distance_;
+  float far_distance_;
+  std::vector<ClusterBounds> cluster_bounds_;
+  // The distances of the boundaries of the slices, grid_depth_ + 1 of them.
+  std::vector<float> slice_distances_;
+  // Persistent between the updates, so that they do not allocate once the
+  // lists reached their steady size.
+  std::vector<ViewLight> view_lights_;
+  std::vector<SliceLists> slices_;
+  std::vector<float> packed_lights_;
+  std::vector<uint32_t> grid_data_;
+  std::vector<uint32_t> light_indices_;
+  ClusteredLightingStatistics statistics_;
+
+  ClusteredLighting(const ClusteredLighting&) = delete;
+  ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_CLUSTERED_LIGHTING_H_
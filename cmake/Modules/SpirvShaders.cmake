@@ -0,0 +1,35 @@
+# Compiles GLSL shaders into SPIR-V modules with glslangValidator, for
+# ShaderProgram::LoadShaderFromSpirvFile().
+#
+# ADD_SPIRV_SHADERS(target output_directory shader1 [shader2 ...])
+#
+# Adds a target that compiles every shader into output_directory/<name>.spv,
+# where <name> is the file name of the shader, e.g., lit.vert becomes
+# lit.vert.spv. glslangValidator infers the stage from the extension of the
+# shader (.vert, .frag, .geom, .comp, ...). If glslangValidator is not found,
+# the target is empty and the programs fall back to their GLSL sources.
+
+FIND_PROGRAM(GLSLANG_VALIDATOR glslangValidator)
+
+FUNCTION(ADD_SPIRV_SHADERS target output_directory)
+  IF (NOT GLSLANG_VALIDATOR)
+    MESSAGE(WARNING "glslangValidator not found: ${target} is empty.")
+    ADD_CUSTOM_TARGET(${target})
+    RETURN()
+  ENDIF (NOT GLSLANG_VALIDATOR)
+
+  SET(modules)
+  FOREACH (shader ${ARGN})
+    GET_FILENAME_COMPONENT(shader_path ${shader} ABSOLUTE)
+    GET_FILENAME_COMPONENT(shader_name ${shader} NAME)
+    SET(module ${output_directory}/${shader_name}.spv)
+    ADD_CUSTOM_COMMAND(
+      OUTPUT ${module}
+      COMMAND ${CMAKE_COMMAND} -E make_directory ${output_directory}
+      COMMAND ${GLSLANG_VALIDATOR} -G -o ${module} ${shader_path}
+      DEPENDS ${shader_path}
+      COMMENT "Compiling ${shader_name} to SPIR-V")
+    LIST(APPEND modules ${module})
+  ENDFOREACH (shader)
+  ADD_CUSTOM_TARGET(${target} ALL DEPENDS ${modules})
+ENDFUNCTION(ADD_SPIRV_SHADERS)
@@ -0,0 +1,128 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "content_hash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace wvu {
+namespace {
+// The primes of XXH64.
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+uint64_t RotateLeft(const uint64_t value, const int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// Reads unaligned little-endian words, as the x86 and ARM targets store them.
+uint64_t Read64(const unsigned char* bytes) {
+  uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+uint32_t Read32(const unsigned char* bytes) {
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+uint64_t Round(uint64_t accumulator, const uint64_t input) {
+  accumulator += input * kPrime2;
+  accumulator = RotateLeft(accumulator, 31);
+  return accumulator * kPrime1;
+}
+
+uint64_t MergeRound(uint64_t hash, const uint64_t accumulator) {
+  hash ^= Round(0, accumulator);
+  return hash * kPrime1 + kPrime4;
+}
+
+}  // namespace
+
+uint64_t HashContent(const void* data,
+                     const size_t num_bytes,
+                     const uint64_t seed) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  const unsigned char* const end = bytes + num_bytes;
+  uint64_t hash;
+  if (num_bytes >= 32) {
+    // Four independent lanes, so the multiplications overlap.
+    uint64_t lanes[4] = {seed + kPrime1 + kPrime2, seed + kPrime2, seed,
+                         seed - kPrime1};
+    const unsigned char* const last_stripe = end - 32;
+    do {
+      lanes[0] = Round(lanes[0], Read64(bytes));
+      lanes[1] = Round(lanes[1], Read64(bytes + 8));
+      lanes[2] = Round(lanes[2], Read64(bytes + 16));
+      lanes[3] = Round(lanes[3], Read64(bytes + 24));
+      bytes += 32;
+    } while (bytes <= last_stripe);
+    hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) +
+        RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+    for (int i = 0; i < 4; ++i) hash = MergeRound(hash, lanes[i]);
+  } else {
+    hash = seed + kPrime5;
+  }
+  hash += num_bytes;
+  // The remaining bytes, in words, half words and bytes.
+  for (; bytes + 8 <= end; bytes += 8) {
+    hash ^= Round(0, Read64(bytes));
+    hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+  }
+  if (bytes + 4 <= end) {
+    hash ^= static_cast<uint64_t>(Read32(bytes)) * kPrime1;
+    hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+    bytes += 4;
+  }
+  for (; bytes < end; ++bytes) {
+    hash ^= *bytes * kPrime5;
+    hash = RotateLeft(hash, 11) * kPrime1;
+  }
+  // Mixes the bits of the hash.
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+}  // namespace wvu
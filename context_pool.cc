@@ -0,0 +1,140 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "context_pool.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "gl_state_cache.h"
+
+namespace wvu {
+
+ContextPool::~ContextPool() {
+  Destroy();
+}
+
+bool ContextPool::Initialize(GLFWwindow* main_window,
+                             const int num_contexts,
+                             std::string* error_info_log) {
+  if (!contexts_.empty()) {
+    *error_info_log = "The context pool is already initialized.";
+    return false;
+  }
+  if (main_window == nullptr || num_contexts <= 0) {
+    *error_info_log = "Invalid main window or number of contexts.";
+    return false;
+  }
+  // The contexts do not present anything, so their windows stay hidden and
+  // as small as possible.
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  for (int i = 0; i < num_contexts; ++i) {
+    GLFWwindow* context = glfwCreateWindow(1, 1, "", nullptr, main_window);
+    if (context == nullptr) {
+      *error_info_log = "Could not create a shared context.";
+      break;
+    }
+    contexts_.push_back(context);
+  }
+  glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+  if (static_cast<int>(contexts_.size()) < num_contexts) {
+    Destroy();
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_contexts_ = contexts_;
+  return true;
+}
+
+void ContextPool::Destroy() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_contexts_.clear();
+  }
+  for (GLFWwindow* context : contexts_) {
+    glfwDestroyWindow(context);
+  }
+  contexts_.clear();
+}
+
+GLFWwindow* ContextPool::Acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (contexts_.empty()) return nullptr;
+  released_.wait(lock, [this]() { return !free_contexts_.empty(); });
+  GLFWwindow* context = free_contexts_.back();
+  free_contexts_.pop_back();
+  return context;
+}
+
+GLFWwindow* ContextPool::TryAcquire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_contexts_.empty()) return nullptr;
+  GLFWwindow* context = free_contexts_.back();
+  free_contexts_.pop_back();
+  return context;
+}
+
+void ContextPool::Release(GLFWwindow* context) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_contexts_.push_back(context);
+  }
+  released_.notify_one();
+}
+
+ScopedSharedContext::ScopedSharedContext(ContextPool* context_pool)
+    : context_pool_(context_pool),
+      context_(context_pool->Acquire()),
+      previous_context_(glfwGetCurrentContext()) {
+  if (context_ == nullptr) return;
+  glfwMakeContextCurrent(context_);
+  // The function pointers loaded by GLEW on the main thread are valid for
+  // the shared contexts too, since they come from the same driver.
+  GlStateCache::Current()->Invalidate();
+}
+
+ScopedSharedContext::~ScopedSharedContext() {
+  if (context_ == nullptr) return;
+  // A context only sees the changes of another context to a shared object
+  // once they are complete.
+  glFinish();
+  glfwMakeContextCurrent(previous_context_);
+  GlStateCache::Current()->Invalidate();
+  context_pool_->Release(context_);
+}
+
+}  // namespace wvu
@@ -0,0 +1,151 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_CONTEXT_POOL_H_
+#define GLUTILS_CONTEXT_POOL_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <GLFW/glfw3.h>
+
+namespace wvu {
+// This class owns hidden windows whose OpenGL contexts share their objects
+// with the context of the main window, and hands them out to worker threads,
+// so that uploads, shader builds and readbacks can run off the main thread.
+// Buffers, textures, programs, shaders and sync objects are shared between
+// the contexts, but vertex array objects and framebuffers are not. A context
+// is used by one worker at a time, and workers block until one is released.
+//
+// GLFW creates and destroys windows on the main thread only, so Initialize()
+// and Destroy() must be called there. Acquiring and releasing the contexts is
+// thread safe.
+//
+// Example:
+//
+// wvu::ContextPool context_pool;
+// context_pool.Initialize(window, 2, &error_info_log);
+// // A worker thread.
+// {
+//   wvu::ScopedSharedContext context(&context_pool);
+//   shader_program.Create(&error_info_log);
+// }
+// // The main thread, once the workers finished.
+// context_pool.Destroy();
+//
+// Workers that keep a context, e.g., a MeshUploader, take it for their whole
+// life:
+//
+// GLFWwindow* upload_context = context_pool.Acquire();
+// mesh_uploader.Initialize(upload_context, &error_info_log);
+// ...
+// mesh_uploader.Stop();
+// context_pool.Release(upload_context);
+class ContextPool {
+ public:
+  ContextPool() {}
+  // Destroys the contexts, which must all be released. Must be called on the
+  // main thread.
+  ~ContextPool();
+
+  // Creates the contexts with the current window hints, except for the
+  // visibility. Must be called on the main thread. Returns true if successful.
+  // Parameters:
+  //   main_window  The window whose context shares its objects. Not owned.
+  //   num_contexts  The number of contexts of the pool.
+  //   error_info_log  A pointer to a string that holds the error log.
+  bool Initialize(GLFWwindow* main_window,
+                  const int num_contexts,
+                  std::string* error_info_log);
+
+  // Destroys the contexts, which must all be released. Must be called on the
+  // main thread while the main window is alive.
+  void Destroy();
+
+  // Returns a context not current on any thread, waiting until one is
+  // released, or nullptr if the pool has no contexts. The caller makes it
+  // current on its thread, and must not call this function again without
+  // releasing it if the pool has one context.
+  GLFWwindow* Acquire();
+
+  // Returns a context as Acquire() does, or nullptr without waiting if all of
+  // them are taken.
+  GLFWwindow* TryAcquire();
+
+  // Returns a context to the pool. It must not be current on any thread.
+  void Release(GLFWwindow* context);
+
+  int num_contexts() const {
+    return contexts_.size();
+  }
+
+ private:
+  std::vector<GLFWwindow*> contexts_;
+  // The contexts not taken.
+  std::vector<GLFWwindow*> free_contexts_;
+  std::mutex mutex_;
+  std::condition_variable released_;
+
+  ContextPool(const ContextPool&) = delete;
+  ContextPool& operator=(const ContextPool&) = delete;
+};
+
+// Makes a context of a pool current on the calling thread during its
+// lifetime. The objects created or modified through it are complete when it
+// is released, so other contexts can use them once they bind them again. The
+// GlStateCache of the thread is invalidated when the context changes.
+class ScopedSharedContext {
+ public:
+  explicit ScopedSharedContext(ContextPool* context_pool);
+  ~ScopedSharedContext();
+
+  // Returns the context, or nullptr if the pool has no contexts.
+  GLFWwindow* context() const {
+    return context_;
+  }
+
+ private:
+  ContextPool* context_pool_;
+  GLFWwindow* context_;
+  // The context current on the thread before, restored on release.
+  GLFWwindow* previous_context_;
+
+  ScopedSharedContext(const ScopedSharedContext&) = delete;
+  ScopedSharedContext& operator=(const ScopedSharedContext&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_CONTEXT_POOL_H_
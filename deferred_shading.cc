@@ -0,0 +1,403 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "deferred_shading.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "clustered_lighting.h"
+#include "gl_state_cache.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Shader storage buffer binding point of the lights of the accumulation.
+constexpr GLuint kDeferredLightsBindingPoint = 6;
+// Floats per light in the light buffer: the position and radius, and the
+// color, as the clustered lights.
+constexpr int kLightStride = 8;
+
+// Lights the pixels of a 16x16 tile with the lights touching the frustum
+// between the nearest and the farthest surface of the tile. The view distance
+// d of a depth is P(2,3) / (z_ndc + P(2,2)), and the view position of a pixel
+// at the distance d is (x_ndc d / P(0,0), y_ndc d / P(1,1), -d).
+const char kLightAccumulationShader[] =
+    "#version 430\n"
+    "layout (local_size_x = 16, local_size_y = 16) in;\n"
+    "struct Light {\n"
+    "  vec4 position_radius;\n"
+    "  vec4 color;\n"
+    "};\n"
+    "layout (std430, binding = 6) readonly buffer Lights {\n"
+    "  Light lights[];\n"
+    "};\n"
+    "layout (binding = 0) uniform sampler2D albedo_texture;\n"
+    "layout (binding = 1) uniform sampler2D normal_texture;\n"
+    "layout (binding = 2) uniform sampler2D depth_texture;\n"
+    "layout (rgba8, binding = 0) writeonly uniform image2D lit_image;\n"
+    "uniform mat4 projection;\n"
+    "uniform int num_lights;\n"
+    "shared uint min_distance_bits;\n"
+    "shared uint max_distance_bits;\n"
+    "shared uint tile_num_lights;\n"
+    "shared uint tile_lights[256];\n"
+    "vec3 DecodeNormal(vec2 encoded) {\n"
+    "  vec2 e = encoded * 2.0 - 1.0;\n"
+    "  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+    "  float t = max(-n.z, 0.0);\n"
+    "  n.x += n.x >= 0.0 ? -t : t;\n"
+    "  n.y += n.y >= 0.0 ? -t : t;\n"
+    "  return normalize(n);\n"
+    "}\n"
+    "void main() {\n"
+    "  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);\n"
+    "  ivec2 size = imageSize(lit_image);\n"
+    "  bool inside = all(lessThan(pixel, size));\n"
+    "  if (gl_LocalInvocationIndex == 0u) {\n"
+    "    min_distance_bits = 0x7f800000u;  // Infinity.\n"
+    "    max_distance_bits = 0u;\n"
+    "    tile_num_lights = 0u;\n"
+    "  }\n"
+    "  barrier();\n"
+    "  float depth = inside ? texelFetch(depth_texture, pixel, 0).r : 1.0;\n"
+    "  bool surface = depth < 1.0;\n"
+    "  float distance =\n"
+    "      projection[3][2] / (2.0 * depth - 1.0 + projection[2][2]);\n"
+    "  // The bits of positive floats are ordered as the floats.\n"
+    "  if (surface) {\n"
+    "    atomicMin(min_distance_bits, floatBitsToUint(distance));\n"
+    "    atomicMax(max_distance_bits, floatBitsToUint(distance));\n"
+    "  }\n"
+    "  barrier();\n"
+    "  if (max_distance_bits != 0u) {\n"
+    "    float min_distance = uintBitsToFloat(min_distance_bits);\n"
+    "    float max_distance = uintBitsToFloat(max_distance_bits);\n"
+    "    vec2 ndc_min = vec2(gl_WorkGroupID.xy * 16u) / vec2(size) * 2.0 -\n"
+    "        1.0;\n"
+    "    vec2 ndc_max = vec2((gl_WorkGroupID.xy + 1u) * 16u) / vec2(size) *\n"
+    "        2.0 - 1.0;\n"
+    "    // The side planes of the frustum of the tile, through the camera,\n"
+    "    // with their normals inwards.\n"
+    "    vec3 planes[4] = vec3[4](\n"
+    "        normalize(vec3(projection[0][0], 0.0, ndc_min.x)),\n"
+    "        normalize(vec3(-projection[0][0], 0.0, -ndc_max.x)),\n"
+    "        normalize(vec3(0.0, projection[1][1], ndc_min.y)),\n"
+    "        normalize(vec3(0.0, -projection[1][1], -ndc_max.y)));\n"
+    "    for (uint i = gl_LocalInvocationIndex; i < uint(num_lights);\n"
+    "         i += 256u) {\n"
+    "      vec4 light = lights[i].position_radius;\n"
+    "      if (-light.z + light.w < min_distance ||\n"
+    "          -light.z - light.w > max_distance) {\n"
+    "        continue;\n"
+    "      }\n"
+    "      bool touches = true;\n"
+    "      for (int p = 0; p < 4; ++p) {\n"
+    "        touches = touches && dot(planes[p], light.xyz) >= -light.w;\n"
+    "      }\n"
+    "      if (!touches) continue;\n"
+    "      uint slot = atomicAdd(tile_num_lights, 1u);\n"
+    "      if (slot < 256u) tile_lights[slot] = i;\n"
+    "    }\n"
+    "  }\n"
+    "  barrier();\n"
+    "  if (!inside) return;\n"
+    "  vec4 albedo = texelFetch(albedo_texture, pixel, 0);\n"
+    "  vec3 color = albedo.rgb * albedo.a;\n"
+    "  if (surface) {\n"
+    "    vec2 ndc = (vec2(pixel) + 0.5) / vec2(size) * 2.0 - 1.0;\n"
+    "    vec3 view_position = vec3(ndc.x * distance / projection[0][0],\n"
+    "                              ndc.y * distance / projection[1][1],\n"
+    "                              -distance);\n"
+    "    vec3 normal = DecodeNormal(texelFetch(normal_texture, pixel, 0).rg);\n"
+    "    uint tile_end = min(tile_num_lights, 256u);\n"
+    "    for (uint i = 0u; i < tile_end; ++i) {\n"
+    "      Light light = lights[tile_lights[i]];\n"
+    "      vec3 to_light = light.position_radius.xyz - view_position;\n"
+    "      float light_distance = length(to_light);\n"
+    "      float falloff =\n"
+    "          clamp(1.0 - light_distance / light.position_radius.w, 0.0,\n"
+    "                1.0);\n"
+    "      color += albedo.rgb * light.color.rgb * falloff * falloff *\n"
+    "          max(dot(normal, to_light / max(light_distance, 1e-6)), 0.0);\n"
+    "    }\n"
+    "  }\n"
+    "  imageStore(lit_image, pixel, vec4(color, 1.0));\n"
+    "}\n";
+
+// Creates a single-level texture of width x height texels, sampled with
+// texelFetch().
+GLuint CreateTargetTexture(const GLenum internal_format,
+                           const int width,
+                           const int height) {
+  GLuint texture_id = 0;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  glTexStorage2D(GL_TEXTURE_2D, 1, internal_format, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return texture_id;
+}
+
+// Checks the completeness of the bound framebuffer.
+bool CheckFramebuffer(const std::string& name, std::string* error_info_log) {
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    *error_info_log = "The " + name + " framebuffer is incomplete: status " +
+        std::to_string(status) + ".";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+DeferredShading::DeferredShading()
+    : projection_location_(-1), num_lights_location_(-1),
+      albedo_texture_id_(0), normal_texture_id_(0), depth_texture_id_(0),
+      lit_texture_id_(0), gbuffer_framebuffer_id_(0), lit_framebuffer_id_(0),
+      lights_buffer_id_(0), width_(0), height_(0), num_lights_(0) {}
+
+DeferredShading::~DeferredShading() {
+  Reset();
+}
+
+bool DeferredShading::Supported() {
+  return GLEW_VERSION_4_3;
+}
+
+bool DeferredShading::Initialize(const int width,
+                                 const int height,
+                                 std::string* error_info_log) {
+  if (!Supported()) {
+    *error_info_log = "Deferred shading needs OpenGL 4.3.";
+    return false;
+  }
+  if (!lighting_program_.LoadComputeShaderFromString(
+          kLightAccumulationShader) ||
+      !lighting_program_.Create(error_info_log)) {
+    return false;
+  }
+  projection_location_ = lighting_program_.GetUniformLocation("projection");
+  num_lights_location_ = lighting_program_.GetUniformLocation("num_lights");
+  if (lights_buffer_id_ == 0) {
+    lights_buffer_id_ = BufferAllocator::Get()->CreateBuffer(STORAGE_DATA);
+    if (lights_buffer_id_ == 0) {
+      *error_info_log = "Could not create the light buffer.";
+      return false;
+    }
+  }
+  width_ = 0;
+  height_ = 0;
+  return Resize(width, height, error_info_log);
+}
+
+bool DeferredShading::Resize(const int width,
+                             const int height,
+                             std::string* error_info_log) {
+  if (width == width_ && height == height_ && gbuffer_framebuffer_id_ != 0) {
+    return true;
+  }
+  if (width <= 0 || height <= 0) {
+    *error_info_log = "Invalid G-buffer size " + std::to_string(width) + "x" +
+        std::to_string(height) + ".";
+    return false;
+  }
+  DeleteTargets();
+  width_ = width;
+  height_ = height;
+  if (!CreateTargets(error_info_log)) {
+    DeleteTargets();
+    return false;
+  }
+  return true;
+}
+
+bool DeferredShading::CreateTargets(std::string* error_info_log) {
+  albedo_texture_id_ = CreateTargetTexture(GL_RGBA8, width_, height_);
+  normal_texture_id_ = CreateTargetTexture(GL_RG16, width_, height_);
+  depth_texture_id_ =
+      CreateTargetTexture(GL_DEPTH24_STENCIL8, width_, height_);
+  lit_texture_id_ = CreateTargetTexture(GL_RGBA8, width_, height_);
+
+  glGenFramebuffers(1, &gbuffer_framebuffer_id_);
+  glBindFramebuffer(GL_FRAMEBUFFER, gbuffer_framebuffer_id_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         albedo_texture_id_, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                         normal_texture_id_, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                         GL_TEXTURE_2D, depth_texture_id_, 0);
+  const GLenum draw_buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(2, draw_buffers);
+  bool complete = CheckFramebuffer("G-buffer", error_info_log);
+
+  // The depth is read with the lit colors, for the blit into the target.
+  glGenFramebuffers(1, &lit_framebuffer_id_);
+  glBindFramebuffer(GL_FRAMEBUFFER, lit_framebuffer_id_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         lit_texture_id_, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                         GL_TEXTURE_2D, depth_texture_id_, 0);
+  complete = complete && CheckFramebuffer("lit", error_info_log);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return complete;
+}
+
+void DeferredShading::DeleteTargets() {
+  GLuint* framebuffers[] = {&gbuffer_framebuffer_id_, &lit_framebuffer_id_};
+  for (GLuint* framebuffer : framebuffers) {
+    if (*framebuffer != 0) glDeleteFramebuffers(1, framebuffer);
+    *framebuffer = 0;
+  }
+  GLuint* textures[] = {&albedo_texture_id_, &normal_texture_id_,
+                        &depth_texture_id_, &lit_texture_id_};
+  for (GLuint* texture : textures) {
+    if (*texture != 0) glDeleteTextures(1, texture);
+    *texture = 0;
+  }
+  width_ = 0;
+  height_ = 0;
+}
+
+void DeferredShading::BindGBuffer() const {
+  glBindFramebuffer(GL_FRAMEBUFFER, gbuffer_framebuffer_id_);
+  glViewport(0, 0, width_, height_);
+}
+
+void DeferredShading::Update(const PointLight* lights,
+                             const int num_lights,
+                             const Eigen::Matrix4f& view) {
+  statistics_ = DeferredShadingStatistics();
+  statistics_.num_lights = num_lights;
+  // Only the lights reaching in front of the camera are uploaded.
+  packed_lights_.resize(num_lights * kLightStride);
+  num_lights_ = 0;
+  for (int i = 0; i < num_lights; ++i) {
+    const Eigen::Vector4f position =
+        view * Eigen::Vector4f(lights[i].position.x(), lights[i].position.y(),
+                               lights[i].position.z(), 1.0f);
+    if (position.z() - lights[i].radius >= 0.0f) continue;
+    float* packed = &packed_lights_[num_lights_ * kLightStride];
+    packed[0] = position.x();
+    packed[1] = position.y();
+    packed[2] = position.z();
+    packed[3] = lights[i].radius;
+    packed[4] = lights[i].color.x();
+    packed[5] = lights[i].color.y();
+    packed[6] = lights[i].color.z();
+    packed[7] = 1.0f;
+    ++num_lights_;
+  }
+  statistics_.num_visible_lights = num_lights_;
+  if (lights_buffer_id_ == 0) return;
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, lights_buffer_id_);
+  // Empty buffers cannot be bound, so they keep a few bytes. The storage read
+  // by the previous frame is orphaned.
+  const GLsizeiptr size = num_lights_ * kLightStride * sizeof(float);
+  BufferAllocator::Get()->BufferData(lights_buffer_id_,
+                                     GL_SHADER_STORAGE_BUFFER,
+                                     std::max<GLsizeiptr>(size, 16), nullptr,
+                                     GL_STREAM_DRAW);
+  if (size > 0) {
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, packed_lights_.data());
+  }
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void DeferredShading::Shade(const Eigen::Matrix4f& projection,
+                            const GLuint framebuffer_id) {
+  if (gbuffer_framebuffer_id_ == 0) return;
+  lighting_program_.Use();
+  lighting_program_.SetUniform(projection_location_, projection);
+  lighting_program_.SetUniform(num_lights_location_,
+                               static_cast<GLint>(num_lights_));
+  const GLuint textures[] = {albedo_texture_id_, normal_texture_id_,
+                             depth_texture_id_};
+  for (int i = 0; i < 3; ++i) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+  }
+  glBindImageTexture(0, lit_texture_id_, 0, GL_FALSE, 0, GL_WRITE_ONLY,
+                     GL_RGBA8);
+  GlStateCache::Current()->BindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, kDeferredLightsBindingPoint,
+      lights_buffer_id_);
+  // The blit reads the lit colors through the framebuffer.
+  lighting_program_.Dispatch(
+      (width_ + kDeferredTileSize - 1) / kDeferredTileSize,
+      (height_ + kDeferredTileSize - 1) / kDeferredTileSize, 1,
+      GL_FRAMEBUFFER_BARRIER_BIT);
+  for (int i = 2; i >= 0; --i) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, lit_framebuffer_id_);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_id);
+  glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_,
+                    GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+                    GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+}
+
+void DeferredShading::Reset() {
+  DeleteTargets();
+  BufferAllocator::Get()->DeleteBuffer(&lights_buffer_id_);
+  num_lights_ = 0;
+}
+
+std::string DeferredShading::GlslDeclaration() {
+  return
+      "layout (location = 0) out vec4 gbuffer_albedo;\n"
+      "layout (location = 1) out vec2 gbuffer_normal;\n"
+      "// Folds the lower hemisphere of the octahedron over the upper one.\n"
+      "vec2 EncodeNormal(vec3 n) {\n"
+      "  n /= abs(n.x) + abs(n.y) + abs(n.z);\n"
+      "  vec2 folded = (1.0 - abs(n.yx)) *\n"
+      "      vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+      "  return (n.z >= 0.0 ? n.xy : folded) * 0.5 + 0.5;\n"
+      "}\n"
+      "void WriteGBuffer(vec3 normal, vec3 albedo, float ambient) {\n"
+      "  gbuffer_albedo = vec4(albedo, ambient);\n"
+      "  gbuffer_normal = EncodeNormal(normalize(normal));\n"
+      "}\n";
+}
+
+}  // namespace wvu
@@ -0,0 +1,199 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_DEFERRED_SHADING_H_
+#define GLUTILS_DEFERRED_SHADING_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "clustered_lighting.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Side in pixels of the tiles of the light accumulation.
+constexpr int kDeferredTileSize = 16;
+
+// Most lights shading a tile. The lights past them are dropped from the tile.
+constexpr int kMaxDeferredTileLights = 256;
+
+// Counters of the last DeferredShading::Update().
+struct DeferredShadingStatistics {
+  int num_lights = 0;
+  // Lights in front of the camera, which the tiles test.
+  int num_visible_lights = 0;
+};
+
+// This class shades many point lights with deferred shading: the draws write
+// the surfaces into a compact G-buffer, and a compute shader then lights every
+// pixel once, whatever the depth complexity. The G-buffer holds 8 bytes per
+// pixel besides the depth:
+//
+//   Target 0, GL_RGBA8: the albedo, and the fraction of it emitted without
+//     lights.
+//   Target 1, GL_RG16: the view-space normal, in octahedron encoding
+//     (Cigolle et al., 2014), which spreads the precision evenly over the
+//     sphere.
+//
+// The view-space positions are reconstructed from the depth. The compute
+// shader splits the screen into tiles of 16x16 pixels; every work group finds
+// the depth range of its tile, tests the lights against the frustum of the
+// tile into a list in shared memory, and shades its pixels with the lights of
+// the list, with the same falloff and diffuse term as ClusteredLighting. The
+// depth is a GL_DEPTH24_STENCIL8 texture, so that it is blitted with the
+// colors into the target framebuffer and the later draws, e.g., blended
+// particles, test against it. Needs OpenGL 4.3.
+//
+// The forward path pays for the lights of the clusters in every fragment
+// drawn, and the deferred path pays for the G-buffer bandwidth once per pixel:
+// the deferred path is faster with many lights and overdraw, the forward one
+// with few lights, transparency or MSAA.
+//
+// The fragment shaders include GlslDeclaration() right after their #version
+// line, of 400 or later, which declares:
+//
+//   // Writes a surface point: its view-space normal, its albedo and the
+//   // fraction of the albedo emitted without lights.
+//   void WriteGBuffer(vec3 normal, vec3 albedo, float ambient);
+//
+// Example:
+//
+// wvu::DeferredShading deferred_shading;
+// deferred_shading.Initialize(width, height, &error_info_log);
+// while (...) {  // Rendering loop.
+//   deferred_shading.BindGBuffer();
+//   ...  // Draws with programs calling WriteGBuffer().
+//   deferred_shading.Update(lights.data(), lights.size(), view);
+//   deferred_shading.Shade(projection, 0);
+// }
+class DeferredShading {
+ public:
+  DeferredShading();
+  ~DeferredShading();
+
+  // Compiles the light accumulation shader and creates the G-buffer of width
+  // x height pixels. Returns true if successful.
+  bool Initialize(const int width,
+                  const int height,
+                  std::string* error_info_log);
+
+  // Recreates the G-buffer of width x height pixels, if the size changed.
+  // Returns true if successful.
+  bool Resize(const int width, const int height, std::string* error_info_log);
+
+  // Binds the G-buffer for drawing and sets the viewport to its size.
+  void BindGBuffer() const;
+
+  // Uploads the lights in view space.
+  // Parameters:
+  //   lights  The num_lights lights, in world space.
+  //   num_lights  The number of lights.
+  //   view  The view matrix of the camera.
+  void Update(const PointLight* lights,
+              const int num_lights,
+              const Eigen::Matrix4f& view);
+
+  // Lights the G-buffer and copies the lit colors and the depths into the
+  // framebuffer framebuffer_id, of the same size and with a
+  // GL_DEPTH24_STENCIL8 depth. Leaves framebuffer_id bound.
+  // Parameters:
+  //   projection  The symmetric perspective projection of the draws.
+  //   framebuffer_id  The target framebuffer, e.g., 0 for the window.
+  void Shade(const Eigen::Matrix4f& projection, const GLuint framebuffer_id);
+
+  // Deletes the OpenGL objects.
+  void Reset();
+
+  // Returns the GLSL declaration of the outputs and of WriteGBuffer().
+  static std::string GlslDeclaration();
+
+  // Returns true if the context supports compute shaders and shader storage
+  // buffers.
+  static bool Supported();
+
+  GLuint gbuffer_framebuffer_id() const {
+    return gbuffer_framebuffer_id_;
+  }
+
+  GLuint depth_texture_id() const {
+    return depth_texture_id_;
+  }
+
+  int width() const {
+    return width_;
+  }
+
+  int height() const {
+    return height_;
+  }
+
+  const DeferredShadingStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // Creates the textures and the framebuffers of the G-buffer.
+  bool CreateTargets(std::string* error_info_log);
+
+  // Deletes the textures and the framebuffers.
+  void DeleteTargets();
+
+  ShaderProgram lighting_program_;
+  GLint projection_location_;
+  GLint num_lights_location_;
+  GLuint albedo_texture_id_;
+  GLuint normal_texture_id_;
+  GLuint depth_texture_id_;
+  // The colors lit by the compute shader.
+  GLuint lit_texture_id_;
+  GLuint gbuffer_framebuffer_id_;
+  // Reads the lit colors and the depth for the blit into the target.
+  GLuint lit_framebuffer_id_;
+  GLuint lights_buffer_id_;
+  int width_;
+  int height_;
+  int num_lights_;
+  // Persistent between the updates, so that they do not allocate.
+  std::vector<float> packed_lights_;
+  DeferredShadingStatistics statistics_;
+
+  DeferredShading(const DeferredShading&) = delete;
+  DeferredShading& operator=(const DeferredShading&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_DEFERRED_SHADING_H_
@@ -0,0 +1,726 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "distributed_rendering.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "transforms.h"
+
+namespace wvu {
+namespace {
+// The types of the messages between the master and the nodes.
+enum MessageType : uint32_t {
+  FRAME_MESSAGE = 1,
+  READY_MESSAGE = 2,
+  SWAP_MESSAGE = 3,
+  // Between the compositing nodes.
+  RANK_MESSAGE = 4,
+  PIXELS_MESSAGE = 5
+};
+
+// Every message starts with its type and the size of its payload.
+struct MessageHeader {
+  uint32_t type;
+  uint32_t size;
+};
+
+// Largest payload accepted, which bounds the allocation of a corrupt header.
+constexpr uint32_t kMaxMessageSize = 64 << 20;
+
+// The compositing nodes start in any order, so a node retries to connect to
+// the nodes that are not listening yet, for up to a minute.
+constexpr int kNumConnectAttempts = 600;
+constexpr std::chrono::milliseconds kConnectRetryDelay(100);
+
+constexpr int kBytesPerPixel = 4;
+
+// Returns the description of errno.
+std::string ErrorString(const std::string& what) {
+  return what + ": " + std::strerror(errno) + ".";
+}
+
+bool SendAll(const int socket, const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  while (size > 0) {
+    const ssize_t sent = send(socket, bytes, size, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    bytes += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+bool ReceiveAll(const int socket, void* data, size_t size) {
+  uint8_t* bytes = static_cast<uint8_t*>(data);
+  while (size > 0) {
+    const ssize_t received = recv(socket, bytes, size, 0);
+    if (received < 0 && errno == EINTR) continue;
+    if (received <= 0) return false;
+    bytes += received;
+    size -= received;
+  }
+  return true;
+}
+
+// Sends the buffers in order without gathering them first.
+bool SendVectors(const int socket, iovec* vectors, int num_vectors) {
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  while (num_vectors > 0) {
+    message.msg_iov = vectors;
+    message.msg_iovlen = num_vectors;
+    ssize_t sent = sendmsg(socket, &message, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    // Skips what was sent, which may end in the middle of a buffer.
+    while (num_vectors > 0 && sent >= static_cast<ssize_t>(vectors->iov_len)) {
+      sent -= vectors->iov_len;
+      ++vectors;
+      --num_vectors;
+    }
+    if (num_vectors > 0) {
+      vectors->iov_base = static_cast<uint8_t*>(vectors->iov_base) + sent;
+      vectors->iov_len -= sent;
+    }
+  }
+  return true;
+}
+
+// Sends the header and the payload in one call, so that small messages
+// leave in one segment.
+bool SendMessage(const int socket,
+                 const MessageType type,
+                 const std::vector<uint8_t>& payload,
+                 std::vector<uint8_t>* message,
+                 std::string* error_info_log) {
+  const MessageHeader header = {type, static_cast<uint32_t>(payload.size())};
+  message->resize(sizeof(header) + payload.size());
+  std::memcpy(message->data(), &header, sizeof(header));
+  if (!payload.empty()) {
+    std::memcpy(message->data() + sizeof(header), payload.data(),
+                payload.size());
+  }
+  if (!SendAll(socket, message->data(), message->size())) {
+    *error_info_log = ErrorString("Could not send a message");
+    return false;
+  }
+  return true;
+}
+
+bool ReceiveMessage(const int socket,
+                    const MessageType expected_type,
+                    std::vector<uint8_t>* payload,
+                    std::string* error_info_log) {
+  MessageHeader header;
+  if (!ReceiveAll(socket, &header, sizeof(header))) {
+    *error_info_log = "The connection was closed.";
+    return false;
+  }
+  if (header.type != expected_type || header.size > kMaxMessageSize) {
+    *error_info_log = "Unexpected message of type " +
+        std::to_string(header.type) + ".";
+    return false;
+  }
+  payload->resize(header.size);
+  if (header.size > 0 && !ReceiveAll(socket, payload->data(), header.size)) {
+    *error_info_log = "The connection was closed.";
+    return false;
+  }
+  return true;
+}
+
+// The barrier messages carry the frame.
+std::vector<uint8_t> FramePayload(const int64_t frame) {
+  std::vector<uint8_t> payload(sizeof(frame));
+  std::memcpy(payload.data(), &frame, sizeof(frame));
+  return payload;
+}
+
+bool CheckFramePayload(const std::vector<uint8_t>& payload,
+                       const int64_t frame,
+                       std::string* error_info_log) {
+  int64_t payload_frame = -1;
+  if (payload.size() == sizeof(payload_frame)) {
+    std::memcpy(&payload_frame, payload.data(), sizeof(payload_frame));
+  }
+  if (payload_frame != frame) {
+    *error_info_log = "Expected frame " + std::to_string(frame) + " but got " +
+        std::to_string(payload_frame) + ".";
+    return false;
+  }
+  return true;
+}
+
+// The barrier messages are small and latency bound, so they are not held
+// back to be coalesced.
+void DisableNagle(const int socket) {
+  const int enable = 1;
+  setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+// Returns a socket listening on port, or -1.
+int ListenOn(const int port, const int backlog, std::string* error_info_log) {
+  const int listen_socket = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_socket < 0) {
+    *error_info_log = ErrorString("Could not create the socket");
+    return -1;
+  }
+  const int reuse = 1;
+  setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(listen_socket, reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) < 0 ||
+      listen(listen_socket, backlog) < 0) {
+    *error_info_log = ErrorString("Could not listen on port " +
+                                  std::to_string(port));
+    close(listen_socket);
+    return -1;
+  }
+  return listen_socket;
+}
+
+// Returns the socket of the next connection, or -1.
+int AcceptOn(const int listen_socket, std::string* error_info_log) {
+  while (true) {
+    const int accepted_socket = accept(listen_socket, nullptr, nullptr);
+    if (accepted_socket < 0 && errno == EINTR) continue;
+    if (accepted_socket < 0) {
+      *error_info_log = ErrorString("Could not accept a connection");
+      return -1;
+    }
+    DisableNagle(accepted_socket);
+    return accepted_socket;
+  }
+}
+
+// Returns a socket connected to host:port, or -1.
+int ConnectTo(const std::string& host,
+              const int port,
+              std::string* error_info_log) {
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses = nullptr;
+  const int status = getaddrinfo(host.c_str(), std::to_string(port).c_str(),
+                                 &hints, &addresses);
+  if (status != 0) {
+    *error_info_log = "Could not resolve " + host + ": " +
+        gai_strerror(status) + ".";
+    return -1;
+  }
+  int connected_socket = -1;
+  for (addrinfo* address = addresses; address != nullptr;
+       address = address->ai_next) {
+    connected_socket = socket(address->ai_family, address->ai_socktype,
+                              address->ai_protocol);
+    if (connected_socket < 0) continue;
+    if (connect(connected_socket, address->ai_addr, address->ai_addrlen) == 0) {
+      break;
+    }
+    close(connected_socket);
+    connected_socket = -1;
+  }
+  freeaddrinfo(addresses);
+  if (connected_socket < 0) {
+    *error_info_log = ErrorString("Could not connect to " + host + ":" +
+                                  std::to_string(port));
+    return -1;
+  }
+  DisableNagle(connected_socket);
+  return connected_socket;
+}
+
+template <typename Type>
+void Append(const Type& value, std::vector<uint8_t>* bytes) {
+  const uint8_t* value_bytes = reinterpret_cast<const uint8_t*>(&value);
+  bytes->insert(bytes->end(), value_bytes, value_bytes + sizeof(value));
+}
+
+template <typename Type>
+bool Read(const uint8_t** bytes, const uint8_t* end, Type* value) {
+  if (end - *bytes < static_cast<ptrdiff_t>(sizeof(*value))) return false;
+  std::memcpy(value, *bytes, sizeof(*value));
+  *bytes += sizeof(*value);
+  return true;
+}
+
+}  // namespace
+
+Eigen::Matrix4f ComputeTileProjection(const float field_of_view,
+                                      const float aspect_ratio,
+                                      const float near,
+                                      const float far,
+                                      const DisplayTile& tile) {
+  // The planes of the whole wall at the near plane, split evenly.
+  const float top = near / ComputeCotangent(0.5f * field_of_view);
+  const float right = top * aspect_ratio;
+  const float tile_width = 2.0f * right / tile.num_columns;
+  const float tile_height = 2.0f * top / tile.num_rows;
+  const float tile_left = -right + tile.column * tile_width;
+  const float tile_top = top - tile.row * tile_height;
+  return ComputeProjectionMatrix(tile_left, tile_left + tile_width, tile_top,
+                                 tile_top - tile_height, near, far);
+}
+
+void EncodeSceneDelta(const SceneDelta& delta, std::vector<uint8_t>* bytes) {
+  Append(delta.frame, bytes);
+  Append(delta.camera_position, bytes);
+  Append(delta.camera_orientation.coeffs().eval(), bytes);
+  Append(static_cast<uint32_t>(delta.moved_objects.size()), bytes);
+  for (const ObjectPose& pose : delta.moved_objects) {
+    Append(pose.object, bytes);
+    Append(pose.position, bytes);
+    Append(pose.orientation.coeffs().eval(), bytes);
+  }
+}
+
+bool DecodeSceneDelta(const uint8_t* bytes,
+                      const size_t num_bytes,
+                      SceneDelta* delta) {
+  const uint8_t* end = bytes + num_bytes;
+  Eigen::Vector4f coefficients;
+  uint32_t num_moved_objects = 0;
+  if (!Read(&bytes, end, &delta->frame) ||
+      !Read(&bytes, end, &delta->camera_position) ||
+      !Read(&bytes, end, &coefficients) ||
+      !Read(&bytes, end, &num_moved_objects)) {
+    return false;
+  }
+  delta->camera_orientation.coeffs() = coefficients;
+  delta->moved_objects.resize(num_moved_objects);
+  for (ObjectPose& pose : delta->moved_objects) {
+    if (!Read(&bytes, end, &pose.object) ||
+        !Read(&bytes, end, &pose.position) ||
+        !Read(&bytes, end, &coefficients)) {
+      return false;
+    }
+    pose.orientation.coeffs() = coefficients;
+  }
+  return bytes == end;
+}
+
+RenderMaster::RenderMaster() : listen_socket_(-1) {}
+
+RenderMaster::~RenderMaster() {
+  Close();
+}
+
+bool RenderMaster::Listen(const int port,
+                          const int num_nodes,
+                          std::string* error_info_log) {
+  Close();
+  listen_socket_ = ListenOn(port, num_nodes, error_info_log);
+  if (listen_socket_ < 0) return false;
+  while (node_sockets_.size() < num_nodes) {
+    const int node_socket = AcceptOn(listen_socket_, error_info_log);
+    if (node_socket < 0) {
+      Close();
+      return false;
+    }
+    node_sockets_.push_back(node_socket);
+  }
+  return true;
+}
+
+bool RenderMaster::BroadcastFrame(const SceneDelta& delta,
+                                  std::string* error_info_log) {
+  std::vector<uint8_t> payload;
+  EncodeSceneDelta(delta, &payload);
+  for (const int node_socket : node_sockets_) {
+    if (!SendMessage(node_socket, FRAME_MESSAGE, payload, &message_,
+                     error_info_log)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RenderMaster::SwapBarrier(const int64_t frame,
+                               std::string* error_info_log) {
+  std::vector<uint8_t> payload;
+  for (const int node_socket : node_sockets_) {
+    if (!ReceiveMessage(node_socket, READY_MESSAGE, &payload,
+                        error_info_log) ||
+        !CheckFramePayload(payload, frame, error_info_log)) {
+      return false;
+    }
+  }
+  payload = FramePayload(frame);
+  for (const int node_socket : node_sockets_) {
+    if (!SendMessage(node_socket, SWAP_MESSAGE, payload, &message_,
+                     error_info_log)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void RenderMaster::Close() {
+  for (const int node_socket : node_sockets_) close(node_socket);
+  node_sockets_.clear();
+  if (listen_socket_ >= 0) close(listen_socket_);
+  listen_socket_ = -1;
+}
+
+RenderNode::RenderNode() : socket_(-1) {}
+
+RenderNode::~RenderNode() {
+  Close();
+}
+
+bool RenderNode::Connect(const std::string& host,
+                         const int port,
+                         std::string* error_info_log) {
+  Close();
+  socket_ = ConnectTo(host, port, error_info_log);
+  return socket_ >= 0;
+}
+
+bool RenderNode::ReceiveFrame(SceneDelta* delta, std::string* error_info_log) {
+  if (!ReceiveMessage(socket_, FRAME_MESSAGE, &message_, error_info_log)) {
+    return false;
+  }
+  if (!DecodeSceneDelta(message_.data(), message_.size(), delta)) {
+    *error_info_log = "Could not decode the scene delta.";
+    return false;
+  }
+  return true;
+}
+
+bool RenderNode::SwapBarrier(const int64_t frame,
+                             std::string* error_info_log) {
+  std::vector<uint8_t> message;
+  return SendMessage(socket_, READY_MESSAGE, FramePayload(frame), &message,
+                     error_info_log) &&
+      ReceiveMessage(socket_, SWAP_MESSAGE, &message_, error_info_log) &&
+      CheckFramePayload(message_, frame, error_info_log);
+}
+
+void RenderNode::Close() {
+  if (socket_ >= 0) close(socket_);
+  socket_ = -1;
+}
+
+SortLastCompositor::SortLastCompositor() : rank_(0) {}
+
+SortLastCompositor::~SortLastCompositor() {
+  Close();
+}
+
+bool SortLastCompositor::Connect(const std::vector<std::string>& hosts,
+                                 const int port,
+                                 const int rank,
+                                 std::string* error_info_log) {
+  Close();
+  const int num_nodes = hosts.size();
+  if (rank < 0 || rank >= num_nodes) {
+    *error_info_log = "Rank " + std::to_string(rank) + " is not in [0, " +
+        std::to_string(num_nodes) + ").";
+    return false;
+  }
+  rank_ = rank;
+  peer_sockets_.assign(num_nodes, -1);
+  // Listens first, so that the higher ranks can connect while this node
+  // connects to the lower ones.
+  const int listen_socket = ListenOn(port + rank, num_nodes, error_info_log);
+  if (listen_socket < 0) return false;
+  std::vector<uint8_t> message;
+  const int32_t rank_payload = rank;
+  const std::vector<uint8_t> payload(
+      reinterpret_cast<const uint8_t*>(&rank_payload),
+      reinterpret_cast<const uint8_t*>(&rank_payload) + sizeof(rank_payload));
+  for (int peer = 0; peer < rank; ++peer) {
+    for (int attempt = 0;
+         peer_sockets_[peer] < 0 && attempt < kNumConnectAttempts; ++attempt) {
+      if (attempt > 0) std::this_thread::sleep_for(kConnectRetryDelay);
+      peer_sockets_[peer] = ConnectTo(hosts[peer], port + peer,
+                                      error_info_log);
+    }
+    if (peer_sockets_[peer] < 0 ||
+        !SendMessage(peer_sockets_[peer], RANK_MESSAGE, payload, &message,
+                     error_info_log)) {
+      close(listen_socket);
+      Close();
+      return false;
+    }
+  }
+  for (int i = rank + 1; i < num_nodes; ++i) {
+    const int peer_socket = AcceptOn(listen_socket, error_info_log);
+    int32_t peer = -1;
+    bool valid_peer = false;
+    if (peer_socket >= 0 &&
+        ReceiveMessage(peer_socket, RANK_MESSAGE, &message, error_info_log)) {
+      if (message.size() == sizeof(peer)) {
+        std::memcpy(&peer, message.data(), sizeof(peer));
+      }
+      valid_peer = peer > rank && peer < num_nodes && peer_sockets_[peer] < 0;
+      if (!valid_peer) {
+        *error_info_log = "Unexpected rank " + std::to_string(peer) + ".";
+      }
+    }
+    if (!valid_peer) {
+      if (peer_socket >= 0) close(peer_socket);
+      close(listen_socket);
+      Close();
+      return false;
+    }
+    peer_sockets_[peer] = peer_socket;
+  }
+  close(listen_socket);
+  return true;
+}
+
+bool SortLastCompositor::Composite(const ReadbackFrame& frame,
+                                   std::string* error_info_log) {
+  if (frame.depths == nullptr) {
+    *error_info_log = "The frame has no depths.";
+    return false;
+  }
+  statistics_ = CompositingStatistics();
+  const int num_pixels = frame.width * frame.height;
+  colors_.resize(static_cast<size_t>(num_pixels) * kBytesPerPixel);
+  depths_.resize(num_pixels);
+  // The image composited so far: the frame until the first merge, and then
+  // colors_ and depths_.
+  const GLubyte* colors = frame.pixels;
+  const GLfloat* depths = frame.depths;
+  const int num_nodes = peer_sockets_.size();
+  int num_swapping_nodes = 1;
+  while (2 * num_swapping_nodes <= num_nodes) num_swapping_nodes *= 2;
+  // Folds the nodes past the largest power of two into the first ones.
+  if (rank_ >= num_swapping_nodes) {
+    statistics_.folded = true;
+    if (!SendPixels(rank_ - num_swapping_nodes, colors, depths, 0,
+                    num_pixels)) {
+      *error_info_log = ErrorString("Could not send the pixels");
+      return false;
+    }
+    return true;
+  }
+  if (rank_ + num_swapping_nodes < num_nodes) {
+    if (!ReceivePixels(rank_ + num_swapping_nodes, colors, depths, 0,
+                       num_pixels, error_info_log)) {
+      return false;
+    }
+    colors = colors_.data();
+    depths = depths_.data();
+  }
+  // Binary swap over the region [begin, end) this node shares with its
+  // partners so far. The partners differ only in the bits of the later
+  // rounds, so they split the same region.
+  int begin = 0;
+  int end = num_pixels;
+  for (int bit = 1; bit < num_swapping_nodes; bit *= 2) {
+    const int partner = rank_ ^ bit;
+    const int middle = begin + (end - begin) / 2;
+    const bool keep_lower = (rank_ & bit) == 0;
+    const int send_begin = keep_lower ? middle : begin;
+    const int send_end = keep_lower ? end : middle;
+    // Sends and receives at once, so that the partners do not wait on each
+    // other. The halves are disjoint, so the sender reads what the merge
+    // does not write.
+    bool sent = false;
+    std::thread sender([&]() {
+      sent = SendPixels(partner, colors, depths, send_begin, send_end);
+    });
+    if (keep_lower) {
+      end = middle;
+    } else {
+      begin = middle;
+    }
+    const bool received = ReceivePixels(partner, colors, depths, begin, end,
+                                        error_info_log);
+    sender.join();
+    if (!sent && received) {
+      *error_info_log = ErrorString("Could not send the pixels");
+    }
+    if (!sent || !received) return false;
+    colors = colors_.data();
+    depths = depths_.data();
+    ++statistics_.num_rounds;
+  }
+  // Gathers the colors of every region on rank 0.
+  if (rank_ != 0) {
+    if (!SendPixels(0, colors, nullptr, begin, end)) {
+      *error_info_log = ErrorString("Could not send the pixels");
+      return false;
+    }
+    return true;
+  }
+  if (colors != colors_.data()) {
+    std::memcpy(colors_.data(), colors, colors_.size());
+  }
+  for (int peer = 1; peer < num_swapping_nodes; ++peer) {
+    int peer_begin = 0;
+    int peer_end = num_pixels;
+    for (int bit = 1; bit < num_swapping_nodes; bit *= 2) {
+      const int middle = peer_begin + (peer_end - peer_begin) / 2;
+      if ((peer & bit) == 0) {
+        peer_end = middle;
+      } else {
+        peer_begin = middle;
+      }
+    }
+    if (!ReceivePixels(peer, nullptr, nullptr, peer_begin, peer_end,
+                       error_info_log)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SortLastCompositor::SendPixels(const int peer,
+                                    const GLubyte* colors,
+                                    const GLfloat* depths,
+                                    const int begin,
+                                    const int end) {
+  const size_t num_pixels = end - begin;
+  const size_t colors_size = num_pixels * kBytesPerPixel;
+  const size_t depths_size = depths != nullptr ? num_pixels * sizeof(*depths)
+                                               : 0;
+  MessageHeader header = {PIXELS_MESSAGE,
+                          static_cast<uint32_t>(colors_size + depths_size)};
+  // Straight from the pixels, which may be a mapped pixel buffer.
+  iovec vectors[3];
+  vectors[0].iov_base = &header;
+  vectors[0].iov_len = sizeof(header);
+  vectors[1].iov_base =
+      const_cast<GLubyte*>(colors + static_cast<size_t>(begin) *
+                           kBytesPerPixel);
+  vectors[1].iov_len = colors_size;
+  vectors[2].iov_base = const_cast<GLfloat*>(depths + begin);
+  vectors[2].iov_len = depths_size;
+  if (!SendVectors(peer_sockets_[peer], vectors, depths != nullptr ? 3 : 2)) {
+    return false;
+  }
+  statistics_.num_bytes_sent += sizeof(header) + header.size;
+  return true;
+}
+
+bool SortLastCompositor::ReceivePixels(const int peer,
+                                       const GLubyte* colors,
+                                       const GLfloat* depths,
+                                       const int begin,
+                                       const int end,
+                                       std::string* error_info_log) {
+  const size_t num_pixels = end - begin;
+  const size_t colors_size = num_pixels * kBytesPerPixel;
+  const size_t depths_size = depths != nullptr ? num_pixels * sizeof(*depths)
+                                               : 0;
+  MessageHeader header;
+  if (!ReceiveAll(peer_sockets_[peer], &header, sizeof(header))) {
+    *error_info_log = "The connection to node " + std::to_string(peer) +
+        " was closed.";
+    return false;
+  }
+  if (header.type != PIXELS_MESSAGE ||
+      header.size != colors_size + depths_size) {
+    *error_info_log = "Unexpected pixels from node " + std::to_string(peer) +
+        "; the nodes must have the same image size.";
+    return false;
+  }
+  GLubyte* target_colors =
+      colors_.data() + static_cast<size_t>(begin) * kBytesPerPixel;
+  // Without depths, the colors are final and go straight to their place.
+  if (depths == nullptr) {
+    if (!ReceiveAll(peer_sockets_[peer], target_colors, colors_size)) {
+      *error_info_log = "The connection to node " + std::to_string(peer) +
+          " was closed.";
+      return false;
+    }
+    statistics_.num_bytes_received += sizeof(header) + header.size;
+    return true;
+  }
+  received_colors_.resize(colors_size);
+  received_depths_.resize(num_pixels);
+  if (!ReceiveAll(peer_sockets_[peer], received_colors_.data(),
+                  colors_size) ||
+      !ReceiveAll(peer_sockets_[peer], received_depths_.data(),
+                  depths_size)) {
+    *error_info_log = "The connection to node " + std::to_string(peer) +
+        " was closed.";
+    return false;
+  }
+  statistics_.num_bytes_received += sizeof(header) + header.size;
+  // Keeps the nearest pixel; on equal depths the lower rank wins, so that
+  // both partners of a tie agree.
+  const GLubyte* source_colors =
+      colors + static_cast<size_t>(begin) * kBytesPerPixel;
+  const GLfloat* source_depths = depths + begin;
+  GLfloat* target_depths = depths_.data() + begin;
+  const bool peer_wins_ties = peer < rank_;
+  for (size_t i = 0; i < num_pixels; ++i) {
+    const GLfloat received_depth = received_depths_[i];
+    const bool take_received = received_depth < source_depths[i] ||
+        (peer_wins_ties && received_depth == source_depths[i]);
+    const GLubyte* pixel = take_received ?
+        received_colors_.data() + i * kBytesPerPixel :
+        source_colors + i * kBytesPerPixel;
+    std::memcpy(target_colors + i * kBytesPerPixel, pixel, kBytesPerPixel);
+    target_depths[i] = take_received ? received_depth : source_depths[i];
+  }
+  return true;
+}
+
+void SortLastCompositor::Close() {
+  for (const int peer_socket : peer_sockets_) {
+    if (peer_socket >= 0) close(peer_socket);
+  }
+  peer_sockets_.clear();
+}
+
+}  // namespace wvu
@@ -0,0 +1,322 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_DISTRIBUTED_RENDERING_H_
+#define GLUTILS_DISTRIBUTED_RENDERING_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+#include <GL/glew.h>
+
+#include "framebuffer_readback.h"
+
+namespace wvu {
+// A tile of a display wall, in a grid of num_columns x num_rows tiles. Row 0
+// is the top row.
+struct DisplayTile {
+  int column = 0;
+  int row = 0;
+  int num_columns = 1;
+  int num_rows = 1;
+};
+
+// Returns the projection of a tile of the frustum of the whole wall, through
+// the six-parameter ComputeProjectionMatrix(), so that the tiles of all the
+// nodes put together show the image of the whole frustum.
+// Parameters:
+//   field_of_view  The vertical field of view of the wall, in radians.
+//   aspect_ratio  The width over the height of the wall.
+//   near  The distance to the near plane.
+//   far  The distance to the far plane.
+//   tile  The tile of the node.
+Eigen::Matrix4f ComputeTileProjection(const float field_of_view,
+                                      const float aspect_ratio,
+                                      const float near,
+                                      const float far,
+                                      const DisplayTile& tile);
+
+// The pose of a moved object.
+struct ObjectPose {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  int32_t object = 0;
+  Eigen::Vector3f position = Eigen::Vector3f::Zero();
+  Eigen::Quaternionf orientation = Eigen::Quaternionf::Identity();
+};
+
+typedef std::vector<ObjectPose, Eigen::aligned_allocator<ObjectPose> >
+    ObjectPoses;
+
+// What changed in the scene since the previous frame: the camera of the wall,
+// and the objects that moved. The nodes start from the same scene file, and
+// apply the deltas in order.
+struct SceneDelta {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  int64_t frame = 0;
+  Eigen::Vector3f camera_position = Eigen::Vector3f::Zero();
+  Eigen::Quaternionf camera_orientation = Eigen::Quaternionf::Identity();
+  ObjectPoses moved_objects;
+};
+
+// Appends the delta to bytes. The nodes share the byte order and the float
+// format of the master, as the machines of a cluster do.
+void EncodeSceneDelta(const SceneDelta& delta, std::vector<uint8_t>* bytes);
+
+// Reads a delta of EncodeSceneDelta(). Returns false if the bytes are
+// truncated.
+bool DecodeSceneDelta(const uint8_t* bytes,
+                      const size_t num_bytes,
+                      SceneDelta* delta);
+
+// This class drives the render nodes of a display wall from the master
+// process (sort-first distribution: every node renders the whole scene into
+// its tile of the frustum). Every frame, the master sends the scene delta to
+// every node, and the nodes render their tile and wait in a barrier before
+// swapping, so that the tiles of the wall always show the same frame:
+//
+//   master                      node
+//   BroadcastFrame(delta)  -->  ReceiveFrame(&delta)
+//                               ...  // Render the tile.
+//   SwapBarrier()          <--  SwapBarrier()  (ready)
+//                          -->  (swap), then glfwSwapBuffers().
+//
+// The deltas go over one TCP connection per node, with Nagle's algorithm off,
+// rather than over UDP multicast: a lost delta would leave a node with a
+// different scene, and the deltas are small next to the frames, so sending
+// them once per node costs little. The calls block, and a closed connection
+// fails every later call. POSIX only.
+//
+// Example:
+//
+// wvu::RenderMaster master;
+// master.Listen(port, num_nodes, &error_info_log);
+// while (...) {  // Rendering loop.
+//   master.BroadcastFrame(delta, &error_info_log);
+//   master.SwapBarrier(delta.frame, &error_info_log);
+// }
+class RenderMaster {
+ public:
+  RenderMaster();
+  ~RenderMaster();
+
+  // Waits for num_nodes nodes to connect on port. Returns true if successful.
+  bool Listen(const int port, const int num_nodes, std::string* error_info_log);
+
+  // Sends the delta to every node. Returns true if successful.
+  bool BroadcastFrame(const SceneDelta& delta, std::string* error_info_log);
+
+  // Waits until every node rendered the frame, and lets them swap. Returns
+  // true if successful.
+  bool SwapBarrier(const int64_t frame, std::string* error_info_log);
+
+  // Closes the connections.
+  void Close();
+
+  int num_nodes() const {
+    return node_sockets_.size();
+  }
+
+ private:
+  int listen_socket_;
+  std::vector<int> node_sockets_;
+  // Persistent between the frames, so that the broadcasts do not allocate.
+  std::vector<uint8_t> message_;
+
+  RenderMaster(const RenderMaster&) = delete;
+  RenderMaster& operator=(const RenderMaster&) = delete;
+};
+
+// The render node side of RenderMaster.
+//
+// Example:
+//
+// wvu::RenderNode node;
+// node.Connect(master_host, port, &error_info_log);
+// while (node.ReceiveFrame(&delta, &error_info_log)) {
+//   ...  // Apply the delta, and render with ComputeTileProjection().
+//   if (!node.SwapBarrier(delta.frame, &error_info_log)) break;
+//   glfwSwapBuffers(window);
+// }
+class RenderNode {
+ public:
+  RenderNode();
+  ~RenderNode();
+
+  // Connects to the master. Returns true if successful.
+  bool Connect(const std::string& host,
+               const int port,
+               std::string* error_info_log);
+
+  // Waits for the delta of the next frame. Returns true if successful, and
+  // false when the master closed the connection.
+  bool ReceiveFrame(SceneDelta* delta, std::string* error_info_log);
+
+  // Tells the master the frame is rendered, and waits until every node
+  // rendered it. Returns true if successful.
+  bool SwapBarrier(const int64_t frame, std::string* error_info_log);
+
+  // Closes the connection.
+  void Close();
+
+ private:
+  int socket_;
+  std::vector<uint8_t> message_;
+
+  RenderNode(const RenderNode&) = delete;
+  RenderNode& operator=(const RenderNode&) = delete;
+};
+
+// Statistics of the last SortLastCompositor::Composite().
+struct CompositingStatistics {
+  // Rounds of binary swap, and whether the node folded its image into a
+  // partner first because the number of nodes is not a power of two.
+  int num_rounds = 0;
+  bool folded = false;
+  int64_t num_bytes_sent = 0;
+  int64_t num_bytes_received = 0;
+};
+
+// This class merges the images of render nodes that each draw a subset of the
+// models of a scene too big for one GPU (sort-last distribution: every node
+// renders the whole frustum, and the images are composited by depth). It uses
+// binary swap: in round i, node r and node r ^ 2^i split the region of the
+// image they share, swap the halves they do not keep, and keep the nearest
+// depth of every pixel of their half. After log2(N) rounds every node owns
+// the final pixels of 1/N of the image, so every round moves half as much as
+// the previous one, and all the links are busy at once instead of one node
+// receiving everything. Rank 0 then gathers the colors of the regions. When
+// N is not a power of two, the extra nodes first fold their whole image into
+// a node of the power of two.
+//
+// The frames come from a FramebufferReadback with set_read_depths(true), so
+// that the reads do not stall the renderer. Composite() is called from the
+// readback callback, and sends the halves straight from the mapped pixel
+// buffers in the first round, without a staging copy. Every node has one
+// TCP connection to every other node, and listens on port + rank, so that
+// several nodes can share a machine. POSIX only.
+//
+// Example:
+//
+// wvu::SortLastCompositor compositor;
+// compositor.Connect(hosts, port, rank, &error_info_log);
+// wvu::FramebufferReadback readback;
+// readback.set_read_depths(true);
+// readback.Initialize(width, height, wvu::kDefaultNumReadbackBuffers,
+//                      [&](const wvu::ReadbackFrame& frame) {
+//   if (compositor.Composite(frame, &error_info_log) && rank == 0) {
+//     ...  // compositor.image() holds the composited frame.
+//   }
+// });
+// while (...) {  // Rendering loop.
+//   ...  // Render this node's models to the framebuffer.
+//   readback.ReadPixels(frame);
+// }
+class SortLastCompositor {
+ public:
+  SortLastCompositor();
+  ~SortLastCompositor();
+
+  // Connects to the other nodes, of the given hosts indexed by rank. Blocks
+  // until all of them are up. Returns true if successful.
+  bool Connect(const std::vector<std::string>& hosts,
+               const int port,
+               const int rank,
+               std::string* error_info_log);
+
+  // Composites the frame of this node with the frames of the other nodes,
+  // which must call it for the same frame. The frame must have depths.
+  // Returns true if successful.
+  bool Composite(const ReadbackFrame& frame, std::string* error_info_log);
+
+  // The composited RGBA pixels of the last frame, from the bottom row to the
+  // top one. Only valid on rank 0.
+  const std::vector<GLubyte>& image() const {
+    return colors_;
+  }
+
+  // Closes the connections.
+  void Close();
+
+  int rank() const {
+    return rank_;
+  }
+
+  int num_nodes() const {
+    return peer_sockets_.size();
+  }
+
+  const CompositingStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // Sends the pixels in [begin, end) of the colors and the depths (if not
+  // null) to the node of the given rank.
+  bool SendPixels(const int peer,
+                  const GLubyte* colors,
+                  const GLfloat* depths,
+                  const int begin,
+                  const int end);
+
+  // Receives the pixels in [begin, end) from the node of the given rank, and
+  // keeps the nearest ones in colors_ and depths_, comparing against colors
+  // and depths. If depths is null, copies the colors.
+  bool ReceivePixels(const int peer,
+                     const GLubyte* colors,
+                     const GLfloat* depths,
+                     const int begin,
+                     const int end,
+                     std::string* error_info_log);
+
+  int rank_;
+  // Sockets to the other nodes, indexed by rank, and -1 for this node.
+  std::vector<int> peer_sockets_;
+  // The image of this node, composited with those of its partners so far.
+  std::vector<GLubyte> colors_;
+  std::vector<GLfloat> depths_;
+  // The pixels of a partner, persistent between the frames.
+  std::vector<GLubyte> received_colors_;
+  std::vector<GLfloat> received_depths_;
+  CompositingStatistics statistics_;
+
+  SortLastCompositor(const SortLastCompositor&) = delete;
+  SortLastCompositor& operator=(const SortLastCompositor&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_DISTRIBUTED_RENDERING_H_
@@ -0,0 +1,497 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "dma_buf_export.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#ifdef GLUTILS_EXPORT_DMA_BUF
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif  // GLUTILS_EXPORT_DMA_BUF
+
+namespace wvu {
+namespace {
+#ifdef GLUTILS_EXPORT_DMA_BUF
+// The entry points of the EGL extensions, loaded by Supported().
+PFNEGLCREATEIMAGEKHRPROC create_image = nullptr;
+PFNEGLDESTROYIMAGEKHRPROC destroy_image = nullptr;
+PFNEGLEXPORTDMABUFIMAGEQUERYMESAPROC export_query = nullptr;
+PFNEGLEXPORTDMABUFIMAGEMESAPROC export_image = nullptr;
+PFNEGLCREATESYNCKHRPROC create_sync = nullptr;
+PFNEGLDESTROYSYNCKHRPROC destroy_sync = nullptr;
+PFNEGLDUPNATIVEFENCEFDANDROIDPROC dup_native_fence_fd = nullptr;
+
+bool HasExtension(const EGLDisplay display, const char* name) {
+  const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (extensions == nullptr) return false;
+  const size_t length = std::strlen(name);
+  for (const char* match = std::strstr(extensions, name); match != nullptr;
+       match = std::strstr(match + length, name)) {
+    if ((match == extensions || match[-1] == ' ') &&
+        (match[length] == ' ' || match[length] == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Waits for the copies of the GPU on the CPU, when there is no sync file.
+constexpr GLuint64 kCopyTimeoutNanoseconds = 1000000000;
+#endif  // GLUTILS_EXPORT_DMA_BUF
+
+// Sends the bytes as one message, with fd attached if it is not -1.
+bool SendWithFd(const int socket, const void* data, const size_t size,
+                const int fd) {
+  iovec vector;
+  vector.iov_base = const_cast<void*>(data);
+  vector.iov_len = size;
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = &vector;
+  message.msg_iovlen = 1;
+  char control[CMSG_SPACE(sizeof(int))];
+  if (fd >= 0) {
+    std::memset(control, 0, sizeof(control));
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(header), &fd, sizeof(fd));
+  }
+  while (true) {
+    const ssize_t sent = sendmsg(socket, &message, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) continue;
+    return sent == static_cast<ssize_t>(size);
+  }
+}
+
+// Receives one message of exactly size bytes, and sets fd to its attached
+// descriptor, or -1.
+bool ReceiveWithFd(const int socket, void* data, const size_t size, int* fd) {
+  *fd = -1;
+  iovec vector;
+  vector.iov_base = data;
+  vector.iov_len = size;
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = &vector;
+  message.msg_iovlen = 1;
+  char control[CMSG_SPACE(sizeof(int))];
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  ssize_t received;
+  do {
+    received = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+  const cmsghdr* header = CMSG_FIRSTHDR(&message);
+  if (received > 0 && header != nullptr && header->cmsg_level == SOL_SOCKET &&
+      header->cmsg_type == SCM_RIGHTS) {
+    std::memcpy(fd, CMSG_DATA(header), sizeof(*fd));
+  }
+  if (received != static_cast<ssize_t>(size)) {
+    if (*fd >= 0) close(*fd);
+    *fd = -1;
+    return false;
+  }
+  return true;
+}
+
+bool SetSocketAddress(const std::string& socket_path, sockaddr_un* address) {
+  std::memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address->sun_path)) return false;
+  std::memcpy(address->sun_path, socket_path.c_str(), socket_path.size());
+  return true;
+}
+
+}  // namespace
+
+DmaBufExporter::DmaBufExporter()
+    : display_(nullptr),
+      listen_socket_(-1),
+      consumer_socket_(-1),
+      native_fences_(false) {}
+
+DmaBufExporter::~DmaBufExporter() {
+  // The buffers must be deleted while the context is current, with Reset().
+  Disconnect();
+  if (listen_socket_ >= 0) close(listen_socket_);
+  for (const Buffer& buffer : buffers_) {
+    if (buffer.fd >= 0) close(buffer.fd);
+  }
+}
+
+bool DmaBufExporter::Supported() {
+#ifdef GLUTILS_EXPORT_DMA_BUF
+  const EGLDisplay display = eglGetCurrentDisplay();
+  if (display == EGL_NO_DISPLAY ||
+      !HasExtension(display, "EGL_KHR_gl_texture_2D_image") ||
+      !HasExtension(display, "EGL_MESA_image_dma_buf_export")) {
+    return false;
+  }
+  create_image = reinterpret_cast<PFNEGLCREATEIMAGEKHRPROC>(
+      eglGetProcAddress("eglCreateImageKHR"));
+  destroy_image = reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(
+      eglGetProcAddress("eglDestroyImageKHR"));
+  export_query = reinterpret_cast<PFNEGLEXPORTDMABUFIMAGEQUERYMESAPROC>(
+      eglGetProcAddress("eglExportDMABUFImageQueryMESA"));
+  export_image = reinterpret_cast<PFNEGLEXPORTDMABUFIMAGEMESAPROC>(
+      eglGetProcAddress("eglExportDMABUFImageMESA"));
+  return create_image != nullptr && destroy_image != nullptr &&
+      export_query != nullptr && export_image != nullptr;
+#else
+  return false;
+#endif  // GLUTILS_EXPORT_DMA_BUF
+}
+
+bool DmaBufExporter::Initialize(const int width,
+                                const int height,
+                                const int num_buffers,
+                                const std::string& socket_path,
+                                std::string* error_info_log) {
+  Reset();
+#ifdef GLUTILS_EXPORT_DMA_BUF
+  if (!Supported()) {
+    *error_info_log = "The context is not an EGL context with "
+        "EGL_MESA_image_dma_buf_export.";
+    return false;
+  }
+  const EGLDisplay display = eglGetCurrentDisplay();
+  display_ = display;
+  native_fences_ = HasExtension(display, "EGL_ANDROID_native_fence_sync");
+  if (native_fences_) {
+    create_sync = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(
+        eglGetProcAddress("eglCreateSyncKHR"));
+    destroy_sync = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(
+        eglGetProcAddress("eglDestroySyncKHR"));
+    dup_native_fence_fd = reinterpret_cast<PFNEGLDUPNATIVEFENCEFDANDROIDPROC>(
+        eglGetProcAddress("eglDupNativeFenceFDANDROID"));
+    native_fences_ = create_sync != nullptr && destroy_sync != nullptr &&
+        dup_native_fence_fd != nullptr;
+  }
+  buffers_.resize(num_buffers);
+  for (int i = 0; i < num_buffers; ++i) {
+    Buffer& buffer = buffers_[i];
+    // Immutable storage, so that the driver never reallocates the memory the
+    // consumer maps.
+    glGenTextures(1, &buffer.texture_id);
+    glBindTexture(GL_TEXTURE_2D, buffer.texture_id);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, &buffer.framebuffer_id);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, buffer.framebuffer_id);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, buffer.texture_id, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    const EGLint image_attributes[] = {EGL_GL_TEXTURE_LEVEL_KHR, 0, EGL_NONE};
+    const EGLImageKHR image = create_image(
+        display, eglGetCurrentContext(), EGL_GL_TEXTURE_2D_KHR,
+        reinterpret_cast<EGLClientBuffer>(
+            static_cast<uintptr_t>(buffer.texture_id)),
+        image_attributes);
+    buffer.image = image;
+    int fourcc = 0;
+    int num_planes = 0;
+    EGLuint64KHR modifier = 0;
+    EGLint stride = 0;
+    EGLint offset = 0;
+    if (image == EGL_NO_IMAGE_KHR ||
+        !export_query(display, image, &fourcc, &num_planes, &modifier) ||
+        num_planes != 1 ||
+        !export_image(display, image, &buffer.fd, &stride, &offset)) {
+      *error_info_log = "Could not export buffer " + std::to_string(i) +
+          " as a dma-buf.";
+      Reset();
+      return false;
+    }
+    buffer.description.index = i;
+    buffer.description.width = width;
+    buffer.description.height = height;
+    buffer.description.fourcc = fourcc;
+    buffer.description.stride = stride;
+    buffer.description.offset = offset;
+    buffer.description.modifier = modifier;
+  }
+  sockaddr_un address;
+  if (!SetSocketAddress(socket_path, &address)) {
+    *error_info_log = "The socket path " + socket_path + " is too long.";
+    Reset();
+    return false;
+  }
+  // Replaces the socket of a previous run.
+  unlink(socket_path.c_str());
+  listen_socket_ = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (listen_socket_ < 0 ||
+      bind(listen_socket_, reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) < 0 ||
+      listen(listen_socket_, 1) < 0 ||
+      fcntl(listen_socket_, F_SETFL, O_NONBLOCK) < 0) {
+    *error_info_log = "Could not listen on " + socket_path + ": " +
+        std::strerror(errno) + ".";
+    Reset();
+    return false;
+  }
+  socket_path_ = socket_path;
+  return true;
+#else
+  *error_info_log = "The dma-buf export is not compiled in; configure with "
+      "-DEXPORT_DMA_BUF=ON.";
+  return false;
+#endif  // GLUTILS_EXPORT_DMA_BUF
+}
+
+bool DmaBufExporter::ExportFrame(const int64_t frame) {
+#ifdef GLUTILS_EXPORT_DMA_BUF
+  if (listen_socket_ < 0) return false;
+  if (consumer_socket_ < 0) {
+    consumer_socket_ = accept(listen_socket_, nullptr, nullptr);
+    if (consumer_socket_ < 0) return false;
+    ++statistics_.num_consumers;
+    if (!SendBuffers()) {
+      Disconnect();
+      return false;
+    }
+  }
+  if (!ReceiveReleases()) {
+    Disconnect();
+    return false;
+  }
+  Buffer* free_buffer = nullptr;
+  for (Buffer& buffer : buffers_) {
+    if (!buffer.held_by_consumer) {
+      free_buffer = &buffer;
+      break;
+    }
+  }
+  if (free_buffer == nullptr) {
+    ++statistics_.num_dropped_frames;
+    return false;
+  }
+  // The copy stays on the GPU.
+  GLint draw_framebuffer_id = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_framebuffer_id);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, free_buffer->framebuffer_id);
+  const int width = free_buffer->description.width;
+  const int height = free_buffer->description.height;
+  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                    GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_framebuffer_id);
+  // The sync file signals when the copy is done, so that neither process
+  // waits here. Without sync files, the copy is waited for on the CPU.
+  int fence_fd = -1;
+  if (native_fences_) {
+    const EGLint sync_attributes[] = {EGL_SYNC_NATIVE_FENCE_FD_ANDROID,
+                                      EGL_NO_NATIVE_FENCE_FD_ANDROID,
+                                      EGL_NONE};
+    const EGLSyncKHR sync = create_sync(display_, EGL_SYNC_NATIVE_FENCE_ANDROID,
+                                        sync_attributes);
+    if (sync != EGL_NO_SYNC_KHR) {
+      // The fence only gets a file once it is flushed.
+      glFlush();
+      fence_fd = dup_native_fence_fd(display_, sync);
+      destroy_sync(display_, sync);
+    }
+  }
+  if (fence_fd < 0) {
+    const GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT,
+                     kCopyTimeoutNanoseconds);
+    glDeleteSync(sync);
+    ++statistics_.num_cpu_waits;
+  }
+  DmaBufFrame message;
+  message.frame = frame;
+  message.index = free_buffer->description.index;
+  message.has_fence = fence_fd >= 0;
+  const bool sent =
+      SendWithFd(consumer_socket_, &message, sizeof(message), fence_fd);
+  if (fence_fd >= 0) close(fence_fd);
+  if (!sent) {
+    Disconnect();
+    return false;
+  }
+  free_buffer->held_by_consumer = true;
+  ++statistics_.num_exported_frames;
+  return true;
+#else
+  return false;
+#endif  // GLUTILS_EXPORT_DMA_BUF
+}
+
+void DmaBufExporter::Reset() {
+  Disconnect();
+  if (listen_socket_ >= 0) close(listen_socket_);
+  listen_socket_ = -1;
+  if (!socket_path_.empty()) unlink(socket_path_.c_str());
+  socket_path_.clear();
+  for (Buffer& buffer : buffers_) {
+    if (buffer.fd >= 0) close(buffer.fd);
+#ifdef GLUTILS_EXPORT_DMA_BUF
+    if (buffer.image != nullptr) destroy_image(display_, buffer.image);
+#endif  // GLUTILS_EXPORT_DMA_BUF
+    glDeleteFramebuffers(1, &buffer.framebuffer_id);
+    glDeleteTextures(1, &buffer.texture_id);
+  }
+  buffers_.clear();
+  display_ = nullptr;
+  statistics_ = DmaBufExportStatistics();
+}
+
+bool DmaBufExporter::SendBuffers() {
+  const int32_t num_buffers = buffers_.size();
+  if (!SendWithFd(consumer_socket_, &num_buffers, sizeof(num_buffers), -1)) {
+    return false;
+  }
+  for (const Buffer& buffer : buffers_) {
+    if (!SendWithFd(consumer_socket_, &buffer.description,
+                    sizeof(buffer.description), buffer.fd)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DmaBufExporter::ReceiveReleases() {
+  while (true) {
+    int32_t index;
+    const ssize_t received =
+        recv(consumer_socket_, &index, sizeof(index), MSG_DONTWAIT);
+    if (received < 0 && errno == EINTR) continue;
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return true;
+    }
+    if (received != sizeof(index)) return false;
+    if (index >= 0 && index < static_cast<int>(buffers_.size())) {
+      buffers_[index].held_by_consumer = false;
+    }
+  }
+}
+
+void DmaBufExporter::Disconnect() {
+  if (consumer_socket_ >= 0) close(consumer_socket_);
+  consumer_socket_ = -1;
+  // A new consumer gets every buffer again. The previous one may still read
+  // a buffer, which then only shows a later frame.
+  for (Buffer& buffer : buffers_) buffer.held_by_consumer = false;
+}
+
+DmaBufReceiver::DmaBufReceiver() : socket_(-1) {}
+
+DmaBufReceiver::~DmaBufReceiver() {
+  Close();
+}
+
+bool DmaBufReceiver::Connect(const std::string& socket_path,
+                             std::string* error_info_log) {
+  Close();
+  sockaddr_un address;
+  if (!SetSocketAddress(socket_path, &address)) {
+    *error_info_log = "The socket path " + socket_path + " is too long.";
+    return false;
+  }
+  socket_ = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (socket_ < 0 ||
+      connect(socket_, reinterpret_cast<const sockaddr*>(&address),
+              sizeof(address)) < 0) {
+    *error_info_log = "Could not connect to " + socket_path + ": " +
+        std::strerror(errno) + ".";
+    Close();
+    return false;
+  }
+  int32_t num_buffers = 0;
+  int fd;
+  if (!ReceiveWithFd(socket_, &num_buffers, sizeof(num_buffers), &fd)) {
+    *error_info_log = "Could not receive the buffers.";
+    Close();
+    return false;
+  }
+  buffers_.resize(num_buffers);
+  buffer_fds_.assign(num_buffers, -1);
+  for (int i = 0; i < num_buffers; ++i) {
+    if (!ReceiveWithFd(socket_, &buffers_[i], sizeof(buffers_[i]),
+                       &buffer_fds_[i]) ||
+        buffer_fds_[i] < 0) {
+      *error_info_log = "Could not receive buffer " + std::to_string(i) + ".";
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DmaBufReceiver::ReceiveFrame(DmaBufFrame* frame,
+                                  int* fence_fd,
+                                  std::string* error_info_log) {
+  if (!ReceiveWithFd(socket_, frame, sizeof(*frame), fence_fd)) {
+    *error_info_log = "The exporter left.";
+    return false;
+  }
+  if (frame->index < 0 || frame->index >= static_cast<int>(buffers_.size())) {
+    if (*fence_fd >= 0) close(*fence_fd);
+    *fence_fd = -1;
+    *error_info_log = "Unexpected buffer " + std::to_string(frame->index) +
+        ".";
+    return false;
+  }
+  return true;
+}
+
+bool DmaBufReceiver::Release(const int index) {
+  const int32_t message = index;
+  return SendWithFd(socket_, &message, sizeof(message), -1);
+}
+
+void DmaBufReceiver::Close() {
+  if (socket_ >= 0) close(socket_);
+  socket_ = -1;
+  for (const int fd : buffer_fds_) {
+    if (fd >= 0) close(fd);
+  }
+  buffer_fds_.clear();
+  buffers_.clear();
+}
+
+}  // namespace wvu
@@ -0,0 +1,233 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_DMA_BUF_EXPORT_H_
+#define GLUTILS_DMA_BUF_EXPORT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+// Default number of buffers a DmaBufExporter shares with its consumer.
+constexpr int kDefaultNumDmaBufs = 3;
+
+// A buffer shared as a dma-buf: the description the consumer needs to import
+// it, e.g., with EGL_EXT_image_dma_buf_import or
+// VK_EXT_external_memory_dma_buf.
+// The layout is also the layout of the messages on the socket.
+struct DmaBufDescription {
+  int32_t index = 0;
+  int32_t width = 0;
+  int32_t height = 0;
+  // The DRM format, e.g., DRM_FORMAT_ABGR8888 for RGBA8.
+  uint32_t fourcc = 0;
+  int32_t stride = 0;
+  int32_t offset = 0;
+  uint64_t modifier = 0;
+};
+
+// A frame in a shared buffer. The layout is also the layout of the messages.
+struct DmaBufFrame {
+  int64_t frame = 0;
+  int32_t index = 0;
+  // Whether a sync file comes with the frame: the consumer waits for it to be
+  // signaled (e.g., poll() it, or import it as a semaphore) before reading
+  // the buffer. Without one, the copy finished before the frame was sent.
+  int32_t has_fence = 0;
+};
+
+// Counters of a DmaBufExporter.
+struct DmaBufExportStatistics {
+  int64_t num_exported_frames = 0;
+  // Frames dropped because the consumer held every buffer.
+  int64_t num_dropped_frames = 0;
+  // Frames sent without a sync file, after a wait on the CPU.
+  int64_t num_cpu_waits = 0;
+  int num_consumers = 0;
+};
+
+// This class shares the headless frames with a consumer process, e.g., a
+// vision pipeline, without copying them through the CPU. The frames are
+// copied on the GPU into a ring of textures exported once as dma-buf file
+// descriptors through EGL_MESA_image_dma_buf_export, and the consumer maps
+// the same memory. The descriptors go over a Unix socket (SOCK_SEQPACKET, with
+// SCM_RIGHTS), and then every frame is a DmaBufFrame message with the sync
+// file of its copy (EGL_ANDROID_native_fence_sync), so that neither process
+// waits on the CPU. The consumer sends the index back as an int32 when it is
+// done with a buffer; when it holds every buffer, the frame is dropped.
+//
+// The context must be an EGL context, i.e., GLFW built with GLFW_USE_EGL, and
+// the exporter is only compiled in with the EXPORT_DMA_BUF CMake option;
+// otherwise Supported() returns false. Linux only.
+//
+// Example:
+//
+// wvu::DmaBufExporter exporter;
+// if (!exporter.Initialize(width, height, wvu::kDefaultNumDmaBufs,
+//                          "/tmp/frames.socket", &error_info_log)) { ... }
+// while (...) {  // Rendering loop.
+//   ...  // Render into the framebuffer bound for reading.
+//   exporter.ExportFrame(frame);
+// }
+// exporter.Reset();
+class DmaBufExporter {
+ public:
+  DmaBufExporter();
+  ~DmaBufExporter();
+
+  // Returns true if the exporter is compiled in, and the current context is
+  // an EGL context with the extensions it needs.
+  static bool Supported();
+
+  // Creates the buffers, exports them, and listens on the Unix socket at
+  // socket_path. Must be called while the context is current. Returns true if
+  // successful.
+  bool Initialize(const int width,
+                  const int height,
+                  const int num_buffers,
+                  const std::string& socket_path,
+                  std::string* error_info_log);
+
+  // Accepts a waiting consumer, takes the buffers it released, and copies the
+  // framebuffer bound for reading into a free buffer for the consumer. Never
+  // blocks on the consumer. Returns true if the frame was sent.
+  bool ExportFrame(const int64_t frame);
+
+  // Closes the socket and the descriptors, and deletes the buffers. Must be
+  // called while the context is current.
+  void Reset();
+
+  bool has_consumer() const {
+    return consumer_socket_ >= 0;
+  }
+
+  const DmaBufExportStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // Sends the descriptions and the descriptors of the buffers to a new
+  // consumer. Returns true if successful.
+  bool SendBuffers();
+
+  // Takes the buffers the consumer released. Returns false if the consumer
+  // left.
+  bool ReceiveReleases();
+
+  // Closes the connection of the consumer, and takes its buffers back.
+  void Disconnect();
+
+  struct Buffer {
+    GLuint texture_id = 0;
+    GLuint framebuffer_id = 0;
+    // The EGLImageKHR of the texture, opaque so that this header does not
+    // need EGL.
+    void* image = nullptr;
+    int fd = -1;
+    DmaBufDescription description;
+    bool held_by_consumer = false;
+  };
+
+  // The EGLDisplay of the context.
+  void* display_;
+  std::vector<Buffer> buffers_;
+  std::string socket_path_;
+  int listen_socket_;
+  int consumer_socket_;
+  bool native_fences_;
+  DmaBufExportStatistics statistics_;
+
+  DmaBufExporter(const DmaBufExporter&) = delete;
+  DmaBufExporter& operator=(const DmaBufExporter&) = delete;
+};
+
+// The consumer side of a DmaBufExporter, for the process that reads the
+// frames. It owns the received descriptors, which the process imports into
+// its own API.
+//
+// Example:
+//
+// wvu::DmaBufReceiver receiver;
+// if (!receiver.Connect("/tmp/frames.socket", &error_info_log)) { ... }
+// ...  // Import receiver.buffers() and receiver.buffer_fds().
+// wvu::DmaBufFrame frame;
+// int fence_fd;
+// while (receiver.ReceiveFrame(&frame, &fence_fd, &error_info_log)) {
+//   ...  // Wait for fence_fd if any, close it, and read the buffer.
+//   receiver.Release(frame.index);
+// }
+class DmaBufReceiver {
+ public:
+  DmaBufReceiver();
+  ~DmaBufReceiver();
+
+  // Connects to the exporter and receives its buffers. Returns true if
+  // successful.
+  bool Connect(const std::string& socket_path, std::string* error_info_log);
+
+  // Waits for the next frame. Sets fence_fd to the sync file of the frame,
+  // which the caller closes, or to -1. Returns false when the exporter left.
+  bool ReceiveFrame(DmaBufFrame* frame,
+                    int* fence_fd,
+                    std::string* error_info_log);
+
+  // Gives the buffer back to the exporter. Returns true if successful.
+  bool Release(const int index);
+
+  // Closes the connection and the descriptors.
+  void Close();
+
+  const std::vector<DmaBufDescription>& buffers() const {
+    return buffers_;
+  }
+
+  const std::vector<int>& buffer_fds() const {
+    return buffer_fds_;
+  }
+
+ private:
+  int socket_;
+  std::vector<DmaBufDescription> buffers_;
+  std::vector<int> buffer_fds_;
+
+  DmaBufReceiver(const DmaBufReceiver&) = delete;
+  DmaBufReceiver& operator=(const DmaBufReceiver&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_DMA_BUF_EXPORT_H_
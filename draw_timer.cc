@@ -0,0 +1,139 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "draw_timer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+
+DrawTimer::DrawTimer(const int max_draws, const int latency)
+    : max_draws_(std::max(max_draws, 0)),
+      supported_(Supported()),
+      frames_(std::max(latency, 1)),
+      frame_slot_(0),
+      timing_draw_(false),
+      total_ms_(0.0f),
+      num_untimed_draws_(0) {}
+
+DrawTimer::~DrawTimer() {
+  Reset();
+}
+
+bool DrawTimer::Supported() {
+  return GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+}
+
+void DrawTimer::BeginFrame() {
+  frame_slot_ = (frame_slot_ + 1) % frames_.size();
+  Frame* frame = &frames_[frame_slot_];
+  ReadFrame(frame);
+  frame->draws.clear();
+  frame->num_untimed_draws = 0;
+  timing_draw_ = false;
+}
+
+void DrawTimer::ReadFrame(Frame* frame) {
+  if (frame->draws.empty()) return;
+  const int num_queries = 2 * frame->draws.size();
+  GLint available = 0;
+  glGetQueryObjectiv(frame->queries[num_queries - 1],
+                     GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) return;
+  draw_times_ = frame->draws;
+  total_ms_ = 0.0f;
+  for (int i = 0; i < static_cast<int>(draw_times_.size()); ++i) {
+    GLuint64 begin = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(frame->queries[2 * i], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame->queries[2 * i + 1], GL_QUERY_RESULT, &end);
+    draw_times_[i].gpu_ms = end > begin ? 1e-6f * (end - begin) : 0.0f;
+    total_ms_ += draw_times_[i].gpu_ms;
+  }
+  std::sort(draw_times_.begin(), draw_times_.end(),
+            [](const DrawTime& x, const DrawTime& y) {
+              return x.gpu_ms > y.gpu_ms;
+            });
+  num_untimed_draws_ = frame->num_untimed_draws;
+}
+
+void DrawTimer::BeginDraw(const GLuint object_id,
+                          const int64_t num_triangles) {
+  Frame* frame = &frames_[frame_slot_];
+  const int draw = frame->draws.size() + frame->num_untimed_draws;
+  if (!supported_ || static_cast<int>(frame->draws.size()) >= max_draws_) {
+    ++frame->num_untimed_draws;
+    return;
+  }
+  const int num_queries = 2 * (frame->draws.size() + 1);
+  if (static_cast<int>(frame->queries.size()) < num_queries) {
+    const int first_query = frame->queries.size();
+    frame->queries.resize(num_queries);
+    glGenQueries(num_queries - first_query, &frame->queries[first_query]);
+  }
+  DrawTime time;
+  time.draw = draw;
+  time.object_id = object_id;
+  time.num_triangles = num_triangles;
+  frame->draws.push_back(time);
+  glQueryCounter(frame->queries[num_queries - 2], GL_TIMESTAMP);
+  timing_draw_ = true;
+}
+
+void DrawTimer::EndDraw() {
+  if (!timing_draw_) return;
+  const Frame& frame = frames_[frame_slot_];
+  glQueryCounter(frame.queries[2 * frame.draws.size() - 1], GL_TIMESTAMP);
+  timing_draw_ = false;
+}
+
+void DrawTimer::Reset() {
+  for (Frame& frame : frames_) {
+    if (!frame.queries.empty()) {
+      glDeleteQueries(frame.queries.size(), frame.queries.data());
+    }
+    frame.queries.clear();
+    frame.draws.clear();
+    frame.num_untimed_draws = 0;
+  }
+  timing_draw_ = false;
+  draw_times_.clear();
+  total_ms_ = 0.0f;
+  num_untimed_draws_ = 0;
+}
+
+}  // namespace wvu
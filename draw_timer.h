@@ -0,0 +1,150 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_DRAW_TIMER_H_
+#define GLUTILS_DRAW_TIMER_H_
+
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+
+#include "frame_profiler.h"
+
+namespace wvu {
+// Default number of draws timed per frame. The draws past it are counted, but
+// not timed.
+constexpr int kDefaultMaxTimedDraws = 256;
+
+// The GPU time of a draw of a frame.
+struct DrawTime {
+  // The index of the draw in its frame.
+  int draw = 0;
+  // The RenderItem::object_id of the (first) item drawn.
+  GLuint object_id = 0;
+  int64_t num_triangles = 0;
+  float gpu_ms = 0.0f;
+};
+
+// This class times the draws of a frame on the GPU, e.g., to find the draws
+// whose fragment shading costs the most. Every draw is bracketed by a pair of
+// GL_TIMESTAMP queries (OpenGL 3.3 or ARB_timer_query), which may be nested in
+// the scopes of a FrameProfiler, and the queries of a frame are read latency
+// frames later, as FrameProfiler does; the frames whose queries are still not
+// available then are dropped instead of waiting for them. The GPU overlaps
+// consecutive draws, so the times are the intervals between the points where
+// the GPU reached the draws, not their exclusive costs: they add up to the
+// time of the pass, and rank the draws well, but a cheap draw following an
+// expensive one may absorb some of its time.
+//
+// The queries are created as the draws grow, so the context must be current
+// in BeginDraw().
+//
+// Example:
+//
+// wvu::DrawTimer draw_timer;
+// render_queue.set_draw_timer(&draw_timer);
+// while (...) {  // Rendering loop.
+//   draw_timer.BeginFrame();
+//   render_queue.Execute();  // Brackets every draw.
+//   for (const wvu::DrawTime& time : draw_timer.draw_times()) {
+//     ...  // Slowest first.
+//   }
+// }
+class DrawTimer {
+ public:
+  // Parameters:
+  //   max_draws  The number of draws timed per frame.
+  //   latency  The number of frames before the queries of a frame are read.
+  explicit DrawTimer(const int max_draws = kDefaultMaxTimedDraws,
+                     const int latency = kDefaultGpuQueryLatency);
+  ~DrawTimer();
+
+  // Returns true if timer queries are supported.
+  static bool Supported();
+
+  // Starts a frame, reading the times of the frame issued latency frames ago.
+  void BeginFrame();
+
+  // Starts and stops timing a draw. The draws are not nested.
+  void BeginDraw(const GLuint object_id, const int64_t num_triangles);
+  void EndDraw();
+
+  // Deletes the queries and the times.
+  void Reset();
+
+  // Returns the draws of the latest frame read, slowest first.
+  const std::vector<DrawTime>& draw_times() const {
+    return draw_times_;
+  }
+
+  // Returns the sum of the times of the latest frame read.
+  float total_ms() const {
+    return total_ms_;
+  }
+
+  // Returns the number of draws of the latest frame read past max_draws.
+  int num_untimed_draws() const {
+    return num_untimed_draws_;
+  }
+
+ private:
+  // The queries and the draws of a frame in flight.
+  struct Frame {
+    // Two queries per draw, at its beginning and at its end. The queries are
+    // kept for the next frames of the slot.
+    std::vector<GLuint> queries;
+    std::vector<DrawTime> draws;
+    int num_untimed_draws = 0;
+  };
+
+  // Reads the times of the frame of a slot, unless they are not available.
+  void ReadFrame(Frame* frame);
+
+  const int max_draws_;
+  const bool supported_;
+  std::vector<Frame> frames_;
+  int frame_slot_;
+  // True between BeginDraw() and EndDraw() of a timed draw.
+  bool timing_draw_;
+  std::vector<DrawTime> draw_times_;
+  float total_ms_;
+  int num_untimed_draws_;
+
+  DrawTimer(const DrawTimer&) = delete;
+  DrawTimer& operator=(const DrawTimer&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_DRAW_TIMER_H_
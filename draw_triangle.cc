@@ -33,9 +33,14 @@
 // Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
 
 #define _USE_MATH_DEFINES  // For using M_PI.
+#include <algorithm>
 #include <cmath>
-#include <iostream>
+#include <functional>
+#include <memory>
+#include <random>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 // The macro below tells the linker to use the GLEW library in a static way.
@@ -53,14 +58,345 @@
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
 
+#include "allocation_tracker.h"
+#include "async_log_sink.h"
+#include "buffer_allocator.h"
+#include "camera.h"
+#include "clustered_lighting.h"
+#include "context_pool.h"
+#include "deferred_shading.h"
+#include "dma_buf_export.h"
+#include "draw_timer.h"
+#include "dynamic_resolution.h"
+#include "environment_lighting.h"
+#include "frame_arena.h"
+#include "frame_encoder.h"
+#include "frame_log.h"
+#include "frame_pacer.h"
+#include "frame_pipeline.h"
+#include "frame_profiler.h"
+#include "frame_streaming.h"
+#include "frame_uniforms.h"
+#include "framebuffer_readback.h"
+#include "gl_call_counter.h"
+#include "gl_capture.h"
+#include "gl_debug_output.h"
+#include "gl_state_cache.h"
+#include "gpu_mesh.h"
+#include "gpu_picking.h"
+#include "gpu_resources.h"
+#include "huge_pages.h"
+#include "input_buffer.h"
+#include "input_latency.h"
+#include "instance_buffer.h"
+#include "job_system.h"
+#include "metrics_server.h"
+#include "mesh_lod.h"
+#include "mesh_orientation.h"
+#include "mesh_picking.h"
+#include "mesh_uploader.h"
+#include "model.h"
+#include "multi_view.h"
+#include "multi_window.h"
+#include "offscreen_framebuffer.h"
+#include "overdraw_view.h"
+#include "particle_system.h"
+#include "performance_hud.h"
+#include "pose_batch_renderer.h"
+#include "post_processing.h"
+#include "render_queue.h"
+#include "render_throttle.h"
+#include "ring_buffer.h"
+#include "scene_file.h"
 #include "shader_program.h"
+#include "shared_vertex_arrays.h"
+#include "startup_trace.h"
+#include "stripifier.h"
+#include "terrain.h"
+#include "texture_cache.h"
+#include "texture_manager.h"
+#include "texture_source.h"
+#include "thread_placement.h"
+#include "tiled_renderer.h"
+#include "transforms.h"
+#include "variable_rate_shading.h"
+
+// Use the right namespace for google flags (gflags).
+#ifdef GFLAGS_NAMESPACE_GOOGLE
+#define CS470_GFLAGS_NAMESPACE google
+#else
+#define CS470_GFLAGS_NAMESPACE gflags
+#endif
+
+DEFINE_string(async_log_file, "",
+              "Writes the log below FATAL into this file, or to stderr if it "
+              "is \"-\", on a background thread, so the render and the job "
+              "threads never wait for the writes. The messages logged while "
+              "its queue is full are dropped.");
+DEFINE_int32(frame_log_interval, 0,
+             "Logs the per-frame debug messages once every this many frames. "
+             "Zero disables them.");
+DEFINE_int32(num_shared_contexts, 2,
+             "Number of hidden contexts sharing the objects of the window, "
+             "handed out to the worker threads. The mesh uploader takes one.");
+DEFINE_int32(main_thread_cpu, -1,
+             "Pins the main thread, which renders with the OpenGL context, to "
+             "this CPU, and the workers of the job system to the other CPUs of "
+             "its NUMA node first. -1 leaves the threads to the scheduler.");
+DEFINE_int32(main_thread_niceness, 0,
+             "Niceness of the main thread, from -20 to 19. Negative values "
+             "raise its priority, and need CAP_SYS_NICE.");
+DEFINE_string(huge_pages, "off",
+              "Backs the large frame arenas and the mapped asset files with "
+              "huge pages: off, transparent (madvise) or explicit (the "
+              "reserved pool of vm.nr_hugepages, falling back to transparent "
+              "pages).");
+DEFINE_int32(gpu_memory_budget_mb, 0,
+             "Megabytes of buffer storage the demo may keep alive. Zero "
+             "disables the budget.");
+DEFINE_string(frame_pacing, "vsync",
+              "Frame pacing mode: uncapped, vsync, adaptive_vsync (falls back "
+              "to vsync without EXT_swap_control_tear), frame_limiter or "
+              "just_in_time (vsync, starting the frames as late as the "
+              "refresh rate of the monitor allows).");
+DEFINE_double(target_frame_rate, 60.0,
+              "Frames per second of the frame_limiter pacing mode, and the "
+              "refresh rate of the just_in_time mode if the monitor does not "
+              "report one.");
+DEFINE_double(background_frame_rate, 0.0,
+              "Frames per second while the window is not focused, or 0 for "
+              "the full rate. Iconified windows render no frames.");
+DEFINE_double(simulation_rate, 60.0,
+              "Steps per second of the simulation, which runs on its own "
+              "thread independently of the frame rate.");
+DEFINE_int32(trace_frames, 0,
+             "Captures the scopes of the first this many frames into "
+             "--trace_file. Pressing T captures the same number of frames "
+             "again, or 120 frames when zero.");
+DEFINE_bool(debug_context, false,
+            "Creates a debug context, and logs the performance messages of "
+            "the driver with the frame log. Debug contexts are slower.");
+DEFINE_bool(show_hud, false,
+            "Shows the performance overlay at start-up. H toggles it, O "
+            "toggles the overdraw heatmap, and G the GPU times of the "
+            "slowest draws in the overlay.");
+DEFINE_bool(measure_input_latency, false,
+            "Logs the latency from the input events to their presentation, "
+            "with the frame log.");
+DEFINE_bool(picking, false,
+            "Indexes the triangles of the model at load, and logs the "
+            "triangle under the cursor when the left mouse button is "
+            "pressed.");
+DEFINE_bool(gpu_picking, false,
+            "Logs the object under the cursor when the left mouse button is "
+            "pressed, drawing the IDs of the objects into a pixel read back "
+            "on a later frame.");
+DEFINE_bool(deferred_deletion, true,
+            "Deletes the OpenGL objects once the GPU has finished the frames "
+            "in flight using them, instead of at once.");
+DEFINE_int32(allocation_check_frames, 0,
+             "Checks that this many frames after --allocation_warmup_frames do "
+             "not allocate, then exits with an error if any did. Needs a build "
+             "with the TRACK_ALLOCATIONS option. The logged frames allocate, "
+             "so use it with --frame_log_interval=0.");
+DEFINE_int32(allocation_warmup_frames, 60,
+             "Frames that may allocate before --allocation_check_frames.");
+DEFINE_bool(headless, false,
+            "Renders into an offscreen framebuffer of a hidden window, e.g., "
+            "on servers without a display. The frames are not paced.");
+DEFINE_int32(headless_width, 1920, "Width of the headless frames.");
+DEFINE_int32(headless_height, 1080, "Height of the headless frames.");
+DEFINE_int32(headless_frames, 1000,
+             "Frames rendered in headless mode before exiting. Zero renders "
+             "until the process is stopped.");
+DEFINE_bool(readback, false,
+            "Reads the headless frames back to the CPU through pixel buffer "
+            "objects.");
+DEFINE_string(record_file, "",
+              "Records the headless frames into a .y4m video, or a sequence "
+              "of .png images whose name has an integer conversion for the "
+              "frame number, e.g., frame_%06d.png.");
+DEFINE_int32(record_frame_rate, 60, "Frames per second of the recording.");
+DEFINE_string(dma_buf_socket, "",
+              "Shares the headless frames with a consumer process as dma-bufs, "
+              "through a Unix socket at this path. Needs an EGL context; see "
+              "dma_buf_export.h.");
+DEFINE_int32(stream_port, 0,
+             "Streams the headless frames to a client on this port, as tile "
+             "deltas compressed with LZ4, and handles the input of the "
+             "client. Zero disables the streaming.");
+DEFINE_int32(metrics_port, 0,
+             "Serves the metrics of the frames in the Prometheus format at "
+             "/metrics on this port, and the live knobs at /knobs. Zero "
+             "disables the server.");
+DEFINE_string(camera_poses_file, "",
+              "Renders the model from every view matrix of this file into the "
+              "tiles of atlas pages, and exits. The file lists 16 numbers per "
+              "pose, row by row; lines starting with # are comments.");
+DEFINE_int32(pose_tile_size, 128, "Width and height of a pose tile.");
+DEFINE_int32(pose_atlas_tiles, 8,
+             "Tiles per row and per column of the pose atlas pages.");
+DEFINE_string(pose_atlas_file, "",
+              "Writes the pose atlas pages into a .y4m video, or a sequence of "
+              ".png images, e.g., atlas_%04d.png.");
+DEFINE_string(poster_file, "",
+              "Renders the view of the camera into a binary PPM image of "
+              "--poster_width x --poster_height pixels, tile by tile, and "
+              "exits.");
+DEFINE_int32(poster_width, 16384, "Width of the poster image.");
+DEFINE_int32(poster_height, 16384, "Height of the poster image.");
+DEFINE_int32(poster_tile_size, wvu::kDefaultRenderTileSize,
+             "Width and height of the tiles of the poster image.");
+DEFINE_bool(depth_prepass, false,
+            "Draws the depths of the scene before shading it, so that each "
+            "pixel is shaded once.");
+DEFINE_bool(sort_front_to_back, false,
+            "Sorts the draws front to back before grouping them by state, "
+            "so the early depth test rejects the hidden fragments.");
+DEFINE_int32(msaa_samples, 0,
+             "Samples per pixel of the multisampled framebuffer the scene is "
+             "rendered into and resolved from. 0 disables MSAA.");
+DEFINE_int32(msaa_benchmark_frames, 0,
+             "Renders this many frames with each sample count, up to the "
+             "maximum of the GPU, logs their times and exits.");
+DEFINE_bool(resizable, false,
+            "Lets the window be resized. The projection and the render "
+            "targets follow the size of its framebuffer.");
+DEFINE_bool(dynamic_resolution, false,
+            "Scales the resolution of the scene to hold a GPU frame time, and "
+            "stretches it over the output.");
+DEFINE_double(dynamic_resolution_target_ms, 0.0,
+              "GPU time per frame held by --dynamic_resolution, or 0 for the "
+              "period of --target_frame_rate.");
+DEFINE_double(dynamic_resolution_min_scale, 0.5,
+              "Smallest fraction of the output size rendered by "
+              "--dynamic_resolution.");
+DEFINE_bool(variable_rate_shading, false,
+            "Shades the periphery of the scene, the whole scene in fast "
+            "motion, and the tiles under the overlay at coarser rates. Needs "
+            "NV_shading_rate_image.");
+DEFINE_double(shading_rate_inner_radius, 0.5,
+              "Radius of the full-rate center of --variable_rate_shading, in "
+              "fractions of the half diagonal of the frame.");
+DEFINE_double(shading_rate_outer_radius, 0.8,
+              "Radius beyond which --variable_rate_shading shades blocks of "
+              "4x4 pixels, in fractions of the half diagonal of the frame.");
+DEFINE_double(lod_pixel_error, 1.0,
+              "Largest screen error in pixels of the selected level of "
+              "detail. Larger errors select coarser levels.");
+DEFINE_int32(num_views, 1,
+             "Splits the window into this many views of the model from "
+             "cameras around it, rendered in a single pass with "
+             "ARB_viewport_array when supported. At most 16.");
+DEFINE_int32(num_windows, 1,
+             "Shows the model in this many windows, from cameras around it, "
+             "sharing the GPU resources of the first window. Needs OpenGL "
+             "4.3 or ARB_vertex_attrib_binding.");
+DEFINE_string(texture_file, "",
+              "Texture of the model: a KTX file, or an image decoded in the "
+              "background into --texture_cache_directory. Its mip levels are "
+              "streamed as the model comes closer. A checkerboard is used "
+              "until it is loaded.");
+DEFINE_string(texture_cache_directory, ".",
+              "Directory of the decoded images, mapped in the next runs.");
+DEFINE_string(environment_map, "",
+              "Equirectangular Netpbm image of the environment, prefiltered "
+              "on the GPU at the first run and read from "
+              "--texture_cache_directory in the next runs.");
+DEFINE_int32(num_lights, 0,
+             "Lights the model with this many point lights around it, "
+             "shaded with clustered forward lighting, or deferred if the "
+             "scene file asks for it. Needs shader storage buffers.");
+DEFINE_int32(num_particles, 0,
+             "Draws a fountain of this many particles under the model.");
+DEFINE_bool(cpu_particles, false,
+            "Simulates the particles with the SIMD kernels of the CPU instead "
+            "of a compute shader.");
+DEFINE_bool(terrain, false,
+            "Draws a generated terrain under the model, with continuous "
+            "levels of detail.");
+DEFINE_string(startup_trace, "",
+              "Chrome trace JSON file of the startup phases, written once the "
+              "first frame shows the mesh. Empty only logs them.");
+DEFINE_string(shader_cache_directory, "",
+              "Existing directory of the program binary cache of the model "
+              "program. Empty disables the cache.");
+DEFINE_string(trace_file, "frame_trace.json",
+              "Chrome trace (chrome://tracing or Perfetto) JSON file of the "
+              "captured frames.");
+DEFINE_int32(capture_frames, 0,
+             "Records the OpenGL calls of the first frames into "
+             "--capture_file, to time them with the replay tool. Needs the "
+             "COUNT_GL_CALLS build option. Zero disables the capture.");
+DEFINE_string(capture_file, "frames.glcapture",
+              "Capture file of the OpenGL calls of --capture_frames.");
+DEFINE_string(post_effects, "",
+              "Chain of post-processing effects of the frame (see "
+              "post_processing.h), e.g., \"ambient_occlusion; bloom; "
+              "tone_mapping exposure=1.5; vignette\". Does not support "
+              "MSAA.");
+DEFINE_string(scene_file, "",
+              "Draws the objects of this scene file (see scene_file.h) with "
+              "the model, loading their meshes as they come into view.");
 
 // Annonymous namespace for constants and helper functions.
 namespace {
 // Window dimensions.
 constexpr int kWindowWidth = 640;
 constexpr int kWindowHeight = 480;
+// Distance to the far plane of the camera.
+constexpr GLfloat kFarPlaneDistance = 10.0f;
+// Bytes of per-frame data streamed through the ring buffer.
+constexpr GLsizeiptr kRingBufferFrameCapacity = 64 * 1024;
+// Frames captured by the trace key when --trace_frames is zero.
+constexpr int kDefaultNumTraceFrames = 120;
+// Size and number of squares per side of the default texture.
+constexpr int kCheckerboardSize = 512;
+constexpr int kCheckerboardNumSquares = 8;
+// Seconds the loop waits for events while the compositor does not show the
+// frames of the window.
+constexpr double kFrameReadyTimeout = 0.1;
+// The object IDs of the model and of the first object of the scene, drawn by
+// the ID pass of --gpu_picking. 0 is the background.
+constexpr GLuint kModelObjectId = 1;
+constexpr GLuint kFirstSceneObjectId = 2;
+
+// The state of the animation handed from the simulation thread to the render
+// thread.
+struct AnimationPacket {
+  // Time of the current angle, in the clock of the pipeline.
+  double simulation_time = 0.0;
+  GLfloat previous_angle = 0.0f;
+  GLfloat current_angle = 0.0f;
+};
+
+// Set by the key callback to capture a trace in the render loop.
+bool trace_requested = false;
+// Toggled by the key callback to show the performance overlay.
+bool show_hud = false;
+// Toggled by the key callback to show the overdraw heatmap in place of the
+// scene, and to time the draws listed by the overlay.
+bool show_overdraw = false;
+bool time_draws = false;
+// The size of the framebuffer of the window, kept by the framebuffer size
+// callback, which flags the changes for the render loop.
+int window_framebuffer_width = 0;
+int window_framebuffer_height = 0;
+bool window_framebuffer_resized = false;
+// Set by the frame callback once the compositor showed the last frame, and
+// cleared by the swaps. Hidden or occluded windows on Wayland stay unready.
+bool window_frame_ready = true;
+// Skips or slows down the frames of iconified and unfocused windows, fed by
+// their callbacks.
+wvu::RenderThrottle render_throttle;
+// The last cursor position in screen coordinates, kept by the mouse handler,
+// which flags the presses of the left button for picking.
+double cursor_x = 0.0;
+double cursor_y = 0.0;
+bool pick_requested = false;
 
 // // Triangle vertices (in the model space).
 // // Note that we don't use these vertices anymore, since we have now our class
@@ -81,17 +417,48 @@ constexpr int kWindowHeight = 480;
 // Note that the position variable is of type vec3, which is a 3D dimensional
 // vector. The layout keyword determines the way the VAO buffer is arranged in
 // memory. This way the shader can read the vertices correctly.
-const std::string vertex_shader_src =
-    "#version 330 core\n"
+// The camera matrices come from the FrameUniforms block (see frame_uniforms.h),
+// which is shared by all the shader programs and written once per frame. The
+// render queue multiplies them with the model matrix once per draw, so the
+// shader transforms the vertices by model_view_projection alone. The lit
+// shaders define VIEW_POSITION: they need the view-space positions, which are
+// transformed by model_view and then projected.
+// The model has no texture coordinates, so they are projected from the
+// positions.
+const std::string vertex_shader_body =
     "layout (location = 0) in vec3 position;\n"
-    "uniform mat4 model;\n"
-    "uniform mat4 view;\n"
-    "uniform mat4 projection;\n"
+    "out vec2 texture_coordinate;\n"
+    "layout (std140) uniform FrameUniforms {\n"
+    "  mat4 view;\n"
+    "  mat4 projection;\n"
+    "  mat4 view_projection;\n"
+    "  vec4 camera_position;\n"
+    "  vec4 time;\n"
+    "};\n"
+    "#ifdef VIEW_POSITION\n"
+    "out vec3 view_position;\n"
+    "uniform mat4 model_view;\n"
+    "#else\n"
+    "uniform mat4 model_view_projection;\n"
+    "#endif\n"
     "\n"
     "void main() {\n"
-    "gl_Position = projection * view * model * vec4(position, 1.0f);\n"
+    "#ifdef VIEW_POSITION\n"
+    "view_position = (model_view * vec4(position, 1.0f)).xyz;\n"
+    "gl_Position = projection * vec4(view_position, 1.0f);\n"
+    "#else\n"
+    "gl_Position = model_view_projection * vec4(position, 1.0f);\n"
+    "#endif\n"
+    "texture_coordinate = position.xy - position.zz;\n"
     "}\n";
 
+// Returns the vertex shader of the model, with the view-space positions if
+// lit.
+std::string VertexShaderSource(const bool lit) {
+  return std::string("#version 330 core\n") +
+      (lit ? "#define VIEW_POSITION\n" : "") + vertex_shader_body;
+}
+
 // Fragment shader follows standard 3.3.0. The goal of the fragment shader is to
 // calculate the color of the pixel corresponding to a vertex. This is why we
 // declare a variable named color of type vec4 (4D vector) as its output. This
@@ -103,192 +470,177 @@ const std::string fragment_shader_src =
     "color = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
     "}\n";
 
+// The fragment shader of the model, sampling its texture, bound to texture
+// unit 0 by the render queue.
+const std::string textured_fragment_shader_src =
+    "#version 330 core\n"
+    "in vec2 texture_coordinate;\n"
+    "uniform sampler2D material;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "color = texture(material, texture_coordinate);\n"
+    "}\n";
+
+// The fragment shader of the model lit by --num_lights lights. The
+// declaration of the clustered lighting is inserted after the version line.
+// The model has no normals, so the faces are shaded flat with the normal of
+// the plane of their fragments.
+const std::string lit_fragment_shader_body =
+    "in vec2 texture_coordinate;\n"
+    "in vec3 view_position;\n"
+    "uniform sampler2D material;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "vec3 normal = normalize(cross(dFdx(view_position),\n"
+    "                              dFdy(view_position)));\n"
+    "vec3 albedo = texture(material, texture_coordinate).rgb;\n"
+    "color = vec4(0.05f * albedo +\n"
+    "             ClusteredLighting(view_position, normal, albedo), 1.0f);\n"
+    "}\n";
+
+// The fragment shader writing the G-buffer of a scene with deferred lighting.
+// The declaration of the G-buffer outputs is inserted after the version line.
+const std::string gbuffer_fragment_shader_body =
+    "in vec2 texture_coordinate;\n"
+    "in vec3 view_position;\n"
+    "uniform sampler2D material;\n"
+    "void main() {\n"
+    "vec3 normal = normalize(cross(dFdx(view_position),\n"
+    "                              dFdy(view_position)));\n"
+    "WriteGBuffer(normal, texture(material, texture_coordinate).rgb, 0.05f);\n"
+    "}\n";
+
+// The fragment shader of the depth prepass. The depths are written by the
+// fixed function, so the shader does nothing.
+const std::string depth_fragment_shader_src =
+    "#version 330 core\n"
+    "void main() {\n"
+    "}\n";
+
+// The vertex shader of the split views. The block of the views and its
+// functions are inserted after the version line.
+const std::string multi_view_vertex_shader_body =
+    "layout (location = 0) in vec3 position;\n"
+    "uniform mat4 model;\n"
+    "\n"
+    "void main() {\n"
+    "gl_Position = MultiViewProjection() * model * vec4(position, 1.0f);\n"
+    "}\n";
+
 // Error callback function. This function follows the required signature of
 // GLFW. See http://www.glfw.org/docs/3.0/group__error.html for more
 // information.
 static void ErrorCallback(int error, const char* description) {
-  std::cerr << "ERROR: " << description << std::endl;
+  LOG(ERROR) << description;
 }
 
-// Key callback. This function follows the required signature of GLFW. See
+// Handles a key event buffered by the wvu::InputBuffer of the window. See
 // http://www.glfw.org/docs/latest/input_guide.html fore more information.
-static void KeyCallback(GLFWwindow* window,
-                        int key,
-                        int scancode,
-                        int action,
-                        int mods) {
-  if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+static void HandleKey(GLFWwindow* window, const wvu::InputEvent& event) {
+  if (event.type != wvu::INPUT_KEY || event.action != GLFW_PRESS) return;
+  if (event.code == GLFW_KEY_ESCAPE) {
     glfwSetWindowShouldClose(window, GL_TRUE);
   }
-}
-
-// Class that will help us keep the state of any model more easily.
-class Model {
-public:
-  // Constructor.
-  // Params
-  //  orientation  Axis of rotation whose norm is the angle
-  //     (aka Rodrigues vector).
-  //  position  The position of the object in the world.
-  //  vertices  The vertices forming the object.
-  Model(const Eigen::Vector3f& orientation,
-        const Eigen::Vector3f& position,
-        const Eigen::MatrixXf& vertices) {
-    orientation_ = orientation;
-    position_ = position;
-    vertices_ = vertices;
+  if (event.code == GLFW_KEY_T) {
+    trace_requested = true;
   }
-
-  // Constructor.
-  // Params
-  //  orientation  Axis of rotation whose norm is the angle
-  //     (aka Rodrigues vector).
-  //  position  The position of the object in the world.
-  //  vertices  The vertices forming the object.
-  //  indices  Indices for EBO.
-  Model(const Eigen::Vector3f& orientation,
-        const Eigen::Vector3f& position,
-        const Eigen::MatrixXf& vertices,
-        const std::vector<GLuint>& indices) {
-    orientation_ = orientation;
-    position_ = position;
-    vertices_ = vertices;
-    indices_ = indices;
-  }
-
-
-  // Default destructor.
-  ~Model() {}
-
-  // Setters set members by *copying* input parameters.
-  void SetOrientation(const Eigen::Vector3f& orientation) {
-    orientation_ = orientation;
+  if (event.code == GLFW_KEY_H) {
+    show_hud = !show_hud;
   }
-
-  void SetPosition(const Eigen::Vector3f& position);
-
-  // If we want to avoid copying, we can return a pointer to
-  // the member. Note that making public the attributes work
-  // if we want to modify directly the members. However, this
-  // is a matter of design.
-  Eigen::Vector3f* mutable_orientation() {
-    return &orientation_;
+  if (event.code == GLFW_KEY_O) {
+    show_overdraw = !show_overdraw;
   }
-
-  Eigen::Vector3f* mutable_position() {
-    return &position_;
+  if (event.code == GLFW_KEY_G) {
+    time_draws = !time_draws;
   }
+}
 
-  // Getters, return a const reference to the member.
-  const Eigen::Vector3f& GetOrientation() {
-    return orientation_;
+// Handles a mouse event buffered by the wvu::InputBuffer of the window.
+static void HandleMouse(const wvu::InputEvent& event) {
+  if (event.type == wvu::INPUT_CURSOR_POSITION) {
+    cursor_x = event.x;
+    cursor_y = event.y;
   }
-
-  const Eigen::Vector3f& GetPosition() {
-    return position_;
+  if (event.type == wvu::INPUT_MOUSE_BUTTON &&
+      event.code == GLFW_MOUSE_BUTTON_LEFT && event.action == GLFW_PRESS) {
+    pick_requested = true;
   }
+}
 
-  const Eigen::MatrixXf& vertices() const {
-    return vertices_;
-  }
+// Computes the cursor position in normalized device coordinates. Returns
+// false if the window has no area.
+bool GetCursorPoint(GLFWwindow* window, Eigen::Vector2f* point) {
+  // The cursor is in screen coordinates, which may differ from the pixels of
+  // the framebuffer.
+  int window_width, window_height;
+  glfwGetWindowSize(window, &window_width, &window_height);
+  if (window_width == 0 || window_height == 0) return false;
+  *point = Eigen::Vector2f(2.0 * cursor_x / window_width - 1.0,
+                           1.0 - 2.0 * cursor_y / window_height);
+  return true;
+}
 
-  const std::vector<GLuint>& indices() const {
-    return indices_;
+// Logs the triangle of the model under the cursor.
+void PickTriangle(GLFWwindow* window,
+                  const wvu::MeshPicker& picker,
+                  const Eigen::Matrix4f& model_view_projection) {
+  Eigen::Vector2f point;
+  if (!GetCursorPoint(window, &point)) return;
+  Eigen::Vector3f origin, direction;
+  wvu::ComputeViewportRay(model_view_projection, point, &origin, &direction);
+  wvu::MeshHit hit;
+  if (picker.Raycast(origin, direction, 1.0f, &hit)) {
+    LOG(INFO) << "Picked the triangle " << hit.triangle
+              << " at the barycentric coordinates "
+              << hit.barycentric.transpose() << ".";
+  } else {
+    LOG(INFO) << "No triangle under the cursor.";
   }
-
-private:
-  // Attributes.
-  // The convention we will use is to define a '_' after the name
-  // of the attribute.
-  Eigen::Vector3f orientation_;
-  Eigen::Vector3f position_;
-  Eigen::MatrixXf vertices_;
-  std::vector<GLuint> indices_;
-};
-
-// Implements the setter for position. Note that the class somehow defines
-// a namespace.
-void Model::SetPosition(const Eigen::Vector3f& position) {
-  position_ = position;
 }
 
-// -------------------- Helper Functions ----------------------------------
-Eigen::Matrix4f ComputeTranslation(
-  const Eigen::Vector3f& offset) {
-  Eigen::Matrix4f transformation = Eigen::Matrix4f::Identity();
-  transformation.col(3) = offset.homogeneous();
-  return transformation;
+// Logs the object read back by the GPU picker.
+void LogGpuPick(const wvu::GpuPick& pick, const int64_t frame) {
+  std::string object;
+  if (pick.object_id == kModelObjectId) {
+    object = "the model";
+  } else if (pick.object_id >= kFirstSceneObjectId) {
+    object = "the object " +
+        std::to_string(pick.object_id - kFirstSceneObjectId) +
+        " of the scene";
+  } else {
+    LOG(INFO) << "No object under the cursor.";
+    return;
+  }
+  LOG(INFO) << "Picked " << object << " at the depth " << pick.depth
+            << ", read back after " << frame - pick.frame << " frames.";
 }
 
-Eigen::Matrix4f ComputeRotation(const Eigen::Vector3f& axis,
-                                const GLfloat angle) {
-  Eigen::AngleAxisf rotation(angle, axis);
-  Eigen::Matrix4f transformation = Eigen::Matrix4f::Identity();
-  Eigen::Matrix3f rot3 = rotation.matrix();
-  transformation.block(0, 0, 3, 3)  = rot3;
-  return transformation;
+// Keeps the size of the framebuffer of the window. GLFW also reports the
+// moves and the repeated sizes of some window managers, which are ignored.
+static void FramebufferSizeCallback(GLFWwindow* window,
+                                    int width,
+                                    int height) {
+  if (width == window_framebuffer_width &&
+      height == window_framebuffer_height) {
+    return;
+  }
+  window_framebuffer_width = width;
+  window_framebuffer_height = height;
+  window_framebuffer_resized = true;
 }
 
-// General form.
-Eigen::Matrix4f ComputeProjectionMatrix(
-  const GLfloat left, 
-  const GLfloat right, 
-  const GLfloat top, 
-  const GLfloat bottom, 
-  const GLfloat near, 
-  const GLfloat far) {
-  Eigen::Matrix4f projection = Eigen::Matrix4f::Identity();
-  projection(0, 0) = 2.0 * near / (right - left);
-  projection(1, 1) = 2.0 * near / (top - bottom);
-  projection(2, 2) = -(far + near) / (far - near);
-  projection(0, 2) = (right + left) / (right - left);
-  projection(1, 2) = (top + bottom) / (top - bottom);
-  projection(2, 3) = -2.0 * far * near / (far - near);
-  projection(3, 3) = 0.0f;
-  projection(3, 2) = -1.0f;
-  return projection;
+static void WindowFrameCallback(GLFWwindow* window) {
+  window_frame_ready = true;
 }
 
-// Mathematical constants. The right way to get PI in C++ is to use the
-// macro M_PI. To do so, we have to include math.h or cmath and define
-// the _USE_MATH_DEFINES macro to enable these constants. See the header
-// section.
-constexpr GLfloat kHalfPi = 0.5f * static_cast<GLfloat>(M_PI);
-
-// Compute cotangent. Since C++ does not provide cotangent, we implement it
-// as follows. Recall that cotangent is essentially tangent flipped and
-// translated 90 degrees (or PI / 2 radians). To do the flipping and translation
-// we have to do PI / 2 - angle. Subtracting the angle flips the curve.
-// See the plots for http://mathworld.wolfram.com/Cotangent.html and
-// http://mathworld.wolfram.com/Tangent.html
-inline GLfloat ComputeCotangent(const GLfloat angle) {
-  return tan(kHalfPi - angle);
+static void WindowIconifyCallback(GLFWwindow* window, int iconified) {
+  render_throttle.SetIconified(iconified == GL_TRUE);
 }
 
-// Reparametrization of the ComputeProjectionMatrix. This function only
-// requires 4 parameters rather than 6 parameters.
-Eigen::Matrix4f ComputeProjectionMatrix(const GLfloat field_of_view,
-                                        const GLfloat aspect_ratio,
-                                        const GLfloat near,
-                                        const GLfloat far) {
-  // Create the projection matrix.
-  const GLfloat y_scale = ComputeCotangent(0.5f * field_of_view);
-  const GLfloat x_scale = y_scale / aspect_ratio;
-  const GLfloat planes_distance = far - near;
-  const GLfloat z_scale =
-      -(near + far) / planes_distance;
-  const GLfloat homogeneous_scale =
-      -2 * near * far / planes_distance;
-  Eigen::Matrix4f projection_matrix;
-  projection_matrix << x_scale, 0.0f, 0.0f, 0.0f,
-      0.0f, y_scale, 0.0f, 0.0f,
-      0.0f, 0.0f, z_scale, homogeneous_scale,
-      0.0f, 0.0f, -1.0f, 0.0f;
-  return projection_matrix;
+static void WindowFocusCallback(GLFWwindow* window, int focused) {
+  render_throttle.SetFocused(focused == GL_TRUE);
 }
 
-// -------------------- End of Helper Functions --------------------------------
-
 // Configures glfw.
 void SetWindowHints() {
   // Sets properties of windows and have to be set before creation.
@@ -299,184 +651,526 @@ void SetWindowHints() {
   // Sets the OpenGL profile.
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-  // Sets the property of resizability of a window.
-  glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+  // Drivers report most of their performance messages in debug contexts only.
+  glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT,
+                 FLAGS_debug_context ? GL_TRUE : GL_FALSE);
+  // Sets the property of resizability of a window. The MSAA benchmark keeps
+  // the size it measures.
+  glfwWindowHint(GLFW_RESIZABLE,
+                 FLAGS_resizable && FLAGS_msaa_benchmark_frames == 0 ?
+                 GL_TRUE : GL_FALSE);
 }
 
 // Configures the view port.
 // Note: All the OpenGL functions begin with gl, and all the GLFW functions
 // begin with glfw. This is because they are C-functions -- C does not have
 // namespaces.
-void ConfigureViewPort(GLFWwindow* window) {
-  int width;
-  int height;
-  // We get the frame buffer dimensions and store them in width and height.
-  glfwGetFramebufferSize(window, &width, &height);
+// The frame buffer dimensions are kept by FramebufferSizeCallback(), so they
+// are not queried every frame.
+void ConfigureViewPort() {
   // Tells OpenGL the dimensions of the window and we specify the coordinates
   // of the lower left corner.
-  glViewport(0, 0, width, height);
+  glViewport(0, 0, window_framebuffer_width, window_framebuffer_height);
+}
+
+// Returns the aspect ratio of a framebuffer of width x height pixels.
+GLfloat ComputeAspectRatio(const int width, const int height) {
+  return static_cast<GLfloat>(width) / static_cast<GLfloat>(height);
 }
 
 // Clears the frame buffer.
 void ClearTheFrameBuffer() {
   // Sets the initial color of the framebuffer in the RGBA, R = Red, G = Green,
   // B = Blue, and A = alpha.
-  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-  // Tells OpenGL to clear the Color buffer.
-  glClear(GL_COLOR_BUFFER_BIT);
-}
-
-// Creates and transfers the vertices into the GPU. Returns the vertex buffer
-// object id.
-GLuint SetVertexBufferObject(const Model& model) {
-  // Create a vertex buffer object (vbo).
-  GLuint vertex_buffer_object_id;
-  glGenBuffers(1, &vertex_buffer_object_id);
-  // Set the GL_ARRAY_BUFFER of OpenGL to the vbo we just created.
-  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object_id);
-  // Copy the vertices into the GL_ARRAY_BUFFER that currently 'points' to our
-  // recently created vbo. In this case, sizeof(vertices) returns the size of
-  // the array vertices (defined above) in bytes.
-  // First parameter specifies the destination buffer.
-  // Second parameter specifies the size of the buffer.
-  // Third parameter specifies the pointer to the vertices buffer in RAM.
-  // Fourth parameter specifies the way we want OpenGL to treat the buffer.
-  // There are three different ways to treat this buffer:
-  // 1. GL_STATIC_DRAW: the data will change very rarely.
-  // 2. GL_DYNAMIC_DRAW: the data will likely change.
-  // 3. GL_STREAM_DRAW: the data will change every time it is drawn.
-  // See https://www.opengl.org/sdk/docs/man/html/glBufferData.xhtml.
-  const Eigen::MatrixXf& vertices = model.vertices();
-  const int vertices_size_in_bytes =
-      vertices.rows() * vertices.cols() * sizeof(vertices(0, 0));
-  glBufferData(GL_ARRAY_BUFFER,
-               vertices_size_in_bytes,
-               vertices.data(),
-               GL_STATIC_DRAW);
-  // Inform OpenGL how the vertex buffer is arranged.
-  constexpr GLuint kIndex = 0;  // Index of the first buffer array.
-  // A vertex right now contains 3 elements because we have x, y, z. But we can
-  // add more information per vertex as we will see shortly.
-  constexpr GLuint kNumElementsPerVertex = 3;
-  constexpr GLuint kStride = kNumElementsPerVertex * sizeof(vertices(0, 0));
-  const GLvoid* offset_ptr = nullptr;
-  glVertexAttribPointer(kIndex, kNumElementsPerVertex, GL_FLOAT, GL_FALSE,
-                        kStride, offset_ptr);
-  // Set as active our newly generated VBO.
-  glEnableVertexAttribArray(kIndex);
-  // Unbind buffer so that later we can use it.
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  return vertex_buffer_object_id;
-}
-
-GLuint SetElementBufferObject(const Model& model) {
-  // Allocates memory in the GPU for the EBO.
-  GLuint element_buffer_object_id;
-  glGenBuffers(1, &element_buffer_object_id);
-  // Set the GL_ARRAY_BUFFER of OpenGL to the vbo we just created.
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object_id);
-  const std::vector<GLuint>& indices = model.indices();
-  const int indices_size_in_bytes = indices.size() * sizeof(indices[0]);
-  // Copying buffer to the GPU.
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-               indices_size_in_bytes,
-               indices.data(),
-               GL_STATIC_DRAW);
-  // NOTE: Do not unbing EBO. It turns out that when we create a buffer of type
-  // GL_ELEMENT_ARRAY_BUFFER, the VAO who contains the EBO remembers the
-  // bindings we perform. Thus if we unbind it, we detach the created EBO and we
-  // won't see results.
-  return element_buffer_object_id;
-}
-
-// Creates and sets the vertex array object (VAO) for our triangle. Returns the
-// id of the created VAO.
-void SetVertexArrayObject(const Model& model,
-                          GLuint* vertex_buffer_object_id,
-                          GLuint* vertex_array_object_id,
-                          GLuint* element_buffer_object_id) {
-  // Create the vertex array object (VAO).
-  constexpr int kNumVertexArrays = 1;
-  // This function creates kNumVertexArrays vaos and stores the ids in the
-  // array pointed by the second argument.
-  glGenVertexArrays(kNumVertexArrays, vertex_array_object_id);
-  // Set the recently created vertex array object (VAO) current.
-  glBindVertexArray(*vertex_array_object_id);
-  // Create the Vertex Buffer Object (VBO).
-  *vertex_buffer_object_id = SetVertexBufferObject(model);
-  *element_buffer_object_id = SetElementBufferObject(model);
-  // Disable our created VAO.
-  glBindVertexArray(0);
+  // The state cache skips the call when the color did not change.
+  wvu::GlStateCache::Current()->ClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  // Tells OpenGL to clear the Color and the Depth buffers. The depth buffer
+  // is only cleared where its writes are enabled.
+  wvu::GlStateCache::Current()->DepthMask(true);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 // Renders the scene.
-void RenderScene(const wvu::ShaderProgram& shader_program,
-                 const GLuint vertex_array_object_id,
-                 const Eigen::Matrix4f& projection,
-                 const GLfloat angle,
+void RenderScene(wvu::ShaderProgram* shader_program,
+                 const wvu::GpuMesh& mesh,
+                 const GLuint texture_id,
+                 const wvu::MeshLodChain& lod_chain,
+                 const wvu::Camera& camera,
+                 const int framebuffer_height,
+                 const wvu::Model& object,
+                 const wvu::StreamedScene& scene,
+                 wvu::RenderQueue* render_queue,
+                 const wvu::MultiViewUniforms* multi_view,
+                 wvu::ShaderProgram* depth_program,
+                 wvu::ShaderProgram* overdraw_program,
+                 const wvu::FrameLogChannel& frame_log,
                  GLFWwindow* window) {
   // Clear the buffer.
   ClearTheFrameBuffer();
-  // Let OpenGL know that we want to use our shader program.
-  shader_program.Use();
-  // Get the locations of the uniform variables.
-  const GLint model_location = 
-    glGetUniformLocation(shader_program.shader_program_id(), "model");
-  const GLint view_location = 
-    glGetUniformLocation(shader_program.shader_program_id(), "view");
-  const GLint projection_location = 
-    glGetUniformLocation(shader_program.shader_program_id(), "projection");
-  Eigen::Matrix4f translation = 
-    ComputeTranslation(Eigen::Vector3f(0.0f, 0.0f, -5.0f));
-  Eigen::Matrix4f rotation = 
-    ComputeRotation(Eigen::Vector3f(1.0f, 1.0f, 1.0f).normalized(),
-                    angle);
-  Eigen::Matrix4f model = translation * rotation;
-  std::cout << "Model: \n" << model << std::endl;
-  Eigen::Matrix4f view = Eigen::Matrix4f::Identity();
-  // We do not create the projection matrix here because the projection 
-  // matrix does not change.
-  // Eigen::Matrix4f projection = Eigen::Matrix4f::Identity();
-  glUniformMatrix4fv(model_location, 1, GL_FALSE, model.data());
-  glUniformMatrix4fv(view_location, 1, GL_FALSE, view.data());
-  glUniformMatrix4fv(projection_location, 1, GL_FALSE, projection.data());
+  // The model caches its matrix, which is only recomputed when its position
+  // or orientation changes.
+  const Eigen::Matrix4f model = object.model_matrix();
+  // The matrix is only formatted in the frames the channel logs.
+  FRAME_LOG(frame_log, INFO) << "Model: \n" << model;
   // Draw the triangle.
-  // Let OpenGL know what vertex array object we will use.
-  glBindVertexArray(vertex_array_object_id);
   // Set to GL_LINE instead of GL_FILL to visualize the poligons as wireframes.
-  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  wvu::GlStateCache* gl_state = wvu::GlStateCache::Current();
+  gl_state->PolygonMode(GL_FILL);
+  // The nearest faces hide the others, whatever their order.
+  gl_state->SetCapability(GL_DEPTH_TEST, true);
+  gl_state->DepthFunc(GL_LESS);
   // First argument specifies the primitive to use.
   // Second argument specifies the starting index in the VAO.
   // Third argument specified the number of vertices to use.
   // glDrawArrays(GL_TRIANGLE_STRIP, 0, 8);
 
-  // Call glDrawElements to use the EBO.
-  glDrawElements(GL_TRIANGLES, 24, GL_UNSIGNED_INT, 0);
-  // Let OpenGL know that we are done with our vertex array object.
-  glBindVertexArray(0);
+  // Pick the level of detail from the projected size of the model.
+  const GLfloat distance = (object.position() - camera.position()).norm();
+  const wvu::MeshLod& lod = lod_chain.lod(
+      lod_chain.SelectLod(distance, camera.field_of_view(), framebuffer_height,
+                          static_cast<GLfloat>(FLAGS_lod_pixel_error)));
+  // Queue the elements of the EBO to draw. All the levels of detail live in
+  // the EBO, so the level only selects the range of indices to draw. The queue
+  // sorts the draws of the frame by program, material and VAO, and only
+  // changes the state between draws that differ. The view and projection
+  // matrices live in the FrameUniforms buffer, which is updated once per
+  // frame, and the queue multiplies them with the model matrices of the draws
+  // in one batch.
+  render_queue->Clear();
+  render_queue->SetViewProjection(camera.view(), camera.projection());
+  wvu::RenderItem item;
+  item.shader_program = shader_program;
+  item.mesh = &mesh;
+  item.texture_id = texture_id;
+  item.first_index = lod.first_index;
+  item.num_indices = lod.num_indices;
+  item.depth = distance / kFarPlaneDistance;
+  item.model = model;
+  item.object_id = kModelObjectId;
+  render_queue->Add(item);
+  // The objects of the scene in the view are drawn once their meshes are
+  // resident.
+  const float far_distance = camera.far();
+  for (const int scene_object : scene.visible_objects()) {
+    const wvu::GpuMesh* scene_mesh = scene.mesh(scene_object);
+    if (scene_mesh == nullptr) continue;
+    item.mesh = scene_mesh;
+    item.first_index = 0;
+    item.num_indices = scene_mesh->num_indices();
+    item.depth = std::min(
+        scene.bounds(scene_object).exteriorDistance(camera.position()) /
+        far_distance, 1.0f);
+    item.model = scene.model_matrix(scene_object);
+    item.object_id = kFirstSceneObjectId + scene_object;
+    render_queue->Add(item);
+  }
+  // The depth prepass writes the nearest depths, so that the shading pass
+  // only runs the fragment shader of the visible fragments. The overdraw
+  // program counts the fragments the shading pass would shade.
+  const auto draw = [&](const int num_instances) {
+    if (FLAGS_depth_prepass) {
+      render_queue->ExecuteDepthPrepass(depth_program, num_instances);
+    }
+    if (overdraw_program != nullptr) {
+      render_queue->ExecuteWithProgram(overdraw_program, num_instances);
+    } else {
+      render_queue->Execute(num_instances);
+    }
+  };
+  // The split views traverse the queue once, drawing an instance per view.
+  if (multi_view != nullptr) {
+    multi_view->Render(draw);
+  } else {
+    draw(1);
+  }
+}
+
+// Returns the texture of the model until --texture_file is loaded: a
+// checkerboard with all its mip levels.
+std::unique_ptr<wvu::TextureSource> CreateCheckerboardTexture() {
+  std::vector<std::vector<GLubyte> > levels(1);
+  constexpr int kNumChannels = 4;
+  const int square_size = kCheckerboardSize / kCheckerboardNumSquares;
+  levels[0].resize(kCheckerboardSize * kCheckerboardSize * kNumChannels);
+  for (int y = 0; y < kCheckerboardSize; ++y) {
+    for (int x = 0; x < kCheckerboardSize; ++x) {
+      const bool light = (x / square_size + y / square_size) % 2 == 0;
+      GLubyte* texel = &levels[0][(y * kCheckerboardSize + x) * kNumChannels];
+      texel[0] = light ? 255 : 64;
+      texel[1] = light ? 128 : 32;
+      texel[2] = light ? 51 : 13;
+      texel[3] = 255;
+    }
+  }
+  wvu::GenerateMipLevels(kCheckerboardSize, kCheckerboardSize, &levels);
+  return std::unique_ptr<wvu::TextureSource>(new wvu::MemoryTextureSource(
+      wvu::TEXTURE_FORMAT_RGBA8, kCheckerboardSize, kCheckerboardSize,
+      std::move(levels)));
+}
+
+// Returns num_lights lights of random colors, scattered in a shell around the
+// center of the model. The seed is fixed, so every run has the same lights.
+wvu::PointLights CreateLights(const int num_lights,
+                              const Eigen::Vector3f& center) {
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::normal_distribution<float> normal(0.0f, 1.0f);
+  // The lights overlap more as there are more of them, so they are dimmed.
+  const float intensity = std::min(1.0f, 8.0f / std::max(num_lights, 1));
+  wvu::PointLights lights(num_lights);
+  for (wvu::PointLight& light : lights) {
+    const Eigen::Vector3f direction =
+        Eigen::Vector3f(normal(generator), normal(generator),
+                        normal(generator)).normalized();
+    light.position = center + (1.0f + uniform(generator)) * direction;
+    light.radius = 1.5f;
+    light.color = intensity * Eigen::Vector3f(uniform(generator),
+                                              uniform(generator),
+                                              uniform(generator));
+  }
+  return lights;
+}
+
+// Creates the program and the uniforms of num_views split views. Returns true
+// if successful.
+bool SetUpSplitViews(const int num_views,
+                     wvu::ShaderProgram* shader_program,
+                     wvu::MultiViewUniforms* multi_view,
+                     std::string* error_info_log) {
+  if (num_views > wvu::kMaxNumViews) {
+    *error_info_log = "There can be at most " +
+        std::to_string(wvu::kMaxNumViews) + " views.";
+    return false;
+  }
+  shader_program->LoadVertexShaderFromString(
+      "#version 330 core\n" + wvu::MultiViewUniforms::GlslDeclaration() +
+      multi_view_vertex_shader_body);
+  shader_program->LoadFragmentShaderFromString(fragment_shader_src);
+  if (!shader_program->Create(error_info_log)) return false;
+  if (!multi_view->Initialize() || !multi_view->Attach(shader_program)) {
+    *error_info_log = "Could not set up the multi-view uniforms.";
+    return false;
+  }
+  return true;
+}
+
+// Sets the cameras and the viewports of num_views views around the model, in
+// a grid covering the framebuffer. Returns true if successful.
+bool UpdateSplitViews(const int num_views,
+                      const int framebuffer_width,
+                      const int framebuffer_height,
+                      const Eigen::Vector3f& target,
+                      const Eigen::Matrix4f& projection,
+                      wvu::MultiViewUniforms* multi_view) {
+  const int num_columns =
+      static_cast<int>(std::ceil(std::sqrt(static_cast<float>(num_views))));
+  const int num_rows = (num_views + num_columns - 1) / num_columns;
+  wvu::InstanceTransforms views(num_views);
+  const wvu::InstanceTransforms projections(num_views, projection);
+  std::vector<wvu::Viewport> viewports(num_views);
+  for (int i = 0; i < num_views; ++i) {
+    // The cameras orbit the target at the distance of the default one.
+    views[i] = wvu::ComputeTranslation(target) *
+        wvu::ComputeRotation(Eigen::Vector3f::UnitY(),
+                             2.0f * wvu::kPi * i / num_views) *
+        wvu::ComputeTranslation(-target);
+    viewports[i].width = static_cast<GLfloat>(framebuffer_width) / num_columns;
+    viewports[i].height = static_cast<GLfloat>(framebuffer_height) / num_rows;
+    viewports[i].x = (i % num_columns) * viewports[i].width;
+    viewports[i].y = (num_rows - 1 - i / num_columns) * viewports[i].height;
+  }
+  return multi_view->Update(views.data(), projections.data(),
+                            viewports.data(), num_views);
+}
+
+// Renders the model from every pose of --camera_poses_file, filling the tiles
+// of as many atlas pages as needed, and writes the pages into
+// --pose_atlas_file if set. Returns true if successful.
+bool RenderCameraPoses(const wvu::GpuMesh& mesh,
+                       const wvu::MeshLod& lod,
+                       const wvu::Model& object,
+                       const Eigen::Matrix4f& projection,
+                       std::string* error_info_log) {
+  wvu::CameraPoses poses;
+  if (!wvu::ReadCameraPoses(FLAGS_camera_poses_file, &poses,
+                            error_info_log)) {
+    return false;
+  }
+  wvu::PoseBatchRenderer renderer;
+  if (!renderer.Initialize(FLAGS_pose_tile_size, FLAGS_pose_tile_size,
+                           FLAGS_pose_atlas_tiles, FLAGS_pose_atlas_tiles,
+                           fragment_shader_src, error_info_log)) {
+    return false;
+  }
+  const int width = renderer.atlas().width();
+  const int height = renderer.atlas().height();
+  // The pages are read back and encoded while the next ones are rendered.
+  std::unique_ptr<wvu::FrameEncoderSink> pages;
+  wvu::FramebufferReadback readback;
+  if (!FLAGS_pose_atlas_file.empty()) {
+    std::unique_ptr<wvu::FrameEncoder> encoder =
+        wvu::CreateFrameEncoder(FLAGS_pose_atlas_file, error_info_log);
+    if (encoder == nullptr) return false;
+    pages.reset(new wvu::FrameEncoderSink(std::move(encoder)));
+    if (!pages->Start(width, height, 1, error_info_log)) return false;
+    if (!readback.Initialize(width, height, wvu::kDefaultNumReadbackBuffers,
+                             [&pages](const wvu::ReadbackFrame& page) {
+                               pages->Submit(page);
+                             })) {
+      *error_info_log = "Could not create the readback buffers.";
+      return false;
+    }
+  }
+  const double start_time = glfwGetTime();
+  int num_draws = 0;
+  int num_pages = 0;
+  for (size_t first_pose = 0; first_pose < poses.size();
+       first_pose += renderer.num_tiles()) {
+    const int num_page_poses = std::min<size_t>(renderer.num_tiles(),
+                                                poses.size() - first_pose);
+    renderer.Render(mesh, lod.first_index, lod.num_indices,
+                    object.model_matrix(), projection,
+                    poses.data() + first_pose, num_page_poses);
+    num_draws += renderer.num_draws();
+    if (pages != nullptr) readback.ReadPixels(num_pages);
+    ++num_pages;
+  }
+  readback.Finish();
+  glFinish();
+  LOG(INFO) << "Rendered " << poses.size() << " poses into " << num_pages
+            << " pages with " << num_draws << " draws in "
+            << glfwGetTime() - start_time << " seconds.";
+  return pages == nullptr || pages->Stop(error_info_log);
+}
+
+// Renders the model from the camera into --poster_file, tile by tile. Each
+// tile is read back and written into the image while the next ones are
+// drawn. Returns true if successful.
+bool RenderPoster(wvu::ShaderProgram* shader_program,
+                  const wvu::GpuMesh& mesh,
+                  const GLuint texture_id,
+                  const wvu::MeshLod& lod,
+                  const wvu::Model& object,
+                  const wvu::Camera& camera,
+                  std::string* error_info_log) {
+  wvu::TiledRenderer renderer;
+  if (!renderer.Initialize(FLAGS_poster_tile_size, error_info_log)) {
+    return false;
+  }
+  wvu::RenderQueue render_queue("model");
+  wvu::RenderItem item;
+  item.shader_program = shader_program;
+  item.mesh = &mesh;
+  item.texture_id = texture_id;
+  item.first_index = lod.first_index;
+  item.num_indices = lod.num_indices;
+  item.model = object.model_matrix();
+  item.object_id = kModelObjectId;
+  const double start_time = glfwGetTime();
+  const bool rendered = renderer.Render(
+      FLAGS_poster_width, FLAGS_poster_height, camera.field_of_view(),
+      camera.near(), camera.far(), FLAGS_poster_file,
+      [&](const Eigen::Matrix4f& projection) {
+    ClearTheFrameBuffer();
+    wvu::GlStateCache* gl_state = wvu::GlStateCache::Current();
+    gl_state->PolygonMode(GL_FILL);
+    gl_state->SetCapability(GL_DEPTH_TEST, true);
+    gl_state->DepthFunc(GL_LESS);
+    render_queue.Clear();
+    render_queue.SetViewProjection(camera.view(), projection);
+    render_queue.Add(item);
+    render_queue.Execute();
+  }, error_info_log);
+  if (!rendered) return false;
+  const wvu::TiledRenderStatistics& statistics = renderer.statistics();
+  LOG(INFO) << "Rendered a " << FLAGS_poster_width << "x"
+            << FLAGS_poster_height << " poster in " << statistics.num_tiles
+            << " tiles of " << renderer.tile_size() << " pixels in "
+            << glfwGetTime() - start_time << " seconds, waiting "
+            << statistics.num_readback_waits << " times for readbacks.";
+  return true;
+}
+
+// Steps through the sample counts of MSAA, from none to the maximum of the
+// GPU, rendering num_frames frames with each, and reports their time per
+// frame. The pipeline is drained between the sample counts, so the times
+// include the GPU work of the frames, whose pacing should be uncapped.
+class MsaaBenchmark {
+ public:
+  // The context must be current, since the maximum sample count is queried
+  // here.
+  MsaaBenchmark(const int num_frames, const int width, const int height)
+      : num_frames_(num_frames), width_(width), height_(height), stage_(-1),
+        num_stage_frames_(0), stage_start_time_(0.0) {
+    GLint max_samples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    sample_counts_.push_back(0);
+    for (int samples = 2; samples <= max_samples; samples *= 2) {
+      sample_counts_.push_back(samples);
+    }
+  }
+
+  // Counts a frame, and moves to the next sample count, reinitializing
+  // framebuffer, once the current one rendered its frames. Returns false if
+  // the framebuffer could not be created.
+  bool BeginFrame(wvu::OffscreenFramebuffer* framebuffer,
+                  std::string* error_info_log) {
+    if (done()) return true;
+    if (stage_ >= 0 && num_stage_frames_ < num_frames_) {
+      ++num_stage_frames_;
+      return true;
+    }
+    glFinish();
+    if (stage_ >= 0) {
+      frame_times_ms_.push_back(
+          1000.0 * (glfwGetTime() - stage_start_time_) / num_frames_);
+    }
+    if (++stage_ == static_cast<int>(sample_counts_.size())) return true;
+    const int num_samples = sample_counts_[stage_];
+    if (num_samples == 0) {
+      framebuffer->Reset();
+    } else if (!framebuffer->Initialize(width_, height_, num_samples,
+                                        error_info_log)) {
+      return false;
+    }
+    // The allocation of the framebuffer is not timed.
+    glFinish();
+    stage_start_time_ = glfwGetTime();
+    num_stage_frames_ = 1;
+    return true;
+  }
+
+  // Returns true once every sample count was measured.
+  bool done() const {
+    return stage_ == static_cast<int>(sample_counts_.size());
+  }
+
+  std::string Report() const {
+    std::string report = "MSAA at " + std::to_string(width_) + "x" +
+        std::to_string(height_) + ", " + std::to_string(num_frames_) +
+        " frames per sample count:";
+    for (size_t i = 0; i < frame_times_ms_.size(); ++i) {
+      const std::string samples = sample_counts_[i] == 0 ? "off" :
+          std::to_string(sample_counts_[i]) + "x";
+      report += "\n  " + samples + ": " + std::to_string(frame_times_ms_[i]) +
+          " ms per frame, +" +
+          std::to_string(frame_times_ms_[i] - frame_times_ms_[0]) + " ms.";
+    }
+    return report;
+  }
+
+ private:
+  const int num_frames_;
+  const int width_;
+  const int height_;
+  std::vector<int> sample_counts_;
+  std::vector<double> frame_times_ms_;
+  // Index of the current sample count, or -1 before the first frame.
+  int stage_;
+  int num_stage_frames_;
+  double stage_start_time_;
+
+  MsaaBenchmark(const MsaaBenchmark&) = delete;
+  MsaaBenchmark& operator=(const MsaaBenchmark&) = delete;
+};
+
+// Exposes a flag as a knob of the metrics server, described by the help of the
+// flag. A new value is applied by apply, and the flag keeps its previous value
+// if the value does not parse or apply returns false.
+void AddFlagKnob(const char* flag,
+                 const std::function<bool()>& apply,
+                 wvu::MetricsServer* metrics) {
+  CS470_GFLAGS_NAMESPACE::CommandLineFlagInfo info;
+  CHECK(CS470_GFLAGS_NAMESPACE::GetCommandLineFlagInfo(flag, &info));
+  metrics->AddKnob(
+      flag, info.description,
+      [flag]() {
+        std::string value;
+        CS470_GFLAGS_NAMESPACE::GetCommandLineOption(flag, &value);
+        return value;
+      },
+      [flag, apply](const std::string& value) {
+        std::string previous;
+        CS470_GFLAGS_NAMESPACE::GetCommandLineOption(flag, &previous);
+        if (CS470_GFLAGS_NAMESPACE::SetCommandLineOption(
+                flag, value.c_str()).empty()) {
+          return false;
+        }
+        if (apply()) return true;
+        CS470_GFLAGS_NAMESPACE::SetCommandLineOption(flag, previous.c_str());
+        return false;
+      });
+}
+
+// Returns the distance in pixels between the projections of a point by two
+// view-projection matrices, e.g., of consecutive frames.
+float ScreenMotion(const Eigen::Matrix4f& previous_view_projection,
+                   const Eigen::Matrix4f& view_projection,
+                   const Eigen::Vector3f& point,
+                   const int width,
+                   const int height) {
+  const Eigen::Vector4f previous =
+      previous_view_projection * point.homogeneous();
+  const Eigen::Vector4f current = view_projection * point.homogeneous();
+  if (previous.w() <= 0.0f || current.w() <= 0.0f) return 0.0f;
+  const Eigen::Vector2f motion =
+      current.head<2>() / current.w() - previous.head<2>() / previous.w();
+  return 0.5f * Eigen::Vector2f(motion.x() * width,
+                                motion.y() * height).norm();
 }
 
 }  // namespace
 
 int main(int argc, char** argv) {
-  // Initialize the GLFW library.
-  if (!glfwInit()) {
+  CS470_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  wvu::AsyncLogSink async_log_sink;
+  if (!FLAGS_async_log_file.empty()) {
+    std::string error_info_log;
+    if (!async_log_sink.Start(
+            FLAGS_async_log_file == "-" ? "" : FLAGS_async_log_file,
+            &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      return -1;
+    }
+    async_log_sink.Install();
+  }
+  wvu::HugePageMode huge_page_mode;
+  if (!wvu::ParseHugePageMode(FLAGS_huge_pages, &huge_page_mode)) {
+    LOG(ERROR) << "Unknown huge page mode " << FLAGS_huge_pages;
     return -1;
   }
+  wvu::SetHugePageMode(huge_page_mode);
+  // The phases of the startup are timed until the first frame showing the
+  // mesh.
+  wvu::StartupTrace startup_trace;
+
+  // Initialize the GLFW library.
+  {
+    wvu::ScopedStartupPhase phase(&startup_trace, "glfwInit");
+    if (!glfwInit()) {
+      return -1;
+    }
+  }
 
   // Setting the error callback.
   glfwSetErrorCallback(ErrorCallback);
 
   // Setting Window hints.
   SetWindowHints();
+  // The headless frames go to an offscreen framebuffer, so the window is only
+  // there to own the context.
+  if (FLAGS_headless) glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
 
   // Create a window and its OpenGL context.
   const std::string window_name = "Hello Triangle";
+  const int window_phase = startup_trace.BeginPhase("glfwCreateWindow");
   GLFWwindow* window = glfwCreateWindow(kWindowWidth,
                                         kWindowHeight,
                                         window_name.c_str(),
                                         nullptr,
                                         nullptr);
+  startup_trace.EndPhase(window_phase);
   if (!window) {
     glfwTerminate();
     return -1;
@@ -484,38 +1178,360 @@ int main(int argc, char** argv) {
 
   // Make the window's context current.
   glfwMakeContextCurrent(window);
-  glfwSwapInterval(1);
-  glfwSetKeyCallback(window, KeyCallback);
+  std::string error_info_log;
+  wvu::FramePacingMode frame_pacing_mode;
+  if (!wvu::ParseFramePacingMode(FLAGS_frame_pacing, &frame_pacing_mode)) {
+    LOG(ERROR) << "Unknown frame pacing mode " << FLAGS_frame_pacing;
+    return -1;
+  }
+  // The headless and the benchmark frames are rendered as fast as possible.
+  if (FLAGS_headless || FLAGS_msaa_benchmark_frames > 0) {
+    frame_pacing_mode = wvu::UNCAPPED;
+  }
+  wvu::FramePacer frame_pacer;
+  if (!frame_pacer.Initialize(frame_pacing_mode, FLAGS_target_frame_rate,
+                              &error_info_log)) {
+    LOG(ERROR) << error_info_log;
+    return -1;
+  }
+  frame_pacer.SetRefreshRate(wvu::MonitorRefreshRate(window));
+  VLOG(1) << "Frame pacing: " << wvu::FramePacingModeName(frame_pacer.mode())
+          << " at " << frame_pacer.statistics().refresh_rate << " Hz";
+  // The input events are buffered with their timestamps, and handled once per
+  // frame.
+  wvu::InputBuffer input_buffer;
+  input_buffer.Attach(window);
+  std::vector<wvu::InputEvent> input_events(wvu::kDefaultInputBufferCapacity);
+  // The size is only queried once, and then kept by the callback.
+  glfwGetFramebufferSize(window, &window_framebuffer_width,
+                         &window_framebuffer_height);
+  glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);
+  glfwSetWindowFrameCallback(window, WindowFrameCallback);
+  render_throttle.Initialize(FLAGS_background_frame_rate);
+  glfwSetWindowIconifyCallback(window, WindowIconifyCallback);
+  glfwSetWindowFocusCallback(window, WindowFocusCallback);
 
   // Initialize GLEW.
   glewExperimental = GL_TRUE;
-  if (glewInit() != GLEW_OK) {
-    std::cerr << "Glew did not initialize properly!" << std::endl;
+  const int glew_phase = startup_trace.BeginPhase("glewInit");
+  const GLenum glew_status = glewInit();
+  startup_trace.EndPhase(glew_phase);
+  if (glew_status != GLEW_OK) {
+    LOG(ERROR) << "Glew did not initialize properly!";
     glfwTerminate();
     return -1;
   }
+  // Count the OpenGL calls in the builds with the COUNT_GL_CALLS option.
+  wvu::InstallGlCallCounters();
+  // The objects deleted during a frame are fenced at its end.
+  wvu::GpuResources* gpu_resources = wvu::GpuResources::Get();
+  gpu_resources->set_deferred(FLAGS_deferred_deletion);
+  // The capture starts before the scene creates its objects, so that the
+  // replay creates them too.
+  if (FLAGS_capture_frames > 0 &&
+      !wvu::StartGlCapture(FLAGS_capture_file, window_framebuffer_width,
+                           window_framebuffer_height, &error_info_log)) {
+    LOG(ERROR) << "The OpenGL calls are not captured: " << error_info_log;
+  }
+  // Aggregate the performance messages of the driver.
+  wvu::GlDebugOutput debug_output;
+  if (FLAGS_debug_context && !debug_output.Initialize(&error_info_log)) {
+    LOG(WARNING) << "No debug output: " << error_info_log;
+  }
+  const int setup_phase = startup_trace.BeginPhase("scene setup");
 
-  // Configure View Port.
-  ConfigureViewPort(window);
+  // Configure View Port. The headless frames use the viewport of the
+  // offscreen framebuffer instead.
+  wvu::OffscreenFramebuffer offscreen_framebuffer;
+  if (FLAGS_headless) {
+    if (!offscreen_framebuffer.Initialize(FLAGS_headless_width,
+                                          FLAGS_headless_height,
+                                          &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      glfwTerminate();
+      return -1;
+    }
+  } else {
+    ConfigureViewPort();
+  }
+  // The MSAA frames are rendered into a multisampled framebuffer of the size
+  // of the output, and resolved into the output before the overlay.
+  int render_width = offscreen_framebuffer.width();
+  int render_height = offscreen_framebuffer.height();
+  if (!FLAGS_headless) {
+    render_width = window_framebuffer_width;
+    render_height = window_framebuffer_height;
+  }
+  const GLuint output_framebuffer_id = offscreen_framebuffer.framebuffer_id();
+  wvu::OffscreenFramebuffer msaa_framebuffer;
+  if (FLAGS_msaa_samples > 0 &&
+      !msaa_framebuffer.Initialize(render_width, render_height,
+                                   FLAGS_msaa_samples, &error_info_log)) {
+    LOG(ERROR) << error_info_log;
+    glfwTerminate();
+    return -1;
+  }
+  // The dynamic resolution renders the scene into its own framebuffer, which
+  // is stretched over the output, so it cannot be multisampled.
+  wvu::DynamicResolution dynamic_resolution;
+  if (FLAGS_dynamic_resolution) {
+    if (FLAGS_msaa_samples > 0 || FLAGS_msaa_benchmark_frames > 0 ||
+        FLAGS_num_views > 1) {
+      LOG(ERROR) << "--dynamic_resolution does not support MSAA nor split "
+                 << "views.";
+      glfwTerminate();
+      return -1;
+    }
+    const double target_frame_ms = FLAGS_dynamic_resolution_target_ms > 0.0 ?
+        FLAGS_dynamic_resolution_target_ms : 1000.0 / FLAGS_target_frame_rate;
+    if (!dynamic_resolution.Initialize(render_width, render_height,
+                                       target_frame_ms,
+                                       FLAGS_dynamic_resolution_min_scale,
+                                       wvu::kDefaultMaxResolutionScale,
+                                       &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      glfwTerminate();
+      return -1;
+    }
+  }
+  // The shading rate image tiles the frame drawn, which the dynamic resolution
+  // scales, so it is resized every frame.
+  wvu::VariableRateShading variable_rate_shading;
+  if (FLAGS_variable_rate_shading) {
+    if (!wvu::VariableRateShading::Supported()) {
+      LOG(WARNING) << "NV_shading_rate_image is not supported: the scene is "
+                   << "shaded at full rate.";
+    } else if (!variable_rate_shading.Initialize(render_width, render_height,
+                                                 &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      glfwTerminate();
+      return -1;
+    } else {
+      variable_rate_shading.SetPeriphery(0.5f, 0.5f,
+                                         FLAGS_shading_rate_inner_radius,
+                                         FLAGS_shading_rate_outer_radius);
+    }
+  }
+  std::unique_ptr<MsaaBenchmark> msaa_benchmark;
+  if (FLAGS_msaa_benchmark_frames > 0) {
+    msaa_benchmark.reset(new MsaaBenchmark(FLAGS_msaa_benchmark_frames,
+                                           render_width, render_height));
+  }
+  // The recording encodes the frames on its own thread, so the render loop
+  // only copies their pixels.
+  std::unique_ptr<wvu::FrameEncoderSink> recording;
+  if (!FLAGS_record_file.empty()) {
+    if (!FLAGS_headless) {
+      LOG(ERROR) << "--record_file needs --headless.";
+      glfwTerminate();
+      return -1;
+    }
+    std::unique_ptr<wvu::FrameEncoder> encoder =
+        wvu::CreateFrameEncoder(FLAGS_record_file, &error_info_log);
+    if (encoder != nullptr) {
+      recording.reset(new wvu::FrameEncoderSink(std::move(encoder)));
+    }
+    if (recording == nullptr ||
+        !recording->Start(offscreen_framebuffer.width(),
+                          offscreen_framebuffer.height(),
+                          FLAGS_record_frame_rate, &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      glfwTerminate();
+      return -1;
+    }
+  }
+  // The streaming sends the latest frame on its own thread, and feeds the
+  // input of the client to the input buffer.
+  wvu::FrameStreamServer stream_server;
+  if (FLAGS_stream_port > 0) {
+    if (!FLAGS_headless) {
+      LOG(ERROR) << "--stream_port needs --headless.";
+      glfwTerminate();
+      return -1;
+    }
+    if (!stream_server.Start(FLAGS_stream_port, &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      glfwTerminate();
+      return -1;
+    }
+  }
+  // The exported frames stay on the GPU: they are copied into buffers the
+  // consumer process maps.
+  wvu::DmaBufExporter dma_buf_exporter;
+  if (!FLAGS_dma_buf_socket.empty() &&
+      (!FLAGS_headless ||
+       !dma_buf_exporter.Initialize(offscreen_framebuffer.width(),
+                                    offscreen_framebuffer.height(),
+                                    wvu::kDefaultNumDmaBufs,
+                                    FLAGS_dma_buf_socket, &error_info_log))) {
+    LOG(ERROR) << (FLAGS_headless ? error_info_log
+                                  : "--dma_buf_socket needs --headless.");
+    glfwTerminate();
+    return -1;
+  }
+  // The frames are read a few frames after they are rendered, overlapping the
+  // copies with the next frames.
+  const bool read_frames = FLAGS_headless &&
+      (FLAGS_readback || recording != nullptr || FLAGS_stream_port > 0);
+  wvu::FramebufferReadback readback;
+  int64_t num_read_frames = 0;
+  if (read_frames &&
+      !readback.Initialize(offscreen_framebuffer.width(),
+                           offscreen_framebuffer.height(),
+                           wvu::kDefaultNumReadbackBuffers,
+                           [&num_read_frames, &recording, &stream_server](
+                               const wvu::ReadbackFrame& frame) {
+                             ++num_read_frames;
+                             if (recording != nullptr) {
+                               recording->Submit(frame);
+                             }
+                             stream_server.Submit(frame);
+                           })) {
+    LOG(ERROR) << "Could not create the readback buffers.";
+    glfwTerminate();
+    return -1;
+  }
+
+  // Report the memory of the GPU, and bound the buffer storage of the demo.
+  wvu::GpuMemoryInfo gpu_memory_info;
+  if (wvu::QueryGpuMemoryInfo(&gpu_memory_info)) {
+    VLOG(1) << "GPU memory: " << gpu_memory_info.total_bytes
+            << " bytes total, " << gpu_memory_info.available_bytes
+            << " bytes available.";
+  }
+  wvu::BufferAllocator* buffer_allocator = wvu::BufferAllocator::Get();
+  buffer_allocator->set_budget(
+      static_cast<GLsizeiptr>(FLAGS_gpu_memory_budget_mb) << 20);
 
   // Compile shaders and create shader program.
   wvu::ShaderProgram shader_program;
-  shader_program.LoadVertexShaderFromString(vertex_shader_src);
-  shader_program.LoadFragmentShaderFromString(fragment_shader_src);
-  std::string error_info_log;
-  if (!shader_program.Create(&error_info_log)) {
-    std::cout << "ERROR: " << error_info_log << "\n";
+  const bool lit = FLAGS_num_lights > 0;
+  shader_program.LoadVertexShaderFromString(VertexShaderSource(lit));
+  if (lit && !wvu::ClusteredLighting::Supported()) {
+    LOG(ERROR) << "--num_lights needs shader storage buffers.";
+    return -1;
+  }
+  shader_program.LoadFragmentShaderFromString(
+      lit ? "#version 430 core\n" +
+          wvu::ClusteredLighting::GlslDeclaration() + lit_fragment_shader_body :
+          textured_fragment_shader_src);
+  // Program binaries only load on the driver that created them, so the
+  // captured programs are built from their sources.
+  if (!wvu::GlCaptureRecording()) {
+    shader_program.SetProgramBinaryCacheDirectory(
+        FLAGS_shader_cache_directory);
+  }
+  {
+    wvu::ScopedStartupPhase phase(&startup_trace, "ShaderProgram::Create");
+    if (!shader_program.Create(&error_info_log)) {
+      LOG(ERROR) << error_info_log;
+    }
+    if (shader_program.loaded_from_binary_cache()) {
+      startup_trace.SetNote(phase.phase(), "from the binary cache");
+    }
   }
   // TODO(vfragoso): Implement me!
   if (!shader_program.shader_program_id()) {
-    std::cerr << "ERROR: Could not create a shader program.\n";
+    LOG(ERROR) << "Could not create a shader program.";
     return -1;
   }
 
-  // Prepare buffers to hold the vertices in GPU.
-  GLuint vertex_buffer_object_id;
-  GLuint vertex_array_object_id;
-  GLuint element_buffer_object_id;
+  // The texture of the model is added with its coarse levels, and its finer
+  // levels are streamed as the model covers more pixels.
+  // Images are decoded on the workers of the texture cache, and the model
+  // shows the checkerboard until they are loaded.
+  wvu::TextureManager texture_manager;
+  wvu::TextureCache texture_cache(FLAGS_texture_cache_directory);
+  std::unique_ptr<wvu::TextureSource> texture_source;
+  const bool ktx_texture = FLAGS_texture_file.size() > 4 &&
+      FLAGS_texture_file.compare(FLAGS_texture_file.size() - 4, 4, ".ktx") == 0;
+  if (ktx_texture) {
+    std::unique_ptr<wvu::KtxTextureSource> ktx_source(
+        new wvu::KtxTextureSource);
+    if (!ktx_source->Open(FLAGS_texture_file, &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      return -1;
+    }
+    texture_source = std::move(ktx_source);
+  } else {
+    texture_source = CreateCheckerboardTexture();
+    if (!FLAGS_texture_file.empty()) {
+      if (!texture_cache.Initialize(0, &error_info_log)) {
+        LOG(ERROR) << error_info_log;
+        return -1;
+      }
+      texture_cache.Load(FLAGS_texture_file);
+    }
+  }
+  std::vector<wvu::CompletedTextureLoad> completed_textures;
+  int model_texture =
+      texture_manager.Add(std::move(texture_source), &error_info_log);
+  if (model_texture < 0) {
+    LOG(ERROR) << "Could not create the texture: " << error_info_log;
+    return -1;
+  }
+  // The environment is prefiltered once per image, and its maps are read
+  // from the texture cache in the next runs.
+  wvu::EnvironmentLighting environment_lighting;
+  if (!FLAGS_environment_map.empty()) {
+    wvu::ScopedStartupPhase phase(&startup_trace, "environment prefilter");
+    int width = 0;
+    int height = 0;
+    std::vector<GLubyte> texels;
+    if (!wvu::DecodeNetpbmImage(FLAGS_environment_map, &width, &height,
+                                &texels, &error_info_log) ||
+        !environment_lighting.Load(width, height, texels, &texture_cache,
+                                   &error_info_log)) {
+      LOG(ERROR) << "Could not load the environment: " << error_info_log;
+      return -1;
+    }
+    const wvu::EnvironmentLightingStatistics& statistics =
+        environment_lighting.statistics();
+    if (statistics.cache_hit) {
+      startup_trace.SetNote(phase.phase(), "from the cache");
+    }
+    LOG(INFO) << "Environment " << (statistics.cache_hit ? "read from the "
+                                    "cache" : "prefiltered")
+              << " in " << statistics.load_ms << " ms.";
+    if (statistics.cache_write_failed) {
+      LOG(WARNING) << "Could not cache the prefiltered environment.";
+    }
+  }
+  shader_program.Use();
+  shader_program.SetUniform(shader_program.GetUniformLocation("material"), 0);
+
+  // The lights are assigned to the clusters of the view frustum every frame.
+  wvu::ClusteredLighting clustered_lighting;
+  if (lit && (!clustered_lighting.Initialize(&error_info_log) ||
+              !clustered_lighting.Attach(&shader_program))) {
+    LOG(ERROR) << "Could not set up the lights: " << error_info_log;
+    return -1;
+  }
+
+  // Create the ring buffer streaming the per-frame data, and bind the program's
+  // camera block to it.
+  wvu::RingBuffer ring_buffer;
+  wvu::FrameUniforms frame_uniforms;
+  if (!ring_buffer.Initialize(kRingBufferFrameCapacity,
+                              wvu::kDefaultNumRingBufferFrames) ||
+      !frame_uniforms.Initialize(&ring_buffer) ||
+      !frame_uniforms.Attach(&shader_program)) {
+    LOG(ERROR) << "Could not set up the frame uniforms.";
+    return -1;
+  }
+  // The depth prepass draws with the vertex shader of the scene, so both
+  // passes compute the same depths.
+  wvu::ShaderProgram depth_program;
+  if (FLAGS_depth_prepass) {
+    depth_program.LoadVertexShaderFromString(VertexShaderSource(lit));
+    depth_program.LoadFragmentShaderFromString(depth_fragment_shader_src);
+    if (!depth_program.Create(&error_info_log) ||
+        !frame_uniforms.Attach(&depth_program)) {
+      LOG(ERROR) << "Could not create the depth program: " << error_info_log;
+      return -1;
+    }
+  }
+
   std::vector<GLuint> indices = {
     0, 1, 3,  // First triangle.
     0, 3, 2,  // Second triangle.
@@ -524,59 +1540,1148 @@ int main(int argc, char** argv) {
     4, 5, 7,  // Fifth triangle.
     4, 7, 6,  // Sixth triangle.
     0, 1, 7,  // Seventh triangle.
-    0, 7, 6   // Eigth triangle.
+    0, 7, 6,  // Eigth triangle.
+    0, 2, 4,  // Ninth triangle.
+    0, 4, 6,  // Tenth triangle.
+    1, 3, 5,  // Eleventh triangle.
+    1, 5, 7   // Twelfth triangle.
+  };
+  // Each vertex only holds a position. See vertex_format.h for vertex types
+  // with more attributes.
+  const std::vector<wvu::PositionVertex> vertices = {
+    {{0.0f, 1.0f, 0.0f}},
+    {{0.0f, 0.0f, 0.0f}},
+    {{1.0f, 1.0f, 0.0f}},
+    {{1.0f, 0.0f, 0.0f}},
+    {{1.0f, 1.0f, -1.0f}},
+    {{1.0f, 0.0f, -1.0f}},
+    {{0.0f, 1.0f, -1.0f}},
+    {{0.0f, 0.0f, -1.0f}}
   };
-  Eigen::MatrixXf vertices(3, 8);
-  vertices.col(0) = Eigen::Vector3f(0.0f, 1.0f, 0.0f);
-  vertices.col(1) = Eigen::Vector3f(0.0f, 0.0f, 0.0f);
-  vertices.col(2) = Eigen::Vector3f(1.0f, 1.0f, 0.0f);
-  vertices.col(3) = Eigen::Vector3f(1.0f, 0.0f, 0.0f);
-  vertices.col(4) = Eigen::Vector3f(1.0f, 1.0f, -1.0f);
-  vertices.col(5) = Eigen::Vector3f(1.0f, 0.0f, -1.0f);
-  vertices.col(6) = Eigen::Vector3f(0.0f, 1.0f, -1.0f);
-  vertices.col(7) = Eigen::Vector3f(0.0f, 0.0f, -1.0f);
-  // These vertices were used for Triangle Strip.
-  // vertices.col(8) = Eigen::Vector3f(0.0f, 1.0f, 0.0f);
-  // vertices.col(9) = Eigen::Vector3f(0.0f, 0.0f, 0.0f);
-  Model model(Eigen::Vector3f(0, 0, 0),  // Orientation of object.
-              Eigen::Vector3f(0, 0, 0),  // Position of object.
-              vertices, indices);
-  SetVertexArrayObject(model, &vertex_buffer_object_id, 
-                       &vertex_array_object_id,
-                       &element_buffer_object_id);
-
-  // Create projection matrix.
-  const GLfloat field_of_view = 45.0f;
-  const GLfloat aspect_ratio = kWindowWidth / kWindowHeight;
-  const Eigen::Matrix4f projection_matrix = 
-      ComputeProjectionMatrix(field_of_view, aspect_ratio, 0.1, 10);
-  std::cout << projection_matrix << std::endl;
-  GLfloat angle = 0.0f;  // State of rotation.
+  wvu::Model model(Eigen::Vector3f(0, 0, 0),  // Orientation of object.
+                   Eigen::Vector3f(0, 0, -5),  // Position of object.
+                   vertices, std::move(indices));
+  // The triangles above are listed in any winding. Orient them outwards, so
+  // that the back faces of the closed cube are culled.
+  wvu::MeshOrientationReport orientation_report;
+  if (!wvu::OrientTriangles(&model, &orientation_report, &error_info_log)) {
+    LOG(ERROR) << "Could not orient the model: " << error_info_log;
+    return -1;
+  }
+  VLOG(1) << orientation_report.num_flipped_triangles
+          << " triangles flipped. The model is "
+          << (orientation_report.closed ? "closed." : "open.");
+  // The lights surround the center of the cube.
+  const wvu::PointLights lights = CreateLights(
+      FLAGS_num_lights, model.position() + Eigen::Vector3f(0.5f, 0.5f, -0.5f));
+  // The fountain rises from below the cube, and its particles bounce on a
+  // floor under it.
+  wvu::ParticleSystem particles;
+  if (FLAGS_num_particles > 0) {
+    wvu::ParticleEmitter emitter;
+    emitter.position = model.position() + Eigen::Vector3f(0.5f, -1.0f, -0.5f);
+    emitter.velocity = Eigen::Vector3f(0.0f, 4.0f, 0.0f);
+    emitter.floor_height = emitter.position.y() - 0.5f;
+    if (!particles.Initialize(FLAGS_num_particles, emitter,
+                              FLAGS_cpu_particles ?
+                              wvu::CPU_PARTICLE_SIMULATION :
+                              wvu::GPU_PARTICLE_SIMULATION,
+                              frame_uniforms, &error_info_log)) {
+      LOG(ERROR) << "Could not create the particles: " << error_info_log;
+      return -1;
+    }
+    VLOG(1) << "Simulating the particles on the "
+            << (particles.simulation() == wvu::GPU_PARTICLE_SIMULATION ?
+                "GPU." : "CPU.");
+  }
+  // The terrain spans the far plane around the camera, below the fountain.
+  wvu::Terrain terrain;
+  if (FLAGS_terrain) {
+    std::vector<float> heights;
+    wvu::GenerateHeightmap(257, 257, 200, 1, &heights);
+    wvu::TerrainParameters terrain_parameters;
+    terrain_parameters.size = 8.0f * kFarPlaneDistance;
+    terrain_parameters.origin = Eigen::Vector3f(
+        -0.5f * terrain_parameters.size, model.position().y() - 4.0f,
+        -0.5f * terrain_parameters.size);
+    terrain_parameters.height_scale = 2.0f;
+    terrain_parameters.patch_resolution = 16;
+    terrain_parameters.num_levels = 6;
+    // The finest patches meet the coarser ones within the view.
+    terrain_parameters.lod_distance = 0.5f * kFarPlaneDistance;
+    if (!terrain.Initialize(heights.data(), 257, 257, terrain_parameters,
+                            frame_uniforms, &error_info_log)) {
+      LOG(ERROR) << "Could not create the terrain: " << error_info_log;
+      return -1;
+    }
+  }
+  // Index the triangles for picking before the levels of detail replace them.
+  wvu::MeshPicker picker;
+  if (FLAGS_picking && !picker.Build(model)) {
+    LOG(WARNING) << "The model is not a triangle list, so it is not picked.";
+  }
+  // The clicks are drawn into the ID target on the next frame, and read back
+  // on a later one.
+  wvu::GpuPicker gpu_picker;
+  if (FLAGS_gpu_picking &&
+      !gpu_picker.Initialize(wvu::kDefaultNumPickBuffers, &error_info_log)) {
+    LOG(ERROR) << "Could not set up the GPU picking: " << error_info_log;
+    return -1;
+  }
+  bool gpu_pick_pending = false;
+  Eigen::Vector2f gpu_pick_point = Eigen::Vector2f::Zero();
+  // Build the levels of detail of the model. They share its vertices, and the
+  // EBO holds the indices of all the levels.
+  wvu::MeshLodChain lod_chain;
+  lod_chain.Build(model, 4, 0.5f);
+  model.SetIndices(lod_chain.indices());
+  // Triangle strips are separated by restart indices.
+  wvu::EnablePrimitiveRestart(model.index_type());
+  // Upload the vertices and indices on a hidden window sharing the objects of
+  // the main one, so the window keeps responding while they are transferred.
+  // The uploader takes a copy of the vertices and indices, and the model only
+  // keeps its transform.
+  wvu::ContextPool context_pool;
+  if (!context_pool.Initialize(window, std::max(FLAGS_num_shared_contexts, 1),
+                               &error_info_log)) {
+    LOG(ERROR) << "Could not create the shared contexts: " << error_info_log;
+    glfwTerminate();
+    return -1;
+  }
+  GLFWwindow* upload_context = context_pool.Acquire();
+  wvu::MeshUploader mesh_uploader;
+  if (!mesh_uploader.Initialize(upload_context, &error_info_log)) {
+    LOG(ERROR) << "Could not start the mesh uploader: " << error_info_log;
+    glfwTerminate();
+    return -1;
+  }
+  const int upload_phase = startup_trace.BeginAsyncPhase("mesh upload");
+  mesh_uploader.Upload(model);
+  model.ReleaseCpuData();
+  // The scene opens with the bounds of its objects, and loads their meshes on
+  // the same uploader as they come into view.
+  wvu::StreamedScene scene;
+  if (!FLAGS_scene_file.empty() &&
+      !scene.Open(FLAGS_scene_file, wvu::SceneStreamingOptions(),
+                  &error_info_log)) {
+    LOG(ERROR) << "Could not open the scene: " << error_info_log;
+    mesh_uploader.Stop();
+    glfwTerminate();
+    return -1;
+  }
+  // The mesh is drawn once its upload completes.
+  wvu::GpuMesh mesh;
+  std::vector<wvu::CompletedMeshUpload> completed_uploads;
+
+  // Create the camera, at the origin looking down -z. Its projection is
+  // recomputed when the window is resized.
+  constexpr GLfloat field_of_view = 45.0f;
+  wvu::Camera camera;
+  camera.SetPerspective(field_of_view,
+                        ComputeAspectRatio(render_width, render_height), 0.1f,
+                        kFarPlaneDistance);
+  VLOG(1) << "Projection: \n" << camera.projection();
+  const Eigen::Vector3f rotation_axis =
+      Eigen::Vector3f(1.0f, 1.0f, 1.0f).normalized();
+
+  // The split views share the render queue of the single view, with their own
+  // program.
+  const bool split_view = FLAGS_num_views > 1;
+  wvu::ShaderProgram multi_view_program;
+  wvu::MultiViewUniforms multi_view;
+  if (split_view) {
+    error_info_log = "Could not set the split views.";
+    if (!SetUpSplitViews(FLAGS_num_views, &multi_view_program, &multi_view,
+                         &error_info_log) ||
+        !UpdateSplitViews(FLAGS_num_views, render_width, render_height,
+                          model.position(), camera.projection(), &multi_view)) {
+      LOG(ERROR) << error_info_log;
+      glfwTerminate();
+      return -1;
+    }
+    VLOG(1) << FLAGS_num_views << " views rendered in "
+            << (wvu::MultiViewUniforms::SinglePassSupported() ?
+                "a single pass." : "one pass per view.");
+  }
+
+  // A scene with deferred lighting draws into the G-buffer with its own
+  // program, and its lights shade every pixel once. The G-buffer is not
+  // multisampled, and does not hold the split views, so they stay forward.
+  const bool deferred = lit && scene.lighting() == wvu::DEFERRED_LIGHTING &&
+      !split_view && msaa_framebuffer.framebuffer_id() == 0 &&
+      msaa_benchmark == nullptr;
+  wvu::ShaderProgram gbuffer_program;
+  wvu::DeferredShading deferred_shading;
+  if (deferred) {
+    gbuffer_program.LoadVertexShaderFromString(VertexShaderSource(lit));
+    gbuffer_program.LoadFragmentShaderFromString(
+        "#version 430 core\n" + wvu::DeferredShading::GlslDeclaration() +
+        gbuffer_fragment_shader_body);
+    if (!gbuffer_program.Create(&error_info_log) ||
+        !frame_uniforms.Attach(&gbuffer_program) ||
+        !deferred_shading.Initialize(render_width, render_height,
+                                     &error_info_log)) {
+      LOG(ERROR) << "Could not set up the deferred shading: "
+                 << error_info_log;
+      glfwTerminate();
+      return -1;
+    }
+    gbuffer_program.Use();
+    gbuffer_program.SetUniform(gbuffer_program.GetUniformLocation("material"),
+                               0);
+  } else if (lit && scene.lighting() == wvu::DEFERRED_LIGHTING) {
+    LOG(WARNING) << "The split views and MSAA shade the scene forward.";
+  }
+
+  // The post-processing chain draws the frame into its own framebuffer, and
+  // writes the processed frame into the framebuffer the frame was meant for.
+  wvu::PostProcessing post_processing;
+  const bool post_process = !FLAGS_post_effects.empty();
+  if (post_process) {
+    std::vector<wvu::PostEffect> post_effects;
+    if (msaa_framebuffer.framebuffer_id() != 0 || msaa_benchmark != nullptr) {
+      LOG(ERROR) << "--post_effects does not support MSAA.";
+      glfwTerminate();
+      return -1;
+    }
+    if (!wvu::ParsePostEffects(FLAGS_post_effects, &post_effects,
+                               &error_info_log) ||
+        !post_processing.Initialize(post_effects, render_width, render_height,
+                                    &error_info_log)) {
+      LOG(ERROR) << "Could not set up the post-processing: "
+                 << error_info_log;
+      glfwTerminate();
+      return -1;
+    }
+  }
+
+  // The batch modes render the poses or the poster once the mesh is uploaded,
+  // and exit without entering the render loop.
+  if (!FLAGS_camera_poses_file.empty() || !FLAGS_poster_file.empty()) {
+    while (!mesh.valid()) {
+      if (mesh_uploader.TakeCompletedMeshes(&completed_uploads) > 0) {
+        mesh = std::move(completed_uploads.front().mesh);
+        completed_uploads.clear();
+      } else if (mesh_uploader.num_pending() == 0) {
+        break;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    error_info_log = "Could not upload the mesh.";
+    bool rendered = mesh.valid();
+    if (rendered && !FLAGS_camera_poses_file.empty()) {
+      rendered = RenderCameraPoses(mesh, lod_chain.lod(0), model,
+                                   camera.projection(), &error_info_log);
+    }
+    if (rendered && !FLAGS_poster_file.empty()) {
+      rendered = RenderPoster(&shader_program, mesh,
+                              texture_manager.texture_id(model_texture),
+                              lod_chain.lod(0), model, camera,
+                              &error_info_log);
+    }
+    if (!rendered) LOG(ERROR) << error_info_log;
+    mesh.Reset();
+    texture_manager.Reset();
+    mesh_uploader.Stop();
+    context_pool.Release(upload_context);
+    context_pool.Destroy();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return rendered ? 0 : -1;
+  }
 
   // Loop until the user closes the window.
   const GLfloat rotation_speed = 50.0f;
+  GLfloat last_time = 0.0f;
+  // The animation is simulated at a fixed rate on its own thread, and the
+  // frames interpolate the last two simulated angles. The angle is only
+  // touched by the simulation thread.
+  GLfloat simulated_angle = 0.0f;
+  wvu::FramePipeline<AnimationPacket> simulation;
+  simulation.Start(1.0 / FLAGS_simulation_rate,
+                   [&simulated_angle, rotation_speed](
+                       const double time, const double step,
+                       AnimationPacket* packet) {
+    packet->simulation_time = time;
+    packet->previous_angle = simulated_angle;
+    simulated_angle += rotation_speed * step * M_PI / 180.f;
+    packet->current_angle = simulated_angle;
+  });
+  wvu::RenderQueue render_queue("model");
+  // The items of the programs reading instance transforms are coalesced into
+  // instanced draws.
+  render_queue.EnableInstancing(&ring_buffer);
+  if (FLAGS_sort_front_to_back) {
+    render_queue.set_sort_order(wvu::SORT_FRONT_TO_BACK);
+  }
+  // The meshes of the scene share the vertex array of their layout.
+  wvu::SharedVertexArrays shared_vertex_arrays;
+  if (wvu::SharedVertexArrays::Supported()) {
+    render_queue.set_shared_vertex_arrays(&shared_vertex_arrays);
+  }
+  // The additional windows execute the queue of the main window with their
+  // own cameras and vertex arrays. The lights and the split views are bound
+  // to the context of the main window, so they are only shown there.
+  wvu::MultiWindowRenderer multi_window;
+  if (FLAGS_num_windows > 1) {
+    if (FLAGS_headless || split_view || lit ||
+        !wvu::SharedVertexArrays::Supported()) {
+      LOG(ERROR) << "--num_windows needs a visible window, no lights, a "
+                 << "single view and separate attribute formats.";
+      glfwTerminate();
+      return -1;
+    }
+    if (!multi_window.Initialize(window, FLAGS_num_windows - 1, kWindowWidth,
+                                 kWindowHeight, window_name,
+                                 &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      glfwTerminate();
+      return -1;
+    }
+  }
+  wvu::FrameLogChannel frame_log(FLAGS_frame_log_interval);
+  // Time the stages of the frames. The statistics are logged with the frame
+  // log.
+  wvu::FrameProfiler profiler;
+  const int update_scope = profiler.AddCpuScope("update");
+  const int render_scope = profiler.AddCpuScope("RenderScene");
+  const int gpu_render_scope = profiler.AddGpuScope("RenderScene");
+  if (FLAGS_dynamic_resolution && !profiler.gpu_timing_supported()) {
+    LOG(WARNING) << "The GPU times are not measured, so the resolution stays "
+                 << "at its largest scale.";
+  }
+  const int pacing_scope = profiler.AddCpuScope("frame pacing");
+  const int frame_start_scope = profiler.AddCpuScope("frame start pacing");
+  const int swap_scope = profiler.AddCpuScope("glfwSwapBuffers");
+  const int poll_scope = profiler.AddCpuScope("glfwPollEvents");
+  // Time from the oldest input event of a frame until it is handled.
+  const int input_latency_scope = profiler.AddCpuScope("input latency");
+  // Time spent in the jobs of the frame, summed over the threads.
+  const int jobs_scope = profiler.AddCpuScope("jobs");
+  // Time spent in the OpenGL calls of the frame, and their number in the
+  // traces, if the calls are counted.
+  const int gl_calls_scope = wvu::GlCallCountingEnabled() ?
+      profiler.AddCpuScope("OpenGL calls") : -1;
+  const int gl_calls_counter = profiler.AddCounter("OpenGL calls");
+  const int debug_messages_counter =
+      profiler.AddCounter("driver performance messages");
+  // The main thread keeps a core of its own once the driver threads started,
+  // since the threads a thread creates inherit its affinity, and the workers
+  // fill the other cores of its NUMA node.
+  const int num_job_threads =
+      std::max<int>(std::thread::hardware_concurrency(), 1);
+  wvu::ThreadPlacement thread_placement;
+  if (FLAGS_main_thread_cpu >= 0) {
+    const wvu::CpuTopology topology = wvu::QueryCpuTopology();
+    thread_placement = wvu::PlanThreadPlacement(
+        topology, FLAGS_main_thread_cpu, num_job_threads - 1);
+    VLOG(1) << "Main thread on CPU " << FLAGS_main_thread_cpu
+            << " of NUMA node " << topology.NodeOfCpu(FLAGS_main_thread_cpu)
+            << " of " << topology.num_nodes() << ".";
+  }
+  thread_placement.main_niceness = FLAGS_main_thread_niceness;
+  if (!wvu::PlaceMainThread(thread_placement, &error_info_log)) {
+    LOG(WARNING) << error_info_log;
+  }
+  // Runs the parallel per-frame CPU work.
+  wvu::JobSystem job_system(num_job_threads, thread_placement.worker_cpus);
+  if (job_system.num_unpinned_workers() > 0) {
+    LOG(WARNING) << job_system.num_unpinned_workers() << " of "
+                 << num_job_threads - 1 << " job workers could not be pinned.";
+  }
+  std::vector<wvu::JobThreadStatistics> job_thread_statistics;
+  // Transient data of the frames. Its buffers grow to the largest frame, after
+  // which the frames do not allocate from the heap.
+  wvu::FrameArena frame_arena;
+  if (FLAGS_trace_frames > 0) profiler.StartCapture(FLAGS_trace_frames);
+  wvu::PerformanceHud hud;
+  if (!hud.Initialize(&error_info_log)) {
+    LOG(ERROR) << error_info_log;
+    return -1;
+  }
+  show_hud = FLAGS_show_hud;
+  // The overdraw view counts the fragments of the items with the vertex
+  // shader of the unlit model, which transforms them the same way.
+  wvu::OverdrawView overdraw_view;
+  if (!overdraw_view.Initialize(VertexShaderSource(false), &error_info_log) ||
+      !frame_uniforms.Attach(overdraw_view.program())) {
+    LOG(ERROR) << "Could not create the overdraw view: " << error_info_log;
+    return -1;
+  }
+  wvu::DrawTimer draw_timer;
+  wvu::InputLatencyTracker input_latency;
+  if (FLAGS_measure_input_latency) input_latency.Initialize(window);
+  // The metrics are scraped and the knobs set between the frames, on this
+  // thread, so the knobs apply their flags right away.
+  wvu::MetricsServer metrics;
+  if (FLAGS_metrics_port > 0 &&
+      !metrics.Start(FLAGS_metrics_port, &error_info_log)) {
+    LOG(ERROR) << error_info_log;
+    return -1;
+  }
+  metrics.set_profiler(&profiler);
+  const int frame_time_metric = metrics.AddHistogram(
+      "frame_time_milliseconds", "Time between the starts of the frames.",
+      {4.0, 8.0, 11.1, 16.7, 33.3, 50.0, 100.0, 250.0});
+  const int draws_metric =
+      metrics.AddGauge("draws", "Draws of the last frame.");
+  const int triangles_metric =
+      metrics.AddGauge("triangles", "Triangles drawn in the last frame.");
+  const int state_changes_metric = metrics.AddGauge(
+      "state_changes", "OpenGL state changes of the last frame.");
+  const int elided_state_changes_metric = metrics.AddGauge(
+      "elided_state_changes",
+      "State changes of the last frame elided by the state cache.");
+  const int gl_calls_metric = metrics.AddGauge(
+      "gl_calls", "OpenGL calls of the last frame, if they are counted.");
+  const int jobs_metric =
+      metrics.AddCounter("jobs_total", "Jobs run by the job system.");
+  const int job_utilization_metric = metrics.AddGauge(
+      "job_utilization",
+      "Fraction of the last frame the job threads spent running jobs.");
+  const int job_migrations_metric = metrics.AddCounter(
+      "job_migrations_total",
+      "Jobs run on another CPU than the previous job of their thread.");
+  const int buffer_bytes_metric =
+      metrics.AddGauge("buffer_bytes", "Bytes of the live buffers.");
+  const int texture_upload_metric = metrics.AddCounter(
+      "texture_uploaded_bytes_total", "Bytes of texture levels streamed.");
+  const int texture_resident_metric = metrics.AddGauge(
+      "texture_resident_bytes", "Bytes of the resident texture levels.");
+  const int pending_texture_levels_metric = metrics.AddGauge(
+      "pending_texture_levels", "Texture levels waiting for their upload.");
+  const int pending_mesh_uploads_metric = metrics.AddGauge(
+      "pending_mesh_uploads", "Meshes queued or uploading.");
+  const int pending_deletions_metric = metrics.AddGauge(
+      "pending_gpu_deletions",
+      "OpenGL objects waiting for the GPU to finish their frames.");
+  const int texture_cache_hits_metric = metrics.AddCounter(
+      "texture_cache_hits_total", "Textures read from the texture cache.");
+  const int texture_cache_misses_metric = metrics.AddCounter(
+      "texture_cache_misses_total", "Textures decoded from their image.");
+  metrics.Set(metrics.AddGauge("program_binary_cache_hits",
+                               "Programs loaded from the binary cache."),
+              shader_program.loaded_from_binary_cache() ? 1.0 : 0.0);
+  AddFlagKnob("frame_pacing", [&frame_pacer]() {
+    wvu::FramePacingMode mode;
+    std::string error_info_log;
+    return wvu::ParseFramePacingMode(FLAGS_frame_pacing, &mode) &&
+        !FLAGS_headless &&
+        frame_pacer.Initialize(mode, FLAGS_target_frame_rate,
+                               &error_info_log);
+  }, &metrics);
+  AddFlagKnob("lod_pixel_error",
+              []() { return FLAGS_lod_pixel_error > 0.0; }, &metrics);
+  if (FLAGS_dynamic_resolution) {
+    AddFlagKnob("dynamic_resolution_min_scale", [&dynamic_resolution]() {
+      return dynamic_resolution.SetMinScale(
+          FLAGS_dynamic_resolution_min_scale);
+    }, &metrics);
+  }
+  if (FLAGS_allocation_check_frames > 0 && !wvu::AllocationTrackingEnabled()) {
+    LOG(ERROR) << "--allocation_check_frames needs a build with the "
+               << "TRACK_ALLOCATIONS option.";
+    return -1;
+  }
+  startup_trace.EndPhase(setup_phase);
+  // The frames until the mesh shows. Ended after the first frame drawing it.
+  int first_frames_phase = startup_trace.BeginPhase("first frames");
+  int exit_code = 0;
+  Eigen::Matrix4f previous_view_projection = camera.view_projection();
   while (!glfwWindowShouldClose(window)) {
-    // Render the scene!
+    // The frames the compositor would not show are not rendered, and the
+    // loop only handles the events until it asks for a new one.
+    if (!window_frame_ready && !FLAGS_headless) {
+      glfwWaitEventsTimeout(kFrameReadyTimeout);
+      continue;
+    }
+    // Iconified windows render nothing, and unfocused ones may render at a
+    // low rate. The events that restore them end the waits.
+    if (!FLAGS_headless && !render_throttle.WaitForFrame()) continue;
+    if (trace_requested && !profiler.capturing()) {
+      profiler.StartCapture(FLAGS_trace_frames > 0 ? FLAGS_trace_frames :
+                            kDefaultNumTraceFrames);
+    }
+    trace_requested = false;
+    if (profiler.capture_complete()) {
+      if (profiler.WriteChromeTrace(FLAGS_trace_file, &error_info_log)) {
+        LOG(INFO) << "Wrote the frame trace " << FLAGS_trace_file;
+      } else {
+        LOG(ERROR) << error_info_log;
+      }
+    }
+    profiler.BeginFrame();
+    // The counters of the OpenGL calls of the last frame are complete.
+    wvu::BeginGlCallFrame();
+    if (wvu::GlCallCountingEnabled()) {
+      profiler.AddCpuSample(gl_calls_scope, wvu::GlCallTimeMs());
+      profiler.SetCounter(gl_calls_counter, wvu::NumGlCalls());
+    }
+    debug_output.BeginFrame();
+    if (FLAGS_debug_context) {
+      profiler.SetCounter(debug_messages_counter,
+                          debug_output.num_frame_messages());
+    }
+    job_system.BeginFrame();
+    frame_arena.BeginFrame();
+    profiler.BeginScope(update_scope);
     // Casting using (<type>) -- which is the C way -- is not recommended.
     // Instead, use static_cast<type>(input argument).
-    angle = rotation_speed * static_cast<GLfloat>(glfwGetTime()) * M_PI / 180.f;
-    RenderScene(shader_program, vertex_array_object_id, 
-                projection_matrix, angle, window);
+    const GLfloat time = static_cast<GLfloat>(glfwGetTime());
+    // Restart the counters of the calls elided by the state cache.
+    wvu::GlStateCache::Current()->BeginFrame();
+    frame_log.BeginFrame();
+    if (FLAGS_headless && FLAGS_headless_frames > 0 &&
+        frame_log.frame() + 1 >= FLAGS_headless_frames) {
+      glfwSetWindowShouldClose(window, GL_TRUE);
+    }
+    // Once warmed up, the frames must not allocate. The counters of a frame
+    // are complete at the start of the next one.
+    if (FLAGS_allocation_check_frames > 0) {
+      const int64_t frame = frame_log.frame();
+      if (frame > FLAGS_allocation_warmup_frames &&
+          profiler.num_frame_allocations() > 0) {
+        LOG(ERROR) << "Frame " << frame - 1 << " made "
+                   << profiler.num_frame_allocations() << " allocations:"
+                   << profiler.Report();
+        exit_code = -1;
+        glfwSetWindowShouldClose(window, GL_TRUE);
+      }
+      if (frame >=
+          FLAGS_allocation_warmup_frames + FLAGS_allocation_check_frames) {
+        glfwSetWindowShouldClose(window, GL_TRUE);
+      }
+    }
+    // Follow the size of the window. The callback only flags actual changes,
+    // and minimized windows, of size zero, keep their targets.
+    if (window_framebuffer_resized && !FLAGS_headless &&
+        window_framebuffer_width > 0 && window_framebuffer_height > 0) {
+      window_framebuffer_resized = false;
+      render_width = window_framebuffer_width;
+      render_height = window_framebuffer_height;
+      camera.SetAspectRatio(ComputeAspectRatio(render_width, render_height));
+      ConfigureViewPort();
+      const bool resized =
+          (msaa_framebuffer.framebuffer_id() == 0 ||
+           msaa_framebuffer.Initialize(render_width, render_height,
+                                       FLAGS_msaa_samples, &error_info_log)) &&
+          (!FLAGS_dynamic_resolution ||
+           dynamic_resolution.Resize(render_width, render_height,
+                                     &error_info_log));
+      if (!resized) {
+        LOG(ERROR) << "Could not resize the render targets: "
+                   << error_info_log;
+        exit_code = -1;
+        break;
+      }
+      if (split_view) {
+        UpdateSplitViews(FLAGS_num_views, render_width, render_height,
+                         model.position(), camera.projection(), &multi_view);
+      }
+      VLOG(1) << "Resized to " << render_width << "x" << render_height;
+    }
+    // Wait until the GPU is done with the section this frame writes into.
+    ring_buffer.BeginFrame();
+    // Evict buffers if the uploads went over the budget.
+    buffer_allocator->EnforceBudget();
+    // Upload the per-frame uniforms once, before any draw of this frame.
+    const GLfloat delta_time = time - last_time;
+    frame_uniforms.Update(camera.view(), camera.projection(), time,
+                          delta_time);
+    last_time = time;
+    // Take the meshes whose uploads finished, without waiting for them: the
+    // meshes of the scene, and then the mesh of the model.
+    if (mesh_uploader.TakeCompletedMeshes(&completed_uploads) > 0) {
+      scene.TakeCompletedMeshes(&completed_uploads);
+      if (!mesh.valid() && !completed_uploads.empty()) {
+        mesh = std::move(completed_uploads.front().mesh);
+        startup_trace.EndPhase(upload_phase);
+      }
+      completed_uploads.clear();
+    }
+    if (!FLAGS_scene_file.empty()) scene.Update(camera, &mesh_uploader);
+    // Take the decoded texture if it finished, without waiting for it.
+    if (texture_cache.TakeCompletedTextures(&completed_textures) > 0) {
+      wvu::CompletedTextureLoad& load = completed_textures.front();
+      const int texture = load.source == nullptr ? -1 :
+          texture_manager.Add(std::move(load.source), &load.error_info_log);
+      if (texture < 0) {
+        LOG(ERROR) << "Could not load the texture: " << load.error_info_log;
+      } else {
+        model_texture = texture;
+        VLOG(1) << "Loaded " << FLAGS_texture_file
+                << (load.cache_hit ? " from the cache." : ".");
+        metrics.Increment(load.cache_hit ? texture_cache_hits_metric :
+                          texture_cache_misses_metric);
+      }
+      completed_textures.clear();
+    }
+    // Take the latest animation state. The frame shows the time of one step
+    // ago, which lies between the two angles of the packet.
+    const AnimationPacket* packet = simulation.AcquireLatestPacket();
+    input_latency.MarkStage(wvu::LATENCY_SIMULATION);
+    if (packet != nullptr) {
+      const double alpha = std::min(std::max(
+          (simulation.time() - packet->simulation_time) / simulation.step(),
+          0.0), 1.0);
+      const GLfloat angle = packet->previous_angle +
+          alpha * (packet->current_angle - packet->previous_angle);
+      model.SetOrientation(angle * rotation_axis);
+    }
+    // Render the scene!
+    profiler.EndScope(update_scope);
+    profiler.BeginScope(render_scope);
+    profiler.BeginScope(gpu_render_scope);
+    // The draws are timed while the overlay lists them.
+    if (time_draws) {
+      draw_timer.BeginFrame();
+    } else if (!draw_timer.draw_times().empty()) {
+      draw_timer.Reset();
+    }
+    render_queue.set_draw_timer(time_draws ? &draw_timer : nullptr);
+    if (msaa_benchmark != nullptr && !msaa_benchmark->done()) {
+      if (!msaa_benchmark->BeginFrame(&msaa_framebuffer, &error_info_log)) {
+        LOG(ERROR) << error_info_log;
+        exit_code = -1;
+        glfwSetWindowShouldClose(window, GL_TRUE);
+      } else if (msaa_benchmark->done()) {
+        LOG(INFO) << msaa_benchmark->Report();
+        glfwSetWindowShouldClose(window, GL_TRUE);
+      }
+    }
+    if (FLAGS_dynamic_resolution) {
+      // The GPU times arrive a few frames late, which the scaling expects.
+      dynamic_resolution.Update(profiler.LatestSample(gpu_render_scope));
+      dynamic_resolution.Bind();
+    } else if (msaa_framebuffer.framebuffer_id() != 0) {
+      msaa_framebuffer.Bind();
+    } else if (FLAGS_headless) {
+      offscreen_framebuffer.Bind();
+    }
+    GLint post_target_framebuffer_id = 0;
+    if (post_process) {
+      glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &post_target_framebuffer_id);
+      if (!post_processing.Resize(
+              FLAGS_dynamic_resolution ? dynamic_resolution.render_width() :
+              render_width,
+              FLAGS_dynamic_resolution ? dynamic_resolution.render_height() :
+              render_height,
+              &error_info_log)) {
+        LOG(ERROR) << error_info_log;
+      }
+      post_processing.Bind();
+    }
+    if (mesh.valid()) {
+      // The texture spans a unit of the model, whose projected size selects
+      // the finest level to stream.
+      texture_manager.RequestScreenSize(
+          model_texture,
+          0.5f * render_height *
+          wvu::ComputeCotangent(0.5f * camera.field_of_view()) /
+          std::max((model.position() - camera.position()).norm(), 1e-6f));
+      if (!texture_manager.Update()) {
+        LOG(WARNING) << "Could not stream the texture.";
+      }
+      // The clusters and the G-buffer tile the framebuffer drawn, which the
+      // dynamic resolution scales.
+      const int frame_width = FLAGS_dynamic_resolution ?
+          dynamic_resolution.render_width() : render_width;
+      const int frame_height = FLAGS_dynamic_resolution ?
+          dynamic_resolution.render_height() : render_height;
+      // The split views draw with their own vertex shader, so they show the
+      // scene.
+      const bool overdraw_frame = show_overdraw && !split_view;
+      GLint target_framebuffer_id = 0;
+      if (overdraw_frame) {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target_framebuffer_id);
+        if (!overdraw_view.Begin(frame_width, frame_height,
+                                 &error_info_log)) {
+          LOG(ERROR) << error_info_log;
+        }
+      } else if (deferred) {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target_framebuffer_id);
+        if (!deferred_shading.Resize(frame_width, frame_height,
+                                     &error_info_log)) {
+          LOG(ERROR) << error_info_log;
+        }
+        deferred_shading.BindGBuffer();
+      } else if (lit) {
+        clustered_lighting.Update(
+            lights.data(), lights.size(), camera.view(), camera.projection(),
+            frame_width, frame_height, &job_system);
+        clustered_lighting.Bind();
+      }
+      // The coarse rates follow the motion of the model on screen, and the
+      // overlay, which is drawn at the output size.
+      if (variable_rate_shading.tile_width() > 0) {
+        if (!variable_rate_shading.Resize(frame_width, frame_height,
+                                          &error_info_log)) {
+          LOG(ERROR) << error_info_log;
+        }
+        variable_rate_shading.SetMotion(ScreenMotion(
+            previous_view_projection, camera.view_projection(),
+            model.position(), frame_width, frame_height));
+        previous_view_projection = camera.view_projection();
+        variable_rate_shading.ClearRegions();
+        if (show_hud) {
+          float hud_width = 0.0f;
+          float hud_height = 0.0f;
+          hud.PanelSize(&hud_width, &hud_height);
+          const float scale_x = static_cast<float>(frame_width) / render_width;
+          const float scale_y =
+              static_cast<float>(frame_height) / render_height;
+          variable_rate_shading.AddRegion(
+              0, frame_height - static_cast<int>(hud_height * scale_y),
+              static_cast<int>(hud_width * scale_x),
+              static_cast<int>(hud_height * scale_y), wvu::SHADING_RATE_4X4);
+        }
+        variable_rate_shading.Update();
+        variable_rate_shading.Enable();
+      }
+      // The depth program does not declare the block of the split views, so
+      // their prepass draws with their own program.
+      RenderScene(split_view ? &multi_view_program :
+                  deferred ? &gbuffer_program : &shader_program, mesh,
+                  texture_manager.texture_id(model_texture), lod_chain,
+                  camera, render_height, model, scene,
+                  &render_queue,
+                  split_view ? &multi_view : nullptr,
+                  split_view ? nullptr : &depth_program,
+                  overdraw_frame ? overdraw_view.program() : nullptr,
+                  frame_log, window);
+      // The ID pass draws the queue of the scene again, at the pixel picked.
+      if (gpu_pick_pending && !split_view) {
+        gpu_pick_pending = false;
+        gpu_picker.Pick(camera.view(), camera.projection(), gpu_pick_point,
+                        frame_width, frame_height, frame_log.frame(),
+                        &render_queue);
+      }
+      // The lit colors and the depths are copied into the target, so the
+      // terrain and the particles draw over them as on the forward path.
+      if (deferred && !overdraw_frame) {
+        deferred_shading.Update(lights.data(), lights.size(), camera.view());
+        deferred_shading.Shade(camera.projection(), target_framebuffer_id);
+      }
+      if (FLAGS_terrain && !split_view && !overdraw_frame) {
+        terrain.Update(camera.position(), camera.view_projection());
+        terrain.Render();
+      }
+      // The particles blend over the opaque scene.
+      if (FLAGS_num_particles > 0 && !split_view && !overdraw_frame) {
+        particles.Update(delta_time, &job_system);
+        particles.Render();
+      }
+      // The post-processing and the overlay shade every pixel.
+      variable_rate_shading.Disable();
+      if (overdraw_frame) overdraw_view.Resolve(target_framebuffer_id);
+      // The overlay covers the whole framebuffer.
+      if (split_view && FLAGS_headless) {
+        offscreen_framebuffer.Bind();
+      } else if (split_view) {
+        ConfigureViewPort();
+      }
+    } else {
+      ClearTheFrameBuffer();
+    }
+    if (post_process) {
+      post_processing.SetProjection(camera.projection());
+      post_processing.Apply(post_target_framebuffer_id);
+    }
+    if (FLAGS_dynamic_resolution) {
+      dynamic_resolution.Resolve(output_framebuffer_id);
+    } else if (msaa_framebuffer.framebuffer_id() != 0) {
+      msaa_framebuffer.Resolve(output_framebuffer_id);
+    }
+    // The overlay shows the counters of this frame, and the time and the
+    // OpenGL calls of the last one.
+    wvu::HudFrameStatistics hud_statistics;
+    hud_statistics.frame_time_ms = 1000.0f * delta_time;
+    hud_statistics.num_draws = render_queue.statistics().num_draws;
+    hud_statistics.num_triangles = render_queue.statistics().num_triangles;
+    hud_statistics.num_state_changes =
+        wvu::GlStateCache::Current()->num_calls();
+    hud_statistics.num_elided_state_changes =
+        wvu::GlStateCache::Current()->num_elided_calls();
+    hud_statistics.buffer_bytes =
+        buffer_allocator->statistics().total_live_bytes;
+    if (show_hud && wvu::QueryGpuMemoryInfo(&gpu_memory_info)) {
+      hud_statistics.gpu_available_bytes = gpu_memory_info.available_bytes;
+    }
+    if (wvu::GlCallCountingEnabled()) {
+      hud_statistics.num_gl_calls = wvu::NumGlCalls();
+      hud_statistics.gl_call_time_ms = wvu::GlCallTimeMs();
+    }
+    if (time_draws) {
+      const std::vector<wvu::DrawTime>& draw_times = draw_timer.draw_times();
+      hud_statistics.num_slowest_draws =
+          std::min(static_cast<int>(draw_times.size()), wvu::kNumHudDrawTimes);
+      std::copy(draw_times.begin(),
+                draw_times.begin() + hud_statistics.num_slowest_draws,
+                hud_statistics.slowest_draws);
+      hud_statistics.draws_gpu_ms = draw_timer.total_ms();
+    }
+    hud.AddFrame(hud_statistics);
+    hud.set_visible(show_hud);
+    hud.Draw(render_width, render_height);
+    profiler.EndScope(gpu_render_scope);
+    profiler.EndScope(render_scope);
+    input_latency.MarkStage(wvu::LATENCY_RENDER);
+    FRAME_LOG(frame_log, INFO)
+        << render_queue.statistics().num_draws << " draws ("
+        << render_queue.statistics().num_coalesced_items
+        << " items instanced), "
+        << wvu::GlStateCache::Current()->num_elided_calls() << " of "
+        << wvu::GlStateCache::Current()->num_calls()
+        << " state changes elided, " << ring_buffer.num_waits()
+        << " ring buffer waits, "
+        << buffer_allocator->statistics().total_live_bytes
+        << " bytes of buffers.";
+    profiler.AddCpuSample(jobs_scope, job_system.statistics().busy_ms);
+    FRAME_LOG(frame_log, INFO)
+        << job_system.statistics().num_jobs << " jobs on "
+        << job_system.num_threads() << " threads, "
+        << job_system.statistics().num_stolen_jobs << " stolen.";
+    if (frame_log.active()) {
+      job_system.GetThreadStatistics(&job_thread_statistics);
+      std::string utilization;
+      for (size_t i = 0; i < job_thread_statistics.size(); ++i) {
+        const wvu::JobThreadStatistics& thread = job_thread_statistics[i];
+        utilization += " " + std::to_string(i) + "@" +
+            std::to_string(thread.cpu) + ":" +
+            std::to_string(static_cast<int>(
+                100.0 * thread.busy_ms / std::max(1000.0 * delta_time, 1e-3))) +
+            "%";
+        if (thread.num_migrations > 0) {
+          utilization += "(" + std::to_string(thread.num_migrations) +
+              " migrations)";
+        }
+      }
+      FRAME_LOG(frame_log, INFO) << "Job thread@CPU utilization:"
+                                 << utilization;
+    }
+    FRAME_LOG(frame_log, INFO)
+        << frame_arena.statistics().num_bytes << " frame arena bytes, "
+        << frame_arena.statistics().high_water_bytes << " at most, "
+        << frame_arena.statistics().num_overflow_allocations
+        << " overflows.";
+    FRAME_LOG(frame_log, INFO)
+        << "Texture level " << texture_manager.resident_level(model_texture)
+        << " of " << texture_manager.requested_level(model_texture)
+        << " requested, " << texture_manager.statistics().resident_bytes
+        << " bytes resident, " << texture_manager.statistics().uploaded_bytes
+        << " bytes streamed.";
+    if (deferred) {
+      FRAME_LOG(frame_log, INFO)
+          << deferred_shading.statistics().num_visible_lights << " of "
+          << deferred_shading.statistics().num_lights
+          << " lights in front of the camera, shaded deferred.";
+    } else if (lit) {
+      const wvu::ClusteredLightingStatistics& light_statistics =
+          clustered_lighting.statistics();
+      FRAME_LOG(frame_log, INFO)
+          << light_statistics.num_visible_lights << " of "
+          << light_statistics.num_lights << " lights visible, "
+          << light_statistics.num_light_indices << " cluster entries, at most "
+          << light_statistics.max_lights_per_cluster << " lights per cluster.";
+    }
+    if (FLAGS_dynamic_resolution) {
+      FRAME_LOG(frame_log, INFO)
+          << "Rendering at " << dynamic_resolution.render_width() << "x"
+          << dynamic_resolution.render_height() << ", after "
+          << dynamic_resolution.num_scale_changes() << " scale changes.";
+    }
+    if (frame_pacer.mode() == wvu::JUST_IN_TIME) {
+      FRAME_LOG(frame_log, INFO)
+          << "Pacing at " << frame_pacer.statistics().refresh_rate
+          << " Hz with a budget of "
+          << frame_pacer.statistics().frame_budget_ms << " ms, "
+          << frame_pacer.statistics().num_missed_vblanks
+          << " vertical blanks missed.";
+    }
+    FRAME_LOG(frame_log, INFO) << "Frame profile:" << profiler.Report();
+    if (wvu::GlCallCountingEnabled()) {
+      FRAME_LOG(frame_log, INFO) << wvu::GlCallReport();
+    }
+    if (debug_output.num_messages() > 0) {
+      FRAME_LOG(frame_log, INFO) << debug_output.num_messages()
+                                 << " driver performance messages:"
+                                 << debug_output.Report();
+    }
+    if (FLAGS_measure_input_latency) {
+      FRAME_LOG(frame_log, INFO) << "Input latency:" << input_latency.Report();
+    }
+    // The scene was traversed into the queue once, and the other windows only
+    // draw it, each one with its context current once.
+    if (multi_window.num_windows() > 0 && mesh.valid()) {
+      multi_window.Render([&](const int index, const int width,
+                              const int height) {
+        // The cameras orbit the model, as the split views do.
+        const Eigen::Vector3f target = model.position();
+        const Eigen::AngleAxisf orbit(
+            2.0f * wvu::kPi * (index + 1) / FLAGS_num_windows,
+            Eigen::Vector3f::UnitY());
+        wvu::Camera window_camera = camera;
+        window_camera.LookAt(target + orbit * (camera.position() - target),
+                             target, Eigen::Vector3f::UnitY());
+        window_camera.SetAspectRatio(static_cast<float>(width) / height);
+        glViewport(0, 0, width, height);
+        ClearTheFrameBuffer();
+        wvu::GlStateCache* gl_state = wvu::GlStateCache::Current();
+        gl_state->SetCapability(GL_DEPTH_TEST, true);
+        gl_state->DepthFunc(GL_LESS);
+        // The uniform buffer binding belongs to the context.
+        frame_uniforms.Update(window_camera.view(),
+                              window_camera.projection(), time, delta_time);
+        render_queue.set_shared_vertex_arrays(
+            multi_window.vertex_arrays(index));
+        render_queue.SetViewProjection(window_camera.view(),
+                                       window_camera.projection());
+        render_queue.Execute();
+      });
+      render_queue.set_shared_vertex_arrays(&shared_vertex_arrays);
+      FRAME_LOG(frame_log, INFO)
+          << multi_window.statistics().num_windows_rendered
+          << " additional windows rendered with "
+          << multi_window.statistics().num_context_switches
+          << " context switches.";
+    }
+    ring_buffer.EndFrame();
+    if (FLAGS_metrics_port > 0) {
+      metrics.Observe(frame_time_metric, 1000.0 * delta_time);
+      metrics.Set(draws_metric, render_queue.statistics().num_draws);
+      metrics.Set(triangles_metric, render_queue.statistics().num_triangles);
+      metrics.Set(state_changes_metric,
+                  wvu::GlStateCache::Current()->num_calls());
+      metrics.Set(elided_state_changes_metric,
+                  wvu::GlStateCache::Current()->num_elided_calls());
+      if (wvu::GlCallCountingEnabled()) {
+        metrics.Set(gl_calls_metric, wvu::NumGlCalls());
+      }
+      metrics.Increment(jobs_metric, job_system.statistics().num_jobs);
+      metrics.Set(job_utilization_metric,
+                  job_system.statistics().busy_ms /
+                  std::max(1000.0 * delta_time * job_system.num_threads(),
+                           1e-3));
+      job_system.GetThreadStatistics(&job_thread_statistics);
+      for (const wvu::JobThreadStatistics& thread : job_thread_statistics) {
+        metrics.Increment(job_migrations_metric, thread.num_migrations);
+      }
+      metrics.Set(buffer_bytes_metric,
+                  buffer_allocator->statistics().total_live_bytes);
+      metrics.Increment(texture_upload_metric,
+                        texture_manager.statistics().uploaded_bytes);
+      metrics.Set(texture_resident_metric,
+                  texture_manager.statistics().resident_bytes);
+      metrics.Set(pending_texture_levels_metric,
+                  texture_manager.statistics().num_pending_levels);
+      metrics.Set(pending_mesh_uploads_metric, mesh_uploader.num_pending());
+      metrics.Set(pending_deletions_metric,
+                  gpu_resources->statistics().num_pending_deletions);
+    }
+
+    // Wait for the target time of the frame limiter, if any.
+    profiler.BeginScope(pacing_scope);
+    frame_pacer.WaitForFrame();
+    profiler.EndScope(pacing_scope);
 
     // Swap front and back buffers.
-    glfwSwapBuffers(window);
+    profiler.BeginScope(swap_scope);
+    // The headless frames are not presented, so only their commands are
+    // submitted.
+    if (FLAGS_headless) {
+      if (read_frames) readback.ReadPixels(frame_log.frame());
+      if (!FLAGS_dma_buf_socket.empty()) {
+        dma_buf_exporter.ExportFrame(frame_log.frame());
+      }
+      glFlush();
+    } else if (multi_window.num_windows() > 0) {
+      window_frame_ready = false;
+      multi_window.SwapBuffers();
+    } else {
+      window_frame_ready = false;
+      glfwSwapBuffers(window);
+    }
+    frame_pacer.EndFrame();
+    gpu_resources->EndFrame();
+    profiler.EndScope(swap_scope);
+    if (wvu::GlCaptureRecording()) {
+      wvu::EndGlCaptureFrame();
+      if (wvu::NumGlCaptureFrames() >= FLAGS_capture_frames) {
+        if (wvu::StopGlCapture(&error_info_log)) {
+          LOG(INFO) << "Captured " << FLAGS_capture_frames << " frames into "
+                    << FLAGS_capture_file;
+        } else {
+          LOG(ERROR) << error_info_log;
+        }
+      }
+    }
+    if (FLAGS_measure_input_latency) input_latency.EndFrame();
+    if (first_frames_phase >= 0 && mesh.valid()) {
+      startup_trace.EndPhase(first_frames_phase);
+      first_frames_phase = -1;
+      LOG(INFO) << "Startup:" << startup_trace.Report();
+      if (huge_page_mode != wvu::HUGE_PAGES_OFF) {
+        const wvu::HugePageStatistics statistics =
+            wvu::huge_page_statistics();
+        LOG(INFO) << statistics.explicit_bytes << " bytes of explicit and "
+                  << statistics.transparent_bytes << " bytes of transparent "
+                  << "huge pages, with " << statistics.num_fallbacks
+                  << " fallbacks to smaller pages.";
+      }
+      if (!FLAGS_startup_trace.empty() &&
+          !startup_trace.WriteChromeTrace(FLAGS_startup_trace,
+                                          &error_info_log)) {
+        LOG(ERROR) << error_info_log;
+      }
+    }
+
+    // Delay the input of the next frame until it can just make the next
+    // vertical blank, with the just-in-time pacing.
+    profiler.BeginScope(frame_start_scope);
+    frame_pacer.WaitForFrameStart();
+    profiler.EndScope(frame_start_scope);
 
     // Poll for and process events.
+    profiler.BeginScope(poll_scope);
     glfwPollEvents();
+    if (FLAGS_stream_port > 0) stream_server.PollInput(&input_buffer);
+    if (FLAGS_metrics_port > 0) metrics.Poll();
+    profiler.EndScope(poll_scope);
+    const int num_input_events =
+        input_buffer.Read(input_events.data(), input_events.size());
+    if (num_input_events > 0) {
+      const double latency_ms = 1000.0 *
+          (glfwGetTimerValue() - input_events[0].timestamp) /
+          glfwGetTimerFrequency();
+      profiler.AddCpuSample(input_latency_scope, latency_ms);
+      if (FLAGS_measure_input_latency) {
+        input_latency.TrackInput(input_events[0].timestamp);
+      }
+    }
+    for (int i = 0; i < num_input_events; ++i) {
+      HandleKey(window, input_events[i]);
+      HandleMouse(input_events[i]);
+    }
+    if (pick_requested) {
+      pick_requested = false;
+      if (picker.num_triangles() > 0) {
+        PickTriangle(window, picker,
+                     camera.view_projection() * model.model_matrix());
+      }
+      if (FLAGS_gpu_picking) {
+        gpu_pick_pending = GetCursorPoint(window, &gpu_pick_point);
+      }
+    }
+    // The picks in flight are only delivered once the GPU read them back.
+    wvu::GpuPick gpu_pick;
+    if (FLAGS_gpu_picking && gpu_picker.Poll(&gpu_pick)) {
+      LogGpuPick(gpu_pick, frame_log.frame());
+    }
   }
 
   // Cleaning up tasks.
-  glDeleteVertexArrays(1, &vertex_array_object_id);
-  glDeleteBuffers(1, &vertex_buffer_object_id);
+  // Complete the capture of a run shorter than --capture_frames.
+  if (wvu::GlCaptureRecording() && !wvu::StopGlCapture(&error_info_log)) {
+    LOG(ERROR) << error_info_log;
+  }
+  simulation.Stop();
+  if (render_throttle.statistics().num_waits > 0) {
+    LOG(INFO) << "Waited " << render_throttle.statistics().wait_time
+              << " s for events instead of rendering, and rendered "
+              << render_throttle.statistics().num_background_frames
+              << " frames in the background.";
+  }
+  texture_cache.Stop();
+  // Delete the VAO and its buffers while the context is alive.
+  mesh.Reset();
+  texture_manager.Reset();
+  clustered_lighting.Reset();
+  deferred_shading.Reset();
+  shared_vertex_arrays.Reset();
+  post_processing.Reset();
+  particles.Reset();
+  terrain.Reset();
+  gpu_picker.Reset();
+  if (read_frames) {
+    readback.Finish();
+    LOG(INFO) << "Read back " << num_read_frames << " frames, waiting "
+              << readback.num_waits() << " times.";
+  }
+  if (recording != nullptr) {
+    if (!recording->Stop(&error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      exit_code = -1;
+    }
+    const wvu::FrameEncoderStatistics statistics = recording->statistics();
+    LOG(INFO) << "Recorded " << statistics.num_encoded_frames << " of "
+              << statistics.num_submitted_frames << " frames into "
+              << FLAGS_record_file << ", waiting for the encoder "
+              << statistics.num_waits << " times, with up to "
+              << statistics.max_queue_size << " frames queued.";
+  }
+  if (!FLAGS_dma_buf_socket.empty()) {
+    const wvu::DmaBufExportStatistics statistics =
+        dma_buf_exporter.statistics();
+    LOG(INFO) << "Exported " << statistics.num_exported_frames
+              << " frames as dma-bufs to " << statistics.num_consumers
+              << " consumers, dropping " << statistics.num_dropped_frames
+              << " frames, waiting on the CPU " << statistics.num_cpu_waits
+              << " times.";
+    dma_buf_exporter.Reset();
+  }
+  if (FLAGS_stream_port > 0) {
+    stream_server.Stop();
+    const wvu::FrameStreamStatistics statistics = stream_server.statistics();
+    LOG(INFO) << "Streamed " << statistics.num_sent_frames << " frames to "
+              << statistics.num_clients << " clients in "
+              << statistics.num_sent_bytes << " of "
+              << statistics.num_raw_bytes << " bytes, dropping "
+              << statistics.num_dropped_frames << " frames, with "
+              << statistics.num_input_events << " input events.";
+  }
+  if (FLAGS_metrics_port > 0) {
+    metrics.Stop();
+    LOG(INFO) << "Served " << metrics.statistics().num_scrapes
+              << " metrics scrapes and "
+              << metrics.statistics().num_knob_changes << " knob changes.";
+  }
+  dynamic_resolution.Reset();
+  msaa_framebuffer.Reset();
+  offscreen_framebuffer.Reset();
+  scene.Reset();
+  multi_window.Reset();
+  // Stop the uploads before their context is destroyed.
+  mesh_uploader.Stop();
+  context_pool.Release(upload_context);
+  context_pool.Destroy();
+  // Delete the objects retired in the last frames while the context is alive.
+  // The objects deleted from now on are deleted at once.
+  gpu_resources->Flush();
+  gpu_resources->set_deferred(false);
+  if (FLAGS_deferred_deletion) {
+    const wvu::GpuResourceStatistics statistics =
+        gpu_resources->statistics();
+    LOG(INFO) << "Deferred the deletion of "
+              << statistics.num_deleted[wvu::GPU_BUFFER] << " buffers, "
+              << statistics.num_deleted[wvu::GPU_VERTEX_ARRAY]
+              << " vertex arrays, "
+              << statistics.num_deleted[wvu::GPU_PROGRAM] << " programs and "
+              << statistics.num_deleted[wvu::GPU_TEXTURE] << " textures, with "
+              << "at most " << statistics.peak_pending_deletions
+              << " objects pending.";
+  }
   // Destroy window.
   glfwDestroyWindow(window);
   // Tear down GLFW library.
   glfwTerminate();
+  if (!FLAGS_async_log_file.empty()) {
+    const wvu::AsyncLogStatistics statistics = async_log_sink.statistics();
+    LOG(INFO) << "Logged " << statistics.num_messages << " messages on the "
+              << "writer thread, dropping " << statistics.num_dropped_messages
+              << " and truncating " << statistics.num_truncated_messages
+              << ".";
+  }
 
-  return 0;
+  return exit_code;
 }
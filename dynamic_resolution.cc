@@ -0,0 +1,166 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <GL/glew.h>
+
+#include "offscreen_framebuffer.h"
+
+namespace wvu {
+namespace {
+// Weight of a new time in the moving average.
+constexpr float kFrameTimeSmoothing = 0.1f;
+// The scale is kept while the average is within this fraction of the target.
+constexpr float kFrameTimeTolerance = 0.1f;
+// Frames before the scale changes again. The GPU times arrive some frames
+// late (see kDefaultGpuQueryLatency), so the first times after a change still
+// measure the previous scale, and they are skipped.
+constexpr int kMinFramesAtScale = 8;
+constexpr int kNumSkippedFramesAtScale = 4;
+// Changes smaller than this are not worth a new scale.
+constexpr float kMinScaleChange = 1.0f / 64.0f;
+// The scale may drop at once to meet the target, but only grows by this much
+// per change, which keeps it from overshooting.
+constexpr float kMaxScaleIncrease = 0.05f;
+
+}  // namespace
+
+DynamicResolution::DynamicResolution()
+    : output_width_(0), output_height_(0), target_frame_ms_(0.0f),
+      min_scale_(kDefaultMinResolutionScale),
+      max_scale_(kDefaultMaxResolutionScale), scale_(1.0f), render_width_(0),
+      render_height_(0), smoothed_frame_ms_(-1.0f), num_frames_at_scale_(0),
+      num_scale_changes_(0) {}
+
+bool DynamicResolution::Initialize(const int output_width,
+                                   const int output_height,
+                                   const float target_frame_ms,
+                                   const float min_scale,
+                                   const float max_scale,
+                                   std::string* error_info_log) {
+  if (target_frame_ms <= 0.0f) {
+    *error_info_log = "The target frame time must be positive.";
+    return false;
+  }
+  if (min_scale <= 0.0f || min_scale > max_scale || max_scale > 1.0f) {
+    *error_info_log = "Invalid resolution scales " +
+        std::to_string(min_scale) + " to " + std::to_string(max_scale) + ".";
+    return false;
+  }
+  target_frame_ms_ = target_frame_ms;
+  min_scale_ = min_scale;
+  max_scale_ = max_scale;
+  num_scale_changes_ = 0;
+  scale_ = max_scale;
+  return Resize(output_width, output_height, error_info_log);
+}
+
+bool DynamicResolution::Resize(const int output_width,
+                               const int output_height,
+                               std::string* error_info_log) {
+  const int width = std::max(1, static_cast<int>(
+      std::ceil(max_scale_ * output_width)));
+  const int height = std::max(1, static_cast<int>(
+      std::ceil(max_scale_ * output_height)));
+  if (!framebuffer_.Initialize(width, height, error_info_log)) return false;
+  output_width_ = output_width;
+  output_height_ = output_height;
+  SetScale(scale_);
+  return true;
+}
+
+void DynamicResolution::Update(const float gpu_frame_ms) {
+  if (gpu_frame_ms < 0.0f || !framebuffer_.framebuffer_id()) return;
+  if (++num_frames_at_scale_ <= kNumSkippedFramesAtScale) return;
+  smoothed_frame_ms_ = smoothed_frame_ms_ < 0.0f ? gpu_frame_ms :
+      smoothed_frame_ms_ +
+      kFrameTimeSmoothing * (gpu_frame_ms - smoothed_frame_ms_);
+  if (num_frames_at_scale_ < kMinFramesAtScale || smoothed_frame_ms_ <= 0.0f) {
+    return;
+  }
+  const float ratio = target_frame_ms_ / smoothed_frame_ms_;
+  if (std::abs(ratio - 1.0f) <= kFrameTimeTolerance) return;
+  // The time is about proportional to the pixels, i.e., the squared scale.
+  float scale = scale_ * std::sqrt(ratio);
+  scale = std::min(scale, scale_ + kMaxScaleIncrease);
+  scale = std::min(std::max(scale, min_scale_), max_scale_);
+  if (std::abs(scale - scale_) < kMinScaleChange &&
+      scale != min_scale_ && scale != max_scale_) {
+    return;
+  }
+  if (scale == scale_) return;
+  SetScale(scale);
+  ++num_scale_changes_;
+}
+
+bool DynamicResolution::SetMinScale(const float min_scale) {
+  if (!(min_scale > 0.0f && min_scale <= max_scale_)) return false;
+  min_scale_ = min_scale;
+  if (scale_ < min_scale_) {
+    SetScale(min_scale_);
+    ++num_scale_changes_;
+  }
+  return true;
+}
+
+void DynamicResolution::Bind() const {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_.framebuffer_id());
+  glViewport(0, 0, render_width_, render_height_);
+}
+
+void DynamicResolution::Resolve(const GLuint framebuffer_id) const {
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_.framebuffer_id());
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_id);
+  glBlitFramebuffer(0, 0, render_width_, render_height_,
+                    0, 0, output_width_, output_height_,
+                    GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+  glViewport(0, 0, output_width_, output_height_);
+}
+
+void DynamicResolution::SetScale(const float scale) {
+  scale_ = scale;
+  render_width_ = std::min(framebuffer_.width(), std::max(1, static_cast<int>(
+      std::lround(scale * output_width_))));
+  render_height_ = std::min(framebuffer_.height(), std::max(1,
+      static_cast<int>(std::lround(scale * output_height_))));
+  smoothed_frame_ms_ = -1.0f;
+  num_frames_at_scale_ = 0;
+}
+
+}  // namespace wvu
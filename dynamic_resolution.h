@@ -0,0 +1,165 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_DYNAMIC_RESOLUTION_H_
+#define GLUTILS_DYNAMIC_RESOLUTION_H_
+
+#include <string>
+#include <GL/glew.h>
+
+#include "offscreen_framebuffer.h"
+
+namespace wvu {
+// Default bounds of the resolution scale, the ratio between the rendered and
+// the output sizes along each axis.
+constexpr float kDefaultMinResolutionScale = 0.5f;
+constexpr float kDefaultMaxResolutionScale = 1.0f;
+
+// This class renders the frames at a fraction of the output resolution, and
+// adjusts the fraction to hold a target GPU frame time: the fragment work, and
+// hence most of the time of heavy frames, is proportional to the number of
+// pixels, so the scale of each axis follows the square root of the ratio
+// between the target and the measured times. The times are smoothed, the
+// scale only changes when they leave a band around the target, and it grows
+// in small steps, so that it does not oscillate.
+//
+// The framebuffer is allocated at the largest scale, and the frames are
+// rendered into its lower-left corner, so changing the scale does not
+// reallocate anything. Resolve() stretches the rendered pixels to the output
+// with a bilinear blit.
+//
+// Example:
+//
+// wvu::DynamicResolution dynamic_resolution;
+// if (!dynamic_resolution.Initialize(width, height, 16.0f,
+//                                    wvu::kDefaultMinResolutionScale,
+//                                    wvu::kDefaultMaxResolutionScale,
+//                                    &error_info_log)) { ... }
+// while (...) {  // Rendering loop.
+//   dynamic_resolution.Update(profiler.LatestSample(gpu_frame_scope));
+//   dynamic_resolution.Bind();
+//   ...  // Draws.
+//   dynamic_resolution.Resolve(0);  // Into the window.
+// }
+class DynamicResolution {
+ public:
+  DynamicResolution();
+  ~DynamicResolution() {}
+
+  // Creates the framebuffer. The context must be current. Returns true if
+  // successful.
+  // Parameters:
+  //   output_width  The width of the output in pixels.
+  //   output_height  The height of the output in pixels.
+  //   target_frame_ms  The GPU time per frame to hold, in milliseconds.
+  //   min_scale  The smallest scale, in (0, max_scale].
+  //   max_scale  The largest scale, and the initial one, in (0, 1].
+  //   error_info_log  The reason of the failure.
+  bool Initialize(const int output_width,
+                  const int output_height,
+                  const float target_frame_ms,
+                  const float min_scale,
+                  const float max_scale,
+                  std::string* error_info_log);
+
+  // Reallocates the framebuffer for a new output size, keeping the scale.
+  // Returns true if successful.
+  bool Resize(const int output_width,
+              const int output_height,
+              std::string* error_info_log);
+
+  // Adjusts the scale to the GPU time of a recent frame. Negative times, i.e.,
+  // missing samples, are ignored.
+  void Update(const float gpu_frame_ms);
+
+  // Changes the smallest scale, e.g., from a live knob, raising the current
+  // scale to it if needed. Returns false if min_scale is not in
+  // (0, max_scale].
+  bool SetMinScale(const float min_scale);
+
+  // Binds the framebuffer, and sets the viewport to the rendered size.
+  void Bind() const;
+
+  // Stretches the rendered pixels over the output, in the framebuffer
+  // framebuffer_id, and leaves it bound with the viewport of the output.
+  void Resolve(const GLuint framebuffer_id) const;
+
+  // Deletes the framebuffer.
+  void Reset() {
+    framebuffer_.Reset();
+  }
+
+  float scale() const {
+    return scale_;
+  }
+
+  int render_width() const {
+    return render_width_;
+  }
+
+  int render_height() const {
+    return render_height_;
+  }
+
+  // Returns the number of changes of the scale.
+  int num_scale_changes() const {
+    return num_scale_changes_;
+  }
+
+ private:
+  // Sets the scale and the rendered size.
+  void SetScale(const float scale);
+
+  OffscreenFramebuffer framebuffer_;
+  int output_width_;
+  int output_height_;
+  float target_frame_ms_;
+  float min_scale_;
+  float max_scale_;
+  float scale_;
+  int render_width_;
+  int render_height_;
+  // Moving average of the GPU times at the current scale, or negative if
+  // there is none.
+  float smoothed_frame_ms_;
+  int num_frames_at_scale_;
+  int num_scale_changes_;
+
+  DynamicResolution(const DynamicResolution&) = delete;
+  DynamicResolution& operator=(const DynamicResolution&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_DYNAMIC_RESOLUTION_H_
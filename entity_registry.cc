@@ -0,0 +1,493 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "entity_registry.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "assignment.h"
+#include "gpu_mesh.h"
+#include "model.h"
+#include "render_queue.h"
+#include "shader_program.h"
+#include "transforms.h"
+
+namespace wvu {
+namespace {
+// Returns the matrix of a transform, as Model::model_matrix() does.
+Eigen::Matrix4f ComputeModelMatrix(const Eigen::Vector3f& orientation,
+                                   const Eigen::Vector3f& position) {
+  Eigen::Matrix4f model_matrix = Eigen::Matrix4f::Identity();
+  // The norm of the Rodrigues vector is the angle of the rotation.
+  const float angle = orientation.norm();
+  if (angle > 0.0f) {
+    model_matrix.block<3, 3>(0, 0) =
+        Eigen::AngleAxisf(angle, orientation / angle).toRotationMatrix();
+  }
+  model_matrix.block<3, 1>(0, 3) = position;
+  return model_matrix;
+}
+
+// Copies the element of a column, if the column has elements.
+template <typename Column>
+void CopyElement(const Column& source,
+                 const int source_row,
+                 const int row,
+                 Column* column) {
+  if (!source.empty() && !column->empty()) {
+    (*column)[row] = source[source_row];
+  }
+}
+
+void CopyElement(const Vector3fArray& source,
+                 const int source_row,
+                 const int row,
+                 Vector3fArray* column) {
+  if (source.size() == 0 || column->size() == 0) return;
+  column->x[row] = source.x[source_row];
+  column->y[row] = source.y[source_row];
+  column->z[row] = source.z[source_row];
+}
+
+void CopyElement(const Vector4fArray& source,
+                 const int source_row,
+                 const int row,
+                 Vector4fArray* column) {
+  if (source.size() == 0 || column->size() == 0) return;
+  column->x[row] = source.x[source_row];
+  column->y[row] = source.y[source_row];
+  column->z[row] = source.z[source_row];
+  column->w[row] = source.w[source_row];
+}
+
+// Moves the last element of a column into row and removes the last element.
+template <typename Column>
+void RemoveElement(const int row, Column* column) {
+  if (column->empty()) return;
+  (*column)[row] = column->back();
+  column->pop_back();
+}
+
+void RemoveElement(const int row, Vector3fArray* column) {
+  if (column->size() == 0) return;
+  RemoveElement(row, &column->x);
+  RemoveElement(row, &column->y);
+  RemoveElement(row, &column->z);
+}
+
+void RemoveElement(const int row, Vector4fArray* column) {
+  if (column->size() == 0) return;
+  RemoveElement(row, &column->x);
+  RemoveElement(row, &column->y);
+  RemoveElement(row, &column->z);
+  RemoveElement(row, &column->w);
+}
+
+// Sets a row of the quaternions to the rotation of a Rodrigues vector.
+void SetRotation(const Eigen::Vector3f& orientation,
+                 const int row,
+                 Vector4fArray* rotations) {
+  const float angle = orientation.norm();
+  const Eigen::Quaternionf rotation =
+      angle > 0.0f ?
+      Eigen::Quaternionf(Eigen::AngleAxisf(angle, orientation / angle)) :
+      Eigen::Quaternionf::Identity();
+  rotations->x[row] = rotation.x();
+  rotations->y[row] = rotation.y();
+  rotations->z[row] = rotation.z();
+  rotations->w[row] = rotation.w();
+}
+
+// Returns the box of a row of the world centers and half extents.
+Eigen::AlignedBox3f WorldBox(const Vector3fArray& centers,
+                             const Vector3fArray& half_extents,
+                             const int row) {
+  const Eigen::Vector3f center(centers.x[row], centers.y[row], centers.z[row]);
+  const Eigen::Vector3f half_extent(half_extents.x[row], half_extents.y[row],
+                                    half_extents.z[row]);
+  return Eigen::AlignedBox3f(center - half_extent, center + half_extent);
+}
+
+}  // namespace
+
+int EntityArchetype::AppendRow(const Entity entity) {
+  const int row = entities_.size();
+  entities_.push_back(entity);
+  if (Has(TRANSFORM_COMPONENT)) {
+    orientations_.push_back(Eigen::Vector3f::Zero());
+    positions_.push_back(Eigen::Vector3f::Zero());
+    model_matrices_.push_back(Eigen::Matrix4f::Identity());
+    dirty_.push_back(0);
+  }
+  if (Has(BOUNDS_COMPONENT)) {
+    local_bounds_.emplace_back();
+    world_centers_.resize(row + 1);
+    world_half_extents_.resize(row + 1);
+    world_centers_.x[row] = world_centers_.y[row] = world_centers_.z[row] =
+        0.0f;
+    world_half_extents_.x[row] = world_half_extents_.y[row] =
+        world_half_extents_.z[row] = -1.0f;
+  }
+  if (Has(MESH_COMPONENT)) meshes_.emplace_back();
+  if (Has(MATERIAL_COMPONENT)) materials_.emplace_back();
+  if (Has(ANIMATION_COMPONENT)) animations_.emplace_back();
+  if (Has(RIGID_BODY_COMPONENT)) {
+    linear_velocities_.resize(row + 1);
+    angular_velocities_.resize(row + 1);
+    rotations_.resize(row + 1);
+    linear_velocities_.x[row] = linear_velocities_.y[row] =
+        linear_velocities_.z[row] = 0.0f;
+    angular_velocities_.x[row] = angular_velocities_.y[row] =
+        angular_velocities_.z[row] = 0.0f;
+    rotations_.x[row] = rotations_.y[row] = rotations_.z[row] = 0.0f;
+    rotations_.w[row] = 1.0f;
+  }
+  return row;
+}
+
+Entity EntityArchetype::RemoveRow(const int row) {
+  const bool last = row + 1 == num_entities();
+  RemoveElement(row, &entities_);
+  RemoveElement(row, &orientations_);
+  RemoveElement(row, &positions_);
+  RemoveElement(row, &model_matrices_);
+  RemoveElement(row, &dirty_);
+  RemoveElement(row, &local_bounds_);
+  RemoveElement(row, &world_centers_);
+  RemoveElement(row, &world_half_extents_);
+  RemoveElement(row, &meshes_);
+  RemoveElement(row, &materials_);
+  RemoveElement(row, &animations_);
+  RemoveElement(row, &linear_velocities_);
+  RemoveElement(row, &angular_velocities_);
+  RemoveElement(row, &rotations_);
+  return last ? kInvalidEntity : entities_[row];
+}
+
+void EntityArchetype::CopyRow(const EntityArchetype& source,
+                              const int source_row,
+                              const int row) {
+  CopyElement(source.orientations_, source_row, row, &orientations_);
+  CopyElement(source.positions_, source_row, row, &positions_);
+  CopyElement(source.model_matrices_, source_row, row, &model_matrices_);
+  CopyElement(source.local_bounds_, source_row, row, &local_bounds_);
+  CopyElement(source.world_centers_, source_row, row, &world_centers_);
+  CopyElement(source.world_half_extents_, source_row, row,
+              &world_half_extents_);
+  CopyElement(source.meshes_, source_row, row, &meshes_);
+  CopyElement(source.materials_, source_row, row, &materials_);
+  CopyElement(source.animations_, source_row, row, &animations_);
+  CopyElement(source.linear_velocities_, source_row, row,
+              &linear_velocities_);
+  CopyElement(source.angular_velocities_, source_row, row,
+              &angular_velocities_);
+  CopyElement(source.rotations_, source_row, row, &rotations_);
+  // The quaternion of a new rigid body is the orientation it keeps.
+  if (Has(RIGID_BODY_COMPONENT | TRANSFORM_COMPONENT) &&
+      !source.Has(RIGID_BODY_COMPONENT) && source.Has(TRANSFORM_COMPONENT)) {
+    SetRotation(orientations_[row], row, &rotations_);
+  }
+  // The world boxes of bounds added to a transform are computed again.
+  if (Has(TRANSFORM_COMPONENT) &&
+      (!source.Has(TRANSFORM_COMPONENT) || source.dirty_[source_row] ||
+       (Has(BOUNDS_COMPONENT) && !source.Has(BOUNDS_COMPONENT)))) {
+    MarkTransformDirty(row);
+  }
+}
+
+void EntityArchetype::UpdateTransforms() {
+  if (!transforms_dirty_) return;
+  transforms_dirty_ = false;
+  const bool has_bounds = Has(BOUNDS_COMPONENT);
+  for (int row = 0; row < num_entities(); ++row) {
+    if (!dirty_[row]) continue;
+    dirty_[row] = 0;
+    const Eigen::Matrix4f model_matrix =
+        ComputeModelMatrix(orientations_[row], positions_[row]);
+    model_matrices_[row] = model_matrix;
+    if (!has_bounds || local_bounds_[row].isEmpty()) continue;
+    // The box of the transformed box is centered at the transformed center,
+    // and its half extents are those of the box rotated by the absolute
+    // values of the rotation.
+    const Eigen::AlignedBox3f& bounds = local_bounds_[row];
+    const Eigen::Vector3f center =
+        (model_matrix * bounds.center().homogeneous()).head<3>();
+    const Eigen::Vector3f half_extent =
+        model_matrix.topLeftCorner<3, 3>().cwiseAbs() *
+        (0.5f * bounds.sizes());
+    world_centers_.x[row] = center.x();
+    world_centers_.y[row] = center.y();
+    world_centers_.z[row] = center.z();
+    world_half_extents_.x[row] = half_extent.x();
+    world_half_extents_.y[row] = half_extent.y();
+    world_half_extents_.z[row] = half_extent.z();
+  }
+}
+
+Entity EntityRegistry::CreateEntity(const ComponentMask components) {
+  uint32_t index;
+  if (!free_slots_.empty()) {
+    index = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    // The last index of the last generation would be kInvalidEntity.
+    if (slots_.size() + 1 >= (1u << kEntityIndexBits)) return kInvalidEntity;
+    index = slots_.size();
+    slots_.emplace_back();
+  }
+  Slot& slot = slots_[index];
+  const Entity entity = (slot.generation << kEntityIndexBits) | index;
+  slot.archetype = FindArchetype(components);
+  slot.row = archetypes_[slot.archetype].AppendRow(entity);
+  ++num_entities_;
+  return entity;
+}
+
+Entity EntityRegistry::CreateEntity(const Model& model,
+                                    const GpuMesh* mesh,
+                                    ShaderProgram* shader_program,
+                                    const GLuint texture_id) {
+  const bool has_bounds = !model.vertex_data().empty();
+  const Entity entity = CreateEntity(has_bounds ?
+                                     kModelComponents : kRenderableComponents);
+  if (entity == kInvalidEntity) return entity;
+  SetTransform(entity, model.orientation(), model.position());
+  if (has_bounds) {
+    Eigen::AlignedBox3f bounds;
+    for (int i = 0; i < model.num_vertices(); ++i) {
+      bounds.extend(model.VertexPosition(i));
+    }
+    SetLocalBounds(entity, bounds);
+  }
+  MeshComponent mesh_component;
+  mesh_component.mesh = mesh;
+  mesh_component.num_indices = model.num_indices();
+  SetMesh(entity, mesh_component);
+  MaterialComponent material;
+  material.shader_program = shader_program;
+  material.texture_id = texture_id;
+  SetMaterial(entity, material);
+  return entity;
+}
+
+void EntityRegistry::DestroyEntity(const Entity entity) {
+  if (!IsAlive(entity)) return;
+  const uint32_t index = Index(entity);
+  Slot& slot = slots_[index];
+  const Entity moved_entity = archetypes_[slot.archetype].RemoveRow(slot.row);
+  if (moved_entity != kInvalidEntity) {
+    slots_[Index(moved_entity)].row = slot.row;
+  }
+  slot.archetype = -1;
+  slot.row = -1;
+  // The generation wraps around within its bits.
+  slot.generation =
+      (slot.generation + 1) & ((1u << (32 - kEntityIndexBits)) - 1);
+  free_slots_.push_back(index);
+  --num_entities_;
+}
+
+bool EntityRegistry::IsAlive(const Entity entity) const {
+  const uint32_t index = Index(entity);
+  return entity != kInvalidEntity && index < slots_.size() &&
+      slots_[index].archetype >= 0 &&
+      slots_[index].generation == entity >> kEntityIndexBits;
+}
+
+bool EntityRegistry::SetComponents(const Entity entity,
+                                   const ComponentMask components) {
+  if (!IsAlive(entity)) return false;
+  Slot& slot = slots_[Index(entity)];
+  if (archetypes_[slot.archetype].components() == components) return true;
+  // Creating the archetype may reallocate the archetypes.
+  const int archetype = FindArchetype(components);
+  EntityArchetype& source = archetypes_[slot.archetype];
+  EntityArchetype& destination = archetypes_[archetype];
+  const int row = destination.AppendRow(entity);
+  destination.CopyRow(source, slot.row, row);
+  const Entity moved_entity = source.RemoveRow(slot.row);
+  if (moved_entity != kInvalidEntity) {
+    slots_[Index(moved_entity)].row = slot.row;
+  }
+  slot.archetype = archetype;
+  slot.row = row;
+  return true;
+}
+
+bool EntityRegistry::SetTransform(const Entity entity,
+                                  const Eigen::Vector3f& orientation,
+                                  const Eigen::Vector3f& position) {
+  EntityArchetype* archetype;
+  int row;
+  if (!Locate(entity, TRANSFORM_COMPONENT, &archetype, &row)) return false;
+  archetype->orientations_[row] = orientation;
+  archetype->positions_[row] = position;
+  archetype->MarkTransformDirty(row);
+  if (archetype->Has(RIGID_BODY_COMPONENT)) {
+    SetRotation(orientation, row, &archetype->rotations_);
+  }
+  return true;
+}
+
+bool EntityRegistry::SetLocalBounds(const Entity entity,
+                                    const Eigen::AlignedBox3f& bounds) {
+  EntityArchetype* archetype;
+  int row;
+  if (!Locate(entity, BOUNDS_COMPONENT, &archetype, &row)) return false;
+  archetype->local_bounds_[row] = bounds;
+  if (archetype->Has(TRANSFORM_COMPONENT)) archetype->MarkTransformDirty(row);
+  return true;
+}
+
+bool EntityRegistry::SetMesh(const Entity entity, const MeshComponent& mesh) {
+  EntityArchetype* archetype;
+  int row;
+  if (!Locate(entity, MESH_COMPONENT, &archetype, &row)) return false;
+  archetype->meshes_[row] = mesh;
+  return true;
+}
+
+bool EntityRegistry::SetMaterial(const Entity entity,
+                                 const MaterialComponent& material) {
+  EntityArchetype* archetype;
+  int row;
+  if (!Locate(entity, MATERIAL_COMPONENT, &archetype, &row)) return false;
+  archetype->materials_[row] = material;
+  return true;
+}
+
+bool EntityRegistry::SetAnimation(const Entity entity,
+                                  const AnimationComponent& animation) {
+  EntityArchetype* archetype;
+  int row;
+  if (!Locate(entity, ANIMATION_COMPONENT, &archetype, &row)) return false;
+  archetype->animations_[row] = animation;
+  return true;
+}
+
+bool EntityRegistry::SetVelocities(const Entity entity,
+                                   const Eigen::Vector3f& linear_velocity,
+                                   const Eigen::Vector3f& angular_velocity) {
+  EntityArchetype* archetype;
+  int row;
+  if (!Locate(entity, RIGID_BODY_COMPONENT, &archetype, &row)) return false;
+  archetype->linear_velocities_.x[row] = linear_velocity.x();
+  archetype->linear_velocities_.y[row] = linear_velocity.y();
+  archetype->linear_velocities_.z[row] = linear_velocity.z();
+  archetype->angular_velocities_.x[row] = angular_velocity.x();
+  archetype->angular_velocities_.y[row] = angular_velocity.y();
+  archetype->angular_velocities_.z[row] = angular_velocity.z();
+  return true;
+}
+
+Eigen::AlignedBox3f EntityRegistry::world_bounds(const Entity entity) const {
+  const Slot& slot = slots_[Index(entity)];
+  const EntityArchetype& archetype = archetypes_[slot.archetype];
+  return WorldBox(archetype.world_centers_, archetype.world_half_extents_,
+                  slot.row);
+}
+
+void EntityRegistry::UpdateTransforms() {
+  for (EntityArchetype& archetype : archetypes_) {
+    if (archetype.Has(TRANSFORM_COMPONENT)) archetype.UpdateTransforms();
+  }
+}
+
+void EntityRegistry::AddVisible(const FrustumPlanes& planes,
+                                const Eigen::Vector3f& viewpoint,
+                                const float far_distance,
+                                RenderQueue* render_queue) {
+  num_visible_entities_ = 0;
+  RenderItem item;
+  for (const EntityArchetype& archetype : archetypes_) {
+    if (!archetype.Has(kRenderableComponents) ||
+        archetype.num_entities() == 0) {
+      continue;
+    }
+    const bool has_bounds = archetype.Has(BOUNDS_COMPONENT);
+    if (has_bounds) {
+      CullBoxes(planes, archetype.world_centers_,
+                archetype.world_half_extents_, &visibility_);
+    }
+    for (int row = 0; row < archetype.num_entities(); ++row) {
+      if (has_bounds && (visibility_[row / 32] & (1u << (row % 32))) == 0) {
+        continue;
+      }
+      const MeshComponent& mesh = archetype.meshes_[row];
+      const MaterialComponent& material = archetype.materials_[row];
+      item.shader_program = material.shader_program;
+      item.texture_id = material.texture_id;
+      item.mesh = mesh.mesh;
+      item.first_index = mesh.first_index;
+      item.num_indices = mesh.num_indices;
+      item.model = archetype.model_matrices_[row];
+      item.depth = 0.0f;
+      if (has_bounds) {
+        item.depth = std::min(
+            WorldBox(archetype.world_centers_, archetype.world_half_extents_,
+                     row).exteriorDistance(viewpoint) / far_distance, 1.0f);
+      }
+      render_queue->Add(item);
+      ++num_visible_entities_;
+    }
+  }
+}
+
+int EntityRegistry::FindArchetype(const ComponentMask components) {
+  const auto it = archetype_indices_.find(components);
+  if (it != archetype_indices_.end()) return it->second;
+  archetypes_.emplace_back(components);
+  archetype_indices_[components] = archetypes_.size() - 1;
+  return archetypes_.size() - 1;
+}
+
+bool EntityRegistry::Locate(const Entity entity,
+                            const ComponentMask components,
+                            EntityArchetype** archetype,
+                            int* row) {
+  if (!IsAlive(entity)) return false;
+  const Slot& slot = slots_[Index(entity)];
+  if (!archetypes_[slot.archetype].Has(components)) return false;
+  *archetype = &archetypes_[slot.archetype];
+  *row = slot.row;
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,449 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_ENTITY_REGISTRY_H_
+#define GLUTILS_ENTITY_REGISTRY_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include "assignment.h"
+#include "gpu_mesh.h"
+#include "model.h"
+#include "render_queue.h"
+#include "shader_program.h"
+#include "transforms.h"
+
+namespace wvu {
+// The components of an entity, as the bits of a ComponentMask.
+enum EntityComponent {
+  // The orientation, as a Rodrigues vector, the position and the model matrix.
+  TRANSFORM_COMPONENT = 1 << 0,
+  // The bounds of the mesh, in model space, and their box in world space.
+  BOUNDS_COMPONENT = 1 << 1,
+  // The range of the indices of a mesh drawn.
+  MESH_COMPONENT = 1 << 2,
+  // The program and the texture drawing the mesh.
+  MATERIAL_COMPONENT = 1 << 3,
+  // The track of an AnimationClip writing the transform.
+  ANIMATION_COMPONENT = 1 << 4,
+  // The velocities and the orientation quaternion of a body integrated by
+  // IntegrateRigidBodies() into the transform.
+  RIGID_BODY_COMPONENT = 1 << 5,
+};
+
+typedef uint32_t ComponentMask;
+
+// The components of the entities drawn by EntityRegistry::AddVisible(), and
+// of the entities mapping a Model.
+constexpr ComponentMask kRenderableComponents =
+    TRANSFORM_COMPONENT | MESH_COMPONENT | MATERIAL_COMPONENT;
+constexpr ComponentMask kModelComponents =
+    kRenderableComponents | BOUNDS_COMPONENT;
+
+// An entity id: an index in the low kEntityIndexBits bits, and a generation
+// in the others, so that the ids of destroyed entities are not alive anymore
+// when their index is reused.
+typedef uint32_t Entity;
+constexpr int kEntityIndexBits = 24;
+constexpr Entity kInvalidEntity = 0xFFFFFFFF;
+
+struct MeshComponent {
+  // The mesh. Not owned.
+  const GpuMesh* mesh = nullptr;
+  int first_index = 0;
+  int num_indices = 0;
+};
+
+struct MaterialComponent {
+  // The program drawing the mesh. Not owned.
+  ShaderProgram* shader_program = nullptr;
+  // The texture bound to texture unit 0, or 0 for none.
+  GLuint texture_id = 0;
+};
+
+struct AnimationComponent {
+  // The track of the clip, or -1 for none.
+  int track = -1;
+  // The time of the track is time_offset + speed * the time of the clip.
+  float time_offset = 0.0f;
+  float speed = 1.0f;
+};
+
+// The entities that have the same components, stored as one column per
+// component member, in the same order as entities(). Systems iterate over the
+// columns of the archetypes with the components they need, so they only read
+// the memory of those components. The columns of the components the
+// archetype does not have are empty.
+class EntityArchetype {
+ public:
+  typedef std::vector<Eigen::Matrix4f,
+                      Eigen::aligned_allocator<Eigen::Matrix4f> >
+      Matrix4fColumn;
+
+  explicit EntityArchetype(const ComponentMask components)
+      : components_(components), transforms_dirty_(false) {}
+  ~EntityArchetype() {}
+
+  ComponentMask components() const {
+    return components_;
+  }
+
+  // Returns true if the archetype has all the components of the mask.
+  bool Has(const ComponentMask components) const {
+    return (components_ & components) == components;
+  }
+
+  int num_entities() const {
+    return entities_.size();
+  }
+
+  const std::vector<Entity>& entities() const {
+    return entities_;
+  }
+
+  // The columns of the transforms. Writing the orientations or the positions
+  // through the mutable columns marks them all dirty.
+  const std::vector<Eigen::Vector3f>& orientations() const {
+    return orientations_;
+  }
+
+  const std::vector<Eigen::Vector3f>& positions() const {
+    return positions_;
+  }
+
+  std::vector<Eigen::Vector3f>* mutable_orientations() {
+    MarkAllTransformsDirty();
+    return &orientations_;
+  }
+
+  std::vector<Eigen::Vector3f>* mutable_positions() {
+    MarkAllTransformsDirty();
+    return &positions_;
+  }
+
+  // Returns the model matrices as of the last
+  // EntityRegistry::UpdateTransforms().
+  const Matrix4fColumn& model_matrices() const {
+    return model_matrices_;
+  }
+
+  // The columns of the bounds. The world boxes are given by their centers and
+  // half extents, as CullBoxes() takes them.
+  const std::vector<Eigen::AlignedBox3f>& local_bounds() const {
+    return local_bounds_;
+  }
+
+  const Vector3fArray& world_centers() const {
+    return world_centers_;
+  }
+
+  const Vector3fArray& world_half_extents() const {
+    return world_half_extents_;
+  }
+
+  const std::vector<MeshComponent>& meshes() const {
+    return meshes_;
+  }
+
+  const std::vector<MaterialComponent>& materials() const {
+    return materials_;
+  }
+
+  const std::vector<AnimationComponent>& animations() const {
+    return animations_;
+  }
+
+  // The columns of the rigid bodies: their linear and angular velocities, in
+  // world space, and their orientations as unit quaternions. The quaternions
+  // are the orientations integrated, from which IntegrateRigidBodies() writes
+  // the Rodrigues vectors of the transforms, so the orientations of rigid
+  // bodies are set with EntityRegistry::SetTransform(), which sets both.
+  const Vector3fArray& linear_velocities() const {
+    return linear_velocities_;
+  }
+
+  const Vector3fArray& angular_velocities() const {
+    return angular_velocities_;
+  }
+
+  const Vector4fArray& rotations() const {
+    return rotations_;
+  }
+
+  Vector3fArray* mutable_linear_velocities() {
+    return &linear_velocities_;
+  }
+
+  Vector3fArray* mutable_angular_velocities() {
+    return &angular_velocities_;
+  }
+
+  Vector4fArray* mutable_rotations() {
+    return &rotations_;
+  }
+
+ private:
+  friend class EntityRegistry;
+  friend class SceneSnapshot;
+
+  // Appends a row with the default components. Returns its index.
+  int AppendRow(const Entity entity);
+
+  // Removes a row, moving the last row into it. Returns the entity moved, or
+  // kInvalidEntity if the row was the last.
+  Entity RemoveRow(const int row);
+
+  // Copies the components of a row of another archetype that both have.
+  void CopyRow(const EntityArchetype& source,
+               const int source_row,
+               const int row);
+
+  void MarkTransformDirty(const int row) {
+    transforms_dirty_ = true;
+    dirty_[row] = 1;
+  }
+
+  void MarkAllTransformsDirty() {
+    transforms_dirty_ = true;
+    std::fill(dirty_.begin(), dirty_.end(), 1);
+  }
+
+  // Recomputes the dirty model matrices, and their world bounds.
+  void UpdateTransforms();
+
+  ComponentMask components_;
+  std::vector<Entity> entities_;
+  std::vector<Eigen::Vector3f> orientations_;
+  std::vector<Eigen::Vector3f> positions_;
+  Matrix4fColumn model_matrices_;
+  // The rows whose model matrix is out of date, and whether any is.
+  std::vector<uint8_t> dirty_;
+  bool transforms_dirty_;
+  std::vector<Eigen::AlignedBox3f> local_bounds_;
+  Vector3fArray world_centers_;
+  Vector3fArray world_half_extents_;
+  std::vector<MeshComponent> meshes_;
+  std::vector<MaterialComponent> materials_;
+  std::vector<AnimationComponent> animations_;
+  Vector3fArray linear_velocities_;
+  Vector3fArray angular_velocities_;
+  Vector4fArray rotations_;
+};
+
+// This class stores the entities of a scene by archetype, i.e., by the set of
+// components they have, with the components of each archetype in contiguous
+// columns (see EntityArchetype). Unlike an array of Models, where updating the
+// transforms strides over the vertices, the indices and the layouts of the
+// models, the systems stream through the columns they need: UpdateTransforms()
+// through the orientations, positions and bounds, and AddVisible() through the
+// world boxes, the meshes and the materials. Adding or removing components
+// moves an entity to the archetype of its new components, and destroying an
+// entity moves the last entity of its archetype into its row, so the columns
+// stay packed. The ids of the entities remain valid through the moves.
+//
+// A Model maps into the transform, bounds, mesh and material components of an
+// entity, so that its geometry lives on the GPU and its CPU data can be
+// released.
+//
+// Example:
+//
+// wvu::EntityRegistry registry;
+// const wvu::Entity entity =
+//     registry.CreateEntity(model, &mesh, &shader_program, texture_id);
+// model.ReleaseCpuData();
+// while (...) {  // Rendering loop.
+//   registry.SetTransform(entity, orientation, position);
+//   registry.UpdateTransforms();
+//   render_queue.Clear();
+//   registry.AddVisible(wvu::ExtractFrustumPlanes(camera.view_projection()),
+//                       camera.position(), camera.far(), &render_queue);
+//   render_queue.Execute();
+// }
+//
+// Custom systems visit the archetypes with the components they need:
+//
+// registry.ForEachArchetype(wvu::TRANSFORM_COMPONENT,
+//                           [&](wvu::EntityArchetype* archetype) {
+//   for (Eigen::Vector3f& position : *archetype->mutable_positions()) {
+//     position += velocity * time_step;
+//   }
+// });
+class EntityRegistry {
+ public:
+  EntityRegistry() : num_entities_(0), num_visible_entities_(0) {}
+  ~EntityRegistry() {}
+
+  // Creates an entity with the default components of the mask: the identity
+  // transform, empty bounds, no mesh and no material. Returns its id, or
+  // kInvalidEntity if there are too many entities.
+  Entity CreateEntity(const ComponentMask components);
+
+  // Creates an entity with the components of a model, drawn from a mesh
+  // uploaded from it. The bounds are those of the vertices of the model, so
+  // the entity has no bounds component if the model released its CPU data.
+  Entity CreateEntity(const Model& model,
+                      const GpuMesh* mesh,
+                      ShaderProgram* shader_program,
+                      const GLuint texture_id);
+
+  // Destroys an entity. Its id is not alive anymore.
+  void DestroyEntity(const Entity entity);
+
+  // Returns true if the entity was created and not destroyed.
+  bool IsAlive(const Entity entity) const;
+
+  // Replaces the components of an entity, moving it to the archetype of the
+  // new components. The components it keeps are kept, and the new ones have
+  // their default values. Returns false if the entity is not alive.
+  bool SetComponents(const Entity entity, const ComponentMask components);
+
+  // Returns the components of an alive entity.
+  ComponentMask components(const Entity entity) const {
+    return archetypes_[slots_[Index(entity)].archetype].components();
+  }
+
+  // Setters of the components of an alive entity. Return false if the entity
+  // does not have the component.
+  bool SetTransform(const Entity entity,
+                    const Eigen::Vector3f& orientation,
+                    const Eigen::Vector3f& position);
+  bool SetLocalBounds(const Entity entity, const Eigen::AlignedBox3f& bounds);
+  bool SetMesh(const Entity entity, const MeshComponent& mesh);
+  bool SetMaterial(const Entity entity, const MaterialComponent& material);
+  bool SetAnimation(const Entity entity, const AnimationComponent& animation);
+  bool SetVelocities(const Entity entity,
+                     const Eigen::Vector3f& linear_velocity,
+                     const Eigen::Vector3f& angular_velocity);
+
+  // Returns the model matrix of an alive entity with a transform, as of the
+  // last UpdateTransforms().
+  const Eigen::Matrix4f& model_matrix(const Entity entity) const {
+    const Slot& slot = slots_[Index(entity)];
+    return archetypes_[slot.archetype].model_matrices_[slot.row];
+  }
+
+  // Returns the world box of an alive entity with a transform and bounds, as
+  // of the last UpdateTransforms().
+  Eigen::AlignedBox3f world_bounds(const Entity entity) const;
+
+  // Recomputes the model matrices of the transforms changed since the last
+  // call, and the world boxes of their bounds.
+  void UpdateTransforms();
+
+  // Adds the render items of the entities with kRenderableComponents to a
+  // render queue. The entities with bounds are culled by their world boxes,
+  // and their depth is the distance of their box to the viewpoint divided by
+  // the far distance. The others are not culled, and have a zero depth.
+  void AddVisible(const FrustumPlanes& planes,
+                  const Eigen::Vector3f& viewpoint,
+                  const float far_distance,
+                  RenderQueue* render_queue);
+
+  // Calls system(archetype) for every archetype having all the components of
+  // the mask, with a pointer to the archetype.
+  template <typename System>
+  void ForEachArchetype(const ComponentMask components, const System& system) {
+    for (EntityArchetype& archetype : archetypes_) {
+      if (archetype.Has(components) && archetype.num_entities() > 0) {
+        system(&archetype);
+      }
+    }
+  }
+
+  int num_entities() const {
+    return num_entities_;
+  }
+
+  int num_archetypes() const {
+    return archetypes_.size();
+  }
+
+  const EntityArchetype& archetype(const int i) const {
+    return archetypes_[i];
+  }
+
+  // Returns the number of entities added by the last AddVisible().
+  int num_visible_entities() const {
+    return num_visible_entities_;
+  }
+
+ private:
+  friend class SceneSnapshot;
+
+  // The location of an entity in the archetypes.
+  struct Slot {
+    int archetype = -1;
+    int row = -1;
+    uint32_t generation = 0;
+  };
+
+  static uint32_t Index(const Entity entity) {
+    return entity & ((1u << kEntityIndexBits) - 1);
+  }
+
+  // Returns the index of the archetype of the components, creating it if
+  // needed.
+  int FindArchetype(const ComponentMask components);
+
+  // Returns the archetype and the row of an alive entity with the components,
+  // or false.
+  bool Locate(const Entity entity,
+              const ComponentMask components,
+              EntityArchetype** archetype,
+              int* row);
+
+  std::vector<EntityArchetype> archetypes_;
+  std::unordered_map<ComponentMask, int> archetype_indices_;
+  std::vector<Slot> slots_;
+  // The indices of the slots of the destroyed entities.
+  std::vector<uint32_t> free_slots_;
+  int num_entities_;
+  // Scratch storage of AddVisible().
+  std::vector<uint32_t> visibility_;
+  int num_visible_entities_;
+
+  EntityRegistry(const EntityRegistry&) = delete;
+  EntityRegistry& operator=(const EntityRegistry&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_ENTITY_REGISTRY_H_
@@ -0,0 +1,495 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "environment_lighting.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_allocator.h"
+#include "content_hash.h"
+#include "gl_state_cache.h"
+#include "shader_program.h"
+#include "texture_cache.h"
+#include "texture_source.h"
+
+namespace wvu {
+namespace {
+// Bumped when the prefiltering changes, so that the cached results of the
+// previous versions are not read.
+constexpr uint32_t kEnvironmentCacheVersion = 1;
+// Identifies the irradiance files of the cache.
+constexpr uint32_t kIrradianceMagic = 0x39485357;  // "WSH9".
+// Samples of the GGX lobe per texel of the specular map.
+constexpr int kSpecularSamples = 128;
+// The irradiance is integrated over the level of the environment at most this
+// wide.
+constexpr int kIrradianceMaxWidth = 128;
+// Side in pixels of the work groups of the specular shader.
+constexpr int kPrefilterGroupSize = 8;
+
+// The directions of the equirectangular maps, shared by the shaders.
+const char kEquirectangularSource[] =
+    "const float PI = 3.14159265;\n"
+    "vec3 Direction(vec2 uv) {\n"
+    "  float phi = uv.x * 2.0 * PI - PI;\n"
+    "  float theta = uv.y * PI;\n"
+    "  return vec3(sin(theta) * cos(phi), cos(theta),\n"
+    "              sin(theta) * sin(phi));\n"
+    "}\n"
+    "vec2 EquirectangularUv(vec3 direction) {\n"
+    "  return vec2(atan(direction.z, direction.x) / (2.0 * PI) + 0.5,\n"
+    "              acos(clamp(direction.y, -1.0, 1.0)) / PI);\n"
+    "}\n";
+
+// Writes a level of the specular map: the environment around the direction
+// of each texel, weighted by the GGX lobe of the roughness, with normal and
+// view along the direction. The samples of the lobe read the level of the
+// environment whose texels cover their solid angle, so that few samples
+// integrate it without noise.
+const char kSpecularShader[] =
+    "layout (local_size_x = 8, local_size_y = 8) in;\n"
+    "layout (binding = 0) uniform sampler2D environment;\n"
+    "layout (rgba16f, binding = 0) writeonly uniform image2D specular_image;\n"
+    "uniform float roughness;\n"
+    "// The level of the environment of the size of level 0 of the map.\n"
+    "uniform float base_level;\n"
+    "// The average solid angle of the texels of level 0 of the environment.\n"
+    "uniform float texel_solid_angle;\n"
+    "const uint NUM_SAMPLES = 128u;\n"
+    "void main() {\n"
+    "  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);\n"
+    "  ivec2 size = imageSize(specular_image);\n"
+    "  if (any(greaterThanEqual(pixel, size))) return;\n"
+    "  vec2 uv = (vec2(pixel) + 0.5) / vec2(size);\n"
+    "  if (roughness == 0.0) {\n"
+    "    imageStore(specular_image, pixel,\n"
+    "               vec4(textureLod(environment, uv, base_level).rgb, 1.0));\n"
+    "    return;\n"
+    "  }\n"
+    "  vec3 normal = Direction(uv);\n"
+    "  vec3 up = abs(normal.y) < 0.999 ? vec3(0.0, 1.0, 0.0) :\n"
+    "                                     vec3(1.0, 0.0, 0.0);\n"
+    "  vec3 tangent = normalize(cross(up, normal));\n"
+    "  vec3 bitangent = cross(normal, tangent);\n"
+    "  float a2 = roughness * roughness * roughness * roughness;\n"
+    "  vec3 sum = vec3(0.0);\n"
+    "  float weight_sum = 0.0;\n"
+    "  for (uint i = 0u; i < NUM_SAMPLES; ++i) {\n"
+    "    // The Hammersley point i.\n"
+    "    vec2 xi = vec2(float(i) / float(NUM_SAMPLES),\n"
+    "                   float(bitfieldReverse(i)) * 2.3283064365386963e-10);\n"
+    "    float phi = 2.0 * PI * xi.x;\n"
+    "    float cos_theta = sqrt((1.0 - xi.y) / (1.0 + (a2 - 1.0) * xi.y));\n"
+    "    float sin_theta = sqrt(1.0 - cos_theta * cos_theta);\n"
+    "    vec3 half_vector = sin_theta * cos(phi) * tangent +\n"
+    "                       sin_theta * sin(phi) * bitangent +\n"
+    "                       cos_theta * normal;\n"
+    "    vec3 light = 2.0 * dot(normal, half_vector) * half_vector - normal;\n"
+    "    float n_dot_l = dot(normal, light);\n"
+    "    if (n_dot_l <= 0.0) continue;\n"
+    "    // With the view along the normal, the density of the sample is\n"
+    "    // D / 4.\n"
+    "    float d = cos_theta * cos_theta * (a2 - 1.0) + 1.0;\n"
+    "    float distribution = a2 / (PI * d * d);\n"
+    "    float sample_solid_angle =\n"
+    "        4.0 / (float(NUM_SAMPLES) * distribution + 1e-4);\n"
+    "    float level = max(\n"
+    "        0.5 * log2(sample_solid_angle / texel_solid_angle) + 1.0, 0.0);\n"
+    "    sum += n_dot_l *\n"
+    "        textureLod(environment, EquirectangularUv(light), level).rgb;\n"
+    "    weight_sum += n_dot_l;\n"
+    "  }\n"
+    "  imageStore(specular_image, pixel,\n"
+    "             vec4(sum / max(weight_sum, 1e-4), 1.0));\n"
+    "}\n";
+
+// Projects a level of the environment on the 9 spherical harmonics of the
+// first 3 bands, weighting each texel by its solid angle, and convolves them
+// with the cosine lobe. Every invocation sums a strided subset of the texels,
+// and the first 9 invocations sum the partial sums of one coefficient.
+const char kIrradianceShader[] =
+    "layout (local_size_x = 128) in;\n"
+    "layout (binding = 0) uniform sampler2D environment;\n"
+    "layout (std430, binding = 0) writeonly buffer Irradiance {\n"
+    "  vec4 coefficients[9];\n"
+    "};\n"
+    "uniform int level;\n"
+    "shared vec3 partial_sums[128][9];\n"
+    "void main() {\n"
+    "  uint id = gl_LocalInvocationID.x;\n"
+    "  ivec2 size = textureSize(environment, level);\n"
+    "  vec3 sums[9];\n"
+    "  for (int k = 0; k < 9; ++k) sums[k] = vec3(0.0);\n"
+    "  for (int t = int(id); t < size.x * size.y; t += 128) {\n"
+    "    ivec2 texel = ivec2(t % size.x, t / size.x);\n"
+    "    vec2 uv = (vec2(texel) + 0.5) / vec2(size);\n"
+    "    vec3 d = Direction(uv);\n"
+    "    float solid_angle =\n"
+    "        (2.0 * PI / float(size.x)) * (PI / float(size.y)) *\n"
+    "        sin(uv.y * PI);\n"
+    "    vec3 radiance =\n"
+    "        solid_angle * texelFetch(environment, texel, level).rgb;\n"
+    "    sums[0] += 0.282095 * radiance;\n"
+    "    sums[1] += 0.488603 * d.y * radiance;\n"
+    "    sums[2] += 0.488603 * d.z * radiance;\n"
+    "    sums[3] += 0.488603 * d.x * radiance;\n"
+    "    sums[4] += 1.092548 * d.x * d.y * radiance;\n"
+    "    sums[5] += 1.092548 * d.y * d.z * radiance;\n"
+    "    sums[6] += 0.315392 * (3.0 * d.z * d.z - 1.0) * radiance;\n"
+    "    sums[7] += 1.092548 * d.x * d.z * radiance;\n"
+    "    sums[8] += 0.546274 * (d.x * d.x - d.y * d.y) * radiance;\n"
+    "  }\n"
+    "  for (int k = 0; k < 9; ++k) partial_sums[id][k] = sums[k];\n"
+    "  barrier();\n"
+    "  if (id >= 9u) return;\n"
+    "  vec3 total = vec3(0.0);\n"
+    "  for (int i = 0; i < 128; ++i) total += partial_sums[i][id];\n"
+    "  // The cosine lobe scales the bands by pi, 2 pi / 3 and pi / 4.\n"
+    "  float band = id == 0u ? PI : (id < 4u ? 2.0 * PI / 3.0 : 0.25 * PI);\n"
+    "  coefficients[id] = vec4(band * total, 0.0);\n"
+    "}\n";
+
+// Returns the number of work groups covering size pixels.
+GLuint NumGroups(const int size) {
+  return (size + kPrefilterGroupSize - 1) / kPrefilterGroupSize;
+}
+
+// Creates the specular map, without texels.
+GLuint CreateSpecularTexture() {
+  GLuint texture_id = 0;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  glTexStorage2D(GL_TEXTURE_2D, kEnvironmentSpecularLevels, GL_RGBA16F,
+                 kEnvironmentSpecularWidth, kEnvironmentSpecularWidth / 2);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  // The longitude wraps around.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  return texture_id;
+}
+
+// The size of a level, in texels, rounded down to 1.
+int LevelDimension(const int dimension, const int level) {
+  return std::max(dimension >> level, 1);
+}
+
+}  // namespace
+
+EnvironmentLighting::EnvironmentLighting() : specular_texture_id_(0) {}
+
+EnvironmentLighting::~EnvironmentLighting() {
+  Reset();
+}
+
+bool EnvironmentLighting::Supported() {
+  return GLEW_VERSION_4_3;
+}
+
+std::string EnvironmentLighting::GlslDeclaration() {
+  return std::string(
+      "uniform sampler2D environment_specular;\n"
+      "uniform float environment_max_level;\n"
+      "uniform vec3 environment_irradiance[9];\n") +
+      kEquirectangularSource +
+      "vec3 EnvironmentIrradiance(vec3 n) {\n"
+      "  return max(0.282095 * environment_irradiance[0] +\n"
+      "             0.488603 * (environment_irradiance[1] * n.y +\n"
+      "                         environment_irradiance[2] * n.z +\n"
+      "                         environment_irradiance[3] * n.x) +\n"
+      "             1.092548 * (environment_irradiance[4] * n.x * n.y +\n"
+      "                         environment_irradiance[5] * n.y * n.z +\n"
+      "                         environment_irradiance[7] * n.x * n.z) +\n"
+      "             0.315392 * environment_irradiance[6] *\n"
+      "                 (3.0 * n.z * n.z - 1.0) +\n"
+      "             0.546274 * environment_irradiance[8] *\n"
+      "                 (n.x * n.x - n.y * n.y), vec3(0.0));\n"
+      "}\n"
+      "vec3 EnvironmentSpecular(vec3 r, float roughness) {\n"
+      "  return textureLod(environment_specular, EquirectangularUv(r),\n"
+      "                    roughness * environment_max_level).rgb;\n"
+      "}\n";
+}
+
+bool EnvironmentLighting::Load(const int width,
+                               const int height,
+                               const std::vector<GLubyte>& texels,
+                               const TextureCache* cache,
+                               std::string* error_info_log) {
+  const std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  statistics_ = EnvironmentLightingStatistics();
+  if (width <= 0 || height <= 0 ||
+      texels.size() != static_cast<size_t>(width) * height * 4) {
+    *error_info_log = "Invalid environment of " + std::to_string(width) +
+        "x" + std::to_string(height) + " texels.";
+    return false;
+  }
+  Reset();
+  // The results depend on the texels and on the parameters of the
+  // prefiltering.
+  const uint32_t parameters[] = {
+    kEnvironmentCacheVersion, static_cast<uint32_t>(width),
+    static_cast<uint32_t>(height), kEnvironmentSpecularWidth,
+    kEnvironmentSpecularLevels, kSpecularSamples
+  };
+  const uint64_t hash = HashContent(
+      texels.data(), texels.size(),
+      HashContent(parameters, sizeof(parameters)));
+  const std::string specular_filepath =
+      cache != nullptr ? cache->ContentCacheFilepath(hash, "ibl.ktx") : "";
+  const std::string irradiance_filepath =
+      cache != nullptr ? cache->ContentCacheFilepath(hash, "ibl.sh") : "";
+  if (cache != nullptr &&
+      ReadCache(specular_filepath, irradiance_filepath)) {
+    statistics_.cache_hit = true;
+  } else {
+    if (!Prefilter(width, height, texels, error_info_log)) {
+      Reset();
+      return false;
+    }
+    std::string write_error;
+    statistics_.cache_write_failed = cache != nullptr &&
+        !WriteCache(specular_filepath, irradiance_filepath, &write_error);
+  }
+  statistics_.load_ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - begin).count();
+  return true;
+}
+
+bool EnvironmentLighting::ReadCache(const std::string& specular_filepath,
+                                    const std::string& irradiance_filepath) {
+  std::ifstream in(irradiance_filepath, std::ios::binary);
+  uint32_t magic = 0;
+  std::vector<GLfloat> irradiance(3 * kEnvironmentIrradianceCoefficients);
+  in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  in.read(reinterpret_cast<char*>(irradiance.data()),
+          irradiance.size() * sizeof(irradiance[0]));
+  if (!in || magic != kIrradianceMagic) return false;
+  KtxTextureSource source;
+  std::string error_info_log;
+  if (!source.Open(specular_filepath, &error_info_log) ||
+      source.format() != TEXTURE_FORMAT_RGBA16F ||
+      source.width() != kEnvironmentSpecularWidth ||
+      source.height() != kEnvironmentSpecularWidth / 2 ||
+      source.num_levels() != kEnvironmentSpecularLevels) {
+    return false;
+  }
+  specular_texture_id_ = CreateSpecularTexture();
+  for (int level = 0; level < kEnvironmentSpecularLevels; ++level) {
+    const GLubyte* data = nullptr;
+    size_t size = 0;
+    if (!source.GetLevel(level, &data, &size)) {
+      Reset();
+      return false;
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0,
+                    LevelDimension(kEnvironmentSpecularWidth, level),
+                    LevelDimension(kEnvironmentSpecularWidth / 2, level),
+                    GL_RGBA, GL_HALF_FLOAT, data);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  irradiance_ = std::move(irradiance);
+  return true;
+}
+
+bool EnvironmentLighting::WriteCache(const std::string& specular_filepath,
+                                     const std::string& irradiance_filepath,
+                                     std::string* error_info_log) const {
+  std::vector<std::vector<GLubyte> > levels(kEnvironmentSpecularLevels);
+  glBindTexture(GL_TEXTURE_2D, specular_texture_id_);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  for (int level = 0; level < kEnvironmentSpecularLevels; ++level) {
+    levels[level].resize(TextureLevelSize(
+        TEXTURE_FORMAT_RGBA16F,
+        LevelDimension(kEnvironmentSpecularWidth, level),
+        LevelDimension(kEnvironmentSpecularWidth / 2, level)));
+    glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_HALF_FLOAT,
+                  levels[level].data());
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  if (!WriteKtxFile(TEXTURE_FORMAT_RGBA16F, kEnvironmentSpecularWidth,
+                    kEnvironmentSpecularWidth / 2, levels, specular_filepath,
+                    error_info_log)) {
+    return false;
+  }
+  // The irradiance is written last, and renamed into place, so that a cached
+  // irradiance always has its specular map.
+  const std::string temporary_filepath = irradiance_filepath + ".tmp";
+  std::ofstream out(temporary_filepath, std::ios::binary);
+  out.write(reinterpret_cast<const char*>(&kIrradianceMagic),
+            sizeof(kIrradianceMagic));
+  out.write(reinterpret_cast<const char*>(irradiance_.data()),
+            irradiance_.size() * sizeof(irradiance_[0]));
+  out.close();
+  if (!out ||
+      std::rename(temporary_filepath.c_str(),
+                  irradiance_filepath.c_str()) != 0) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + irradiance_filepath;
+    return false;
+  }
+  return true;
+}
+
+bool EnvironmentLighting::Prefilter(const int width,
+                                    const int height,
+                                    const std::vector<GLubyte>& texels,
+                                    std::string* error_info_log) {
+  if (!Supported()) {
+    *error_info_log = "Prefiltering the environment needs OpenGL 4.3.";
+    return false;
+  }
+  ShaderProgram specular_program;
+  ShaderProgram irradiance_program;
+  const std::string prefix =
+      std::string("#version 430\n") + kEquirectangularSource;
+  if (!specular_program.LoadComputeShaderFromString(prefix +
+                                                    kSpecularShader) ||
+      !specular_program.Create(error_info_log) ||
+      !irradiance_program.LoadComputeShaderFromString(prefix +
+                                                      kIrradianceShader) ||
+      !irradiance_program.Create(error_info_log)) {
+    return false;
+  }
+
+  // The environment with its mip levels, which the samples of the wide
+  // lobes read.
+  const int num_levels = NumMipLevels(width, height);
+  GLuint environment_id = 0;
+  glGenTextures(1, &environment_id);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, environment_id);
+  glTexStorage2D(GL_TEXTURE_2D, num_levels, GL_RGBA8, width, height);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA,
+                  GL_UNSIGNED_BYTE, texels.data());
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  specular_texture_id_ = CreateSpecularTexture();
+  glBindTexture(GL_TEXTURE_2D, environment_id);
+  specular_program.Use();
+  specular_program.SetUniform(
+      "base_level", std::max(std::log2(static_cast<GLfloat>(width) /
+                                        kEnvironmentSpecularWidth), 0.0f));
+  specular_program.SetUniform(
+      "texel_solid_angle",
+      static_cast<GLfloat>(4.0 * M_PI / (static_cast<double>(width) * height)));
+  const GLint roughness_location =
+      specular_program.GetUniformLocation("roughness");
+  for (int level = 0; level < kEnvironmentSpecularLevels; ++level) {
+    specular_program.SetUniform(
+        roughness_location,
+        static_cast<GLfloat>(level) / (kEnvironmentSpecularLevels - 1));
+    glBindImageTexture(0, specular_texture_id_, level, GL_FALSE, 0,
+                       GL_WRITE_ONLY, GL_RGBA16F);
+    // The texels are sampled, or read back into the cache.
+    specular_program.Dispatch(
+        NumGroups(LevelDimension(kEnvironmentSpecularWidth, level)),
+        NumGroups(LevelDimension(kEnvironmentSpecularWidth / 2, level)), 1,
+        GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+  }
+
+  int irradiance_level = 0;
+  while ((std::max(width, height) >> irradiance_level) > kIrradianceMaxWidth) {
+    ++irradiance_level;
+  }
+  BufferAllocator* allocator = BufferAllocator::Get();
+  GlStateCache* gl_state = GlStateCache::Current();
+  GLuint irradiance_buffer_id = allocator->CreateBuffer(STORAGE_DATA);
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, irradiance_buffer_id);
+  allocator->BufferData(irradiance_buffer_id, GL_SHADER_STORAGE_BUFFER,
+                        4 * kEnvironmentIrradianceCoefficients *
+                        sizeof(GLfloat), nullptr, GL_STREAM_READ);
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, irradiance_buffer_id);
+  irradiance_program.Use();
+  irradiance_program.SetUniform("level",
+                                static_cast<GLint>(irradiance_level));
+  irradiance_program.Dispatch(1, 1, 1, GL_BUFFER_UPDATE_BARRIER_BIT);
+  // The coefficients are padded to vec4.
+  std::vector<GLfloat> coefficients(4 * kEnvironmentIrradianceCoefficients);
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, irradiance_buffer_id);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                     coefficients.size() * sizeof(coefficients[0]),
+                     coefficients.data());
+  irradiance_.resize(3 * kEnvironmentIrradianceCoefficients);
+  for (int i = 0; i < kEnvironmentIrradianceCoefficients; ++i) {
+    std::copy(&coefficients[4 * i], &coefficients[4 * i] + 3,
+              &irradiance_[3 * i]);
+  }
+  allocator->DeleteBuffer(&irradiance_buffer_id);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glDeleteTextures(1, &environment_id);
+  return true;
+}
+
+void EnvironmentLighting::SetUniforms(ShaderProgram* program,
+                                      const int texture_unit) const {
+  program->Use();
+  glActiveTexture(GL_TEXTURE0 + texture_unit);
+  glBindTexture(GL_TEXTURE_2D, specular_texture_id_);
+  glActiveTexture(GL_TEXTURE0);
+  program->SetUniform("environment_specular",
+                      static_cast<GLint>(texture_unit));
+  program->SetUniform("environment_max_level",
+                      static_cast<GLfloat>(kEnvironmentSpecularLevels - 1));
+  if (irradiance_.size() == 3 * kEnvironmentIrradianceCoefficients) {
+    glUniform3fv(program->GetUniformLocation("environment_irradiance"),
+                 kEnvironmentIrradianceCoefficients, irradiance_.data());
+  }
+}
+
+void EnvironmentLighting::Reset() {
+  if (specular_texture_id_ != 0) {
+    glDeleteTextures(1, &specular_texture_id_);
+    specular_texture_id_ = 0;
+  }
+  irradiance_.clear();
+}
+
+}  // namespace wvu
@@ -0,0 +1,166 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_ENVIRONMENT_LIGHTING_H_
+#define GLUTILS_ENVIRONMENT_LIGHTING_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "shader_program.h"
+#include "texture_cache.h"
+
+namespace wvu {
+// Width of level 0 of the prefiltered specular map, twice its height.
+constexpr int kEnvironmentSpecularWidth = 256;
+// Levels of the prefiltered specular map, from roughness 0 to 1.
+constexpr int kEnvironmentSpecularLevels = 6;
+// Coefficients of the irradiance: the 9 spherical harmonics of the first 3
+// bands, for each of red, green and blue.
+constexpr int kEnvironmentIrradianceCoefficients = 9;
+
+// Counters of the last EnvironmentLighting::Load().
+struct EnvironmentLightingStatistics {
+  // True if the prefiltered data was read from the cache.
+  bool cache_hit = false;
+  // True if the prefiltered data could not be written into the cache.
+  bool cache_write_failed = false;
+  // Milliseconds of the load, including the prefiltering and the wait for the
+  // GPU on a miss.
+  double load_ms = 0.0;
+};
+
+// This class prefilters an environment map for image-based lighting: a
+// specular map whose levels hold the environment convolved with the GGX lobe
+// of increasing roughness, and the irradiance of the environment over the
+// cosine lobe as spherical harmonics. The environment, and the specular map,
+// are equirectangular: the longitude spans the width and the latitude the
+// height, from +y at the top row. The prefiltering runs in compute shaders,
+// with the importance sampling of Karis (2013) reading the mip levels of the
+// environment in proportion to the solid angle of each sample, and takes a
+// moment on a large environment, so its results are written into the texture
+// cache, named by the hash of the texels of the environment and of the
+// parameters of the prefiltering. The next runs upload them directly,
+// without any GPU work. Needs OpenGL 4.3.
+//
+// The shaders declaring GlslDeclaration() shade with
+//   vec3 EnvironmentIrradiance(vec3 world_normal);
+//   vec3 EnvironmentSpecular(vec3 world_reflection, float roughness);
+// once SetUniforms() bound the maps; the diffuse radiance of a surface of
+// albedo a is a / pi times its irradiance.
+//
+// Example:
+//
+// wvu::TextureCache texture_cache("/path/to/cache");
+// int width, height;
+// std::vector<GLubyte> texels;
+// wvu::DecodeNetpbmImage("/path/to/sky.ppm", &width, &height, &texels,
+//                        &error_info_log);
+// wvu::EnvironmentLighting environment;
+// if (!environment.Load(width, height, texels, &texture_cache,
+//                       &error_info_log)) { ... }
+// ...
+// environment.SetUniforms(&shader_program, 4);
+class EnvironmentLighting {
+ public:
+  EnvironmentLighting();
+  ~EnvironmentLighting();
+
+  // Prefilters the environment of width x height RGBA8 texels, rows from the
+  // top, whose colors are linear, or reads the prefiltered data from the
+  // cache if a previous load prefiltered the same texels. The cache may be
+  // nullptr, which always prefilters. Returns true if successful.
+  bool Load(const int width,
+            const int height,
+            const std::vector<GLubyte>& texels,
+            const TextureCache* cache,
+            std::string* error_info_log);
+
+  // Binds the specular map to texture unit texture_unit, and sets the
+  // uniforms of GlslDeclaration() in the program, which is used.
+  void SetUniforms(ShaderProgram* program, const int texture_unit) const;
+
+  // Deletes the specular map.
+  void Reset();
+
+  // Returns the declaration of the uniforms and the shading functions.
+  static std::string GlslDeclaration();
+
+  // Returns true if the context supports compute shaders.
+  static bool Supported();
+
+  GLuint specular_texture_id() const {
+    return specular_texture_id_;
+  }
+
+  // Returns the irradiance coefficients, 3 floats per coefficient, already
+  // convolved with the cosine lobe.
+  const std::vector<GLfloat>& irradiance() const {
+    return irradiance_;
+  }
+
+  const EnvironmentLightingStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // Reads the prefiltered data of the hash from the cache. Returns true if
+  // both files are valid.
+  bool ReadCache(const std::string& specular_filepath,
+                 const std::string& irradiance_filepath);
+
+  // Writes the specular map and the irradiance into the cache. Returns true
+  // if successful.
+  bool WriteCache(const std::string& specular_filepath,
+                  const std::string& irradiance_filepath,
+                  std::string* error_info_log) const;
+
+  // Prefilters the environment on the GPU. Returns true if successful.
+  bool Prefilter(const int width,
+                 const int height,
+                 const std::vector<GLubyte>& texels,
+                 std::string* error_info_log);
+
+  GLuint specular_texture_id_;
+  std::vector<GLfloat> irradiance_;
+  EnvironmentLightingStatistics statistics_;
+
+  EnvironmentLighting(const EnvironmentLighting&) = delete;
+  EnvironmentLighting& operator=(const EnvironmentLighting&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_ENVIRONMENT_LIGHTING_H_
@@ -0,0 +1,85 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "fixed_timestep.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace wvu {
+
+int FixedTimestep::Advance(const double time) {
+  if (last_time_ < 0.0) {
+    last_time_ = time;
+    return 0;
+  }
+  accumulated_time_ += std::max(time - last_time_, 0.0);
+  last_time_ = time;
+  int num_steps = static_cast<int>(accumulated_time_ / step_);
+  accumulated_time_ -= num_steps * step_;
+  if (num_steps > max_steps_per_frame_) {
+    num_dropped_steps_ += num_steps - max_steps_per_frame_;
+    num_steps = max_steps_per_frame_;
+  }
+  simulation_time_ += num_steps * step_;
+  return num_steps;
+}
+
+int FixedTimestep::Advance(const uint64_t timer_value,
+                           const uint64_t timer_frequency) {
+  if (!timer_started_ || timer_frequency != timer_frequency_) {
+    timer_started_ = true;
+    last_timer_value_ = timer_value;
+    accumulated_ticks_ = 0;
+    timer_frequency_ = timer_frequency;
+    step_ticks_ = std::max<uint64_t>(
+        static_cast<uint64_t>(std::llround(step_ * timer_frequency)), 1);
+    return 0;
+  }
+  if (timer_value > last_timer_value_) {
+    accumulated_ticks_ += timer_value - last_timer_value_;
+  }
+  last_timer_value_ = timer_value;
+  const uint64_t num_whole_steps = accumulated_ticks_ / step_ticks_;
+  accumulated_ticks_ -= num_whole_steps * step_ticks_;
+  accumulated_time_ = step_ * accumulated_ticks_ / step_ticks_;
+  int num_steps = static_cast<int>(
+      std::min<uint64_t>(num_whole_steps, max_steps_per_frame_));
+  num_dropped_steps_ += static_cast<int>(num_whole_steps - num_steps);
+  simulation_time_ += num_steps * step_;
+  return num_steps;
+}
+
+}  // namespace wvu
@@ -0,0 +1,135 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_FIXED_TIMESTEP_H_
+#define GLUTILS_FIXED_TIMESTEP_H_
+
+#include <cstdint>
+
+namespace wvu {
+// Default maximum number of simulation steps run in a frame.
+constexpr int kDefaultMaxSimulationSteps = 8;
+
+// This class runs a simulation at a fixed rate regardless of the frame rate.
+// Every frame, Advance() returns how many steps of the fixed duration fit in
+// the elapsed time, and alpha() tells how far the frame is between the last
+// two simulation states, so that rendering interpolates them instead of
+// showing the simulation stutter. When the frames are slower than
+// max_steps_per_frame steps, the excess time is dropped, so a slow simulation
+// cannot make every later frame slower (the "spiral of death").
+//
+// Example:
+//
+// wvu::FixedTimestep timestep(1.0 / 60.0);
+// while (...) {  // Rendering loop.
+//   const int num_steps = timestep.Advance(glfwGetTime());
+//   for (int i = 0; i < num_steps; ++i) {
+//     previous_state = state;
+//     Simulate(timestep.step(), &state);
+//   }
+//   Render(Interpolate(previous_state, state, timestep.alpha()));
+// }
+//
+// The clock may also be advanced with the integer ticks of a timer, e.g.,
+// glfwGetTimerValue() and glfwGetTimerFrequency(). The elapsed time is then
+// accumulated exactly, so the steps do not drift however long the simulation
+// runs:
+//
+// const int num_steps =
+//     timestep.Advance(glfwGetTimerValue(), glfwGetTimerFrequency());
+class FixedTimestep {
+ public:
+  // Parameters:
+  //   step  The duration of a simulation step in seconds.
+  //   max_steps_per_frame  The maximum number of steps Advance() returns.
+  explicit FixedTimestep(const double step,
+                         const int max_steps_per_frame =
+                             kDefaultMaxSimulationSteps)
+      : step_(step), max_steps_per_frame_(max_steps_per_frame),
+        last_time_(-1.0), accumulated_time_(0.0), simulation_time_(0.0),
+        num_dropped_steps_(0), timer_started_(false), last_timer_value_(0),
+        accumulated_ticks_(0), step_ticks_(0), timer_frequency_(0) {}
+  ~FixedTimestep() {}
+
+  // Advances the clock to time, in seconds, and returns the number of steps
+  // to simulate. The first call starts the clock and returns 0.
+  int Advance(const double time);
+
+  // Advances the clock to the value of a timer counting timer_frequency ticks
+  // per second, and returns the number of steps to simulate. The step is
+  // rounded to the nearest tick. The first call starts the clock and returns
+  // 0. A timestep is advanced either in seconds or in ticks, not both.
+  int Advance(const uint64_t timer_value, const uint64_t timer_frequency);
+
+  // Returns the position of the current time between the last two simulation
+  // states, in [0, 1).
+  double alpha() const {
+    return accumulated_time_ / step_;
+  }
+
+  double step() const {
+    return step_;
+  }
+
+  // Returns the time of the last simulation state.
+  double simulation_time() const {
+    return simulation_time_;
+  }
+
+  // Returns the number of steps dropped because a frame needed more than
+  // max_steps_per_frame steps.
+  int num_dropped_steps() const {
+    return num_dropped_steps_;
+  }
+
+ private:
+  const double step_;
+  const int max_steps_per_frame_;
+  // Time of the last call to Advance(), or -1 before the first one.
+  double last_time_;
+  // Time elapsed since the last simulation state.
+  double accumulated_time_;
+  double simulation_time_;
+  int num_dropped_steps_;
+  // State of the clock advanced in ticks.
+  bool timer_started_;
+  uint64_t last_timer_value_;
+  uint64_t accumulated_ticks_;
+  uint64_t step_ticks_;
+  uint64_t timer_frequency_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_FIXED_TIMESTEP_H_
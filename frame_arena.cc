@@ -0,0 +1,121 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "huge_pages.h"
+
+namespace wvu {
+namespace {
+// Returns the bytes to skip after address to align it.
+inline size_t AlignmentPadding(const char* address, const size_t alignment) {
+  const uintptr_t misalignment =
+      reinterpret_cast<uintptr_t>(address) & (alignment - 1);
+  return misalignment == 0 ? 0 : alignment - misalignment;
+}
+
+// Allocates the storage of a buffer of at least capacity bytes, from huge
+// pages if the process asks for them and the buffer is large enough, in which
+// case the capacity grows to the mapped size.
+void AllocateBuffer(const size_t capacity,
+                    char** data,
+                    size_t* buffer_capacity,
+                    size_t* mapped_bytes) {
+  *data = static_cast<char*>(AllocatePages(capacity, mapped_bytes));
+  *buffer_capacity = std::max(capacity, *mapped_bytes);
+}
+
+}  // namespace
+
+FrameArena::FrameArena(const size_t capacity) : current_buffer_(0) {
+  for (Buffer& buffer : buffers_) {
+    AllocateBuffer(capacity, &buffer.data, &buffer.capacity,
+                   &buffer.mapped_bytes);
+  }
+  statistics_.capacity = buffers_[0].capacity;
+}
+
+FrameArena::~FrameArena() {
+  for (Buffer& buffer : buffers_) {
+    for (char* block : buffer.overflow_blocks) delete[] block;
+    FreePages(buffer.data, buffer.mapped_bytes);
+  }
+}
+
+void FrameArena::BeginFrame() {
+  current_buffer_ = (current_buffer_ + 1) % kNumFrameArenaBuffers;
+  Buffer& buffer = buffers_[current_buffer_];
+  for (char* block : buffer.overflow_blocks) delete[] block;
+  buffer.overflow_blocks.clear();
+  // Grow the buffer to fit the largest frame, so the overflow does not repeat.
+  if (buffer.capacity < statistics_.high_water_bytes) {
+    FreePages(buffer.data, buffer.mapped_bytes);
+    AllocateBuffer(statistics_.high_water_bytes, &buffer.data,
+                   &buffer.capacity, &buffer.mapped_bytes);
+    ++statistics_.num_resizes;
+  }
+  buffer.offset = 0;
+  statistics_.num_bytes = 0;
+  statistics_.capacity = buffer.capacity;
+}
+
+void* FrameArena::Allocate(const size_t num_bytes, const size_t alignment) {
+  Buffer& buffer = buffers_[current_buffer_];
+  const size_t padding =
+      AlignmentPadding(buffer.data + buffer.offset, alignment);
+  char* result;
+  if (buffer.offset + padding + num_bytes <= buffer.capacity) {
+    result = buffer.data + buffer.offset + padding;
+    buffer.offset += padding + num_bytes;
+    statistics_.num_bytes += padding + num_bytes;
+  } else {
+    // The padding is bounded by the alignment in the buffer too, so the grown
+    // buffer fits this allocation.
+    char* block = new char[num_bytes + alignment];
+    buffer.overflow_blocks.push_back(block);
+    result = block + AlignmentPadding(block, alignment);
+    statistics_.num_bytes += num_bytes + alignment;
+    ++statistics_.num_overflow_allocations;
+  }
+  statistics_.high_water_bytes =
+      std::max(statistics_.high_water_bytes, statistics_.num_bytes);
+  return result;
+}
+
+}  // namespace wvu
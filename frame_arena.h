@@ -0,0 +1,199 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_FRAME_ARENA_H_
+#define GLUTILS_FRAME_ARENA_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace wvu {
+// Number of buffers of a FrameArena. The data of a frame remains valid while
+// the next frame is recorded, e.g., while the render thread draws the frame
+// the simulation produced.
+constexpr int kNumFrameArenaBuffers = 2;
+
+// Default capacity in bytes of each buffer of a FrameArena.
+constexpr size_t kDefaultFrameArenaCapacity = 1 << 20;
+
+// Minimum alignment of the allocations, which covers the vectorized
+// fixed-size Eigen types (e.g., Eigen::Matrix4f).
+constexpr size_t kFrameArenaAlignment = 16;
+
+// Counters of the allocations of a FrameArena.
+struct FrameArenaStatistics {
+  // Bytes allocated in the current frame, including the alignment padding.
+  size_t num_bytes = 0;
+  // Largest number of bytes allocated in a frame.
+  size_t high_water_bytes = 0;
+  // Capacity in bytes of each buffer.
+  size_t capacity = 0;
+  // Allocations that did not fit in the buffer and went to the heap.
+  int num_overflow_allocations = 0;
+  // Times a buffer was reallocated to fit the high-water mark.
+  int num_resizes = 0;
+};
+
+// This class is a linear (bump) allocator for the transient data of a frame,
+// e.g., draw lists, culling results or temporary matrices. An allocation
+// advances an offset into a preallocated buffer, and the whole buffer is
+// released at once when it is reused, so the frames do not call the global
+// heap. The arena alternates between kNumFrameArenaBuffers buffers: the
+// allocations of a frame remain valid until BeginFrame() is called twice.
+//
+// Allocations that do not fit in the buffer are served by the heap, so the
+// arena never fails, and the buffer is grown to the high-water mark the next
+// time it is reused. Once the buffers fit the largest frame, the frame loop
+// performs no heap allocations. The destructors of the objects are not run,
+// so the arena should hold trivially destructible types or containers using
+// a FrameAllocator.
+//
+// The arena is not thread-safe: each thread should own one, or the
+// allocations should be made before the data is shared.
+//
+// Large buffers are backed by huge pages when the process asks for them (see
+// huge_pages.h), so that a frame touching the whole arena misses the TLB a
+// few times rather than once per 4 KB page.
+//
+// Example:
+//
+// wvu::FrameArena frame_arena;
+// while (...) {  // Rendering loop.
+//   frame_arena.BeginFrame();
+//   Eigen::Matrix4f* matrices =
+//       frame_arena.AllocateArray<Eigen::Matrix4f>(num_objects);
+//   wvu::FrameVector<int> visible((wvu::FrameAllocator<int>(&frame_arena)));
+//   visible.reserve(num_objects);
+//   ...
+// }
+class FrameArena {
+ public:
+  // Parameters:
+  //   capacity  The initial capacity in bytes of each buffer.
+  explicit FrameArena(const size_t capacity = kDefaultFrameArenaCapacity);
+  ~FrameArena();
+
+  // Switches to the next buffer and releases its allocations, which are those
+  // of kNumFrameArenaBuffers frames ago.
+  void BeginFrame();
+
+  // Returns uninitialized storage of num_bytes bytes, aligned to alignment.
+  // The alignment must be a power of two.
+  void* Allocate(const size_t num_bytes,
+                 const size_t alignment = kFrameArenaAlignment);
+
+  // Returns uninitialized storage for num_elements elements of type T.
+  template <typename T>
+  T* AllocateArray(const size_t num_elements) {
+    return static_cast<T*>(Allocate(
+        num_elements * sizeof(T), std::max(alignof(T), kFrameArenaAlignment)));
+  }
+
+  // Returns the counters of the current frame and the high-water marks.
+  const FrameArenaStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  struct Buffer {
+    char* data = nullptr;
+    size_t capacity = 0;
+    size_t offset = 0;
+    // Bytes of the pages mapped for data, or 0 if it came from the heap (see
+    // AllocatePages()).
+    size_t mapped_bytes = 0;
+    // Heap blocks of the allocations that did not fit, freed with the buffer.
+    std::vector<char*> overflow_blocks;
+  };
+
+  Buffer buffers_[kNumFrameArenaBuffers];
+  int current_buffer_;
+  FrameArenaStatistics statistics_;
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+};
+
+// Allocator adapter that lets the standard containers allocate from a
+// FrameArena. Deallocation is a no-op: the memory is released with the frame.
+// A growing container leaves its previous storage behind, so containers
+// should reserve their size first.
+template <typename T>
+class FrameAllocator {
+ public:
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind {
+    typedef FrameAllocator<U> other;
+  };
+
+  explicit FrameAllocator(FrameArena* arena) : arena_(arena) {}
+
+  template <typename U>
+  FrameAllocator(const FrameAllocator<U>& allocator)  // NOLINT
+      : arena_(allocator.arena()) {}
+
+  T* allocate(const size_t n) {
+    return arena_->AllocateArray<T>(n);
+  }
+
+  void deallocate(T* pointer, const size_t n) {}
+
+  FrameArena* arena() const {
+    return arena_;
+  }
+
+ private:
+  FrameArena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const FrameAllocator<T>& lhs, const FrameAllocator<U>& rhs) {
+  return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const FrameAllocator<T>& lhs, const FrameAllocator<U>& rhs) {
+  return lhs.arena() != rhs.arena();
+}
+
+// Vector whose storage lives in a FrameArena.
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T> >;
+
+}  // namespace wvu
+
+#endif  // GLUTILS_FRAME_ARENA_H_
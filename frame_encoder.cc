@@ -0,0 +1,479 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "frame_encoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+
+#include "framebuffer_readback.h"
+
+namespace wvu {
+namespace {
+// Bytes of an RGBA pixel.
+constexpr int kBytesPerPixel = 4;
+
+// Largest payload of a stored deflate block.
+constexpr int kMaxStoredBlockSize = 65535;
+
+// Returns true if filepath ends with extension.
+bool HasExtension(const std::string& filepath, const std::string& extension) {
+  return filepath.size() >= extension.size() &&
+      filepath.compare(filepath.size() - extension.size(), extension.size(),
+                       extension) == 0;
+}
+
+// Returns true if the pattern has exactly one printf conversion, and it is an
+// integer one, e.g., "%06d". A literal percent sign is written "%%".
+bool IsFramePattern(const std::string& pattern) {
+  int num_conversions = 0;
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    if (pattern[i] != '%') continue;
+    if (i + 1 < pattern.size() && pattern[i + 1] == '%') {
+      ++i;
+      continue;
+    }
+    size_t j = i + 1;
+    while (j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9') ++j;
+    if (j == pattern.size() || pattern[j] != 'd') return false;
+    ++num_conversions;
+    i = j;
+  }
+  return num_conversions == 1;
+}
+
+// Returns the CRC-32 of the bytes, as PNG checksums its chunks.
+uint32_t ComputeCrc32(const GLubyte* data, const size_t size, uint32_t crc) {
+  static const std::vector<uint32_t> table = [] {
+    std::vector<uint32_t> entries(256);
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      entries[i] = c;
+    }
+    return entries;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+void AppendBigEndian(const uint32_t value, std::vector<GLubyte>* bytes) {
+  bytes->push_back(value >> 24);
+  bytes->push_back((value >> 16) & 0xFF);
+  bytes->push_back((value >> 8) & 0xFF);
+  bytes->push_back(value & 0xFF);
+}
+
+// Writes a PNG chunk: its length, type, data and CRC.
+void WritePngChunk(const char* type,
+                   const GLubyte* data,
+                   const size_t size,
+                   std::ofstream* out) {
+  std::vector<GLubyte> header;
+  AppendBigEndian(size, &header);
+  header.insert(header.end(), type, type + 4);
+  uint32_t crc = ComputeCrc32(header.data() + 4, 4, 0);
+  crc = ComputeCrc32(data, size, crc);
+  std::vector<GLubyte> footer;
+  AppendBigEndian(crc, &footer);
+  out->write(reinterpret_cast<const char*>(header.data()), header.size());
+  out->write(reinterpret_cast<const char*>(data), size);
+  out->write(reinterpret_cast<const char*>(footer.data()), footer.size());
+}
+
+// Moves the temporary file of filepath into place. Returns true if
+// successful.
+bool RenameTemporaryFile(const std::string& filepath,
+                         std::string* error_info_log) {
+  const std::string temporary_filepath = filepath + ".tmp";
+  if (std::rename(temporary_filepath.c_str(), filepath.c_str()) != 0) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not rename " + temporary_filepath;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+Y4mEncoder::Y4mEncoder(const std::string& filepath)
+    : filepath_(filepath), width_(0), height_(0) {}
+
+Y4mEncoder::~Y4mEncoder() {
+  if (out_.is_open()) {
+    out_.close();
+    std::remove((filepath_ + ".tmp").c_str());
+  }
+}
+
+bool Y4mEncoder::Open(const int width,
+                      const int height,
+                      const int frame_rate,
+                      std::string* error_info_log) {
+  const std::string temporary_filepath = filepath_ + ".tmp";
+  out_.open(temporary_filepath, std::ios::binary);
+  if (!out_.is_open()) {
+    *error_info_log = "Could not open " + temporary_filepath;
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  const int chroma_size = ((width + 1) / 2) * ((height + 1) / 2);
+  planes_.resize(width * height + 2 * chroma_size);
+  // C420jpeg: full range BT.601 with the chroma samples centered between the
+  // luma samples, which is what 2x2 averaging produces.
+  out_ << "YUV4MPEG2 W" << width << " H" << height << " F" << frame_rate
+       << ":1 Ip A1:1 C420jpeg\n";
+  return static_cast<bool>(out_);
+}
+
+bool Y4mEncoder::EncodeFrame(const GLubyte* pixels,
+                             std::string* error_info_log) {
+  const int chroma_width = (width_ + 1) / 2;
+  const int chroma_height = (height_ + 1) / 2;
+  GLubyte* luma = planes_.data();
+  GLubyte* blue_chroma = luma + width_ * height_;
+  GLubyte* red_chroma = blue_chroma + chroma_width * chroma_height;
+  // The pixels start at the bottom row, while the planes start at the top.
+  const auto pixel = [&](const int x, const int y) {
+    return pixels + (static_cast<size_t>(height_ - 1 - y) * width_ + x) *
+        kBytesPerPixel;
+  };
+  for (int y = 0; y < height_; ++y) {
+    for (int x = 0; x < width_; ++x) {
+      const GLubyte* rgb = pixel(x, y);
+      luma[y * width_ + x] =
+          (77 * rgb[0] + 150 * rgb[1] + 29 * rgb[2] + 128) >> 8;
+    }
+  }
+  for (int y = 0; y < chroma_height; ++y) {
+    const int y0 = 2 * y;
+    const int y1 = std::min(y0 + 1, height_ - 1);
+    for (int x = 0; x < chroma_width; ++x) {
+      const int x0 = 2 * x;
+      const int x1 = std::min(x0 + 1, width_ - 1);
+      int rgb[3];
+      for (int c = 0; c < 3; ++c) {
+        rgb[c] = (pixel(x0, y0)[c] + pixel(x1, y0)[c] + pixel(x0, y1)[c] +
+                  pixel(x1, y1)[c] + 2) / 4;
+      }
+      // The offset of 128 << 8 keeps the sums positive before the shift.
+      const int blue = (-43 * rgb[0] - 85 * rgb[1] + 128 * rgb[2] + 32896) >> 8;
+      const int red = (128 * rgb[0] - 107 * rgb[1] - 21 * rgb[2] + 32896) >> 8;
+      blue_chroma[y * chroma_width + x] = std::min(blue, 255);
+      red_chroma[y * chroma_width + x] = std::min(red, 255);
+    }
+  }
+  out_ << "FRAME\n";
+  out_.write(reinterpret_cast<const char*>(planes_.data()), planes_.size());
+  if (!out_) {
+    *error_info_log = "Could not write " + filepath_ + ".tmp";
+    return false;
+  }
+  return true;
+}
+
+bool Y4mEncoder::Close(std::string* error_info_log) {
+  const std::string temporary_filepath = filepath_ + ".tmp";
+  out_.close();
+  if (!out_) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + temporary_filepath;
+    return false;
+  }
+  return RenameTemporaryFile(filepath_, error_info_log);
+}
+
+PngSequenceEncoder::PngSequenceEncoder(const std::string& filepath_pattern)
+    : filepath_pattern_(filepath_pattern), width_(0), height_(0),
+      num_frames_(0) {}
+
+bool PngSequenceEncoder::Open(const int width,
+                              const int height,
+                              const int frame_rate,
+                              std::string* error_info_log) {
+  width_ = width;
+  height_ = height;
+  num_frames_ = 0;
+  return true;
+}
+
+bool PngSequenceEncoder::EncodeFrame(const GLubyte* pixels,
+                                     std::string* error_info_log) {
+  // Each row starts with its filter type, 0 (none).
+  const size_t row_size = static_cast<size_t>(width_) * kBytesPerPixel;
+  const size_t raw_size = (row_size + 1) * height_;
+  // The zlib stream: its header, stored deflate blocks of at most 64 KiB,
+  // each with a 5-byte header, and the Adler-32 of the raw data.
+  const size_t num_blocks =
+      std::max<size_t>((raw_size + kMaxStoredBlockSize - 1) /
+                       kMaxStoredBlockSize, 1);
+  image_data_.clear();
+  image_data_.reserve(2 + raw_size + 5 * num_blocks + 4);
+  image_data_.push_back(0x78);
+  image_data_.push_back(0x01);
+  uint32_t adler_a = 1;
+  uint32_t adler_b = 0;
+  size_t block_remaining = 0;
+  size_t remaining = raw_size;
+  const auto append = [&](const GLubyte value) {
+    if (block_remaining == 0) {
+      const size_t block_size =
+          std::min<size_t>(remaining, kMaxStoredBlockSize);
+      image_data_.push_back(block_size == remaining ? 1 : 0);
+      image_data_.push_back(block_size & 0xFF);
+      image_data_.push_back(block_size >> 8);
+      image_data_.push_back(~block_size & 0xFF);
+      image_data_.push_back((~block_size >> 8) & 0xFF);
+      block_remaining = block_size;
+    }
+    image_data_.push_back(value);
+    --block_remaining;
+    --remaining;
+    adler_a = (adler_a + value) % 65521;
+    adler_b = (adler_b + adler_a) % 65521;
+  };
+  // The rows of a PNG go from the top to the bottom.
+  for (int y = height_ - 1; y >= 0; --y) {
+    append(0);
+    const GLubyte* row = pixels + y * row_size;
+    for (size_t i = 0; i < row_size; ++i) append(row[i]);
+  }
+  AppendBigEndian((adler_b << 16) | adler_a, &image_data_);
+
+  char filepath[4096];
+  std::snprintf(filepath, sizeof(filepath), filepath_pattern_.c_str(),
+                num_frames_);
+  const std::string temporary_filepath = std::string(filepath) + ".tmp";
+  std::ofstream out(temporary_filepath, std::ios::binary);
+  if (!out.is_open()) {
+    *error_info_log = "Could not open " + temporary_filepath;
+    return false;
+  }
+  static const GLubyte kSignature[] = {
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+  };
+  out.write(reinterpret_cast<const char*>(kSignature), sizeof(kSignature));
+  std::vector<GLubyte> header;
+  AppendBigEndian(width_, &header);
+  AppendBigEndian(height_, &header);
+  // 8 bits per channel, RGBA, deflate, adaptive filtering, no interlacing.
+  const GLubyte kFormat[] = {8, 6, 0, 0, 0};
+  header.insert(header.end(), kFormat, kFormat + sizeof(kFormat));
+  WritePngChunk("IHDR", header.data(), header.size(), &out);
+  WritePngChunk("IDAT", image_data_.data(), image_data_.size(), &out);
+  WritePngChunk("IEND", nullptr, 0, &out);
+  out.close();
+  if (!out) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + temporary_filepath;
+    return false;
+  }
+  ++num_frames_;
+  return RenameTemporaryFile(filepath, error_info_log);
+}
+
+bool PngSequenceEncoder::Close(std::string* error_info_log) {
+  return true;
+}
+
+std::unique_ptr<FrameEncoder> CreateFrameEncoder(const std::string& filepath,
+                                                 std::string* error_info_log) {
+  if (HasExtension(filepath, ".y4m")) {
+    return std::unique_ptr<FrameEncoder>(new Y4mEncoder(filepath));
+  }
+  if (HasExtension(filepath, ".png")) {
+    if (!IsFramePattern(filepath)) {
+      *error_info_log = filepath + " needs one integer conversion, e.g., "
+          "frame_%06d.png, for the frame numbers.";
+      return nullptr;
+    }
+    return std::unique_ptr<FrameEncoder>(new PngSequenceEncoder(filepath));
+  }
+  *error_info_log = "Unknown frame sequence format of " + filepath +
+      ". Use .y4m or .png.";
+  return nullptr;
+}
+
+FrameEncoderSink::FrameEncoderSink(std::unique_ptr<FrameEncoder> encoder,
+                                   const int queue_capacity,
+                                   const EncoderBackPressure back_pressure)
+    : encoder_(std::move(encoder)),
+      back_pressure_(back_pressure),
+      width_(0),
+      height_(0),
+      slots_(std::max(queue_capacity, 1)),
+      write_index_(0),
+      read_index_(0),
+      stop_(false),
+      num_encoded_frames_(0),
+      num_dropped_frames_(0),
+      num_waits_(0),
+      max_queue_size_(0),
+      failed_(false) {}
+
+FrameEncoderSink::~FrameEncoderSink() {
+  std::string error_info_log;
+  Stop(&error_info_log);
+}
+
+bool FrameEncoderSink::Start(const int width,
+                             const int height,
+                             const int frame_rate,
+                             std::string* error_info_log) {
+  if (encoder_ == nullptr || thread_.joinable()) {
+    *error_info_log = "The encoder is missing or already started.";
+    return false;
+  }
+  if (!encoder_->Open(width, height, frame_rate, error_info_log)) {
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  for (std::vector<GLubyte>& slot : slots_) {
+    slot.resize(static_cast<size_t>(width) * height * kBytesPerPixel);
+  }
+  stop_ = false;
+  thread_ = std::thread(&FrameEncoderSink::EncodeFrames, this);
+  return true;
+}
+
+bool FrameEncoderSink::Submit(const ReadbackFrame& frame) {
+  if (!thread_.joinable() || frame.width != width_ ||
+      frame.height != height_) {
+    return false;
+  }
+  const int64_t capacity = slots_.size();
+  const int64_t write_index = write_index_.load(std::memory_order_relaxed);
+  if (write_index - read_index_.load(std::memory_order_acquire) == capacity) {
+    if (back_pressure_ == DROP_WHEN_FULL) {
+      num_dropped_frames_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    num_waits_.fetch_add(1, std::memory_order_relaxed);
+    while (write_index - read_index_.load(std::memory_order_acquire) ==
+           capacity) {
+      std::this_thread::yield();
+    }
+  }
+  std::vector<GLubyte>& slot = slots_[write_index % capacity];
+  std::memcpy(slot.data(), frame.pixels, slot.size());
+  write_index_.store(write_index + 1, std::memory_order_release);
+  const int queue_size = static_cast<int>(
+      write_index + 1 - read_index_.load(std::memory_order_acquire));
+  if (queue_size > max_queue_size_.load(std::memory_order_relaxed)) {
+    max_queue_size_.store(queue_size, std::memory_order_relaxed);
+  }
+  // Taking the mutex orders the store before the check of a sleeping encoder
+  // thread, so the notification is not lost.
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  frame_queued_.notify_one();
+  return true;
+}
+
+bool FrameEncoderSink::Stop(std::string* error_info_log) {
+  if (!thread_.joinable()) return !failed_;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  frame_queued_.notify_one();
+  thread_.join();
+  std::string close_error;
+  const bool closed = encoder_->Close(&close_error);
+  if (failed_) {
+    *error_info_log = error_info_log_;
+    return false;
+  }
+  if (!closed) {
+    *error_info_log = close_error;
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+FrameEncoderStatistics FrameEncoderSink::statistics() const {
+  FrameEncoderStatistics statistics;
+  statistics.num_submitted_frames = write_index_.load();
+  statistics.num_encoded_frames = num_encoded_frames_.load();
+  statistics.num_dropped_frames = num_dropped_frames_.load();
+  statistics.num_waits = num_waits_.load();
+  statistics.max_queue_size = max_queue_size_.load();
+  return statistics;
+}
+
+void FrameEncoderSink::EncodeFrames() {
+  const int64_t capacity = slots_.size();
+  while (true) {
+    const int64_t read_index = read_index_.load(std::memory_order_relaxed);
+    if (read_index == write_index_.load(std::memory_order_acquire)) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      frame_queued_.wait(lock, [&] {
+        return stop_ ||
+            read_index != write_index_.load(std::memory_order_acquire);
+      });
+      // Stop() drains the queue before the thread exits.
+      if (read_index == write_index_.load(std::memory_order_acquire)) return;
+      continue;
+    }
+    // After a failure the frames are still consumed, so Submit() does not
+    // wait forever.
+    if (!failed_) {
+      if (encoder_->EncodeFrame(slots_[read_index % capacity].data(),
+                                &error_info_log_)) {
+        num_encoded_frames_.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        failed_ = true;
+      }
+    }
+    read_index_.store(read_index + 1, std::memory_order_release);
+  }
+}
+
+}  // namespace wvu
@@ -0,0 +1,236 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_FRAME_ENCODER_H_
+#define GLUTILS_FRAME_ENCODER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+
+#include "framebuffer_readback.h"
+
+namespace wvu {
+// Default number of frames queued for the encoder thread.
+constexpr int kDefaultEncoderQueueCapacity = 8;
+
+// Interface of the encoders of frame sequences. The frames are RGBA, from the
+// bottom row to the top one, as read back by FramebufferReadback. The methods
+// are called from the encoder thread of a FrameEncoderSink.
+class FrameEncoder {
+ public:
+  virtual ~FrameEncoder() {}
+
+  // Starts the sequence. Returns true if successful.
+  virtual bool Open(const int width,
+                    const int height,
+                    const int frame_rate,
+                    std::string* error_info_log) = 0;
+
+  // Encodes the next frame. Returns true if successful.
+  virtual bool EncodeFrame(const GLubyte* pixels,
+                           std::string* error_info_log) = 0;
+
+  // Finishes the sequence. Returns true if successful.
+  virtual bool Close(std::string* error_info_log) = 0;
+};
+
+// Writes the frames as a YUV4MPEG2 (.y4m) video with 4:2:0 chroma, which
+// ffmpeg and most players read. The video is written to a temporary file and
+// renamed when closed.
+class Y4mEncoder : public FrameEncoder {
+ public:
+  explicit Y4mEncoder(const std::string& filepath);
+  ~Y4mEncoder() override;
+
+  bool Open(const int width,
+            const int height,
+            const int frame_rate,
+            std::string* error_info_log) override;
+  bool EncodeFrame(const GLubyte* pixels,
+                   std::string* error_info_log) override;
+  bool Close(std::string* error_info_log) override;
+
+ private:
+  const std::string filepath_;
+  std::ofstream out_;
+  int width_;
+  int height_;
+  // The planes of the current frame.
+  std::vector<GLubyte> planes_;
+};
+
+// Writes each frame as an uncompressed PNG. The path of a frame is
+// filepath_pattern formatted with its number, e.g., "frame_%06d.png".
+class PngSequenceEncoder : public FrameEncoder {
+ public:
+  explicit PngSequenceEncoder(const std::string& filepath_pattern);
+  ~PngSequenceEncoder() override {}
+
+  bool Open(const int width,
+            const int height,
+            const int frame_rate,
+            std::string* error_info_log) override;
+  bool EncodeFrame(const GLubyte* pixels,
+                   std::string* error_info_log) override;
+  bool Close(std::string* error_info_log) override;
+
+ private:
+  const std::string filepath_pattern_;
+  int width_;
+  int height_;
+  int num_frames_;
+  // The image data of the current frame: the filtered rows wrapped in a
+  // zlib stream of stored blocks.
+  std::vector<GLubyte> image_data_;
+};
+
+// Returns the encoder of the extension of filepath: ".y4m" for Y4mEncoder,
+// and ".png" for PngSequenceEncoder, whose filepath must then contain a
+// printf integer conversion for the frame number. Returns nullptr otherwise.
+std::unique_ptr<FrameEncoder> CreateFrameEncoder(const std::string& filepath,
+                                                 std::string* error_info_log);
+
+// What FrameEncoderSink::Submit() does when the queue is full.
+enum EncoderBackPressure {
+  // Waits for the encoder to free a slot, so no frame is lost.
+  WAIT_WHEN_FULL = 0,
+  // Drops the frame, so the render loop never waits.
+  DROP_WHEN_FULL
+};
+
+// Counters of a FrameEncoderSink.
+struct FrameEncoderStatistics {
+  int64_t num_submitted_frames = 0;
+  int64_t num_encoded_frames = 0;
+  int64_t num_dropped_frames = 0;
+  // Times Submit() waited for a free slot.
+  int64_t num_waits = 0;
+  // Largest number of frames queued at once.
+  int max_queue_size = 0;
+};
+
+// This class encodes frames on a background thread, so that recording does
+// not slow down the render loop. Submit() copies the pixels into a slot of a
+// bounded single-producer single-consumer queue, whose slots are allocated
+// once, and the encoder thread takes the slots in order. The queue only uses
+// atomic indices; the encoder thread sleeps on a condition variable when it
+// is empty. When the queue is full, the frame is waited for or dropped, as
+// configured, and counted.
+//
+// Example:
+//
+// wvu::FrameEncoderSink sink(
+//     wvu::CreateFrameEncoder("capture.y4m", &error_info_log));
+// sink.Start(width, height, 60, &error_info_log);
+// wvu::FramebufferReadback readback;
+// readback.Initialize(width, height, wvu::kDefaultNumReadbackBuffers,
+//                     [&sink](const wvu::ReadbackFrame& frame) {
+//   sink.Submit(frame);
+// });
+// ...  // Render loop.
+// readback.Finish();
+// sink.Stop(&error_info_log);
+class FrameEncoderSink {
+ public:
+  // Parameters:
+  //   encoder  The encoder of the frames.
+  //   queue_capacity  The number of frames that may wait for the encoder.
+  //   back_pressure  What Submit() does when the queue is full.
+  explicit FrameEncoderSink(
+      std::unique_ptr<FrameEncoder> encoder,
+      const int queue_capacity = kDefaultEncoderQueueCapacity,
+      const EncoderBackPressure back_pressure = WAIT_WHEN_FULL);
+  ~FrameEncoderSink();
+
+  // Opens the encoder and starts the encoder thread. Returns true if
+  // successful.
+  bool Start(const int width,
+             const int height,
+             const int frame_rate,
+             std::string* error_info_log);
+
+  // Queues a copy of the frame. Returns false if the frame was dropped, or if
+  // its size is not the size passed to Start().
+  bool Submit(const ReadbackFrame& frame);
+
+  // Encodes the queued frames, stops the thread and closes the encoder.
+  // Returns false if any frame could not be encoded.
+  bool Stop(std::string* error_info_log);
+
+  // Returns the counters. May be called while the thread runs.
+  FrameEncoderStatistics statistics() const;
+
+ private:
+  // Encodes the queued frames until Stop() is called.
+  void EncodeFrames();
+
+  std::unique_ptr<FrameEncoder> encoder_;
+  const EncoderBackPressure back_pressure_;
+  int width_;
+  int height_;
+  // The pixels of the queued frames. Slot i % slots_.size() holds the i-th
+  // submitted frame.
+  std::vector<std::vector<GLubyte> > slots_;
+  // Frames submitted and frames encoded. Only the producer writes the first,
+  // and only the encoder thread writes the second.
+  std::atomic<int64_t> write_index_;
+  std::atomic<int64_t> read_index_;
+  std::atomic<bool> stop_;
+  std::atomic<int64_t> num_encoded_frames_;
+  std::atomic<int64_t> num_dropped_frames_;
+  std::atomic<int64_t> num_waits_;
+  std::atomic<int> max_queue_size_;
+  // Only used to let the encoder thread sleep while the queue is empty.
+  std::mutex mutex_;
+  std::condition_variable frame_queued_;
+  // The first encoding error, set by the encoder thread before it exits.
+  std::string error_info_log_;
+  bool failed_;
+  std::thread thread_;
+
+  FrameEncoderSink(const FrameEncoderSink&) = delete;
+  FrameEncoderSink& operator=(const FrameEncoderSink&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_FRAME_ENCODER_H_
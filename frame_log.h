@@ -0,0 +1,94 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_FRAME_LOG_H_
+#define GLUTILS_FRAME_LOG_H_
+
+#include <cstdint>
+#include <glog/logging.h>
+
+namespace wvu {
+// This class is a rate-limited logging channel for the render loop. The
+// channel is active once every interval frames, and FRAME_LOG() only formats
+// its message when the channel is active, so a disabled channel costs a
+// comparison per message. The messages go to the glog sinks, and are thus
+// filtered and redirected with the usual glog flags (e.g., --minloglevel,
+// --logtostderr).
+//
+// Example:
+//
+// wvu::FrameLogChannel frame_log(FLAGS_frame_log_interval);
+// while (...) {  // Rendering loop.
+//   frame_log.BeginFrame();
+//   FRAME_LOG(frame_log, INFO) << "Model: \n" << model;
+// }
+class FrameLogChannel {
+ public:
+  // Parameters:
+  //   interval  The channel is active once every interval frames. A
+  //     non-positive interval disables the channel.
+  explicit FrameLogChannel(const int interval)
+      : interval_(interval), frame_(-1), active_(false) {}
+  ~FrameLogChannel() {}
+
+  // Advances to the next frame.
+  void BeginFrame() {
+    ++frame_;
+    active_ = interval_ > 0 && frame_ % interval_ == 0;
+  }
+
+  // Returns true if the messages of the current frame are logged.
+  bool active() const {
+    return active_;
+  }
+
+  // Returns the number of the current frame, starting at 0.
+  int64_t frame() const {
+    return frame_;
+  }
+
+ private:
+  const int interval_;
+  int64_t frame_;
+  bool active_;
+};
+
+}  // namespace wvu
+
+// Logs a message with the given glog severity when the channel is active. The
+// message is not evaluated otherwise.
+#define FRAME_LOG(channel, severity) \
+  LOG_IF(severity, (channel).active()) << "[frame " << (channel).frame() << "] "
+
+#endif  // GLUTILS_FRAME_LOG_H_
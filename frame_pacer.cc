@@ -0,0 +1,234 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <GLFW/glfw3.h>
+
+namespace wvu {
+namespace {
+// Time before the target that the frame limiter spins instead of sleeping. It
+// covers the overshoot of the sleeps.
+constexpr std::chrono::microseconds kSpinDuration(2000);
+
+// Time reserved before the predicted vertical blank on top of the peak frame
+// time, for the swap itself and the jitter of the wake-up.
+constexpr std::chrono::microseconds kJustInTimeMargin(1500);
+
+// Fraction the peak frame time decays by every frame, so that it follows the
+// frame times down within a few seconds.
+constexpr double kPeakFrameTimeDecay = 0.02;
+
+// Weight of a swap interval in the estimate of the refresh period. Intervals
+// further than a quarter of a period from the estimate are not blank to blank,
+// and are ignored.
+constexpr double kRefreshPeriodWeight = 1.0 / 16.0;
+constexpr double kRefreshPeriodTolerance = 0.25;
+
+const char* const kModeNames[] = {
+  "uncapped", "vsync", "adaptive_vsync", "frame_limiter", "just_in_time"};
+
+}  // namespace
+
+bool ParseFramePacingMode(const std::string& name, FramePacingMode* mode) {
+  for (int i = UNCAPPED; i <= JUST_IN_TIME; ++i) {
+    if (name == kModeNames[i]) {
+      *mode = static_cast<FramePacingMode>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* FramePacingModeName(const FramePacingMode mode) {
+  return kModeNames[mode];
+}
+
+double MonitorRefreshRate(GLFWwindow* window) {
+  GLFWmonitor* monitor = glfwGetWindowMonitor(window);
+  if (monitor == nullptr) {
+    int x, y, width, height;
+    glfwGetWindowPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    const int center_x = x + width / 2;
+    const int center_y = y + height / 2;
+    int num_monitors = 0;
+    GLFWmonitor** monitors = glfwGetMonitors(&num_monitors);
+    for (int i = 0; i < num_monitors && monitor == nullptr; ++i) {
+      const GLFWvidmode* mode = glfwGetVideoMode(monitors[i]);
+      int monitor_x, monitor_y;
+      glfwGetMonitorPos(monitors[i], &monitor_x, &monitor_y);
+      if (mode != nullptr && center_x >= monitor_x &&
+          center_x < monitor_x + mode->width && center_y >= monitor_y &&
+          center_y < monitor_y + mode->height) {
+        monitor = monitors[i];
+      }
+    }
+  }
+  if (monitor == nullptr) monitor = glfwGetPrimaryMonitor();
+  if (monitor == nullptr) return 0.0;
+  const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+  return mode != nullptr ? mode->refreshRate : 0.0;
+}
+
+FramePacer::FramePacer()
+    : mode_(VSYNC), swap_interval_(1),
+      frame_period_(std::chrono::steady_clock::duration::zero()),
+      refresh_period_(0.0), peak_frame_time_(0.0) {}
+
+bool FramePacer::Initialize(const FramePacingMode mode,
+                            const double target_frame_rate,
+                            std::string* error_info_log) {
+  mode_ = mode;
+  switch (mode) {
+    case UNCAPPED:
+    case FRAME_LIMITER:
+      swap_interval_ = 0;
+      break;
+    case VSYNC:
+    case JUST_IN_TIME:
+      swap_interval_ = 1;
+      break;
+    case ADAPTIVE_VSYNC:
+      // A negative interval enables the late swaps to tear.
+      if (glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+          glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+        swap_interval_ = -1;
+      } else {
+        mode_ = VSYNC;
+        swap_interval_ = 1;
+      }
+      break;
+  }
+  if (mode == FRAME_LIMITER || mode == JUST_IN_TIME) {
+    if (target_frame_rate <= 0.0) {
+      *error_info_log = "The frame pacing needs a positive frame rate.";
+      return false;
+    }
+    frame_period_ = std::chrono::duration_cast<
+        std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / target_frame_rate));
+  }
+  next_frame_time_ = std::chrono::steady_clock::time_point();
+  last_swap_time_ = std::chrono::steady_clock::time_point();
+  frame_start_time_ = std::chrono::steady_clock::now();
+  refresh_period_ = std::chrono::duration<double>(
+      target_frame_rate > 0.0 ? 1.0 / target_frame_rate : 0.0);
+  peak_frame_time_ = std::chrono::duration<double>::zero();
+  statistics_ = FramePacingStatistics();
+  statistics_.refresh_rate = target_frame_rate;
+  glfwSwapInterval(swap_interval_);
+  return true;
+}
+
+void FramePacer::SetRefreshRate(const double refresh_rate) {
+  if (refresh_rate <= 0.0) return;
+  refresh_period_ = std::chrono::duration<double>(1.0 / refresh_rate);
+  statistics_.refresh_rate = refresh_rate;
+}
+
+void FramePacer::WaitUntil(const std::chrono::steady_clock::time_point time) {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  // Waiting for events instead of sleeping processes the input that arrives
+  // meanwhile, so it is not held until the next frame.
+  while (now + kSpinDuration < time) {
+    const std::chrono::duration<double> timeout = time - kSpinDuration - now;
+    glfwWaitEventsTimeout(timeout.count());
+    now = std::chrono::steady_clock::now();
+  }
+  while (std::chrono::steady_clock::now() < time) {
+    std::this_thread::yield();
+  }
+}
+
+void FramePacer::WaitForFrame() {
+  if (mode_ == JUST_IN_TIME) {
+    const std::chrono::duration<double> frame_time =
+        std::chrono::steady_clock::now() - frame_start_time_;
+    peak_frame_time_ = std::max(frame_time,
+                                (1.0 - kPeakFrameTimeDecay) * peak_frame_time_);
+    return;
+  }
+  if (mode_ != FRAME_LIMITER) return;
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  // Frames later than a whole period restart the schedule, instead of
+  // presenting a burst of frames to catch up.
+  if (next_frame_time_ == std::chrono::steady_clock::time_point() ||
+      now > next_frame_time_ + frame_period_) {
+    next_frame_time_ = now;
+  }
+  WaitUntil(next_frame_time_);
+  next_frame_time_ += frame_period_;
+}
+
+void FramePacer::EndFrame() {
+  if (mode_ != JUST_IN_TIME) return;
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  if (last_swap_time_ != std::chrono::steady_clock::time_point()) {
+    const std::chrono::duration<double> interval = now - last_swap_time_;
+    const double periods = interval / refresh_period_;
+    // The intervals of about a period measure it, e.g., 59.94 Hz instead of
+    // the 60 Hz of the video mode.
+    if (std::abs(periods - 1.0) < kRefreshPeriodTolerance) {
+      refresh_period_ += kRefreshPeriodWeight * (interval - refresh_period_);
+      statistics_.refresh_rate = 1.0 / refresh_period_.count();
+    } else if (periods > 1.0 + 2.0 * kRefreshPeriodTolerance) {
+      ++statistics_.num_missed_vblanks;
+    }
+  }
+  last_swap_time_ = now;
+}
+
+void FramePacer::WaitForFrameStart() {
+  if (mode_ != JUST_IN_TIME) return;
+  const std::chrono::duration<double> budget =
+      peak_frame_time_ + kJustInTimeMargin;
+  statistics_.frame_budget_ms = 1000.0 * budget.count();
+  // The next blank is a period after the one the last swap returned at. A
+  // frame longer than a period starts right away.
+  if (budget < refresh_period_ &&
+      last_swap_time_ != std::chrono::steady_clock::time_point()) {
+    WaitUntil(last_swap_time_ + std::chrono::duration_cast<
+        std::chrono::steady_clock::duration>(refresh_period_ - budget));
+  }
+  frame_start_time_ = std::chrono::steady_clock::now();
+}
+
+}  // namespace wvu
@@ -0,0 +1,184 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_FRAME_PACER_H_
+#define GLUTILS_FRAME_PACER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <GLFW/glfw3.h>
+
+namespace wvu {
+// How the presentation of the frames is paced.
+enum FramePacingMode {
+  // No synchronization: lowest latency, tearing and highest power use.
+  UNCAPPED = 0,
+  // Swaps wait for the vertical blank.
+  VSYNC = 1,
+  // Swaps wait for the vertical blank unless the frame is late, in which case
+  // they tear instead of waiting for the next one (EXT_swap_control_tear).
+  // Falls back to VSYNC when the extension is not available.
+  ADAPTIVE_VSYNC = 2,
+  // No vertical synchronization, and the CPU waits until the target frame
+  // time before swapping.
+  FRAME_LIMITER = 3,
+  // Swaps wait for the vertical blank, and the CPU delays the start of the
+  // frames until the predicted vertical blank minus the expected frame time,
+  // so the input is sampled as late as possible without missing a blank.
+  JUST_IN_TIME = 4,
+};
+
+// Parses the names "uncapped", "vsync", "adaptive_vsync", "frame_limiter" and
+// "just_in_time".
+// Returns false if the name is not a mode.
+bool ParseFramePacingMode(const std::string& name, FramePacingMode* mode);
+
+// Returns the name of a mode, as parsed by ParseFramePacingMode().
+const char* FramePacingModeName(const FramePacingMode mode);
+
+// Returns the refresh rate in Hz of the monitor of a window: the monitor of a
+// full screen window, or else the one containing the center of the window, or
+// the primary one. Returns 0 if the rate is unknown.
+double MonitorRefreshRate(GLFWwindow* window);
+
+// Counters of the just-in-time pacing.
+struct FramePacingStatistics {
+  // The refresh rate measured from the intervals between the swaps.
+  double refresh_rate = 0.0;
+  // The time reserved for a frame before the predicted vertical blank.
+  double frame_budget_ms = 0.0;
+  // The frames that presented more than half a period after their blank.
+  int64_t num_missed_vblanks = 0;
+};
+
+// This class applies a frame pacing mode to the current GLFW context. The
+// frame limiter waits for events with glfwWaitEventsTimeout() until shortly
+// before the target time, since the waits overshoot by up to the scheduler
+// granularity, and spins the remainder, so the frames are presented at a
+// precise period without saturating the CPU. The input that arrives during
+// the wait is processed right away.
+//
+// The just-in-time pacing starts from the refresh rate of the monitor, and
+// refines it with the intervals between the swaps, which return right after
+// the vertical blanks when they wait for them. The start of the next frame is
+// delayed until the predicted blank minus the recent peak of the frame times
+// and a margin, so that a frame handles input that is less than a period old.
+// The peak decays slowly, and a missed blank shows in it the next frame.
+//
+// Example:
+//
+// wvu::FramePacer frame_pacer;
+// frame_pacer.Initialize(wvu::FRAME_LIMITER, 60.0, &error_info_log);
+// while (...) {  // Rendering loop.
+//   ...  // Render the frame.
+//   frame_pacer.WaitForFrame();
+//   glfwSwapBuffers(window);
+//   frame_pacer.EndFrame();
+//   frame_pacer.WaitForFrameStart();
+//   glfwPollEvents();
+// }
+class FramePacer {
+ public:
+  FramePacer();
+  ~FramePacer() {}
+
+  // Sets the swap interval of the current context for the mode. Returns true
+  // if successful.
+  // Parameters:
+  //   mode  The pacing mode.
+  //   target_frame_rate  The frames per second of the frame limiter, and the
+  //     refresh rate assumed by the just-in-time pacing until SetRefreshRate()
+  //     is called. Ignored by the other modes.
+  bool Initialize(const FramePacingMode mode,
+                  const double target_frame_rate,
+                  std::string* error_info_log);
+
+  // Sets the refresh rate of the display, e.g., MonitorRefreshRate(), which
+  // the just-in-time pacing refines from then on. Rates of 0 are ignored.
+  void SetRefreshRate(const double refresh_rate);
+
+  // Waits until the target time of the frame with the frame limiter,
+  // processing the window events meanwhile. Called before the swap. The
+  // just-in-time pacing records the end of the frame work instead. Does
+  // nothing in the other modes, where the swap waits instead.
+  void WaitForFrame();
+
+  // Records the time the swap returned. Called right after the swap.
+  void EndFrame();
+
+  // Waits until the just-in-time start of the next frame, processing the
+  // window events meanwhile. Called before polling the input of the next
+  // frame. Does nothing in the other modes.
+  void WaitForFrameStart();
+
+  // Returns the mode in use, which is VSYNC when ADAPTIVE_VSYNC is not
+  // supported.
+  FramePacingMode mode() const {
+    return mode_;
+  }
+
+  int swap_interval() const {
+    return swap_interval_;
+  }
+
+  const FramePacingStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // Waits for events until shortly before a time, and spins the remainder.
+  void WaitUntil(const std::chrono::steady_clock::time_point time);
+
+  FramePacingMode mode_;
+  int swap_interval_;
+  std::chrono::steady_clock::duration frame_period_;
+  // Target time of the next frame, or the epoch before the first frame.
+  std::chrono::steady_clock::time_point next_frame_time_;
+  // The just-in-time pacing state: the estimated refresh period, the return
+  // of the last swap, the start of the work of the frame, and the decaying
+  // peak of the frame work.
+  std::chrono::duration<double> refresh_period_;
+  std::chrono::steady_clock::time_point last_swap_time_;
+  std::chrono::steady_clock::time_point frame_start_time_;
+  std::chrono::duration<double> peak_frame_time_;
+  FramePacingStatistics statistics_;
+
+  FramePacer(const FramePacer&) = delete;
+  FramePacer& operator=(const FramePacer&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_FRAME_PACER_H_
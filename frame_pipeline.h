@@ -0,0 +1,203 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_FRAME_PIPELINE_H_
+#define GLUTILS_FRAME_PIPELINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "fixed_timestep.h"
+
+namespace wvu {
+// This class runs the simulation on its own thread and hands its results to
+// the render thread as immutable frame packets, so the update work of a frame
+// overlaps with the draw submission of the previous one. The packets live in
+// a triple buffer: the simulation writes one packet, the render thread reads
+// another, and the third holds the latest published packet. Neither side ever
+// waits for the other: the simulation overwrites the published packet if the
+// render thread did not take it yet, and the render thread keeps reading its
+// packet until a newer one is published.
+// The simulation thread steps at a fixed rate (see FixedTimestep), and
+// publishes a packet after the steps of each wake-up. A packet holds whatever
+// the render thread needs, e.g., transforms and draw lists, and must not
+// point into the simulation state, which keeps changing.
+//
+// Example:
+//
+// struct Packet {
+//   double simulation_time;
+//   InstanceTransforms transforms;
+// };
+// wvu::FramePipeline<Packet> pipeline;
+// pipeline.Start(1.0 / 60.0, [&](const double time, const double step,
+//                               Packet* packet) {
+//   Simulate(step, &scene);  // Owned by the simulation thread.
+//   packet->simulation_time = time;
+//   scene.GetTransforms(&packet->transforms);
+// });
+// while (...) {  // Rendering loop.
+//   const Packet* packet = pipeline.AcquireLatestPacket();
+//   if (packet != nullptr) Render(*packet);
+// }
+// pipeline.Stop();
+template <typename PacketType>
+class FramePipeline {
+ public:
+  // Advances the simulation owned by the callback by one step of step
+  // seconds, ending at time (see FramePipeline::time()), and writes it into
+  // the packet. The packet holds the data of an older step, so the callback
+  // must overwrite all of it.
+  typedef std::function<void(const double time,
+                             const double step,
+                             PacketType* packet)> SimulateFunction;
+
+  FramePipeline()
+      : write_index_(0), ready_index_(1), read_index_(2), ready_is_new_(false),
+        has_packet_(false), num_published_packets_(0), stop_(false) {}
+  ~FramePipeline() {
+    Stop();
+  }
+
+  // Starts the simulation thread. Returns false if it is already running.
+  // Parameters:
+  //   step  The duration of a simulation step in seconds.
+  //   simulate  Called on the simulation thread for every step.
+  bool Start(const double step, SimulateFunction simulate) {
+    if (thread_.joinable() || step <= 0.0) return false;
+    step_ = step;
+    simulate_ = std::move(simulate);
+    stop_ = false;
+    start_time_ = std::chrono::steady_clock::now();
+    thread_ = std::thread(&FramePipeline::Run, this);
+    return true;
+  }
+
+  // Stops and joins the simulation thread.
+  void Stop() {
+    stop_ = true;
+    if (thread_.joinable()) thread_.join();
+  }
+
+  // Returns the latest published packet, or nullptr if none was published
+  // yet. The packet does not change until the next call. Must only be called
+  // by one thread.
+  const PacketType* AcquireLatestPacket() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ready_is_new_) {
+      std::swap(read_index_, ready_index_);
+      ready_is_new_ = false;
+      has_packet_ = true;
+    }
+    return has_packet_ ? &packets_[read_index_] : nullptr;
+  }
+
+  // Returns the seconds since Start(), the clock of the simulation.
+  double time() const {
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start_time_;
+    return elapsed.count();
+  }
+
+  double step() const {
+    return step_;
+  }
+
+  int64_t num_published_packets() const {
+    return num_published_packets_;
+  }
+
+ private:
+  // Body of the simulation thread.
+  void Run() {
+    typedef std::chrono::steady_clock Clock;
+    const uint64_t frequency = Clock::period::den / Clock::period::num;
+    FixedTimestep timestep(step_);
+    timestep.Advance(Clock::now().time_since_epoch().count(), frequency);
+    while (!stop_) {
+      const int num_steps =
+          timestep.Advance(Clock::now().time_since_epoch().count(), frequency);
+      if (num_steps > 0) {
+        const double first_step_time =
+            timestep.simulation_time() - (num_steps - 1) * step_;
+        for (int i = 0; i < num_steps; ++i) {
+          simulate_(first_step_time + i * step_, step_,
+                    &packets_[write_index_]);
+        }
+        Publish();
+      }
+      // Sleep until the end of the next step.
+      std::this_thread::sleep_for(
+          std::chrono::duration<double>((1.0 - timestep.alpha()) * step_));
+    }
+  }
+
+  // Makes the written packet the latest one.
+  void Publish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(write_index_, ready_index_);
+    ready_is_new_ = true;
+    ++num_published_packets_;
+  }
+
+  PacketType packets_[3];
+  // Indices of the packets written by the simulation, published, and read by
+  // the render thread. Guarded by mutex_.
+  int write_index_;
+  int ready_index_;
+  int read_index_;
+  // True if the published packet was not acquired yet.
+  bool ready_is_new_;
+  // True once the render thread acquired a packet.
+  bool has_packet_;
+  std::atomic<int64_t> num_published_packets_;
+  std::mutex mutex_;
+  double step_;
+  SimulateFunction simulate_;
+  std::chrono::steady_clock::time_point start_time_;
+  std::atomic<bool> stop_;
+  std::thread thread_;
+
+  FramePipeline(const FramePipeline&) = delete;
+  FramePipeline& operator=(const FramePipeline&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_FRAME_PIPELINE_H_
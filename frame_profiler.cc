@@ -0,0 +1,349 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "frame_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "allocation_tracker.h"
+
+namespace wvu {
+namespace {
+// Percentile of the samples reported as the duration of the slow frames.
+constexpr double kSlowFramePercentile = 0.99;
+
+// Trace thread ids of the CPU and GPU tracks.
+constexpr int kCpuTrackId = 0;
+constexpr int kGpuTrackId = 1;
+
+// Returns the string as a JSON string literal.
+std::string JsonString(const std::string& value) {
+  std::string literal = "\"";
+  for (const char c : value) {
+    if (c == '"' || c == '\\') literal += '\\';
+    literal += c;
+  }
+  return literal + "\"";
+}
+
+}  // namespace
+
+FrameProfiler::FrameProfiler(const int history_size,
+                             const int gpu_query_latency)
+    : history_size_(std::max(history_size, 1)),
+      gpu_query_latency_(std::max(gpu_query_latency, 1)),
+      gpu_timing_supported_(GLEW_VERSION_3_3 || GLEW_ARB_timer_query),
+      frame_slot_(-1),
+      num_dropped_gpu_samples_(0),
+      frame_(-1),
+      frame_allocations_begin_(0),
+      num_frame_allocations_(0),
+      cpu_epoch_(std::chrono::steady_clock::now()),
+      gpu_epoch_(0),
+      capture_first_frame_(0),
+      capture_end_frame_(0) {
+  // Reading the GPU timestamp does not wait for the pending commands, so it is
+  // taken at about the same time as the CPU one.
+  if (gpu_timing_supported_) glGetInteger64v(GL_TIMESTAMP, &gpu_epoch_);
+}
+
+FrameProfiler::~FrameProfiler() {
+  for (Scope& scope : scopes_) {
+    for (GpuQueries& queries : scope.gpu_queries) {
+      glDeleteQueries(1, &queries.begin_query);
+      glDeleteQueries(1, &queries.end_query);
+    }
+  }
+}
+
+int FrameProfiler::AddCpuScope(const std::string& name) {
+  Scope scope;
+  scope.name = name;
+  scope.samples.resize(history_size_);
+  scope.allocation_samples.resize(history_size_);
+  scopes_.push_back(scope);
+  return scopes_.size() - 1;
+}
+
+int FrameProfiler::AddGpuScope(const std::string& name) {
+  Scope scope;
+  scope.name = name;
+  scope.gpu = true;
+  scope.samples.resize(history_size_);
+  scope.allocation_samples.resize(history_size_);
+  if (gpu_timing_supported_) {
+    // The queries of a frame are reused gpu_query_latency frames later.
+    scope.gpu_queries.resize(gpu_query_latency_);
+    for (GpuQueries& queries : scope.gpu_queries) {
+      glGenQueries(1, &queries.begin_query);
+      glGenQueries(1, &queries.end_query);
+    }
+  }
+  scopes_.push_back(scope);
+  return scopes_.size() - 1;
+}
+
+void FrameProfiler::BeginFrame() {
+  const int64_t num_allocations = NumAllocations();
+  if (frame_ >= 0) {
+    num_frame_allocations_ = num_allocations - frame_allocations_begin_;
+  }
+  frame_allocations_begin_ = num_allocations;
+  ++frame_;
+  frame_slot_ = (frame_slot_ + 1) % gpu_query_latency_;
+  // The queries of the slot were issued gpu_query_latency frames ago.
+  for (int i = 0; i < static_cast<int>(scopes_.size()); ++i) {
+    if (!scopes_[i].gpu_queries.empty()) {
+      CollectGpuSample(i, &scopes_[i].gpu_queries[frame_slot_]);
+    }
+  }
+}
+
+void FrameProfiler::BeginScope(const int scope_id) {
+  Scope& scope = scopes_[scope_id];
+  if (!scope.gpu) {
+    scope.allocations_begin = NumAllocations();
+    scope.cpu_begin = std::chrono::steady_clock::now();
+    return;
+  }
+  if (scope.gpu_queries.empty() || frame_slot_ < 0) return;
+  // Timestamps record when the GPU reaches the command, without stalling the
+  // CPU.
+  glQueryCounter(scope.gpu_queries[frame_slot_].begin_query, GL_TIMESTAMP);
+}
+
+void FrameProfiler::EndScope(const int scope_id) {
+  Scope& scope = scopes_[scope_id];
+  if (!scope.gpu) {
+    const std::chrono::steady_clock::time_point cpu_end =
+        std::chrono::steady_clock::now();
+    const std::chrono::duration<float, std::milli> duration =
+        cpu_end - scope.cpu_begin;
+    AddSample(duration.count(),
+              static_cast<int>(NumAllocations() - scope.allocations_begin),
+              &scope);
+    if (IsCaptured(frame_)) {
+      const std::chrono::duration<double, std::micro> begin =
+          scope.cpu_begin - cpu_epoch_;
+      const std::chrono::duration<double, std::micro> duration_us =
+          cpu_end - scope.cpu_begin;
+      captured_scopes_.push_back(CapturedScope{
+        scope_id, frame_, begin.count(), duration_us.count()});
+    }
+    return;
+  }
+  if (scope.gpu_queries.empty() || frame_slot_ < 0) return;
+  GpuQueries& queries = scope.gpu_queries[frame_slot_];
+  glQueryCounter(queries.end_query, GL_TIMESTAMP);
+  queries.pending = true;
+  queries.frame = frame_;
+}
+
+void FrameProfiler::AddCpuSample(const int scope, const float milliseconds) {
+  AddSample(milliseconds, 0, &scopes_[scope]);
+}
+
+int FrameProfiler::AddCounter(const std::string& name) {
+  counter_names_.push_back(name);
+  return counter_names_.size() - 1;
+}
+
+void FrameProfiler::SetCounter(const int counter, const double value) {
+  if (!IsCaptured(frame_)) return;
+  const std::chrono::duration<double, std::micro> time =
+      std::chrono::steady_clock::now() - cpu_epoch_;
+  captured_counters_.push_back(CapturedCounter{counter, time.count(), value});
+}
+
+float FrameProfiler::LatestSample(const int scope_id) const {
+  const Scope& scope = scopes_[scope_id];
+  if (scope.num_samples == 0) return -1.0f;
+  return scope.samples[(scope.next_sample + history_size_ - 1) %
+                       history_size_];
+}
+
+void FrameProfiler::AddSample(const float milliseconds,
+                              const int num_allocations,
+                              Scope* scope) {
+  scope->samples[scope->next_sample] = milliseconds;
+  scope->allocation_samples[scope->next_sample] = num_allocations;
+  scope->next_sample = (scope->next_sample + 1) % history_size_;
+  scope->num_samples = std::min(scope->num_samples + 1, history_size_);
+}
+
+void FrameProfiler::CollectGpuSample(const int scope_id,
+                                     GpuQueries* queries) {
+  if (!queries->pending) return;
+  queries->pending = false;
+  // The end timestamp is available after the begin one.
+  GLint available = GL_FALSE;
+  glGetQueryObjectiv(queries->end_query, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (available == GL_FALSE) {
+    ++num_dropped_gpu_samples_;
+    return;
+  }
+  GLuint64 begin_time = 0;
+  GLuint64 end_time = 0;
+  glGetQueryObjectui64v(queries->begin_query, GL_QUERY_RESULT, &begin_time);
+  glGetQueryObjectui64v(queries->end_query, GL_QUERY_RESULT, &end_time);
+  // The timestamps are in nanoseconds.
+  AddSample(static_cast<float>(end_time - begin_time) * 1e-6f, 0,
+            &scopes_[scope_id]);
+  if (IsCaptured(queries->frame)) {
+    captured_scopes_.push_back(CapturedScope{
+      scope_id, queries->frame,
+      static_cast<double>(static_cast<GLint64>(begin_time) - gpu_epoch_) *
+          1e-3,
+      static_cast<double>(end_time - begin_time) * 1e-3});
+  }
+}
+
+void FrameProfiler::GetStatistics(
+    std::vector<ProfileScopeStatistics>* statistics) const {
+  statistics->clear();
+  statistics->reserve(scopes_.size());
+  std::vector<float> samples;
+  for (const Scope& scope : scopes_) {
+    ProfileScopeStatistics scope_statistics;
+    scope_statistics.name = scope.name;
+    scope_statistics.gpu = scope.gpu;
+    scope_statistics.num_samples = scope.num_samples;
+    if (scope.num_samples > 0) {
+      samples.assign(scope.samples.begin(),
+                     scope.samples.begin() + scope.num_samples);
+      std::sort(samples.begin(), samples.end());
+      double sum = 0.0;
+      for (const float sample : samples) sum += sample;
+      const int p99_index = static_cast<int>(
+          std::ceil(kSlowFramePercentile * samples.size())) - 1;
+      scope_statistics.min_ms = samples.front();
+      scope_statistics.average_ms = sum / samples.size();
+      scope_statistics.p99_ms = samples[p99_index];
+      scope_statistics.max_ms = samples.back();
+      scope_statistics.max_allocations = *std::max_element(
+          scope.allocation_samples.begin(),
+          scope.allocation_samples.begin() + scope.num_samples);
+    }
+    statistics->push_back(scope_statistics);
+  }
+}
+
+std::string FrameProfiler::Report() const {
+  std::vector<ProfileScopeStatistics> statistics;
+  GetStatistics(&statistics);
+  std::ostringstream report;
+  report << std::fixed << std::setprecision(3);
+  for (const ProfileScopeStatistics& scope : statistics) {
+    report << "\n  " << scope.name << (scope.gpu ? " (gpu)" : " (cpu)")
+           << ": avg " << scope.average_ms << " ms, min " << scope.min_ms
+           << " ms, p99 " << scope.p99_ms << " ms, max " << scope.max_ms
+           << " ms over " << scope.num_samples << " frames.";
+    if (AllocationTrackingEnabled() && !scope.gpu) {
+      report << " At most " << scope.max_allocations
+             << " allocations per frame.";
+    }
+  }
+  return report.str();
+}
+
+void FrameProfiler::StartCapture(const int num_frames) {
+  captured_scopes_.clear();
+  captured_counters_.clear();
+  capture_first_frame_ = frame_ + 1;
+  capture_end_frame_ = capture_first_frame_ + std::max(num_frames, 0);
+}
+
+bool FrameProfiler::WriteChromeTrace(const std::string& filepath,
+                                     std::string* error_info_log) {
+  const std::string temporary_filepath = filepath + ".tmp";
+  std::ofstream out(temporary_filepath);
+  if (!out.is_open()) {
+    *error_info_log = "Could not open " + temporary_filepath;
+    return false;
+  }
+  // Complete events ("ph": "X") carry their duration, and the metadata events
+  // name the tracks.
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+      << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": "
+      << kCpuTrackId << ", \"args\": {\"name\": \"CPU\"}},\n"
+      << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": "
+      << kGpuTrackId << ", \"args\": {\"name\": \"GPU\"}}";
+  for (const CapturedScope& captured_scope : captured_scopes_) {
+    const Scope& scope = scopes_[captured_scope.scope];
+    out << ",\n{\"name\": " << JsonString(scope.name)
+        << ", \"cat\": " << (scope.gpu ? "\"gpu\"" : "\"cpu\"")
+        << ", \"ph\": \"X\", \"pid\": 0, \"tid\": "
+        << (scope.gpu ? kGpuTrackId : kCpuTrackId)
+        << ", \"ts\": " << captured_scope.begin_us
+        << ", \"dur\": " << captured_scope.duration_us
+        << ", \"args\": {\"frame\": " << captured_scope.frame << "}}";
+  }
+  // Counter events ("ph": "C") are drawn as graphs above the tracks.
+  for (const CapturedCounter& captured_counter : captured_counters_) {
+    out << ",\n{\"name\": "
+        << JsonString(counter_names_[captured_counter.counter])
+        << ", \"ph\": \"C\", \"pid\": 0, \"ts\": " << captured_counter.time_us
+        << ", \"args\": {\"value\": " << captured_counter.value << "}}";
+  }
+  out << "\n]}\n";
+  out.close();
+  if (!out) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + temporary_filepath;
+    return false;
+  }
+  if (std::rename(temporary_filepath.c_str(), filepath.c_str()) != 0) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not rename " + temporary_filepath;
+    return false;
+  }
+  captured_scopes_.clear();
+  captured_counters_.clear();
+  capture_first_frame_ = 0;
+  capture_end_frame_ = 0;
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,300 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_FRAME_PROFILER_H_
+#define GLUTILS_FRAME_PROFILER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+// Default number of frames whose samples are kept per scope.
+constexpr int kDefaultProfileHistorySize = 240;
+
+// Default number of frames between issuing the GPU queries of a frame and
+// reading their results. The results are usually available by then, so the
+// read does not stall the pipeline.
+constexpr int kDefaultGpuQueryLatency = 3;
+
+// Statistics of the samples of a scope in the history, in milliseconds.
+struct ProfileScopeStatistics {
+  std::string name;
+  // True if the scope measures GPU time.
+  bool gpu = false;
+  int num_samples = 0;
+  double min_ms = 0.0;
+  double average_ms = 0.0;
+  // The 99th percentile, i.e., the duration of the slow frames.
+  double p99_ms = 0.0;
+  double max_ms = 0.0;
+  // The most allocations of a CPU scope in a frame of the history. Zero unless
+  // the allocations are tracked (see allocation_tracker.h).
+  int max_allocations = 0;
+};
+
+// This class measures where the time of the frames goes. CPU scopes are timed
+// with std::chrono::steady_clock. GPU scopes are timed with GL_TIMESTAMP
+// queries (OpenGL 3.3 or ARB_timer_query), which, unlike GL_TIME_ELAPSED
+// queries, may be nested. The queries of a frame are read latency frames
+// later, when the GPU has usually finished the frame; the samples that are
+// still not available then are dropped instead of waiting for them. Each scope
+// keeps the samples of the last history_size frames. When the allocations are
+// tracked (see allocation_tracker.h), the CPU scopes and the frames also count
+// the allocations made during them, on all the threads.
+//
+// Example:
+//
+// wvu::FrameProfiler profiler;
+// const int update_scope = profiler.AddCpuScope("update");
+// const int render_scope = profiler.AddGpuScope("render");
+// while (...) {  // Rendering loop.
+//   profiler.BeginFrame();
+//   {
+//     wvu::ScopedProfile profile(&profiler, update_scope);
+//     ...  // Update the scene.
+//   }
+//   profiler.BeginScope(render_scope);
+//   ...  // Draws.
+//   profiler.EndScope(render_scope);
+// }
+// LOG(INFO) << profiler.Report();
+//
+// The scopes of a window of frames can also be captured with their start
+// times and written as a chrome://tracing (or Perfetto) JSON trace, with the
+// CPU and the GPU scopes on separate tracks:
+//
+// profiler.StartCapture(num_frames);
+// ...  // Render the frames.
+// if (profiler.capture_complete()) {
+//   profiler.WriteChromeTrace("frames.json", &error_info_log);
+// }
+class FrameProfiler {
+ public:
+  // The context must be current, since the support of timer queries is
+  // checked here.
+  // Parameters:
+  //   history_size  The number of frames whose samples are kept per scope.
+  //   gpu_query_latency  The number of frames before the GPU queries of a
+  //     frame are read.
+  explicit FrameProfiler(const int history_size = kDefaultProfileHistorySize,
+                         const int gpu_query_latency = kDefaultGpuQueryLatency);
+  ~FrameProfiler();
+
+  // Adds a scope timed on the CPU. Returns the id of the scope.
+  int AddCpuScope(const std::string& name);
+
+  // Adds a scope timed on the GPU. Creates its queries, so the context must be
+  // current. Returns the id of the scope.
+  int AddGpuScope(const std::string& name);
+
+  // Starts a frame, collecting the GPU samples of the frame issued latency
+  // frames ago.
+  void BeginFrame();
+
+  // Starts and stops timing a scope. A scope is timed at most once per frame.
+  void BeginScope(const int scope);
+  void EndScope(const int scope);
+
+  // Adds a sample measured elsewhere to a CPU scope, e.g., the time the job
+  // system spent running jobs on all its threads in the frame.
+  void AddCpuSample(const int scope, const float milliseconds);
+
+  // Adds a counter, e.g., the number of OpenGL calls of the frame, whose
+  // values are written to the trace of the captured frames. Returns the id of
+  // the counter.
+  int AddCounter(const std::string& name);
+
+  // Sets the value of a counter at the current time. The values are only kept
+  // in the captured frames.
+  void SetCounter(const int counter, const double value);
+
+  // Returns the last sample of a scope in milliseconds, or a negative value if
+  // the scope has no samples. The last sample of a GPU scope times the frame
+  // issued gpu_query_latency frames ago.
+  float LatestSample(const int scope) const;
+
+  // Computes the statistics of every scope, in the order they were added.
+  void GetStatistics(std::vector<ProfileScopeStatistics>* statistics) const;
+
+  // Returns a table of the statistics of the scopes.
+  std::string Report() const;
+
+  // Starts capturing the scopes of the next num_frames frames, discarding the
+  // previous capture. The GPU scopes of a frame are captured when their
+  // queries are read, so the capture completes gpu_query_latency frames after
+  // the last captured frame.
+  void StartCapture(const int num_frames);
+
+  // Returns true while a capture has frames or GPU queries left.
+  bool capturing() const {
+    return capture_end_frame_ > capture_first_frame_ &&
+        frame_ < capture_end_frame_ + gpu_query_latency_;
+  }
+
+  // Returns true if a capture finished and has not been written yet.
+  bool capture_complete() const {
+    return capture_end_frame_ > capture_first_frame_ && !capturing();
+  }
+
+  // Writes the captured scopes and counters as a Chrome trace event JSON file,
+  // and clears the capture. The GPU timestamps are aligned to the CPU clock at
+  // the creation of the profiler. Returns true if successful.
+  bool WriteChromeTrace(const std::string& filepath,
+                        std::string* error_info_log);
+
+  // Returns the number of allocations of the last complete frame, from its
+  // BeginFrame() to the next one.
+  int64_t num_frame_allocations() const {
+    return num_frame_allocations_;
+  }
+
+  // Returns true if the GPU scopes are timed. Timer queries need OpenGL 3.3 or
+  // ARB_timer_query.
+  bool gpu_timing_supported() const {
+    return gpu_timing_supported_;
+  }
+
+  // Returns the number of GPU samples dropped because their queries were not
+  // available after the latency.
+  int num_dropped_gpu_samples() const {
+    return num_dropped_gpu_samples_;
+  }
+
+ private:
+  // The queries of a GPU scope in a frame.
+  struct GpuQueries {
+    GLuint begin_query = 0;
+    GLuint end_query = 0;
+    // True if both timestamps were issued and not read yet.
+    bool pending = false;
+    // Frame that issued the queries.
+    int64_t frame = 0;
+  };
+
+  // A scope of a captured frame. The times are in microseconds since the
+  // creation of the profiler.
+  struct CapturedScope {
+    int scope;
+    int64_t frame;
+    double begin_us;
+    double duration_us;
+  };
+
+  // A value of a counter in a captured frame.
+  struct CapturedCounter {
+    int counter;
+    double time_us;
+    double value;
+  };
+
+  struct Scope {
+    std::string name;
+    bool gpu = false;
+    // Samples in milliseconds, in a circular buffer.
+    std::vector<float> samples;
+    int num_samples = 0;
+    int next_sample = 0;
+    // Allocations of the CPU samples, in the same circular buffer.
+    std::vector<int> allocation_samples;
+    std::chrono::steady_clock::time_point cpu_begin;
+    int64_t allocations_begin = 0;
+    // One set of queries per frame in flight.
+    std::vector<GpuQueries> gpu_queries;
+  };
+
+  // Adds a sample to the history of the scope.
+  void AddSample(const float milliseconds,
+                 const int num_allocations,
+                 Scope* scope);
+
+  // Reads the queries of a frame slot of a GPU scope, if they are pending.
+  void CollectGpuSample(const int scope_id, GpuQueries* queries);
+
+  // Returns true if the scopes of the frame are captured.
+  bool IsCaptured(const int64_t frame) const {
+    return frame >= capture_first_frame_ && frame < capture_end_frame_;
+  }
+
+  const int history_size_;
+  const int gpu_query_latency_;
+  std::vector<Scope> scopes_;
+  bool gpu_timing_supported_;
+  // Slot of the queries of the current frame, or -1 before the first frame.
+  int frame_slot_;
+  int num_dropped_gpu_samples_;
+  // Number of the current frame, or -1 before the first frame.
+  int64_t frame_;
+  // Allocation counter at the last BeginFrame(), and the allocations of the
+  // last complete frame.
+  int64_t frame_allocations_begin_;
+  int64_t num_frame_allocations_;
+  // Clocks at the creation of the profiler, the origin of the captured times.
+  std::chrono::steady_clock::time_point cpu_epoch_;
+  GLint64 gpu_epoch_;
+  // The frames [capture_first_frame_, capture_end_frame_) are captured.
+  int64_t capture_first_frame_;
+  int64_t capture_end_frame_;
+  std::vector<CapturedScope> captured_scopes_;
+  std::vector<std::string> counter_names_;
+  std::vector<CapturedCounter> captured_counters_;
+
+  FrameProfiler(const FrameProfiler&) = delete;
+  FrameProfiler& operator=(const FrameProfiler&) = delete;
+};
+
+// Times a scope of a profiler during its lifetime.
+class ScopedProfile {
+ public:
+  ScopedProfile(FrameProfiler* profiler, const int scope)
+      : profiler_(profiler), scope_(scope) {
+    profiler_->BeginScope(scope_);
+  }
+  ~ScopedProfile() {
+    profiler_->EndScope(scope_);
+  }
+
+ private:
+  FrameProfiler* profiler_;
+  const int scope_;
+
+  ScopedProfile(const ScopedProfile&) = delete;
+  ScopedProfile& operator=(const ScopedProfile&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_FRAME_PROFILER_H_
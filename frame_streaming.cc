@@ -0,0 +1,351 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "frame_streaming.h"
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+
+#include "framebuffer_readback.h"
+#include "input_buffer.h"
+#include "lz4_block.h"
+
+namespace wvu {
+namespace {
+// Bytes of an RGBA pixel.
+constexpr int kBytesPerPixel = 4;
+
+// The types of the messages.
+enum StreamMessageType : uint32_t {
+  STREAM_FRAME_MESSAGE = 1,
+  STREAM_INPUT_MESSAGE = 2
+};
+
+struct StreamMessageHeader {
+  uint32_t type;
+  uint32_t size;
+};
+
+template <typename Type>
+void Append(const Type& value, std::vector<uint8_t>* bytes) {
+  const uint8_t* value_bytes = reinterpret_cast<const uint8_t*>(&value);
+  bytes->insert(bytes->end(), value_bytes, value_bytes + sizeof(value));
+}
+
+// Sends the bytes. With MSG_MORE in flags, the bytes wait for the next send,
+// so that a header leaves with its payload.
+bool SendAll(const int socket, const void* data, size_t size, const int flags) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  while (size > 0) {
+    const ssize_t sent = send(socket, bytes, size, MSG_NOSIGNAL | flags);
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    bytes += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+}  // namespace
+
+TileDeltaEncoder::TileDeltaEncoder(const int tile_size)
+    : tile_size_(tile_size), previous_width_(0), previous_height_(0) {}
+
+void TileDeltaEncoder::Reset() {
+  previous_pixels_.clear();
+}
+
+int TileDeltaEncoder::Encode(const int64_t frame,
+                             const int width,
+                             const int height,
+                             const GLubyte* pixels,
+                             std::vector<uint8_t>* encoded) {
+  const size_t size = static_cast<size_t>(width) * height * kBytesPerPixel;
+  if (width != previous_width_ || height != previous_height_) Reset();
+  const bool key_frame = previous_pixels_.empty();
+  if (key_frame) previous_pixels_.resize(size);
+  previous_width_ = width;
+  previous_height_ = height;
+  tiles_.clear();
+  const size_t row_size = static_cast<size_t>(width) * kBytesPerPixel;
+  uint32_t num_tiles = 0;
+  for (int row = 0; row * tile_size_ < height; ++row) {
+    const int y = row * tile_size_;
+    const int tile_height = std::min(tile_size_, height - y);
+    for (int column = 0; column * tile_size_ < width; ++column) {
+      const int x = column * tile_size_;
+      const size_t tile_row_size =
+          static_cast<size_t>(std::min(tile_size_, width - x)) *
+          kBytesPerPixel;
+      const size_t offset = y * row_size + x * kBytesPerPixel;
+      bool changed = key_frame;
+      for (int i = 0; !changed && i < tile_height; ++i) {
+        changed = std::memcmp(pixels + offset + i * row_size,
+                              previous_pixels_.data() + offset + i * row_size,
+                              tile_row_size) != 0;
+      }
+      if (!changed) continue;
+      ++num_tiles;
+      Append(static_cast<uint16_t>(column), &tiles_);
+      Append(static_cast<uint16_t>(row), &tiles_);
+      for (int i = 0; i < tile_height; ++i) {
+        const GLubyte* tile_row = pixels + offset + i * row_size;
+        tiles_.insert(tiles_.end(), tile_row, tile_row + tile_row_size);
+        std::memcpy(previous_pixels_.data() + offset + i * row_size, tile_row,
+                    tile_row_size);
+      }
+    }
+  }
+  encoded->clear();
+  Append(frame, encoded);
+  Append(static_cast<uint16_t>(width), encoded);
+  Append(static_cast<uint16_t>(height), encoded);
+  Append(static_cast<uint16_t>(tile_size_), encoded);
+  Append(num_tiles, encoded);
+  Append(static_cast<uint32_t>(tiles_.size()), encoded);
+  compressor_.Compress(tiles_.data(), tiles_.size(), &compressed_);
+  encoded->insert(encoded->end(), compressed_.begin(), compressed_.end());
+  return num_tiles;
+}
+
+FrameStreamServer::FrameStreamServer()
+    : listen_socket_(-1),
+      client_socket_(-1),
+      send_failed_(false),
+      key_frame_requested_(false),
+      pending_frame_(0),
+      pending_width_(0),
+      pending_height_(0),
+      has_pending_frame_(false),
+      stop_(false) {}
+
+FrameStreamServer::~FrameStreamServer() {
+  Stop();
+}
+
+bool FrameStreamServer::Start(const int port, std::string* error_info_log) {
+  Stop();
+  listen_socket_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_socket_ < 0) {
+    *error_info_log = std::string("Could not create the socket: ") +
+        std::strerror(errno) + ".";
+    return false;
+  }
+  const int reuse = 1;
+  setsockopt(listen_socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  // The main thread polls for clients, so the socket never blocks.
+  if (bind(listen_socket_, reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) < 0 ||
+      listen(listen_socket_, 1) < 0 ||
+      fcntl(listen_socket_, F_SETFL, O_NONBLOCK) < 0) {
+    *error_info_log = "Could not listen on port " + std::to_string(port) +
+        ": " + std::strerror(errno) + ".";
+    close(listen_socket_);
+    listen_socket_ = -1;
+    return false;
+  }
+  stop_ = false;
+  thread_ = std::thread(&FrameStreamServer::SendFrames, this);
+  return true;
+}
+
+void FrameStreamServer::Submit(const ReadbackFrame& frame) {
+  if (client_socket_ < 0) return;
+  const size_t size =
+      static_cast<size_t>(frame.width) * frame.height * kBytesPerPixel;
+  {
+    std::lock_guard<std::mutex> lock(frame_mutex_);
+    if (has_pending_frame_) {
+      std::lock_guard<std::mutex> statistics_lock(statistics_mutex_);
+      ++statistics_.num_dropped_frames;
+    }
+    pending_pixels_.assign(frame.pixels, frame.pixels + size);
+    pending_frame_ = frame.frame;
+    pending_width_ = frame.width;
+    pending_height_ = frame.height;
+    has_pending_frame_ = true;
+  }
+  frame_submitted_.notify_one();
+}
+
+void FrameStreamServer::PollInput(InputBuffer* input_buffer) {
+  if (listen_socket_ < 0) return;
+  if (client_socket_ >= 0 && send_failed_) Disconnect();
+  if (client_socket_ < 0) {
+    const int client_socket = accept(listen_socket_, nullptr, nullptr);
+    if (client_socket < 0) return;
+    const int enable = 1;
+    setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &enable,
+               sizeof(enable));
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    received_bytes_.clear();
+    send_failed_ = false;
+    key_frame_requested_ = true;
+    client_socket_ = client_socket;
+    std::lock_guard<std::mutex> statistics_lock(statistics_mutex_);
+    ++statistics_.num_clients;
+  }
+  // Reads what arrived without waiting, and keeps a partial message for the
+  // next poll.
+  uint8_t buffer[4096];
+  while (true) {
+    const ssize_t received =
+        recv(client_socket_, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (received < 0 && errno == EINTR) continue;
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if (received <= 0) {
+      Disconnect();
+      return;
+    }
+    received_bytes_.insert(received_bytes_.end(), buffer, buffer + received);
+  }
+  size_t offset = 0;
+  int64_t num_input_events = 0;
+  StreamMessageHeader header;
+  while (received_bytes_.size() - offset >= sizeof(header)) {
+    std::memcpy(&header, received_bytes_.data() + offset, sizeof(header));
+    if (header.type != STREAM_INPUT_MESSAGE ||
+        header.size != sizeof(StreamInputEvent)) {
+      Disconnect();
+      return;
+    }
+    if (received_bytes_.size() - offset < sizeof(header) + header.size) break;
+    StreamInputEvent stream_event;
+    std::memcpy(&stream_event, received_bytes_.data() + offset + sizeof(header),
+                sizeof(stream_event));
+    offset += sizeof(header) + header.size;
+    InputEvent event;
+    event.type = static_cast<InputEventType>(stream_event.type);
+    event.code = stream_event.code;
+    event.scancode = stream_event.scancode;
+    event.action = stream_event.action;
+    event.mods = stream_event.mods;
+    event.x = stream_event.x;
+    event.y = stream_event.y;
+    input_buffer->Inject(event);
+    ++num_input_events;
+  }
+  received_bytes_.erase(received_bytes_.begin(),
+                        received_bytes_.begin() + offset);
+  if (num_input_events > 0) {
+    std::lock_guard<std::mutex> statistics_lock(statistics_mutex_);
+    statistics_.num_input_events += num_input_events;
+  }
+}
+
+void FrameStreamServer::Stop() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(frame_mutex_);
+      stop_ = true;
+    }
+    frame_submitted_.notify_one();
+    // Unblocks a send to a stalled client.
+    if (client_socket_ >= 0) shutdown(client_socket_, SHUT_RDWR);
+    thread_.join();
+  }
+  Disconnect();
+  if (listen_socket_ >= 0) close(listen_socket_);
+  listen_socket_ = -1;
+}
+
+FrameStreamStatistics FrameStreamServer::statistics() const {
+  std::lock_guard<std::mutex> lock(statistics_mutex_);
+  return statistics_;
+}
+
+void FrameStreamServer::SendFrames() {
+  while (true) {
+    int64_t frame;
+    int width, height;
+    {
+      std::unique_lock<std::mutex> lock(frame_mutex_);
+      frame_submitted_.wait(lock,
+                            [this]() { return stop_ || has_pending_frame_; });
+      if (stop_) return;
+      pending_pixels_.swap(sent_pixels_);
+      frame = pending_frame_;
+      width = pending_width_;
+      height = pending_height_;
+      has_pending_frame_ = false;
+    }
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    if (client_socket_ < 0 || send_failed_) continue;
+    if (key_frame_requested_.exchange(false)) encoder_.Reset();
+    const int num_changed_tiles =
+        encoder_.Encode(frame, width, height, sent_pixels_.data(), &encoded_);
+    const StreamMessageHeader header = {
+        STREAM_FRAME_MESSAGE, static_cast<uint32_t>(encoded_.size())};
+    if (!SendAll(client_socket_, &header, sizeof(header), MSG_MORE) ||
+        !SendAll(client_socket_, encoded_.data(), encoded_.size(), 0)) {
+      send_failed_ = true;
+      continue;
+    }
+    std::lock_guard<std::mutex> statistics_lock(statistics_mutex_);
+    ++statistics_.num_sent_frames;
+    statistics_.num_sent_bytes += sizeof(header) + encoded_.size();
+    statistics_.num_raw_bytes += sent_pixels_.size();
+    statistics_.num_changed_tiles += num_changed_tiles;
+  }
+}
+
+void FrameStreamServer::Disconnect() {
+  if (client_socket_ < 0) return;
+  // Fails a send in progress, so that the sender releases the client.
+  shutdown(client_socket_, SHUT_RDWR);
+  std::lock_guard<std::mutex> lock(client_mutex_);
+  close(client_socket_);
+  client_socket_ = -1;
+  received_bytes_.clear();
+}
+
+}  // namespace wvu
@@ -0,0 +1,215 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_FRAME_STREAMING_H_
+#define GLUTILS_FRAME_STREAMING_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+
+#include "framebuffer_readback.h"
+#include "input_buffer.h"
+#include "lz4_block.h"
+
+namespace wvu {
+// Default width and height of the tiles of a TileDeltaEncoder.
+constexpr int kDefaultStreamTileSize = 32;
+
+// Encodes a frame as the tiles that changed since the previous one, so that a
+// mostly static view costs a few bytes, followed by LZ4. The first frame, and
+// the frame after Reset(), is a key frame with every tile. An encoded frame is
+//
+//   int64 frame, uint16 width, uint16 height, uint16 tile_size,
+//   uint32 num_tiles, uint32 uncompressed_size,
+//   LZ4 block of num_tiles x (uint16 column, uint16 row, RGBA rows),
+//
+// in host byte order, with the rows of a tile from the bottom to the top, and
+// the tiles of the right and top edges cropped to the frame.
+class TileDeltaEncoder {
+ public:
+  explicit TileDeltaEncoder(const int tile_size = kDefaultStreamTileSize);
+  ~TileDeltaEncoder() {}
+
+  // Makes the next frame a key frame.
+  void Reset();
+
+  // Replaces encoded with the delta of the frame. Returns the number of
+  // changed tiles.
+  int Encode(const int64_t frame,
+             const int width,
+             const int height,
+             const GLubyte* pixels,
+             std::vector<uint8_t>* encoded);
+
+ private:
+  const int tile_size_;
+  // The pixels of the previous frame, or empty for a key frame.
+  std::vector<GLubyte> previous_pixels_;
+  int previous_width_;
+  int previous_height_;
+  std::vector<uint8_t> tiles_;
+  std::vector<uint8_t> compressed_;
+  Lz4BlockCompressor compressor_;
+};
+
+// An input event of a client, in the byte layout of the wire.
+struct StreamInputEvent {
+  int32_t type;
+  int32_t code;
+  int32_t scancode;
+  int32_t action;
+  int32_t mods;
+  int32_t padding;
+  double x;
+  double y;
+};
+
+// Counters of a FrameStreamServer.
+struct FrameStreamStatistics {
+  int64_t num_sent_frames = 0;
+  // Frames replaced by a newer one before the sender took them.
+  int64_t num_dropped_frames = 0;
+  int64_t num_sent_bytes = 0;
+  // Bytes of the frames before the delta and the compression.
+  int64_t num_raw_bytes = 0;
+  int64_t num_changed_tiles = 0;
+  int64_t num_input_events = 0;
+  int num_clients = 0;
+};
+
+// This class streams the frames of a headless renderer to a thin client over
+// TCP, and feeds the input of the client back into the InputBuffer of the
+// window, so that the render loop handles it as local input. It serves one
+// client at a time; a new client waits until the previous one leaves.
+//
+// The latency matters more than the frame rate, so the frames never queue:
+// Submit() copies the frame into one pending slot, replacing a frame the
+// sender thread did not take yet, and the sender thread encodes the latest
+// frame with a TileDeltaEncoder and sends it with Nagle's algorithm off. A
+// frame is a message {uint32 type = 1, uint32 size} followed by the encoded
+// frame, and an input event is a message {uint32 type = 2, uint32 size}
+// followed by a StreamInputEvent. Each new client starts with a key frame.
+// There is no hardware video encoder: the deltas of a rendered view compress
+// well, and decode in a few lines on any client. POSIX only.
+//
+// Example:
+//
+// wvu::FrameStreamServer server;
+// server.Start(port, &error_info_log);
+// wvu::FramebufferReadback readback;
+// readback.Initialize(width, height, wvu::kDefaultNumReadbackBuffers,
+//                     [&server](const wvu::ReadbackFrame& frame) {
+//   server.Submit(frame);
+// });
+// while (...) {  // Render loop.
+//   ...  // Render, and readback.ReadPixels(frame).
+//   server.PollInput(&input_buffer);
+// }
+// readback.Finish();
+// server.Stop();
+class FrameStreamServer {
+ public:
+  FrameStreamServer();
+  ~FrameStreamServer();
+
+  // Listens on port, and starts the sender thread. Returns true if successful.
+  bool Start(const int port, std::string* error_info_log);
+
+  // Queues a copy of the frame for the client, replacing the frame queued
+  // before, if the sender did not take it yet. Does nothing without a client.
+  void Submit(const ReadbackFrame& frame);
+
+  // Accepts a waiting client, and injects the input events the client sent
+  // into input_buffer. Never blocks. Must be called on the main thread.
+  void PollInput(InputBuffer* input_buffer);
+
+  // Stops the sender thread, and closes the connections.
+  void Stop();
+
+  bool has_client() const {
+    return client_socket_ >= 0;
+  }
+
+  // Returns the counters. May be called while the sender runs.
+  FrameStreamStatistics statistics() const;
+
+ private:
+  // Encodes and sends the pending frames until Stop() is called.
+  void SendFrames();
+
+  // Shuts the connection of the client down. Must be called on the main
+  // thread.
+  void Disconnect();
+
+  int listen_socket_;
+  // Only the main thread opens and closes the socket of the client; the
+  // sender only uses it while holding client_mutex_.
+  std::atomic<int> client_socket_;
+  std::mutex client_mutex_;
+  // Set by the sender when a send failed, and when a new client needs a key
+  // frame.
+  std::atomic<bool> send_failed_;
+  std::atomic<bool> key_frame_requested_;
+  // The partial message of the client.
+  std::vector<uint8_t> received_bytes_;
+  // The frame waiting for the sender, and the frame being sent.
+  std::mutex frame_mutex_;
+  std::condition_variable frame_submitted_;
+  std::vector<GLubyte> pending_pixels_;
+  std::vector<GLubyte> sent_pixels_;
+  int64_t pending_frame_;
+  int pending_width_;
+  int pending_height_;
+  bool has_pending_frame_;
+  bool stop_;
+  TileDeltaEncoder encoder_;
+  std::vector<uint8_t> encoded_;
+  mutable std::mutex statistics_mutex_;
+  FrameStreamStatistics statistics_;
+  std::thread thread_;
+
+  FrameStreamServer(const FrameStreamServer&) = delete;
+  FrameStreamServer& operator=(const FrameStreamServer&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_FRAME_STREAMING_H_
@@ -0,0 +1,154 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "frame_uniforms.h"
+
+#include <cstring>
+#include <string>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/LU>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "ring_buffer.h"
+#include "shader_program.h"
+
+namespace wvu {
+
+const char FrameUniforms::kBlockName[] = "FrameUniforms";
+
+FrameUniforms::~FrameUniforms() {
+  if (ring_buffer_ == nullptr) {
+    BufferAllocator::Get()->DeleteBuffer(&buffer_id_);
+  }
+}
+
+bool FrameUniforms::Initialize() {
+  GlStateCache* gl_state = GlStateCache::Current();
+  if (buffer_id_ != 0) return true;
+  std::memset(&data_, 0, sizeof(data_));
+  BufferAllocator* allocator = BufferAllocator::Get();
+  buffer_id_ = allocator->CreateBuffer(UNIFORM_DATA);
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, buffer_id_);
+  allocator->BufferData(buffer_id_, GL_UNIFORM_BUFFER, sizeof(data_), &data_,
+                        GL_DYNAMIC_DRAW);
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, 0);
+  // The buffer stays bound to its binding point, so programs only need to be
+  // attached once.
+  gl_state->BindBufferBase(GL_UNIFORM_BUFFER, kFrameUniformsBindingPoint,
+                           buffer_id_);
+  return buffer_id_ != 0;
+}
+
+bool FrameUniforms::Initialize(RingBuffer* ring_buffer) {
+  if (buffer_id_ != 0) return ring_buffer_ == ring_buffer;
+  ring_buffer_ = ring_buffer;
+  buffer_id_ = ring_buffer->buffer_id();
+  // Uniform buffer ranges must start at a multiple of the driver alignment.
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment_);
+  return buffer_id_ != 0;
+}
+
+bool FrameUniforms::Attach(ShaderProgram* shader_program) const {
+  return shader_program->BindUniformBlock(kBlockName,
+                                          kFrameUniformsBindingPoint);
+}
+
+bool FrameUniforms::Update(const Eigen::Matrix4f& view,
+                           const Eigen::Matrix4f& projection,
+                           const float time,
+                           const float delta_time) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  BlockData data;
+  std::memcpy(data.view, view.data(), sizeof(data.view));
+  std::memcpy(data.projection, projection.data(), sizeof(data.projection));
+  const Eigen::Matrix4f view_projection = projection * view;
+  std::memcpy(data.view_projection, view_projection.data(),
+              sizeof(data.view_projection));
+  // The camera position is the translation of the inverse view matrix.
+  const Eigen::Vector4f camera_position = view.inverse().col(3);
+  std::memcpy(data.camera_position, camera_position.data(),
+              sizeof(data.camera_position));
+  data.time[0] = time;
+  data.time[1] = delta_time;
+  data.time[2] = 0.0f;
+  data.time[3] = 0.0f;
+  if (ring_buffer_ != nullptr) {
+    RingBufferAllocation allocation;
+    if (!ring_buffer_->Allocate(sizeof(data), offset_alignment_,
+                                &allocation)) {
+      return false;
+    }
+    data_ = data;
+    std::memcpy(allocation.data, &data_, sizeof(data_));
+    ring_buffer_->Flush();
+    range_offset_ = allocation.offset;
+    Bind();
+    ++num_updates_;
+    return true;
+  }
+  if (num_updates_ > 0 && std::memcmp(&data, &data_, sizeof(data)) == 0) {
+    return true;
+  }
+  data_ = data;
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, buffer_id_);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data_), &data_);
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, 0);
+  ++num_updates_;
+  return true;
+}
+
+void FrameUniforms::Bind() const {
+  GlStateCache* gl_state = GlStateCache::Current();
+  if (ring_buffer_ != nullptr) {
+    gl_state->BindBufferRange(GL_UNIFORM_BUFFER, kFrameUniformsBindingPoint,
+                              buffer_id_, range_offset_, sizeof(data_));
+    return;
+  }
+  gl_state->BindBufferBase(GL_UNIFORM_BUFFER, kFrameUniformsBindingPoint,
+                           buffer_id_);
+}
+
+std::string FrameUniforms::GlslDeclaration() {
+  return std::string("layout (std140) uniform ") + kBlockName + " {\n"
+      "  mat4 view;\n"
+      "  mat4 projection;\n"
+      "  mat4 view_projection;\n"
+      "  vec4 camera_position;\n"
+      "  vec4 time;\n"
+      "};\n";
+}
+
+}  // namespace wvu
@@ -0,0 +1,157 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_FRAME_UNIFORMS_H_
+#define GLUTILS_FRAME_UNIFORMS_H_
+
+#include <string>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "ring_buffer.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Uniform buffer binding point reserved for the per-frame uniforms.
+constexpr GLuint kFrameUniformsBindingPoint = 0;
+
+// This class holds the uniforms that are the same for every draw of a frame,
+// such as the camera matrices, in a uniform buffer object that all the shader
+// programs share. The buffer is written at most once per frame, regardless of
+// the number of programs using it. Shaders declare the block returned by
+// GlslDeclaration(), and programs are attached with Attach().
+// The block uses the std140 layout:
+//
+//   layout (std140) uniform FrameUniforms {
+//     mat4 view;
+//     mat4 projection;
+//     mat4 view_projection;
+//     vec4 camera_position;
+//     vec4 time;  // x: seconds since start, y: seconds since last frame.
+//   };
+//
+// Example:
+//
+// wvu::FrameUniforms frame_uniforms;
+// frame_uniforms.Initialize();
+// frame_uniforms.Attach(&shader_program);
+// while (...) {  // Rendering loop.
+//   frame_uniforms.Update(view, projection, time, delta_time);
+//   ...
+// }
+//
+// When initialized with a RingBuffer, every update writes the block into the
+// section of the current frame of the ring buffer and binds that range, so the
+// update never waits for the draws of previous frames reading the block.
+class FrameUniforms {
+ public:
+  // Name of the uniform block in the shaders.
+  static const char kBlockName[];
+
+  FrameUniforms()
+      : buffer_id_(0), num_updates_(0), ring_buffer_(nullptr),
+        offset_alignment_(0), range_offset_(0) {}
+  ~FrameUniforms();
+
+  // Creates the uniform buffer and binds it to kFrameUniformsBindingPoint.
+  // Returns true if successful.
+  bool Initialize();
+
+  // Streams the uniforms through the ring buffer instead of a dedicated
+  // buffer. Returns true if successful.
+  // Parameters:
+  //   ring_buffer  The ring buffer of the frame data. Not owned.
+  bool Initialize(RingBuffer* ring_buffer);
+
+  // Binds the FrameUniforms block of the program to the shared buffer.
+  // Returns false if the program does not declare the block.
+  bool Attach(ShaderProgram* shader_program) const;
+
+  // Writes the uniforms of the current frame into the buffer. The buffer is
+  // not written when the values did not change since the last update, unless
+  // the uniforms are streamed through a ring buffer, whose sections are
+  // recycled. Returns false if the ring buffer section is full.
+  // Parameters:
+  //   view  The view matrix, which maps world to camera coordinates.
+  //   projection  The projection matrix.
+  //   time  The time in seconds since the start of the application.
+  //   delta_time  The time in seconds since the last frame.
+  bool Update(const Eigen::Matrix4f& view,
+              const Eigen::Matrix4f& projection,
+              const float time,
+              const float delta_time);
+
+  // Binds the buffer, or the ring buffer range of the last update, to
+  // kFrameUniformsBindingPoint again, e.g., after a pass drew with other
+  // uniforms bound to it.
+  void Bind() const;
+
+  // Returns the GLSL declaration of the block, to be included in shaders.
+  static std::string GlslDeclaration();
+
+  // Returns the id of the uniform buffer.
+  GLuint buffer_id() const {
+    return buffer_id_;
+  }
+
+  // Returns the number of times the buffer was written.
+  int num_updates() const {
+    return num_updates_;
+  }
+
+ private:
+  // CPU-side copy of the block following the std140 layout. The matrices are
+  // stored in column-major order, as Eigen does.
+  struct BlockData {
+    GLfloat view[16];
+    GLfloat projection[16];
+    GLfloat view_projection[16];
+    GLfloat camera_position[4];
+    GLfloat time[4];
+  };
+
+  GLuint buffer_id_;
+  BlockData data_;
+  int num_updates_;
+  // Ring buffer streaming the block, or nullptr. Not owned.
+  RingBuffer* ring_buffer_;
+  // Alignment of uniform buffer ranges required by the driver.
+  GLint offset_alignment_;
+  // Offset in the ring buffer of the block of the last update.
+  GLintptr range_offset_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_FRAME_UNIFORMS_H_
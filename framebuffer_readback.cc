@@ -0,0 +1,166 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "framebuffer_readback.h"
+
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+
+namespace wvu {
+namespace {
+// Time in nanoseconds to wait for a fence before checking it again.
+constexpr GLuint64 kFenceTimeout = 1000000000;
+
+// Bytes of an RGBA pixel, and of a depth.
+constexpr int kBytesPerPixel = 4;
+constexpr int kBytesPerDepth = sizeof(GLfloat);
+
+}  // namespace
+
+FramebufferReadback::FramebufferReadback()
+    : width_(0), height_(0), read_depths_(false), oldest_buffer_(0),
+      num_pending_(0), num_waits_(0) {}
+
+FramebufferReadback::~FramebufferReadback() {
+  for (PixelBuffer& buffer : buffers_) {
+    if (buffer.fence != nullptr) glDeleteSync(buffer.fence);
+    BufferAllocator::Get()->DeleteBuffer(&buffer.buffer_id);
+  }
+}
+
+bool FramebufferReadback::Initialize(const int width,
+                                     const int height,
+                                     const int num_buffers,
+                                     const Callback& callback) {
+  if (!buffers_.empty() || width <= 0 || height <= 0 || num_buffers <= 0) {
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  callback_ = callback;
+  buffers_.resize(num_buffers);
+  // The depths follow the colors in the same buffer.
+  const GLsizeiptr size = static_cast<GLsizeiptr>(width) * height *
+      (kBytesPerPixel + (read_depths_ ? kBytesPerDepth : 0));
+  BufferAllocator* allocator = BufferAllocator::Get();
+  GlStateCache* gl_state = GlStateCache::Current();
+  for (PixelBuffer& buffer : buffers_) {
+    buffer.buffer_id = allocator->CreateBuffer(STAGING_DATA);
+    if (buffer.buffer_id == 0) return false;
+    gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer_id);
+    // GL_STREAM_READ hints the driver to keep the storage in memory the CPU
+    // reads quickly.
+    allocator->BufferData(buffer.buffer_id, GL_PIXEL_PACK_BUFFER, size,
+                          nullptr, GL_STREAM_READ);
+  }
+  gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  return true;
+}
+
+void FramebufferReadback::ReadPixels(const int64_t frame) {
+  if (buffers_.empty()) return;
+  while (num_pending_ > 0 && DeliverOldest(false)) {}
+  if (num_pending_ == static_cast<int>(buffers_.size())) {
+    ++num_waits_;
+    DeliverOldest(true);
+  }
+  PixelBuffer& buffer =
+      buffers_[(oldest_buffer_ + num_pending_) % buffers_.size()];
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer_id);
+  // The rows are tightly packed, since a row of RGBA pixels is always a
+  // multiple of 4 bytes.
+  glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  if (read_depths_) {
+    glReadPixels(0, 0, width_, height_, GL_DEPTH_COMPONENT, GL_FLOAT,
+                 reinterpret_cast<GLvoid*>(
+                     static_cast<uintptr_t>(width_) * height_ *
+                     kBytesPerPixel));
+  }
+  gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  buffer.frame = frame;
+  ++num_pending_;
+}
+
+void FramebufferReadback::Finish() {
+  while (num_pending_ > 0) DeliverOldest(true);
+}
+
+bool FramebufferReadback::DeliverOldest(const bool wait) {
+  PixelBuffer& buffer = buffers_[oldest_buffer_];
+  GLenum status = glClientWaitSync(buffer.fence, 0, 0);
+  if (status == GL_TIMEOUT_EXPIRED) {
+    if (!wait) return false;
+    do {
+      status = glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                kFenceTimeout);
+    } while (status == GL_TIMEOUT_EXPIRED);
+  }
+  glDeleteSync(buffer.fence);
+  buffer.fence = nullptr;
+  oldest_buffer_ = (oldest_buffer_ + 1) % buffers_.size();
+  --num_pending_;
+
+  // The copy is complete, so mapping the buffer does not wait.
+  const GLsizeiptr colors_size =
+      static_cast<GLsizeiptr>(width_) * height_ * kBytesPerPixel;
+  const GLsizeiptr size = colors_size + (read_depths_ ?
+      static_cast<GLsizeiptr>(width_) * height_ * kBytesPerDepth : 0);
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer_id);
+  const void* pixels =
+      glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+  if (pixels != nullptr) {
+    ReadbackFrame readback_frame;
+    readback_frame.frame = buffer.frame;
+    readback_frame.width = width_;
+    readback_frame.height = height_;
+    readback_frame.pixels = static_cast<const GLubyte*>(pixels);
+    if (read_depths_) {
+      readback_frame.depths = reinterpret_cast<const GLfloat*>(
+          readback_frame.pixels + colors_size);
+    }
+    if (callback_) callback_(readback_frame);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,153 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_FRAMEBUFFER_READBACK_H_
+#define GLUTILS_FRAMEBUFFER_READBACK_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+// Default number of pixel buffers of a FramebufferReadback, i.e., the number
+// of frames a read may take before the CPU waits for it.
+constexpr int kDefaultNumReadbackBuffers = 3;
+
+// The pixels of a frame read back from a framebuffer.
+struct ReadbackFrame {
+  // The number of the frame passed to FramebufferReadback::ReadPixels().
+  int64_t frame = 0;
+  int width = 0;
+  int height = 0;
+  // RGBA pixels, 4 bytes each, from the bottom row to the top one. They are
+  // only valid during the callback.
+  const GLubyte* pixels = nullptr;
+  // The depths of the pixels, in the same order, if the depths are read (see
+  // FramebufferReadback::set_read_depths()), otherwise nullptr.
+  const GLfloat* depths = nullptr;
+};
+
+// This class reads the pixels of the frames back to the CPU without stalling
+// the pipeline. glReadPixels() into a pixel buffer object (PBO) only
+// schedules the copy, so ReadPixels() returns immediately; a fence tracks the
+// copy, and the buffer is mapped once the GPU finished it, typically
+// num_buffers - 1 frames later, and handed to the callback. The CPU only waits
+// when all the buffers hold reads in flight.
+//
+// Example:
+//
+// wvu::FramebufferReadback readback;
+// readback.Initialize(width, height, wvu::kDefaultNumReadbackBuffers,
+//                     [](const wvu::ReadbackFrame& frame) {
+//   ...  // Encode or copy frame.pixels.
+// });
+// while (...) {  // Rendering loop.
+//   ...  // Draws into the framebuffer.
+//   readback.ReadPixels(frame_number);
+// }
+// readback.Finish();
+class FramebufferReadback {
+ public:
+  typedef std::function<void(const ReadbackFrame&)> Callback;
+
+  FramebufferReadback();
+  ~FramebufferReadback();
+
+  // Creates the pixel buffers. Returns true if successful.
+  // Parameters:
+  //   width  The width of the frames in pixels.
+  //   height  The height of the frames in pixels.
+  //   num_buffers  The number of reads in flight.
+  //   callback  Receives the frames, in the order they were read, on the
+  //     thread calling ReadPixels() and Finish().
+  bool Initialize(const int width,
+                  const int height,
+                  const int num_buffers,
+                  const Callback& callback);
+
+  // Delivers the completed reads, and starts reading the framebuffer bound to
+  // GL_READ_FRAMEBUFFER. Waits for the oldest read if no buffer is free.
+  // Parameters:
+  //   frame  The number of the frame, passed to the callback.
+  void ReadPixels(const int64_t frame);
+
+  // Waits for the reads in flight and delivers them.
+  void Finish();
+
+  // Also reads the depths of the framebuffer, as floats, e.g., to composite
+  // the frames of several renderers by depth. Call before Initialize().
+  void set_read_depths(const bool read_depths) {
+    read_depths_ = read_depths;
+  }
+
+  // Returns the number of reads in flight.
+  int num_pending() const {
+    return num_pending_;
+  }
+
+  // Returns the number of times ReadPixels() waited for a read to free its
+  // buffer.
+  int num_waits() const {
+    return num_waits_;
+  }
+
+ private:
+  struct PixelBuffer {
+    GLuint buffer_id = 0;
+    GLsync fence = nullptr;
+    int64_t frame = 0;
+  };
+
+  // Delivers the oldest read. If wait, waits for it to complete; otherwise
+  // returns false if it did not complete yet.
+  bool DeliverOldest(const bool wait);
+
+  std::vector<PixelBuffer> buffers_;
+  Callback callback_;
+  int width_;
+  int height_;
+  bool read_depths_;
+  // Buffer of the oldest read in flight.
+  int oldest_buffer_;
+  int num_pending_;
+  int num_waits_;
+
+  FramebufferReadback(const FramebufferReadback&) = delete;
+  FramebufferReadback& operator=(const FramebufferReadback&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_FRAMEBUFFER_READBACK_H_
@@ -0,0 +1,288 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "gl_call_counter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "gl_capture.h"
+#include "gl_entry_points.h"
+
+#if defined(GLUTILS_COUNT_GL_CALLS) && defined(GLUTILS_WRAP_GL_CORE)
+
+// The linker redirects the calls of __real_<function> to the OpenGL 1.1 entry
+// points of the OpenGL library.
+#define GLUTILS_DECLARE_REAL_CORE_ENTRY_POINT(name, parameters, arguments, \
+                                              kinds)                       \
+  void GLAPIENTRY __real_gl##name parameters;
+
+extern "C" {
+GLUTILS_CORE_ENTRY_POINTS(GLUTILS_DECLARE_REAL_CORE_ENTRY_POINT)
+}  // extern "C"
+
+#undef GLUTILS_DECLARE_REAL_CORE_ENTRY_POINT
+
+#endif  // GLUTILS_COUNT_GL_CALLS && GLUTILS_WRAP_GL_CORE
+
+namespace wvu {
+namespace {
+// The counters of the current frame, updated by all the threads. Zero
+// initialized before any dynamic initialization.
+struct GlCallCounter {
+  std::atomic<int64_t> num_calls;
+  std::atomic<int64_t> nanoseconds;
+};
+
+GlCallCounter frame_counters[NUM_GL_ENTRY_POINTS];
+
+// The counters of the last complete frame, only used by the thread calling
+// BeginGlCallFrame().
+int last_frame_num_calls[NUM_GL_ENTRY_POINTS];
+int64_t last_frame_nanoseconds[NUM_GL_ENTRY_POINTS];
+
+#ifdef GLUTILS_COUNT_GL_CALLS
+
+// Counts a call of an entry point and times it until it goes out of scope.
+class ScopedGlCall {
+ public:
+  explicit ScopedGlCall(const GlEntryPoint entry_point)
+      : entry_point_(entry_point),
+        begin_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedGlCall() {
+    const std::chrono::nanoseconds duration =
+        std::chrono::steady_clock::now() - begin_;
+    GlCallCounter& counter = frame_counters[entry_point_];
+    counter.num_calls.fetch_add(1, std::memory_order_relaxed);
+    counter.nanoseconds.fetch_add(duration.count(), std::memory_order_relaxed);
+  }
+
+ private:
+  const GlEntryPoint entry_point_;
+  const std::chrono::steady_clock::time_point begin_;
+};
+
+// Calls an entry point and records the call in the capture.
+template <typename Return>
+struct CapturedGlCall {
+  template <typename... Arguments>
+  static Return Call(const GlEntryPoint entry_point,
+                     Return (GLAPIENTRY* function)(Arguments...),
+                     Arguments... arguments) {
+    BeginCapturedGlCall(entry_point);
+    const Return result = function(arguments...);
+    const uint64_t words[] = {ToGlCaptureWord(arguments)..., 0};
+    CaptureGlCall(entry_point, words, sizeof...(Arguments),
+                  ToGlCaptureWord(result));
+    return result;
+  }
+};
+
+template <>
+struct CapturedGlCall<void> {
+  template <typename... Arguments>
+  static void Call(const GlEntryPoint entry_point,
+                   void (GLAPIENTRY* function)(Arguments...),
+                   Arguments... arguments) {
+    BeginCapturedGlCall(entry_point);
+    function(arguments...);
+    const uint64_t words[] = {ToGlCaptureWord(arguments)..., 0};
+    CaptureGlCall(entry_point, words, sizeof...(Arguments), 0);
+  }
+};
+
+// Counts and times a call of an entry point, and records it while a capture
+// is recording.
+template <typename Return, typename... Arguments>
+Return CountGlCall(const GlEntryPoint entry_point,
+                   Return (GLAPIENTRY* function)(Arguments...),
+                   Arguments... arguments) {
+  ScopedGlCall call(entry_point);
+  if (GlCaptureRecording()) {
+    return CapturedGlCall<Return>::Call(entry_point, function, arguments...);
+  }
+  return function(arguments...);
+}
+
+// The wrapper of an entry point of the GLEW function table, generated from the
+// type of its pointer.
+template <GlEntryPoint kEntryPoint, typename Function>
+struct GlewWrapper;
+
+template <GlEntryPoint kEntryPoint, typename Return, typename... Arguments>
+struct GlewWrapper<kEntryPoint, Return (GLAPIENTRY*)(Arguments...)> {
+  static Return GLAPIENTRY Call(Arguments... arguments) {
+    return CountGlCall(kEntryPoint, original, arguments...);
+  }
+
+  // The entry point of the driver.
+  static Return (GLAPIENTRY* original)(Arguments...);
+};
+
+template <GlEntryPoint kEntryPoint, typename Return, typename... Arguments>
+Return (GLAPIENTRY* GlewWrapper<kEntryPoint, Return (GLAPIENTRY*)(
+    Arguments...)>::original)(Arguments...) = nullptr;
+
+// A call of an OpenGL 1.1 entry point of the library, whose arguments are
+// spliced by the wrappers of the linker.
+template <typename... Arguments>
+struct CoreGlCall {
+  void operator()(Arguments... arguments) const {
+    CountGlCall(entry_point, function, arguments...);
+  }
+
+  const GlEntryPoint entry_point;
+  void (GLAPIENTRY* const function)(Arguments...);
+};
+
+template <typename... Arguments>
+CoreGlCall<Arguments...> MakeCoreGlCall(
+    const GlEntryPoint entry_point,
+    void (GLAPIENTRY* function)(Arguments...)) {
+  return CoreGlCall<Arguments...>{entry_point, function};
+}
+
+// Replaces the pointer of the GLEW function table with the wrapper, unless the
+// driver does not have the entry point.
+template <GlEntryPoint kEntryPoint, typename Function>
+void InstallGlewWrapper(Function* glew_function) {
+  if (*glew_function == nullptr) return;
+  GlewWrapper<kEntryPoint, Function>::original = *glew_function;
+  *glew_function = &GlewWrapper<kEntryPoint, Function>::Call;
+}
+
+#endif  // GLUTILS_COUNT_GL_CALLS
+
+}  // namespace
+
+bool GlCallCountingEnabled() {
+#ifdef GLUTILS_COUNT_GL_CALLS
+  return true;
+#else
+  return false;
+#endif  // GLUTILS_COUNT_GL_CALLS
+}
+
+void InstallGlCallCounters() {
+#ifdef GLUTILS_COUNT_GL_CALLS
+  static bool installed = false;
+  if (installed) return;
+  installed = true;
+#define GLUTILS_INSTALL_GLEW_WRAPPER(name, kinds) \
+  InstallGlewWrapper<CALL_##name>(&__glew##name);
+  GLUTILS_GLEW_ENTRY_POINTS(GLUTILS_INSTALL_GLEW_WRAPPER)
+#undef GLUTILS_INSTALL_GLEW_WRAPPER
+#endif  // GLUTILS_COUNT_GL_CALLS
+}
+
+void BeginGlCallFrame() {
+  for (int i = 0; i < NUM_GL_ENTRY_POINTS; ++i) {
+    last_frame_num_calls[i] = static_cast<int>(
+        frame_counters[i].num_calls.exchange(0, std::memory_order_relaxed));
+    last_frame_nanoseconds[i] =
+        frame_counters[i].nanoseconds.exchange(0, std::memory_order_relaxed);
+  }
+}
+
+int NumGlCalls() {
+  int num_calls = 0;
+  for (int i = 0; i < NUM_GL_ENTRY_POINTS; ++i) {
+    num_calls += last_frame_num_calls[i];
+  }
+  return num_calls;
+}
+
+double GlCallTimeMs() {
+  int64_t nanoseconds = 0;
+  for (int i = 0; i < NUM_GL_ENTRY_POINTS; ++i) {
+    nanoseconds += last_frame_nanoseconds[i];
+  }
+  return nanoseconds * 1e-6;
+}
+
+void GetGlCallStatistics(std::vector<GlCallStatistics>* statistics) {
+  statistics->clear();
+  for (int i = 0; i < NUM_GL_ENTRY_POINTS; ++i) {
+    if (last_frame_num_calls[i] == 0) continue;
+    GlCallStatistics entry_point_statistics;
+    entry_point_statistics.name = GlEntryPointName(i);
+    entry_point_statistics.num_calls = last_frame_num_calls[i];
+    entry_point_statistics.cpu_ms = last_frame_nanoseconds[i] * 1e-6;
+    statistics->push_back(entry_point_statistics);
+  }
+  std::sort(statistics->begin(), statistics->end(),
+            [](const GlCallStatistics& a, const GlCallStatistics& b) {
+              return a.cpu_ms > b.cpu_ms;
+            });
+}
+
+std::string GlCallReport() {
+  std::vector<GlCallStatistics> statistics;
+  GetGlCallStatistics(&statistics);
+  std::ostringstream report;
+  report << std::fixed << std::setprecision(3) << NumGlCalls()
+         << " OpenGL calls, " << GlCallTimeMs() << " ms.";
+  for (const GlCallStatistics& entry_point : statistics) {
+    report << "\n  " << entry_point.name << ": " << entry_point.num_calls
+           << " calls, " << entry_point.cpu_ms << " ms.";
+  }
+  return report.str();
+}
+
+}  // namespace wvu
+
+#if defined(GLUTILS_COUNT_GL_CALLS) && defined(GLUTILS_WRAP_GL_CORE)
+
+// The linker redirects the calls of the OpenGL 1.1 entry points to
+// __wrap_<function>.
+#define GLUTILS_CORE_WRAPPER(name, parameters, arguments, kinds)      \
+  void GLAPIENTRY __wrap_gl##name parameters {                          \
+    wvu::MakeCoreGlCall(wvu::CALL_##name, &__real_gl##name) arguments; \
+  }
+
+extern "C" {
+GLUTILS_CORE_ENTRY_POINTS(GLUTILS_CORE_WRAPPER)
+}  // extern "C"
+
+#undef GLUTILS_CORE_WRAPPER
+
+#endif  // GLUTILS_COUNT_GL_CALLS && GLUTILS_WRAP_GL_CORE
@@ -0,0 +1,105 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_GL_CALL_COUNTER_H_
+#define GLUTILS_GL_CALL_COUNTER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wvu {
+// OpenGL call counters, to see which entry points the frames call and how much
+// CPU time the driver spends in them. The counting is opt-in: building with
+// the COUNT_GL_CALLS CMake option (which defines GLUTILS_COUNT_GL_CALLS)
+// generates a wrapper for every entry point listed in gl_entry_points.h,
+// which counts the call and times it with std::chrono::steady_clock before
+// forwarding it to the driver. Otherwise the counters remain zero and cost
+// nothing.
+//
+// The entry points loaded by GLEW are wrapped by replacing their pointers in
+// the GLEW function table, which InstallGlCallCounters() does once glewInit()
+// succeeded. The OpenGL 1.1 entry points, e.g., glDrawElements() or
+// glBindTexture(), are linked directly from the OpenGL library instead, and
+// are only wrapped on Linux, where the linker redirects them to the wrappers
+// (see the --wrap options of CMakeLists.txt). The calls of all the threads
+// and contexts are counted together.
+//
+// Example:
+//
+// glewInit();
+// wvu::InstallGlCallCounters();
+// while (...) {  // Rendering loop.
+//   wvu::BeginGlCallFrame();
+//   RenderFrame();
+//   LOG(INFO) << wvu::NumGlCalls() << " OpenGL calls in the last frame.";
+// }
+
+// The calls of an entry point in the last complete frame.
+struct GlCallStatistics {
+  std::string name;
+  int num_calls = 0;
+  // CPU time spent in the calls.
+  double cpu_ms = 0.0;
+};
+
+// Returns true if the build counts the OpenGL calls.
+bool GlCallCountingEnabled();
+
+// Replaces the entry points of the GLEW function table with the counting
+// wrappers. Must be called after glewInit() succeeded, before any other thread
+// calls OpenGL. Does nothing if the build does not count the calls or if the
+// wrappers are already installed.
+void InstallGlCallCounters();
+
+// Ends the frame of the counters and starts the next one. The counters of the
+// frame that ended are returned by the functions below. Must be called by one
+// thread only.
+void BeginGlCallFrame();
+
+// Returns the number of OpenGL calls of the last complete frame, and the CPU
+// time spent in them.
+int NumGlCalls();
+double GlCallTimeMs();
+
+// Computes the statistics of the entry points called in the last complete
+// frame, sorted by decreasing CPU time.
+void GetGlCallStatistics(std::vector<GlCallStatistics>* statistics);
+
+// Returns a table of the entry points called in the last complete frame.
+std::string GlCallReport();
+
+}  // namespace wvu
+
+#endif  // GLUTILS_GL_CALL_COUNTER_H_
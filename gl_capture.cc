@@ -0,0 +1,641 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "gl_capture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "gl_call_counter.h"
+#include "gl_entry_points.h"
+
+namespace wvu {
+namespace {
+// Size of the blocks of mapped storage compared against their last recorded
+// contents.
+constexpr int64_t kMappedBlockSize = 1024;
+
+// The data of a call read from the memory of the program.
+struct Payload {
+  int argument = 0;
+  const void* data = nullptr;
+  int64_t size = 0;
+  bool size_only = false;
+  // Holds the data when it is rearranged, e.g., an array of strings.
+  std::string storage;
+};
+
+// Storage of a buffer mapped for writing.
+struct Mapping {
+  GLuint buffer = 0;
+  const GLubyte* pointer = nullptr;
+  int64_t length = 0;
+  // The contents at the last record, empty until it is first recorded.
+  std::vector<GLubyte> recorded;
+};
+
+struct Capture {
+  std::mutex mutex;
+  std::ofstream out;
+  std::string filepath;
+  int num_frames = 0;
+  // Index of every context, and of the context of the last recorded call.
+  std::unordered_map<GLFWwindow*, int> contexts;
+  int current_context = -1;
+  std::vector<Mapping> mappings;
+};
+
+std::atomic<bool> recording(false);
+
+Capture* GetCapture() {
+  static Capture* capture = new Capture;
+  return capture;
+}
+
+template <typename Value>
+void Write(const Value& value, std::ofstream* out) {
+  out->write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Returns the binding of a buffer target, or zero if it is unknown.
+GLenum BufferBinding(const GLenum target) {
+  switch (target) {
+    case GL_ARRAY_BUFFER:
+      return GL_ARRAY_BUFFER_BINDING;
+    case GL_ELEMENT_ARRAY_BUFFER:
+      return GL_ELEMENT_ARRAY_BUFFER_BINDING;
+    case GL_UNIFORM_BUFFER:
+      return GL_UNIFORM_BUFFER_BINDING;
+    case GL_SHADER_STORAGE_BUFFER:
+      return GL_SHADER_STORAGE_BUFFER_BINDING;
+    case GL_ATOMIC_COUNTER_BUFFER:
+      return GL_ATOMIC_COUNTER_BUFFER_BINDING;
+    case GL_DRAW_INDIRECT_BUFFER:
+      return GL_DRAW_INDIRECT_BUFFER_BINDING;
+    case GL_DISPATCH_INDIRECT_BUFFER:
+      return GL_DISPATCH_INDIRECT_BUFFER_BINDING;
+    case GL_COPY_READ_BUFFER:
+      return GL_COPY_READ_BUFFER_BINDING;
+    case GL_COPY_WRITE_BUFFER:
+      return GL_COPY_WRITE_BUFFER_BINDING;
+    case GL_PIXEL_PACK_BUFFER:
+      return GL_PIXEL_PACK_BUFFER_BINDING;
+    case GL_PIXEL_UNPACK_BUFFER:
+      return GL_PIXEL_UNPACK_BUFFER_BINDING;
+    default:
+      return 0;
+  }
+}
+
+// Returns the buffer bound to a target of the current context.
+GLuint BoundBuffer(const GLenum target) {
+  const GLenum binding = BufferBinding(target);
+  if (binding == 0) return 0;
+  GLint buffer = 0;
+  glGetIntegerv(binding, &buffer);
+  return buffer;
+}
+
+// Returns the size of a pixel of the given format and type in bytes.
+int64_t PixelSize(const GLenum format, const GLenum type) {
+  switch (type) {
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+      return 2;
+    case GL_UNSIGNED_INT_8_8_8_8:
+    case GL_UNSIGNED_INT_8_8_8_8_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+    case GL_UNSIGNED_INT_24_8:
+      return 4;
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+      return 8;
+    default:
+      break;
+  }
+  int64_t num_components = 4;
+  switch (format) {
+    case GL_RED:
+    case GL_RED_INTEGER:
+    case GL_DEPTH_COMPONENT:
+    case GL_STENCIL_INDEX:
+      num_components = 1;
+      break;
+    case GL_RG:
+    case GL_RG_INTEGER:
+      num_components = 2;
+      break;
+    case GL_RGB:
+    case GL_BGR:
+    case GL_RGB_INTEGER:
+      num_components = 3;
+      break;
+    default:
+      break;
+  }
+  switch (type) {
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+      return 2 * num_components;
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+      return 4 * num_components;
+    default:
+      return num_components;
+  }
+}
+
+// Returns the size of an image in client memory, with the rows aligned to the
+// alignment of the given pixel store parameter.
+int64_t ImageSize(const int64_t width,
+                  const int64_t height,
+                  const int64_t depth,
+                  const GLenum format,
+                  const GLenum type,
+                  const GLenum alignment_name) {
+  if (width <= 0 || height <= 0 || depth <= 0) return 0;
+  GLint alignment = 4;
+  glGetIntegerv(alignment_name, &alignment);
+  const int64_t row_size = width * PixelSize(format, type);
+  const int64_t row_stride =
+      (row_size + alignment - 1) / alignment * alignment;
+  return row_stride * (height * depth - 1) + row_size;
+}
+
+// Adds the payload of a pointer argument, unless it is null.
+void AddPayload(const int argument,
+                const uint64_t* arguments,
+                const int64_t size,
+                std::vector<Payload>* payloads) {
+  Payload payload;
+  payload.argument = argument;
+  payload.data = FromGlCaptureWord<const void*>(arguments[argument]);
+  payload.size = size;
+  if (payload.data == nullptr || size <= 0) return;
+  payloads->push_back(payload);
+}
+
+// Adds the payload of an image argument, unless the image is read from a
+// pixel unpack buffer.
+void AddImagePayload(const int argument,
+                     const uint64_t* arguments,
+                     const int64_t size,
+                     std::vector<Payload>* payloads) {
+  if (BoundBuffer(GL_PIXEL_UNPACK_BUFFER) != 0) return;
+  AddPayload(argument, arguments, size, payloads);
+}
+
+// Adds the payload of an array of strings, stored null-terminated one after
+// the other.
+void AddStringsPayload(const int argument,
+                       const uint64_t* arguments,
+                       const int num_strings,
+                       const GLint* lengths,
+                       std::vector<Payload>* payloads) {
+  const GLchar* const* strings =
+      FromGlCaptureWord<const GLchar* const*>(arguments[argument]);
+  Payload payload;
+  payload.argument = argument;
+  for (int i = 0; i < num_strings; ++i) {
+    if (lengths != nullptr && lengths[i] >= 0) {
+      payload.storage.append(strings[i], lengths[i]);
+    } else {
+      payload.storage.append(strings[i]);
+    }
+    payload.storage.push_back('\0');
+  }
+  payload.data = payload.storage.data();
+  payload.size = payload.storage.size();
+  payloads->push_back(payload);
+}
+
+// Adds the payload of a null-terminated string.
+void AddStringPayload(const int argument,
+                      const uint64_t* arguments,
+                      std::vector<Payload>* payloads) {
+  const GLchar* string = FromGlCaptureWord<const GLchar*>(arguments[argument]);
+  AddPayload(argument, arguments, std::strlen(string) + 1, payloads);
+}
+
+// Adds the data that a call reads from, or writes into, the memory of the
+// program. The data of the names created by the call are read after it.
+void GetPayloads(const int entry_point,
+                 const uint64_t* arguments,
+                 std::vector<Payload>* payloads) {
+  const auto count = [arguments](const int argument) {
+    return static_cast<int64_t>(static_cast<GLsizei>(arguments[argument]));
+  };
+  switch (entry_point) {
+    case CALL_BufferData:
+    case CALL_BufferStorage:
+      AddPayload(2, arguments, arguments[1], payloads);
+      break;
+    case CALL_BufferSubData:
+      AddPayload(3, arguments, arguments[2], payloads);
+      break;
+    case CALL_ClearBufferData:
+      AddPayload(4, arguments,
+                 PixelSize(arguments[2], arguments[3]), payloads);
+      break;
+    case CALL_ClearBufferfv:
+      AddPayload(2, arguments,
+                 (arguments[0] == GL_COLOR ? 4 : 1) * sizeof(GLfloat),
+                 payloads);
+      break;
+    case CALL_CompressedTexImage2D:
+      AddImagePayload(7, arguments, count(6), payloads);
+      break;
+    case CALL_CompressedTexImage3D:
+    case CALL_CompressedTexSubImage2D:
+      AddImagePayload(8, arguments, count(7), payloads);
+      break;
+    case CALL_CompressedTexSubImage3D:
+      AddImagePayload(10, arguments, count(9), payloads);
+      break;
+    case CALL_CreateShaderProgramv:
+      AddStringsPayload(2, arguments, count(1), nullptr, payloads);
+      break;
+    case CALL_ShaderSource:
+      AddStringsPayload(2, arguments, count(1),
+                        FromGlCaptureWord<const GLint*>(arguments[3]),
+                        payloads);
+      break;
+    case CALL_DeleteBuffers:
+    case CALL_DeleteFramebuffers:
+    case CALL_DeleteProgramPipelines:
+    case CALL_DeleteQueries:
+    case CALL_DeleteRenderbuffers:
+    case CALL_DeleteVertexArrays:
+    case CALL_DeleteTextures:
+    case CALL_GenBuffers:
+    case CALL_GenFramebuffers:
+    case CALL_GenProgramPipelines:
+    case CALL_GenQueries:
+    case CALL_GenRenderbuffers:
+    case CALL_GenVertexArrays:
+    case CALL_GenTextures:
+      AddPayload(1, arguments, count(0) * sizeof(GLuint), payloads);
+      break;
+    case CALL_DrawBuffers:
+      AddPayload(1, arguments, count(0) * sizeof(GLenum), payloads);
+      break;
+    case CALL_GetProgramResourceIndex:
+      AddStringPayload(2, arguments, payloads);
+      break;
+    case CALL_GetUniformLocation:
+      AddStringPayload(1, arguments, payloads);
+      break;
+    case CALL_MultiDrawElements:
+      AddPayload(1, arguments, count(4) * sizeof(GLsizei), payloads);
+      AddPayload(3, arguments, count(4) * sizeof(void*), payloads);
+      break;
+    case CALL_ProgramBinary:
+      AddPayload(2, arguments, count(3), payloads);
+      break;
+    case CALL_ProgramUniform3fv:
+      AddPayload(3, arguments, count(2) * 3 * sizeof(GLfloat), payloads);
+      break;
+    case CALL_ProgramUniformMatrix4fv:
+      AddPayload(4, arguments, count(2) * 16 * sizeof(GLfloat), payloads);
+      break;
+    case CALL_Uniform3fv:
+      AddPayload(2, arguments, count(1) * 3 * sizeof(GLfloat), payloads);
+      break;
+    case CALL_Uniform4fv:
+      AddPayload(2, arguments, count(1) * 4 * sizeof(GLfloat), payloads);
+      break;
+    case CALL_UniformMatrix3fv:
+      AddPayload(3, arguments, count(1) * 9 * sizeof(GLfloat), payloads);
+      break;
+    case CALL_UniformMatrix4fv:
+      AddPayload(3, arguments, count(1) * 16 * sizeof(GLfloat), payloads);
+      break;
+    case CALL_ViewportArrayv:
+      AddPayload(2, arguments, count(1) * 4 * sizeof(GLfloat), payloads);
+      break;
+    case CALL_TexImage2D:
+      AddImagePayload(8, arguments,
+                      ImageSize(count(3), count(4), 1, arguments[6],
+                                arguments[7], GL_UNPACK_ALIGNMENT),
+                      payloads);
+      break;
+    case CALL_TexSubImage2D:
+      AddImagePayload(8, arguments,
+                      ImageSize(count(4), count(5), 1, arguments[6],
+                                arguments[7], GL_UNPACK_ALIGNMENT),
+                      payloads);
+      break;
+    case CALL_TexImage3D:
+      AddImagePayload(9, arguments,
+                      ImageSize(count(3), count(4), count(5), arguments[7],
+                                arguments[8], GL_UNPACK_ALIGNMENT),
+                      payloads);
+      break;
+    case CALL_TexSubImage3D:
+      AddImagePayload(10, arguments,
+                      ImageSize(count(5), count(6), count(7), arguments[8],
+                                arguments[9], GL_UNPACK_ALIGNMENT),
+                      payloads);
+      break;
+    case CALL_ReadPixels:
+      // The replay only needs memory to write the pixels into.
+      if (BoundBuffer(GL_PIXEL_PACK_BUFFER) == 0) {
+        Payload payload;
+        payload.argument = 6;
+        payload.size = ImageSize(count(2), count(3), 1, arguments[4],
+                                 arguments[5], GL_PACK_ALIGNMENT);
+        payload.size_only = true;
+        payloads->push_back(payload);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// Returns true if the call may read the storage of the mapped buffers.
+bool ReadsMappedBuffers(const int entry_point) {
+  switch (entry_point) {
+    case CALL_DrawArrays:
+    case CALL_DrawArraysInstanced:
+    case CALL_DrawElements:
+    case CALL_DrawElementsBaseVertex:
+    case CALL_DrawElementsInstanced:
+    case CALL_DrawElementsInstancedBaseInstance:
+    case CALL_DrawElementsInstancedBaseVertex:
+    case CALL_DrawElementsInstancedBaseVertexBaseInstance:
+    case CALL_MultiDrawElements:
+    case CALL_MultiDrawElementsIndirect:
+    case CALL_MultiDrawElementsIndirectCountARB:
+    case CALL_DispatchCompute:
+    case CALL_CopyBufferSubData:
+    case CALL_TexImage2D:
+    case CALL_TexImage3D:
+    case CALL_TexSubImage2D:
+    case CALL_TexSubImage3D:
+    case CALL_CompressedTexImage2D:
+    case CALL_CompressedTexImage3D:
+    case CALL_CompressedTexSubImage2D:
+    case CALL_CompressedTexSubImage3D:
+    case CALL_FlushMappedBufferRange:
+    case CALL_UnmapBuffer:
+    case CALL_FenceSync:
+    case CALL_Flush:
+    case CALL_Finish:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Records the ranges of a mapping that changed since they were last recorded.
+void RecordMappedWrites(Mapping* mapping, std::ofstream* out) {
+  const auto record = [mapping, out](const int64_t begin, const int64_t end) {
+    Write(kGlCaptureMappedWriteRecord, out);
+    Write(ToGlCaptureWord(mapping->pointer), out);
+    Write(static_cast<uint64_t>(begin), out);
+    Write(static_cast<uint32_t>(end - begin), out);
+    out->write(reinterpret_cast<const char*>(mapping->pointer + begin),
+               end - begin);
+    std::memcpy(mapping->recorded.data() + begin, mapping->pointer + begin,
+                end - begin);
+  };
+  if (mapping->recorded.empty()) {
+    mapping->recorded.resize(mapping->length);
+    record(0, mapping->length);
+    return;
+  }
+  int64_t run_begin = -1;
+  for (int64_t begin = 0; begin < mapping->length;
+       begin += kMappedBlockSize) {
+    const int64_t end = std::min(begin + kMappedBlockSize, mapping->length);
+    const bool changed = std::memcmp(mapping->pointer + begin,
+                                     mapping->recorded.data() + begin,
+                                     end - begin) != 0;
+    if (changed && run_begin < 0) run_begin = begin;
+    if (!changed && run_begin >= 0) {
+      record(run_begin, begin);
+      run_begin = -1;
+    }
+  }
+  if (run_begin >= 0) record(run_begin, mapping->length);
+}
+
+// Records the context of the calling thread if it is not the context of the
+// last recorded call.
+void RecordContext(Capture* capture) {
+  GLFWwindow* context = glfwGetCurrentContext();
+  const auto inserted =
+      capture->contexts.emplace(context, capture->contexts.size());
+  const int index = inserted.first->second;
+  if (index == capture->current_context) return;
+  capture->current_context = index;
+  Write(kGlCaptureContextRecord, &capture->out);
+  Write(static_cast<uint32_t>(index), &capture->out);
+}
+
+// Forgets the mappings of the buffers unmapped or deleted by a call.
+void RemoveMappings(const int entry_point,
+                    const uint64_t* arguments,
+                    Capture* capture) {
+  std::vector<GLuint> buffers;
+  if (entry_point == CALL_UnmapBuffer) {
+    buffers.push_back(BoundBuffer(arguments[0]));
+  } else if (entry_point == CALL_DeleteBuffers) {
+    const GLuint* deleted = FromGlCaptureWord<const GLuint*>(arguments[1]);
+    buffers.assign(deleted, deleted + static_cast<GLsizei>(arguments[0]));
+  } else {
+    return;
+  }
+  std::vector<Mapping>& mappings = capture->mappings;
+  mappings.erase(std::remove_if(mappings.begin(), mappings.end(),
+                                [&buffers](const Mapping& mapping) {
+                                  return std::find(buffers.begin(),
+                                                   buffers.end(),
+                                                   mapping.buffer) !=
+                                      buffers.end();
+                                }),
+                 mappings.end());
+}
+
+}  // namespace
+
+bool StartGlCapture(const std::string& filepath,
+                    const int framebuffer_width,
+                    const int framebuffer_height,
+                    std::string* error_info_log) {
+  if (!GlCallCountingEnabled()) {
+    *error_info_log = "The captures need a build with the COUNT_GL_CALLS "
+        "option.";
+    return false;
+  }
+  Capture* capture = GetCapture();
+  std::lock_guard<std::mutex> lock(capture->mutex);
+  if (recording.load()) {
+    *error_info_log = "A capture is already recording.";
+    return false;
+  }
+  capture->filepath = filepath;
+  capture->out.open(filepath + ".tmp", std::ios::binary | std::ios::trunc);
+  if (!capture->out.is_open()) {
+    *error_info_log = "Could not open " + filepath + ".tmp";
+    return false;
+  }
+  capture->num_frames = 0;
+  capture->contexts.clear();
+  capture->current_context = -1;
+  capture->mappings.clear();
+  Write(kGlCaptureMagic, &capture->out);
+  Write(kGlCaptureVersion, &capture->out);
+  Write(static_cast<int32_t>(framebuffer_width), &capture->out);
+  Write(static_cast<int32_t>(framebuffer_height), &capture->out);
+  Write(static_cast<uint32_t>(NUM_GL_ENTRY_POINTS), &capture->out);
+  for (int i = 0; i < NUM_GL_ENTRY_POINTS; ++i) {
+    const std::string name = GlEntryPointName(i);
+    Write(static_cast<uint16_t>(name.size()), &capture->out);
+    capture->out.write(name.data(), name.size());
+  }
+  recording.store(true);
+  return true;
+}
+
+void EndGlCaptureFrame() {
+  if (!recording.load()) return;
+  Capture* capture = GetCapture();
+  std::lock_guard<std::mutex> lock(capture->mutex);
+  for (Mapping& mapping : capture->mappings) {
+    RecordMappedWrites(&mapping, &capture->out);
+  }
+  Write(kGlCaptureFrameRecord, &capture->out);
+  ++capture->num_frames;
+}
+
+bool StopGlCapture(std::string* error_info_log) {
+  Capture* capture = GetCapture();
+  std::lock_guard<std::mutex> lock(capture->mutex);
+  if (!recording.exchange(false)) {
+    *error_info_log = "No capture is recording.";
+    return false;
+  }
+  const std::string temporary_filepath = capture->filepath + ".tmp";
+  capture->mappings.clear();
+  capture->out.close();
+  if (!capture->out) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + temporary_filepath;
+    return false;
+  }
+  if (std::rename(temporary_filepath.c_str(),
+                  capture->filepath.c_str()) != 0) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not rename " + temporary_filepath;
+    return false;
+  }
+  return true;
+}
+
+bool GlCaptureRecording() {
+  return recording.load(std::memory_order_relaxed);
+}
+
+int NumGlCaptureFrames() {
+  Capture* capture = GetCapture();
+  std::lock_guard<std::mutex> lock(capture->mutex);
+  return capture->num_frames;
+}
+
+void BeginCapturedGlCall(const int entry_point) {
+  if (!ReadsMappedBuffers(entry_point)) return;
+  Capture* capture = GetCapture();
+  std::lock_guard<std::mutex> lock(capture->mutex);
+  if (!recording.load()) return;
+  for (Mapping& mapping : capture->mappings) {
+    RecordMappedWrites(&mapping, &capture->out);
+  }
+}
+
+void CaptureGlCall(const int entry_point,
+                   const uint64_t* arguments,
+                   const int num_arguments,
+                   const uint64_t result) {
+  Capture* capture = GetCapture();
+  std::lock_guard<std::mutex> lock(capture->mutex);
+  if (!recording.load()) return;
+  RecordContext(capture);
+  std::vector<Payload> payloads;
+  GetPayloads(entry_point, arguments, &payloads);
+  std::ofstream* out = &capture->out;
+  Write(static_cast<uint16_t>(entry_point), out);
+  Write(static_cast<uint8_t>(num_arguments), out);
+  Write(static_cast<uint8_t>(payloads.size()), out);
+  out->write(reinterpret_cast<const char*>(arguments),
+             num_arguments * sizeof(arguments[0]));
+  Write(result, out);
+  for (const Payload& payload : payloads) {
+    Write(static_cast<uint8_t>(payload.argument), out);
+    Write(static_cast<uint8_t>(payload.size_only ?
+                               kGlCapturePayloadSizeOnly : 0), out);
+    Write(static_cast<uint32_t>(payload.size), out);
+    if (!payload.size_only) {
+      out->write(static_cast<const char*>(payload.data), payload.size);
+    }
+  }
+  // Start comparing the storage mapped for writing.
+  const GLbitfield kWriteAccess = GL_MAP_WRITE_BIT;
+  if (entry_point == CALL_MapBufferRange && result != 0 &&
+      (arguments[3] & kWriteAccess) != 0) {
+    Mapping mapping;
+    mapping.buffer = BoundBuffer(arguments[0]);
+    mapping.pointer = FromGlCaptureWord<const GLubyte*>(result);
+    mapping.length = static_cast<GLsizeiptr>(arguments[2]);
+    capture->mappings.push_back(mapping);
+  }
+  RemoveMappings(entry_point, arguments, capture);
+}
+
+}  // namespace wvu
@@ -0,0 +1,181 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_GL_CAPTURE_H_
+#define GLUTILS_GL_CAPTURE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace wvu {
+// Captures of the OpenGL command stream, to reproduce the performance of a
+// run offline, e.g., to bisect a slow frame across driver versions with the
+// replay tool (see gl_replay.h), without the scene and the program that
+// rendered it. A capture records every call of the entry points of
+// gl_entry_points.h from all the contexts, with the data they read from the
+// memory of the program: buffer and texture contents, shader sources, and the
+// writes into mapped buffers, which are compared against a copy of the
+// mapped storage before every call that may read them. The calls are recorded
+// by the wrappers of the call counters, so the build must have the
+// COUNT_GL_CALLS CMake option (see gl_call_counter.h).
+//
+// The replay creates the objects again, so a capture must start before the
+// program creates any, right after InstallGlCallCounters(). Program binaries
+// only load on the driver that created them, so the programs of a capture
+// should be built from their sources. Recording is slow, since every call
+// writes to the file.
+//
+// Example:
+//
+// glewInit();
+// wvu::InstallGlCallCounters();
+// wvu::StartGlCapture("frames.glcapture", width, height, &error_info_log);
+// ...  // Create the scene.
+// for (int i = 0; i < num_frames; ++i) {
+//   RenderFrame();
+//   glfwSwapBuffers(window);
+//   wvu::EndGlCaptureFrame();
+// }
+// wvu::StopGlCapture(&error_info_log);
+
+// The layout of the capture files. A header, with the magic number, the
+// version, the size of the default framebuffer and the names of the entry
+// points, is followed by records that start with their type. The records of
+// calls have the type of their entry point, i.e., its index in the header,
+// the number of arguments and of payloads, the arguments, the result, and the
+// payloads: the index of the argument they replace, their flags, size and
+// data. Integers are stored in the byte order of the program.
+constexpr uint32_t kGlCaptureMagic = 0x50414347;  // "GCAP".
+constexpr uint32_t kGlCaptureVersion = 1;
+// Ends a frame.
+constexpr uint16_t kGlCaptureFrameRecord = 0xff00;
+// Makes a context current: its index, in the order the contexts appear.
+constexpr uint16_t kGlCaptureContextRecord = 0xff01;
+// Writes into mapped storage: the pointer returned by the map call, the
+// offset, the size and the data written.
+constexpr uint16_t kGlCaptureMappedWriteRecord = 0xff02;
+// A payload that only has a size, e.g., the memory written by a call.
+constexpr uint8_t kGlCapturePayloadSizeOnly = 1;
+
+// Starts recording the calls of all the threads into a capture file, which
+// is complete once StopGlCapture() succeeds. Returns true if successful.
+// Parameters:
+//   filepath  The path of the capture file.
+//   framebuffer_width  The size of the default framebuffer, recreated by the
+//   framebuffer_height    replay.
+//   error_info_log  A pointer to a string that holds the error log.
+bool StartGlCapture(const std::string& filepath,
+                    const int framebuffer_width,
+                    const int framebuffer_height,
+                    std::string* error_info_log);
+
+// Marks the end of a frame, e.g., after glfwSwapBuffers(). The replay times
+// the frames.
+void EndGlCaptureFrame();
+
+// Stops recording and completes the capture file. Returns true if successful.
+bool StopGlCapture(std::string* error_info_log);
+
+// Returns true while the calls are recorded.
+bool GlCaptureRecording();
+
+// Returns the number of frames of the current capture.
+int NumGlCaptureFrames();
+
+// Records the writes into the mapped buffers that the call of an entry point
+// may read. Called by the wrappers before the call.
+void BeginCapturedGlCall(const int entry_point);
+
+// Records a call of an entry point, after it returned. Called by the
+// wrappers.
+// Parameters:
+//   entry_point  The GlEntryPoint of the call.
+//   arguments  The arguments of the call, converted with ToGlCaptureWord().
+//   num_arguments  The number of arguments.
+//   result  The result of the call, or zero if it returns nothing.
+void CaptureGlCall(const int entry_point,
+                   const uint64_t* arguments,
+                   const int num_arguments,
+                   const uint64_t result);
+
+// Converts the arguments and results of the calls to and from the words of
+// the captures. Integers and enums keep their value, floating-point numbers
+// their bits, and pointers their address.
+template <typename Value>
+typename std::enable_if<std::is_integral<Value>::value ||
+                        std::is_enum<Value>::value, uint64_t>::type
+ToGlCaptureWord(const Value value) {
+  return static_cast<uint64_t>(value);
+}
+
+template <typename Value>
+typename std::enable_if<std::is_floating_point<Value>::value, uint64_t>::type
+ToGlCaptureWord(const Value value) {
+  uint64_t word = 0;
+  std::memcpy(&word, &value, sizeof(value));
+  return word;
+}
+
+template <typename Value>
+typename std::enable_if<std::is_pointer<Value>::value, uint64_t>::type
+ToGlCaptureWord(const Value value) {
+  return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value));
+}
+
+template <typename Value>
+typename std::enable_if<std::is_integral<Value>::value ||
+                        std::is_enum<Value>::value, Value>::type
+FromGlCaptureWord(const uint64_t word) {
+  return static_cast<Value>(word);
+}
+
+template <typename Value>
+typename std::enable_if<std::is_floating_point<Value>::value, Value>::type
+FromGlCaptureWord(const uint64_t word) {
+  Value value;
+  std::memcpy(&value, &word, sizeof(value));
+  return value;
+}
+
+template <typename Value>
+typename std::enable_if<std::is_pointer<Value>::value, Value>::type
+FromGlCaptureWord(const uint64_t word) {
+  return reinterpret_cast<Value>(static_cast<uintptr_t>(word));
+}
+
+}  // namespace wvu
+
+#endif  // GLUTILS_GL_CAPTURE_H_
@@ -0,0 +1,194 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "gl_debug_output.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+namespace {
+// Longest label of an object. GL_MAX_LABEL_LENGTH, which counts the null
+// terminator, is at least 256.
+constexpr int kMaxObjectLabelLength = 255;
+
+// Returns true if the context has the debug output.
+bool DebugOutputSupported() {
+  return GLEW_VERSION_4_3 || GLEW_KHR_debug;
+}
+
+std::string SourceName(const GLenum source) {
+  switch (source) {
+    case GL_DEBUG_SOURCE_API:
+      return "api";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+      return "window system";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER:
+      return "shader compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY:
+      return "third party";
+    case GL_DEBUG_SOURCE_APPLICATION:
+      return "application";
+    default:
+      return "other";
+  }
+}
+
+std::string SeverityName(const GLenum severity) {
+  switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH:
+      return "high";
+    case GL_DEBUG_SEVERITY_MEDIUM:
+      return "medium";
+    case GL_DEBUG_SEVERITY_LOW:
+      return "low";
+    default:
+      return "notification";
+  }
+}
+
+}  // namespace
+
+GlDebugOutput::GlDebugOutput()
+    : installed_(false),
+      num_messages_(0),
+      num_current_frame_messages_(0),
+      num_frame_messages_(0) {}
+
+GlDebugOutput::~GlDebugOutput() {
+  if (installed_) glDebugMessageCallback(nullptr, nullptr);
+}
+
+bool GlDebugOutput::Initialize(std::string* error_info_log) {
+  if (!DebugOutputSupported()) {
+    *error_info_log = "The context does not support KHR_debug.";
+    return false;
+  }
+  GLint context_flags = 0;
+  glGetIntegerv(GL_CONTEXT_FLAGS, &context_flags);
+  if ((context_flags & GL_CONTEXT_FLAG_DEBUG_BIT) == 0) {
+    *error_info_log = "The context is not a debug context.";
+    return false;
+  }
+  glEnable(GL_DEBUG_OUTPUT);
+  // Synchronous messages are received before the call returns, by the thread
+  // that made it.
+  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr,
+                        GL_FALSE);
+  glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PERFORMANCE, GL_DONT_CARE,
+                        0, nullptr, GL_TRUE);
+  glDebugMessageCallback(&GlDebugOutput::ReceiveMessage, this);
+  installed_ = true;
+  return true;
+}
+
+void GlDebugOutput::BeginFrame() {
+  for (int i = 0; i < static_cast<int>(message_ids_.size()); ++i) {
+    message_ids_[i].num_frame_messages = current_frame_messages_[i];
+    current_frame_messages_[i] = 0;
+  }
+  num_frame_messages_ = num_current_frame_messages_;
+  num_current_frame_messages_ = 0;
+}
+
+void GlDebugOutput::GetStatistics(
+    std::vector<GlDebugMessageStatistics>* statistics) const {
+  *statistics = message_ids_;
+  std::stable_sort(statistics->begin(), statistics->end(),
+                   [](const GlDebugMessageStatistics& a,
+                      const GlDebugMessageStatistics& b) {
+                     return a.num_messages > b.num_messages;
+                   });
+}
+
+std::string GlDebugOutput::Report() const {
+  std::vector<GlDebugMessageStatistics> statistics;
+  GetStatistics(&statistics);
+  std::ostringstream report;
+  for (const GlDebugMessageStatistics& message_id : statistics) {
+    report << "\n  " << SourceName(message_id.source) << " " << message_id.id
+           << " (" << SeverityName(message_id.severity)
+           << "): " << message_id.num_messages << " messages, "
+           << message_id.num_frame_messages << " in the last frame. "
+           << message_id.message;
+  }
+  return report.str();
+}
+
+void GLAPIENTRY GlDebugOutput::ReceiveMessage(GLenum source,
+                                              GLenum type,
+                                              GLuint id,
+                                              GLenum severity,
+                                              GLsizei length,
+                                              const GLchar* message,
+                                              const void* user_parameter) {
+  if (type != GL_DEBUG_TYPE_PERFORMANCE) return;
+  GlDebugOutput* debug_output =
+      static_cast<GlDebugOutput*>(const_cast<void*>(user_parameter));
+  const auto inserted = debug_output->message_id_indices_.emplace(
+      std::make_pair(source, id), debug_output->message_ids_.size());
+  if (inserted.second) {
+    GlDebugMessageStatistics message_id;
+    message_id.source = source;
+    message_id.id = id;
+    message_id.severity = severity;
+    message_id.message = length < 0 ?
+        std::string(message) : std::string(message, length);
+    debug_output->message_ids_.push_back(message_id);
+    debug_output->current_frame_messages_.push_back(0);
+  }
+  const int index = inserted.first->second;
+  ++debug_output->message_ids_[index].num_messages;
+  ++debug_output->current_frame_messages_[index];
+  ++debug_output->num_messages_;
+  ++debug_output->num_current_frame_messages_;
+}
+
+void SetObjectLabel(const GLenum identifier,
+                    const GLuint name,
+                    const std::string& label) {
+  if (name == 0 || !DebugOutputSupported()) return;
+  const GLsizei length =
+      std::min(static_cast<int>(label.size()), kMaxObjectLabelLength);
+  glObjectLabel(identifier, name, length, label.data());
+}
+
+}  // namespace wvu
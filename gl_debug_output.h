@@ -0,0 +1,147 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_GL_DEBUG_OUTPUT_H_
+#define GLUTILS_GL_DEBUG_OUTPUT_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+// The performance messages of the driver with the same id, e.g., a buffer
+// update that stalls on the GPU or a shader recompiled for a new state.
+struct GlDebugMessageStatistics {
+  GLenum source = 0;
+  GLuint id = 0;
+  GLenum severity = 0;
+  // The text of the first message with the id.
+  std::string message;
+  int64_t num_messages = 0;
+  // The messages of the last complete frame.
+  int num_frame_messages = 0;
+};
+
+// This class receives the performance messages that the driver reports
+// through the debug output of KHR_debug (or OpenGL 4.3), and aggregates them
+// by id. Drivers only report most of them in debug contexts, i.e., windows
+// created with the GLFW_OPENGL_DEBUG_CONTEXT hint, which are also slower, so
+// the debug output is meant for profiling sessions. The messages are
+// synchronous, so they are received by the thread calling OpenGL, right after
+// the call that caused them, and only the context current at Initialize()
+// reports them.
+//
+// Example:
+//
+// glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+// ...  // Create the window and initialize GLEW.
+// wvu::GlDebugOutput debug_output;
+// debug_output.Initialize(&error_info_log);
+// while (...) {  // Rendering loop.
+//   debug_output.BeginFrame();
+//   RenderFrame();
+// }
+// LOG(INFO) << debug_output.Report();
+class GlDebugOutput {
+ public:
+  GlDebugOutput();
+  // Removes the callback, so the context must be current if it was installed.
+  ~GlDebugOutput();
+
+  // Installs the message callback on the current context, and filters the
+  // messages other than GL_DEBUG_TYPE_PERFORMANCE out. Returns true if
+  // successful, and false if the context does not support the debug output or
+  // is not a debug context.
+  bool Initialize(std::string* error_info_log);
+
+  // Ends the frame of the counters and starts the next one.
+  void BeginFrame();
+
+  // Computes the statistics of the message ids, sorted by decreasing number of
+  // messages.
+  void GetStatistics(std::vector<GlDebugMessageStatistics>* statistics) const;
+
+  // Returns a table of the message ids, with the text of their first message.
+  std::string Report() const;
+
+  // Returns the number of messages received since Initialize().
+  int64_t num_messages() const {
+    return num_messages_;
+  }
+
+  // Returns the number of messages of the last complete frame.
+  int num_frame_messages() const {
+    return num_frame_messages_;
+  }
+
+ private:
+  static void GLAPIENTRY ReceiveMessage(GLenum source,
+                                        GLenum type,
+                                        GLuint id,
+                                        GLenum severity,
+                                        GLsizei length,
+                                        const GLchar* message,
+                                        const void* user_parameter);
+
+  bool installed_;
+  std::vector<GlDebugMessageStatistics> message_ids_;
+  // Index in message_ids_ of every (source, id) pair.
+  std::map<std::pair<GLenum, GLuint>, int> message_id_indices_;
+  int64_t num_messages_;
+  // Messages of the current frame, in total and per message id.
+  int num_current_frame_messages_;
+  std::vector<int> current_frame_messages_;
+  int num_frame_messages_;
+
+  GlDebugOutput(const GlDebugOutput&) = delete;
+  GlDebugOutput& operator=(const GlDebugOutput&) = delete;
+};
+
+// Names an OpenGL object, e.g., for the debug output and for the debuggers.
+// Does nothing if the context does not support KHR_debug (or OpenGL 4.3). The
+// label is truncated to 255 characters, the smallest limit of the contexts.
+// Parameters:
+//   identifier  The namespace of the object, e.g., GL_BUFFER or GL_PROGRAM.
+//   name  The id of the object.
+//   label  The name of the object.
+void SetObjectLabel(const GLenum identifier,
+                    const GLuint name,
+                    const std::string& label);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_GL_DEBUG_OUTPUT_H_
@@ -0,0 +1,378 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_GL_ENTRY_POINTS_H_
+#define GLUTILS_GL_ENTRY_POINTS_H_
+
+#include <GL/glew.h>
+
+// The OpenGL entry points wrapped by the call counters (see gl_call_counter.h)
+// and recorded by the captures (see gl_capture.h). Every entry point lists the
+// kind of its result and of each of its parameters (see GlArgumentKind), which
+// tell the replay how to translate its arguments.
+
+// The entry points loaded by GLEW, whose pointers are named __glew<name>.
+#define GLUTILS_GLEW_ENTRY_POINTS(X)                                          \
+  X(ActiveTexture, (ARG_VOID, ARG_VALUE))                                     \
+  X(AttachShader, (ARG_VOID, ARG_PROGRAM, ARG_SHADER))                        \
+  X(BindBuffer, (ARG_VOID, ARG_VALUE, ARG_BUFFER))                            \
+  X(BindBufferBase, (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_BUFFER))             \
+  X(BindBufferRange,                                                          \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_BUFFER, ARG_VALUE, ARG_VALUE))       \
+  X(BindFramebuffer, (ARG_VOID, ARG_VALUE, ARG_FRAMEBUFFER))                  \
+  X(BindImageTexture,                                                         \
+    (ARG_VOID, ARG_VALUE, ARG_TEXTURE, ARG_VALUE, ARG_VALUE, ARG_VALUE,       \
+     ARG_VALUE, ARG_VALUE))                                                   \
+  X(BindProgramPipeline, (ARG_VOID, ARG_PIPELINE))                            \
+  X(BindRenderbuffer, (ARG_VOID, ARG_VALUE, ARG_RENDERBUFFER))                \
+  X(BindVertexArray, (ARG_VOID, ARG_VERTEX_ARRAY))                            \
+  X(BlendFuncSeparate, (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE)) \
+  X(BlitFramebuffer,                                                          \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))                  \
+  X(BufferData, (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_DATA, ARG_VALUE))        \
+  X(BufferStorage, (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_DATA, ARG_VALUE))     \
+  X(BufferSubData, (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_DATA))     \
+  X(ClearBufferData,                                                          \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_DATA))         \
+  X(ClearBufferfv, (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_DATA))                \
+  X(ClientWaitSync, (ARG_VALUE, ARG_SYNC, ARG_VALUE, ARG_VALUE))              \
+  X(CompileShader, (ARG_VOID, ARG_SHADER))                                    \
+  X(CompressedTexImage2D,                                                     \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE, ARG_VALUE, ARG_DATA))                                         \
+  X(CompressedTexImage3D,                                                     \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_DATA))                              \
+  X(CompressedTexSubImage2D,                                                  \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_DATA))                              \
+  X(CompressedTexSubImage3D,                                                  \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_DATA))        \
+  X(CopyBufferSubData,                                                        \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))        \
+  X(CreateProgram, (ARG_NEW_PROGRAM))                                         \
+  X(CreateShader, (ARG_NEW_SHADER, ARG_VALUE))                                \
+  X(CreateShaderProgramv,                                                     \
+    (ARG_NEW_PROGRAM, ARG_VALUE, ARG_VALUE, ARG_STRINGS))                     \
+  X(DeleteBuffers, (ARG_VOID, ARG_VALUE, ARG_BUFFERS))                        \
+  X(DeleteFramebuffers, (ARG_VOID, ARG_VALUE, ARG_FRAMEBUFFERS))              \
+  X(DeleteProgram, (ARG_VOID, ARG_PROGRAM))                                   \
+  X(DeleteProgramPipelines, (ARG_VOID, ARG_VALUE, ARG_PIPELINES))             \
+  X(DeleteQueries, (ARG_VOID, ARG_VALUE, ARG_QUERIES))                        \
+  X(DeleteRenderbuffers, (ARG_VOID, ARG_VALUE, ARG_RENDERBUFFERS))            \
+  X(DeleteShader, (ARG_VOID, ARG_SHADER))                                     \
+  X(DeleteSync, (ARG_VOID, ARG_SYNC))                                         \
+  X(DeleteVertexArrays, (ARG_VOID, ARG_VALUE, ARG_VERTEX_ARRAYS))             \
+  X(DetachShader, (ARG_VOID, ARG_PROGRAM, ARG_SHADER))                        \
+  X(DispatchCompute, (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE))             \
+  X(DrawArraysInstanced,                                                      \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))                   \
+  X(DrawBuffers, (ARG_VOID, ARG_VALUE, ARG_DATA))                             \
+  X(DrawElementsBaseVertex,                                                   \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))        \
+  X(DrawElementsInstanced,                                                    \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))        \
+  X(DrawElementsInstancedBaseInstance,                                        \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE))                                                              \
+  X(DrawElementsInstancedBaseVertex,                                          \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE))                                                              \
+  X(DrawElementsInstancedBaseVertexBaseInstance,                              \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE, ARG_VALUE))                                                   \
+  X(EnableVertexAttribArray, (ARG_VOID, ARG_VALUE))                           \
+  X(FenceSync, (ARG_NEW_SYNC, ARG_VALUE, ARG_VALUE))                          \
+  X(FlushMappedBufferRange, (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE))      \
+  X(FramebufferRenderbuffer,                                                  \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_RENDERBUFFER))            \
+  X(FramebufferTexture2D,                                                     \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_TEXTURE, ARG_VALUE))      \
+  X(FramebufferTextureLayer,                                                  \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_TEXTURE, ARG_VALUE, ARG_VALUE))      \
+  X(GenBuffers, (ARG_VOID, ARG_VALUE, ARG_NEW_BUFFERS))                       \
+  X(GenFramebuffers, (ARG_VOID, ARG_VALUE, ARG_NEW_FRAMEBUFFERS))             \
+  X(GenProgramPipelines, (ARG_VOID, ARG_VALUE, ARG_NEW_PIPELINES))            \
+  X(GenQueries, (ARG_VOID, ARG_VALUE, ARG_NEW_QUERIES))                       \
+  X(GenRenderbuffers, (ARG_VOID, ARG_VALUE, ARG_NEW_RENDERBUFFERS))           \
+  X(GenVertexArrays, (ARG_VOID, ARG_VALUE, ARG_NEW_VERTEX_ARRAYS))            \
+  X(GenerateMipmap, (ARG_VOID, ARG_VALUE))                                    \
+  X(GetProgramResourceIndex,                                                  \
+    (ARG_NEW_RESOURCE_INDEX, ARG_PROGRAM, ARG_VALUE, ARG_STRING))             \
+  X(GetUniformLocation, (ARG_NEW_LOCATION, ARG_PROGRAM, ARG_STRING))          \
+  X(LinkProgram, (ARG_VOID, ARG_PROGRAM))                                     \
+  X(MapBufferRange,                                                           \
+    (ARG_NEW_MAPPING, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))            \
+  X(MemoryBarrier, (ARG_VOID, ARG_VALUE))                                     \
+  X(MultiDrawElements,                                                        \
+    (ARG_VOID, ARG_VALUE, ARG_DATA, ARG_VALUE, ARG_DATA, ARG_VALUE))          \
+  X(MultiDrawElementsIndirect,                                                \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))        \
+  X(MultiDrawElementsIndirectCountARB,                                        \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE))                                                              \
+  X(PrimitiveRestartIndex, (ARG_VOID, ARG_VALUE))                             \
+  X(ProgramBinary, (ARG_VOID, ARG_PROGRAM, ARG_VALUE, ARG_DATA, ARG_VALUE))   \
+  X(ProgramParameteri, (ARG_VOID, ARG_PROGRAM, ARG_VALUE, ARG_VALUE))         \
+  X(ProgramUniform1f, (ARG_VOID, ARG_PROGRAM, ARG_LOCATION, ARG_VALUE))       \
+  X(ProgramUniform1i, (ARG_VOID, ARG_PROGRAM, ARG_LOCATION, ARG_VALUE))       \
+  X(ProgramUniform3fv,                                                        \
+    (ARG_VOID, ARG_PROGRAM, ARG_LOCATION, ARG_VALUE, ARG_DATA))               \
+  X(ProgramUniformMatrix4fv,                                                  \
+    (ARG_VOID, ARG_PROGRAM, ARG_LOCATION, ARG_VALUE, ARG_VALUE, ARG_DATA))    \
+  X(QueryCounter, (ARG_VOID, ARG_QUERY, ARG_VALUE))                           \
+  X(RenderbufferStorage,                                                      \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))                   \
+  X(RenderbufferStorageMultisample,                                           \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))        \
+  X(ShaderSource, (ARG_VOID, ARG_SHADER, ARG_VALUE, ARG_STRINGS, ARG_NULL))   \
+  X(ShaderStorageBlockBinding,                                                \
+    (ARG_VOID, ARG_PROGRAM, ARG_RESOURCE_INDEX, ARG_VALUE))                   \
+  X(TexImage3D,                                                               \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_DATA))                   \
+  X(TexStorage2D,                                                             \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))        \
+  X(TexStorage3D,                                                             \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE))                                                              \
+  X(TexSubImage3D,                                                            \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_DATA))        \
+  X(Uniform1f, (ARG_VOID, ARG_LOCATION, ARG_VALUE))                           \
+  X(Uniform1i, (ARG_VOID, ARG_LOCATION, ARG_VALUE))                           \
+  X(Uniform2f, (ARG_VOID, ARG_LOCATION, ARG_VALUE, ARG_VALUE))                \
+  X(Uniform3f, (ARG_VOID, ARG_LOCATION, ARG_VALUE, ARG_VALUE, ARG_VALUE))     \
+  X(Uniform3fv, (ARG_VOID, ARG_LOCATION, ARG_VALUE, ARG_DATA))                \
+  X(Uniform4f,                                                                \
+    (ARG_VOID, ARG_LOCATION, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))     \
+  X(Uniform4fv, (ARG_VOID, ARG_LOCATION, ARG_VALUE, ARG_DATA))                \
+  X(UniformBlockBinding, (ARG_VOID, ARG_PROGRAM, ARG_VALUE, ARG_VALUE))       \
+  X(UniformMatrix3fv,                                                         \
+    (ARG_VOID, ARG_LOCATION, ARG_VALUE, ARG_VALUE, ARG_DATA))                 \
+  X(UniformMatrix4fv,                                                         \
+    (ARG_VOID, ARG_LOCATION, ARG_VALUE, ARG_VALUE, ARG_DATA))                 \
+  X(UnmapBuffer, (ARG_VALUE, ARG_VALUE))                                      \
+  X(UseProgram, (ARG_VOID, ARG_PROGRAM))                                      \
+  X(UseProgramStages, (ARG_VOID, ARG_PIPELINE, ARG_VALUE, ARG_PROGRAM))       \
+  X(ValidateProgramPipeline, (ARG_VOID, ARG_PIPELINE))                        \
+  X(VertexAttribDivisor, (ARG_VOID, ARG_VALUE, ARG_VALUE))                    \
+  X(VertexAttribIPointer,                                                     \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))        \
+  X(VertexAttribPointer,                                                      \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE))                                                              \
+  X(ViewportArrayv, (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_DATA))
+
+// The OpenGL 1.1 entry points, with their parameters and arguments. They are
+// wrapped by the linker, so the list must match the one of CMakeLists.txt.
+#define GLUTILS_CORE_ENTRY_POINTS(X)                                          \
+  X(BindTexture, (GLenum target, GLuint texture), (target, texture),          \
+    (ARG_VOID, ARG_VALUE, ARG_TEXTURE))                                       \
+  X(BlendFunc, (GLenum source, GLenum destination), (source, destination),    \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE))                                         \
+  X(Clear, (GLbitfield mask), (mask), (ARG_VOID, ARG_VALUE))                  \
+  X(ClearColor,                                                               \
+    (GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha),            \
+    (red, green, blue, alpha),                                                \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))                   \
+  X(ColorMask,                                                                \
+    (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha),        \
+    (red, green, blue, alpha),                                                \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))                   \
+  X(CullFace, (GLenum mode), (mode), (ARG_VOID, ARG_VALUE))                   \
+  X(DeleteTextures, (GLsizei count, const GLuint* textures),                  \
+    (count, textures), (ARG_VOID, ARG_VALUE, ARG_TEXTURES))                   \
+  X(DepthFunc, (GLenum function), (function), (ARG_VOID, ARG_VALUE))          \
+  X(DepthMask, (GLboolean flag), (flag), (ARG_VOID, ARG_VALUE))               \
+  X(Disable, (GLenum capability), (capability), (ARG_VOID, ARG_VALUE))        \
+  X(DrawArrays, (GLenum mode, GLint first, GLsizei count),                    \
+    (mode, first, count), (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE))        \
+  X(DrawBuffer, (GLenum buffer), (buffer), (ARG_VOID, ARG_VALUE))             \
+  X(DrawElements,                                                             \
+    (GLenum mode, GLsizei count, GLenum type, const GLvoid* indices),         \
+    (mode, count, type, indices),                                             \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))                   \
+  X(Enable, (GLenum capability), (capability), (ARG_VOID, ARG_VALUE))         \
+  X(Finish, (), (), (ARG_VOID))                                               \
+  X(Flush, (), (), (ARG_VOID))                                                \
+  X(GenTextures, (GLsizei count, GLuint* textures), (count, textures),        \
+    (ARG_VOID, ARG_VALUE, ARG_NEW_TEXTURES))                                  \
+  X(PixelStorei, (GLenum name, GLint value), (name, value),                   \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE))                                         \
+  X(PolygonMode, (GLenum face, GLenum mode), (face, mode),                    \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE))                                         \
+  X(PolygonOffset, (GLfloat factor, GLfloat units), (factor, units),          \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE))                                         \
+  X(ReadBuffer, (GLenum buffer), (buffer), (ARG_VOID, ARG_VALUE))             \
+  X(ReadPixels,                                                               \
+    (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format,          \
+     GLenum type, GLvoid* pixels),                                            \
+    (x, y, width, height, format, type, pixels),                              \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE, ARG_OUTPUT))                                                  \
+  X(Scissor, (GLint x, GLint y, GLsizei width, GLsizei height),               \
+    (x, y, width, height),                                                    \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))                   \
+  X(TexImage2D,                                                               \
+    (GLenum target, GLint level, GLint internal_format, GLsizei width,        \
+     GLsizei height, GLint border, GLenum format, GLenum type,                \
+     const GLvoid* pixels),                                                   \
+    (target, level, internal_format, width, height, border, format, type,     \
+     pixels),                                                                 \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_DATA))                              \
+  X(TexParameteri, (GLenum target, GLenum name, GLint value),                 \
+    (target, name, value), (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE))       \
+  X(TexSubImage2D,                                                            \
+    (GLenum target, GLint level, GLint x, GLint y, GLsizei width,             \
+     GLsizei height, GLenum format, GLenum type, const GLvoid* pixels),       \
+    (target, level, x, y, width, height, format, type, pixels),               \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE,         \
+     ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_DATA))                              \
+  X(Viewport, (GLint x, GLint y, GLsizei width, GLsizei height),              \
+    (x, y, width, height),                                                    \
+    (ARG_VOID, ARG_VALUE, ARG_VALUE, ARG_VALUE, ARG_VALUE))
+
+namespace wvu {
+// Largest number of parameters of the entry points.
+constexpr int kMaxGlEntryPointParameters = 11;
+
+#define GLUTILS_GLEW_ENTRY_POINT_ID(name, kinds) CALL_##name,
+#define GLUTILS_CORE_ENTRY_POINT_ID(name, parameters, arguments, kinds) \
+  CALL_##name,
+
+// Ids of the wrapped entry points.
+enum GlEntryPoint {
+  GLUTILS_GLEW_ENTRY_POINTS(GLUTILS_GLEW_ENTRY_POINT_ID)
+  GLUTILS_CORE_ENTRY_POINTS(GLUTILS_CORE_ENTRY_POINT_ID)
+  NUM_GL_ENTRY_POINTS
+};
+
+#undef GLUTILS_GLEW_ENTRY_POINT_ID
+#undef GLUTILS_CORE_ENTRY_POINT_ID
+
+// The meaning of a result or a parameter of an entry point. The names of the
+// objects differ between the capture and the replay, and so do the uniform
+// locations, the resource indices and the mapped pointers.
+enum GlArgumentKind {
+  ARG_VOID = 0,
+  // A value used as is, e.g., an enum, a size, or an offset into a buffer.
+  ARG_VALUE = 1,
+  // The name of an object, in the order of GlNameSpace.
+  ARG_BUFFER = 2,
+  ARG_TEXTURE = 3,
+  ARG_VERTEX_ARRAY = 4,
+  ARG_FRAMEBUFFER = 5,
+  ARG_RENDERBUFFER = 6,
+  ARG_QUERY = 7,
+  ARG_PIPELINE = 8,
+  ARG_PROGRAM = 9,
+  ARG_SHADER = 10,
+  ARG_SYNC = 11,
+  // An array of names deleted by the call, in the same order.
+  ARG_BUFFERS = 12,
+  ARG_TEXTURES = 13,
+  ARG_VERTEX_ARRAYS = 14,
+  ARG_FRAMEBUFFERS = 15,
+  ARG_RENDERBUFFERS = 16,
+  ARG_QUERIES = 17,
+  ARG_PIPELINES = 18,
+  // An array receiving the names created by the call, in the same order.
+  ARG_NEW_BUFFERS = 19,
+  ARG_NEW_TEXTURES = 20,
+  ARG_NEW_VERTEX_ARRAYS = 21,
+  ARG_NEW_FRAMEBUFFERS = 22,
+  ARG_NEW_RENDERBUFFERS = 23,
+  ARG_NEW_QUERIES = 24,
+  ARG_NEW_PIPELINES = 25,
+  // A name created by the call and returned.
+  ARG_NEW_PROGRAM = 26,
+  ARG_NEW_SHADER = 27,
+  ARG_NEW_SYNC = 28,
+  // A uniform location or a resource index of the program of the call, or of
+  // the program in use, and the call that returns it.
+  ARG_LOCATION = 29,
+  ARG_NEW_LOCATION = 30,
+  ARG_RESOURCE_INDEX = 31,
+  ARG_NEW_RESOURCE_INDEX = 32,
+  // A pointer to the mapped storage of a buffer returned by the call.
+  ARG_NEW_MAPPING = 33,
+  // A pointer to the data read by the call, or an offset into the buffer
+  // bound to the target of the call.
+  ARG_DATA = 34,
+  // A null-terminated string, and an array of strings.
+  ARG_STRING = 35,
+  ARG_STRINGS = 36,
+  // A pointer to the memory written by the call, or an offset into a buffer.
+  ARG_OUTPUT = 37,
+  // A pointer replayed as nullptr, e.g., the lengths of null-terminated
+  // strings.
+  ARG_NULL = 38
+};
+
+// The kinds of objects whose names are translated by the replay.
+enum GlNameSpace {
+  BUFFER_NAMES = 0,
+  TEXTURE_NAMES = 1,
+  VERTEX_ARRAY_NAMES = 2,
+  FRAMEBUFFER_NAMES = 3,
+  RENDERBUFFER_NAMES = 4,
+  QUERY_NAMES = 5,
+  PIPELINE_NAMES = 6,
+  PROGRAM_NAMES = 7,
+  SHADER_NAMES = 8,
+  SYNC_NAMES = 9,
+  NUM_GL_NAME_SPACES = 10
+};
+
+// Returns the name of an entry point, e.g., "glDrawElements".
+inline const char* GlEntryPointName(const int entry_point) {
+#define GLUTILS_GLEW_ENTRY_POINT_NAME(name, kinds) "gl" #name,
+#define GLUTILS_CORE_ENTRY_POINT_NAME(name, parameters, arguments, kinds) \
+  "gl" #name,
+  static const char* const kNames[NUM_GL_ENTRY_POINTS] = {
+    GLUTILS_GLEW_ENTRY_POINTS(GLUTILS_GLEW_ENTRY_POINT_NAME)
+    GLUTILS_CORE_ENTRY_POINTS(GLUTILS_CORE_ENTRY_POINT_NAME)
+  };
+#undef GLUTILS_GLEW_ENTRY_POINT_NAME
+#undef GLUTILS_CORE_ENTRY_POINT_NAME
+  return kNames[entry_point];
+}
+
+}  // namespace wvu
+
+#endif  // GLUTILS_GL_ENTRY_POINTS_H_
@@ -0,0 +1,519 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "gl_replay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "gl_capture.h"
+#include "gl_entry_points.h"
+#include "mapped_file.h"
+
+namespace wvu {
+namespace {
+// Reads the values of a capture, checking that they are in the file.
+class CaptureReader {
+ public:
+  CaptureReader(const char* data, const size_t size)
+      : data_(data), size_(size), offset_(0) {}
+
+  template <typename Value>
+  bool Read(Value* value) {
+    if (size_ - offset_ < sizeof(*value)) return false;
+    std::memcpy(value, data_ + offset_, sizeof(*value));
+    offset_ += sizeof(*value);
+    return true;
+  }
+
+  bool ReadBytes(const size_t size, std::string* bytes) {
+    if (size_ - offset_ < size) return false;
+    bytes->assign(data_ + offset_, size);
+    offset_ += size;
+    return true;
+  }
+
+  bool done() const {
+    return offset_ == size_;
+  }
+
+ private:
+  const char* data_;
+  const size_t size_;
+  size_t offset_;
+};
+
+// Calls an entry point with the words of its arguments, and returns the word
+// of its result.
+template <int... kIndices>
+struct IndexSequence {};
+
+template <int kSize, int... kIndices>
+struct MakeIndexSequence
+    : MakeIndexSequence<kSize - 1, kSize - 1, kIndices...> {};
+
+template <int... kIndices>
+struct MakeIndexSequence<0, kIndices...> {
+  typedef IndexSequence<kIndices...> Type;
+};
+
+template <typename Return>
+struct WordCall {
+  template <typename... Arguments, int... kIndices>
+  static uint64_t Call(Return (GLAPIENTRY* function)(Arguments...),
+                       const uint64_t* words,
+                       IndexSequence<kIndices...>) {
+    return ToGlCaptureWord(
+        function(FromGlCaptureWord<Arguments>(words[kIndices])...));
+  }
+};
+
+template <>
+struct WordCall<void> {
+  template <typename... Arguments, int... kIndices>
+  static uint64_t Call(void (GLAPIENTRY* function)(Arguments...),
+                       const uint64_t* words,
+                       IndexSequence<kIndices...>) {
+    function(FromGlCaptureWord<Arguments>(words[kIndices])...);
+    return 0;
+  }
+};
+
+template <typename Return, typename... Arguments>
+uint64_t CallWithWords(Return (GLAPIENTRY* function)(Arguments...),
+                       const uint64_t* words) {
+  return WordCall<Return>::Call(
+      function, words,
+      typename MakeIndexSequence<sizeof...(Arguments)>::Type());
+}
+
+// Calls an entry point of the replay. Returns false if the driver does not
+// have it.
+typedef bool (*GlInvoker)(const uint64_t* words, uint64_t* result);
+
+#define GLUTILS_GLEW_INVOKER(name, kinds)                             \
+  [](const uint64_t* words, uint64_t* result) -> bool {               \
+    if (__glew##name == nullptr) return false;                        \
+    *result = CallWithWords(__glew##name, words);                     \
+    return true;                                                      \
+  },
+#define GLUTILS_CORE_INVOKER(name, parameters, arguments, kinds)      \
+  [](const uint64_t* words, uint64_t* result) -> bool {               \
+    *result = CallWithWords(&gl##name, words);                        \
+    return true;                                                      \
+  },
+
+const GlInvoker kGlInvokers[NUM_GL_ENTRY_POINTS] = {
+  GLUTILS_GLEW_ENTRY_POINTS(GLUTILS_GLEW_INVOKER)
+  GLUTILS_CORE_ENTRY_POINTS(GLUTILS_CORE_INVOKER)
+};
+
+#undef GLUTILS_GLEW_INVOKER
+#undef GLUTILS_CORE_INVOKER
+
+// The kinds of the result and of the parameters of every entry point.
+#define GLUTILS_BRACED(...) {__VA_ARGS__}
+#define GLUTILS_GLEW_KINDS(name, kinds) GLUTILS_BRACED kinds,
+#define GLUTILS_CORE_KINDS(name, parameters, arguments, kinds) \
+  GLUTILS_BRACED kinds,
+
+const GlArgumentKind
+    kGlArgumentKinds[NUM_GL_ENTRY_POINTS][kMaxGlEntryPointParameters + 1] = {
+  GLUTILS_GLEW_ENTRY_POINTS(GLUTILS_GLEW_KINDS)
+  GLUTILS_CORE_ENTRY_POINTS(GLUTILS_CORE_KINDS)
+};
+
+#undef GLUTILS_BRACED
+#undef GLUTILS_GLEW_KINDS
+#undef GLUTILS_CORE_KINDS
+
+// Returns the key of a location or a resource index of a program.
+uint64_t ProgramKey(const uint64_t program, const uint64_t value) {
+  return (program << 32) | static_cast<uint32_t>(value);
+}
+
+double MillisecondsBetween(const std::chrono::steady_clock::time_point begin,
+                           const std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+}  // namespace
+
+GlReplay::~GlReplay() {
+  for (int i = 1; i < contexts_.size(); ++i) {
+    glfwDestroyWindow(contexts_[i]);
+  }
+}
+
+bool GlReplay::Open(const std::string& filepath,
+                    GLFWwindow* main_window,
+                    std::string* error_info_log) {
+  MappedFile file;
+  if (!file.Open(filepath)) {
+    *error_info_log = "Could not open " + filepath;
+    return false;
+  }
+  CaptureReader reader(file.data(), file.size());
+  const std::string corrupt = filepath + " is not a complete capture.";
+  uint32_t magic, version, num_entry_points;
+  int32_t width, height;
+  if (!reader.Read(&magic) || magic != kGlCaptureMagic ||
+      !reader.Read(&version)) {
+    *error_info_log = filepath + " is not a capture.";
+    return false;
+  }
+  if (version != kGlCaptureVersion) {
+    *error_info_log = filepath + " has an unsupported version.";
+    return false;
+  }
+  if (!reader.Read(&width) || !reader.Read(&height) ||
+      !reader.Read(&num_entry_points)) {
+    *error_info_log = corrupt;
+    return false;
+  }
+  framebuffer_width_ = width;
+  framebuffer_height_ = height;
+
+  // The entry points of the capture, which may list them in another order.
+  std::unordered_map<std::string, int> entry_point_ids;
+  for (int i = 0; i < NUM_GL_ENTRY_POINTS; ++i) {
+    entry_point_ids[GlEntryPointName(i)] = i;
+  }
+  std::vector<std::string> entry_point_names(num_entry_points);
+  std::vector<int> entry_points(num_entry_points, -1);
+  for (int i = 0; i < num_entry_points; ++i) {
+    uint16_t length;
+    if (!reader.Read(&length) ||
+        !reader.ReadBytes(length, &entry_point_names[i])) {
+      *error_info_log = corrupt;
+      return false;
+    }
+    const auto id = entry_point_ids.find(entry_point_names[i]);
+    if (id != entry_point_ids.end()) entry_points[i] = id->second;
+  }
+
+  commands_.clear();
+  frame_ends_.clear();
+  int num_contexts = 1;
+  while (!reader.done()) {
+    uint16_t type;
+    if (!reader.Read(&type)) {
+      *error_info_log = corrupt;
+      return false;
+    }
+    Command command;
+    if (type == kGlCaptureFrameRecord) {
+      command.type = Command::FRAME;
+      commands_.push_back(std::move(command));
+      frame_ends_.push_back(commands_.size());
+      continue;
+    }
+    if (type == kGlCaptureContextRecord) {
+      uint32_t context;
+      if (!reader.Read(&context)) {
+        *error_info_log = corrupt;
+        return false;
+      }
+      command.type = Command::CONTEXT;
+      command.id = context;
+      num_contexts = std::max<int>(num_contexts, context + 1);
+      commands_.push_back(std::move(command));
+      continue;
+    }
+    if (type == kGlCaptureMappedWriteRecord) {
+      Payload payload;
+      command.type = Command::MAPPED_WRITE;
+      payload.argument = 0;
+      payload.size_only = false;
+      if (!reader.Read(&command.id) || !reader.Read(&command.arguments[0]) ||
+          !reader.Read(&payload.size) ||
+          !reader.ReadBytes(payload.size, &payload.data)) {
+        *error_info_log = corrupt;
+        return false;
+      }
+      command.payloads.push_back(std::move(payload));
+      commands_.push_back(std::move(command));
+      continue;
+    }
+    if (type >= num_entry_points) {
+      *error_info_log = corrupt;
+      return false;
+    }
+    if (entry_points[type] < 0) {
+      *error_info_log = "The replay does not know " + entry_point_names[type];
+      return false;
+    }
+    command.type = Command::CALL;
+    command.id = entry_points[type];
+    uint8_t num_arguments, num_payloads;
+    if (!reader.Read(&num_arguments) || !reader.Read(&num_payloads) ||
+        num_arguments > kMaxGlEntryPointParameters) {
+      *error_info_log = corrupt;
+      return false;
+    }
+    command.num_arguments = num_arguments;
+    for (int i = 0; i < num_arguments; ++i) {
+      if (!reader.Read(&command.arguments[i])) {
+        *error_info_log = corrupt;
+        return false;
+      }
+    }
+    if (!reader.Read(&command.result)) {
+      *error_info_log = corrupt;
+      return false;
+    }
+    for (int i = 0; i < num_payloads; ++i) {
+      Payload payload;
+      uint8_t argument, flags;
+      if (!reader.Read(&argument) || !reader.Read(&flags) ||
+          !reader.Read(&payload.size) || argument >= num_arguments) {
+        *error_info_log = corrupt;
+        return false;
+      }
+      payload.argument = argument;
+      payload.size_only = (flags & kGlCapturePayloadSizeOnly) != 0;
+      if (!payload.size_only &&
+          !reader.ReadBytes(payload.size, &payload.data)) {
+        *error_info_log = corrupt;
+        return false;
+      }
+      command.payloads.push_back(std::move(payload));
+    }
+    commands_.push_back(std::move(command));
+  }
+
+  // The other contexts share the objects of the main window.
+  contexts_.assign(1, main_window);
+  for (int i = 1; i < num_contexts; ++i) {
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    GLFWwindow* context =
+        glfwCreateWindow(1, 1, "replay context", nullptr, main_window);
+    if (context == nullptr) {
+      *error_info_log = "Could not create the contexts of the capture.";
+      return false;
+    }
+    contexts_.push_back(context);
+  }
+  current_programs_.assign(num_contexts, 0);
+  current_context_ = 0;
+  next_frame_ = 0;
+  return true;
+}
+
+bool GlReplay::ReplayFrame(GlReplayFrameTime* frame_time) {
+  if (next_frame_ >= frame_ends_.size()) return false;
+  const int begin = next_frame_ == 0 ? 0 : frame_ends_[next_frame_ - 1];
+  const int end = frame_ends_[next_frame_];
+  ++next_frame_;
+
+  const auto begin_time = std::chrono::steady_clock::now();
+  for (int i = begin; i < end; ++i) {
+    const Command& command = commands_[i];
+    switch (command.type) {
+      case Command::CALL:
+        ReplayCall(command);
+        break;
+      case Command::CONTEXT:
+        if (command.id != current_context_) {
+          current_context_ = command.id;
+          glfwMakeContextCurrent(contexts_[current_context_]);
+        }
+        break;
+      case Command::MAPPED_WRITE: {
+        const auto mapping = mappings_.find(command.id);
+        if (mapping == mappings_.end()) break;
+        const Payload& payload = command.payloads[0];
+        std::memcpy(mapping->second + command.arguments[0],
+                    payload.data.data(), payload.size);
+        break;
+      }
+      case Command::FRAME:
+        break;
+    }
+  }
+  const auto submitted_time = std::chrono::steady_clock::now();
+  glFinish();
+  const auto finished_time = std::chrono::steady_clock::now();
+  frame_time->cpu_ms = MillisecondsBetween(begin_time, submitted_time);
+  frame_time->total_ms = MillisecondsBetween(begin_time, finished_time);
+  return true;
+}
+
+void GlReplay::ReplayCall(const Command& command) {
+  const int entry_point = command.id;
+  const GlArgumentKind* result_kind = kGlArgumentKinds[entry_point];
+  const GlArgumentKind* kinds = result_kind + 1;
+  const Payload* payloads[kMaxGlEntryPointParameters] = {};
+  for (const Payload& payload : command.payloads) {
+    payloads[payload.argument] = &payload;
+  }
+  // The locations and resource indices belong to the program of the call, or
+  // to the program in use.
+  uint64_t program = current_programs_[current_context_];
+  for (int i = 0; i < command.num_arguments; ++i) {
+    if (kinds[i] == ARG_PROGRAM) {
+      program = command.arguments[i];
+      break;
+    }
+  }
+
+  uint64_t words[kMaxGlEntryPointParameters] = {};
+  // The names created or deleted by the call, the strings and the memory
+  // written by the call.
+  std::vector<GLuint> names;
+  int names_argument = -1;
+  std::vector<const GLchar*> strings;
+  std::string output;
+  for (int i = 0; i < command.num_arguments; ++i) {
+    const uint64_t argument = command.arguments[i];
+    const Payload* payload = payloads[i];
+    const GlArgumentKind kind = kinds[i];
+    words[i] = argument;
+    if (kind >= ARG_BUFFER && kind <= ARG_SYNC) {
+      words[i] = TranslateName(kind - ARG_BUFFER, argument);
+    } else if (kind >= ARG_BUFFERS && kind <= ARG_PIPELINES) {
+      if (payload == nullptr) continue;
+      const int name_space = kind - ARG_BUFFERS;
+      names.resize(payload->size / sizeof(GLuint));
+      std::memcpy(names.data(), payload->data.data(),
+                  names.size() * sizeof(GLuint));
+      for (GLuint& name : names) {
+        const GLuint recorded_name = name;
+        name = TranslateName(name_space, recorded_name);
+        names_[name_space].erase(NameKey(name_space, recorded_name));
+      }
+      words[i] = ToGlCaptureWord(names.data());
+    } else if (kind >= ARG_NEW_BUFFERS && kind <= ARG_NEW_PIPELINES) {
+      if (payload == nullptr) continue;
+      names.resize(payload->size / sizeof(GLuint));
+      names_argument = i;
+      words[i] = ToGlCaptureWord(names.data());
+    } else if (kind == ARG_LOCATION) {
+      const auto location = locations_.find(ProgramKey(program, argument));
+      if (location != locations_.end()) {
+        words[i] = ToGlCaptureWord(static_cast<GLint>(location->second));
+      }
+    } else if (kind == ARG_RESOURCE_INDEX) {
+      const auto index =
+          resource_indices_.find(ProgramKey(program, argument));
+      if (index != resource_indices_.end()) {
+        words[i] = ToGlCaptureWord(static_cast<GLuint>(index->second));
+      }
+    } else if (kind == ARG_DATA || kind == ARG_STRING) {
+      if (payload != nullptr) words[i] = ToGlCaptureWord(payload->data.data());
+    } else if (kind == ARG_STRINGS) {
+      if (payload == nullptr) continue;
+      for (size_t begin = 0; begin < payload->data.size();
+           begin = payload->data.find('\0', begin) + 1) {
+        strings.push_back(payload->data.data() + begin);
+      }
+      words[i] = ToGlCaptureWord(strings.data());
+    } else if (kind == ARG_OUTPUT) {
+      if (payload == nullptr) continue;
+      output.resize(payload->size);
+      words[i] = ToGlCaptureWord(&output[0]);
+    } else if (kind == ARG_NULL) {
+      words[i] = 0;
+    }
+  }
+
+  uint64_t result = 0;
+  if (!kGlInvokers[entry_point](words, &result)) {
+    ++num_skipped_calls_;
+    return;
+  }
+
+  // Remember the names, locations, indices and pointers the call returned.
+  switch (*result_kind) {
+    case ARG_NEW_PROGRAM:
+      names_[PROGRAM_NAMES][NameKey(PROGRAM_NAMES, command.result)] = result;
+      break;
+    case ARG_NEW_SHADER:
+      names_[SHADER_NAMES][NameKey(SHADER_NAMES, command.result)] = result;
+      break;
+    case ARG_NEW_SYNC:
+      names_[SYNC_NAMES][NameKey(SYNC_NAMES, command.result)] = result;
+      break;
+    case ARG_NEW_LOCATION:
+      locations_[ProgramKey(program, command.result)] =
+          FromGlCaptureWord<GLint>(result);
+      break;
+    case ARG_NEW_RESOURCE_INDEX:
+      resource_indices_[ProgramKey(program, command.result)] =
+          FromGlCaptureWord<GLuint>(result);
+      break;
+    case ARG_NEW_MAPPING:
+      mappings_[command.result] = FromGlCaptureWord<char*>(result);
+      break;
+    default:
+      break;
+  }
+  if (names_argument >= 0) {
+    const int name_space = kinds[names_argument] - ARG_NEW_BUFFERS;
+    const Payload* payload = payloads[names_argument];
+    for (int i = 0; i < names.size(); ++i) {
+      GLuint recorded_name;
+      std::memcpy(&recorded_name,
+                  payload->data.data() + i * sizeof(recorded_name),
+                  sizeof(recorded_name));
+      names_[name_space][NameKey(name_space, recorded_name)] = names[i];
+    }
+  }
+  if (entry_point == CALL_UseProgram) {
+    current_programs_[current_context_] = command.arguments[0];
+  }
+}
+
+uint64_t GlReplay::TranslateName(const int name_space,
+                                 const uint64_t name) const {
+  if (name == 0) return 0;
+  const auto translated = names_[name_space].find(NameKey(name_space, name));
+  return translated == names_[name_space].end() ? name : translated->second;
+}
+
+uint64_t GlReplay::NameKey(const int name_space, const uint64_t name) const {
+  if (name_space == VERTEX_ARRAY_NAMES || name_space == FRAMEBUFFER_NAMES) {
+    return (static_cast<uint64_t>(current_context_) << 32) | name;
+  }
+  return name;
+}
+
+}  // namespace wvu
@@ -0,0 +1,193 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_GL_REPLAY_H_
+#define GLUTILS_GL_REPLAY_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "gl_entry_points.h"
+
+namespace wvu {
+// The times of a replayed frame, in milliseconds.
+struct GlReplayFrameTime {
+  // The time spent submitting the calls of the frame.
+  double cpu_ms = 0.0;
+  // The time until glFinish() returned, i.e., until the GPU completed the
+  // frame.
+  double total_ms = 0.0;
+};
+
+// This class replays a capture of the OpenGL command stream (see
+// gl_capture.h) frame by frame, to time the frames offline, independently of
+// the program and the scene that rendered them. The object names, uniform
+// locations, resource indices and mapped pointers of the capture are
+// translated to those of the replay, the data the calls read is passed from
+// the file, and the writes into mapped buffers are copied into the buffers
+// mapped by the replay. The capture starts before the objects are created, so
+// the first frame also creates them.
+//
+// The calls of the other contexts of the capture are replayed on hidden
+// windows sharing the objects of the main window, created when the capture
+// is read. The replay is deterministic: it issues the calls of the capture in
+// the order they were recorded, from the main thread.
+//
+// Example:
+//
+// wvu::GlReplay replay;
+// if (!replay.Open("frames.glcapture", window, &error_info_log)) {
+//   LOG(ERROR) << error_info_log;
+// }
+// wvu::GlReplayFrameTime frame_time;
+// while (replay.ReplayFrame(&frame_time)) {
+//   LOG(INFO) << "Frame: " << frame_time.total_ms << " ms.";
+//   glfwSwapBuffers(window);
+// }
+class GlReplay {
+ public:
+  GlReplay() {}
+  // Destroys the windows of the other contexts.
+  ~GlReplay();
+
+  // Reads a capture. The context of the main window must be current, and its
+  // default framebuffer should have the size of the capture. Must be called
+  // on the main thread, since it creates the windows of the other contexts.
+  // Returns true if successful.
+  // Parameters:
+  //   filepath  The path of the capture file.
+  //   main_window  The window whose context replays the first context of the
+  //     capture. Not owned.
+  //   error_info_log  A pointer to a string that holds the error log.
+  bool Open(const std::string& filepath,
+            GLFWwindow* main_window,
+            std::string* error_info_log);
+
+  // Replays the calls of the next frame and waits for the GPU to complete
+  // them. Returns false if all the frames were replayed.
+  bool ReplayFrame(GlReplayFrameTime* frame_time);
+
+  // Returns the size of the default framebuffer of the capture.
+  int framebuffer_width() const {
+    return framebuffer_width_;
+  }
+
+  int framebuffer_height() const {
+    return framebuffer_height_;
+  }
+
+  int num_frames() const {
+    return frame_ends_.size();
+  }
+
+  // Returns the number of calls skipped because the driver of the replay does
+  // not have their entry points.
+  int num_skipped_calls() const {
+    return num_skipped_calls_;
+  }
+
+ private:
+  // The data of a call, or of a write into mapped storage.
+  struct Payload {
+    int argument;
+    bool size_only;
+    uint32_t size;
+    std::string data;
+  };
+
+  // A record of the capture.
+  struct Command {
+    enum Type {
+      CALL = 0,
+      CONTEXT = 1,
+      MAPPED_WRITE = 2,
+      FRAME = 3
+    };
+    Type type;
+    // The entry point of a call, the index of a context, or the pointer
+    // returned by the map call of a write.
+    uint64_t id = 0;
+    int num_arguments = 0;
+    // The arguments of a call, or the offset of a write.
+    uint64_t arguments[kMaxGlEntryPointParameters];
+    uint64_t result = 0;
+    std::vector<Payload> payloads;
+  };
+
+  // Replays a call.
+  void ReplayCall(const Command& command);
+
+  // Translates the name of an object of the capture to the replay, or returns
+  // it unchanged if the capture did not create it.
+  uint64_t TranslateName(const int name_space, const uint64_t name) const;
+
+  // Returns the key of a name of the capture in the names of its name space.
+  // Vertex array objects and framebuffers are not shared between the
+  // contexts, so their keys include the context.
+  uint64_t NameKey(const int name_space, const uint64_t name) const;
+
+  int framebuffer_width_ = 0;
+  int framebuffer_height_ = 0;
+  std::vector<Command> commands_;
+  // Index after the last command of every frame.
+  std::vector<int> frame_ends_;
+  int next_frame_ = 0;
+  int num_skipped_calls_ = 0;
+  // The windows of the contexts of the capture. The first one is the main
+  // window, which is not owned.
+  std::vector<GLFWwindow*> contexts_;
+  int current_context_ = 0;
+  // The names of the capture mapped to the names of the replay, per name
+  // space.
+  std::unordered_map<uint64_t, uint64_t> names_[NUM_GL_NAME_SPACES];
+  // The uniform locations and program resource indices, keyed by the program
+  // of the capture and the location or index.
+  std::unordered_map<uint64_t, int64_t> locations_;
+  std::unordered_map<uint64_t, int64_t> resource_indices_;
+  // The program in use in the capture, per context.
+  std::vector<uint64_t> current_programs_;
+  // The pointers to mapped storage of the capture mapped to the replay.
+  std::unordered_map<uint64_t, char*> mappings_;
+
+  GlReplay(const GlReplay&) = delete;
+  GlReplay& operator=(const GlReplay&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_GL_REPLAY_H_
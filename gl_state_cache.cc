@@ -0,0 +1,243 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "gl_state_cache.h"
+
+#include <GL/glew.h>
+
+namespace wvu {
+
+GlStateCache::GlStateCache() : num_calls_(0), num_elided_calls_(0) {}
+
+GlStateCache* GlStateCache::Current() {
+  static thread_local GlStateCache cache;
+  return &cache;
+}
+
+void GlStateCache::Invalidate() {
+  program_ = Shadow<GLuint>();
+  vertex_array_ = Shadow<GLuint>();
+  for (Shadow<GLuint>& buffer : buffers_) {
+    buffer = Shadow<GLuint>();
+  }
+  polygon_mode_ = Shadow<GLenum>();
+  clear_color_ = Shadow<Color>();
+  blend_ = Shadow<bool>();
+  depth_test_ = Shadow<bool>();
+  cull_face_ = Shadow<bool>();
+  blend_func_ = Shadow<BlendFactors>();
+  depth_func_ = Shadow<GLenum>();
+  depth_mask_ = Shadow<bool>();
+  color_mask_ = Shadow<bool>();
+}
+
+void GlStateCache::BeginFrame() {
+  num_calls_ = 0;
+  num_elided_calls_ = 0;
+}
+
+GlStateCache::BufferTarget GlStateCache::ToBufferTarget(const GLenum target) {
+  switch (target) {
+    case GL_ARRAY_BUFFER: return ARRAY_BUFFER;
+    case GL_ELEMENT_ARRAY_BUFFER: return ELEMENT_ARRAY_BUFFER;
+    case GL_UNIFORM_BUFFER: return UNIFORM_BUFFER;
+    case GL_SHADER_STORAGE_BUFFER: return SHADER_STORAGE_BUFFER;
+    case GL_ATOMIC_COUNTER_BUFFER: return ATOMIC_COUNTER_BUFFER;
+    case GL_DRAW_INDIRECT_BUFFER: return DRAW_INDIRECT_BUFFER;
+    case GL_PARAMETER_BUFFER_ARB: return PARAMETER_BUFFER;
+    case GL_COPY_READ_BUFFER: return COPY_READ_BUFFER;
+    case GL_COPY_WRITE_BUFFER: return COPY_WRITE_BUFFER;
+    default: return NUM_BUFFER_TARGETS;
+  }
+}
+
+void GlStateCache::UseProgram(const GLuint program_id) {
+  if (Update(program_id, &program_)) {
+    glUseProgram(program_id);
+  }
+}
+
+void GlStateCache::BindVertexArray(const GLuint vertex_array_object_id) {
+  if (Update(vertex_array_object_id, &vertex_array_)) {
+    glBindVertexArray(vertex_array_object_id);
+    // The element array buffer binding is part of the vertex array state.
+    buffers_[ELEMENT_ARRAY_BUFFER] = Shadow<GLuint>();
+  }
+}
+
+void GlStateCache::BindBuffer(const GLenum target, const GLuint buffer_id) {
+  const BufferTarget buffer_target = ToBufferTarget(target);
+  if (buffer_target == NUM_BUFFER_TARGETS) {
+    glBindBuffer(target, buffer_id);
+    return;
+  }
+  if (Update(buffer_id, &buffers_[buffer_target])) {
+    glBindBuffer(target, buffer_id);
+  }
+}
+
+void GlStateCache::BindBufferBase(const GLenum target,
+                                  const GLuint index,
+                                  const GLuint buffer_id) {
+  // The indexed bindings are not shadowed.
+  glBindBufferBase(target, index, buffer_id);
+  const BufferTarget buffer_target = ToBufferTarget(target);
+  if (buffer_target != NUM_BUFFER_TARGETS) {
+    buffers_[buffer_target].known = true;
+    buffers_[buffer_target].value = buffer_id;
+  }
+}
+
+void GlStateCache::BindBufferRange(const GLenum target,
+                                   const GLuint index,
+                                   const GLuint buffer_id,
+                                   const GLintptr offset,
+                                   const GLsizeiptr size) {
+  glBindBufferRange(target, index, buffer_id, offset, size);
+  const BufferTarget buffer_target = ToBufferTarget(target);
+  if (buffer_target != NUM_BUFFER_TARGETS) {
+    buffers_[buffer_target].known = true;
+    buffers_[buffer_target].value = buffer_id;
+  }
+}
+
+void GlStateCache::PolygonMode(const GLenum mode) {
+  if (Update(mode, &polygon_mode_)) {
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+  }
+}
+
+void GlStateCache::ClearColor(const GLfloat red,
+                              const GLfloat green,
+                              const GLfloat blue,
+                              const GLfloat alpha) {
+  const Color color = {red, green, blue, alpha};
+  if (Update(color, &clear_color_)) {
+    glClearColor(red, green, blue, alpha);
+  }
+}
+
+void GlStateCache::SetCapability(const GLenum capability,
+                                 const bool enabled) {
+  Shadow<bool>* shadow = nullptr;
+  if (capability == GL_BLEND) {
+    shadow = &blend_;
+  } else if (capability == GL_DEPTH_TEST) {
+    shadow = &depth_test_;
+  } else if (capability == GL_CULL_FACE) {
+    shadow = &cull_face_;
+  }
+  if (shadow != nullptr && !Update(enabled, shadow)) return;
+  if (enabled) {
+    glEnable(capability);
+  } else {
+    glDisable(capability);
+  }
+}
+
+void GlStateCache::BlendFunc(const GLenum source_factor,
+                             const GLenum destination_factor) {
+  const BlendFactors factors = {source_factor, destination_factor,
+                                source_factor, destination_factor};
+  if (Update(factors, &blend_func_)) {
+    glBlendFunc(source_factor, destination_factor);
+  }
+}
+
+void GlStateCache::BlendFuncSeparate(const GLenum source_color_factor,
+                                     const GLenum destination_color_factor,
+                                     const GLenum source_alpha_factor,
+                                     const GLenum destination_alpha_factor) {
+  const BlendFactors factors = {source_color_factor, destination_color_factor,
+                                source_alpha_factor, destination_alpha_factor};
+  if (Update(factors, &blend_func_)) {
+    glBlendFuncSeparate(source_color_factor, destination_color_factor,
+                        source_alpha_factor, destination_alpha_factor);
+  }
+}
+
+void GlStateCache::DepthFunc(const GLenum function) {
+  if (Update(function, &depth_func_)) {
+    glDepthFunc(function);
+  }
+}
+
+void GlStateCache::DepthMask(const bool enabled) {
+  if (Update(enabled, &depth_mask_)) {
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+  }
+}
+
+void GlStateCache::ColorMask(const bool enabled) {
+  if (Update(enabled, &color_mask_)) {
+    const GLboolean mask = enabled ? GL_TRUE : GL_FALSE;
+    glColorMask(mask, mask, mask, mask);
+  }
+}
+
+void GlStateCache::DeleteBuffers(const GLsizei num_buffers,
+                                 const GLuint* buffer_ids) {
+  glDeleteBuffers(num_buffers, buffer_ids);
+  // OpenGL binds 0 in place of the deleted buffers.
+  for (GLsizei i = 0; i < num_buffers; ++i) {
+    for (Shadow<GLuint>& buffer : buffers_) {
+      if (buffer.known && buffer.value == buffer_ids[i]) {
+        buffer.value = 0;
+      }
+    }
+  }
+}
+
+void GlStateCache::DeleteVertexArrays(const GLsizei num_vertex_arrays,
+                                      const GLuint* vertex_array_object_ids) {
+  glDeleteVertexArrays(num_vertex_arrays, vertex_array_object_ids);
+  for (GLsizei i = 0; i < num_vertex_arrays; ++i) {
+    if (vertex_array_.known &&
+        vertex_array_.value == vertex_array_object_ids[i]) {
+      vertex_array_.value = 0;
+      buffers_[ELEMENT_ARRAY_BUFFER] = Shadow<GLuint>();
+    }
+  }
+}
+
+void GlStateCache::DeleteProgram(const GLuint program_id) {
+  glDeleteProgram(program_id);
+  // A program in use is only deleted once it is not in use anymore, so the
+  // next UseProgram() call must reach OpenGL.
+  if (program_.known && program_.value == program_id) {
+    program_ = Shadow<GLuint>();
+  }
+}
+
+}  // namespace wvu
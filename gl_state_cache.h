@@ -0,0 +1,210 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_GL_STATE_CACHE_H_
+#define GLUTILS_GL_STATE_CACHE_H_
+
+#include <GL/glew.h>
+
+namespace wvu {
+// This class shadows the OpenGL state that the library changes most often:
+// the program in use, the vertex array object, the buffer bindings, the
+// polygon mode, the clear color, the color mask, and the blend and depth
+// state. Every setter compares the request against the shadow copy and only
+// calls OpenGL when the state changes, so that code can set the state it needs
+// without tracking what the previous draws left bound. The cache keeps
+// counters of the calls it received and elided since the last BeginFrame().
+//
+// The shadow copy is only valid if every change goes through the cache. Code
+// that calls OpenGL directly must call Invalidate() afterwards. Objects must be
+// deleted through the cache, since OpenGL unbinds deleted objects and may reuse
+// their ids. The state starts unknown, so the first call of every setter
+// reaches OpenGL.
+//
+// Example:
+//
+// wvu::GlStateCache* gl_state = wvu::GlStateCache::Current();
+// while (...) {  // Rendering loop.
+//   gl_state->BeginFrame();
+//   gl_state->ClearColor(0.0f, 0.0f, 0.0f, 1.0f);  // Elided after frame 1.
+//   ...
+//   LOG(INFO) << gl_state->num_elided_calls() << " calls elided.";
+// }
+class GlStateCache {
+ public:
+  GlStateCache();
+  ~GlStateCache() {}
+
+  // Returns the cache of the calling thread. OpenGL contexts are current in
+  // one thread at a time, and this library uses one context per thread.
+  static GlStateCache* Current();
+
+  // Forgets all the shadowed state.
+  void Invalidate();
+
+  // Resets the per-frame counters.
+  void BeginFrame();
+
+  void UseProgram(const GLuint program_id);
+  void BindVertexArray(const GLuint vertex_array_object_id);
+  // Buffer targets other than the ones listed in the .cc file are passed
+  // through without caching.
+  void BindBuffer(const GLenum target, const GLuint buffer_id);
+  // Binding to an indexed binding point also binds the generic target.
+  void BindBufferBase(const GLenum target,
+                      const GLuint index,
+                      const GLuint buffer_id);
+  void BindBufferRange(const GLenum target,
+                       const GLuint index,
+                       const GLuint buffer_id,
+                       const GLintptr offset,
+                       const GLsizeiptr size);
+  void PolygonMode(const GLenum mode);
+  void ClearColor(const GLfloat red,
+                  const GLfloat green,
+                  const GLfloat blue,
+                  const GLfloat alpha);
+  // Enables or disables GL_BLEND, GL_CULL_FACE or GL_DEPTH_TEST. Other
+  // capabilities are passed through without caching.
+  void SetCapability(const GLenum capability, const bool enabled);
+  void BlendFunc(const GLenum source_factor, const GLenum destination_factor);
+  // Sets the factors of the color channels and of the alpha channel apart.
+  void BlendFuncSeparate(const GLenum source_color_factor,
+                         const GLenum destination_color_factor,
+                         const GLenum source_alpha_factor,
+                         const GLenum destination_alpha_factor);
+  void DepthFunc(const GLenum function);
+  void DepthMask(const bool enabled);
+  // Enables or disables the writes to all the color channels.
+  void ColorMask(const bool enabled);
+
+  // Delete the objects and forget their bindings.
+  void DeleteBuffers(const GLsizei num_buffers, const GLuint* buffer_ids);
+  void DeleteVertexArrays(const GLsizei num_vertex_arrays,
+                          const GLuint* vertex_array_object_ids);
+  void DeleteProgram(const GLuint program_id);
+
+  // Returns the number of state changes requested and elided since the last
+  // call to BeginFrame().
+  int num_calls() const {
+    return num_calls_;
+  }
+
+  int num_elided_calls() const {
+    return num_elided_calls_;
+  }
+
+ private:
+  // Buffer targets with a shadowed binding.
+  enum BufferTarget {
+    ARRAY_BUFFER = 0,
+    ELEMENT_ARRAY_BUFFER = 1,
+    UNIFORM_BUFFER = 2,
+    SHADER_STORAGE_BUFFER = 3,
+    ATOMIC_COUNTER_BUFFER = 4,
+    DRAW_INDIRECT_BUFFER = 5,
+    PARAMETER_BUFFER = 6,
+    COPY_READ_BUFFER = 7,
+    COPY_WRITE_BUFFER = 8,
+    NUM_BUFFER_TARGETS = 9
+  };
+
+  // A shadowed value, which is unknown until it is set through the cache.
+  template <typename ValueType>
+  struct Shadow {
+    Shadow() : known(false), value() {}
+    bool known;
+    ValueType value;
+  };
+
+  // Compares value against the shadow and updates it. Returns true if OpenGL
+  // needs to be called.
+  template <typename ValueType>
+  bool Update(const ValueType& value, Shadow<ValueType>* shadow) {
+    ++num_calls_;
+    if (shadow->known && shadow->value == value) {
+      ++num_elided_calls_;
+      return false;
+    }
+    shadow->known = true;
+    shadow->value = value;
+    return true;
+  }
+
+  // Returns the shadowed target of an OpenGL buffer target, or
+  // NUM_BUFFER_TARGETS if the target is not shadowed.
+  static BufferTarget ToBufferTarget(const GLenum target);
+
+  // Clear color, stored to be comparable with ==.
+  struct Color {
+    bool operator==(const Color& other) const {
+      return red == other.red && green == other.green && blue == other.blue &&
+          alpha == other.alpha;
+    }
+    GLfloat red, green, blue, alpha;
+  };
+
+  // Blend factors of the color and the alpha channels.
+  struct BlendFactors {
+    bool operator==(const BlendFactors& other) const {
+      return source_color == other.source_color &&
+          destination_color == other.destination_color &&
+          source_alpha == other.source_alpha &&
+          destination_alpha == other.destination_alpha;
+    }
+    GLenum source_color, destination_color, source_alpha, destination_alpha;
+  };
+
+  Shadow<GLuint> program_;
+  Shadow<GLuint> vertex_array_;
+  Shadow<GLuint> buffers_[NUM_BUFFER_TARGETS];
+  Shadow<GLenum> polygon_mode_;
+  Shadow<Color> clear_color_;
+  Shadow<bool> blend_;
+  Shadow<bool> depth_test_;
+  Shadow<bool> cull_face_;
+  Shadow<BlendFactors> blend_func_;
+  Shadow<GLenum> depth_func_;
+  Shadow<bool> depth_mask_;
+  Shadow<bool> color_mask_;
+  int num_calls_;
+  int num_elided_calls_;
+
+  GlStateCache(const GlStateCache&) = delete;
+  GlStateCache& operator=(const GlStateCache&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_GL_STATE_CACHE_H_
@@ -0,0 +1,496 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "gpu_culling.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "mesh_batch.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Number of invocations per work group of the shaders.
+constexpr int kCullingGroupSize = 64;
+constexpr int kReductionGroupSize = 8;
+// Texels of level 0 per side of the tile reduced by a work group of the
+// single-pass shader, which keeps levels 1 to 5 of the tile in shared memory.
+constexpr int kHiZTileSize = 32;
+
+// Builds levels 0 to NUM_LEVELS - 1 of the pyramid in one dispatch. Every work
+// group copies a 32x32 tile of the depth texture into level 0 and reduces it
+// down to a texel of level 5 in shared memory. The last group to finish,
+// counted with an atomic, reduces the remaining levels from level 5. Every
+// texel holds the farthest (r) and the nearest (g) depth of the texels it
+// covers. Odd sizes include the extra row and column in the last texels, so
+// that every texel of the source is covered; the last groups of a row or
+// column of tiles own those texels too. The source prepends the version and
+// the definition of NUM_LEVELS.
+const char kHiZSinglePassShader[] =
+    "layout (local_size_x = 16, local_size_y = 16) in;\n"
+    "layout (binding = 0) uniform sampler2D depth;\n"
+    "layout (rg32f, binding = 0) coherent uniform image2D levels[NUM_LEVELS];\n"
+    "layout (std430, binding = 0) coherent buffer Counter {\n"
+    "  uint num_finished_groups;\n"
+    "};\n"
+    "shared vec2 odd_levels[32 * 32];\n"
+    "shared vec2 even_levels[16 * 16];\n"
+    "shared bool is_last_group;\n"
+    "vec2 Combine(vec2 a, vec2 b) {\n"
+    "  return vec2(max(a.x, b.x), min(a.y, b.y));\n"
+    "}\n"
+    "vec2 LoadTile(int level, ivec2 texel) {\n"
+    "  return (level & 1) != 0 ? odd_levels[texel.y * 32 + texel.x] :\n"
+    "                            even_levels[texel.y * 16 + texel.x];\n"
+    "}\n"
+    "void StoreTile(int level, ivec2 texel, vec2 value) {\n"
+    "  if ((level & 1) != 0) {\n"
+    "    odd_levels[texel.y * 32 + texel.x] = value;\n"
+    "  } else {\n"
+    "    even_levels[texel.y * 16 + texel.x] = value;\n"
+    "  }\n"
+    "}\n"
+    "// The last source texel covered by a texel, on each axis.\n"
+    "ivec2 FootprintLast(ivec2 texel, ivec2 size, ivec2 source_size) {\n"
+    "  ivec2 last = 2 * texel + 1;\n"
+    "  if (texel.x == size.x - 1) last.x = source_size.x - 1;\n"
+    "  if (texel.y == size.y - 1) last.y = source_size.y - 1;\n"
+    "  return last;\n"
+    "}\n"
+    "// The end of the texels of a level owned by the work group.\n"
+    "ivec2 OwnedEnd(ivec2 first, int tile_size, ivec2 size) {\n"
+    "  ivec2 last_group = ivec2(gl_NumWorkGroups.xy) - 1;\n"
+    "  ivec2 group = ivec2(gl_WorkGroupID.xy);\n"
+    "  return ivec2(group.x == last_group.x ? size.x : first.x + tile_size,\n"
+    "               group.y == last_group.y ? size.y : first.y + tile_size);\n"
+    "}\n"
+    "void main() {\n"
+    "  ivec2 group = ivec2(gl_WorkGroupID.xy);\n"
+    "  ivec2 local = ivec2(gl_LocalInvocationID.xy);\n"
+    "  ivec2 size = imageSize(levels[0]);\n"
+    "  ivec2 first = group * 32;\n"
+    "  ivec2 end = OwnedEnd(first, 32, size);\n"
+    "  for (int y = first.y + local.y; y < end.y; y += 16) {\n"
+    "    for (int x = first.x + local.x; x < end.x; x += 16) {\n"
+    "      float d = texelFetch(depth, ivec2(x, y), 0).r;\n"
+    "      imageStore(levels[0], ivec2(x, y), vec4(d, d, 0.0, 0.0));\n"
+    "    }\n"
+    "  }\n"
+    "  for (int level = 1; level < min(NUM_LEVELS, 6); ++level) {\n"
+    "    ivec2 source_size = size;\n"
+    "    ivec2 source_first = first;\n"
+    "    size = imageSize(levels[level]);\n"
+    "    first = group * (32 >> level);\n"
+    "    end = OwnedEnd(first, 32 >> level, size);\n"
+    "    for (int y = first.y + local.y; y < end.y; y += 16) {\n"
+    "      for (int x = first.x + local.x; x < end.x; x += 16) {\n"
+    "        ivec2 texel = ivec2(x, y);\n"
+    "        ivec2 last = FootprintLast(texel, size, source_size);\n"
+    "        vec2 value = vec2(0.0, 1.0);\n"
+    "        for (int j = 2 * y; j <= last.y; ++j) {\n"
+    "          for (int i = 2 * x; i <= last.x; ++i) {\n"
+    "            value = Combine(value, level == 1 ?\n"
+    "                vec2(texelFetch(depth, ivec2(i, j), 0).r) :\n"
+    "                LoadTile(level - 1, ivec2(i, j) - source_first));\n"
+    "          }\n"
+    "        }\n"
+    "        StoreTile(level, texel - first, value);\n"
+    "        imageStore(levels[level], texel, vec4(value, 0.0, 0.0));\n"
+    "      }\n"
+    "    }\n"
+    "    memoryBarrierShared();\n"
+    "    barrier();\n"
+    "  }\n"
+    "#if NUM_LEVELS > 6\n"
+    "  // Level 5 of every tile must be visible to the last group.\n"
+    "  memoryBarrierImage();\n"
+    "  barrier();\n"
+    "  if (gl_LocalInvocationIndex == 0u) {\n"
+    "    uint num_groups = gl_NumWorkGroups.x * gl_NumWorkGroups.y;\n"
+    "    is_last_group =\n"
+    "        atomicAdd(num_finished_groups, 1u) == num_groups - 1u;\n"
+    "  }\n"
+    "  barrier();\n"
+    "  if (is_last_group) {\n"
+    "    for (int level = 6; level < NUM_LEVELS; ++level) {\n"
+    "      ivec2 source_size = size;\n"
+    "      size = imageSize(levels[level]);\n"
+    "      for (int t = int(gl_LocalInvocationIndex); t < size.x * size.y;\n"
+    "           t += 256) {\n"
+    "        ivec2 texel = ivec2(t % size.x, t / size.x);\n"
+    "        ivec2 last = FootprintLast(texel, size, source_size);\n"
+    "        vec2 value = vec2(0.0, 1.0);\n"
+    "        for (int j = 2 * texel.y; j <= last.y; ++j) {\n"
+    "          for (int i = 2 * texel.x; i <= last.x; ++i) {\n"
+    "            value = Combine(\n"
+    "                value, imageLoad(levels[level - 1], ivec2(i, j)).rg);\n"
+    "          }\n"
+    "        }\n"
+    "        imageStore(levels[level], texel, vec4(value, 0.0, 0.0));\n"
+    "      }\n"
+    "      memoryBarrierImage();\n"
+    "      barrier();\n"
+    "    }\n"
+    "    // Ready for the next frame.\n"
+    "    if (gl_LocalInvocationIndex == 0u) num_finished_groups = 0u;\n"
+    "  }\n"
+    "#endif\n"
+    "}\n";
+
+// Reduces a level of the pyramid into the next one. Builds the levels that do
+// not fit in the image units of the single-pass shader.
+const char kHiZReductionShader[] =
+    "#version 430\n"
+    "layout (local_size_x = 8, local_size_y = 8) in;\n"
+    "layout (binding = 0) uniform sampler2D source;\n"
+    "layout (rg32f, binding = 0) writeonly uniform image2D destination;\n"
+    "uniform int source_level;\n"
+    "void main() {\n"
+    "  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);\n"
+    "  ivec2 size = imageSize(destination);\n"
+    "  if (any(greaterThanEqual(texel, size))) return;\n"
+    "  ivec2 source_size = textureSize(source, source_level);\n"
+    "  ivec2 first = 2 * texel;\n"
+    "  ivec2 last = first + 1;\n"
+    "  if (texel.x == size.x - 1) last.x = source_size.x - 1;\n"
+    "  if (texel.y == size.y - 1) last.y = source_size.y - 1;\n"
+    "  vec2 depths = vec2(0.0, 1.0);\n"
+    "  for (int y = first.y; y <= last.y; ++y) {\n"
+    "    for (int x = first.x; x <= last.x; ++x) {\n"
+    "      vec2 source_depths =\n"
+    "          texelFetch(source, ivec2(x, y), source_level).rg;\n"
+    "      depths = vec2(max(depths.x, source_depths.x),\n"
+    "                    min(depths.y, source_depths.y));\n"
+    "    }\n"
+    "  }\n"
+    "  imageStore(destination, texel, vec4(depths, 0.0, 0.0));\n"
+    "}\n";
+
+// Tests the bounding spheres against the planes of the frustum, and the
+// screen rectangle of their bounding boxes against the Hi-Z buffer.
+const char kCullingShader[] =
+    "#version 430\n"
+    "layout (local_size_x = 64) in;\n"
+    "struct DrawCommand {\n"
+    "  uint count;\n"
+    "  uint instance_count;\n"
+    "  uint first_index;\n"
+    "  int base_vertex;\n"
+    "  uint base_instance;\n"
+    "};\n"
+    "struct CullingRecord {\n"
+    "  vec4 bounding_sphere;\n"
+    "  DrawCommand command;\n"
+    "  uint padding[3];\n"
+    "};\n"
+    "layout (std430, binding = 0) readonly buffer Records {\n"
+    "  CullingRecord records[];\n"
+    "};\n"
+    "layout (std430, binding = 1) writeonly buffer Commands {\n"
+    "  DrawCommand commands[];\n"
+    "};\n"
+    "layout (binding = 0, offset = 0) uniform atomic_uint num_visible;\n"
+    "layout (binding = 0) uniform sampler2D hi_z;\n"
+    "uniform mat4 view_projection;\n"
+    "uniform int num_records;\n"
+    "uniform int hi_z_num_levels;\n"
+    "bool IsInsideFrustum(vec4 sphere) {\n"
+    "  mat4 m = transpose(view_projection);\n"
+    "  vec4 planes[6] = vec4[6](m[3] + m[0], m[3] - m[0], m[3] + m[1],\n"
+    "                           m[3] - m[1], m[3] + m[2], m[3] - m[2]);\n"
+    "  for (int i = 0; i < 6; ++i) {\n"
+    "    float distance = dot(planes[i].xyz, sphere.xyz) + planes[i].w;\n"
+    "    if (distance < -sphere.w * length(planes[i].xyz)) return false;\n"
+    "  }\n"
+    "  return true;\n"
+    "}\n"
+    "bool IsOccluded(vec4 sphere) {\n"
+    "  vec2 min_uv = vec2(1.0);\n"
+    "  vec2 max_uv = vec2(0.0);\n"
+    "  float min_depth = 1.0;\n"
+    "  for (int i = 0; i < 8; ++i) {\n"
+    "    vec3 offset = vec3((i & 1) != 0 ? 1.0 : -1.0,\n"
+    "                       (i & 2) != 0 ? 1.0 : -1.0,\n"
+    "                       (i & 4) != 0 ? 1.0 : -1.0);\n"
+    "    vec4 clip = view_projection * vec4(sphere.xyz + sphere.w * offset,\n"
+    "                                       1.0);\n"
+    "    // Boxes crossing the near plane are never occluded.\n"
+    "    if (clip.w <= 0.0) return false;\n"
+    "    vec3 ndc = clip.xyz / clip.w;\n"
+    "    min_uv = min(min_uv, ndc.xy * 0.5 + 0.5);\n"
+    "    max_uv = max(max_uv, ndc.xy * 0.5 + 0.5);\n"
+    "    min_depth = min(min_depth, ndc.z * 0.5 + 0.5);\n"
+    "  }\n"
+    "  min_uv = clamp(min_uv, 0.0, 1.0);\n"
+    "  max_uv = clamp(max_uv, 0.0, 1.0);\n"
+    "  // The level where the rectangle spans at most one texel, so that it\n"
+    "  // overlaps at most 2x2 texels.\n"
+    "  vec2 extent = (max_uv - min_uv) * vec2(textureSize(hi_z, 0));\n"
+    "  float level = ceil(log2(max(max(extent.x, extent.y), 1.0)));\n"
+    "  level = min(level, float(hi_z_num_levels - 1));\n"
+    "  float max_depth = max(\n"
+    "      max(textureLod(hi_z, min_uv, level).r,\n"
+    "          textureLod(hi_z, vec2(max_uv.x, min_uv.y), level).r),\n"
+    "      max(textureLod(hi_z, vec2(min_uv.x, max_uv.y), level).r,\n"
+    "          textureLod(hi_z, max_uv, level).r));\n"
+    "  return min_depth > max_depth;\n"
+    "}\n"
+    "void main() {\n"
+    "  int i = int(gl_GlobalInvocationID.x);\n"
+    "  if (i >= num_records) return;\n"
+    "  vec4 sphere = records[i].bounding_sphere;\n"
+    "  if (!IsInsideFrustum(sphere)) return;\n"
+    "  if (hi_z_num_levels > 0 && IsOccluded(sphere)) return;\n"
+    "  uint slot = atomicCounterIncrement(num_visible);\n"
+    "  commands[slot] = records[i].command;\n"
+    "}\n";
+
+// Returns the number of work groups covering num_items items.
+GLuint NumGroups(const int num_items, const int group_size) {
+  return (num_items + group_size - 1) / group_size;
+}
+
+}  // namespace
+
+HiZBuffer::HiZBuffer() : texture_id_(0), counter_buffer_id_(0), width_(0),
+                         height_(0), num_levels_(0),
+                         num_single_pass_levels_(0) {}
+
+HiZBuffer::~HiZBuffer() {
+  if (texture_id_ != 0) {
+    glDeleteTextures(1, &texture_id_);
+  }
+  BufferAllocator::Get()->DeleteBuffer(&counter_buffer_id_);
+}
+
+bool HiZBuffer::Initialize(const int width,
+                           const int height,
+                           std::string* error_info_log) {
+  width_ = width;
+  height_ = height;
+  num_levels_ = 1;
+  while ((std::max(width, height) >> num_levels_) > 0) ++num_levels_;
+  // Every level written by the single-pass shader takes an image unit.
+  GLint max_image_units = 0;
+  GLint max_compute_images = 0;
+  glGetIntegerv(GL_MAX_IMAGE_UNITS, &max_image_units);
+  glGetIntegerv(GL_MAX_COMPUTE_IMAGE_UNIFORMS, &max_compute_images);
+  num_single_pass_levels_ = std::max(
+      std::min(num_levels_, std::min(max_image_units, max_compute_images)), 1);
+  const std::string single_pass_source =
+      "#version 430\n#define NUM_LEVELS " +
+      std::to_string(num_single_pass_levels_) + "\n" +
+      kHiZSinglePassShader;
+  if (!single_pass_program_.LoadComputeShaderFromString(single_pass_source) ||
+      !single_pass_program_.Create(error_info_log)) {
+    return false;
+  }
+  if (num_single_pass_levels_ < num_levels_ &&
+      (!reduction_program_.LoadComputeShaderFromString(kHiZReductionShader) ||
+       !reduction_program_.Create(error_info_log))) {
+    return false;
+  }
+  if (counter_buffer_id_ == 0) {
+    BufferAllocator* allocator = BufferAllocator::Get();
+    counter_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+    const GLuint zero = 0;
+    GlStateCache* gl_state = GlStateCache::Current();
+    gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, counter_buffer_id_);
+    allocator->BufferData(counter_buffer_id_, GL_SHADER_STORAGE_BUFFER,
+                          sizeof(zero), &zero, GL_DYNAMIC_DRAW);
+    gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  }
+  if (texture_id_ != 0) {
+    glDeleteTextures(1, &texture_id_);
+  }
+  glGenTextures(1, &texture_id_);
+  glBindTexture(GL_TEXTURE_2D, texture_id_);
+  glTexStorage2D(GL_TEXTURE_2D, num_levels_, GL_RG32F, width, height);
+  // The culling shader selects the level explicitly.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_NEAREST_MIPMAP_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return texture_id_ != 0 && counter_buffer_id_ != 0;
+}
+
+void HiZBuffer::Build(const GLuint depth_texture_id) {
+  single_pass_program_.Use();
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, depth_texture_id);
+  for (int level = 0; level < num_single_pass_levels_; ++level) {
+    glBindImageTexture(level, texture_id_, level, GL_FALSE, 0,
+                       GL_READ_WRITE, GL_RG32F);
+  }
+  GlStateCache::Current()->BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0,
+                                          counter_buffer_id_);
+  // The culling shader, or the reduction of the remaining levels, fetches the
+  // texels written here.
+  single_pass_program_.Dispatch(std::max(width_ / kHiZTileSize, 1),
+                                std::max(height_ / kHiZTileSize, 1), 1,
+                                GL_TEXTURE_FETCH_BARRIER_BIT);
+  if (num_single_pass_levels_ < num_levels_) {
+    reduction_program_.Use();
+    const GLint source_level_location =
+        reduction_program_.GetUniformLocation("source_level");
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    for (int level = num_single_pass_levels_; level < num_levels_; ++level) {
+      const int level_width = std::max(width_ >> level, 1);
+      const int level_height = std::max(height_ >> level, 1);
+      reduction_program_.SetUniform(source_level_location,
+                                    static_cast<GLint>(level - 1));
+      glBindImageTexture(0, texture_id_, level, GL_FALSE, 0, GL_WRITE_ONLY,
+                         GL_RG32F);
+      // The next level fetches the texels written by this one.
+      reduction_program_.Dispatch(NumGroups(level_width, kReductionGroupSize),
+                                  NumGroups(level_height, kReductionGroupSize),
+                                  1, GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GpuCuller::GpuCuller() : record_buffer_id_(0), command_buffer_id_(0),
+                         counter_buffer_id_(0), num_records_(0),
+                         capacity_(0) {}
+
+GpuCuller::~GpuCuller() {
+  GLuint* buffers[] = {&record_buffer_id_, &command_buffer_id_,
+                       &counter_buffer_id_};
+  for (GLuint* buffer : buffers) {
+    BufferAllocator::Get()->DeleteBuffer(buffer);
+  }
+}
+
+bool GpuCuller::Initialize(std::string* error_info_log) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  if (!culling_program_.LoadComputeShaderFromString(kCullingShader) ||
+      !culling_program_.Create(error_info_log)) {
+    return false;
+  }
+  BufferAllocator* allocator = BufferAllocator::Get();
+  record_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+  command_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+  counter_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+  const GLuint zero = 0;
+  gl_state->BindBuffer(GL_ATOMIC_COUNTER_BUFFER, counter_buffer_id_);
+  allocator->BufferData(counter_buffer_id_, GL_ATOMIC_COUNTER_BUFFER,
+                        sizeof(zero), &zero, GL_DYNAMIC_DRAW);
+  gl_state->BindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+  return record_buffer_id_ != 0 && command_buffer_id_ != 0 &&
+      counter_buffer_id_ != 0;
+}
+
+void GpuCuller::SetRecords(const std::vector<CullingRecord>& records) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  num_records_ = records.size();
+  if (num_records_ > capacity_) {
+    capacity_ = std::max(num_records_, 2 * capacity_);
+    BufferAllocator* allocator = BufferAllocator::Get();
+    gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, command_buffer_id_);
+    allocator->BufferData(command_buffer_id_, GL_SHADER_STORAGE_BUFFER,
+                          capacity_ * sizeof(DrawElementsIndirectCommand),
+                          nullptr, GL_DYNAMIC_DRAW);
+    gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, record_buffer_id_);
+    allocator->BufferData(record_buffer_id_, GL_SHADER_STORAGE_BUFFER,
+                          capacity_ * sizeof(CullingRecord), nullptr,
+                          GL_STATIC_DRAW);
+  }
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, record_buffer_id_);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                  num_records_ * sizeof(CullingRecord), records.data());
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCuller::Cull(const Eigen::Matrix4f& view_projection,
+                     const HiZBuffer* hi_z) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  if (num_records_ == 0) return;
+  // Reset the counter and the commands of the previous frame. Empty commands
+  // draw nothing when the number of draws is not read from the GPU.
+  const GLuint zero = 0;
+  gl_state->BindBuffer(GL_ATOMIC_COUNTER_BUFFER, counter_buffer_id_);
+  glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(zero), &zero);
+  gl_state->BindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, command_buffer_id_);
+  glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER,
+                    GL_UNSIGNED_INT, &zero);
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  culling_program_.Use();
+  culling_program_.SetUniform("view_projection", view_projection);
+  culling_program_.SetUniform("num_records",
+                              static_cast<GLint>(num_records_));
+  culling_program_.SetUniform(
+      "hi_z_num_levels",
+      static_cast<GLint>(hi_z != nullptr ? hi_z->num_levels() : 0));
+  if (hi_z != nullptr) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hi_z->texture_id());
+  }
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, record_buffer_id_);
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, command_buffer_id_);
+  gl_state->BindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, counter_buffer_id_);
+  // The draws read the commands and the counter as indirect parameters.
+  culling_program_.Dispatch(NumGroups(num_records_, kCullingGroupSize), 1, 1,
+                            GL_COMMAND_BARRIER_BIT);
+  if (hi_z != nullptr) {
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+}
+
+void GpuCuller::Draw(const MeshBatch& batch) const {
+  GlStateCache* gl_state = GlStateCache::Current();
+  if (num_records_ == 0) return;
+  gl_state->BindVertexArray(batch.vertex_array_object_id());
+  gl_state->BindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_id_);
+  if (GLEW_ARB_indirect_parameters) {
+    gl_state->BindBuffer(GL_PARAMETER_BUFFER_ARB, counter_buffer_id_);
+    glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, batch.index_type(),
+                                        nullptr, 0, num_records_, 0);
+  } else {
+    glMultiDrawElementsIndirect(GL_TRIANGLES, batch.index_type(), nullptr,
+                                num_records_, 0);
+  }
+}
+
+}  // namespace wvu
@@ -0,0 +1,197 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_GPU_CULLING_H_
+#define GLUTILS_GPU_CULLING_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "mesh_batch.h"
+#include "shader_program.h"
+
+namespace wvu {
+// An instance to cull on the GPU: its bounding sphere in world coordinates and
+// the command that draws it when visible. The layout matches the std430
+// layout of the records read by the culling shader.
+struct CullingRecord {
+  GLfloat bounding_sphere[4];
+  DrawElementsIndirectCommand command;
+  GLuint padding[3];
+};
+
+// This class keeps a hierarchical-Z buffer: a mip chain of a depth texture
+// where every texel holds the farthest (red) and the nearest (green) depth of
+// the texels it covers. The culling shader tests the bounding rectangle of an
+// instance against the farthest depths of the few texels of the level that
+// covers it, so an occlusion test costs four fetches; screen-space effects,
+// e.g., ambient occlusion, may use the nearest depths. The pyramid is built
+// from the depth of the previous frame, which must be rendered into a depth
+// texture, with a single compute dispatch that reduces tiles of the depth in
+// shared memory. Only the levels past the image units of the device, e.g., 8,
+// are reduced by a dispatch per level.
+//
+// Example:
+//
+// wvu::HiZBuffer hi_z;
+// hi_z.Initialize(width, height, &error_info_log);
+// while (...) {  // Rendering loop.
+//   culler.Cull(view_projection, &hi_z);
+//   culler.Draw(batch);
+//   ...
+//   hi_z.Build(depth_texture_id);
+// }
+class HiZBuffer {
+ public:
+  HiZBuffer();
+  ~HiZBuffer();
+
+  // Compiles the reduction shaders and allocates the pyramid for a depth
+  // texture of width x height texels. Returns true if successful.
+  bool Initialize(const int width,
+                  const int height,
+                  std::string* error_info_log);
+
+  // Rebuilds the pyramid from a depth texture of the size given to
+  // Initialize().
+  void Build(const GLuint depth_texture_id);
+
+  GLuint texture_id() const {
+    return texture_id_;
+  }
+
+  int width() const {
+    return width_;
+  }
+
+  int height() const {
+    return height_;
+  }
+
+  int num_levels() const {
+    return num_levels_;
+  }
+
+  // Returns the number of levels built by the single dispatch.
+  int num_single_pass_levels() const {
+    return num_single_pass_levels_;
+  }
+
+ private:
+  ShaderProgram single_pass_program_;
+  // Reduces the levels past the single-pass ones, if any.
+  ShaderProgram reduction_program_;
+  GLuint texture_id_;
+  // The number of work groups of the single pass that finished.
+  GLuint counter_buffer_id_;
+  int width_;
+  int height_;
+  int num_levels_;
+  int num_single_pass_levels_;
+
+  HiZBuffer(const HiZBuffer&) = delete;
+  HiZBuffer& operator=(const HiZBuffer&) = delete;
+};
+
+// This class culls instances against the view frustum and, optionally, a
+// hierarchical-Z buffer with a compute shader. The shader writes the commands
+// of the visible instances contiguously into an indirect buffer, so the
+// draw submission never reads the results back to the CPU. With
+// ARB_indirect_parameters, the number of draws is read from the GPU as well;
+// otherwise every slot is drawn and the slots past the visible ones hold
+// empty commands.
+//
+// Example:
+//
+// wvu::GpuCuller culler;
+// culler.Initialize(&error_info_log);
+// culler.SetRecords(records);  // E.g., once per scene change.
+// while (...) {  // Rendering loop.
+//   culler.Cull(projection * view, &hi_z);
+//   shader_program.Use();
+//   culler.Draw(batch);
+// }
+class GpuCuller {
+ public:
+  GpuCuller();
+  ~GpuCuller();
+
+  // Compiles the culling shader and creates the buffers. Returns true if
+  // successful. Requires OpenGL 4.3.
+  bool Initialize(std::string* error_info_log);
+
+  // Uploads the instances to cull.
+  void SetRecords(const std::vector<CullingRecord>& records);
+
+  // Culls the instances. The occlusion test is skipped when hi_z is nullptr.
+  // Parameters:
+  //   view_projection  The matrix transforming world to clip coordinates.
+  //   hi_z  The hierarchical-Z buffer of the previous frame, or nullptr.
+  void Cull(const Eigen::Matrix4f& view_projection, const HiZBuffer* hi_z);
+
+  // Draws the visible instances with the geometry of the batch and the
+  // current program.
+  void Draw(const MeshBatch& batch) const;
+
+  int num_records() const {
+    return num_records_;
+  }
+
+  GLuint command_buffer_id() const {
+    return command_buffer_id_;
+  }
+
+  // The buffer holding the number of visible instances.
+  GLuint counter_buffer_id() const {
+    return counter_buffer_id_;
+  }
+
+ private:
+  ShaderProgram culling_program_;
+  GLuint record_buffer_id_;
+  GLuint command_buffer_id_;
+  GLuint counter_buffer_id_;
+  int num_records_;
+  // Capacity in records of the record and command buffers.
+  int capacity_;
+
+  GpuCuller(const GpuCuller&) = delete;
+  GpuCuller& operator=(const GpuCuller&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_GPU_CULLING_H_
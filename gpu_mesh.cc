@@ -0,0 +1,459 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "gpu_mesh.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_allocator.h"
+#include "gl_debug_output.h"
+#include "gl_state_cache.h"
+#include "gpu_resources.h"
+#include "model.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+// Creates a buffer with immutable storage holding the vertices of the model,
+// without binding it. The storage is written with glNamedBufferSubData().
+GLuint CreateNamedVertexBuffer(const Model& model) {
+  BufferAllocator* allocator = BufferAllocator::Get();
+  const GLuint vertex_buffer_object_id =
+      allocator->CreateNamedBuffer(VERTEX_DATA);
+  const std::vector<GLubyte>& vertices = model.vertex_data();
+  // Immutable storage cannot be empty.
+  allocator->NamedBufferStorage(
+      vertex_buffer_object_id,
+      std::max<GLsizeiptr>(vertices.size(), 1),
+      vertices.empty() ? nullptr : vertices.data(), GL_DYNAMIC_STORAGE_BIT);
+  SetObjectLabel(GL_BUFFER, vertex_buffer_object_id,
+                 std::to_string(model.num_vertices()) + " model vertices");
+  return vertex_buffer_object_id;
+}
+
+// Creates a buffer with immutable storage holding the indices of the model,
+// of model.index_type(), without binding it.
+GLuint CreateNamedElementBuffer(const Model& model) {
+  BufferAllocator* allocator = BufferAllocator::Get();
+  const GLuint element_buffer_object_id =
+      allocator->CreateNamedBuffer(INDEX_DATA);
+  const std::vector<GLuint>& indices = model.indices();
+  if (indices.empty()) {
+    allocator->NamedBufferStorage(element_buffer_object_id, 1, nullptr, 0);
+  } else if (model.index_type() == GL_UNSIGNED_SHORT) {
+    const std::vector<GLushort> short_indices(indices.begin(), indices.end());
+    allocator->NamedBufferStorage(
+        element_buffer_object_id,
+        short_indices.size() * sizeof(short_indices[0]), short_indices.data(),
+        0);
+  } else {
+    allocator->NamedBufferStorage(element_buffer_object_id,
+                                  indices.size() * sizeof(indices[0]),
+                                  indices.data(), 0);
+  }
+  SetObjectLabel(GL_BUFFER, element_buffer_object_id,
+                 std::to_string(model.num_indices()) + " model indices");
+  return element_buffer_object_id;
+}
+
+}  // namespace
+
+GpuMesh::GpuMesh()
+    : vertex_array_object_id_(0),
+      vertex_buffer_object_id_(0),
+      element_buffer_object_id_(0),
+      num_vertices_(0),
+      num_indices_(0),
+      index_type_(GL_UNSIGNED_INT),
+      primitive_type_(GL_TRIANGLES),
+      closed_(false),
+      immutable_vertex_storage_(false),
+      current_vertex_buffer_(0) {}
+
+GpuMesh::~GpuMesh() {
+  Reset();
+}
+
+GpuMesh::GpuMesh(GpuMesh&& mesh) : GpuMesh() {
+  *this = std::move(mesh);
+}
+
+GpuMesh& GpuMesh::operator=(GpuMesh&& mesh) {
+  if (this != &mesh) {
+    Reset();
+    std::swap(vertex_array_object_id_, mesh.vertex_array_object_id_);
+    std::swap(vertex_buffer_object_id_, mesh.vertex_buffer_object_id_);
+    std::swap(element_buffer_object_id_, mesh.element_buffer_object_id_);
+    std::swap(vertex_layout_, mesh.vertex_layout_);
+    std::swap(num_vertices_, mesh.num_vertices_);
+    std::swap(num_indices_, mesh.num_indices_);
+    std::swap(index_type_, mesh.index_type_);
+    std::swap(primitive_type_, mesh.primitive_type_);
+    std::swap(closed_, mesh.closed_);
+    std::swap(immutable_vertex_storage_, mesh.immutable_vertex_storage_);
+    vertex_array_object_ids_.swap(mesh.vertex_array_object_ids_);
+    vertex_buffer_object_ids_.swap(mesh.vertex_buffer_object_ids_);
+    pending_vertex_ranges_.swap(mesh.pending_vertex_ranges_);
+    std::swap(current_vertex_buffer_, mesh.current_vertex_buffer_);
+  }
+  return *this;
+}
+
+void GpuMesh::Reset() {
+  BufferAllocator* allocator = BufferAllocator::Get();
+  // The ids of a dynamic mesh are those of its current copy.
+  if (!vertex_array_object_ids_.empty()) {
+    for (const GLuint vertex_array_object_id : vertex_array_object_ids_) {
+      GpuResources::Get()->Retire(GPU_VERTEX_ARRAY, vertex_array_object_id);
+    }
+    for (GLuint& buffer_id : vertex_buffer_object_ids_) {
+      allocator->DeleteBuffer(&buffer_id);
+    }
+    vertex_array_object_id_ = 0;
+    vertex_buffer_object_id_ = 0;
+  }
+  vertex_array_object_ids_.clear();
+  vertex_buffer_object_ids_.clear();
+  pending_vertex_ranges_.clear();
+  current_vertex_buffer_ = 0;
+  GpuResources::Get()->Retire(GPU_VERTEX_ARRAY, vertex_array_object_id_);
+  allocator->DeleteBuffer(&vertex_buffer_object_id_);
+  allocator->DeleteBuffer(&element_buffer_object_id_);
+  vertex_array_object_id_ = 0;
+  num_vertices_ = 0;
+  num_indices_ = 0;
+  immutable_vertex_storage_ = false;
+}
+
+bool GpuMesh::UpdateVertices(Model* model) {
+  if (!valid() || model->vertex_layout() != vertex_layout_ ||
+      model->cpu_data_released()) {
+    return false;
+  }
+  int begin = model->dirty_vertices_begin();
+  int end = model->dirty_vertices_end();
+  // A different number of vertices replaces all of them.
+  if (model->num_vertices() != num_vertices_) {
+    num_vertices_ = model->num_vertices();
+    begin = 0;
+    end = num_vertices_;
+    // Immutable storage cannot be resized, so the vertex array object reads
+    // a new buffer.
+    if (immutable_vertex_storage_) {
+      model->ClearDirtyVertices();
+      GLuint previous_buffer_object_id = vertex_buffer_object_id_;
+      vertex_buffer_object_id_ = CreateNamedVertexBuffer(*model);
+      glVertexArrayVertexBuffer(vertex_array_object_id_, 0,
+                                vertex_buffer_object_id_, 0,
+                                vertex_layout_.stride());
+      BufferAllocator::Get()->DeleteBuffer(&previous_buffer_object_id);
+      return true;
+    }
+  }
+  model->ClearDirtyVertices();
+  if (vertex_buffer_object_ids_.empty()) {
+    if (begin < end) {
+      WriteVertices(*model, vertex_buffer_object_id_, begin, end);
+    }
+    return true;
+  }
+  // Every copy owes the new changes, and the next copy catches up with the
+  // changes made since it was written.
+  for (std::pair<int, int>& range : pending_vertex_ranges_) {
+    if (begin >= end) break;
+    if (range.first >= range.second) {
+      range = std::make_pair(begin, end);
+    } else {
+      range = std::make_pair(std::min(range.first, begin),
+                             std::max(range.second, end));
+    }
+  }
+  current_vertex_buffer_ =
+      (current_vertex_buffer_ + 1) % vertex_buffer_object_ids_.size();
+  std::pair<int, int>& pending = pending_vertex_ranges_[current_vertex_buffer_];
+  vertex_array_object_id_ = vertex_array_object_ids_[current_vertex_buffer_];
+  vertex_buffer_object_id_ = vertex_buffer_object_ids_[current_vertex_buffer_];
+  if (pending.first < pending.second) {
+    WriteVertices(*model, vertex_buffer_object_id_, pending.first,
+                  pending.second);
+  }
+  pending = std::make_pair(0, 0);
+  return true;
+}
+
+void GpuMesh::WriteVertices(const Model& model,
+                            const GLuint vertex_buffer_object_id,
+                            const int begin,
+                            const int end) const {
+  GlStateCache* gl_state = GlStateCache::Current();
+  const int stride = vertex_layout_.stride();
+  const GLubyte* vertices = model.vertex_data().data();
+  // The immutable storage is written in place, even when all the vertices
+  // change.
+  if (immutable_vertex_storage_) {
+    glNamedBufferSubData(vertex_buffer_object_id, begin * stride,
+                         (end - begin) * stride, vertices + begin * stride);
+    return;
+  }
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object_id);
+  if (begin == 0 && end == num_vertices_) {
+    // New storage: the draws still reading the old one do not block the
+    // write.
+    BufferAllocator::Get()->BufferData(
+        vertex_buffer_object_id, GL_ARRAY_BUFFER, num_vertices_ * stride,
+        vertices, vertex_buffer_object_ids_.empty() ?
+        GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+  } else {
+    glBufferSubData(GL_ARRAY_BUFFER, begin * stride, (end - begin) * stride,
+                    vertices + begin * stride);
+  }
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool DirectStateAccessSupported() {
+  return GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access;
+}
+
+// Creates and transfers the vertices into the GPU. Returns the vertex buffer
+// object id.
+GLuint SetVertexBufferObject(const Model& model) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  // Create a vertex buffer object (vbo).
+  BufferAllocator* allocator = BufferAllocator::Get();
+  const GLuint vertex_buffer_object_id = allocator->CreateBuffer(VERTEX_DATA);
+  // Set the GL_ARRAY_BUFFER of OpenGL to the vbo we just created.
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object_id);
+  // Copy the vertices into the GL_ARRAY_BUFFER that currently 'points' to our
+  // recently created vbo. In this case, sizeof(vertices) returns the size of
+  // the array vertices (defined above) in bytes.
+  // First parameter specifies the destination buffer.
+  // Second parameter specifies the size of the buffer.
+  // Third parameter specifies the pointer to the vertices buffer in RAM.
+  // Fourth parameter specifies the way we want OpenGL to treat the buffer.
+  // There are three different ways to treat this buffer:
+  // 1. GL_STATIC_DRAW: the data will change very rarely.
+  // 2. GL_DYNAMIC_DRAW: the data will likely change.
+  // 3. GL_STREAM_DRAW: the data will change every time it is drawn.
+  // See https://www.opengl.org/sdk/docs/man/html/glBufferData.xhtml.
+  const std::vector<GLubyte>& vertices = model.vertex_data();
+  // The allocator calls glBufferData() and keeps track of the bytes.
+  allocator->BufferData(vertex_buffer_object_id,
+                        GL_ARRAY_BUFFER,
+                        vertices.size(),
+                        vertices.data(),
+                        GL_STATIC_DRAW);
+  // Inform OpenGL how the vertex buffer is arranged. The vertices are
+  // interleaved in a single stream, and the layout of the model tells the
+  // location, number of components, type and offset of each attribute.
+  model.vertex_layout().SetAttributePointers();
+  // Unbind buffer so that later we can use it.
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+  // Name the buffer in the debug output and the debuggers.
+  SetObjectLabel(GL_BUFFER, vertex_buffer_object_id,
+                 std::to_string(model.num_vertices()) + " model vertices");
+  return vertex_buffer_object_id;
+}
+
+GLuint SetElementBufferObject(const Model& model) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  // Allocates memory in the GPU for the EBO.
+  BufferAllocator* allocator = BufferAllocator::Get();
+  const GLuint element_buffer_object_id = allocator->CreateBuffer(INDEX_DATA);
+  // Set the GL_ARRAY_BUFFER of OpenGL to the vbo we just created.
+  gl_state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object_id);
+  const std::vector<GLuint>& indices = model.indices();
+  // Copying buffer to the GPU. Meshes with few vertices use 16-bit indices,
+  // which halves the memory and bandwidth of the EBO. The draw call must use
+  // the same type, i.e., model.index_type().
+  if (model.index_type() == GL_UNSIGNED_SHORT) {
+    const std::vector<GLushort> short_indices(indices.begin(), indices.end());
+    allocator->BufferData(element_buffer_object_id,
+                          GL_ELEMENT_ARRAY_BUFFER,
+                          short_indices.size() * sizeof(short_indices[0]),
+                          short_indices.data(),
+                          GL_STATIC_DRAW);
+  } else {
+    allocator->BufferData(element_buffer_object_id,
+                          GL_ELEMENT_ARRAY_BUFFER,
+                          indices.size() * sizeof(indices[0]),
+                          indices.data(),
+                          GL_STATIC_DRAW);
+  }
+  // NOTE: Do not unbing EBO. It turns out that when we create a buffer of type
+  // GL_ELEMENT_ARRAY_BUFFER, the VAO who contains the EBO remembers the
+  // bindings we perform. Thus if we unbind it, we detach the created EBO and we
+  // won't see results.
+  SetObjectLabel(GL_BUFFER, element_buffer_object_id,
+                 std::to_string(model.num_indices()) + " model indices");
+  return element_buffer_object_id;
+}
+
+// Creates and sets the vertex array object (VAO) for our triangle. Returns the
+// mesh owning the VAO and its buffers.
+GpuMesh SetVertexArrayObject(const Model& model) {
+  // With direct state access, the buffers are created and filled by name, and
+  // the EBO is attached to the VAO explicitly instead of through its binding.
+  if (DirectStateAccessSupported()) {
+    GpuMesh mesh = SetVertexArrayObject(model, CreateNamedVertexBuffer(model),
+                                        CreateNamedElementBuffer(model));
+    mesh.immutable_vertex_storage_ = true;
+    return mesh;
+  }
+  GlStateCache* gl_state = GlStateCache::Current();
+  GpuMesh mesh;
+  // Create the vertex array object (VAO).
+  constexpr int kNumVertexArrays = 1;
+  // This function creates kNumVertexArrays vaos and stores the ids in the
+  // array pointed by the second argument.
+  glGenVertexArrays(kNumVertexArrays, &mesh.vertex_array_object_id_);
+  // Set the recently created vertex array object (VAO) current.
+  gl_state->BindVertexArray(mesh.vertex_array_object_id_);
+  // Create the Vertex Buffer Object (VBO).
+  mesh.vertex_buffer_object_id_ = SetVertexBufferObject(model);
+  mesh.element_buffer_object_id_ = SetElementBufferObject(model);
+  // Disable our created VAO.
+  gl_state->BindVertexArray(0);
+  // Keep what the draw calls need, since the model may release its data.
+  mesh.vertex_layout_ = model.vertex_layout();
+  mesh.num_vertices_ = model.num_vertices();
+  mesh.num_indices_ = model.num_indices();
+  mesh.index_type_ = model.index_type();
+  mesh.primitive_type_ = model.primitive_type();
+  mesh.closed_ = model.closed();
+  return mesh;
+}
+
+GpuMesh SetVertexArrayObject(const Model& model,
+                             const GLuint vertex_buffer_object_id,
+                             const GLuint element_buffer_object_id) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  GpuMesh mesh;
+  if (DirectStateAccessSupported()) {
+    // The buffers exist, since they were bound to be filled, so the VAO reads
+    // them from binding point 0 without binding anything.
+    glCreateVertexArrays(1, &mesh.vertex_array_object_id_);
+    model.vertex_layout().SetVertexArrayFormat(mesh.vertex_array_object_id_,
+                                               0);
+    glVertexArrayVertexBuffer(mesh.vertex_array_object_id_, 0,
+                              vertex_buffer_object_id, 0,
+                              model.vertex_layout().stride());
+    glVertexArrayElementBuffer(mesh.vertex_array_object_id_,
+                               element_buffer_object_id);
+  } else {
+    glGenVertexArrays(1, &mesh.vertex_array_object_id_);
+    gl_state->BindVertexArray(mesh.vertex_array_object_id_);
+    gl_state->BindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object_id);
+    model.vertex_layout().SetAttributePointers();
+    gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+    // The EBO binding is part of the VAO state, so it must stay bound.
+    gl_state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object_id);
+    gl_state->BindVertexArray(0);
+  }
+  mesh.vertex_buffer_object_id_ = vertex_buffer_object_id;
+  mesh.element_buffer_object_id_ = element_buffer_object_id;
+  mesh.vertex_layout_ = model.vertex_layout();
+  mesh.num_vertices_ = model.num_vertices();
+  mesh.num_indices_ = model.num_indices();
+  mesh.index_type_ = model.index_type();
+  mesh.primitive_type_ = model.primitive_type();
+  mesh.closed_ = model.closed();
+  return mesh;
+}
+
+GpuMesh SetDynamicVertexArrayObject(const Model& model,
+                                    const int num_buffers) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  BufferAllocator* allocator = BufferAllocator::Get();
+  GpuMesh mesh;
+  const int num_copies = std::max(num_buffers, 1);
+  mesh.vertex_array_object_ids_.resize(num_copies);
+  glGenVertexArrays(num_copies, mesh.vertex_array_object_ids_.data());
+  const std::vector<GLubyte>& vertices = model.vertex_data();
+  for (int i = 0; i < num_copies; ++i) {
+    gl_state->BindVertexArray(mesh.vertex_array_object_ids_[i]);
+    const GLuint vertex_buffer_object_id =
+        allocator->CreateBuffer(VERTEX_DATA);
+    gl_state->BindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object_id);
+    allocator->BufferData(vertex_buffer_object_id, GL_ARRAY_BUFFER,
+                          vertices.size(), vertices.data(), GL_DYNAMIC_DRAW);
+    model.vertex_layout().SetAttributePointers();
+    mesh.vertex_buffer_object_ids_.push_back(vertex_buffer_object_id);
+    // The copies share the indices.
+    if (i == 0) {
+      mesh.element_buffer_object_id_ = SetElementBufferObject(model);
+    } else {
+      gl_state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                           mesh.element_buffer_object_id_);
+    }
+  }
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+  gl_state->BindVertexArray(0);
+  mesh.pending_vertex_ranges_.assign(num_copies, std::make_pair(0, 0));
+  mesh.current_vertex_buffer_ = 0;
+  mesh.vertex_array_object_id_ = mesh.vertex_array_object_ids_[0];
+  mesh.vertex_buffer_object_id_ = mesh.vertex_buffer_object_ids_[0];
+  mesh.vertex_layout_ = model.vertex_layout();
+  mesh.num_vertices_ = model.num_vertices();
+  mesh.num_indices_ = model.num_indices();
+  mesh.index_type_ = model.index_type();
+  mesh.primitive_type_ = model.primitive_type();
+  mesh.closed_ = model.closed();
+  return mesh;
+}
+
+void Draw(const GpuMesh& mesh) {
+  DrawRange(mesh, 0, mesh.num_indices());
+}
+
+void DrawRange(const GpuMesh& mesh,
+               const int first_index,
+               const int num_indices) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  // Let OpenGL know what vertex array object we will use.
+  gl_state->BindVertexArray(mesh.vertex_array_object_id());
+  // The offset into the EBO is passed as a pointer.
+  const GLvoid* offset = reinterpret_cast<const GLvoid*>(
+      static_cast<uintptr_t>(first_index) * IndexSize(mesh.index_type()));
+  glDrawElements(mesh.primitive_type(), num_indices, mesh.index_type(),
+                 offset);
+  // The vertex array object stays bound, so that consecutive draws of the same
+  // mesh do not bind it again (see GlStateCache).
+}
+
+}  // namespace wvu
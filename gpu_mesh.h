@@ -0,0 +1,241 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_GPU_MESH_H_
+#define GLUTILS_GPU_MESH_H_
+
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+#include "model.h"
+#include "vertex_format.h"
+
+namespace wvu {
+// Default number of vertex buffers of a dynamic mesh. The GPU usually draws
+// at most two frames behind, so three copies are never written while drawn.
+constexpr int kDefaultNumDynamicVertexBuffers = 3;
+
+// This class owns the OpenGL objects of a mesh uploaded into the GPU: the
+// vertex array object (VAO), the vertex buffer object (VBO) and the element
+// buffer object (EBO). It also keeps everything a draw call needs (index
+// count, index type and primitive), so nothing has to be re-derived from the
+// model every frame, and the model can release its CPU data after the upload.
+// The objects are deleted when the mesh goes out of scope or is reset, which
+// must happen while the OpenGL context is current. Meshes can be moved but not
+// copied.
+//
+// On OpenGL 4.5, or with GL_ARB_direct_state_access, the static meshes are
+// created with direct state access: the buffers and the vertex array object
+// are filled by name, so creating a mesh binds nothing and leaves the bindings
+// of the draws (see GlStateCache) alone. Their vertex buffers have immutable
+// storage, and the vertex array object reads them through a vertex buffer
+// binding point, which UpdateVertices() points to a new buffer when the
+// number of vertices changes.
+//
+// Example:
+//
+// wvu::GpuMesh mesh = wvu::SetVertexArrayObject(model);
+// model.ReleaseCpuData();
+// while (...) {  // Rendering loop.
+//   shader_program.Use();
+//   wvu::Draw(mesh);
+// }
+//
+// Meshes whose vertices change every frame, e.g., a deforming surface, keep
+// several copies of their vertex buffer and draw them in turns, so that the
+// copy being written is not the one the GPU may still be drawing. Only the
+// dirty vertices of the model are uploaded:
+//
+// wvu::GpuMesh mesh = wvu::SetDynamicVertexArrayObject(model);
+// while (...) {  // Rendering loop.
+//   model.UpdateVertices(first_vertex, moved_vertices);
+//   mesh.UpdateVertices(&model);
+//   wvu::Draw(mesh);
+// }
+class GpuMesh {
+ public:
+  GpuMesh();
+  ~GpuMesh();
+
+  GpuMesh(GpuMesh&& mesh);
+  GpuMesh& operator=(GpuMesh&& mesh);
+
+  // Deletes the OpenGL objects.
+  void Reset();
+
+  // Uploads the dirty vertices of the model (see Model::UpdateVertices()) and
+  // clears them. A dynamic mesh switches to its next copy of the vertices and
+  // writes the vertices that changed since that copy was last written, so the
+  // write does not wait for the draws of the previous frames. A copy whose
+  // vertices all changed is orphaned and written with glBufferData(), and
+  // otherwise only the changed range is written with glBufferSubData(). The
+  // model must have the layout of the mesh and keep its CPU data. Returns
+  // true if successful.
+  bool UpdateVertices(Model* model);
+
+  // Returns true if the mesh holds uploaded buffers.
+  bool valid() const {
+    return vertex_array_object_id_ != 0;
+  }
+
+  GLuint vertex_array_object_id() const {
+    return vertex_array_object_id_;
+  }
+
+  // Returns the vertex buffer of the next draws. A dynamic mesh changes it in
+  // UpdateVertices().
+  GLuint vertex_buffer_object_id() const {
+    return vertex_buffer_object_id_;
+  }
+
+  GLuint element_buffer_object_id() const {
+    return element_buffer_object_id_;
+  }
+
+  const VertexLayout& vertex_layout() const {
+    return vertex_layout_;
+  }
+
+  int num_vertices() const {
+    return num_vertices_;
+  }
+
+  int num_indices() const {
+    return num_indices_;
+  }
+
+  GLenum index_type() const {
+    return index_type_;
+  }
+
+  GLenum primitive_type() const {
+    return primitive_type_;
+  }
+
+  // Returns true if the model was closed (see Model::closed()), in which case
+  // its back faces can be culled.
+  bool closed() const {
+    return closed_;
+  }
+
+  // Returns the number of copies of the vertices, more than one for dynamic
+  // meshes.
+  int num_vertex_buffers() const {
+    return vertex_buffer_object_ids_.empty() ?
+        1 : vertex_buffer_object_ids_.size();
+  }
+
+ private:
+  friend GpuMesh SetVertexArrayObject(const Model& model);
+  friend GpuMesh SetVertexArrayObject(const Model& model,
+                                      const GLuint vertex_buffer_object_id,
+                                      const GLuint element_buffer_object_id);
+  friend GpuMesh SetDynamicVertexArrayObject(const Model& model,
+                                             const int num_buffers);
+
+  // Writes the vertices [begin, end) of the model into a vertex buffer.
+  void WriteVertices(const Model& model,
+                     const GLuint vertex_buffer_object_id,
+                     const int begin,
+                     const int end) const;
+
+  // The ids of the copy of the vertices drawn next.
+  GLuint vertex_array_object_id_;
+  GLuint vertex_buffer_object_id_;
+  GLuint element_buffer_object_id_;
+  VertexLayout vertex_layout_;
+  int num_vertices_;
+  int num_indices_;
+  GLenum index_type_;
+  GLenum primitive_type_;
+  bool closed_;
+  // Whether the vertex buffer has immutable storage, written in place.
+  bool immutable_vertex_storage_;
+  // The copies of a dynamic mesh, each with its vertex array object, and the
+  // range [begin, end) of the vertices that changed since it was written.
+  // Empty for the other meshes.
+  std::vector<GLuint> vertex_array_object_ids_;
+  std::vector<GLuint> vertex_buffer_object_ids_;
+  std::vector<std::pair<int, int> > pending_vertex_ranges_;
+  int current_vertex_buffer_;
+
+  GpuMesh(const GpuMesh&) = delete;
+  GpuMesh& operator=(const GpuMesh&) = delete;
+};
+
+// Returns true if the meshes are created with direct state access.
+bool DirectStateAccessSupported();
+
+// Creates and transfers the vertices into the GPU. Returns the vertex buffer
+// object id. The VBO is left configured in the currently bound VAO.
+GLuint SetVertexBufferObject(const Model& model);
+
+// Creates and transfers the indices into the GPU, using model.index_type().
+// Returns the element buffer object id. The EBO stays bound to the currently
+// bound VAO.
+GLuint SetElementBufferObject(const Model& model);
+
+// Creates and sets the vertex array object (VAO) for the model, along with its
+// buffers. Returns the mesh owning them.
+GpuMesh SetVertexArrayObject(const Model& model);
+
+// Creates the vertex array object of buffers already holding the vertices and
+// indices of the model, e.g., uploaded by a MeshUploader on a shared context.
+// Vertex array objects are not shared between contexts, so they must be created
+// on the context that draws them. The mesh takes ownership of the buffers, and
+// the model only needs its layout and counts.
+GpuMesh SetVertexArrayObject(const Model& model,
+                             const GLuint vertex_buffer_object_id,
+                             const GLuint element_buffer_object_id);
+
+// Creates a mesh whose vertices are updated often, with num_buffers copies of
+// its vertex buffer, each with its vertex array object, all sharing the
+// element buffer. The buffers are GL_DYNAMIC_DRAW.
+GpuMesh SetDynamicVertexArrayObject(
+    const Model& model,
+    const int num_buffers = kDefaultNumDynamicVertexBuffers);
+
+// Draws all the indices of the mesh with the current program.
+void Draw(const GpuMesh& mesh);
+
+// Draws num_indices indices of the mesh starting at first_index, e.g., a level
+// of detail.
+void DrawRange(const GpuMesh& mesh,
+               const int first_index,
+               const int num_indices);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_GPU_MESH_H_
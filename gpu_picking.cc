@@ -0,0 +1,263 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "gpu_picking.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "render_queue.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Bytes of the ID and of the depth read back per pick.
+constexpr int kBytesPerId = sizeof(GLuint);
+constexpr int kBytesPerDepth = sizeof(GLfloat);
+
+// The programs of the items are replaced, so the positions are transformed by
+// the products of the queue alone.
+const char kIdVertexShaderSource[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "uniform mat4 model_view_projection;\n"
+    "void main() {\n"
+    "gl_Position = model_view_projection * vec4(position, 1.0f);\n"
+    "}\n";
+
+const char kIdFragmentShaderSource[] =
+    "#version 330 core\n"
+    "uniform int object_id;\n"
+    "layout (location = 0) out uint id;\n"
+    "void main() {\n"
+    "id = uint(object_id);\n"
+    "}\n";
+
+}  // namespace
+
+GpuPicker::GpuPicker()
+    : framebuffer_id_(0), id_renderbuffer_id_(0), depth_renderbuffer_id_(0),
+      oldest_buffer_(0), num_pending_(0) {}
+
+GpuPicker::~GpuPicker() {
+  Reset();
+}
+
+bool GpuPicker::Initialize(const int num_buffers,
+                           std::string* error_info_log) {
+  Reset();
+  if (num_buffers <= 0) {
+    *error_info_log = "Invalid number of pick buffers " +
+        std::to_string(num_buffers) + ".";
+    return false;
+  }
+  // The program is kept by Reset(), and deleted with the picker.
+  if (id_program_.shader_program_id() == 0) {
+    id_program_.LoadVertexShaderFromString(kIdVertexShaderSource);
+    id_program_.LoadFragmentShaderFromString(kIdFragmentShaderSource);
+    if (!id_program_.Create(error_info_log)) return false;
+  }
+
+  // The target holds the pixel picked alone.
+  glGenRenderbuffers(1, &id_renderbuffer_id_);
+  glBindRenderbuffer(GL_RENDERBUFFER, id_renderbuffer_id_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, 1, 1);
+  glGenRenderbuffers(1, &depth_renderbuffer_id_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_id_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, 1, 1);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  GLint previous_framebuffer_id = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_framebuffer_id);
+  glGenFramebuffers(1, &framebuffer_id_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, id_renderbuffer_id_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_renderbuffer_id_);
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer_id);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    *error_info_log = "The ID framebuffer is incomplete: status " +
+        std::to_string(status) + ".";
+    Reset();
+    return false;
+  }
+
+  buffers_.resize(num_buffers);
+  BufferAllocator* allocator = BufferAllocator::Get();
+  GlStateCache* gl_state = GlStateCache::Current();
+  for (PixelBuffer& buffer : buffers_) {
+    buffer.buffer_id = allocator->CreateBuffer(STAGING_DATA);
+    if (buffer.buffer_id == 0) {
+      *error_info_log = "Could not create the pick buffers.";
+      Reset();
+      return false;
+    }
+    gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer_id);
+    allocator->BufferData(buffer.buffer_id, GL_PIXEL_PACK_BUFFER,
+                          kBytesPerId + kBytesPerDepth, nullptr,
+                          GL_STREAM_READ);
+  }
+  gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  return true;
+}
+
+void GpuPicker::Pick(const Eigen::Matrix4f& view,
+                     const Eigen::Matrix4f& projection,
+                     const Eigen::Vector2f& point,
+                     const int width,
+                     const int height,
+                     const int64_t frame,
+                     RenderQueue* render_queue) {
+  if (buffers_.empty() || width <= 0 || height <= 0) return;
+  // Waiting for the oldest pick would stall the pipeline, so the click is
+  // dropped instead.
+  if (num_pending_ == static_cast<int>(buffers_.size())) {
+    ++statistics_.num_dropped_picks;
+    return;
+  }
+  GLint previous_framebuffer_ids[2] = {0, 0};
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer_ids[0]);
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous_framebuffer_ids[1]);
+  GLint previous_viewport[4];
+  glGetIntegerv(GL_VIEWPORT, previous_viewport);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+  glViewport(0, 0, 1, 1);
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->ColorMask(true);
+  gl_state->DepthMask(true);
+  gl_state->DepthFunc(GL_LESS);
+  gl_state->SetCapability(GL_DEPTH_TEST, true);
+  const GLuint no_object_id[4] = {0, 0, 0, 0};
+  const GLfloat far_depth = 1.0f;
+  glClearBufferuiv(GL_COLOR, 0, no_object_id);
+  glClearBufferfv(GL_DEPTH, 0, &far_depth);
+  render_queue->SetViewProjection(
+      view, PickMatrix(point, width, height) * projection);
+  render_queue->ExecuteIdPass(&id_program_);
+
+  PixelBuffer& buffer =
+      buffers_[(oldest_buffer_ + num_pending_) % buffers_.size()];
+  gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer_id);
+  glReadPixels(0, 0, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+  glReadPixels(0, 0, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT,
+               reinterpret_cast<GLvoid*>(static_cast<uintptr_t>(kBytesPerId)));
+  gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  buffer.frame = frame;
+  buffer.point = point;
+  ++num_pending_;
+  ++statistics_.num_picks;
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous_framebuffer_ids[0]);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previous_framebuffer_ids[1]);
+  glViewport(previous_viewport[0], previous_viewport[1],
+             previous_viewport[2], previous_viewport[3]);
+  render_queue->SetViewProjection(view, projection);
+}
+
+bool GpuPicker::Poll(GpuPick* pick) {
+  if (num_pending_ == 0) return false;
+  PixelBuffer& buffer = buffers_[oldest_buffer_];
+  // The first poll flushes the commands of the pick, so that the fence is
+  // eventually signaled even if nothing else flushes them.
+  const GLenum status =
+      glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  if (status == GL_TIMEOUT_EXPIRED) return false;
+  glDeleteSync(buffer.fence);
+  buffer.fence = nullptr;
+  oldest_buffer_ = (oldest_buffer_ + 1) % buffers_.size();
+  --num_pending_;
+
+  // The copy is complete, so mapping the buffer does not wait.
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer_id);
+  const void* data = glMapBufferRange(
+      GL_PIXEL_PACK_BUFFER, 0, kBytesPerId + kBytesPerDepth, GL_MAP_READ_BIT);
+  bool mapped = data != nullptr;
+  if (mapped) {
+    const GLubyte* bytes = static_cast<const GLubyte*>(data);
+    pick->frame = buffer.frame;
+    pick->point = buffer.point;
+    pick->object_id = *reinterpret_cast<const GLuint*>(bytes);
+    pick->depth = *reinterpret_cast<const GLfloat*>(bytes + kBytesPerId);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    ++statistics_.num_completed_picks;
+  }
+  gl_state->BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  return mapped;
+}
+
+void GpuPicker::Reset() {
+  for (PixelBuffer& buffer : buffers_) {
+    if (buffer.fence != nullptr) glDeleteSync(buffer.fence);
+    BufferAllocator::Get()->DeleteBuffer(&buffer.buffer_id);
+  }
+  buffers_.clear();
+  oldest_buffer_ = 0;
+  num_pending_ = 0;
+  if (framebuffer_id_ != 0) glDeleteFramebuffers(1, &framebuffer_id_);
+  if (id_renderbuffer_id_ != 0) {
+    glDeleteRenderbuffers(1, &id_renderbuffer_id_);
+  }
+  if (depth_renderbuffer_id_ != 0) {
+    glDeleteRenderbuffers(1, &depth_renderbuffer_id_);
+  }
+  framebuffer_id_ = 0;
+  id_renderbuffer_id_ = 0;
+  depth_renderbuffer_id_ = 0;
+}
+
+Eigen::Matrix4f GpuPicker::PickMatrix(const Eigen::Vector2f& point,
+                                      const int width,
+                                      const int height) {
+  // Scales the pixel, 2 / width x 2 / height in normalized device
+  // coordinates, by width x height around its center. Multiplying the
+  // clip-space x and y keeps the perspective division and the depths.
+  Eigen::Matrix4f pick_matrix = Eigen::Matrix4f::Identity();
+  pick_matrix(0, 0) = width;
+  pick_matrix(1, 1) = height;
+  pick_matrix(0, 3) = -point.x() * width;
+  pick_matrix(1, 3) = -point.y() * height;
+  return pick_matrix;
+}
+
+}  // namespace wvu
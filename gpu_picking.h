@@ -0,0 +1,199 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_GPU_PICKING_H_
+#define GLUTILS_GPU_PICKING_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "render_queue.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Default number of pixel buffers of a GpuPicker, i.e., the number of picks
+// in flight.
+constexpr int kDefaultNumPickBuffers = 3;
+
+// The object under a point of the viewport, read back by a GpuPicker.
+struct GpuPick {
+  // The number of the frame passed to GpuPicker::Pick().
+  int64_t frame = 0;
+  // The point passed to GpuPicker::Pick(), in normalized device coordinates.
+  Eigen::Vector2f point = Eigen::Vector2f::Zero();
+  // The RenderItem::object_id of the nearest item under the point, or 0 if
+  // there is none.
+  GLuint object_id = 0;
+  // The window-space depth of the nearest item, in [0, 1], or 1 if there is
+  // none. With the point, it unprojects to the position picked.
+  float depth = 1.0f;
+};
+
+// Counters of a GpuPicker.
+struct GpuPickerStatistics {
+  // The picks drawn.
+  int num_picks = 0;
+  // The picks skipped because all the pixel buffers held picks in flight.
+  int num_dropped_picks = 0;
+  // The picks read back.
+  int num_completed_picks = 0;
+};
+
+// This class picks the object under the cursor on the GPU, as an alternative
+// to raycasting the triangles on the CPU (see mesh_picking.h): picking costs
+// no traversal of the scene on the CPU, whatever its size, and no stall of
+// the pipeline.
+//
+// Pick() draws the items of a RenderQueue once more with a program writing
+// their RenderItem::object_id into a 32-bit integer target, and reads the ID
+// and the depth of the target into a pixel buffer object (PBO) with a fence.
+// The projection is narrowed to the pixel under the point, so the target
+// holds a single pixel: the pass only runs the vertex shaders of the items,
+// only in the frames that pick, and the shading pass is left untouched.
+// Poll() maps the buffer once the GPU has written it, typically on the next
+// frame, without waiting.
+//
+// Example:
+//
+// wvu::GpuPicker picker;
+// if (!picker.Initialize(wvu::kDefaultNumPickBuffers, &error_info_log)) {
+//   ...
+// }
+// while (...) {  // Rendering loop.
+//   render_queue.Clear();
+//   item.object_id = object_index + 1;
+//   render_queue.Add(item);
+//   ...
+//   render_queue.Execute();
+//   if (clicked) {
+//     picker.Pick(camera.view(), camera.projection(), cursor_point,
+//                 framebuffer_width, framebuffer_height, frame,
+//                 &render_queue);
+//   }
+//   wvu::GpuPick pick;
+//   if (picker.Poll(&pick) && pick.object_id != 0) {
+//     ...  // Select the object pick.object_id - 1.
+//   }
+// }
+class GpuPicker {
+ public:
+  GpuPicker();
+  ~GpuPicker();
+
+  // Creates the ID target, its program and the pixel buffers. Returns true if
+  // successful.
+  // Parameters:
+  //   num_buffers  The number of picks in flight.
+  //   error_info_log  The reason of the failure.
+  bool Initialize(const int num_buffers, std::string* error_info_log);
+
+  // Draws the IDs of the items of a queue at a point of the viewport, and
+  // starts reading them back. The pick is skipped if all the pixel buffers
+  // hold picks in flight. Restores the framebuffer and the viewport, and
+  // leaves the depth writes on. The products of the queue are computed with
+  // the narrowed projection, and are recomputed on its next draw.
+  // Parameters:
+  //   view  The view matrix of the frame.
+  //   projection  The projection matrix of the frame.
+  //   point  The point in normalized device coordinates, e.g.,
+  //     (2 x / width - 1, 1 - 2 y / height) for the cursor position (x, y)
+  //     of a window of width x height.
+  //   width  The width of the viewport in pixels, which sets the size of the
+  //     pixel picked.
+  //   height  The height of the viewport in pixels.
+  //   frame  The number of the frame, returned with the pick.
+  //   render_queue  The queue of the frame, whose items are drawn with the
+  //     program of the picker instead of theirs.
+  void Pick(const Eigen::Matrix4f& view,
+            const Eigen::Matrix4f& projection,
+            const Eigen::Vector2f& point,
+            const int width,
+            const int height,
+            const int64_t frame,
+            RenderQueue* render_queue);
+
+  // Returns true and the oldest pick in flight if the GPU has written it,
+  // without waiting otherwise.
+  bool Poll(GpuPick* pick);
+
+  // Deletes the target and the pixel buffers. The program is deleted with
+  // the picker.
+  void Reset();
+
+  // Returns the matrix scaling the pixel of a viewport of width x height
+  // centered at point, in normalized device coordinates, to the whole clip
+  // space. Multiplied on the left of a projection matrix, it draws that pixel
+  // alone into a target of 1 x 1 pixel.
+  static Eigen::Matrix4f PickMatrix(const Eigen::Vector2f& point,
+                                    const int width,
+                                    const int height);
+
+  // Returns the number of picks in flight.
+  int num_pending() const {
+    return num_pending_;
+  }
+
+  const GpuPickerStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  struct PixelBuffer {
+    GLuint buffer_id = 0;
+    GLsync fence = nullptr;
+    int64_t frame = 0;
+    Eigen::Vector2f point = Eigen::Vector2f::Zero();
+  };
+
+  ShaderProgram id_program_;
+  GLuint framebuffer_id_;
+  GLuint id_renderbuffer_id_;
+  GLuint depth_renderbuffer_id_;
+  std::vector<PixelBuffer> buffers_;
+  // Buffer of the oldest pick in flight.
+  int oldest_buffer_;
+  int num_pending_;
+  GpuPickerStatistics statistics_;
+
+  GpuPicker(const GpuPicker&) = delete;
+  GpuPicker& operator=(const GpuPicker&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_GPU_PICKING_H_
@@ -0,0 +1,239 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "gpu_resources.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <GL/glew.h>
+
+#include "gl_state_cache.h"
+
+namespace wvu {
+namespace {
+// Time in nanoseconds to wait for a fence before checking it again.
+constexpr GLuint64 kFenceTimeout = 1000000000;
+
+}  // namespace
+
+GpuResources::GpuResources() : deferred_(false) {}
+
+GpuResources* GpuResources::Get() {
+  static GpuResources resources;
+  return &resources;
+}
+
+GpuHandle GpuResources::Register(const GpuResourceType type,
+                                 const GLuint id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint32_t index;
+  if (!free_slots_.empty()) {
+    index = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    // The last index of the last generation would be kInvalidGpuHandle.
+    if (slots_.size() + 1 >= (1u << kGpuHandleIndexBits)) {
+      return kInvalidGpuHandle;
+    }
+    index = slots_.size();
+    slots_.emplace_back();
+  }
+  Slot& slot = slots_[index];
+  slot.resource.type = type;
+  slot.resource.id = id;
+  slot.alive = true;
+  ++statistics_.num_handles;
+  return (slot.generation << kGpuHandleIndexBits) | index;
+}
+
+GLuint GpuResources::Lookup(const GpuHandle handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!IsAliveLocked(handle)) {
+    ++statistics_.num_stale_lookups;
+    return 0;
+  }
+  return slots_[Index(handle)].resource.id;
+}
+
+bool GpuResources::IsAlive(const GpuHandle handle) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return IsAliveLocked(handle);
+}
+
+void GpuResources::Destroy(const GpuHandle handle) {
+  Resource resource;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!IsAliveLocked(handle)) return;
+    const uint32_t index = Index(handle);
+    Slot& slot = slots_[index];
+    resource = slot.resource;
+    slot.resource.id = 0;
+    slot.alive = false;
+    // The generation wraps around within its bits.
+    slot.generation =
+        (slot.generation + 1) & ((1u << (32 - kGpuHandleIndexBits)) - 1);
+    free_slots_.push_back(index);
+    --statistics_.num_handles;
+  }
+  Retire(resource.type, resource.id);
+}
+
+void GpuResources::Retire(const GpuResourceType type, const GLuint id) {
+  if (id == 0) return;
+  const Resource resource = {type, id};
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (deferred_) {
+      retired_.push_back(resource);
+      ++statistics_.num_pending_deletions;
+      statistics_.peak_pending_deletions =
+          std::max(statistics_.peak_pending_deletions,
+                   statistics_.num_pending_deletions);
+      return;
+    }
+  }
+  Delete(std::vector<Resource>(1, resource));
+}
+
+void GpuResources::EndFrame() {
+  std::vector<Resource> completed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // The fence follows the commands of the frame, which include every use
+    // of the objects retired during it.
+    if (!retired_.empty()) {
+      retired_frames_.emplace_back();
+      retired_frames_.back().fence =
+          glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      retired_frames_.back().resources.swap(retired_);
+    }
+    // The fences are passed in order, so the first one not passed yet ends
+    // the frames to delete.
+    while (!retired_frames_.empty()) {
+      RetiredFrame& frame = retired_frames_.front();
+      if (glClientWaitSync(frame.fence, 0, 0) == GL_TIMEOUT_EXPIRED) break;
+      glDeleteSync(frame.fence);
+      completed.insert(completed.end(), frame.resources.begin(),
+                       frame.resources.end());
+      retired_frames_.pop_front();
+    }
+    statistics_.num_pending_deletions -= completed.size();
+  }
+  Delete(completed);
+}
+
+void GpuResources::Flush() {
+  std::vector<Resource> resources;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (RetiredFrame& frame : retired_frames_) {
+      GLenum status;
+      do {
+        status = glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                  kFenceTimeout);
+      } while (status == GL_TIMEOUT_EXPIRED);
+      glDeleteSync(frame.fence);
+      resources.insert(resources.end(), frame.resources.begin(),
+                       frame.resources.end());
+    }
+    retired_frames_.clear();
+    // The objects retired during this frame are only used by commands
+    // submitted already, which glFinish() completes.
+    if (!retired_.empty()) {
+      glFinish();
+      resources.insert(resources.end(), retired_.begin(), retired_.end());
+      retired_.clear();
+    }
+    statistics_.num_pending_deletions = 0;
+  }
+  Delete(resources);
+}
+
+void GpuResources::set_deferred(const bool deferred) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  deferred_ = deferred;
+}
+
+bool GpuResources::deferred() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return deferred_;
+}
+
+GpuResourceStatistics GpuResources::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+bool GpuResources::IsAliveLocked(const GpuHandle handle) const {
+  const uint32_t index = Index(handle);
+  return handle != kInvalidGpuHandle && index < slots_.size() &&
+      slots_[index].alive &&
+      slots_[index].generation == handle >> kGpuHandleIndexBits;
+}
+
+void GpuResources::Delete(const std::vector<Resource>& resources) {
+  if (resources.empty()) return;
+  GlStateCache* gl_state = GlStateCache::Current();
+  int64_t num_deleted[NUM_GPU_RESOURCE_TYPES] = {0};
+  for (const Resource& resource : resources) {
+    switch (resource.type) {
+      case GPU_BUFFER:
+        gl_state->DeleteBuffers(1, &resource.id);
+        break;
+      case GPU_VERTEX_ARRAY:
+        gl_state->DeleteVertexArrays(1, &resource.id);
+        break;
+      case GPU_PROGRAM:
+        gl_state->DeleteProgram(resource.id);
+        break;
+      case GPU_TEXTURE:
+        glDeleteTextures(1, &resource.id);
+        break;
+      default:
+        continue;
+    }
+    ++num_deleted[resource.type];
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int type = 0; type < NUM_GPU_RESOURCE_TYPES; ++type) {
+    statistics_.num_deleted[type] += num_deleted[type];
+  }
+}
+
+}  // namespace wvu
@@ -0,0 +1,199 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_GPU_RESOURCES_H_
+#define GLUTILS_GPU_RESOURCES_H_
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+// The kinds of OpenGL objects deleted by GpuResources.
+enum GpuResourceType {
+  GPU_BUFFER = 0,
+  // Vertex arrays are not shared between contexts, so they must be retired
+  // and deleted on the context that created them.
+  GPU_VERTEX_ARRAY,
+  GPU_PROGRAM,
+  GPU_TEXTURE,
+  NUM_GPU_RESOURCE_TYPES
+};
+
+// A handle of an OpenGL object: an index in the low kGpuHandleIndexBits bits,
+// and a generation in the others, so that the handles of destroyed objects
+// resolve to 0 even when their index, or their OpenGL id, is reused.
+typedef uint32_t GpuHandle;
+constexpr int kGpuHandleIndexBits = 24;
+constexpr GpuHandle kInvalidGpuHandle = 0xFFFFFFFF;
+
+// Counters of GpuResources.
+struct GpuResourceStatistics {
+  // The handles alive.
+  int num_handles = 0;
+  // The objects retired but not deleted yet, because the GPU may still run
+  // the frames using them.
+  int num_pending_deletions = 0;
+  // Maximum of num_pending_deletions since the start.
+  int peak_pending_deletions = 0;
+  // The objects deleted, per type.
+  int64_t num_deleted[NUM_GPU_RESOURCE_TYPES] = {0};
+  // The lookups of handles destroyed already.
+  int64_t num_stale_lookups = 0;
+};
+
+// This class owns the deletion of the OpenGL objects of the library. Retire()
+// queues an object instead of deleting it: the objects retired during a frame
+// are fenced by EndFrame(), and deleted by a later EndFrame() once the GPU has
+// passed the fence, so the driver never deletes an object that commands in
+// flight still use, nor stalls to wait for them. BufferAllocator, GpuMesh,
+// ShaderProgram and TextureManager retire their objects here. Deferral is off
+// by default, in which case Retire() deletes at once, as OpenGL would.
+//
+// The objects may also be referred to by generational handles instead of
+// their ids: Destroy() retires the object and invalidates its handle, so that
+// the holders of stale copies of the handle look up 0 instead of an object
+// that reused the id, or one that was deleted.
+//
+// Retire() and the handles may be used from any thread. EndFrame() and Flush()
+// run on the render thread, whose context deletes the objects.
+//
+// Example:
+//
+// wvu::GpuResources* resources = wvu::GpuResources::Get();
+// resources->set_deferred(true);
+// const wvu::GpuHandle texture =
+//     resources->Register(wvu::GPU_TEXTURE, texture_id);
+// while (...) {  // Rendering loop.
+//   glBindTexture(GL_TEXTURE_2D, resources->Lookup(texture));
+//   ...  // Draws.
+//   glfwSwapBuffers(window);
+//   resources->EndFrame();
+// }
+// resources->Destroy(texture);
+// resources->Flush();
+class GpuResources {
+ public:
+  GpuResources();
+  ~GpuResources() {}
+
+  // Returns the resources of the process.
+  static GpuResources* Get();
+
+  // Returns a handle of the object id of a type, or kInvalidGpuHandle if all
+  // the indices are in use.
+  GpuHandle Register(const GpuResourceType type, const GLuint id);
+
+  // Returns the id of the object of a handle, or 0 if the handle was
+  // destroyed.
+  GLuint Lookup(const GpuHandle handle);
+
+  // Returns true if the handle was registered and not destroyed.
+  bool IsAlive(const GpuHandle handle) const;
+
+  // Retires the object of a handle, and invalidates the handle. Does nothing
+  // if the handle is not alive.
+  void Destroy(const GpuHandle handle);
+
+  // Deletes the object id of a type once the GPU has finished the frames
+  // submitted so far, or at once if deferral is off. Does nothing if the id
+  // is 0.
+  void Retire(const GpuResourceType type, const GLuint id);
+
+  // Fences the objects retired since the last call, and deletes the objects
+  // whose fence the GPU has passed, without waiting. Call once per frame,
+  // after its commands are submitted, e.g., after swapping the buffers.
+  void EndFrame();
+
+  // Waits for the GPU, and deletes all the objects retired, e.g., before the
+  // context is destroyed.
+  void Flush();
+
+  // Sets whether Retire() defers the deletions. Turning the deferral off
+  // does not delete the objects already retired, see Flush().
+  void set_deferred(const bool deferred);
+
+  bool deferred() const;
+
+  GpuResourceStatistics statistics() const;
+
+ private:
+  struct Resource {
+    GpuResourceType type;
+    GLuint id;
+  };
+
+  // The objects retired during a frame, deleted once the GPU passed fence.
+  struct RetiredFrame {
+    GLsync fence = nullptr;
+    std::vector<Resource> resources;
+  };
+
+  struct Slot {
+    Resource resource = {GPU_BUFFER, 0};
+    uint32_t generation = 0;
+    bool alive = false;
+  };
+
+  static uint32_t Index(const GpuHandle handle) {
+    return handle & ((1u << kGpuHandleIndexBits) - 1);
+  }
+
+  // Returns true if the handle refers to a live slot. The mutex must be held.
+  bool IsAliveLocked(const GpuHandle handle) const;
+
+  // Deletes the objects through the state cache of the calling thread, and
+  // counts them.
+  void Delete(const std::vector<Resource>& resources);
+
+  mutable std::mutex mutex_;
+  bool deferred_;
+  std::vector<Slot> slots_;
+  std::vector<uint32_t> free_slots_;
+  // The objects retired since the last EndFrame().
+  std::vector<Resource> retired_;
+  // The fenced frames, oldest first.
+  std::deque<RetiredFrame> retired_frames_;
+  GpuResourceStatistics statistics_;
+
+  GpuResources(const GpuResources&) = delete;
+  GpuResources& operator=(const GpuResources&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_GPU_RESOURCES_H_
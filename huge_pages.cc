@@ -0,0 +1,177 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "huge_pages.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/resource.h>
+#define WVU_HAS_MMAP
+#endif
+
+namespace wvu {
+namespace {
+std::atomic<int> process_huge_page_mode(HUGE_PAGES_OFF);
+std::atomic<int64_t> num_explicit_bytes(0);
+std::atomic<int64_t> num_transparent_bytes(0);
+std::atomic<int64_t> num_fallbacks(0);
+
+size_t RoundUp(const size_t value, const size_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+#ifdef WVU_HAS_MMAP
+// Maps size bytes aligned to kHugePageSize, which the transparent huge pages
+// need, by mapping a huge page more and unmapping the ends. Returns nullptr
+// if the mapping fails.
+void* MapAlignedPages(const size_t size) {
+  const size_t padded_size = size + kHugePageSize;
+  void* mapping = mmap(nullptr, padded_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) return nullptr;
+  char* begin = static_cast<char*>(mapping);
+  char* aligned = reinterpret_cast<char*>(
+      RoundUp(reinterpret_cast<uintptr_t>(begin), kHugePageSize));
+  if (aligned > begin) munmap(begin, aligned - begin);
+  char* end = begin + padded_size;
+  if (end > aligned + size) munmap(aligned + size, end - aligned - size);
+  return aligned;
+}
+#endif  // WVU_HAS_MMAP
+
+}  // namespace
+
+bool ParseHugePageMode(const std::string& name, HugePageMode* mode) {
+  if (name == "off") {
+    *mode = HUGE_PAGES_OFF;
+  } else if (name == "transparent") {
+    *mode = HUGE_PAGES_TRANSPARENT;
+  } else if (name == "explicit") {
+    *mode = HUGE_PAGES_EXPLICIT;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void SetHugePageMode(const HugePageMode mode) {
+  process_huge_page_mode = mode;
+}
+
+HugePageMode huge_page_mode() {
+  return static_cast<HugePageMode>(process_huge_page_mode.load());
+}
+
+HugePageStatistics huge_page_statistics() {
+  HugePageStatistics statistics;
+  statistics.explicit_bytes = num_explicit_bytes.load();
+  statistics.transparent_bytes = num_transparent_bytes.load();
+  statistics.num_fallbacks = num_fallbacks.load();
+  return statistics;
+}
+
+void* AllocatePages(const size_t num_bytes, size_t* mapped_bytes) {
+  *mapped_bytes = 0;
+  const HugePageMode mode = huge_page_mode();
+#ifdef WVU_HAS_MMAP
+  if (mode != HUGE_PAGES_OFF && num_bytes >= kMinHugePageBytes) {
+    const size_t size = RoundUp(num_bytes, kHugePageSize);
+#ifdef MAP_HUGETLB
+    if (mode == HUGE_PAGES_EXPLICIT) {
+      void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (mapping != MAP_FAILED) {
+        num_explicit_bytes += size;
+        *mapped_bytes = size;
+        return mapping;
+      }
+      // The pool is empty or not configured.
+      ++num_fallbacks;
+    }
+#endif  // MAP_HUGETLB
+    void* mapping = MapAlignedPages(size);
+    if (mapping != nullptr) {
+      AdviseHugePages(mapping, size);
+      *mapped_bytes = size;
+      return mapping;
+    }
+    ++num_fallbacks;
+  }
+#endif  // WVU_HAS_MMAP
+  return new char[num_bytes];
+}
+
+void FreePages(void* data, const size_t mapped_bytes) {
+  if (mapped_bytes == 0) {
+    delete[] static_cast<char*>(data);
+    return;
+  }
+#ifdef WVU_HAS_MMAP
+  munmap(data, mapped_bytes);
+#endif  // WVU_HAS_MMAP
+}
+
+bool AdviseHugePages(void* address, const size_t size) {
+  if (huge_page_mode() == HUGE_PAGES_OFF || size < kMinHugePageBytes) {
+    return false;
+  }
+#if defined(WVU_HAS_MMAP) && defined(MADV_HUGEPAGE)
+  if (madvise(address, size, MADV_HUGEPAGE) == 0) {
+    num_transparent_bytes += size;
+    return true;
+  }
+#endif
+  // The kernel has no transparent huge pages, or not for this file system.
+  ++num_fallbacks;
+  return false;
+}
+
+PageFaultCounts CurrentPageFaults() {
+  PageFaultCounts counts;
+#ifdef WVU_HAS_MMAP
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    counts.num_minor_faults = usage.ru_minflt;
+    counts.num_major_faults = usage.ru_majflt;
+  }
+#endif  // WVU_HAS_MMAP
+  return counts;
+}
+
+}  // namespace wvu
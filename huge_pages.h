@@ -0,0 +1,113 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_HUGE_PAGES_H_
+#define GLUTILS_HUGE_PAGES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace wvu {
+// Size of the huge pages the allocations are rounded and aligned to. The
+// default size of x86-64 and of most ARM64 kernels.
+constexpr size_t kHugePageSize = 2 << 20;
+
+// Smallest allocation, and mapped file, backed by huge pages. Smaller ones
+// would waste most of a huge page.
+constexpr size_t kMinHugePageBytes = 1 << 20;
+
+// How the large allocations and the mapped files are backed.
+enum HugePageMode {
+  // Regular pages.
+  HUGE_PAGES_OFF = 0,
+  // Transparent huge pages, requested with madvise(MADV_HUGEPAGE), which the
+  // kernel grants when it finds free huge pages, or later with khugepaged.
+  HUGE_PAGES_TRANSPARENT = 1,
+  // Huge pages of the reserved pool (MAP_HUGETLB, see vm.nr_hugepages),
+  // falling back to transparent ones when the pool is empty. Mapped files
+  // use transparent huge pages.
+  HUGE_PAGES_EXPLICIT = 2,
+};
+
+// Parses the names "off", "transparent" and "explicit". Returns false if the
+// name is not a mode.
+bool ParseHugePageMode(const std::string& name, HugePageMode* mode);
+
+// Sets the mode of the process, used by the FrameArena buffers and by the
+// MappedFile mappings created afterwards. The default is HUGE_PAGES_OFF.
+void SetHugePageMode(const HugePageMode mode);
+HugePageMode huge_page_mode();
+
+// Counters of the huge page requests of the process since its start.
+struct HugePageStatistics {
+  // Bytes mapped from the reserved pool.
+  int64_t explicit_bytes = 0;
+  // Bytes advised to use transparent huge pages.
+  int64_t transparent_bytes = 0;
+  // Requests that fell back to a lesser kind of page, e.g., an empty pool or
+  // a file system without transparent huge pages.
+  int64_t num_fallbacks = 0;
+};
+
+HugePageStatistics huge_page_statistics();
+
+// Allocates at least num_bytes, and sets mapped_bytes to the size to pass to
+// FreePages(). Allocations of at least kMinHugePageBytes are mapped as the
+// mode of the process asks, aligned to kHugePageSize; the others, and all of
+// them when the mode is off or pages cannot be mapped, come from operator new,
+// with a mapped_bytes of 0. Never returns nullptr.
+void* AllocatePages(const size_t num_bytes, size_t* mapped_bytes);
+void FreePages(void* data, const size_t mapped_bytes);
+
+// Asks for transparent huge pages on a mapping, e.g., of a file, if the mode
+// of the process is not off and the mapping is large enough. Returns true if
+// the kernel accepted the advice. Failures are counted as fallbacks.
+bool AdviseHugePages(void* address, const size_t size);
+
+// The page faults of the process since its start. The minor ones mapped a
+// page already in memory, and the major ones read it from the disk.
+struct PageFaultCounts {
+  int64_t num_minor_faults = 0;
+  int64_t num_major_faults = 0;
+};
+
+// Returns the page faults of all the threads of the process, or zeros where
+// getrusage() is not available.
+PageFaultCounts CurrentPageFaults();
+
+}  // namespace wvu
+
+#endif  // GLUTILS_HUGE_PAGES_H_
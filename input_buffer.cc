@@ -0,0 +1,167 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "input_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <GLFW/glfw3.h>
+
+namespace wvu {
+namespace {
+// Returns the smallest power of two not less than value.
+uint64_t RoundUpToPowerOfTwo(const int value) {
+  uint64_t power = 1;
+  while (power < static_cast<uint64_t>(std::max(value, 1))) power <<= 1;
+  return power;
+}
+
+}  // namespace
+
+InputBuffer::InputBuffer(const int capacity)
+    : events_(RoundUpToPowerOfTwo(capacity)),
+      mask_(events_.size() - 1),
+      num_written_events_(0),
+      num_read_events_(0),
+      num_dropped_events_(0),
+      window_(nullptr) {}
+
+void InputBuffer::Attach(GLFWwindow* window) {
+  Detach();
+  window_ = window;
+  glfwSetWindowUserPointer(window_, this);
+  glfwSetKeyCallback(window_, KeyCallback);
+  glfwSetCharCallback(window_, CharacterCallback);
+  glfwSetMouseButtonCallback(window_, MouseButtonCallback);
+  glfwSetCursorPosCallback(window_, CursorPositionCallback);
+  glfwSetScrollCallback(window_, ScrollCallback);
+}
+
+void InputBuffer::Detach() {
+  if (window_ == nullptr) return;
+  glfwSetKeyCallback(window_, nullptr);
+  glfwSetCharCallback(window_, nullptr);
+  glfwSetMouseButtonCallback(window_, nullptr);
+  glfwSetCursorPosCallback(window_, nullptr);
+  glfwSetScrollCallback(window_, nullptr);
+  glfwSetWindowUserPointer(window_, nullptr);
+  window_ = nullptr;
+}
+
+int InputBuffer::Read(InputEvent* events, const int max_events) {
+  const uint64_t num_read = num_read_events_.load(std::memory_order_relaxed);
+  const uint64_t num_written =
+      num_written_events_.load(std::memory_order_acquire);
+  const int num_events = static_cast<int>(
+      std::min<uint64_t>(num_written - num_read, std::max(max_events, 0)));
+  for (int i = 0; i < num_events; ++i) {
+    events[i] = events_[(num_read + i) & mask_];
+  }
+  // The slots may be written again once the read count is published.
+  num_read_events_.store(num_read + num_events, std::memory_order_release);
+  return num_events;
+}
+
+void InputBuffer::Inject(const InputEvent& event) {
+  InputEvent injected_event = event;
+  Push(&injected_event);
+}
+
+void InputBuffer::Push(InputEvent* event) {
+  const uint64_t num_written =
+      num_written_events_.load(std::memory_order_relaxed);
+  const uint64_t num_read = num_read_events_.load(std::memory_order_acquire);
+  if (num_written - num_read == events_.size()) {
+    num_dropped_events_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  event->timestamp = glfwGetTimerValue();
+  events_[num_written & mask_] = *event;
+  num_written_events_.store(num_written + 1, std::memory_order_release);
+}
+
+void InputBuffer::KeyCallback(GLFWwindow* window,
+                              int key,
+                              int scancode,
+                              int action,
+                              int mods) {
+  InputEvent event;
+  event.type = INPUT_KEY;
+  event.code = key;
+  event.scancode = scancode;
+  event.action = action;
+  event.mods = mods;
+  static_cast<InputBuffer*>(glfwGetWindowUserPointer(window))->Push(&event);
+}
+
+void InputBuffer::CharacterCallback(GLFWwindow* window,
+                                    unsigned int codepoint) {
+  InputEvent event;
+  event.type = INPUT_CHARACTER;
+  event.code = static_cast<int>(codepoint);
+  static_cast<InputBuffer*>(glfwGetWindowUserPointer(window))->Push(&event);
+}
+
+void InputBuffer::MouseButtonCallback(GLFWwindow* window,
+                                      int button,
+                                      int action,
+                                      int mods) {
+  InputEvent event;
+  event.type = INPUT_MOUSE_BUTTON;
+  event.code = button;
+  event.action = action;
+  event.mods = mods;
+  static_cast<InputBuffer*>(glfwGetWindowUserPointer(window))->Push(&event);
+}
+
+void InputBuffer::CursorPositionCallback(GLFWwindow* window,
+                                         double x,
+                                         double y) {
+  InputEvent event;
+  event.type = INPUT_CURSOR_POSITION;
+  event.x = x;
+  event.y = y;
+  static_cast<InputBuffer*>(glfwGetWindowUserPointer(window))->Push(&event);
+}
+
+void InputBuffer::ScrollCallback(GLFWwindow* window, double x, double y) {
+  InputEvent event;
+  event.type = INPUT_SCROLL;
+  event.x = x;
+  event.y = y;
+  static_cast<InputBuffer*>(glfwGetWindowUserPointer(window))->Push(&event);
+}
+
+}  // namespace wvu
@@ -0,0 +1,160 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_INPUT_BUFFER_H_
+#define GLUTILS_INPUT_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include <GLFW/glfw3.h>
+
+namespace wvu {
+// Default number of events an InputBuffer holds before dropping new ones.
+constexpr int kDefaultInputBufferCapacity = 1024;
+
+// Kinds of the events of an InputBuffer.
+enum InputEventType {
+  INPUT_KEY = 0,
+  INPUT_CHARACTER = 1,
+  INPUT_MOUSE_BUTTON = 2,
+  INPUT_CURSOR_POSITION = 3,
+  INPUT_SCROLL = 4
+};
+
+// An input event of a window, as reported by GLFW.
+struct InputEvent {
+  InputEventType type = INPUT_KEY;
+  // Value of glfwGetTimerValue() when GLFW reported the event.
+  uint64_t timestamp = 0;
+  // The key, the mouse button or the Unicode code point of a character.
+  int code = 0;
+  // The scancode of a key.
+  int scancode = 0;
+  // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT for keys and mouse buttons.
+  int action = 0;
+  int mods = 0;
+  // The cursor position, or the scroll offsets.
+  double x = 0.0;
+  double y = 0.0;
+};
+
+// This class buffers the input events of a window instead of handling them in
+// the GLFW callbacks. The callbacks, which run inside glfwPollEvents(), only
+// append the events with a timestamp to a single producer, single consumer
+// ring buffer, and another thread, e.g., the simulation, reads them in bulk
+// without locks. The timestamps measure the latency from the event to the
+// frame or the simulation step that handles it. When the buffer is full, the
+// new events are dropped and counted. The buffer sets the window user pointer
+// of GLFW, and its key, character, mouse button, cursor position and scroll
+// callbacks.
+//
+// Example:
+//
+// wvu::InputBuffer input_buffer;
+// input_buffer.Attach(window);
+// std::vector<wvu::InputEvent> events(wvu::kDefaultInputBufferCapacity);
+// while (...) {  // Simulation loop.
+//   const int num_events = input_buffer.Read(events.data(), events.size());
+//   for (int i = 0; i < num_events; ++i) HandleEvent(events[i]);
+// }
+class InputBuffer {
+ public:
+  // Parameters:
+  //   capacity  The number of events the buffer holds, rounded up to a power
+  //     of two.
+  explicit InputBuffer(const int capacity = kDefaultInputBufferCapacity);
+  // Does not touch the window, which may be destroyed already. A window that
+  // outlives the buffer must be detached first.
+  ~InputBuffer() {}
+
+  // Buffers the events of the window. Must be called on the main thread.
+  void Attach(GLFWwindow* window);
+
+  // Restores the callbacks and the user pointer of the window to none. Must be
+  // called on the main thread.
+  void Detach();
+
+  // Appends an event of another source, e.g., a remote client, as if GLFW
+  // reported it. Must be called on the main thread, as the callbacks are.
+  void Inject(const InputEvent& event);
+
+  // Moves up to max_events of the oldest events to events. Must only be
+  // called by one thread at a time. Returns the number of events read.
+  int Read(InputEvent* events, const int max_events);
+
+  GLFWwindow* window() const {
+    return window_;
+  }
+
+  // Returns the number of events dropped because the buffer was full.
+  int64_t num_dropped_events() const {
+    return num_dropped_events_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // The GLFW callbacks, which find the buffer in the window user pointer.
+  static void KeyCallback(GLFWwindow* window,
+                          int key,
+                          int scancode,
+                          int action,
+                          int mods);
+  static void CharacterCallback(GLFWwindow* window, unsigned int codepoint);
+  static void MouseButtonCallback(GLFWwindow* window,
+                                  int button,
+                                  int action,
+                                  int mods);
+  static void CursorPositionCallback(GLFWwindow* window, double x, double y);
+  static void ScrollCallback(GLFWwindow* window, double x, double y);
+
+  // Appends an event stamped with the current time, or drops it if the buffer
+  // is full. Only called by the main thread.
+  void Push(InputEvent* event);
+
+  std::vector<InputEvent> events_;
+  const uint64_t mask_;
+  // Numbers of events written and read since the creation of the buffer. The
+  // position of an event in events_ is its number masked.
+  std::atomic<uint64_t> num_written_events_;
+  std::atomic<uint64_t> num_read_events_;
+  std::atomic<int64_t> num_dropped_events_;
+  GLFWwindow* window_;
+
+  InputBuffer(const InputBuffer&) = delete;
+  InputBuffer& operator=(const InputBuffer&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_INPUT_BUFFER_H_
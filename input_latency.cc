@@ -0,0 +1,270 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "input_latency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#if defined(__linux__)
+#define GLFW_EXPOSE_NATIVE_X11
+#define GLFW_EXPOSE_NATIVE_GLX
+#include <GLFW/glfw3native.h>
+#endif
+
+namespace wvu {
+namespace {
+// Percentile reported as the latency of the slow frames.
+constexpr double kSlowLatencyPercentile = 0.99;
+
+const char* const kStageNames[] = {
+  "handled", "simulation", "render", "swap", "gpu", "present"};
+
+#if defined(__linux__)
+// Signature of glXGetSyncValuesOML.
+typedef Bool (*GetSyncValuesOmlFunction)(Display* display,
+                                        Window drawable,
+                                        int64_t* ust,
+                                        int64_t* msc,
+                                        int64_t* sbc);
+#endif
+
+}  // namespace
+
+InputLatencyTracker::InputLatencyTracker(const int history_size)
+    : history_size_(std::max(history_size, 1)),
+      gpu_timing_supported_(false),
+      get_sync_values_(nullptr),
+      display_(nullptr),
+      drawable_(0),
+      timer_frequency_(1),
+      cpu_epoch_(0),
+      gpu_epoch_(0),
+      num_swaps_(0),
+      initial_swap_count_(0),
+      tracking_(false),
+      num_dropped_frames_(0) {
+  for (int stage = 0; stage < kNumLatencyStages; ++stage) {
+    samples_[stage].resize(history_size_);
+    num_samples_[stage] = 0;
+    next_sample_[stage] = 0;
+  }
+}
+
+InputLatencyTracker::~InputLatencyTracker() {
+  for (const Frame& frame : pending_frames_) {
+    if (frame.query != 0) free_queries_.push_back(frame.query);
+  }
+  if (!free_queries_.empty()) {
+    glDeleteQueries(free_queries_.size(), free_queries_.data());
+  }
+}
+
+void InputLatencyTracker::Initialize(GLFWwindow* window) {
+  timer_frequency_ = glfwGetTimerFrequency();
+  gpu_timing_supported_ = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+  if (gpu_timing_supported_) {
+    cpu_epoch_ = glfwGetTimerValue();
+    glGetInteger64v(GL_TIMESTAMP, &gpu_epoch_);
+  }
+#if defined(__linux__)
+  if (glfwExtensionSupported("GLX_OML_sync_control")) {
+    get_sync_values_ = glfwGetProcAddress("glXGetSyncValuesOML");
+    display_ = glfwGetX11Display();
+    drawable_ = glfwGetX11Window(window);
+  }
+#endif
+  int64_t ust;
+  if (!GetSyncValues(&ust, &initial_swap_count_)) get_sync_values_ = nullptr;
+  num_swaps_ = 0;
+}
+
+bool InputLatencyTracker::GetSyncValues(int64_t* ust,
+                                        int64_t* swap_count) const {
+#if defined(__linux__)
+  if (get_sync_values_ == nullptr) return false;
+  int64_t msc;
+  const GetSyncValuesOmlFunction get_sync_values =
+      reinterpret_cast<GetSyncValuesOmlFunction>(get_sync_values_);
+  return get_sync_values(static_cast<Display*>(display_),
+                         static_cast<Window>(drawable_),
+                         ust, &msc, swap_count) != 0;
+#else
+  return false;
+#endif
+}
+
+void InputLatencyTracker::TrackInput(const uint64_t input_timestamp) {
+  tracking_ = true;
+  std::fill(current_frame_.stage_times,
+            current_frame_.stage_times + kNumLatencyStages, 0);
+  current_frame_.input_timestamp = input_timestamp;
+  current_frame_.query = 0;
+  current_frame_.present_swap_count = 0;
+  MarkStage(LATENCY_HANDLED);
+}
+
+void InputLatencyTracker::MarkStage(const LatencyStage stage) {
+  if (!tracking_) return;
+  current_frame_.stage_times[stage] = glfwGetTimerValue();
+}
+
+void InputLatencyTracker::EndFrame() {
+  ++num_swaps_;
+  if (tracking_) {
+    tracking_ = false;
+    current_frame_.stage_times[LATENCY_SWAP] = glfwGetTimerValue();
+    if (gpu_timing_supported_) {
+      if (free_queries_.empty()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        free_queries_.push_back(query);
+      }
+      current_frame_.query = free_queries_.back();
+      free_queries_.pop_back();
+      glQueryCounter(current_frame_.query, GL_TIMESTAMP);
+    }
+    current_frame_.present_swap_count = initial_swap_count_ + num_swaps_;
+    if (static_cast<int>(pending_frames_.size()) ==
+        kMaxPendingLatencyFrames) {
+      if (pending_frames_.front().query != 0) {
+        free_queries_.push_back(pending_frames_.front().query);
+      }
+      pending_frames_.erase(pending_frames_.begin());
+      ++num_dropped_frames_;
+    }
+    pending_frames_.push_back(current_frame_);
+  }
+  CollectPendingFrames();
+}
+
+void InputLatencyTracker::CollectPendingFrames() {
+  int64_t ust = 0;
+  int64_t swap_count = 0;
+  const bool present_known = GetSyncValues(&ust, &swap_count);
+  int num_kept_frames = 0;
+  for (Frame& frame : pending_frames_) {
+    if (frame.query != 0) {
+      GLint available = GL_FALSE;
+      glGetQueryObjectiv(frame.query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (available) {
+        GLuint64 gpu_time;
+        glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &gpu_time);
+        // The GPU clock counts nanoseconds.
+        const double seconds = (static_cast<GLint64>(gpu_time) - gpu_epoch_) *
+            1e-9;
+        frame.stage_times[LATENCY_GPU] =
+            cpu_epoch_ + static_cast<int64_t>(seconds * timer_frequency_);
+        free_queries_.push_back(frame.query);
+        frame.query = 0;
+      }
+    }
+    if (present_known && frame.stage_times[LATENCY_PRESENT] == 0 &&
+        swap_count >= frame.present_swap_count) {
+      // The unadjusted system time counts microseconds.
+      frame.stage_times[LATENCY_PRESENT] =
+          static_cast<uint64_t>(ust) * timer_frequency_ / 1000000;
+    }
+    const bool complete = frame.query == 0 &&
+        (get_sync_values_ == nullptr ||
+         frame.stage_times[LATENCY_PRESENT] != 0);
+    if (complete) {
+      AddToHistory(frame);
+    } else {
+      pending_frames_[num_kept_frames++] = frame;
+    }
+  }
+  pending_frames_.resize(num_kept_frames);
+}
+
+void InputLatencyTracker::AddToHistory(const Frame& frame) {
+  for (int stage = 0; stage < kNumLatencyStages; ++stage) {
+    if (frame.stage_times[stage] == 0) continue;
+    const double latency_ms = 1000.0 *
+        (static_cast<double>(frame.stage_times[stage]) -
+         static_cast<double>(frame.input_timestamp)) / timer_frequency_;
+    samples_[stage][next_sample_[stage]] = latency_ms;
+    next_sample_[stage] = (next_sample_[stage] + 1) % history_size_;
+    num_samples_[stage] = std::min(num_samples_[stage] + 1, history_size_);
+  }
+}
+
+void InputLatencyTracker::GetStatistics(
+    std::vector<LatencyStageStatistics>* statistics) const {
+  statistics->clear();
+  std::vector<float> samples;
+  for (int stage = 0; stage < kNumLatencyStages; ++stage) {
+    if (num_samples_[stage] == 0) continue;
+    samples.assign(samples_[stage].begin(),
+                   samples_[stage].begin() + num_samples_[stage]);
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (const float sample : samples) sum += sample;
+    const int p99_index = static_cast<int>(
+        std::ceil(kSlowLatencyPercentile * samples.size())) - 1;
+    LatencyStageStatistics stage_statistics;
+    stage_statistics.stage = static_cast<LatencyStage>(stage);
+    stage_statistics.num_samples = samples.size();
+    stage_statistics.min_ms = samples.front();
+    stage_statistics.average_ms = sum / samples.size();
+    stage_statistics.p99_ms = samples[p99_index];
+    stage_statistics.max_ms = samples.back();
+    statistics->push_back(stage_statistics);
+  }
+}
+
+std::string InputLatencyTracker::Report() const {
+  std::vector<LatencyStageStatistics> statistics;
+  GetStatistics(&statistics);
+  std::ostringstream report;
+  report << std::fixed << std::setprecision(3);
+  for (const LatencyStageStatistics& stage : statistics) {
+    report << "\n  input to " << kStageNames[stage.stage]
+           << ": avg " << stage.average_ms << " ms, min " << stage.min_ms
+           << " ms, p99 " << stage.p99_ms << " ms, max " << stage.max_ms
+           << " ms over " << stage.num_samples << " frames.";
+  }
+  if (num_dropped_frames_ > 0) {
+    report << "\n  " << num_dropped_frames_ << " tracked frames dropped.";
+  }
+  return report.str();
+}
+
+}  // namespace wvu
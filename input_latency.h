@@ -0,0 +1,209 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_INPUT_LATENCY_H_
+#define GLUTILS_INPUT_LATENCY_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+namespace wvu {
+// Default number of tracked frames whose latencies are kept.
+constexpr int kDefaultLatencyHistorySize = 240;
+
+// Maximum number of tracked frames waiting for their GPU and present times.
+// Older frames are dropped.
+constexpr int kMaxPendingLatencyFrames = 8;
+
+// The stages an input event goes through until it reaches the screen.
+enum LatencyStage {
+  // The frame read the event from the input buffer and handled it.
+  LATENCY_HANDLED = 0,
+  // The next frame acquired the simulation state.
+  LATENCY_SIMULATION = 1,
+  // The frame finished recording its draws, e.g., after RenderScene().
+  LATENCY_RENDER = 2,
+  // glfwSwapBuffers() returned.
+  LATENCY_SWAP = 3,
+  // The GPU executed the commands of the frame (GL_TIMESTAMP query).
+  LATENCY_GPU = 4,
+  // The swap was presented, with GLX_OML_sync_control.
+  LATENCY_PRESENT = 5,
+  kNumLatencyStages = 6
+};
+
+// Statistics of the latency from the input events to a stage, in
+// milliseconds.
+struct LatencyStageStatistics {
+  LatencyStage stage = LATENCY_HANDLED;
+  int num_samples = 0;
+  double min_ms = 0.0;
+  double average_ms = 0.0;
+  double p99_ms = 0.0;
+  double max_ms = 0.0;
+};
+
+// This class measures the end-to-end latency of the input, from the arrival
+// of an event (see InputEvent::timestamp) to the frame that handles it, the
+// simulation state the next frame uses, the end of the draws, the return of
+// the swap, the completion of the frame on the GPU and its presentation. All
+// the times are in the clock of glfwGetTimerValue(). The GPU times come from
+// GL_TIMESTAMP queries (OpenGL 3.3 or ARB_timer_query) aligned to that clock
+// when the tracker is initialized. The present times need
+// GLX_OML_sync_control, whose clock is CLOCK_MONOTONIC on Linux like the GLFW
+// timer, and are the start of the vertical blank at which the swap was first
+// seen completed, so they are late by up to a frame. The results of the
+// frames are read without waiting, a few frames later. Only the frames that
+// handle input events are tracked.
+//
+// Example:
+//
+// wvu::InputLatencyTracker latency;
+// latency.Initialize(window);
+// while (...) {  // Rendering loop.
+//   ...  // Acquire the simulation state.
+//   latency.MarkStage(wvu::LATENCY_SIMULATION);
+//   ...  // Render the frame.
+//   latency.MarkStage(wvu::LATENCY_RENDER);
+//   glfwSwapBuffers(window);
+//   latency.EndFrame();
+//   glfwPollEvents();
+//   const int num_events = input_buffer.Read(events.data(), events.size());
+//   if (num_events > 0) latency.TrackInput(events[0].timestamp);
+//   ...  // Handle the events.
+// }
+// LOG(INFO) << latency.Report();
+class InputLatencyTracker {
+ public:
+  // Parameters:
+  //   history_size  The number of tracked frames whose latencies are kept.
+  explicit InputLatencyTracker(
+      const int history_size = kDefaultLatencyHistorySize);
+  ~InputLatencyTracker();
+
+  // Checks the support of the timer queries and of GLX_OML_sync_control. The
+  // context of the window must be current.
+  void Initialize(GLFWwindow* window);
+
+  // Starts tracking the frame that handles input events, and marks the
+  // LATENCY_HANDLED stage. The later stages are marked on the frame until the
+  // next EndFrame(). Parameters:
+  //   input_timestamp  The timestamp of the oldest event of the frame.
+  void TrackInput(const uint64_t input_timestamp);
+
+  // Marks a CPU stage of the tracked frame with the current time. Does
+  // nothing if no frame is tracked.
+  void MarkStage(const LatencyStage stage);
+
+  // Marks the LATENCY_SWAP stage, issues the GPU query of the tracked frame,
+  // and collects the GPU and present times of the previous frames that are
+  // available. Must be called right after glfwSwapBuffers().
+  void EndFrame();
+
+  // Computes the statistics of every stage measured at least once.
+  void GetStatistics(std::vector<LatencyStageStatistics>* statistics) const;
+
+  // Returns a table of the statistics of the stages.
+  std::string Report() const;
+
+  bool gpu_timing_supported() const {
+    return gpu_timing_supported_;
+  }
+
+  bool present_timing_supported() const {
+    return get_sync_values_ != nullptr;
+  }
+
+  // Returns the number of tracked frames dropped before their GPU or present
+  // times were available.
+  int num_dropped_frames() const {
+    return num_dropped_frames_;
+  }
+
+ private:
+  // A tracked frame. The stage times are 0 until they are measured.
+  struct Frame {
+    uint64_t stage_times[kNumLatencyStages];
+    uint64_t input_timestamp;
+    GLuint query;
+    // Swap buffer count at which the frame is presented.
+    int64_t present_swap_count;
+  };
+
+  // Collects the available times of the pending frames, and moves the
+  // complete frames to the history.
+  void CollectPendingFrames();
+
+  // Adds the latencies of a complete frame to the history.
+  void AddToHistory(const Frame& frame);
+
+  // Reads the swap buffer count and its vertical blank time. Returns false if
+  // not supported.
+  bool GetSyncValues(int64_t* ust, int64_t* swap_count) const;
+
+  const int history_size_;
+  bool gpu_timing_supported_;
+  // glXGetSyncValuesOML, and the X11 display and window it reads, or nullptr
+  // if not supported.
+  GLFWglproc get_sync_values_;
+  void* display_;
+  uint64_t drawable_;
+  uint64_t timer_frequency_;
+  // Clocks at the initialization, to align the GPU times to the timer.
+  uint64_t cpu_epoch_;
+  GLint64 gpu_epoch_;
+  // Swaps since the initialization, and the swap buffer count then.
+  int64_t num_swaps_;
+  int64_t initial_swap_count_;
+  bool tracking_;
+  Frame current_frame_;
+  std::vector<Frame> pending_frames_;
+  // Unused timestamp queries.
+  std::vector<GLuint> free_queries_;
+  // Latencies in milliseconds of every stage, in circular buffers.
+  std::vector<float> samples_[kNumLatencyStages];
+  int num_samples_[kNumLatencyStages];
+  int next_sample_[kNumLatencyStages];
+  int num_dropped_frames_;
+
+  InputLatencyTracker(const InputLatencyTracker&) = delete;
+  InputLatencyTracker& operator=(const InputLatencyTracker&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_INPUT_LATENCY_H_
@@ -0,0 +1,198 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "instance_buffer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "gpu_mesh.h"
+#include "ring_buffer.h"
+
+namespace wvu {
+
+InstanceBuffer::~InstanceBuffer() {
+  if (ring_buffer_ == nullptr) {
+    BufferAllocator::Get()->DeleteBuffer(&buffer_id_);
+  }
+}
+
+bool InstanceBuffer::Initialize() {
+  if (buffer_id_ == 0) {
+    buffer_id_ = BufferAllocator::Get()->CreateBuffer(VERTEX_DATA);
+  }
+  return buffer_id_ != 0;
+}
+
+bool InstanceBuffer::Initialize(RingBuffer* ring_buffer) {
+  if (buffer_id_ != 0) return ring_buffer_ == ring_buffer;
+  ring_buffer_ = ring_buffer;
+  buffer_id_ = ring_buffer->buffer_id();
+  return buffer_id_ != 0;
+}
+
+void InstanceBuffer::Attach(const GpuMesh& mesh) const {
+  Attach(mesh.vertex_array_object_id());
+}
+
+void InstanceBuffer::Attach(const GLuint vertex_array_object_id) const {
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindVertexArray(vertex_array_object_id);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, buffer_id_);
+  // A mat4 attribute is made of four vec4 attributes, one per column. Eigen
+  // stores matrices in column-major order, as GLSL expects.
+  constexpr GLsizei kStride = sizeof(Eigen::Matrix4f);
+  for (GLuint column = 0; column < 4; ++column) {
+    const GLuint location = kInstanceTransformLocation + column;
+    const GLvoid* offset = reinterpret_cast<const GLvoid*>(
+        static_cast<uintptr_t>(column * 4 * sizeof(GLfloat)));
+    glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, kStride, offset);
+    glEnableVertexAttribArray(location);
+    // Advance the attribute once per instance instead of once per vertex.
+    glVertexAttribDivisor(location, 1);
+  }
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+  gl_state->BindVertexArray(0);
+}
+
+bool InstanceBuffer::Update(const Eigen::Matrix4f* transforms,
+                            const int num_instances) {
+  if (ring_buffer_ != nullptr) {
+    GLfloat* mapped_transforms = MapTransforms(num_instances);
+    if (mapped_transforms == nullptr) return false;
+    std::memcpy(mapped_transforms, transforms,
+                num_instances * sizeof(Eigen::Matrix4f));
+    UnmapTransforms();
+    return true;
+  }
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, buffer_id_);
+  const GLsizeiptr size = num_instances * sizeof(Eigen::Matrix4f);
+  OrphanStorage(num_instances);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, size, transforms);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+  num_instances_ = num_instances;
+  return true;
+}
+
+GLfloat* InstanceBuffer::MapTransforms(const int num_instances) {
+  constexpr GLsizeiptr kTransformSize = sizeof(Eigen::Matrix4f);
+  if (ring_buffer_ != nullptr) {
+    // The range starts at a whole transform, so that it is addressed by the
+    // base instance of the draws.
+    RingBufferAllocation allocation;
+    if (!ring_buffer_->Allocate(num_instances * kTransformSize,
+                                kTransformSize, &allocation)) {
+      return nullptr;
+    }
+    base_instance_ = allocation.offset / kTransformSize;
+    num_instances_ = num_instances;
+    return static_cast<GLfloat*>(allocation.data);
+  }
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, buffer_id_);
+  OrphanStorage(num_instances);
+  // The storage was just orphaned, so the mapping does not wait for the GPU.
+  void* transforms = glMapBufferRange(
+      GL_ARRAY_BUFFER, 0, num_instances * kTransformSize,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+  num_instances_ = num_instances;
+  return static_cast<GLfloat*>(transforms);
+}
+
+void InstanceBuffer::UnmapTransforms() {
+  if (ring_buffer_ != nullptr) {
+    ring_buffer_->Flush();
+    return;
+  }
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, buffer_id_);
+  glUnmapBuffer(GL_ARRAY_BUFFER);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::OrphanStorage(const int num_instances) {
+  if (num_instances > capacity_) {
+    // Grow geometrically to amortize the reallocations.
+    capacity_ = std::max(num_instances, 2 * capacity_);
+  }
+  // Reallocating the storage orphans the previous one, so the driver does not
+  // wait for pending draws reading it.
+  BufferAllocator::Get()->BufferData(buffer_id_, GL_ARRAY_BUFFER,
+                                     capacity_ * sizeof(Eigen::Matrix4f),
+                                     nullptr, GL_STREAM_DRAW);
+}
+
+void DrawInstanced(const GpuMesh& mesh, const int num_instances) {
+  DrawRangeInstanced(mesh, 0, mesh.num_indices(), num_instances);
+}
+
+void DrawInstanced(const GpuMesh& mesh, const InstanceBuffer& instances) {
+  DrawRangeInstanced(mesh, 0, mesh.num_indices(), instances.num_instances(),
+                     instances.base_instance());
+}
+
+void DrawRangeInstanced(const GpuMesh& mesh,
+                        const int first_index,
+                        const int num_indices,
+                        const int num_instances) {
+  DrawRangeInstanced(mesh, first_index, num_indices, num_instances, 0);
+}
+
+void DrawRangeInstanced(const GpuMesh& mesh,
+                        const int first_index,
+                        const int num_indices,
+                        const int num_instances,
+                        const int base_instance) {
+  if (num_instances <= 0) return;
+  GlStateCache::Current()->BindVertexArray(mesh.vertex_array_object_id());
+  const GLvoid* offset = reinterpret_cast<const GLvoid*>(
+      static_cast<uintptr_t>(first_index) * IndexSize(mesh.index_type()));
+  if (base_instance == 0) {
+    glDrawElementsInstanced(mesh.primitive_type(), num_indices,
+                            mesh.index_type(), offset, num_instances);
+  } else {
+    glDrawElementsInstancedBaseInstance(mesh.primitive_type(), num_indices,
+                                        mesh.index_type(), offset,
+                                        num_instances, base_instance);
+  }
+}
+
+}  // namespace wvu
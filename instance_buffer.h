@@ -0,0 +1,192 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_INSTANCE_BUFFER_H_
+#define GLUTILS_INSTANCE_BUFFER_H_
+
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include "gpu_mesh.h"
+#include "ring_buffer.h"
+
+namespace wvu {
+// First attribute location of the per-instance model matrix. A mat4 attribute
+// takes four consecutive locations, one per column:
+//   layout (location = 12) in mat4 instance_model;
+// The locations after the vertex semantics are left free for other per-vertex
+// attributes.
+constexpr GLuint kInstanceTransformLocation = 12;
+
+// Contiguous array of instance transforms. Eigen requires an aligned allocator
+// for the vectorizable Matrix4f.
+typedef std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f>>
+    InstanceTransforms;
+
+// A transform in the memory returned by InstanceBuffer::MapTransforms(), which
+// is aligned to at least 16 bytes, e.g.,
+//   wvu::MappedTransform(transforms + 16 * i) = view * model;
+typedef Eigen::Map<Eigen::Matrix4f, Eigen::Aligned16> MappedTransform;
+
+// This class holds the model matrices of the instances of a mesh in a vertex
+// buffer read with an attribute divisor of 1, so that many copies of a mesh
+// are drawn with a single glDrawElementsInstanced() call instead of one draw
+// and one uniform upload per copy.
+//
+// Example:
+//
+// wvu::InstanceBuffer instances;
+// instances.Initialize();
+// instances.Attach(mesh);
+// while (...) {  // Rendering loop.
+//   instances.Update(transforms.data(), transforms.size());
+//   shader_program.Use();
+//   wvu::DrawInstanced(mesh, instances);
+// }
+//
+// The transforms computed every frame are best written in place instead, into
+// the memory the GPU reads, which saves the copy of Update():
+//
+// GLfloat* transforms = instances.MapTransforms(num_instances);
+// for (int i = 0; i < num_instances; ++i) {
+//   wvu::MappedTransform(transforms + 16 * i) = ...;
+// }
+// instances.UnmapTransforms();
+//
+// When initialized with a RingBuffer, the transforms of every frame are
+// written into the section of the frame of the ring buffer, and the draws
+// start reading at the base instance of that range (OpenGL 4.2 or
+// ARB_base_instance), so the vertex array object does not change.
+class InstanceBuffer {
+ public:
+  InstanceBuffer()
+      : buffer_id_(0), capacity_(0), num_instances_(0), base_instance_(0),
+        ring_buffer_(nullptr) {}
+  ~InstanceBuffer();
+
+  // Creates the buffer. Returns true if successful.
+  bool Initialize();
+
+  // Streams the transforms through the ring buffer instead of a dedicated
+  // buffer. Returns true if successful.
+  // Parameters:
+  //   ring_buffer  The ring buffer of the frame data. Not owned.
+  bool Initialize(RingBuffer* ring_buffer);
+
+  // Adds the per-instance model matrix attribute to the vertex array object of
+  // the mesh. A buffer may be attached to several meshes.
+  void Attach(const GpuMesh& mesh) const;
+
+  // Adds the per-instance model matrix attribute to a vertex array object,
+  // e.g., the one of a MeshBatch. The base instance of indirect draws offsets
+  // the instance read by each draw.
+  void Attach(const GLuint vertex_array_object_id) const;
+
+  // Uploads the transforms of the instances. The buffer grows when needed;
+  // otherwise the storage is orphaned and refilled, so the upload does not wait
+  // for draws still reading the previous transforms. Returns false if the
+  // section of the ring buffer is full.
+  // Parameters:
+  //   transforms  An array of num_instances model matrices.
+  //   num_instances  The number of instances.
+  bool Update(const Eigen::Matrix4f* transforms, const int num_instances);
+
+  // Maps num_instances transforms for writing and returns them, 16 floats
+  // each in column-major order, or nullptr if the section of the ring buffer
+  // is full. The transforms are allocated in the section of the frame of the
+  // ring buffer, which is persistently mapped if supported, or in the orphaned
+  // storage of the buffer. They must all be written, and UnmapTransforms()
+  // called, before the draws. num_instances must be positive.
+  GLfloat* MapTransforms(const int num_instances);
+
+  // Ends the writes into the transforms returned by MapTransforms().
+  void UnmapTransforms();
+
+  GLuint buffer_id() const {
+    return buffer_id_;
+  }
+
+  int num_instances() const {
+    return num_instances_;
+  }
+
+  // Returns the index of the first transform of the last update in the
+  // buffer, which is 0 unless the transforms are streamed.
+  int base_instance() const {
+    return base_instance_;
+  }
+
+ private:
+  // Reallocates the storage of the buffer bound to GL_ARRAY_BUFFER, growing
+  // it to hold at least num_instances transforms.
+  void OrphanStorage(const int num_instances);
+
+  GLuint buffer_id_;
+  // Number of transforms the buffer storage can hold.
+  int capacity_;
+  int num_instances_;
+  int base_instance_;
+  // Ring buffer streaming the transforms, or nullptr. Not owned.
+  RingBuffer* ring_buffer_;
+
+  InstanceBuffer(const InstanceBuffer&) = delete;
+  InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+};
+
+// Draws num_instances instances of the mesh.
+void DrawInstanced(const GpuMesh& mesh, const int num_instances);
+
+// Draws the instances of the last update of the buffer, which must be attached
+// to the mesh.
+void DrawInstanced(const GpuMesh& mesh, const InstanceBuffer& instances);
+
+// Draws num_instances instances of a range of the mesh indices.
+void DrawRangeInstanced(const GpuMesh& mesh,
+                        const int first_index,
+                        const int num_indices,
+                        const int num_instances);
+
+// Draws num_instances instances of a range of the mesh indices, reading the
+// instance attributes from base_instance on.
+void DrawRangeInstanced(const GpuMesh& mesh,
+                        const int first_index,
+                        const int num_indices,
+                        const int num_instances,
+                        const int base_instance);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_INSTANCE_BUFFER_H_
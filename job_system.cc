@@ -0,0 +1,326 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "frame_arena.h"
+#include "thread_placement.h"
+
+namespace wvu {
+namespace {
+// Number of failed searches for a job before a worker sleeps.
+constexpr int kNumSpinsBeforeSleep = 64;
+
+// The system and the index of the worker running on this thread.
+struct WorkerIdentity {
+  const JobSystem* job_system;
+  int thread_index;
+};
+
+thread_local WorkerIdentity current_worker = {nullptr, 0};
+
+}  // namespace
+
+bool JobSystem::JobDeque::Push(Job* job) {
+  const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+  const int64_t top = top_.load(std::memory_order_acquire);
+  if (bottom - top >= kJobDequeCapacity) return false;
+  jobs_[bottom % kJobDequeCapacity].store(job, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom_.store(bottom + 1, std::memory_order_relaxed);
+  return true;
+}
+
+JobSystem::Job* JobSystem::JobDeque::Pop() {
+  const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+  bottom_.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t top = top_.load(std::memory_order_relaxed);
+  if (top > bottom) {
+    // Empty.
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  Job* job = jobs_[bottom % kJobDequeCapacity].load(std::memory_order_relaxed);
+  if (top == bottom) {
+    // The last job: race the thieves for it.
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      job = nullptr;
+    }
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+JobSystem::Job* JobSystem::JobDeque::Steal() {
+  int64_t top = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const int64_t bottom = bottom_.load(std::memory_order_acquire);
+  if (top >= bottom) return nullptr;
+  Job* job = jobs_[top % kJobDequeCapacity].load(std::memory_order_acquire);
+  if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    // Another thread took it.
+    return nullptr;
+  }
+  return job;
+}
+
+JobSystem::JobSystem(const int num_threads,
+                     const std::vector<int>& worker_cpus)
+    : worker_cpus_(worker_cpus),
+      num_started_workers_(0),
+      num_unpinned_workers_(0),
+      num_queued_jobs_(0),
+      num_sleeping_workers_(0),
+      stop_(false),
+      num_jobs_(0),
+      num_stolen_jobs_(0),
+      busy_nanoseconds_(0) {
+  int num_deques = num_threads;
+  if (num_deques <= 0) {
+    num_deques = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+  for (int i = 0; i < num_deques; ++i) {
+    deques_.emplace_back(new JobDeque);
+    thread_counters_.emplace_back(new ThreadCounters);
+  }
+  // The workers allocate their own arenas.
+  arenas_.resize(num_deques);
+  arenas_[0].reset(new FrameArena(kDefaultJobArenaCapacity));
+  for (int i = 1; i < num_deques; ++i) {
+    workers_.emplace_back(&JobSystem::RunWorker, this, i);
+  }
+  while (num_started_workers_.load(std::memory_order_acquire) <
+         num_deques - 1) {
+    std::this_thread::yield();
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  wake_condition_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void JobSystem::Run(std::function<void()> function, JobCounter* counter) {
+  const int thread_index = CurrentThreadIndex();
+  Job* job = new Job{std::move(function), counter, thread_index};
+  if (counter != nullptr) {
+    counter->num_unfinished_jobs_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (!deques_[thread_index]->Push(job)) {
+    Execute(job, thread_index);
+    return;
+  }
+  num_queued_jobs_.fetch_add(1);
+  // Sleeping workers register before checking for queued jobs, so either they
+  // see the job or this sees them.
+  if (num_sleeping_workers_.load() > 0) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    wake_condition_.notify_one();
+  }
+}
+
+void JobSystem::Wait(const JobCounter& counter) {
+  const int thread_index = CurrentThreadIndex();
+  while (!counter.done()) {
+    Job* job = FindJob(thread_index);
+    if (job != nullptr) {
+      Execute(job, thread_index);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::ParallelFor(const int num_elements,
+                            const int grain_size,
+                            const std::function<void(int, int)>& function) {
+  const int range_size = std::max(grain_size, 1);
+  if (num_elements <= range_size) {
+    if (num_elements > 0) function(0, num_elements);
+    return;
+  }
+  JobCounter counter;
+  // The calling thread runs the last range itself.
+  int begin = 0;
+  for (; begin + range_size < num_elements; begin += range_size) {
+    const int end = begin + range_size;
+    Run([&function, begin, end]() { function(begin, end); }, &counter);
+  }
+  function(begin, num_elements);
+  Wait(counter);
+}
+
+void JobSystem::BeginFrame() {
+  num_jobs_ = 0;
+  num_stolen_jobs_ = 0;
+  busy_nanoseconds_ = 0;
+  for (const std::unique_ptr<ThreadCounters>& counters : thread_counters_) {
+    counters->num_jobs.store(0, std::memory_order_relaxed);
+    counters->busy_nanoseconds.store(0, std::memory_order_relaxed);
+    counters->num_migrations.store(0, std::memory_order_relaxed);
+  }
+  for (const std::unique_ptr<FrameArena>& arena : arenas_) arena->BeginFrame();
+}
+
+JobSystemStatistics JobSystem::statistics() const {
+  JobSystemStatistics statistics;
+  statistics.num_jobs = num_jobs_.load();
+  statistics.num_stolen_jobs = num_stolen_jobs_.load();
+  statistics.busy_ms = busy_nanoseconds_.load() * 1e-6;
+  return statistics;
+}
+
+void JobSystem::GetThreadStatistics(
+    std::vector<JobThreadStatistics>* statistics) const {
+  statistics->resize(thread_counters_.size());
+  for (size_t i = 0; i < thread_counters_.size(); ++i) {
+    const ThreadCounters& counters = *thread_counters_[i];
+    JobThreadStatistics& thread_statistics = (*statistics)[i];
+    thread_statistics.cpu = counters.cpu.load(std::memory_order_relaxed);
+    thread_statistics.num_jobs =
+        counters.num_jobs.load(std::memory_order_relaxed);
+    thread_statistics.busy_ms =
+        counters.busy_nanoseconds.load(std::memory_order_relaxed) * 1e-6;
+    thread_statistics.num_migrations =
+        counters.num_migrations.load(std::memory_order_relaxed);
+  }
+}
+
+void JobSystem::RunWorker(const int thread_index) {
+  current_worker.job_system = this;
+  current_worker.thread_index = thread_index;
+  // Pin the thread before its arena, whose pages are then placed on the node
+  // of the thread when it first writes them.
+  if (!worker_cpus_.empty()) {
+    std::string error_info_log;
+    const int cpu = worker_cpus_[(thread_index - 1) % worker_cpus_.size()];
+    if (!PinCurrentThread(std::vector<int>(1, cpu), &error_info_log)) {
+      num_unpinned_workers_.fetch_add(1);
+    }
+  }
+  arenas_[thread_index].reset(new FrameArena(kDefaultJobArenaCapacity));
+  num_started_workers_.fetch_add(1, std::memory_order_release);
+  int num_spins = 0;
+  while (!stop_) {
+    Job* job = FindJob(thread_index);
+    if (job != nullptr) {
+      Execute(job, thread_index);
+      num_spins = 0;
+      continue;
+    }
+    if (++num_spins < kNumSpinsBeforeSleep) {
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    num_sleeping_workers_.fetch_add(1);
+    wake_condition_.wait(lock, [this]() {
+      return stop_ || num_queued_jobs_.load() > 0;
+    });
+    num_sleeping_workers_.fetch_sub(1);
+    num_spins = 0;
+  }
+}
+
+JobSystem::Job* JobSystem::FindJob(const int thread_index) {
+  Job* job = deques_[thread_index]->Pop();
+  // Steal from the other threads, starting with the next one so that the
+  // thieves spread over the deques.
+  const int num_deques = deques_.size();
+  for (int i = 1; job == nullptr && i < num_deques; ++i) {
+    job = deques_[(thread_index + i) % num_deques]->Steal();
+  }
+  if (job != nullptr) num_queued_jobs_.fetch_sub(1);
+  return job;
+}
+
+void JobSystem::Execute(Job* job, const int thread_index) {
+  const std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  job->function();
+  const std::chrono::nanoseconds duration =
+      std::chrono::steady_clock::now() - begin;
+  busy_nanoseconds_.fetch_add(duration.count(), std::memory_order_relaxed);
+  num_jobs_.fetch_add(1, std::memory_order_relaxed);
+  // Only this thread writes its counters, so they need no read-modify-write.
+  ThreadCounters& counters = *thread_counters_[thread_index];
+  const int cpu = CurrentCpu();
+  const int previous_cpu = counters.cpu.load(std::memory_order_relaxed);
+  if (previous_cpu >= 0 && cpu != previous_cpu) {
+    counters.num_migrations.store(
+        counters.num_migrations.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+  }
+  counters.cpu.store(cpu, std::memory_order_relaxed);
+  counters.num_jobs.store(
+      counters.num_jobs.load(std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+  counters.busy_nanoseconds.store(
+      counters.busy_nanoseconds.load(std::memory_order_relaxed) +
+      duration.count(), std::memory_order_relaxed);
+  if (job->submitting_thread != thread_index) {
+    num_stolen_jobs_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (job->counter != nullptr) {
+    job->counter->num_unfinished_jobs_.fetch_sub(1, std::memory_order_release);
+  }
+  delete job;
+}
+
+int JobSystem::CurrentThreadIndex() const {
+  return current_worker.job_system == this ? current_worker.thread_index : 0;
+}
+
+}  // namespace wvu
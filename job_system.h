@@ -0,0 +1,270 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_JOB_SYSTEM_H_
+#define GLUTILS_JOB_SYSTEM_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_arena.h"
+
+namespace wvu {
+// Capacity of the job deque of each thread. Jobs submitted to a full deque run
+// immediately on the submitting thread.
+constexpr int kJobDequeCapacity = 4096;
+
+// Initial capacity in bytes of the buffers of the FrameArena of each thread.
+constexpr size_t kDefaultJobArenaCapacity = 64 * 1024;
+
+// Counts the unfinished jobs of a group. Jobs increment the counter when they
+// are submitted and decrement it when they finish, so a job depending on a
+// group waits for its counter to reach zero (see JobSystem::Wait()).
+class JobCounter {
+ public:
+  JobCounter() : num_unfinished_jobs_(0) {}
+  ~JobCounter() {}
+
+  bool done() const {
+    return num_unfinished_jobs_.load(std::memory_order_acquire) == 0;
+  }
+
+ private:
+  friend class JobSystem;
+
+  std::atomic<int> num_unfinished_jobs_;
+
+  JobCounter(const JobCounter&) = delete;
+  JobCounter& operator=(const JobCounter&) = delete;
+};
+
+// Counters of the jobs run since the last call to JobSystem::BeginFrame().
+struct JobSystemStatistics {
+  int64_t num_jobs = 0;
+  // Jobs run by a thread other than the one that submitted them.
+  int64_t num_stolen_jobs = 0;
+  // Time spent running jobs, summed over the threads.
+  double busy_ms = 0.0;
+};
+
+// Counters of a thread of a JobSystem since the last call to
+// JobSystem::BeginFrame(). The busy time over the frame time is the
+// utilization of the thread.
+struct JobThreadStatistics {
+  // The CPU of the last job of the thread, or -1 before its first job.
+  int cpu = -1;
+  int64_t num_jobs = 0;
+  double busy_ms = 0.0;
+  // Jobs that ran on another CPU than the previous job of the thread.
+  int64_t num_migrations = 0;
+};
+
+// This class runs jobs on a pool of worker threads. Every thread has a
+// Chase-Lev deque: the thread pushes and pops its jobs at the bottom, without
+// locks, and idle threads steal the oldest jobs from the top of the deques of
+// the others, so the load balances itself without a shared queue. Jobs are
+// plain functions rather than fibers: a thread waiting for a counter runs
+// other jobs until the counter reaches zero, which also lets jobs submit and
+// wait for jobs of their own.
+// Jobs may only be submitted by the thread that created the system and by the
+// jobs themselves.
+//
+// The workers may be pinned to CPUs, e.g., those of the NUMA node of the main
+// thread (see thread_placement.h), so that the scheduler does not migrate
+// them. Each thread owns a FrameArena for the transient data of its jobs,
+// which the worker allocates itself once pinned, so that the first touch of
+// its pages places them on the node of the worker.
+//
+// Example:
+//
+// wvu::JobSystem job_system;
+// job_system.ParallelFor(models.data(), models.size(), 64,
+//                        [](wvu::Model* begin, wvu::Model* end) {
+//   for (wvu::Model* model = begin; model != end; ++model) {
+//     model->model_matrix();
+//   }
+// });
+class JobSystem {
+ public:
+  // Parameters:
+  //   num_threads  The number of threads running jobs, including the creating
+  //     thread. Zero uses one thread per hardware thread.
+  //   worker_cpus  The CPU of each worker, i.e., of the threads but the
+  //     creating one, repeated if too short. Empty leaves the workers to the
+  //     scheduler.
+  explicit JobSystem(const int num_threads = 0,
+                     const std::vector<int>& worker_cpus = std::vector<int>());
+  ~JobSystem();
+
+  // Submits a job. The counter, if not nullptr, is incremented now and
+  // decremented when the job finished.
+  void Run(std::function<void()> function, JobCounter* counter);
+
+  // Runs jobs until the counter reaches zero.
+  void Wait(const JobCounter& counter);
+
+  // Calls function(begin, end) on contiguous ranges of at most grain_size
+  // elements covering [0, num_elements), in parallel, and returns when all of
+  // them finished.
+  void ParallelFor(const int num_elements,
+                   const int grain_size,
+                   const std::function<void(int, int)>& function);
+
+  // Calls function(begin, end) on contiguous ranges of an array, e.g., of
+  // models or instance transforms.
+  template <typename ElementType>
+  void ParallelFor(ElementType* elements,
+                   const int num_elements,
+                   const int grain_size,
+                   const std::function<void(ElementType*, ElementType*)>&
+                       function) {
+    ParallelFor(num_elements, grain_size,
+                [elements, &function](const int begin, const int end) {
+      function(elements + begin, elements + end);
+    });
+  }
+
+  // Restarts the statistics, and starts a frame in the arenas of the threads,
+  // e.g., at the start of a frame. Must not be called while jobs run.
+  void BeginFrame();
+
+  // Returns the statistics since the last call to BeginFrame().
+  JobSystemStatistics statistics() const;
+
+  // Returns the statistics of each thread since the last call to BeginFrame(),
+  // indexed like CurrentThreadIndex().
+  void GetThreadStatistics(std::vector<JobThreadStatistics>* statistics) const;
+
+  // Returns the FrameArena of the calling thread, e.g., for the transient data
+  // of a job. Its allocations remain valid until BeginFrame() is called twice.
+  FrameArena* thread_arena() {
+    return arenas_[CurrentThreadIndex()].get();
+  }
+
+  // Returns the number of workers that could not be pinned to their CPU.
+  int num_unpinned_workers() const {
+    return num_unpinned_workers_.load();
+  }
+
+  int num_threads() const {
+    return deques_.size();
+  }
+
+  // Returns the index of the calling thread in [0, num_threads()), where 0 is
+  // the creating thread, e.g., to index per-thread storage from a job.
+  int CurrentThreadIndex() const;
+
+ private:
+  struct Job {
+    std::function<void()> function;
+    JobCounter* counter;
+    int submitting_thread;
+  };
+
+  // The counters of a thread, only written by the thread itself. Padded to a
+  // cache line, so that the counters of the threads rarely share one.
+  struct ThreadCounters {
+    std::atomic<int64_t> num_jobs{0};
+    std::atomic<int64_t> busy_nanoseconds{0};
+    std::atomic<int64_t> num_migrations{0};
+    std::atomic<int> cpu{-1};
+    char padding[36];
+  };
+
+  // Lock-free work-stealing deque of a thread (Chase and Lev, 2005, with the
+  // memory orders of Le et al., 2013). The capacity is fixed, and Push() fails
+  // when it is full.
+  class JobDeque {
+   public:
+    JobDeque() : top_(0), bottom_(0) {
+      for (std::atomic<Job*>& job : jobs_) job.store(nullptr);
+    }
+
+    // Only called by the owning thread.
+    bool Push(Job* job);
+    Job* Pop();
+
+    // Called by any thread.
+    Job* Steal();
+
+   private:
+    std::atomic<int64_t> top_;
+    std::atomic<int64_t> bottom_;
+    std::atomic<Job*> jobs_[kJobDequeCapacity];
+  };
+
+  // Body of the worker threads.
+  void RunWorker(const int thread_index);
+
+  // Returns a job of the deque of the thread, or one stolen from another
+  // thread, or nullptr.
+  Job* FindJob(const int thread_index);
+
+  // Runs a job and deletes it.
+  void Execute(Job* job, const int thread_index);
+
+  // One deque per thread. The creating thread owns the first one.
+  std::vector<std::unique_ptr<JobDeque> > deques_;
+  std::vector<std::thread> workers_;
+  std::vector<int> worker_cpus_;
+  // The arenas and the counters of the threads, indexed like the deques.
+  std::vector<std::unique_ptr<FrameArena> > arenas_;
+  std::vector<std::unique_ptr<ThreadCounters> > thread_counters_;
+  // Workers that allocated their arena, and that failed to pin themselves.
+  std::atomic<int> num_started_workers_;
+  std::atomic<int> num_unpinned_workers_;
+  // Number of jobs in the deques.
+  std::atomic<int> num_queued_jobs_;
+  // Number of workers waiting on the condition.
+  std::atomic<int> num_sleeping_workers_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_condition_;
+  std::atomic<bool> stop_;
+  std::atomic<int64_t> num_jobs_;
+  std::atomic<int64_t> num_stolen_jobs_;
+  std::atomic<int64_t> busy_nanoseconds_;
+
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_JOB_SYSTEM_H_
@@ -0,0 +1,422 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "keyframe_animation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define WVU_HAS_SSE
+#endif
+
+#include "assignment.h"
+#include "entity_registry.h"
+#include "job_system.h"
+
+namespace wvu {
+namespace {
+// Number of animations interpolated together, one per SSE lane.
+constexpr int kBatchSize = 4;
+
+// Number of animations sampled by a job.
+constexpr int kSampleGrainSize = 256;
+
+constexpr float kMaxQuantized = 65535.0f;
+
+// The channels of a batch of animations, one lane per animation: the
+// quantized keyframes around their times, and the interpolated transforms.
+struct SampleBatch {
+  alignas(16) float position_t[kBatchSize];
+  alignas(16) float from_positions[3][kBatchSize];
+  alignas(16) float to_positions[3][kBatchSize];
+  alignas(16) float position_min[3][kBatchSize];
+  alignas(16) float position_scale[3][kBatchSize];
+  alignas(16) float orientation_t[kBatchSize];
+  alignas(16) float from_orientations[4][kBatchSize];
+  alignas(16) float to_orientations[4][kBatchSize];
+  alignas(16) float positions[3][kBatchSize];
+  // The x, y, z and w of the unit quaternions.
+  alignas(16) float orientations[4][kBatchSize];
+};
+
+// Returns the index of the keyframe preceding a time, wrapped in the time of
+// the keyframes, and sets t to the interpolation parameter towards the next
+// one.
+int FindKeyframe(const float* times,
+                 const int num_keyframes,
+                 const float time,
+                 float* t) {
+  *t = 0.0f;
+  const float duration = times[num_keyframes - 1] - times[0];
+  if (num_keyframes == 1 || duration <= 0.0f) return 0;
+  float local_time = time - times[0];
+  local_time -= duration * std::floor(local_time / duration);
+  local_time += times[0];
+  const int keyframe = std::min<int>(
+      std::upper_bound(times, times + num_keyframes, local_time) - times - 1,
+      num_keyframes - 2);
+  const float length = times[keyframe + 1] - times[keyframe];
+  if (length > 0.0f) {
+    *t = std::min(std::max((local_time - times[keyframe]) / length, 0.0f),
+                  1.0f);
+  }
+  return keyframe;
+}
+
+// Returns the indices of the keyframes kept: the first, the last, and every
+// keyframe that the interpolation between the last kept keyframe and a later
+// one does not reproduce, i.e., for which error(from, to, i) exceeds the
+// tolerance for some i in between.
+template <typename ErrorFunction>
+std::vector<int> ReduceKeyframes(const int num_keyframes,
+                                 const float tolerance,
+                                 const ErrorFunction& error) {
+  std::vector<int> kept(1, 0);
+  int from = 0;
+  for (int to = 2; to < num_keyframes; ++to) {
+    for (int i = from + 1; i < to; ++i) {
+      if (error(from, to, i) > tolerance) {
+        from = to - 1;
+        kept.push_back(from);
+        break;
+      }
+    }
+  }
+  if (num_keyframes > 1) kept.push_back(num_keyframes - 1);
+  return kept;
+}
+
+// Returns the interpolation parameter of keyframe i between from and to.
+float KeyframeParameter(const std::vector<TransformKeyframe>& keyframes,
+                        const int from,
+                        const int to,
+                        const int i) {
+  const float length = keyframes[to].time - keyframes[from].time;
+  return length > 0.0f ?
+      (keyframes[i].time - keyframes[from].time) / length : 0.0f;
+}
+
+uint16_t Quantize(const float value) {
+  return static_cast<uint16_t>(
+      std::min(std::max(value, 0.0f), 1.0f) * kMaxQuantized + 0.5f);
+}
+
+void InterpolateScalar(SampleBatch* batch) {
+  for (int lane = 0; lane < kBatchSize; ++lane) {
+    const float position_t = batch->position_t[lane];
+    for (int c = 0; c < 3; ++c) {
+      const float from = batch->from_positions[c][lane];
+      const float quantized =
+          from + position_t * (batch->to_positions[c][lane] - from);
+      batch->positions[c][lane] = batch->position_min[c][lane] +
+                                  quantized * batch->position_scale[c][lane];
+    }
+    const float orientation_t = batch->orientation_t[lane];
+    float squared_norm = 0.0f;
+    for (int c = 0; c < 4; ++c) {
+      const float from = batch->from_orientations[c][lane];
+      const float quantized =
+          from + orientation_t * (batch->to_orientations[c][lane] - from);
+      const float component = quantized * (2.0f / kMaxQuantized) - 1.0f;
+      batch->orientations[c][lane] = component;
+      squared_norm += component * component;
+    }
+    const float inverse_norm = 1.0f / std::sqrt(squared_norm);
+    for (int c = 0; c < 4; ++c) batch->orientations[c][lane] *= inverse_norm;
+  }
+}
+
+#if defined(WVU_HAS_SSE)
+void InterpolateSse(SampleBatch* batch) {
+  const __m128 position_t = _mm_load_ps(batch->position_t);
+  for (int c = 0; c < 3; ++c) {
+    const __m128 from = _mm_load_ps(batch->from_positions[c]);
+    const __m128 to = _mm_load_ps(batch->to_positions[c]);
+    const __m128 quantized =
+        _mm_add_ps(from, _mm_mul_ps(position_t, _mm_sub_ps(to, from)));
+    _mm_store_ps(batch->positions[c],
+                 _mm_add_ps(_mm_load_ps(batch->position_min[c]),
+                            _mm_mul_ps(quantized,
+                                       _mm_load_ps(batch->position_scale[c]))));
+  }
+  // Dequantizing is affine, so it commutes with the interpolation.
+  const __m128 orientation_t = _mm_load_ps(batch->orientation_t);
+  const __m128 scale = _mm_set1_ps(2.0f / kMaxQuantized);
+  const __m128 one = _mm_set1_ps(1.0f);
+  __m128 components[4];
+  __m128 squared_norm = _mm_setzero_ps();
+  for (int c = 0; c < 4; ++c) {
+    const __m128 from = _mm_load_ps(batch->from_orientations[c]);
+    const __m128 to = _mm_load_ps(batch->to_orientations[c]);
+    const __m128 quantized =
+        _mm_add_ps(from, _mm_mul_ps(orientation_t, _mm_sub_ps(to, from)));
+    components[c] = _mm_sub_ps(_mm_mul_ps(quantized, scale), one);
+    squared_norm =
+        _mm_add_ps(squared_norm, _mm_mul_ps(components[c], components[c]));
+  }
+  const __m128 inverse_norm = _mm_div_ps(one, _mm_sqrt_ps(squared_norm));
+  for (int c = 0; c < 4; ++c) {
+    _mm_store_ps(batch->orientations[c],
+                 _mm_mul_ps(components[c], inverse_norm));
+  }
+}
+#endif  // WVU_HAS_SSE
+
+// Returns the Rodrigues vector of a unit quaternion.
+Eigen::Vector3f QuaternionToRodrigues(float x, float y, float z, float w) {
+  // The quaternions q and -q are the same rotation; the one with w >= 0 has
+  // the angle in [0, pi].
+  if (w < 0.0f) {
+    x = -x;
+    y = -y;
+    z = -z;
+    w = -w;
+  }
+  const float sin_half_angle = std::sqrt(x * x + y * y + z * z);
+  // Near the identity, the angle is 2 * sin_half_angle.
+  const float factor = sin_half_angle > 1e-6f ?
+      2.0f * std::atan2(sin_half_angle, w) / sin_half_angle : 2.0f;
+  return Eigen::Vector3f(x, y, z) * factor;
+}
+
+}  // namespace
+
+AnimationClip::AnimationClip() : num_input_keyframes_(0) {}
+
+AnimationClip::~AnimationClip() {}
+
+int AnimationClip::AddTrack(const std::vector<TransformKeyframe>& keyframes,
+                            const AnimationCompressionOptions& options) {
+  const int num_keyframes = keyframes.size();
+  if (num_keyframes == 0) return -1;
+  for (int i = 1; i < num_keyframes; ++i) {
+    if (keyframes[i].time < keyframes[i - 1].time) return -1;
+  }
+
+  // The orientations as quaternions, each in the hemisphere of the previous,
+  // so that the interpolation takes the shortest path.
+  std::vector<Eigen::Vector4f, Eigen::aligned_allocator<Eigen::Vector4f> >
+      quaternions(num_keyframes);
+  for (int i = 0; i < num_keyframes; ++i) {
+    const Eigen::Vector3f& orientation = keyframes[i].orientation;
+    const float angle = orientation.norm();
+    const Eigen::Quaternionf quaternion =
+        angle > 0.0f ?
+        Eigen::Quaternionf(Eigen::AngleAxisf(angle, orientation / angle)) :
+        Eigen::Quaternionf::Identity();
+    quaternions[i] = quaternion.coeffs();
+    if (i > 0 && quaternions[i].dot(quaternions[i - 1]) < 0.0f) {
+      quaternions[i] = -quaternions[i];
+    }
+  }
+
+  const std::vector<int> kept_positions = ReduceKeyframes(
+      num_keyframes, options.position_tolerance,
+      [&keyframes](const int from, const int to, const int i) {
+    const float t = KeyframeParameter(keyframes, from, to, i);
+    const Eigen::Vector3f position =
+        keyframes[from].position +
+        t * (keyframes[to].position - keyframes[from].position);
+    return (position - keyframes[i].position).norm();
+  });
+  const std::vector<int> kept_orientations = ReduceKeyframes(
+      num_keyframes, options.orientation_tolerance,
+      [&keyframes, &quaternions](const int from, const int to, const int i) {
+    const float t = KeyframeParameter(keyframes, from, to, i);
+    const Eigen::Vector4f quaternion =
+        (quaternions[from] + t * (quaternions[to] - quaternions[from]))
+            .normalized();
+    const float cosine_half_angle =
+        std::min(std::abs(quaternion.dot(quaternions[i])), 1.0f);
+    return 2.0f * std::acos(cosine_half_angle);
+  });
+
+  Track track;
+  track.first_position = position_times_.size();
+  track.num_positions = kept_positions.size();
+  track.first_orientation = orientation_times_.size();
+  track.num_orientations = kept_orientations.size();
+
+  // The positions are quantized over the box of the kept keyframes.
+  Eigen::AlignedBox3f box;
+  for (const int i : kept_positions) box.extend(keyframes[i].position);
+  const Eigen::Vector3f extents = box.sizes();
+  for (int c = 0; c < 3; ++c) {
+    track.position_min[c] = box.min()[c];
+    track.position_scale[c] = extents[c] / kMaxQuantized;
+  }
+  for (const int i : kept_positions) {
+    position_times_.push_back(keyframes[i].time);
+    for (int c = 0; c < 3; ++c) {
+      positions_.push_back(
+          extents[c] > 0.0f ?
+          Quantize((keyframes[i].position[c] - box.min()[c]) / extents[c]) :
+          0);
+    }
+  }
+  for (const int i : kept_orientations) {
+    orientation_times_.push_back(keyframes[i].time);
+    for (int c = 0; c < 4; ++c) {
+      orientations_.push_back(Quantize(0.5f * (quaternions[i][c] + 1.0f)));
+    }
+  }
+
+  tracks_.push_back(track);
+  num_input_keyframes_ += 2 * num_keyframes;
+  return tracks_.size() - 1;
+}
+
+void AnimationClip::Sample(const AnimationComponent* animations,
+                           const int num_animations,
+                           const float time,
+                           Eigen::Vector3f* orientations,
+                           Eigen::Vector3f* positions) const {
+#if defined(WVU_HAS_SSE)
+  const bool use_sse = ActiveSimdInstructionSet() != SCALAR;
+#endif
+  // The lanes without an animation are interpolated too, so they start from
+  // valid values.
+  SampleBatch batch = SampleBatch();
+  int rows[kBatchSize];
+  for (int begin = 0; begin < num_animations; begin += kBatchSize) {
+    const int end = std::min(begin + kBatchSize, num_animations);
+    int num_lanes = 0;
+    // Gather the keyframes around the time of every animation, one channel
+    // after the other.
+    for (int i = begin; i < end; ++i) {
+      const AnimationComponent& animation = animations[i];
+      if (animation.track < 0 || animation.track >= num_tracks()) continue;
+      const Track& track = tracks_[animation.track];
+      const float track_time = animation.time_offset + animation.speed * time;
+      const int lane = num_lanes++;
+      rows[lane] = i;
+
+      const int position = track.first_position +
+          FindKeyframe(&position_times_[track.first_position],
+                       track.num_positions, track_time,
+                       &batch.position_t[lane]);
+      const int next_position =
+          track.num_positions > 1 ? position + 1 : position;
+      for (int c = 0; c < 3; ++c) {
+        batch.from_positions[c][lane] = positions_[3 * position + c];
+        batch.to_positions[c][lane] = positions_[3 * next_position + c];
+        batch.position_min[c][lane] = track.position_min[c];
+        batch.position_scale[c][lane] = track.position_scale[c];
+      }
+
+      const int orientation = track.first_orientation +
+          FindKeyframe(&orientation_times_[track.first_orientation],
+                       track.num_orientations, track_time,
+                       &batch.orientation_t[lane]);
+      const int next_orientation =
+          track.num_orientations > 1 ? orientation + 1 : orientation;
+      for (int c = 0; c < 4; ++c) {
+        batch.from_orientations[c][lane] = orientations_[4 * orientation + c];
+        batch.to_orientations[c][lane] =
+            orientations_[4 * next_orientation + c];
+      }
+    }
+    if (num_lanes == 0) continue;
+
+#if defined(WVU_HAS_SSE)
+    if (use_sse) {
+      InterpolateSse(&batch);
+    } else {
+      InterpolateScalar(&batch);
+    }
+#else
+    InterpolateScalar(&batch);
+#endif
+
+    for (int lane = 0; lane < num_lanes; ++lane) {
+      const int row = rows[lane];
+      positions[row] = Eigen::Vector3f(batch.positions[0][lane],
+                                       batch.positions[1][lane],
+                                       batch.positions[2][lane]);
+      orientations[row] = QuaternionToRodrigues(batch.orientations[0][lane],
+                                                batch.orientations[1][lane],
+                                                batch.orientations[2][lane],
+                                                batch.orientations[3][lane]);
+    }
+  }
+}
+
+void AnimationClip::Reset() {
+  tracks_.clear();
+  position_times_.clear();
+  orientation_times_.clear();
+  positions_.clear();
+  orientations_.clear();
+  num_input_keyframes_ = 0;
+}
+
+size_t AnimationClip::num_bytes() const {
+  return tracks_.size() * sizeof(Track) +
+         (position_times_.size() + orientation_times_.size()) * sizeof(float) +
+         (positions_.size() + orientations_.size()) * sizeof(uint16_t);
+}
+
+void AnimateEntities(const AnimationClip& clip,
+                     const float time,
+                     JobSystem* job_system,
+                     EntityRegistry* registry) {
+  registry->ForEachArchetype(TRANSFORM_COMPONENT | ANIMATION_COMPONENT,
+                             [&](EntityArchetype* archetype) {
+    // The mutable columns mark the transforms dirty once, before the jobs
+    // write them.
+    const AnimationComponent* animations = archetype->animations().data();
+    Eigen::Vector3f* orientations = archetype->mutable_orientations()->data();
+    Eigen::Vector3f* positions = archetype->mutable_positions()->data();
+    const auto sample = [&](const int begin, const int end) {
+      clip.Sample(animations + begin, end - begin, time,
+                  orientations + begin, positions + begin);
+    };
+    if (job_system == nullptr) {
+      sample(0, archetype->num_entities());
+    } else {
+      job_system->ParallelFor(archetype->num_entities(), kSampleGrainSize,
+                              sample);
+    }
+  });
+}
+
+}  // namespace wvu
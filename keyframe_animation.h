@@ -0,0 +1,186 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_KEYFRAME_ANIMATION_H_
+#define GLUTILS_KEYFRAME_ANIMATION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <Eigen/Core>
+
+#include "entity_registry.h"
+#include "job_system.h"
+
+namespace wvu {
+// A keyframe of the transform of an object, in the units of the transform
+// component: the orientation as a Rodrigues vector, and the position.
+struct TransformKeyframe {
+  float time = 0.0f;
+  Eigen::Vector3f orientation = Eigen::Vector3f::Zero();
+  Eigen::Vector3f position = Eigen::Vector3f::Zero();
+};
+
+// The errors allowed when the keyframes of a track are removed.
+struct AnimationCompressionOptions {
+  // The largest distance between a position and its interpolation.
+  float position_tolerance = 1e-3f;
+  // The largest angle, in radians, between an orientation and its
+  // interpolation.
+  float orientation_tolerance = 1e-3f;
+};
+
+// This class stores the transform tracks of many objects, compressed for the
+// memory bandwidth of sampling thousands of them every frame. The positions
+// and the orientations of a track are reduced separately: the keyframes that
+// the interpolation of their neighbors reproduces within the tolerances of
+// AnimationCompressionOptions are removed, so a channel that is still or
+// moves at a constant rate keeps two keyframes. The remaining keyframes are
+// quantized to 16 bits per component: the positions over the box of the
+// track, and the orientations as unit quaternions, whose components are in
+// [-1, 1]. The quantization adds at most 1/65535 of the box extents to the
+// error of the positions.
+//
+// The tracks are sampled in batches of four objects: the keyframes around the
+// time of every object are gathered one channel after the other, and the
+// channels are interpolated with SSE, positions linearly and quaternions with
+// NLERP, before the quaternions are converted to Rodrigues vectors. The tracks
+// loop over the time of their keyframes.
+//
+// AnimateEntities() samples the clip for the entities with an
+// ANIMATION_COMPONENT and a TRANSFORM_COMPONENT, in parallel on the jobs of a
+// JobSystem, and writes the transform columns of their archetypes.
+//
+// Example:
+//
+// wvu::AnimationClip clip;
+// const int track =
+//     clip.AddTrack(keyframes, wvu::AnimationCompressionOptions());
+// wvu::AnimationComponent animation;
+// animation.track = track;
+// const wvu::Entity entity = registry.CreateEntity(
+//     wvu::kModelComponents | wvu::ANIMATION_COMPONENT);
+// registry.SetAnimation(entity, animation);
+// while (...) {  // Rendering loop.
+//   wvu::AnimateEntities(clip, glfwGetTime(), &job_system, &registry);
+//   registry.UpdateTransforms();
+//   ...
+// }
+class AnimationClip {
+ public:
+  AnimationClip();
+  ~AnimationClip();
+
+  // Compresses a track of keyframes sorted by time, and adds it to the clip.
+  // Returns the index of the track, or -1 if there are no keyframes or they
+  // are not sorted.
+  int AddTrack(const std::vector<TransformKeyframe>& keyframes,
+               const AnimationCompressionOptions& options);
+
+  // Samples the tracks of the animations at a time, the time of the clip, and
+  // writes the transforms. The animations without a valid track are skipped.
+  // Parameters:
+  //   animations  The animations sampled.
+  //   num_animations  The number of animations.
+  //   time  The time of the clip.
+  //   orientations  The orientations of the animations, as Rodrigues vectors.
+  //   positions  The positions of the animations.
+  void Sample(const AnimationComponent* animations,
+              const int num_animations,
+              const float time,
+              Eigen::Vector3f* orientations,
+              Eigen::Vector3f* positions) const;
+
+  // Removes the tracks.
+  void Reset();
+
+  int num_tracks() const {
+    return tracks_.size();
+  }
+
+  // Returns the number of keyframes of all the tracks before and after the
+  // compression, counting the positions and orientations separately.
+  int num_input_keyframes() const {
+    return num_input_keyframes_;
+  }
+
+  int num_keyframes() const {
+    return position_times_.size() + orientation_times_.size();
+  }
+
+  // Returns the bytes taken by the compressed tracks.
+  size_t num_bytes() const;
+
+ private:
+  struct Track {
+    int first_position = 0;
+    int num_positions = 0;
+    int first_orientation = 0;
+    int num_orientations = 0;
+    // The dequantized position of q is position_min + q * position_scale.
+    float position_min[3];
+    float position_scale[3];
+  };
+
+  std::vector<Track> tracks_;
+  std::vector<float> position_times_;
+  std::vector<float> orientation_times_;
+  // The quantized keyframes: 3 components per position, and 4 components per
+  // orientation.
+  std::vector<uint16_t> positions_;
+  std::vector<uint16_t> orientations_;
+  int num_input_keyframes_;
+
+  AnimationClip(const AnimationClip&) = delete;
+  AnimationClip& operator=(const AnimationClip&) = delete;
+};
+
+// Samples a clip at a time for the entities of a registry with an
+// ANIMATION_COMPONENT and a TRANSFORM_COMPONENT, and writes their transforms,
+// which are then dirty.
+// Parameters:
+//   clip  The clip of the tracks of the animations.
+//   time  The time of the clip.
+//   job_system  The job system sampling ranges of the entities in parallel, or
+//     nullptr to sample them on the calling thread.
+//   registry  The entities.
+void AnimateEntities(const AnimationClip& clip,
+                     const float time,
+                     JobSystem* job_system,
+                     EntityRegistry* registry);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_KEYFRAME_ANIMATION_H_
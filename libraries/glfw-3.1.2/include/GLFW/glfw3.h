@@ -109,6 +109,11 @@ extern "C" {
  #include <stddef.h>
 #endif
 
+/* Include because the raw timer functions return 64-bit values.
+ * Include it unconditionally to avoid surprising side-effects.
+ */
+#include <stdint.h>
+
 /* Include the chosen client API headers.
  */
 #if defined(__APPLE_CC__)
@@ -796,6 +801,18 @@ typedef void (* GLFWwindowclosefun)(GLFWwindow*);
  */
 typedef void (* GLFWwindowrefreshfun)(GLFWwindow*);
 
+/*! @brief The function signature for window frame callbacks.
+ *
+ *  This is the function signature for window frame callback functions.
+ *
+ *  @param[in] window The window whose last frame was presented.
+ *
+ *  @sa glfwSetWindowFrameCallback
+ *
+ *  @ingroup window
+ */
+typedef void (* GLFWwindowframefun)(GLFWwindow*);
+
 /*! @brief The function signature for window focus/defocus callbacks.
  *
  *  This is the function signature for window focus callback functions.
@@ -2216,6 +2233,38 @@ GLFWAPI GLFWwindowclosefun glfwSetWindowCloseCallback(GLFWwindow* window, GLFWwi
  */
 GLFWAPI GLFWwindowrefreshfun glfwSetWindowRefreshCallback(GLFWwindow* window, GLFWwindowrefreshfun cbfun);
 
+/*! @brief Sets the frame callback for the specified window.
+ *
+ *  This function sets the frame callback of the specified window, which is
+ *  called when it is a good time to draw a new frame of the window, i.e. when
+ *  the compositor showed the last one.  Applications that only render a frame
+ *  after this callback do not render frames that would never be shown.
+ *
+ *  On Wayland, the callback is driven by the `wl_surface.frame` events of the
+ *  compositor, which are not sent while the window is hidden or occluded, so
+ *  the callback is not called either.  Rendering must then not wait for the
+ *  vertical blank in the buffer swap, which would block until the window
+ *  shows again, so the swap interval should be zero.
+ *
+ *  On the other platforms, the callback is called after every buffer swap.
+ *
+ *  @param[in] window The window whose callback to set.
+ *  @param[in] cbfun The new callback, or `NULL` to remove the currently set
+ *  callback.
+ *  @return The previously set callback, or `NULL` if no callback was set or the
+ *  library had not been [initialized](@ref intro_init).
+ *
+ *  @par Thread Safety
+ *  This function may only be called from the main thread.
+ *
+ *  @sa glfwSwapBuffers
+ *
+ *  @since Added in GLFW 3.2.
+ *
+ *  @ingroup window
+ */
+GLFWAPI GLFWwindowframefun glfwSetWindowFrameCallback(GLFWwindow* window, GLFWwindowframefun cbfun);
+
 /*! @brief Sets the focus callback for the specified window.
  *
  *  This function sets the focus callback of the specified window, which is
@@ -2363,6 +2412,41 @@ GLFWAPI void glfwPollEvents(void);
  */
 GLFWAPI void glfwWaitEvents(void);
 
+/*! @brief Waits with timeout until events are queued and processes them.
+ *
+ *  This function puts the calling thread to sleep until at least one event is
+ *  available in the event queue, or until the specified timeout is reached.  If
+ *  one or more events are available, it behaves exactly like @ref
+ *  glfwPollEvents, i.e. the events in the queue are processed and the function
+ *  then returns immediately.  Processing events will cause the window and input
+ *  callbacks associated with those events to be called.
+ *
+ *  The timeout value must be a positive finite number.
+ *
+ *  Since not all events are associated with callbacks, this function may return
+ *  without a callback having been called even if you are monitoring all
+ *  callbacks.
+ *
+ *  If no windows exist, this function returns immediately.
+ *
+ *  @param[in] timeout The maximum amount of time, in seconds, to wait.
+ *
+ *  @par Reentrancy
+ *  This function may not be called from a callback.
+ *
+ *  @par Thread Safety
+ *  This function may only be called from the main thread.
+ *
+ *  @sa @ref events
+ *  @sa glfwPollEvents
+ *  @sa glfwWaitEvents
+ *
+ *  @since Added in GLFW 3.2.
+ *
+ *  @ingroup window
+ */
+GLFWAPI void glfwWaitEventsTimeout(double timeout);
+
 /*! @brief Posts an empty event to the event queue.
  *
  *  This function posts an empty event from the current thread to the event
@@ -3150,6 +3234,44 @@ GLFWAPI double glfwGetTime(void);
  */
 GLFWAPI void glfwSetTime(double time);
 
+/*! @brief Returns the current value of the raw timer.
+ *
+ *  This function returns the current value of the raw timer, measured in
+ *  1&nbsp;/&nbsp;frequency seconds.  To get the frequency, call @ref
+ *  glfwGetTimerFrequency.  Unlike @ref glfwGetTime, the value is not converted
+ *  to floating point, so differences between values are exact whatever the
+ *  uptime of the system, and it is not affected by @ref glfwSetTime.
+ *
+ *  @return The value of the timer, or zero if an
+ *  [error](@ref error_handling) occurred.
+ *
+ *  @par Thread Safety
+ *  This function may be called from any thread.
+ *
+ *  @sa @ref time
+ *  @sa glfwGetTimerFrequency
+ *
+ *  @ingroup input
+ */
+GLFWAPI uint64_t glfwGetTimerValue(void);
+
+/*! @brief Returns the frequency, in Hz, of the raw timer.
+ *
+ *  This function returns the frequency, in Hz, of the raw timer.
+ *
+ *  @return The frequency of the timer, in Hz, or zero if an
+ *  [error](@ref error_handling) occurred.
+ *
+ *  @par Thread Safety
+ *  This function may be called from any thread.
+ *
+ *  @sa @ref time
+ *  @sa glfwGetTimerValue
+ *
+ *  @ingroup input
+ */
+GLFWAPI uint64_t glfwGetTimerFrequency(void);
+
 /*! @brief Makes the context of the specified window current for the calling
  *  thread.
  *
@@ -3163,6 +3285,10 @@ GLFWAPI void glfwSetTime(double time);
  *  whether a context performs this flush by setting the
  *  [GLFW_CONTEXT_RELEASE_BEHAVIOR](@ref window_hints_ctx) window hint.
  *
+ *  If the context of the specified window is already current on the calling
+ *  thread, this function returns without calling the window system, so it
+ *  does not flush the pipeline either.
+ *
  *  @param[in] window The window whose context to make current, or `NULL` to
  *  detach the current context.
  *
@@ -110,6 +110,7 @@ typedef struct _GLFWtimeNS
 {
     double          base;
     double          resolution;
+    uint64_t        frequency;
 
 } _GLFWtimeNS;
 
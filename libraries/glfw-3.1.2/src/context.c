@@ -28,11 +28,142 @@
 #include "internal.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <stdio.h>
 
 
+// Returns the FNV-1a hash of the specified string
+//
+static unsigned int hashExtensionName(const char* name)
+{
+    unsigned int hash = 2166136261u;
+
+    while (*name)
+    {
+        hash ^= (unsigned char) *name++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// Returns the slot of the specified extension in the hash set of the window,
+// or of the empty slot where it would be inserted
+//
+static const char** findExtensionSlot(_GLFWwindow* window, const char* name)
+{
+    // The slot count is a power of two and at least twice the extension count,
+    // so the linear probing always ends at an empty slot
+    const unsigned int mask = window->extensions.slotCount - 1;
+    unsigned int i = hashExtensionName(name) & mask;
+
+    while (window->extensions.slots[i] &&
+           strcmp(window->extensions.slots[i], name) != 0)
+    {
+        i = (i + 1) & mask;
+    }
+
+    return window->extensions.slots + i;
+}
+
+// Builds the hash set of the extensions of the current context
+//
+// NOTE: The names are copied into a single allocation, split at their
+//       terminators, and the set points into it
+//
+static GLboolean buildExtensionSet(_GLFWwindow* window)
+{
+    char* name;
+    char* names;
+    int count = 0;
+    size_t size = 0;
+
+#if defined(_GLFW_USE_OPENGL)
+    if (window->context.major >= 3)
+    {
+        GLint i, numExtensions;
+
+        window->GetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+
+        for (i = 0;  i < numExtensions;  i++)
+        {
+            const char* en = (const char*) window->GetStringi(GL_EXTENSIONS, i);
+            if (!en)
+            {
+                _glfwInputError(GLFW_PLATFORM_ERROR,
+                                "Failed to retrieve extension string %i", i);
+                return GL_FALSE;
+            }
+
+            size += strlen(en) + 1;
+        }
+
+        names = malloc(size + 1);
+        name = names;
+
+        for (i = 0;  i < numExtensions;  i++)
+        {
+            const char* en = (const char*) window->GetStringi(GL_EXTENSIONS, i);
+            const size_t length = strlen(en) + 1;
+
+            memcpy(name, en, length);
+            name += length;
+        }
+
+        *name = '\0';
+        count = numExtensions;
+    }
+    else
+#endif // _GLFW_USE_OPENGL
+    {
+        const char* extensions = (const char*) window->GetString(GL_EXTENSIONS);
+        if (!extensions)
+        {
+            _glfwInputError(GLFW_PLATFORM_ERROR,
+                            "Failed to retrieve extension string");
+            return GL_FALSE;
+        }
+
+        // The names are separated by one or more spaces, which are replaced
+        // with terminators, and the list ends with an empty name
+        size = strlen(extensions);
+        names = malloc(size + 2);
+        name = names;
+
+        while (*extensions)
+        {
+            while (*extensions == ' ')
+                extensions++;
+
+            if (!*extensions)
+                break;
+
+            while (*extensions && *extensions != ' ')
+                *name++ = *extensions++;
+
+            *name++ = '\0';
+            count++;
+        }
+
+        *name = '\0';
+    }
+
+    window->extensions.slotCount = 16;
+    while (window->extensions.slotCount < (unsigned int) count * 2)
+        window->extensions.slotCount *= 2;
+
+    window->extensions.slots = calloc(window->extensions.slotCount,
+                                      sizeof(const char*));
+    window->extensions.names = names;
+
+    for (name = names;  *name;  name += strlen(name) + 1)
+        *findExtensionSlot(window, name) = name;
+
+    return GL_TRUE;
+}
+
 // Parses the client API version string and extracts the version number
 //
 static GLboolean parseVersionString(int* api, int* major, int* minor, int* rev)
@@ -532,6 +663,12 @@ GLFWAPI void glfwMakeContextCurrent(GLFWwindow* handle)
 {
     _GLFWwindow* window = (_GLFWwindow*) handle;
     _GLFW_REQUIRE_INIT();
+
+    // The current context of the thread is kept in TLS, so making it current
+    // again is skipped without a glXMakeCurrent or wglMakeCurrent round trip
+    if (_glfwPlatformGetCurrentContext() == window)
+        return;
+
     _glfwPlatformMakeContextCurrent(window);
 }
 
@@ -546,6 +683,12 @@ GLFWAPI void glfwSwapBuffers(GLFWwindow* handle)
     _GLFWwindow* window = (_GLFWwindow*) handle;
     _GLFW_REQUIRE_INIT();
     _glfwPlatformSwapBuffers(window);
+
+#if !defined(_GLFW_WAYLAND)
+    // Without frame events from the compositor, every swapped frame is
+    // considered shown
+    _glfwInputWindowFrame(window);
+#endif
 }
 
 GLFWAPI void glfwSwapInterval(int interval)
@@ -580,46 +723,20 @@ GLFWAPI int glfwExtensionSupported(const char* extension)
         return GL_FALSE;
     }
 
-#if defined(_GLFW_USE_OPENGL)
-    if (window->context.major >= 3)
+    // The extensions of the context are read once, into a hash set, instead
+    // of being searched on every query
+    if (!window->extensions.slots)
     {
-        int i;
-        GLint count;
-
-        // Check if extension is in the modern OpenGL extensions string list
-
-        window->GetIntegerv(GL_NUM_EXTENSIONS, &count);
-
-        for (i = 0;  i < count;  i++)
-        {
-            const char* en = (const char*) window->GetStringi(GL_EXTENSIONS, i);
-            if (!en)
-            {
-                _glfwInputError(GLFW_PLATFORM_ERROR,
-                                "Failed to retrieve extension string %i", i);
-                return GL_FALSE;
-            }
-
-            if (strcmp(en, extension) == 0)
-                return GL_TRUE;
-        }
+        if (!buildExtensionSet(window))
+            return GL_FALSE;
     }
-    else
-#endif // _GLFW_USE_OPENGL
-    {
-        // Check if extension is in the old style OpenGL extensions string
 
-        const char* extensions = (const char*) window->GetString(GL_EXTENSIONS);
-        if (!extensions)
-        {
-            _glfwInputError(GLFW_PLATFORM_ERROR,
-                            "Failed to retrieve extension string");
-            return GL_FALSE;
-        }
+    if (*findExtensionSlot(window, extension))
+        return GL_TRUE;
 
-        if (_glfwStringInExtensionString(extension, extensions))
-            return GL_TRUE;
-    }
+    // The window system extensions have their own prefixes, e.g. GLX_ or WGL_
+    if (strncmp(extension, "GL_", 3) == 0)
+        return GL_FALSE;
 
     // Check if extension is in the platform-specific string
     return _glfwPlatformExtensionSupported(extension);
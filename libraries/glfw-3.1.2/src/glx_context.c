@@ -46,13 +46,37 @@ static int getFBConfigAttrib(GLXFBConfig fbconfig, int attrib)
     return value;
 }
 
-// Return a list of available and usable framebuffer configs
+// Returns whether the specified framebuffer hints are identical
 //
-static GLboolean chooseFBConfig(const _GLFWfbconfig* desired, GLXFBConfig* result)
+static GLboolean equalFBConfigHints(const _GLFWfbconfig* a,
+                                    const _GLFWfbconfig* b)
+{
+    return a->redBits == b->redBits &&
+           a->greenBits == b->greenBits &&
+           a->blueBits == b->blueBits &&
+           a->alphaBits == b->alphaBits &&
+           a->depthBits == b->depthBits &&
+           a->stencilBits == b->stencilBits &&
+           a->accumRedBits == b->accumRedBits &&
+           a->accumGreenBits == b->accumGreenBits &&
+           a->accumBlueBits == b->accumBlueBits &&
+           a->accumAlphaBits == b->accumAlphaBits &&
+           a->auxBuffers == b->auxBuffers &&
+           a->stereo == b->stereo &&
+           a->samples == b->samples &&
+           a->sRGB == b->sRGB &&
+           a->doublebuffer == b->doublebuffer;
+}
+
+// Query the available and usable framebuffer configs of the display
+//
+// NOTE: The GLXFBConfig handles remain valid after the array holding them is
+//       freed, so they are kept until the display is closed
+//
+static GLboolean queryFBConfigs(void)
 {
     GLXFBConfig* nativeConfigs;
     _GLFWfbconfig* usableConfigs;
-    const _GLFWfbconfig* closest;
     int i, nativeCount, usableCount;
     const char* vendor;
     GLboolean trustWindowBit = GL_TRUE;
@@ -124,14 +148,50 @@ static GLboolean chooseFBConfig(const _GLFWfbconfig* desired, GLXFBConfig* resul
         usableCount++;
     }
 
-    closest = _glfwChooseFBConfig(desired, usableConfigs, usableCount);
-    if (closest)
-        *result = closest->glx;
-
     XFree(nativeConfigs);
-    free(usableConfigs);
 
-    return closest ? GL_TRUE : GL_FALSE;
+    _glfw.glx.fbconfigs = usableConfigs;
+    _glfw.glx.fbconfigCount = usableCount;
+    return GL_TRUE;
+}
+
+// Return the closest match among the usable framebuffer configs
+//
+// NOTE: The usable configs are queried on the first window creation and reused
+//       for the following ones, and the config selected for the last hints is
+//       returned directly when the same hints are requested again
+//
+static GLboolean chooseFBConfig(const _GLFWfbconfig* desired, GLXFBConfig* result)
+{
+    const _GLFWfbconfig* closest;
+
+    if (_glfw.glx.lastDesired &&
+        equalFBConfigHints(desired, _glfw.glx.lastDesired))
+    {
+        *result = _glfw.glx.lastFBConfig;
+        return GL_TRUE;
+    }
+
+    if (!_glfw.glx.fbconfigs)
+    {
+        if (!queryFBConfigs())
+            return GL_FALSE;
+    }
+
+    closest = _glfwChooseFBConfig(desired,
+                                  _glfw.glx.fbconfigs,
+                                  _glfw.glx.fbconfigCount);
+    if (!closest)
+        return GL_FALSE;
+
+    if (!_glfw.glx.lastDesired)
+        _glfw.glx.lastDesired = calloc(1, sizeof(_GLFWfbconfig));
+
+    *_glfw.glx.lastDesired = *desired;
+    _glfw.glx.lastFBConfig = closest->glx;
+
+    *result = closest->glx;
+    return GL_TRUE;
 }
 
 // Create the OpenGL context using legacy API
@@ -290,6 +350,13 @@ void _glfwTerminateContextAPI(void)
     // NOTE: This function may not call any X11 functions, as it is called after
     //       XCloseDisplay (see _glfwPlatformTerminate for details)
 
+    free(_glfw.glx.fbconfigs);
+    _glfw.glx.fbconfigs = NULL;
+    _glfw.glx.fbconfigCount = 0;
+
+    free(_glfw.glx.lastDesired);
+    _glfw.glx.lastDesired = NULL;
+
     if (_glfw.glx.handle)
     {
         dlclose(_glfw.glx.handle);
@@ -122,6 +122,13 @@ typedef struct _GLFWlibraryGLX
     GLboolean       EXT_create_context_es2_profile;
     GLboolean       ARB_context_flush_control;
 
+    // Usable framebuffer configs of the display, queried once
+    _GLFWfbconfig*  fbconfigs;
+    int             fbconfigCount;
+    // Hints and result of the last successful selection
+    _GLFWfbconfig*  lastDesired;
+    GLXFBConfig     lastFBConfig;
+
 } _GLFWlibraryGLX;
 
 
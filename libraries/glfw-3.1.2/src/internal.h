@@ -262,6 +262,14 @@ struct _GLFWwindow
         int             release;
     } context;
 
+    // Hash set of the context extensions, built by the first extension query
+    // with the context current
+    struct {
+        char*           names;
+        const char**    slots;
+        unsigned int    slotCount;
+    } extensions;
+
 #if defined(_GLFW_USE_OPENGL)
     PFNGLGETSTRINGIPROC GetStringi;
 #endif
@@ -274,6 +282,7 @@ struct _GLFWwindow
         GLFWwindowsizefun       size;
         GLFWwindowclosefun      close;
         GLFWwindowrefreshfun    refresh;
+        GLFWwindowframefun      frame;
         GLFWwindowfocusfun      focus;
         GLFWwindowiconifyfun    iconify;
         GLFWframebuffersizefun  fbsize;
@@ -500,6 +509,16 @@ double _glfwPlatformGetTime(void);
  */
 void _glfwPlatformSetTime(double time);
 
+/*! @copydoc glfwGetTimerValue
+ *  @ingroup platform
+ */
+uint64_t _glfwPlatformGetTimerValue(void);
+
+/*! @copydoc glfwGetTimerFrequency
+ *  @ingroup platform
+ */
+uint64_t _glfwPlatformGetTimerFrequency(void);
+
 /*! @ingroup platform
  */
 int _glfwPlatformCreateWindow(_GLFWwindow* window,
@@ -595,6 +614,11 @@ void _glfwPlatformPollEvents(void);
  */
 void _glfwPlatformWaitEvents(void);
 
+/*! @copydoc glfwWaitEventsTimeout
+ *  @ingroup platform
+ */
+void _glfwPlatformWaitEventsTimeout(double timeout);
+
 /*! @copydoc glfwPostEmptyEvent
  *  @ingroup platform
  */
@@ -700,6 +724,12 @@ void _glfwInputWindowIconify(_GLFWwindow* window, int iconified);
  */
 void _glfwInputWindowDamage(_GLFWwindow* window);
 
+/*! @brief Notifies shared code that the last frame of a window was presented.
+ *  @param[in] window The window that received the event.
+ *  @ingroup event
+ */
+void _glfwInputWindowFrame(_GLFWwindow* window);
+
 /*! @brief Notifies shared code of a window close request event
  *  @param[in] window The window that received the event.
  *  @ingroup event
@@ -33,6 +33,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/inotify.h>
+#include <sys/epoll.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <dirent.h>
@@ -40,6 +41,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+
+// Tags of the descriptors of the epoll set other than the joysticks, whose
+// tags are their indices
+#define _GLFW_EPOLL_INOTIFY  (GLFW_JOYSTICK_LAST + 1)
+#define _GLFW_EPOLL_PLATFORM (GLFW_JOYSTICK_LAST + 2)
 #endif // __linux__
 
 
@@ -101,16 +107,23 @@ static void openJoystickDevice(const char* path)
     _glfw.linux_js.js[joy].buttons = calloc(buttonCount, 1);
 
     _glfw.linux_js.js[joy].present = GL_TRUE;
+
+    if (_glfw.linux_js.epoll > 0)
+    {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u32 = joy;
+        epoll_ctl(_glfw.linux_js.epoll, EPOLL_CTL_ADD, fd, &event);
+    }
 #endif // __linux__
 }
 
-// Polls for and processes events for all present joysticks
+#if defined(__linux__)
+// Opens the joystick devices created since the last call
 //
-static void pollJoystickEvents(void)
+static void readInotifyEvents(void)
 {
-#if defined(__linux__)
-    int i;
-    struct js_event e;
     ssize_t offset = 0;
     char buffer[16384];
 
@@ -130,53 +143,116 @@ static void pollJoystickEvents(void)
 
         offset += sizeof(struct inotify_event) + e->len;
     }
+}
 
-    for (i = 0;  i <= GLFW_JOYSTICK_LAST;  i++)
-    {
-        if (!_glfw.linux_js.js[i].present)
-            continue;
+// Processes the queued events of the specified joystick
+//
+static void readJoystickEvents(int i)
+{
+    struct js_event e;
 
-        // Read all queued events (non-blocking)
-        for (;;)
+    if (!_glfw.linux_js.js[i].present)
+        return;
+
+    // Read all queued events (non-blocking)
+    for (;;)
+    {
+        errno = 0;
+        if (read(_glfw.linux_js.js[i].fd, &e, sizeof(e)) < 0)
         {
-            errno = 0;
-            if (read(_glfw.linux_js.js[i].fd, &e, sizeof(e)) < 0)
+            if (errno == ENODEV)
             {
-                if (errno == ENODEV)
-                {
-                    // The joystick was disconnected
+                // The joystick was disconnected
+                // Closing the descriptor also removes it from the epoll set
 
-                    free(_glfw.linux_js.js[i].axes);
-                    free(_glfw.linux_js.js[i].buttons);
-                    free(_glfw.linux_js.js[i].name);
-                    free(_glfw.linux_js.js[i].path);
+                close(_glfw.linux_js.js[i].fd);
+                free(_glfw.linux_js.js[i].axes);
+                free(_glfw.linux_js.js[i].buttons);
+                free(_glfw.linux_js.js[i].name);
+                free(_glfw.linux_js.js[i].path);
 
-                    memset(&_glfw.linux_js.js[i], 0, sizeof(_glfw.linux_js.js[i]));
-                }
+                memset(&_glfw.linux_js.js[i], 0, sizeof(_glfw.linux_js.js[i]));
+            }
 
+            break;
+        }
+
+        // We don't care if it's an init event or not
+        e.type &= ~JS_EVENT_INIT;
+
+        switch (e.type)
+        {
+            case JS_EVENT_AXIS:
+                _glfw.linux_js.js[i].axes[e.number] =
+                    (float) e.value / 32767.0f;
                 break;
-            }
 
-            // We don't care if it's an init event or not
-            e.type &= ~JS_EVENT_INIT;
+            case JS_EVENT_BUTTON:
+                _glfw.linux_js.js[i].buttons[e.number] =
+                    e.value ? GLFW_PRESS : GLFW_RELEASE;
+                break;
 
-            switch (e.type)
-            {
-                case JS_EVENT_AXIS:
-                    _glfw.linux_js.js[i].axes[e.number] =
-                        (float) e.value / 32767.0f;
-                    break;
-
-                case JS_EVENT_BUTTON:
-                    _glfw.linux_js.js[i].buttons[e.number] =
-                        e.value ? GLFW_PRESS : GLFW_RELEASE;
-                    break;
-
-                default:
-                    break;
-            }
+            default:
+                break;
         }
     }
+}
+
+// Waits up to timeout milliseconds, or forever if negative, for data on the
+// descriptors of the epoll set and processes the joystick events
+// Returns whether any joystick or device connection event was processed
+//
+static int waitJoystickEvents(int timeout)
+{
+    struct epoll_event events[GLFW_JOYSTICK_LAST + 3];
+    int i, count, processed = GL_FALSE;
+
+    // NOTE: Only retry on EINTR if there is no timeout, as with select
+    do
+    {
+        count = epoll_wait(_glfw.linux_js.epoll, events,
+                           sizeof(events) / sizeof(events[0]), timeout);
+    }
+    while (count == -1 && errno == EINTR && timeout < 0);
+
+    for (i = 0;  i < count;  i++)
+    {
+        const uint32_t tag = events[i].data.u32;
+
+        if (tag == _GLFW_EPOLL_PLATFORM)
+            continue;
+
+        if (tag == _GLFW_EPOLL_INOTIFY)
+            readInotifyEvents();
+        else
+            readJoystickEvents(tag);
+
+        processed = GL_TRUE;
+    }
+
+    return processed;
+}
+#endif // __linux__
+
+// Polls for and processes events for all present joysticks
+//
+static void pollJoystickEvents(void)
+{
+#if defined(__linux__)
+    int i;
+
+    // Only the descriptors with queued data are read, so polling is a single
+    // system call when no device changed
+    if (_glfw.linux_js.epoll > 0)
+    {
+        waitJoystickEvents(0);
+        return;
+    }
+
+    readInotifyEvents();
+
+    for (i = 0;  i <= GLFW_JOYSTICK_LAST;  i++)
+        readJoystickEvents(i);
 #endif // __linux__
 }
 
@@ -193,6 +269,15 @@ int _glfwInitJoysticks(void)
     const char* dirname = "/dev/input";
     DIR* dir;
 
+    _glfw.linux_js.epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (_glfw.linux_js.epoll == -1)
+    {
+        _glfwInputError(GLFW_PLATFORM_ERROR,
+                        "Linux: Failed to create epoll set: %s",
+                        strerror(errno));
+        // Continue reading every descriptor on every poll
+    }
+
     _glfw.linux_js.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
     if (_glfw.linux_js.inotify == -1)
     {
@@ -216,6 +301,15 @@ int _glfwInitJoysticks(void)
                         strerror(errno));
         // Continue without device connection notifications
     }
+    else if (_glfw.linux_js.epoll > 0)
+    {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u32 = _GLFW_EPOLL_INOTIFY;
+        epoll_ctl(_glfw.linux_js.epoll, EPOLL_CTL_ADD,
+                  _glfw.linux_js.inotify, &event);
+    }
 
     if (regcomp(&_glfw.linux_js.regex, "^js[0-9]\\+$", 0) != 0)
     {
@@ -284,9 +378,47 @@ void _glfwTerminateJoysticks(void)
 
         close(_glfw.linux_js.inotify);
     }
+
+    if (_glfw.linux_js.epoll > 0)
+        close(_glfw.linux_js.epoll);
 #endif // __linux__
 }
 
+// Adds a descriptor of the platform, e.g. the display connection, to the set
+// waited on by _glfwWaitJoystickEvents
+// Returns whether the descriptor was added
+//
+int _glfwAddJoystickWaitFd(int fd)
+{
+#if defined(__linux__)
+    struct epoll_event event;
+
+    if (_glfw.linux_js.epoll <= 0)
+        return GL_FALSE;
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = _GLFW_EPOLL_PLATFORM;
+    return epoll_ctl(_glfw.linux_js.epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+#else
+    return GL_FALSE;
+#endif // __linux__
+}
+
+// Waits up to timeout milliseconds, or forever if negative, for data on the
+// joysticks or on the descriptors added with _glfwAddJoystickWaitFd
+// Returns whether the wait ended with joystick input, which is processed
+//
+int _glfwWaitJoystickEvents(int timeout)
+{
+#if defined(__linux__)
+    if (_glfw.linux_js.epoll > 0)
+        return waitJoystickEvents(timeout);
+#endif // __linux__
+
+    return GL_FALSE;
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 //////                       GLFW platform API                      //////
@@ -53,11 +53,15 @@ typedef struct _GLFWjoystickLinux
     int             inotify;
     int             watch;
     regex_t         regex;
+    // Set of the inotify, joystick and platform descriptors
+    int             epoll;
 #endif /*__linux__*/
 } _GLFWjoystickLinux;
 
 
 int _glfwInitJoysticks(void);
 void _glfwTerminateJoysticks(void);
+int _glfwAddJoystickWaitFd(int fd);
+int _glfwWaitJoystickEvents(int timeout);
 
 #endif // _glfw3_linux_joystick_h_
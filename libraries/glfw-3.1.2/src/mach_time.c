@@ -49,6 +49,7 @@ void _glfwInitTimer(void)
     mach_timebase_info(&info);
 
     _glfw.ns_time.resolution = (double) info.numer / (info.denom * 1.0e9);
+    _glfw.ns_time.frequency = (uint64_t) ((info.denom * 1e9) / info.numer);
     _glfw.ns_time.base = getRawTime();
 }
 
@@ -69,3 +70,13 @@ void _glfwPlatformSetTime(double time)
         (uint64_t) (time / _glfw.ns_time.resolution);
 }
 
+uint64_t _glfwPlatformGetTimerValue(void)
+{
+    return getRawTime();
+}
+
+uint64_t _glfwPlatformGetTimerFrequency(void)
+{
+    return _glfw.ns_time.frequency;
+}
+
@@ -29,6 +29,7 @@
 #include <linux/input.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 
 typedef struct EventNode
@@ -637,6 +638,30 @@ void _glfwPlatformWaitEvents(void)
     _glfwPlatformPollEvents();
 }
 
+void _glfwPlatformWaitEventsTimeout(double timeout)
+{
+    struct timespec deadline;
+    const long seconds = (long) timeout;
+    const long nanoseconds = (long) ((timeout - seconds) * 1e9);
+
+    // The condition variable uses the default realtime clock
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += seconds + (deadline.tv_nsec + nanoseconds) / 1000000000;
+    deadline.tv_nsec = (deadline.tv_nsec + nanoseconds) % 1000000000;
+
+    pthread_mutex_lock(&_glfw.mir.event_mutex);
+
+    if (emptyEventQueue(_glfw.mir.event_queue))
+    {
+        pthread_cond_timedwait(&_glfw.mir.event_cond, &_glfw.mir.event_mutex,
+                               &deadline);
+    }
+
+    pthread_mutex_unlock(&_glfw.mir.event_mutex);
+
+    _glfwPlatformPollEvents();
+}
+
 void _glfwPlatformPostEmptyEvent(void)
 {
 }
@@ -68,11 +68,13 @@ void _glfwInitTimer(void)
     {
         _glfw.posix_time.monotonic = GL_TRUE;
         _glfw.posix_time.resolution = 1e-9;
+        _glfw.posix_time.frequency = 1000000000;
     }
     else
 #endif
     {
         _glfw.posix_time.resolution = 1e-6;
+        _glfw.posix_time.frequency = 1000000;
     }
 
     _glfw.posix_time.base = getRawTime();
@@ -95,3 +97,13 @@ void _glfwPlatformSetTime(double time)
         (uint64_t) (time / _glfw.posix_time.resolution);
 }
 
+uint64_t _glfwPlatformGetTimerValue(void)
+{
+    return getRawTime();
+}
+
+uint64_t _glfwPlatformGetTimerFrequency(void)
+{
+    return _glfw.posix_time.frequency;
+}
+
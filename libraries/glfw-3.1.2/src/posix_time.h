@@ -39,6 +39,7 @@ typedef struct _GLFWtimePOSIX
 {
     GLboolean   monotonic;
     double      resolution;
+    uint64_t    frequency;
     uint64_t    base;
 
 } _GLFWtimePOSIX;
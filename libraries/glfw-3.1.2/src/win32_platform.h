@@ -224,6 +224,7 @@ typedef struct _GLFWtimeWin32
 {
     GLboolean           hasPC;
     double              resolution;
+    unsigned __int64    frequency;
     unsigned __int64    base;
 
 } _GLFWtimeWin32;
@@ -57,11 +57,13 @@ void _glfwInitTimer(void)
     {
         _glfw.win32_time.hasPC = GL_TRUE;
         _glfw.win32_time.resolution = 1.0 / (double) frequency;
+        _glfw.win32_time.frequency = frequency;
     }
     else
     {
         _glfw.win32_time.hasPC = GL_FALSE;
         _glfw.win32_time.resolution = 0.001; // winmm resolution is 1 ms
+        _glfw.win32_time.frequency = 1000;
     }
 
     _glfw.win32_time.base = getRawTime();
@@ -84,3 +86,13 @@ void _glfwPlatformSetTime(double time)
         (unsigned __int64) (time / _glfw.win32_time.resolution);
 }
 
+uint64_t _glfwPlatformGetTimerValue(void)
+{
+    return (uint64_t) getRawTime();
+}
+
+uint64_t _glfwPlatformGetTimerFrequency(void)
+{
+    return (uint64_t) _glfw.win32_time.frequency;
+}
+
@@ -30,6 +30,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <float.h>
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -100,6 +101,12 @@ void _glfwInputWindowDamage(_GLFWwindow* window)
         window->callbacks.refresh((GLFWwindow*) window);
 }
 
+void _glfwInputWindowFrame(_GLFWwindow* window)
+{
+    if (window->callbacks.frame)
+        window->callbacks.frame((GLFWwindow*) window);
+}
+
 void _glfwInputWindowCloseRequest(_GLFWwindow* window)
 {
     window->closed = GL_TRUE;
@@ -390,6 +397,9 @@ GLFWAPI void glfwDestroyWindow(GLFWwindow* handle)
 
     _glfwPlatformDestroyWindow(window);
 
+    free(window->extensions.names);
+    free(window->extensions.slots);
+
     // Unlink window from global linked list
     {
         _GLFWwindow** prev = &_glfw.windowListHead;
@@ -652,6 +662,15 @@ GLFWAPI GLFWwindowrefreshfun glfwSetWindowRefreshCallback(GLFWwindow* handle,
     return cbfun;
 }
 
+GLFWAPI GLFWwindowframefun glfwSetWindowFrameCallback(GLFWwindow* handle,
+                                                      GLFWwindowframefun cbfun)
+{
+    _GLFWwindow* window = (_GLFWwindow*) handle;
+    _GLFW_REQUIRE_INIT_OR_RETURN(NULL);
+    _GLFW_SWAP_POINTERS(window->callbacks.frame, cbfun);
+    return cbfun;
+}
+
 GLFWAPI GLFWwindowfocusfun glfwSetWindowFocusCallback(GLFWwindow* handle,
                                                       GLFWwindowfocusfun cbfun)
 {
@@ -695,6 +714,22 @@ GLFWAPI void glfwWaitEvents(void)
     _glfwPlatformWaitEvents();
 }
 
+GLFWAPI void glfwWaitEventsTimeout(double timeout)
+{
+    _GLFW_REQUIRE_INIT();
+
+    if (timeout != timeout || timeout < 0.0 || timeout > DBL_MAX)
+    {
+        _glfwInputError(GLFW_INVALID_VALUE, "Invalid time %f", timeout);
+        return;
+    }
+
+    if (!_glfw.windowListHead)
+        return;
+
+    _glfwPlatformWaitEventsTimeout(timeout);
+}
+
 GLFWAPI void glfwPostEmptyEvent(void)
 {
     _GLFW_REQUIRE_INIT();
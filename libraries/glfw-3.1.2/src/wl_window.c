@@ -72,6 +72,54 @@ static const struct wl_shell_surface_listener shellSurfaceListener = {
     handlePopupDone
 };
 
+static void handleFrameDone(void* data,
+                            struct wl_callback* callback,
+                            uint32_t time);
+
+static const struct wl_callback_listener frameListener = {
+    handleFrameDone
+};
+
+// Requests a frame event for the next commit of the surface, i.e. the next
+// buffer swap, as the request is part of the pending state of the surface
+//
+static void requestFrame(_GLFWwindow* window)
+{
+    window->wl.callback = wl_surface_frame(window->wl.surface);
+    wl_callback_add_listener(window->wl.callback, &frameListener, window);
+}
+
+// The compositor sends the frame event once it showed the commit, and not
+// while the surface is hidden or occluded
+//
+static void handleFrameDone(void* data,
+                            struct wl_callback* callback,
+                            uint32_t time)
+{
+    _GLFWwindow* window = data;
+
+    wl_callback_destroy(callback);
+    requestFrame(window);
+    _glfwInputWindowFrame(window);
+}
+
+// Marks the whole surface as opaque, so that the compositor neither blends it
+// nor needs to keep what is below it, and can scan out its buffers directly
+// when it covers an output
+//
+static void setOpaqueRegion(_GLFWwindow* window)
+{
+    struct wl_region* region;
+
+    region = wl_compositor_create_region(_glfw.wl.compositor);
+    if (!region)
+        return;
+
+    wl_region_add(region, 0, 0, window->wl.width, window->wl.height);
+    wl_surface_set_opaque_region(window->wl.surface, region);
+    wl_region_destroy(region);
+}
+
 static GLboolean createSurface(_GLFWwindow* window,
                                const _GLFWwndconfig* wndconfig)
 {
@@ -99,6 +147,9 @@ static GLboolean createSurface(_GLFWwindow* window,
     window->wl.width = wndconfig->width;
     window->wl.height = wndconfig->height;
 
+    setOpaqueRegion(window);
+    requestFrame(window);
+
     return GL_TRUE;
 }
 
@@ -224,10 +275,17 @@ int _glfwPlatformCreateWindow(_GLFWwindow* window,
 
     if (wndconfig->monitor)
     {
+        GLFWvidmode mode;
+
+        // The driver method asks the compositor to switch the output to the
+        // size and rate of the surface instead of scaling it, so that the
+        // buffers can be scanned out directly without a composition pass
+        _glfwPlatformGetVideoMode(wndconfig->monitor, &mode);
+
         wl_shell_surface_set_fullscreen(
             window->wl.shell_surface,
-            WL_SHELL_SURFACE_FULLSCREEN_METHOD_DEFAULT,
-            0,
+            WL_SHELL_SURFACE_FULLSCREEN_METHOD_DRIVER,
+            mode.refreshRate * 1000,
             wndconfig->monitor->wl.output);
     }
     else
@@ -255,6 +313,9 @@ void _glfwPlatformDestroyWindow(_GLFWwindow* window)
 
     _glfwDestroyContext(window);
 
+    if (window->wl.callback)
+        wl_callback_destroy(window->wl.callback);
+
     if (window->wl.native)
         wl_egl_window_destroy(window->wl.native);
 
@@ -300,6 +361,8 @@ void _glfwPlatformSetWindowSize(_GLFWwindow* window, int width, int height)
     wl_egl_window_resize(window->wl.native, width, height, 0, 0);
     window->wl.width = width;
     window->wl.height = height;
+
+    setOpaqueRegion(window);
 }
 
 void _glfwPlatformGetFramebufferSize(_GLFWwindow* window, int* width, int* height)
@@ -372,6 +435,11 @@ void _glfwPlatformWaitEvents(void)
     handleEvents(-1);
 }
 
+void _glfwPlatformWaitEventsTimeout(double timeout)
+{
+    handleEvents((int) (timeout * 1e3));
+}
+
 void _glfwPlatformPostEmptyEvent(void)
 {
     wl_display_sync(_glfw.wl.display);
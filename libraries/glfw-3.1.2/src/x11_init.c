@@ -34,7 +34,41 @@
 #include <limits.h>
 #include <stdio.h>
 #include <locale.h>
+#include <fcntl.h>
+#include <unistd.h>
 
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+
+// Create the descriptors signaled by glfwPostEmptyEvent
+//
+static GLboolean createEmptyEventFds(void)
+{
+#if defined(__linux__)
+    const int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1)
+        return GL_FALSE;
+
+    _glfw.x11.emptyEventFds[0] = fd;
+    _glfw.x11.emptyEventFds[1] = fd;
+#else
+    int i;
+
+    if (pipe(_glfw.x11.emptyEventFds) != 0)
+        return GL_FALSE;
+
+    for (i = 0;  i < 2;  i++)
+    {
+        const int fd = _glfw.x11.emptyEventFds[i];
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, fcntl(fd, F_GETFD, 0) | FD_CLOEXEC);
+    }
+#endif
+
+    return GL_TRUE;
+}
 
 // Translate an X11 key code to a GLFW key code.
 //
@@ -455,8 +489,6 @@ static void detectEWMH(void)
         getSupportedAtom(supportedAtoms, atomCount, "_NET_FRAME_EXTENTS");
     _glfw.x11.NET_REQUEST_FRAME_EXTENTS =
         getSupportedAtom(supportedAtoms, atomCount, "_NET_REQUEST_FRAME_EXTENTS");
-    _glfw.x11.NET_WM_BYPASS_COMPOSITOR =
-        getSupportedAtom(supportedAtoms, atomCount, "_NET_WM_BYPASS_COMPOSITOR");
 
     XFree(supportedAtoms);
 }
@@ -477,6 +509,11 @@ static GLboolean initExtensions(void)
                                            "_MOTIF_WM_HINTS",
                                            False);
 
+    // Compositors honor this hint without listing it in _NET_SUPPORTED, and
+    // it lets them unredirect full screen windows, so it is always created
+    _glfw.x11.NET_WM_BYPASS_COMPOSITOR =
+        XInternAtom(_glfw.x11.display, "_NET_WM_BYPASS_COMPOSITOR", False);
+
 #if defined(_GLFW_HAS_XF86VM)
     // Check for XF86VidMode extension
     _glfw.x11.vidmode.available =
@@ -766,6 +803,27 @@ int _glfwPlatformInit(void)
     if (!_glfwInitJoysticks())
         return GL_FALSE;
 
+    // Share the wait for events with the joysticks, so that joystick input
+    // also wakes up glfwWaitEvents
+    _glfw.x11.joystickWait =
+        _glfwAddJoystickWaitFd(ConnectionNumber(_glfw.x11.display));
+
+    // Empty events wake up the wait through a descriptor instead of a
+    // client message, so posting them needs neither Xlib nor its lock
+    if (createEmptyEventFds())
+    {
+        if (_glfw.x11.joystickWait &&
+            !_glfwAddJoystickWaitFd(_glfw.x11.emptyEventFds[0]))
+        {
+            _glfw.x11.joystickWait = GL_FALSE;
+        }
+    }
+    else
+    {
+        _glfw.x11.emptyEventFds[0] = -1;
+        _glfw.x11.emptyEventFds[1] = -1;
+    }
+
     _glfwInitTimer();
 
     return GL_TRUE;
@@ -789,6 +847,13 @@ void _glfwPlatformTerminate(void)
 
     _glfwTerminateJoysticks();
 
+    if (_glfw.x11.emptyEventFds[0] > 0)
+    {
+        close(_glfw.x11.emptyEventFds[0]);
+        if (_glfw.x11.emptyEventFds[1] != _glfw.x11.emptyEventFds[0])
+            close(_glfw.x11.emptyEventFds[1]);
+    }
+
     if (_glfw.x11.display)
     {
         XCloseDisplay(_glfw.x11.display);
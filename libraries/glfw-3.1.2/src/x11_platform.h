@@ -117,6 +117,18 @@ typedef struct _GLFWlibraryX11
     Cursor          cursor;
     // Context for mapping window XIDs to _GLFWwindow pointers
     XContext        context;
+    // Most recently looked up window XID and its _GLFWwindow pointer
+    Window          lastHandle;
+    _GLFWwindow*    lastWindow;
+    // Window whose cursor is disabled and grabbed, if any
+    _GLFWwindow*    disabledCursorWindow;
+    // Whether the connection is waited on with the joysticks
+    GLboolean       joystickWait;
+    // Read and write ends of the wakeup of glfwPostEmptyEvent, the same
+    // eventfd on Linux and a pipe elsewhere
+    int             emptyEventFds[2];
+    // Whether an empty event was consumed outside of glfwWaitEvents
+    GLboolean       emptyEventPosted;
     // XIM input method
     XIM             im;
     // Most recent error code received by X error handler
@@ -49,16 +49,55 @@
 #define Button7            7
 
 
+// Consumes the pending wakeups posted by glfwPostEmptyEvent
+// Returns whether there were any
+//
+static int readEmptyEvents(void)
+{
+    uint64_t value;
+    int posted = GL_FALSE;
+
+    if (_glfw.x11.emptyEventFds[0] <= 0)
+        return GL_FALSE;
+
+    while (read(_glfw.x11.emptyEventFds[0], &value, sizeof(value)) > 0)
+        posted = GL_TRUE;
+
+    // Waits for other events may consume the wakeup, so it is remembered for
+    // the next glfwWaitEvents
+    if (posted)
+        _glfw.x11.emptyEventPosted = GL_TRUE;
+
+    return posted;
+}
+
 // Wait for data to arrive
+// Returns whether the wait ended with joystick input or an empty event
 //
-void selectDisplayConnection(struct timeval* timeout)
+int selectDisplayConnection(struct timeval* timeout)
 {
     fd_set fds;
-    int result;
+    int result, joystick;
     const int fd = ConnectionNumber(_glfw.x11.display);
+    const int emptyEventFd = _glfw.x11.emptyEventFds[0];
+
+    if (_glfw.x11.joystickWait)
+    {
+        int milliseconds = -1;
+        if (timeout)
+        {
+            milliseconds = (int) (timeout->tv_sec * 1000 +
+                                  (timeout->tv_usec + 999) / 1000);
+        }
+
+        joystick = _glfwWaitJoystickEvents(milliseconds);
+        return readEmptyEvents() || joystick;
+    }
 
     FD_ZERO(&fds);
     FD_SET(fd, &fds);
+    if (emptyEventFd > 0)
+        FD_SET(emptyEventFd, &fds);
 
     // NOTE: We use select instead of an X function like XNextEvent, as the
     //       wait inside those are guarded by the mutex protecting the display
@@ -68,9 +107,12 @@ void selectDisplayConnection(struct timeval* timeout)
     // TODO: Update timeout value manually
     do
     {
-        result = select(fd + 1, &fds, NULL, NULL, timeout);
+        result = select((fd > emptyEventFd ? fd : emptyEventFd) + 1,
+                        &fds, NULL, NULL, timeout);
     }
     while (result == -1 && errno == EINTR && timeout == NULL);
+
+    return readEmptyEvents();
 }
 
 // Returns whether the window is iconified
@@ -164,6 +206,10 @@ static _GLFWwindow* findWindowByHandle(Window handle)
 {
     _GLFWwindow* window;
 
+    // Consecutive events usually target the same window
+    if (handle && handle == _glfw.x11.lastHandle)
+        return _glfw.x11.lastWindow;
+
     if (XFindContext(_glfw.x11.display,
                      handle,
                      _glfw.x11.context,
@@ -172,9 +218,37 @@ static _GLFWwindow* findWindowByHandle(Window handle)
         return NULL;
     }
 
+    _glfw.x11.lastHandle = handle;
+    _glfw.x11.lastWindow = window;
     return window;
 }
 
+// Returns whether the specified motion event can be dropped in favor of the
+// next queued event
+//
+static GLboolean isMotionCoalescable(const XEvent* event, int queued)
+{
+    XEvent next;
+    _GLFWwindow* window;
+
+    if (!queued)
+        return GL_FALSE;
+
+    XPeekEvent(_glfw.x11.display, &next);
+    if (next.type != MotionNotify ||
+        next.xmotion.window != event->xmotion.window)
+        return GL_FALSE;
+
+    window = findWindowByHandle(event->xmotion.window);
+    if (window == NULL)
+        return GL_TRUE;
+
+    // The motion caused by a warp updates the reference of the disabled
+    // cursor deltas, so it must be processed
+    return event->xmotion.x != window->x11.warpPosX ||
+           event->xmotion.y != window->x11.warpPosY;
+}
+
 // Sends an EWMH or ICCCM event to the window manager
 //
 static void sendEventToWM(_GLFWwindow* window, Atom type,
@@ -502,10 +576,57 @@ static GLboolean createWindow(_GLFWwindow* window,
     return GL_TRUE;
 }
 
+// Returns whether the motion of the disabled cursor of the specified window is
+// reported by XInput2 raw motion events
+//
+static GLboolean usesRawMotion(_GLFWwindow* window)
+{
+#if defined(_GLFW_HAS_XINPUT)
+    return _glfw.x11.xi.available && _glfw.x11.disabledCursorWindow == window;
+#else
+    return GL_FALSE;
+#endif /*_GLFW_HAS_XINPUT*/
+}
+
+// Selects or deselects XInput2 raw motion events on the root window
+//
+static void selectRawMotion(GLboolean enabled)
+{
+#if defined(_GLFW_HAS_XINPUT)
+    if (_glfw.x11.xi.available)
+    {
+        // Raw events are only delivered to the root window
+
+        XIEventMask eventmask;
+        unsigned char mask[XIMaskLen(XI_RawMotion)] = { 0 };
+
+        eventmask.deviceid = XIAllMasterDevices;
+        eventmask.mask_len = sizeof(mask);
+        eventmask.mask = mask;
+        if (enabled)
+            XISetMask(mask, XI_RawMotion);
+
+        XISelectEvents(_glfw.x11.display, _glfw.x11.root, &eventmask, 1);
+    }
+#endif /*_GLFW_HAS_XINPUT*/
+}
+
+// Stops reporting the raw motion of the disabled cursor of the window
+//
+static void releaseDisabledCursor(_GLFWwindow* window)
+{
+    if (_glfw.x11.disabledCursorWindow != window)
+        return;
+
+    selectRawMotion(GL_FALSE);
+    _glfw.x11.disabledCursorWindow = NULL;
+}
+
 // Hide the mouse cursor
 //
 static void hideCursor(_GLFWwindow* window)
 {
+    releaseDisabledCursor(window);
     XUngrabPointer(_glfw.x11.display, CurrentTime);
     XDefineCursor(_glfw.x11.display, window->x11.handle, _glfw.x11.cursor);
 }
@@ -518,12 +639,21 @@ static void disableCursor(_GLFWwindow* window)
                  ButtonPressMask | ButtonReleaseMask | PointerMotionMask,
                  GrabModeAsync, GrabModeAsync,
                  window->x11.handle, _glfw.x11.cursor, CurrentTime);
+
+    // The relative motion is read from raw events when available, so the
+    // cursor does not need to be warped back to the center every poll
+    if (_glfw.x11.disabledCursorWindow != window)
+    {
+        _glfw.x11.disabledCursorWindow = window;
+        selectRawMotion(GL_TRUE);
+    }
 }
 
 // Restores the mouse cursor
 //
 static void restoreCursor(_GLFWwindow* window)
 {
+    releaseDisabledCursor(window);
     XUngrabPointer(_glfw.x11.display, CurrentTime);
 
     if (window->cursor)
@@ -770,6 +900,9 @@ static void enterFullscreenMode(_GLFWwindow* window)
 
     if (_glfw.x11.NET_WM_BYPASS_COMPOSITOR)
     {
+        // Ask the compositor to unredirect the window, so that its buffers
+        // are presented directly instead of being copied into the composited
+        // frame, which saves a frame of latency
         const unsigned long value = 1;
 
         XChangeProperty(_glfw.x11.display,  window->x11.handle,
@@ -833,6 +966,13 @@ static void leaveFullscreenMode(_GLFWwindow* window)
 {
     _glfwRestoreVideoMode(window->monitor);
 
+    // Let the compositor redirect the window again
+    if (_glfw.x11.NET_WM_BYPASS_COMPOSITOR)
+    {
+        XDeleteProperty(_glfw.x11.display, window->x11.handle,
+                        _glfw.x11.NET_WM_BYPASS_COMPOSITOR);
+    }
+
     _glfw.x11.saver.count--;
 
     if (_glfw.x11.saver.count == 0)
@@ -1132,7 +1272,7 @@ static void processEvent(XEvent *event)
 
                 if (window->cursorMode == GLFW_CURSOR_DISABLED)
                 {
-                    if (_glfw.cursorWindow != window)
+                    if (_glfw.cursorWindow != window || usesRawMotion(window))
                         return;
 
                     _glfwInputCursorMotion(window,
@@ -1408,8 +1548,9 @@ static void processEvent(XEvent *event)
                 {
                     XIDeviceEvent* data = (XIDeviceEvent*) event->xcookie.data;
 
+                    // The raw motion events report the disabled cursor
                     window = findWindowByHandle(data->event);
-                    if (window)
+                    if (window && !usesRawMotion(window))
                     {
                         if (data->event_x != window->x11.warpPosX ||
                             data->event_y != window->x11.warpPosY)
@@ -1439,6 +1580,26 @@ static void processEvent(XEvent *event)
                         window->x11.cursorPosY = data->event_y;
                     }
                 }
+                else if (event->xcookie.evtype == XI_RawMotion)
+                {
+                    XIRawEvent* data = (XIRawEvent*) event->xcookie.data;
+
+                    window = _glfw.x11.disabledCursorWindow;
+                    if (window && data->valuators.mask_len)
+                    {
+                        // The raw values are the unaccelerated deltas of the
+                        // valuators present in the mask
+                        const double* values = data->raw_values;
+                        double x = 0.0, y = 0.0;
+
+                        if (XIMaskIsSet(data->valuators.mask, 0))
+                            x = *values++;
+                        if (XIMaskIsSet(data->valuators.mask, 1))
+                            y = *values;
+
+                        _glfwInputCursorMotion(window, x, y);
+                    }
+                }
             }
 
             XFreeEventData(_glfw.x11.display, &event->xcookie);
@@ -1537,6 +1698,12 @@ void _glfwPlatformDestroyWindow(_GLFWwindow* window)
         }
 
         XDeleteContext(_glfw.x11.display, window->x11.handle, _glfw.x11.context);
+        if (_glfw.x11.lastHandle == window->x11.handle)
+        {
+            _glfw.x11.lastHandle = (Window) 0;
+            _glfw.x11.lastWindow = NULL;
+        }
+        releaseDisabledCursor(window);
         XUnmapWindow(_glfw.x11.display, window->x11.handle);
         XDestroyWindow(_glfw.x11.display, window->x11.handle);
         window->x11.handle = (Window) 0;
@@ -1809,28 +1976,76 @@ int _glfwPlatformWindowVisible(_GLFWwindow* window)
 
 void _glfwPlatformPollEvents(void)
 {
-    int count = XPending(_glfw.x11.display);
+    // Read whatever the server has sent once, then drain the queue without
+    // flushing or reading the connection for every event
+    int count = XEventsQueued(_glfw.x11.display, QueuedAfterReading);
     while (count--)
     {
         XEvent event;
         XNextEvent(_glfw.x11.display, &event);
+
+        // Only the last of consecutive motions of a window is reported, as
+        // the intermediate positions add nothing to the final position or
+        // to the sum of the deltas of a disabled cursor
+        if (event.type == MotionNotify && isMotionCoalescable(&event, count))
+            continue;
+
         processEvent(&event);
     }
 
     _GLFWwindow* window = _glfw.cursorWindow;
-    if (window && window->cursorMode == GLFW_CURSOR_DISABLED)
+    if (window && window->cursorMode == GLFW_CURSOR_DISABLED &&
+        !usesRawMotion(window))
     {
         int width, height;
         _glfwPlatformGetWindowSize(window, &width, &height);
         _glfwPlatformSetCursorPos(window, width / 2, height / 2);
     }
+
+    // Send the requests made while processing the events
+    XFlush(_glfw.x11.display);
 }
 
 void _glfwPlatformWaitEvents(void)
 {
-    while (!XPending(_glfw.x11.display))
-        selectDisplayConnection(NULL);
+    while (!XPending(_glfw.x11.display) && !_glfw.x11.emptyEventPosted)
+    {
+        // Joystick input also ends the wait
+        if (selectDisplayConnection(NULL))
+            break;
+    }
 
+    _glfw.x11.emptyEventPosted = GL_FALSE;
+    _glfwPlatformPollEvents();
+}
+
+void _glfwPlatformWaitEventsTimeout(double timeout)
+{
+    // The raw timer is not affected by glfwSetTime
+    const uint64_t frequency = _glfwPlatformGetTimerFrequency();
+    const uint64_t deadline = _glfwPlatformGetTimerValue() +
+                              (uint64_t) (timeout * frequency);
+
+    while (!XPending(_glfw.x11.display) && !_glfw.x11.emptyEventPosted)
+    {
+        struct timeval tv;
+        double remaining;
+        const uint64_t now = _glfwPlatformGetTimerValue();
+
+        if (now >= deadline)
+            break;
+
+        // The remainder is recomputed, as select need not update it
+        remaining = (double) (deadline - now) / frequency;
+        tv.tv_sec = (time_t) remaining;
+        tv.tv_usec = (suseconds_t) ((remaining - tv.tv_sec) * 1e6);
+
+        // Joystick input also ends the wait
+        if (selectDisplayConnection(&tv))
+            break;
+    }
+
+    _glfw.x11.emptyEventPosted = GL_FALSE;
     _glfwPlatformPollEvents();
 }
 
@@ -1839,6 +2054,19 @@ void _glfwPlatformPostEmptyEvent(void)
     XEvent event;
     _GLFWwindow* window = _glfw.windowListHead;
 
+    if (_glfw.x11.emptyEventFds[1] > 0)
+    {
+        // A write is async-signal-safe and takes no lock, so any thread may
+        // post while the main thread waits
+        const uint64_t value = 1;
+        while (write(_glfw.x11.emptyEventFds[1], &value, sizeof(value)) == -1 &&
+               errno == EINTR)
+        {
+        }
+
+        return;
+    }
+
     memset(&event, 0, sizeof(event));
     event.type = ClientMessage;
     event.xclient.window = window->x11.handle;
@@ -0,0 +1,188 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "lz4_block.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace wvu {
+namespace {
+// The LZ4 block format: matches of 4 bytes or more, at most 65535 bytes back,
+// the last 5 bytes are literals, and the last match starts at least 12 bytes
+// before the end.
+constexpr int kLz4MinMatch = 4;
+constexpr int kLz4MaxOffset = 65535;
+constexpr int kLz4LastLiterals = 5;
+constexpr int kLz4MatchSafety = 12;
+constexpr int kLz4HashBits = 14;
+
+uint32_t Read32(const uint8_t* bytes) {
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+// Appends a length of 15 or more past its nibble, in runs of 255.
+void AppendLength(size_t length, std::vector<uint8_t>* compressed) {
+  while (length >= 255) {
+    compressed->push_back(255);
+    length -= 255;
+  }
+  compressed->push_back(length);
+}
+
+// Appends a sequence: the literals, and a match unless match_length is zero.
+void AppendSequence(const uint8_t* literals,
+                    const size_t num_literals,
+                    const size_t offset,
+                    const size_t match_length,
+                    std::vector<uint8_t>* compressed) {
+  const size_t match_code =
+      match_length > 0 ? match_length - kLz4MinMatch : 0;
+  compressed->push_back((std::min<size_t>(num_literals, 15) << 4) |
+                        std::min<size_t>(match_code, 15));
+  if (num_literals >= 15) AppendLength(num_literals - 15, compressed);
+  compressed->insert(compressed->end(), literals, literals + num_literals);
+  if (match_length == 0) return;
+  compressed->push_back(offset & 0xff);
+  compressed->push_back(offset >> 8);
+  if (match_code >= 15) AppendLength(match_code - 15, compressed);
+}
+
+// Reads the rest of a length of 15 or more. Returns false past the end.
+bool ReadLength(const uint8_t** bytes, const uint8_t* end, size_t* length) {
+  uint8_t byte;
+  do {
+    if (*bytes == end) return false;
+    byte = *(*bytes)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+}  // namespace
+
+Lz4BlockCompressor::Lz4BlockCompressor()
+    : positions_(1 << kLz4HashBits, -1) {}
+
+void Lz4BlockCompressor::Compress(const uint8_t* input,
+                                  const size_t size,
+                                  std::vector<uint8_t>* compressed) {
+  compressed->clear();
+  std::fill(positions_.begin(), positions_.end(), -1);
+  size_t anchor = 0;
+  if (size > kLz4MatchSafety) {
+    const size_t match_limit = size - kLz4MatchSafety;
+    const size_t match_end_limit = size - kLz4LastLiterals;
+    size_t position = 0;
+    while (position < match_limit) {
+      const uint32_t sequence = Read32(input + position);
+      const uint32_t hash =
+          (sequence * 2654435761u) >> (32 - kLz4HashBits);
+      const int32_t candidate = positions_[hash];
+      positions_[hash] = position;
+      if (candidate < 0 || position - candidate > kLz4MaxOffset ||
+          Read32(input + candidate) != sequence) {
+        ++position;
+        continue;
+      }
+      size_t match_length = kLz4MinMatch;
+      while (position + match_length < match_end_limit &&
+             input[candidate + match_length] ==
+                 input[position + match_length]) {
+        ++match_length;
+      }
+      AppendSequence(input + anchor, position - anchor, position - candidate,
+                     match_length, compressed);
+      position += match_length;
+      anchor = position;
+    }
+  }
+  AppendSequence(input + anchor, size - anchor, 0, 0, compressed);
+}
+
+bool DecompressLz4Block(const uint8_t* compressed,
+                        const size_t compressed_size,
+                        uint8_t* output,
+                        const size_t output_size) {
+  const uint8_t* bytes = compressed;
+  const uint8_t* end = compressed + compressed_size;
+  size_t position = 0;
+  while (bytes < end) {
+    const uint8_t token = *bytes++;
+    size_t num_literals = token >> 4;
+    if (num_literals == 15 && !ReadLength(&bytes, end, &num_literals)) {
+      return false;
+    }
+    if (static_cast<size_t>(end - bytes) < num_literals ||
+        output_size - position < num_literals) {
+      return false;
+    }
+    std::memcpy(output + position, bytes, num_literals);
+    bytes += num_literals;
+    position += num_literals;
+    // The last sequence has no match.
+    if (bytes == end) break;
+    if (end - bytes < 2) return false;
+    const size_t offset = bytes[0] | (bytes[1] << 8);
+    bytes += 2;
+    size_t match_length = token & 15;
+    if (match_length == 15 && !ReadLength(&bytes, end, &match_length)) {
+      return false;
+    }
+    match_length += kLz4MinMatch;
+    if (offset == 0 || offset > position ||
+        output_size - position < match_length) {
+      return false;
+    }
+    // The match may overlap what it writes, e.g., a run, so it is copied
+    // forward byte by byte when it does.
+    const uint8_t* match = output + position - offset;
+    if (offset >= match_length) {
+      std::memcpy(output + position, match, match_length);
+    } else {
+      for (size_t i = 0; i < match_length; ++i) {
+        output[position + i] = match[i];
+      }
+    }
+    position += match_length;
+  }
+  return position == output_size;
+}
+
+}  // namespace wvu
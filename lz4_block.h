@@ -0,0 +1,73 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_LZ4_BLOCK_H_
+#define GLUTILS_LZ4_BLOCK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace wvu {
+// Compresses bytes into the LZ4 block format, which DecompressLz4Block(),
+// liblz4 and its ports decode. The compressor is greedy with one hash table of
+// recent positions: it trades ratio for speed, e.g., for streamed frames that
+// must leave within a few milliseconds.
+class Lz4BlockCompressor {
+ public:
+  Lz4BlockCompressor();
+  ~Lz4BlockCompressor() {}
+
+  // Replaces compressed with the block of the size bytes of input.
+  void Compress(const uint8_t* input,
+                const size_t size,
+                std::vector<uint8_t>* compressed);
+
+ private:
+  // The last position of every hash of 4 bytes, persistent between the calls.
+  std::vector<int32_t> positions_;
+};
+
+// Decompresses an LZ4 block into the output_size bytes of output. Returns
+// false if the block is corrupt or does not decompress to exactly output_size
+// bytes; never reads or writes out of the buffers.
+bool DecompressLz4Block(const uint8_t* compressed,
+                        const size_t compressed_size,
+                        uint8_t* output,
+                        const size_t output_size);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_LZ4_BLOCK_H_
@@ -0,0 +1,85 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "main_thread_queue.h"
+
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <GLFW/glfw3.h>
+
+namespace wvu {
+
+MainThreadQueue::MainThreadQueue() : head_(new Node), tail_(head_.load()) {
+  tail_->next.store(nullptr, std::memory_order_relaxed);
+}
+
+MainThreadQueue::~MainThreadQueue() {
+  while (tail_ != nullptr) {
+    Node* next = tail_->next.load(std::memory_order_relaxed);
+    delete tail_;
+    tail_ = next;
+  }
+}
+
+void MainThreadQueue::Post(std::function<void()> task) {
+  Node* node = new Node;
+  node->next.store(nullptr, std::memory_order_relaxed);
+  node->task = std::move(task);
+  Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+  previous->next.store(node, std::memory_order_release);
+  glfwPostEmptyEvent();
+}
+
+bool MainThreadQueue::Pop(std::function<void()>* task) {
+  Node* next = tail_->next.load(std::memory_order_acquire);
+  if (next == nullptr) return false;
+  // The next node becomes the sentinel once its task is taken.
+  *task = std::move(next->task);
+  delete tail_;
+  tail_ = next;
+  return true;
+}
+
+int MainThreadQueue::Dispatch() {
+  int num_tasks = 0;
+  std::function<void()> task;
+  while (Pop(&task)) {
+    task();
+    ++num_tasks;
+  }
+  return num_tasks;
+}
+
+}  // namespace wvu
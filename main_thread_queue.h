@@ -0,0 +1,97 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MAIN_THREAD_QUEUE_H_
+#define GLUTILS_MAIN_THREAD_QUEUE_H_
+
+#include <atomic>
+#include <functional>
+
+namespace wvu {
+// This class delivers tasks posted by any thread to the main thread, e.g., the
+// results of a simulation or loading thread that must touch the windows or the
+// OpenGL context. The tasks form an intrusive multiple producer, single
+// consumer list: posting exchanges the head of the list and links the previous
+// head without locks, and every post wakes up glfwWaitEvents() with
+// glfwPostEmptyEvent(), so a main thread waiting for input also wakes up for
+// the tasks. The tasks of one thread run in the order they were posted.
+//
+// Example:
+//
+// wvu::MainThreadQueue main_thread_queue;
+// std::thread loader([&]() {
+//   ...  // Load the model.
+//   main_thread_queue.Post([&]() { scene.Add(model); });
+// });
+// while (...) {  // Rendering loop.
+//   glfwWaitEvents();
+//   main_thread_queue.Dispatch();
+//   ...  // Render the frame.
+// }
+class MainThreadQueue {
+ public:
+  MainThreadQueue();
+  // Deletes the tasks that were not dispatched, without running them.
+  ~MainThreadQueue();
+
+  // Posts a task to run on the main thread. May be called from any thread, as
+  // long as GLFW is initialized.
+  void Post(std::function<void()> task);
+
+  // Runs the posted tasks. Must only be called by the main thread. Returns the
+  // number of tasks run.
+  int Dispatch();
+
+ private:
+  struct Node {
+    std::atomic<Node*> next;
+    std::function<void()> task;
+  };
+
+  // Removes the oldest task. Returns false if the list is empty, or if a post
+  // has exchanged the head but not linked its node yet.
+  bool Pop(std::function<void()>* task);
+
+  // Newest node, exchanged by the posts.
+  std::atomic<Node*> head_;
+  // Oldest node, whose task already ran. Only used by the main thread.
+  Node* tail_;
+
+  MainThreadQueue(const MainThreadQueue&) = delete;
+  MainThreadQueue& operator=(const MainThreadQueue&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MAIN_THREAD_QUEUE_H_
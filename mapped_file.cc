@@ -0,0 +1,103 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mapped_file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define WVU_HAS_MMAP
+#endif
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "huge_pages.h"
+
+namespace wvu {
+
+MappedFile::MappedFile() : data_(""), size_(0), mapped_(false) {}
+
+MappedFile::~MappedFile() {
+#ifdef WVU_HAS_MMAP
+  if (mapped_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+#endif
+}
+
+bool MappedFile::Open(const std::string& filepath) {
+  if (mapped_ || !filepath_.empty()) return false;
+#ifdef WVU_HAS_MMAP
+  const int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat file_status;
+  if (fstat(fd, &file_status) != 0) {
+    close(fd);
+    return false;
+  }
+  size_ = static_cast<size_t>(file_status.st_size);
+  // Empty files cannot be mapped, but they are valid files.
+  if (size_ > 0) {
+    void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      size_ = 0;
+      return false;
+    }
+    data_ = static_cast<const char*>(mapping);
+    mapped_ = true;
+    // Large assets are read through fewer TLB entries, where the kernel maps
+    // the page cache of the file system with huge pages.
+    AdviseHugePages(mapping, size_);
+  }
+  // The mapping stays valid after closing the file descriptor.
+  close(fd);
+#else
+  std::ifstream in(filepath, std::ios::binary);
+  if (!in.is_open()) return false;
+  buffer_.assign(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+  data_ = buffer_.empty() ? "" : buffer_.data();
+  size_ = buffer_.size();
+#endif
+  filepath_ = filepath;
+  return true;
+}
+
+}  // namespace wvu
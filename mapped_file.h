@@ -0,0 +1,103 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MAPPED_FILE_H_
+#define GLUTILS_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace wvu {
+// This class maps a file into memory for reading. The contents of the file are
+// accessed through data() without copying them into intermediate buffers; the
+// operating system pages them in on demand. On systems without mmap the class
+// reads the whole file into memory instead. Large mappings ask for transparent
+// huge pages when the process does (see huge_pages.h).
+// The mapping is released when the instance goes out of scope.
+//
+// Example:
+//
+// wvu::MappedFile mapped_file;
+// if (!mapped_file.Open("/absolute/path/to/file")) {
+//   LOG(ERROR) << "Could not map the file.";
+// }
+// Consume(mapped_file.data(), mapped_file.size());
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  // Maps the file at filepath. Returns true if successful, and false
+  // otherwise. A mapped file cannot be opened again.
+  // Parameters:
+  //   filepath  The path of the file to map.
+  bool Open(const std::string& filepath);
+
+  // Returns a pointer to the contents of the file. The contents are not
+  // NUL-terminated.
+  const char* data() const {
+    return data_;
+  }
+
+  // Returns the size of the file in bytes.
+  size_t size() const {
+    return size_;
+  }
+
+  // Returns the path of the mapped file.
+  const std::string& filepath() const {
+    return filepath_;
+  }
+
+ private:
+  // Disallow copies, since the mapping is owned by the instance.
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Path of the mapped file.
+  std::string filepath_;
+  // Pointer to the mapped contents.
+  const char* data_;
+  // Size of the file in bytes.
+  size_t size_;
+  // True if data_ points to a memory mapping.
+  bool mapped_;
+  // Contents of the file when the file cannot be mapped.
+  std::vector<char> buffer_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MAPPED_FILE_H_
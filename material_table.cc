@@ -0,0 +1,362 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "material_table.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "shader_program.h"
+#include "texture_source.h"
+
+namespace wvu {
+namespace {
+
+int LevelDimension(const int dimension, const int level) {
+  return std::max(dimension >> level, 1);
+}
+
+// Reads a level of a source, checking its size.
+bool ReadLevel(TextureSource* source,
+               const int level,
+               const GLubyte** data,
+               size_t* size) {
+  return source->GetLevel(level, data, size) &&
+      *size == TextureLevelSize(source->format(),
+                                LevelDimension(source->width(), level),
+                                LevelDimension(source->height(), level));
+}
+
+}  // namespace
+
+const char MaterialTable::kSamplerName[] = "material_array";
+const char MaterialTable::kBlockName[] = "MaterialHandles";
+
+MaterialTable::MaterialTable()
+    : bindless_(false), format_(TEXTURE_FORMAT_RGBA8), width_(0), height_(0),
+      num_levels_(0), max_num_materials_(0), num_materials_(0),
+      texture_array_id_(0), handle_buffer_id_(0), instance_buffer_id_(0),
+      instance_capacity_(0) {}
+
+MaterialTable::~MaterialTable() {
+  Reset();
+}
+
+bool MaterialTable::BindlessSupported() {
+  return GLEW_ARB_bindless_texture &&
+      (GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object);
+}
+
+bool MaterialTable::Initialize(const TextureFormat format,
+                               const int width,
+                               const int height,
+                               const int num_levels,
+                               const int max_num_materials,
+                               std::string* error_info_log) {
+  if (instance_buffer_id_ != 0) {
+    *error_info_log = "The material table is already initialized.";
+    return false;
+  }
+  if (width <= 0 || height <= 0 || max_num_materials <= 0 ||
+      num_levels <= 0 || num_levels > NumMipLevels(width, height)) {
+    *error_info_log = "Invalid size of the material textures.";
+    return false;
+  }
+  if (!TextureFormatSupported(format)) {
+    *error_info_log = std::string("The format ") + TextureFormatName(format) +
+        " is not supported.";
+    return false;
+  }
+  bindless_ = BindlessSupported();
+  format_ = format;
+  width_ = width;
+  height_ = height;
+  num_levels_ = num_levels;
+  max_num_materials_ = max_num_materials;
+  BufferAllocator* allocator = BufferAllocator::Get();
+  instance_buffer_id_ = allocator->CreateBuffer(VERTEX_DATA);
+  if (instance_buffer_id_ == 0) {
+    *error_info_log = "Could not create the instance material buffer.";
+    return false;
+  }
+  if (bindless_) {
+    GlStateCache* gl_state = GlStateCache::Current();
+    handle_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+    if (handle_buffer_id_ == 0) {
+      *error_info_log = "Could not create the material handle buffer.";
+      return false;
+    }
+    gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, handle_buffer_id_);
+    allocator->BufferData(handle_buffer_id_, GL_SHADER_STORAGE_BUFFER,
+                          max_num_materials * sizeof(GLuint64), nullptr,
+                          GL_STATIC_DRAW);
+    gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return true;
+  }
+  // The memory of every layer is allocated once for the entire array.
+  const GLenum internal_format = TextureInternalFormat(format);
+  glGenTextures(1, &texture_array_id_);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array_id_);
+  if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, num_levels, internal_format, width,
+                   height, max_num_materials);
+  } else {
+    for (int level = 0; level < num_levels; ++level) {
+      const int level_width = LevelDimension(width, level);
+      const int level_height = LevelDimension(height, level);
+      if (IsCompressedTextureFormat(format)) {
+        glCompressedTexImage3D(
+            GL_TEXTURE_2D_ARRAY, level, internal_format, level_width,
+            level_height, max_num_materials, 0,
+            TextureLevelSize(format, level_width, level_height) *
+                max_num_materials,
+            nullptr);
+      } else {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internal_format, level_width,
+                     level_height, max_num_materials, 0, GL_RGBA,
+                     TextureTexelType(format), nullptr);
+      }
+    }
+  }
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, num_levels - 1);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  if (texture_array_id_ == 0) {
+    *error_info_log = "Could not create the texture array.";
+    return false;
+  }
+  return true;
+}
+
+int MaterialTable::AddMaterial(TextureSource* source,
+                               std::string* error_info_log) {
+  if (num_materials_ == max_num_materials_) {
+    *error_info_log = "The material table is full.";
+    return -1;
+  }
+  if (bindless_) {
+    if (!TextureFormatSupported(source->format())) {
+      *error_info_log = std::string("The format ") +
+          TextureFormatName(source->format()) + " is not supported.";
+      return -1;
+    }
+    if (!CreateBindlessTexture(source)) {
+      *error_info_log = "Could not read the levels of the texture.";
+      return -1;
+    }
+    GlStateCache* gl_state = GlStateCache::Current();
+    gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, handle_buffer_id_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    num_materials_ * sizeof(GLuint64), sizeof(GLuint64),
+                    &handles_.back());
+    gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return num_materials_++;
+  }
+  if (source->format() != format_ || source->width() != width_ ||
+      source->height() != height_ || source->num_levels() < num_levels_) {
+    *error_info_log = "The texture does not match the texture array: " +
+        std::string(TextureFormatName(source->format())) + " " +
+        std::to_string(source->width()) + "x" +
+        std::to_string(source->height()) + ".";
+    return -1;
+  }
+  if (!UploadLayer(num_materials_, source)) {
+    *error_info_log = "Could not read the levels of the texture.";
+    return -1;
+  }
+  return num_materials_++;
+}
+
+bool MaterialTable::UploadLayer(const int layer, TextureSource* source) {
+  const GLenum internal_format = TextureInternalFormat(format_);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array_id_);
+  bool success = true;
+  for (int level = 0; level < num_levels_ && success; ++level) {
+    const GLubyte* data = nullptr;
+    size_t size = 0;
+    success = ReadLevel(source, level, &data, &size);
+    if (!success) break;
+    const int width = LevelDimension(width_, level);
+    const int height = LevelDimension(height_, level);
+    if (IsCompressedTextureFormat(format_)) {
+      glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                                width, height, 1, internal_format, size,
+                                data);
+    } else {
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height,
+                      1, GL_RGBA, TextureTexelType(format_), data);
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  return success;
+}
+
+bool MaterialTable::CreateBindlessTexture(TextureSource* source) {
+  const TextureFormat format = source->format();
+  const GLenum internal_format = TextureInternalFormat(format);
+  const int num_levels = source->num_levels();
+  GLuint texture_id = 0;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  // Contexts with bindless textures have immutable storage.
+  glTexStorage2D(GL_TEXTURE_2D, num_levels, internal_format, source->width(),
+                 source->height());
+  for (int level = 0; level < num_levels; ++level) {
+    const GLubyte* data = nullptr;
+    size_t size = 0;
+    if (!ReadLevel(source, level, &data, &size)) {
+      glBindTexture(GL_TEXTURE_2D, 0);
+      glDeleteTextures(1, &texture_id);
+      return false;
+    }
+    const int width = LevelDimension(source->width(), level);
+    const int height = LevelDimension(source->height(), level);
+    if (IsCompressedTextureFormat(format)) {
+      glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height,
+                                internal_format, size, data);
+    } else {
+      glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, GL_RGBA,
+                      TextureTexelType(format), data);
+    }
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  // The state of the texture is frozen once it has a handle.
+  const GLuint64 handle = glGetTextureHandleARB(texture_id);
+  glMakeTextureHandleResidentARB(handle);
+  texture_ids_.push_back(texture_id);
+  handles_.push_back(handle);
+  return true;
+}
+
+void MaterialTable::Attach(const GLuint vertex_array_object_id) const {
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindVertexArray(vertex_array_object_id);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, instance_buffer_id_);
+  // An integer attribute, so the index is not converted to a float.
+  glVertexAttribIPointer(kInstanceMaterialLocation, 1, GL_UNSIGNED_INT,
+                         sizeof(GLuint), nullptr);
+  glEnableVertexAttribArray(kInstanceMaterialLocation);
+  glVertexAttribDivisor(kInstanceMaterialLocation, 1);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+  gl_state->BindVertexArray(0);
+}
+
+bool MaterialTable::Attach(ShaderProgram* shader_program) const {
+  if (bindless_) {
+    return shader_program->BindShaderStorageBlock(kBlockName,
+                                                  kMaterialTableBindingPoint);
+  }
+  const GLint location = shader_program->GetUniformLocation(kSamplerName);
+  if (location < 0 || !shader_program->Use()) return false;
+  return shader_program->SetUniform(location,
+                                    static_cast<GLint>(kMaterialTextureUnit));
+}
+
+void MaterialTable::UpdateInstanceMaterials(const GLuint* materials,
+                                            const int num_instances) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, instance_buffer_id_);
+  if (num_instances > instance_capacity_) {
+    // Grow geometrically to amortize the reallocations.
+    instance_capacity_ = std::max(num_instances, 2 * instance_capacity_);
+  }
+  BufferAllocator::Get()->BufferData(instance_buffer_id_, GL_ARRAY_BUFFER,
+                                     instance_capacity_ * sizeof(GLuint),
+                                     nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, num_instances * sizeof(GLuint),
+                  materials);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MaterialTable::Bind() const {
+  if (bindless_) {
+    GlStateCache::Current()->BindBufferBase(
+        GL_SHADER_STORAGE_BUFFER, kMaterialTableBindingPoint,
+        handle_buffer_id_);
+    return;
+  }
+  glActiveTexture(GL_TEXTURE0 + kMaterialTextureUnit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array_id_);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void MaterialTable::Reset() {
+  for (size_t i = 0; i < texture_ids_.size(); ++i) {
+    glMakeTextureHandleNonResidentARB(handles_[i]);
+    glDeleteTextures(1, &texture_ids_[i]);
+  }
+  texture_ids_.clear();
+  handles_.clear();
+  if (texture_array_id_ != 0) glDeleteTextures(1, &texture_array_id_);
+  texture_array_id_ = 0;
+  BufferAllocator::Get()->DeleteBuffer(&handle_buffer_id_);
+  BufferAllocator::Get()->DeleteBuffer(&instance_buffer_id_);
+  instance_capacity_ = 0;
+  num_materials_ = 0;
+}
+
+std::string MaterialTable::GlslDeclaration() {
+  if (!BindlessSupported()) {
+    return std::string("uniform sampler2DArray ") + kSamplerName + ";\n"
+        "vec4 SampleMaterial(uint material, vec2 texture_coordinate) {\n"
+        "  return texture(" + kSamplerName +
+        ", vec3(texture_coordinate, float(material)));\n"
+        "}\n";
+  }
+  return std::string("#extension GL_ARB_bindless_texture : require\n") +
+      "#extension GL_ARB_shader_storage_buffer_object : require\n"
+      "layout (std430) readonly buffer " + kBlockName + " {\n"
+      "  uvec2 material_handles[];\n"
+      "};\n"
+      "vec4 SampleMaterial(uint material, vec2 texture_coordinate) {\n"
+      "  return texture(sampler2D(material_handles[material]),\n"
+      "                 texture_coordinate);\n"
+      "}\n";
+}
+
+}  // namespace wvu
@@ -0,0 +1,199 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MATERIAL_TABLE_H_
+#define GLUTILS_MATERIAL_TABLE_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "shader_program.h"
+#include "texture_source.h"
+
+namespace wvu {
+// Shader storage buffer binding point reserved for the bindless handles of
+// the materials.
+constexpr GLuint kMaterialTableBindingPoint = 2;
+
+// Texture unit of the texture array of the materials. Unit 0 is left to the
+// textures bound per draw by a RenderQueue.
+constexpr GLuint kMaterialTextureUnit = 1;
+
+// Attribute location of the per-instance material index, just below the
+// instance transform (see instance_buffer.h):
+//   layout (location = 11) in uint instance_material;
+constexpr GLuint kInstanceMaterialLocation = 11;
+
+// This class gives every material of a scene an index that the shaders use to
+// sample its texture, so that the draws of different materials need no
+// texture binds between them, and one glMultiDrawElementsIndirect() of a
+// MeshBatch covers them all. The index of each instance is a per-instance
+// attribute, read from the base instance of its draw like the transforms of an
+// InstanceBuffer.
+//
+// With ARB_bindless_texture and shader storage buffers (OpenGL 4.3 or
+// ARB_shader_storage_buffer_object), every material keeps its own texture, of
+// any format and size, made resident, and the shaders read its 64-bit handle
+// from a shader storage buffer. Otherwise, the textures are layers of a single
+// GL_TEXTURE_2D_ARRAY, so they must share the format, the size and the number
+// of levels given to Initialize(). Either way the materials hold all their
+// levels: resident textures cannot change, so they are not streamed like those
+// of a TextureManager.
+//
+// The shaders include GlslDeclaration() right after their #version line, which
+// declares:
+//
+//   // Returns the texel of a material at texture coordinate.
+//   vec4 SampleMaterial(uint material, vec2 texture_coordinate);
+//
+// The vertex shader passes the index to the fragment shader as a flat output,
+// so it is the same for all the fragments of a draw. The storage block of the
+// bindless path needs a #version of 400 or later.
+//
+// Example:
+//
+// wvu::MaterialTable materials;
+// materials.Initialize(wvu::TEXTURE_FORMAT_BC7, 256, 256, 9, 64,
+//                      &error_info_log);
+// const int brick = materials.AddMaterial(&brick_source, &error_info_log);
+// const int wood = materials.AddMaterial(&wood_source, &error_info_log);
+// materials.Attach(batch.vertex_array_object_id());
+// materials.Attach(&shader_program);
+// while (...) {  // Rendering loop.
+//   materials.UpdateInstanceMaterials(instance_materials.data(),
+//                                     instance_materials.size());
+//   shader_program.Use();
+//   materials.Bind();
+//   batch.Submit();
+// }
+class MaterialTable {
+ public:
+  // Names of the texture array sampler and of the storage block of the handles
+  // in the shaders.
+  static const char kSamplerName[];
+  static const char kBlockName[];
+
+  MaterialTable();
+  ~MaterialTable();
+
+  // Creates the buffers and, without bindless textures, the texture array.
+  // The context must be current. Returns true if successful.
+  // Parameters:
+  //   format  The format of the textures of the array.
+  //   width  The width of the textures of the array.
+  //   height  The height of the textures of the array.
+  //   num_levels  The number of mip levels of the textures of the array.
+  //   max_num_materials  The number of layers of the array, and the capacity
+  //     of the handle buffer.
+  //   error_info_log  The reason of the failure.
+  bool Initialize(const TextureFormat format,
+                  const int width,
+                  const int height,
+                  const int num_levels,
+                  const int max_num_materials,
+                  std::string* error_info_log);
+
+  // Uploads all the levels of a texture as a new material. Returns the index
+  // of the material, or -1 if the table is full, the texture does not match
+  // the array, or a level cannot be read.
+  int AddMaterial(TextureSource* source, std::string* error_info_log);
+
+  // Adds the per-instance material attribute to a vertex array object, e.g.,
+  // the one of a MeshBatch.
+  void Attach(const GLuint vertex_array_object_id) const;
+
+  // Binds the sampler or the storage block of a program declaring
+  // GlslDeclaration(). Returns false if the program does not declare them.
+  bool Attach(ShaderProgram* shader_program) const;
+
+  // Uploads the material indices of the instances, in the order of their
+  // transforms. The buffer grows when needed; otherwise its storage is
+  // orphaned, so the upload does not wait for the draws still reading it.
+  void UpdateInstanceMaterials(const GLuint* materials,
+                               const int num_instances);
+
+  // Binds the texture array or the handle buffer for the next draws.
+  void Bind() const;
+
+  // Deletes the textures and the buffers.
+  void Reset();
+
+  // Returns the GLSL declaration of SampleMaterial() for the path supported by
+  // the context.
+  static std::string GlslDeclaration();
+
+  // Returns true if the materials are bindless textures.
+  static bool BindlessSupported();
+
+  int num_materials() const {
+    return num_materials_;
+  }
+
+  // Returns the texture array, or 0 with bindless textures.
+  GLuint texture_array_id() const {
+    return texture_array_id_;
+  }
+
+ private:
+  // Uploads the levels of a source into the layer of the array.
+  bool UploadLayer(const int layer, TextureSource* source);
+
+  // Creates a resident texture with the levels of a source, and stores its
+  // handle. Returns false if a level cannot be read.
+  bool CreateBindlessTexture(TextureSource* source);
+
+  bool bindless_;
+  TextureFormat format_;
+  int width_;
+  int height_;
+  int num_levels_;
+  int max_num_materials_;
+  int num_materials_;
+  GLuint texture_array_id_;
+  // Textures and resident handles of the bindless materials.
+  std::vector<GLuint> texture_ids_;
+  std::vector<GLuint64> handles_;
+  GLuint handle_buffer_id_;
+  GLuint instance_buffer_id_;
+  // Number of indices the instance buffer storage can hold.
+  int instance_capacity_;
+
+  MaterialTable(const MaterialTable&) = delete;
+  MaterialTable& operator=(const MaterialTable&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MATERIAL_TABLE_H_
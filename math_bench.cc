@@ -0,0 +1,381 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+// Microbenchmarks of the math kernels of assignment.h. Every kernel processes
+// arrays whose working set fits the L1, L2 and L3 caches, and one that only
+// fits the DRAM, and reports the time per element and the bandwidth of its
+// reads and writes.
+//
+// Example:
+//
+// ./bin/math_bench --benchmark_filter=Cross --benchmark_min_time_ms=500
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "assignment.h"
+
+// Use the right namespace for google flags (gflags).
+#ifdef GFLAGS_NAMESPACE_GOOGLE
+#define CS470_GFLAGS_NAMESPACE google
+#else
+#define CS470_GFLAGS_NAMESPACE gflags
+#endif
+
+DEFINE_string(benchmark_filter, "",
+              "Only runs the benchmarks whose name contains this string.");
+DEFINE_int32(benchmark_min_time_ms, 200,
+             "Minimum time each kernel runs at each working set size.");
+DEFINE_string(simd_instruction_set, "",
+              "Instruction set of the batched kernels: scalar, SSE, AVX2, "
+              "AVX-512 or NEON. Empty uses the best one the CPU supports.");
+
+// Annonymous namespace for constants and helper functions.
+namespace {
+// Bytes of the working sets, sized for the L1, L2 and L3 caches of a typical
+// desktop CPU and well beyond them.
+constexpr int kNumWorkingSets = 4;
+constexpr int64_t kWorkingSetBytes[kNumWorkingSets] = {
+  16 * 1024, 192 * 1024, 4 * 1024 * 1024, 256 * 1024 * 1024
+};
+const char* const kWorkingSetNames[kNumWorkingSets] = {
+  "L1", "L2", "L3", "DRAM"
+};
+
+// Contiguous arrays of fixed-size vectorizable Eigen types need an aligned
+// allocator.
+typedef std::vector<Eigen::Vector3f> Vector3fs;
+typedef std::vector<Eigen::Vector4f, Eigen::aligned_allocator<Eigen::Vector4f> >
+    Vector4fs;
+typedef std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >
+    Matrix4fs;
+
+// Written with the results of the kernels, so the compiler cannot discard
+// them.
+volatile float result_sink = 0.0f;
+
+// A benchmarked kernel.
+struct MathBenchmark {
+  std::string name;
+  // Bytes read and written per element.
+  int bytes_per_element;
+  // Allocates the inputs and outputs of num_elements elements, and returns the
+  // function processing all of them once.
+  std::function<std::function<void()>(int)> setup;
+};
+
+float RandomFloat(std::mt19937* generator) {
+  return std::uniform_real_distribution<float>(-1.0f, 1.0f)(*generator);
+}
+
+Vector3fs RandomVector3fs(const int size, std::mt19937* generator) {
+  Vector3fs vectors(size);
+  for (Eigen::Vector3f& vector : vectors) {
+    vector = Eigen::Vector3f(RandomFloat(generator), RandomFloat(generator),
+                             RandomFloat(generator));
+  }
+  return vectors;
+}
+
+wvu::Vector3fArray RandomVector3fArray(const int size,
+                                       std::mt19937* generator) {
+  wvu::Vector3fArray vectors;
+  vectors.resize(size);
+  for (int i = 0; i < size; ++i) {
+    vectors.x[i] = RandomFloat(generator);
+    vectors.y[i] = RandomFloat(generator);
+    vectors.z[i] = RandomFloat(generator);
+  }
+  return vectors;
+}
+
+Eigen::Matrix4f RandomMatrix(std::mt19937* generator) {
+  Eigen::Matrix4f matrix;
+  for (int i = 0; i < 16; ++i) matrix(i) = RandomFloat(generator);
+  return matrix;
+}
+
+// Returns the benchmarks of the scalar kernels and of their batched
+// counterparts.
+std::vector<MathBenchmark> CreateBenchmarks() {
+  std::vector<MathBenchmark> benchmarks;
+  benchmarks.push_back({"Add3dPoints", 3 * sizeof(Eigen::Vector3f),
+                        [](const int size) -> std::function<void()> {
+    std::mt19937 generator(0);
+    auto x = std::make_shared<Vector3fs>(RandomVector3fs(size, &generator));
+    auto y = std::make_shared<Vector3fs>(RandomVector3fs(size, &generator));
+    auto result = std::make_shared<Vector3fs>(size);
+    return [=]() {
+      for (int i = 0; i < size; ++i) {
+        (*result)[i] = wvu::Add3dPoints((*x)[i], (*y)[i]);
+      }
+      result_sink = (*result)[0].x();
+    };
+  }});
+  benchmarks.push_back({"Multiply4x4Matrices", 2 * sizeof(Eigen::Matrix4f),
+                        [](const int size) -> std::function<void()> {
+    std::mt19937 generator(0);
+    const Eigen::Matrix4f x = RandomMatrix(&generator);
+    auto y = std::make_shared<Matrix4fs>(size);
+    for (Eigen::Matrix4f& matrix : *y) matrix = RandomMatrix(&generator);
+    auto result = std::make_shared<Matrix4fs>(size);
+    return [=]() {
+      for (int i = 0; i < size; ++i) {
+        (*result)[i] = wvu::Multiply4x4Matrices(x, (*y)[i]);
+      }
+      result_sink = (*result)[0](0);
+    };
+  }});
+  benchmarks.push_back({"Multiply4x4MatrixArray", 2 * sizeof(Eigen::Matrix4f),
+                        [](const int size) -> std::function<void()> {
+    std::mt19937 generator(0);
+    const Eigen::Matrix4f x = RandomMatrix(&generator);
+    auto y = std::make_shared<Matrix4fs>(size);
+    for (Eigen::Matrix4f& matrix : *y) matrix = RandomMatrix(&generator);
+    auto result = std::make_shared<Matrix4fs>(size);
+    return [=]() {
+      wvu::Multiply4x4MatrixArray(x, y->data(), size, result->data());
+      result_sink = (*result)[0](0);
+    };
+  }});
+  benchmarks.push_back({"MultiplyVectorAndMatrix", 2 * sizeof(Eigen::Vector4f),
+                        [](const int size) -> std::function<void()> {
+    std::mt19937 generator(0);
+    const Eigen::Matrix4f x = RandomMatrix(&generator);
+    auto y = std::make_shared<Vector4fs>(size);
+    for (Eigen::Vector4f& vector : *y) {
+      vector = RandomMatrix(&generator).col(0);
+    }
+    auto result = std::make_shared<Vector4fs>(size);
+    return [=]() {
+      for (int i = 0; i < size; ++i) {
+        (*result)[i] = wvu::MultiplyVectorAndMatrix(x, (*y)[i]);
+      }
+      result_sink = (*result)[0].x();
+    };
+  }});
+  benchmarks.push_back({"MultiplyVectorArrayAndMatrix", 8 * sizeof(float),
+                        [](const int size) -> std::function<void()> {
+    std::mt19937 generator(0);
+    const Eigen::Matrix4f x = RandomMatrix(&generator);
+    auto y = std::make_shared<wvu::Vector4fArray>();
+    y->resize(size);
+    for (int i = 0; i < size; ++i) {
+      y->x[i] = RandomFloat(&generator);
+      y->y[i] = RandomFloat(&generator);
+      y->z[i] = RandomFloat(&generator);
+      y->w[i] = RandomFloat(&generator);
+    }
+    auto result = std::make_shared<wvu::Vector4fArray>();
+    return [=]() {
+      wvu::MultiplyVectorArrayAndMatrix(x, *y, result.get());
+      result_sink = result->x[0];
+    };
+  }});
+  benchmarks.push_back({"ComputeCrossProduct", 3 * sizeof(Eigen::Vector3f),
+                        [](const int size) -> std::function<void()> {
+    std::mt19937 generator(0);
+    auto x = std::make_shared<Vector3fs>(RandomVector3fs(size, &generator));
+    auto y = std::make_shared<Vector3fs>(RandomVector3fs(size, &generator));
+    auto result = std::make_shared<Vector3fs>(size);
+    return [=]() {
+      for (int i = 0; i < size; ++i) {
+        (*result)[i] = wvu::ComputeCrossProduct((*x)[i], (*y)[i]);
+      }
+      result_sink = (*result)[0].x();
+    };
+  }});
+  benchmarks.push_back({"ComputeCrossProducts", 9 * sizeof(float),
+                        [](const int size) -> std::function<void()> {
+    std::mt19937 generator(0);
+    auto x = std::make_shared<wvu::Vector3fArray>(
+        RandomVector3fArray(size, &generator));
+    auto y = std::make_shared<wvu::Vector3fArray>(
+        RandomVector3fArray(size, &generator));
+    auto result = std::make_shared<wvu::Vector3fArray>();
+    return [=]() {
+      wvu::ComputeCrossProducts(*x, *y, result.get());
+      result_sink = result->x[0];
+    };
+  }});
+  benchmarks.push_back({"CalculateAngleBetweenTwoVectors",
+                        2 * sizeof(Eigen::Vector3f) + sizeof(float),
+                        [](const int size) -> std::function<void()> {
+    std::mt19937 generator(0);
+    auto x = std::make_shared<Vector3fs>(RandomVector3fs(size, &generator));
+    auto y = std::make_shared<Vector3fs>(RandomVector3fs(size, &generator));
+    auto result = std::make_shared<std::vector<float> >(size);
+    return [=]() {
+      for (int i = 0; i < size; ++i) {
+        (*result)[i] = wvu::CalculateAngleBetweenTwoVectors((*x)[i], (*y)[i]);
+      }
+      result_sink = (*result)[0];
+    };
+  }});
+  const wvu::AngleApproximation approximations[] = {
+    wvu::EXACT_ANGLE, wvu::FAST_ANGLE
+  };
+  for (const wvu::AngleApproximation approximation : approximations) {
+    benchmarks.push_back({approximation == wvu::EXACT_ANGLE ?
+                          "CalculateAnglesBetweenVectors/exact" :
+                          "CalculateAnglesBetweenVectors/fast",
+                          7 * sizeof(float),
+                          [=](const int size) -> std::function<void()> {
+      std::mt19937 generator(0);
+      auto x = std::make_shared<wvu::Vector3fArray>(
+          RandomVector3fArray(size, &generator));
+      auto y = std::make_shared<wvu::Vector3fArray>(
+          RandomVector3fArray(size, &generator));
+      auto result = std::make_shared<std::vector<float> >();
+      return [=]() {
+        wvu::CalculateAnglesBetweenVectors(*x, *y, approximation,
+                                           result.get());
+        result_sink = (*result)[0];
+      };
+    }});
+  }
+  // Frustum planes at a distance of 0.5 from the origin, which about half of
+  // the bounds intersect.
+  Eigen::Matrix<float, 6, 4> planes = Eigen::Matrix<float, 6, 4>::Zero();
+  for (int axis = 0; axis < 3; ++axis) {
+    planes(2 * axis, axis) = 1.0f;
+    planes(2 * axis + 1, axis) = -1.0f;
+  }
+  planes.col(3).setConstant(0.5f);
+  benchmarks.push_back({"CullSpheres", 4 * sizeof(float),
+                        [=](const int size) -> std::function<void()> {
+    std::mt19937 generator(0);
+    auto centers = std::make_shared<wvu::Vector3fArray>(
+        RandomVector3fArray(size, &generator));
+    auto radii = std::make_shared<std::vector<float> >(size, 0.05f);
+    auto visibility = std::make_shared<std::vector<uint32_t> >();
+    return [=]() {
+      wvu::CullSpheres(planes, *centers, *radii, visibility.get());
+      result_sink = (*visibility)[0];
+    };
+  }});
+  benchmarks.push_back({"CullBoxes", 6 * sizeof(float),
+                        [=](const int size) -> std::function<void()> {
+    std::mt19937 generator(0);
+    auto centers = std::make_shared<wvu::Vector3fArray>(
+        RandomVector3fArray(size, &generator));
+    auto half_extents = std::make_shared<wvu::Vector3fArray>();
+    half_extents->x.assign(size, 0.05f);
+    half_extents->y.assign(size, 0.05f);
+    half_extents->z.assign(size, 0.05f);
+    auto visibility = std::make_shared<std::vector<uint32_t> >();
+    return [=]() {
+      wvu::CullBoxes(planes, *centers, *half_extents, visibility.get());
+      result_sink = (*visibility)[0];
+    };
+  }});
+  return benchmarks;
+}
+
+// Runs the kernel for at least min_time_ms after a warm up run, and prints the
+// time per element and the bandwidth.
+void RunBenchmark(const MathBenchmark& benchmark,
+                  const int working_set,
+                  const int min_time_ms) {
+  const int size = std::max<int64_t>(
+      kWorkingSetBytes[working_set] / benchmark.bytes_per_element, 1);
+  const std::function<void()> run = benchmark.setup(size);
+  // The warm up run also lets the batched kernels resize their outputs.
+  run();
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point begin = Clock::now();
+  const Clock::time_point min_end =
+      begin + std::chrono::milliseconds(min_time_ms);
+  int64_t num_runs = 0;
+  Clock::time_point end;
+  do {
+    run();
+    ++num_runs;
+    end = Clock::now();
+  } while (end < min_end);
+  const double elapsed_ns =
+      std::chrono::duration<double, std::nano>(end - begin).count();
+  const double num_elements = static_cast<double>(num_runs) * size;
+  std::printf("%-36s %-5s %10d %10.3f %10.2f\n", benchmark.name.c_str(),
+              kWorkingSetNames[working_set], size, elapsed_ns / num_elements,
+              num_elements * benchmark.bytes_per_element / elapsed_ns);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CS470_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  if (!FLAGS_simd_instruction_set.empty()) {
+    bool selected = false;
+    for (int i = 0; i < wvu::NUM_SIMD_INSTRUCTION_SETS; ++i) {
+      const wvu::SimdInstructionSet instruction_set =
+          static_cast<wvu::SimdInstructionSet>(i);
+      if (FLAGS_simd_instruction_set ==
+          wvu::SimdInstructionSetName(instruction_set)) {
+        selected = wvu::SetSimdInstructionSet(instruction_set);
+      }
+    }
+    if (!selected) {
+      LOG(ERROR) << "This CPU or build does not support "
+                 << FLAGS_simd_instruction_set;
+      return -1;
+    }
+  }
+  std::printf("Batched kernels use %s.\n",
+              wvu::SimdInstructionSetName(wvu::ActiveSimdInstructionSet()));
+  std::printf("%-36s %-5s %10s %10s %10s\n", "Kernel", "Set", "Elements",
+              "ns/op", "GB/s");
+  for (const MathBenchmark& benchmark : CreateBenchmarks()) {
+    if (benchmark.name.find(FLAGS_benchmark_filter) == std::string::npos) {
+      continue;
+    }
+    for (int working_set = 0; working_set < kNumWorkingSets; ++working_set) {
+      RunBenchmark(benchmark, working_set, FLAGS_benchmark_min_time_ms);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,234 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mesh_batch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_allocator.h"
+#include "buffer_arena.h"
+#include "gl_state_cache.h"
+#include "model.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+
+bool MultiDrawIndirectSupported() {
+  return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+}
+
+}  // namespace
+
+MeshBatch::MeshBatch(const VertexLayout& vertex_layout, const GLenum index_type)
+    : vertex_layout_(vertex_layout),
+      index_type_(index_type),
+      vertex_arena_(vertex_layout.stride(), VERTEX_DATA),
+      index_arena_(IndexSize(index_type), INDEX_DATA),
+      vertex_array_object_id_(0),
+      indirect_buffer_id_(0),
+      indirect_capacity_(0) {}
+
+MeshBatch::~MeshBatch() {
+  if (vertex_array_object_id_ != 0) {
+    GlStateCache::Current()->DeleteVertexArrays(1, &vertex_array_object_id_);
+  }
+  BufferAllocator::Get()->DeleteBuffer(&indirect_buffer_id_);
+}
+
+bool MeshBatch::Initialize(const int max_num_vertices,
+                           const int max_num_indices) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  if (vertex_array_object_id_ != 0) return false;
+  if (!vertex_arena_.Initialize(max_num_vertices) ||
+      !index_arena_.Initialize(max_num_indices)) {
+    return false;
+  }
+  glGenVertexArrays(1, &vertex_array_object_id_);
+  gl_state->BindVertexArray(vertex_array_object_id_);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, vertex_arena_.buffer_id());
+  vertex_layout_.SetAttributePointers();
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+  // The EBO stays bound to the VAO.
+  gl_state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_arena_.buffer_id());
+  gl_state->BindVertexArray(0);
+  indirect_buffer_id_ = BufferAllocator::Get()->CreateBuffer(STORAGE_DATA);
+  return vertex_array_object_id_ != 0 && indirect_buffer_id_ != 0;
+}
+
+int MeshBatch::AddMesh(const Model& model, std::string* error_info_log) {
+  if (model.vertex_layout() != vertex_layout_) {
+    *error_info_log = "The vertex layout of the model does not match.";
+    return -1;
+  }
+  if (model.primitive_type() != GL_TRIANGLES) {
+    *error_info_log = "Only triangle lists can be batched.";
+    return -1;
+  }
+  if (IndexSize(model.index_type()) > IndexSize(index_type_)) {
+    *error_info_log = "The model has too many vertices for the index type.";
+    return -1;
+  }
+  if (model.cpu_data_released()) {
+    *error_info_log = "The vertices of the model were released.";
+    return -1;
+  }
+  MeshRanges ranges;
+  ranges.vertex_range = vertex_arena_.Allocate(model.num_vertices());
+  ranges.index_range = index_arena_.Allocate(model.num_indices());
+  if (ranges.vertex_range < 0 || ranges.index_range < 0) {
+    if (ranges.vertex_range >= 0) vertex_arena_.Free(ranges.vertex_range);
+    if (ranges.index_range >= 0) index_arena_.Free(ranges.index_range);
+    *error_info_log = "The batch is full.";
+    return -1;
+  }
+  vertex_arena_.Upload(ranges.vertex_range, model.vertex_data().data());
+  // The indices stay relative to the first vertex of the mesh; the draws add
+  // it as the base vertex.
+  if (index_type_ == GL_UNSIGNED_SHORT) {
+    const std::vector<GLushort> short_indices(model.indices().begin(),
+                                              model.indices().end());
+    index_arena_.Upload(ranges.index_range, short_indices.data());
+  } else {
+    index_arena_.Upload(ranges.index_range, model.indices().data());
+  }
+  meshes_.push_back(MeshAllocation());
+  mesh_ranges_.push_back(ranges);
+  UpdateAllocation(meshes_.size() - 1);
+  return meshes_.size() - 1;
+}
+
+void MeshBatch::RemoveMesh(const int mesh_id) {
+  MeshRanges& ranges = mesh_ranges_[mesh_id];
+  if (ranges.vertex_range < 0) return;
+  vertex_arena_.Free(ranges.vertex_range);
+  index_arena_.Free(ranges.index_range);
+  ranges = MeshRanges();
+  meshes_[mesh_id] = MeshAllocation();
+}
+
+bool MeshBatch::Defragment() {
+  const bool vertices_moved = vertex_arena_.Defragment();
+  const bool indices_moved = index_arena_.Defragment();
+  if (!vertices_moved && !indices_moved) return false;
+  for (int mesh_id = 0; mesh_id < num_meshes(); ++mesh_id) {
+    if (mesh_ranges_[mesh_id].vertex_range >= 0) UpdateAllocation(mesh_id);
+  }
+  return true;
+}
+
+void MeshBatch::UpdateAllocation(const int mesh_id) {
+  const MeshRanges& ranges = mesh_ranges_[mesh_id];
+  MeshAllocation& allocation = meshes_[mesh_id];
+  allocation.first_vertex = vertex_arena_.offset(ranges.vertex_range);
+  allocation.num_vertices = vertex_arena_.size(ranges.vertex_range);
+  allocation.first_index = index_arena_.offset(ranges.index_range);
+  allocation.num_indices = index_arena_.size(ranges.index_range);
+}
+
+void MeshBatch::ClearDraws() {
+  commands_.clear();
+}
+
+void MeshBatch::AddDraw(const int mesh_id,
+                        const int instance_count,
+                        const int base_instance) {
+  const MeshAllocation& allocation = meshes_[mesh_id];
+  AddDrawRange(mesh_id, 0, allocation.num_indices, instance_count,
+               base_instance);
+}
+
+void MeshBatch::AddDrawRange(const int mesh_id,
+                             const int first_index,
+                             const int num_indices,
+                             const int instance_count,
+                             const int base_instance) {
+  const MeshAllocation& allocation = meshes_[mesh_id];
+  DrawElementsIndirectCommand command;
+  command.count = num_indices;
+  command.instance_count = instance_count;
+  command.first_index = allocation.first_index + first_index;
+  command.base_vertex = allocation.first_vertex;
+  command.base_instance = base_instance;
+  commands_.push_back(command);
+}
+
+void MeshBatch::Submit() {
+  GlStateCache* gl_state = GlStateCache::Current();
+  if (commands_.empty()) return;
+  gl_state->BindVertexArray(vertex_array_object_id_);
+  if (MultiDrawIndirectSupported()) {
+    gl_state->BindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_id_);
+    const int num_commands = commands_.size();
+    const GLsizeiptr size =
+        num_commands * sizeof(DrawElementsIndirectCommand);
+    if (num_commands > indirect_capacity_) {
+      indirect_capacity_ = std::max(num_commands, 2 * indirect_capacity_);
+    }
+    // Reallocating orphans the commands of the previous frame.
+    BufferAllocator::Get()->BufferData(
+        indirect_buffer_id_, GL_DRAW_INDIRECT_BUFFER,
+        indirect_capacity_ * sizeof(DrawElementsIndirectCommand), nullptr,
+        GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, commands_.data());
+    glMultiDrawElementsIndirect(GL_TRIANGLES, index_type_, nullptr,
+                                num_commands, 0);
+  } else {
+    const bool base_instance_supported =
+        GLEW_VERSION_4_2 || GLEW_ARB_base_instance;
+    const GLsizei index_size = IndexSize(index_type_);
+    for (const DrawElementsIndirectCommand& command : commands_) {
+      const GLvoid* offset = reinterpret_cast<const GLvoid*>(
+          static_cast<uintptr_t>(command.first_index) * index_size);
+      if (base_instance_supported) {
+        glDrawElementsInstancedBaseVertexBaseInstance(
+            GL_TRIANGLES, command.count, index_type_, offset,
+            command.instance_count, command.base_vertex,
+            command.base_instance);
+      } else {
+        // Without base instances, per-instance attributes start at zero.
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count,
+                                          index_type_, offset,
+                                          command.instance_count,
+                                          command.base_vertex);
+      }
+    }
+  }
+}
+
+}  // namespace wvu
@@ -0,0 +1,214 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESH_BATCH_H_
+#define GLUTILS_MESH_BATCH_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_arena.h"
+#include "model.h"
+#include "vertex_format.h"
+
+namespace wvu {
+// Layout of the commands read by glMultiDrawElementsIndirect().
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instance_count;
+  GLuint first_index;
+  GLint base_vertex;
+  GLuint base_instance;
+};
+
+// Location of a mesh inside the shared buffers of a MeshBatch.
+struct MeshAllocation {
+  int first_vertex = 0;
+  int num_vertices = 0;
+  int first_index = 0;
+  int num_indices = 0;
+};
+
+// This class packs many meshes with the same vertex layout into a single
+// vertex buffer and a single index buffer, which share one vertex array
+// object. The indices of each mesh stay relative to its first vertex and the
+// draws add it as the base vertex, so 16-bit indices remain usable for large
+// batches of small meshes. All the draws of a frame are recorded as indirect
+// commands and submitted with one glMultiDrawElementsIndirect() call (OpenGL
+// 4.3 or ARB_multi_draw_indirect), or one draw per command otherwise.
+//
+// The vertices and indices of the meshes are sub-allocated from BufferArenas,
+// so meshes can be removed and their ranges reused. Removing meshes leaves
+// holes in the buffers, which Defragment() packs on demand.
+//
+// The draws of a batch share the bound textures, so meshes of different
+// materials select their texture with a per-instance index into a
+// MaterialTable (see material_table.h).
+//
+// Example:
+//
+// wvu::MeshBatch batch(wvu::StandardVertex::Layout(), GL_UNSIGNED_SHORT);
+// batch.Initialize(1 << 20, 1 << 22);
+// const int cube = batch.AddMesh(cube_model, &error_info_log);
+// const int sphere = batch.AddMesh(sphere_model, &error_info_log);
+// while (...) {  // Rendering loop.
+//   batch.ClearDraws();
+//   batch.AddDraw(cube, 1, 0);
+//   batch.AddDraw(sphere, 1, 1);
+//   shader_program.Use();
+//   batch.Submit();
+// }
+class MeshBatch {
+ public:
+  // Parameters:
+  //   vertex_layout  The layout of the vertices of every mesh in the batch.
+  //   index_type  GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+  MeshBatch(const VertexLayout& vertex_layout, const GLenum index_type);
+  ~MeshBatch();
+
+  // Allocates the shared buffers. Returns true if successful.
+  // Parameters:
+  //   max_num_vertices  The capacity of the vertex buffer in vertices.
+  //   max_num_indices  The capacity of the index buffer in indices.
+  bool Initialize(const int max_num_vertices, const int max_num_indices);
+
+  // Copies the vertices and indices of the model into the shared buffers.
+  // Returns the id of the mesh in the batch, or -1 if the model does not
+  // match the layout, index type or primitive of the batch, or does not fit.
+  int AddMesh(const Model& model, std::string* error_info_log);
+
+  // Releases the vertices and indices of a mesh. The id is not reused, and the
+  // mesh must not be drawn anymore.
+  void RemoveMesh(const int mesh_id);
+
+  // Packs the vertices and indices of the meshes at the start of their
+  // buffers, so that the space freed by removed meshes forms a single range.
+  // Returns true if any mesh moved, in which case the commands recorded
+  // before, e.g., in the records of a GpuCuller, are stale and must be
+  // recorded again.
+  bool Defragment();
+
+  // Returns the location of a mesh in the shared buffers.
+  const MeshAllocation& mesh(const int mesh_id) const {
+    return meshes_[mesh_id];
+  }
+
+  int num_meshes() const {
+    return meshes_.size();
+  }
+
+  // Removes the recorded draws.
+  void ClearDraws();
+
+  // Records a draw of instance_count instances of a mesh. The instance
+  // attributes, e.g., an InstanceBuffer, are read from base_instance on.
+  void AddDraw(const int mesh_id,
+               const int instance_count,
+               const int base_instance);
+
+  // Records a draw of a range of the indices of a mesh, e.g., a level of
+  // detail.
+  void AddDrawRange(const int mesh_id,
+                    const int first_index,
+                    const int num_indices,
+                    const int instance_count,
+                    const int base_instance);
+
+  // Uploads the recorded commands and draws them with the current program.
+  void Submit();
+
+  // Returns the recorded commands.
+  const std::vector<DrawElementsIndirectCommand>& commands() const {
+    return commands_;
+  }
+
+  GLuint vertex_array_object_id() const {
+    return vertex_array_object_id_;
+  }
+
+  GLuint vertex_buffer_object_id() const {
+    return vertex_arena_.buffer_id();
+  }
+
+  GLuint element_buffer_object_id() const {
+    return index_arena_.buffer_id();
+  }
+
+  GLuint indirect_buffer_id() const {
+    return indirect_buffer_id_;
+  }
+
+  GLenum index_type() const {
+    return index_type_;
+  }
+
+  // Returns the number of vertices and indices used by the meshes.
+  int num_vertices() const {
+    return vertex_arena_.num_used_elements();
+  }
+
+  int num_indices() const {
+    return index_arena_.num_used_elements();
+  }
+
+ private:
+  // Handles of the arena ranges of a mesh, or -1 if it was removed.
+  struct MeshRanges {
+    int vertex_range = -1;
+    int index_range = -1;
+  };
+
+  // Copies the arena ranges of a mesh into its allocation.
+  void UpdateAllocation(const int mesh_id);
+
+  const VertexLayout vertex_layout_;
+  const GLenum index_type_;
+  BufferArena vertex_arena_;
+  BufferArena index_arena_;
+  GLuint vertex_array_object_id_;
+  GLuint indirect_buffer_id_;
+  // Capacity in commands of the indirect buffer.
+  int indirect_capacity_;
+  std::vector<MeshAllocation> meshes_;
+  std::vector<MeshRanges> mesh_ranges_;
+  std::vector<DrawElementsIndirectCommand> commands_;
+
+  MeshBatch(const MeshBatch&) = delete;
+  MeshBatch& operator=(const MeshBatch&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESH_BATCH_H_
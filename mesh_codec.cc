@@ -0,0 +1,441 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mesh_codec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include <GL/glew.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define WVU_HAS_SSE2
+#endif
+
+#include "job_system.h"
+#include "lz4_block.h"
+
+namespace wvu {
+namespace {
+
+// A block of an encoded buffer.
+struct EncodedBlock {
+  const uint8_t* data;
+  uint32_t stored_size;
+  uint32_t size;
+  // The range of vertices or indices of the block.
+  int first;
+  int count;
+};
+
+void AppendUint32(const uint32_t value, std::vector<uint8_t>* bytes) {
+  const uint8_t* value_bytes = reinterpret_cast<const uint8_t*>(&value);
+  bytes->insert(bytes->end(), value_bytes, value_bytes + sizeof(value));
+}
+
+uint32_t ReadUint32(const uint8_t* bytes) {
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+// Appends the block table of num_blocks blocks, to be filled by AppendBlock().
+void BeginBlocks(const int num_blocks, std::vector<uint8_t>* encoded) {
+  encoded->clear();
+  AppendUint32(num_blocks, encoded);
+  encoded->resize(encoded->size() + 2 * sizeof(uint32_t) * num_blocks, 0);
+}
+
+// Compresses the block and appends it, or appends it as it is if it does not
+// shrink.
+void AppendBlock(const int block,
+                 const std::vector<uint8_t>& bytes,
+                 Lz4BlockCompressor* compressor,
+                 std::vector<uint8_t>* compressed,
+                 std::vector<uint8_t>* encoded) {
+  compressor->Compress(bytes.data(), bytes.size(), compressed);
+  const std::vector<uint8_t>& stored =
+      compressed->size() < bytes.size() ? *compressed : bytes;
+  const uint32_t sizes[2] = {static_cast<uint32_t>(stored.size()),
+                             static_cast<uint32_t>(bytes.size())};
+  std::memcpy(encoded->data() + sizeof(uint32_t) + block * sizeof(sizes),
+              sizes, sizeof(sizes));
+  encoded->insert(encoded->end(), stored.begin(), stored.end());
+}
+
+// Reads the block table of a buffer of num_elements elements split into
+// blocks of block_size elements. Returns false if the table does not match
+// the buffer.
+bool ParseBlocks(const uint8_t* encoded,
+                 const size_t encoded_size,
+                 const int num_elements,
+                 const int block_size,
+                 std::vector<EncodedBlock>* blocks) {
+  if (encoded_size < sizeof(uint32_t) || num_elements < 0) return false;
+  const uint32_t num_blocks = ReadUint32(encoded);
+  if (num_blocks != (static_cast<uint32_t>(num_elements) + block_size - 1) /
+                        block_size ||
+      (encoded_size - sizeof(uint32_t)) / (2 * sizeof(uint32_t)) <
+          num_blocks) {
+    return false;
+  }
+  size_t offset = sizeof(uint32_t) + 2 * sizeof(uint32_t) * num_blocks;
+  blocks->resize(num_blocks);
+  for (uint32_t i = 0; i < num_blocks; ++i) {
+    EncodedBlock& block = (*blocks)[i];
+    block.stored_size = ReadUint32(encoded + sizeof(uint32_t) * (1 + 2 * i));
+    block.size = ReadUint32(encoded + sizeof(uint32_t) * (2 + 2 * i));
+    if (block.stored_size > encoded_size - offset ||
+        block.stored_size > block.size) {
+      return false;
+    }
+    block.data = encoded + offset;
+    block.first = i * block_size;
+    block.count = std::min(block_size, num_elements - block.first);
+    offset += block.stored_size;
+  }
+  return offset == encoded_size;
+}
+
+// Returns the decompressed bytes of the block, which are either the stored
+// bytes or the bytes decompressed into buffer. Returns null if the block is
+// corrupt.
+const uint8_t* UnpackBlock(const EncodedBlock& block,
+                           std::vector<uint8_t>* buffer) {
+  if (block.stored_size == block.size) return block.data;
+  buffer->resize(block.size);
+  if (!DecompressLz4Block(block.data, block.stored_size, buffer->data(),
+                          block.size)) {
+    return nullptr;
+  }
+  return buffer->data();
+}
+
+// Calls decode on every block, in parallel if a job system is given. Each
+// thread passes its own buffer to decode. Returns false if any call did.
+bool DecodeBlocks(
+    const std::vector<EncodedBlock>& blocks,
+    JobSystem* job_system,
+    const std::function<bool(const EncodedBlock&, std::vector<uint8_t>*)>&
+        decode) {
+  if (job_system == nullptr || blocks.size() < 2) {
+    std::vector<uint8_t> buffer;
+    for (const EncodedBlock& block : blocks) {
+      if (!decode(block, &buffer)) return false;
+    }
+    return true;
+  }
+  std::atomic<bool> corrupt(false);
+  job_system->ParallelFor(blocks.size(), 1,
+                          [&blocks, &decode, &corrupt](const int begin,
+                                                       const int end) {
+    std::vector<uint8_t> buffer;
+    for (int i = begin; i < end; ++i) {
+      if (!decode(blocks[i], &buffer)) corrupt = true;
+    }
+  });
+  return !corrupt;
+}
+
+#ifdef WVU_HAS_SSE2
+// Returns the running sums of the 16 bytes.
+inline __m128i PrefixSumBytes(__m128i x) {
+  x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+  x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+  x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+  return _mm_add_epi8(x, _mm_slli_si128(x, 8));
+}
+
+// Returns the running sums of the 4 integers.
+inline __m128i PrefixSumInts(__m128i x) {
+  x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+  return _mm_add_epi32(x, _mm_slli_si128(x, 8));
+}
+
+// Transposes the 16x16 bytes held by the rows. Four rounds of interleaving
+// row i with row i + 8 move every byte to its transposed position.
+inline void TransposeBytes(__m128i rows[16]) {
+  __m128i interleaved[16];
+  for (int round = 0; round < 4; ++round) {
+    for (int i = 0; i < 8; ++i) {
+      interleaved[2 * i] = _mm_unpacklo_epi8(rows[i], rows[i + 8]);
+      interleaved[2 * i + 1] = _mm_unpackhi_epi8(rows[i], rows[i + 8]);
+    }
+    std::copy(interleaved, interleaved + 16, rows);
+  }
+}
+#endif
+
+// Transposes the vertices into byte planes of the differences between
+// consecutive vertices.
+void EncodeVertexBlock(const uint8_t* vertices,
+                       const int num_vertices,
+                       const int vertex_stride,
+                       std::vector<uint8_t>* planes) {
+  planes->resize(static_cast<size_t>(num_vertices) * vertex_stride);
+  for (int k = 0; k < vertex_stride; ++k) {
+    uint8_t* plane = planes->data() + static_cast<size_t>(k) * num_vertices;
+    uint8_t previous = 0;
+    for (int v = 0; v < num_vertices; ++v) {
+      const uint8_t byte = vertices[static_cast<size_t>(v) * vertex_stride + k];
+      plane[v] = byte - previous;
+      previous = byte;
+    }
+  }
+}
+
+// Inverse of EncodeVertexBlock().
+void DecodeVertexBlock(const uint8_t* planes,
+                       const int num_vertices,
+                       const int vertex_stride,
+                       uint8_t* vertices) {
+  int v = 0;
+#ifdef WVU_HAS_SSE2
+  // Restores 16 vertices and up to 16 bytes of their stride at a time: the
+  // running sums of each byte plane give the rows, continuing from the byte
+  // of the previous vertex, and the transpose turns them into vertices.
+  for (; v + 16 <= num_vertices; v += 16) {
+    for (int k0 = 0; k0 < vertex_stride; k0 += 16) {
+      const int num_planes = std::min(16, vertex_stride - k0);
+      __m128i rows[16];
+      for (int j = 0; j < 16; ++j) {
+        if (j >= num_planes) {
+          rows[j] = _mm_setzero_si128();
+          continue;
+        }
+        const int k = k0 + j;
+        const __m128i differences = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(
+                planes + static_cast<size_t>(k) * num_vertices + v));
+        const uint8_t previous =
+            v > 0 ? vertices[static_cast<size_t>(v - 1) * vertex_stride + k]
+                  : 0;
+        rows[j] = _mm_add_epi8(PrefixSumBytes(differences),
+                               _mm_set1_epi8(static_cast<char>(previous)));
+      }
+      TransposeBytes(rows);
+      for (int i = 0; i < 16; ++i) {
+        uint8_t* vertex =
+            vertices + static_cast<size_t>(v + i) * vertex_stride + k0;
+        if (num_planes == 16) {
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(vertex), rows[i]);
+        } else {
+          uint8_t bytes[16];
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), rows[i]);
+          std::memcpy(vertex, bytes, num_planes);
+        }
+      }
+    }
+  }
+#endif
+  for (; v < num_vertices; ++v) {
+    uint8_t* vertex = vertices + static_cast<size_t>(v) * vertex_stride;
+    for (int k = 0; k < vertex_stride; ++k) {
+      const uint8_t previous = v > 0 ? vertex[k - vertex_stride] : 0;
+      vertex[k] = previous + planes[static_cast<size_t>(k) * num_vertices + v];
+    }
+  }
+}
+
+// Writes the zigzag-mapped differences between consecutive indices as
+// variable-length integers.
+void EncodeIndexBlock(const GLuint* indices,
+                      const int num_indices,
+                      std::vector<uint8_t>* bytes) {
+  bytes->clear();
+  GLuint previous = 0;
+  for (int i = 0; i < num_indices; ++i) {
+    const uint32_t difference = indices[i] - previous;
+    uint32_t value = (difference << 1) ^ (0u - (difference >> 31));
+    while (value >= 0x80) {
+      bytes->push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    bytes->push_back(static_cast<uint8_t>(value));
+    previous = indices[i];
+  }
+}
+
+// Inverse of EncodeIndexBlock(). Returns false if the bytes do not hold
+// exactly num_indices indices.
+bool DecodeIndexBlock(const uint8_t* bytes,
+                      const size_t size,
+                      const int num_indices,
+                      GLuint* indices) {
+  size_t position = 0;
+  GLuint previous = 0;
+  int i = 0;
+  while (i < num_indices) {
+#ifdef WVU_HAS_SSE2
+    // 16 differences of a single byte each, i.e., within [-64, 63], are
+    // unmapped, widened to 32 bits and summed without branches.
+    if (num_indices - i >= 16 && size - position >= 16) {
+      const __m128i values = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(bytes + position));
+      if (_mm_movemask_epi8(values) == 0) {
+        const __m128i halves = _mm_and_si128(_mm_srli_epi16(values, 1),
+                                             _mm_set1_epi8(0x7F));
+        const __m128i signs = _mm_sub_epi8(
+            _mm_setzero_si128(), _mm_and_si128(values, _mm_set1_epi8(1)));
+        const __m128i differences = _mm_xor_si128(halves, signs);
+        const __m128i low = _mm_srai_epi16(
+            _mm_unpacklo_epi8(differences, differences), 8);
+        const __m128i high = _mm_srai_epi16(
+            _mm_unpackhi_epi8(differences, differences), 8);
+        const __m128i quarters[4] = {
+            _mm_srai_epi32(_mm_unpacklo_epi16(low, low), 16),
+            _mm_srai_epi32(_mm_unpackhi_epi16(low, low), 16),
+            _mm_srai_epi32(_mm_unpacklo_epi16(high, high), 16),
+            _mm_srai_epi32(_mm_unpackhi_epi16(high, high), 16)};
+        __m128i sums = _mm_set1_epi32(static_cast<int>(previous));
+        for (int j = 0; j < 4; ++j) {
+          sums = _mm_add_epi32(PrefixSumInts(quarters[j]),
+                               _mm_shuffle_epi32(sums, 0xFF));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i + 4 * j),
+                           sums);
+        }
+        previous = indices[i + 15];
+        i += 16;
+        position += 16;
+        continue;
+      }
+    }
+#endif
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+      if (position == size || shift > 28) return false;
+      const uint8_t byte = bytes[position++];
+      value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) break;
+    }
+    previous += (value >> 1) ^ (0u - (value & 1));
+    indices[i++] = previous;
+  }
+  return position == size;
+}
+
+}  // namespace
+
+void EncodeVertexBuffer(const void* vertices,
+                        const int num_vertices,
+                        const int vertex_stride,
+                        std::vector<uint8_t>* encoded) {
+  const int num_blocks = (num_vertices + kMeshCodecVertexBlockSize - 1) /
+      kMeshCodecVertexBlockSize;
+  BeginBlocks(num_blocks, encoded);
+  const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+  Lz4BlockCompressor compressor;
+  std::vector<uint8_t> planes;
+  std::vector<uint8_t> compressed;
+  for (int i = 0; i < num_blocks; ++i) {
+    const int first = i * kMeshCodecVertexBlockSize;
+    EncodeVertexBlock(
+        bytes + static_cast<size_t>(first) * vertex_stride,
+        std::min(kMeshCodecVertexBlockSize, num_vertices - first),
+        vertex_stride, &planes);
+    AppendBlock(i, planes, &compressor, &compressed, encoded);
+  }
+}
+
+bool DecodeVertexBuffer(const uint8_t* encoded,
+                        const size_t encoded_size,
+                        const int num_vertices,
+                        const int vertex_stride,
+                        void* vertices,
+                        JobSystem* job_system) {
+  std::vector<EncodedBlock> blocks;
+  if ((vertex_stride <= 0 && num_vertices > 0) ||
+      !ParseBlocks(encoded, encoded_size, num_vertices,
+                   kMeshCodecVertexBlockSize, &blocks)) {
+    return false;
+  }
+  uint8_t* bytes = static_cast<uint8_t*>(vertices);
+  return DecodeBlocks(blocks, job_system,
+                      [bytes, vertex_stride](const EncodedBlock& block,
+                                             std::vector<uint8_t>* buffer) {
+    if (block.size != static_cast<uint64_t>(block.count) * vertex_stride) {
+      return false;
+    }
+    const uint8_t* planes = UnpackBlock(block, buffer);
+    if (planes == nullptr) return false;
+    DecodeVertexBlock(planes, block.count, vertex_stride,
+                      bytes + static_cast<size_t>(block.first) * vertex_stride);
+    return true;
+  });
+}
+
+void EncodeIndexBuffer(const GLuint* indices,
+                       const int num_indices,
+                       std::vector<uint8_t>* encoded) {
+  const int num_blocks = (num_indices + kMeshCodecIndexBlockSize - 1) /
+      kMeshCodecIndexBlockSize;
+  BeginBlocks(num_blocks, encoded);
+  Lz4BlockCompressor compressor;
+  std::vector<uint8_t> bytes;
+  std::vector<uint8_t> compressed;
+  for (int i = 0; i < num_blocks; ++i) {
+    const int first = i * kMeshCodecIndexBlockSize;
+    EncodeIndexBlock(indices + first,
+                     std::min(kMeshCodecIndexBlockSize, num_indices - first),
+                     &bytes);
+    AppendBlock(i, bytes, &compressor, &compressed, encoded);
+  }
+}
+
+bool DecodeIndexBuffer(const uint8_t* encoded,
+                       const size_t encoded_size,
+                       const int num_indices,
+                       GLuint* indices,
+                       JobSystem* job_system) {
+  std::vector<EncodedBlock> blocks;
+  if (!ParseBlocks(encoded, encoded_size, num_indices,
+                   kMeshCodecIndexBlockSize, &blocks)) {
+    return false;
+  }
+  return DecodeBlocks(blocks, job_system,
+                      [indices](const EncodedBlock& block,
+                                std::vector<uint8_t>* buffer) {
+    const uint8_t* bytes = UnpackBlock(block, buffer);
+    return bytes != nullptr &&
+        DecodeIndexBlock(bytes, block.size, block.count,
+                         indices + block.first);
+  });
+}
+
+}  // namespace wvu
@@ -0,0 +1,131 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESH_CODEC_H_
+#define GLUTILS_MESH_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+class JobSystem;
+
+// Compression of vertex and index buffers for storage and transfer. The codec
+// is lossless: it reproduces the buffers byte for byte, so attributes narrowed
+// by QuantizeModel() (see vertex_quantization.h) before encoding stay narrow,
+// and their small deltas compress best.
+//
+// Vertices are split into blocks of kMeshCodecVertexBlockSize vertices. Within
+// a block, every byte of a vertex is replaced by its difference with the same
+// byte of the previous vertex, and the differences are transposed into byte
+// planes, one per byte of the stride, so that the slowly varying bytes of
+// neighbor vertices form long runs. The planes are compressed into an LZ4
+// block. The decoder restores 16 vertices at a time with SSE2: a prefix sum
+// over each plane, then a 16x16 byte transpose back into vertices.
+//
+// Indices are split into blocks of kMeshCodecIndexBlockSize indices, a whole
+// number of triangles. Every index is replaced by its difference with the
+// previous one, zigzag-mapped so that small negative differences stay small,
+// and written as a variable-length integer of 7 bits per byte, which is then
+// compressed into an LZ4 block. Indices ordered for the vertex cache or into
+// meshlets (see mesh_optimizer.h and meshlet.h) differ by a few vertices, and
+// the decoder expands 16 single-byte differences at a time.
+//
+// The blocks are independent, so the decoders spread them over the workers of
+// a job system. An encoded buffer starts with the number of blocks and the
+// sizes of each block before and after compression, followed by the blocks.
+// A block that does not shrink when compressed is stored, which the decoder
+// tells by its sizes.
+//
+// Example:
+//
+// std::vector<uint8_t> encoded_vertices;
+// wvu::EncodeVertexBuffer(model.vertex_data().data(), model.num_vertices(),
+//                         model.vertex_layout().stride(), &encoded_vertices);
+// ...
+// std::vector<GLubyte> vertices(num_vertices * vertex_stride);
+// if (!wvu::DecodeVertexBuffer(encoded_vertices.data(),
+//                              encoded_vertices.size(), num_vertices,
+//                              vertex_stride, vertices.data(), &job_system)) {
+//   LOG(ERROR) << "Corrupt vertex buffer.";
+// }
+constexpr int kMeshCodecVertexBlockSize = 8192;
+constexpr int kMeshCodecIndexBlockSize = 3 * 8192;
+
+// Replaces encoded with the encoding of the num_vertices interleaved vertices
+// of vertex_stride bytes.
+void EncodeVertexBuffer(const void* vertices,
+                        const int num_vertices,
+                        const int vertex_stride,
+                        std::vector<uint8_t>* encoded);
+
+// Decodes the vertices encoded by EncodeVertexBuffer() into the num_vertices
+// * vertex_stride bytes of vertices. Returns false if the encoding is corrupt
+// or does not hold as many vertices; never reads or writes out of the
+// buffers.
+// Parameters:
+//   encoded  The encoded vertices.
+//   encoded_size  The size of the encoded vertices in bytes.
+//   num_vertices  The number of vertices.
+//   vertex_stride  The size of a vertex in bytes.
+//   vertices  The decoded vertices.
+//   job_system  The job system that decodes the blocks in parallel. The
+//     blocks are decoded on the calling thread if null.
+bool DecodeVertexBuffer(const uint8_t* encoded,
+                        const size_t encoded_size,
+                        const int num_vertices,
+                        const int vertex_stride,
+                        void* vertices,
+                        JobSystem* job_system);
+
+// Replaces encoded with the encoding of the num_indices indices. The restart
+// index of strips is encoded as any other index.
+void EncodeIndexBuffer(const GLuint* indices,
+                       const int num_indices,
+                       std::vector<uint8_t>* encoded);
+
+// Decodes the indices encoded by EncodeIndexBuffer() into the num_indices
+// indices. Returns false if the encoding is corrupt or does not hold as many
+// indices; never reads or writes out of the buffers.
+bool DecodeIndexBuffer(const uint8_t* encoded,
+                       const size_t encoded_size,
+                       const int num_indices,
+                       GLuint* indices,
+                       JobSystem* job_system);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESH_CODEC_H_
@@ -0,0 +1,302 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mesh_file.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "content_hash.h"
+#include "mapped_file.h"
+#include "mesh_codec.h"
+#include "model.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+
+uint64_t AlignOffset(const uint64_t offset) {
+  return (offset + kMeshFileAlignment - 1) / kMeshFileAlignment *
+      kMeshFileAlignment;
+}
+
+// Writes zeros until the stream reaches the given offset.
+void PadTo(const uint64_t offset, std::ofstream* out) {
+  static const char kZeros[kMeshFileAlignment] = {0};
+  const uint64_t position = out->tellp();
+  if (offset > position) {
+    out->write(kZeros, offset - position);
+  }
+}
+
+// The fields of the header that version 2 files hold.
+constexpr size_t kVersion2HeaderSize = offsetof(MeshFileHeader, encoded);
+
+bool WriteMeshFile(const Model& model,
+                   const bool encode,
+                   const std::string& filepath,
+                   std::string* error_info_log) {
+  if (model.cpu_data_released()) {
+    *error_info_log = "The vertices of the model were released.";
+    return false;
+  }
+  const VertexLayout& layout = model.vertex_layout();
+  MeshFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kMeshFileMagic;
+  header.version = kMeshFileVersion;
+  header.primitive_type = model.primitive_type();
+  header.index_type = model.index_type();
+  header.num_vertices = model.num_vertices();
+  header.num_indices = model.num_indices();
+  header.vertex_stride = layout.stride();
+  header.num_attributes = layout.num_attributes();
+  for (int i = 0; i < layout.num_attributes(); ++i) {
+    const VertexAttribute& attribute = layout.attribute(i);
+    header.attributes[i].semantic = attribute.semantic;
+    header.attributes[i].num_components = attribute.num_components;
+    header.attributes[i].type = attribute.type;
+    header.attributes[i].normalized = attribute.normalized;
+    header.attributes[i].offset = attribute.offset;
+  }
+  const VertexAttribute* position = layout.FindAttribute(POSITION);
+  if (position != nullptr && position->type == GL_FLOAT &&
+      model.num_vertices() > 0) {
+    Eigen::Vector3f min_corner = model.VertexPosition(0);
+    Eigen::Vector3f max_corner = min_corner;
+    for (int i = 1; i < model.num_vertices(); ++i) {
+      const Eigen::Vector3f p = model.VertexPosition(i);
+      min_corner = min_corner.cwiseMin(p);
+      max_corner = max_corner.cwiseMax(p);
+    }
+    std::memcpy(header.bounds_min, min_corner.data(),
+                sizeof(header.bounds_min));
+    std::memcpy(header.bounds_max, max_corner.data(),
+                sizeof(header.bounds_max));
+  }
+  header.vertex_data_offset = AlignOffset(sizeof(header));
+  header.vertex_data_size = model.vertex_data().size();
+  header.index_data_offset =
+      AlignOffset(header.vertex_data_offset + header.vertex_data_size);
+  header.index_data_size =
+      model.num_indices() * IndexSize(model.index_type());
+  // The encoded blobs replace the decoded ones in the file.
+  std::vector<uint8_t> encoded_vertices;
+  std::vector<uint8_t> encoded_indices;
+  if (encode) {
+    header.encoded = 1;
+    EncodeVertexBuffer(model.vertex_data().data(), model.num_vertices(),
+                       layout.stride(), &encoded_vertices);
+    EncodeIndexBuffer(model.indices().data(), model.num_indices(),
+                      &encoded_indices);
+    header.encoded_vertex_data_size = encoded_vertices.size();
+    header.encoded_index_data_size = encoded_indices.size();
+    header.index_data_offset = AlignOffset(header.vertex_data_offset +
+                                           encoded_vertices.size());
+  }
+
+  const std::string temporary_filepath = filepath + ".tmp";
+  std::ofstream out(temporary_filepath, std::ios::binary);
+  if (!out.is_open()) {
+    *error_info_log = "Could not open " + temporary_filepath;
+    return false;
+  }
+  std::vector<GLushort> short_indices;
+  const void* index_data = model.indices().data();
+  if (model.index_type() == GL_UNSIGNED_SHORT) {
+    short_indices.assign(model.indices().begin(), model.indices().end());
+    index_data = short_indices.data();
+  }
+  // The hash covers the header up to the bounds, since the bounds and the
+  // offsets follow from the rest.
+  header.content_hash = HashContent(
+      &header.primitive_type,
+      offsetof(MeshFileHeader, bounds_min) -
+          offsetof(MeshFileHeader, primitive_type));
+  header.content_hash = HashContent(model.vertex_data().data(),
+                                    header.vertex_data_size,
+                                    header.content_hash);
+  header.content_hash = HashContent(index_data, header.index_data_size,
+                                    header.content_hash);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  PadTo(header.vertex_data_offset, &out);
+  if (encode) {
+    out.write(reinterpret_cast<const char*>(encoded_vertices.data()),
+              encoded_vertices.size());
+    PadTo(header.index_data_offset, &out);
+    out.write(reinterpret_cast<const char*>(encoded_indices.data()),
+              encoded_indices.size());
+  } else {
+    out.write(reinterpret_cast<const char*>(model.vertex_data().data()),
+              header.vertex_data_size);
+    PadTo(header.index_data_offset, &out);
+    out.write(static_cast<const char*>(index_data), header.index_data_size);
+  }
+  out.close();
+  if (!out) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + temporary_filepath;
+    return false;
+  }
+  if (std::rename(temporary_filepath.c_str(), filepath.c_str()) != 0) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not rename " + temporary_filepath;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool WriteMeshFile(const Model& model,
+                   const std::string& filepath,
+                   std::string* error_info_log) {
+  return WriteMeshFile(model, false, filepath, error_info_log);
+}
+
+bool WriteEncodedMeshFile(const Model& model,
+                          const std::string& filepath,
+                          std::string* error_info_log) {
+  return WriteMeshFile(model, true, filepath, error_info_log);
+}
+
+bool MeshFile::Open(const std::string& filepath, std::string* error_info_log) {
+  std::shared_ptr<MappedFile> mapped_file(new MappedFile);
+  if (!mapped_file->Open(filepath)) {
+    *error_info_log = "Could not map " + filepath;
+    return false;
+  }
+  if (mapped_file->size() < kVersion2HeaderSize) {
+    *error_info_log = filepath + " is not a mesh file.";
+    return false;
+  }
+  // The mapping is page-aligned, so the header can be read in place.
+  const MeshFileHeader* header =
+      reinterpret_cast<const MeshFileHeader*>(mapped_file->data());
+  if (header->magic != kMeshFileMagic) {
+    *error_info_log = filepath + " is not a mesh file.";
+    return false;
+  }
+  if ((header->version != kMeshFileVersion && header->version != 2) ||
+      (header->version == kMeshFileVersion &&
+       mapped_file->size() < sizeof(MeshFileHeader))) {
+    *error_info_log = filepath + " has an unsupported version.";
+    return false;
+  }
+  const bool encoded =
+      header->version == kMeshFileVersion && header->encoded != 0;
+  const uint64_t file_size = mapped_file->size();
+  const uint64_t stored_vertex_data_size = encoded ?
+      header->encoded_vertex_data_size : header->vertex_data_size;
+  const uint64_t stored_index_data_size = encoded ?
+      header->encoded_index_data_size : header->index_data_size;
+  if (header->vertex_data_offset > file_size ||
+      stored_vertex_data_size > file_size - header->vertex_data_offset ||
+      header->index_data_offset > file_size ||
+      stored_index_data_size > file_size - header->index_data_offset ||
+      header->num_attributes > static_cast<uint32_t>(kMaxNumVertexAttributes) ||
+      (header->index_type != GL_UNSIGNED_SHORT &&
+       header->index_type != GL_UNSIGNED_INT) ||
+      header->index_data_size !=
+          static_cast<uint64_t>(header->num_indices) *
+              IndexSize(header->index_type) ||
+      header->vertex_data_size !=
+          static_cast<uint64_t>(header->num_vertices) * header->vertex_stride) {
+    *error_info_log = filepath + " is corrupted.";
+    return false;
+  }
+  VertexLayout layout(header->vertex_stride);
+  for (uint32_t i = 0; i < header->num_attributes; ++i) {
+    const MeshFileAttribute& attribute = header->attributes[i];
+    if (!layout.AddAttribute(static_cast<VertexSemantic>(attribute.semantic),
+                             attribute.num_components, attribute.type,
+                             attribute.normalized ? GL_TRUE : GL_FALSE,
+                             attribute.offset)) {
+      *error_info_log = filepath + " has an invalid vertex layout.";
+      return false;
+    }
+  }
+  mapped_file_ = mapped_file;
+  header_ = header;
+  encoded_ = encoded;
+  vertex_layout_ = layout;
+  return true;
+}
+
+bool MeshFile::ToModel(Model* model, JobSystem* job_system) const {
+  std::vector<GLuint> indices(num_indices());
+  if (encoded_) {
+    const uint8_t* data =
+        reinterpret_cast<const uint8_t*>(mapped_file_->data());
+    std::vector<GLubyte> vertices(vertex_data_size());
+    if (!DecodeVertexBuffer(data + header_->vertex_data_offset,
+                            header_->encoded_vertex_data_size,
+                            num_vertices(), header_->vertex_stride,
+                            vertices.data(), job_system) ||
+        !DecodeIndexBuffer(data + header_->index_data_offset,
+                           header_->encoded_index_data_size, num_indices(),
+                           indices.data(), job_system)) {
+      return false;
+    }
+    model->SetVertexData(vertex_layout_, std::move(vertices));
+    model->SetIndices(std::move(indices), primitive_type());
+    return true;
+  }
+  const GLubyte* vertices = static_cast<const GLubyte*>(vertex_data());
+  model->SetVertexData(vertex_layout_, std::vector<GLubyte>(
+      vertices, vertices + vertex_data_size()));
+  if (index_type() == GL_UNSIGNED_SHORT) {
+    const GLushort* short_indices = static_cast<const GLushort*>(index_data());
+    for (int i = 0; i < num_indices(); ++i) {
+      // Keep the restart index of strips.
+      indices[i] = short_indices[i] == 0xFFFF ?
+          kPrimitiveRestartIndex : short_indices[i];
+    }
+  } else {
+    std::memcpy(indices.data(), index_data(), index_data_size());
+  }
+  model->SetIndices(std::move(indices), primitive_type());
+  return true;
+}
+
+}  // namespace wvu
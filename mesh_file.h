@@ -0,0 +1,237 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESH_FILE_H_
+#define GLUTILS_MESH_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "mapped_file.h"
+#include "model.h"
+#include "vertex_format.h"
+
+namespace wvu {
+class JobSystem;
+
+// Binary mesh format. A mesh file holds a fixed-size header followed by the
+// vertex and index blobs exactly as the GPU consumes them: the interleaved
+// vertices in their layout, and the indices in the index type chosen for the
+// mesh. Each blob starts at a multiple of kMeshFileAlignment bytes, so the
+// blobs of a memory-mapped file can be passed directly to glBufferData() or
+// glBufferStorage() without parsing or copying. All fields are little-endian.
+// The header holds a hash of the content of the mesh, so the duplicates of a
+// mesh are found without reading their blobs.
+//
+// The blobs of an encoded mesh file are compressed with the codec of
+// mesh_codec.h instead, which shrinks them several times for storage and
+// transfer; they are decoded when the mesh is copied into a model. Files of
+// version 2, which predate encoding, are still read.
+constexpr uint32_t kMeshFileMagic = 0x4D555657;  // "WVUM".
+constexpr uint32_t kMeshFileVersion = 3;
+constexpr uint32_t kMeshFileAlignment = 64;
+
+// On-disk description of a vertex attribute.
+struct MeshFileAttribute {
+  uint32_t semantic;
+  uint32_t num_components;
+  uint32_t type;
+  uint32_t normalized;
+  uint32_t offset;
+};
+
+// On-disk header of a mesh file.
+struct MeshFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t primitive_type;
+  uint32_t index_type;
+  uint32_t num_vertices;
+  uint32_t num_indices;
+  uint32_t vertex_stride;
+  uint32_t num_attributes;
+  MeshFileAttribute attributes[kMaxNumVertexAttributes];
+  // Bounding box of the positions in model space.
+  float bounds_min[3];
+  float bounds_max[3];
+  uint64_t vertex_data_offset;
+  uint64_t vertex_data_size;
+  uint64_t index_data_offset;
+  uint64_t index_data_size;
+  // HashContent() of the primitive type, the index type, the counts, the
+  // vertex layout and the blobs: the meshes with equal hashes draw the same.
+  // The hash of an encoded file is that of its decoded blobs.
+  uint64_t content_hash;
+  // Fields of version 3. Non-zero if the blobs are encoded, in which case the
+  // data sizes above are those of the decoded blobs.
+  uint32_t encoded;
+  uint32_t reserved;
+  uint64_t encoded_vertex_data_size;
+  uint64_t encoded_index_data_size;
+};
+
+// Writes the vertices and indices of the model into a mesh file at filepath.
+// The file is written into a temporary file first, which is then renamed, so
+// readers never observe a partially written file. Returns true if successful,
+// otherwise the error is copied into error_info_log.
+// Parameters:
+//   model  The model to write. Its CPU data must not be released.
+//   filepath  The path of the mesh file.
+//   error_info_log  A pointer to a string that holds the error log.
+bool WriteMeshFile(const Model& model,
+                   const std::string& filepath,
+                   std::string* error_info_log);
+
+// Writes the model into an encoded mesh file at filepath, as WriteMeshFile()
+// does. Quantizing the model first (see vertex_quantization.h) and ordering
+// its indices for the vertex cache or into meshlets make the file smaller.
+bool WriteEncodedMeshFile(const Model& model,
+                          const std::string& filepath,
+                          std::string* error_info_log);
+
+// This class opens a mesh file through a memory mapping. Opening only
+// validates the header; the vertex and index blobs are paged in by the
+// operating system when the GPU upload reads them. The blobs of an encoded
+// file are decoded by ToModel() instead of being read in place.
+//
+// Example:
+//
+// wvu::MeshFile mesh_file;
+// std::string error_info_log;
+// if (!mesh_file.Open("/absolute/path/to/mesh.wvum", &error_info_log)) {
+//   LOG(ERROR) << error_info_log;
+// }
+// glBufferData(GL_ARRAY_BUFFER, mesh_file.vertex_data_size(),
+//              mesh_file.vertex_data(), GL_STATIC_DRAW);
+// mesh_file.vertex_layout().SetAttributePointers();
+// glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh_file.index_data_size(),
+//              mesh_file.index_data(), GL_STATIC_DRAW);
+class MeshFile {
+ public:
+  MeshFile() : header_(nullptr), encoded_(false) {}
+  ~MeshFile() {}
+
+  // Maps and validates the mesh file. Returns true if successful, otherwise
+  // the error is copied into error_info_log.
+  bool Open(const std::string& filepath, std::string* error_info_log);
+
+  // Copies the mesh into a model, widening 16-bit indices. The blobs of an
+  // encoded file are decoded on the workers of job_system, or on the calling
+  // thread if it is null. Returns false if they are corrupt.
+  bool ToModel(Model* model, JobSystem* job_system = nullptr) const;
+
+  // Returns true if the blobs are encoded, in which case vertex_data() and
+  // index_data() return null.
+  bool encoded() const {
+    return encoded_;
+  }
+
+  const VertexLayout& vertex_layout() const {
+    return vertex_layout_;
+  }
+
+  const void* vertex_data() const {
+    return encoded_ ? nullptr
+                    : mapped_file_->data() + header_->vertex_data_offset;
+  }
+
+  size_t vertex_data_size() const {
+    return header_->vertex_data_size;
+  }
+
+  const void* index_data() const {
+    return encoded_ ? nullptr
+                    : mapped_file_->data() + header_->index_data_offset;
+  }
+
+  size_t index_data_size() const {
+    return header_->index_data_size;
+  }
+
+  int num_vertices() const {
+    return header_->num_vertices;
+  }
+
+  int num_indices() const {
+    return header_->num_indices;
+  }
+
+  GLenum index_type() const {
+    return header_->index_type;
+  }
+
+  GLenum primitive_type() const {
+    return header_->primitive_type;
+  }
+
+  Eigen::Vector3f bounds_min() const {
+    return Eigen::Vector3f(header_->bounds_min[0], header_->bounds_min[1],
+                           header_->bounds_min[2]);
+  }
+
+  // Returns the hash of what the mesh draws, equal for identical meshes
+  // stored in different files.
+  uint64_t content_hash() const {
+    return header_->content_hash;
+  }
+
+  Eigen::Vector3f bounds_max() const {
+    return Eigen::Vector3f(header_->bounds_max[0], header_->bounds_max[1],
+                           header_->bounds_max[2]);
+  }
+
+  // Returns the mapping of the file. Sharing it keeps the blobs alive, e.g.,
+  // while an asynchronous upload reads them.
+  const std::shared_ptr<const MappedFile>& mapped_file() const {
+    return mapped_file_;
+  }
+
+ private:
+  std::shared_ptr<const MappedFile> mapped_file_;
+  // Points into the mapping.
+  const MeshFileHeader* header_;
+  bool encoded_;
+  VertexLayout vertex_layout_;
+
+  MeshFile(const MeshFile&) = delete;
+  MeshFile& operator=(const MeshFile&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESH_FILE_H_
@@ -0,0 +1,759 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mesh_importer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+#include "mapped_file.h"
+#include "model.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+
+// Minimum size of a chunk, so that small files are not split needlessly.
+constexpr size_t kMinChunkSize = 1 << 20;
+
+// ---------------------------- Parsing helpers. ------------------------------
+// The mapped files are not NUL-terminated, so every helper takes the end of
+// the range it may read.
+
+bool IsSpace(const char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char* SkipSpaces(const char* p, const char* end) {
+  while (p < end && IsSpace(*p)) ++p;
+  return p;
+}
+
+// Returns the start of the next line.
+const char* NextLine(const char* p, const char* end) {
+  const void* newline = std::memchr(p, '\n', end - p);
+  return newline == nullptr ? end : static_cast<const char*>(newline) + 1;
+}
+
+// Parses a decimal number with an optional fraction and exponent.
+bool ParseNumber(const char** cursor, const char* end, double* value) {
+  const char* p = SkipSpaces(*cursor, end);
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+  const char* digits_begin = p;
+  double result = 0.0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    result = 10.0 * result + (*p++ - '0');
+  }
+  if (p < end && *p == '.') {
+    ++p;
+    double scale = 0.1;
+    while (p < end && *p >= '0' && *p <= '9') {
+      result += (*p++ - '0') * scale;
+      scale *= 0.1;
+    }
+  }
+  if (p == digits_begin) return false;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool negative_exponent = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative_exponent = *p == '-';
+      ++p;
+    }
+    int exponent = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+      exponent = 10 * exponent + (*p++ - '0');
+    }
+    result *= std::pow(10.0, negative_exponent ? -exponent : exponent);
+  }
+  *value = negative ? -result : result;
+  *cursor = p;
+  return true;
+}
+
+bool ParseFloat(const char** cursor, const char* end, float* value) {
+  double number;
+  if (!ParseNumber(cursor, end, &number)) return false;
+  *value = static_cast<float>(number);
+  return true;
+}
+
+bool ParseInt(const char** cursor, const char* end, int64_t* value) {
+  const char* p = *cursor;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+  const char* digits_begin = p;
+  int64_t result = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    result = 10 * result + (*p++ - '0');
+  }
+  if (p == digits_begin) return false;
+  *value = negative ? -result : result;
+  *cursor = p;
+  return true;
+}
+
+// Returns true if the line at p starts with the keyword followed by a space.
+bool StartsWith(const char* p, const char* end, const char* keyword) {
+  const size_t length = std::strlen(keyword);
+  return static_cast<size_t>(end - p) > length &&
+      std::memcmp(p, keyword, length) == 0 && IsSpace(p[length]);
+}
+
+int NumThreads(const MeshImportOptions& options) {
+  if (options.num_threads > 0) return options.num_threads;
+  const int num_threads = std::thread::hardware_concurrency();
+  return num_threads > 0 ? num_threads : 1;
+}
+
+// Runs function(i) for every i in [0, num_tasks) on up to num_tasks threads.
+template <typename Function>
+void RunInParallel(const int num_tasks, const Function& function) {
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_tasks; ++i) {
+    threads.emplace_back([&function, i]() { function(i); });
+  }
+  if (num_tasks > 0) function(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+// Splits [begin, end) into at most num_chunks ranges of whole lines.
+std::vector<std::pair<const char*, const char*>> SplitIntoLines(
+    const char* begin, const char* end, const int num_chunks) {
+  std::vector<std::pair<const char*, const char*>> chunks;
+  const size_t size = end - begin;
+  const size_t chunk_size =
+      std::max(kMinChunkSize, size / std::max(num_chunks, 1) + 1);
+  const char* chunk_begin = begin;
+  while (chunk_begin < end) {
+    const char* chunk_end = size_t(end - chunk_begin) > chunk_size ?
+        NextLine(chunk_begin + chunk_size, end) : end;
+    chunks.push_back(std::make_pair(chunk_begin, chunk_end));
+    chunk_begin = chunk_end;
+  }
+  return chunks;
+}
+
+// Writes the attributes of an interleaved vertex.
+struct VertexWriter {
+  VertexLayout layout;
+  bool standard = false;
+
+  void Write(const float* position,
+             const float* normal,
+             const float* texcoord,
+             const GLubyte* color,
+             GLubyte* vertex) const {
+    if (!standard) {
+      PositionVertex* v = reinterpret_cast<PositionVertex*>(vertex);
+      std::memcpy(v->position, position, sizeof(v->position));
+      return;
+    }
+    static const float kZeros[3] = {0.0f, 0.0f, 0.0f};
+    static const GLubyte kWhite[4] = {255, 255, 255, 255};
+    StandardVertex* v = reinterpret_cast<StandardVertex*>(vertex);
+    std::memcpy(v->position, position, sizeof(v->position));
+    std::memcpy(v->normal, normal ? normal : kZeros, sizeof(v->normal));
+    std::memcpy(v->texcoord, texcoord ? texcoord : kZeros,
+                sizeof(v->texcoord));
+    std::memcpy(v->color, color ? color : kWhite, sizeof(v->color));
+  }
+};
+
+VertexWriter MakeVertexWriter(const bool standard) {
+  VertexWriter writer;
+  writer.standard = standard;
+  writer.layout = standard ? StandardVertex::Layout() :
+      PositionVertex::Layout();
+  return writer;
+}
+
+// ------------------------------- OBJ. ---------------------------------------
+
+// A face corner of an OBJ file. The indices are 0-based, or -1 if absent.
+struct ObjCorner {
+  int32_t position;
+  int32_t texcoord;
+  int32_t normal;
+
+  bool operator==(const ObjCorner& other) const {
+    return position == other.position && texcoord == other.texcoord &&
+        normal == other.normal;
+  }
+};
+
+struct ObjCornerHash {
+  size_t operator()(const ObjCorner& corner) const {
+    uint64_t hash = static_cast<uint32_t>(corner.position);
+    constexpr uint64_t kMultiplier = 0x9E3779B97F4A7C15ULL;
+    hash = hash * kMultiplier + static_cast<uint32_t>(corner.texcoord);
+    hash = hash * kMultiplier + static_cast<uint32_t>(corner.normal);
+    return static_cast<size_t>(hash ^ (hash >> 32));
+  }
+};
+
+struct ObjChunk {
+  const char* begin;
+  const char* end;
+  // Number of elements in the chunk, and number of elements in the previous
+  // chunks.
+  int num_positions = 0;
+  int num_texcoords = 0;
+  int num_normals = 0;
+  int first_position = 0;
+  int first_texcoord = 0;
+  int first_normal = 0;
+  // Triangulated corners, three per triangle.
+  std::vector<ObjCorner> corners;
+  std::string error;
+};
+
+void CountObjChunk(ObjChunk* chunk) {
+  for (const char* p = chunk->begin; p < chunk->end;
+       p = NextLine(p, chunk->end)) {
+    const char* line = SkipSpaces(p, chunk->end);
+    if (line + 1 >= chunk->end || line[0] != 'v') continue;
+    if (IsSpace(line[1])) {
+      ++chunk->num_positions;
+    } else if (line[1] == 't' && StartsWith(line, chunk->end, "vt")) {
+      ++chunk->num_texcoords;
+    } else if (line[1] == 'n' && StartsWith(line, chunk->end, "vn")) {
+      ++chunk->num_normals;
+    }
+  }
+}
+
+// Resolves an OBJ index, which is 1-based or relative to the last element
+// when negative.
+int32_t ResolveObjIndex(const int64_t index, const int num_elements_so_far) {
+  if (index > 0) return static_cast<int32_t>(index - 1);
+  return static_cast<int32_t>(num_elements_so_far + index);
+}
+
+// Parses the chunk, writing its attributes at their final position of the
+// flat attribute arrays.
+void ParseObjChunk(ObjChunk* chunk,
+                   float* positions,
+                   float* texcoords,
+                   float* normals) {
+  int position = chunk->first_position;
+  int texcoord = chunk->first_texcoord;
+  int normal = chunk->first_normal;
+  std::vector<ObjCorner> polygon;
+  const char* end = chunk->end;
+  for (const char* p = chunk->begin; p < end; p = NextLine(p, end)) {
+    const char* line = SkipSpaces(p, end);
+    if (line >= end || *line == '#' || *line == '\n') continue;
+    const char* cursor = line + 2;
+    bool valid = true;
+    if (StartsWith(line, end, "v")) {
+      cursor = line + 1;
+      float* values = positions + 3 * position++;
+      valid = ParseFloat(&cursor, end, &values[0]) &&
+          ParseFloat(&cursor, end, &values[1]) &&
+          ParseFloat(&cursor, end, &values[2]);
+    } else if (StartsWith(line, end, "vt")) {
+      float* values = texcoords + 2 * texcoord++;
+      valid = ParseFloat(&cursor, end, &values[0]);
+      if (!ParseFloat(&cursor, end, &values[1])) values[1] = 0.0f;
+    } else if (StartsWith(line, end, "vn")) {
+      float* values = normals + 3 * normal++;
+      valid = ParseFloat(&cursor, end, &values[0]) &&
+          ParseFloat(&cursor, end, &values[1]) &&
+          ParseFloat(&cursor, end, &values[2]);
+    } else if (StartsWith(line, end, "f")) {
+      cursor = line + 1;
+      polygon.clear();
+      while (true) {
+        cursor = SkipSpaces(cursor, end);
+        if (cursor >= end || *cursor == '\n' || *cursor == '#') break;
+        ObjCorner corner = {-1, -1, -1};
+        int64_t index;
+        if (!ParseInt(&cursor, end, &index)) {
+          valid = false;
+          break;
+        }
+        corner.position = ResolveObjIndex(index, position);
+        if (cursor < end && *cursor == '/') {
+          ++cursor;
+          if (ParseInt(&cursor, end, &index)) {
+            corner.texcoord = ResolveObjIndex(index, texcoord);
+          }
+          if (cursor < end && *cursor == '/') {
+            ++cursor;
+            if (ParseInt(&cursor, end, &index)) {
+              corner.normal = ResolveObjIndex(index, normal);
+            }
+          }
+        }
+        polygon.push_back(corner);
+      }
+      if (polygon.size() < 3) valid = false;
+      // Triangulate the polygon as a fan.
+      for (size_t i = 2; valid && i < polygon.size(); ++i) {
+        chunk->corners.push_back(polygon[0]);
+        chunk->corners.push_back(polygon[i - 1]);
+        chunk->corners.push_back(polygon[i]);
+      }
+    }
+    // Other statements (groups, materials, smoothing) are ignored.
+    if (!valid) {
+      chunk->error = "Malformed line: " +
+          std::string(line, NextLine(line, end) - line);
+      return;
+    }
+  }
+}
+
+// ------------------------------- PLY. ---------------------------------------
+
+enum PlyFormat { PLY_ASCII, PLY_BINARY_LITTLE_ENDIAN };
+
+enum PlyType {
+  PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32,
+  PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID
+};
+
+PlyType ParsePlyType(const std::string& name) {
+  if (name == "char" || name == "int8") return PLY_INT8;
+  if (name == "uchar" || name == "uint8") return PLY_UINT8;
+  if (name == "short" || name == "int16") return PLY_INT16;
+  if (name == "ushort" || name == "uint16") return PLY_UINT16;
+  if (name == "int" || name == "int32") return PLY_INT32;
+  if (name == "uint" || name == "uint32") return PLY_UINT32;
+  if (name == "float" || name == "float32") return PLY_FLOAT32;
+  if (name == "double" || name == "float64") return PLY_FLOAT64;
+  return PLY_INVALID;
+}
+
+size_t PlyTypeSize(const PlyType type) {
+  static const size_t kSizes[] = {1, 1, 2, 2, 4, 4, 4, 8, 0};
+  return kSizes[type];
+}
+
+struct PlyProperty {
+  std::string name;
+  PlyType type = PLY_INVALID;
+  // For list properties, the type of the count. PLY_INVALID otherwise.
+  PlyType count_type = PLY_INVALID;
+};
+
+struct PlyElement {
+  std::string name;
+  int64_t count = 0;
+  std::vector<PlyProperty> properties;
+};
+
+// Reads a value of the given type and advances the cursor.
+bool ReadPlyValue(const PlyFormat format,
+                  const PlyType type,
+                  const char** cursor,
+                  const char* end,
+                  double* value) {
+  if (format == PLY_ASCII) {
+    return ParseNumber(cursor, end, value);
+  }
+  const size_t size = PlyTypeSize(type);
+  if (static_cast<size_t>(end - *cursor) < size) return false;
+  const char* p = *cursor;
+  switch (type) {
+    case PLY_INT8: { int8_t v; std::memcpy(&v, p, 1); *value = v; break; }
+    case PLY_UINT8: { uint8_t v; std::memcpy(&v, p, 1); *value = v; break; }
+    case PLY_INT16: { int16_t v; std::memcpy(&v, p, 2); *value = v; break; }
+    case PLY_UINT16: { uint16_t v; std::memcpy(&v, p, 2); *value = v; break; }
+    case PLY_INT32: { int32_t v; std::memcpy(&v, p, 4); *value = v; break; }
+    case PLY_UINT32: { uint32_t v; std::memcpy(&v, p, 4); *value = v; break; }
+    case PLY_FLOAT32: { float v; std::memcpy(&v, p, 4); *value = v; break; }
+    case PLY_FLOAT64: { std::memcpy(value, p, 8); break; }
+    default: return false;
+  }
+  *cursor = p + size;
+  return true;
+}
+
+// Parses the header. Returns the start of the body, or nullptr on errors.
+const char* ParsePlyHeader(const char* begin,
+                           const char* end,
+                           PlyFormat* format,
+                           std::vector<PlyElement>* elements) {
+  if (end - begin < 4 || std::memcmp(begin, "ply", 3) != 0) return nullptr;
+  bool has_format = false;
+  for (const char* p = NextLine(begin, end); p < end; p = NextLine(p, end)) {
+    const char* line_end = NextLine(p, end);
+    std::vector<std::string> words;
+    for (const char* q = p; q < line_end;) {
+      q = SkipSpaces(q, line_end);
+      const char* word_begin = q;
+      while (q < line_end && !IsSpace(*q) && *q != '\n') ++q;
+      if (q > word_begin) words.emplace_back(word_begin, q);
+      if (q < line_end && *q == '\n') break;
+    }
+    if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+      continue;
+    }
+    if (words[0] == "end_header") {
+      return has_format ? line_end : nullptr;
+    }
+    if (words[0] == "format" && words.size() >= 2) {
+      if (words[1] == "ascii") {
+        *format = PLY_ASCII;
+      } else if (words[1] == "binary_little_endian") {
+        *format = PLY_BINARY_LITTLE_ENDIAN;
+      } else {
+        return nullptr;
+      }
+      has_format = true;
+    } else if (words[0] == "element" && words.size() == 3) {
+      PlyElement element;
+      element.name = words[1];
+      const char* count = words[2].c_str();
+      if (!ParseInt(&count, count + words[2].size(), &element.count) ||
+          element.count < 0) {
+        return nullptr;
+      }
+      elements->push_back(element);
+    } else if (words[0] == "property" && !elements->empty()) {
+      PlyProperty property;
+      if (words.size() == 5 && words[1] == "list") {
+        property.count_type = ParsePlyType(words[2]);
+        property.type = ParsePlyType(words[3]);
+        property.name = words[4];
+        if (property.count_type == PLY_INVALID) return nullptr;
+      } else if (words.size() == 3) {
+        property.type = ParsePlyType(words[1]);
+        property.name = words[2];
+      } else {
+        return nullptr;
+      }
+      if (property.type == PLY_INVALID) return nullptr;
+      elements->back().properties.push_back(property);
+    } else {
+      return nullptr;
+    }
+  }
+  return nullptr;
+}
+
+// Skips one instance of an element.
+bool SkipPlyElement(const PlyFormat format,
+                    const PlyElement& element,
+                    const char** cursor,
+                    const char* end) {
+  if (format == PLY_ASCII) {
+    *cursor = NextLine(*cursor, end);
+    return true;
+  }
+  for (const PlyProperty& property : element.properties) {
+    double count = 1.0;
+    if (property.count_type != PLY_INVALID &&
+        !ReadPlyValue(format, property.count_type, cursor, end, &count)) {
+      return false;
+    }
+    const size_t size = static_cast<size_t>(count) * PlyTypeSize(property.type);
+    if (static_cast<size_t>(end - *cursor) < size) return false;
+    *cursor += size;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ImportMesh(const std::string& filepath,
+                const MeshImportOptions& options,
+                Model* model,
+                std::string* error_info_log) {
+  const std::string::size_type dot = filepath.rfind('.');
+  std::string extension =
+      dot == std::string::npos ? "" : filepath.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 ::tolower);
+  if (extension == "obj") {
+    return ImportObj(filepath, options, model, error_info_log);
+  }
+  if (extension == "ply") {
+    return ImportPly(filepath, options, model, error_info_log);
+  }
+  *error_info_log = "Unsupported mesh format: " + filepath;
+  return false;
+}
+
+bool ImportObj(const std::string& filepath,
+               const MeshImportOptions& options,
+               Model* model,
+               std::string* error_info_log) {
+  MappedFile mapped_file;
+  if (!mapped_file.Open(filepath)) {
+    *error_info_log = "Could not map " + filepath;
+    return false;
+  }
+  const char* begin = mapped_file.data();
+  const char* end = begin + mapped_file.size();
+  const std::vector<std::pair<const char*, const char*>> ranges =
+      SplitIntoLines(begin, end, NumThreads(options));
+  std::vector<ObjChunk> chunks(ranges.size());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    chunks[i].begin = ranges[i].first;
+    chunks[i].end = ranges[i].second;
+  }
+  const int num_chunks = chunks.size();
+
+  // First pass: count the attributes of each chunk, and compute where each
+  // chunk writes its attributes.
+  RunInParallel(num_chunks, [&chunks](const int i) {
+    CountObjChunk(&chunks[i]);
+  });
+  int num_positions = 0;
+  int num_texcoords = 0;
+  int num_normals = 0;
+  for (ObjChunk& chunk : chunks) {
+    chunk.first_position = num_positions;
+    chunk.first_texcoord = num_texcoords;
+    chunk.first_normal = num_normals;
+    num_positions += chunk.num_positions;
+    num_texcoords += chunk.num_texcoords;
+    num_normals += chunk.num_normals;
+  }
+
+  // Second pass: parse the chunks.
+  std::unique_ptr<float[]> positions(new float[3 * num_positions]);
+  std::unique_ptr<float[]> texcoords(new float[2 * num_texcoords]);
+  std::unique_ptr<float[]> normals(new float[3 * num_normals]);
+  RunInParallel(num_chunks, [&](const int i) {
+    ParseObjChunk(&chunks[i], positions.get(), texcoords.get(), normals.get());
+  });
+  size_t num_corners = 0;
+  for (const ObjChunk& chunk : chunks) {
+    if (!chunk.error.empty()) {
+      *error_info_log = filepath + ": " + chunk.error;
+      return false;
+    }
+    num_corners += chunk.corners.size();
+  }
+
+  // Build the interleaved vertex stream.
+  const VertexWriter writer =
+      MakeVertexWriter(num_texcoords > 0 || num_normals > 0);
+  const GLsizei stride = writer.layout.stride();
+  std::vector<GLubyte> vertex_data;
+  std::vector<GLuint> indices;
+  indices.reserve(num_corners);
+  std::unordered_map<ObjCorner, GLuint, ObjCornerHash> vertex_ids;
+  if (options.deduplicate_vertices) {
+    vertex_ids.reserve(num_corners / 2);
+  }
+  GLuint num_vertices = 0;
+  for (const ObjChunk& chunk : chunks) {
+    for (const ObjCorner& corner : chunk.corners) {
+      if (corner.position < 0 || corner.position >= num_positions ||
+          corner.texcoord >= num_texcoords || corner.normal >= num_normals) {
+        *error_info_log = filepath + ": face index out of range.";
+        return false;
+      }
+      if (options.deduplicate_vertices) {
+        const auto inserted = vertex_ids.emplace(corner, num_vertices);
+        if (!inserted.second) {
+          indices.push_back(inserted.first->second);
+          continue;
+        }
+      }
+      vertex_data.resize(vertex_data.size() + stride);
+      writer.Write(positions.get() + 3 * corner.position,
+                   corner.normal >= 0 ? normals.get() + 3 * corner.normal :
+                       nullptr,
+                   corner.texcoord >= 0 ?
+                       texcoords.get() + 2 * corner.texcoord : nullptr,
+                   nullptr, &vertex_data[vertex_data.size() - stride]);
+      indices.push_back(num_vertices++);
+    }
+  }
+  model->SetVertexData(writer.layout, std::move(vertex_data));
+  model->SetIndices(std::move(indices));
+  return true;
+}
+
+bool ImportPly(const std::string& filepath,
+               const MeshImportOptions& options,
+               Model* model,
+               std::string* error_info_log) {
+  MappedFile mapped_file;
+  if (!mapped_file.Open(filepath)) {
+    *error_info_log = "Could not map " + filepath;
+    return false;
+  }
+  const char* end = mapped_file.data() + mapped_file.size();
+  PlyFormat format = PLY_ASCII;
+  std::vector<PlyElement> elements;
+  const char* cursor =
+      ParsePlyHeader(mapped_file.data(), end, &format, &elements);
+  if (cursor == nullptr) {
+    *error_info_log = filepath + ": invalid PLY header.";
+    return false;
+  }
+
+  // Find the properties of the vertices.
+  bool has_vertices = false;
+  bool standard = false;
+  for (const PlyElement& element : elements) {
+    if (element.name != "vertex") continue;
+    has_vertices = true;
+    for (const PlyProperty& property : element.properties) {
+      if (property.name != "x" && property.name != "y" &&
+          property.name != "z") {
+        standard = true;
+      }
+    }
+  }
+  if (!has_vertices) {
+    *error_info_log = filepath + ": no vertex element.";
+    return false;
+  }
+  const VertexWriter writer = MakeVertexWriter(standard);
+  const GLsizei stride = writer.layout.stride();
+  std::vector<GLubyte> vertex_data;
+  std::vector<GLuint> indices;
+  std::vector<GLuint> polygon;
+  int64_t num_vertices = 0;
+  for (const PlyElement& element : elements) {
+    const bool is_vertex = element.name == "vertex";
+    const bool is_face = element.name == "face";
+    if (is_vertex) {
+      vertex_data.resize(element.count * stride);
+      num_vertices = element.count;
+    }
+    for (int64_t i = 0; i < element.count; ++i) {
+      if (!is_vertex && !is_face) {
+        if (!SkipPlyElement(format, element, &cursor, end)) {
+          *error_info_log = filepath + ": truncated file.";
+          return false;
+        }
+        continue;
+      }
+      float position[3] = {0.0f, 0.0f, 0.0f};
+      float normal[3] = {0.0f, 0.0f, 0.0f};
+      float texcoord[2] = {0.0f, 0.0f};
+      GLubyte color[4] = {255, 255, 255, 255};
+      for (const PlyProperty& property : element.properties) {
+        double value = 0.0;
+        if (property.count_type != PLY_INVALID) {
+          double count;
+          if (!ReadPlyValue(format, property.count_type, &cursor, end,
+                            &count)) {
+            *error_info_log = filepath + ": truncated file.";
+            return false;
+          }
+          polygon.clear();
+          for (int k = 0; k < static_cast<int>(count); ++k) {
+            if (!ReadPlyValue(format, property.type, &cursor, end, &value)) {
+              *error_info_log = filepath + ": truncated file.";
+              return false;
+            }
+            polygon.push_back(static_cast<GLuint>(value));
+          }
+          if (is_face && (property.name == "vertex_indices" ||
+                          property.name == "vertex_index")) {
+            for (size_t k = 2; k < polygon.size(); ++k) {
+              indices.push_back(polygon[0]);
+              indices.push_back(polygon[k - 1]);
+              indices.push_back(polygon[k]);
+            }
+          }
+          continue;
+        }
+        if (!ReadPlyValue(format, property.type, &cursor, end, &value)) {
+          *error_info_log = filepath + ": truncated file.";
+          return false;
+        }
+        const std::string& name = property.name;
+        // Integer colors are in [0, 255], and float colors in [0, 1].
+        const bool float_type =
+            property.type == PLY_FLOAT32 || property.type == PLY_FLOAT64;
+        const GLubyte color_value = static_cast<GLubyte>(
+            std::max(0.0, std::min(255.0, float_type ? value * 255.0 : value)));
+        if (name == "x" || name == "y" || name == "z") {
+          position[name[0] - 'x'] = value;
+        } else if (name == "nx" || name == "ny" || name == "nz") {
+          normal[name[1] - 'x'] = value;
+        } else if (name == "s" || name == "u" || name == "texture_u") {
+          texcoord[0] = value;
+        } else if (name == "t" || name == "v" || name == "texture_v") {
+          texcoord[1] = value;
+        } else if (name == "red") {
+          color[0] = color_value;
+        } else if (name == "green") {
+          color[1] = color_value;
+        } else if (name == "blue") {
+          color[2] = color_value;
+        } else if (name == "alpha") {
+          color[3] = color_value;
+        }
+      }
+      if (format == PLY_ASCII) {
+        cursor = NextLine(cursor, end);
+      }
+      if (is_vertex) {
+        writer.Write(position, normal, texcoord, color,
+                     &vertex_data[i * stride]);
+      }
+    }
+  }
+  for (const GLuint index : indices) {
+    if (index >= num_vertices) {
+      *error_info_log = filepath + ": face index out of range.";
+      return false;
+    }
+  }
+  model->SetVertexData(writer.layout, std::move(vertex_data));
+  model->SetIndices(std::move(indices));
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,89 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESH_IMPORTER_H_
+#define GLUTILS_MESH_IMPORTER_H_
+
+#include <string>
+
+#include "model.h"
+
+namespace wvu {
+// Options of the mesh importers.
+struct MeshImportOptions {
+  // Number of threads parsing the file. Zero uses one thread per hardware
+  // thread.
+  int num_threads = 0;
+  // Merges the OBJ face corners referencing the same position, texture
+  // coordinates and normal into a single vertex.
+  bool deduplicate_vertices = true;
+};
+
+// Imports a Wavefront OBJ or a PLY file into a model, based on the extension
+// of filepath. The vertices are written directly into the interleaved stream
+// of the model: wvu::StandardVertex when the file provides normals, texture
+// coordinates or colors, and wvu::PositionVertex otherwise. Polygons are
+// triangulated as fans. Returns true if successful, otherwise the error is
+// copied into error_info_log.
+// Parameters:
+//   filepath  The path of the .obj or .ply file.
+//   options  The importer options.
+//   model  The imported model.
+//   error_info_log  A pointer to a string that holds the error log.
+bool ImportMesh(const std::string& filepath,
+                const MeshImportOptions& options,
+                Model* model,
+                std::string* error_info_log);
+
+// Imports a Wavefront OBJ file. The file is memory-mapped and split into
+// chunks of whole lines that are parsed in parallel: a first pass counts the
+// elements of each chunk, so that the second pass writes the attributes of
+// every chunk directly at their final position.
+bool ImportObj(const std::string& filepath,
+               const MeshImportOptions& options,
+               Model* model,
+               std::string* error_info_log);
+
+// Imports an ASCII or binary little-endian PLY file with a vertex element (x,
+// y, z and optionally nx, ny, nz, s/u, t/v, red, green, blue, alpha) and a face
+// element with a vertex index list. The vertices are already indexed, so they
+// are not deduplicated.
+bool ImportPly(const std::string& filepath,
+               const MeshImportOptions& options,
+               Model* model,
+               std::string* error_info_log);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESH_IMPORTER_H_
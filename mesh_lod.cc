@@ -0,0 +1,314 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mesh_lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "model.h"
+
+namespace wvu {
+namespace {
+
+// A candidate collapse of vertex from onto vertex to. The versions detect
+// candidates made stale by other collapses.
+struct Collapse {
+  double cost;
+  GLuint from;
+  GLuint to;
+  uint32_t from_version;
+  uint32_t to_version;
+
+  bool operator<(const Collapse& other) const {
+    // std::priority_queue pops the largest element first.
+    return cost > other.cost;
+  }
+};
+
+class Simplifier {
+ public:
+  Simplifier(const Model& model, const std::vector<GLuint>& indices)
+      : num_alive_triangles_(indices.size() / 3) {
+    const int num_vertices = model.num_vertices();
+    positions_.resize(num_vertices);
+    for (int v = 0; v < num_vertices; ++v) {
+      positions_[v] = model.VertexPosition(v).cast<double>();
+    }
+    quadrics_.assign(num_vertices, Eigen::Matrix4d::Zero());
+    vertex_triangles_.resize(num_vertices);
+    versions_.assign(num_vertices, 0);
+    locked_.assign(num_vertices, false);
+    triangles_.resize(indices.size() / 3 * 3);
+    std::copy(indices.begin(), indices.begin() + triangles_.size(),
+              triangles_.begin());
+    alive_.assign(num_alive_triangles_, true);
+    // Accumulate the plane quadrics of the triangles, and find the boundary
+    // edges, which belong to a single triangle.
+    std::unordered_map<uint64_t, int> edge_counts;
+    for (int t = 0; t < num_alive_triangles_; ++t) {
+      const GLuint* tri = &triangles_[3 * t];
+      if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+        alive_[t] = false;
+        continue;
+      }
+      const Eigen::Vector3d normal =
+          (positions_[tri[1]] - positions_[tri[0]]).cross(
+              positions_[tri[2]] - positions_[tri[0]]);
+      const double area = normal.norm();
+      if (area > 0.0) {
+        Eigen::Vector4d plane;
+        plane << normal / area, -normal.dot(positions_[tri[0]]) / area;
+        // Weighting by the area favors keeping large triangles.
+        const Eigen::Matrix4d quadric = area * plane * plane.transpose();
+        for (int k = 0; k < 3; ++k) quadrics_[tri[k]] += quadric;
+      }
+      for (int k = 0; k < 3; ++k) {
+        vertex_triangles_[tri[k]].push_back(t);
+        const GLuint a = std::min(tri[k], tri[(k + 1) % 3]);
+        const GLuint b = std::max(tri[k], tri[(k + 1) % 3]);
+        ++edge_counts[(static_cast<uint64_t>(a) << 32) | b];
+      }
+    }
+    num_alive_triangles_ = std::count(alive_.begin(), alive_.end(), true);
+    for (const auto& edge : edge_counts) {
+      if (edge.second == 1) {
+        locked_[edge.first >> 32] = true;
+        locked_[edge.first & 0xFFFFFFFF] = true;
+      }
+    }
+    for (int t = 0; t < static_cast<int>(alive_.size()); ++t) {
+      if (!alive_[t]) continue;
+      for (int k = 0; k < 3; ++k) {
+        PushCollapse(triangles_[3 * t + k], triangles_[3 * t + (k + 1) % 3]);
+        PushCollapse(triangles_[3 * t + (k + 1) % 3], triangles_[3 * t + k]);
+      }
+    }
+  }
+
+  // Collapses vertices until reaching target_num_triangles. Returns the error.
+  float Run(const int target_num_triangles, std::vector<GLuint>* indices) {
+    double max_cost = 0.0;
+    while (num_alive_triangles_ > target_num_triangles && !queue_.empty()) {
+      const Collapse collapse = queue_.top();
+      queue_.pop();
+      if (collapse.from_version != versions_[collapse.from] ||
+          collapse.to_version != versions_[collapse.to]) {
+        continue;
+      }
+      if (!Apply(collapse.from, collapse.to)) continue;
+      max_cost = std::max(max_cost, collapse.cost);
+    }
+    indices->clear();
+    for (int t = 0; t < static_cast<int>(alive_.size()); ++t) {
+      if (!alive_[t]) continue;
+      indices->insert(indices->end(), &triangles_[3 * t],
+                      &triangles_[3 * t] + 3);
+    }
+    // The quadric error is a sum of squared distances to the planes.
+    return static_cast<float>(std::sqrt(std::max(max_cost, 0.0)));
+  }
+
+ private:
+  double Cost(const GLuint from, const GLuint to) const {
+    const Eigen::Vector4d p = positions_[to].homogeneous();
+    return p.dot((quadrics_[from] + quadrics_[to]) * p);
+  }
+
+  void PushCollapse(const GLuint from, const GLuint to) {
+    if (locked_[from]) return;
+    Collapse collapse;
+    collapse.cost = Cost(from, to);
+    collapse.from = from;
+    collapse.to = to;
+    collapse.from_version = versions_[from];
+    collapse.to_version = versions_[to];
+    queue_.push(collapse);
+  }
+
+  // Moves from onto to unless a triangle would flip. Returns true if the
+  // collapse was applied.
+  bool Apply(const GLuint from, const GLuint to) {
+    for (const int t : vertex_triangles_[from]) {
+      if (!alive_[t]) continue;
+      const GLuint* tri = &triangles_[3 * t];
+      if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+      Eigen::Vector3d before[3], after[3];
+      for (int k = 0; k < 3; ++k) {
+        before[k] = positions_[tri[k]];
+        after[k] = tri[k] == from ? positions_[to] : positions_[tri[k]];
+      }
+      const Eigen::Vector3d n0 =
+          (before[1] - before[0]).cross(before[2] - before[0]);
+      const Eigen::Vector3d n1 =
+          (after[1] - after[0]).cross(after[2] - after[0]);
+      if (n0.dot(n1) <= 0.0) return false;
+    }
+    for (const int t : vertex_triangles_[from]) {
+      if (!alive_[t]) continue;
+      GLuint* tri = &triangles_[3 * t];
+      if (tri[0] == to || tri[1] == to || tri[2] == to) {
+        alive_[t] = false;
+        --num_alive_triangles_;
+        continue;
+      }
+      for (int k = 0; k < 3; ++k) {
+        if (tri[k] == from) tri[k] = to;
+      }
+      vertex_triangles_[to].push_back(t);
+    }
+    vertex_triangles_[from].clear();
+    quadrics_[to] += quadrics_[from];
+    ++versions_[from];
+    ++versions_[to];
+    // Remove the dead triangles of to and queue the collapses around it.
+    std::vector<int>& triangles = vertex_triangles_[to];
+    triangles.erase(std::remove_if(triangles.begin(), triangles.end(),
+                                   [this](const int t) { return !alive_[t]; }),
+                    triangles.end());
+    for (const int t : triangles) {
+      for (int k = 0; k < 3; ++k) {
+        const GLuint other = triangles_[3 * t + k];
+        if (other == to) continue;
+        ++versions_[other];
+      }
+    }
+    for (const int t : triangles) {
+      for (int k = 0; k < 3; ++k) {
+        const GLuint other = triangles_[3 * t + k];
+        if (other == to) continue;
+        PushCollapse(other, to);
+        PushCollapse(to, other);
+        for (int j = 0; j < 3; ++j) {
+          const GLuint neighbor = triangles_[3 * t + j];
+          if (neighbor != other) PushCollapse(other, neighbor);
+        }
+      }
+    }
+    return true;
+  }
+
+  std::vector<Eigen::Vector3d> positions_;
+  std::vector<Eigen::Matrix4d, Eigen::aligned_allocator<Eigen::Matrix4d>>
+      quadrics_;
+  std::vector<std::vector<int>> vertex_triangles_;
+  std::vector<uint32_t> versions_;
+  std::vector<bool> locked_;
+  std::vector<GLuint> triangles_;
+  std::vector<bool> alive_;
+  int num_alive_triangles_;
+  std::priority_queue<Collapse> queue_;
+};
+
+}  // namespace
+
+float SimplifyMesh(const Model& model,
+                   const std::vector<GLuint>& indices,
+                   const int target_num_triangles,
+                   std::vector<GLuint>* simplified_indices) {
+  Simplifier simplifier(model, indices);
+  return simplifier.Run(target_num_triangles, simplified_indices);
+}
+
+bool MeshLodChain::Build(const Model& model,
+                         const int max_num_lods,
+                         const float reduction_ratio) {
+  indices_.clear();
+  lods_.clear();
+  if (model.primitive_type() != GL_TRIANGLES || model.cpu_data_released() ||
+      max_num_lods < 1) {
+    return false;
+  }
+  MeshLod full_resolution;
+  full_resolution.num_indices = model.indices().size();
+  lods_.push_back(full_resolution);
+  indices_ = model.indices();
+  std::vector<GLuint> lod_indices = model.indices();
+  std::vector<GLuint> simplified_indices;
+  float error = 0.0f;
+  while (static_cast<int>(lods_.size()) < max_num_lods) {
+    const int num_triangles = lod_indices.size() / 3;
+    const int target_num_triangles = num_triangles * reduction_ratio;
+    // Simplifying the previous level is cheaper than simplifying the full
+    // mesh, and yields nested levels.
+    error = std::max(error, SimplifyMesh(model, lod_indices,
+                                         target_num_triangles,
+                                         &simplified_indices));
+    if (simplified_indices.size() / 3 >= static_cast<size_t>(num_triangles) ||
+        simplified_indices.empty()) {
+      break;
+    }
+    MeshLod lod;
+    lod.first_index = indices_.size();
+    lod.num_indices = simplified_indices.size();
+    lod.error = error;
+    lods_.push_back(lod);
+    indices_.insert(indices_.end(), simplified_indices.begin(),
+                    simplified_indices.end());
+    lod_indices.swap(simplified_indices);
+  }
+  return true;
+}
+
+int MeshLodChain::SelectLod(const float distance,
+                            const float field_of_view,
+                            const int viewport_height,
+                            const float max_pixel_error) const {
+  if (lods_.empty()) return 0;
+  // Pixels per world unit at the given distance, following the y scale of
+  // ComputeProjectionMatrix().
+  const float y_scale = 1.0f / std::tan(0.5f * field_of_view);
+  const float pixels_per_unit = 0.5f * viewport_height * y_scale /
+      std::max(distance, 1e-6f);
+  if (impostor_pixel_radius_ > 0.0f &&
+      impostor_radius_ * pixels_per_unit <= impostor_pixel_radius_) {
+    return num_lods();
+  }
+  int selected = 0;
+  for (int i = 1; i < static_cast<int>(lods_.size()); ++i) {
+    if (lods_[i].error * pixels_per_unit > max_pixel_error) break;
+    selected = i;
+  }
+  return selected;
+}
+
+}  // namespace wvu
@@ -0,0 +1,160 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESH_LOD_H_
+#define GLUTILS_MESH_LOD_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "model.h"
+
+namespace wvu {
+// Simplifies a triangle list of the model with quadric error metrics (Garland
+// and Heckbert). The simplification collapses vertices onto neighbor vertices
+// instead of creating new ones, so the simplified indices keep referencing the
+// vertex buffer of the model. Boundary vertices are never collapsed, which
+// keeps the silhouette of open meshes and the seams of tiles. Returns the
+// geometric error of the result, i.e., an estimate of the maximum distance
+// between the simplified and the original surfaces in model units.
+// Parameters:
+//   model  The model providing the positions.
+//   indices  The triangle list to simplify.
+//   target_num_triangles  The number of triangles to reach. The result may
+//     have more triangles if no more vertices can be collapsed.
+//   simplified_indices  The simplified triangle list.
+float SimplifyMesh(const Model& model,
+                   const std::vector<GLuint>& indices,
+                   const int target_num_triangles,
+                   std::vector<GLuint>* simplified_indices);
+
+// A level of detail: a range of the combined index buffer of a chain.
+struct MeshLod {
+  // First index of the level in the combined index buffer.
+  int first_index = 0;
+  int num_indices = 0;
+  // Geometric error of the level in model units.
+  float error = 0.0f;
+};
+
+// This class builds a chain of levels of detail for a model. All levels share
+// the vertex buffer of the model and are stored in a single index buffer, so
+// switching levels only changes the range of the draw call. The levels are
+// selected by their projected error in pixels. Beyond the last level, a chain
+// with an impostor (see ImpostorAtlas) selects it once the model covers
+// fewer pixels than the views of the impostor have texels.
+//
+// Example:
+//
+// wvu::MeshLodChain lod_chain;
+// lod_chain.Build(model, 4, 0.5f);
+// model.SetIndices(lod_chain.indices());
+// ...  // Upload the model.
+// const wvu::MeshLod& lod = lod_chain.lod(
+//     lod_chain.SelectLod(distance, field_of_view, viewport_height, 1.0f));
+// glDrawElements(GL_TRIANGLES, lod.num_indices, model.index_type(),
+//     reinterpret_cast<const GLvoid*>(
+//         lod.first_index * wvu::IndexSize(model.index_type())));
+class MeshLodChain {
+ public:
+  MeshLodChain() : impostor_radius_(0.0f), impostor_pixel_radius_(0.0f) {}
+  ~MeshLodChain() {}
+
+  // Builds the chain. The first level holds the full-resolution indices of the
+  // model, and every other level holds reduction_ratio times the triangles of
+  // the previous one. The chain stops early when the simplification stalls.
+  // Returns false if the model is not a triangle list with CPU data.
+  // Parameters:
+  //   model  The model to simplify.
+  //   max_num_lods  The maximum number of levels, including the first one.
+  //   reduction_ratio  The ratio of triangles between consecutive levels.
+  bool Build(const Model& model,
+             const int max_num_lods,
+             const float reduction_ratio);
+
+  // Adds an impostor after the last level.
+  // Parameters:
+  //   radius  The radius of the bounding sphere of the model, in model units.
+  //   max_pixel_radius  The largest projected radius, in pixels, drawn with
+  //     the impostor, e.g., half the texels of a view of the impostor.
+  void SetImpostor(const float radius, const float max_pixel_radius) {
+    impostor_radius_ = radius;
+    impostor_pixel_radius_ = max_pixel_radius;
+  }
+
+  // Returns true if lod is the impostor, i.e., num_lods().
+  bool IsImpostor(const int lod) const {
+    return lod == num_lods();
+  }
+
+  // Returns the coarsest level whose projected error is at most
+  // max_pixel_error pixels, or num_lods() if the chain has an impostor and
+  // the bounding sphere projects to at most its pixel radius.
+  // Parameters:
+  //   distance  The distance from the camera to the model.
+  //   field_of_view  The vertical field of view, as passed to
+  //     ComputeProjectionMatrix().
+  //   viewport_height  The height of the viewport in pixels.
+  //   max_pixel_error  The maximum tolerated error in pixels.
+  int SelectLod(const float distance,
+                const float field_of_view,
+                const int viewport_height,
+                const float max_pixel_error) const;
+
+  // Returns the indices of all the levels, concatenated.
+  const std::vector<GLuint>& indices() const {
+    return indices_;
+  }
+
+  int num_lods() const {
+    return lods_.size();
+  }
+
+  const MeshLod& lod(const int i) const {
+    return lods_[i];
+  }
+
+ private:
+  std::vector<GLuint> indices_;
+  std::vector<MeshLod> lods_;
+  // The bounding radius and the largest projected radius of the impostor, or
+  // zero without impostor.
+  float impostor_radius_;
+  float impostor_pixel_radius_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESH_LOD_H_
@@ -0,0 +1,324 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mesh_normals.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "assignment.h"
+#include "job_system.h"
+#include "model.h"
+#include "vertex_format.h"
+#include "vertex_quantization.h"
+
+namespace wvu {
+namespace {
+// Triangles or vertices processed by a job.
+constexpr int kNormalGrainSize = 4096;
+
+// Rounds the size up to a multiple of 4 bytes, as the other attributes.
+GLuint AlignTo4(const GLuint size) {
+  return (size + 3) & ~3u;
+}
+
+// Returns true if the normals can be written into the attribute.
+bool IsSupportedNormalAttribute(const VertexAttribute& attribute) {
+  switch (attribute.type) {
+    case GL_FLOAT:
+      return attribute.num_components == 3;
+    case GL_HALF_FLOAT:
+      return attribute.num_components == 3 || attribute.num_components == 4;
+    case GL_INT_2_10_10_10_REV:
+      return attribute.normalized == GL_TRUE;
+    default:
+      return false;
+  }
+}
+
+// Writes a normal into the attribute of a vertex.
+void WriteNormal(const Eigen::Vector3f& normal,
+                 const VertexAttribute& attribute,
+                 GLubyte* vertex) {
+  GLubyte* destination = vertex + attribute.offset;
+  if (attribute.type == GL_FLOAT) {
+    std::memcpy(destination, normal.data(), 3 * sizeof(float));
+  } else if (attribute.type == GL_HALF_FLOAT) {
+    const GLushort halves[4] = {FloatToHalf(normal.x()),
+                                FloatToHalf(normal.y()),
+                                FloatToHalf(normal.z()), 0};
+    std::memcpy(destination, halves,
+                attribute.num_components * sizeof(GLushort));
+  } else {
+    const uint32_t packed = PackSnorm10(normal.data());
+    std::memcpy(destination, &packed, sizeof(packed));
+  }
+}
+
+// Calls function(begin, end) on ranges covering [0, num_elements), on the
+// threads of the job system if there is one.
+void ParallelFor(JobSystem* job_system,
+                 const int num_elements,
+                 const std::function<void(int, int)>& function) {
+  if (job_system == nullptr) {
+    function(0, num_elements);
+  } else {
+    job_system->ParallelFor(num_elements, kNormalGrainSize, function);
+  }
+}
+
+// Computes the normals of the triangles [begin, end), whose lengths are twice
+// their areas, and the angles of their corners if angles is not nullptr.
+void ComputeTriangleNormals(const VertexPositions& positions,
+                            const std::vector<GLuint>& indices,
+                            const int begin,
+                            const int end,
+                            Vector3fArray* triangle_normals,
+                            std::vector<float>* angles) {
+  const int size = end - begin;
+  // The edges leaving each corner of the triangles.
+  Vector3fArray edges[3];
+  for (Vector3fArray& edge : edges) edge.resize(size);
+  for (int i = 0; i < size; ++i) {
+    const GLuint* triangle = indices.data() + 3 * (begin + i);
+    for (int k = 0; k < 3; ++k) {
+      const Eigen::Vector4f edge = positions[triangle[(k + 1) % 3]] -
+          positions[triangle[k]];
+      edges[k].x[i] = edge.x();
+      edges[k].y[i] = edge.y();
+      edges[k].z[i] = edge.z();
+    }
+  }
+  // The third edge reversed, so that the cross product of the first two
+  // edges leaving the first corner is the normal.
+  Vector3fArray& second_edges = edges[2];
+  for (int i = 0; i < size; ++i) {
+    second_edges.x[i] = -second_edges.x[i];
+    second_edges.y[i] = -second_edges.y[i];
+    second_edges.z[i] = -second_edges.z[i];
+  }
+  Vector3fArray normals;
+  ComputeCrossProducts(edges[0], second_edges, &normals);
+  std::copy(normals.x.begin(), normals.x.end(),
+            triangle_normals->x.begin() + begin);
+  std::copy(normals.y.begin(), normals.y.end(),
+            triangle_normals->y.begin() + begin);
+  std::copy(normals.z.begin(), normals.z.end(),
+            triangle_normals->z.begin() + begin);
+  if (angles == nullptr) return;
+
+  // The angle of a corner is between the two edges leaving it. Those of the
+  // third corner are p0 - p2 and p1 - p2, both reversed, which does not change
+  // the angle between them.
+  Vector3fArray reversed_first_edges = edges[0];
+  for (int i = 0; i < size; ++i) {
+    reversed_first_edges.x[i] = -reversed_first_edges.x[i];
+    reversed_first_edges.y[i] = -reversed_first_edges.y[i];
+    reversed_first_edges.z[i] = -reversed_first_edges.z[i];
+  }
+  const Vector3fArray* corner_edges[3][2] = {
+    {&edges[0], &second_edges},
+    {&edges[1], &reversed_first_edges},
+    {&second_edges, &edges[1]}
+  };
+  std::vector<float> corner_angles;
+  for (int k = 0; k < 3; ++k) {
+    CalculateAnglesBetweenVectors(*corner_edges[k][0], *corner_edges[k][1],
+                                  FAST_ANGLE, &corner_angles);
+    for (int i = 0; i < size; ++i) {
+      (*angles)[3 * (begin + i) + k] = corner_angles[i];
+    }
+  }
+}
+
+}  // namespace
+
+bool ComputeVertexNormals(const NormalWeighting weighting,
+                          const NormalPrecision precision,
+                          JobSystem* job_system,
+                          Model* model,
+                          std::string* error_info_log) {
+  if (model->primitive_type() != GL_TRIANGLES) {
+    *error_info_log = "The normals are computed for triangle lists only.";
+    return false;
+  }
+  if (model->cpu_data_released()) {
+    *error_info_log = "The CPU data of the model was released.";
+    return false;
+  }
+  const VertexLayout& layout = model->vertex_layout();
+  const VertexAttribute* position = layout.FindAttribute(POSITION);
+  if (position == nullptr || position->type != GL_FLOAT ||
+      position->num_components < 3) {
+    *error_info_log = "The model does not have float positions.";
+    return false;
+  }
+  const VertexAttribute* normal = layout.FindAttribute(NORMAL);
+  if (normal != nullptr && !IsSupportedNormalAttribute(*normal)) {
+    *error_info_log = "The normal attribute of the model is not 3 floats, "
+        "3 or 4 half floats or a normalized GL_INT_2_10_10_10_REV.";
+    return false;
+  }
+  const int num_vertices = model->num_vertices();
+  const std::vector<GLuint>& indices = model->indices();
+  for (const GLuint index : indices) {
+    if (index >= static_cast<GLuint>(num_vertices)) {
+      *error_info_log = "An index of the model is out of range.";
+      return false;
+    }
+  }
+
+  // The layout with the normals. A normal attribute of the precision is
+  // appended after the other attributes if the model has none.
+  VertexLayout normal_layout = layout;
+  if (normal == nullptr) {
+    GLenum type = GL_FLOAT;
+    GLint num_components = 3;
+    GLboolean normalized = GL_FALSE;
+    if (precision == NORMAL_FLOAT16) {
+      type = GL_HALF_FLOAT;
+    } else if (precision == NORMAL_SNORM10) {
+      type = GL_INT_2_10_10_10_REV;
+      num_components = 4;
+      normalized = GL_TRUE;
+    }
+    const GLuint offset = AlignTo4(layout.stride());
+    normal_layout = VertexLayout(
+        offset + AlignTo4(VertexAttributeSize(type, num_components)));
+    for (int i = 0; i < layout.num_attributes(); ++i) {
+      const VertexAttribute& attribute = layout.attribute(i);
+      normal_layout.AddAttribute(attribute.semantic, attribute.num_components,
+                                 attribute.type, attribute.normalized,
+                                 attribute.offset);
+    }
+    if (!normal_layout.AddAttribute(NORMAL, num_components, type, normalized,
+                                    offset)) {
+      *error_info_log = "The layout of the model has no room for normals.";
+      return false;
+    }
+  }
+  const VertexAttribute& normal_attribute =
+      *normal_layout.FindAttribute(NORMAL);
+
+  // The normals and the corner angles of the triangles.
+  VertexPositions positions;
+  model->GetVertexPositions(&positions);
+  const int num_triangles = indices.size() / 3;
+  Vector3fArray triangle_normals;
+  triangle_normals.resize(num_triangles);
+  std::vector<float> angles;
+  if (weighting == ANGLE_WEIGHTED_NORMALS) {
+    angles.resize(3 * num_triangles);
+    ParallelFor(job_system, num_triangles, [&](const int begin, const int end) {
+      ComputeTriangleNormals(positions, indices, begin, end,
+                             &triangle_normals, &angles);
+      // The angles weight the unit normals.
+      for (int t = begin; t < end; ++t) {
+        const float length = Eigen::Vector3f(
+            triangle_normals.x[t], triangle_normals.y[t],
+            triangle_normals.z[t]).norm();
+        const float inverse_length = length > 0.0f ? 1.0f / length : 0.0f;
+        triangle_normals.x[t] *= inverse_length;
+        triangle_normals.y[t] *= inverse_length;
+        triangle_normals.z[t] *= inverse_length;
+      }
+    });
+  } else {
+    ParallelFor(job_system, num_triangles, [&](const int begin, const int end) {
+      ComputeTriangleNormals(positions, indices, begin, end,
+                             &triangle_normals, nullptr);
+    });
+  }
+
+  // The corners of every vertex, sorted by vertex with a counting sort, so
+  // that every vertex gathers the normals of its triangles.
+  const int num_corners = 3 * num_triangles;
+  std::vector<int> first_corners(num_vertices + 1, 0);
+  for (int c = 0; c < num_corners; ++c) ++first_corners[indices[c] + 1];
+  for (int v = 0; v < num_vertices; ++v) {
+    first_corners[v + 1] += first_corners[v];
+  }
+  std::vector<int> vertex_corners(num_corners);
+  {
+    std::vector<int> next_corners(first_corners.begin(),
+                                  first_corners.end() - 1);
+    for (int c = 0; c < num_corners; ++c) {
+      vertex_corners[next_corners[indices[c]]++] = c;
+    }
+  }
+
+  // Sum, normalize and write the normals of the vertices, copying the other
+  // attributes if the layout changes.
+  const bool relayout = normal == nullptr;
+  std::vector<GLubyte> vertex_data;
+  if (relayout) vertex_data.resize(num_vertices * normal_layout.stride(), 0);
+  const GLubyte* source = model->vertex_data().data();
+  GLubyte* destination =
+      relayout ? vertex_data.data() : model->mutable_vertex_data();
+  ParallelFor(job_system, num_vertices, [&](const int begin, const int end) {
+    for (int v = begin; v < end; ++v) {
+      Eigen::Vector3f vertex_normal = Eigen::Vector3f::Zero();
+      for (int i = first_corners[v]; i < first_corners[v + 1]; ++i) {
+        const int corner = vertex_corners[i];
+        const int t = corner / 3;
+        const float weight = angles.empty() ? 1.0f : angles[corner];
+        vertex_normal += weight * Eigen::Vector3f(triangle_normals.x[t],
+                                                  triangle_normals.y[t],
+                                                  triangle_normals.z[t]);
+      }
+      const float length = vertex_normal.norm();
+      if (length > 0.0f) vertex_normal /= length;
+      GLubyte* vertex = destination + v * normal_layout.stride();
+      if (relayout) {
+        std::memcpy(vertex, source + v * layout.stride(), layout.stride());
+      }
+      WriteNormal(vertex_normal, normal_attribute, vertex);
+    }
+  });
+  if (relayout) {
+    model->SetVertexData(normal_layout, std::move(vertex_data));
+  } else {
+    model->MarkVerticesDirty(0, num_vertices);
+  }
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,87 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESH_NORMALS_H_
+#define GLUTILS_MESH_NORMALS_H_
+
+#include <string>
+
+#include "job_system.h"
+#include "model.h"
+#include "vertex_quantization.h"
+
+namespace wvu {
+// Weights of the normals of the triangles around a vertex.
+enum NormalWeighting {
+  // By the area of the triangles, which favors the large triangles.
+  AREA_WEIGHTED_NORMALS = 0,
+  // By the angle of the triangles at the vertex, which does not depend on how
+  // the surface around the vertex is triangulated.
+  ANGLE_WEIGHTED_NORMALS
+};
+
+// Computes smooth vertex normals for the triangles of the model, and writes
+// them into the normal attribute of its vertices. The model gets a normal
+// attribute of the given precision, appended to its vertices, if it has none;
+// otherwise the normals are written in the precision of its attribute, which
+// must be 3 floats, 3 or 4 half floats or a normalized GL_INT_2_10_10_10_REV,
+// and the vertices are marked dirty.
+//
+// The normals of the triangles are computed in parallel with
+// ComputeCrossProducts() (and their angles with
+// CalculateAnglesBetweenVectors()). Then every vertex sums the normals of its
+// triangles, found through the corners sorted by vertex, so that the vertices
+// are also processed in parallel without atomics, and the sums do not depend
+// on the number of threads. Vertices split at seams, e.g., of the texture
+// coordinates, only get the normals of their own triangles, and the vertices
+// of no triangle or of degenerate triangles only get a zero normal. The model
+// must be a triangle list with float positions whose CPU data was not
+// released. Returns false otherwise, in which case the error is copied into
+// error_info_log.
+// Parameters:
+//   weighting  The weights of the normals of the triangles.
+//   precision  The precision of the normal attribute added to the model.
+//   job_system  The threads computing the normals. Can be nullptr, in which
+//     case they are computed on the calling thread.
+//   model  The model whose normals are computed.
+//   error_info_log  A pointer to a string that holds the error log.
+bool ComputeVertexNormals(const NormalWeighting weighting,
+                          const NormalPrecision precision,
+                          JobSystem* job_system,
+                          Model* model,
+                          std::string* error_info_log);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESH_NORMALS_H_
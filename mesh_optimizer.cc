@@ -0,0 +1,330 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "model.h"
+
+namespace wvu {
+namespace {
+
+// Parameters of Forsyth's scoring function. See
+// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html.
+constexpr int kScoringCacheSize = 32;
+constexpr float kCacheDecayPower = 1.5f;
+constexpr float kLastTriangleScore = 0.75f;
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+// Score of a vertex given its position in the simulated LRU cache (-1 if not
+// in the cache) and its number of triangles not yet emitted.
+float VertexScore(const int cache_position, const int num_remaining) {
+  if (num_remaining == 0) {
+    // No triangle needs the vertex anymore.
+    return -1.0f;
+  }
+  float score = 0.0f;
+  if (cache_position >= 0) {
+    if (cache_position < 3) {
+      // The vertex was used by the last triangle. Using it again right away
+      // does not help as much, so that strips do not dominate.
+      score = kLastTriangleScore;
+    } else {
+      const float scaler = 1.0f / (kScoringCacheSize - 3);
+      score = std::pow(1.0f - (cache_position - 3) * scaler, kCacheDecayPower);
+    }
+  }
+  // Boost the vertices with few remaining triangles, so that they are
+  // finished before they leave the cache.
+  score += kValenceBoostScale *
+      std::pow(static_cast<float>(num_remaining), -kValenceBoostPower);
+  return score;
+}
+
+}  // namespace
+
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<GLuint>& indices,
+                                         const int num_vertices,
+                                         const int cache_size) {
+  VertexCacheStatistics statistics;
+  // Each vertex remembers the time it entered the cache. A vertex is in the
+  // FIFO cache if fewer than cache_size vertices entered after it.
+  std::vector<int> insertion_time(num_vertices, -cache_size - 1);
+  int time = 0;
+  for (const GLuint index : indices) {
+    if (time - insertion_time[index] > cache_size) {
+      insertion_time[index] = time++;
+    }
+  }
+  statistics.num_transformed_vertices = time;
+  const int num_triangles = indices.size() / 3;
+  if (num_triangles > 0) {
+    statistics.acmr = static_cast<float>(time) / num_triangles;
+  }
+  if (num_vertices > 0) {
+    statistics.atvr = static_cast<float>(time) / num_vertices;
+  }
+  return statistics;
+}
+
+void OptimizeVertexCache(const std::vector<GLuint>& indices,
+                         const int num_vertices,
+                         std::vector<GLuint>* optimized_indices) {
+  const int num_triangles = indices.size() / 3;
+  // Build the vertex-triangle adjacency in compressed form.
+  std::vector<int> num_remaining(num_vertices, 0);
+  for (const GLuint index : indices) {
+    ++num_remaining[index];
+  }
+  std::vector<int> adjacency_offsets(num_vertices + 1, 0);
+  for (int v = 0; v < num_vertices; ++v) {
+    adjacency_offsets[v + 1] = adjacency_offsets[v] + num_remaining[v];
+  }
+  std::vector<int> adjacency(indices.size());
+  {
+    std::vector<int> cursor(adjacency_offsets.begin(),
+                            adjacency_offsets.end() - 1);
+    for (int t = 0; t < num_triangles; ++t) {
+      for (int k = 0; k < 3; ++k) {
+        adjacency[cursor[indices[3 * t + k]]++] = t;
+      }
+    }
+  }
+
+  std::vector<int> cache_position(num_vertices, -1);
+  std::vector<float> vertex_score(num_vertices);
+  for (int v = 0; v < num_vertices; ++v) {
+    vertex_score[v] = VertexScore(-1, num_remaining[v]);
+  }
+  std::vector<float> triangle_score(num_triangles);
+  std::vector<bool> emitted(num_triangles, false);
+  for (int t = 0; t < num_triangles; ++t) {
+    triangle_score[t] = vertex_score[indices[3 * t]] +
+        vertex_score[indices[3 * t + 1]] + vertex_score[indices[3 * t + 2]];
+  }
+
+  std::vector<GLuint> output;
+  output.reserve(num_triangles * 3);
+  // The simulated LRU cache holds kScoringCacheSize entries, plus room for the
+  // three vertices being inserted.
+  std::vector<int> cache;
+  cache.reserve(kScoringCacheSize + 3);
+  std::vector<int> new_cache;
+  new_cache.reserve(kScoringCacheSize + 3);
+  int best_triangle = -1;
+  // Cursor for the linear scan used when the cache holds no candidate.
+  int scan_cursor = 0;
+  for (int num_emitted = 0; num_emitted < num_triangles; ++num_emitted) {
+    if (best_triangle < 0) {
+      float best_score = -1.0f;
+      for (; scan_cursor < num_triangles; ++scan_cursor) {
+        if (!emitted[scan_cursor]) break;
+      }
+      for (int t = scan_cursor; t < num_triangles; ++t) {
+        if (!emitted[t] && triangle_score[t] > best_score) {
+          best_score = triangle_score[t];
+          best_triangle = t;
+        }
+      }
+    }
+    // Emit the triangle.
+    emitted[best_triangle] = true;
+    new_cache.clear();
+    for (int k = 0; k < 3; ++k) {
+      const int v = indices[3 * best_triangle + k];
+      output.push_back(v);
+      --num_remaining[v];
+      new_cache.push_back(v);
+    }
+    for (const int v : cache) {
+      if (v != static_cast<int>(indices[3 * best_triangle]) &&
+          v != static_cast<int>(indices[3 * best_triangle + 1]) &&
+          v != static_cast<int>(indices[3 * best_triangle + 2])) {
+        new_cache.push_back(v);
+      }
+    }
+    // Update the scores of the vertices in the cache, including the ones
+    // leaving it, and of their triangles.
+    for (size_t i = 0; i < new_cache.size(); ++i) {
+      const int v = new_cache[i];
+      cache_position[v] =
+          i < static_cast<size_t>(kScoringCacheSize) ? static_cast<int>(i) : -1;
+      vertex_score[v] = VertexScore(cache_position[v], num_remaining[v]);
+    }
+    best_triangle = -1;
+    float best_score = -1.0f;
+    for (const int v : new_cache) {
+      for (int a = adjacency_offsets[v]; a < adjacency_offsets[v + 1]; ++a) {
+        const int t = adjacency[a];
+        if (emitted[t]) continue;
+        triangle_score[t] = vertex_score[indices[3 * t]] +
+            vertex_score[indices[3 * t + 1]] +
+            vertex_score[indices[3 * t + 2]];
+        if (triangle_score[t] > best_score) {
+          best_score = triangle_score[t];
+          best_triangle = t;
+        }
+      }
+    }
+    if (new_cache.size() > static_cast<size_t>(kScoringCacheSize)) {
+      new_cache.resize(kScoringCacheSize);
+    }
+    cache.swap(new_cache);
+  }
+  *optimized_indices = std::move(output);
+}
+
+void OptimizeOverdraw(const Model& model,
+                      const std::vector<GLuint>& indices,
+                      const int cluster_size,
+                      std::vector<GLuint>* optimized_indices) {
+  const int num_triangles = indices.size() / 3;
+  if (num_triangles == 0 || cluster_size <= 0) {
+    *optimized_indices = indices;
+    return;
+  }
+  // Compute the center of the mesh.
+  Eigen::Vector3f mesh_center = Eigen::Vector3f::Zero();
+  for (const GLuint index : indices) {
+    mesh_center += model.VertexPosition(index);
+  }
+  mesh_center /= indices.size();
+  // Sort the clusters by how much they face away from the mesh center.
+  struct Cluster {
+    int first_triangle;
+    int num_triangles;
+    float sort_key;
+  };
+  std::vector<Cluster> clusters;
+  for (int first = 0; first < num_triangles; first += cluster_size) {
+    Cluster cluster;
+    cluster.first_triangle = first;
+    cluster.num_triangles = std::min(cluster_size, num_triangles - first);
+    Eigen::Vector3f center = Eigen::Vector3f::Zero();
+    Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+    for (int t = first; t < first + cluster.num_triangles; ++t) {
+      const Eigen::Vector3f a = model.VertexPosition(indices[3 * t]);
+      const Eigen::Vector3f b = model.VertexPosition(indices[3 * t + 1]);
+      const Eigen::Vector3f c = model.VertexPosition(indices[3 * t + 2]);
+      // The cross product is weighted by the area of the triangle.
+      normal += (b - a).cross(c - a);
+      center += a + b + c;
+    }
+    center /= 3.0f * cluster.num_triangles;
+    const float normal_length = normal.norm();
+    cluster.sort_key = normal_length > 0.0f ?
+        (center - mesh_center).dot(normal / normal_length) : 0.0f;
+    clusters.push_back(cluster);
+  }
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const Cluster& a, const Cluster& b) {
+                     return a.sort_key > b.sort_key;
+                   });
+  std::vector<GLuint> output;
+  output.reserve(indices.size());
+  for (const Cluster& cluster : clusters) {
+    output.insert(output.end(), indices.begin() + 3 * cluster.first_triangle,
+                  indices.begin() + 3 * (cluster.first_triangle +
+                                         cluster.num_triangles));
+  }
+  *optimized_indices = std::move(output);
+}
+
+void OptimizeVertexFetch(Model* model) {
+  const int num_vertices = model->num_vertices();
+  const GLsizei stride = model->vertex_layout().stride();
+  std::vector<GLuint> indices = model->indices();
+  std::vector<GLuint> remap(num_vertices, static_cast<GLuint>(-1));
+  std::vector<GLubyte> vertex_data;
+  vertex_data.reserve(model->vertex_data().size());
+  GLuint next_vertex = 0;
+  for (GLuint& index : indices) {
+    if (remap[index] == static_cast<GLuint>(-1)) {
+      remap[index] = next_vertex++;
+      const GLubyte* vertex = model->vertex_data().data() + index * stride;
+      vertex_data.insert(vertex_data.end(), vertex, vertex + stride);
+    }
+    index = remap[index];
+  }
+  model->SetVertexData(model->vertex_layout(), std::move(vertex_data));
+  model->SetIndices(std::move(indices));
+}
+
+bool OptimizeModel(Model* model,
+                   MeshOptimizationReport* report,
+                   std::string* error_info_log) {
+  if (model->cpu_data_released()) {
+    *error_info_log = "The vertices of the model were released.";
+    return false;
+  }
+  if (model->primitive_type() != GL_TRIANGLES ||
+      model->indices().size() % 3 != 0) {
+    *error_info_log = "The indices of the model are not a triangle list.";
+    return false;
+  }
+  for (const GLuint index : model->indices()) {
+    if (index >= static_cast<GLuint>(model->num_vertices())) {
+      *error_info_log = "The indices of the model are out of range.";
+      return false;
+    }
+  }
+  MeshOptimizationReport optimization_report;
+  optimization_report.before =
+      AnalyzeVertexCache(model->indices(), model->num_vertices());
+  // Overdraw clusters are small enough to keep most of the cache reuse.
+  constexpr int kOverdrawClusterSize = 64;
+  std::vector<GLuint> indices;
+  OptimizeVertexCache(model->indices(), model->num_vertices(), &indices);
+  OptimizeOverdraw(*model, indices, kOverdrawClusterSize, &indices);
+  model->SetIndices(std::move(indices));
+  OptimizeVertexFetch(model);
+  optimization_report.after =
+      AnalyzeVertexCache(model->indices(), model->num_vertices());
+  if (report != nullptr) {
+    *report = optimization_report;
+  }
+  return true;
+}
+
+}  // namespace wvu
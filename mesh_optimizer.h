@@ -0,0 +1,118 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESH_OPTIMIZER_H_
+#define GLUTILS_MESH_OPTIMIZER_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "model.h"
+
+namespace wvu {
+// Statistics of the post-transform vertex cache for a triangle list, simulated
+// with a FIFO cache.
+struct VertexCacheStatistics {
+  // Average cache miss ratio: transformed vertices per triangle. It ranges
+  // from 0.5 (ideal for large regular meshes) to 3 (no reuse).
+  float acmr = 0.0f;
+  // Average transform to vertex ratio: transformed vertices per vertex. The
+  // ideal value is 1.
+  float atvr = 0.0f;
+  // Number of vertex shader invocations.
+  int num_transformed_vertices = 0;
+};
+
+// Reports the effect of OptimizeModel().
+struct MeshOptimizationReport {
+  VertexCacheStatistics before;
+  VertexCacheStatistics after;
+};
+
+// Default size of the simulated FIFO cache. It matches the reuse window of
+// most GPUs.
+constexpr int kDefaultVertexCacheSize = 16;
+
+// Simulates a FIFO post-transform cache of cache_size entries for the triangle
+// list.
+VertexCacheStatistics AnalyzeVertexCache(
+    const std::vector<GLuint>& indices,
+    const int num_vertices,
+    const int cache_size = kDefaultVertexCacheSize);
+
+// Reorders the triangles of the list to maximize the reuse of the
+// post-transform vertex cache, using Tom Forsyth's linear-speed algorithm.
+// The algorithm does not depend on the exact cache size of the GPU.
+// Parameters:
+//   indices  The triangle list.
+//   num_vertices  The number of vertices referenced by the indices.
+//   optimized_indices  The reordered triangle list. Can alias indices.
+void OptimizeVertexCache(const std::vector<GLuint>& indices,
+                         const int num_vertices,
+                         std::vector<GLuint>* optimized_indices);
+
+// Reorders the triangles of a cache-optimized list to reduce overdraw. The list
+// is split into clusters of cluster_size consecutive triangles, which keeps
+// most of the cache reuse, and the clusters facing away from the center of the
+// mesh are drawn first, since they are likely to occlude the inner ones.
+// Parameters:
+//   model  The model providing the positions of the vertices.
+//   indices  The triangle list, ideally the output of OptimizeVertexCache().
+//   cluster_size  The number of triangles per cluster.
+//   optimized_indices  The reordered triangle list. Can alias indices.
+void OptimizeOverdraw(const Model& model,
+                      const std::vector<GLuint>& indices,
+                      const int cluster_size,
+                      std::vector<GLuint>* optimized_indices);
+
+// Reorders the vertices of the model in the order the indices first reference
+// them, so that the vertex fetches walk the vertex buffer linearly, and remaps
+// the indices. Vertices not referenced by any triangle are removed.
+void OptimizeVertexFetch(Model* model);
+
+// Runs the vertex cache, overdraw and vertex fetch optimizations on the model.
+// The model must be a triangle list whose CPU data was not released. Returns
+// false otherwise, in which case the error is copied into error_info_log.
+// Parameters:
+//   model  The model to optimize.
+//   report  The cache statistics before and after. Can be nullptr.
+//   error_info_log  A pointer to a string that holds the error log.
+bool OptimizeModel(Model* model,
+                   MeshOptimizationReport* report,
+                   std::string* error_info_log);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESH_OPTIMIZER_H_
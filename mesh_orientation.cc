@@ -0,0 +1,222 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mesh_orientation.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "model.h"
+
+namespace wvu {
+namespace {
+
+// An edge of a triangle, from its vertex a to its vertex b, keyed by its
+// welded vertices regardless of the direction.
+struct TriangleEdge {
+  uint64_t key;
+  int triangle;
+  // True if the triangle runs the edge from the smaller to the larger vertex.
+  bool forward;
+};
+
+// A triangle sharing an edge with another, and whether the two must have
+// opposite windings to be consistent.
+struct Neighbor {
+  int triangle;
+  bool flip;
+};
+
+// Returns the id of the first vertex at the same position of every vertex.
+std::vector<GLuint> WeldVertices(const Model& model) {
+  const int num_vertices = model.num_vertices();
+  std::vector<std::pair<Eigen::Vector3f, int> > positions(num_vertices);
+  for (int i = 0; i < num_vertices; ++i) {
+    positions[i] = std::make_pair(model.VertexPosition(i), i);
+  }
+  std::sort(positions.begin(), positions.end(),
+            [](const std::pair<Eigen::Vector3f, int>& lhs,
+               const std::pair<Eigen::Vector3f, int>& rhs) {
+    return std::lexicographical_compare(
+        lhs.first.data(), lhs.first.data() + 3,
+        rhs.first.data(), rhs.first.data() + 3) ||
+        (lhs.first == rhs.first && lhs.second < rhs.second);
+  });
+  std::vector<GLuint> welded(num_vertices);
+  for (int i = 0; i < num_vertices; ++i) {
+    const bool same = i > 0 && positions[i].first == positions[i - 1].first;
+    welded[positions[i].second] =
+        same ? welded[positions[i - 1].second] : positions[i].second;
+  }
+  return welded;
+}
+
+}  // namespace
+
+bool OrientTriangles(Model* model,
+                     MeshOrientationReport* report,
+                     std::string* error_info_log) {
+  if (model->cpu_data_released()) {
+    *error_info_log = "The vertices of the model were released.";
+    return false;
+  }
+  if (model->primitive_type() != GL_TRIANGLES ||
+      model->indices().size() % 3 != 0) {
+    *error_info_log = "The indices of the model are not a triangle list.";
+    return false;
+  }
+  for (const GLuint index : model->indices()) {
+    if (index >= static_cast<GLuint>(model->num_vertices())) {
+      *error_info_log = "The indices of the model are out of range.";
+      return false;
+    }
+  }
+  std::vector<GLuint> indices = model->indices();
+  const int num_triangles = indices.size() / 3;
+  const std::vector<GLuint> welded = WeldVertices(*model);
+
+  // Sort the edges of the triangles, so that the triangles sharing an edge are
+  // consecutive.
+  std::vector<TriangleEdge> edges;
+  edges.reserve(indices.size());
+  for (int t = 0; t < num_triangles; ++t) {
+    const GLuint v[3] = {welded[indices[3 * t]], welded[indices[3 * t + 1]],
+                         welded[indices[3 * t + 2]]};
+    if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0]) continue;
+    for (int i = 0; i < 3; ++i) {
+      const GLuint a = v[i];
+      const GLuint b = v[(i + 1) % 3];
+      TriangleEdge edge;
+      edge.key = (static_cast<uint64_t>(std::min(a, b)) << 32) |
+          std::max(a, b);
+      edge.triangle = t;
+      edge.forward = a < b;
+      edges.push_back(edge);
+    }
+  }
+  std::sort(edges.begin(), edges.end(),
+            [](const TriangleEdge& lhs, const TriangleEdge& rhs) {
+    return lhs.key < rhs.key;
+  });
+
+  // Link the triangles through their manifold edges. Two triangles wound
+  // consistently run their shared edge in opposite directions.
+  MeshOrientationReport orientation_report;
+  std::vector<std::vector<Neighbor> > neighbors(num_triangles);
+  for (size_t begin = 0, end = 0; begin < edges.size(); begin = end) {
+    end = begin + 1;
+    while (end < edges.size() && edges[end].key == edges[begin].key) ++end;
+    if (end - begin == 1) {
+      ++orientation_report.num_boundary_edges;
+    } else if (end - begin > 2) {
+      ++orientation_report.num_non_manifold_edges;
+    } else {
+      const TriangleEdge& first = edges[begin];
+      const TriangleEdge& second = edges[begin + 1];
+      const bool flip = first.forward == second.forward;
+      neighbors[first.triangle].push_back({second.triangle, flip});
+      neighbors[second.triangle].push_back({first.triangle, flip});
+    }
+  }
+
+  // Propagate the winding of the first triangle of each component to the
+  // others, and flip the component if its signed volume is negative.
+  std::vector<int> flips(num_triangles, -1);
+  std::vector<int> component;
+  for (int seed = 0; seed < num_triangles; ++seed) {
+    if (flips[seed] != -1 || neighbors[seed].empty()) continue;
+    ++orientation_report.num_components;
+    component.clear();
+    component.push_back(seed);
+    flips[seed] = 0;
+    for (size_t i = 0; i < component.size(); ++i) {
+      const int triangle = component[i];
+      for (const Neighbor& neighbor : neighbors[triangle]) {
+        const int flip = flips[triangle] ^ static_cast<int>(neighbor.flip);
+        if (flips[neighbor.triangle] == -1) {
+          flips[neighbor.triangle] = flip;
+          component.push_back(neighbor.triangle);
+        } else if (flips[neighbor.triangle] != flip &&
+                   triangle < neighbor.triangle) {
+          ++orientation_report.num_inconsistent_edges;
+        }
+      }
+    }
+    // The signed volume is measured from the centroid of the component, which
+    // keeps the sum accurate for meshes far from the origin.
+    Eigen::Vector3f centroid = Eigen::Vector3f::Zero();
+    for (const int triangle : component) {
+      centroid += model->VertexPosition(indices[3 * triangle]);
+    }
+    centroid /= component.size();
+    float volume = 0.0f;
+    for (const int triangle : component) {
+      const Eigen::Vector3f p0 =
+          model->VertexPosition(indices[3 * triangle]) - centroid;
+      const Eigen::Vector3f p1 =
+          model->VertexPosition(indices[3 * triangle + 1]) - centroid;
+      const Eigen::Vector3f p2 =
+          model->VertexPosition(indices[3 * triangle + 2]) - centroid;
+      const float triangle_volume = p0.dot(p1.cross(p2));
+      volume += flips[triangle] ? -triangle_volume : triangle_volume;
+    }
+    if (volume < 0.0f) {
+      for (const int triangle : component) flips[triangle] ^= 1;
+    }
+  }
+
+  for (int t = 0; t < num_triangles; ++t) {
+    if (flips[t] != 1) continue;
+    std::swap(indices[3 * t + 1], indices[3 * t + 2]);
+    ++orientation_report.num_flipped_triangles;
+  }
+  orientation_report.closed = !edges.empty() &&
+      orientation_report.num_boundary_edges == 0 &&
+      orientation_report.num_non_manifold_edges == 0 &&
+      orientation_report.num_inconsistent_edges == 0;
+  model->SetIndices(std::move(indices));
+  model->set_closed(orientation_report.closed);
+  if (report != nullptr) {
+    *report = orientation_report;
+  }
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,84 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESH_ORIENTATION_H_
+#define GLUTILS_MESH_ORIENTATION_H_
+
+#include <string>
+
+#include "model.h"
+
+namespace wvu {
+// Reports what OrientTriangles() found and changed.
+struct MeshOrientationReport {
+  // Triangles whose winding was reversed.
+  int num_flipped_triangles = 0;
+  // Connected pieces of the surface, through the edges shared by exactly two
+  // triangles.
+  int num_components = 0;
+  // Edges of a single triangle, i.e., the holes and the outlines of open
+  // surfaces.
+  int num_boundary_edges = 0;
+  // Edges shared by more than two triangles.
+  int num_non_manifold_edges = 0;
+  // Edges whose two triangles could not be given opposite directions along
+  // them, as on a Moebius strip.
+  int num_inconsistent_edges = 0;
+  // True if the surface encloses a volume: every edge is shared by two
+  // consistently wound triangles.
+  bool closed = false;
+};
+
+// Orients the triangles of the model consistently, so that the front faces
+// (counter-clockwise, the OpenGL default) of each connected piece face
+// outwards, and flags the model as closed if its back faces can never be seen
+// from outside (see Model::closed()). The winding of each piece is propagated
+// from one of its triangles through the edges it shares with its neighbors;
+// the orientation of the piece is then chosen so that its signed volume is
+// positive. Vertices at the same position are welded for the adjacency, so
+// meshes with split normals or texture seams are still connected. Degenerate
+// triangles are kept, but not used for the adjacency. The model must be a
+// triangle list whose CPU data was not released. Returns false otherwise, in
+// which case the error is copied into error_info_log.
+// Parameters:
+//   model  The model to orient.
+//   report  What was found and changed. Can be nullptr.
+//   error_info_log  A pointer to a string that holds the error log.
+bool OrientTriangles(Model* model,
+                     MeshOrientationReport* report,
+                     std::string* error_info_log);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESH_ORIENTATION_H_
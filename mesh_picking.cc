@@ -0,0 +1,143 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mesh_picking.h"
+
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/LU>
+
+#include "assignment.h"
+#include "bounding_volume_hierarchy.h"
+#include "model.h"
+
+namespace wvu {
+
+void ComputeViewportRay(const Eigen::Matrix4f& clip_matrix,
+                        const Eigen::Vector2f& point,
+                        Eigen::Vector3f* origin,
+                        Eigen::Vector3f* direction) {
+  const Eigen::Matrix4f inverse_clip_matrix = clip_matrix.inverse();
+  const Eigen::Vector4f near_point =
+      inverse_clip_matrix * Eigen::Vector4f(point.x(), point.y(), -1.0f, 1.0f);
+  const Eigen::Vector4f far_point =
+      inverse_clip_matrix * Eigen::Vector4f(point.x(), point.y(), 1.0f, 1.0f);
+  *origin = near_point.hnormalized();
+  *direction = far_point.hnormalized() - *origin;
+}
+
+bool MeshPicker::Build(const Model& model) {
+  if (model.primitive_type() != GL_TRIANGLES || model.cpu_data_released()) {
+    return false;
+  }
+  VertexPositions positions;
+  model.GetVertexPositions(&positions);
+  const std::vector<GLuint>& indices = model.indices();
+  const int num_triangles = indices.size() / 3;
+  std::vector<Eigen::AlignedBox3f> triangle_bounds(num_triangles);
+  bounds_.setEmpty();
+  for (int t = 0; t < num_triangles; ++t) {
+    Eigen::AlignedBox3f& bounds = triangle_bounds[t];
+    for (int k = 0; k < 3; ++k) {
+      bounds.extend(positions[indices[3 * t + k]].head<3>());
+    }
+    bounds_.extend(bounds);
+  }
+  hierarchy_.Build(triangle_bounds);
+  // The vertex and the edges of the triangles, in the order of the leaves.
+  const std::vector<int>& ordered_triangles = hierarchy_.ordered_objects();
+  triangles_.resize(num_triangles);
+  for (int i = 0; i < num_triangles; ++i) {
+    const GLuint* triangle = indices.data() + 3 * ordered_triangles[i];
+    const Eigen::Vector3f vertex = positions[triangle[0]].head<3>();
+    const Eigen::Vector3f first_edge =
+        positions[triangle[1]].head<3>() - vertex;
+    const Eigen::Vector3f second_edge =
+        positions[triangle[2]].head<3>() - vertex;
+    triangles_.vertices.x[i] = vertex.x();
+    triangles_.vertices.y[i] = vertex.y();
+    triangles_.vertices.z[i] = vertex.z();
+    triangles_.first_edges.x[i] = first_edge.x();
+    triangles_.first_edges.y[i] = first_edge.y();
+    triangles_.first_edges.z[i] = first_edge.z();
+    triangles_.second_edges.x[i] = second_edge.x();
+    triangles_.second_edges.y[i] = second_edge.y();
+    triangles_.second_edges.z[i] = second_edge.z();
+  }
+  return true;
+}
+
+bool MeshPicker::Raycast(const Eigen::Vector3f& origin,
+                         const Eigen::Vector3f& direction,
+                         const float max_distance,
+                         MeshHit* hit) const {
+  int nearest_triangle = -1;
+  float distance;
+  const bool found = hierarchy_.RaycastLeaves(
+      origin, direction, max_distance,
+      [&](const int first, const int end, float* leaf_distance) {
+    const int triangle = IntersectRayWithTriangles(
+        origin, direction, triangles_, first, end, leaf_distance);
+    if (triangle < 0) return false;
+    nearest_triangle = triangle;
+    return true;
+  }, &distance);
+  if (!found) return false;
+  hit->triangle = hierarchy_.ordered_objects()[nearest_triangle];
+  hit->distance = distance;
+  // The barycentric coordinates solve
+  // origin + distance * direction = vertex + u first_edge + v second_edge.
+  const int i = nearest_triangle;
+  const Eigen::Vector3f vertex(triangles_.vertices.x[i],
+                               triangles_.vertices.y[i],
+                               triangles_.vertices.z[i]);
+  const Eigen::Vector3f first_edge(triangles_.first_edges.x[i],
+                                   triangles_.first_edges.y[i],
+                                   triangles_.first_edges.z[i]);
+  const Eigen::Vector3f second_edge(triangles_.second_edges.x[i],
+                                    triangles_.second_edges.y[i],
+                                    triangles_.second_edges.z[i]);
+  const Eigen::Vector3f p = ComputeCrossProduct(direction, second_edge);
+  const float inverse_determinant = 1.0f / ComputeDotProduct(first_edge, p);
+  const Eigen::Vector3f s = origin - vertex;
+  const Eigen::Vector3f q = ComputeCrossProduct(s, first_edge);
+  hit->barycentric =
+      Eigen::Vector2f(ComputeDotProduct(s, p), ComputeDotProduct(direction, q))
+      * inverse_determinant;
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,139 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESH_PICKING_H_
+#define GLUTILS_MESH_PICKING_H_
+
+#include <vector>
+#include <Eigen/Core>
+
+#include "assignment.h"
+#include "bounding_volume_hierarchy.h"
+#include "model.h"
+
+namespace wvu {
+// The triangle of a mesh hit by a ray.
+struct MeshHit {
+  // The index of the triangle, whose vertices are the indices
+  // 3 * triangle to 3 * triangle + 2 of the model.
+  int triangle = -1;
+  // The distance along the ray, in units of its direction.
+  float distance = 0.0f;
+  // The barycentric coordinates of the point hit: the weights of the second
+  // and the third vertex of the triangle.
+  Eigen::Vector2f barycentric = Eigen::Vector2f::Zero();
+};
+
+// Computes the ray through a point of a viewport, from the near plane to the
+// far plane, in the space that a matrix maps to clip space. The ray reaches
+// the far plane at distance 1.
+// Parameters:
+//   clip_matrix  Maps the space of the ray to clip space, e.g., the
+//     projection * view * model matrix of a model to pick it in model space.
+//   point  The point in normalized device coordinates, e.g.,
+//     (2 x / width - 1, 1 - 2 y / height) for the cursor position (x, y) of a
+//     window of width x height.
+//   origin  The point of the near plane.
+//   direction  From the point of the near plane to the one of the far plane.
+void ComputeViewportRay(const Eigen::Matrix4f& clip_matrix,
+                        const Eigen::Vector2f& point,
+                        Eigen::Vector3f* origin,
+                        Eigen::Vector3f* direction);
+
+// This class finds the triangle of a mesh under the cursor. It indexes the
+// triangles of a model in a BoundingVolumeHierarchy in model space, and
+// stores them in the order of its leaves as a TriangleArray, so that a ray
+// query visits a few leaves and intersects the triangles of each with
+// IntersectRayWithTriangles() at once. The picker keeps its own copy of the
+// triangles, so it is built at load, before Model::ReleaseCpuData(), and
+// picks a model of a million triangles in microseconds.
+//
+// Example:
+//
+// wvu::MeshPicker picker;
+// picker.Build(model);
+// model.ReleaseCpuData();
+// ...
+// Eigen::Vector3f origin, direction;
+// wvu::ComputeViewportRay(projection * view * model.model_matrix(),
+//                         cursor_point, &origin, &direction);
+// wvu::MeshHit hit;
+// if (picker.Raycast(origin, direction, 1.0f, &hit)) {
+//   LOG(INFO) << "Picked the triangle " << hit.triangle;
+// }
+class MeshPicker {
+ public:
+  MeshPicker() {}
+  ~MeshPicker() {}
+
+  // Builds the hierarchy of the triangles of the model, replacing the
+  // previous one. Returns false if the model is not a triangle list with CPU
+  // data.
+  bool Build(const Model& model);
+
+  // Finds the nearest triangle hit by a ray in model space. Both faces of the
+  // triangles are hit. Returns true if a triangle is hit within max_distance.
+  // Parameters:
+  //   origin  The origin of the ray in model space.
+  //   direction  The direction of the ray. The distances are in units of its
+  //     length.
+  //   max_distance  The maximum distance of a hit.
+  //   hit  The triangle hit.
+  bool Raycast(const Eigen::Vector3f& origin,
+               const Eigen::Vector3f& direction,
+               const float max_distance,
+               MeshHit* hit) const;
+
+  int num_triangles() const {
+    return triangles_.size();
+  }
+
+  // Returns the bounds of the triangles in model space.
+  const Eigen::AlignedBox3f& bounds() const {
+    return bounds_;
+  }
+
+ private:
+  BoundingVolumeHierarchy hierarchy_;
+  Eigen::AlignedBox3f bounds_;
+  // The triangles in the order of the leaves of the hierarchy.
+  TriangleArray triangles_;
+
+  MeshPicker(const MeshPicker&) = delete;
+  MeshPicker& operator=(const MeshPicker&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESH_PICKING_H_
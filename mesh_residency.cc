@@ -0,0 +1,197 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mesh_residency.h"
+
+#include <algorithm>
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_allocator.h"
+
+namespace wvu {
+
+MeshResidency::MeshResidency()
+    : allocator_(nullptr),
+      callback_id_(-1),
+      head_(-1),
+      tail_(-1),
+      reserved_bytes_(0),
+      frame_(0) {}
+
+MeshResidency::~MeshResidency() {
+  Reset();
+}
+
+void MeshResidency::Initialize(const int num_meshes,
+                               const MeshResidencyOptions& options,
+                               BufferAllocator* allocator,
+                               const EvictFunction& evict) {
+  Reset();
+  options_ = options;
+  allocator_ = allocator;
+  evict_ = evict;
+  entries_.assign(num_meshes, Entry());
+  // The allocator asks for the excess over its budget.
+  callback_id_ = allocator_->AddEvictionCallback(
+      [this](const GLsizeiptr num_bytes) {
+    Evict(num_bytes + static_cast<GLsizeiptr>(options_.eviction_slack *
+                                              allocator_->budget()));
+  });
+}
+
+void MeshResidency::Reset() {
+  if (allocator_ != nullptr) allocator_->RemoveEvictionCallback(callback_id_);
+  allocator_ = nullptr;
+  callback_id_ = -1;
+  evict_ = EvictFunction();
+  entries_.clear();
+  head_ = -1;
+  tail_ = -1;
+  reserved_bytes_ = 0;
+  statistics_ = MeshResidencyStatistics();
+}
+
+bool MeshResidency::RequestLoad(const int mesh, const GLsizeiptr num_bytes) {
+  Entry& entry = entries_[mesh];
+  if (entry.resident) return true;
+  const GLsizeiptr budget = allocator_->budget();
+  if (budget > 0) {
+    const GLsizeiptr excess = allocator_->statistics().total_live_bytes +
+        reserved_bytes_ - entry.reserved_bytes + num_bytes - budget;
+    if (excess > 0) {
+      if (CountEvictableBytes(excess) < excess) {
+        ++statistics_.num_refused_loads;
+        return false;
+      }
+      Evict(excess);
+    }
+  }
+  reserved_bytes_ += num_bytes - entry.reserved_bytes;
+  entry.reserved_bytes = num_bytes;
+  return true;
+}
+
+void MeshResidency::SetResident(const int mesh, const GLsizeiptr num_bytes) {
+  Entry& entry = entries_[mesh];
+  reserved_bytes_ -= entry.reserved_bytes;
+  entry.reserved_bytes = 0;
+  if (entry.resident) {
+    statistics_.resident_bytes += num_bytes - entry.num_bytes;
+    entry.num_bytes = num_bytes;
+    return;
+  }
+  entry.resident = true;
+  entry.num_bytes = num_bytes;
+  // A new mesh counts as drawn, so it is not evicted before its first draw.
+  entry.drawn_frame = frame_;
+  Link(mesh);
+  ++statistics_.num_resident_meshes;
+  statistics_.resident_bytes += num_bytes;
+}
+
+void MeshResidency::SetEvicted(const int mesh) {
+  Entry& entry = entries_[mesh];
+  reserved_bytes_ -= entry.reserved_bytes;
+  entry.reserved_bytes = 0;
+  if (!entry.resident) return;
+  Unlink(mesh);
+  entry.resident = false;
+  --statistics_.num_resident_meshes;
+  statistics_.resident_bytes -= entry.num_bytes;
+}
+
+void MeshResidency::MarkDrawn(const int mesh) {
+  Entry& entry = entries_[mesh];
+  if (!entry.resident) return;
+  entry.drawn_frame = frame_;
+  if (head_ == mesh) return;
+  Unlink(mesh);
+  Link(mesh);
+}
+
+GLsizeiptr MeshResidency::Evict(const GLsizeiptr num_bytes) {
+  GLsizeiptr freed_bytes = 0;
+  // The list is ordered by the frame of the last draw, so the meshes after a
+  // protected one are protected too.
+  while (freed_bytes < num_bytes && tail_ >= 0 &&
+         !Protected(entries_[tail_])) {
+    const int mesh = tail_;
+    const GLsizeiptr mesh_bytes = entries_[mesh].num_bytes;
+    SetEvicted(mesh);
+    evict_(mesh);
+    freed_bytes += mesh_bytes;
+    ++statistics_.num_evictions;
+    statistics_.evicted_bytes += mesh_bytes;
+  }
+  return freed_bytes;
+}
+
+GLsizeiptr MeshResidency::CountEvictableBytes(
+    const GLsizeiptr max_bytes) const {
+  GLsizeiptr evictable_bytes = 0;
+  for (int mesh = tail_;
+       mesh >= 0 && evictable_bytes < max_bytes && !Protected(entries_[mesh]);
+       mesh = entries_[mesh].previous) {
+    evictable_bytes += entries_[mesh].num_bytes;
+  }
+  return evictable_bytes;
+}
+
+void MeshResidency::Link(const int mesh) {
+  Entry& entry = entries_[mesh];
+  entry.previous = -1;
+  entry.next = head_;
+  if (head_ >= 0) entries_[head_].previous = mesh;
+  head_ = mesh;
+  if (tail_ < 0) tail_ = mesh;
+}
+
+void MeshResidency::Unlink(const int mesh) {
+  Entry& entry = entries_[mesh];
+  if (entry.previous >= 0) {
+    entries_[entry.previous].next = entry.next;
+  } else {
+    head_ = entry.next;
+  }
+  if (entry.next >= 0) {
+    entries_[entry.next].previous = entry.previous;
+  } else {
+    tail_ = entry.previous;
+  }
+  entry.previous = -1;
+  entry.next = -1;
+}
+
+}  // namespace wvu
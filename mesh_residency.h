@@ -0,0 +1,192 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESH_RESIDENCY_H_
+#define GLUTILS_MESH_RESIDENCY_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_allocator.h"
+
+namespace wvu {
+// Parameters of a MeshResidency.
+struct MeshResidencyOptions {
+  // The frames a mesh is protected from eviction after it was drawn, so the
+  // meshes of a view needing more than the budget are not evicted and
+  // streamed again in turns.
+  int min_idle_frames = 30;
+  // The fraction of the budget evicted beyond the excess, so an eviction is
+  // not followed by another one every frame.
+  float eviction_slack = 0.05f;
+};
+
+// Counters of a MeshResidency since its initialization.
+struct MeshResidencyStatistics {
+  int num_resident_meshes = 0;
+  int64_t resident_bytes = 0;
+  int num_evictions = 0;
+  int64_t evicted_bytes = 0;
+  // Loads refused because only the meshes drawn recently could make room.
+  int num_refused_loads = 0;
+};
+
+// This class keeps the meshes of an owner, e.g., a StreamedScene, within the
+// budget of the BufferAllocator by evicting the least recently drawn ones.
+// The meshes are identified by indices, and the owner reports when they
+// become resident, when they are drawn, and when it evicts them by itself.
+// The resident meshes are kept in a list from the most to the least recently
+// drawn, so marking a draw and evicting take constant time per mesh. The
+// evictions run when the allocator enforces its budget, and when a load needs
+// room. Three hysteresis rules prevent thrashing: the meshes drawn in the last
+// min_idle_frames frames are never evicted, the evictions free a slack beyond
+// the excess, and the loads that would need to evict the protected meshes are
+// refused, so a view larger than the budget draws what fits instead of
+// streaming its meshes in turns. The evicted meshes are loaded again when the
+// owner requests them.
+//
+// Example:
+//
+// wvu::MeshResidency residency;
+// residency.Initialize(num_meshes, wvu::MeshResidencyOptions(),
+//                      wvu::BufferAllocator::Get(),
+//                      [&](const int mesh) { meshes[mesh].Reset(); });
+// while (...) {  // Rendering loop.
+//   residency.BeginFrame();
+//   if (!meshes[i].valid() && residency.RequestLoad(i, size_of_mesh_i)) {
+//     ...  // Queue the upload of the mesh, and once it completes:
+//     residency.SetResident(i, size_of_mesh_i);
+//   }
+//   residency.MarkDrawn(i);
+// }
+class MeshResidency {
+ public:
+  // Deletes the GPU data of a mesh.
+  typedef std::function<void(const int mesh)> EvictFunction;
+
+  MeshResidency();
+  // Removes the eviction callback from the allocator.
+  ~MeshResidency();
+
+  // Tracks num_meshes meshes, none resident, and registers the eviction
+  // callback with the allocator. Replaces the previous meshes.
+  // Parameters:
+  //   num_meshes  The number of meshes.
+  //   options  When the meshes are evicted.
+  //   allocator  The allocator whose budget bounds the meshes. Not owned.
+  //   evict  Deletes the GPU data of a mesh evicted.
+  void Initialize(const int num_meshes,
+                  const MeshResidencyOptions& options,
+                  BufferAllocator* allocator,
+                  const EvictFunction& evict);
+
+  // Removes the eviction callback and forgets the meshes.
+  void Reset();
+
+  // Starts a frame, which ages the draws of the previous ones.
+  void BeginFrame() {
+    ++frame_;
+  }
+
+  // Returns true if a mesh of num_bytes can be loaded, after evicting the
+  // least recently drawn meshes it needs room from. The bytes are reserved
+  // until the mesh is resident or evicted.
+  bool RequestLoad(const int mesh, const GLsizeiptr num_bytes);
+
+  // Records that a mesh became resident, holding num_bytes.
+  void SetResident(const int mesh, const GLsizeiptr num_bytes);
+
+  // Records that the owner evicted or dropped a mesh. Does not call evict.
+  void SetEvicted(const int mesh);
+
+  // Records that a resident mesh is drawn in the current frame.
+  void MarkDrawn(const int mesh);
+
+  // Evicts the least recently drawn meshes not protected until num_bytes are
+  // freed, or none are left. Returns the bytes freed.
+  GLsizeiptr Evict(const GLsizeiptr num_bytes);
+
+  bool resident(const int mesh) const {
+    return entries_[mesh].resident;
+  }
+
+  const MeshResidencyStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // A mesh, and its links in the list of the resident meshes.
+  struct Entry {
+    bool resident = false;
+    GLsizeiptr num_bytes = 0;
+    // The bytes reserved by a pending load.
+    GLsizeiptr reserved_bytes = 0;
+    int64_t drawn_frame = -1;
+    int previous = -1;
+    int next = -1;
+  };
+
+  // Returns the bytes of the meshes that may be evicted, counting from the
+  // least recently drawn one until max_bytes.
+  GLsizeiptr CountEvictableBytes(const GLsizeiptr max_bytes) const;
+
+  // Returns true if the mesh was drawn recently enough to be protected.
+  bool Protected(const Entry& entry) const {
+    return frame_ - entry.drawn_frame < options_.min_idle_frames;
+  }
+
+  void Link(const int mesh);
+  void Unlink(const int mesh);
+
+  MeshResidencyOptions options_;
+  BufferAllocator* allocator_;
+  int callback_id_;
+  EvictFunction evict_;
+  std::vector<Entry> entries_;
+  // The most and the least recently drawn resident meshes.
+  int head_;
+  int tail_;
+  GLsizeiptr reserved_bytes_;
+  int64_t frame_;
+  MeshResidencyStatistics statistics_;
+
+  MeshResidency(const MeshResidency&) = delete;
+  MeshResidency& operator=(const MeshResidency&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESH_RESIDENCY_H_
@@ -0,0 +1,220 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "mesh_uploader.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "gpu_mesh.h"
+#include "model.h"
+
+namespace wvu {
+
+MeshUploader::MeshUploader()
+    : upload_context_(nullptr),
+      stop_(false),
+      next_id_(0),
+      staging_buffer_id_(0),
+      staging_capacity_(0) {}
+
+MeshUploader::~MeshUploader() {
+  Stop();
+}
+
+void MeshUploader::Stop() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+  }
+  // The buffers of the uploads not taken are shared, so they can be deleted
+  // from the render thread.
+  BufferAllocator* allocator = BufferAllocator::Get();
+  for (IssuedUpload& upload : issued_) {
+    glDeleteSync(upload.fence);
+    allocator->DeleteBuffer(&upload.vertex_buffer_object_id);
+    allocator->DeleteBuffer(&upload.element_buffer_object_id);
+  }
+  issued_.clear();
+  queued_.clear();
+}
+
+bool MeshUploader::Initialize(GLFWwindow* upload_context,
+                              std::string* error_info_log) {
+  if (thread_.joinable()) {
+    *error_info_log = "The mesh uploader is already running.";
+    return false;
+  }
+  if (upload_context == nullptr) {
+    *error_info_log = "The upload context is null.";
+    return false;
+  }
+  upload_context_ = upload_context;
+  thread_ = std::thread(&MeshUploader::Run, this);
+  return true;
+}
+
+int MeshUploader::Upload(Model model) {
+  int id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    id = next_id_++;
+    queued_.push_back(QueuedUpload{id, std::move(model)});
+  }
+  condition_.notify_one();
+  return id;
+}
+
+int MeshUploader::TakeCompletedMeshes(
+    std::vector<CompletedMeshUpload>* meshes) {
+  int num_taken = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The copies are issued in order on a single context, so they complete in
+  // order, and the first fence not signaled ends the search.
+  while (!issued_.empty()) {
+    IssuedUpload& upload = issued_.front();
+    const GLenum status = glClientWaitSync(upload.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      break;
+    }
+    glDeleteSync(upload.fence);
+    CompletedMeshUpload completed;
+    completed.id = upload.id;
+    completed.mesh = SetVertexArrayObject(upload.model,
+                                          upload.vertex_buffer_object_id,
+                                          upload.element_buffer_object_id);
+    meshes->push_back(std::move(completed));
+    issued_.pop_front();
+    ++num_taken;
+  }
+  return num_taken;
+}
+
+int MeshUploader::num_pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int>(queued_.size() + issued_.size());
+}
+
+void MeshUploader::Run() {
+  glfwMakeContextCurrent(upload_context_);
+  // The function pointers loaded by GLEW on the render thread are valid for
+  // the shared context too, since both come from the same driver.
+  BufferAllocator* allocator = BufferAllocator::Get();
+  staging_buffer_id_ = allocator->CreateBuffer(STAGING_DATA);
+  while (true) {
+    QueuedUpload upload;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return stop_ || !queued_.empty(); });
+      if (stop_) break;
+      upload = std::move(queued_.front());
+      queued_.pop_front();
+    }
+    IssuedUpload issued = Issue(std::move(upload));
+    std::lock_guard<std::mutex> lock(mutex_);
+    issued_.push_back(std::move(issued));
+  }
+  allocator->DeleteBuffer(&staging_buffer_id_);
+  glfwMakeContextCurrent(nullptr);
+}
+
+MeshUploader::IssuedUpload MeshUploader::Issue(QueuedUpload upload) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  BufferAllocator* allocator = BufferAllocator::Get();
+  const Model& model = upload.model;
+  const std::vector<GLubyte>& vertices = model.vertex_data();
+  const std::vector<GLuint>& indices = model.indices();
+  // The indices are narrowed to the type the draws use (see
+  // SetElementBufferObject()).
+  std::vector<GLushort> short_indices;
+  const GLvoid* index_data = indices.data();
+  if (model.index_type() == GL_UNSIGNED_SHORT) {
+    short_indices.assign(indices.begin(), indices.end());
+    index_data = short_indices.data();
+  }
+  const GLsizeiptr vertices_size = vertices.size();
+  const GLsizeiptr indices_size =
+      indices.size() * IndexSize(model.index_type());
+
+  // Fill the staging buffer. Reallocating its storage orphans the one the
+  // previous copies may still read.
+  gl_state->BindBuffer(GL_COPY_READ_BUFFER, staging_buffer_id_);
+  staging_capacity_ = std::max(staging_capacity_,
+                               vertices_size + indices_size);
+  allocator->BufferData(staging_buffer_id_, GL_COPY_READ_BUFFER,
+                        staging_capacity_, nullptr, GL_STREAM_COPY);
+  glBufferSubData(GL_COPY_READ_BUFFER, 0, vertices_size, vertices.data());
+  glBufferSubData(GL_COPY_READ_BUFFER, vertices_size, indices_size,
+                  index_data);
+
+  // Copy the staging buffer into the buffers the draws read.
+  IssuedUpload issued;
+  issued.id = upload.id;
+  issued.vertex_buffer_object_id = allocator->CreateBuffer(VERTEX_DATA);
+  issued.element_buffer_object_id = allocator->CreateBuffer(INDEX_DATA);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, issued.vertex_buffer_object_id);
+  allocator->BufferData(issued.vertex_buffer_object_id, GL_COPY_WRITE_BUFFER,
+                        vertices_size, nullptr, GL_STATIC_DRAW);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                      vertices_size);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, issued.element_buffer_object_id);
+  allocator->BufferData(issued.element_buffer_object_id, GL_COPY_WRITE_BUFFER,
+                        indices_size, nullptr, GL_STATIC_DRAW);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                      vertices_size, 0, indices_size);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  gl_state->BindBuffer(GL_COPY_READ_BUFFER, 0);
+
+  // The fence must reach the GPU before the render thread polls it from its
+  // own context, which does not flush this one.
+  issued.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glFlush();
+  issued.model = std::move(upload.model);
+  issued.model.ReleaseCpuData();
+  return issued;
+}
+
+}  // namespace wvu
@@ -0,0 +1,154 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESH_UPLOADER_H_
+#define GLUTILS_MESH_UPLOADER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <Eigen/Core>
+
+#include "gpu_mesh.h"
+#include "model.h"
+
+namespace wvu {
+// A mesh whose upload finished, ready to be drawn by the render thread.
+struct CompletedMeshUpload {
+  // The id returned by MeshUploader::Upload().
+  int id = -1;
+  GpuMesh mesh;
+};
+
+// This class uploads meshes on a second thread, so that large scenes do not
+// freeze the window while their buffers are transferred. The thread owns an
+// OpenGL context created with the context of the window as its share context:
+// buffers and fences are shared between the contexts, but vertex array objects
+// are not. The upload thread writes the vertices and indices of each model
+// into a staging buffer, copies them into the final buffers on the GPU and
+// fences the copies. The render thread polls the fences without waiting, and
+// creates the vertex array objects of the completed meshes on its own context.
+//
+// Example:
+//
+// glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+// GLFWwindow* upload_context =
+//     glfwCreateWindow(1, 1, "", nullptr, window);
+// wvu::MeshUploader uploader;
+// uploader.Initialize(upload_context, &error_info_log);
+// uploader.Upload(std::move(model));
+// while (...) {  // Rendering loop.
+//   std::vector<wvu::CompletedMeshUpload> completed;
+//   uploader.TakeCompletedMeshes(&completed);
+//   ...  // Draw the meshes uploaded so far.
+// }
+class MeshUploader {
+ public:
+  MeshUploader();
+  ~MeshUploader();
+
+  // Starts the upload thread, which makes upload_context current. The context
+  // must share its objects with the context of the render thread, and must not
+  // be current on any other thread. Returns true if successful.
+  // Parameters:
+  //   upload_context  A window whose context is used for the uploads. Not
+  //     owned.
+  //   error_info_log  A pointer to a string that holds the error log.
+  bool Initialize(GLFWwindow* upload_context, std::string* error_info_log);
+
+  // Queues the upload of the model, and returns the id of the upload. The
+  // model releases its CPU data once it is copied into the staging buffer.
+  int Upload(Model model);
+
+  // Creates the vertex array objects of the uploads whose copies finished, and
+  // appends them to meshes in the order they were queued. Never waits for the
+  // GPU. Returns the number of meshes appended.
+  int TakeCompletedMeshes(std::vector<CompletedMeshUpload>* meshes);
+
+  // Stops the upload thread and deletes the uploads not taken yet. Must be
+  // called on the render thread while both contexts are alive. The destructor
+  // stops the thread too.
+  void Stop();
+
+  // Returns the number of uploads not taken yet.
+  int num_pending() const;
+
+ private:
+  // A model waiting for the upload thread.
+  struct QueuedUpload {
+    int id;
+    Model model;
+  };
+
+  // A model whose copies were issued but may not have finished.
+  struct IssuedUpload {
+    int id;
+    Model model;
+    GLuint vertex_buffer_object_id;
+    GLuint element_buffer_object_id;
+    GLsync fence;
+  };
+
+  // Body of the upload thread.
+  void Run();
+
+  // Copies the model into new buffers through the staging buffer, and fences
+  // the copies.
+  IssuedUpload Issue(QueuedUpload upload);
+
+  GLFWwindow* upload_context_;
+  std::thread thread_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stop_;
+  int next_id_;
+  // The uploads hold models, which need an aligned allocator.
+  std::deque<QueuedUpload, Eigen::aligned_allocator<QueuedUpload> > queued_;
+  std::deque<IssuedUpload, Eigen::aligned_allocator<IssuedUpload> > issued_;
+  // Only used by the upload thread.
+  GLuint staging_buffer_id_;
+  GLsizeiptr staging_capacity_;
+
+  MeshUploader(const MeshUploader&) = delete;
+  MeshUploader& operator=(const MeshUploader&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESH_UPLOADER_H_
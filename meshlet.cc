@@ -0,0 +1,224 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "model.h"
+#include "transforms.h"
+
+namespace wvu {
+namespace {
+
+// Computes the bounding sphere and the normal cone of the triangles.
+void ComputeMeshletBounds(const Model& model,
+                          const std::vector<GLuint>& indices,
+                          Meshlet* meshlet) {
+  Eigen::Vector3f min_corner =
+      Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+  Eigen::Vector3f max_corner = -min_corner;
+  std::vector<Eigen::Vector3f> normals;
+  Eigen::Vector3f axis = Eigen::Vector3f::Zero();
+  for (int i = meshlet->first_index;
+       i < meshlet->first_index + meshlet->num_indices; i += 3) {
+    const Eigen::Vector3f a = model.VertexPosition(indices[i]);
+    const Eigen::Vector3f b = model.VertexPosition(indices[i + 1]);
+    const Eigen::Vector3f c = model.VertexPosition(indices[i + 2]);
+    for (const Eigen::Vector3f* p : {&a, &b, &c}) {
+      min_corner = min_corner.cwiseMin(*p);
+      max_corner = max_corner.cwiseMax(*p);
+    }
+    const Eigen::Vector3f normal = (b - a).cross(c - a);
+    if (normal.squaredNorm() > 0.0f) {
+      normals.push_back(normal.normalized());
+      axis += normals.back();
+    }
+  }
+  meshlet->center = 0.5f * (min_corner + max_corner);
+  meshlet->radius = 0.0f;
+  for (int i = meshlet->first_index;
+       i < meshlet->first_index + meshlet->num_indices; ++i) {
+    meshlet->radius = std::max(
+        meshlet->radius,
+        (model.VertexPosition(indices[i]) - meshlet->center).norm());
+  }
+  if (normals.empty() || axis.squaredNorm() == 0.0f) {
+    meshlet->cone_axis = Eigen::Vector3f::UnitZ();
+    meshlet->cone_cutoff = 1.0f;
+    return;
+  }
+  meshlet->cone_axis = axis.normalized();
+  float min_dot = 1.0f;
+  for (const Eigen::Vector3f& normal : normals) {
+    min_dot = std::min(min_dot, normal.dot(meshlet->cone_axis));
+  }
+  // The cutoff is the sine of the cone spread; cones wider than a hemisphere
+  // cannot be culled.
+  meshlet->cone_cutoff =
+      min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+}
+
+}  // namespace
+
+bool BuildMeshlets(const int max_triangles,
+                   const int max_vertices,
+                   Model* model,
+                   std::vector<Meshlet>* meshlets) {
+  if (model->primitive_type() != GL_TRIANGLES || model->cpu_data_released() ||
+      max_triangles < 1 || max_vertices < 3) {
+    return false;
+  }
+  const std::vector<GLuint>& indices = model->indices();
+  const int num_triangles = indices.size() / 3;
+  const int num_vertices = model->num_vertices();
+  // Vertex to triangle adjacency.
+  std::vector<std::vector<int>> vertex_triangles(num_vertices);
+  for (int t = 0; t < num_triangles; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      vertex_triangles[indices[3 * t + k]].push_back(t);
+    }
+  }
+  std::vector<bool> emitted(num_triangles, false);
+  // Meshlet that last used each vertex, to count the new vertices quickly.
+  std::vector<int> vertex_meshlet(num_vertices, -1);
+  std::vector<GLuint> reordered;
+  reordered.reserve(indices.size());
+  meshlets->clear();
+  int seed = 0;
+  std::vector<int> candidates;
+  while (true) {
+    while (seed < num_triangles && emitted[seed]) ++seed;
+    if (seed == num_triangles) break;
+    const int meshlet_id = meshlets->size();
+    Meshlet meshlet;
+    meshlet.first_index = reordered.size();
+    int meshlet_vertices = 0;
+    int meshlet_triangles = 0;
+    int next = seed;
+    candidates.clear();
+    while (next >= 0) {
+      // Add the triangle to the meshlet.
+      emitted[next] = true;
+      ++meshlet_triangles;
+      for (int k = 0; k < 3; ++k) {
+        const GLuint v = indices[3 * next + k];
+        reordered.push_back(v);
+        if (vertex_meshlet[v] != meshlet_id) {
+          vertex_meshlet[v] = meshlet_id;
+          ++meshlet_vertices;
+          candidates.insert(candidates.end(), vertex_triangles[v].begin(),
+                            vertex_triangles[v].end());
+        }
+      }
+      if (meshlet_triangles == max_triangles) break;
+      // Pick the neighbor triangle adding the fewest vertices.
+      next = -1;
+      int best_new_vertices = 4;
+      for (size_t i = 0; i < candidates.size();) {
+        const int t = candidates[i];
+        if (emitted[t]) {
+          candidates[i] = candidates.back();
+          candidates.pop_back();
+          continue;
+        }
+        int new_vertices = 0;
+        for (int k = 0; k < 3; ++k) {
+          if (vertex_meshlet[indices[3 * t + k]] != meshlet_id) ++new_vertices;
+        }
+        if (new_vertices < best_new_vertices &&
+            meshlet_vertices + new_vertices <= max_vertices) {
+          best_new_vertices = new_vertices;
+          next = t;
+        }
+        ++i;
+      }
+    }
+    meshlet.num_indices = reordered.size() - meshlet.first_index;
+    meshlets->push_back(meshlet);
+  }
+  for (Meshlet& meshlet : *meshlets) {
+    ComputeMeshletBounds(*model, reordered, &meshlet);
+  }
+  model->SetIndices(std::move(reordered));
+  return true;
+}
+
+int CullMeshlets(const std::vector<Meshlet>& meshlets,
+                 const Eigen::Matrix4f& model_view_projection,
+                 const Eigen::Vector3f& camera_position,
+                 const GLenum index_type,
+                 MeshletDrawList* draw_list) {
+  // The frustum planes in model space.
+  const FrustumPlanes planes = ExtractFrustumPlanes(model_view_projection);
+  const GLsizei index_size = IndexSize(index_type);
+  int num_visible = 0;
+  int last_end = -1;
+  for (const Meshlet& meshlet : meshlets) {
+    const Eigen::Vector4f center = meshlet.center.homogeneous();
+    if (((planes * center).array() < -meshlet.radius).any()) continue;
+    const Eigen::Vector3f view = meshlet.center - camera_position;
+    if (view.dot(meshlet.cone_axis) >=
+        meshlet.cone_cutoff * view.norm() + meshlet.radius) {
+      continue;
+    }
+    ++num_visible;
+    if (meshlet.first_index == last_end) {
+      draw_list->counts.back() += meshlet.num_indices;
+    } else {
+      draw_list->counts.push_back(meshlet.num_indices);
+      draw_list->offsets.push_back(reinterpret_cast<const GLvoid*>(
+          static_cast<uintptr_t>(meshlet.first_index) * index_size));
+    }
+    last_end = meshlet.first_index + meshlet.num_indices;
+  }
+  return num_visible;
+}
+
+void DrawMeshlets(const MeshletDrawList& draw_list, const GLenum index_type) {
+  if (draw_list.counts.empty()) return;
+  glMultiDrawElements(GL_TRIANGLES, draw_list.counts.data(), index_type,
+                      draw_list.offsets.data(), draw_list.counts.size());
+}
+
+}  // namespace wvu
@@ -0,0 +1,115 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MESHLET_H_
+#define GLUTILS_MESHLET_H_
+
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "model.h"
+
+namespace wvu {
+// Default limits of a meshlet. Small clusters cull finely, while large ones
+// keep the per-cluster overhead low.
+constexpr int kDefaultMeshletMaxTriangles = 124;
+constexpr int kDefaultMeshletMaxVertices = 64;
+
+// A cluster of triangles stored as a contiguous range of the index buffer,
+// with the bounds needed to cull it.
+struct Meshlet {
+  int first_index = 0;
+  int num_indices = 0;
+  // Bounding sphere in model space.
+  Eigen::Vector3f center = Eigen::Vector3f::Zero();
+  float radius = 0.0f;
+  // Normal cone: all the triangles face within the cone around cone_axis. The
+  // meshlet is back-facing when
+  //   dot(center - camera, cone_axis) >=
+  //       cone_cutoff * |center - camera| + radius.
+  // A cutoff of 1 disables the test.
+  Eigen::Vector3f cone_axis = Eigen::Vector3f::UnitZ();
+  float cone_cutoff = 1.0f;
+};
+
+// Partitions the triangle list of the model into meshlets and reorders its
+// indices so that each meshlet is a contiguous range. Meshlets grow by
+// adding the neighbor triangle that brings the fewest new vertices, which keeps
+// them compact. Returns false if the model is not a triangle list with CPU
+// data.
+// Parameters:
+//   max_triangles  The maximum number of triangles per meshlet.
+//   max_vertices  The maximum number of unique vertices per meshlet.
+//   model  The model whose indices are reordered.
+//   meshlets  The meshlets of the model.
+bool BuildMeshlets(const int max_triangles,
+                   const int max_vertices,
+                   Model* model,
+                   std::vector<Meshlet>* meshlets);
+
+// Ranges of the index buffer to draw with glMultiDrawElements().
+struct MeshletDrawList {
+  std::vector<GLsizei> counts;
+  std::vector<const GLvoid*> offsets;
+
+  void Clear() {
+    counts.clear();
+    offsets.clear();
+  }
+};
+
+// Culls the meshlets against the view frustum and their normal cones, and
+// appends the visible ones to draw_list. Consecutive visible meshlets are
+// merged into a single range.
+// Parameters:
+//   meshlets  The meshlets of a model.
+//   model_view_projection  The projection * view * model matrix of the model.
+//   camera_position  The position of the camera in model space.
+//   index_type  The index type of the element buffer.
+//   draw_list  The ranges to draw.
+// Returns the number of visible meshlets.
+int CullMeshlets(const std::vector<Meshlet>& meshlets,
+                 const Eigen::Matrix4f& model_view_projection,
+                 const Eigen::Vector3f& camera_position,
+                 const GLenum index_type,
+                 MeshletDrawList* draw_list);
+
+// Draws the ranges of the draw list with the currently bound vertex array
+// object.
+void DrawMeshlets(const MeshletDrawList& draw_list, const GLenum index_type);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MESHLET_H_
@@ -0,0 +1,482 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "metrics_server.h"
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "frame_profiler.h"
+
+namespace wvu {
+namespace {
+// Prefix of the names of the metrics.
+constexpr char kMetricPrefix[] = "wvu_";
+
+// Largest request head accepted. The requests have no body.
+constexpr size_t kMaxRequestBytes = 8192;
+
+// Time a connection has to send its request and take the answer.
+constexpr std::chrono::seconds kConnectionTimeout(5);
+
+bool IsValidName(const std::string& name) {
+  if (name.empty() || (name[0] >= '0' && name[0] <= '9')) return false;
+  for (const char c : name) {
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+          (c >= '0' && c <= '9') || c == '_')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Formats a sample value the way Prometheus parses it.
+std::string FormatValue(const double value) {
+  if (value != value) return "NaN";
+  if (value > 1e308) return "+Inf";
+  if (value < -1e308) return "-Inf";
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.10g", value);
+  return text;
+}
+
+// Escapes the backslashes, the new lines and, in label values, the quotes.
+std::string Escape(const std::string& text, const bool quotes) {
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (const char c : text) {
+    if (c == '\\') {
+      escaped += "\\\\";
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else if (c == '"' && quotes) {
+      escaped += "\\\"";
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+void AppendHeader(const std::string& name,
+                  const std::string& help,
+                  const char* type,
+                  std::string* text) {
+  *text += "# HELP " + name + " " + Escape(help, false) + "\n";
+  *text += "# TYPE " + name + " " + type + "\n";
+}
+
+// Decodes the %XX escapes and the pluses of a query string component.
+std::string DecodeComponent(const std::string& component) {
+  std::string decoded;
+  for (size_t i = 0; i < component.size(); ++i) {
+    const char c = component[i];
+    if (c == '+') {
+      decoded += ' ';
+    } else if (c == '%' && i + 2 < component.size() &&
+               std::isxdigit(static_cast<unsigned char>(component[i + 1])) &&
+               std::isxdigit(static_cast<unsigned char>(component[i + 2]))) {
+      decoded += static_cast<char>(
+          std::stoi(component.substr(i + 1, 2), nullptr, 16));
+      i += 2;
+    } else {
+      decoded += c;
+    }
+  }
+  return decoded;
+}
+
+std::string HttpResponse(const int status,
+                         const char* reason,
+                         const std::string& body) {
+  return "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n" +
+      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n" +
+      "Content-Length: " + std::to_string(body.size()) + "\r\n" +
+      "Connection: close\r\n\r\n" + body;
+}
+
+const char* StatusReason(const int status) {
+  switch (status) {
+    case 200:
+      return "OK";
+    case 400:
+      return "Bad Request";
+    case 404:
+      return "Not Found";
+    case 405:
+      return "Method Not Allowed";
+    case 431:
+      return "Request Header Fields Too Large";
+    default:
+      return "Error";
+  }
+}
+
+}  // namespace
+
+MetricsServer::MetricsServer() : listen_socket_(-1), profiler_(nullptr) {}
+
+MetricsServer::~MetricsServer() {
+  Stop();
+}
+
+bool MetricsServer::Start(const int port, std::string* error_info_log) {
+  Stop();
+  listen_socket_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_socket_ < 0) {
+    *error_info_log = std::string("Could not create the socket: ") +
+        std::strerror(errno) + ".";
+    return false;
+  }
+  const int reuse = 1;
+  setsockopt(listen_socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(listen_socket_, reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) < 0 ||
+      listen(listen_socket_, kMaxMetricsConnections) < 0 ||
+      fcntl(listen_socket_, F_SETFL, O_NONBLOCK) < 0) {
+    *error_info_log = "Could not listen on port " + std::to_string(port) +
+        ": " + std::strerror(errno) + ".";
+    close(listen_socket_);
+    listen_socket_ = -1;
+    return false;
+  }
+  return true;
+}
+
+void MetricsServer::Stop() {
+  for (const Connection& connection : connections_) close(connection.socket);
+  connections_.clear();
+  if (listen_socket_ >= 0) close(listen_socket_);
+  listen_socket_ = -1;
+}
+
+int MetricsServer::AddCounter(const std::string& name,
+                              const std::string& help) {
+  return AddMetric(name, help, COUNTER);
+}
+
+int MetricsServer::AddGauge(const std::string& name, const std::string& help) {
+  return AddMetric(name, help, GAUGE);
+}
+
+int MetricsServer::AddHistogram(const std::string& name,
+                                const std::string& help,
+                                const std::vector<double>& upper_bounds) {
+  if (!std::is_sorted(upper_bounds.begin(), upper_bounds.end()) ||
+      std::adjacent_find(upper_bounds.begin(), upper_bounds.end()) !=
+      upper_bounds.end()) {
+    return -1;
+  }
+  const int histogram = AddMetric(name, help, HISTOGRAM);
+  if (histogram < 0) return -1;
+  metrics_[histogram].upper_bounds = upper_bounds;
+  metrics_[histogram].bucket_counts.assign(upper_bounds.size(), 0);
+  return histogram;
+}
+
+void MetricsServer::Set(const int metric, const double value) {
+  if (metric < 0) return;
+  metrics_[metric].value = value;
+}
+
+void MetricsServer::Increment(const int metric, const double delta) {
+  if (metric < 0) return;
+  metrics_[metric].value += delta;
+}
+
+void MetricsServer::Observe(const int histogram, const double value) {
+  if (histogram < 0) return;
+  Metric& metric = metrics_[histogram];
+  // The buckets are cumulative, so a value counts in every bucket whose bound
+  // is at least the value.
+  const size_t first_bucket = std::lower_bound(metric.upper_bounds.begin(),
+                                               metric.upper_bounds.end(),
+                                               value) -
+      metric.upper_bounds.begin();
+  for (size_t i = first_bucket; i < metric.bucket_counts.size(); ++i) {
+    ++metric.bucket_counts[i];
+  }
+  ++metric.count;
+  metric.value += value;
+}
+
+void MetricsServer::AddKnob(
+    const std::string& name,
+    const std::string& help,
+    const std::function<std::string()>& getter,
+    const std::function<bool(const std::string&)>& setter) {
+  Knob knob;
+  knob.name = name;
+  knob.help = help;
+  knob.getter = getter;
+  knob.setter = setter;
+  knobs_.push_back(knob);
+}
+
+int MetricsServer::Poll() {
+  if (listen_socket_ < 0) return 0;
+  while (connections_.size() < kMaxMetricsConnections) {
+    const int client_socket = accept(listen_socket_, nullptr, nullptr);
+    if (client_socket < 0) break;
+    if (fcntl(client_socket, F_SETFL, O_NONBLOCK) < 0) {
+      close(client_socket);
+      continue;
+    }
+    Connection connection;
+    connection.socket = client_socket;
+    connection.accept_time = std::chrono::steady_clock::now();
+    connections_.push_back(connection);
+  }
+  int num_knob_changes = 0;
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  for (size_t i = 0; i < connections_.size();) {
+    Connection& connection = connections_[i];
+    if (Serve(&connection, &num_knob_changes) &&
+        now - connection.accept_time < kConnectionTimeout) {
+      ++i;
+      continue;
+    }
+    close(connection.socket);
+    connections_.erase(connections_.begin() + i);
+  }
+  return num_knob_changes;
+}
+
+int MetricsServer::AddMetric(const std::string& name,
+                             const std::string& help,
+                             const MetricType type) {
+  if (!IsValidName(name)) return -1;
+  Metric metric;
+  metric.name = kMetricPrefix + name;
+  metric.help = help;
+  metric.type = type;
+  metrics_.push_back(metric);
+  return static_cast<int>(metrics_.size()) - 1;
+}
+
+bool MetricsServer::Serve(Connection* connection, int* num_knob_changes) {
+  // Reads until the end of the request head, without waiting.
+  if (connection->response.empty()) {
+    char buffer[1024];
+    while (true) {
+      const ssize_t received =
+          recv(connection->socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+      if (received < 0 && errno == EINTR) continue;
+      if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      if (received <= 0) return false;
+      connection->request.append(buffer, received);
+      if (connection->request.size() > kMaxRequestBytes) break;
+    }
+    const size_t head_end = connection->request.find("\r\n\r\n");
+    if (head_end != std::string::npos) {
+      ++statistics_.num_requests;
+      connection->response = Answer(connection->request.substr(0, head_end),
+                                    num_knob_changes);
+    } else if (connection->request.size() > kMaxRequestBytes) {
+      ++statistics_.num_bad_requests;
+      connection->response = HttpResponse(431, StatusReason(431), "");
+    } else {
+      return true;
+    }
+  }
+  // Sends what the socket takes, and the rest in the next polls.
+  while (connection->num_sent_bytes < connection->response.size()) {
+    const ssize_t sent =
+        send(connection->socket,
+             connection->response.data() + connection->num_sent_bytes,
+             connection->response.size() - connection->num_sent_bytes,
+             MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (sent <= 0) return false;
+    connection->num_sent_bytes += sent;
+  }
+  return false;
+}
+
+std::string MetricsServer::Answer(const std::string& request,
+                                  int* num_knob_changes) {
+  // The request line is "METHOD target HTTP/1.1".
+  const size_t method_end = request.find(' ');
+  const size_t target_end = method_end == std::string::npos ?
+      std::string::npos : request.find(' ', method_end + 1);
+  if (target_end == std::string::npos) {
+    ++statistics_.num_bad_requests;
+    return HttpResponse(400, StatusReason(400), "Malformed request.\n");
+  }
+  const std::string method = request.substr(0, method_end);
+  const std::string target =
+      request.substr(method_end + 1, target_end - method_end - 1);
+  const size_t query_begin = target.find('?');
+  const std::string path = target.substr(0, query_begin);
+  const std::string query = query_begin == std::string::npos ? "" :
+      target.substr(query_begin + 1);
+  if (path == "/metrics" && method == "GET") {
+    ++statistics_.num_scrapes;
+    return HttpResponse(200, StatusReason(200), FormatMetrics());
+  }
+  if (path == "/knobs" && method == "GET") {
+    return HttpResponse(200, StatusReason(200), FormatKnobs());
+  }
+  if (path == "/knobs" && method == "POST") {
+    std::string body;
+    const int status = SetKnobs(query, &body, num_knob_changes);
+    return HttpResponse(status, StatusReason(status), body);
+  }
+  ++statistics_.num_bad_requests;
+  if (path == "/metrics" || path == "/knobs") {
+    return HttpResponse(405, StatusReason(405), "Method not allowed.\n");
+  }
+  return HttpResponse(404, StatusReason(404),
+                      "Serving /metrics and /knobs.\n");
+}
+
+std::string MetricsServer::FormatMetrics() const {
+  std::string text;
+  for (const Metric& metric : metrics_) {
+    if (metric.type != HISTOGRAM) {
+      AppendHeader(metric.name, metric.help,
+                   metric.type == COUNTER ? "counter" : "gauge", &text);
+      text += metric.name + " " + FormatValue(metric.value) + "\n";
+      continue;
+    }
+    AppendHeader(metric.name, metric.help, "histogram", &text);
+    for (size_t i = 0; i < metric.upper_bounds.size(); ++i) {
+      text += metric.name + "_bucket{le=\"" +
+          FormatValue(metric.upper_bounds[i]) + "\"} " +
+          std::to_string(metric.bucket_counts[i]) + "\n";
+    }
+    text += metric.name + "_bucket{le=\"+Inf\"} " +
+        std::to_string(metric.count) + "\n";
+    text += metric.name + "_sum " + FormatValue(metric.value) + "\n";
+    text += metric.name + "_count " + std::to_string(metric.count) + "\n";
+  }
+  if (profiler_ == nullptr) return text;
+  // The scopes keep a window of samples rather than every value, so their
+  // statistics are gauges labeled by scope.
+  std::vector<ProfileScopeStatistics> scopes;
+  profiler_->GetStatistics(&scopes);
+  const struct {
+    const char* name;
+    const char* help;
+    double ProfileScopeStatistics::*field;
+  } kScopeGauges[] = {
+      {"scope_average_milliseconds", "Average time of a profiler scope.",
+       &ProfileScopeStatistics::average_ms},
+      {"scope_p99_milliseconds", "99th percentile time of a profiler scope.",
+       &ProfileScopeStatistics::p99_ms},
+      {"scope_max_milliseconds", "Largest time of a profiler scope.",
+       &ProfileScopeStatistics::max_ms},
+  };
+  for (const auto& gauge : kScopeGauges) {
+    const std::string name = std::string(kMetricPrefix) + gauge.name;
+    AppendHeader(name, gauge.help, "gauge", &text);
+    for (const ProfileScopeStatistics& scope : scopes) {
+      if (scope.num_samples == 0) continue;
+      text += name + "{scope=\"" + Escape(scope.name, true) +
+          "\",clock=\"" + (scope.gpu ? "gpu" : "cpu") + "\"} " +
+          FormatValue(scope.*gauge.field) + "\n";
+    }
+  }
+  return text;
+}
+
+std::string MetricsServer::FormatKnobs() const {
+  std::string text;
+  for (const Knob& knob : knobs_) {
+    text += "# " + knob.help + "\n" + knob.name + " " + knob.getter() + "\n";
+  }
+  return text;
+}
+
+int MetricsServer::SetKnobs(const std::string& query,
+                            std::string* body,
+                            int* num_knob_changes) {
+  if (query.empty()) {
+    ++statistics_.num_bad_requests;
+    *body = "Expected /knobs?name=value.\n";
+    return 400;
+  }
+  // The knobs are set in order, and the first failure stops the others.
+  size_t begin = 0;
+  while (begin <= query.size()) {
+    size_t end = query.find('&', begin);
+    if (end == std::string::npos) end = query.size();
+    const std::string parameter = query.substr(begin, end - begin);
+    begin = end + 1;
+    if (parameter.empty()) continue;
+    const size_t equals = parameter.find('=');
+    const std::string name = DecodeComponent(parameter.substr(0, equals));
+    const std::string value = equals == std::string::npos ? "" :
+        DecodeComponent(parameter.substr(equals + 1));
+    const auto knob = std::find_if(
+        knobs_.begin(), knobs_.end(),
+        [&name](const Knob& knob) { return knob.name == name; });
+    if (knob == knobs_.end()) {
+      ++statistics_.num_bad_requests;
+      *body += "Unknown knob " + name + ".\n";
+      return 404;
+    }
+    if (!knob->setter(value)) {
+      ++statistics_.num_rejected_knob_changes;
+      *body += "Invalid value " + value + " for " + name + ".\n";
+      return 400;
+    }
+    ++statistics_.num_knob_changes;
+    ++*num_knob_changes;
+    *body += knob->name + " " + knob->getter() + "\n";
+  }
+  return 200;
+}
+
+}  // namespace wvu
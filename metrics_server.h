@@ -0,0 +1,223 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_METRICS_SERVER_H_
+#define GLUTILS_METRICS_SERVER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace wvu {
+class FrameProfiler;
+
+// Most connections a MetricsServer keeps open at once. The others wait in the
+// backlog of the socket.
+constexpr int kMaxMetricsConnections = 8;
+
+// Counters of a MetricsServer.
+struct MetricsServerStatistics {
+  int64_t num_requests = 0;
+  // Requests of /metrics.
+  int64_t num_scrapes = 0;
+  // Knobs changed, and values the setters of the knobs rejected.
+  int64_t num_knob_changes = 0;
+  int64_t num_rejected_knob_changes = 0;
+  // Requests that were malformed, too large, or for an unknown path.
+  int64_t num_bad_requests = 0;
+};
+
+// This class serves the metrics of the renderer over HTTP in the Prometheus
+// text format, so that a running instance is scraped without attaching any
+// tool, and exposes knobs, e.g., the frame pacing or the resolution scale,
+// that are read and changed live:
+//
+//   GET /metrics                 The counters, gauges and histograms, and the
+//                                statistics of the scopes of a FrameProfiler.
+//   GET /knobs                   The knobs, one "name value" line each.
+//   POST /knobs?name=value&...   Sets knobs, and answers with their values.
+//
+// The server lives on the main thread: Poll() accepts the connections and
+// answers the complete requests without ever blocking, so the metrics are read
+// and the knobs are set between two frames, without any lock, and a slow
+// client only delays its own answer. The counters and gauges are set once per
+// frame, and the histograms count the values of every frame. POSIX only.
+//
+// Example:
+//
+// wvu::MetricsServer metrics;
+// metrics.Start(port, &error_info_log);
+// metrics.set_profiler(&profiler);
+// const int frame_time = metrics.AddHistogram(
+//     "frame_time_milliseconds", "Time between frames.", {8.0, 16.7, 33.3});
+// const int draws = metrics.AddGauge("draws", "Draws of the last frame.");
+// metrics.AddKnob("lod_pixel_error", "Screen error of the levels of detail.",
+//                 []() { return std::to_string(lod_pixel_error); },
+//                 [](const std::string& value) { ... return valid; });
+// while (...) {  // Render loop.
+//   ...
+//   metrics.Observe(frame_time, frame_ms);
+//   metrics.Set(draws, render_queue.statistics().num_draws);
+//   metrics.Poll();
+// }
+// metrics.Stop();
+class MetricsServer {
+ public:
+  MetricsServer();
+  ~MetricsServer();
+
+  // Listens on port. Returns true if successful.
+  bool Start(const int port, std::string* error_info_log);
+
+  // Closes the connections and the socket.
+  void Stop();
+
+  // Adds a metric, and returns its id, or -1 if the name is invalid. Names are
+  // prefixed with "wvu_", and must only have letters, digits and underscores.
+  // Counters only increase, e.g., the bytes uploaded since the start, while
+  // gauges hold a current value, e.g., the depth of a queue.
+  int AddCounter(const std::string& name, const std::string& help);
+  int AddGauge(const std::string& name, const std::string& help);
+  // Histograms count the observed values below each upper bound, which must
+  // increase.
+  int AddHistogram(const std::string& name,
+                   const std::string& help,
+                   const std::vector<double>& upper_bounds);
+
+  // Sets the value of a counter or a gauge. Ids of -1 are ignored.
+  void Set(const int metric, const double value);
+
+  // Adds a delta to the value of a counter or a gauge.
+  void Increment(const int metric, const double delta = 1.0);
+
+  // Counts a value in a histogram.
+  void Observe(const int histogram, const double value);
+
+  // Adds a knob. The getter returns its value, and the setter applies a new
+  // one, returning false if the value is invalid. Both run in Poll().
+  void AddKnob(const std::string& name,
+               const std::string& help,
+               const std::function<std::string()>& getter,
+               const std::function<bool(const std::string&)>& setter);
+
+  // Accepts the waiting connections, and answers the complete requests. Never
+  // blocks. Returns the number of knobs changed. Must be called on the thread
+  // that sets the metrics and owns the state of the knobs.
+  int Poll();
+
+  // Exports the statistics of the scopes of the profiler in /metrics, or none
+  // if the profiler is nullptr. The profiler must outlive the server.
+  void set_profiler(const FrameProfiler* profiler) {
+    profiler_ = profiler;
+  }
+
+  bool listening() const {
+    return listen_socket_ >= 0;
+  }
+
+  const MetricsServerStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  enum MetricType { COUNTER, GAUGE, HISTOGRAM };
+
+  struct Metric {
+    std::string name;
+    std::string help;
+    MetricType type;
+    // The sum of the values of a histogram.
+    double value = 0.0;
+    // The bounds of a histogram, and the number of values below each bound and
+    // in total.
+    std::vector<double> upper_bounds;
+    std::vector<int64_t> bucket_counts;
+    int64_t count = 0;
+  };
+
+  struct Knob {
+    std::string name;
+    std::string help;
+    std::function<std::string()> getter;
+    std::function<bool(const std::string&)> setter;
+  };
+
+  struct Connection {
+    int socket = -1;
+    // The request received so far, and the answer left to send.
+    std::string request;
+    std::string response;
+    size_t num_sent_bytes = 0;
+    std::chrono::steady_clock::time_point accept_time;
+  };
+
+  int AddMetric(const std::string& name,
+                const std::string& help,
+                const MetricType type);
+
+  // Reads and answers what a connection allows without blocking. Returns false
+  // once the connection is done or failed.
+  bool Serve(Connection* connection, int* num_knob_changes);
+
+  // Returns the answer to a complete request.
+  std::string Answer(const std::string& request, int* num_knob_changes);
+
+  // Returns the metrics in the Prometheus text format.
+  std::string FormatMetrics() const;
+
+  // Returns the knobs, one "name value" line each.
+  std::string FormatKnobs() const;
+
+  // Sets the knobs of a query string. Returns the HTTP status.
+  int SetKnobs(const std::string& query,
+               std::string* body,
+               int* num_knob_changes);
+
+  int listen_socket_;
+  std::vector<Connection> connections_;
+  std::vector<Metric> metrics_;
+  std::vector<Knob> knobs_;
+  const FrameProfiler* profiler_;
+  MetricsServerStatistics statistics_;
+
+  MetricsServer(const MetricsServer&) = delete;
+  MetricsServer& operator=(const MetricsServer&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_METRICS_SERVER_H_
@@ -0,0 +1,180 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "model.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "vertex_format.h"
+
+namespace wvu {
+
+// Implements the setter for position. Note that the class somehow defines
+// a namespace.
+void Model::SetPosition(const Eigen::Vector3f& position) {
+  position_ = position;
+  model_matrix_dirty_ = true;
+}
+
+Model::Model(const Eigen::Vector3f& orientation,
+             const Eigen::Vector3f& position,
+             const VertexLayout& vertex_layout,
+             std::vector<GLubyte> vertex_data,
+             std::vector<GLuint> indices)
+    : orientation_(orientation),
+      position_(position),
+      num_vertices_(0),
+      indices_(std::move(indices)),
+      num_indices_(indices_.size()),
+      primitive_type_(GL_TRIANGLES),
+      closed_(false),
+      dirty_vertices_begin_(0),
+      dirty_vertices_end_(0),
+      model_matrix_dirty_(true) {
+  SetVertexData(vertex_layout, std::move(vertex_data));
+}
+
+const Eigen::Matrix4f& Model::model_matrix() const {
+  if (model_matrix_dirty_) {
+    Eigen::Matrix4f model_matrix = Eigen::Matrix4f::Identity();
+    // The norm of the Rodrigues vector is the angle of the rotation.
+    const float angle = orientation_.norm();
+    if (angle > 0.0f) {
+      model_matrix.block<3, 3>(0, 0) =
+          Eigen::AngleAxisf(angle, orientation_ / angle).toRotationMatrix();
+    }
+    model_matrix.block<3, 1>(0, 3) = position_;
+    model_matrix_ = model_matrix;
+    model_matrix_dirty_ = false;
+  }
+  return model_matrix_;
+}
+
+void Model::SetVertexData(const VertexLayout& layout,
+                          const void* data,
+                          const int num_vertices) {
+  vertex_layout_ = layout;
+  num_vertices_ = num_vertices;
+  const GLubyte* bytes = static_cast<const GLubyte*>(data);
+  vertex_data_.assign(bytes, bytes + num_vertices * layout.stride());
+  ClearDirtyVertices();
+}
+
+void Model::SetVertexData(const VertexLayout& layout,
+                          std::vector<GLubyte> vertex_data) {
+  vertex_layout_ = layout;
+  vertex_data_ = std::move(vertex_data);
+  num_vertices_ =
+      layout.stride() > 0 ? vertex_data_.size() / layout.stride() : 0;
+  ClearDirtyVertices();
+}
+
+bool Model::UpdateVertices(const int first_vertex,
+                           const int num_vertices,
+                           const void* data) {
+  if (first_vertex < 0 || num_vertices < 0 ||
+      first_vertex + num_vertices > num_vertices_ || cpu_data_released()) {
+    return false;
+  }
+  const int stride = vertex_layout_.stride();
+  std::memcpy(vertex_data_.data() + first_vertex * stride, data,
+              num_vertices * stride);
+  MarkVerticesDirty(first_vertex, num_vertices);
+  return true;
+}
+
+void Model::MarkVerticesDirty(const int first_vertex, const int num_vertices) {
+  if (num_vertices <= 0) return;
+  if (dirty_vertices_begin_ == dirty_vertices_end_) {
+    dirty_vertices_begin_ = first_vertex;
+    dirty_vertices_end_ = first_vertex + num_vertices;
+    return;
+  }
+  dirty_vertices_begin_ = std::min(dirty_vertices_begin_, first_vertex);
+  dirty_vertices_end_ =
+      std::max(dirty_vertices_end_, first_vertex + num_vertices);
+}
+
+void Model::SetIndices(std::vector<GLuint> indices,
+                       const GLenum primitive_type) {
+  indices_ = std::move(indices);
+  num_indices_ = indices_.size();
+  primitive_type_ = primitive_type;
+}
+
+void Model::ReleaseCpuData() {
+  // Swapping with empty vectors frees the memory, whereas clear() keeps the
+  // capacity.
+  std::vector<GLubyte>().swap(vertex_data_);
+  std::vector<GLuint>().swap(indices_);
+}
+
+Eigen::Vector3f Model::VertexPosition(const int i) const {
+  const VertexAttribute* attribute = vertex_layout_.FindAttribute(POSITION);
+  Eigen::Vector3f position = Eigen::Vector3f::Zero();
+  if (attribute == nullptr || attribute->type != GL_FLOAT) {
+    return position;
+  }
+  const GLubyte* vertex = vertex_data_.data() + i * vertex_layout_.stride();
+  const int num_components = attribute->num_components < 3 ?
+      attribute->num_components : 3;
+  std::memcpy(position.data(), vertex + attribute->offset,
+              num_components * sizeof(GLfloat));
+  return position;
+}
+
+void Model::GetVertexPositions(VertexPositions* positions) const {
+  positions->assign(num_vertices_, Eigen::Vector4f::UnitW());
+  const VertexAttribute* attribute = vertex_layout_.FindAttribute(POSITION);
+  if (attribute == nullptr || attribute->type != GL_FLOAT ||
+      vertex_data_.empty()) {
+    return;
+  }
+  const int num_components = attribute->num_components < 3 ?
+      attribute->num_components : 3;
+  const GLubyte* vertex = vertex_data_.data() + attribute->offset;
+  for (int i = 0; i < num_vertices_; ++i) {
+    std::memcpy((*positions)[i].data(), vertex,
+                num_components * sizeof(GLfloat));
+    vertex += vertex_layout_.stride();
+  }
+}
+
+}  // namespace wvu
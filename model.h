@@ -0,0 +1,386 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MODEL_H_
+#define GLUTILS_MODEL_H_
+
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include "vertex_format.h"
+
+namespace wvu {
+// Maximum number of vertices that 16-bit indices can address. The index 0xFFFF
+// is reserved for primitive restart (GL_PRIMITIVE_RESTART_FIXED_INDEX).
+constexpr int kMaxNumVerticesForShortIndices = 0xFFFF;
+
+// Index that restarts a primitive when GL_PRIMITIVE_RESTART_FIXED_INDEX is
+// enabled. Narrowing it to 16 bits gives the 16-bit restart index, 0xFFFF.
+constexpr GLuint kPrimitiveRestartIndex = 0xFFFFFFFF;
+
+// Returns the size in bytes of an index of the given type.
+// Vertex positions padded to 4 floats, with w = 1, so that bulk transform code
+// loads and multiplies each position as an aligned vector.
+typedef std::vector<Eigen::Vector4f, Eigen::aligned_allocator<Eigen::Vector4f> >
+    VertexPositions;
+
+inline GLsizei IndexSize(const GLenum index_type) {
+  return index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+// Class that will help us keep the state of any model more easily.
+// The model stores its vertices in a single interleaved stream of bytes, which
+// is described by a VertexLayout. This is the same stream that is copied into
+// the vertex buffer object, and the same layout configures the attribute
+// pointers, so adding an attribute to a vertex type does not require touching
+// the buffer setup.
+//
+// Example:
+//
+// std::vector<wvu::StandardVertex> vertices = ...;
+// std::vector<GLuint> indices = ...;
+// wvu::Model model(Eigen::Vector3f(0, 0, 0),  // Orientation of object.
+//                  Eigen::Vector3f(0, 0, 0),  // Position of object.
+//                  vertices, indices);
+//
+// The cached model matrix is aligned for vectorization, so containers of
+// models must use an aligned allocator, e.g., wvu::Models.
+class Model {
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  Model() : orientation_(Eigen::Vector3f::Zero()),
+            position_(Eigen::Vector3f::Zero()),
+            num_vertices_(0),
+            num_indices_(0),
+            primitive_type_(GL_TRIANGLES),
+            closed_(false),
+            dirty_vertices_begin_(0),
+            dirty_vertices_end_(0),
+            model_matrix_dirty_(true) {}
+
+  // Constructor.
+  // Params
+  //  orientation  Axis of rotation whose norm is the angle
+  //     (aka Rodrigues vector).
+  //  position  The position of the object in the world.
+  //  vertices  The vertices forming the object. The vertex type must provide
+  //     its layout through a static Layout() function (see vertex_format.h).
+  template <typename VertexType>
+  Model(const Eigen::Vector3f& orientation,
+        const Eigen::Vector3f& position,
+        const std::vector<VertexType>& vertices)
+      : orientation_(orientation), position_(position), num_vertices_(0),
+        num_indices_(0), primitive_type_(GL_TRIANGLES), closed_(false),
+        dirty_vertices_begin_(0), dirty_vertices_end_(0),
+        model_matrix_dirty_(true) {
+    SetVertices(vertices);
+  }
+
+  // Constructor.
+  // Params
+  //  orientation  Axis of rotation whose norm is the angle
+  //     (aka Rodrigues vector).
+  //  position  The position of the object in the world.
+  //  vertices  The vertices forming the object.
+  //  indices  Indices for EBO. The indices are taken by value, so passing an
+  //     rvalue (e.g., std::move(indices)) moves them into the model instead of
+  //     copying them.
+  template <typename VertexType>
+  Model(const Eigen::Vector3f& orientation,
+        const Eigen::Vector3f& position,
+        const std::vector<VertexType>& vertices,
+        std::vector<GLuint> indices)
+      : orientation_(orientation), position_(position), num_vertices_(0),
+        indices_(std::move(indices)), num_indices_(indices_.size()),
+        primitive_type_(GL_TRIANGLES), closed_(false),
+        dirty_vertices_begin_(0), dirty_vertices_end_(0),
+        model_matrix_dirty_(true) {
+    SetVertices(vertices);
+  }
+
+  // Constructor that takes ownership of an interleaved vertex stream. Neither
+  // the vertices nor the indices are copied when passed as rvalues, which
+  // keeps the peak memory of loading large meshes to a single copy. Loaders
+  // should produce the vertex stream directly and use this constructor.
+  // Params
+  //  orientation  Axis of rotation whose norm is the angle
+  //     (aka Rodrigues vector).
+  //  position  The position of the object in the world.
+  //  vertex_layout  The layout of the vertices.
+  //  vertex_data  The interleaved vertices. Its size must be a multiple of the
+  //     stride of the layout.
+  //  indices  Indices for EBO.
+  Model(const Eigen::Vector3f& orientation,
+        const Eigen::Vector3f& position,
+        const VertexLayout& vertex_layout,
+        std::vector<GLubyte> vertex_data,
+        std::vector<GLuint> indices);
+
+  // Models own potentially large buffers. Moving a model transfers them, while
+  // copying a model duplicates them.
+  Model(const Model& model) = default;
+  Model(Model&& model) = default;
+  Model& operator=(const Model& model) = default;
+  Model& operator=(Model&& model) = default;
+
+  // Default destructor.
+  ~Model() {}
+
+  // Setters set members by *copying* input parameters. Changing the
+  // orientation or the position invalidates the model matrix.
+  void SetOrientation(const Eigen::Vector3f& orientation) {
+    orientation_ = orientation;
+    model_matrix_dirty_ = true;
+  }
+
+  void SetPosition(const Eigen::Vector3f& position);
+
+  // Replaces the vertices of the model with the given typed vertices.
+  template <typename VertexType>
+  void SetVertices(const std::vector<VertexType>& vertices) {
+    SetVertexData(VertexType::Layout(), vertices.data(), vertices.size());
+  }
+
+  // Replaces the vertices of the model with num_vertices interleaved vertices
+  // described by layout. The data is copied. The new vertices are not dirty,
+  // since a GpuMesh of a different number of vertices uploads all of them.
+  void SetVertexData(const VertexLayout& layout,
+                     const void* data,
+                     const int num_vertices);
+
+  // Replaces the vertices of the model with an interleaved vertex stream
+  // described by layout. The stream is moved when passed as an rvalue.
+  void SetVertexData(const VertexLayout& layout,
+                     std::vector<GLubyte> vertex_data);
+
+  // Overwrites the vertices [first_vertex, first_vertex + vertices.size())
+  // with typed vertices of the layout of the model, and marks them dirty.
+  // Returns false if the layout differs or the range is outside the vertices.
+  template <typename VertexType>
+  bool UpdateVertices(const int first_vertex,
+                      const std::vector<VertexType>& vertices) {
+    if (vertex_layout_ != VertexType::Layout()) return false;
+    return UpdateVertices(first_vertex, vertices.size(), vertices.data());
+  }
+
+  // Overwrites num_vertices interleaved vertices starting at first_vertex, and
+  // marks them dirty, so that GpuMesh::UpdateVertices() uploads only the dirty
+  // range instead of all the vertices. The CPU data must not be released.
+  // Returns false if the range is outside the vertices.
+  bool UpdateVertices(const int first_vertex,
+                      const int num_vertices,
+                      const void* data);
+
+  // Marks the vertices [first_vertex, first_vertex + num_vertices) dirty after
+  // writing them in place through mutable_vertex_data(). The dirty range is
+  // the smallest range covering all the marked vertices.
+  void MarkVerticesDirty(const int first_vertex, const int num_vertices);
+
+  // Clears the dirty range, once uploaded.
+  void ClearDirtyVertices() {
+    dirty_vertices_begin_ = 0;
+    dirty_vertices_end_ = 0;
+  }
+
+  // Returns the range [begin, end) of the vertices changed since the last
+  // ClearDirtyVertices(). It is empty if begin == end.
+  int dirty_vertices_begin() const {
+    return dirty_vertices_begin_;
+  }
+
+  int dirty_vertices_end() const {
+    return dirty_vertices_end_;
+  }
+
+  // Replaces the indices of the model. The indices are moved when passed as an
+  // rvalue.
+  // Params
+  //  indices  Indices for EBO.
+  //  primitive_type  The primitive the indices describe: GL_TRIANGLES or
+  //     GL_TRIANGLE_STRIP. Strips are separated by kPrimitiveRestartIndex.
+  void SetIndices(std::vector<GLuint> indices,
+                  const GLenum primitive_type = GL_TRIANGLES);
+
+  // Frees the CPU-side copies of the vertices and indices, e.g., once they have
+  // been uploaded into the GPU. The layout and the number of vertices and
+  // indices are kept, so the model can still be drawn.
+  void ReleaseCpuData();
+
+  // If we want to avoid copying, we can return a pointer to
+  // the member. Note that making public the attributes work
+  // if we want to modify directly the members. However, this
+  // is a matter of design. Since the caller may modify the member through
+  // the pointer, the model matrix is invalidated.
+  Eigen::Vector3f* mutable_orientation() {
+    model_matrix_dirty_ = true;
+    return &orientation_;
+  }
+
+  Eigen::Vector3f* mutable_position() {
+    model_matrix_dirty_ = true;
+    return &position_;
+  }
+
+  // Getters, return a const reference to the member.
+  const Eigen::Vector3f& GetOrientation() {
+    return orientation_;
+  }
+
+  const Eigen::Vector3f& GetPosition() {
+    return position_;
+  }
+
+  const Eigen::Vector3f& orientation() const {
+    return orientation_;
+  }
+
+  const Eigen::Vector3f& position() const {
+    return position_;
+  }
+
+  // Returns the matrix transforming the model into the world: the rotation of
+  // the orientation followed by the translation of the position. The matrix is
+  // cached, and only recomputed after the orientation or the position change.
+  const Eigen::Matrix4f& model_matrix() const;
+
+  // Returns the vertices as an array of VertexType, or nullptr if the layout of
+  // the model is not the layout of VertexType.
+  template <typename VertexType>
+  const VertexType* vertices() const {
+    if (vertex_layout_ != VertexType::Layout()) return nullptr;
+    return reinterpret_cast<const VertexType*>(vertex_data_.data());
+  }
+
+  // Returns the position of the i-th vertex. The position attribute must be
+  // stored in floats.
+  Eigen::Vector3f VertexPosition(const int i) const;
+
+  // Copies the positions of all the vertices into an aligned array, reusing
+  // its storage. The position attribute must be stored in floats.
+  void GetVertexPositions(VertexPositions* positions) const;
+
+  // Returns the interleaved vertex stream.
+  const std::vector<GLubyte>& vertex_data() const {
+    return vertex_data_;
+  }
+
+  // Returns the interleaved vertex stream to write the vertices in place. The
+  // caller marks the written vertices with MarkVerticesDirty().
+  GLubyte* mutable_vertex_data() {
+    return vertex_data_.data();
+  }
+
+  const VertexLayout& vertex_layout() const {
+    return vertex_layout_;
+  }
+
+  int num_vertices() const {
+    return num_vertices_;
+  }
+
+  const std::vector<GLuint>& indices() const {
+    return indices_;
+  }
+
+  // Returns the number of indices of the model. Unlike indices().size(), this
+  // remains valid after ReleaseCpuData().
+  int num_indices() const {
+    return num_indices_;
+  }
+
+  // Returns the smallest index type able to address the vertices of the model:
+  // GL_UNSIGNED_SHORT when there are at most kMaxNumVerticesForShortIndices
+  // vertices, and GL_UNSIGNED_INT otherwise. Element buffers and draw calls of
+  // the model must use this type.
+  GLenum index_type() const {
+    return num_vertices_ <= kMaxNumVerticesForShortIndices ?
+        GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  }
+
+  // Returns the primitive drawn with the indices.
+  GLenum primitive_type() const {
+    return primitive_type_;
+  }
+
+  // Returns true if the triangles enclose a volume, with a consistent winding
+  // facing outwards, so that their back faces are never visible from outside
+  // and can be culled. Set by OrientTriangles() (see mesh_orientation.h).
+  // SetIndices() keeps the flag, since the levels of detail and the optimizers
+  // reorder or collapse the triangles without opening the surface; a caller
+  // replacing the surface clears it.
+  bool closed() const {
+    return closed_;
+  }
+
+  void set_closed(const bool closed) {
+    closed_ = closed;
+  }
+
+  // Returns true if ReleaseCpuData() freed the vertices and indices.
+  bool cpu_data_released() const {
+    return num_vertices_ > 0 && vertex_data_.empty();
+  }
+
+private:
+  // Attributes.
+  // The convention we will use is to define a '_' after the name
+  // of the attribute.
+  Eigen::Vector3f orientation_;
+  Eigen::Vector3f position_;
+  VertexLayout vertex_layout_;
+  std::vector<GLubyte> vertex_data_;
+  int num_vertices_;
+  std::vector<GLuint> indices_;
+  int num_indices_;
+  GLenum primitive_type_;
+  bool closed_;
+  // The vertices changed since the last upload, [begin, end).
+  int dirty_vertices_begin_;
+  int dirty_vertices_end_;
+  // Cache of model_matrix().
+  mutable Eigen::Matrix4f model_matrix_;
+  mutable bool model_matrix_dirty_;
+};
+
+// Contiguous array of models. Eigen requires an aligned allocator for the
+// aligned model matrix.
+typedef std::vector<Model, Eigen::aligned_allocator<Model> > Models;
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MODEL_H_
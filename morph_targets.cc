@@ -0,0 +1,352 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "morph_targets.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "gpu_mesh.h"
+#include "model.h"
+#include "shader_program.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+// Size of the work groups of the blending shader.
+constexpr int kBlendingGroupSize = 64;
+
+// A record of the delta buffer, in the std430 layout of MorphDelta: the offset
+// of a vertex, or its rest pose for the records restoring it.
+struct MorphRecord {
+  GLfloat position[3];
+  GLuint vertex;
+  GLfloat normal[3];
+  GLfloat padding;
+};
+static_assert(sizeof(MorphRecord) == 32,
+              "The blending shader reads MorphRecord as 32 bytes.");
+
+// Writes the records of a dispatch into the vertices, read as an array of
+// floats. With accumulate, the records are offsets scaled by the weight;
+// otherwise they overwrite the vertices.
+const char kBlendingShader[] =
+    "#version 430\n"
+    "layout (local_size_x = 64) in;\n"
+    "struct MorphDelta {\n"
+    "  vec3 position;\n"
+    "  uint vertex;\n"
+    "  vec3 normal;\n"
+    "  float padding;\n"
+    "};\n"
+    "layout (std430, binding = 0) readonly buffer Deltas {\n"
+    "  MorphDelta deltas[];\n"
+    "};\n"
+    "layout (std430, binding = 1) buffer Vertices {\n"
+    "  float vertices[];\n"
+    "};\n"
+    "uniform int first_delta;\n"
+    "uniform int num_deltas;\n"
+    "uniform float weight;\n"
+    "uniform bool accumulate;\n"
+    "uniform int stride;\n"
+    "uniform int position_offset;\n"
+    "uniform int normal_offset;\n"
+    "void Write(int offset, vec3 value) {\n"
+    "  if (accumulate) {\n"
+    "    value += vec3(vertices[offset], vertices[offset + 1],\n"
+    "                  vertices[offset + 2]);\n"
+    "  }\n"
+    "  vertices[offset] = value.x;\n"
+    "  vertices[offset + 1] = value.y;\n"
+    "  vertices[offset + 2] = value.z;\n"
+    "}\n"
+    "void main() {\n"
+    "  int i = int(gl_GlobalInvocationID.x);\n"
+    "  if (i >= num_deltas) return;\n"
+    "  MorphDelta delta = deltas[first_delta + i];\n"
+    "  int vertex = int(delta.vertex) * stride;\n"
+    "  Write(vertex + position_offset, weight * delta.position);\n"
+    "  if (normal_offset >= 0) {\n"
+    "    Write(vertex + normal_offset, weight * delta.normal);\n"
+    "  }\n"
+    "}\n";
+
+// Returns the float attribute of a vertex with 3 components, or zero if the
+// layout does not have one with the semantic.
+Eigen::Vector3f ReadVector(const Model& model,
+                           const VertexSemantic semantic,
+                           const int i) {
+  Eigen::Vector3f vector = Eigen::Vector3f::Zero();
+  const VertexAttribute* attribute =
+      model.vertex_layout().FindAttribute(semantic);
+  if (attribute == nullptr || attribute->type != GL_FLOAT ||
+      attribute->num_components != 3) {
+    return vector;
+  }
+  std::memcpy(vector.data(),
+              model.vertex_data().data() +
+                  i * model.vertex_layout().stride() + attribute->offset,
+              sizeof(vector));
+  return vector;
+}
+
+// Returns the offset in floats of a float attribute with 3 components, or -1
+// if the layout does not have one with the semantic.
+int FloatOffset(const VertexLayout& layout, const VertexSemantic semantic) {
+  const VertexAttribute* attribute = layout.FindAttribute(semantic);
+  if (attribute == nullptr || attribute->type != GL_FLOAT ||
+      attribute->num_components != 3 ||
+      attribute->offset % sizeof(GLfloat) != 0) {
+    return -1;
+  }
+  return attribute->offset / sizeof(GLfloat);
+}
+
+}  // namespace
+
+MorphTarget ExtractMorphTarget(const Model& model,
+                               const Model& shape,
+                               const float tolerance) {
+  MorphTarget target;
+  const int num_vertices = std::min(model.num_vertices(), shape.num_vertices());
+  for (int i = 0; i < num_vertices; ++i) {
+    const Eigen::Vector3f position_delta =
+        shape.VertexPosition(i) - model.VertexPosition(i);
+    const Eigen::Vector3f normal_delta =
+        ReadVector(shape, NORMAL, i) - ReadVector(model, NORMAL, i);
+    if (position_delta.norm() <= tolerance &&
+        normal_delta.norm() <= tolerance) {
+      continue;
+    }
+    target.vertices.push_back(i);
+    target.position_deltas.push_back(position_delta);
+    target.normal_deltas.push_back(normal_delta);
+  }
+  return target;
+}
+
+MorphedMesh::MorphedMesh()
+    : delta_buffer_id_(0),
+      num_moved_vertices_(0),
+      dirty_(false),
+      stride_(0),
+      position_offset_(0),
+      normal_offset_(-1) {}
+
+MorphedMesh::~MorphedMesh() {
+  Reset();
+}
+
+bool MorphedMesh::Supported() {
+  return (GLEW_VERSION_4_3 || GLEW_ARB_compute_shader) &&
+      (GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object);
+}
+
+bool MorphedMesh::Initialize(const Model& model,
+                             const std::vector<MorphTarget>& targets,
+                             std::string* error_info_log) {
+  if (mesh_.valid()) {
+    *error_info_log = "The morphed mesh is already initialized.";
+    return false;
+  }
+  if (!Supported()) {
+    *error_info_log = "Morph targets in compute shaders need OpenGL 4.3.";
+    return false;
+  }
+  const VertexLayout& layout = model.vertex_layout();
+  position_offset_ = FloatOffset(layout, POSITION);
+  normal_offset_ = FloatOffset(layout, NORMAL);
+  stride_ = layout.stride() / sizeof(GLfloat);
+  if (model.cpu_data_released() || position_offset_ < 0 ||
+      layout.stride() % sizeof(GLfloat) != 0) {
+    *error_info_log =
+        "The model must keep its vertices, with float positions.";
+    return false;
+  }
+
+  // The rest pose of the vertices moved by any target comes first, so that
+  // Blend() restores them before adding the deltas.
+  const int num_vertices = model.num_vertices();
+  std::vector<int> last_target(num_vertices, -1);
+  std::vector<MorphRecord> records;
+  std::vector<MorphRecord> deltas;
+  for (int t = 0; t < targets.size(); ++t) {
+    const MorphTarget& target = targets[t];
+    const int num_deltas = target.vertices.size();
+    if (target.position_deltas.size() != num_deltas ||
+        (!target.normal_deltas.empty() &&
+         target.normal_deltas.size() != num_deltas)) {
+      *error_info_log = "A morph target has a delta per vertex.";
+      Reset();
+      return false;
+    }
+    target_ranges_.emplace_back(deltas.size(), num_deltas);
+    for (int i = 0; i < num_deltas; ++i) {
+      const int vertex = target.vertices[i];
+      // The records of a dispatch must write different vertices.
+      if (vertex < 0 || vertex >= num_vertices || last_target[vertex] == t) {
+        *error_info_log = "A morph target moves a vertex twice or none.";
+        Reset();
+        return false;
+      }
+      if (last_target[vertex] < 0) {
+        MorphRecord rest_pose = MorphRecord();
+        const Eigen::Vector3f position = model.VertexPosition(vertex);
+        const Eigen::Vector3f normal = ReadVector(model, NORMAL, vertex);
+        std::copy(position.data(), position.data() + 3, rest_pose.position);
+        std::copy(normal.data(), normal.data() + 3, rest_pose.normal);
+        rest_pose.vertex = vertex;
+        records.push_back(rest_pose);
+      }
+      last_target[vertex] = t;
+      MorphRecord delta = MorphRecord();
+      std::copy(target.position_deltas[i].data(),
+                target.position_deltas[i].data() + 3, delta.position);
+      if (!target.normal_deltas.empty()) {
+        std::copy(target.normal_deltas[i].data(),
+                  target.normal_deltas[i].data() + 3, delta.normal);
+      }
+      delta.vertex = vertex;
+      deltas.push_back(delta);
+    }
+  }
+  num_moved_vertices_ = records.size();
+  for (std::pair<int, int>& range : target_ranges_) {
+    range.first += num_moved_vertices_;
+  }
+  records.insert(records.end(), deltas.begin(), deltas.end());
+  weights_.assign(targets.size(), 0.0f);
+  dirty_ = false;
+
+  blending_program_.LoadComputeShaderFromString(kBlendingShader);
+  if (!blending_program_.Create(error_info_log)) {
+    Reset();
+    return false;
+  }
+  // A single copy: the shader writes it after the draws of the previous
+  // frame in the order of the commands, without waiting on the CPU.
+  mesh_ = SetDynamicVertexArrayObject(model, 1);
+
+  BufferAllocator* allocator = BufferAllocator::Get();
+  delta_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, delta_buffer_id_);
+  allocator->BufferData(delta_buffer_id_, GL_SHADER_STORAGE_BUFFER,
+                        records.size() * sizeof(MorphRecord), records.data(),
+                        GL_STATIC_DRAW);
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  if (delta_buffer_id_ == 0 || !mesh_.valid()) {
+    *error_info_log = "Could not create the morph target buffers.";
+    Reset();
+    return false;
+  }
+  return true;
+}
+
+void MorphedMesh::SetWeight(const int target, const float weight) {
+  if (weights_[target] == weight) return;
+  weights_[target] = weight;
+  dirty_ = true;
+}
+
+void MorphedMesh::Blend() {
+  statistics_ = MorphStatistics();
+  if (!mesh_.valid() || !dirty_ || num_moved_vertices_ == 0) return;
+  dirty_ = false;
+  std::vector<int> active_targets;
+  for (int t = 0; t < num_targets(); ++t) {
+    if (weights_[t] != 0.0f && target_ranges_[t].second > 0) {
+      active_targets.push_back(t);
+    }
+  }
+
+  GlStateCache* gl_state = GlStateCache::Current();
+  blending_program_.Use();
+  blending_program_.SetUniform("stride", static_cast<GLint>(stride_));
+  blending_program_.SetUniform("position_offset",
+                               static_cast<GLint>(position_offset_));
+  blending_program_.SetUniform("normal_offset",
+                               static_cast<GLint>(normal_offset_));
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, delta_buffer_id_);
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1,
+                           mesh_.vertex_buffer_object_id());
+  // Every dispatch reads the vertices written by the previous one, and the
+  // draws read the last.
+  const auto dispatch = [&](const int first_delta,
+                            const int num_deltas,
+                            const float weight,
+                            const bool accumulate,
+                            const bool last) {
+    blending_program_.SetUniform("first_delta",
+                                 static_cast<GLint>(first_delta));
+    blending_program_.SetUniform("num_deltas", static_cast<GLint>(num_deltas));
+    blending_program_.SetUniform("weight", weight);
+    blending_program_.SetUniform("accumulate",
+                                 static_cast<GLint>(accumulate));
+    blending_program_.Dispatch(
+        (num_deltas + kBlendingGroupSize - 1) / kBlendingGroupSize, 1, 1,
+        last ? GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT :
+               GL_SHADER_STORAGE_BARRIER_BIT);
+    statistics_.num_blended_vertices += num_deltas;
+    ++statistics_.num_dispatches;
+  };
+  dispatch(0, num_moved_vertices_, 1.0f, false, active_targets.empty());
+  for (int i = 0; i < active_targets.size(); ++i) {
+    const std::pair<int, int>& range = target_ranges_[active_targets[i]];
+    dispatch(range.first, range.second, weights_[active_targets[i]], true,
+             i + 1 == active_targets.size());
+  }
+  statistics_.num_active_targets = active_targets.size();
+}
+
+void MorphedMesh::Reset() {
+  BufferAllocator::Get()->DeleteBuffer(&delta_buffer_id_);
+  mesh_.Reset();
+  num_moved_vertices_ = 0;
+  target_ranges_.clear();
+  weights_.clear();
+  dirty_ = false;
+  statistics_ = MorphStatistics();
+}
+
+}  // namespace wvu
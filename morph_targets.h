@@ -0,0 +1,171 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_MORPH_TARGETS_H_
+#define GLUTILS_MORPH_TARGETS_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "gpu_mesh.h"
+#include "model.h"
+#include "shader_program.h"
+
+namespace wvu {
+// A blend shape of a mesh, e.g., a facial expression, stored sparsely: the
+// offsets of the vertices it moves only.
+struct MorphTarget {
+  // The indices of the vertices moved.
+  std::vector<int> vertices;
+  // The offsets of their positions.
+  std::vector<Eigen::Vector3f> position_deltas;
+  // The offsets of their normals, or empty if the target does not bend them.
+  std::vector<Eigen::Vector3f> normal_deltas;
+};
+
+// Returns the morph target from the vertices of a model to those of a shape
+// with the same vertices, e.g., exported as a whole mesh: the vertices whose
+// position or normal moved by more than the tolerance.
+MorphTarget ExtractMorphTarget(const Model& model,
+                               const Model& shape,
+                               const float tolerance);
+
+struct MorphStatistics {
+  // The targets with a nonzero weight in the last Blend().
+  int num_active_targets = 0;
+  // The vertices restored and offset by the last Blend().
+  int num_blended_vertices = 0;
+  int num_dispatches = 0;
+};
+
+// This class blends the morph targets of a mesh on the GPU into a mesh of its
+// own, which is drawn like any other GpuMesh. The deltas of all the targets
+// live in one shader storage buffer, target after target, so the CPU neither
+// blends the vertices nor uploads them every frame. Blend() first restores
+// the rest pose of the vertices that any target moves, and then adds the
+// deltas of every target with a nonzero weight, one compute dispatch per
+// target, so the inactive targets cost nothing and the active ones touch
+// only the vertices they move. The weights that did not change since the last
+// Blend() dispatch nothing.
+//
+// The normals are blended as offsets too, so the vertex shaders normalize
+// them. It needs compute shaders and shader storage buffers (see
+// Supported()).
+//
+// Example:
+//
+// std::vector<wvu::MorphTarget> targets;
+// targets.push_back(wvu::ExtractMorphTarget(face, smile, 1e-5f));
+// targets.push_back(wvu::ExtractMorphTarget(face, blink, 1e-5f));
+// wvu::MorphedMesh morphed_face;
+// morphed_face.Initialize(face, targets, &error_info_log);
+// while (...) {  // Rendering loop.
+//   morphed_face.SetWeight(0, smile_weight);
+//   morphed_face.SetWeight(1, blink_weight);
+//   morphed_face.Blend();
+//   shader_program.Use();
+//   wvu::Draw(morphed_face.mesh());
+// }
+class MorphedMesh {
+ public:
+  MorphedMesh();
+  ~MorphedMesh();
+
+  // Uploads the vertices of the model, which must keep its CPU data and have
+  // float positions, and the deltas of the targets, and compiles the program.
+  // The targets start with a zero weight. Returns true if successful.
+  bool Initialize(const Model& model,
+                  const std::vector<MorphTarget>& targets,
+                  std::string* error_info_log);
+
+  // Sets the weight of a target for the next Blend().
+  void SetWeight(const int target, const float weight);
+
+  // Blends the targets with their weights into the mesh. The vertex reads of
+  // the next draws wait for the writes.
+  void Blend();
+
+  // Deletes the buffers and the blended mesh.
+  void Reset();
+
+  // Returns true if compute shaders and shader storage buffers are supported.
+  static bool Supported();
+
+  // Returns the blended mesh.
+  const GpuMesh& mesh() const {
+    return mesh_;
+  }
+
+  int num_targets() const {
+    return target_ranges_.size();
+  }
+
+  float weight(const int target) const {
+    return weights_[target];
+  }
+
+  const MorphStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  ShaderProgram blending_program_;
+  // The records of the rest pose of the moved vertices, followed by the
+  // deltas of every target.
+  GLuint delta_buffer_id_;
+  int num_moved_vertices_;
+  // The first record and the number of records of every target.
+  std::vector<std::pair<int, int> > target_ranges_;
+  std::vector<float> weights_;
+  // Whether the weights changed since the last Blend().
+  bool dirty_;
+  // The stride and the offsets of the position and the normal of a vertex, in
+  // floats. The normal offset is -1 without normals.
+  int stride_;
+  int position_offset_;
+  int normal_offset_;
+  GpuMesh mesh_;
+  MorphStatistics statistics_;
+
+  MorphedMesh(const MorphedMesh&) = delete;
+  MorphedMesh& operator=(const MorphedMesh&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MORPH_TARGETS_H_
@@ -0,0 +1,187 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "multi_view.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Bytes of a mat4 in the std140 layout.
+constexpr GLsizeiptr kMatrixSize = 16 * sizeof(GLfloat);
+
+// Bytes of the block of the single pass: the matrices of all the views and
+// their number, padded to a vec4.
+constexpr GLsizeiptr kSinglePassBlockSize = kMaxNumViews * kMatrixSize + 16;
+
+}  // namespace
+
+const char MultiViewUniforms::kBlockName[] = "MultiViewUniforms";
+
+MultiViewUniforms::MultiViewUniforms()
+    : buffer_id_(0), single_pass_(false), section_size_(0), num_views_(0) {}
+
+MultiViewUniforms::~MultiViewUniforms() {
+  BufferAllocator::Get()->DeleteBuffer(&buffer_id_);
+}
+
+bool MultiViewUniforms::SinglePassSupported() {
+  return (GLEW_VERSION_4_1 || GLEW_ARB_viewport_array) &&
+      (GLEW_ARB_shader_viewport_layer_array ||
+       GLEW_AMD_vertex_shader_viewport_index);
+}
+
+bool MultiViewUniforms::Initialize() {
+  if (buffer_id_ != 0) return true;
+  single_pass_ = SinglePassSupported();
+  GLsizeiptr size = kSinglePassBlockSize;
+  if (!single_pass_) {
+    // Each view has its own section, bound as the block in its pass. The
+    // sections start at multiples of the driver alignment.
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = std::max(alignment, 1);
+    section_size_ = (kMatrixSize + alignment - 1) / alignment * alignment;
+    size = section_size_ * kMaxNumViews;
+  }
+  data_.assign(size, 0);
+  GlStateCache* gl_state = GlStateCache::Current();
+  BufferAllocator* allocator = BufferAllocator::Get();
+  buffer_id_ = allocator->CreateBuffer(UNIFORM_DATA);
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, buffer_id_);
+  allocator->BufferData(buffer_id_, GL_UNIFORM_BUFFER, size, data_.data(),
+                        GL_DYNAMIC_DRAW);
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, 0);
+  return buffer_id_ != 0;
+}
+
+bool MultiViewUniforms::Attach(ShaderProgram* shader_program) const {
+  return shader_program->BindUniformBlock(kBlockName, kMultiViewBindingPoint);
+}
+
+bool MultiViewUniforms::Update(const Eigen::Matrix4f* views,
+                               const Eigen::Matrix4f* projections,
+                               const Viewport* viewports,
+                               const int num_views) {
+  if (buffer_id_ == 0 || num_views <= 0 || num_views > kMaxNumViews) {
+    return false;
+  }
+  num_views_ = num_views;
+  viewports_.assign(viewports, viewports + num_views);
+  const GLsizeiptr stride = single_pass_ ? kMatrixSize : section_size_;
+  for (int i = 0; i < num_views; ++i) {
+    const Eigen::Matrix4f view_projection = projections[i] * views[i];
+    std::memcpy(data_.data() + i * stride, view_projection.data(),
+                kMatrixSize);
+  }
+  GLsizeiptr size = num_views * stride;
+  if (single_pass_) {
+    const GLint count = num_views;
+    std::memcpy(data_.data() + kMaxNumViews * kMatrixSize, &count,
+                sizeof(count));
+    size = kSinglePassBlockSize;
+  }
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, buffer_id_);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data_.data());
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, 0);
+  return true;
+}
+
+void MultiViewUniforms::Render(
+    const std::function<void(int num_instances)>& draw) const {
+  if (num_views_ == 0) return;
+  GlStateCache* gl_state = GlStateCache::Current();
+  if (single_pass_) {
+    gl_state->BindBufferBase(GL_UNIFORM_BUFFER, kMultiViewBindingPoint,
+                             buffer_id_);
+    // glViewport() resets every viewport of the array, so they are set on
+    // each pass. Each primitive picks its own.
+    static_assert(sizeof(Viewport) == 4 * sizeof(GLfloat),
+                  "Viewport must be an array of 4 floats.");
+    glViewportArrayv(0, num_views_, &viewports_[0].x);
+    draw(num_views_);
+    return;
+  }
+  for (int i = 0; i < num_views_; ++i) {
+    const Viewport& viewport = viewports_[i];
+    glViewport(viewport.x, viewport.y, viewport.width, viewport.height);
+    gl_state->BindBufferRange(GL_UNIFORM_BUFFER, kMultiViewBindingPoint,
+                              buffer_id_, i * section_size_, kMatrixSize);
+    draw(1);
+  }
+}
+
+std::string MultiViewUniforms::GlslDeclaration() {
+  if (!SinglePassSupported()) {
+    return std::string("layout (std140) uniform ") + kBlockName + " {\n"
+        "  mat4 multi_view_projection;\n"
+        "};\n"
+        "mat4 MultiViewProjection() {\n"
+        "  return multi_view_projection;\n"
+        "}\n"
+        "int MultiViewInstanceID() {\n"
+        "  return gl_InstanceID;\n"
+        "}\n";
+  }
+  const std::string extension = GLEW_ARB_shader_viewport_layer_array ?
+      "GL_ARB_shader_viewport_layer_array" :
+      "GL_AMD_vertex_shader_viewport_index";
+  return "#extension " + extension + " : require\n"
+      "layout (std140) uniform " + kBlockName + " {\n"
+      "  mat4 multi_view_projections[" + std::to_string(kMaxNumViews) +
+      "];\n"
+      "  int multi_view_count;\n"
+      "};\n"
+      "mat4 MultiViewProjection() {\n"
+      "  int view = gl_InstanceID % multi_view_count;\n"
+      "  gl_ViewportIndex = view;\n"
+      "  return multi_view_projections[view];\n"
+      "}\n"
+      "int MultiViewInstanceID() {\n"
+      "  return gl_InstanceID / multi_view_count;\n"
+      "}\n";
+}
+
+}  // namespace wvu
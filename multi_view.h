@@ -0,0 +1,159 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_MULTI_VIEW_H_
+#define GLUTILS_MULTI_VIEW_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "shader_program.h"
+
+namespace wvu {
+// Uniform buffer binding point reserved for the multi-view uniforms.
+constexpr GLuint kMultiViewBindingPoint = 2;
+
+// Maximum number of views, the smallest GL_MAX_VIEWPORTS that OpenGL 4.1
+// guarantees.
+constexpr int kMaxNumViews = 16;
+
+// A viewport of the framebuffer, in pixels.
+struct Viewport {
+  GLfloat x = 0.0f;
+  GLfloat y = 0.0f;
+  GLfloat width = 0.0f;
+  GLfloat height = 0.0f;
+};
+
+// This class renders a draw list into several viewports, e.g., the panes of a
+// split view, traversing the list once. The view-projection matrices of all
+// the views are uploaded into a uniform buffer, and every draw is instanced
+// once per view: the vertex shader takes the view of the instance, and routes
+// the primitive to its viewport through gl_ViewportIndex. This single pass
+// needs ARB_viewport_array (OpenGL 4.1) and writing gl_ViewportIndex from the
+// vertex shader (ARB_shader_viewport_layer_array or
+// AMD_vertex_shader_viewport_index). Otherwise Render() falls back to one
+// pass per view, with the matrix of the view bound as the block.
+//
+// The vertex shaders of the draws include GlslDeclaration() right after their
+// #version line, which declares the block and two functions:
+//
+//   // Returns the view-projection matrix of the vertex, and routes it to the
+//   // viewport of its view.
+//   mat4 MultiViewProjection();
+//   // Returns the instance id of the draw, without the views.
+//   int MultiViewInstanceID();
+//
+// Example:
+//
+// wvu::MultiViewUniforms multi_view;
+// multi_view.Initialize();
+// shader_program.LoadVertexShaderFromString(
+//     "#version 330 core\n" + wvu::MultiViewUniforms::GlslDeclaration() +
+//     ...);
+// multi_view.Attach(&shader_program);
+// while (...) {  // Rendering loop.
+//   multi_view.Update(views, projections, viewports, num_views);
+//   multi_view.Render([&](const int num_instances) {
+//     render_queue.Execute(num_instances);
+//   });
+// }
+class MultiViewUniforms {
+ public:
+  // Name of the uniform block in the shaders.
+  static const char kBlockName[];
+
+  MultiViewUniforms();
+  ~MultiViewUniforms();
+
+  // Creates the uniform buffer. Returns true if successful.
+  bool Initialize();
+
+  // Binds the block of the program to the buffer. Returns false if the program
+  // does not declare the block.
+  bool Attach(ShaderProgram* shader_program) const;
+
+  // Uploads the matrices and the viewports of the views. Returns false if
+  // there are no views or more than kMaxNumViews.
+  // Parameters:
+  //   views  The num_views view matrices.
+  //   projections  The num_views projection matrices.
+  //   viewports  The num_views viewports.
+  //   num_views  The number of views.
+  bool Update(const Eigen::Matrix4f* views,
+              const Eigen::Matrix4f* projections,
+              const Viewport* viewports,
+              const int num_views);
+
+  // Calls draw to render the draw list into the views. In a single pass, draw
+  // is called once and must draw num_views instances per instance of the
+  // draws, and the viewport array is left set. Otherwise draw is called once
+  // per view with num_instances = 1, and the viewport is left on the last
+  // view. Either way, the caller restores its viewport afterwards.
+  void Render(const std::function<void(int num_instances)>& draw) const;
+
+  // Returns the GLSL declaration of the block and of its functions, for the
+  // path supported by the context.
+  static std::string GlslDeclaration();
+
+  // Returns true if the views are rendered in a single pass.
+  static bool SinglePassSupported();
+
+  GLuint buffer_id() const {
+    return buffer_id_;
+  }
+
+  int num_views() const {
+    return num_views_;
+  }
+
+ private:
+  GLuint buffer_id_;
+  bool single_pass_;
+  // Bytes between the sections of the views in the one pass per view path.
+  GLsizeiptr section_size_;
+  int num_views_;
+  std::vector<Viewport> viewports_;
+  std::vector<GLubyte> data_;
+
+  MultiViewUniforms(const MultiViewUniforms&) = delete;
+  MultiViewUniforms& operator=(const MultiViewUniforms&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MULTI_VIEW_H_
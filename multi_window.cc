@@ -0,0 +1,168 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "multi_window.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "gl_state_cache.h"
+#include "shared_vertex_arrays.h"
+
+namespace wvu {
+
+MultiWindowRenderer::MultiWindowRenderer() : main_window_(nullptr) {}
+
+MultiWindowRenderer::~MultiWindowRenderer() {
+  Reset();
+}
+
+bool MultiWindowRenderer::Initialize(GLFWwindow* main_window,
+                                     const int num_windows,
+                                     const int width,
+                                     const int height,
+                                     const std::string& title,
+                                     std::string* error_info_log) {
+  if (!windows_.empty()) {
+    *error_info_log = "The windows are already initialized.";
+    return false;
+  }
+  if (main_window == nullptr || num_windows <= 0) {
+    *error_info_log = "Invalid main window or number of windows.";
+    return false;
+  }
+  main_window_ = main_window;
+  windows_.resize(num_windows);
+  for (int i = 0; i < num_windows; ++i) {
+    const std::string window_title = title + " " + std::to_string(i + 1);
+    windows_[i].window = glfwCreateWindow(width, height, window_title.c_str(),
+                                          nullptr, main_window);
+    if (windows_[i].window == nullptr) {
+      *error_info_log = "Could not create a shared window.";
+      Reset();
+      return false;
+    }
+    // The swap interval belongs to the context, so it is set while the
+    // context of the window is current.
+    MakeCurrent(windows_[i].window);
+    glfwSwapInterval(0);
+    windows_[i].vertex_arrays.reset(new SharedVertexArrays);
+  }
+  MakeCurrent(main_window_);
+  return true;
+}
+
+void MultiWindowRenderer::MakeCurrent(GLFWwindow* window) {
+  if (glfwGetCurrentContext() == window) return;
+  glfwMakeContextCurrent(window);
+  GlStateCache::Current()->Invalidate();
+  ++statistics_.num_context_switches;
+}
+
+void MultiWindowRenderer::Render(
+    const std::function<void(int, int, int)>& render) {
+  statistics_ = MultiWindowStatistics();
+  const int num_windows = windows_.size();
+  for (int i = 0; i < num_windows; ++i) {
+    Window& window = windows_[i];
+    window.rendered = false;
+    if (!glfwGetWindowAttrib(window.window, GLFW_VISIBLE)) continue;
+    if (glfwWindowShouldClose(window.window)) {
+      glfwHideWindow(window.window);
+      continue;
+    }
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(window.window, &width, &height);
+    // Iconified windows have no framebuffer to draw into.
+    if (width <= 0 || height <= 0) continue;
+    MakeCurrent(window.window);
+    render(i, width, height);
+    // Another context can only wait for a fence once it is flushed.
+    fences_.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    glFlush();
+    window.rendered = true;
+    ++statistics_.num_windows_rendered;
+  }
+  MakeCurrent(main_window_);
+  // The sync objects are shared, so the main context waits for the fences of
+  // the others before its next commands, without blocking the CPU.
+  for (const GLsync fence : fences_) {
+    glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+    glDeleteSync(fence);
+  }
+  fences_.clear();
+}
+
+void MultiWindowRenderer::SwapBuffers() {
+  // GLX swaps the windows without making their contexts current, but
+  // eglSwapBuffers() needs the surface current on the thread, so the builds
+  // with EGL contexts, i.e., the dma-buf export ones, switch for each swap.
+  for (Window& window : windows_) {
+    if (!window.rendered) continue;
+#ifdef GLUTILS_EXPORT_DMA_BUF
+    MakeCurrent(window.window);
+#endif
+    glfwSwapBuffers(window.window);
+    window.rendered = false;
+    ++statistics_.num_swaps;
+  }
+#ifdef GLUTILS_EXPORT_DMA_BUF
+  MakeCurrent(main_window_);
+#endif
+  glfwSwapBuffers(main_window_);
+  ++statistics_.num_swaps;
+}
+
+void MultiWindowRenderer::Reset() {
+  if (windows_.empty()) return;
+  // The vertex arrays are deleted with the context of their window current.
+  for (Window& window : windows_) {
+    if (window.window == nullptr) continue;
+    MakeCurrent(window.window);
+    window.vertex_arrays.reset();
+  }
+  if (main_window_ != nullptr) MakeCurrent(main_window_);
+  for (Window& window : windows_) {
+    if (window.window != nullptr) glfwDestroyWindow(window.window);
+  }
+  windows_.clear();
+}
+
+}  // namespace wvu
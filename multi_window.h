@@ -0,0 +1,181 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_MULTI_WINDOW_H_
+#define GLUTILS_MULTI_WINDOW_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "shared_vertex_arrays.h"
+
+namespace wvu {
+// Counters of the last frame of a MultiWindowRenderer.
+struct MultiWindowStatistics {
+  // The windows rendered by Render(), excluding the main one.
+  int num_windows_rendered = 0;
+  // The calls to glfwMakeContextCurrent() of Render() and SwapBuffers().
+  // The context of the main window is made current once, after the others.
+  int num_context_switches = 0;
+  // The windows swapped by SwapBuffers(), including the main one.
+  int num_swaps = 0;
+};
+
+// This class shows the scene of the main window in additional windows, whose
+// contexts share their objects with the context of the main window, so that
+// the buffers, textures and programs are created and uploaded once for all of
+// them. Vertex array objects are not shared between contexts, so the class
+// keeps a SharedVertexArrays per window, to be handed to the render queue
+// while drawing into that window.
+//
+// The scene is traversed once per frame, e.g., into a RenderQueue, and each
+// additional window only executes the draws with its own camera. Switching
+// the current context flushes the previous one, and is costly in some
+// drivers, so every context is made current once per frame: the main window
+// is drawn first, then Render() visits the other windows in order and makes
+// the context of the main window current again, and SwapBuffers() presents all
+// of them at the end of the frame. Only the swap of the main window waits for
+// the vertical blank: the others swap with an interval of 0, so that a frame
+// waits for one vertical blank instead of one per window.
+//
+// The contexts submit their commands to separate streams, so the fences of
+// the main context do not cover the draws of the other windows. Render() makes
+// the main context wait on the GPU for them, so that the fences inserted after
+// it, e.g., by RingBuffer::EndFrame(), also guard the frame data they read.
+//
+// The GlStateCache of the thread is invalidated whenever the context changes.
+// GLFW creates and destroys windows on the main thread only, so the class is
+// used there.
+//
+// Example:
+//
+// wvu::MultiWindowRenderer windows;
+// windows.Initialize(window, 2, 640, 480, "View", &error_info_log);
+// while (...) {  // Rendering loop.
+//   // Traverse the scene into the queue and draw the main window.
+//   render_queue.Execute();
+//   windows.Render([&](const int index, const int width, const int height) {
+//     glViewport(0, 0, width, height);
+//     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+//     render_queue.set_shared_vertex_arrays(windows.vertex_arrays(index));
+//     render_queue.SetViewProjection(views[index], projection);
+//     render_queue.Execute();
+//   });
+//   ring_buffer.EndFrame();
+//   windows.SwapBuffers();
+// }
+class MultiWindowRenderer {
+ public:
+  MultiWindowRenderer();
+  // Destroys the windows. Must be called on the main thread.
+  ~MultiWindowRenderer();
+
+  // Creates the additional windows with the current window hints, sharing
+  // the objects of the main window, whose context must be current. Must be
+  // called on the main thread. Returns true if successful.
+  // Parameters:
+  //   main_window  The window whose context shares its objects. Not owned.
+  //   num_windows  The number of additional windows.
+  //   width, height  The size of the additional windows.
+  //   title  The title of the additional windows, followed by their index.
+  //   error_info_log  A pointer to a string that holds the error log.
+  bool Initialize(GLFWwindow* main_window,
+                  const int num_windows,
+                  const int width,
+                  const int height,
+                  const std::string& title,
+                  std::string* error_info_log);
+
+  // Draws the additional windows that are open, once the main window is
+  // drawn, calling render(index, width, height) with the context of each one
+  // current and the size of its framebuffer. Windows whose close flag is set
+  // are hidden and skipped from then on. Returns with the context of the main
+  // window current, waiting on the GPU for the draws of the other windows.
+  void Render(const std::function<void(int, int, int)>& render);
+
+  // Swaps the buffers of the windows rendered by Render() and of the main
+  // window, and leaves the context of the main window current.
+  void SwapBuffers();
+
+  // Destroys the additional windows and their vertex arrays.
+  void Reset();
+
+  // Returns the vertex arrays of the context of an additional window, to be
+  // used while it is current. Needs SharedVertexArrays::Supported().
+  SharedVertexArrays* vertex_arrays(const int index) {
+    return windows_[index].vertex_arrays.get();
+  }
+
+  GLFWwindow* window(const int index) const {
+    return windows_[index].window;
+  }
+
+  int num_windows() const {
+    return windows_.size();
+  }
+
+  // Returns the counters of the last frame.
+  const MultiWindowStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  struct Window {
+    GLFWwindow* window = nullptr;
+    std::unique_ptr<SharedVertexArrays> vertex_arrays;
+    // Whether the window was rendered in this frame and awaits its swap.
+    bool rendered = false;
+  };
+
+  // Makes the context of a window current if it is not yet.
+  void MakeCurrent(GLFWwindow* window);
+
+  GLFWwindow* main_window_;
+  std::vector<Window> windows_;
+  // The fences after the draws of the windows rendered in this frame.
+  std::vector<GLsync> fences_;
+  MultiWindowStatistics statistics_;
+
+  MultiWindowRenderer(const MultiWindowRenderer&) = delete;
+  MultiWindowRenderer& operator=(const MultiWindowRenderer&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_MULTI_WINDOW_H_
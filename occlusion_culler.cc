@@ -0,0 +1,320 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "occlusion_culler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define WVU_HAS_SSE
+#endif
+
+#include "assignment.h"
+#include "model.h"
+
+namespace wvu {
+namespace {
+// The smallest w of the vertices rasterized and of the corners of the boxes
+// tested. The clip space vertices nearer than it are behind the camera or
+// too close to it.
+constexpr float kMinClipW = 1e-5f;
+
+// Rounds the size up to a multiple of the tile size.
+int RoundUpToTiles(const int size) {
+  return (std::max(size, 1) + kOcclusionTileSize - 1) /
+      kOcclusionTileSize * kOcclusionTileSize;
+}
+
+// The edge function of the edge from a to b, as A x + B y + C, positive on
+// the left of the edge.
+struct EdgeFunction {
+  EdgeFunction(const Eigen::Vector3f& a, const Eigen::Vector3f& b)
+      : a(a.y() - b.y()), b(b.x() - a.x()),
+        c(a.x() * b.y() - a.y() * b.x()) {}
+  float a, b, c;
+};
+
+}  // namespace
+
+OcclusionCuller::OcclusionCuller(const int width, const int height)
+    : width_(RoundUpToTiles(width)),
+      height_(RoundUpToTiles(height)),
+      num_tiles_x_(width_ / kOcclusionTileSize),
+      depths_(width_ * height_, 1.0f),
+      tile_max_depths_(depths_.size() /
+                       (kOcclusionTileSize * kOcclusionTileSize), 1.0f),
+      tiles_valid_(true),
+      view_projection_(Eigen::Matrix4f::Identity()) {}
+
+void OcclusionCuller::BeginFrame(const Eigen::Matrix4f& view_projection) {
+  view_projection_ = view_projection;
+  std::fill(depths_.begin(), depths_.end(), 1.0f);
+  std::fill(tile_max_depths_.begin(), tile_max_depths_.end(), 1.0f);
+  tiles_valid_ = true;
+  statistics_ = OcclusionStatistics();
+}
+
+void OcclusionCuller::AddOccluder(const VertexPositions& positions,
+                                  const std::vector<GLuint>& indices,
+                                  const Eigen::Matrix4f& model_matrix) {
+  // The vertices are transformed into clip space all at once with the batched
+  // kernels.
+  const int num_vertices = positions.size();
+  model_positions_.resize(num_vertices);
+  for (int i = 0; i < num_vertices; ++i) {
+    model_positions_.x[i] = positions[i].x();
+    model_positions_.y[i] = positions[i].y();
+    model_positions_.z[i] = positions[i].z();
+    model_positions_.w[i] = 1.0f;
+  }
+  MultiplyVectorArrayAndMatrix(view_projection_ * model_matrix,
+                               model_positions_, &clip_positions_);
+  const int num_triangles = indices.size() / 3;
+  statistics_.num_occluder_triangles += num_triangles;
+  Eigen::Vector3f screen[3];
+  for (int t = 0; t < num_triangles; ++t) {
+    bool in_front = true;
+    for (int k = 0; k < 3 && in_front; ++k) {
+      const GLuint vertex = indices[3 * t + k];
+      const float w = clip_positions_.w[vertex];
+      in_front = w > kMinClipW;
+      // The pixel centers are at half integers.
+      screen[k] = Eigen::Vector3f(
+          (0.5f * clip_positions_.x[vertex] / w + 0.5f) * width_,
+          (0.5f * clip_positions_.y[vertex] / w + 0.5f) * height_,
+          0.5f * clip_positions_.z[vertex] / w + 0.5f);
+    }
+    // Clipping the triangles crossing the near plane would only add
+    // occlusion near the camera.
+    if (!in_front) continue;
+    RasterizeTriangle(screen[0], screen[1], screen[2]);
+  }
+  tiles_valid_ = false;
+}
+
+bool OcclusionCuller::AddOccluder(const Model& model) {
+  if (model.primitive_type() != GL_TRIANGLES || model.cpu_data_released()) {
+    return false;
+  }
+  VertexPositions positions;
+  model.GetVertexPositions(&positions);
+  AddOccluder(positions, model.indices(), model.model_matrix());
+  return true;
+}
+
+void OcclusionCuller::RasterizeTriangle(const Eigen::Vector3f& v0,
+                                        Eigen::Vector3f v1,
+                                        Eigen::Vector3f v2) {
+  float area = (v1.x() - v0.x()) * (v2.y() - v0.y()) -
+      (v2.x() - v0.x()) * (v1.y() - v0.y());
+  if (area == 0.0f || !std::isfinite(area)) return;
+  // Counterclockwise, so that the inside is on the left of the edges.
+  if (area < 0.0f) {
+    std::swap(v1, v2);
+    area = -area;
+  }
+  const int x0 = std::max(0, static_cast<int>(std::floor(
+      std::min({v0.x(), v1.x(), v2.x()}))));
+  const int x1 = std::min(width_, static_cast<int>(std::ceil(
+      std::max({v0.x(), v1.x(), v2.x()}))));
+  const int y0 = std::max(0, static_cast<int>(std::floor(
+      std::min({v0.y(), v1.y(), v2.y()}))));
+  const int y1 = std::min(height_, static_cast<int>(std::ceil(
+      std::max({v0.y(), v1.y(), v2.y()}))));
+  if (x0 >= x1 || y0 >= y1) return;
+  ++statistics_.num_rasterized_triangles;
+  // The depth is linear in screen space, after the perspective division.
+  const float depth_x = ((v1.z() - v0.z()) * (v2.y() - v0.y()) -
+                         (v2.z() - v0.z()) * (v1.y() - v0.y())) / area;
+  const float depth_y = ((v2.z() - v0.z()) * (v1.x() - v0.x()) -
+                         (v1.z() - v0.z()) * (v2.x() - v0.x())) / area;
+  const float depth_c = v0.z() - depth_x * v0.x() - depth_y * v0.y();
+  const EdgeFunction edges[3] = {EdgeFunction(v1, v2), EdgeFunction(v2, v0),
+                                 EdgeFunction(v0, v1)};
+  // The spans start at a multiple of 4 pixels, so that they are aligned to the
+  // rows, which are a multiple of the tile size.
+  const int span_x0 = x0 & ~3;
+  for (int y = y0; y < y1; ++y) {
+    const float center_y = y + 0.5f;
+    float* row = depths_.data() + y * width_;
+    int x = span_x0;
+#if defined(WVU_HAS_SSE)
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 a[3], row_values[3];
+    for (int k = 0; k < 3; ++k) {
+      a[k] = _mm_set1_ps(edges[k].a);
+      row_values[k] = _mm_set1_ps(edges[k].b * center_y + edges[k].c);
+    }
+    const __m128 depth_a = _mm_set1_ps(depth_x);
+    const __m128 depth_row = _mm_set1_ps(depth_y * center_y + depth_c);
+    const __m128 zero = _mm_setzero_ps();
+    for (; x < x1; x += 4) {
+      const __m128 center_x = _mm_add_ps(_mm_set1_ps(x), offsets);
+      __m128 inside = _mm_cmpge_ps(
+          _mm_add_ps(_mm_mul_ps(a[0], center_x), row_values[0]), zero);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(
+          _mm_add_ps(_mm_mul_ps(a[1], center_x), row_values[1]), zero));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(
+          _mm_add_ps(_mm_mul_ps(a[2], center_x), row_values[2]), zero));
+      if (_mm_movemask_ps(inside) == 0) continue;
+      const __m128 depth =
+          _mm_add_ps(_mm_mul_ps(depth_a, center_x), depth_row);
+      const __m128 old_depth = _mm_loadu_ps(row + x);
+      const __m128 new_depth = _mm_min_ps(old_depth, depth);
+      _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_depth),
+                                       _mm_andnot_ps(inside, old_depth)));
+    }
+#endif
+    for (; x < x1; ++x) {
+      const float center_x = x + 0.5f;
+      bool inside = true;
+      for (const EdgeFunction& edge : edges) {
+        inside = inside && edge.a * center_x + edge.b * center_y + edge.c >= 0;
+      }
+      if (!inside) continue;
+      const float depth = depth_x * center_x + depth_y * center_y + depth_c;
+      row[x] = std::min(row[x], depth);
+    }
+  }
+}
+
+void OcclusionCuller::UpdateTiles() {
+  if (tiles_valid_) return;
+  tiles_valid_ = true;
+  const int num_tiles_y = height_ / kOcclusionTileSize;
+  for (int tile_y = 0; tile_y < num_tiles_y; ++tile_y) {
+    for (int tile_x = 0; tile_x < num_tiles_x_; ++tile_x) {
+      float max_depth = 0.0f;
+      for (int y = 0; y < kOcclusionTileSize; ++y) {
+        const float* row = depths_.data() +
+            (tile_y * kOcclusionTileSize + y) * width_ +
+            tile_x * kOcclusionTileSize;
+        max_depth = std::max(max_depth,
+                             *std::max_element(row, row + kOcclusionTileSize));
+      }
+      tile_max_depths_[tile_y * num_tiles_x_ + tile_x] = max_depth;
+    }
+  }
+}
+
+bool OcclusionCuller::IsRectangleVisible(const int x0,
+                                         const int y0,
+                                         const int x1,
+                                         const int y1,
+                                         const float depth) const {
+  const int tile_x0 = x0 / kOcclusionTileSize;
+  const int tile_x1 = (x1 + kOcclusionTileSize - 1) / kOcclusionTileSize;
+  const int tile_y0 = y0 / kOcclusionTileSize;
+  const int tile_y1 = (y1 + kOcclusionTileSize - 1) / kOcclusionTileSize;
+  for (int tile_y = tile_y0; tile_y < tile_y1; ++tile_y) {
+    for (int tile_x = tile_x0; tile_x < tile_x1; ++tile_x) {
+      // The whole tile is nearer than the box.
+      if (tile_max_depths_[tile_y * num_tiles_x_ + tile_x] < depth) continue;
+      // Otherwise the pixels of the tile inside the rectangle are tested.
+      const int begin_x = std::max(x0, tile_x * kOcclusionTileSize);
+      const int end_x = std::min(x1, (tile_x + 1) * kOcclusionTileSize);
+      const int begin_y = std::max(y0, tile_y * kOcclusionTileSize);
+      const int end_y = std::min(y1, (tile_y + 1) * kOcclusionTileSize);
+      for (int y = begin_y; y < end_y; ++y) {
+        const float* row = depths_.data() + y * width_;
+        for (int x = begin_x; x < end_x; ++x) {
+          if (row[x] >= depth) return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+bool OcclusionCuller::IsBoxVisible(const Eigen::AlignedBox3f& box) {
+  UpdateTiles();
+  ++statistics_.num_tested_boxes;
+  float min_x = width_, min_y = height_, max_x = 0.0f, max_y = 0.0f;
+  float min_depth = 1.0f;
+  for (int i = 0; i < 8; ++i) {
+    const Eigen::Vector4f corner = view_projection_ *
+        box.corner(static_cast<Eigen::AlignedBox3f::CornerType>(i))
+            .homogeneous();
+    // A box crossing the near plane covers the camera.
+    if (corner.w() <= kMinClipW) return true;
+    const float x = (0.5f * corner.x() / corner.w() + 0.5f) * width_;
+    const float y = (0.5f * corner.y() / corner.w() + 0.5f) * height_;
+    min_x = std::min(min_x, x);
+    max_x = std::max(max_x, x);
+    min_y = std::min(min_y, y);
+    max_y = std::max(max_y, y);
+    min_depth = std::min(min_depth, 0.5f * corner.z() / corner.w() + 0.5f);
+  }
+  // The pixels whose centers the rectangle covers, and at least one.
+  const int x0 = std::max(0, static_cast<int>(std::floor(min_x)));
+  const int x1 = std::min(width_, static_cast<int>(std::ceil(max_x)));
+  const int y0 = std::max(0, static_cast<int>(std::floor(min_y)));
+  const int y1 = std::min(height_, static_cast<int>(std::ceil(max_y)));
+  // Out of the screen, the frustum culling decides.
+  if (x0 >= x1 || y0 >= y1) return true;
+  if (IsRectangleVisible(x0, y0, x1, y1, min_depth)) return true;
+  ++statistics_.num_occluded_boxes;
+  return false;
+}
+
+void OcclusionCuller::TestBoxes(const Vector3fArray& centers,
+                                const Vector3fArray& half_extents,
+                                std::vector<uint32_t>* visibility) {
+  const int num_words =
+      std::min<int>(visibility->size(), (centers.size() + 31) / 32);
+  for (int word = 0; word < num_words; ++word) {
+    for (uint32_t bits = (*visibility)[word]; bits != 0; bits &= bits - 1) {
+      const int lane = __builtin_ctz(bits);
+      const int box = 32 * word + lane;
+      if (box >= centers.size()) break;
+      const Eigen::Vector3f center(centers.x[box], centers.y[box],
+                                   centers.z[box]);
+      const Eigen::Vector3f half_extent(
+          half_extents.x[box], half_extents.y[box], half_extents.z[box]);
+      if (!IsBoxVisible(Eigen::AlignedBox3f(center - half_extent,
+                                            center + half_extent))) {
+        (*visibility)[word] &= ~(1u << lane);
+      }
+    }
+  }
+}
+
+}  // namespace wvu
@@ -0,0 +1,186 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_OCCLUSION_CULLER_H_
+#define GLUTILS_OCCLUSION_CULLER_H_
+
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "assignment.h"
+#include "model.h"
+
+namespace wvu {
+// Default resolution of the depth buffer of an OcclusionCuller. Occluders are
+// large, so a coarse buffer hides most of what they hide.
+constexpr int kDefaultOcclusionWidth = 256;
+constexpr int kDefaultOcclusionHeight = 128;
+
+// Edge in pixels of the square tiles whose farthest depth is kept.
+constexpr int kOcclusionTileSize = 8;
+
+// Counters of an OcclusionCuller since the last BeginFrame().
+struct OcclusionStatistics {
+  int num_occluder_triangles = 0;
+  // Triangles in front of the camera and not degenerate.
+  int num_rasterized_triangles = 0;
+  int num_tested_boxes = 0;
+  int num_occluded_boxes = 0;
+};
+
+// This class culls the objects hidden behind large occluders, e.g.,
+// buildings, on the CPU before their draws are submitted. The occluders, or
+// low polygon proxies of them, are rasterized into a small depth-only buffer,
+// four pixels at a time with SSE (or one at a time on other CPUs), keeping the
+// nearest depth of every pixel. The farthest depth of every tile of 8x8
+// pixels is then kept, so that testing a box mostly reads the tiles it
+// covers: a box is hidden if its nearest depth is behind the depths of all the
+// pixels of its screen rectangle.
+//
+// The culling is conservative: the triangles crossing the near plane are not
+// rasterized, and the boxes crossing it are visible. The pixels are sampled at
+// their centers, so an object may be hidden when it is only visible through
+// the edges of the pixels of an occluder.
+//
+// Example:
+//
+// wvu::OcclusionCuller occlusion_culler;
+// while (...) {  // Rendering loop.
+//   occlusion_culler.BeginFrame(camera.view_projection());
+//   for (const wvu::Model& building : buildings) {
+//     occlusion_culler.AddOccluder(building);
+//   }
+//   wvu::CullBoxes(planes, centers, half_extents, &visibility);
+//   occlusion_culler.TestBoxes(centers, half_extents, &visibility);
+//   render_queue.AddVisible(scene_items, visibility);
+// }
+class OcclusionCuller {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  // The width is rounded up to a multiple of the tile size, and the height as
+  // well.
+  OcclusionCuller(const int width = kDefaultOcclusionWidth,
+                  const int height = kDefaultOcclusionHeight);
+  ~OcclusionCuller() {}
+
+  // Clears the depth buffer, and sets the matrix projecting the world into
+  // the clip space of the next occluders and boxes.
+  void BeginFrame(const Eigen::Matrix4f& view_projection);
+
+  // Rasterizes the triangles of an occluder. The orientation of the triangles
+  // does not matter.
+  // Parameters:
+  //   positions  The positions of the vertices, in model space.
+  //   indices  The indices of the triangles.
+  //   model_matrix  The transform of the occluder into the world.
+  void AddOccluder(const VertexPositions& positions,
+                   const std::vector<GLuint>& indices,
+                   const Eigen::Matrix4f& model_matrix);
+
+  // Rasterizes a model, which must be a triangle list keeping its CPU data.
+  // Returns false otherwise.
+  bool AddOccluder(const Model& model);
+
+  // Returns true if an axis-aligned box in world space may be visible.
+  bool IsBoxVisible(const Eigen::AlignedBox3f& box);
+
+  // Clears the bits of the occluded boxes in a visibility mask, e.g., of
+  // CullBoxes(), where the bit i % 32 of visibility[i / 32] stands for the box
+  // i. The boxes whose bits are clear are not tested.
+  // Parameters:
+  //   centers  The centers of the boxes.
+  //   half_extents  The half extents of the boxes.
+  //   visibility  The bit mask of the visible boxes.
+  void TestBoxes(const Vector3fArray& centers,
+                 const Vector3fArray& half_extents,
+                 std::vector<uint32_t>* visibility);
+
+  int width() const {
+    return width_;
+  }
+
+  int height() const {
+    return height_;
+  }
+
+  // Returns the nearest depth of a pixel in [0, 1], or 1 where no occluder
+  // was rasterized, e.g., to display the buffer.
+  float depth(const int x, const int y) const {
+    return depths_[y * width_ + x];
+  }
+
+  const OcclusionStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // Rasterizes a triangle in screen space, with (x, y, depth) vertices.
+  void RasterizeTriangle(const Eigen::Vector3f& v0,
+                         Eigen::Vector3f v1,
+                         Eigen::Vector3f v2);
+
+  // Computes the farthest depth of the tiles after new occluders.
+  void UpdateTiles();
+
+  // Returns true if a pixel of the rectangle [x0, x1) x [y0, y1) is farther
+  // than depth.
+  bool IsRectangleVisible(const int x0,
+                          const int y0,
+                          const int x1,
+                          const int y1,
+                          const float depth) const;
+
+  const int width_;
+  const int height_;
+  const int num_tiles_x_;
+  std::vector<float> depths_;
+  std::vector<float> tile_max_depths_;
+  bool tiles_valid_;
+  Eigen::Matrix4f view_projection_;
+  // Scratch storage of the transformed vertices of an occluder.
+  Vector4fArray model_positions_;
+  Vector4fArray clip_positions_;
+  OcclusionStatistics statistics_;
+
+  OcclusionCuller(const OcclusionCuller&) = delete;
+  OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_OCCLUSION_CULLER_H_
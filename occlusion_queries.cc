@@ -0,0 +1,171 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "occlusion_queries.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "gl_state_cache.h"
+#include "gpu_mesh.h"
+#include "model.h"
+#include "shader_program.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+const char kBoxVertexShaderSource[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "uniform mat4 box_to_clip;\n"
+    "void main() {\n"
+    "  gl_Position = box_to_clip * vec4(position, 1.0);\n"
+    "}\n";
+
+// The boxes write no color, so the fragment shader does nothing.
+const char kBoxFragmentShaderSource[] =
+    "#version 330 core\n"
+    "void main() {}\n";
+
+// Returns the unit cube [-1, 1]^3, with its 12 triangles facing outwards.
+Model CreateUnitCube() {
+  std::vector<PositionVertex> vertices(8);
+  for (int i = 0; i < 8; ++i) {
+    vertices[i].position[0] = (i & 1) ? 1.0f : -1.0f;
+    vertices[i].position[1] = (i & 2) ? 1.0f : -1.0f;
+    vertices[i].position[2] = (i & 4) ? 1.0f : -1.0f;
+  }
+  std::vector<GLuint> indices = {
+    0, 2, 1, 1, 2, 3,  // -z
+    4, 5, 6, 5, 7, 6,  // +z
+    0, 1, 4, 1, 5, 4,  // -y
+    2, 6, 3, 3, 6, 7,  // +y
+    0, 4, 2, 2, 4, 6,  // -x
+    1, 3, 5, 3, 7, 5   // +x
+  };
+  return Model(Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), vertices,
+               std::move(indices));
+}
+
+}  // namespace
+
+OcclusionQueries::OcclusionQueries()
+    : view_projection_(Eigen::Matrix4f::Identity()),
+      viewpoint_(Eigen::Vector3f::Zero()),
+      near_distance_(0.0f),
+      query_target_(GL_ANY_SAMPLES_PASSED),
+      box_to_clip_location_(-1) {}
+
+OcclusionQueries::~OcclusionQueries() {
+  if (!queries_.empty()) glDeleteQueries(queries_.size(), queries_.data());
+}
+
+bool OcclusionQueries::Initialize(const int num_objects,
+                                  std::string* error_info_log) {
+  if (!box_mesh_.valid()) {
+    box_program_.LoadVertexShaderFromString(kBoxVertexShaderSource);
+    box_program_.LoadFragmentShaderFromString(kBoxFragmentShaderSource);
+    if (!box_program_.Create(error_info_log)) return false;
+    box_to_clip_location_ = box_program_.GetUniformLocation("box_to_clip");
+    box_mesh_ = SetVertexArrayObject(CreateUnitCube());
+    if (!box_mesh_.valid()) {
+      *error_info_log = "Could not create the box of the occlusion queries.";
+      return false;
+    }
+    query_target_ = GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility ?
+        GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+  }
+  if (!queries_.empty()) glDeleteQueries(queries_.size(), queries_.data());
+  queries_.assign(num_objects, 0);
+  issued_.assign(num_objects, false);
+  if (num_objects > 0) glGenQueries(num_objects, queries_.data());
+  return true;
+}
+
+void OcclusionQueries::BeginQueries(const Eigen::Matrix4f& view_projection,
+                                    const Eigen::Vector3f& viewpoint,
+                                    const float near_distance) {
+  statistics_ = OcclusionQueryStatistics();
+  std::fill(issued_.begin(), issued_.end(), false);
+  view_projection_ = view_projection;
+  viewpoint_ = viewpoint;
+  near_distance_ = near_distance;
+  box_program_.Use();
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindVertexArray(box_mesh_.vertex_array_object_id());
+  gl_state->ColorMask(false);
+  gl_state->DepthMask(false);
+  gl_state->SetCapability(GL_DEPTH_TEST, true);
+  gl_state->DepthFunc(GL_LEQUAL);
+  // Both faces of the boxes are tested, so that a box cut by the far plane
+  // still passes samples through its back faces.
+  gl_state->SetCapability(GL_CULL_FACE, false);
+}
+
+void OcclusionQueries::Query(const int object,
+                             const Eigen::AlignedBox3f& box) {
+  if (object < 0 || object >= num_objects() || !box_mesh_.valid()) return;
+  // The near plane clips the faces of the boxes around the viewpoint.
+  const Eigen::AlignedBox3f near_box(
+      box.min() - Eigen::Vector3f::Constant(near_distance_),
+      box.max() + Eigen::Vector3f::Constant(near_distance_));
+  if (box.isEmpty() || near_box.contains(viewpoint_)) {
+    ++statistics_.num_unconditional_objects;
+    return;
+  }
+  Eigen::Matrix4f box_to_world = Eigen::Matrix4f::Identity();
+  box_to_world.diagonal().head<3>() = 0.5f * box.sizes();
+  box_to_world.block<3, 1>(0, 3) = box.center();
+  box_program_.SetUniform(box_to_clip_location_,
+                          Eigen::Matrix4f(view_projection_ * box_to_world));
+  glBeginQuery(query_target_, queries_[object]);
+  Draw(box_mesh_);
+  glEndQuery(query_target_);
+  issued_[object] = true;
+  ++statistics_.num_queries;
+}
+
+void OcclusionQueries::EndQueries() {
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->ColorMask(true);
+  gl_state->DepthMask(true);
+}
+
+}  // namespace wvu
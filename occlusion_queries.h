@@ -0,0 +1,158 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_OCCLUSION_QUERIES_H_
+#define GLUTILS_OCCLUSION_QUERIES_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "gpu_mesh.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Counters of the last queries of an OcclusionQueries.
+struct OcclusionQueryStatistics {
+  int num_queries = 0;
+  // Objects not queried because the viewpoint is inside their box.
+  int num_unconditional_objects = 0;
+};
+
+// This class culls the hidden objects on the GPU, with no readback: after the
+// draws of a frame, Query() draws the bounding box of every object against
+// the depth buffer, without writing colors or depths, inside an occlusion
+// query per object. The draws of the objects in the next frame are
+// conditioned on their query (see RenderItem::occlusion_query), with
+// glBeginConditionalRender() and GL_QUERY_NO_WAIT, so the GPU skips the draws
+// of the boxes that passed no samples, and draws those whose result is not
+// available yet. The queries lag one frame behind, so an object appearing
+// from behind an occluder is drawn one frame late. The boxes holding the
+// viewpoint, whose faces may all be clipped by the near plane, are not
+// queried, and neither are the objects culled by the caller, so that their
+// next draws are not conditioned on a stale result.
+//
+// The queries count any sample passed: GL_ANY_SAMPLES_PASSED_CONSERVATIVE with
+// OpenGL 4.3 or ARB_ES3_compatibility, and GL_ANY_SAMPLES_PASSED otherwise.
+// Conditioning the expensive objects only, e.g., with many triangles or
+// costly shaders, keeps the queries cheaper than what they save.
+//
+// Example:
+//
+// wvu::OcclusionQueries occlusion_queries;
+// occlusion_queries.Initialize(num_objects, &error_info_log);
+// while (...) {  // Rendering loop.
+//   render_queue.Clear();
+//   for (const int object : visible_objects) {
+//     item.occlusion_query = occlusion_queries.condition_query(object);
+//     ...
+//     render_queue.Add(item);
+//   }
+//   render_queue.Execute();
+//   occlusion_queries.BeginQueries(camera.view_projection(),
+//                                  camera.position(), camera.near());
+//   for (const int object : visible_objects) {
+//     occlusion_queries.Query(object, bounds[object]);
+//   }
+//   occlusion_queries.EndQueries();
+// }
+class OcclusionQueries {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  OcclusionQueries();
+  ~OcclusionQueries();
+
+  // Creates the queries of num_objects objects, the box mesh and the program
+  // drawing the boxes. The context must be current. Returns true if
+  // successful.
+  bool Initialize(const int num_objects, std::string* error_info_log);
+
+  // Starts querying the boxes of the visible objects of a frame against the
+  // depth buffer, which must hold the depths of the occluders. The objects
+  // not queried until EndQueries() are drawn unconditionally in the next
+  // frame.
+  // Parameters:
+  //   view_projection  The matrix of the camera of the frame.
+  //   viewpoint  The position of the camera.
+  //   near_distance  The distance of the near plane.
+  void BeginQueries(const Eigen::Matrix4f& view_projection,
+                    const Eigen::Vector3f& viewpoint,
+                    const float near_distance);
+
+  // Queries the samples of the world box of an object passing the depth test.
+  void Query(const int object, const Eigen::AlignedBox3f& box);
+
+  // Ends the queries, leaving the depth test enabled with GL_LEQUAL and the
+  // color and depth writes enabled.
+  void EndQueries();
+
+  // Returns the query of the last queries of an object, to condition its
+  // draws on, or 0 if it was not queried.
+  GLuint condition_query(const int object) const {
+    return issued_[object] ? queries_[object] : 0;
+  }
+
+  int num_objects() const {
+    return queries_.size();
+  }
+
+  const OcclusionQueryStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  std::vector<GLuint> queries_;
+  // True if the query of an object was issued by the last queries.
+  std::vector<bool> issued_;
+  Eigen::Matrix4f view_projection_;
+  Eigen::Vector3f viewpoint_;
+  float near_distance_;
+  GLenum query_target_;
+  // The unit cube, [-1, 1]^3, scaled and translated into each box.
+  GpuMesh box_mesh_;
+  ShaderProgram box_program_;
+  GLint box_to_clip_location_;
+  OcclusionQueryStatistics statistics_;
+
+  OcclusionQueries(const OcclusionQueries&) = delete;
+  OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_OCCLUSION_QUERIES_H_
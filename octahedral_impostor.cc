@@ -0,0 +1,303 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "octahedral_impostor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "gl_state_cache.h"
+#include "gpu_mesh.h"
+#include "instance_buffer.h"
+#include "model.h"
+#include "pose_batch_renderer.h"
+#include "shader_program.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+// Stores the normal of the surface, from the derivatives of its position, and
+// a full coverage.
+const char kBakeFragmentShader[] =
+    "#version 330 core\n"
+    "in vec3 model_position;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "  vec3 normal =\n"
+    "      normalize(cross(dFdx(model_position), dFdy(model_position)));\n"
+    "  color = vec4(0.5 * normal + 0.5, 1.0);\n"
+    "}\n";
+
+// The octahedral map and the basis of the views, as in OctahedralDirection()
+// and ViewBasis().
+const char kImpostorVertexShader[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "layout (location = 12) in mat4 instance_model;\n"
+    "uniform mat4 view_projection;\n"
+    "uniform vec3 camera_position;\n"
+    "uniform vec3 center;\n"
+    "uniform float radius;\n"
+    "uniform float grid_size;\n"
+    "out vec2 texcoord;\n"
+    "out mat3 normal_matrix;\n"
+    "vec2 OctahedralCoordinates(vec3 direction) {\n"
+    "  direction /= abs(direction.x) + abs(direction.y) + abs(direction.z);\n"
+    "  vec2 folded = direction.xy;\n"
+    "  if (direction.z < 0.0) {\n"
+    "    folded = (1.0 - abs(direction.yx)) *\n"
+    "        vec2(direction.x >= 0.0 ? 1.0 : -1.0,\n"
+    "             direction.y >= 0.0 ? 1.0 : -1.0);\n"
+    "  }\n"
+    "  return 0.5 * folded + 0.5;\n"
+    "}\n"
+    "vec3 OctahedralDirection(vec2 coordinates) {\n"
+    "  vec2 f = 2.0 * coordinates - 1.0;\n"
+    "  vec3 direction = vec3(f, 1.0 - abs(f.x) - abs(f.y));\n"
+    "  float fold = max(-direction.z, 0.0);\n"
+    "  direction.x += direction.x >= 0.0 ? -fold : fold;\n"
+    "  direction.y += direction.y >= 0.0 ? -fold : fold;\n"
+    "  return normalize(direction);\n"
+    "}\n"
+    "void main() {\n"
+    "  mat3 linear = mat3(instance_model);\n"
+    "  vec3 world_center = (instance_model * vec4(center, 1.0)).xyz;\n"
+    "  // The rotation and uniform scale of the instance are undone by the\n"
+    "  // transpose and the normalization.\n"
+    "  vec3 direction =\n"
+    "      normalize(transpose(linear) * (camera_position - world_center));\n"
+    "  vec2 cell = clamp(floor(OctahedralCoordinates(direction) * grid_size),\n"
+    "                    0.0, grid_size - 1.0);\n"
+    "  vec3 view = OctahedralDirection((cell + 0.5) / grid_size);\n"
+    "  vec3 up = abs(view.y) > 0.999 ? vec3(0.0, 0.0, 1.0) :\n"
+    "                                  vec3(0.0, 1.0, 0.0);\n"
+    "  vec3 right = normalize(cross(up, view));\n"
+    "  up = cross(view, right);\n"
+    "  vec3 corner =\n"
+    "      center + radius * (position.x * right + position.y * up);\n"
+    "  gl_Position = view_projection * instance_model * vec4(corner, 1.0);\n"
+    "  texcoord = (cell + 0.5 + 0.5 * position.xy) / grid_size;\n"
+    "  normal_matrix = linear;\n"
+    "}\n";
+
+const char kImpostorFragmentShader[] =
+    "#version 330 core\n"
+    "in vec2 texcoord;\n"
+    "in mat3 normal_matrix;\n"
+    "uniform sampler2D atlas;\n"
+    "uniform vec3 light_direction;\n"
+    "uniform vec3 color;\n"
+    "out vec4 fragment_color;\n"
+    "void main() {\n"
+    "  vec4 texel = texture(atlas, texcoord);\n"
+    "  if (texel.a < 0.5) discard;\n"
+    "  vec3 normal = normalize(normal_matrix * (2.0 * texel.rgb - 1.0));\n"
+    "  float diffuse = max(dot(normal, light_direction), 0.0);\n"
+    "  fragment_color = vec4(color * (0.2 + 0.8 * diffuse), 1.0);\n"
+    "}\n";
+
+// Returns the direction of a point of the octahedral map of the sphere, with
+// coordinates in [0, 1]^2.
+Eigen::Vector3f OctahedralDirection(const Eigen::Vector2f& coordinates) {
+  const Eigen::Vector2f f = 2.0f * coordinates - Eigen::Vector2f::Ones();
+  Eigen::Vector3f direction(f.x(), f.y(),
+                            1.0f - std::abs(f.x()) - std::abs(f.y()));
+  const float fold = std::max(-direction.z(), 0.0f);
+  direction.x() += direction.x() >= 0.0f ? -fold : fold;
+  direction.y() += direction.y() >= 0.0f ? -fold : fold;
+  return direction.normalized();
+}
+
+// Returns the view matrix of a camera at eye looking along -direction, with
+// the up vector of the impostor shader.
+Eigen::Matrix4f ViewMatrix(const Eigen::Vector3f& eye,
+                           const Eigen::Vector3f& direction) {
+  const Eigen::Vector3f up = std::abs(direction.y()) > 0.999f ?
+      Eigen::Vector3f::UnitZ() : Eigen::Vector3f::UnitY();
+  const Eigen::Vector3f right = up.cross(direction).normalized();
+  Eigen::Matrix4f view = Eigen::Matrix4f::Identity();
+  view.block<1, 3>(0, 0) = right.transpose();
+  view.block<1, 3>(1, 0) = direction.cross(right).transpose();
+  view.block<1, 3>(2, 0) = direction.transpose();
+  view.block<3, 1>(0, 3) = -view.block<3, 3>(0, 0) * eye;
+  return view;
+}
+
+}  // namespace
+
+ImpostorAtlas::ImpostorAtlas()
+    : texture_id_(0), grid_size_(0), tile_size_(0),
+      center_(Eigen::Vector3f::Zero()), radius_(0.0f) {}
+
+ImpostorAtlas::~ImpostorAtlas() {
+  Reset();
+}
+
+bool ImpostorAtlas::Bake(const GpuMesh& mesh,
+                         const int first_index,
+                         const int num_indices,
+                         const Eigen::AlignedBox3f& bounds,
+                         const int grid_size,
+                         const int tile_size,
+                         std::string* error_info_log) {
+  if (bounds.isEmpty()) {
+    *error_info_log = "The impostor of an empty mesh has no views.";
+    return false;
+  }
+  Reset();
+  PoseBatchRenderer renderer;
+  if (!renderer.Initialize(tile_size, tile_size, grid_size, grid_size,
+                           kBakeFragmentShader, error_info_log)) {
+    return false;
+  }
+  // The fragments not covered by the mesh have a zero alpha.
+  renderer.set_clear_color(Eigen::Vector4f::Zero());
+  grid_size_ = grid_size;
+  tile_size_ = tile_size;
+  center_ = bounds.center();
+  radius_ = std::max(0.5f * bounds.sizes().norm(), 1e-6f);
+
+  // Orthographic views framing the bounding sphere, from twice its radius.
+  const float near = radius_;
+  const float far = 3.0f * radius_;
+  Eigen::Matrix4f projection = Eigen::Matrix4f::Zero();
+  projection(0, 0) = 1.0f / radius_;
+  projection(1, 1) = 1.0f / radius_;
+  projection(2, 2) = -2.0f / (far - near);
+  projection(2, 3) = -(far + near) / (far - near);
+  projection(3, 3) = 1.0f;
+  // The tile of the cell (i, j) is j * grid_size + i, from the bottom left.
+  CameraPoses views(grid_size * grid_size);
+  for (int j = 0; j < grid_size; ++j) {
+    for (int i = 0; i < grid_size; ++i) {
+      const Eigen::Vector3f direction = OctahedralDirection(
+          Eigen::Vector2f(i + 0.5f, j + 0.5f) / grid_size);
+      views[j * grid_size + i] =
+          ViewMatrix(center_ + 2.0f * radius_ * direction, direction);
+    }
+  }
+  if (!renderer.Render(mesh, first_index, num_indices,
+                       Eigen::Matrix4f::Identity(), projection, views.data(),
+                       views.size())) {
+    *error_info_log = "Could not render the views of the impostor.";
+    return false;
+  }
+
+  // Copy the atlas, still bound for reading, into a texture. The mip levels
+  // stop where a texel would cover a quarter of a view, so the views do not
+  // bleed into each other.
+  const int size = grid_size * tile_size;
+  int max_level = 0;
+  while ((tile_size >> (max_level + 1)) >= 4) ++max_level;
+  glGenTextures(1, &texture_id_);
+  glBindTexture(GL_TEXTURE_2D, texture_id_);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, nullptr);
+  glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, size, size);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, max_level);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return texture_id_ != 0;
+}
+
+void ImpostorAtlas::Reset() {
+  if (texture_id_ != 0) {
+    glDeleteTextures(1, &texture_id_);
+    texture_id_ = 0;
+  }
+  grid_size_ = 0;
+  tile_size_ = 0;
+}
+
+ImpostorRenderer::ImpostorRenderer()
+    : attached_buffer_id_(0),
+      light_direction_(Eigen::Vector3f::UnitY()),
+      color_(Eigen::Vector3f::Ones()) {}
+
+ImpostorRenderer::~ImpostorRenderer() {}
+
+bool ImpostorRenderer::Initialize(std::string* error_info_log) {
+  shader_program_.LoadVertexShaderFromString(kImpostorVertexShader);
+  shader_program_.LoadFragmentShaderFromString(kImpostorFragmentShader);
+  if (!shader_program_.Create(error_info_log)) return false;
+  const std::vector<PositionVertex> corners = {
+      {{-1.0f, -1.0f, 0.0f}}, {{1.0f, -1.0f, 0.0f}},
+      {{1.0f, 1.0f, 0.0f}}, {{-1.0f, 1.0f, 0.0f}}};
+  Model quad(Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), corners);
+  quad.SetIndices({0, 1, 2, 0, 2, 3});
+  quad_ = SetVertexArrayObject(quad);
+  if (!quad_.valid()) {
+    *error_info_log = "Could not create the impostor quad.";
+    return false;
+  }
+  return true;
+}
+
+void ImpostorRenderer::Draw(const ImpostorAtlas& atlas,
+                            const InstanceBuffer& instances,
+                            const Eigen::Matrix4f& view_projection,
+                            const Eigen::Vector3f& camera_position) {
+  if (atlas.texture_id() == 0 || instances.num_instances() == 0) return;
+  if (attached_buffer_id_ != instances.buffer_id()) {
+    instances.Attach(quad_);
+    attached_buffer_id_ = instances.buffer_id();
+  }
+  shader_program_.Use();
+  shader_program_.SetUniform("view_projection", view_projection);
+  shader_program_.SetUniform("camera_position", camera_position);
+  shader_program_.SetUniform("center", atlas.center());
+  shader_program_.SetUniform("radius", atlas.radius());
+  shader_program_.SetUniform("grid_size",
+                             static_cast<GLfloat>(atlas.grid_size()));
+  shader_program_.SetUniform("light_direction", light_direction_);
+  shader_program_.SetUniform("color", color_);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, atlas.texture_id());
+  DrawInstanced(quad_, instances);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+}  // namespace wvu
@@ -0,0 +1,194 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_OCTAHEDRAL_IMPOSTOR_H_
+#define GLUTILS_OCTAHEDRAL_IMPOSTOR_H_
+
+#include <string>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "gpu_mesh.h"
+#include "instance_buffer.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Default number of views per side of the octahedral grid of an impostor.
+constexpr int kDefaultImpostorGridSize = 16;
+
+// Default texels per side of a view of an impostor.
+constexpr int kDefaultImpostorTileSize = 64;
+
+// This class holds an octahedral impostor of a mesh: a texture atlas of
+// grid_size x grid_size orthographic views of the mesh, taken from the
+// directions of the centers of the cells of an octahedral map of the sphere,
+// so that the views cover all the directions evenly. The views are rendered
+// with a PoseBatchRenderer, all the tiles in one instanced draw, and store the
+// normals of the mesh in model space in their colors, and its coverage in
+// their alpha, so that the impostors are lit at draw time like the meshes.
+//
+// Example:
+//
+// wvu::ImpostorAtlas impostor;
+// impostor.Bake(mesh, lod_chain.lod(0).first_index,
+//               lod_chain.lod(0).num_indices, bounds,
+//               wvu::kDefaultImpostorGridSize,
+//               wvu::kDefaultImpostorTileSize, &error_info_log);
+// lod_chain.SetImpostor(impostor.radius(),
+//                       0.5f * wvu::kDefaultImpostorTileSize);
+class ImpostorAtlas {
+ public:
+  ImpostorAtlas();
+  ~ImpostorAtlas();
+
+  // Renders the views of a range of the indices of a mesh into the atlas.
+  // Leaves the default framebuffer bound; the viewport must be set again.
+  // Returns true if successful.
+  // Parameters:
+  //   mesh  The mesh, whose positions are at attribute location 0.
+  //   first_index  The first index of the range to draw.
+  //   num_indices  The number of indices to draw.
+  //   bounds  The bounds of the range, in model space.
+  //   grid_size  The number of views per side of the grid.
+  //   tile_size  The number of texels per side of a view.
+  //   error_info_log  The reason of the failure.
+  bool Bake(const GpuMesh& mesh,
+            const int first_index,
+            const int num_indices,
+            const Eigen::AlignedBox3f& bounds,
+            const int grid_size,
+            const int tile_size,
+            std::string* error_info_log);
+
+  // Deletes the texture.
+  void Reset();
+
+  GLuint texture_id() const {
+    return texture_id_;
+  }
+
+  int grid_size() const {
+    return grid_size_;
+  }
+
+  int tile_size() const {
+    return tile_size_;
+  }
+
+  // The bounding sphere of the mesh, in model space, which the views frame.
+  const Eigen::Vector3f& center() const {
+    return center_;
+  }
+
+  float radius() const {
+    return radius_;
+  }
+
+ private:
+  GLuint texture_id_;
+  int grid_size_;
+  int tile_size_;
+  Eigen::Vector3f center_;
+  float radius_;
+
+  ImpostorAtlas(const ImpostorAtlas&) = delete;
+  ImpostorAtlas& operator=(const ImpostorAtlas&) = delete;
+};
+
+// This class draws the instances of an impostor as camera-facing quads, all
+// of them with one instanced draw. Every instance selects the view of the
+// atlas nearest to the direction of the camera in its model space, and its
+// quad is oriented like that view, so the silhouette of the view matches the
+// mesh from the camera. The fragments outside the coverage of the view are
+// discarded, and the others are lit with the normal of the view rotated by
+// the instance. The instances are the model matrices of an InstanceBuffer,
+// e.g., of the entities whose MeshLodChain::SelectLod() returns the impostor.
+//
+// Example:
+//
+// wvu::ImpostorRenderer impostor_renderer;
+// impostor_renderer.Initialize(&error_info_log);
+// while (...) {  // Rendering loop.
+//   ...  // Select the levels of the instances, and gather the impostors.
+//   impostor_instances.Update(far_transforms.data(), far_transforms.size());
+//   impostor_renderer.Draw(impostor, impostor_instances,
+//                          camera.view_projection(), camera.position());
+// }
+class ImpostorRenderer {
+ public:
+  ImpostorRenderer();
+  ~ImpostorRenderer();
+
+  // Compiles the program and creates the quad. Returns true if successful.
+  bool Initialize(std::string* error_info_log);
+
+  // Draws the instances of the last update of a buffer with the views of an
+  // atlas. The buffer is attached to the quad when it changes.
+  // Parameters:
+  //   atlas  The impostor.
+  //   instances  The model matrices of the instances.
+  //   view_projection  The matrix transforming world to clip coordinates.
+  //   camera_position  The position of the camera in world coordinates.
+  void Draw(const ImpostorAtlas& atlas,
+            const InstanceBuffer& instances,
+            const Eigen::Matrix4f& view_projection,
+            const Eigen::Vector3f& camera_position);
+
+  // The direction towards the light, in world coordinates, and the color of
+  // the impostors.
+  void set_light_direction(const Eigen::Vector3f& light_direction) {
+    light_direction_ = light_direction.normalized();
+  }
+
+  void set_color(const Eigen::Vector3f& color) {
+    color_ = color;
+  }
+
+ private:
+  ShaderProgram shader_program_;
+  GpuMesh quad_;
+  // The instance buffer attached to the quad.
+  GLuint attached_buffer_id_;
+  Eigen::Vector3f light_direction_;
+  Eigen::Vector3f color_;
+
+  ImpostorRenderer(const ImpostorRenderer&) = delete;
+  ImpostorRenderer& operator=(const ImpostorRenderer&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_OCTAHEDRAL_IMPOSTOR_H_
@@ -0,0 +1,140 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "offscreen_framebuffer.h"
+
+#include <string>
+#include <GL/glew.h>
+
+namespace wvu {
+
+OffscreenFramebuffer::OffscreenFramebuffer()
+    : framebuffer_id_(0), color_renderbuffer_id_(0), depth_renderbuffer_id_(0),
+      width_(0), height_(0), num_samples_(0) {}
+
+OffscreenFramebuffer::~OffscreenFramebuffer() {
+  Reset();
+}
+
+bool OffscreenFramebuffer::Initialize(const int width,
+                                      const int height,
+                                      std::string* error_info_log) {
+  return Initialize(width, height, 0, error_info_log);
+}
+
+bool OffscreenFramebuffer::Initialize(const int width,
+                                      const int height,
+                                      const int num_samples,
+                                      std::string* error_info_log) {
+  Reset();
+  GLint max_size = 0;
+  glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size);
+  if (width <= 0 || height <= 0 || width > max_size || height > max_size) {
+    *error_info_log = "Invalid framebuffer size " + std::to_string(width) +
+        "x" + std::to_string(height) + ", the maximum is " +
+        std::to_string(max_size) + ".";
+    return false;
+  }
+  GLint max_samples = 0;
+  glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+  if (num_samples < 0 || num_samples > max_samples) {
+    *error_info_log = "Invalid number of samples " +
+        std::to_string(num_samples) + ", the maximum is " +
+        std::to_string(max_samples) + ".";
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  // Zero samples allocates single-sampled storage.
+  glGenRenderbuffers(1, &color_renderbuffer_id_);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer_id_);
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, num_samples, GL_RGBA8,
+                                   width_, height_);
+  glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_SAMPLES,
+                               &num_samples_);
+  glGenRenderbuffers(1, &depth_renderbuffer_id_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_id_);
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, num_samples,
+                                   GL_DEPTH24_STENCIL8, width_, height_);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer_id_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, color_renderbuffer_id_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_renderbuffer_id_);
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    *error_info_log =
+        "The offscreen framebuffer is incomplete: status " +
+        std::to_string(status) + ".";
+    Reset();
+    return false;
+  }
+  return true;
+}
+
+void OffscreenFramebuffer::Bind() const {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+  glViewport(0, 0, width_, height_);
+}
+
+void OffscreenFramebuffer::Resolve(const GLuint framebuffer_id) const {
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_id_);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_id);
+  // Multisampled blits cannot scale, so the filter does not matter.
+  glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_,
+                    GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+}
+
+void OffscreenFramebuffer::Reset() {
+  if (framebuffer_id_ != 0) glDeleteFramebuffers(1, &framebuffer_id_);
+  if (color_renderbuffer_id_ != 0) {
+    glDeleteRenderbuffers(1, &color_renderbuffer_id_);
+  }
+  if (depth_renderbuffer_id_ != 0) {
+    glDeleteRenderbuffers(1, &depth_renderbuffer_id_);
+  }
+  framebuffer_id_ = 0;
+  color_renderbuffer_id_ = 0;
+  depth_renderbuffer_id_ = 0;
+  width_ = 0;
+  height_ = 0;
+  num_samples_ = 0;
+}
+
+}  // namespace wvu
@@ -0,0 +1,150 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_OFFSCREEN_FRAMEBUFFER_H_
+#define GLUTILS_OFFSCREEN_FRAMEBUFFER_H_
+
+#include <string>
+#include <GL/glew.h>
+
+namespace wvu {
+// This class owns a framebuffer object with a color and a depth-stencil
+// renderbuffer, so that frames are rendered at any resolution without a
+// visible window, e.g., on servers without a display. The context can belong
+// to a hidden window: the default framebuffer of the window is not used, and
+// nothing goes through the compositor. The objects are deleted with the
+// framebuffer, which must happen while the context is current.
+//
+// Multisampled framebuffers store num_samples samples per pixel, which smooths
+// the edges of the triangles (MSAA). Their samples cannot be read or shown
+// directly: Resolve() averages them into a single-sampled framebuffer, e.g.,
+// the default framebuffer of the window.
+//
+// Example:
+//
+// glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+// GLFWwindow* window = glfwCreateWindow(1, 1, "", nullptr, nullptr);
+// ...  // Make the context current and initialize GLEW.
+// wvu::OffscreenFramebuffer framebuffer;
+// if (!framebuffer.Initialize(1920, 1080, &error_info_log)) { ... }
+// while (...) {  // Rendering loop.
+//   framebuffer.Bind();
+//   ...  // Draws.
+// }
+//
+// wvu::OffscreenFramebuffer msaa_framebuffer;
+// if (!msaa_framebuffer.Initialize(1920, 1080, 4, &error_info_log)) { ... }
+// while (...) {  // Rendering loop.
+//   msaa_framebuffer.Bind();
+//   ...  // Draws.
+//   msaa_framebuffer.Resolve(framebuffer.framebuffer_id());
+// }
+class OffscreenFramebuffer {
+ public:
+  OffscreenFramebuffer();
+  ~OffscreenFramebuffer();
+
+  // Creates the framebuffer and its renderbuffers. Returns true if the
+  // framebuffer is complete.
+  // Parameters:
+  //   width  The width in pixels.
+  //   height  The height in pixels.
+  //   error_info_log  The reason of the failure.
+  bool Initialize(const int width,
+                  const int height,
+                  std::string* error_info_log);
+
+  // Creates the framebuffer with multisampled renderbuffers. The GPU may use
+  // more samples than requested, see num_samples(). Returns true if the
+  // framebuffer is complete.
+  // Parameters:
+  //   width  The width in pixels.
+  //   height  The height in pixels.
+  //   num_samples  The samples per pixel, at most GL_MAX_SAMPLES, or 0 for a
+  //     single-sampled framebuffer.
+  //   error_info_log  The reason of the failure.
+  bool Initialize(const int width,
+                  const int height,
+                  const int num_samples,
+                  std::string* error_info_log);
+
+  // Binds the framebuffer for drawing and reading, and sets the viewport to
+  // its size.
+  void Bind() const;
+
+  // Copies the colors into the framebuffer framebuffer_id of the same size,
+  // averaging the samples of each pixel, with glBlitFramebuffer(). Leaves
+  // framebuffer_id bound for drawing and reading, so the next draws (e.g., an
+  // overlay) go to the resolved image.
+  void Resolve(const GLuint framebuffer_id) const;
+
+  // Deletes the OpenGL objects.
+  void Reset();
+
+  GLuint framebuffer_id() const {
+    return framebuffer_id_;
+  }
+
+  GLuint color_renderbuffer_id() const {
+    return color_renderbuffer_id_;
+  }
+
+  int width() const {
+    return width_;
+  }
+
+  int height() const {
+    return height_;
+  }
+
+  // Returns the samples per pixel, or 0 if the framebuffer is single-sampled.
+  int num_samples() const {
+    return num_samples_;
+  }
+
+ private:
+  GLuint framebuffer_id_;
+  GLuint color_renderbuffer_id_;
+  GLuint depth_renderbuffer_id_;
+  int width_;
+  int height_;
+  int num_samples_;
+
+  OffscreenFramebuffer(const OffscreenFramebuffer&) = delete;
+  OffscreenFramebuffer& operator=(const OffscreenFramebuffer&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_OFFSCREEN_FRAMEBUFFER_H_
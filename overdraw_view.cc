@@ -0,0 +1,212 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "overdraw_view.h"
+
+#include <string>
+#include <GL/glew.h>
+
+#include "gl_state_cache.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Counts the fragment, blended additively.
+const char kCountFragmentShader[] =
+    "#version 330 core\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "  color = vec4(1.0);\n"
+    "}\n";
+
+// Covers the viewport with a single triangle, from gl_VertexID alone.
+const char kHeatmapVertexShader[] =
+    "#version 330 core\n"
+    "void main() {\n"
+    "  vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+    "  gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+// Maps the counts to the colors of the heatmap.
+const char kHeatmapFragmentShader[] =
+    "#version 330 core\n"
+    "uniform sampler2D counts;\n"
+    "uniform float max_overdraw;\n"
+    "out vec4 color;\n"
+    "const vec3 RAMP[5] = vec3[5](vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 1.0),\n"
+    "                             vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0),\n"
+    "                             vec3(1.0, 0.0, 0.0));\n"
+    "void main() {\n"
+    "  float count = texelFetch(counts, ivec2(gl_FragCoord.xy), 0).r;\n"
+    "  if (count < 0.5) {\n"
+    "    color = vec4(0.0, 0.0, 0.0, 1.0);\n"
+    "  } else if (count > max_overdraw + 0.5) {\n"
+    "    color = vec4(1.0);\n"
+    "  } else {\n"
+    "    // One fragment is blue, and max_overdraw red.\n"
+    "    float t = 4.0 * clamp((count - 1.0) / max(max_overdraw - 1.0, 1.0),\n"
+    "                          0.0, 1.0);\n"
+    "    int i = min(int(t), 3);\n"
+    "    color = vec4(mix(RAMP[i], RAMP[i + 1], t - float(i)), 1.0);\n"
+    "  }\n"
+    "}\n";
+
+}  // namespace
+
+OverdrawView::OverdrawView()
+    : max_overdraw_location_(-1),
+      framebuffer_id_(0),
+      count_texture_id_(0),
+      depth_renderbuffer_id_(0),
+      vertex_array_id_(0),
+      width_(0),
+      height_(0),
+      max_overdraw_(kDefaultMaxOverdraw) {}
+
+OverdrawView::~OverdrawView() {
+  Reset();
+}
+
+bool OverdrawView::Initialize(const std::string& vertex_shader_source,
+                              std::string* error_info_log) {
+  if (count_program_.shader_program_id() != 0) {
+    *error_info_log = "The overdraw view is already initialized.";
+    return false;
+  }
+  count_program_.LoadVertexShaderFromString(vertex_shader_source);
+  count_program_.LoadFragmentShaderFromString(kCountFragmentShader);
+  heatmap_program_.LoadVertexShaderFromString(kHeatmapVertexShader);
+  heatmap_program_.LoadFragmentShaderFromString(kHeatmapFragmentShader);
+  if (!count_program_.Create(error_info_log) ||
+      !heatmap_program_.Create(error_info_log)) {
+    return false;
+  }
+  heatmap_program_.Use();
+  heatmap_program_.SetUniform("counts", static_cast<GLint>(0));
+  max_overdraw_location_ = heatmap_program_.GetUniformLocation("max_overdraw");
+  if (vertex_array_id_ == 0) glGenVertexArrays(1, &vertex_array_id_);
+  return true;
+}
+
+bool OverdrawView::Begin(const int width,
+                         const int height,
+                         std::string* error_info_log) {
+  if (width <= 0 || height <= 0) {
+    *error_info_log = "Invalid overdraw target size " +
+        std::to_string(width) + "x" + std::to_string(height) + ".";
+    return false;
+  }
+  if (framebuffer_id_ == 0 || width != width_ || height != height_) {
+    ResetTarget();
+    width_ = width;
+    height_ = height;
+    glGenTextures(1, &count_texture_id_);
+    glBindTexture(GL_TEXTURE_2D, count_texture_id_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width_, height_, 0, GL_RED,
+                 GL_HALF_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenRenderbuffers(1, &depth_renderbuffer_id_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_id_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width_,
+                          height_);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glGenFramebuffers(1, &framebuffer_id_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, count_texture_id_, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, depth_renderbuffer_id_);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+      *error_info_log = "The overdraw framebuffer is incomplete: status " +
+          std::to_string(status) + ".";
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      ResetTarget();
+      return false;
+    }
+  }
+  GlStateCache* gl_state = GlStateCache::Current();
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+  glViewport(0, 0, width_, height_);
+  gl_state->ColorMask(true);
+  gl_state->DepthMask(true);
+  const GLfloat zero[] = {0.0f, 0.0f, 0.0f, 0.0f};
+  glClearBufferfv(GL_COLOR, 0, zero);
+  glClear(GL_DEPTH_BUFFER_BIT);
+  gl_state->SetCapability(GL_BLEND, true);
+  gl_state->BlendFunc(GL_ONE, GL_ONE);
+  return true;
+}
+
+void OverdrawView::Resolve(const GLuint framebuffer_id) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+  glViewport(0, 0, width_, height_);
+  gl_state->SetCapability(GL_BLEND, false);
+  gl_state->SetCapability(GL_DEPTH_TEST, false);
+  gl_state->SetCapability(GL_CULL_FACE, false);
+  heatmap_program_.Use();
+  heatmap_program_.SetUniform(max_overdraw_location_, max_overdraw_);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, count_texture_id_);
+  gl_state->BindVertexArray(vertex_array_id_);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  gl_state->SetCapability(GL_DEPTH_TEST, true);
+}
+
+void OverdrawView::ResetTarget() {
+  if (framebuffer_id_ != 0) glDeleteFramebuffers(1, &framebuffer_id_);
+  if (count_texture_id_ != 0) glDeleteTextures(1, &count_texture_id_);
+  if (depth_renderbuffer_id_ != 0) {
+    glDeleteRenderbuffers(1, &depth_renderbuffer_id_);
+  }
+  framebuffer_id_ = 0;
+  count_texture_id_ = 0;
+  depth_renderbuffer_id_ = 0;
+  width_ = 0;
+  height_ = 0;
+}
+
+void OverdrawView::Reset() {
+  ResetTarget();
+  if (vertex_array_id_ != 0) {
+    GlStateCache::Current()->DeleteVertexArrays(1, &vertex_array_id_);
+  }
+  vertex_array_id_ = 0;
+}
+
+}  // namespace wvu
@@ -0,0 +1,133 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_OVERDRAW_VIEW_H_
+#define GLUTILS_OVERDRAW_VIEW_H_
+
+#include <string>
+#include <GL/glew.h>
+
+#include "shader_program.h"
+
+namespace wvu {
+// Default number of fragments per pixel shown at the hot end of the heatmap.
+constexpr float kDefaultMaxOverdraw = 8.0f;
+
+// This class shows where the fill rate of a scene goes: the items are drawn
+// with a program whose fragment shader writes 1, blended additively into a
+// GL_R16F target, which counts the fragments shaded in every pixel, and the
+// counts are resolved into a heatmap, from black (none) through blue (one),
+// green and yellow, to red at the maximum overdraw and white past it. The
+// depth test keeps its state, so the counts are the fragments that pass it in
+// the order of the draws: the fragments the GPU would shade. The heatmap
+// shows where sorting front to back, a depth prepass (after which every pixel
+// shades once), coarser levels of detail or culling would pay off.
+//
+// The counting program has the vertex shader of the items, and is drawn in
+// their place, e.g., with RenderQueue::ExecuteWithProgram().
+//
+// Example:
+//
+// wvu::OverdrawView overdraw_view;
+// if (!overdraw_view.Initialize(vertex_shader_source, &error_info_log)) {
+//   ...
+// }
+// while (...) {  // Rendering loop.
+//   overdraw_view.Begin(width, height, &error_info_log);
+//   render_queue.ExecuteWithProgram(overdraw_view.program());
+//   overdraw_view.Resolve(framebuffer_id);
+// }
+class OverdrawView {
+ public:
+  OverdrawView();
+  ~OverdrawView();
+
+  // Compiles the counting program with the vertex shader of the items, and
+  // the heatmap program, once. The context must be current. Returns true if
+  // successful.
+  bool Initialize(const std::string& vertex_shader_source,
+                  std::string* error_info_log);
+
+  // Binds the counting target of width x height pixels, created again if the
+  // size changed, and clears it. Leaves the additive blending on. Returns
+  // true if successful.
+  bool Begin(const int width,
+             const int height,
+             std::string* error_info_log);
+
+  // Draws the heatmap of the counts over the framebuffer framebuffer_id, and
+  // leaves it bound with the blending off.
+  void Resolve(const GLuint framebuffer_id);
+
+  // Deletes the target. The programs are kept until destruction.
+  void Reset();
+
+  // Returns the counting program, which the caller sets up as the programs
+  // of the items, e.g., binds its uniform blocks.
+  ShaderProgram* program() {
+    return &count_program_;
+  }
+
+  // Sets the number of fragments per pixel shown in red.
+  void set_max_overdraw(const float max_overdraw) {
+    max_overdraw_ = max_overdraw;
+  }
+
+  float max_overdraw() const {
+    return max_overdraw_;
+  }
+
+ private:
+  // Deletes the target and its framebuffer.
+  void ResetTarget();
+
+  ShaderProgram count_program_;
+  ShaderProgram heatmap_program_;
+  GLint max_overdraw_location_;
+  GLuint framebuffer_id_;
+  GLuint count_texture_id_;
+  GLuint depth_renderbuffer_id_;
+  // The empty vertex array of the full-screen triangle of the heatmap.
+  GLuint vertex_array_id_;
+  int width_;
+  int height_;
+  float max_overdraw_;
+
+  OverdrawView(const OverdrawView&) = delete;
+  OverdrawView& operator=(const OverdrawView&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_OVERDRAW_VIEW_H_
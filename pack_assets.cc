@@ -0,0 +1,165 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+// Packs asset files into an archive of wvu::AssetArchive (see
+// asset_archive.h), so that a scene loads them with one open instead of one
+// per file. The entries are named by the paths given, and stored in their
+// order, which should be the order the scene loads them in.
+//
+// Example:
+//
+// ./bin/pack_assets --output_file=assets.wvua shaders/*.glsl meshes/*.mesh
+// ./bin/pack_assets --list_file=assets.wvua
+// ./bin/pack_assets --load_file=assets.wvua
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "asset_archive.h"
+#include "asset_loader.h"
+#include "async_file_reader.h"
+#include "job_system.h"
+#include "mapped_file.h"
+
+// Use the right namespace for google flags (gflags).
+#ifdef GFLAGS_NAMESPACE_GOOGLE
+#define CS470_GFLAGS_NAMESPACE google
+#else
+#define CS470_GFLAGS_NAMESPACE gflags
+#endif
+
+DEFINE_string(output_file, "assets.wvua", "Archive to write.");
+DEFINE_bool(compress, true,
+            "Compresses the entries with LZ4. Otherwise they are stored.");
+DEFINE_int32(block_size, wvu::kDefaultAssetBlockSize,
+             "Bytes of the blocks the entries are compressed in.");
+DEFINE_string(list_file, "",
+              "Lists the entries of this archive instead of writing one.");
+DEFINE_string(load_file, "",
+              "Loads every entry of this archive through the asynchronous "
+              "reads and the decompression jobs, and reports the throughput, "
+              "instead of writing an archive.");
+DEFINE_int32(queue_depth, wvu::kDefaultAsyncReadQueueDepth,
+             "Reads in flight with --load_file.");
+DEFINE_bool(thread_pool_reads, false,
+            "Reads with threads instead of io_uring with --load_file.");
+
+// Annonymous namespace for constants and helper functions.
+namespace {
+// Loads every entry of the archive, and logs the counters. Returns true if
+// every entry loaded.
+bool LoadArchive(const std::string& filepath, std::string* error_info_log) {
+  wvu::AssetArchive archive;
+  wvu::AsyncFileReader reader;
+  if (!archive.Open(filepath, error_info_log) ||
+      !reader.Initialize(FLAGS_queue_depth, error_info_log,
+                         FLAGS_thread_pool_reads)) {
+    return false;
+  }
+  wvu::JobSystem job_system;
+  wvu::AssetLoader loader(&archive, &reader, &job_system);
+  if (!loader.Open(error_info_log)) return false;
+  for (const std::string& name : archive.names()) {
+    loader.Load(name, [](const std::string& name,
+                         std::vector<uint8_t>* contents) {
+      if (contents == nullptr) LOG(ERROR) << "Could not load " << name;
+    });
+  }
+  loader.Finish();
+  const wvu::AssetLoaderStatistics statistics = loader.statistics();
+  LOG(INFO) << "Loaded " << statistics.num_loaded_assets << " entries of "
+            << statistics.num_bytes << " bytes with "
+            << (reader.backend() == wvu::IO_URING_BACKEND ? "io_uring"
+                                                          : "threads")
+            << ": " << statistics.reads.num_reads << " reads of "
+            << statistics.reads.num_bytes << " bytes at "
+            << statistics.reads.bytes_per_second / (1 << 20)
+            << " MiB/s, with up to " << statistics.reads.max_queue_depth
+            << " reads queued and " << statistics.reads.num_submit_calls
+            << " system calls.";
+  return statistics.num_failed_assets == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CS470_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  std::string error_info_log;
+  if (!FLAGS_load_file.empty()) {
+    if (!LoadArchive(FLAGS_load_file, &error_info_log)) {
+      if (!error_info_log.empty()) LOG(ERROR) << error_info_log;
+      return -1;
+    }
+    return 0;
+  }
+  if (!FLAGS_list_file.empty()) {
+    wvu::AssetArchive archive;
+    if (!archive.Open(FLAGS_list_file, &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      return -1;
+    }
+    for (const std::string& name : archive.names()) {
+      LOG(INFO) << name << ": " << archive.size(name) << " bytes.";
+    }
+    return 0;
+  }
+
+  wvu::AssetArchiveWriter writer(FLAGS_block_size);
+  const wvu::AssetCompression compression =
+      FLAGS_compress ? wvu::ASSET_LZ4 : wvu::ASSET_STORED;
+  for (int i = 1; i < argc; ++i) {
+    wvu::MappedFile file;
+    if (!file.Open(argv[i])) {
+      LOG(ERROR) << "Could not map " << argv[i];
+      return -1;
+    }
+    if (!writer.Add(argv[i], file.data(), file.size(), compression)) {
+      LOG(ERROR) << argv[i] << " is given twice.";
+      return -1;
+    }
+  }
+  if (!writer.Write(FLAGS_output_file, &error_info_log)) {
+    LOG(ERROR) << error_info_log;
+    return -1;
+  }
+  LOG(INFO) << "Packed " << argc - 1 << " files of " << writer.num_bytes()
+            << " bytes into " << writer.num_stored_bytes() << " bytes.";
+  return 0;
+}
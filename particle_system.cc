@@ -0,0 +1,701 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "particle_system.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define WVU_HAS_SSE
+#endif
+// AVX2 kernels are compiled for their own target and selected at run time, so
+// that the binary still runs on CPUs without AVX2.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define WVU_HAS_AVX2
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define WVU_HAS_NEON
+#endif
+
+#include "assignment.h"
+#include "buffer_allocator.h"
+#include "frame_uniforms.h"
+#include "gl_state_cache.h"
+#include "job_system.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Number of invocations per work group of the simulation shader.
+constexpr int kSimulationGroupSize = 256;
+// Maximum number of particles of a CPU simulation job. A multiple of the
+// widest SIMD register, so that only the last job runs the scalar tail.
+constexpr int kSimulationGrainSize = 16384;
+// Floats per particle of the buffers of the GPU simulation: the position and
+// the life, and the velocity. The CPU simulation only uploads the first four.
+constexpr int kGpuParticleStride = 8;
+constexpr int kCpuParticleStride = 4;
+
+// Hashes the index of a particle (Wellons' lowbias32), the same way as the
+// simulation shader.
+uint32_t HashParticle(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352dU;
+  x ^= x >> 15;
+  x *= 0x846ca68bU;
+  x ^= x >> 16;
+  return x;
+}
+
+// Returns a number in [0, 1) drawn from a hash of seed.
+float RandomUnit(const uint32_t seed) {
+  return (HashParticle(seed) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Moves the particles by delta_time, bouncing them on the floor, and consumes
+// their lives. Emitting the dead particles again is left to the caller.
+const char kSimulationShader[] =
+    "#version 430\n"
+    "layout (local_size_x = 256) in;\n"
+    "struct Particle {\n"
+    "  vec4 position_life;\n"
+    "  vec4 velocity;\n"
+    "};\n"
+    "layout (std430, binding = 0) readonly buffer Source {\n"
+    "  Particle source[];\n"
+    "};\n"
+    "layout (std430, binding = 1) writeonly buffer Destination {\n"
+    "  Particle destination[];\n"
+    "};\n"
+    "uniform int num_particles;\n"
+    "uniform int frame_hash;\n"
+    "uniform float delta_time;\n"
+    "uniform float life_step;\n"
+    "uniform vec3 gravity;\n"
+    "uniform vec3 emitter_position;\n"
+    "uniform vec3 emitter_velocity;\n"
+    "uniform float velocity_spread;\n"
+    "uniform float floor_height;\n"
+    "uniform float restitution;\n"
+    "uint Hash(uint x) {\n"
+    "  x ^= x >> 16;\n"
+    "  x *= 0x7feb352du;\n"
+    "  x ^= x >> 15;\n"
+    "  x *= 0x846ca68bu;\n"
+    "  x ^= x >> 16;\n"
+    "  return x;\n"
+    "}\n"
+    "float RandomUnit(uint seed) {\n"
+    "  return float(Hash(seed) >> 8) * (1.0 / 16777216.0);\n"
+    "}\n"
+    "void main() {\n"
+    "  int i = int(gl_GlobalInvocationID.x);\n"
+    "  if (i >= num_particles) return;\n"
+    "  Particle particle = source[i];\n"
+    "  vec3 velocity = particle.velocity.xyz + gravity * delta_time;\n"
+    "  vec3 position = particle.position_life.xyz + velocity * delta_time;\n"
+    "  float life = particle.position_life.w - life_step;\n"
+    "  if (position.y < floor_height && velocity.y < 0.0) {\n"
+    "    position.y = floor_height;\n"
+    "    velocity.y *= -restitution;\n"
+    "  }\n"
+    "  if (life <= 0.0) {\n"
+    "    uint seed = Hash(uint(i) ^ uint(frame_hash));\n"
+    "    vec3 random = vec3(RandomUnit(seed), RandomUnit(seed + 1u),\n"
+    "                       RandomUnit(seed + 2u));\n"
+    "    position = emitter_position;\n"
+    "    velocity = emitter_velocity +\n"
+    "        velocity_spread * (2.0 * random - 1.0);\n"
+    "    life += 1.0;\n"
+    "    if (life <= 0.0) life = 1.0;\n"
+    "  }\n"
+    "  destination[i] = Particle(vec4(position, life), vec4(velocity, 0.0));\n"
+    "}\n";
+
+// Draws a quad facing the camera per instance, whose position and life are
+// the instanced attribute. The corners come from the vertex ids of a strip.
+const std::string kRenderVertexShader = std::string(
+    "#version 330 core\n"
+    "layout (location = 0) in vec4 position_life;\n") +
+    FrameUniforms::GlslDeclaration() +
+    "uniform float particle_size;\n"
+    "out vec2 corner;\n"
+    "out float life;\n"
+    "void main() {\n"
+    "  corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;\n"
+    "  vec3 right = vec3(view[0][0], view[1][0], view[2][0]);\n"
+    "  vec3 up = vec3(view[0][1], view[1][1], view[2][1]);\n"
+    "  vec3 position = position_life.xyz +\n"
+    "      particle_size * (corner.x * right + corner.y * up);\n"
+    "  life = position_life.w;\n"
+    "  gl_Position = view_projection * vec4(position, 1.0);\n"
+    "}\n";
+
+// Fades the particles from yellow to red as they age, and towards the edges
+// of their quads.
+const char kRenderFragmentShader[] =
+    "#version 330 core\n"
+    "in vec2 corner;\n"
+    "in float life;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "  float falloff = max(1.0 - dot(corner, corner), 0.0);\n"
+    "  vec3 hue = mix(vec3(1.0, 0.2, 0.05), vec3(1.0, 0.9, 0.4), life);\n"
+    "  color = vec4(hue * (falloff * life), 1.0);\n"
+    "}\n";
+
+// The CPU particles of a simulation step, as a structure of arrays, and the
+// interleaved positions and lives written for the draw.
+struct ParticleArrays {
+  float* x;
+  float* y;
+  float* z;
+  float* velocity_x;
+  float* velocity_y;
+  float* velocity_z;
+  float* life;
+  GLfloat* vertices;
+};
+
+// The constants of a simulation step.
+struct StepParameters {
+  float delta_time;
+  // The gravity times delta_time.
+  float velocity_step[3];
+  float life_step;
+  float floor_height;
+  float restitution;
+};
+
+// The kernels below step the particles in [begin, end) and return the index
+// of the first particle they did not step, since the SIMD kernels stop at the
+// last full register. The scalar kernel steps the remaining particles.
+
+int StepScalar(const StepParameters& step,
+               const ParticleArrays& particles,
+               const int begin,
+               const int end) {
+  for (int i = begin; i < end; ++i) {
+    const float velocity_x = particles.velocity_x[i] + step.velocity_step[0];
+    float velocity_y = particles.velocity_y[i] + step.velocity_step[1];
+    const float velocity_z = particles.velocity_z[i] + step.velocity_step[2];
+    const float x = particles.x[i] + velocity_x * step.delta_time;
+    float y = particles.y[i] + velocity_y * step.delta_time;
+    const float z = particles.z[i] + velocity_z * step.delta_time;
+    if (y < step.floor_height && velocity_y < 0.0f) {
+      y = step.floor_height;
+      velocity_y *= -step.restitution;
+    }
+    const float life = particles.life[i] - step.life_step;
+    particles.x[i] = x;
+    particles.y[i] = y;
+    particles.z[i] = z;
+    particles.velocity_x[i] = velocity_x;
+    particles.velocity_y[i] = velocity_y;
+    particles.velocity_z[i] = velocity_z;
+    particles.life[i] = life;
+    GLfloat* vertex = particles.vertices + kCpuParticleStride * i;
+    vertex[0] = x;
+    vertex[1] = y;
+    vertex[2] = z;
+    vertex[3] = life;
+  }
+  return end;
+}
+
+#if defined(WVU_HAS_SSE)
+int StepSse(const StepParameters& step,
+            const ParticleArrays& particles,
+            const int begin,
+            const int end) {
+  const __m128 delta_time = _mm_set1_ps(step.delta_time);
+  const __m128 velocity_step_x = _mm_set1_ps(step.velocity_step[0]);
+  const __m128 velocity_step_y = _mm_set1_ps(step.velocity_step[1]);
+  const __m128 velocity_step_z = _mm_set1_ps(step.velocity_step[2]);
+  const __m128 life_step = _mm_set1_ps(step.life_step);
+  const __m128 floor_height = _mm_set1_ps(step.floor_height);
+  const __m128 bounce_factor = _mm_set1_ps(-step.restitution);
+  const __m128 zero = _mm_setzero_ps();
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m128 velocity_x =
+        _mm_add_ps(_mm_loadu_ps(particles.velocity_x + i), velocity_step_x);
+    __m128 velocity_y =
+        _mm_add_ps(_mm_loadu_ps(particles.velocity_y + i), velocity_step_y);
+    const __m128 velocity_z =
+        _mm_add_ps(_mm_loadu_ps(particles.velocity_z + i), velocity_step_z);
+    __m128 x = _mm_add_ps(_mm_loadu_ps(particles.x + i),
+                          _mm_mul_ps(velocity_x, delta_time));
+    __m128 y = _mm_add_ps(_mm_loadu_ps(particles.y + i),
+                          _mm_mul_ps(velocity_y, delta_time));
+    __m128 z = _mm_add_ps(_mm_loadu_ps(particles.z + i),
+                          _mm_mul_ps(velocity_z, delta_time));
+    // The falling particles below the floor bounce.
+    const __m128 bounce = _mm_and_ps(_mm_cmplt_ps(y, floor_height),
+                                     _mm_cmplt_ps(velocity_y, zero));
+    y = _mm_or_ps(_mm_and_ps(bounce, floor_height), _mm_andnot_ps(bounce, y));
+    velocity_y = _mm_or_ps(
+        _mm_and_ps(bounce, _mm_mul_ps(velocity_y, bounce_factor)),
+        _mm_andnot_ps(bounce, velocity_y));
+    __m128 life = _mm_sub_ps(_mm_loadu_ps(particles.life + i), life_step);
+    _mm_storeu_ps(particles.x + i, x);
+    _mm_storeu_ps(particles.y + i, y);
+    _mm_storeu_ps(particles.z + i, z);
+    _mm_storeu_ps(particles.velocity_x + i, velocity_x);
+    _mm_storeu_ps(particles.velocity_y + i, velocity_y);
+    _mm_storeu_ps(particles.velocity_z + i, velocity_z);
+    _mm_storeu_ps(particles.life + i, life);
+    // Interleave the four particles for the vertex buffer.
+    _MM_TRANSPOSE4_PS(x, y, z, life);
+    GLfloat* vertices = particles.vertices + kCpuParticleStride * i;
+    _mm_storeu_ps(vertices, x);
+    _mm_storeu_ps(vertices + 4, y);
+    _mm_storeu_ps(vertices + 8, z);
+    _mm_storeu_ps(vertices + 12, life);
+  }
+  return i;
+}
+#endif  // WVU_HAS_SSE
+
+#if defined(WVU_HAS_AVX2)
+__attribute__((target("avx2,fma")))
+int StepAvx2(const StepParameters& step,
+             const ParticleArrays& particles,
+             const int begin,
+             const int end) {
+  const __m256 delta_time = _mm256_set1_ps(step.delta_time);
+  const __m256 velocity_step_x = _mm256_set1_ps(step.velocity_step[0]);
+  const __m256 velocity_step_y = _mm256_set1_ps(step.velocity_step[1]);
+  const __m256 velocity_step_z = _mm256_set1_ps(step.velocity_step[2]);
+  const __m256 life_step = _mm256_set1_ps(step.life_step);
+  const __m256 floor_height = _mm256_set1_ps(step.floor_height);
+  const __m256 bounce_factor = _mm256_set1_ps(-step.restitution);
+  const __m256 zero = _mm256_setzero_ps();
+  int i = begin;
+  for (; i + 8 <= end; i += 8) {
+    const __m256 velocity_x = _mm256_add_ps(
+        _mm256_loadu_ps(particles.velocity_x + i), velocity_step_x);
+    __m256 velocity_y = _mm256_add_ps(
+        _mm256_loadu_ps(particles.velocity_y + i), velocity_step_y);
+    const __m256 velocity_z = _mm256_add_ps(
+        _mm256_loadu_ps(particles.velocity_z + i), velocity_step_z);
+    const __m256 x = _mm256_fmadd_ps(velocity_x, delta_time,
+                                     _mm256_loadu_ps(particles.x + i));
+    __m256 y = _mm256_fmadd_ps(velocity_y, delta_time,
+                               _mm256_loadu_ps(particles.y + i));
+    const __m256 z = _mm256_fmadd_ps(velocity_z, delta_time,
+                                     _mm256_loadu_ps(particles.z + i));
+    // The falling particles below the floor bounce.
+    const __m256 bounce =
+        _mm256_and_ps(_mm256_cmp_ps(y, floor_height, _CMP_LT_OQ),
+                      _mm256_cmp_ps(velocity_y, zero, _CMP_LT_OQ));
+    y = _mm256_blendv_ps(y, floor_height, bounce);
+    velocity_y = _mm256_blendv_ps(
+        velocity_y, _mm256_mul_ps(velocity_y, bounce_factor), bounce);
+    const __m256 life =
+        _mm256_sub_ps(_mm256_loadu_ps(particles.life + i), life_step);
+    _mm256_storeu_ps(particles.x + i, x);
+    _mm256_storeu_ps(particles.y + i, y);
+    _mm256_storeu_ps(particles.z + i, z);
+    _mm256_storeu_ps(particles.velocity_x + i, velocity_x);
+    _mm256_storeu_ps(particles.velocity_y + i, velocity_y);
+    _mm256_storeu_ps(particles.velocity_z + i, velocity_z);
+    _mm256_storeu_ps(particles.life + i, life);
+    // Interleave the eight particles for the vertex buffer. The unpacks and
+    // shuffles transpose within the 128-bit lanes, which hold the particles
+    // 0-3 and 4-7, and the permutes gather the pairs of particles.
+    const __m256 xy_low = _mm256_unpacklo_ps(x, y);
+    const __m256 xy_high = _mm256_unpackhi_ps(x, y);
+    const __m256 zw_low = _mm256_unpacklo_ps(z, life);
+    const __m256 zw_high = _mm256_unpackhi_ps(z, life);
+    const __m256 particle_0 = _mm256_shuffle_ps(xy_low, zw_low, 0x44);
+    const __m256 particle_1 = _mm256_shuffle_ps(xy_low, zw_low, 0xee);
+    const __m256 particle_2 = _mm256_shuffle_ps(xy_high, zw_high, 0x44);
+    const __m256 particle_3 = _mm256_shuffle_ps(xy_high, zw_high, 0xee);
+    GLfloat* vertices = particles.vertices + kCpuParticleStride * i;
+    _mm256_storeu_ps(vertices,
+                     _mm256_permute2f128_ps(particle_0, particle_1, 0x20));
+    _mm256_storeu_ps(vertices + 8,
+                     _mm256_permute2f128_ps(particle_2, particle_3, 0x20));
+    _mm256_storeu_ps(vertices + 16,
+                     _mm256_permute2f128_ps(particle_0, particle_1, 0x31));
+    _mm256_storeu_ps(vertices + 24,
+                     _mm256_permute2f128_ps(particle_2, particle_3, 0x31));
+  }
+  return i;
+}
+#endif  // WVU_HAS_AVX2
+
+#if defined(WVU_HAS_NEON)
+int StepNeon(const StepParameters& step,
+             const ParticleArrays& particles,
+             const int begin,
+             const int end) {
+  const float32x4_t delta_time = vdupq_n_f32(step.delta_time);
+  const float32x4_t velocity_step_x = vdupq_n_f32(step.velocity_step[0]);
+  const float32x4_t velocity_step_y = vdupq_n_f32(step.velocity_step[1]);
+  const float32x4_t velocity_step_z = vdupq_n_f32(step.velocity_step[2]);
+  const float32x4_t life_step = vdupq_n_f32(step.life_step);
+  const float32x4_t floor_height = vdupq_n_f32(step.floor_height);
+  const float32x4_t bounce_factor = vdupq_n_f32(-step.restitution);
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const float32x4_t velocity_x =
+        vaddq_f32(vld1q_f32(particles.velocity_x + i), velocity_step_x);
+    float32x4_t velocity_y =
+        vaddq_f32(vld1q_f32(particles.velocity_y + i), velocity_step_y);
+    const float32x4_t velocity_z =
+        vaddq_f32(vld1q_f32(particles.velocity_z + i), velocity_step_z);
+    float32x4x4_t vertex;
+    vertex.val[0] =
+        vmlaq_f32(vld1q_f32(particles.x + i), velocity_x, delta_time);
+    vertex.val[1] =
+        vmlaq_f32(vld1q_f32(particles.y + i), velocity_y, delta_time);
+    vertex.val[2] =
+        vmlaq_f32(vld1q_f32(particles.z + i), velocity_z, delta_time);
+    // The falling particles below the floor bounce.
+    const uint32x4_t bounce = vandq_u32(vcltq_f32(vertex.val[1], floor_height),
+                                        vcltq_f32(velocity_y, zero));
+    vertex.val[1] = vbslq_f32(bounce, floor_height, vertex.val[1]);
+    velocity_y =
+        vbslq_f32(bounce, vmulq_f32(velocity_y, bounce_factor), velocity_y);
+    vertex.val[3] = vsubq_f32(vld1q_f32(particles.life + i), life_step);
+    vst1q_f32(particles.x + i, vertex.val[0]);
+    vst1q_f32(particles.y + i, vertex.val[1]);
+    vst1q_f32(particles.z + i, vertex.val[2]);
+    vst1q_f32(particles.velocity_x + i, velocity_x);
+    vst1q_f32(particles.velocity_y + i, velocity_y);
+    vst1q_f32(particles.velocity_z + i, velocity_z);
+    vst1q_f32(particles.life + i, vertex.val[3]);
+    // The interleaving store writes the four particles for the vertex buffer.
+    vst4q_f32(particles.vertices + kCpuParticleStride * i, vertex);
+  }
+  return i;
+}
+#endif  // WVU_HAS_NEON
+
+}  // namespace
+
+ParticleSystem::ParticleSystem()
+    : simulation_(GPU_PARTICLE_SIMULATION),
+      num_particles_(0),
+      frame_(0),
+      buffer_ids_{0, 0},
+      vertex_array_ids_{0, 0},
+      current_(0) {}
+
+ParticleSystem::~ParticleSystem() {
+  Reset();
+}
+
+bool ParticleSystem::GpuSimulationSupported() {
+  return (GLEW_VERSION_4_3 || GLEW_ARB_compute_shader) &&
+      (GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object);
+}
+
+bool ParticleSystem::Initialize(const int num_particles,
+                                const ParticleEmitter& emitter,
+                                const ParticleSimulation simulation,
+                                const FrameUniforms& frame_uniforms,
+                                std::string* error_info_log) {
+  if (buffer_ids_[0] != 0) {
+    *error_info_log = "The particle system is already initialized.";
+    return false;
+  }
+  if (num_particles <= 0) {
+    *error_info_log = "The particle system needs at least one particle.";
+    return false;
+  }
+  simulation_ = simulation == GPU_PARTICLE_SIMULATION &&
+      GpuSimulationSupported() ?
+      GPU_PARTICLE_SIMULATION : CPU_PARTICLE_SIMULATION;
+  num_particles_ = num_particles;
+  emitter_ = emitter;
+  frame_ = 0;
+  current_ = 0;
+  render_program_.LoadVertexShaderFromString(kRenderVertexShader);
+  render_program_.LoadFragmentShaderFromString(kRenderFragmentShader);
+  if (!render_program_.Create(error_info_log) ||
+      !frame_uniforms.Attach(&render_program_)) {
+    return false;
+  }
+  if (simulation_ == GPU_PARTICLE_SIMULATION &&
+      (!simulation_program_.LoadComputeShaderFromString(kSimulationShader) ||
+       !simulation_program_.Create(error_info_log))) {
+    return false;
+  }
+
+  // Every particle was emitted at a random age, and has moved under gravity
+  // since, ignoring the floor.
+  positions_.resize(num_particles_);
+  velocities_.resize(num_particles_);
+  lives_.resize(num_particles_);
+  for (int i = 0; i < num_particles_; ++i) {
+    const uint32_t seed = HashParticle(i);
+    lives_[i] = 1.0f - RandomUnit(seed + 3);
+    const float age = (1.0f - lives_[i]) * emitter_.lifetime;
+    const Eigen::Vector3f velocity = emitter_.velocity +
+        emitter_.velocity_spread * Eigen::Vector3f(
+            2.0f * RandomUnit(seed) - 1.0f, 2.0f * RandomUnit(seed + 1) - 1.0f,
+            2.0f * RandomUnit(seed + 2) - 1.0f);
+    const Eigen::Vector3f position = emitter_.position + velocity * age +
+        0.5f * age * age * emitter_.gravity;
+    positions_.x[i] = position.x();
+    positions_.y[i] = std::max(position.y(), emitter_.floor_height);
+    positions_.z[i] = position.z();
+    velocities_.x[i] = velocity.x() + emitter_.gravity.x() * age;
+    velocities_.y[i] = velocity.y() + emitter_.gravity.y() * age;
+    velocities_.z[i] = velocity.z() + emitter_.gravity.z() * age;
+  }
+
+  GlStateCache* gl_state = GlStateCache::Current();
+  BufferAllocator* allocator = BufferAllocator::Get();
+  const int num_buffers = simulation_ == GPU_PARTICLE_SIMULATION ? 2 : 1;
+  const int stride = simulation_ == GPU_PARTICLE_SIMULATION ?
+      kGpuParticleStride : kCpuParticleStride;
+  std::vector<GLfloat> particles(num_particles_ * stride, 0.0f);
+  for (int i = 0; i < num_particles_; ++i) {
+    GLfloat* particle = particles.data() + stride * i;
+    particle[0] = positions_.x[i];
+    particle[1] = positions_.y[i];
+    particle[2] = positions_.z[i];
+    particle[3] = lives_[i];
+    if (stride == kGpuParticleStride) {
+      particle[4] = velocities_.x[i];
+      particle[5] = velocities_.y[i];
+      particle[6] = velocities_.z[i];
+    }
+  }
+  glGenVertexArrays(num_buffers, vertex_array_ids_);
+  for (int i = 0; i < num_buffers; ++i) {
+    buffer_ids_[i] = allocator->CreateBuffer(
+        simulation_ == GPU_PARTICLE_SIMULATION ? STORAGE_DATA : VERTEX_DATA);
+    gl_state->BindVertexArray(vertex_array_ids_[i]);
+    gl_state->BindBuffer(GL_ARRAY_BUFFER, buffer_ids_[i]);
+    allocator->BufferData(buffer_ids_[i], GL_ARRAY_BUFFER,
+                          particles.size() * sizeof(particles[0]),
+                          particles.data(),
+                          simulation_ == GPU_PARTICLE_SIMULATION ?
+                          GL_DYNAMIC_COPY : GL_STREAM_DRAW);
+    // One position and life per instance.
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride * sizeof(GLfloat),
+                          nullptr);
+    glEnableVertexAttribArray(0);
+    glVertexAttribDivisor(0, 1);
+  }
+  gl_state->BindVertexArray(0);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+  // The GPU particles only live in the buffers.
+  if (simulation_ == GPU_PARTICLE_SIMULATION) {
+    positions_ = Vector3fArray();
+    velocities_ = Vector3fArray();
+    lives_ = std::vector<float>();
+  }
+  if (buffer_ids_[num_buffers - 1] == 0) {
+    *error_info_log = "Could not create the particle buffers.";
+    Reset();
+    return false;
+  }
+  return true;
+}
+
+void ParticleSystem::EmitParticle(const int i, GLfloat* vertices) {
+  const uint32_t seed = HashParticle(i ^ HashParticle(frame_));
+  positions_.x[i] = emitter_.position.x();
+  positions_.y[i] = emitter_.position.y();
+  positions_.z[i] = emitter_.position.z();
+  velocities_.x[i] = emitter_.velocity.x() +
+      emitter_.velocity_spread * (2.0f * RandomUnit(seed) - 1.0f);
+  velocities_.y[i] = emitter_.velocity.y() +
+      emitter_.velocity_spread * (2.0f * RandomUnit(seed + 1) - 1.0f);
+  velocities_.z[i] = emitter_.velocity.z() +
+      emitter_.velocity_spread * (2.0f * RandomUnit(seed + 2) - 1.0f);
+  // The life left past the end carries over, so that the particles emitted in
+  // a frame do not all line up.
+  lives_[i] += 1.0f;
+  if (lives_[i] <= 0.0f) lives_[i] = 1.0f;
+  GLfloat* vertex = vertices + kCpuParticleStride * i;
+  vertex[0] = positions_.x[i];
+  vertex[1] = positions_.y[i];
+  vertex[2] = positions_.z[i];
+  vertex[3] = lives_[i];
+}
+
+void ParticleSystem::SimulateRange(const int begin,
+                                   const int end,
+                                   const float delta_time,
+                                   GLfloat* vertices) {
+  StepParameters step;
+  step.delta_time = delta_time;
+  for (int j = 0; j < 3; ++j) {
+    step.velocity_step[j] = emitter_.gravity[j] * delta_time;
+  }
+  step.life_step = delta_time / std::max(emitter_.lifetime, 1e-6f);
+  step.floor_height = emitter_.floor_height;
+  step.restitution = emitter_.restitution;
+  ParticleArrays particles;
+  particles.x = positions_.x.data();
+  particles.y = positions_.y.data();
+  particles.z = positions_.z.data();
+  particles.velocity_x = velocities_.x.data();
+  particles.velocity_y = velocities_.y.data();
+  particles.velocity_z = velocities_.z.data();
+  particles.life = lives_.data();
+  particles.vertices = vertices;
+  int i = begin;
+  switch (ActiveSimdInstructionSet()) {
+#if defined(WVU_HAS_AVX2)
+    // The CPUs with AVX-512 also have AVX2 and FMA.
+    case AVX512:
+    case AVX2:
+      i = StepAvx2(step, particles, begin, end);
+      break;
+#endif
+#if defined(WVU_HAS_SSE)
+    case SSE:
+      i = StepSse(step, particles, begin, end);
+      break;
+#endif
+#if defined(WVU_HAS_NEON)
+    case NEON:
+      i = StepNeon(step, particles, begin, end);
+      break;
+#endif
+    default:
+      break;
+  }
+  StepScalar(step, particles, i, end);
+  // Few particles die in a frame, so they are emitted again one at a time.
+  for (i = begin; i < end; ++i) {
+    if (lives_[i] <= 0.0f) EmitParticle(i, vertices);
+  }
+}
+
+void ParticleSystem::Update(const float delta_time, JobSystem* job_system) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  if (buffer_ids_[0] == 0) return;
+  ++frame_;
+  if (simulation_ == GPU_PARTICLE_SIMULATION) {
+    simulation_program_.Use();
+    simulation_program_.SetUniform("num_particles",
+                                   static_cast<GLint>(num_particles_));
+    simulation_program_.SetUniform(
+        "frame_hash", static_cast<GLint>(HashParticle(frame_)));
+    simulation_program_.SetUniform("delta_time", delta_time);
+    simulation_program_.SetUniform(
+        "life_step", delta_time / std::max(emitter_.lifetime, 1e-6f));
+    simulation_program_.SetUniform("gravity", emitter_.gravity);
+    simulation_program_.SetUniform("emitter_position", emitter_.position);
+    simulation_program_.SetUniform("emitter_velocity", emitter_.velocity);
+    simulation_program_.SetUniform("velocity_spread",
+                                   emitter_.velocity_spread);
+    simulation_program_.SetUniform("floor_height", emitter_.floor_height);
+    simulation_program_.SetUniform("restitution", emitter_.restitution);
+    gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0,
+                             buffer_ids_[current_]);
+    gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1,
+                             buffer_ids_[1 - current_]);
+    // The draw reads the particles as vertex attributes, and the next step
+    // as storage.
+    simulation_program_.Dispatch(
+        (num_particles_ + kSimulationGroupSize - 1) / kSimulationGroupSize, 1,
+        1, GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    current_ = 1 - current_;
+    return;
+  }
+  // The jobs write the vertices straight into the buffer, whose previous
+  // storage is orphaned.
+  const GLsizeiptr size =
+      num_particles_ * kCpuParticleStride * sizeof(GLfloat);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, buffer_ids_[0]);
+  GLfloat* vertices = static_cast<GLfloat*>(glMapBufferRange(
+      GL_ARRAY_BUFFER, 0, size,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+  if (vertices != nullptr) {
+    const auto simulate = [&](const int begin, const int end) {
+      SimulateRange(begin, end, delta_time, vertices);
+    };
+    if (job_system != nullptr) {
+      job_system->ParallelFor(num_particles_, kSimulationGrainSize, simulate);
+    } else {
+      simulate(0, num_particles_);
+    }
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleSystem::Render() {
+  GlStateCache* gl_state = GlStateCache::Current();
+  if (buffer_ids_[0] == 0) return;
+  gl_state->SetCapability(GL_DEPTH_TEST, true);
+  gl_state->DepthMask(false);
+  gl_state->SetCapability(GL_CULL_FACE, false);
+  gl_state->SetCapability(GL_BLEND, true);
+  gl_state->BlendFunc(GL_ONE, GL_ONE);
+  render_program_.Use();
+  render_program_.SetUniform("particle_size", emitter_.particle_size);
+  gl_state->BindVertexArray(vertex_array_ids_[current_]);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, num_particles_);
+  gl_state->SetCapability(GL_BLEND, false);
+  gl_state->DepthMask(true);
+}
+
+void ParticleSystem::Reset() {
+  const int num_buffers = simulation_ == GPU_PARTICLE_SIMULATION ? 2 : 1;
+  if (vertex_array_ids_[0] != 0) {
+    GlStateCache::Current()->DeleteVertexArrays(num_buffers,
+                                                vertex_array_ids_);
+  }
+  vertex_array_ids_[0] = 0;
+  vertex_array_ids_[1] = 0;
+  for (GLuint& buffer_id : buffer_ids_) {
+    BufferAllocator::Get()->DeleteBuffer(&buffer_id);
+  }
+  num_particles_ = 0;
+  positions_ = Vector3fArray();
+  velocities_ = Vector3fArray();
+  lives_ = std::vector<float>();
+}
+
+}  // namespace wvu
@@ -0,0 +1,194 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_PARTICLE_SYSTEM_H_
+#define GLUTILS_PARTICLE_SYSTEM_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "assignment.h"
+#include "frame_uniforms.h"
+#include "job_system.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Where the particles are simulated.
+enum ParticleSimulation {
+  // In a compute shader, which needs OpenGL 4.3 or ARB_compute_shader and
+  // ARB_shader_storage_buffer_object.
+  GPU_PARTICLE_SIMULATION = 0,
+  // With the SIMD kernels on the threads of a JobSystem, uploading the
+  // positions every frame.
+  CPU_PARTICLE_SIMULATION
+};
+
+// A fountain emitting the particles, as in the particles example of GLFW.
+struct ParticleEmitter {
+  // The position the particles are emitted from, in world space.
+  Eigen::Vector3f position = Eigen::Vector3f::Zero();
+  // The mean initial velocity, and the largest deviation of each of its
+  // components.
+  Eigen::Vector3f velocity = Eigen::Vector3f(0.0f, 5.0f, 0.0f);
+  float velocity_spread = 1.0f;
+  Eigen::Vector3f gravity = Eigen::Vector3f(0.0f, -9.81f, 0.0f);
+  // The seconds a particle lives before it is emitted again.
+  float lifetime = 2.0f;
+  // The height of the floor the particles bounce on, and the fraction of
+  // their vertical speed they keep when they do.
+  float floor_height = -1.0f;
+  float restitution = 0.5f;
+  // The half width of the quads in world units.
+  float particle_size = 0.01f;
+};
+
+// This class simulates and draws a particle fountain. The particles fall under
+// gravity, bounce on a floor and are emitted again at the end of their life, at
+// a position and a velocity drawn from a hash of their index and the frame, so
+// both simulations emit the same way without any random state.
+//
+// On the GPU, a compute shader reads the particles from one shader storage
+// buffer and writes them into the other, and the buffers swap every frame, so
+// the simulation never waits for the draw of the previous frame still reading
+// its buffer. On the CPU, the particles are kept as a structure of arrays and
+// integrated with the SSE, AVX2 or NEON kernels of the CPU (see
+// ActiveSimdInstructionSet()), one range per job, which also write the
+// positions straight into the mapped vertex buffer. Either way, the particles
+// are drawn as camera-facing quads, one instance per particle reading its
+// position as an instanced attribute, blended additively.
+//
+// Example:
+//
+// wvu::ParticleSystem particles;
+// particles.Initialize(1 << 20, emitter, wvu::GPU_PARTICLE_SIMULATION,
+//                      frame_uniforms, &error_info_log);
+// while (...) {  // Rendering loop.
+//   particles.Update(delta_time, &job_system);
+//   ...  // Draw the opaque geometry.
+//   particles.Render();
+// }
+class ParticleSystem {
+ public:
+  ParticleSystem();
+  ~ParticleSystem();
+
+  // Creates the buffers and compiles the programs, falling back to the CPU
+  // simulation when the GPU one is not supported. The particles start at
+  // random ages, as if the emitter had been running for a lifetime. Returns
+  // true if successful.
+  // Parameters:
+  //   num_particles  The number of particles, all of them alive at any time.
+  //   emitter  The emitter of the particles.
+  //   simulation  Where to simulate the particles.
+  //   frame_uniforms  The uniforms of the camera, attached to the program
+  //     drawing the particles.
+  bool Initialize(const int num_particles,
+                  const ParticleEmitter& emitter,
+                  const ParticleSimulation simulation,
+                  const FrameUniforms& frame_uniforms,
+                  std::string* error_info_log);
+
+  // Advances the particles by delta_time seconds.
+  // Parameters:
+  //   delta_time  The seconds since the last update.
+  //   job_system  Runs the CPU simulation, or nullptr to run it on the calling
+  //     thread. Unused by the GPU simulation.
+  void Update(const float delta_time, JobSystem* job_system);
+
+  // Draws the particles after the opaque geometry. They are tested against
+  // its depths without writing theirs.
+  void Render();
+
+  // Deletes the buffers and the vertex arrays.
+  void Reset();
+
+  // Returns true if the context supports the GPU simulation.
+  static bool GpuSimulationSupported();
+
+  // Changes the emitter. The particles already emitted keep their motion.
+  void set_emitter(const ParticleEmitter& emitter) {
+    emitter_ = emitter;
+  }
+
+  const ParticleEmitter& emitter() const {
+    return emitter_;
+  }
+
+  // Returns where the particles are simulated, after the fallback.
+  ParticleSimulation simulation() const {
+    return simulation_;
+  }
+
+  int num_particles() const {
+    return num_particles_;
+  }
+
+ private:
+  // Integrates the CPU particles of [begin, end), writing the positions and
+  // the remaining lives into vertices.
+  void SimulateRange(const int begin,
+                     const int end,
+                     const float delta_time,
+                     GLfloat* vertices);
+
+  // Emits the CPU particle i again.
+  void EmitParticle(const int i, GLfloat* vertices);
+
+  ParticleSimulation simulation_;
+  int num_particles_;
+  ParticleEmitter emitter_;
+  // Number of the update, seeding the emission.
+  uint32_t frame_;
+  ShaderProgram simulation_program_;
+  ShaderProgram render_program_;
+  // The GPU simulation reads buffer current_ and writes the other one. The
+  // CPU simulation only uses the first.
+  GLuint buffer_ids_[2];
+  GLuint vertex_array_ids_[2];
+  int current_;
+  // The CPU particles. The lives are fractions of the lifetime left.
+  Vector3fArray positions_;
+  Vector3fArray velocities_;
+  std::vector<float> lives_;
+
+  ParticleSystem(const ParticleSystem&) = delete;
+  ParticleSystem& operator=(const ParticleSystem&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_PARTICLE_SYSTEM_H_
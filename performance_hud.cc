@@ -0,0 +1,340 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "performance_hud.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "shader_program.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+// Size of a font pixel in framebuffer pixels.
+constexpr float kFontPixelSize = 2.0f;
+// Advance of a character and of a line, in font pixels.
+constexpr float kCharacterAdvance = 4.0f;
+constexpr float kLineAdvance = 7.0f;
+// Margin of the panel, in framebuffer pixels.
+constexpr float kPanelMargin = 8.0f;
+// Size of a bar of the graph, and of the whole graph, in framebuffer pixels.
+constexpr float kGraphBarWidth = 2.0f;
+constexpr float kGraphHeight = 48.0f;
+// Frame time at the top of the graph, and budget of a 60 Hz frame.
+constexpr float kGraphMaxFrameTimeMs = 33.3f;
+constexpr float kFrameBudgetMs = 16.7f;
+// Number of lines of text of the panel.
+constexpr int kNumTextLines = 7;
+
+constexpr GLubyte kPanelColor[4] = {0, 0, 0, 160};
+constexpr GLubyte kTextColor[4] = {255, 255, 255, 255};
+constexpr GLubyte kFastFrameColor[4] = {64, 224, 64, 255};
+constexpr GLubyte kSlowFrameColor[4] = {240, 64, 64, 255};
+
+// A glyph of the font: five rows of three pixels, from the top. The bits 2, 1
+// and 0 of a row are its left, middle and right pixels.
+struct Glyph {
+  char character;
+  GLubyte rows[5];
+};
+
+const Glyph kGlyphs[] = {
+  {'0', {7, 5, 5, 5, 7}}, {'1', {2, 6, 2, 2, 7}}, {'2', {7, 1, 7, 4, 7}},
+  {'3', {7, 1, 7, 1, 7}}, {'4', {5, 5, 7, 1, 1}}, {'5', {7, 4, 7, 1, 7}},
+  {'6', {7, 4, 7, 5, 7}}, {'7', {7, 1, 1, 1, 1}}, {'8', {7, 5, 7, 5, 7}},
+  {'9', {7, 5, 7, 1, 7}}, {'A', {2, 5, 7, 5, 5}}, {'B', {6, 5, 6, 5, 6}},
+  {'C', {3, 4, 4, 4, 3}}, {'D', {6, 5, 5, 5, 6}}, {'E', {7, 4, 6, 4, 7}},
+  {'F', {7, 4, 6, 4, 4}}, {'G', {3, 4, 5, 5, 3}}, {'H', {5, 5, 7, 5, 5}},
+  {'I', {7, 2, 2, 2, 7}}, {'J', {1, 1, 1, 5, 2}}, {'K', {5, 5, 6, 5, 5}},
+  {'L', {4, 4, 4, 4, 7}}, {'M', {5, 7, 7, 5, 5}}, {'N', {6, 5, 5, 5, 5}},
+  {'O', {2, 5, 5, 5, 2}}, {'P', {6, 5, 6, 4, 4}}, {'Q', {2, 5, 5, 6, 3}},
+  {'R', {6, 5, 6, 5, 5}}, {'S', {3, 4, 2, 1, 6}}, {'T', {7, 2, 2, 2, 2}},
+  {'U', {5, 5, 5, 5, 7}}, {'V', {5, 5, 5, 5, 2}}, {'W', {5, 5, 7, 7, 5}},
+  {'X', {5, 5, 2, 5, 5}}, {'Y', {5, 5, 2, 2, 2}}, {'Z', {7, 1, 2, 4, 7}},
+  {'.', {0, 0, 0, 0, 2}}, {':', {0, 2, 0, 2, 0}}, {'/', {1, 1, 2, 4, 4}},
+  {'-', {0, 0, 7, 0, 0}}, {'%', {5, 1, 2, 4, 5}},
+};
+
+// Returns the glyph of a character, or nullptr if the font does not have it.
+const Glyph* FindGlyph(const char character) {
+  const char upper_character =
+      static_cast<char>(std::toupper(static_cast<unsigned char>(character)));
+  for (const Glyph& glyph : kGlyphs) {
+    if (glyph.character == upper_character) return &glyph;
+  }
+  return nullptr;
+}
+
+// Formats a number of bytes in megabytes.
+std::string FormatMegabytes(const int64_t bytes) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024.0));
+  return text;
+}
+
+const char kVertexShaderSource[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec2 position;\n"
+    "layout (location = 3) in vec4 color;\n"
+    "uniform mat4 projection;\n"
+    "out vec4 vertex_color;\n"
+    "void main() {\n"
+    "  gl_Position = projection * vec4(position, 0.0, 1.0);\n"
+    "  vertex_color = color;\n"
+    "}\n";
+
+const char kFragmentShaderSource[] =
+    "#version 330 core\n"
+    "in vec4 vertex_color;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "  color = vertex_color;\n"
+    "}\n";
+
+}  // namespace
+
+PerformanceHud::PerformanceHud()
+    : projection_location_(-1),
+      vertex_array_object_id_(0),
+      vertex_buffer_object_id_(0),
+      vertex_capacity_(0),
+      visible_(false),
+      next_frame_(0) {
+  std::fill(frame_times_ms_, frame_times_ms_ + kNumHudGraphFrames, 0.0f);
+}
+
+PerformanceHud::~PerformanceHud() {
+  if (vertex_array_object_id_ != 0) {
+    GlStateCache::Current()->DeleteVertexArrays(1, &vertex_array_object_id_);
+  }
+  BufferAllocator::Get()->DeleteBuffer(&vertex_buffer_object_id_);
+}
+
+bool PerformanceHud::Initialize(std::string* error_info_log) {
+  if (vertex_array_object_id_ != 0) return true;
+  shader_program_.LoadVertexShaderFromString(kVertexShaderSource);
+  shader_program_.LoadFragmentShaderFromString(kFragmentShaderSource);
+  if (!shader_program_.Create(error_info_log)) return false;
+  projection_location_ = shader_program_.GetUniformLocation("projection");
+
+  VertexLayout layout(sizeof(HudVertex));
+  layout.AddAttribute(POSITION, 2, GL_FLOAT, GL_FALSE,
+                      offsetof(HudVertex, position));
+  layout.AddAttribute(COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                      offsetof(HudVertex, color));
+  GlStateCache* gl_state = GlStateCache::Current();
+  vertex_buffer_object_id_ = BufferAllocator::Get()->CreateBuffer(VERTEX_DATA);
+  glGenVertexArrays(1, &vertex_array_object_id_);
+  gl_state->BindVertexArray(vertex_array_object_id_);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object_id_);
+  layout.SetAttributePointers();
+  gl_state->BindVertexArray(0);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+  if (vertex_array_object_id_ == 0 || vertex_buffer_object_id_ == 0) {
+    *error_info_log = "Could not create the buffers of the HUD.";
+    return false;
+  }
+  return true;
+}
+
+void PerformanceHud::AddFrame(const HudFrameStatistics& statistics) {
+  frame_times_ms_[next_frame_] = statistics.frame_time_ms;
+  next_frame_ = (next_frame_ + 1) % kNumHudGraphFrames;
+  last_frame_ = statistics;
+}
+
+void PerformanceHud::PanelSize(float* width, float* height) const {
+  // The timed draws follow a line of their total.
+  const int num_lines = kNumTextLines + (last_frame_.num_slowest_draws > 0 ?
+                                         1 + last_frame_.num_slowest_draws :
+                                         0);
+  *width = kNumHudGraphFrames * kGraphBarWidth + 2.0f * kPanelMargin;
+  *height = kGraphHeight + num_lines * kLineAdvance * kFontPixelSize +
+      2.0f * kPanelMargin;
+}
+
+void PerformanceHud::Draw(const int framebuffer_width,
+                          const int framebuffer_height) {
+  if (!visible_ || vertex_array_object_id_ == 0 || framebuffer_width <= 0 ||
+      framebuffer_height <= 0) {
+    return;
+  }
+  vertices_.clear();
+  const float line_height = kLineAdvance * kFontPixelSize;
+  float panel_width = 0.0f;
+  float panel_height = 0.0f;
+  PanelSize(&panel_width, &panel_height);
+  AddQuad(0.0f, 0.0f, panel_width, panel_height, kPanelColor);
+
+  // Frame time graph, from the oldest frame on the left.
+  const float graph_bottom = kPanelMargin + kGraphHeight;
+  for (int i = 0; i < kNumHudGraphFrames; ++i) {
+    const float frame_time_ms =
+        frame_times_ms_[(next_frame_ + i) % kNumHudGraphFrames];
+    const float height = kGraphHeight *
+        std::min(frame_time_ms / kGraphMaxFrameTimeMs, 1.0f);
+    AddQuad(kPanelMargin + i * kGraphBarWidth, graph_bottom - height,
+            kGraphBarWidth, height,
+            frame_time_ms > kFrameBudgetMs ? kSlowFrameColor : kFastFrameColor);
+  }
+
+  // Counters of the last frame.
+  char line[64];
+  float y = graph_bottom + 2.0f * kFontPixelSize;
+  std::snprintf(line, sizeof(line), "FRAME %.2f MS",
+                last_frame_.frame_time_ms);
+  AddText(line, kPanelMargin, y, kTextColor);
+  y += line_height;
+  std::snprintf(line, sizeof(line), "DRAWS %d", last_frame_.num_draws);
+  AddText(line, kPanelMargin, y, kTextColor);
+  y += line_height;
+  std::snprintf(line, sizeof(line), "TRIANGLES %lld",
+                static_cast<long long>(last_frame_.num_triangles));
+  AddText(line, kPanelMargin, y, kTextColor);
+  y += line_height;
+  std::snprintf(line, sizeof(line), "ELIDED %d/%d",
+                last_frame_.num_elided_state_changes,
+                last_frame_.num_state_changes);
+  AddText(line, kPanelMargin, y, kTextColor);
+  y += line_height;
+  if (last_frame_.num_gl_calls < 0) {
+    std::snprintf(line, sizeof(line), "GL CALLS -");
+  } else {
+    std::snprintf(line, sizeof(line), "GL CALLS %d %.2f MS",
+                  last_frame_.num_gl_calls, last_frame_.gl_call_time_ms);
+  }
+  AddText(line, kPanelMargin, y, kTextColor);
+  y += line_height;
+  AddText("BUFFERS " + FormatMegabytes(last_frame_.buffer_bytes),
+          kPanelMargin, y, kTextColor);
+  y += line_height;
+  AddText("GPU FREE " + (last_frame_.gpu_available_bytes < 0 ? "-" :
+                         FormatMegabytes(last_frame_.gpu_available_bytes)),
+          kPanelMargin, y, kTextColor);
+  if (last_frame_.num_slowest_draws > 0) {
+    y += line_height;
+    std::snprintf(line, sizeof(line), "DRAWS GPU %.2f MS",
+                  last_frame_.draws_gpu_ms);
+    AddText(line, kPanelMargin, y, kTextColor);
+  }
+  for (int i = 0; i < last_frame_.num_slowest_draws; ++i) {
+    const DrawTime& draw = last_frame_.slowest_draws[i];
+    y += line_height;
+    std::snprintf(line, sizeof(line), "DRAW %d OBJ %u %.2f MS", draw.draw,
+                  draw.object_id, draw.gpu_ms);
+    AddText(line, kPanelMargin, y, kTextColor);
+  }
+
+  // Upload the quads, orphaning the storage of the previous frame.
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object_id_);
+  const int num_vertices = vertices_.size();
+  if (num_vertices > vertex_capacity_) {
+    vertex_capacity_ = std::max(num_vertices, 2 * vertex_capacity_);
+  }
+  BufferAllocator::Get()->BufferData(vertex_buffer_object_id_, GL_ARRAY_BUFFER,
+                                     vertex_capacity_ * sizeof(HudVertex),
+                                     nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, num_vertices * sizeof(HudVertex),
+                  vertices_.data());
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // Maps the framebuffer pixels, from the top-left corner, to clip space.
+  Eigen::Matrix4f projection = Eigen::Matrix4f::Identity();
+  projection(0, 0) = 2.0f / framebuffer_width;
+  projection(1, 1) = -2.0f / framebuffer_height;
+  projection(0, 3) = -1.0f;
+  projection(1, 3) = 1.0f;
+  gl_state->SetCapability(GL_DEPTH_TEST, false);
+  gl_state->SetCapability(GL_CULL_FACE, false);
+  gl_state->SetCapability(GL_BLEND, true);
+  gl_state->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  gl_state->PolygonMode(GL_FILL);
+  shader_program_.Use();
+  shader_program_.SetUniform(projection_location_, projection);
+  gl_state->BindVertexArray(vertex_array_object_id_);
+  glDrawArrays(GL_TRIANGLES, 0, num_vertices);
+  gl_state->SetCapability(GL_BLEND, false);
+}
+
+void PerformanceHud::AddQuad(const float x,
+                             const float y,
+                             const float width,
+                             const float height,
+                             const GLubyte* color) {
+  const float corners[6][2] = {
+    {x, y}, {x, y + height}, {x + width, y},
+    {x + width, y}, {x, y + height}, {x + width, y + height}};
+  for (const float* corner : corners) {
+    HudVertex vertex;
+    vertex.position[0] = corner[0];
+    vertex.position[1] = corner[1];
+    std::copy(color, color + 4, vertex.color);
+    vertices_.push_back(vertex);
+  }
+}
+
+void PerformanceHud::AddText(const std::string& text,
+                             const float x,
+                             const float y,
+                             const GLubyte* color) {
+  // y is the top of the line.
+  float character_x = x;
+  for (const char character : text) {
+    const Glyph* glyph = FindGlyph(character);
+    if (glyph != nullptr) {
+      for (int row = 0; row < 5; ++row) {
+        for (int column = 0; column < 3; ++column) {
+          if ((glyph->rows[row] >> (2 - column) & 1) == 0) continue;
+          AddQuad(character_x + column * kFontPixelSize,
+                  y + row * kFontPixelSize, kFontPixelSize, kFontPixelSize,
+                  color);
+        }
+      }
+    }
+    character_x += kCharacterAdvance * kFontPixelSize;
+  }
+}
+
+}  // namespace wvu
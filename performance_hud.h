@@ -0,0 +1,165 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_PERFORMANCE_HUD_H_
+#define GLUTILS_PERFORMANCE_HUD_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "draw_timer.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Number of frames in the frame time graph of the HUD.
+constexpr int kNumHudGraphFrames = 120;
+// Number of the slowest draws listed by the HUD.
+constexpr int kNumHudDrawTimes = 5;
+
+// The counters of a frame shown by the HUD.
+struct HudFrameStatistics {
+  float frame_time_ms = 0.0f;
+  int num_draws = 0;
+  int64_t num_triangles = 0;
+  int num_state_changes = 0;
+  int num_elided_state_changes = 0;
+  // OpenGL calls of the frame and the CPU time spent in them, or -1 if the
+  // calls are not counted (see gl_call_counter.h).
+  int num_gl_calls = -1;
+  float gl_call_time_ms = 0.0f;
+  // Live buffer storage.
+  int64_t buffer_bytes = 0;
+  // Free video memory, or -1 if unknown (see QueryGpuMemoryInfo()).
+  int64_t gpu_available_bytes = -1;
+  // The slowest draws of a recent frame, slowest first, and the GPU time of
+  // all its draws, if the draws are timed (see draw_timer.h).
+  DrawTime slowest_draws[kNumHudDrawTimes];
+  int num_slowest_draws = 0;
+  float draws_gpu_ms = 0.0f;
+};
+
+// This class draws an overlay with the frame time graph and the counters of
+// the last frame in the top-left corner of the window. The text uses a
+// built-in 3x5 pixel font, and the glyph pixels, the graph bars and the
+// background are all quads of a single vertex buffer drawn with one
+// glDrawArrays() call, so the overlay costs one upload and one draw per frame.
+// The overlay disables depth testing and blends over the frame.
+//
+// Example:
+//
+// wvu::PerformanceHud hud;
+// hud.Initialize(&error_info_log);
+// while (...) {  // Rendering loop.
+//   RenderScene(...);
+//   hud.AddFrame(frame_statistics);
+//   hud.Draw(framebuffer_width, framebuffer_height);
+//   glfwSwapBuffers(window);
+// }
+class PerformanceHud {
+ public:
+  PerformanceHud();
+  ~PerformanceHud();
+
+  // Creates the program, the vertex array object and the vertex buffer.
+  // Returns true if successful.
+  bool Initialize(std::string* error_info_log);
+
+  // Records the counters of a frame. Frames are recorded while the overlay is
+  // hidden, so the graph is complete when it is shown.
+  void AddFrame(const HudFrameStatistics& statistics);
+
+  // Draws the overlay over the framebuffer, if visible.
+  void Draw(const int framebuffer_width, const int framebuffer_height);
+
+  // Returns the size in pixels of the panel of the overlay, in the top-left
+  // corner of the framebuffer. The panel grows with the timed draws of the
+  // last frame.
+  void PanelSize(float* width, float* height) const;
+
+  void set_visible(const bool visible) {
+    visible_ = visible;
+  }
+
+  bool visible() const {
+    return visible_;
+  }
+
+  // Returns the number of quads of the last draw.
+  int num_quads() const {
+    return vertices_.size() / 6;
+  }
+
+ private:
+  // A vertex of the overlay, in framebuffer pixels from the top-left corner.
+  struct HudVertex {
+    GLfloat position[2];
+    GLubyte color[4];
+  };
+
+  // Appends a quad of the given color.
+  void AddQuad(const float x,
+               const float y,
+               const float width,
+               const float height,
+               const GLubyte* color);
+
+  // Appends the quads of the pixels of a line of text. Lowercase letters are
+  // drawn as uppercase, and characters without a glyph as spaces.
+  void AddText(const std::string& text,
+               const float x,
+               const float y,
+               const GLubyte* color);
+
+  ShaderProgram shader_program_;
+  GLint projection_location_;
+  GLuint vertex_array_object_id_;
+  GLuint vertex_buffer_object_id_;
+  // Number of vertices the vertex buffer storage can hold.
+  int vertex_capacity_;
+  bool visible_;
+  // Frame times in a circular buffer, with the next frame at next_frame_.
+  float frame_times_ms_[kNumHudGraphFrames];
+  int next_frame_;
+  HudFrameStatistics last_frame_;
+  std::vector<HudVertex> vertices_;
+
+  PerformanceHud(const PerformanceHud&) = delete;
+  PerformanceHud& operator=(const PerformanceHud&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_PERFORMANCE_HUD_H_
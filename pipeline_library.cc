@@ -0,0 +1,148 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "pipeline_library.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "offscreen_framebuffer.h"
+#include "render_device.h"
+
+namespace wvu {
+namespace {
+
+// Size in pixels of the framebuffer of the pre-warm draws.
+constexpr int kPrewarmFramebufferSize = 4;
+
+}  // namespace
+
+PipelineLibrary::PipelineLibrary(RenderDevice* device)
+    : device_(device), num_prewarmed_(0) {}
+
+PipelineLibrary::~PipelineLibrary() {
+  Reset();
+}
+
+RenderPipelineHandle PipelineLibrary::Register(
+    const std::string& name,
+    const RenderPipelineDescription& description,
+    std::string* error_info_log) {
+  if (handles_.count(name) != 0) {
+    *error_info_log = "The pipeline " + name + " is already registered.";
+    return kInvalidRenderHandle;
+  }
+  const RenderPipelineHandle pipeline =
+      device_->CreatePipeline(description, error_info_log);
+  if (pipeline == kInvalidRenderHandle) {
+    *error_info_log = "The pipeline " + name + " failed: " + *error_info_log;
+    return kInvalidRenderHandle;
+  }
+  handles_[name] = pipeline;
+  pipelines_.push_back(pipeline);
+  strides_.push_back(description.vertex_layout.stride());
+  statistics_.num_pipelines = pipelines_.size();
+  return pipeline;
+}
+
+RenderPipelineHandle PipelineLibrary::Find(const std::string& name) const {
+  const auto it = handles_.find(name);
+  return it == handles_.end() ? kInvalidRenderHandle : it->second;
+}
+
+bool PipelineLibrary::Prewarm(const int num_samples,
+                              std::string* error_info_log) {
+  const std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  const int num_pipelines = pipelines_.size();
+  statistics_.num_prewarmed = num_pipelines - num_prewarmed_;
+  if (statistics_.num_prewarmed == 0) {
+    statistics_.prewarm_ms = 0.0;
+    return true;
+  }
+  OffscreenFramebuffer framebuffer;
+  if (!framebuffer.Initialize(kPrewarmFramebufferSize,
+                              kPrewarmFramebufferSize, num_samples,
+                              error_info_log)) {
+    return false;
+  }
+  // Three vertices of zeros make a degenerate triangle whatever the layout:
+  // it runs the vertex shader without covering any pixel.
+  const int max_stride =
+      *std::max_element(strides_.begin() + num_prewarmed_, strides_.end());
+  const std::vector<GLubyte> zeros(3 * std::max(max_stride, 1), 0);
+  const RenderBufferHandle vertices = device_->CreateBuffer(
+      RENDER_VERTEX_BUFFER, zeros.size(), zeros.data(), false);
+  if (vertices == kInvalidRenderHandle) {
+    *error_info_log = "Could not create the pre-warm vertex buffer.";
+    return false;
+  }
+  RenderPassDescription pass;
+  pass.target = framebuffer.framebuffer_id();
+  pass.width = framebuffer.width();
+  pass.height = framebuffer.height();
+  CommandList command_list;
+  command_list.BeginPass(pass);
+  command_list.BindVertexBuffer(vertices, 0);
+  for (int i = num_prewarmed_; i < num_pipelines; ++i) {
+    command_list.BindPipeline(pipelines_[i]);
+    command_list.Draw(3, 0);
+  }
+  command_list.EndPass();
+  device_->Submit(&command_list, 1);
+  // The compilations finish with the draws.
+  glFinish();
+  device_->DestroyBuffer(vertices);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  num_prewarmed_ = num_pipelines;
+  statistics_.prewarm_ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - begin).count();
+  return true;
+}
+
+void PipelineLibrary::Reset() {
+  for (const RenderPipelineHandle pipeline : pipelines_) {
+    device_->DestroyPipeline(pipeline);
+  }
+  handles_.clear();
+  pipelines_.clear();
+  strides_.clear();
+  num_prewarmed_ = 0;
+  statistics_ = PipelineLibraryStatistics();
+}
+
+}  // namespace wvu
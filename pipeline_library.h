@@ -0,0 +1,120 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_PIPELINE_LIBRARY_H_
+#define GLUTILS_PIPELINE_LIBRARY_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "render_device.h"
+
+namespace wvu {
+// Counters of a PipelineLibrary.
+struct PipelineLibraryStatistics {
+  int num_pipelines = 0;
+  // Pipelines drawn by the last Prewarm(), and its duration, including the
+  // wait for the GPU.
+  int num_prewarmed = 0;
+  double prewarm_ms = 0.0;
+};
+
+// This class holds the pipelines of the materials of an application, i.e.,
+// their programs, blend, depth and raster state and vertex layouts,
+// registered up front by name and immutable afterwards. Drivers compile the
+// programs for the state they are drawn with, often not before the first
+// draw, so the first frame showing a material hitches. Prewarm() draws every
+// pipeline not drawn yet once, with degenerate triangles, into a tiny
+// offscreen framebuffer and waits for the GPU, so that these compilations
+// happen at startup instead. The framebuffer should have the formats and
+// samples of the real render targets, which select the compiled code too.
+//
+// Example:
+//
+// wvu::PipelineLibrary pipelines(device.get());
+// for (const Material& material : materials) {
+//   if (pipelines.Register(material.name, material.pipeline,
+//                          &error_info_log) == wvu::kInvalidRenderHandle) {
+//     ...
+//   }
+// }
+// if (!pipelines.Prewarm(0, &error_info_log)) { ... }
+// ...
+// command_list.BindPipeline(pipelines.Find("opaque"));
+class PipelineLibrary {
+ public:
+  // The device is not owned, and must outlive the library.
+  explicit PipelineLibrary(RenderDevice* device);
+  ~PipelineLibrary();
+
+  // Creates the pipeline of the description under the name. Returns its
+  // handle, or kInvalidRenderHandle and the reason in error_info_log if the
+  // name is taken or the pipeline does not compile.
+  RenderPipelineHandle Register(const std::string& name,
+                                const RenderPipelineDescription& description,
+                                std::string* error_info_log);
+
+  // Returns the pipeline registered under the name, or kInvalidRenderHandle.
+  RenderPipelineHandle Find(const std::string& name) const;
+
+  // Draws the pipelines registered since the last call once into a
+  // framebuffer of num_samples samples per pixel, or single-sampled if 0, and
+  // waits for the draws to complete. Returns true if successful.
+  bool Prewarm(const int num_samples, std::string* error_info_log);
+
+  // Destroys the pipelines.
+  void Reset();
+
+  PipelineLibraryStatistics statistics() const {
+    return statistics_;
+  }
+
+ private:
+  RenderDevice* device_;
+  std::unordered_map<std::string, RenderPipelineHandle> handles_;
+  // The pipelines in the order of registration, and their vertex strides.
+  std::vector<RenderPipelineHandle> pipelines_;
+  std::vector<int> strides_;
+  // The number of pipelines already pre-warmed, from the first.
+  int num_prewarmed_;
+  PipelineLibraryStatistics statistics_;
+
+  PipelineLibrary(const PipelineLibrary&) = delete;
+  PipelineLibrary& operator=(const PipelineLibrary&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_PIPELINE_LIBRARY_H_
@@ -0,0 +1,234 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "pose_batch_renderer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "gpu_mesh.h"
+#include "instance_buffer.h"
+#include "offscreen_framebuffer.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Floats of a 4x4 matrix.
+constexpr int kMatrixSize = 16;
+
+typedef Eigen::Matrix<float, 4, 4, Eigen::RowMajor> RowMajorMatrix4f;
+
+// Bytes of the uniform buffer of the poses of a draw.
+constexpr GLsizeiptr kPosesBufferSize =
+    kMaxCameraPosesPerDraw * kMatrixSize * sizeof(GLfloat);
+
+// Each instance draws the mesh from the pose of its tile, and maps the clip
+// coordinates of the pose into the tile. The clip distances discard what lies
+// outside the view of the pose, which would otherwise cover the neighboring
+// tiles. The size of the array is kMaxCameraPosesPerDraw.
+const char kVertexShaderSource[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "out vec3 model_position;\n"
+    "uniform mat4 model;\n"
+    "uniform int first_tile;\n"
+    "uniform int tiles_per_row;\n"
+    "uniform int num_tile_rows;\n"
+    "layout (std140) uniform CameraPoses {\n"
+    "  mat4 view_projections[256];\n"
+    "};\n"
+    "\n"
+    "void main() {\n"
+    "  model_position = position;\n"
+    "  vec4 clip =\n"
+    "      view_projections[gl_InstanceID] * model * vec4(position, 1.0);\n"
+    "  gl_ClipDistance[0] = clip.w + clip.x;\n"
+    "  gl_ClipDistance[1] = clip.w - clip.x;\n"
+    "  gl_ClipDistance[2] = clip.w + clip.y;\n"
+    "  gl_ClipDistance[3] = clip.w - clip.y;\n"
+    "  int tile = first_tile + gl_InstanceID;\n"
+    "  vec2 cell = vec2(tile % tiles_per_row, tile / tiles_per_row);\n"
+    "  vec2 scale = 1.0 / vec2(tiles_per_row, num_tile_rows);\n"
+    "  clip.xy = (clip.xy + clip.w) * scale +\n"
+    "      (2.0 * cell * scale - 1.0) * clip.w;\n"
+    "  gl_Position = clip;\n"
+    "}\n";
+
+// Number of clip distances of the vertex shader.
+constexpr int kNumClipDistances = 4;
+
+}  // namespace
+
+bool ReadCameraPoses(const std::string& filepath,
+                     CameraPoses* poses,
+                     std::string* error_info_log) {
+  std::ifstream in(filepath);
+  if (!in.is_open()) {
+    *error_info_log = "Could not open " + filepath;
+    return false;
+  }
+  std::vector<float> values;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(in, line)) {
+    ++line_number;
+    const size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') continue;
+    std::istringstream numbers(line);
+    float value;
+    while (numbers >> value) values.push_back(value);
+    if (!numbers.eof()) {
+      *error_info_log = filepath + ":" + std::to_string(line_number) +
+          ": Expected numbers.";
+      return false;
+    }
+  }
+  if (values.size() % kMatrixSize != 0) {
+    *error_info_log = filepath + ": The number of values, " +
+        std::to_string(values.size()) + ", is not a multiple of 16.";
+    return false;
+  }
+  poses->resize(values.size() / kMatrixSize);
+  for (size_t i = 0; i < poses->size(); ++i) {
+    // The file lists the rows, while Eigen stores the columns.
+    (*poses)[i] = Eigen::Map<const RowMajorMatrix4f>(
+        values.data() + i * kMatrixSize);
+  }
+  return true;
+}
+
+PoseBatchRenderer::PoseBatchRenderer()
+    : poses_buffer_id_(0), tiles_per_row_(0), num_tile_rows_(0),
+      num_draws_(0), model_location_(-1), first_tile_location_(-1),
+      clear_color_{0.0f, 0.0f, 0.0f, 1.0f} {}
+
+PoseBatchRenderer::~PoseBatchRenderer() {
+  BufferAllocator::Get()->DeleteBuffer(&poses_buffer_id_);
+}
+
+bool PoseBatchRenderer::Initialize(const int tile_width,
+                                   const int tile_height,
+                                   const int tiles_per_row,
+                                   const int num_tile_rows,
+                                   const std::string& fragment_shader_src,
+                                   std::string* error_info_log) {
+  if (tiles_per_row <= 0 || num_tile_rows <= 0) {
+    *error_info_log = "The atlas needs at least one tile.";
+    return false;
+  }
+  if (!atlas_.Initialize(tile_width * tiles_per_row,
+                         tile_height * num_tile_rows, error_info_log)) {
+    return false;
+  }
+  tiles_per_row_ = tiles_per_row;
+  num_tile_rows_ = num_tile_rows;
+  shader_program_.LoadVertexShaderFromString(kVertexShaderSource);
+  shader_program_.LoadFragmentShaderFromString(fragment_shader_src);
+  if (!shader_program_.Create(error_info_log) ||
+      !shader_program_.BindUniformBlock("CameraPoses",
+                                        kCameraPosesBindingPoint) ||
+      !shader_program_.Use()) {
+    return false;
+  }
+  model_location_ = shader_program_.GetUniformLocation("model");
+  first_tile_location_ = shader_program_.GetUniformLocation("first_tile");
+  shader_program_.SetUniform("tiles_per_row", tiles_per_row_);
+  shader_program_.SetUniform("num_tile_rows", num_tile_rows_);
+
+  BufferAllocator* allocator = BufferAllocator::Get();
+  poses_buffer_id_ = allocator->CreateBuffer(UNIFORM_DATA);
+  GlStateCache::Current()->BindBuffer(GL_UNIFORM_BUFFER, poses_buffer_id_);
+  allocator->BufferData(poses_buffer_id_, GL_UNIFORM_BUFFER, kPosesBufferSize,
+                        nullptr, GL_STREAM_DRAW);
+  pose_data_.resize(kMaxCameraPosesPerDraw * kMatrixSize);
+  return poses_buffer_id_ != 0;
+}
+
+bool PoseBatchRenderer::Render(const GpuMesh& mesh,
+                               const int first_index,
+                               const int num_indices,
+                               const Eigen::Matrix4f& model,
+                               const Eigen::Matrix4f& projection,
+                               const Eigen::Matrix4f* views,
+                               const int num_poses) {
+  num_draws_ = 0;
+  if (num_poses > num_tiles() || !shader_program_.Use()) return false;
+  GlStateCache* gl_state = GlStateCache::Current();
+  atlas_.Bind();
+  gl_state->ClearColor(clear_color_[0], clear_color_[1], clear_color_[2],
+                       clear_color_[3]);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  gl_state->SetCapability(GL_DEPTH_TEST, true);
+  gl_state->SetCapability(GL_CULL_FACE, mesh.closed());
+  for (int i = 0; i < kNumClipDistances; ++i) glEnable(GL_CLIP_DISTANCE0 + i);
+  shader_program_.SetUniform(model_location_, model);
+  gl_state->BindBufferBase(GL_UNIFORM_BUFFER, kCameraPosesBindingPoint,
+                           poses_buffer_id_);
+  BufferAllocator* allocator = BufferAllocator::Get();
+  for (int first_pose = 0; first_pose < num_poses;
+       first_pose += kMaxCameraPosesPerDraw) {
+    const int num_draw_poses =
+        std::min(num_poses - first_pose, kMaxCameraPosesPerDraw);
+    for (int i = 0; i < num_draw_poses; ++i) {
+      const Eigen::Matrix4f view_projection =
+          projection * views[first_pose + i];
+      std::memcpy(pose_data_.data() + i * kMatrixSize, view_projection.data(),
+                  kMatrixSize * sizeof(GLfloat));
+    }
+    // Orphan the storage, so the upload does not wait for the previous draw.
+    gl_state->BindBuffer(GL_UNIFORM_BUFFER, poses_buffer_id_);
+    allocator->BufferData(poses_buffer_id_, GL_UNIFORM_BUFFER,
+                          kPosesBufferSize, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0,
+                    num_draw_poses * kMatrixSize * sizeof(GLfloat),
+                    pose_data_.data());
+    shader_program_.SetUniform(first_tile_location_, first_pose);
+    DrawRangeInstanced(mesh, first_index, num_indices, num_draw_poses);
+    ++num_draws_;
+  }
+  for (int i = 0; i < kNumClipDistances; ++i) glDisable(GL_CLIP_DISTANCE0 + i);
+  gl_state->SetCapability(GL_DEPTH_TEST, false);
+  gl_state->SetCapability(GL_CULL_FACE, false);
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,171 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_POSE_BATCH_RENDERER_H_
+#define GLUTILS_POSE_BATCH_RENDERER_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include "gpu_mesh.h"
+#include "offscreen_framebuffer.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Uniform buffer binding point of the camera poses of a PoseBatchRenderer.
+constexpr GLuint kCameraPosesBindingPoint = 1;
+
+// Poses drawn by one instanced draw. Their matrices fill 16 KiB, the smallest
+// GL_MAX_UNIFORM_BLOCK_SIZE that OpenGL guarantees.
+constexpr int kMaxCameraPosesPerDraw = 256;
+
+// Contiguous array of view matrices. Eigen requires an aligned allocator for
+// the vectorizable Matrix4f.
+typedef std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >
+    CameraPoses;
+
+// Reads view matrices from a text file: 16 numbers per pose, the rows of the
+// matrix one after the other, separated by white space. Lines starting with
+// '#' are comments. Returns true if successful.
+bool ReadCameraPoses(const std::string& filepath,
+                     CameraPoses* poses,
+                     std::string* error_info_log);
+
+// This class renders a mesh from many camera poses into the tiles of an atlas
+// framebuffer. Instead of one pass per pose, the view-projection matrices of
+// up to kMaxCameraPosesPerDraw poses are uploaded into a uniform buffer, and a
+// single instanced draw renders all of them: each instance transforms the mesh
+// with the matrix of its pose and moves the result into the tile of the pose.
+// Clip distances keep each instance inside its tile. The program and the
+// vertex array are bound once per call to Render().
+//
+// The vertex shader reads the positions from attribute location 0. The
+// fragment shader is given to Initialize(), and may read the position in
+// model space from
+//   in vec3 model_position;
+//
+// Example:
+//
+// wvu::PoseBatchRenderer renderer;
+// renderer.Initialize(256, 256, 8, 8, fragment_shader_src, &error_info_log);
+// for (int i = 0; i < poses.size(); i += renderer.num_tiles()) {
+//   const int num_poses = std::min(renderer.num_tiles(), poses.size() - i);
+//   renderer.Render(mesh, 0, mesh.num_indices(), model, projection,
+//                   poses.data() + i, num_poses);
+//   ...  // Read renderer.atlas() back.
+// }
+class PoseBatchRenderer {
+ public:
+  PoseBatchRenderer();
+  ~PoseBatchRenderer();
+
+  // Creates the atlas, the program and the uniform buffer of the poses.
+  // Returns true if successful.
+  // Parameters:
+  //   tile_width  The width of a tile in pixels.
+  //   tile_height  The height of a tile in pixels.
+  //   tiles_per_row  The number of tiles of a row of the atlas.
+  //   num_tile_rows  The number of rows of tiles of the atlas.
+  //   fragment_shader_src  The source of the fragment shader.
+  //   error_info_log  The reason of the failure.
+  bool Initialize(const int tile_width,
+                  const int tile_height,
+                  const int tiles_per_row,
+                  const int num_tile_rows,
+                  const std::string& fragment_shader_src,
+                  std::string* error_info_log);
+
+  // Clears the atlas and renders a range of the indices of the mesh from
+  // num_poses poses into the tiles [0, num_poses), from the bottom left tile
+  // on, row by row, with the depth test, which is disabled afterwards. Returns
+  // false if there are more poses than tiles.
+  // Parameters:
+  //   mesh  The mesh to draw.
+  //   first_index  The first index of the range to draw.
+  //   num_indices  The number of indices to draw.
+  //   model  The model matrix of the mesh.
+  //   projection  The projection matrix of every pose.
+  //   views  The num_poses view matrices.
+  //   num_poses  The number of poses.
+  bool Render(const GpuMesh& mesh,
+              const int first_index,
+              const int num_indices,
+              const Eigen::Matrix4f& model,
+              const Eigen::Matrix4f& projection,
+              const Eigen::Matrix4f* views,
+              const int num_poses);
+
+  // Sets the color the atlas is cleared to, opaque black by default, e.g., a
+  // transparent color for the fragment shaders writing a coverage.
+  void set_clear_color(const Eigen::Vector4f& clear_color) {
+    for (int i = 0; i < 4; ++i) clear_color_[i] = clear_color[i];
+  }
+
+  // Returns the framebuffer holding the tiles. It stays bound after Render().
+  const OffscreenFramebuffer& atlas() const {
+    return atlas_;
+  }
+
+  int num_tiles() const {
+    return tiles_per_row_ * num_tile_rows_;
+  }
+
+  // Returns the number of draws issued by the last call to Render().
+  int num_draws() const {
+    return num_draws_;
+  }
+
+ private:
+  OffscreenFramebuffer atlas_;
+  ShaderProgram shader_program_;
+  GLuint poses_buffer_id_;
+  int tiles_per_row_;
+  int num_tile_rows_;
+  int num_draws_;
+  GLint model_location_;
+  GLint first_tile_location_;
+  GLfloat clear_color_[4];
+  // View-projection matrices of the poses of a draw.
+  std::vector<GLfloat> pose_data_;
+
+  PoseBatchRenderer(const PoseBatchRenderer&) = delete;
+  PoseBatchRenderer& operator=(const PoseBatchRenderer&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_POSE_BATCH_RENDERER_H_
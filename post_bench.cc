@@ -0,0 +1,331 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+// Benchmarks the GPU cost of the ambient occlusion of PostProcessing at several
+// resolution scales, and writes the milliseconds of the post-processing of a
+// frame as JSON, so that the quality of each scale can be weighed against its
+// cost on each GPU. The frames show a procedural city of boxes, drawn by a
+// full-screen triangle that writes its depth, so every pixel has occluders.
+// A chain of only the tone mapping is measured first, and the cost of the
+// occlusion at each scale is the difference with it.
+//
+// Example:
+//
+// ./bin/post_bench --resolution_scales=1,0.5,0.25 --output_file=results.json
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <Eigen/Core>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "frame_profiler.h"
+#include "post_processing.h"
+#include "shader_program.h"
+#include "transforms.h"
+
+// Use the right namespace for google flags (gflags).
+#ifdef GFLAGS_NAMESPACE_GOOGLE
+#define CS470_GFLAGS_NAMESPACE google
+#else
+#define CS470_GFLAGS_NAMESPACE gflags
+#endif
+
+DEFINE_int32(width, 1920, "Width of the frames.");
+DEFINE_int32(height, 1080, "Height of the frames.");
+DEFINE_int32(num_frames, 300, "Frames measured per resolution scale.");
+DEFINE_int32(warmup_frames, 30,
+             "Frames processed per resolution scale before the measured "
+             "ones.");
+DEFINE_string(resolution_scales, "1,0.5,0.25",
+              "Comma-separated resolution scales of the ambient occlusion.");
+DEFINE_double(occlusion_radius, 0.5,
+              "Radius of the ambient occlusion in view space units.");
+DEFINE_string(output_file, "",
+              "JSON file of the results. Empty writes them to stdout.");
+
+// Annonymous namespace for constants and helper functions.
+namespace {
+// Vertical field of view of the camera, in radians.
+constexpr float kFieldOfView = 1.0472f;
+
+// A triangle covering the frame, whose vertices come from gl_VertexID.
+const std::string vertex_shader_src =
+    "#version 430 core\n"
+    "out vec2 uv;\n"
+    "void main() {\n"
+    "uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+    "gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+// Boxes of random heights on a grid, seen from above at a slant, with the
+// depth of a perspective projection between the planes at 1 and 100.
+const std::string fragment_shader_src =
+    "#version 430 core\n"
+    "in vec2 uv;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "vec2 cell = floor(uv * vec2(32.0, 18.0));\n"
+    "float height = fract(sin(dot(cell, vec2(12.9898, 78.233))) * 43758.5);\n"
+    "float view_distance = mix(4.0, 40.0, uv.y) - 2.0 * height;\n"
+    "float near = 1.0;\n"
+    "float far = 100.0;\n"
+    "gl_FragDepth = (far / (far - near)) * (1.0 - near / view_distance);\n"
+    "color = vec4(vec3(0.5 + 0.5 * height), 1.0);\n"
+    "}\n";
+
+// Measurements of a resolution scale, or of the chain without occlusion if
+// the scale is 0.
+struct ScaleResult {
+  float scale = 0.0f;
+  bool failed = false;
+  int num_dispatches = 0;
+  wvu::ProfileScopeStatistics gpu;
+};
+
+// Parses the comma-separated values of --resolution_scales.
+bool ParseScales(const std::string& values, std::vector<float>* scales) {
+  std::stringstream stream(values);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    const float scale = std::atof(value.c_str());
+    if (scale <= 0.0f || scale > 1.0f) {
+      LOG(ERROR) << "Invalid resolution scale " << value;
+      return false;
+    }
+    scales->push_back(scale);
+  }
+  return !scales->empty();
+}
+
+// Processes the warm up and the measured frames of the chain.
+ScaleResult RunScale(const float scale,
+                     const Eigen::Matrix4f& projection,
+                     const wvu::ShaderProgram& scene_program) {
+  ScaleResult result;
+  result.scale = scale;
+  std::ostringstream chain;
+  if (scale > 0.0f) {
+    chain << "ambient_occlusion radius=" << FLAGS_occlusion_radius
+          << " scale=" << scale << "; ";
+  }
+  chain << "tone_mapping";
+  std::vector<wvu::PostEffect> effects;
+  std::string error_info_log;
+  wvu::PostProcessing post_processing;
+  if (!wvu::ParsePostEffects(chain.str(), &effects, &error_info_log) ||
+      !post_processing.Initialize(effects, FLAGS_width, FLAGS_height,
+                                  &error_info_log)) {
+    LOG(ERROR) << "Could not set up " << chain.str() << ": "
+               << error_info_log;
+    result.failed = true;
+    return result;
+  }
+  post_processing.SetProjection(projection);
+  // The profiler keeps the samples of every measured frame.
+  wvu::FrameProfiler profiler(std::max(FLAGS_num_frames, 1));
+  const int gpu_scope = profiler.AddGpuScope("post_processing");
+  for (int frame = 0; frame < FLAGS_warmup_frames + FLAGS_num_frames;
+       ++frame) {
+    const bool measured = frame >= FLAGS_warmup_frames;
+    post_processing.Bind();
+    glClear(GL_DEPTH_BUFFER_BIT);
+    scene_program.Use();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    if (measured) {
+      profiler.BeginFrame();
+      profiler.BeginScope(gpu_scope);
+    }
+    post_processing.Apply(0);
+    if (measured) profiler.EndScope(gpu_scope);
+  }
+  glFinish();
+  // Collect the GPU samples of the last frames.
+  for (int i = 0; i < wvu::kDefaultGpuQueryLatency; ++i) {
+    profiler.BeginFrame();
+  }
+  std::vector<wvu::ProfileScopeStatistics> statistics;
+  profiler.GetStatistics(&statistics);
+  result.gpu = statistics[gpu_scope];
+  result.num_dispatches = post_processing.statistics().num_dispatches;
+  return result;
+}
+
+// Returns the string as a JSON string literal.
+std::string JsonString(const char* value) {
+  std::string json = "\"";
+  for (const char* c = value; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') json += '\\';
+    json += *c;
+  }
+  return json + "\"";
+}
+
+void WriteTimes(const wvu::ProfileScopeStatistics& statistics,
+                std::ostringstream* json) {
+  if (statistics.num_samples == 0) {
+    *json << "null";
+    return;
+  }
+  *json << "{\"samples\": " << statistics.num_samples
+        << ", \"min\": " << statistics.min_ms
+        << ", \"average\": " << statistics.average_ms
+        << ", \"p99\": " << statistics.p99_ms
+        << ", \"max\": " << statistics.max_ms << "}";
+}
+
+// The first result is the chain without occlusion.
+std::string ToJson(const std::vector<ScaleResult>& results) {
+  std::ostringstream json;
+  json << "{\n"
+       << "  \"renderer\": " << JsonString(reinterpret_cast<const char*>(
+              glGetString(GL_RENDERER))) << ",\n"
+       << "  \"version\": " << JsonString(reinterpret_cast<const char*>(
+              glGetString(GL_VERSION))) << ",\n"
+       << "  \"width\": " << FLAGS_width << ",\n"
+       << "  \"height\": " << FLAGS_height << ",\n"
+       << "  \"num_frames\": " << FLAGS_num_frames << ",\n"
+       << "  \"baseline_ms\": ";
+  WriteTimes(results[0].gpu, &json);
+  json << ",\n  \"scales\": [";
+  for (int i = 1; i < static_cast<int>(results.size()); ++i) {
+    const ScaleResult& result = results[i];
+    json << (i == 1 ? "\n" : ",\n")
+         << "    {\"scale\": " << result.scale;
+    if (result.failed) {
+      json << ", \"failed\": true}";
+      continue;
+    }
+    json << ", \"dispatches\": " << result.num_dispatches
+         << ",\n     \"post_processing_ms\": ";
+    WriteTimes(result.gpu, &json);
+    json << ",\n     \"occlusion_ms\": ";
+    if (results[0].gpu.num_samples > 0 && result.gpu.num_samples > 0) {
+      json << result.gpu.average_ms - results[0].gpu.average_ms;
+    } else {
+      json << "null";
+    }
+    json << "}";
+  }
+  json << "\n  ]\n}\n";
+  return json.str();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CS470_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  std::vector<float> scales;
+  if (FLAGS_width <= 0 || FLAGS_height <= 0 ||
+      !ParseScales(FLAGS_resolution_scales, &scales)) {
+    LOG(ERROR) << "Nothing to benchmark.";
+    return -1;
+  }
+  if (!glfwInit()) {
+    return -1;
+  }
+  // The frames go to the framebuffer of the post-processing, so the window is
+  // only there to own the context.
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  GLFWwindow* window =
+      glfwCreateWindow(64, 64, "post_bench", nullptr, nullptr);
+  if (!window) {
+    glfwTerminate();
+    return -1;
+  }
+  glfwMakeContextCurrent(window);
+  glfwSwapInterval(0);
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK || !wvu::PostProcessing::Supported()) {
+    LOG(ERROR) << "Post-processing needs OpenGL 4.3.";
+    glfwTerminate();
+    return -1;
+  }
+
+  int exit_code = 0;
+  {
+    std::string error_info_log;
+    wvu::ShaderProgram scene_program;
+    scene_program.LoadVertexShaderFromString(vertex_shader_src);
+    scene_program.LoadFragmentShaderFromString(fragment_shader_src);
+    // The triangle needs a vertex array object bound, without attributes.
+    GLuint vertex_array_object_id = 0;
+    glGenVertexArrays(1, &vertex_array_object_id);
+    glBindVertexArray(vertex_array_object_id);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+    if (!scene_program.Create(&error_info_log)) {
+      LOG(ERROR) << "Could not build the scene: " << error_info_log;
+      exit_code = -1;
+    } else {
+      const Eigen::Matrix4f projection =
+          wvu::ToMatrix(wvu::ComputePerspectiveProjection(
+              kFieldOfView, static_cast<float>(FLAGS_width) / FLAGS_height,
+              1.0f, 100.0f));
+      std::vector<ScaleResult> results;
+      results.push_back(RunScale(0.0f, projection, scene_program));
+      for (const float scale : scales) {
+        results.push_back(RunScale(scale, projection, scene_program));
+      }
+      const std::string json = ToJson(results);
+      if (FLAGS_output_file.empty()) {
+        std::fputs(json.c_str(), stdout);
+      } else {
+        std::ofstream file(FLAGS_output_file);
+        file << json;
+        if (!file) {
+          LOG(ERROR) << "Could not write " << FLAGS_output_file;
+          exit_code = -1;
+        }
+      }
+    }
+    glDeleteVertexArrays(1, &vertex_array_object_id);
+  }
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return exit_code;
+}
@@ -0,0 +1,740 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "post_processing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "gpu_culling.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Side in pixels of the work groups of the shaders.
+constexpr int kPostGroupSize = 8;
+
+// Writes the target level of the bloom texture from the finer source level,
+// with four bilinear taps covering the 4x4 source texels of the target texel.
+// The first level keeps the part of the frame brighter than the threshold.
+const char kBloomDownsampleShader[] =
+    "#version 430\n"
+    "layout (local_size_x = 8, local_size_y = 8) in;\n"
+    "layout (binding = 0) uniform sampler2D source_texture;\n"
+    "layout (rgba16f, binding = 0) writeonly uniform image2D target_image;\n"
+    "uniform float source_level;\n"
+    "// Negative past the first level.\n"
+    "uniform float threshold;\n"
+    "void main() {\n"
+    "  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);\n"
+    "  ivec2 size = imageSize(target_image);\n"
+    "  if (any(greaterThanEqual(pixel, size))) return;\n"
+    "  vec2 texel = 1.0 / vec2(size);\n"
+    "  vec2 uv = (vec2(pixel) + 0.5) * texel;\n"
+    "  vec3 color = 0.25 * (\n"
+    "      textureLod(source_texture, uv + vec2(-0.5, -0.5) * texel,\n"
+    "                 source_level).rgb +\n"
+    "      textureLod(source_texture, uv + vec2(0.5, -0.5) * texel,\n"
+    "                 source_level).rgb +\n"
+    "      textureLod(source_texture, uv + vec2(-0.5, 0.5) * texel,\n"
+    "                 source_level).rgb +\n"
+    "      textureLod(source_texture, uv + vec2(0.5, 0.5) * texel,\n"
+    "                 source_level).rgb);\n"
+    "  if (threshold >= 0.0) {\n"
+    "    float brightness = max(color.r, max(color.g, color.b));\n"
+    "    color *= max(brightness - threshold, 0.0) / max(brightness, 1e-4);\n"
+    "  }\n"
+    "  imageStore(target_image, pixel, vec4(color, 1.0));\n"
+    "}\n";
+
+// Adds the coarser source level into the target level, with a 3x3 tent
+// filter.
+const char kBloomUpsampleShader[] =
+    "#version 430\n"
+    "layout (local_size_x = 8, local_size_y = 8) in;\n"
+    "layout (binding = 0) uniform sampler2D source_texture;\n"
+    "layout (rgba16f, binding = 0) uniform image2D target_image;\n"
+    "uniform float source_level;\n"
+    "void main() {\n"
+    "  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);\n"
+    "  ivec2 size = imageSize(target_image);\n"
+    "  if (any(greaterThanEqual(pixel, size))) return;\n"
+    "  vec2 texel = 1.0 / vec2(size);\n"
+    "  vec2 uv = (vec2(pixel) + 0.5) * texel;\n"
+    "  vec3 sum = vec3(0.0);\n"
+    "  for (int y = -1; y <= 1; ++y) {\n"
+    "    for (int x = -1; x <= 1; ++x) {\n"
+    "      float weight = float((2 - abs(x)) * (2 - abs(y)));\n"
+    "      sum += weight * textureLod(source_texture, uv + vec2(x, y) * texel,\n"
+    "                                 source_level).rgb;\n"
+    "    }\n"
+    "  }\n"
+    "  vec4 color = imageLoad(target_image, pixel);\n"
+    "  imageStore(target_image, pixel, vec4(color.rgb + sum / 16.0, 1.0));\n"
+    "}\n";
+
+// Computes the ambient occlusion of the texels of the occlusion image from the
+// nearest depths (g) of the hierarchical-Z buffer, with the spiral of samples
+// of scalable ambient obscurance (McGuire et al., 2012), whose sample i of n
+// is at alpha = (i + 0.5) / n of the radius after alpha * NUM_TURNS turns. The
+// samples at d pixels of the frame read level log2(d) - 3, so that the
+// fetches of neighboring pixels stay close whatever the radius. The spirals
+// of the pixels of a 4x4 block start at the 16 angles of a Bayer matrix.
+// Writes the occlusion and the view space distance of the texel, which
+// weighs it in the upsample.
+const char kAmbientOcclusionShader[] =
+    "#version 430\n"
+    "layout (local_size_x = 8, local_size_y = 8) in;\n"
+    "layout (binding = 0) uniform sampler2D hi_z;\n"
+    "layout (rg16f, binding = 0) writeonly uniform image2D occlusion_image;\n"
+    "uniform mat4 inverse_projection;\n"
+    "// Pixels of the frame per view space unit at a distance of 1.\n"
+    "uniform float projection_scale;\n"
+    "uniform float radius;\n"
+    "uniform float strength;\n"
+    "// The level of the size of the occlusion image, and the coarsest one.\n"
+    "uniform int base_level;\n"
+    "uniform int max_level;\n"
+    "const int NUM_SAMPLES = 12;\n"
+    "const float NUM_TURNS = 7.0;\n"
+    "const float TWO_PI = 6.28318531;\n"
+    "const int BAYER[16] = int[16](0, 8, 2, 10, 12, 4, 14, 6,\n"
+    "                              3, 11, 1, 9, 15, 7, 13, 5);\n"
+    "vec3 ViewPosition(vec2 uv, float depth) {\n"
+    "  vec4 position =\n"
+    "      inverse_projection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);\n"
+    "  return position.xyz / position.w;\n"
+    "}\n"
+    "vec3 ViewPosition(vec2 uv, int level) {\n"
+    "  return ViewPosition(uv, textureLod(hi_z, uv, float(level)).g);\n"
+    "}\n"
+    "void main() {\n"
+    "  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);\n"
+    "  ivec2 size = imageSize(occlusion_image);\n"
+    "  if (any(greaterThanEqual(pixel, size))) return;\n"
+    "  vec2 texel = 1.0 / vec2(size);\n"
+    "  vec2 uv = (vec2(pixel) + 0.5) * texel;\n"
+    "  float depth = textureLod(hi_z, uv, float(base_level)).g;\n"
+    "  vec3 position = ViewPosition(uv, depth);\n"
+    "  if (depth >= 1.0) {\n"
+    "    imageStore(occlusion_image, pixel,\n"
+    "               vec4(1.0, -position.z, 0.0, 0.0));\n"
+    "    return;\n"
+    "  }\n"
+    "  // The normal from the neighbors on the same surface as the pixel, the\n"
+    "  // ones of closer depth, so that it stays sharp at the edges.\n"
+    "  vec3 right = ViewPosition(uv + vec2(texel.x, 0.0), base_level) -\n"
+    "      position;\n"
+    "  vec3 left = position -\n"
+    "      ViewPosition(uv - vec2(texel.x, 0.0), base_level);\n"
+    "  vec3 up = ViewPosition(uv + vec2(0.0, texel.y), base_level) -\n"
+    "      position;\n"
+    "  vec3 down = position -\n"
+    "      ViewPosition(uv - vec2(0.0, texel.y), base_level);\n"
+    "  vec3 dx = abs(right.z) < abs(left.z) ? right : left;\n"
+    "  vec3 dy = abs(up.z) < abs(down.z) ? up : down;\n"
+    "  vec3 normal = normalize(cross(dx, dy));\n"
+    "  vec2 frame_texel = 1.0 / vec2(textureSize(hi_z, 0));\n"
+    "  float screen_radius = projection_scale * radius / -position.z;\n"
+    "  float rotation =\n"
+    "      float(BAYER[(pixel.x & 3) + 4 * (pixel.y & 3)]) * (TWO_PI / 16.0);\n"
+    "  float sum = 0.0;\n"
+    "  for (int i = 0; i < NUM_SAMPLES; ++i) {\n"
+    "    float alpha = (float(i) + 0.5) / float(NUM_SAMPLES);\n"
+    "    float angle = alpha * NUM_TURNS * TWO_PI + rotation;\n"
+    "    float pixels = alpha * screen_radius;\n"
+    "    int level = clamp(int(floor(log2(max(pixels, 1.0)))) - 3,\n"
+    "                      base_level, max_level);\n"
+    "    vec3 offset = ViewPosition(\n"
+    "        uv + pixels * vec2(cos(angle), sin(angle)) * frame_texel,\n"
+    "        level) - position;\n"
+    "    float squared_distance = dot(offset, offset);\n"
+    "    float falloff =\n"
+    "        max(1.0 - squared_distance / (radius * radius), 0.0);\n"
+    "    // The cosine between the normal and the occluder, past a bias that\n"
+    "    // keeps flat surfaces from occluding themselves.\n"
+    "    sum += falloff * max(dot(offset, normal) /\n"
+    "                         sqrt(squared_distance + 1e-4) - 0.1, 0.0);\n"
+    "  }\n"
+    "  float occlusion = max(1.0 - strength * sum / float(NUM_SAMPLES), 0.0);\n"
+    "  imageStore(occlusion_image, pixel,\n"
+    "             vec4(occlusion, -position.z, 0.0, 0.0));\n"
+    "}\n";
+
+// Declares AmbientOcclusion() in the fused shader, which upsamples the
+// occlusion texture at a pixel of the frame. The 4x4 texels around the pixel
+// hold every rotation of the spirals; they are weighted by a tent of their
+// distance and by how close their view space distance is to the one of the
+// pixel, relative to it, so that the occlusion of the objects in front does
+// not bleed onto the ones behind, and the other way around.
+const char kOcclusionUpsampleSource[] =
+    "layout (binding = 2) uniform sampler2D depth_texture;\n"
+    "layout (binding = 3) uniform sampler2D occlusion_texture;\n"
+    "uniform mat4 inverse_projection;\n"
+    "float AmbientOcclusion(ivec2 pixel, vec2 uv) {\n"
+    "  float depth = texelFetch(depth_texture, pixel, 0).r;\n"
+    "  vec4 position =\n"
+    "      inverse_projection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);\n"
+    "  float view_distance = max(-position.z / position.w, 1e-4);\n"
+    "  ivec2 size = textureSize(occlusion_texture, 0);\n"
+    "  vec2 center = uv * vec2(size) - 0.5;\n"
+    "  ivec2 first = ivec2(floor(center)) - 1;\n"
+    "  float sum = 0.0;\n"
+    "  float weight_sum = 0.0;\n"
+    "  for (int y = 0; y < 4; ++y) {\n"
+    "    for (int x = 0; x < 4; ++x) {\n"
+    "      ivec2 texel = first + ivec2(x, y);\n"
+    "      vec2 value = texelFetch(\n"
+    "          occlusion_texture, clamp(texel, ivec2(0), size - 1), 0).rg;\n"
+    "      vec2 offset = max(2.0 - abs(vec2(texel) - center), 0.0);\n"
+    "      float weight = offset.x * offset.y * (1e-4 + exp(\n"
+    "          -16.0 * abs(value.g - view_distance) / view_distance));\n"
+    "      sum += weight * value.r;\n"
+    "      weight_sum += weight;\n"
+    "    }\n"
+    "  }\n"
+    "  return weight_sum > 0.0 ? sum / weight_sum : 1.0;\n"
+    "}\n";
+
+// Returns the body of the effect, which updates color, a vec3, from the
+// parameters in the uniform effect_<index>.
+std::string EffectSource(const PostEffectType type, const int index) {
+  const std::string parameters = "effect_" + std::to_string(index);
+  switch (type) {
+    case BLOOM_EFFECT:
+      return "  color += " + parameters + ".x *\n"
+          "      textureLod(bloom_texture, uv, 0.0).rgb;\n";
+    case TONE_MAPPING_EFFECT:
+      return "  color = ToneMap(color * " + parameters + ".x);\n";
+    case COLOR_GRADING_EFFECT:
+      return "  color = mix(vec3(Luminance(color)), color, " + parameters +
+          ".x);\n"
+          "  color = max((color - 0.5) * " + parameters + ".y + 0.5, 0.0);\n"
+          "  color *= vec3(1.0 + 0.1 * " + parameters + ".z, 1.0,\n"
+          "                1.0 - 0.1 * " + parameters + ".z);\n";
+    case VIGNETTE_EFFECT:
+      return "  color *= 1.0 - " + parameters + ".z * smoothstep(\n"
+          "      " + parameters + ".x, " + parameters + ".x + " + parameters +
+          ".y,\n"
+          "      length(uv - 0.5) * 1.41421356);\n";
+    case AMBIENT_OCCLUSION_EFFECT:
+      return "  color *= AmbientOcclusion(pixel, uv);\n";
+  }
+  return "";
+}
+
+// Returns the parameters of the effect, in the order of EffectSource().
+Eigen::Vector3f EffectParameters(const PostEffect& effect) {
+  switch (effect.type) {
+    case BLOOM_EFFECT:
+      return Eigen::Vector3f(effect.intensity, 0.0f, 0.0f);
+    case TONE_MAPPING_EFFECT:
+      return Eigen::Vector3f(effect.exposure, 0.0f, 0.0f);
+    case COLOR_GRADING_EFFECT:
+      return Eigen::Vector3f(effect.saturation, effect.contrast,
+                             effect.temperature);
+    case VIGNETTE_EFFECT:
+      return Eigen::Vector3f(effect.radius, effect.softness, effect.strength);
+    case AMBIENT_OCCLUSION_EFFECT:
+      // Applied by the occlusion shader.
+      return Eigen::Vector3f(effect.occlusion_radius,
+                             effect.occlusion_strength,
+                             effect.resolution_scale);
+  }
+  return Eigen::Vector3f::Zero();
+}
+
+// Sets the parameter name of the effect from value. Returns false if the
+// effect has no such parameter or the value is not a number.
+bool SetEffectParameter(const std::string& name,
+                        const std::string& value,
+                        PostEffect* effect) {
+  std::istringstream value_stream(value);
+  float number = 0.0f;
+  if (!(value_stream >> number) || !value_stream.eof()) return false;
+  float* parameter = nullptr;
+  switch (effect->type) {
+    case BLOOM_EFFECT:
+      if (name == "threshold") parameter = &effect->threshold;
+      if (name == "intensity") parameter = &effect->intensity;
+      if (name == "levels") {
+        effect->num_levels = static_cast<int>(number);
+        return number >= 1.0f && number <= kMaxBloomLevels;
+      }
+      break;
+    case TONE_MAPPING_EFFECT:
+      if (name == "exposure") parameter = &effect->exposure;
+      break;
+    case COLOR_GRADING_EFFECT:
+      if (name == "saturation") parameter = &effect->saturation;
+      if (name == "contrast") parameter = &effect->contrast;
+      if (name == "temperature") parameter = &effect->temperature;
+      break;
+    case VIGNETTE_EFFECT:
+      if (name == "radius") parameter = &effect->radius;
+      if (name == "softness") parameter = &effect->softness;
+      if (name == "strength") parameter = &effect->strength;
+      break;
+    case AMBIENT_OCCLUSION_EFFECT:
+      if (name == "radius") parameter = &effect->occlusion_radius;
+      if (name == "strength") parameter = &effect->occlusion_strength;
+      if (name == "scale") {
+        effect->resolution_scale = number;
+        return number > 0.0f && number <= 1.0f;
+      }
+      break;
+  }
+  if (parameter == nullptr) return false;
+  *parameter = number;
+  return true;
+}
+
+// Creates a texture of width x height texels and num_levels levels, sampled
+// linearly and clamped to its edges.
+GLuint CreateTargetTexture(const GLenum internal_format,
+                           const int width,
+                           const int height,
+                           const int num_levels) {
+  GLuint texture_id = 0;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  glTexStorage2D(GL_TEXTURE_2D, num_levels, internal_format, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  num_levels > 1 ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return texture_id;
+}
+
+// Returns the number of work groups covering size pixels.
+GLuint NumGroups(const int size) {
+  return (size + kPostGroupSize - 1) / kPostGroupSize;
+}
+
+}  // namespace
+
+bool ParsePostEffects(const std::string& description,
+                      std::vector<PostEffect>* effects,
+                      std::string* error_info_log) {
+  effects->clear();
+  std::istringstream chain(description);
+  std::string effect_description;
+  bool has_bloom = false;
+  bool has_occlusion = false;
+  while (std::getline(chain, effect_description, ';')) {
+    std::istringstream fields(effect_description);
+    std::string name;
+    if (!(fields >> name)) continue;
+    PostEffect effect;
+    if (name == "bloom") {
+      effect.type = BLOOM_EFFECT;
+      if (has_bloom) {
+        *error_info_log = "The chain has more than one bloom.";
+        return false;
+      }
+      has_bloom = true;
+    } else if (name == "tone_mapping") {
+      effect.type = TONE_MAPPING_EFFECT;
+    } else if (name == "color_grading") {
+      effect.type = COLOR_GRADING_EFFECT;
+    } else if (name == "vignette") {
+      effect.type = VIGNETTE_EFFECT;
+    } else if (name == "ambient_occlusion") {
+      effect.type = AMBIENT_OCCLUSION_EFFECT;
+      if (has_occlusion) {
+        *error_info_log = "The chain has more than one ambient occlusion.";
+        return false;
+      }
+      has_occlusion = true;
+    } else {
+      *error_info_log = "Unknown effect " + name + ".";
+      return false;
+    }
+    std::string parameter;
+    while (fields >> parameter) {
+      const size_t equals = parameter.find('=');
+      if (equals == std::string::npos ||
+          !SetEffectParameter(parameter.substr(0, equals),
+                              parameter.substr(equals + 1), &effect)) {
+        *error_info_log = "Invalid parameter " + parameter + " of " + name +
+            ".";
+        return false;
+      }
+    }
+    if (effects->size() == kMaxPostEffects) {
+      *error_info_log = "The chain has more than " +
+          std::to_string(kMaxPostEffects) + " effects.";
+      return false;
+    }
+    effects->push_back(effect);
+  }
+  return true;
+}
+
+PostProcessing::PostProcessing()
+    : bloom_index_(-1), occlusion_index_(-1), occlusion_texture_id_(0),
+      occlusion_width_(0), occlusion_height_(0),
+      projection_(Eigen::Matrix4f::Identity()), color_texture_id_(0),
+      depth_texture_id_(0), bloom_texture_id_(0), num_bloom_levels_(0),
+      output_texture_id_(0), framebuffer_id_(0), output_framebuffer_id_(0),
+      width_(0), height_(0) {}
+
+PostProcessing::~PostProcessing() {
+  Reset();
+}
+
+bool PostProcessing::Supported() {
+  return GLEW_VERSION_4_3;
+}
+
+std::string PostProcessing::FusedShaderSource(
+    const std::vector<PostEffect>& effects) {
+  std::string source =
+      "#version 430\n"
+      "layout (local_size_x = 8, local_size_y = 8) in;\n"
+      "layout (binding = 0) uniform sampler2D color_texture;\n"
+      "layout (binding = 1) uniform sampler2D bloom_texture;\n"
+      "layout (rgba8, binding = 0) writeonly uniform image2D output_image;\n";
+  for (int i = 0; i < effects.size(); ++i) {
+    source += "uniform vec3 effect_" + std::to_string(i) + ";\n";
+    if (effects[i].type == AMBIENT_OCCLUSION_EFFECT) {
+      source += kOcclusionUpsampleSource;
+    }
+  }
+  source +=
+      "float Luminance(vec3 color) {\n"
+      "  return dot(color, vec3(0.2126, 0.7152, 0.0722));\n"
+      "}\n"
+      "// The fit of the ACES curve of Narkowicz (2015).\n"
+      "vec3 ToneMap(vec3 color) {\n"
+      "  return clamp((color * (2.51 * color + 0.03)) /\n"
+      "               (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);\n"
+      "}\n"
+      "void main() {\n"
+      "  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);\n"
+      "  ivec2 size = imageSize(output_image);\n"
+      "  if (any(greaterThanEqual(pixel, size))) return;\n"
+      "  vec2 uv = (vec2(pixel) + 0.5) / vec2(size);\n"
+      "  vec3 color = texelFetch(color_texture, pixel, 0).rgb;\n";
+  for (int i = 0; i < effects.size(); ++i) {
+    source += EffectSource(effects[i].type, i);
+  }
+  source +=
+      "  imageStore(output_image, pixel, vec4(color, 1.0));\n"
+      "}\n";
+  return source;
+}
+
+bool PostProcessing::Initialize(const std::vector<PostEffect>& effects,
+                                const int width,
+                                const int height,
+                                std::string* error_info_log) {
+  if (!Supported()) {
+    *error_info_log = "Post-processing needs OpenGL 4.3.";
+    return false;
+  }
+  effects_ = effects;
+  bloom_index_ = -1;
+  occlusion_index_ = -1;
+  for (int i = 0; i < effects_.size(); ++i) {
+    if (effects_[i].type == BLOOM_EFFECT) bloom_index_ = i;
+    if (effects_[i].type == AMBIENT_OCCLUSION_EFFECT) occlusion_index_ = i;
+  }
+  if (!fused_program_.LoadComputeShaderFromString(
+          FusedShaderSource(effects_)) ||
+      !fused_program_.Create(error_info_log)) {
+    return false;
+  }
+  effect_locations_.clear();
+  for (int i = 0; i < effects_.size(); ++i) {
+    effect_locations_.push_back(
+        fused_program_.GetUniformLocation("effect_" + std::to_string(i)));
+  }
+  if (bloom_index_ >= 0 &&
+      (!downsample_program_.LoadComputeShaderFromString(
+           kBloomDownsampleShader) ||
+       !downsample_program_.Create(error_info_log) ||
+       !upsample_program_.LoadComputeShaderFromString(kBloomUpsampleShader) ||
+       !upsample_program_.Create(error_info_log))) {
+    return false;
+  }
+  if (occlusion_index_ >= 0 &&
+      (!occlusion_program_.LoadComputeShaderFromString(
+           kAmbientOcclusionShader) ||
+       !occlusion_program_.Create(error_info_log))) {
+    return false;
+  }
+  width_ = 0;
+  height_ = 0;
+  return Resize(width, height, error_info_log);
+}
+
+bool PostProcessing::Resize(const int width,
+                            const int height,
+                            std::string* error_info_log) {
+  if (width == width_ && height == height_ && framebuffer_id_ != 0) {
+    return true;
+  }
+  if (width <= 0 || height <= 0) {
+    *error_info_log = "Invalid post-processing size " + std::to_string(width) +
+        "x" + std::to_string(height) + ".";
+    return false;
+  }
+  DeleteTargets();
+  width_ = width;
+  height_ = height;
+  if (!CreateTargets(error_info_log)) {
+    DeleteTargets();
+    return false;
+  }
+  return true;
+}
+
+bool PostProcessing::CreateTargets(std::string* error_info_log) {
+  color_texture_id_ = CreateTargetTexture(GL_RGBA16F, width_, height_, 1);
+  depth_texture_id_ =
+      CreateTargetTexture(GL_DEPTH24_STENCIL8, width_, height_, 1);
+  output_texture_id_ = CreateTargetTexture(GL_RGBA8, width_, height_, 1);
+  num_bloom_levels_ = 0;
+  if (bloom_index_ >= 0) {
+    // The levels stop at a single texel.
+    const int bloom_width = std::max(width_ / 2, 1);
+    const int bloom_height = std::max(height_ / 2, 1);
+    int max_levels = 1;
+    while ((std::max(bloom_width, bloom_height) >> max_levels) > 0) {
+      ++max_levels;
+    }
+    num_bloom_levels_ =
+        std::min(effects_[bloom_index_].num_levels, max_levels);
+    bloom_texture_id_ = CreateTargetTexture(GL_RGBA16F, bloom_width,
+                                            bloom_height, num_bloom_levels_);
+  }
+  if (occlusion_index_ >= 0) {
+    const float scale = effects_[occlusion_index_].resolution_scale;
+    occlusion_width_ = std::max(static_cast<int>(width_ * scale + 0.5f), 1);
+    occlusion_height_ = std::max(static_cast<int>(height_ * scale + 0.5f), 1);
+    occlusion_texture_id_ = CreateTargetTexture(GL_RG16F, occlusion_width_,
+                                                occlusion_height_, 1);
+    // The pyramid has the levels of this size, so it follows the frame.
+    if (!hi_z_.Initialize(width_, height_, error_info_log)) return false;
+  }
+
+  glGenFramebuffers(1, &framebuffer_id_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         color_texture_id_, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                         GL_TEXTURE_2D, depth_texture_id_, 0);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glGenFramebuffers(1, &output_framebuffer_id_);
+  glBindFramebuffer(GL_FRAMEBUFFER, output_framebuffer_id_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         output_texture_id_, 0);
+  if (status == GL_FRAMEBUFFER_COMPLETE) {
+    status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    *error_info_log = "The post-processing framebuffer is incomplete: status " +
+        std::to_string(status) + ".";
+    return false;
+  }
+  return true;
+}
+
+void PostProcessing::DeleteTargets() {
+  GLuint* framebuffers[] = {&framebuffer_id_, &output_framebuffer_id_};
+  for (GLuint* framebuffer : framebuffers) {
+    if (*framebuffer != 0) glDeleteFramebuffers(1, framebuffer);
+    *framebuffer = 0;
+  }
+  GLuint* textures[] = {&color_texture_id_, &depth_texture_id_,
+                        &bloom_texture_id_, &output_texture_id_,
+                        &occlusion_texture_id_};
+  for (GLuint* texture : textures) {
+    if (*texture != 0) glDeleteTextures(1, texture);
+    *texture = 0;
+  }
+  num_bloom_levels_ = 0;
+  occlusion_width_ = 0;
+  occlusion_height_ = 0;
+  width_ = 0;
+  height_ = 0;
+}
+
+void PostProcessing::Bind() const {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+  glViewport(0, 0, width_, height_);
+}
+
+void PostProcessing::set_effect(const int index, const PostEffect& effect) {
+  if (index < 0 || index >= effects_.size() ||
+      effect.type != effects_[index].type) {
+    return;
+  }
+  effects_[index] = effect;
+}
+
+void PostProcessing::RenderBloom(const PostEffect& bloom) {
+  const int bloom_width = std::max(width_ / 2, 1);
+  const int bloom_height = std::max(height_ / 2, 1);
+  glActiveTexture(GL_TEXTURE0);
+  // Every level reads the previous one, so the dispatches are serialized by
+  // the barriers of the texture fetches.
+  downsample_program_.Use();
+  for (int level = 0; level < num_bloom_levels_; ++level) {
+    glBindTexture(GL_TEXTURE_2D,
+                  level == 0 ? color_texture_id_ : bloom_texture_id_);
+    downsample_program_.SetUniform("source_level",
+                                   static_cast<GLfloat>(std::max(level - 1,
+                                                                 0)));
+    downsample_program_.SetUniform(
+        "threshold", level == 0 ? std::max(bloom.threshold, 0.0f) : -1.0f);
+    glBindImageTexture(0, bloom_texture_id_, level, GL_FALSE, 0,
+                       GL_WRITE_ONLY, GL_RGBA16F);
+    downsample_program_.Dispatch(NumGroups(std::max(bloom_width >> level, 1)),
+                                 NumGroups(std::max(bloom_height >> level, 1)),
+                                 1, GL_TEXTURE_FETCH_BARRIER_BIT);
+    ++statistics_.num_dispatches;
+  }
+  glBindTexture(GL_TEXTURE_2D, bloom_texture_id_);
+  upsample_program_.Use();
+  for (int level = num_bloom_levels_ - 2; level >= 0; --level) {
+    upsample_program_.SetUniform("source_level",
+                                 static_cast<GLfloat>(level + 1));
+    glBindImageTexture(0, bloom_texture_id_, level, GL_FALSE, 0,
+                       GL_READ_WRITE, GL_RGBA16F);
+    upsample_program_.Dispatch(NumGroups(std::max(bloom_width >> level, 1)),
+                               NumGroups(std::max(bloom_height >> level, 1)),
+                               1, GL_TEXTURE_FETCH_BARRIER_BIT |
+                               GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    ++statistics_.num_dispatches;
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void PostProcessing::RenderAmbientOcclusion(const PostEffect& occlusion) {
+  // The nearest depths of the frame.
+  hi_z_.Build(depth_texture_id_);
+  statistics_.num_dispatches +=
+      1 + hi_z_.num_levels() - hi_z_.num_single_pass_levels();
+  // The level of the pyramid closest to the size of the occlusion.
+  const int base_level = std::min(
+      std::max(static_cast<int>(
+          std::lround(-std::log2(occlusion.resolution_scale))), 0),
+      hi_z_.num_levels() - 1);
+  occlusion_program_.Use();
+  occlusion_program_.SetUniform("inverse_projection",
+                                Eigen::Matrix4f(projection_.inverse()));
+  occlusion_program_.SetUniform("projection_scale",
+                                0.5f * height_ * projection_(1, 1));
+  occlusion_program_.SetUniform("radius", occlusion.occlusion_radius);
+  occlusion_program_.SetUniform("strength", occlusion.occlusion_strength);
+  occlusion_program_.SetUniform("base_level", static_cast<GLint>(base_level));
+  occlusion_program_.SetUniform("max_level",
+                                static_cast<GLint>(hi_z_.num_levels() - 1));
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, hi_z_.texture_id());
+  glBindImageTexture(0, occlusion_texture_id_, 0, GL_FALSE, 0, GL_WRITE_ONLY,
+                     GL_RG16F);
+  // The fused shader fetches the occlusion.
+  occlusion_program_.Dispatch(NumGroups(occlusion_width_),
+                              NumGroups(occlusion_height_), 1,
+                              GL_TEXTURE_FETCH_BARRIER_BIT);
+  ++statistics_.num_dispatches;
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void PostProcessing::Apply(const GLuint framebuffer_id) {
+  statistics_ = PostProcessingStatistics();
+  if (framebuffer_id_ == 0) return;
+  // The draws into the frame complete before the compute shaders fetch it.
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+  if (occlusion_index_ >= 0) {
+    RenderAmbientOcclusion(effects_[occlusion_index_]);
+  }
+  if (bloom_index_ >= 0) RenderBloom(effects_[bloom_index_]);
+  fused_program_.Use();
+  if (occlusion_index_ >= 0) {
+    fused_program_.SetUniform("inverse_projection",
+                              Eigen::Matrix4f(projection_.inverse()));
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, depth_texture_id_);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, occlusion_texture_id_);
+  }
+  for (int i = 0; i < effects_.size(); ++i) {
+    fused_program_.SetUniform(effect_locations_[i],
+                              EffectParameters(effects_[i]));
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, color_texture_id_);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, bloom_texture_id_);
+  glBindImageTexture(0, output_texture_id_, 0, GL_FALSE, 0, GL_WRITE_ONLY,
+                     GL_RGBA8);
+  // The blit reads the output through the framebuffer.
+  fused_program_.Dispatch(NumGroups(width_), NumGroups(height_), 1,
+                          GL_FRAMEBUFFER_BARRIER_BIT);
+  ++statistics_.num_dispatches;
+  if (occlusion_index_ >= 0) {
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE1);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, output_framebuffer_id_);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_id);
+  glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_,
+                    GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+}
+
+void PostProcessing::Reset() {
+  DeleteTargets();
+}
+
+}  // namespace wvu
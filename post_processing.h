@@ -0,0 +1,276 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_POST_PROCESSING_H_
+#define GLUTILS_POST_PROCESSING_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "gpu_culling.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Most effects in a chain.
+constexpr int kMaxPostEffects = 8;
+
+// Most levels of the bloom chain.
+constexpr int kMaxBloomLevels = 8;
+
+// The effects of the post-processing chain.
+enum PostEffectType {
+  // Adds the blurred bright parts of the frame.
+  BLOOM_EFFECT = 0,
+  // Maps the colors to [0, 1] with the ACES filmic curve.
+  TONE_MAPPING_EFFECT = 1,
+  // Changes the saturation, the contrast and the temperature of the colors.
+  COLOR_GRADING_EFFECT = 2,
+  // Darkens the corners of the frame.
+  VIGNETTE_EFFECT = 3,
+  // Darkens the creases and the corners of the scene that little ambient
+  // light reaches (screen-space ambient occlusion).
+  AMBIENT_OCCLUSION_EFFECT = 4
+};
+
+// An effect of the chain. Every effect only reads the parameters of its type.
+struct PostEffect {
+  PostEffectType type = TONE_MAPPING_EFFECT;
+  // Bloom: the brightness where the bloom starts, its weight, and the number
+  // of levels of the blur, each half the size of the previous one.
+  float threshold = 1.0f;
+  float intensity = 0.5f;
+  int num_levels = 5;
+  // Tone mapping: the scale of the colors before the curve.
+  float exposure = 1.0f;
+  // Color grading: 0 is grayscale, and a positive temperature is warmer.
+  float saturation = 1.0f;
+  float contrast = 1.0f;
+  float temperature = 0.0f;
+  // Vignette: the distance from the center, in half diagonals, where the
+  // darkening starts, the distance over which it fades in, and how dark the
+  // corners get.
+  float radius = 0.75f;
+  float softness = 0.45f;
+  float strength = 0.8f;
+  // Ambient occlusion: the distance in view space within which the geometry
+  // occludes a pixel, how dark the occluded pixels get, and the resolution of
+  // the occlusion relative to the frame.
+  float occlusion_radius = 0.5f;
+  float occlusion_strength = 1.0f;
+  float resolution_scale = 0.5f;
+};
+
+// Parses a chain of effects separated by semicolons, each a name (bloom,
+// tone_mapping, color_grading or vignette) followed by the parameters that
+// differ from their defaults, e.g.:
+//
+//   bloom threshold=0.8 intensity=0.3; tone_mapping exposure=1.5; vignette
+//
+// The ambient occlusion is named ambient_occlusion, and its parameters
+// radius, strength and scale.
+//
+// Returns true if successful, otherwise the error is copied into
+// error_info_log.
+bool ParsePostEffects(const std::string& description,
+                      std::vector<PostEffect>* effects,
+                      std::string* error_info_log);
+
+// Counters of the last PostProcessing::Apply().
+struct PostProcessingStatistics {
+  int num_dispatches = 0;
+};
+
+// This class applies a chain of full-screen effects to a frame. The frame is
+// drawn into a GL_RGBA16F framebuffer, so the colors past 1 reach the bloom
+// and the tone mapping. Separate full-screen passes would read and write the
+// whole frame once per effect; instead, the effects of the chain, which only
+// read their own pixel, are generated into a single compute shader, which
+// reads the frame once and writes the output once.
+//
+// The bloom blurs the frame, which does not fit in a per-pixel shader: its
+// bright parts are downsampled into the levels of a half-size mipmapped
+// texture, and then upsampled back, adding every level into the finer one
+// with a tent filter. The chain costs about a third of a half-size pass,
+// whatever the blur radius. The fused shader then only adds the finest level,
+// at its place in the chain.
+//
+// The ambient occlusion is computed at a fraction of the resolution, half by
+// default, from the nearest depths of a HiZBuffer of the depth of the frame:
+// each pixel takes 12 samples on a spiral around it, the farther ones from
+// coarser levels, which keeps the fetches in the cache whatever the radius.
+// The spirals of the 16 pixels of each 4x4 block are rotated differently, so
+// that few samples per pixel cover all the directions together. The fused
+// shader upsamples the occlusion with a depth-aware bilateral filter over the
+// 4x4 texels around each pixel, which averages the rotations without blurring
+// the occlusion across the edges of the objects. The occlusion needs the
+// projection of the frame (see SetProjection()), and darkens all the light of
+// the frame, so it goes before the tone mapping.
+//
+// The effects run in their order in the list, e.g., the color grading before
+// the tone mapping works on the linear colors, and after it on the displayed
+// ones. The parameters of the effects are uniforms, so set_effect() changes
+// them without building the shader again. Needs OpenGL 4.3.
+//
+// Example:
+//
+// std::vector<wvu::PostEffect> effects;
+// wvu::ParsePostEffects("bloom; tone_mapping exposure=1.5; vignette",
+//                       &effects, &error_info_log);
+// wvu::PostProcessing post_processing;
+// post_processing.Initialize(effects, width, height, &error_info_log);
+// while (...) {  // Rendering loop.
+//   post_processing.Bind();
+//   ...  // Draws.
+//   post_processing.Apply(0);
+// }
+class PostProcessing {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  PostProcessing();
+  ~PostProcessing();
+
+  // Builds the shaders of the chain and creates the framebuffer of width x
+  // height pixels. Returns true if successful.
+  bool Initialize(const std::vector<PostEffect>& effects,
+                  const int width,
+                  const int height,
+                  std::string* error_info_log);
+
+  // Recreates the textures of width x height pixels, if the size changed.
+  // Returns true if successful.
+  bool Resize(const int width, const int height, std::string* error_info_log);
+
+  // Binds the framebuffer of the frame for drawing and sets the viewport to
+  // its size.
+  void Bind() const;
+
+  // Applies the chain to the frame and copies the result into the framebuffer
+  // framebuffer_id, of the same size and single-sampled. The depth is not
+  // copied. Leaves framebuffer_id bound.
+  void Apply(const GLuint framebuffer_id);
+
+  // Sets the projection matrix of the frame, which the ambient occlusion needs
+  // to find the view space positions of the pixels.
+  void SetProjection(const Eigen::Matrix4f& projection) {
+    projection_ = projection;
+  }
+
+  // Replaces the parameters of the effect at index. Its type cannot change.
+  void set_effect(const int index, const PostEffect& effect);
+
+  // Deletes the OpenGL objects.
+  void Reset();
+
+  // Returns the compute shader fusing the per-pixel effects of the chain.
+  static std::string FusedShaderSource(const std::vector<PostEffect>& effects);
+
+  // Returns true if the context supports compute shaders.
+  static bool Supported();
+
+  const std::vector<PostEffect>& effects() const {
+    return effects_;
+  }
+
+  GLuint framebuffer_id() const {
+    return framebuffer_id_;
+  }
+
+  int width() const {
+    return width_;
+  }
+
+  int height() const {
+    return height_;
+  }
+
+  const PostProcessingStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // Creates the textures and the framebuffers.
+  bool CreateTargets(std::string* error_info_log);
+
+  // Deletes the textures and the framebuffers.
+  void DeleteTargets();
+
+  // Blurs the bright parts of the frame into the finest level of the bloom
+  // texture.
+  void RenderBloom(const PostEffect& bloom);
+
+  // Computes the ambient occlusion and the depth of the pixels of the
+  // occlusion texture.
+  void RenderAmbientOcclusion(const PostEffect& occlusion);
+
+  std::vector<PostEffect> effects_;
+  // The bloom effect of the chain, or -1.
+  int bloom_index_;
+  ShaderProgram downsample_program_;
+  ShaderProgram upsample_program_;
+  ShaderProgram fused_program_;
+  // The ambient occlusion effect of the chain, or -1.
+  int occlusion_index_;
+  ShaderProgram occlusion_program_;
+  HiZBuffer hi_z_;
+  // The occlusion (r) and the view space distance (g) of the pixels, at the
+  // resolution scale of the effect.
+  GLuint occlusion_texture_id_;
+  int occlusion_width_;
+  int occlusion_height_;
+  Eigen::Matrix4f projection_;
+  // The locations of the parameters of the effects in the fused program.
+  std::vector<GLint> effect_locations_;
+  GLuint color_texture_id_;
+  GLuint depth_texture_id_;
+  // The levels of the bloom, from half the size of the frame.
+  GLuint bloom_texture_id_;
+  int num_bloom_levels_;
+  GLuint output_texture_id_;
+  GLuint framebuffer_id_;
+  // Reads the output for the blit into the target.
+  GLuint output_framebuffer_id_;
+  int width_;
+  int height_;
+  PostProcessingStatistics statistics_;
+
+  PostProcessing(const PostProcessing&) = delete;
+  PostProcessing& operator=(const PostProcessing&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_POST_PROCESSING_H_
@@ -0,0 +1,97 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "quaternion_interpolation.h"
+
+#include <cmath>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace wvu {
+namespace {
+// Cosine of the angle between orientations above which the slerp falls back
+// to the nlerp, since the sine of the angle vanishes and both methods agree.
+constexpr float kSlerpThreshold = 0.9995f;
+
+// Returns the unit quaternion in the direction of coeffs.
+Eigen::Quaternionf Normalized(const Eigen::Vector4f& coeffs) {
+  Eigen::Quaternionf quaternion;
+  quaternion.coeffs() = coeffs / coeffs.norm();
+  return quaternion;
+}
+
+}  // namespace
+
+void InterpolateQuaternions(const Eigen::Quaternionf* from,
+                            const Eigen::Quaternionf* to,
+                            const int num_quaternions,
+                            const float t,
+                            const QuaternionInterpolation interpolation,
+                            Eigen::Quaternionf* result) {
+  for (int i = 0; i < num_quaternions; ++i) {
+    const Eigen::Vector4f start = from[i].coeffs();
+    Eigen::Vector4f end = to[i].coeffs();
+    // The quaternions q and -q are the same orientation. Negating the end
+    // when they are in opposite hemispheres takes the shortest arc.
+    float cos_angle = start.dot(end);
+    if (cos_angle < 0.0f) {
+      end = -end;
+      cos_angle = -cos_angle;
+    }
+    if (interpolation == NLERP || cos_angle > kSlerpThreshold) {
+      result[i] = Normalized(start + t * (end - start));
+      continue;
+    }
+    const float angle = std::acos(cos_angle);
+    const float inverse_sin_angle =
+        1.0f / std::sqrt(1.0f - cos_angle * cos_angle);
+    const float start_weight = std::sin((1.0f - t) * angle) * inverse_sin_angle;
+    const float end_weight = std::sin(t * angle) * inverse_sin_angle;
+    result[i].coeffs() = start_weight * start + end_weight * end;
+  }
+}
+
+void ComputeRigidTransforms(const Eigen::Quaternionf* rotations,
+                            const Eigen::Vector3f* translations,
+                            const int num_transforms,
+                            Eigen::Matrix4f* result) {
+  for (int i = 0; i < num_transforms; ++i) {
+    Eigen::Matrix4f& transform = result[i];
+    transform.block<3, 3>(0, 0) = rotations[i].toRotationMatrix();
+    transform.block<3, 1>(0, 3) = translations[i];
+    transform.row(3) << 0.0f, 0.0f, 0.0f, 1.0f;
+  }
+}
+
+}  // namespace wvu
@@ -0,0 +1,95 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_QUATERNION_INTERPOLATION_H_
+#define GLUTILS_QUATERNION_INTERPOLATION_H_
+
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+namespace wvu {
+// Contiguous array of orientations. Eigen requires an aligned allocator for the
+// vectorizable Quaternionf.
+typedef std::vector<Eigen::Quaternionf,
+                    Eigen::aligned_allocator<Eigen::Quaternionf> > Quaternions;
+
+// Methods to interpolate orientations.
+enum QuaternionInterpolation {
+  // Normalized linear interpolation. It does not need trigonometric functions,
+  // but the angular velocity is not constant: it is faster in the middle of
+  // the interpolation. The error is small for close orientations, e.g., the
+  // keyframes of an animation.
+  NLERP,
+  // Spherical linear interpolation, with constant angular velocity.
+  SLERP,
+};
+
+// Interpolates the pairs of orientations from[i] and to[i] along the shortest
+// arc, e.g., to blend the keyframes of the animated objects of a scene.
+// Storing orientations as quaternions avoids the angle-axis to matrix
+// conversions (and their sines and cosines) of every frame; see
+// ComputeRigidTransforms().
+// Parameters:
+//   from  The orientations at t = 0.
+//   to  The orientations at t = 1.
+//   num_quaternions  The number of quaternions of the arrays.
+//   t  The interpolation parameter in [0, 1].
+//   interpolation  The interpolation method.
+//   result  The num_quaternions interpolated unit quaternions. It may alias
+//     from or to.
+void InterpolateQuaternions(const Eigen::Quaternionf* from,
+                            const Eigen::Quaternionf* to,
+                            const int num_quaternions,
+                            const float t,
+                            const QuaternionInterpolation interpolation,
+                            Eigen::Quaternionf* result);
+
+// Computes the model matrices of the rotations followed by the translations,
+// e.g., for an InstanceBuffer. A unit quaternion converts to a rotation matrix
+// with products and sums only.
+// Parameters:
+//   rotations  The unit quaternions of the orientations.
+//   translations  The positions.
+//   num_transforms  The number of transforms.
+//   result  The num_transforms model matrices.
+void ComputeRigidTransforms(const Eigen::Quaternionf* rotations,
+                            const Eigen::Vector3f* translations,
+                            const int num_transforms,
+                            Eigen::Matrix4f* result);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_QUATERNION_INTERPOLATION_H_
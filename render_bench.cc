@@ -0,0 +1,715 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+// Benchmarks the throughput of the draw paths of the library on a scene of
+// rotating cubes rendered headless with vsync off, and writes the CPU and GPU
+// frame times, draws per second and triangles per second as JSON, so that the
+// paths can be compared on each GPU:
+//   render_queue  One draw per cube through a RenderQueue, as RenderScene()
+//     does in draw_triangle.cc.
+//   instanced  One glDrawElementsInstanced() of all the cubes with an
+//     InstanceBuffer.
+//   multi_draw  One command per cube in a MeshBatch, submitted with
+//     glMultiDrawElementsIndirect() when supported. Needs base instances.
+//   vertex_pulling  One command per cube in a PulledMeshBatch, alternating a
+//     float and a quantized copy of the cube, which the vertex shader pulls
+//     from a storage buffer in the same glMultiDrawElementsIndirect().
+//     Needs OpenGL 4.3.
+//   command_list  One draw per cube recorded into a CommandList, with the
+//     model-view-projection matrix as constants, and submitted to the gl
+//     RenderDevice, whose pipeline is pre-warmed by a PipelineLibrary. Needs
+//     OpenGL 4.3.
+//
+// Example:
+//
+// ./bin/render_bench --num_objects=10000 --output_file=results.json
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "frame_profiler.h"
+#include "gl_state_cache.h"
+#include "gpu_mesh.h"
+#include "instance_buffer.h"
+#include "mesh_batch.h"
+#include "mesh_orientation.h"
+#include "model.h"
+#include "offscreen_framebuffer.h"
+#include "pipeline_library.h"
+#include "render_device.h"
+#include "render_queue.h"
+#include "shader_program.h"
+#include "transforms.h"
+#include "vertex_format.h"
+#include "vertex_pulling.h"
+#include "vertex_quantization.h"
+
+// Use the right namespace for google flags (gflags).
+#ifdef GFLAGS_NAMESPACE_GOOGLE
+#define CS470_GFLAGS_NAMESPACE google
+#else
+#define CS470_GFLAGS_NAMESPACE gflags
+#endif
+
+DEFINE_int32(num_objects, 1000, "Number of cubes of the scene.");
+DEFINE_int32(num_frames, 500, "Frames measured per draw path.");
+DEFINE_int32(warmup_frames, 50,
+             "Frames rendered per draw path before the measured ones.");
+DEFINE_int32(width, 1280, "Width of the rendered frames.");
+DEFINE_int32(height, 720, "Height of the rendered frames.");
+DEFINE_string(draw_paths,
+              "render_queue,instanced,multi_draw,vertex_pulling,"
+              "command_list",
+              "Comma-separated draw paths to benchmark.");
+DEFINE_string(output_file, "",
+              "JSON file of the results. Empty writes them to stdout.");
+
+// Annonymous namespace for constants and helper functions.
+namespace {
+// Vertical field of view of the camera, in radians.
+constexpr float kFieldOfView = 0.785398f;
+// Distance between the centers of neighboring cubes.
+constexpr float kCubeSpacing = 1.5f;
+// Radians the cubes rotate per frame.
+constexpr float kRotationPerFrame = 0.01f;
+
+// The vertex shader of the render queue path, whose model-view-projection
+// matrices are computed by the queue.
+const std::string vertex_shader_src =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "uniform mat4 model_view_projection;\n"
+    "out vec3 color_in;\n"
+    "void main() {\n"
+    "gl_Position = model_view_projection * vec4(position, 1.0f);\n"
+    "color_in = position;\n"
+    "}\n";
+
+// The vertex shader of the instanced and the multi-draw paths, which read the
+// model matrix from an InstanceBuffer.
+const std::string instanced_vertex_shader_src =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "layout (location = 12) in mat4 instance_model;\n"
+    "uniform mat4 view_projection;\n"
+    "out vec3 color_in;\n"
+    "void main() {\n"
+    "gl_Position = view_projection * instance_model * vec4(position, 1.0f);\n"
+    "color_in = position;\n"
+    "}\n";
+
+// The vertex shader of the vertex pulling path, which reads the vertices from
+// the storage buffers of a PulledMeshBatch. Its declaration is inserted after
+// the version line.
+const std::string pulled_vertex_shader_body =
+    "layout (location = 12) in mat4 instance_model;\n"
+    "uniform mat4 view_projection;\n"
+    "out vec3 color_in;\n"
+    "void main() {\n"
+    "PulledVertex vertex = PullVertex();\n"
+    "gl_Position = view_projection * instance_model *\n"
+    "              vec4(vertex.position, 1.0f);\n"
+    "color_in = vertex.position;\n"
+    "}\n";
+
+// The vertex shader of the command list path, whose model-view-projection
+// matrices are the constants of the draws. The declaration of the constants
+// is inserted by the RenderDevice.
+const std::string command_list_vertex_shader_src =
+    "#version 430 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "out vec3 color_in;\n"
+    "void main() {\n"
+    "mat4 model_view_projection = mat4(render_constants[0],\n"
+    "    render_constants[1], render_constants[2], render_constants[3]);\n"
+    "gl_Position = model_view_projection * vec4(position, 1.0f);\n"
+    "color_in = position;\n"
+    "}\n";
+
+const std::string fragment_shader_src =
+    "#version 330 core\n"
+    "in vec3 color_in;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "color = vec4(color_in, 1.0f);\n"
+    "}\n";
+
+// Draw paths of the benchmark.
+enum DrawPath {
+  RENDER_QUEUE_PATH = 0,
+  INSTANCED_PATH,
+  MULTI_DRAW_PATH,
+  VERTEX_PULLING_PATH,
+  COMMAND_LIST_PATH
+};
+
+const char* DrawPathName(const DrawPath path) {
+  switch (path) {
+    case INSTANCED_PATH:
+      return "instanced";
+    case MULTI_DRAW_PATH:
+      return "multi_draw";
+    case VERTEX_PULLING_PATH:
+      return "vertex_pulling";
+    case COMMAND_LIST_PATH:
+      return "command_list";
+    default:
+      return "render_queue";
+  }
+}
+
+// Measurements of a draw path.
+struct DrawPathResult {
+  DrawPath path;
+  bool skipped = false;
+  int draw_calls_per_frame = 0;
+  double wall_seconds = 0.0;
+  wvu::ProfileScopeStatistics cpu_frame;
+  wvu::ProfileScopeStatistics gpu_frame;
+  double draws_per_second = 0.0;
+  double triangles_per_second = 0.0;
+};
+
+// The unit cube of draw_triangle.cc, oriented outwards so that the back faces
+// are culled.
+wvu::Model CreateCube() {
+  std::vector<GLuint> indices = {
+    0, 1, 3, 0, 3, 2, 2, 3, 5, 2, 5, 4, 4, 5, 7, 4, 7, 6,
+    0, 1, 7, 0, 7, 6, 0, 2, 4, 0, 4, 6, 1, 3, 5, 1, 5, 7
+  };
+  const std::vector<wvu::PositionVertex> vertices = {
+    {{0.0f, 1.0f, 0.0f}}, {{0.0f, 0.0f, 0.0f}},
+    {{1.0f, 1.0f, 0.0f}}, {{1.0f, 0.0f, 0.0f}},
+    {{1.0f, 1.0f, -1.0f}}, {{1.0f, 0.0f, -1.0f}},
+    {{0.0f, 1.0f, -1.0f}}, {{0.0f, 0.0f, -1.0f}}
+  };
+  wvu::Model cube(Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), vertices,
+                  std::move(indices));
+  wvu::MeshOrientationReport report;
+  std::string error_info_log;
+  if (!wvu::OrientTriangles(&cube, &report, &error_info_log)) {
+    LOG(WARNING) << "Could not orient the cube: " << error_info_log;
+  }
+  return cube;
+}
+
+// Lays the cubes on a square grid facing the camera, which sees all of them.
+std::vector<Eigen::Vector3f> ComputeCubePositions(const int num_objects,
+                                                  float* camera_distance) {
+  const int grid_size = std::ceil(std::sqrt(static_cast<float>(num_objects)));
+  const float extent = grid_size * kCubeSpacing;
+  *camera_distance = 0.5f * extent / std::tan(0.5f * kFieldOfView) + 2.0f;
+  std::vector<Eigen::Vector3f> positions(num_objects);
+  for (int i = 0; i < num_objects; ++i) {
+    positions[i] = Eigen::Vector3f(
+        (i % grid_size) * kCubeSpacing - 0.5f * extent,
+        (i / grid_size) * kCubeSpacing - 0.5f * extent,
+        -*camera_distance);
+  }
+  return positions;
+}
+
+// Computes the model matrices of the cubes in a frame into transforms, 16
+// floats each, e.g., mapped from an InstanceBuffer. Every path updates all of
+// them every frame, as an animated scene would.
+void ComputeTransforms(const std::vector<Eigen::Vector3f>& positions,
+                       const int frame,
+                       GLfloat* transforms) {
+  const Eigen::Matrix3f rotation = Eigen::AngleAxisf(
+      frame * kRotationPerFrame,
+      Eigen::Vector3f(1.0f, 1.0f, 1.0f).normalized()).toRotationMatrix();
+  for (int i = 0; i < static_cast<int>(positions.size()); ++i) {
+    wvu::MappedTransform transform(transforms + 16 * i);
+    transform.setIdentity();
+    transform.topLeftCorner<3, 3>() = rotation;
+    transform.topRightCorner<3, 1>() = positions[i];
+  }
+}
+
+bool CreateProgram(const std::string& vertex_shader,
+                   const Eigen::Matrix4f& view_projection,
+                   wvu::ShaderProgram* program,
+                   std::string* error_info_log) {
+  program->LoadVertexShaderFromString(vertex_shader);
+  program->LoadFragmentShaderFromString(fragment_shader_src);
+  if (!program->Create(error_info_log)) return false;
+  const GLint location = program->GetUniformLocation("view_projection");
+  if (location < 0) return true;
+  program->Use();
+  return program->SetUniform(location, view_projection);
+}
+
+// Renders the warm up and the measured frames of a path.
+class DrawPathBenchmark {
+ public:
+  DrawPathBenchmark(GLFWwindow* window,
+                    const wvu::OffscreenFramebuffer& framebuffer,
+                    const std::vector<Eigen::Vector3f>& positions)
+      : window_(window), framebuffer_(framebuffer), positions_(positions),
+        render_queue_("model"),
+        batch_(wvu::PositionVertex::Layout(), GL_UNSIGNED_INT),
+        batch_mesh_(-1), vertices_(wvu::kInvalidRenderHandle),
+        indices_(wvu::kInvalidRenderHandle),
+        pipeline_(wvu::kInvalidRenderHandle) {
+    pulled_meshes_[0] = pulled_meshes_[1] = -1;
+  }
+
+  bool Initialize(const wvu::Model& cube,
+                  const Eigen::Matrix4f& view_projection,
+                  std::string* error_info_log) {
+    cube_ = cube;
+    mesh_ = wvu::SetVertexArrayObject(cube_);
+    if (!CreateProgram(vertex_shader_src, view_projection, &program_,
+                       error_info_log) ||
+        !CreateProgram(instanced_vertex_shader_src, view_projection,
+                       &instanced_program_, error_info_log)) {
+      return false;
+    }
+    render_queue_.SetViewProjection(Eigen::Matrix4f::Identity(),
+                                    view_projection);
+    // The cubes share one mesh, so the batches hold a single copy of it.
+    if (!instances_.Initialize() ||
+        !batch_.Initialize(cube_.num_vertices(), cube_.num_indices())) {
+      *error_info_log = "Could not create the instance or batch buffers.";
+      return false;
+    }
+    batch_mesh_ = batch_.AddMesh(cube_, error_info_log);
+    if (batch_mesh_ < 0) return false;
+    instances_.Attach(mesh_);
+    instances_.Attach(batch_.vertex_array_object_id());
+    view_projection_ = view_projection;
+    return (!wvu::PulledMeshBatch::Supported() ||
+            InitializeVertexPulling(view_projection, error_info_log)) &&
+        (!wvu::GlRenderDevice::Supported() ||
+         InitializeCommandList(error_info_log));
+  }
+
+  DrawPathResult Run(const DrawPath path) {
+    DrawPathResult result;
+    result.path = path;
+    if ((path == MULTI_DRAW_PATH &&
+         !(GLEW_VERSION_4_2 || GLEW_ARB_base_instance)) ||
+        (path == VERTEX_PULLING_PATH && pulled_meshes_[0] < 0) ||
+        (path == COMMAND_LIST_PATH && device_ == nullptr)) {
+      result.skipped = true;
+      return result;
+    }
+    for (int frame = 0; frame < FLAGS_warmup_frames; ++frame) {
+      RenderFrame(path, frame);
+    }
+    // The profiler keeps the samples of every measured frame.
+    wvu::FrameProfiler profiler(std::max(FLAGS_num_frames, 1));
+    const int cpu_scope = profiler.AddCpuScope("cpu_frame");
+    const int gpu_scope = profiler.AddGpuScope("gpu_frame");
+    const std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    int64_t num_draws = 0;
+    for (int frame = 0; frame < FLAGS_num_frames; ++frame) {
+      profiler.BeginFrame();
+      profiler.BeginScope(cpu_scope);
+      profiler.BeginScope(gpu_scope);
+      num_draws += RenderFrame(path, FLAGS_warmup_frames + frame);
+      profiler.EndScope(gpu_scope);
+      glfwSwapBuffers(window_);
+      profiler.EndScope(cpu_scope);
+    }
+    glFinish();
+    const std::chrono::steady_clock::time_point end =
+        std::chrono::steady_clock::now();
+    // Collect the GPU samples of the last frames.
+    for (int i = 0; i < wvu::kDefaultGpuQueryLatency; ++i) {
+      profiler.BeginFrame();
+    }
+    std::vector<wvu::ProfileScopeStatistics> statistics;
+    profiler.GetStatistics(&statistics);
+    result.cpu_frame = statistics[cpu_scope];
+    result.gpu_frame = statistics[gpu_scope];
+    result.draw_calls_per_frame =
+        FLAGS_num_frames > 0 ? num_draws / FLAGS_num_frames : 0;
+    result.wall_seconds = std::chrono::duration<double>(end - begin).count();
+    if (result.wall_seconds > 0.0) {
+      result.draws_per_second = num_draws / result.wall_seconds;
+      result.triangles_per_second = static_cast<double>(FLAGS_num_frames) *
+          positions_.size() * (cube_.num_indices() / 3) / result.wall_seconds;
+    }
+    return result;
+  }
+
+ private:
+  // Packs the cube and its quantized copy into the pulled batch, whose
+  // vertices have different layouts.
+  bool InitializeVertexPulling(const Eigen::Matrix4f& view_projection,
+                               std::string* error_info_log) {
+    wvu::QuantizationOptions options;
+    options.position_precision = wvu::POSITION_QUANTIZED16;
+    Eigen::Matrix4f dequantization;
+    if (!wvu::QuantizeModel(cube_, options, &quantized_cube_,
+                            &dequantization, nullptr, error_info_log)) {
+      return false;
+    }
+    if (!CreateProgram("#version 430 core\n" +
+                       wvu::PulledMeshBatch::GlslDeclaration() +
+                       pulled_vertex_shader_body,
+                       view_projection, &pulled_program_, error_info_log) ||
+        !pulled_batch_.Initialize(
+            cube_.vertex_data().size() + quantized_cube_.vertex_data().size(),
+            2 * cube_.num_indices(), 2, error_info_log) ||
+        !pulled_batch_.Attach(&pulled_program_)) {
+      return false;
+    }
+    pulled_meshes_[0] = pulled_batch_.AddMesh(cube_, nullptr, error_info_log);
+    pulled_meshes_[1] = pulled_batch_.AddMesh(quantized_cube_,
+                                              &dequantization,
+                                              error_info_log);
+    if (pulled_meshes_[0] < 0 || pulled_meshes_[1] < 0) return false;
+    instances_.Attach(pulled_batch_.vertex_array_object_id());
+    return true;
+  }
+
+  // Creates the render device, and the buffers and the pre-warmed pipeline of
+  // the cube.
+  bool InitializeCommandList(std::string* error_info_log) {
+    device_ = wvu::CreateRenderDevice("gl", error_info_log);
+    if (device_ == nullptr) return false;
+    vertices_ = device_->CreateBuffer(
+        wvu::RENDER_VERTEX_BUFFER, cube_.vertex_data().size(),
+        cube_.vertex_data().data(), false);
+    indices_ = device_->CreateBuffer(
+        wvu::RENDER_INDEX_BUFFER, cube_.indices().size() * sizeof(GLuint),
+        cube_.indices().data(), false);
+    wvu::RenderPipelineDescription description;
+    description.vertex_shader = command_list_vertex_shader_src;
+    description.fragment_shader = fragment_shader_src;
+    description.vertex_layout = cube_.vertex_layout();
+    description.cull_back_faces = mesh_.closed();
+    pipelines_.reset(new wvu::PipelineLibrary(device_.get()));
+    pipeline_ = pipelines_->Register("cube", description, error_info_log);
+    return vertices_ != wvu::kInvalidRenderHandle &&
+        indices_ != wvu::kInvalidRenderHandle &&
+        pipeline_ != wvu::kInvalidRenderHandle &&
+        pipelines_->Prewarm(framebuffer_.num_samples(), error_info_log);
+  }
+
+  // Renders a frame of the path, and returns the number of draw calls.
+  int RenderFrame(const DrawPath path, const int frame) {
+    wvu::GlStateCache* gl_state = wvu::GlStateCache::Current();
+    framebuffer_.Bind();
+    gl_state->ClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    gl_state->DepthMask(true);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gl_state->SetCapability(GL_DEPTH_TEST, true);
+    gl_state->DepthFunc(GL_LESS);
+    const int num_objects = positions_.size();
+    switch (path) {
+      case RENDER_QUEUE_PATH: {
+        render_queue_.Clear();
+        wvu::RenderItem item;
+        item.shader_program = &program_;
+        item.mesh = &mesh_;
+        item.num_indices = cube_.num_indices();
+        transforms_.resize(num_objects);
+        ComputeTransforms(positions_, frame, transforms_.data()->data());
+        for (int i = 0; i < num_objects; ++i) {
+          item.model = transforms_[i];
+          render_queue_.Add(item);
+        }
+        render_queue_.Execute();
+        return render_queue_.statistics().num_draws;
+      }
+      case INSTANCED_PATH:
+        UpdateInstances(frame);
+        instanced_program_.Use();
+        gl_state->SetCapability(GL_CULL_FACE, mesh_.closed());
+        wvu::DrawInstanced(mesh_, instances_);
+        return 1;
+      case MULTI_DRAW_PATH:
+        UpdateInstances(frame);
+        instanced_program_.Use();
+        gl_state->SetCapability(GL_CULL_FACE, mesh_.closed());
+        batch_.ClearDraws();
+        for (int i = 0; i < num_objects; ++i) {
+          batch_.AddDraw(batch_mesh_, 1, instances_.base_instance() + i);
+        }
+        batch_.Submit();
+        return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect ?
+            1 : num_objects;
+      case VERTEX_PULLING_PATH:
+        UpdateInstances(frame);
+        pulled_program_.Use();
+        gl_state->SetCapability(GL_CULL_FACE, mesh_.closed());
+        pulled_batch_.ClearDraws();
+        for (int i = 0; i < num_objects; ++i) {
+          pulled_batch_.AddDraw(pulled_meshes_[i % 2], 1,
+                                instances_.base_instance() + i);
+        }
+        pulled_batch_.Submit();
+        return 1;
+      case COMMAND_LIST_PATH: {
+        transforms_.resize(num_objects);
+        ComputeTransforms(positions_, frame, transforms_.data()->data());
+        // The frame is cleared above.
+        wvu::RenderPassDescription pass;
+        pass.target = framebuffer_.framebuffer_id();
+        pass.width = framebuffer_.width();
+        pass.height = framebuffer_.height();
+        pass.clear_color = pass.clear_depth = false;
+        command_list_.Clear();
+        command_list_.BeginPass(pass);
+        command_list_.BindPipeline(pipeline_);
+        command_list_.BindVertexBuffer(vertices_, 0);
+        command_list_.BindIndexBuffer(indices_, GL_UNSIGNED_INT, 0);
+        for (int i = 0; i < num_objects; ++i) {
+          const Eigen::Matrix4f model_view_projection =
+              view_projection_ * transforms_[i];
+          command_list_.SetConstants(model_view_projection.data(), 4);
+          command_list_.DrawIndexed(cube_.num_indices(), 0);
+        }
+        command_list_.EndPass();
+        device_->Submit(&command_list_, 1);
+        return device_->statistics().num_draws;
+      }
+    }
+    return 0;
+  }
+
+  // Computes the transforms of the frame straight into the mapped instance
+  // buffer.
+  void UpdateInstances(const int frame) {
+    GLfloat* transforms = instances_.MapTransforms(positions_.size());
+    if (transforms == nullptr) return;
+    ComputeTransforms(positions_, frame, transforms);
+    instances_.UnmapTransforms();
+  }
+
+  GLFWwindow* window_;
+  const wvu::OffscreenFramebuffer& framebuffer_;
+  const std::vector<Eigen::Vector3f>& positions_;
+  wvu::Model cube_;
+  wvu::GpuMesh mesh_;
+  wvu::ShaderProgram program_;
+  wvu::ShaderProgram instanced_program_;
+  wvu::RenderQueue render_queue_;
+  wvu::InstanceBuffer instances_;
+  wvu::MeshBatch batch_;
+  int batch_mesh_;
+  wvu::Model quantized_cube_;
+  wvu::ShaderProgram pulled_program_;
+  wvu::PulledMeshBatch pulled_batch_;
+  // The meshes of the cube and of its quantized copy.
+  int pulled_meshes_[2];
+  wvu::InstanceTransforms transforms_;
+  Eigen::Matrix4f view_projection_;
+  std::unique_ptr<wvu::RenderDevice> device_;
+  std::unique_ptr<wvu::PipelineLibrary> pipelines_;
+  wvu::RenderBufferHandle vertices_;
+  wvu::RenderBufferHandle indices_;
+  wvu::RenderPipelineHandle pipeline_;
+  wvu::CommandList command_list_;
+
+  DrawPathBenchmark(const DrawPathBenchmark&) = delete;
+  DrawPathBenchmark& operator=(const DrawPathBenchmark&) = delete;
+};
+
+// Parses the comma-separated names of --draw_paths.
+bool ParseDrawPaths(const std::string& names, std::vector<DrawPath>* paths) {
+  std::stringstream stream(names);
+  std::string name;
+  while (std::getline(stream, name, ',')) {
+    if (name == "render_queue") {
+      paths->push_back(RENDER_QUEUE_PATH);
+    } else if (name == "instanced") {
+      paths->push_back(INSTANCED_PATH);
+    } else if (name == "multi_draw") {
+      paths->push_back(MULTI_DRAW_PATH);
+    } else if (name == "vertex_pulling") {
+      paths->push_back(VERTEX_PULLING_PATH);
+    } else if (name == "command_list") {
+      paths->push_back(COMMAND_LIST_PATH);
+    } else {
+      LOG(ERROR) << "Unknown draw path " << name;
+      return false;
+    }
+  }
+  return !paths->empty();
+}
+
+// Returns the string as a JSON string literal.
+std::string JsonString(const char* value) {
+  std::string json = "\"";
+  for (const char* c = value; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') json += '\\';
+    json += *c;
+  }
+  return json + "\"";
+}
+
+void WriteFrameTimes(const wvu::ProfileScopeStatistics& statistics,
+                     std::ostringstream* json) {
+  if (statistics.num_samples == 0) {
+    *json << "null";
+    return;
+  }
+  *json << "{\"samples\": " << statistics.num_samples
+        << ", \"min\": " << statistics.min_ms
+        << ", \"average\": " << statistics.average_ms
+        << ", \"p99\": " << statistics.p99_ms
+        << ", \"max\": " << statistics.max_ms << "}";
+}
+
+std::string ToJson(const std::vector<DrawPathResult>& results) {
+  std::ostringstream json;
+  json << "{\n"
+       << "  \"renderer\": " << JsonString(reinterpret_cast<const char*>(
+              glGetString(GL_RENDERER))) << ",\n"
+       << "  \"version\": " << JsonString(reinterpret_cast<const char*>(
+              glGetString(GL_VERSION))) << ",\n"
+       << "  \"num_objects\": " << FLAGS_num_objects << ",\n"
+       << "  \"num_frames\": " << FLAGS_num_frames << ",\n"
+       << "  \"width\": " << FLAGS_width << ",\n"
+       << "  \"height\": " << FLAGS_height << ",\n"
+       << "  \"paths\": [";
+  for (int i = 0; i < static_cast<int>(results.size()); ++i) {
+    const DrawPathResult& result = results[i];
+    json << (i == 0 ? "\n" : ",\n")
+         << "    {\"name\": " << JsonString(DrawPathName(result.path));
+    if (result.skipped) {
+      json << ", \"skipped\": true}";
+      continue;
+    }
+    json << ", \"draw_calls_per_frame\": " << result.draw_calls_per_frame
+         << ", \"wall_seconds\": " << result.wall_seconds
+         << ",\n     \"cpu_frame_ms\": ";
+    WriteFrameTimes(result.cpu_frame, &json);
+    json << ",\n     \"gpu_frame_ms\": ";
+    WriteFrameTimes(result.gpu_frame, &json);
+    json << ",\n     \"draws_per_second\": " << result.draws_per_second
+         << ", \"triangles_per_second\": " << result.triangles_per_second
+         << "}";
+  }
+  json << "\n  ]\n}\n";
+  return json.str();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CS470_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  std::vector<DrawPath> paths;
+  if (FLAGS_num_objects <= 0 || !ParseDrawPaths(FLAGS_draw_paths, &paths)) {
+    LOG(ERROR) << "Nothing to benchmark.";
+    return -1;
+  }
+  if (!glfwInit()) {
+    return -1;
+  }
+  // The frames go to an offscreen framebuffer, so the window is only there to
+  // own the context.
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  GLFWwindow* window =
+      glfwCreateWindow(64, 64, "render_bench", nullptr, nullptr);
+  if (!window) {
+    glfwTerminate();
+    return -1;
+  }
+  glfwMakeContextCurrent(window);
+  // The frames are rendered as fast as possible.
+  glfwSwapInterval(0);
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK) {
+    LOG(ERROR) << "Glew did not initialize properly!";
+    glfwTerminate();
+    return -1;
+  }
+
+  std::string error_info_log;
+  int exit_code = 0;
+  {
+    wvu::OffscreenFramebuffer framebuffer;
+    if (!framebuffer.Initialize(FLAGS_width, FLAGS_height, &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      glfwTerminate();
+      return -1;
+    }
+    float camera_distance;
+    const std::vector<Eigen::Vector3f> positions =
+        ComputeCubePositions(FLAGS_num_objects, &camera_distance);
+    const Eigen::Matrix4f projection =
+        wvu::ToMatrix(wvu::ComputePerspectiveProjection(
+            kFieldOfView, static_cast<float>(FLAGS_width) / FLAGS_height,
+            0.1f, 2.0f * camera_distance));
+    DrawPathBenchmark benchmark(window, framebuffer, positions);
+    if (!benchmark.Initialize(CreateCube(), projection, &error_info_log)) {
+      LOG(ERROR) << "Could not set up the scene: " << error_info_log;
+      exit_code = -1;
+    } else {
+      std::vector<DrawPathResult> results;
+      for (const DrawPath path : paths) {
+        results.push_back(benchmark.Run(path));
+      }
+      const std::string json = ToJson(results);
+      if (FLAGS_output_file.empty()) {
+        std::fputs(json.c_str(), stdout);
+      } else {
+        std::ofstream file(FLAGS_output_file);
+        file << json;
+        if (!file) {
+          LOG(ERROR) << "Could not write " << FLAGS_output_file;
+          exit_code = -1;
+        }
+      }
+    }
+  }
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return exit_code;
+}
@@ -0,0 +1,479 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "render_device.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "model.h"
+#include "shader_program.h"
+#include "shared_vertex_arrays.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+
+// Returns the GL buffer target and the category of the buffers of the usage.
+void BufferTargetAndCategory(const RenderBufferUsage usage,
+                             GLenum* target,
+                             BufferCategory* category) {
+  switch (usage) {
+    case RENDER_VERTEX_BUFFER:
+      *target = GL_ARRAY_BUFFER;
+      *category = VERTEX_DATA;
+      break;
+    case RENDER_INDEX_BUFFER:
+      *target = GL_ELEMENT_ARRAY_BUFFER;
+      *category = INDEX_DATA;
+      break;
+    case RENDER_UNIFORM_BUFFER:
+      *target = GL_UNIFORM_BUFFER;
+      *category = UNIFORM_DATA;
+      break;
+    case RENDER_STORAGE_BUFFER:
+      *target = GL_SHADER_STORAGE_BUFFER;
+      *category = STORAGE_DATA;
+      break;
+  }
+}
+
+// Inserts the declaration after the version line of the source, or before
+// the source if it has none.
+std::string InsertDeclaration(const std::string& source,
+                              const std::string& declaration) {
+  const size_t version = source.find("#version");
+  if (version == std::string::npos) {
+    return declaration + source;
+  }
+  const size_t end_of_line = source.find('\n', version);
+  if (end_of_line == std::string::npos) {
+    return source + "\n" + declaration;
+  }
+  return source.substr(0, end_of_line + 1) + declaration +
+         source.substr(end_of_line + 1);
+}
+
+}  // namespace
+
+void CommandList::Clear() {
+  commands_.clear();
+  passes_.clear();
+  constants_.clear();
+  num_draws_ = 0;
+}
+
+RenderCommand* CommandList::Add(const RenderCommandType type) {
+  commands_.emplace_back();
+  RenderCommand* command = &commands_.back();
+  command->type = type;
+  command->handle = kInvalidRenderHandle;
+  command->arguments[0] = command->arguments[1] = 0;
+  command->arguments[2] = command->arguments[3] = 0;
+  command->offset = 0;
+  command->size = 0;
+  return command;
+}
+
+void CommandList::BeginPass(const RenderPassDescription& pass) {
+  RenderCommand* command = Add(RENDER_BEGIN_PASS);
+  command->arguments[0] = passes_.size();
+  passes_.push_back(pass);
+}
+
+void CommandList::EndPass() {
+  Add(RENDER_END_PASS);
+}
+
+void CommandList::BindPipeline(const RenderPipelineHandle pipeline) {
+  Add(RENDER_BIND_PIPELINE)->handle = pipeline;
+}
+
+void CommandList::BindVertexBuffer(const RenderBufferHandle buffer,
+                                   const size_t offset) {
+  RenderCommand* command = Add(RENDER_BIND_VERTEX_BUFFER);
+  command->handle = buffer;
+  command->offset = offset;
+}
+
+void CommandList::BindIndexBuffer(const RenderBufferHandle buffer,
+                                  const GLenum index_type,
+                                  const size_t offset) {
+  RenderCommand* command = Add(RENDER_BIND_INDEX_BUFFER);
+  command->handle = buffer;
+  command->arguments[0] = index_type;
+  command->offset = offset;
+}
+
+void CommandList::BindUniformBuffer(const GLuint binding_point,
+                                    const RenderBufferHandle buffer,
+                                    const size_t offset,
+                                    const size_t size) {
+  RenderCommand* command = Add(RENDER_BIND_UNIFORM_BUFFER);
+  command->handle = buffer;
+  command->arguments[0] = binding_point;
+  command->offset = offset;
+  command->size = size;
+}
+
+void CommandList::BindStorageBuffer(const GLuint binding_point,
+                                    const RenderBufferHandle buffer,
+                                    const size_t offset,
+                                    const size_t size) {
+  RenderCommand* command = Add(RENDER_BIND_STORAGE_BUFFER);
+  command->handle = buffer;
+  command->arguments[0] = binding_point;
+  command->offset = offset;
+  command->size = size;
+}
+
+void CommandList::SetConstants(const GLfloat* constants,
+                               const int num_constants) {
+  const int num_floats = 4 * std::min(num_constants, kMaxRenderConstants);
+  RenderCommand* command = Add(RENDER_SET_CONSTANTS);
+  command->arguments[0] = num_floats / 4;
+  command->offset = constants_.size();
+  constants_.insert(constants_.end(), constants, constants + num_floats);
+}
+
+void CommandList::Draw(const int num_vertices,
+                       const int first_vertex,
+                       const int num_instances,
+                       const int base_instance) {
+  RenderCommand* command = Add(RENDER_DRAW);
+  command->arguments[0] = num_vertices;
+  command->arguments[1] = first_vertex;
+  command->arguments[2] = num_instances;
+  command->arguments[3] = base_instance;
+  ++num_draws_;
+}
+
+void CommandList::DrawIndexed(const int num_indices,
+                              const int first_index,
+                              const int num_instances,
+                              const int base_vertex,
+                              const int base_instance) {
+  RenderCommand* command = Add(RENDER_DRAW_INDEXED);
+  command->arguments[0] = num_indices;
+  command->arguments[1] = first_index;
+  command->arguments[2] = num_instances;
+  command->arguments[3] = base_instance;
+  // The base vertex may be negative.
+  command->size = static_cast<uint32_t>(base_vertex);
+  ++num_draws_;
+}
+
+GlRenderDevice::GlRenderDevice() {}
+
+GlRenderDevice::~GlRenderDevice() {
+  for (Buffer& buffer : buffers_) {
+    BufferAllocator::Get()->DeleteBuffer(&buffer.buffer_id);
+  }
+  pipelines_.clear();
+}
+
+bool GlRenderDevice::Supported() {
+  return SharedVertexArrays::Supported() &&
+         (GLEW_VERSION_4_2 || GLEW_ARB_base_instance);
+}
+
+GLuint GlRenderDevice::BufferId(const RenderBufferHandle buffer) const {
+  if (buffer == kInvalidRenderHandle || buffer > buffers_.size()) {
+    return 0;
+  }
+  return buffers_[buffer - 1].buffer_id;
+}
+
+RenderBufferHandle GlRenderDevice::CreateBuffer(const RenderBufferUsage usage,
+                                                const size_t size,
+                                                const void* data,
+                                                const bool dynamic) {
+  Buffer buffer;
+  BufferCategory category;
+  BufferTargetAndCategory(usage, &buffer.target, &category);
+  BufferAllocator* allocator = BufferAllocator::Get();
+  buffer.buffer_id = allocator->CreateBuffer(category);
+  if (buffer.buffer_id == 0) {
+    return kInvalidRenderHandle;
+  }
+  // Index buffers are bound to the vertex array objects, so they are filled
+  // through the array buffer target.
+  const GLenum target = usage == RENDER_INDEX_BUFFER ?
+      GL_ARRAY_BUFFER : buffer.target;
+  GlStateCache::Current()->BindBuffer(target, buffer.buffer_id);
+  allocator->BufferData(buffer.buffer_id, target, size, data,
+                        dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+  if (!free_buffers_.empty()) {
+    const int index = free_buffers_.back();
+    free_buffers_.pop_back();
+    buffers_[index] = buffer;
+    return index + 1;
+  }
+  buffers_.push_back(buffer);
+  return buffers_.size();
+}
+
+bool GlRenderDevice::UpdateBuffer(const RenderBufferHandle buffer,
+                                  const size_t offset,
+                                  const size_t size,
+                                  const void* data) {
+  const GLuint buffer_id = BufferId(buffer);
+  if (buffer_id == 0) {
+    return false;
+  }
+  GlStateCache::Current()->BindBuffer(GL_ARRAY_BUFFER, buffer_id);
+  glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+  return true;
+}
+
+void GlRenderDevice::DestroyBuffer(const RenderBufferHandle buffer) {
+  if (BufferId(buffer) == 0) {
+    return;
+  }
+  // OpenGL keeps the storage alive until the submitted commands complete.
+  BufferAllocator::Get()->DeleteBuffer(&buffers_[buffer - 1].buffer_id);
+  free_buffers_.push_back(buffer - 1);
+}
+
+std::string GlRenderDevice::ConstantsGlslDeclaration() const {
+  return "uniform vec4 render_constants[" +
+         std::to_string(kMaxRenderConstants) + "];\n";
+}
+
+RenderPipelineHandle GlRenderDevice::CreatePipeline(
+    const RenderPipelineDescription& description,
+    std::string* error_info_log) {
+  std::unique_ptr<Pipeline> pipeline(new Pipeline);
+  pipeline->description = description;
+  pipeline->program.reset(new ShaderProgram);
+  const std::string declaration = ConstantsGlslDeclaration();
+  if (!pipeline->program->LoadVertexShaderFromString(
+          InsertDeclaration(description.vertex_shader, declaration)) ||
+      !pipeline->program->LoadFragmentShaderFromString(
+          InsertDeclaration(description.fragment_shader, declaration)) ||
+      !pipeline->program->Create(error_info_log)) {
+    return kInvalidRenderHandle;
+  }
+  pipeline->constants_location =
+      pipeline->program->GetUniformLocation("render_constants");
+  // Creates the vertex array object of the layout now rather than while
+  // drawing.
+  vertex_arrays_.VertexArray(description.vertex_layout);
+  if (!free_pipelines_.empty()) {
+    const int index = free_pipelines_.back();
+    free_pipelines_.pop_back();
+    pipelines_[index] = std::move(pipeline);
+    return index + 1;
+  }
+  pipelines_.push_back(std::move(pipeline));
+  return pipelines_.size();
+}
+
+void GlRenderDevice::DestroyPipeline(const RenderPipelineHandle pipeline) {
+  if (pipeline == kInvalidRenderHandle || pipeline > pipelines_.size() ||
+      pipelines_[pipeline - 1] == nullptr) {
+    return;
+  }
+  pipelines_[pipeline - 1].reset();
+  free_pipelines_.push_back(pipeline - 1);
+}
+
+void GlRenderDevice::Submit(const CommandList* command_lists,
+                            const int num_command_lists) {
+  statistics_ = RenderDeviceStatistics();
+  GlStateCache* gl_state = GlStateCache::Current();
+  const Pipeline* pipeline = nullptr;
+  GLuint vertex_array_object_id = 0;
+  // The vertex buffer and the index buffer of the next draws, and the vertex
+  // buffer attached to the bound vertex array object.
+  GLuint vertex_buffer_id = 0;
+  GLintptr vertex_buffer_offset = 0;
+  bool vertex_buffer_attached = false;
+  GLuint index_buffer_id = 0;
+  GLenum index_type = GL_UNSIGNED_INT;
+  size_t index_buffer_offset = 0;
+  // The constants are uniforms of the program, so they are set again when the
+  // program changes.
+  GLfloat constants[4 * kMaxRenderConstants] = {0.0f};
+  int num_constants = 0;
+  bool constants_dirty = false;
+
+  for (int i = 0; i < num_command_lists; ++i) {
+    const CommandList& command_list = command_lists[i];
+    for (const RenderCommand& command : command_list.commands()) {
+      ++statistics_.num_commands;
+      switch (command.type) {
+        case RENDER_BEGIN_PASS: {
+          const RenderPassDescription& pass = command_list.pass(command);
+          glBindFramebuffer(GL_FRAMEBUFFER, pass.target);
+          glViewport(0, 0, pass.width, pass.height);
+          GLbitfield mask = 0;
+          if (pass.clear_color) {
+            gl_state->ColorMask(true);
+            gl_state->ClearColor(
+                pass.clear_color_value[0], pass.clear_color_value[1],
+                pass.clear_color_value[2], pass.clear_color_value[3]);
+            mask |= GL_COLOR_BUFFER_BIT;
+          }
+          if (pass.clear_depth) {
+            gl_state->DepthMask(true);
+            glClearDepth(pass.clear_depth_value);
+            mask |= GL_DEPTH_BUFFER_BIT;
+          }
+          if (mask != 0) {
+            glClear(mask);
+          }
+          break;
+        }
+        case RENDER_END_PASS:
+          break;
+        case RENDER_BIND_PIPELINE: {
+          if (command.handle == kInvalidRenderHandle ||
+              command.handle > pipelines_.size() ||
+              pipelines_[command.handle - 1] == nullptr) {
+            pipeline = nullptr;
+            break;
+          }
+          const Pipeline* next_pipeline = pipelines_[command.handle - 1].get();
+          if (next_pipeline == pipeline) {
+            break;
+          }
+          pipeline = next_pipeline;
+          ++statistics_.num_pipeline_changes;
+          const RenderPipelineDescription& description =
+              pipeline->description;
+          pipeline->program->Use();
+          gl_state->SetCapability(GL_DEPTH_TEST, description.depth_test);
+          gl_state->DepthMask(description.depth_write);
+          gl_state->SetCapability(GL_CULL_FACE, description.cull_back_faces);
+          gl_state->SetCapability(GL_BLEND, description.alpha_blending);
+          if (description.alpha_blending) {
+            gl_state->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+          }
+          const GLuint next_vertex_array_object_id =
+              vertex_arrays_.VertexArray(description.vertex_layout);
+          if (next_vertex_array_object_id != vertex_array_object_id) {
+            vertex_array_object_id = next_vertex_array_object_id;
+            gl_state->BindVertexArray(vertex_array_object_id);
+            vertex_buffer_attached = false;
+          }
+          constants_dirty = num_constants > 0;
+          break;
+        }
+        case RENDER_BIND_VERTEX_BUFFER:
+          vertex_buffer_id = BufferId(command.handle);
+          vertex_buffer_offset = command.offset;
+          vertex_buffer_attached = false;
+          break;
+        case RENDER_BIND_INDEX_BUFFER:
+          index_buffer_id = BufferId(command.handle);
+          index_type = command.arguments[0];
+          index_buffer_offset = command.offset;
+          break;
+        case RENDER_BIND_UNIFORM_BUFFER:
+          gl_state->BindBufferRange(GL_UNIFORM_BUFFER, command.arguments[0],
+                                    BufferId(command.handle), command.offset,
+                                    command.size);
+          break;
+        case RENDER_BIND_STORAGE_BUFFER:
+          gl_state->BindBufferRange(GL_SHADER_STORAGE_BUFFER,
+                                    command.arguments[0],
+                                    BufferId(command.handle), command.offset,
+                                    command.size);
+          break;
+        case RENDER_SET_CONSTANTS:
+          num_constants = command.arguments[0];
+          std::memcpy(constants, command_list.constants(command),
+                      4 * num_constants * sizeof(constants[0]));
+          constants_dirty = true;
+          break;
+        case RENDER_DRAW:
+        case RENDER_DRAW_INDEXED: {
+          if (pipeline == nullptr) {
+            break;
+          }
+          if (constants_dirty && pipeline->constants_location >= 0) {
+            glUniform4fv(pipeline->constants_location, num_constants,
+                         constants);
+          }
+          constants_dirty = false;
+          if (!vertex_buffer_attached) {
+            glBindVertexBuffer(0, vertex_buffer_id, vertex_buffer_offset,
+                               pipeline->description.vertex_layout.stride());
+            vertex_buffer_attached = true;
+          }
+          const GLenum mode = pipeline->description.primitive_type;
+          if (command.type == RENDER_DRAW) {
+            glDrawArraysInstancedBaseInstance(
+                mode, command.arguments[1], command.arguments[0],
+                command.arguments[2], command.arguments[3]);
+          } else {
+            // Elided unless the vertex array object changed.
+            gl_state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_id);
+            const size_t offset = index_buffer_offset +
+                command.arguments[1] * IndexSize(index_type);
+            glDrawElementsInstancedBaseVertexBaseInstance(
+                mode, command.arguments[0], index_type,
+                reinterpret_cast<const GLvoid*>(offset), command.arguments[2],
+                static_cast<GLint>(static_cast<uint32_t>(command.size)),
+                command.arguments[3]);
+          }
+          ++statistics_.num_draws;
+          break;
+        }
+      }
+    }
+  }
+}
+
+std::unique_ptr<RenderDevice> CreateRenderDevice(const std::string& backend,
+                                                 std::string* error_info_log) {
+  if (backend == "gl") {
+    if (!GlRenderDevice::Supported()) {
+      *error_info_log = "The gl render backend needs OpenGL 4.3.";
+      return nullptr;
+    }
+    return std::unique_ptr<RenderDevice>(new GlRenderDevice);
+  }
+  *error_info_log = "Unknown render backend: " + backend + ".";
+  return nullptr;
+}
+
+}  // namespace wvu
@@ -0,0 +1,357 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_RENDER_DEVICE_H_
+#define GLUTILS_RENDER_DEVICE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "shader_program.h"
+#include "shared_vertex_arrays.h"
+#include "vertex_format.h"
+
+namespace wvu {
+// Handles of the objects of a RenderDevice. Zero is never a valid handle.
+typedef uint32_t RenderBufferHandle;
+typedef uint32_t RenderPipelineHandle;
+constexpr uint32_t kInvalidRenderHandle = 0;
+
+// Number of vec4 constants a draw may set with CommandList::SetConstants():
+// 128 bytes, the push constants every Vulkan implementation supports.
+constexpr int kMaxRenderConstants = 8;
+
+// What a buffer of a RenderDevice holds.
+enum RenderBufferUsage {
+  RENDER_VERTEX_BUFFER = 0,
+  RENDER_INDEX_BUFFER,
+  RENDER_UNIFORM_BUFFER,
+  RENDER_STORAGE_BUFFER
+};
+
+// The programs and the fixed-function state of draws, set all at once by
+// CommandList::BindPipeline(), as Vulkan pipelines are immutable.
+struct RenderPipelineDescription {
+  // GLSL sources of the shaders. The declaration of the constants of the
+  // draws, RenderDevice::ConstantsGlslDeclaration(), is inserted after the
+  // version line of both.
+  std::string vertex_shader;
+  std::string fragment_shader;
+  // The layout of the vertices, read from the buffer of
+  // CommandList::BindVertexBuffer().
+  VertexLayout vertex_layout;
+  GLenum primitive_type = GL_TRIANGLES;
+  bool depth_test = true;
+  bool depth_write = true;
+  bool cull_back_faces = false;
+  // Blends the colors by their alpha.
+  bool alpha_blending = false;
+};
+
+// The target and the clears of a render pass.
+struct RenderPassDescription {
+  // The render target: the id of a framebuffer object on OpenGL, where 0 is
+  // the window.
+  uint32_t target = 0;
+  int width = 0;
+  int height = 0;
+  bool clear_color = true;
+  float clear_color_value[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+  bool clear_depth = true;
+  float clear_depth_value = 1.0f;
+};
+
+// Commands recorded into a CommandList.
+enum RenderCommandType {
+  RENDER_BEGIN_PASS = 0,
+  RENDER_END_PASS,
+  RENDER_BIND_PIPELINE,
+  RENDER_BIND_VERTEX_BUFFER,
+  RENDER_BIND_INDEX_BUFFER,
+  RENDER_BIND_UNIFORM_BUFFER,
+  RENDER_BIND_STORAGE_BUFFER,
+  RENDER_SET_CONSTANTS,
+  RENDER_DRAW,
+  RENDER_DRAW_INDEXED
+};
+
+// A recorded command. The meaning of the arguments depends on the type; see
+// the functions of CommandList that record them.
+struct RenderCommand {
+  RenderCommandType type;
+  uint32_t handle;
+  uint32_t arguments[4];
+  uint64_t offset;
+  uint64_t size;
+};
+
+// This class records draw commands without calling the graphics API, so that
+// command lists are recorded on any thread, e.g., one per job of a JobSystem,
+// and executed in order by RenderDevice::Submit() on the thread of the
+// device. The commands refer to the objects of the device by handle, and are
+// independent of the backend. A list is recorded once and may be submitted
+// many times; Clear() keeps its storage for the next recording.
+//
+// Example:
+//
+// wvu::CommandList commands;
+// commands.BeginPass(pass);
+// commands.BindPipeline(pipeline);
+// commands.BindVertexBuffer(vertices, 0);
+// commands.BindIndexBuffer(indices, GL_UNSIGNED_INT, 0);
+// for (const Eigen::Matrix4f& model_view_projection : matrices) {
+//   commands.SetConstants(model_view_projection.data(), 4);
+//   commands.DrawIndexed(num_indices, 0);
+// }
+// commands.EndPass();
+// device->Submit(&commands, 1);
+class CommandList {
+ public:
+  CommandList() : num_draws_(0) {}
+  ~CommandList() {}
+
+  // Removes the commands.
+  void Clear();
+
+  // Starts a render pass: binds its target and clears it. The draws must
+  // happen within a pass.
+  void BeginPass(const RenderPassDescription& pass);
+  void EndPass();
+
+  // Sets the programs and the state of the next draws.
+  void BindPipeline(const RenderPipelineHandle pipeline);
+
+  // Binds the vertex buffer read by the next draws, from offset bytes.
+  void BindVertexBuffer(const RenderBufferHandle buffer, const size_t offset);
+
+  // Binds the index buffer read by the next indexed draws, holding indices
+  // of index_type from offset bytes.
+  void BindIndexBuffer(const RenderBufferHandle buffer,
+                       const GLenum index_type,
+                       const size_t offset);
+
+  // Binds size bytes of a buffer from offset to the uniform block or the
+  // shader storage block of binding_point.
+  void BindUniformBuffer(const GLuint binding_point,
+                         const RenderBufferHandle buffer,
+                         const size_t offset,
+                         const size_t size);
+  void BindStorageBuffer(const GLuint binding_point,
+                         const RenderBufferHandle buffer,
+                         const size_t offset,
+                         const size_t size);
+
+  // Sets the first num_constants vec4 constants of the next draws, at most
+  // kMaxRenderConstants, from 4 * num_constants floats. The constants are
+  // copied into the list.
+  void SetConstants(const GLfloat* constants, const int num_constants);
+
+  // Draws num_vertices vertices from first_vertex.
+  void Draw(const int num_vertices,
+            const int first_vertex,
+            const int num_instances = 1,
+            const int base_instance = 0);
+
+  // Draws num_indices indices from first_index, whose vertices are offset by
+  // base_vertex.
+  void DrawIndexed(const int num_indices,
+                   const int first_index,
+                   const int num_instances = 1,
+                   const int base_vertex = 0,
+                   const int base_instance = 0);
+
+  const std::vector<RenderCommand>& commands() const {
+    return commands_;
+  }
+
+  // Returns the pass of a RENDER_BEGIN_PASS command.
+  const RenderPassDescription& pass(const RenderCommand& command) const {
+    return passes_[command.arguments[0]];
+  }
+
+  // Returns the constants of a RENDER_SET_CONSTANTS command.
+  const GLfloat* constants(const RenderCommand& command) const {
+    return constants_.data() + command.offset;
+  }
+
+  int num_draws() const {
+    return num_draws_;
+  }
+
+ private:
+  // Appends a command of the type, and returns it.
+  RenderCommand* Add(const RenderCommandType type);
+
+  std::vector<RenderCommand> commands_;
+  std::vector<RenderPassDescription> passes_;
+  std::vector<GLfloat> constants_;
+  int num_draws_;
+
+  CommandList(const CommandList&) = delete;
+  CommandList& operator=(const CommandList&) = delete;
+};
+
+// Counters of the last RenderDevice::Submit().
+struct RenderDeviceStatistics {
+  int num_commands = 0;
+  int num_draws = 0;
+  int num_pipeline_changes = 0;
+};
+
+// Interface of the render backends. A device owns the buffers and the
+// pipelines, and executes the command lists recorded against them. Its
+// functions must be called on the thread of its context. The backends share
+// the semantics of Vulkan, so that explicit APIs implement them directly:
+// pipelines are immutable, draws happen within passes, and the per-draw
+// constants are push constants.
+class RenderDevice {
+ public:
+  virtual ~RenderDevice() {}
+
+  // Creates a buffer of size bytes, initialized with data if not nullptr.
+  // Dynamic buffers are updated often. Returns kInvalidRenderHandle if the
+  // buffer could not be created.
+  virtual RenderBufferHandle CreateBuffer(const RenderBufferUsage usage,
+                                          const size_t size,
+                                          const void* data,
+                                          const bool dynamic) = 0;
+
+  // Copies size bytes of data into the buffer from offset. The copy is
+  // ordered before the commands submitted later. Returns true if successful.
+  virtual bool UpdateBuffer(const RenderBufferHandle buffer,
+                            const size_t offset,
+                            const size_t size,
+                            const void* data) = 0;
+
+  // Destroys the buffer once the submitted commands no longer read it.
+  virtual void DestroyBuffer(const RenderBufferHandle buffer) = 0;
+
+  // Compiles the pipeline. Returns kInvalidRenderHandle and the error in
+  // error_info_log if it failed.
+  virtual RenderPipelineHandle CreatePipeline(
+      const RenderPipelineDescription& description,
+      std::string* error_info_log) = 0;
+
+  virtual void DestroyPipeline(const RenderPipelineHandle pipeline) = 0;
+
+  // Executes the command lists in order.
+  virtual void Submit(const CommandList* command_lists,
+                      const int num_command_lists) = 0;
+
+  // Returns the GLSL declaration of the constants set by
+  // CommandList::SetConstants(), an array of kMaxRenderConstants vec4 named
+  // render_constants.
+  virtual std::string ConstantsGlslDeclaration() const = 0;
+
+  // Returns the name of the backend.
+  virtual const char* name() const = 0;
+
+  virtual RenderDeviceStatistics statistics() const = 0;
+};
+
+// The OpenGL backend. The pipelines share one vertex array object per vertex
+// layout (see SharedVertexArrays), and the state changes go through the
+// GlStateCache, so binding the same state again costs nothing. The
+// constants are a uniform array. Needs OpenGL 4.3, for separate attribute
+// formats and base instances.
+class GlRenderDevice : public RenderDevice {
+ public:
+  GlRenderDevice();
+  ~GlRenderDevice() override;
+
+  // Returns true if the context supports the backend.
+  static bool Supported();
+
+  RenderBufferHandle CreateBuffer(const RenderBufferUsage usage,
+                                  const size_t size,
+                                  const void* data,
+                                  const bool dynamic) override;
+  bool UpdateBuffer(const RenderBufferHandle buffer,
+                    const size_t offset,
+                    const size_t size,
+                    const void* data) override;
+  void DestroyBuffer(const RenderBufferHandle buffer) override;
+  RenderPipelineHandle CreatePipeline(
+      const RenderPipelineDescription& description,
+      std::string* error_info_log) override;
+  void DestroyPipeline(const RenderPipelineHandle pipeline) override;
+  void Submit(const CommandList* command_lists,
+              const int num_command_lists) override;
+  std::string ConstantsGlslDeclaration() const override;
+  const char* name() const override {
+    return "gl";
+  }
+  RenderDeviceStatistics statistics() const override {
+    return statistics_;
+  }
+
+ private:
+  struct Buffer {
+    GLuint buffer_id = 0;
+    GLenum target = GL_ARRAY_BUFFER;
+  };
+
+  struct Pipeline {
+    std::unique_ptr<ShaderProgram> program;
+    RenderPipelineDescription description;
+    GLint constants_location = -1;
+  };
+
+  // Returns the id of a live buffer, or 0.
+  GLuint BufferId(const RenderBufferHandle buffer) const;
+
+  // The objects by handle - 1. The slots of the destroyed ones are reused.
+  std::vector<Buffer> buffers_;
+  std::vector<int> free_buffers_;
+  std::vector<std::unique_ptr<Pipeline> > pipelines_;
+  std::vector<int> free_pipelines_;
+  SharedVertexArrays vertex_arrays_;
+  RenderDeviceStatistics statistics_;
+
+  GlRenderDevice(const GlRenderDevice&) = delete;
+  GlRenderDevice& operator=(const GlRenderDevice&) = delete;
+};
+
+// Returns the device of the backend named backend, "gl", or nullptr with the
+// reason in error_info_log if the backend is unknown or not supported.
+std::unique_ptr<RenderDevice> CreateRenderDevice(const std::string& backend,
+                                                 std::string* error_info_log);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_RENDER_DEVICE_H_
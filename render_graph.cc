@@ -0,0 +1,373 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "render_graph.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+namespace {
+// Returns true if the format is attached as the depth of a framebuffer.
+bool IsDepthFormat(const GLenum internal_format) {
+  switch (internal_format) {
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+    case GL_DEPTH32F_STENCIL8:
+      return true;
+  }
+  return false;
+}
+
+// Returns true if the depth format also holds the stencil.
+bool HasStencil(const GLenum internal_format) {
+  return internal_format == GL_DEPTH24_STENCIL8 ||
+      internal_format == GL_DEPTH32F_STENCIL8;
+}
+
+// Returns the bytes of a texel of the common render target formats, and 4
+// for the others.
+int BytesPerTexel(const GLenum internal_format) {
+  switch (internal_format) {
+    case GL_R8:
+      return 1;
+    case GL_RG8:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+      return 2;
+    case GL_RGBA16F:
+    case GL_RG32F:
+    case GL_DEPTH32F_STENCIL8:
+      return 8;
+    case GL_RGBA32F:
+      return 16;
+  }
+  return 4;
+}
+
+size_t TextureBytes(const RenderGraphTextureDescription& description) {
+  return static_cast<size_t>(description.width) * description.height *
+      BytesPerTexel(description.internal_format);
+}
+
+}  // namespace
+
+RenderGraph::RenderGraph() {}
+
+RenderGraph::~RenderGraph() {
+  Reset();
+}
+
+void RenderGraph::Clear() {
+  resources_.clear();
+  passes_.clear();
+}
+
+int RenderGraph::CreateTexture(
+    const std::string& name,
+    const RenderGraphTextureDescription& description) {
+  Resource resource;
+  resource.name = name;
+  resource.description = description;
+  resources_.push_back(resource);
+  return resources_.size() - 1;
+}
+
+int RenderGraph::ImportTexture(
+    const std::string& name,
+    const GLuint texture_id,
+    const RenderGraphTextureDescription& description) {
+  Resource resource;
+  resource.name = name;
+  resource.description = description;
+  resource.imported = true;
+  resource.object_id = texture_id;
+  resources_.push_back(resource);
+  return resources_.size() - 1;
+}
+
+int RenderGraph::ImportFramebuffer(const std::string& name,
+                                   const GLuint framebuffer_id,
+                                   const int width,
+                                   const int height) {
+  Resource resource;
+  resource.name = name;
+  resource.description.width = width;
+  resource.description.height = height;
+  resource.imported = true;
+  resource.framebuffer = true;
+  resource.object_id = framebuffer_id;
+  resources_.push_back(resource);
+  return resources_.size() - 1;
+}
+
+int RenderGraph::AddPass(const std::string& name,
+                         std::function<void()> execute) {
+  Pass pass;
+  pass.name = name;
+  pass.execute = std::move(execute);
+  passes_.push_back(std::move(pass));
+  return passes_.size() - 1;
+}
+
+void RenderGraph::Read(const int pass, const int resource) {
+  passes_[pass].reads.push_back(resource);
+}
+
+void RenderGraph::Write(const int pass, const int resource) {
+  passes_[pass].writes.push_back(resource);
+}
+
+void RenderGraph::SetSideEffect(const int pass) {
+  passes_[pass].side_effect = true;
+}
+
+GLuint RenderGraph::texture_id(const int resource) const {
+  return resources_[resource].framebuffer ? 0 : resources_[resource].object_id;
+}
+
+void RenderGraph::CullPasses() {
+  // The passes only read what the earlier passes wrote, so a single sweep from
+  // the last pass finds every contributing pass.
+  std::vector<bool> needed(resources_.size(), false);
+  for (int i = passes_.size() - 1; i >= 0; --i) {
+    Pass& pass = passes_[i];
+    bool kept = pass.side_effect;
+    for (const int resource : pass.writes) {
+      kept = kept || resources_[resource].imported || needed[resource];
+    }
+    pass.culled = !kept;
+    if (pass.culled) {
+      ++statistics_.num_culled_passes;
+      continue;
+    }
+    for (const int resource : pass.reads) needed[resource] = true;
+  }
+}
+
+void RenderGraph::AssignTextures() {
+  for (int i = 0; i < passes_.size(); ++i) {
+    if (passes_[i].culled) continue;
+    for (const std::vector<int>* resources :
+             {&passes_[i].reads, &passes_[i].writes}) {
+      for (const int resource : *resources) {
+        Resource& used = resources_[resource];
+        if (used.first_pass < 0) used.first_pass = i;
+        used.last_pass = i;
+      }
+    }
+  }
+  // The transient textures take the textures of the pool in the order they
+  // start, so a texture is reused as soon as its last pass ran.
+  std::vector<int> transient;
+  for (int i = 0; i < resources_.size(); ++i) {
+    if (!resources_[i].imported && resources_[i].first_pass >= 0) {
+      transient.push_back(i);
+    }
+  }
+  std::stable_sort(transient.begin(), transient.end(),
+                   [this](const int a, const int b) {
+                     return resources_[a].first_pass <
+                         resources_[b].first_pass;
+                   });
+  for (PooledTexture& pooled : pool_) {
+    pooled.used = false;
+    pooled.last_pass = -1;
+  }
+  for (const int index : transient) {
+    Resource& resource = resources_[index];
+    PooledTexture* assigned = nullptr;
+    for (PooledTexture& pooled : pool_) {
+      if (pooled.description == resource.description &&
+          pooled.last_pass < resource.first_pass) {
+        assigned = &pooled;
+        break;
+      }
+    }
+    if (assigned == nullptr) {
+      PooledTexture pooled;
+      pooled.description = resource.description;
+      glGenTextures(1, &pooled.texture_id);
+      glBindTexture(GL_TEXTURE_2D, pooled.texture_id);
+      glTexStorage2D(GL_TEXTURE_2D, 1, resource.description.internal_format,
+                     resource.description.width, resource.description.height);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      pool_.push_back(pooled);
+      assigned = &pool_.back();
+    }
+    assigned->used = true;
+    assigned->last_pass = resource.last_pass;
+    resource.object_id = assigned->texture_id;
+    ++statistics_.num_transient_textures;
+    statistics_.unaliased_bytes += TextureBytes(resource.description);
+  }
+  // The textures the frame did not use are deleted, with the framebuffers,
+  // which may attach them.
+  const size_t pool_size = pool_.size();
+  pool_.erase(std::remove_if(pool_.begin(), pool_.end(),
+                             [](PooledTexture& pooled) {
+                               if (pooled.used) return false;
+                               glDeleteTextures(1, &pooled.texture_id);
+                               return true;
+                             }),
+              pool_.end());
+  if (pool_.size() != pool_size) {
+    for (const auto& framebuffer : framebuffers_) {
+      glDeleteFramebuffers(1, &framebuffer.second);
+    }
+    framebuffers_.clear();
+  }
+  for (const PooledTexture& pooled : pool_) {
+    ++statistics_.num_allocated_textures;
+    statistics_.allocated_bytes += TextureBytes(pooled.description);
+  }
+}
+
+bool RenderGraph::FindFramebuffer(Pass* pass, std::string* error_info_log) {
+  pass->framebuffer_id = 0;
+  if (pass->writes.empty()) return true;
+  const Resource& first = resources_[pass->writes.front()];
+  pass->width = first.description.width;
+  pass->height = first.description.height;
+  if (first.framebuffer) {
+    if (pass->writes.size() > 1) {
+      *error_info_log = "The pass " + pass->name + " writes " + first.name +
+          " with other resources.";
+      return false;
+    }
+    pass->framebuffer_id = first.object_id;
+    return true;
+  }
+  std::vector<GLuint> attachments;
+  for (const int resource : pass->writes) {
+    if (resources_[resource].framebuffer) {
+      *error_info_log = "The pass " + pass->name + " writes " +
+          resources_[resource].name + " with other resources.";
+      return false;
+    }
+    attachments.push_back(resources_[resource].object_id);
+  }
+  auto framebuffer = framebuffers_.find(attachments);
+  if (framebuffer != framebuffers_.end()) {
+    pass->framebuffer_id = framebuffer->second;
+    return true;
+  }
+  GLuint framebuffer_id = 0;
+  glGenFramebuffers(1, &framebuffer_id);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+  std::vector<GLenum> draw_buffers;
+  for (const int index : pass->writes) {
+    const Resource& resource = resources_[index];
+    const GLenum format = resource.description.internal_format;
+    GLenum attachment = GL_COLOR_ATTACHMENT0 + draw_buffers.size();
+    if (IsDepthFormat(format)) {
+      attachment = HasStencil(format) ? GL_DEPTH_STENCIL_ATTACHMENT :
+          GL_DEPTH_ATTACHMENT;
+    } else {
+      draw_buffers.push_back(attachment);
+    }
+    glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D,
+                           resource.object_id, 0);
+  }
+  if (draw_buffers.empty()) {
+    glDrawBuffer(GL_NONE);
+  } else {
+    glDrawBuffers(draw_buffers.size(), draw_buffers.data());
+  }
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  framebuffers_[attachments] = framebuffer_id;
+  pass->framebuffer_id = framebuffer_id;
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    *error_info_log = "The framebuffer of the pass " + pass->name +
+        " is incomplete: status " + std::to_string(status) + ".";
+    return false;
+  }
+  return true;
+}
+
+bool RenderGraph::Compile(std::string* error_info_log) {
+  statistics_ = RenderGraphStatistics();
+  statistics_.num_passes = passes_.size();
+  for (Resource& resource : resources_) {
+    resource.first_pass = -1;
+    resource.last_pass = -1;
+    if (!resource.imported) resource.object_id = 0;
+  }
+  CullPasses();
+  AssignTextures();
+  for (Pass& pass : passes_) {
+    if (!pass.culled && !FindFramebuffer(&pass, error_info_log)) return false;
+  }
+  return true;
+}
+
+void RenderGraph::Execute() {
+  for (Pass& pass : passes_) {
+    if (pass.culled) continue;
+    if (!pass.writes.empty()) {
+      glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer_id);
+      glViewport(0, 0, pass.width, pass.height);
+    }
+    pass.execute();
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RenderGraph::Reset() {
+  for (const auto& framebuffer : framebuffers_) {
+    glDeleteFramebuffers(1, &framebuffer.second);
+  }
+  framebuffers_.clear();
+  for (PooledTexture& pooled : pool_) {
+    glDeleteTextures(1, &pooled.texture_id);
+  }
+  pool_.clear();
+  Clear();
+}
+
+}  // namespace wvu
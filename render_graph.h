@@ -0,0 +1,248 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_RENDER_GRAPH_H_
+#define GLUTILS_RENDER_GRAPH_H_
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+// The description of a texture of the graph. The transient textures with the
+// same description share their storage when their lifetimes do not overlap.
+struct RenderGraphTextureDescription {
+  int width = 0;
+  int height = 0;
+  // The sized internal format, e.g., GL_RGBA16F or GL_DEPTH24_STENCIL8. The
+  // depth formats are attached as the depth of the framebuffers.
+  GLenum internal_format = GL_RGBA8;
+
+  bool operator==(const RenderGraphTextureDescription& other) const {
+    return width == other.width && height == other.height &&
+        internal_format == other.internal_format;
+  }
+};
+
+// Counters of the last RenderGraph::Compile().
+struct RenderGraphStatistics {
+  int num_passes = 0;
+  // Passes whose writes are never read by the outputs of the frame.
+  int num_culled_passes = 0;
+  int num_transient_textures = 0;
+  // The textures allocated for the transient textures.
+  int num_allocated_textures = 0;
+  // The bytes of the allocated textures, and of one texture per transient
+  // texture.
+  size_t allocated_bytes = 0;
+  size_t unaliased_bytes = 0;
+};
+
+// This class orders the passes of a frame from the textures they read and
+// write. Every frame, the passes are added in the order they run, with the
+// textures they read and write, and Compile():
+//
+//   1. Culls the passes that do not contribute to an output: a pass is kept
+//      if it writes an imported texture or framebuffer, or is marked with a
+//      side effect (e.g., a readback), or if a kept pass reads a texture it
+//      writes.
+//   2. Finds the first and the last kept pass using every transient texture.
+//   3. Assigns the transient textures to GL textures, reusing the texture of
+//      an earlier transient texture with the same description whose last
+//      pass ran. OpenGL does not expose the memory of the textures, so two
+//      textures only share their storage by being the same texture object;
+//      e.g., the G-buffer normals and the bloom of a frame of the same size
+//      and format are the same texture.
+//
+// Execute() then runs the kept passes in order. Before a pass runs, the
+// textures it writes are attached to a framebuffer, which is bound with the
+// viewport of their size; the depth formats are the depth attachment. A pass
+// writing an imported framebuffer draws into it instead.
+//
+// The textures outlive the frame, and Compile() only creates the textures the
+// frame needs beyond the ones of the last frame, so the same graph every frame
+// allocates nothing. The passes read the textures with texture_id().
+//
+// Example:
+//
+// wvu::RenderGraph graph;
+// while (...) {  // Rendering loop.
+//   graph.Clear();
+//   const int window = graph.ImportFramebuffer("window", 0, width, height);
+//   const int gbuffer = graph.CreateTexture("gbuffer", gbuffer_description);
+//   const int depth = graph.CreateTexture("depth", depth_description);
+//   const int geometry = graph.AddPass("geometry", [&]() { ...  // Draws.
+//   });
+//   graph.Write(geometry, gbuffer);
+//   graph.Write(geometry, depth);
+//   const int lighting = graph.AddPass("lighting", [&]() {
+//     glBindTexture(GL_TEXTURE_2D, graph.texture_id(gbuffer));
+//     ...
+//   });
+//   graph.Read(lighting, gbuffer);
+//   graph.Read(lighting, depth);
+//   graph.Write(lighting, window);
+//   graph.Compile(&error_info_log);
+//   graph.Execute();
+// }
+class RenderGraph {
+ public:
+  RenderGraph();
+  ~RenderGraph();
+
+  // Removes the passes and the resources of the frame. The textures are kept
+  // for the next frame.
+  void Clear();
+
+  // Adds a transient texture, which lives from its first to its last pass in
+  // the frame. Returns its resource index.
+  int CreateTexture(const std::string& name,
+                    const RenderGraphTextureDescription& description);
+
+  // Adds a texture owned by the caller. Its writers are never culled. Returns
+  // its resource index.
+  int ImportTexture(const std::string& name,
+                    const GLuint texture_id,
+                    const RenderGraphTextureDescription& description);
+
+  // Adds a framebuffer owned by the caller, e.g., 0 for the window. Its
+  // writers are never culled, and draw into it. Returns its resource index.
+  int ImportFramebuffer(const std::string& name,
+                        const GLuint framebuffer_id,
+                        const int width,
+                        const int height);
+
+  // Adds a pass, run by Execute() after the passes added before it. Returns
+  // its index.
+  int AddPass(const std::string& name, std::function<void()> execute);
+
+  // Declares that the pass reads the resource.
+  void Read(const int pass, const int resource);
+
+  // Declares that the pass writes the resource. A pass writes either
+  // textures or one imported framebuffer.
+  void Write(const int pass, const int resource);
+
+  // Keeps the pass even if nothing reads what it writes.
+  void SetSideEffect(const int pass);
+
+  // Culls the passes and assigns the textures of the transient ones. Returns
+  // true if successful, otherwise the error is copied into error_info_log.
+  bool Compile(std::string* error_info_log);
+
+  // Runs the kept passes in order, and leaves framebuffer 0 bound.
+  void Execute();
+
+  // Deletes the textures and the framebuffers.
+  void Reset();
+
+  // Returns the texture of a texture resource, valid after Compile().
+  GLuint texture_id(const int resource) const;
+
+  // Returns true if Compile() culled the pass.
+  bool culled(const int pass) const {
+    return passes_[pass].culled;
+  }
+
+  int num_passes() const {
+    return passes_.size();
+  }
+
+  const RenderGraphStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  struct Resource {
+    std::string name;
+    RenderGraphTextureDescription description;
+    bool imported = false;
+    // Whether the resource is an imported framebuffer instead of a texture.
+    bool framebuffer = false;
+    // The imported texture or framebuffer, or the texture assigned by
+    // Compile().
+    GLuint object_id = 0;
+    // The first and the last kept pass using the resource, or -1.
+    int first_pass = -1;
+    int last_pass = -1;
+  };
+
+  struct Pass {
+    std::string name;
+    std::function<void()> execute;
+    std::vector<int> reads;
+    std::vector<int> writes;
+    bool side_effect = false;
+    bool culled = false;
+    // The framebuffer bound for the pass, and its size.
+    GLuint framebuffer_id = 0;
+    int width = 0;
+    int height = 0;
+  };
+
+  // A texture of the pool, shared by the transient textures of a frame.
+  struct PooledTexture {
+    RenderGraphTextureDescription description;
+    GLuint texture_id = 0;
+    // The last pass of the frame using the texture, or -1 if it is free.
+    int last_pass = -1;
+    bool used = false;
+  };
+
+  // Marks the passes contributing to the outputs, from the last one.
+  void CullPasses();
+
+  // Assigns a texture of the pool to every used transient texture.
+  void AssignTextures();
+
+  // Finds the framebuffer of the writes of the pass, creating it the first
+  // time its textures are written together. Returns true if it is complete.
+  bool FindFramebuffer(Pass* pass, std::string* error_info_log);
+
+  std::vector<Resource> resources_;
+  std::vector<Pass> passes_;
+  std::vector<PooledTexture> pool_;
+  // The framebuffers of the attachments of the passes, by texture.
+  std::map<std::vector<GLuint>, GLuint> framebuffers_;
+  RenderGraphStatistics statistics_;
+
+  RenderGraph(const RenderGraph&) = delete;
+  RenderGraph& operator=(const RenderGraph&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_RENDER_GRAPH_H_
@@ -0,0 +1,497 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "render_queue.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "assignment.h"
+#include "draw_timer.h"
+#include "gl_state_cache.h"
+#include "gpu_mesh.h"
+#include "instance_buffer.h"
+#include "job_system.h"
+#include "model.h"
+#include "ring_buffer.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Radix of the sort passes.
+constexpr int kRadixBits = 8;
+constexpr int kRadix = 1 << kRadixBits;
+// Minimum number of entries sorted with the job system. Below it, splitting
+// the passes costs more than it saves.
+constexpr int kMinNumEntriesForParallelSort = 16384;
+
+// Returns value truncated to its lowest num_bits bits.
+inline uint64_t Field(const uint64_t value, const int num_bits) {
+  return value & ((uint64_t(1) << num_bits) - 1);
+}
+
+}  // namespace
+
+uint64_t ComputeSortKey(const RenderItem& item, const RenderSortOrder order) {
+  const uint64_t program =
+      item.shader_program ? item.shader_program->shader_program_id() : 0;
+  const uint64_t vertex_array =
+      item.mesh ? item.mesh->vertex_array_object_id() : 0;
+  const float depth = std::min(std::max(item.depth, 0.0f), 1.0f);
+  const uint64_t max_depth = (uint64_t(1) << kSortKeyDepthBits) - 1;
+  const uint64_t quantized_depth =
+      static_cast<uint64_t>(depth * max_depth + 0.5f);
+  uint64_t state = Field(program, kSortKeyProgramBits);
+  state = (state << kSortKeyMaterialBits) |
+      Field(item.texture_id, kSortKeyMaterialBits);
+  state = (state << kSortKeyVertexArrayBits) |
+      Field(vertex_array, kSortKeyVertexArrayBits);
+  if (order == SORT_FRONT_TO_BACK) {
+    return (quantized_depth << (64 - kSortKeyDepthBits)) | state;
+  }
+  return (state << kSortKeyDepthBits) | quantized_depth;
+}
+
+RenderQueue::RenderQueue(const std::string& model_uniform_name)
+    : model_uniform_name_(model_uniform_name),
+      sort_order_(SORT_BY_STATE),
+      sorted_(true),
+      view_(Eigen::Matrix4f::Identity()),
+      view_projection_(Eigen::Matrix4f::Identity()),
+      model_matrices_valid_(false),
+      instance_ring_buffer_(nullptr),
+      instances_base_(0),
+      shared_vertex_arrays_(nullptr),
+      draw_timer_(nullptr) {}
+
+void RenderQueue::Clear() {
+  items_.clear();
+  entries_.clear();
+  sorted_ = true;
+  InvalidateProducts();
+}
+
+void RenderQueue::Add(const RenderItem& item) {
+  SortEntry entry;
+  entry.key = ComputeSortKey(item, sort_order_);
+  entry.item_index = items_.size();
+  entries_.push_back(entry);
+  items_.push_back(item);
+  sorted_ = false;
+  InvalidateProducts();
+}
+
+void RenderQueue::AddVisible(const RenderItems& items,
+                             const std::vector<uint32_t>& visibility) {
+  const int num_words =
+      std::min<int>(visibility.size(), (items.size() + 31) / 32);
+  for (int word = 0; word < num_words; ++word) {
+    // Visit the set bits only, from the lowest.
+    for (uint32_t bits = visibility[word]; bits != 0; bits &= bits - 1) {
+      const int item = 32 * word + __builtin_ctz(bits);
+      if (item < static_cast<int>(items.size())) Add(items[item]);
+    }
+  }
+}
+
+void RenderQueue::set_sort_order(const RenderSortOrder order) {
+  if (order == sort_order_) return;
+  sort_order_ = order;
+  for (SortEntry& entry : entries_) {
+    entry.key = ComputeSortKey(items_[entry.item_index], sort_order_);
+  }
+  sorted_ = entries_.empty();
+}
+
+void RenderQueue::Record(
+    JobSystem* job_system,
+    const int num_objects,
+    const int grain_size,
+    const std::function<void(int, int, RenderItemRecorder*)>& record) {
+  const int num_threads = job_system->num_threads();
+  if (static_cast<int>(recorders_.size()) < num_threads) {
+    recorders_.resize(num_threads);
+  }
+  for (RenderItemRecorder& recorder : recorders_) {
+    recorder.items_.clear();
+  }
+  job_system->ParallelFor(num_objects, grain_size,
+                          [&](const int begin, const int end) {
+    record(begin, end, &recorders_[job_system->CurrentThreadIndex()]);
+  });
+
+  // Copy the lists into consecutive ranges of the queue, computing the keys of
+  // the items in parallel.
+  const int first_entry = entries_.size();
+  int num_recorded_items = 0;
+  for (const RenderItemRecorder& recorder : recorders_) {
+    num_recorded_items += recorder.items_.size();
+  }
+  if (num_recorded_items == 0) return;
+  InvalidateProducts();
+  items_.resize(first_entry + num_recorded_items);
+  entries_.resize(first_entry + num_recorded_items);
+  job_system->ParallelFor(num_threads, 1, [&](const int begin, const int end) {
+    for (int thread = begin; thread < end; ++thread) {
+      int offset = first_entry;
+      for (int i = 0; i < thread; ++i) offset += recorders_[i].items_.size();
+      for (const RenderItem& item : recorders_[thread].items_) {
+        items_[offset] = item;
+        entries_[offset].key = ComputeSortKey(item, sort_order_);
+        entries_[offset].item_index = offset;
+        ++offset;
+      }
+    }
+  });
+  SortEntries(job_system);
+}
+
+void RenderQueue::SortEntries(JobSystem* job_system) {
+  sorted_ = true;
+  const int num_entries = entries_.size();
+  if (num_entries == 0) return;
+  sorted_entries_.resize(num_entries);
+  // The entries are split into one chunk per thread. Each chunk counts and
+  // scatters its own entries, and the offsets of the digits of a chunk follow
+  // those of the previous chunks, so the passes remain stable.
+  const int num_chunks =
+      job_system != nullptr && num_entries >= kMinNumEntriesForParallelSort ?
+      job_system->num_threads() : 1;
+  const int chunk_size = (num_entries + num_chunks - 1) / num_chunks;
+  histograms_.resize(num_chunks * kRadix);
+  const auto for_each_chunk = [&](const std::function<void(int)>& function) {
+    if (num_chunks == 1) {
+      function(0);
+      return;
+    }
+    job_system->ParallelFor(num_chunks, 1, [&](const int begin, const int end) {
+      for (int chunk = begin; chunk < end; ++chunk) function(chunk);
+    });
+  };
+  for (int shift = 0; shift < 64; shift += kRadixBits) {
+    for_each_chunk([&](const int chunk) {
+      int* histogram = histograms_.data() + chunk * kRadix;
+      std::fill(histogram, histogram + kRadix, 0);
+      const int end = std::min((chunk + 1) * chunk_size, num_entries);
+      for (int i = chunk * chunk_size; i < end; ++i) {
+        ++histogram[(entries_[i].key >> shift) & (kRadix - 1)];
+      }
+    });
+    // Every key has the same digit, so the pass would not move any entry.
+    const int first_digit = (entries_[0].key >> shift) & (kRadix - 1);
+    int num_first_digits = 0;
+    for (int chunk = 0; chunk < num_chunks; ++chunk) {
+      num_first_digits += histograms_[chunk * kRadix + first_digit];
+    }
+    if (num_first_digits == num_entries) continue;
+    int offset = 0;
+    for (int digit = 0; digit < kRadix; ++digit) {
+      for (int chunk = 0; chunk < num_chunks; ++chunk) {
+        const int count = histograms_[chunk * kRadix + digit];
+        histograms_[chunk * kRadix + digit] = offset;
+        offset += count;
+      }
+    }
+    for_each_chunk([&](const int chunk) {
+      int* offsets = histograms_.data() + chunk * kRadix;
+      const int end = std::min((chunk + 1) * chunk_size, num_entries);
+      for (int i = chunk * chunk_size; i < end; ++i) {
+        const SortEntry& entry = entries_[i];
+        sorted_entries_[offsets[(entry.key >> shift) & (kRadix - 1)]++] =
+            entry;
+      }
+    });
+    entries_.swap(sorted_entries_);
+  }
+}
+
+void RenderQueue::SetViewProjection(const Eigen::Matrix4f& view,
+                                    const Eigen::Matrix4f& projection) {
+  const Eigen::Matrix4f view_projection = projection * view;
+  if (view == view_ && view_projection == view_projection_) return;
+  view_ = view;
+  view_projection_ = view_projection;
+  model_view_projections_.valid = false;
+  model_views_.valid = false;
+}
+
+void RenderQueue::ComputeProducts(const Eigen::Matrix4f& matrix,
+                                  MatrixProducts* products) {
+  const int num_items = items_.size();
+  if (!model_matrices_valid_) {
+    model_matrices_.resize(num_items);
+    for (int i = 0; i < num_items; ++i) model_matrices_[i] = items_[i].model;
+    model_matrices_valid_ = true;
+  }
+  products->matrices.resize(num_items);
+  Multiply4x4MatrixArray(matrix, model_matrices_.data(), num_items,
+                         products->matrices.data());
+  products->valid = true;
+}
+
+void RenderQueue::Execute(const int num_instances) {
+  Draw(nullptr, num_instances, draw_timer_, &statistics_);
+}
+
+void RenderQueue::ExecuteWithProgram(ShaderProgram* program,
+                                     const int num_instances) {
+  Draw(program, num_instances, draw_timer_, &statistics_);
+}
+
+void RenderQueue::ExecuteDepthPrepass(ShaderProgram* depth_program,
+                                      const int num_instances) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->ColorMask(false);
+  gl_state->DepthMask(true);
+  gl_state->DepthFunc(GL_LESS);
+  Draw(depth_program, num_instances, nullptr, &depth_prepass_statistics_);
+  // The depths are final, so the shading pass only tests them.
+  gl_state->ColorMask(true);
+  gl_state->DepthMask(false);
+  gl_state->DepthFunc(GL_LEQUAL);
+}
+
+void RenderQueue::ExecuteIdPass(ShaderProgram* id_program) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->ColorMask(true);
+  gl_state->DepthMask(true);
+  gl_state->DepthFunc(GL_LESS);
+  Draw(id_program, 1, nullptr, &id_pass_statistics_);
+}
+
+void RenderQueue::EnableInstancing(RingBuffer* ring_buffer) {
+  if (instances_.Initialize(ring_buffer)) instance_ring_buffer_ = ring_buffer;
+}
+
+bool RenderQueue::StreamInstanceTransforms(ShaderProgram* depth_program) {
+  if (instance_ring_buffer_ == nullptr ||
+      !(GLEW_VERSION_4_2 || GLEW_ARB_base_instance)) {
+    return false;
+  }
+  const auto instanced = [this, depth_program](const RenderItem& item) {
+    return item.shader_program != nullptr && item.mesh != nullptr &&
+        DrawingProgram(item, depth_program)->reads_instance_transforms();
+  };
+  int num_transforms = 0;
+  for (const SortEntry& entry : entries_) {
+    if (instanced(items_[entry.item_index])) ++num_transforms;
+  }
+  if (num_transforms == 0) return true;
+  // The matrices are written straight into the ring buffer, without an
+  // intermediate array.
+  GLfloat* transforms = instances_.MapTransforms(num_transforms);
+  if (transforms == nullptr) return false;
+  for (const SortEntry& entry : entries_) {
+    const RenderItem& item = items_[entry.item_index];
+    if (!instanced(item)) continue;
+    MappedTransform transform(transforms);
+    transform = item.model;
+    transforms += 16;
+  }
+  instances_.UnmapTransforms();
+  instances_base_ = instances_.base_instance();
+  return true;
+}
+
+void RenderQueue::Draw(ShaderProgram* depth_program,
+                       const int num_instances,
+                       DrawTimer* draw_timer,
+                       RenderQueueStatistics* statistics) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  *statistics = RenderQueueStatistics();
+  if (entries_.empty()) return;
+  if (!sorted_) SortEntries(nullptr);
+  const bool instancing =
+      num_instances == 1 && StreamInstanceTransforms(depth_program);
+  if (shared_vertex_arrays_ != nullptr) {
+    shared_vertex_arrays_->InvalidateBindings();
+    shared_vertex_arrays_->reset_num_buffer_changes();
+  }
+  // The instance of the next item reading instance transforms, in the order
+  // of StreamInstanceTransforms().
+  int next_instance = 0;
+  const ShaderProgram* current_program = nullptr;
+  GLint model_location = -1;
+  GLint model_view_projection_location = -1;
+  GLint model_view_location = -1;
+  GLint object_id_location = -1;
+  GLuint current_vertex_array = 0;
+  // The vertex array whose instance transform attribute was set up last.
+  GLuint instance_vertex_array = 0;
+  GLuint current_texture = 0;
+  bool texture_bound = false;
+  const int num_entries = entries_.size();
+  for (int i = 0; i < num_entries;) {
+    const SortEntry& entry = entries_[i];
+    const RenderItem& item = items_[entry.item_index];
+    if (item.shader_program == nullptr || item.mesh == nullptr) {
+      ++i;
+      continue;
+    }
+    ShaderProgram* program = DrawingProgram(item, depth_program);
+    const bool reads_instances = program->reads_instance_transforms();
+    const bool instanced = reads_instances && instancing;
+    // The items drawn by this draw: the following ones drawing the same, if
+    // instanced. The depths do not depend on the materials.
+    int run_end = i + 1;
+    while (instanced && run_end < num_entries &&
+           SameInstancedDraw(item, items_[entries_[run_end].item_index],
+                             depth_program == nullptr)) {
+      ++run_end;
+    }
+    const int num_run_items = run_end - i;
+    const int first_instance = next_instance;
+    if (reads_instances) next_instance += num_run_items;
+    i = run_end;
+    if (program != current_program) {
+      if (!program->Use()) continue;
+      current_program = program;
+      model_location = program->GetUniformLocation(model_uniform_name_);
+      model_view_projection_location =
+          program->GetUniformLocation(kModelViewProjectionUniformName);
+      model_view_location = program->GetUniformLocation(kModelViewUniformName);
+      object_id_location = program->GetUniformLocation(kObjectIdUniformName);
+      if (model_view_projection_location >= 0 &&
+          !model_view_projections_.valid) {
+        ComputeProducts(view_projection_, &model_view_projections_);
+      }
+      if (model_view_location >= 0 && !model_views_.valid) {
+        ComputeProducts(view_, &model_views_);
+      }
+      ++statistics->num_program_changes;
+    }
+    // The shared vertex arrays only change with the layout, and rebind the
+    // buffers of the meshes that differ from the previous ones.
+    const GLuint vertex_array = shared_vertex_arrays_ != nullptr ?
+        shared_vertex_arrays_->Bind(*item.mesh) :
+        item.mesh->vertex_array_object_id();
+    if (vertex_array != current_vertex_array) {
+      current_vertex_array = vertex_array;
+      gl_state->BindVertexArray(current_vertex_array);
+      ++statistics->num_vertex_array_changes;
+    }
+    // The instance transforms are read from the ring buffer when instanced,
+    // and from the constant attribute values otherwise. The attribute of a
+    // vertex array stays set up for the rest of the pass.
+    if (reads_instances && current_vertex_array != instance_vertex_array) {
+      instance_vertex_array = current_vertex_array;
+      if (instanced) {
+        instances_.Attach(current_vertex_array);
+        gl_state->BindVertexArray(current_vertex_array);
+      } else {
+        for (GLuint column = 0; column < 4; ++column) {
+          glDisableVertexAttribArray(kInstanceTransformLocation + column);
+        }
+      }
+    }
+    if (reads_instances && !instanced) {
+      for (GLuint column = 0; column < 4; ++column) {
+        glVertexAttrib4fv(kInstanceTransformLocation + column,
+                          item.model.col(column).data());
+      }
+    }
+    // The back faces of closed meshes are hidden by their front faces.
+    gl_state->SetCapability(GL_CULL_FACE, item.mesh->closed());
+    // The depths do not depend on the materials.
+    if (depth_program == nullptr &&
+        (!texture_bound || item.texture_id != current_texture)) {
+      if (!texture_bound) glActiveTexture(GL_TEXTURE0);
+      current_texture = item.texture_id;
+      texture_bound = true;
+      glBindTexture(GL_TEXTURE_2D, current_texture);
+      ++statistics->num_texture_changes;
+    }
+    // The setters skip the values that did not change.
+    program->SetUniform(model_location, item.model);
+    if (model_view_projection_location >= 0) {
+      program->SetUniform(model_view_projection_location,
+                          model_view_projections_.matrices[entry.item_index]);
+    }
+    if (model_view_location >= 0) {
+      program->SetUniform(model_view_location,
+                          model_views_.matrices[entry.item_index]);
+    }
+    if (object_id_location >= 0) {
+      program->SetUniform(object_id_location,
+                          static_cast<GLint>(item.object_id));
+    }
+    const GLvoid* offset = reinterpret_cast<const GLvoid*>(
+        static_cast<uintptr_t>(item.first_index) *
+        IndexSize(item.mesh->index_type()));
+    const int64_t num_triangles = num_instances * num_run_items *
+        (item.mesh->primitive_type() == GL_TRIANGLE_STRIP ?
+         std::max(item.num_indices - 2, 0) : item.num_indices / 3);
+    if (draw_timer != nullptr) {
+      draw_timer->BeginDraw(item.object_id, num_triangles);
+    }
+    // The draw is skipped by the GPU if the query passed no samples, and
+    // drawn if its result is not available yet, so the CPU never waits.
+    if (item.occlusion_query != 0) {
+      glBeginConditionalRender(item.occlusion_query, GL_QUERY_NO_WAIT);
+      ++statistics->num_conditional_draws;
+    }
+    if (instanced) {
+      glDrawElementsInstancedBaseInstance(
+          item.mesh->primitive_type(), item.num_indices,
+          item.mesh->index_type(), offset, num_run_items,
+          instances_base_ + first_instance);
+      if (num_run_items > 1) {
+        statistics->num_coalesced_items += num_run_items;
+        ++statistics->num_instanced_draws;
+      }
+    } else if (num_instances == 1) {
+      glDrawElements(item.mesh->primitive_type(), item.num_indices,
+                     item.mesh->index_type(), offset);
+    } else {
+      glDrawElementsInstanced(item.mesh->primitive_type(), item.num_indices,
+                              item.mesh->index_type(), offset, num_instances);
+    }
+    if (item.occlusion_query != 0) glEndConditionalRender();
+    if (draw_timer != nullptr) draw_timer->EndDraw();
+    if (shared_vertex_arrays_ != nullptr) {
+      statistics->num_buffer_changes =
+          shared_vertex_arrays_->num_buffer_changes();
+    }
+    ++statistics->num_draws;
+    statistics->num_triangles += num_triangles;
+  }
+}
+
+}  // namespace wvu
@@ -0,0 +1,457 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_RENDER_QUEUE_H_
+#define GLUTILS_RENDER_QUEUE_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include "draw_timer.h"
+#include "gpu_mesh.h"
+#include "instance_buffer.h"
+#include "job_system.h"
+#include "ring_buffer.h"
+#include "shader_program.h"
+#include "shared_vertex_arrays.h"
+
+namespace wvu {
+// A draw submitted to a RenderQueue: a range of the indices of a mesh drawn
+// with a program, a material texture and a model matrix.
+struct RenderItem {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  // The program drawing the item. Not owned.
+  ShaderProgram* shader_program = nullptr;
+  // The mesh to draw. Not owned.
+  const GpuMesh* mesh = nullptr;
+  // The texture of the material, bound to texture unit 0, or 0 for none.
+  GLuint texture_id = 0;
+  // The range of indices of the mesh to draw.
+  int first_index = 0;
+  int num_indices = 0;
+  // The depth of the item in [0, 1], e.g., its view distance divided by the
+  // far plane distance. Items sharing the state are drawn front to back.
+  float depth = 0.0f;
+  // The model matrix, passed to the model uniform of the program, and
+  // multiplied with the camera matrices (see SetViewProjection()).
+  Eigen::Matrix4f model = Eigen::Matrix4f::Identity();
+  // An occlusion query whose samples condition the draw, e.g., of the
+  // bounding box of the item in the previous frame (see
+  // occlusion_queries.h), or 0 to draw unconditionally.
+  GLuint occlusion_query = 0;
+  // The ID passed to the object_id uniform of the programs declaring it, e.g.,
+  // to tell the items apart in the ID pass of a GpuPicker (see
+  // gpu_picking.h). 0 is left for the background.
+  GLuint object_id = 0;
+};
+
+// Names of the uniforms of the products of the model matrices with the camera
+// matrices of RenderQueue::SetViewProjection().
+constexpr char kModelViewProjectionUniformName[] = "model_view_projection";
+constexpr char kModelViewUniformName[] = "model_view";
+// Name of the int uniform of RenderItem::object_id.
+constexpr char kObjectIdUniformName[] = "object_id";
+
+// Number of bits of each field of the sort keys, from the most significant.
+constexpr int kSortKeyProgramBits = 12;
+constexpr int kSortKeyMaterialBits = 16;
+constexpr int kSortKeyVertexArrayBits = 12;
+constexpr int kSortKeyDepthBits = 24;
+
+// Orders of the items of a RenderQueue.
+enum RenderSortOrder {
+  // By program, material and vertex array, and front to back among the items
+  // sharing them: the fewest state changes.
+  SORT_BY_STATE = 0,
+  // Front to back, and by state among the items at the same depth: the
+  // nearest occluders are drawn first, so the early depth test rejects most of
+  // the fragments behind them before they are shaded. Suits scenes with a lot
+  // of overdraw and expensive fragment shaders.
+  SORT_FRONT_TO_BACK = 1
+};
+
+// Returns the 64-bit sort key of an item. With SORT_BY_STATE, the key holds
+// the program, material, vertex array and depth, from the most to the least
+// significant bits, so sorting by the key groups the items by the most
+// expensive state changes first. SORT_FRONT_TO_BACK moves the depth to the
+// most significant bits. The ids are truncated to the bits of their fields, so
+// that distinct ids may share a field; this only affects the order, since the
+// queue compares the actual state before changing it.
+uint64_t ComputeSortKey(const RenderItem& item,
+                        const RenderSortOrder order = SORT_BY_STATE);
+
+// Counters of the work done by RenderQueue::Execute().
+struct RenderQueueStatistics {
+  int num_draws = 0;
+  int num_program_changes = 0;
+  int num_vertex_array_changes = 0;
+  // Vertex and element buffers rebound on shared vertex arrays.
+  int num_buffer_changes = 0;
+  int num_texture_changes = 0;
+  // Items drawn by the instanced draws of several items, and those draws.
+  int num_coalesced_items = 0;
+  int num_instanced_draws = 0;
+  // Draws conditioned on an occlusion query. The GPU skips those whose query
+  // passed no samples.
+  int num_conditional_draws = 0;
+  // Triangles drawn. Strips count the restart indices as vertices, so their
+  // count is an upper bound.
+  int64_t num_triangles = 0;
+};
+
+// Contiguous array of render items. Eigen requires an aligned allocator for
+// the model matrices.
+typedef std::vector<RenderItem, Eigen::aligned_allocator<RenderItem> >
+    RenderItems;
+
+// The items recorded by the jobs of one thread in RenderQueue::Record().
+// Its storage is kept between frames, so recording does not allocate once the
+// lists reached their steady size.
+class RenderItemRecorder {
+ public:
+  RenderItemRecorder() {}
+  ~RenderItemRecorder() {}
+
+  void Add(const RenderItem& item) {
+    items_.push_back(item);
+  }
+
+ private:
+  friend class RenderQueue;
+
+  RenderItems items_;
+};
+
+// This class collects the draws of a frame, sorts them by their sort keys with
+// a radix sort, and submits them changing the program, vertex array and
+// texture only when they differ from the previous draw. The back faces of the
+// closed meshes (see GpuMesh::closed()) are culled. The queue does not
+// unbind the state between draws.
+//
+// Example:
+//
+// wvu::RenderQueue render_queue("model");
+// while (...) {  // Rendering loop.
+//   render_queue.Clear();
+//   for (const SceneObject& object : scene) {
+//     render_queue.Add(object.render_item());
+//   }
+//   render_queue.Execute();
+// }
+//
+// The objects culled on the CPU are added with the visibility mask of their
+// bounds:
+//
+// wvu::CullSpheres(wvu::ExtractFrustumPlanes(projection * view), centers,
+//                  radii, &visibility);
+// render_queue.AddVisible(scene_items, visibility);
+//
+// Opaque scenes with a lot of overdraw may sort the items front to back, and
+// draw their depths first, so that the second pass shades every pixel once:
+//
+// render_queue.set_sort_order(wvu::SORT_FRONT_TO_BACK);
+// gl_state->SetCapability(GL_DEPTH_TEST, true);
+// render_queue.ExecuteDepthPrepass(&depth_program);
+// render_queue.Execute();
+// gl_state->DepthMask(true);
+//
+// Large scenes are recorded in parallel: every thread of a JobSystem records
+// the items of contiguous ranges of objects into its own list, and the lists
+// are merged and sorted in parallel:
+//
+// render_queue.Record(&job_system, scene.size(), 256,
+//                     [&](const int begin, const int end,
+//                         wvu::RenderItemRecorder* recorder) {
+//   for (int i = begin; i < end; ++i) recorder->Add(scene[i].render_item());
+// });
+// render_queue.Execute();
+//
+// The vertex shaders may transform the vertices by one matrix per draw instead
+// of multiplying the camera and model matrices per vertex: given the camera
+// matrices, the queue computes the model-view-projection matrices of all the
+// items at once, with the batched kernels of assignment.h, and sets them to
+// the programs declaring the model_view_projection uniform. The programs that
+// need the view-space positions, e.g., for lighting, declare the model_view
+// uniform instead or too:
+//
+// render_queue.SetViewProjection(camera.view(), camera.projection());
+// render_queue.Execute();  // gl_Position = model_view_projection * position.
+//
+// The programs whose vertex shaders read the model matrix as a per-instance
+// attribute (see ShaderProgram::reads_instance_transforms()) need no
+// instancing code from the callers: the consecutive sorted items drawing the
+// same range of the same mesh with the same program and texture are drawn
+// with one instanced draw, whose model matrices are streamed through a
+// RingBuffer and read from the base instance of the draw (OpenGL 4.2 or
+// ARB_base_instance). Without a ring buffer, or when its section is full,
+// those items are drawn one by one with their matrix as a constant attribute:
+//
+// render_queue.EnableInstancing(&ring_buffer);
+// render_queue.Execute();  // gl_Position = view_projection * instance_model *
+//                          //     vec4(position, 1.0f);
+class RenderQueue {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  // Parameters:
+  //   model_uniform_name  The name of the model matrix uniform in the
+  //     programs of the items.
+  explicit RenderQueue(const std::string& model_uniform_name);
+  ~RenderQueue() {}
+
+  // Removes all the items.
+  void Clear();
+
+  // Adds an item to draw in the next call to Execute().
+  void Add(const RenderItem& item);
+
+  // Adds the items whose bits are set in a visibility mask, e.g., of
+  // CullSpheres() or CullBoxes(), where the bit i % 32 of visibility[i / 32]
+  // stands for items[i].
+  void AddVisible(const RenderItems& items,
+                  const std::vector<uint32_t>& visibility);
+
+  // Records the items of the ranges [begin, end) of num_objects objects with
+  // the jobs of job_system, calling record(begin, end, recorder) with the
+  // recorder of the thread running the job. The recorded items are appended
+  // to the queue and sorted in parallel, so Execute() does not sort them
+  // again. The order of the items with equal keys depends on the scheduling.
+  // Parameters:
+  //   job_system  The job system running the recording jobs.
+  //   num_objects  The number of objects to record.
+  //   grain_size  The maximum number of objects of a job.
+  //   record  Adds the items of a range of objects to the recorder.
+  void Record(JobSystem* job_system,
+              const int num_objects,
+              const int grain_size,
+              const std::function<void(int, int, RenderItemRecorder*)>&
+                  record);
+
+  // Sets the camera matrices multiplied with the model matrices of the items
+  // for the model_view_projection and model_view uniforms. The products are
+  // computed by the first draw of a program declaring each uniform, and kept
+  // until the items or the matrices change. The matrices are kept by Clear().
+  void SetViewProjection(const Eigen::Matrix4f& view,
+                         const Eigen::Matrix4f& projection);
+
+  // Coalesces the items of the programs reading instance transforms into
+  // instanced draws, streaming their matrices through the ring buffer, which
+  // must be the same on every call. The draws of several instances per item,
+  // e.g., of a MultiViewUniforms pass, are not coalesced. The draws must happen
+  // between the BeginFrame() and the EndFrame() of the ring buffer.
+  // Parameters:
+  //   ring_buffer  The ring buffer of the frame data. Not owned.
+  void EnableInstancing(RingBuffer* ring_buffer);
+
+  // Sorts and draws the items. The items are kept until Clear() is called.
+  // Parameters:
+  //   num_instances  The number of instances of each draw, e.g., one per view
+  //     of a MultiViewUniforms pass.
+  void Execute(const int num_instances = 1);
+
+  // Sorts the items and draws their depths, without writing colors. Leaves the
+  // depth writes off and the depth function GL_LEQUAL, so that the next
+  // Execute() only shades the nearest fragment of each pixel. The caller turns
+  // the depth writes back on before clearing the depth buffer. The depth test
+  // must be enabled.
+  // Parameters:
+  //   depth_program  The program drawing the depths, e.g., one with the
+  //     vertex shader of the items and an empty fragment shader, or nullptr to
+  //     draw them with the programs of the items. Its model uniform has the
+  //     name of theirs. The positions of both passes must match exactly, so
+  //     the vertex shaders should compute them the same way, or declare
+  //     gl_Position invariant.
+  //   num_instances  The number of instances of each draw.
+  void ExecuteDepthPrepass(ShaderProgram* depth_program,
+                           const int num_instances = 1);
+
+  // Sorts the items and draws them with program in place of their programs,
+  // with the current state and without their textures, e.g., to count the
+  // fragments of every pixel. Counts the work in statistics(), since it
+  // replaces Execute().
+  void ExecuteWithProgram(ShaderProgram* program, const int num_instances = 1);
+
+  // Sorts the items and draws them with id_program, writing colors and
+  // depths, e.g., their object IDs into an integer target. The program must
+  // not read instance transforms, so that every item keeps its own draw and
+  // its own object_id uniform. Leaves the depth writes on and the depth
+  // function GL_LESS.
+  void ExecuteIdPass(ShaderProgram* id_program);
+
+  // Sets the order of the items, and sorts them again on the next draw.
+  void set_sort_order(const RenderSortOrder order);
+
+  // Draws the meshes through the vertex arrays of their layouts, rebinding
+  // only their buffers, instead of through their own vertex arrays. nullptr,
+  // the default, draws with the vertex arrays of the meshes. Needs
+  // SharedVertexArrays::Supported(). Not owned.
+  void set_shared_vertex_arrays(SharedVertexArrays* shared_vertex_arrays) {
+    shared_vertex_arrays_ = shared_vertex_arrays;
+  }
+
+  // Times every draw of Execute() and ExecuteWithProgram() with draw_timer,
+  // or none if nullptr, the default. Not owned.
+  void set_draw_timer(DrawTimer* draw_timer) {
+    draw_timer_ = draw_timer;
+  }
+
+  RenderSortOrder sort_order() const {
+    return sort_order_;
+  }
+
+  int num_items() const {
+    return items_.size();
+  }
+
+  // Returns the counters of the last call to Execute().
+  const RenderQueueStatistics& statistics() const {
+    return statistics_;
+  }
+
+  // Returns the counters of the last call to ExecuteDepthPrepass().
+  const RenderQueueStatistics& depth_prepass_statistics() const {
+    return depth_prepass_statistics_;
+  }
+
+  // Returns the counters of the last call to ExecuteIdPass().
+  const RenderQueueStatistics& id_pass_statistics() const {
+    return id_pass_statistics_;
+  }
+
+ private:
+  // An item key and the position of the item in items_.
+  struct SortEntry {
+    uint64_t key;
+    uint32_t item_index;
+  };
+
+  // Sorts entries_ by key with a least significant digit radix sort. Passes
+  // where all the keys share the digit are skipped. The histograms and the
+  // scatter of large queues are split into chunks run by the job system, if
+  // not nullptr.
+  void SortEntries(JobSystem* job_system);
+
+  // The products of a camera matrix with the model matrices of the items,
+  // indexed as items_.
+  struct MatrixProducts {
+    bool valid = false;
+    std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >
+        matrices;
+  };
+
+  // Computes the products of matrix with the model matrices of the items.
+  void ComputeProducts(const Eigen::Matrix4f& matrix,
+                       MatrixProducts* products);
+
+  // Marks the products out of date, e.g., when the items change.
+  void InvalidateProducts() {
+    model_matrices_valid_ = false;
+    model_view_projections_.valid = false;
+    model_views_.valid = false;
+  }
+
+  // Returns the program drawing an item, depth_program if not nullptr.
+  static ShaderProgram* DrawingProgram(const RenderItem& item,
+                                       ShaderProgram* depth_program) {
+    return depth_program != nullptr ? depth_program : item.shader_program;
+  }
+
+  // Returns true if the items are drawn by the same instanced draw.
+  static bool SameInstancedDraw(const RenderItem& x,
+                                const RenderItem& y,
+                                const bool compare_textures) {
+    return x.shader_program == y.shader_program && x.mesh == y.mesh &&
+        x.first_index == y.first_index && x.num_indices == y.num_indices &&
+        x.occlusion_query == y.occlusion_query &&
+        (!compare_textures || x.texture_id == y.texture_id);
+  }
+
+  // Streams the model matrices of the sorted items drawn by programs reading
+  // instance transforms through the ring buffer, in their order. Sets
+  // instances_base_ to the instance of the first one, and returns false if
+  // instancing is not enabled or supported, or the ring buffer is full.
+  bool StreamInstanceTransforms(ShaderProgram* depth_program);
+
+  // Draws the sorted items, with depth_program in place of their programs if
+  // not nullptr, timing them with draw_timer if not nullptr, and counts the
+  // work in statistics.
+  void Draw(ShaderProgram* depth_program,
+            const int num_instances,
+            DrawTimer* draw_timer,
+            RenderQueueStatistics* statistics);
+
+  const std::string model_uniform_name_;
+  RenderSortOrder sort_order_;
+  RenderItems items_;
+  std::vector<SortEntry> entries_;
+  // True if entries_ is sorted.
+  bool sorted_;
+  // One recorder per thread of the job system of Record().
+  std::vector<RenderItemRecorder> recorders_;
+  // Scratch storage of the radix sort, and the digit histograms of its
+  // chunks.
+  std::vector<SortEntry> sorted_entries_;
+  std::vector<int> histograms_;
+  // The camera matrices of SetViewProjection(), and their products with the
+  // model matrices of the items, gathered contiguously for the kernels.
+  Eigen::Matrix4f view_;
+  Eigen::Matrix4f view_projection_;
+  std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >
+      model_matrices_;
+  bool model_matrices_valid_;
+  MatrixProducts model_view_projections_;
+  MatrixProducts model_views_;
+  // The ring buffer streaming the instance transforms, or nullptr, and the
+  // matrices of the last pass with their first instance in the buffer.
+  RingBuffer* instance_ring_buffer_;
+  InstanceBuffer instances_;
+  int instances_base_;
+  SharedVertexArrays* shared_vertex_arrays_;
+  DrawTimer* draw_timer_;
+  RenderQueueStatistics statistics_;
+  RenderQueueStatistics depth_prepass_statistics_;
+  RenderQueueStatistics id_pass_statistics_;
+
+  RenderQueue(const RenderQueue&) = delete;
+  RenderQueue& operator=(const RenderQueue&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_RENDER_QUEUE_H_
@@ -0,0 +1,106 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "render_throttle.h"
+
+#include <chrono>
+#include <GLFW/glfw3.h>
+
+namespace wvu {
+namespace {
+// Longest wait for events of a paused window, so that the loop still runs
+// its periodic work, e.g., the closing of the headless runs, now and then.
+constexpr double kPausedWaitTimeout = 0.5;
+
+}  // namespace
+
+RenderThrottle::RenderThrottle()
+    : iconified_(false), focused_(true),
+      background_period_(std::chrono::steady_clock::duration::zero()) {}
+
+void RenderThrottle::Initialize(const double background_frame_rate) {
+  background_period_ = background_frame_rate > 0.0 ?
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / background_frame_rate)) :
+      std::chrono::steady_clock::duration::zero();
+  next_background_frame_ = std::chrono::steady_clock::time_point();
+}
+
+void RenderThrottle::SetIconified(const bool iconified) {
+  iconified_ = iconified;
+}
+
+void RenderThrottle::SetFocused(const bool focused) {
+  focused_ = focused;
+  // The first background frame renders right away, e.g., to show that the
+  // window lost the focus.
+  next_background_frame_ = std::chrono::steady_clock::time_point();
+}
+
+RenderActivity RenderThrottle::activity() const {
+  if (iconified_) return RENDER_PAUSED;
+  if (!focused_ && background_period_.count() > 0) return RENDER_BACKGROUND;
+  return RENDER_ACTIVE;
+}
+
+bool RenderThrottle::WaitForFrame() {
+  const RenderActivity activity = this->activity();
+  if (activity == RENDER_ACTIVE) return true;
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  double timeout = kPausedWaitTimeout;
+  if (activity == RENDER_BACKGROUND) {
+    if (now >= next_background_frame_) {
+      // The frames keep their period, unless they fall a period behind.
+      next_background_frame_ += background_period_;
+      if (next_background_frame_ < now) {
+        next_background_frame_ = now + background_period_;
+      }
+      ++statistics_.num_background_frames;
+      return true;
+    }
+    const std::chrono::duration<double> until_frame =
+        next_background_frame_ - now;
+    timeout = until_frame.count();
+  }
+  glfwWaitEventsTimeout(timeout);
+  const std::chrono::duration<double> wait_time =
+      std::chrono::steady_clock::now() - now;
+  ++statistics_.num_waits;
+  statistics_.wait_time += wait_time.count();
+  return false;
+}
+
+}  // namespace wvu
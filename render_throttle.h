@@ -0,0 +1,122 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_RENDER_THROTTLE_H_
+#define GLUTILS_RENDER_THROTTLE_H_
+
+#include <chrono>
+#include <cstdint>
+
+namespace wvu {
+// How often a RenderThrottle lets the frames render.
+enum RenderActivity {
+  // Every frame renders.
+  RENDER_ACTIVE = 0,
+  // The window is not focused, and the frames render at the background rate.
+  RENDER_BACKGROUND = 1,
+  // The window is iconified, and no frame renders.
+  RENDER_PAUSED = 2,
+};
+
+// Counters of a RenderThrottle.
+struct RenderThrottleStatistics {
+  // The frames let through while in the background.
+  int64_t num_background_frames = 0;
+  // The waits for events instead of frames.
+  int64_t num_waits = 0;
+  // The seconds spent in the waits.
+  double wait_time = 0.0;
+};
+
+// This class decides whether the render loop draws a frame, from the state of
+// the window reported by its iconify and focus callbacks. Iconified windows
+// show nothing, so their frames are skipped, and unfocused windows are drawn
+// at a low rate, e.g., for the operators glancing at them. Instead of the
+// frames, the loop waits for events, so the CPU and the GPU idle, and the
+// event that restores or focuses the window ends the wait right away.
+//
+// The class does not install the callbacks, since GLFW keeps one per window;
+// the callbacks of the application forward the state.
+//
+// Example:
+//
+// wvu::RenderThrottle render_throttle;
+// render_throttle.Initialize(10.0);
+// // In the iconify and focus callbacks of the window.
+// render_throttle.SetIconified(iconified);
+// render_throttle.SetFocused(focused);
+// while (!glfwWindowShouldClose(window)) {
+//   if (!render_throttle.WaitForFrame()) continue;
+//   ...  // Render the frame.
+// }
+class RenderThrottle {
+ public:
+  RenderThrottle();
+  ~RenderThrottle() {}
+
+  // Sets the frame rate of the unfocused windows, or 0 to render them at full
+  // rate.
+  void Initialize(const double background_frame_rate);
+
+  void SetIconified(const bool iconified);
+  void SetFocused(const bool focused);
+
+  // Returns true if a frame should render now. Otherwise waits for events,
+  // at most until the next background frame, and returns false, so that the
+  // caller checks whether the window should close before calling again.
+  bool WaitForFrame();
+
+  RenderActivity activity() const;
+
+  const RenderThrottleStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  bool iconified_;
+  bool focused_;
+  // The period of the background frames, or zero.
+  std::chrono::steady_clock::duration background_period_;
+  // Time of the next background frame.
+  std::chrono::steady_clock::time_point next_background_frame_;
+  RenderThrottleStatistics statistics_;
+
+  RenderThrottle(const RenderThrottle&) = delete;
+  RenderThrottle& operator=(const RenderThrottle&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_RENDER_THROTTLE_H_
@@ -0,0 +1,235 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+// Replays a capture of the OpenGL calls of draw_triangle (see gl_capture.h)
+// in a hidden window of the size of the captured framebuffer, with vsync off,
+// and times every frame: the CPU time submitting its calls, and the total time
+// until the GPU completed it. The first frame also creates the objects of the
+// scene, so it is reported apart as the setup. The replay needs the driver to
+// support every entry point the capture calls; the others are skipped.
+//
+// Example:
+//
+// ./bin/draw_triangle --capture_frames=100 --capture_file=frames.glcapture
+// ./bin/replay --capture_file=frames.glcapture --output_file=replay.json
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "gl_replay.h"
+
+// Use the right namespace for google flags (gflags).
+#ifdef GFLAGS_NAMESPACE_GOOGLE
+#define CS470_GFLAGS_NAMESPACE google
+#else
+#define CS470_GFLAGS_NAMESPACE gflags
+#endif
+
+DEFINE_string(capture_file, "frames.glcapture", "Capture file to replay.");
+DEFINE_int32(num_slowest_frames, 5, "Number of slowest frames reported.");
+DEFINE_string(output_file, "",
+              "JSON file of the frame times. Empty writes them to stdout.");
+
+// Annonymous namespace for constants and helper functions.
+namespace {
+// The times of a replayed frame.
+struct ReplayedFrame {
+  int frame;
+  wvu::GlReplayFrameTime time;
+};
+
+// Statistics of the frame times, in milliseconds.
+struct FrameTimeStatistics {
+  double min_ms = 0.0;
+  double average_ms = 0.0;
+  double p99_ms = 0.0;
+  double max_ms = 0.0;
+};
+
+FrameTimeStatistics ComputeStatistics(std::vector<double> times) {
+  FrameTimeStatistics statistics;
+  if (times.empty()) return statistics;
+  std::sort(times.begin(), times.end());
+  double sum = 0.0;
+  for (const double time : times) sum += time;
+  statistics.min_ms = times.front();
+  statistics.average_ms = sum / times.size();
+  statistics.p99_ms = times[(times.size() - 1) * 99 / 100];
+  statistics.max_ms = times.back();
+  return statistics;
+}
+
+// Returns the string as a JSON string literal.
+std::string JsonString(const char* value) {
+  std::string json = "\"";
+  for (const char* c = value; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') json += '\\';
+    json += *c;
+  }
+  return json + "\"";
+}
+
+void WriteFrameTimes(const FrameTimeStatistics& statistics,
+                     std::ostringstream* json) {
+  *json << "{\"min\": " << statistics.min_ms
+        << ", \"average\": " << statistics.average_ms
+        << ", \"p99\": " << statistics.p99_ms
+        << ", \"max\": " << statistics.max_ms << "}";
+}
+
+// Returns the setup, the statistics of the other frames and the slowest
+// frames as JSON.
+std::string ToJson(const std::vector<ReplayedFrame>& frames,
+                   const int num_skipped_calls) {
+  std::vector<ReplayedFrame> slowest_frames(frames.begin() + 1, frames.end());
+  std::sort(slowest_frames.begin(), slowest_frames.end(),
+            [](const ReplayedFrame& a, const ReplayedFrame& b) {
+              return a.time.total_ms > b.time.total_ms;
+            });
+  slowest_frames.resize(std::min<int>(slowest_frames.size(),
+                                      FLAGS_num_slowest_frames));
+  std::vector<double> cpu_times, total_times;
+  for (int i = 1; i < static_cast<int>(frames.size()); ++i) {
+    cpu_times.push_back(frames[i].time.cpu_ms);
+    total_times.push_back(frames[i].time.total_ms);
+  }
+  std::ostringstream json;
+  json << "{\n"
+       << "  \"renderer\": " << JsonString(reinterpret_cast<const char*>(
+              glGetString(GL_RENDERER))) << ",\n"
+       << "  \"version\": " << JsonString(reinterpret_cast<const char*>(
+              glGetString(GL_VERSION))) << ",\n"
+       << "  \"capture\": " << JsonString(FLAGS_capture_file.c_str()) << ",\n"
+       << "  \"num_frames\": " << frames.size() << ",\n"
+       << "  \"num_skipped_calls\": " << num_skipped_calls << ",\n"
+       << "  \"setup_ms\": " << frames[0].time.total_ms << ",\n"
+       << "  \"cpu_frame_ms\": ";
+  WriteFrameTimes(ComputeStatistics(cpu_times), &json);
+  json << ",\n  \"total_frame_ms\": ";
+  WriteFrameTimes(ComputeStatistics(total_times), &json);
+  json << ",\n  \"slowest_frames\": [";
+  for (int i = 0; i < static_cast<int>(slowest_frames.size()); ++i) {
+    const ReplayedFrame& frame = slowest_frames[i];
+    json << (i == 0 ? "\n" : ",\n")
+         << "    {\"frame\": " << frame.frame
+         << ", \"cpu_ms\": " << frame.time.cpu_ms
+         << ", \"total_ms\": " << frame.time.total_ms << "}";
+  }
+  json << "\n  ]\n}\n";
+  return json.str();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CS470_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  if (!glfwInit()) {
+    return -1;
+  }
+  // The same context as draw_triangle. The window is created with a
+  // temporary size until the capture tells the size of its framebuffer.
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  GLFWwindow* window = glfwCreateWindow(64, 64, "replay", nullptr, nullptr);
+  if (!window) {
+    glfwTerminate();
+    return -1;
+  }
+  glfwMakeContextCurrent(window);
+  // The frames are replayed as fast as possible.
+  glfwSwapInterval(0);
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK) {
+    LOG(ERROR) << "Glew did not initialize properly!";
+    glfwTerminate();
+    return -1;
+  }
+
+  std::string error_info_log;
+  int exit_code = 0;
+  {
+    wvu::GlReplay replay;
+    if (!replay.Open(FLAGS_capture_file, window, &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+      glfwDestroyWindow(window);
+      glfwTerminate();
+      return -1;
+    }
+    glfwSetWindowSize(window, replay.framebuffer_width(),
+                      replay.framebuffer_height());
+    std::vector<ReplayedFrame> frames;
+    ReplayedFrame frame;
+    while (replay.ReplayFrame(&frame.time)) {
+      frame.frame = frames.size();
+      frames.push_back(frame);
+      glfwSwapBuffers(window);
+    }
+    if (replay.num_skipped_calls() > 0) {
+      LOG(WARNING) << replay.num_skipped_calls() << " calls were skipped, "
+                   << "since the driver does not have their entry points.";
+    }
+    if (frames.empty()) {
+      LOG(ERROR) << FLAGS_capture_file << " has no frames.";
+      exit_code = -1;
+    } else {
+      const std::string json = ToJson(frames, replay.num_skipped_calls());
+      if (FLAGS_output_file.empty()) {
+        std::fputs(json.c_str(), stdout);
+      } else {
+        std::ofstream file(FLAGS_output_file);
+        file << json;
+        if (!file) {
+          LOG(ERROR) << "Could not write " << FLAGS_output_file;
+          exit_code = -1;
+        }
+      }
+    }
+  }
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return exit_code;
+}
@@ -0,0 +1,365 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "rigid_body.h"
+
+#include <algorithm>
+#include <cmath>
+#include <Eigen/Core>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define WVU_HAS_SSE
+#endif
+
+#include "assignment.h"
+#include "entity_registry.h"
+#include "job_system.h"
+
+namespace wvu {
+namespace {
+// Number of bodies integrated by a job.
+constexpr int kIntegrationGrainSize = 4096;
+
+constexpr float kHalfPi = 1.57079632679490f;
+
+// The kernels read the transform columns as arrays of floats.
+static_assert(sizeof(Eigen::Vector3f) == 3 * sizeof(float),
+              "The transform columns must be packed.");
+
+// The constants of a step, shared by the kernels.
+struct StepParameters {
+  float time_step;
+  // The gravity times the time step.
+  float velocity_step[3];
+  // The factors of the damped velocities.
+  float linear_factor;
+  float angular_factor;
+};
+
+// The columns of the bodies of an archetype. The positions and the
+// orientations are the transform columns, three floats per body.
+struct BodyArrays {
+  float* linear_velocity[3];
+  float* angular_velocity[3];
+  float* rotation[4];
+  float* positions;
+  float* orientations;
+};
+
+// Returns the arc tangent of a ratio in [0, 1], as FastAtan2OfNonNegative()
+// in assignment.cc does, with an absolute error below 1e-5 radians.
+inline float AtanOfRatio(const float ratio) {
+  const float squared_ratio = ratio * ratio;
+  return ratio * (0.99997726f + squared_ratio * (-0.33262347f +
+      squared_ratio * (0.19354346f + squared_ratio * (-0.11643287f +
+      squared_ratio * (0.05265332f + squared_ratio * -0.01172120f)))));
+}
+
+int IntegrateScalar(const StepParameters& step,
+                    const BodyArrays& bodies,
+                    const int begin,
+                    const int end) {
+  const float half_step = 0.5f * step.time_step;
+  for (int i = begin; i < end; ++i) {
+    float angular_velocity[3];
+    for (int c = 0; c < 3; ++c) {
+      const float velocity =
+          (bodies.linear_velocity[c][i] + step.velocity_step[c]) *
+          step.linear_factor;
+      bodies.linear_velocity[c][i] = velocity;
+      bodies.positions[3 * i + c] += velocity * step.time_step;
+      angular_velocity[c] =
+          bodies.angular_velocity[c][i] * step.angular_factor;
+      bodies.angular_velocity[c][i] = angular_velocity[c];
+    }
+    const float wx = angular_velocity[0];
+    const float wy = angular_velocity[1];
+    const float wz = angular_velocity[2];
+    float x = bodies.rotation[0][i];
+    float y = bodies.rotation[1][i];
+    float z = bodies.rotation[2][i];
+    float w = bodies.rotation[3][i];
+    const float dx = half_step * (w * wx + wy * z - wz * y);
+    const float dy = half_step * (w * wy + wz * x - wx * z);
+    const float dz = half_step * (w * wz + wx * y - wy * x);
+    const float dw = -half_step * (wx * x + wy * y + wz * z);
+    x += dx;
+    y += dy;
+    z += dz;
+    w += dw;
+    const float inverse_norm = 1.0f / std::sqrt(x * x + y * y + z * z + w * w);
+    x *= inverse_norm;
+    y *= inverse_norm;
+    z *= inverse_norm;
+    w *= inverse_norm;
+    bodies.rotation[0][i] = x;
+    bodies.rotation[1][i] = y;
+    bodies.rotation[2][i] = z;
+    bodies.rotation[3][i] = w;
+
+    // The Rodrigues vector of the quaternion with w >= 0, whose angle is
+    // 2 * atan2(sin_half_angle, w) in [0, pi].
+    const float sign = w < 0.0f ? -1.0f : 1.0f;
+    w *= sign;
+    const float sin_half_angle = std::sqrt(x * x + y * y + z * z);
+    const float larger = std::max(sin_half_angle, w);
+    const float smaller = std::min(sin_half_angle, w);
+    float half_angle = AtanOfRatio(smaller / larger);
+    if (sin_half_angle > w) half_angle = kHalfPi - half_angle;
+    // Near the identity, the angle is 2 * sin_half_angle.
+    const float factor = sign * (sin_half_angle > 1e-6f ?
+        2.0f * half_angle / sin_half_angle : 2.0f);
+    bodies.orientations[3 * i] = x * factor;
+    bodies.orientations[3 * i + 1] = y * factor;
+    bodies.orientations[3 * i + 2] = z * factor;
+  }
+  return end;
+}
+
+#if defined(WVU_HAS_SSE)
+// Loads four packed 3d vectors, x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3, into
+// the registers of their coordinates.
+inline void LoadVectors(const float* vectors, __m128* x, __m128* y, __m128* z) {
+  const __m128 a = _mm_loadu_ps(vectors);
+  const __m128 b = _mm_loadu_ps(vectors + 4);
+  const __m128 c = _mm_loadu_ps(vectors + 8);
+  // x2 y2 x3 y3 and y0 z0 y1 z1.
+  const __m128 t0 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+  const __m128 t1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+  *x = _mm_shuffle_ps(a, t0, _MM_SHUFFLE(2, 0, 3, 0));
+  *y = _mm_shuffle_ps(t1, t0, _MM_SHUFFLE(3, 1, 2, 0));
+  *z = _mm_shuffle_ps(t1, c, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+// Stores the registers of the coordinates of four 3d vectors packed, as
+// LoadVectors() reads them.
+inline void StoreVectors(const __m128 x,
+                         const __m128 y,
+                         const __m128 z,
+                         float* vectors) {
+  // x0 y0 x1 y1 and x2 y2 x3 y3.
+  const __m128 xy01 = _mm_unpacklo_ps(x, y);
+  const __m128 xy23 = _mm_unpackhi_ps(x, y);
+  // z0 z0 x1 x1, y1 y1 z1 z1, z2 z2 x3 x3 and y3 y3 z3 z3.
+  const __m128 zx01 = _mm_shuffle_ps(z, xy01, _MM_SHUFFLE(2, 2, 0, 0));
+  const __m128 yz11 = _mm_shuffle_ps(xy01, z, _MM_SHUFFLE(1, 1, 3, 3));
+  const __m128 zx23 = _mm_shuffle_ps(z, xy23, _MM_SHUFFLE(2, 2, 2, 2));
+  const __m128 yz33 = _mm_shuffle_ps(xy23, z, _MM_SHUFFLE(3, 3, 3, 3));
+  _mm_storeu_ps(vectors, _mm_shuffle_ps(xy01, zx01, _MM_SHUFFLE(2, 0, 1, 0)));
+  _mm_storeu_ps(vectors + 4,
+                _mm_shuffle_ps(yz11, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+  _mm_storeu_ps(vectors + 8,
+                _mm_shuffle_ps(zx23, yz33, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+// Selects a where the mask is set, and b elsewhere.
+inline __m128 Select(const __m128 mask, const __m128 a, const __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+int IntegrateSse(const StepParameters& step,
+                 const BodyArrays& bodies,
+                 const int begin,
+                 const int end) {
+  const __m128 time_step = _mm_set1_ps(step.time_step);
+  const __m128 half_step = _mm_set1_ps(0.5f * step.time_step);
+  const __m128 velocity_step_x = _mm_set1_ps(step.velocity_step[0]);
+  const __m128 velocity_step_y = _mm_set1_ps(step.velocity_step[1]);
+  const __m128 velocity_step_z = _mm_set1_ps(step.velocity_step[2]);
+  const __m128 linear_factor = _mm_set1_ps(step.linear_factor);
+  const __m128 angular_factor = _mm_set1_ps(step.angular_factor);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 half_pi = _mm_set1_ps(kHalfPi);
+  const __m128 epsilon = _mm_set1_ps(1e-6f);
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  int i = begin;
+  for (; i + 4 <= end; i += 4) {
+    // Semi-implicit Euler: the positions move with the new velocities.
+    const __m128 velocity_x = _mm_mul_ps(
+        _mm_add_ps(_mm_loadu_ps(bodies.linear_velocity[0] + i),
+                   velocity_step_x), linear_factor);
+    const __m128 velocity_y = _mm_mul_ps(
+        _mm_add_ps(_mm_loadu_ps(bodies.linear_velocity[1] + i),
+                   velocity_step_y), linear_factor);
+    const __m128 velocity_z = _mm_mul_ps(
+        _mm_add_ps(_mm_loadu_ps(bodies.linear_velocity[2] + i),
+                   velocity_step_z), linear_factor);
+    _mm_storeu_ps(bodies.linear_velocity[0] + i, velocity_x);
+    _mm_storeu_ps(bodies.linear_velocity[1] + i, velocity_y);
+    _mm_storeu_ps(bodies.linear_velocity[2] + i, velocity_z);
+    float* positions = bodies.positions + 3 * i;
+    __m128 px, py, pz;
+    LoadVectors(positions, &px, &py, &pz);
+    px = _mm_add_ps(px, _mm_mul_ps(velocity_x, time_step));
+    py = _mm_add_ps(py, _mm_mul_ps(velocity_y, time_step));
+    pz = _mm_add_ps(pz, _mm_mul_ps(velocity_z, time_step));
+    StoreVectors(px, py, pz, positions);
+
+    const __m128 wx = _mm_mul_ps(
+        _mm_loadu_ps(bodies.angular_velocity[0] + i), angular_factor);
+    const __m128 wy = _mm_mul_ps(
+        _mm_loadu_ps(bodies.angular_velocity[1] + i), angular_factor);
+    const __m128 wz = _mm_mul_ps(
+        _mm_loadu_ps(bodies.angular_velocity[2] + i), angular_factor);
+    _mm_storeu_ps(bodies.angular_velocity[0] + i, wx);
+    _mm_storeu_ps(bodies.angular_velocity[1] + i, wy);
+    _mm_storeu_ps(bodies.angular_velocity[2] + i, wz);
+    __m128 x = _mm_loadu_ps(bodies.rotation[0] + i);
+    __m128 y = _mm_loadu_ps(bodies.rotation[1] + i);
+    __m128 z = _mm_loadu_ps(bodies.rotation[2] + i);
+    __m128 w = _mm_loadu_ps(bodies.rotation[3] + i);
+    const __m128 dx = _mm_mul_ps(half_step, _mm_sub_ps(
+        _mm_add_ps(_mm_mul_ps(w, wx), _mm_mul_ps(wy, z)), _mm_mul_ps(wz, y)));
+    const __m128 dy = _mm_mul_ps(half_step, _mm_sub_ps(
+        _mm_add_ps(_mm_mul_ps(w, wy), _mm_mul_ps(wz, x)), _mm_mul_ps(wx, z)));
+    const __m128 dz = _mm_mul_ps(half_step, _mm_sub_ps(
+        _mm_add_ps(_mm_mul_ps(w, wz), _mm_mul_ps(wx, y)), _mm_mul_ps(wy, x)));
+    const __m128 dw = _mm_mul_ps(half_step, _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(wx, x), _mm_mul_ps(wy, y)), _mm_mul_ps(wz, z)));
+    x = _mm_add_ps(x, dx);
+    y = _mm_add_ps(y, dy);
+    z = _mm_add_ps(z, dz);
+    w = _mm_sub_ps(w, dw);
+    const __m128 squared_sin = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    const __m128 inverse_norm = _mm_div_ps(
+        one, _mm_sqrt_ps(_mm_add_ps(squared_sin, _mm_mul_ps(w, w))));
+    x = _mm_mul_ps(x, inverse_norm);
+    y = _mm_mul_ps(y, inverse_norm);
+    z = _mm_mul_ps(z, inverse_norm);
+    w = _mm_mul_ps(w, inverse_norm);
+    _mm_storeu_ps(bodies.rotation[0] + i, x);
+    _mm_storeu_ps(bodies.rotation[1] + i, y);
+    _mm_storeu_ps(bodies.rotation[2] + i, z);
+    _mm_storeu_ps(bodies.rotation[3] + i, w);
+
+    // The Rodrigues vectors of the quaternions with w >= 0, as in
+    // IntegrateScalar().
+    const __m128 sign = _mm_and_ps(w, sign_mask);
+    w = _mm_xor_ps(w, sign);
+    const __m128 sin_half_angle =
+        _mm_sqrt_ps(_mm_mul_ps(squared_sin,
+                               _mm_mul_ps(inverse_norm, inverse_norm)));
+    const __m128 ratio = _mm_div_ps(_mm_min_ps(sin_half_angle, w),
+                                    _mm_max_ps(sin_half_angle, w));
+    const __m128 squared_ratio = _mm_mul_ps(ratio, ratio);
+    __m128 half_angle = _mm_set1_ps(-0.01172120f);
+    half_angle = _mm_add_ps(_mm_mul_ps(half_angle, squared_ratio),
+                            _mm_set1_ps(0.05265332f));
+    half_angle = _mm_add_ps(_mm_mul_ps(half_angle, squared_ratio),
+                            _mm_set1_ps(-0.11643287f));
+    half_angle = _mm_add_ps(_mm_mul_ps(half_angle, squared_ratio),
+                            _mm_set1_ps(0.19354346f));
+    half_angle = _mm_add_ps(_mm_mul_ps(half_angle, squared_ratio),
+                            _mm_set1_ps(-0.33262347f));
+    half_angle = _mm_add_ps(_mm_mul_ps(half_angle, squared_ratio),
+                            _mm_set1_ps(0.99997726f));
+    half_angle = _mm_mul_ps(half_angle, ratio);
+    half_angle = Select(_mm_cmpgt_ps(sin_half_angle, w),
+                        _mm_sub_ps(half_pi, half_angle), half_angle);
+    const __m128 factor = _mm_xor_ps(
+        Select(_mm_cmpgt_ps(sin_half_angle, epsilon),
+               _mm_div_ps(_mm_mul_ps(two, half_angle), sin_half_angle), two),
+        sign);
+    StoreVectors(_mm_mul_ps(x, factor), _mm_mul_ps(y, factor),
+                 _mm_mul_ps(z, factor), bodies.orientations + 3 * i);
+  }
+  return i;
+}
+#endif  // WVU_HAS_SSE
+
+void Integrate(const StepParameters& step,
+               const BodyArrays& bodies,
+               const int begin,
+               const int end) {
+  int i = begin;
+#if defined(WVU_HAS_SSE)
+  if (ActiveSimdInstructionSet() != SCALAR) {
+    i = IntegrateSse(step, bodies, begin, end);
+  }
+#endif
+  IntegrateScalar(step, bodies, i, end);
+}
+
+}  // namespace
+
+void IntegrateRigidBodies(const float time_step,
+                          const RigidBodyParameters& parameters,
+                          JobSystem* job_system,
+                          EntityRegistry* registry) {
+  StepParameters step;
+  step.time_step = time_step;
+  for (int c = 0; c < 3; ++c) {
+    step.velocity_step[c] = parameters.gravity[c] * time_step;
+  }
+  step.linear_factor = 1.0f / (1.0f + parameters.linear_damping * time_step);
+  step.angular_factor =
+      1.0f / (1.0f + parameters.angular_damping * time_step);
+  registry->ForEachArchetype(RIGID_BODY_COMPONENT | TRANSFORM_COMPONENT,
+                             [&](EntityArchetype* archetype) {
+    // The mutable columns mark the transforms dirty once, before the jobs
+    // write them.
+    BodyArrays bodies;
+    Vector3fArray* linear_velocities = archetype->mutable_linear_velocities();
+    Vector3fArray* angular_velocities =
+        archetype->mutable_angular_velocities();
+    Vector4fArray* rotations = archetype->mutable_rotations();
+    bodies.linear_velocity[0] = linear_velocities->x.data();
+    bodies.linear_velocity[1] = linear_velocities->y.data();
+    bodies.linear_velocity[2] = linear_velocities->z.data();
+    bodies.angular_velocity[0] = angular_velocities->x.data();
+    bodies.angular_velocity[1] = angular_velocities->y.data();
+    bodies.angular_velocity[2] = angular_velocities->z.data();
+    bodies.rotation[0] = rotations->x.data();
+    bodies.rotation[1] = rotations->y.data();
+    bodies.rotation[2] = rotations->z.data();
+    bodies.rotation[3] = rotations->w.data();
+    bodies.positions = archetype->mutable_positions()->data()->data();
+    bodies.orientations = archetype->mutable_orientations()->data()->data();
+    const auto integrate = [&step, &bodies](const int begin, const int end) {
+      Integrate(step, bodies, begin, end);
+    };
+    if (job_system == nullptr) {
+      integrate(0, archetype->num_entities());
+    } else {
+      job_system->ParallelFor(archetype->num_entities(),
+                              kIntegrationGrainSize, integrate);
+    }
+  });
+}
+
+}  // namespace wvu
@@ -0,0 +1,94 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_RIGID_BODY_H_
+#define GLUTILS_RIGID_BODY_H_
+
+#include <Eigen/Core>
+
+#include "entity_registry.h"
+#include "job_system.h"
+
+namespace wvu {
+// The forces of the world of the rigid bodies.
+struct RigidBodyParameters {
+  // The acceleration of every body.
+  Eigen::Vector3f gravity = Eigen::Vector3f(0.0f, -9.81f, 0.0f);
+  // The damping of the linear and angular velocities, per second: every step
+  // divides them by 1 + damping * time_step.
+  float linear_damping = 0.0f;
+  float angular_damping = 0.0f;
+};
+
+// Integrates the entities of a registry with a RIGID_BODY_COMPONENT and a
+// TRANSFORM_COMPONENT over a time step with the semi-implicit Euler method:
+// the velocities are updated first, and the positions and the orientations
+// move with the new velocities. The quaternions advance by
+// dt / 2 * (angular velocity, 0) * rotation and are normalized again, and
+// the Rodrigues vectors of the transforms are computed from them with a
+// polynomial arc tangent accurate to 1e-5 radians, which does not accumulate
+// because the quaternions are integrated instead.
+//
+// The velocities and the quaternions are columns of arrays (SoA), so the
+// kernel integrates four bodies at a time with SSE, loading the positions and
+// orientations of the transform columns and transposing them in registers.
+// The ranges of the bodies are integrated in parallel on the jobs of a
+// JobSystem.
+//
+// Example:
+//
+// const wvu::Entity body = registry.CreateEntity(
+//     wvu::kModelComponents | wvu::RIGID_BODY_COMPONENT);
+// registry.SetTransform(body, orientation, position);
+// registry.SetVelocities(body, linear_velocity, angular_velocity);
+// while (...) {  // Simulation loop.
+//   wvu::IntegrateRigidBodies(time_step, wvu::RigidBodyParameters(),
+//                             &job_system, &registry);
+//   registry.UpdateTransforms();
+// }
+// Parameters:
+//   time_step  The time step, in seconds.
+//   parameters  The forces.
+//   job_system  The job system integrating ranges of the bodies in parallel,
+//     or nullptr to integrate them on the calling thread.
+//   registry  The entities.
+void IntegrateRigidBodies(const float time_step,
+                          const RigidBodyParameters& parameters,
+                          JobSystem* job_system,
+                          EntityRegistry* registry);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_RIGID_BODY_H_
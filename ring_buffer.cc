@@ -0,0 +1,161 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "ring_buffer.h"
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+
+namespace wvu {
+namespace {
+// Time in nanoseconds to wait for a fence before checking it again.
+constexpr GLuint64 kFenceTimeout = 1000000000;
+
+bool BufferStorageSupported() {
+  return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+}  // namespace
+
+RingBuffer::RingBuffer()
+    : buffer_id_(0),
+      mapped_data_(nullptr),
+      flushed_size_(0),
+      persistent_(false),
+      frame_capacity_(0),
+      num_frames_(0),
+      frame_index_(-1),
+      frame_size_(0),
+      num_waits_(0) {}
+
+RingBuffer::~RingBuffer() {
+  for (const GLsync fence : fences_) {
+    if (fence != nullptr) glDeleteSync(fence);
+  }
+  // Deleting the buffer unmaps it.
+  BufferAllocator::Get()->DeleteBuffer(&buffer_id_);
+}
+
+bool RingBuffer::Initialize(const GLsizeiptr frame_capacity,
+                            const int num_frames) {
+  if (buffer_id_ != 0 || num_frames <= 0) return false;
+  GlStateCache* gl_state = GlStateCache::Current();
+  frame_capacity_ = frame_capacity;
+  num_frames_ = num_frames;
+  fences_.assign(num_frames, nullptr);
+  const GLsizeiptr size = frame_capacity * num_frames;
+  BufferAllocator* allocator = BufferAllocator::Get();
+  buffer_id_ = allocator->CreateBuffer(STAGING_DATA);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, buffer_id_);
+  persistent_ = BufferStorageSupported();
+  if (persistent_) {
+    constexpr GLbitfield kMapFlags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    allocator->BufferStorage(buffer_id_, GL_COPY_WRITE_BUFFER, size, nullptr,
+                             kMapFlags);
+    mapped_data_ = static_cast<char*>(
+        glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, kMapFlags));
+  } else {
+    allocator->BufferData(buffer_id_, GL_COPY_WRITE_BUFFER, size, nullptr,
+                          GL_STREAM_DRAW);
+    staging_data_.resize(frame_capacity);
+  }
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  return buffer_id_ != 0 && (!persistent_ || mapped_data_ != nullptr);
+}
+
+void RingBuffer::BeginFrame() {
+  frame_index_ = (frame_index_ + 1) % num_frames_;
+  frame_size_ = 0;
+  flushed_size_ = 0;
+  GLsync& fence = fences_[frame_index_];
+  if (fence != nullptr) {
+    // Poll first, so that waits are only counted when the GPU is behind.
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      ++num_waits_;
+      do {
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                  kFenceTimeout);
+      } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+}
+
+bool RingBuffer::Allocate(const GLsizeiptr size,
+                          const GLsizeiptr alignment,
+                          RingBufferAllocation* allocation) {
+  if (frame_index_ < 0) return false;
+  // Align the offset within the buffer, since that is what OpenGL checks.
+  const GLintptr unaligned_offset = section_offset() + frame_size_;
+  const GLintptr offset = alignment > 1 ?
+      (unaligned_offset + alignment - 1) / alignment * alignment :
+      unaligned_offset;
+  if (offset + size > section_offset() + frame_capacity_) {
+    return false;
+  }
+  allocation->offset = offset;
+  allocation->size = size;
+  allocation->data = persistent_ ?
+      mapped_data_ + offset :
+      staging_data_.data() + (offset - section_offset());
+  frame_size_ = offset + size - section_offset();
+  return true;
+}
+
+void RingBuffer::Flush() {
+  if (persistent_ || frame_index_ < 0 || flushed_size_ == frame_size_) return;
+  // The fence of the section guarantees that the GPU is done reading it, so
+  // the upload does not wait for pending draws.
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, buffer_id_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, section_offset() + flushed_size_,
+                  frame_size_ - flushed_size_,
+                  staging_data_.data() + flushed_size_);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  flushed_size_ = frame_size_;
+}
+
+void RingBuffer::EndFrame() {
+  if (frame_index_ < 0) return;
+  Flush();
+  fences_[frame_index_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+}  // namespace wvu
@@ -0,0 +1,165 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_RING_BUFFER_H_
+#define GLUTILS_RING_BUFFER_H_
+
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+// Default number of frames a ring buffer can have in flight.
+constexpr int kDefaultNumRingBufferFrames = 3;
+
+// A range of a ring buffer written by the CPU in the current frame.
+struct RingBufferAllocation {
+  // Pointer to write the data into.
+  void* data = nullptr;
+  // Offset of the range in the buffer, e.g., for glBindBufferRange() or the
+  // offset of a vertex attribute.
+  GLintptr offset = 0;
+  GLsizeiptr size = 0;
+};
+
+// This class streams per-frame data, such as uniforms, instance transforms
+// and dynamic vertices, into a buffer split into one section per frame in
+// flight. The CPU writes the section of the current frame while the GPU reads
+// the sections of the previous frames, so no upload waits for a draw and no
+// storage is reallocated. A fence per section guards its reuse: BeginFrame()
+// only waits if the GPU is more than num_frames - 1 frames behind.
+// With OpenGL 4.4 or ARB_buffer_storage the buffer is mapped once, persistently
+// and coherently, and the allocations are visible to the GPU as soon as they
+// are written. Otherwise the allocations are written into CPU memory, and
+// Flush() uploads them before the draws that read them.
+//
+// Example:
+//
+// wvu::RingBuffer ring_buffer;
+// ring_buffer.Initialize(1 << 20, wvu::kDefaultNumRingBufferFrames);
+// while (...) {  // Rendering loop.
+//   ring_buffer.BeginFrame();
+//   wvu::RingBufferAllocation allocation;
+//   if (ring_buffer.Allocate(size, alignment, &allocation)) {
+//     std::memcpy(allocation.data, vertices, size);
+//     ring_buffer.Flush();
+//     glBindVertexBuffer(0, ring_buffer.buffer_id(), allocation.offset,
+//                        stride);
+//   }
+//   ...  // Draws reading the allocations.
+//   ring_buffer.EndFrame();
+// }
+class RingBuffer {
+ public:
+  RingBuffer();
+  ~RingBuffer();
+
+  // Creates the buffer with num_frames sections of frame_capacity bytes each.
+  // Returns true if successful.
+  bool Initialize(const GLsizeiptr frame_capacity, const int num_frames);
+
+  // Starts writing the section of the next frame, waiting for the GPU to
+  // finish reading it if necessary.
+  void BeginFrame();
+
+  // Reserves size bytes of the section of the current frame at an offset
+  // multiple of alignment. Returns false if the section is full.
+  bool Allocate(const GLsizeiptr size,
+                const GLsizeiptr alignment,
+                RingBufferAllocation* allocation);
+
+  // Uploads the allocations written since the last flush. Does nothing when
+  // the buffer is persistently mapped.
+  void Flush();
+
+  // Ends the writes of the current frame. Must be called after the commands
+  // reading the section were issued, since it fences them.
+  void EndFrame();
+
+  GLuint buffer_id() const {
+    return buffer_id_;
+  }
+
+  // Returns true if the buffer is persistently mapped.
+  bool persistent() const {
+    return persistent_;
+  }
+
+  GLsizeiptr frame_capacity() const {
+    return frame_capacity_;
+  }
+
+  int num_frames() const {
+    return num_frames_;
+  }
+
+  // Returns the bytes allocated in the current frame.
+  GLsizeiptr frame_size() const {
+    return frame_size_;
+  }
+
+  // Returns the number of times BeginFrame() waited for the GPU.
+  int num_waits() const {
+    return num_waits_;
+  }
+
+ private:
+  // Offset of the section of the current frame.
+  GLintptr section_offset() const {
+    return static_cast<GLintptr>(frame_index_) * frame_capacity_;
+  }
+
+  GLuint buffer_id_;
+  // Pointer to the mapped buffer when persistent.
+  char* mapped_data_;
+  // The section of the current frame when not persistent.
+  std::vector<char> staging_data_;
+  // Bytes of the current frame already uploaded when not persistent.
+  GLsizeiptr flushed_size_;
+  bool persistent_;
+  GLsizeiptr frame_capacity_;
+  int num_frames_;
+  // Section of the current frame, or -1 before the first frame.
+  int frame_index_;
+  GLsizeiptr frame_size_;
+  // Fences of the commands reading each section.
+  std::vector<GLsync> fences_;
+  int num_waits_;
+
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_RING_BUFFER_H_
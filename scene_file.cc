@@ -0,0 +1,385 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "scene_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "bounding_volume_hierarchy.h"
+#include "buffer_allocator.h"
+#include "camera.h"
+#include "gpu_mesh.h"
+#include "mesh_file.h"
+#include "mesh_residency.h"
+#include "mesh_uploader.h"
+#include "model.h"
+
+namespace wvu {
+namespace {
+
+// Returns the directory of a filepath, including the trailing separator.
+std::string DirectoryOf(const std::string& filepath) {
+  const size_t separator = filepath.find_last_of('/');
+  if (separator == std::string::npos) return "";
+  return filepath.substr(0, separator + 1);
+}
+
+// Returns the world-space bounds of a model-space box placed by a matrix.
+Eigen::AlignedBox3f TransformBox(const Eigen::AlignedBox3f& box,
+                                 const Eigen::Matrix4f& transformation) {
+  Eigen::AlignedBox3f transformed_box;
+  for (int i = 0; i < 8; ++i) {
+    const Eigen::Vector3f corner = box.corner(
+        static_cast<Eigen::AlignedBox3f::CornerType>(i));
+    transformed_box.extend((transformation * corner.homogeneous()).head<3>());
+  }
+  return transformed_box;
+}
+
+// Returns true if two mesh files with the same content hash draw the same. The
+// hashes of different meshes may collide, however unlikely, so the counts
+// are compared too.
+bool IsSameMesh(const MeshFile& mesh_file, const MeshFile& other_mesh_file) {
+  return mesh_file.content_hash() == other_mesh_file.content_hash() &&
+      mesh_file.primitive_type() == other_mesh_file.primitive_type() &&
+      mesh_file.index_type() == other_mesh_file.index_type() &&
+      mesh_file.num_vertices() == other_mesh_file.num_vertices() &&
+      mesh_file.num_indices() == other_mesh_file.num_indices() &&
+      mesh_file.vertex_data_size() == other_mesh_file.vertex_data_size();
+}
+
+// Returns the bytes of the GPU buffers of a mesh.
+GLsizeiptr GetMeshBytes(const MeshFile& mesh_file) {
+  return mesh_file.vertex_data_size() + mesh_file.index_data_size();
+}
+
+}  // namespace
+
+bool ReadSceneFile(const std::string& filepath,
+                   SceneDescription* scene,
+                   std::string* error_info_log) {
+  std::ifstream in(filepath);
+  if (!in.is_open()) {
+    *error_info_log = "Could not open " + filepath;
+    return false;
+  }
+  scene->meshes.clear();
+  scene->objects.clear();
+  scene->lighting = CLUSTERED_FORWARD_LIGHTING;
+  const std::string directory = DirectoryOf(filepath);
+  std::unordered_map<std::string, int> mesh_indices;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(in, line)) {
+    ++line_number;
+    const size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') continue;
+    const std::string location =
+        filepath + ":" + std::to_string(line_number) + ": ";
+    std::istringstream fields(line);
+    std::string keyword;
+    fields >> keyword;
+    if (keyword == "mesh") {
+      SceneMesh mesh;
+      if (!(fields >> mesh.name >> mesh.filepath)) {
+        *error_info_log = location + "Expected a mesh name and a path.";
+        return false;
+      }
+      if (!mesh_indices.emplace(mesh.name, scene->meshes.size()).second) {
+        *error_info_log = location + "The mesh " + mesh.name +
+            " is declared twice.";
+        return false;
+      }
+      if (mesh.filepath[0] != '/') mesh.filepath = directory + mesh.filepath;
+      scene->meshes.push_back(std::move(mesh));
+    } else if (keyword == "object") {
+      std::string mesh_name;
+      SceneObject object;
+      if (!(fields >> mesh_name >> object.position.x() >>
+            object.position.y() >> object.position.z() >>
+            object.orientation.x() >> object.orientation.y() >>
+            object.orientation.z())) {
+        *error_info_log = location +
+            "Expected a mesh name, a position and an orientation.";
+        return false;
+      }
+      const auto mesh = mesh_indices.find(mesh_name);
+      if (mesh == mesh_indices.end()) {
+        *error_info_log = location + "Unknown mesh " + mesh_name + ".";
+        return false;
+      }
+      object.mesh = mesh->second;
+      scene->objects.push_back(object);
+    } else if (keyword == "lighting") {
+      std::string lighting;
+      fields >> lighting;
+      if (lighting == "forward") {
+        scene->lighting = CLUSTERED_FORWARD_LIGHTING;
+      } else if (lighting == "deferred") {
+        scene->lighting = DEFERRED_LIGHTING;
+      } else {
+        *error_info_log = location + "Expected forward or deferred lighting.";
+        return false;
+      }
+    } else {
+      *error_info_log = location + "Unknown keyword " + keyword + ".";
+      return false;
+    }
+    std::string rest;
+    if (fields >> rest) {
+      *error_info_log = location + "Unexpected " + rest + ".";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WriteSceneFile(const SceneDescription& scene,
+                    const std::string& filepath,
+                    std::string* error_info_log) {
+  const std::string temporary_filepath = filepath + ".tmp";
+  std::ofstream out(temporary_filepath);
+  if (!out.is_open()) {
+    *error_info_log = "Could not open " + temporary_filepath;
+    return false;
+  }
+  // Nine significant digits round trip the floats.
+  out << std::setprecision(9);
+  if (scene.lighting == DEFERRED_LIGHTING) out << "lighting deferred\n";
+  for (const SceneMesh& mesh : scene.meshes) {
+    out << "mesh " << mesh.name << " " << mesh.filepath << "\n";
+  }
+  for (const SceneObject& object : scene.objects) {
+    out << "object " << scene.meshes[object.mesh].name << " "
+        << object.position.x() << " " << object.position.y() << " "
+        << object.position.z() << " " << object.orientation.x() << " "
+        << object.orientation.y() << " " << object.orientation.z() << "\n";
+  }
+  out.close();
+  if (!out) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + temporary_filepath;
+    return false;
+  }
+  if (std::rename(temporary_filepath.c_str(), filepath.c_str()) != 0) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not rename " + temporary_filepath;
+    return false;
+  }
+  return true;
+}
+
+StreamedScene::StreamedScene()
+    : lighting_(CLUSTERED_FORWARD_LIGHTING), num_duplicate_meshes_(0),
+      frame_(0) {}
+
+bool StreamedScene::Open(const std::string& filepath,
+                         const SceneStreamingOptions& options,
+                         std::string* error_info_log) {
+  SceneDescription scene;
+  if (!ReadSceneFile(filepath, &scene, error_info_log)) return false;
+  Reset();
+  options_ = options;
+  lighting_ = scene.lighting;
+  // Opening a mesh file maps it and validates its header, without reading
+  // the vertices. The meshes with the content of an earlier one are dropped,
+  // and their objects draw the earlier one.
+  std::vector<Mesh> meshes;
+  std::vector<int> mesh_indices(scene.meshes.size());
+  std::unordered_map<uint64_t, int> meshes_by_content;
+  for (size_t i = 0; i < scene.meshes.size(); ++i) {
+    std::unique_ptr<MeshFile> mesh_file(new MeshFile());
+    if (!mesh_file->Open(scene.meshes[i].filepath, error_info_log)) {
+      return false;
+    }
+    const auto existing_mesh = meshes_by_content.emplace(
+        mesh_file->content_hash(), meshes.size());
+    if (!existing_mesh.second &&
+        IsSameMesh(*meshes[existing_mesh.first->second].mesh_file,
+                   *mesh_file)) {
+      mesh_indices[i] = existing_mesh.first->second;
+      continue;
+    }
+    mesh_indices[i] = meshes.size();
+    meshes.emplace_back();
+    meshes.back().mesh_file = std::move(mesh_file);
+  }
+  num_duplicate_meshes_ = scene.meshes.size() - meshes.size();
+  meshes_ = std::move(meshes);
+  objects_.resize(scene.objects.size());
+  std::vector<Eigen::AlignedBox3f> object_bounds(scene.objects.size());
+  for (size_t i = 0; i < scene.objects.size(); ++i) {
+    // The objects are placed as models are.
+    Model placement;
+    placement.SetOrientation(scene.objects[i].orientation);
+    placement.SetPosition(scene.objects[i].position);
+    objects_[i].mesh = mesh_indices[scene.objects[i].mesh];
+    objects_[i].model_matrix = placement.model_matrix();
+    const MeshFile& mesh_file = *meshes_[objects_[i].mesh].mesh_file;
+    object_bounds[i] = TransformBox(
+        Eigen::AlignedBox3f(mesh_file.bounds_min(), mesh_file.bounds_max()),
+        objects_[i].model_matrix);
+  }
+  bvh_.Build(object_bounds);
+  residency_.Initialize(meshes_.size(), options_.residency,
+                        BufferAllocator::Get(), [this](const int mesh) {
+    meshes_[mesh].gpu_mesh.Reset();
+    meshes_[mesh].state = MESH_UNLOADED;
+  });
+  return true;
+}
+
+
+void StreamedScene::Update(const Camera& camera, MeshUploader* mesh_uploader) {
+  ++frame_;
+  residency_.BeginFrame();
+  const int num_pending_uploads = uploads_.size();
+  statistics_ = SceneStreamingStatistics();
+  visible_objects_.clear();
+  bvh_.QueryFrustum(camera.view_projection(), &visible_objects_);
+  // The objects within the keep distance keep their meshes, and the nearest
+  // of them request the missing ones.
+  requested_meshes_.clear();
+  for (const int object : visible_objects_) {
+    const float distance = bvh_.bounds(object).exteriorDistance(
+        camera.position());
+    if (distance > options_.keep_distance) continue;
+    const int mesh_index = objects_[object].mesh;
+    Mesh& mesh = meshes_[mesh_index];
+    if (mesh.kept_frame != frame_) {
+      mesh.kept_frame = frame_;
+      mesh.distance = distance;
+      if (mesh.state == MESH_UNLOADED) requested_meshes_.push_back(mesh_index);
+      residency_.MarkDrawn(mesh_index);
+    } else {
+      mesh.distance = std::min(mesh.distance, distance);
+    }
+  }
+  const auto nearer = [this](const int a, const int b) {
+    return meshes_[a].distance < meshes_[b].distance;
+  };
+  const int num_uploads = std::min<int>(requested_meshes_.size(),
+                                        options_.max_uploads_per_frame);
+  std::partial_sort(requested_meshes_.begin(),
+                    requested_meshes_.begin() + num_uploads,
+                    requested_meshes_.end(), nearer);
+  for (int i = 0; i < num_uploads; ++i) {
+    const int mesh_index = requested_meshes_[i];
+    Mesh& mesh = meshes_[mesh_index];
+    // The requests are sorted, so the rest are beyond the load distance too.
+    if (mesh.distance > options_.load_distance) break;
+    if (!residency_.RequestLoad(mesh_index, GetMeshBytes(*mesh.mesh_file))) {
+      ++statistics_.num_refused_uploads;
+      continue;
+    }
+    Model model;
+    if (!mesh.mesh_file->ToModel(&model)) {
+      residency_.SetEvicted(mesh_index);
+      mesh.state = MESH_CORRUPT;
+      ++statistics_.num_corrupt_meshes;
+      continue;
+    }
+    uploads_[mesh_uploader->Upload(std::move(model))] = mesh_index;
+    mesh.state = MESH_UPLOADING;
+    ++statistics_.num_uploads;
+  }
+  // The meshes not kept for the delay are evicted. The uploading ones are
+  // evicted once resident.
+  for (int i = 0; i < num_meshes(); ++i) {
+    Mesh& mesh = meshes_[i];
+    if (mesh.state != MESH_RESIDENT) continue;
+    if (frame_ - mesh.kept_frame > options_.eviction_delay_frames) {
+      mesh.gpu_mesh.Reset();
+      mesh.state = MESH_UNLOADED;
+      residency_.SetEvicted(i);
+      ++statistics_.num_evictions;
+      continue;
+    }
+    ++statistics_.num_resident_meshes;
+    statistics_.resident_bytes += GetMeshBytes(*mesh.mesh_file);
+  }
+  statistics_.num_visible_objects = visible_objects_.size();
+  statistics_.num_pending_uploads =
+      num_pending_uploads + statistics_.num_uploads;
+}
+
+int StreamedScene::TakeCompletedMeshes(
+    std::vector<CompletedMeshUpload>* uploads) {
+  int num_taken = 0;
+  auto kept = uploads->begin();
+  for (auto upload = uploads->begin(); upload != uploads->end(); ++upload) {
+    const auto mesh_index = uploads_.find(upload->id);
+    if (mesh_index == uploads_.end()) {
+      if (kept != upload) *kept = std::move(*upload);
+      ++kept;
+      continue;
+    }
+    Mesh& mesh = meshes_[mesh_index->second];
+    mesh.gpu_mesh = std::move(upload->mesh);
+    mesh.state = MESH_RESIDENT;
+    residency_.SetResident(mesh_index->second,
+                           GetMeshBytes(*mesh.mesh_file));
+    uploads_.erase(mesh_index);
+    ++num_taken;
+  }
+  uploads->erase(kept, uploads->end());
+  return num_taken;
+}
+
+void StreamedScene::Reset() {
+  for (int i = 0; i < num_meshes(); ++i) {
+    Mesh& mesh = meshes_[i];
+    mesh.gpu_mesh.Reset();
+    mesh.state = MESH_UNLOADED;
+    mesh.kept_frame = -1;
+    residency_.SetEvicted(i);
+  }
+  uploads_.clear();
+  visible_objects_.clear();
+  statistics_ = SceneStreamingStatistics();
+}
+
+}  // namespace wvu
@@ -0,0 +1,306 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SCENE_FILE_H_
+#define GLUTILS_SCENE_FILE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include "bounding_volume_hierarchy.h"
+#include "camera.h"
+#include "gpu_mesh.h"
+#include "mesh_file.h"
+#include "mesh_residency.h"
+#include "mesh_uploader.h"
+
+namespace wvu {
+// A mesh of a scene file.
+struct SceneMesh {
+  std::string name;
+  // The path of the mesh file, relative to the scene file in the file and
+  // resolved once read.
+  std::string filepath;
+};
+
+// An object of a scene file: a mesh placed as a Model places its vertices.
+struct SceneObject {
+  // The index of the mesh in SceneDescription::meshes.
+  int mesh = 0;
+  Eigen::Vector3f position = Eigen::Vector3f::Zero();
+  // Axis of rotation whose norm is the angle, as Model::orientation().
+  Eigen::Vector3f orientation = Eigen::Vector3f::Zero();
+};
+
+// How the lights of a scene are shaded.
+enum SceneLighting {
+  // Forward shading, with the lights of the clusters of the frustum (see
+  // clustered_lighting.h).
+  CLUSTERED_FORWARD_LIGHTING = 0,
+  // Deferred shading, with the lights of the tiles of the screen (see
+  // deferred_shading.h), for scenes with many overlapping lights.
+  DEFERRED_LIGHTING = 1
+};
+
+// The contents of a scene file.
+struct SceneDescription {
+  std::vector<SceneMesh> meshes;
+  std::vector<SceneObject> objects;
+  SceneLighting lighting = CLUSTERED_FORWARD_LIGHTING;
+};
+
+// Reads a scene from a text file listing the mesh files of the scene and the
+// objects placing them, one per line. Lines starting with '#' are comments.
+//
+//   # The meshes, by name and path of their mesh file (see mesh_file.h).
+//   mesh rock meshes/rock.wvum
+//   # The objects, by mesh name, position and orientation.
+//   object rock 1.0 0.0 -5.0 0.0 0.5 0.0
+//   # Optionally, how the lights are shaded: forward (the default) or
+//   # deferred.
+//   lighting deferred
+//
+// A mesh is declared before the objects using it. Returns true if successful,
+// otherwise the error is copied into error_info_log.
+bool ReadSceneFile(const std::string& filepath,
+                   SceneDescription* scene,
+                   std::string* error_info_log);
+
+// Writes a scene file. The paths of the meshes are written as they are.
+// Returns true if successful.
+bool WriteSceneFile(const SceneDescription& scene,
+                    const std::string& filepath,
+                    std::string* error_info_log);
+
+// Parameters of a StreamedScene.
+struct SceneStreamingOptions {
+  // The distance from the camera within which the meshes of the objects in
+  // the view are loaded.
+  float load_distance = 100.0f;
+  // The distance within which the objects in the view keep their meshes
+  // resident, larger than the load distance so that the meshes at the limit
+  // are not loaded and evicted in turns.
+  float keep_distance = 125.0f;
+  // The number of frames a mesh stays resident after it was last kept.
+  int eviction_delay_frames = 120;
+  // The meshes queued for upload per frame. Their data is copied out of the
+  // mapping on the calling thread.
+  int max_uploads_per_frame = 4;
+  // How the meshes are evicted when they exceed the budget of the
+  // BufferAllocator.
+  MeshResidencyOptions residency;
+};
+
+// Counters of the last StreamedScene::Update().
+struct SceneStreamingStatistics {
+  int num_visible_objects = 0;
+  int num_resident_meshes = 0;
+  int num_pending_uploads = 0;
+  int num_uploads = 0;
+  int num_evictions = 0;
+  // The uploads refused since only the meshes drawn recently could make room
+  // for them in the budget.
+  int num_refused_uploads = 0;
+  // The meshes whose encoded mesh files failed to decode.
+  int num_corrupt_meshes = 0;
+  // The bytes of the vertices and indices of the resident meshes.
+  int64_t resident_bytes = 0;
+};
+
+// This class opens a scene file without loading its meshes: the mesh files
+// are mapped and only their headers are read, which hold the bounds of the
+// meshes, so the objects are placeholders with world-space bounds from the
+// start, indexed in a BoundingVolumeHierarchy. Every frame, the meshes of the
+// objects in the view within the load distance of the camera are queued for
+// upload on a MeshUploader, nearest first, and the meshes no object kept for
+// a while are evicted. The memory of the meshes, on the CPU and on the GPU,
+// thus follows what the camera sees instead of the size of the scene, and the
+// scene opens in the time of reading the headers. The meshes stored in
+// several files are found by the content hashes of their headers, and loaded
+// once. When the meshes exceed the budget of the BufferAllocator, the least
+// recently drawn ones are evicted earlier (see mesh_residency.h), and loaded
+// again once they are in the view.
+//
+// The uploader is shared, so the completed uploads are handed to the scene,
+// which takes its own and leaves the others.
+//
+// Example:
+//
+// wvu::StreamedScene scene;
+// scene.Open("/absolute/path/to/city.scene", wvu::SceneStreamingOptions(),
+//            &error_info_log);
+// while (...) {  // Rendering loop.
+//   mesh_uploader.TakeCompletedMeshes(&completed_uploads);
+//   scene.TakeCompletedMeshes(&completed_uploads);
+//   scene.Update(camera, &mesh_uploader);
+//   for (const int object : scene.visible_objects()) {
+//     const wvu::GpuMesh* mesh = scene.mesh(object);
+//     if (mesh != nullptr) ...  // Queue the draw of the object.
+//   }
+// }
+class StreamedScene {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  StreamedScene();
+  ~StreamedScene() {}
+
+  // Reads the scene file and opens its mesh files. No mesh is loaded. Returns
+  // true if successful.
+  // Parameters:
+  //   filepath  The path of the scene file.
+  //   options  When the meshes are loaded and evicted.
+  //   error_info_log  A pointer to a string that holds the error log.
+  bool Open(const std::string& filepath,
+            const SceneStreamingOptions& options,
+            std::string* error_info_log);
+
+  // Finds the objects in the view of the camera, queues the uploads of their
+  // missing meshes and evicts the meshes not kept for the eviction delay. Must
+  // be called on the render thread.
+  void Update(const Camera& camera, MeshUploader* mesh_uploader);
+
+  // Moves the uploads of the meshes of the scene out of uploads, which keeps
+  // the others in their order. Returns the number of meshes taken.
+  int TakeCompletedMeshes(std::vector<CompletedMeshUpload>* uploads);
+
+  // Deletes the resident meshes. Must be called while the context is current.
+  void Reset();
+
+  // Returns the objects in the view of the camera of the last update.
+  const std::vector<int>& visible_objects() const {
+    return visible_objects_;
+  }
+
+  // Returns the mesh of an object, or nullptr while it is not resident.
+  const GpuMesh* mesh(const int object) const {
+    const Mesh& mesh = meshes_[objects_[object].mesh];
+    return mesh.gpu_mesh.valid() ? &mesh.gpu_mesh : nullptr;
+  }
+
+  const Eigen::Matrix4f& model_matrix(const int object) const {
+    return objects_[object].model_matrix;
+  }
+
+  // Returns the world-space bounds of an object.
+  const Eigen::AlignedBox3f& bounds(const int object) const {
+    return bvh_.bounds(object);
+  }
+
+  int num_objects() const {
+    return objects_.size();
+  }
+
+  // Returns how the scene file shades the lights.
+  SceneLighting lighting() const {
+    return lighting_;
+  }
+
+  // Returns the number of meshes with distinct contents.
+  int num_meshes() const {
+    return meshes_.size();
+  }
+
+  // Returns the number of meshes of the scene file dropped since an earlier
+  // one has the same content.
+  int num_duplicate_meshes() const {
+    return num_duplicate_meshes_;
+  }
+
+  const SceneStreamingStatistics& statistics() const {
+    return statistics_;
+  }
+
+  // Returns the counters of the evictions over the budget since the opening.
+  const MeshResidencyStatistics& residency_statistics() const {
+    return residency_.statistics();
+  }
+
+ private:
+  // The residency of a mesh.
+  enum MeshState {
+    MESH_UNLOADED = 0,
+    MESH_UPLOADING = 1,
+    MESH_RESIDENT = 2,
+    // The encoded blobs of the mesh file are corrupt; never loaded again.
+    MESH_CORRUPT = 3
+  };
+
+  struct Mesh {
+    std::unique_ptr<MeshFile> mesh_file;
+    MeshState state = MESH_UNLOADED;
+    GpuMesh gpu_mesh;
+    // The last frame an object in the view kept the mesh, and the distance
+    // of the nearest of them in the current frame.
+    int64_t kept_frame = -1;
+    float distance = 0.0f;
+  };
+
+  struct Object {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    int mesh;
+    Eigen::Matrix4f model_matrix;
+  };
+
+  SceneStreamingOptions options_;
+  SceneLighting lighting_;
+  std::vector<Mesh> meshes_;
+  int num_duplicate_meshes_;
+  std::vector<Object, Eigen::aligned_allocator<Object> > objects_;
+  BoundingVolumeHierarchy bvh_;
+  // The mesh of every upload in flight, by upload id.
+  std::unordered_map<int, int> uploads_;
+  int64_t frame_;
+  std::vector<int> visible_objects_;
+  // The meshes to load in the current frame.
+  std::vector<int> requested_meshes_;
+  SceneStreamingStatistics statistics_;
+  // Declared after the meshes it evicts, so its eviction callback is removed
+  // before they are destroyed.
+  MeshResidency residency_;
+
+  StreamedScene(const StreamedScene&) = delete;
+  StreamedScene& operator=(const StreamedScene&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SCENE_FILE_H_
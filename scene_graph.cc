@@ -0,0 +1,118 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "scene_graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace wvu {
+
+void SceneGraph::Reserve(const int num_nodes) {
+  local_translations_.reserve(num_nodes);
+  local_rotations_.reserve(num_nodes);
+  local_scales_.reserve(num_nodes);
+  world_matrices_.reserve(num_nodes);
+  parents_.reserve(num_nodes);
+  dirty_.reserve(num_nodes);
+}
+
+int SceneGraph::AddNode(const int parent) {
+  // Parents precede their children, which keeps the array topologically
+  // sorted.
+  if (parent < kNoParentNode || parent >= num_nodes()) return -1;
+  const int node = num_nodes();
+  local_translations_.push_back(Eigen::Vector3f::Zero());
+  local_rotations_.push_back(Eigen::Quaternionf::Identity());
+  local_scales_.push_back(Eigen::Vector3f::Ones());
+  world_matrices_.push_back(Eigen::Matrix4f::Identity());
+  parents_.push_back(parent);
+  dirty_.push_back(0);
+  MarkDirty(node);
+  return node;
+}
+
+void SceneGraph::SetLocalTranslation(const int node,
+                                     const Eigen::Vector3f& translation) {
+  local_translations_[node] = translation;
+  MarkDirty(node);
+}
+
+void SceneGraph::SetLocalRotation(const int node,
+                                  const Eigen::Quaternionf& rotation) {
+  local_rotations_[node] = rotation;
+  MarkDirty(node);
+}
+
+void SceneGraph::SetLocalScale(const int node, const Eigen::Vector3f& scale) {
+  local_scales_[node] = scale;
+  MarkDirty(node);
+}
+
+void SceneGraph::Update() {
+  num_updated_nodes_ = 0;
+  const int num_nodes = this->num_nodes();
+  for (int node = first_dirty_node_; node < num_nodes; ++node) {
+    const int parent = parents_[node];
+    // A parent is visited before its children, so its bit already tells if
+    // its world matrix changed in this pass.
+    if (parent != kNoParentNode && dirty_[parent]) dirty_[node] = 1;
+    if (!dirty_[node]) continue;
+    Eigen::Matrix4f local = Eigen::Matrix4f::Identity();
+    local.block<3, 3>(0, 0) = local_rotations_[node].toRotationMatrix() *
+        local_scales_[node].asDiagonal();
+    local.block<3, 1>(0, 3) = local_translations_[node];
+    if (parent == kNoParentNode) {
+      world_matrices_[node] = local;
+    } else {
+      world_matrices_[node] = world_matrices_[parent] * local;
+    }
+    ++num_updated_nodes_;
+  }
+  // The bits are cleared after the pass, since the children read the bits of
+  // their parents during it.
+  std::fill(dirty_.begin() + std::min(first_dirty_node_, num_nodes),
+            dirty_.end(), 0);
+  first_dirty_node_ = num_nodes;
+}
+
+void SceneGraph::MarkDirty(const int node) {
+  dirty_[node] = 1;
+  first_dirty_node_ = std::min(first_dirty_node_, node);
+}
+
+}  // namespace wvu
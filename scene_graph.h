@@ -0,0 +1,138 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SCENE_GRAPH_H_
+#define GLUTILS_SCENE_GRAPH_H_
+
+#include <cstdint>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+namespace wvu {
+// Parent of the root nodes of a scene graph.
+constexpr int kNoParentNode = -1;
+
+// This class stores a hierarchy of transforms as a flat array of nodes in
+// topological order: a node is always added after its parent, so a single
+// forward pass over the array computes every world matrix from the world
+// matrix of its parent. The node data is stored as a structure of arrays
+// (local translation, rotation and scale, world matrix, parent index and dirty
+// bit), so the pass streams through memory. Changing a local transform marks
+// the node dirty, and Update() only recomputes the dirty nodes and their
+// descendants, starting at the first dirty node.
+//
+// Example:
+//
+// wvu::SceneGraph scene;
+// const int car = scene.AddNode(wvu::kNoParentNode);
+// const int wheel = scene.AddNode(car);
+// scene.SetLocalTranslation(wheel, Eigen::Vector3f(1.0f, 0.0f, 0.5f));
+// while (...) {  // Rendering loop.
+//   scene.SetLocalTranslation(car, car_position);
+//   scene.Update();  // Recomputes the car and its wheels.
+//   item.model = scene.world_matrix(wheel);
+// }
+class SceneGraph {
+ public:
+  SceneGraph() : first_dirty_node_(0), num_updated_nodes_(0) {}
+  ~SceneGraph() {}
+
+  // Reserves the arrays for num_nodes nodes.
+  void Reserve(const int num_nodes);
+
+  // Adds a node with the identity as its local transform. Returns its index,
+  // or -1 if the parent is not a node.
+  // Parameters:
+  //   parent  The index of an existing node, or kNoParentNode.
+  int AddNode(const int parent);
+
+  // Setters of the local transform of a node, relative to its parent.
+  void SetLocalTranslation(const int node, const Eigen::Vector3f& translation);
+  void SetLocalRotation(const int node, const Eigen::Quaternionf& rotation);
+  void SetLocalScale(const int node, const Eigen::Vector3f& scale);
+
+  // Recomputes the world matrices of the dirty nodes and their descendants.
+  void Update();
+
+  // Returns the world matrix of a node as of the last Update().
+  const Eigen::Matrix4f& world_matrix(const int node) const {
+    return world_matrices_[node];
+  }
+
+  const Eigen::Vector3f& local_translation(const int node) const {
+    return local_translations_[node];
+  }
+
+  const Eigen::Quaternionf& local_rotation(const int node) const {
+    return local_rotations_[node];
+  }
+
+  const Eigen::Vector3f& local_scale(const int node) const {
+    return local_scales_[node];
+  }
+
+  int parent(const int node) const {
+    return parents_[node];
+  }
+
+  int num_nodes() const {
+    return parents_.size();
+  }
+
+  // Returns the number of world matrices the last Update() recomputed.
+  int num_updated_nodes() const {
+    return num_updated_nodes_;
+  }
+
+ private:
+  void MarkDirty(const int node);
+
+  std::vector<Eigen::Vector3f> local_translations_;
+  std::vector<Eigen::Quaternionf,
+              Eigen::aligned_allocator<Eigen::Quaternionf> > local_rotations_;
+  std::vector<Eigen::Vector3f> local_scales_;
+  std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >
+      world_matrices_;
+  std::vector<int> parents_;
+  std::vector<uint8_t> dirty_;
+  // Nodes before this one are clean.
+  int first_dirty_node_;
+  int num_updated_nodes_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SCENE_GRAPH_H_
@@ -0,0 +1,548 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "scene_snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "camera.h"
+#include "content_hash.h"
+#include "entity_registry.h"
+#include "job_system.h"
+#include "mapped_file.h"
+
+namespace wvu {
+namespace {
+// The header of a snapshot file, followed by the payload: blocks of a 16-byte
+// header holding their size and their bytes, padded to 16 bytes.
+struct SnapshotHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t payload_size;
+  // The content hash of the payload.
+  uint64_t payload_hash;
+  // The camera: position, orientation as x, y, z, w, and projection.
+  float camera_position[3];
+  float camera_orientation[4];
+  float field_of_view;
+  float aspect_ratio;
+  float near;
+  float far;
+  int32_t num_entities;
+  uint32_t num_archetypes;
+  uint32_t num_slots;
+  uint32_t num_free_slots;
+  uint32_t reserved[3];
+};
+static_assert(sizeof(SnapshotHeader) % 16 == 0,
+              "The payload must start 16-byte aligned.");
+
+// The header of the columns of an archetype.
+struct SnapshotArchetype {
+  uint32_t components;
+  int32_t num_entities;
+};
+
+// The mesh and material components, with hashes instead of the resources.
+struct SnapshotMesh {
+  uint64_t mesh_hash;
+  int32_t first_index;
+  int32_t num_indices;
+};
+
+struct SnapshotMaterial {
+  uint64_t program_hash;
+  uint64_t texture_hash;
+};
+
+constexpr size_t kBlockAlignment = 16;
+
+double MillisecondsSince(const std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Appends the blocks of a payload.
+class SnapshotWriter {
+ public:
+  explicit SnapshotWriter(std::vector<char>* snapshot) : snapshot_(snapshot) {}
+
+  void AppendBlock(const void* data, const size_t num_bytes) {
+    const uint64_t block_header[2] = {num_bytes, 0};
+    Append(block_header, sizeof(block_header));
+    Append(data, num_bytes);
+    snapshot_->resize(
+        (snapshot_->size() + kBlockAlignment - 1) & ~(kBlockAlignment - 1), 0);
+  }
+
+  template <typename ValueType, typename Allocator>
+  void AppendColumn(const std::vector<ValueType, Allocator>& column) {
+    AppendBlock(column.data(), column.size() * sizeof(ValueType));
+  }
+
+  void AppendColumn(const Vector3fArray& column) {
+    AppendColumn(column.x);
+    AppendColumn(column.y);
+    AppendColumn(column.z);
+  }
+
+  void AppendColumn(const Vector4fArray& column) {
+    AppendColumn(column.x);
+    AppendColumn(column.y);
+    AppendColumn(column.z);
+    AppendColumn(column.w);
+  }
+
+ private:
+  void Append(const void* data, const size_t num_bytes) {
+    const char* bytes = static_cast<const char*>(data);
+    snapshot_->insert(snapshot_->end(), bytes, bytes + num_bytes);
+  }
+
+  std::vector<char>* snapshot_;
+};
+
+// Reads the blocks of a payload, checking that they are within it.
+class SnapshotReader {
+ public:
+  SnapshotReader(const char* data, const size_t size)
+      : data_(data), size_(size), offset_(0) {}
+
+  bool ReadBlock(const char** block, uint64_t* num_bytes) {
+    uint64_t block_header[2];
+    if (size_ - offset_ < sizeof(block_header)) return false;
+    std::memcpy(block_header, data_ + offset_, sizeof(block_header));
+    offset_ += sizeof(block_header);
+    if (block_header[0] > size_ - offset_) return false;
+    *block = data_ + offset_;
+    *num_bytes = block_header[0];
+    offset_ += (*num_bytes + kBlockAlignment - 1) & ~(kBlockAlignment - 1);
+    if (offset_ > size_) offset_ = size_;
+    return true;
+  }
+
+  // Reads a column of num_elements elements.
+  template <typename ValueType, typename Allocator>
+  bool ReadColumn(const size_t num_elements,
+                  std::vector<ValueType, Allocator>* column) {
+    const char* block;
+    uint64_t num_bytes;
+    if (!ReadBlock(&block, &num_bytes) ||
+        num_bytes != num_elements * sizeof(ValueType)) {
+      return false;
+    }
+    column->resize(num_elements);
+    if (num_bytes > 0) {
+      std::memcpy(static_cast<void*>(column->data()), block, num_bytes);
+    }
+    return true;
+  }
+
+  bool ReadColumn(const size_t num_elements, Vector3fArray* column) {
+    return ReadColumn(num_elements, &column->x) &&
+        ReadColumn(num_elements, &column->y) &&
+        ReadColumn(num_elements, &column->z);
+  }
+
+  bool ReadColumn(const size_t num_elements, Vector4fArray* column) {
+    return ReadColumn(num_elements, &column->x) &&
+        ReadColumn(num_elements, &column->y) &&
+        ReadColumn(num_elements, &column->z) &&
+        ReadColumn(num_elements, &column->w);
+  }
+
+ private:
+  const char* data_;
+  size_t size_;
+  size_t offset_;
+};
+
+// Writes the snapshot into a temporary file renamed into place, so that a
+// crash during the write leaves the previous snapshot.
+bool WriteSnapshotFile(const std::vector<char>& snapshot,
+                       const std::string& filepath,
+                       std::string* error_info_log) {
+  const std::string temporary_filepath = filepath + ".tmp";
+  std::ofstream out(temporary_filepath, std::ios::binary);
+  if (!out.is_open()) {
+    *error_info_log = "Could not open " + temporary_filepath;
+    return false;
+  }
+  out.write(snapshot.data(), snapshot.size());
+  out.close();
+  if (!out) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + temporary_filepath;
+    return false;
+  }
+  if (std::rename(temporary_filepath.c_str(), filepath.c_str()) != 0) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not rename " + temporary_filepath;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+void SnapshotResources::AddMesh(const uint64_t hash, const GpuMesh* mesh) {
+  mesh_hashes_[mesh] = hash;
+  meshes_[hash] = mesh;
+}
+
+void SnapshotResources::AddProgram(const uint64_t hash,
+                                   ShaderProgram* shader_program) {
+  program_hashes_[shader_program] = hash;
+  programs_[hash] = shader_program;
+}
+
+void SnapshotResources::AddTexture(const uint64_t hash,
+                                   const GLuint texture_id) {
+  texture_hashes_[texture_id] = hash;
+  textures_[hash] = texture_id;
+}
+
+uint64_t SnapshotResources::MeshHash(const GpuMesh* mesh) const {
+  const auto it = mesh_hashes_.find(mesh);
+  return it != mesh_hashes_.end() ? it->second : 0;
+}
+
+uint64_t SnapshotResources::ProgramHash(
+    const ShaderProgram* shader_program) const {
+  const auto it = program_hashes_.find(shader_program);
+  return it != program_hashes_.end() ? it->second : 0;
+}
+
+uint64_t SnapshotResources::TextureHash(const GLuint texture_id) const {
+  const auto it = texture_hashes_.find(texture_id);
+  return it != texture_hashes_.end() ? it->second : 0;
+}
+
+const GpuMesh* SnapshotResources::FindMesh(const uint64_t hash) const {
+  const auto it = meshes_.find(hash);
+  return it != meshes_.end() ? it->second : nullptr;
+}
+
+ShaderProgram* SnapshotResources::FindProgram(const uint64_t hash) const {
+  const auto it = programs_.find(hash);
+  return it != programs_.end() ? it->second : nullptr;
+}
+
+GLuint SnapshotResources::FindTexture(const uint64_t hash) const {
+  const auto it = textures_.find(hash);
+  return it != textures_.end() ? it->second : 0;
+}
+
+SceneSnapshot::SceneSnapshot()
+    : write_succeeded_(true), job_system_(nullptr) {}
+
+SceneSnapshot::~SceneSnapshot() {
+  if (job_system_ != nullptr) job_system_->Wait(write_);
+}
+
+void SceneSnapshot::Write(const EntityRegistry& registry,
+                          const Camera& camera,
+                          const SnapshotResources& resources,
+                          const std::string& filepath,
+                          JobSystem* job_system) {
+  if (job_system_ != nullptr) job_system_->Wait(write_);
+  job_system_ = job_system;
+  const auto start = std::chrono::steady_clock::now();
+  SceneSnapshotStatistics statistics;
+  Capture(registry, camera, resources, &snapshot_, &statistics);
+  statistics.capture_ms = MillisecondsSince(start);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    statistics_ = statistics;
+  }
+  job_system->Run([this, filepath]() {
+    const auto write_start = std::chrono::steady_clock::now();
+    std::string error_info_log;
+    const bool succeeded =
+        WriteSnapshotFile(snapshot_, filepath, &error_info_log);
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_succeeded_ = succeeded;
+    write_error_ = error_info_log;
+    statistics_.write_ms = MillisecondsSince(write_start);
+  }, &write_);
+}
+
+bool SceneSnapshot::Finish(std::string* error_info_log) {
+  if (job_system_ != nullptr) job_system_->Wait(write_);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!write_succeeded_) *error_info_log = write_error_;
+  return write_succeeded_;
+}
+
+SceneSnapshotStatistics SceneSnapshot::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+void SceneSnapshot::Capture(const EntityRegistry& registry,
+                            const Camera& camera,
+                            const SnapshotResources& resources,
+                            std::vector<char>* snapshot,
+                            SceneSnapshotStatistics* statistics) {
+  snapshot->clear();
+  snapshot->resize(sizeof(SnapshotHeader), 0);
+  SnapshotWriter writer(snapshot);
+  writer.AppendColumn(registry.slots_);
+  writer.AppendColumn(registry.free_slots_);
+  std::vector<SnapshotMesh> meshes;
+  std::vector<SnapshotMaterial> materials;
+  for (const EntityArchetype& archetype : registry.archetypes_) {
+    SnapshotArchetype archetype_header;
+    archetype_header.components = archetype.components_;
+    archetype_header.num_entities = archetype.num_entities();
+    writer.AppendBlock(&archetype_header, sizeof(archetype_header));
+    writer.AppendColumn(archetype.entities_);
+    writer.AppendColumn(archetype.orientations_);
+    writer.AppendColumn(archetype.positions_);
+    writer.AppendColumn(archetype.model_matrices_);
+    writer.AppendColumn(archetype.dirty_);
+    writer.AppendColumn(archetype.local_bounds_);
+    writer.AppendColumn(archetype.world_centers_);
+    writer.AppendColumn(archetype.world_half_extents_);
+    // The references to the resources are written as their hashes.
+    meshes.resize(archetype.meshes_.size());
+    for (size_t i = 0; i < meshes.size(); ++i) {
+      const MeshComponent& mesh = archetype.meshes_[i];
+      meshes[i].mesh_hash = resources.MeshHash(mesh.mesh);
+      meshes[i].first_index = mesh.first_index;
+      meshes[i].num_indices = mesh.num_indices;
+      if (mesh.mesh != nullptr && meshes[i].mesh_hash == 0) {
+        ++statistics->num_unresolved_references;
+      }
+    }
+    writer.AppendColumn(meshes);
+    materials.resize(archetype.materials_.size());
+    for (size_t i = 0; i < materials.size(); ++i) {
+      const MaterialComponent& material = archetype.materials_[i];
+      materials[i].program_hash =
+          resources.ProgramHash(material.shader_program);
+      materials[i].texture_hash = resources.TextureHash(material.texture_id);
+      if ((material.shader_program != nullptr &&
+           materials[i].program_hash == 0) ||
+          (material.texture_id != 0 && materials[i].texture_hash == 0)) {
+        ++statistics->num_unresolved_references;
+      }
+    }
+    writer.AppendColumn(materials);
+    writer.AppendColumn(archetype.animations_);
+    writer.AppendColumn(archetype.linear_velocities_);
+    writer.AppendColumn(archetype.angular_velocities_);
+    writer.AppendColumn(archetype.rotations_);
+  }
+
+  SnapshotHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kSceneSnapshotMagic;
+  header.version = kSceneSnapshotVersion;
+  header.payload_size = snapshot->size() - sizeof(header);
+  header.payload_hash = HashContent(snapshot->data() + sizeof(header),
+                                    header.payload_size);
+  const Eigen::Vector3f& position = camera.position();
+  const Eigen::Quaternionf& orientation = camera.orientation();
+  for (int i = 0; i < 3; ++i) header.camera_position[i] = position[i];
+  for (int i = 0; i < 4; ++i) {
+    header.camera_orientation[i] = orientation.coeffs()[i];
+  }
+  header.field_of_view = camera.field_of_view();
+  header.aspect_ratio = camera.aspect_ratio();
+  header.near = camera.near();
+  header.far = camera.far();
+  header.num_entities = registry.num_entities_;
+  header.num_archetypes = registry.archetypes_.size();
+  header.num_slots = registry.slots_.size();
+  header.num_free_slots = registry.free_slots_.size();
+  std::memcpy(snapshot->data(), &header, sizeof(header));
+  statistics->num_bytes = snapshot->size();
+  statistics->num_entities = registry.num_entities_;
+}
+
+bool SceneSnapshot::Read(const std::string& filepath,
+                         const SnapshotResources& resources,
+                         EntityRegistry* registry,
+                         Camera* camera,
+                         SceneSnapshotStatistics* statistics,
+                         std::string* error_info_log) {
+  const auto start = std::chrono::steady_clock::now();
+  MappedFile file;
+  if (!file.Open(filepath)) {
+    *error_info_log = "Could not map " + filepath;
+    return false;
+  }
+  SnapshotHeader header;
+  if (file.size() < sizeof(header)) {
+    *error_info_log = filepath + " is not a scene snapshot.";
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != kSceneSnapshotMagic) {
+    *error_info_log = filepath + " is not a scene snapshot.";
+    return false;
+  }
+  if (header.version != kSceneSnapshotVersion) {
+    *error_info_log = filepath + " has an unsupported version.";
+    return false;
+  }
+  const char* payload = file.data() + sizeof(header);
+  if (header.payload_size != file.size() - sizeof(header) ||
+      HashContent(payload, header.payload_size) != header.payload_hash) {
+    *error_info_log = filepath + " is corrupt.";
+    return false;
+  }
+  SceneSnapshotStatistics read_statistics;
+  EntityRegistry restored;
+  restored.num_entities_ = header.num_entities;
+  restored.archetypes_.reserve(header.num_archetypes);
+  SnapshotReader reader(payload, header.payload_size);
+  bool valid = reader.ReadColumn(header.num_slots, &restored.slots_) &&
+      reader.ReadColumn(header.num_free_slots, &restored.free_slots_);
+  std::vector<SnapshotMesh> meshes;
+  std::vector<SnapshotMaterial> materials;
+  for (uint32_t a = 0; valid && a < header.num_archetypes; ++a) {
+    const char* block;
+    uint64_t num_bytes;
+    SnapshotArchetype archetype_header;
+    if (!reader.ReadBlock(&block, &num_bytes) ||
+        num_bytes != sizeof(archetype_header)) {
+      valid = false;
+      break;
+    }
+    std::memcpy(&archetype_header, block, sizeof(archetype_header));
+    const ComponentMask components = archetype_header.components;
+    const size_t n = std::max(archetype_header.num_entities, 0);
+    restored.archetypes_.emplace_back(components);
+    EntityArchetype& archetype = restored.archetypes_.back();
+    const size_t num_transforms = archetype.Has(TRANSFORM_COMPONENT) ? n : 0;
+    const size_t num_bounds = archetype.Has(BOUNDS_COMPONENT) ? n : 0;
+    const size_t num_rigid_bodies =
+        archetype.Has(RIGID_BODY_COMPONENT) ? n : 0;
+    valid = reader.ReadColumn(n, &archetype.entities_) &&
+        reader.ReadColumn(num_transforms, &archetype.orientations_) &&
+        reader.ReadColumn(num_transforms, &archetype.positions_) &&
+        reader.ReadColumn(num_transforms, &archetype.model_matrices_) &&
+        reader.ReadColumn(num_transforms, &archetype.dirty_) &&
+        reader.ReadColumn(num_bounds, &archetype.local_bounds_) &&
+        reader.ReadColumn(num_bounds, &archetype.world_centers_) &&
+        reader.ReadColumn(num_bounds, &archetype.world_half_extents_) &&
+        reader.ReadColumn(archetype.Has(MESH_COMPONENT) ? n : 0, &meshes) &&
+        reader.ReadColumn(archetype.Has(MATERIAL_COMPONENT) ? n : 0,
+                          &materials) &&
+        reader.ReadColumn(archetype.Has(ANIMATION_COMPONENT) ? n : 0,
+                          &archetype.animations_) &&
+        reader.ReadColumn(num_rigid_bodies, &archetype.linear_velocities_) &&
+        reader.ReadColumn(num_rigid_bodies, &archetype.angular_velocities_) &&
+        reader.ReadColumn(num_rigid_bodies, &archetype.rotations_);
+    if (!valid) break;
+    // The references to the resources are fixed up through their hashes.
+    archetype.meshes_.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i) {
+      MeshComponent& mesh = archetype.meshes_[i];
+      mesh.mesh = resources.FindMesh(meshes[i].mesh_hash);
+      mesh.first_index = meshes[i].first_index;
+      mesh.num_indices = meshes[i].num_indices;
+      if (mesh.mesh == nullptr && meshes[i].mesh_hash != 0) {
+        ++read_statistics.num_unresolved_references;
+      }
+    }
+    archetype.materials_.resize(materials.size());
+    for (size_t i = 0; i < materials.size(); ++i) {
+      MaterialComponent& material = archetype.materials_[i];
+      material.shader_program =
+          resources.FindProgram(materials[i].program_hash);
+      material.texture_id = resources.FindTexture(materials[i].texture_hash);
+      if ((material.shader_program == nullptr &&
+           materials[i].program_hash != 0) ||
+          (material.texture_id == 0 && materials[i].texture_hash != 0)) {
+        ++read_statistics.num_unresolved_references;
+      }
+    }
+    for (const uint8_t dirty : archetype.dirty_) {
+      archetype.transforms_dirty_ |= dirty != 0;
+    }
+    restored.archetype_indices_[components] = a;
+  }
+  // The slots must point at rows of the archetypes holding their entities.
+  for (size_t i = 0; valid && i < restored.slots_.size(); ++i) {
+    const EntityRegistry::Slot& slot = restored.slots_[i];
+    if (slot.archetype < 0) continue;
+    valid = slot.archetype < static_cast<int>(restored.archetypes_.size()) &&
+        slot.row >= 0 &&
+        slot.row < restored.archetypes_[slot.archetype].num_entities() &&
+        EntityRegistry::Index(
+            restored.archetypes_[slot.archetype].entities_[slot.row]) == i;
+  }
+  if (!valid) {
+    *error_info_log = filepath + " is corrupt.";
+    return false;
+  }
+
+  registry->archetypes_.swap(restored.archetypes_);
+  registry->archetype_indices_.swap(restored.archetype_indices_);
+  registry->slots_.swap(restored.slots_);
+  registry->free_slots_.swap(restored.free_slots_);
+  registry->num_entities_ = restored.num_entities_;
+  registry->num_visible_entities_ = 0;
+  camera->SetPosition(Eigen::Vector3f(header.camera_position));
+  camera->SetOrientation(Eigen::Quaternionf(
+      header.camera_orientation[3], header.camera_orientation[0],
+      header.camera_orientation[1], header.camera_orientation[2]));
+  camera->SetPerspective(header.field_of_view, header.aspect_ratio,
+                         header.near, header.far);
+  if (statistics != nullptr) {
+    read_statistics.num_bytes = file.size();
+    read_statistics.num_entities = header.num_entities;
+    read_statistics.read_ms = MillisecondsSince(start);
+    *statistics = read_statistics;
+  }
+  return true;
+}
+
+}  // namespace wvu
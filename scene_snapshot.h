@@ -0,0 +1,211 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SCENE_SNAPSHOT_H_
+#define GLUTILS_SCENE_SNAPSHOT_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+
+#include "camera.h"
+#include "entity_registry.h"
+#include "gpu_mesh.h"
+#include "job_system.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Identifies the snapshot files, and their format.
+constexpr uint32_t kSceneSnapshotMagic = 0x534e5357;  // "WSNS".
+constexpr uint32_t kSceneSnapshotVersion = 1;
+
+// The resources referenced by the components of the entities, by a content
+// hash that does not change between runs (see content_hash.h), e.g., the
+// content hash of the mesh file of a mesh, or the hash of the sources of a
+// program. The snapshots store the hashes instead of the pointers and the
+// OpenGL names, which the next run maps back to its own resources.
+class SnapshotResources {
+ public:
+  SnapshotResources() {}
+  ~SnapshotResources() {}
+
+  void AddMesh(const uint64_t hash, const GpuMesh* mesh);
+  void AddProgram(const uint64_t hash, ShaderProgram* shader_program);
+  void AddTexture(const uint64_t hash, const GLuint texture_id);
+
+  // Return the hash of a resource, or 0 if it was not added.
+  uint64_t MeshHash(const GpuMesh* mesh) const;
+  uint64_t ProgramHash(const ShaderProgram* shader_program) const;
+  uint64_t TextureHash(const GLuint texture_id) const;
+
+  // Return the resource of a hash, or nullptr (or 0) if none was added.
+  const GpuMesh* FindMesh(const uint64_t hash) const;
+  ShaderProgram* FindProgram(const uint64_t hash) const;
+  GLuint FindTexture(const uint64_t hash) const;
+
+ private:
+  std::unordered_map<const GpuMesh*, uint64_t> mesh_hashes_;
+  std::unordered_map<uint64_t, const GpuMesh*> meshes_;
+  std::unordered_map<const ShaderProgram*, uint64_t> program_hashes_;
+  std::unordered_map<uint64_t, ShaderProgram*> programs_;
+  std::unordered_map<GLuint, uint64_t> texture_hashes_;
+  std::unordered_map<uint64_t, GLuint> textures_;
+
+  SnapshotResources(const SnapshotResources&) = delete;
+  SnapshotResources& operator=(const SnapshotResources&) = delete;
+};
+
+// Counters of a SceneSnapshot.
+struct SceneSnapshotStatistics {
+  int64_t num_bytes = 0;
+  int num_entities = 0;
+  // Time spent copying the scene on the calling thread of Write(), and
+  // writing the file on a job.
+  double capture_ms = 0.0;
+  double write_ms = 0.0;
+  // Time spent by Read().
+  double read_ms = 0.0;
+  // References to resources that were not added to the SnapshotResources:
+  // written as 0 by Write(), and read as no mesh, program or texture by
+  // Read().
+  int num_unresolved_references = 0;
+};
+
+// This class saves the runtime state of a scene, i.e., the columns of the
+// archetypes of an EntityRegistry, its entity ids, and a camera, into a binary
+// snapshot file, so that a renderer restarted after a crash restores the scene
+// in milliseconds instead of building it again. The file holds the columns as
+// they are in memory, padded to 16 bytes, after a header with their content
+// hash. Write() copies the columns into a buffer on the calling thread, which
+// is a memcpy per column, and writes the buffer into a temporary file renamed
+// into place on a job, so neither the frame nor the previous snapshot is lost
+// to the write. Read() maps the file, copies the columns back, and fixes up
+// the references to the meshes, the programs and the textures through their
+// hashes. The ids of the entities are kept, so that the ids held by the
+// application remain valid.
+//
+// Example:
+//
+// wvu::SceneSnapshot snapshot;
+// if (wvu::SceneSnapshot::Read("scene.snapshot", resources, &registry,
+//                              &camera, nullptr, &error_info_log)) {
+//   ...  // Restored, skip building the scene.
+// }
+// while (...) {  // Rendering loop.
+//   if (frame % 600 == 0) {
+//     snapshot.Write(registry, camera, resources, "scene.snapshot",
+//                    &job_system);
+//   }
+//   ...  // Render the frame.
+// }
+// snapshot.Finish(&error_info_log);
+class SceneSnapshot {
+ public:
+  SceneSnapshot();
+  // Waits for the write in flight.
+  ~SceneSnapshot();
+
+  // Copies the registry and the camera, and writes them into filepath on a
+  // job of the job system, which must outlive the write. Waits for the write
+  // in flight first. The resources are only used by the call. Must be called
+  // by the thread that created the job system.
+  void Write(const EntityRegistry& registry,
+             const Camera& camera,
+             const SnapshotResources& resources,
+             const std::string& filepath,
+             JobSystem* job_system);
+
+  // Waits for the write in flight. Returns true if the last write succeeded,
+  // otherwise the error is copied into error_info_log.
+  bool Finish(std::string* error_info_log);
+
+  // Replaces the entities of the registry and the camera with those of the
+  // snapshot at filepath. The model matrices and the world bounds are restored
+  // as of the snapshot, and so is the aspect ratio of the camera, which the
+  // caller sets again if the window changed. Returns true if successful, otherwise the error is
+  // copied into error_info_log and the registry and the camera are left
+  // unchanged.
+  // Parameters:
+  //   filepath  The path of the snapshot file.
+  //   resources  The resources of the hashes of the snapshot.
+  //   registry  The registry to restore.
+  //   camera  The camera to restore.
+  //   statistics  The counters of the read. Can be nullptr.
+  //   error_info_log  A pointer to a string that holds the error log.
+  static bool Read(const std::string& filepath,
+                   const SnapshotResources& resources,
+                   EntityRegistry* registry,
+                   Camera* camera,
+                   SceneSnapshotStatistics* statistics,
+                   std::string* error_info_log);
+
+  // Returns the counters of the last write.
+  SceneSnapshotStatistics statistics() const;
+
+ private:
+  // Copies the registry and the camera into a snapshot.
+  static void Capture(const EntityRegistry& registry,
+                      const Camera& camera,
+                      const SnapshotResources& resources,
+                      std::vector<char>* snapshot,
+                      SceneSnapshotStatistics* statistics);
+
+  // Restores the registry from the columns of a snapshot. Returns false if
+  // they are corrupt.
+  static bool Restore(const char* data,
+                      const size_t size,
+                      const SnapshotResources& resources,
+                      EntityRegistry* registry,
+                      SceneSnapshotStatistics* statistics);
+
+  // The snapshot being written, owned by the job.
+  std::vector<char> snapshot_;
+  JobCounter write_;
+  mutable std::mutex mutex_;
+  // The result of the last write, set by the job.
+  bool write_succeeded_;
+  std::string write_error_;
+  SceneSnapshotStatistics statistics_;
+  JobSystem* job_system_;
+
+  SceneSnapshot(const SceneSnapshot&) = delete;
+  SceneSnapshot& operator=(const SceneSnapshot&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SCENE_SNAPSHOT_H_
@@ -0,0 +1,476 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+// Benchmarks ShaderProgram::Create() on generated programs of several sizes,
+// and writes the milliseconds per program as JSON, so that the startup cost of
+// the shaders can be compared on each driver and the caching paths do not
+// regress:
+//   cold  Every program has a source never compiled before, so neither the
+//     driver nor the binary cache know it.
+//   warm  The same source is compiled again after a first build, which the
+//     in-memory or on-disk shader cache of the driver may serve.
+//   binary_cache  The program is loaded from the program binary cache of
+//     ShaderProgram (see SetProgramBinaryCacheDirectory()).
+//   parallel  Batches of --parallel_programs cold programs are submitted with
+//     CreateAsync() and waited for, which the driver may compile on several
+//     threads with KHR/ARB_parallel_shader_compile.
+//
+// The size of a program is the number of lighting functions its fragment
+// shader sums.
+//
+// Example:
+//
+// ./bin/shader_bench --shader_sizes=1,32,256 --output_file=results.json
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "frame_profiler.h"
+#include "shader_program.h"
+
+// Use the right namespace for google flags (gflags).
+#ifdef GFLAGS_NAMESPACE_GOOGLE
+#define CS470_GFLAGS_NAMESPACE google
+#else
+#define CS470_GFLAGS_NAMESPACE gflags
+#endif
+
+DEFINE_int32(num_iterations, 20,
+             "Programs (or batches of the parallel scenario) created per "
+             "scenario and shader size.");
+DEFINE_string(shader_sizes, "1,16,128",
+              "Comma-separated numbers of lighting functions of the generated "
+              "fragment shaders.");
+DEFINE_int32(parallel_programs, 8,
+             "Programs in flight per batch of the parallel scenario.");
+DEFINE_string(scenarios, "cold,warm,binary_cache,parallel",
+              "Comma-separated scenarios to benchmark.");
+DEFINE_string(cache_directory, "",
+              "Directory of the program binary cache. Empty uses a temporary "
+              "directory removed afterwards.");
+DEFINE_string(output_file, "",
+              "JSON file of the results. Empty writes them to stdout.");
+
+// Annonymous namespace for constants and helper functions.
+namespace {
+const std::string vertex_shader_src =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "layout (location = 1) in vec3 normal;\n"
+    "uniform mat4 model;\n"
+    "uniform mat4 view_projection;\n"
+    "out vec3 world_position;\n"
+    "out vec3 world_normal;\n"
+    "void main() {\n"
+    "vec4 world = model * vec4(position, 1.0f);\n"
+    "world_position = world.xyz;\n"
+    "world_normal = mat3(model) * normal;\n"
+    "gl_Position = view_projection * world;\n"
+    "}\n";
+
+// Scenarios of the benchmark.
+enum Scenario {
+  COLD_SCENARIO = 0,
+  WARM_SCENARIO,
+  BINARY_CACHE_SCENARIO,
+  PARALLEL_SCENARIO
+};
+
+const char* ScenarioName(const Scenario scenario) {
+  switch (scenario) {
+    case WARM_SCENARIO:
+      return "warm";
+    case BINARY_CACHE_SCENARIO:
+      return "binary_cache";
+    case PARALLEL_SCENARIO:
+      return "parallel";
+    default:
+      return "cold";
+  }
+}
+
+// Measurements of a scenario on a shader size.
+struct ScenarioResult {
+  Scenario scenario;
+  int num_functions = 0;
+  int source_bytes = 0;
+  bool failed = false;
+  // Milliseconds per program, and per batch in the parallel scenario.
+  wvu::ProfileScopeStatistics create;
+  wvu::ProfileScopeStatistics batch;
+  // Programs of the binary cache scenario loaded from the cache.
+  int num_cache_hits = 0;
+};
+
+// Generates a fragment shader summing num_functions lighting functions. The
+// salt is folded into the output, so that sources with different salts are
+// different programs to the shader cache of the driver.
+std::string FragmentShaderSource(const int num_functions,
+                                 const uint64_t salt) {
+  std::ostringstream source;
+  source << "#version 330 core\n"
+         << "in vec3 world_position;\n"
+         << "in vec3 world_normal;\n"
+         << "out vec4 color;\n"
+         << "const float salt = " << (salt % 1000000) << ".0;\n";
+  for (int i = 0; i < num_functions; ++i) {
+    source << "vec3 Light" << i << "(vec3 n, vec3 p) {\n"
+           << "vec3 l = vec3(" << i % 7 << ".0, " << i % 5 << ".0, "
+           << i % 3 << ".0) - p;\n"
+           << "float attenuation = 1.0 / (1.0 + dot(l, l));\n"
+           << "l = normalize(l);\n"
+           << "vec3 h = normalize(l + vec3(0.0, 0.0, 1.0));\n"
+           << "float specular = pow(max(dot(n, h), 0.0), "
+           << 8 + i % 32 << ".0);\n"
+           << "float diffuse = max(dot(n, l), 0.0);\n"
+           << "return attenuation * (diffuse * vec3(sin(p.x * " << i + 1
+           << ".0), cos(p.y), 0.5) + vec3(specular));\n"
+           << "}\n";
+  }
+  source << "void main() {\n"
+         << "vec3 n = normalize(world_normal);\n"
+         << "vec3 radiance = vec3(salt * 1e-30);\n";
+  for (int i = 0; i < num_functions; ++i) {
+    source << "radiance += Light" << i << "(n, world_position);\n";
+  }
+  source << "color = vec4(radiance, 1.0);\n"
+         << "}\n";
+  return source.str();
+}
+
+// Returns a salt that no run of the benchmark used before, so that the cold
+// programs also miss the on-disk shader caches of the drivers.
+uint64_t NextSalt() {
+  static uint64_t salt = static_cast<uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+  return ++salt;
+}
+
+void LoadProgram(const std::string& fragment_shader,
+                 const std::string& cache_directory,
+                 wvu::ShaderProgram* program) {
+  program->LoadVertexShaderFromString(vertex_shader_src);
+  program->LoadFragmentShaderFromString(fragment_shader);
+  program->SetProgramBinaryCacheDirectory(cache_directory);
+}
+
+double MillisecondsSince(const std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - begin).count();
+}
+
+// Creates the programs of a scenario on a shader size. The statistics of the
+// samples are computed by a FrameProfiler keeping all of them.
+ScenarioResult RunScenario(const Scenario scenario,
+                           const int num_functions,
+                           const std::string& cache_directory) {
+  ScenarioResult result;
+  result.scenario = scenario;
+  result.num_functions = num_functions;
+  const int num_iterations = std::max(FLAGS_num_iterations, 1);
+  const int num_programs = scenario == PARALLEL_SCENARIO ?
+      std::max(FLAGS_parallel_programs, 1) : 1;
+  wvu::FrameProfiler profiler(num_iterations * num_programs);
+  const int create_scope = profiler.AddCpuScope("create");
+  const int batch_scope = profiler.AddCpuScope("batch");
+  std::string error_info_log;
+  // The warm and the binary cache scenarios build their source once before
+  // measuring, which fills the caches.
+  const std::string shared_source =
+      FragmentShaderSource(num_functions, NextSalt());
+  result.source_bytes = vertex_shader_src.size() + shared_source.size();
+  if (scenario == WARM_SCENARIO || scenario == BINARY_CACHE_SCENARIO) {
+    wvu::ShaderProgram program;
+    LoadProgram(shared_source,
+                scenario == BINARY_CACHE_SCENARIO ? cache_directory : "",
+                &program);
+    if (!program.Create(&error_info_log)) {
+      LOG(ERROR) << "Could not build the program: " << error_info_log;
+      result.failed = true;
+      return result;
+    }
+  }
+  for (int i = 0; i < num_iterations && !result.failed; ++i) {
+    // The sources are generated before timing, and the programs are deleted
+    // after it.
+    std::vector<std::unique_ptr<wvu::ShaderProgram> > programs(num_programs);
+    for (std::unique_ptr<wvu::ShaderProgram>& program : programs) {
+      program.reset(new wvu::ShaderProgram);
+      LoadProgram(scenario == WARM_SCENARIO ||
+                  scenario == BINARY_CACHE_SCENARIO ?
+                  shared_source : FragmentShaderSource(num_functions,
+                                                       NextSalt()),
+                  scenario == BINARY_CACHE_SCENARIO ? cache_directory : "",
+                  program.get());
+    }
+    const std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    if (scenario == PARALLEL_SCENARIO) {
+      for (std::unique_ptr<wvu::ShaderProgram>& program : programs) {
+        program->CreateAsync();
+      }
+      // Poll as a loading screen would, until the driver finished all of them.
+      int num_pending = num_programs;
+      while (num_pending > 0) {
+        num_pending = 0;
+        for (std::unique_ptr<wvu::ShaderProgram>& program : programs) {
+          if (!program->IsReady()) ++num_pending;
+        }
+      }
+    }
+    for (std::unique_ptr<wvu::ShaderProgram>& program : programs) {
+      if (!program->Create(&error_info_log)) {
+        LOG(ERROR) << "Could not build the program: " << error_info_log;
+        result.failed = true;
+        break;
+      }
+      if (program->loaded_from_binary_cache()) ++result.num_cache_hits;
+    }
+    const double milliseconds = MillisecondsSince(begin);
+    profiler.AddCpuSample(batch_scope, milliseconds);
+    for (int j = 0; j < num_programs; ++j) {
+      profiler.AddCpuSample(create_scope, milliseconds / num_programs);
+    }
+  }
+  std::vector<wvu::ProfileScopeStatistics> statistics;
+  profiler.GetStatistics(&statistics);
+  result.create = statistics[create_scope];
+  result.batch = statistics[batch_scope];
+  return result;
+}
+
+// Parses the comma-separated names of --scenarios.
+bool ParseScenarios(const std::string& names,
+                    std::vector<Scenario>* scenarios) {
+  std::stringstream stream(names);
+  std::string name;
+  while (std::getline(stream, name, ',')) {
+    if (name == "cold") {
+      scenarios->push_back(COLD_SCENARIO);
+    } else if (name == "warm") {
+      scenarios->push_back(WARM_SCENARIO);
+    } else if (name == "binary_cache") {
+      scenarios->push_back(BINARY_CACHE_SCENARIO);
+    } else if (name == "parallel") {
+      scenarios->push_back(PARALLEL_SCENARIO);
+    } else {
+      LOG(ERROR) << "Unknown scenario " << name;
+      return false;
+    }
+  }
+  return !scenarios->empty();
+}
+
+// Parses the comma-separated numbers of --shader_sizes.
+bool ParseShaderSizes(const std::string& values, std::vector<int>* sizes) {
+  std::stringstream stream(values);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    const int size = std::atoi(value.c_str());
+    if (size <= 0) {
+      LOG(ERROR) << "Invalid shader size " << value;
+      return false;
+    }
+    sizes->push_back(size);
+  }
+  return !sizes->empty();
+}
+
+// Removes a directory and the files in it.
+void RemoveDirectory(const std::string& directory) {
+  DIR* stream = opendir(directory.c_str());
+  if (stream == nullptr) return;
+  while (const dirent* entry = readdir(stream)) {
+    const std::string name = entry->d_name;
+    if (name != "." && name != "..") unlink((directory + "/" + name).c_str());
+  }
+  closedir(stream);
+  rmdir(directory.c_str());
+}
+
+// Returns the string as a JSON string literal.
+std::string JsonString(const char* value) {
+  std::string json = "\"";
+  for (const char* c = value; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') json += '\\';
+    json += *c;
+  }
+  return json + "\"";
+}
+
+void WriteTimes(const wvu::ProfileScopeStatistics& statistics,
+                std::ostringstream* json) {
+  if (statistics.num_samples == 0) {
+    *json << "null";
+    return;
+  }
+  *json << "{\"samples\": " << statistics.num_samples
+        << ", \"min\": " << statistics.min_ms
+        << ", \"average\": " << statistics.average_ms
+        << ", \"p99\": " << statistics.p99_ms
+        << ", \"max\": " << statistics.max_ms << "}";
+}
+
+std::string ToJson(const std::vector<ScenarioResult>& results) {
+  std::ostringstream json;
+  json << "{\n"
+       << "  \"renderer\": " << JsonString(reinterpret_cast<const char*>(
+              glGetString(GL_RENDERER))) << ",\n"
+       << "  \"version\": " << JsonString(reinterpret_cast<const char*>(
+              glGetString(GL_VERSION))) << ",\n"
+       << "  \"parallel_shader_compile\": "
+       << (GLEW_KHR_parallel_shader_compile ||
+           GLEW_ARB_parallel_shader_compile ? "true" : "false") << ",\n"
+       << "  \"program_binaries\": "
+       << (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary ?
+           "true" : "false") << ",\n"
+       << "  \"num_iterations\": " << FLAGS_num_iterations << ",\n"
+       << "  \"parallel_programs\": " << FLAGS_parallel_programs << ",\n"
+       << "  \"scenarios\": [";
+  for (int i = 0; i < static_cast<int>(results.size()); ++i) {
+    const ScenarioResult& result = results[i];
+    json << (i == 0 ? "\n" : ",\n")
+         << "    {\"name\": " << JsonString(ScenarioName(result.scenario))
+         << ", \"num_functions\": " << result.num_functions
+         << ", \"source_bytes\": " << result.source_bytes;
+    if (result.failed) {
+      json << ", \"failed\": true}";
+      continue;
+    }
+    json << ",\n     \"create_ms\": ";
+    WriteTimes(result.create, &json);
+    if (result.scenario == PARALLEL_SCENARIO) {
+      json << ",\n     \"batch_ms\": ";
+      WriteTimes(result.batch, &json);
+    }
+    if (result.scenario == BINARY_CACHE_SCENARIO) {
+      json << ",\n     \"cache_hits\": " << result.num_cache_hits;
+    }
+    json << "}";
+  }
+  json << "\n  ]\n}\n";
+  return json.str();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  CS470_GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  std::vector<Scenario> scenarios;
+  std::vector<int> shader_sizes;
+  if (!ParseScenarios(FLAGS_scenarios, &scenarios) ||
+      !ParseShaderSizes(FLAGS_shader_sizes, &shader_sizes)) {
+    LOG(ERROR) << "Nothing to benchmark.";
+    return -1;
+  }
+  if (!glfwInit()) {
+    return -1;
+  }
+  // Nothing is drawn, so the window is only there to own the context.
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  GLFWwindow* window =
+      glfwCreateWindow(64, 64, "shader_bench", nullptr, nullptr);
+  if (!window) {
+    glfwTerminate();
+    return -1;
+  }
+  glfwMakeContextCurrent(window);
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK) {
+    LOG(ERROR) << "Glew did not initialize properly!";
+    glfwTerminate();
+    return -1;
+  }
+
+  std::string cache_directory = FLAGS_cache_directory;
+  char directory_template[] = "/tmp/shader_bench_XXXXXX";
+  if (cache_directory.empty()) {
+    const char* directory = mkdtemp(directory_template);
+    if (directory == nullptr) {
+      LOG(ERROR) << "Could not create a temporary cache directory.";
+      glfwTerminate();
+      return -1;
+    }
+    cache_directory = directory;
+  }
+  std::vector<ScenarioResult> results;
+  for (const int num_functions : shader_sizes) {
+    for (const Scenario scenario : scenarios) {
+      results.push_back(RunScenario(scenario, num_functions, cache_directory));
+    }
+  }
+  if (FLAGS_cache_directory.empty()) {
+    RemoveDirectory(cache_directory);
+  }
+  int exit_code = 0;
+  for (const ScenarioResult& result : results) {
+    if (result.failed) exit_code = -1;
+  }
+  const std::string json = ToJson(results);
+  if (FLAGS_output_file.empty()) {
+    std::fputs(json.c_str(), stdout);
+  } else {
+    std::ofstream file(FLAGS_output_file);
+    file << json;
+    if (!file) {
+      LOG(ERROR) << "Could not write " << FLAGS_output_file;
+      exit_code = -1;
+    }
+  }
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return exit_code;
+}
@@ -0,0 +1,150 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "shader_library.h"
+
+#include <memory>
+#include <string>
+#include <GL/glew.h>
+
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Buffer size for the error log info.
+constexpr int kNumCharsInfoLog = 512;
+
+// Removes the expired entries of a registry of weak pointers.
+template <typename Registry>
+void RemoveExpiredEntries(Registry* registry) {
+  for (auto it = registry->begin(); it != registry->end();) {
+    if (it->second.expired()) {
+      it = registry->erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// Counts the live entries of a registry of weak pointers.
+template <typename Registry>
+int CountLiveEntries(const Registry& registry) {
+  int num_live_entries = 0;
+  for (const auto& entry : registry) {
+    if (!entry.second.expired()) ++num_live_entries;
+  }
+  return num_live_entries;
+}
+
+}  // namespace
+
+std::shared_ptr<ShaderProgram> ShaderLibrary::GetProgram(
+    const std::string& vertex_shader_source,
+    const std::string& fragment_shader_source,
+    std::string* error_info_log) {
+  const std::shared_ptr<Shader> vertex_shader =
+      GetShader(vertex_shader_source, GL_VERTEX_SHADER, error_info_log);
+  if (!vertex_shader) return nullptr;
+  const std::shared_ptr<Shader> fragment_shader =
+      GetShader(fragment_shader_source, GL_FRAGMENT_SHADER, error_info_log);
+  if (!fragment_shader) return nullptr;
+
+  const std::pair<const Shader*, const Shader*> key(vertex_shader.get(),
+                                                    fragment_shader.get());
+  std::shared_ptr<ProgramEntry> entry = programs_[key].lock();
+  if (!entry) {
+    entry = std::make_shared<ProgramEntry>();
+    entry->program.LoadVertexShaderFromString(vertex_shader_source);
+    entry->program.LoadFragmentShaderFromString(fragment_shader_source);
+    if (!entry->program.CreateFromShaders(vertex_shader->id(),
+                                          fragment_shader->id(),
+                                          error_info_log)) {
+      programs_.erase(key);
+      return nullptr;
+    }
+    entry->vertex_shader = vertex_shader;
+    entry->fragment_shader = fragment_shader;
+    programs_[key] = entry;
+  }
+  // The handle shares the ownership of the entry, so the shaders stay alive
+  // for as long as the program does.
+  return std::shared_ptr<ShaderProgram>(entry, &entry->program);
+}
+
+std::shared_ptr<ShaderLibrary::Shader> ShaderLibrary::GetShader(
+    const std::string& shader_source,
+    const GLenum shader_type,
+    std::string* error_info_log) {
+  std::unordered_map<std::string, std::weak_ptr<Shader> >& shaders =
+      shader_type == GL_VERTEX_SHADER ? vertex_shaders_ : fragment_shaders_;
+  std::shared_ptr<Shader> shader = shaders[shader_source].lock();
+  if (shader) return shader;
+
+  const GLuint shader_id = glCreateShader(shader_type);
+  const char* shader_source_ptr = shader_source.c_str();
+  glShaderSource(shader_id, 1, &shader_source_ptr, nullptr);
+  glCompileShader(shader_id);
+  GLint success = 0;
+  glGetShaderiv(shader_id, GL_COMPILE_STATUS, &success);
+  if (!success) {
+    if (error_info_log) {
+      error_info_log->resize(kNumCharsInfoLog);
+      glGetShaderInfoLog(shader_id, kNumCharsInfoLog, nullptr,
+                         &error_info_log->front());
+    }
+    glDeleteShader(shader_id);
+    shaders.erase(shader_source);
+    return nullptr;
+  }
+  shader = std::make_shared<Shader>(shader_id);
+  shaders[shader_source] = shader;
+  return shader;
+}
+
+void ShaderLibrary::Purge() {
+  RemoveExpiredEntries(&programs_);
+  RemoveExpiredEntries(&vertex_shaders_);
+  RemoveExpiredEntries(&fragment_shaders_);
+}
+
+int ShaderLibrary::num_programs() const {
+  return CountLiveEntries(programs_);
+}
+
+int ShaderLibrary::num_shaders() const {
+  return CountLiveEntries(vertex_shaders_) +
+      CountLiveEntries(fragment_shaders_);
+}
+
+}  // namespace wvu
@@ -0,0 +1,141 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SHADER_LIBRARY_H_
+#define GLUTILS_SHADER_LIBRARY_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <GL/glew.h>
+
+#include "shader_program.h"
+
+namespace wvu {
+// This class keeps a registry of the shader programs created by an
+// application, so that identical shader sources are compiled and linked only
+// once. The library returns shared handles to the linked programs; a program
+// is deleted once the last handle to it goes out of scope. The library also
+// shares the compiled shader objects: programs that reuse the same vertex or
+// fragment source only compile that stage once.
+// The library must be used in the thread that owns the OpenGL context.
+//
+// Example:
+//
+// wvu::ShaderLibrary shader_library;
+// std::string error_info_log;
+// std::shared_ptr<wvu::ShaderProgram> shader_program =
+//     shader_library.GetProgram(vertex_shader_src, fragment_shader_src,
+//                               &error_info_log);
+// if (!shader_program) {
+//   LOG(ERROR) << error_info_log;
+// }
+class ShaderLibrary {
+ public:
+  ShaderLibrary() {}
+  ~ShaderLibrary() {}
+
+  // Returns a shared handle to a linked shader program built from the given
+  // sources. If a program with the same sources is alive, the function returns
+  // a handle to it. Returns nullptr if the compilation or linkage fails, in
+  // which case the error information log is copied into error_info_log.
+  // Parameters:
+  //   vertex_shader_source  The vertex shader source.
+  //   fragment_shader_source  The fragment shader source.
+  //   error_info_log  A pointer to a string that holds the error log.
+  std::shared_ptr<ShaderProgram> GetProgram(
+      const std::string& vertex_shader_source,
+      const std::string& fragment_shader_source,
+      std::string* error_info_log);
+
+  // Removes the registry entries of programs and shaders that are no longer
+  // alive.
+  void Purge();
+
+  // Returns the number of live shader programs in the library.
+  int num_programs() const;
+
+  // Returns the number of live compiled shaders in the library.
+  int num_shaders() const;
+
+ private:
+  // A compiled shader object. The shader is deleted when the last program
+  // using it is deleted.
+  class Shader {
+   public:
+    explicit Shader(const GLuint id) : id_(id) {}
+    ~Shader() { glDeleteShader(id_); }
+    GLuint id() const { return id_; }
+
+   private:
+    const GLuint id_;
+  };
+
+  // A linked program along with the shaders it was built from. Holding the
+  // shaders allows other programs to reuse them while this program is alive.
+  struct ProgramEntry {
+    ShaderProgram program;
+    std::shared_ptr<Shader> vertex_shader;
+    std::shared_ptr<Shader> fragment_shader;
+  };
+
+  // Returns the compiled shader for the given source and type, compiling it if
+  // necessary. Returns nullptr if the compilation fails.
+  std::shared_ptr<Shader> GetShader(const std::string& shader_source,
+                                    const GLenum shader_type,
+                                    std::string* error_info_log);
+
+  // Compiled shaders indexed by their sources. There is one registry per
+  // shader type.
+  std::unordered_map<std::string, std::weak_ptr<Shader> > vertex_shaders_;
+  std::unordered_map<std::string, std::weak_ptr<Shader> > fragment_shaders_;
+
+  // Hashes a pair of shader pointers.
+  struct ShaderPairHash {
+    size_t operator()(const std::pair<const Shader*, const Shader*>& p) const {
+      const std::hash<const Shader*> hasher;
+      return hasher(p.first) * 31 + hasher(p.second);
+    }
+  };
+  // Linked programs indexed by the shaders they were built from. Since the
+  // shaders are deduplicated by source, this deduplicates the source pairs.
+  std::unordered_map<std::pair<const Shader*, const Shader*>,
+                     std::weak_ptr<ProgramEntry>,
+                     ShaderPairHash> programs_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SHADER_LIBRARY_H_
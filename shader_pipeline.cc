@@ -0,0 +1,218 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "shader_pipeline.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "gl_state_cache.h"
+
+namespace wvu {
+namespace {
+
+// Copies the information log of the program into info_log.
+void GetProgramInfoLog(const GLuint program_id, std::string* info_log) {
+  GLint info_log_length = 0;
+  glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &info_log_length);
+  info_log->resize(std::max(info_log_length, 1));
+  glGetProgramInfoLog(program_id, info_log_length, nullptr, &info_log->front());
+}
+
+}  // namespace
+
+bool ShaderStage::Supported() {
+  return GLEW_VERSION_4_1 || GLEW_ARB_separate_shader_objects;
+}
+
+ShaderStage::~ShaderStage() {
+  if (program_id_ != 0) {
+    glDeleteProgram(program_id_);
+  }
+}
+
+bool ShaderStage::Create(const StageType stage_type,
+                         const std::string& source,
+                         std::string* error_info_log) {
+  if (program_id_ != 0) {
+    *error_info_log = "The shader stage is already created.";
+    return false;
+  }
+  if (!Supported()) {
+    *error_info_log = "Separable shader programs are not supported.";
+    return false;
+  }
+  stage_type_ = stage_type;
+  const GLenum shader_type =
+      stage_type == VERTEX ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER;
+  // glCreateShaderProgramv() compiles, links and deletes the shader. The
+  // compilation log is appended to the program log.
+  const GLchar* source_str = source.c_str();
+  const GLuint program_id = glCreateShaderProgramv(shader_type, 1, &source_str);
+  GLint success = program_id != 0 ? GL_TRUE : GL_FALSE;
+  if (program_id != 0) {
+    glGetProgramiv(program_id, GL_LINK_STATUS, &success);
+  }
+  if (!success) {
+    if (program_id != 0) {
+      GetProgramInfoLog(program_id, error_info_log);
+      glDeleteProgram(program_id);
+    } else {
+      *error_info_log = "Could not create the separable program.";
+    }
+    return false;
+  }
+  program_id_ = program_id;
+  IntrospectUniforms();
+  return true;
+}
+
+void ShaderStage::IntrospectUniforms() {
+  uniform_locations_.clear();
+  GLint num_uniforms = 0;
+  glGetProgramiv(program_id_, GL_ACTIVE_UNIFORMS, &num_uniforms);
+  GLint max_name_length = 0;
+  glGetProgramiv(program_id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+  std::string name(std::max(max_name_length, 1), '\0');
+  for (GLint i = 0; i < num_uniforms; ++i) {
+    GLsizei name_length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(program_id_, i, max_name_length, &name_length, &size,
+                       &type, &name.front());
+    const std::string uniform_name = name.substr(0, name_length);
+    const GLint location =
+        glGetUniformLocation(program_id_, uniform_name.c_str());
+    // Members of uniform blocks do not have a location.
+    if (location < 0) continue;
+    uniform_locations_[uniform_name] = location;
+    // Arrays are reported as "name[0]", but are also accessible as "name".
+    const std::string::size_type bracket = uniform_name.rfind("[0]");
+    if (bracket != std::string::npos &&
+        bracket + 3 == uniform_name.size()) {
+      uniform_locations_[uniform_name.substr(0, bracket)] = location;
+    }
+  }
+}
+
+GLint ShaderStage::GetUniformLocation(const std::string& uniform_name) const {
+  const auto it = uniform_locations_.find(uniform_name);
+  if (it == uniform_locations_.end()) {
+    return -1;
+  }
+  return it->second;
+}
+
+bool ShaderStage::SetUniform(const GLint location,
+                             const Eigen::Matrix4f& value) {
+  if (location < 0) return false;
+  glProgramUniformMatrix4fv(program_id_, location, 1, GL_FALSE, value.data());
+  return true;
+}
+
+bool ShaderStage::SetUniform(const GLint location,
+                             const Eigen::Vector3f& value) {
+  if (location < 0) return false;
+  glProgramUniform3fv(program_id_, location, 1, value.data());
+  return true;
+}
+
+bool ShaderStage::SetUniform(const GLint location, const GLfloat value) {
+  if (location < 0) return false;
+  glProgramUniform1f(program_id_, location, value);
+  return true;
+}
+
+bool ShaderStage::SetUniform(const GLint location, const GLint value) {
+  if (location < 0) return false;
+  glProgramUniform1i(program_id_, location, value);
+  return true;
+}
+
+ShaderPipeline::~ShaderPipeline() {
+  if (pipeline_id_ != 0) {
+    glDeleteProgramPipelines(1, &pipeline_id_);
+  }
+}
+
+bool ShaderPipeline::Create(const std::shared_ptr<ShaderStage>& vertex_stage,
+                            const std::shared_ptr<ShaderStage>& fragment_stage,
+                            std::string* error_info_log) {
+  if (!vertex_stage || vertex_stage->program_id() == 0 ||
+      vertex_stage->stage_type() != ShaderStage::VERTEX) {
+    *error_info_log = "Invalid vertex stage.";
+    return false;
+  }
+  if (!fragment_stage || fragment_stage->program_id() == 0 ||
+      fragment_stage->stage_type() != ShaderStage::FRAGMENT) {
+    *error_info_log = "Invalid fragment stage.";
+    return false;
+  }
+  if (pipeline_id_ == 0) {
+    glGenProgramPipelines(1, &pipeline_id_);
+  }
+  glUseProgramStages(pipeline_id_, GL_VERTEX_SHADER_BIT,
+                     vertex_stage->program_id());
+  glUseProgramStages(pipeline_id_, GL_FRAGMENT_SHADER_BIT,
+                     fragment_stage->program_id());
+  // Validation checks that the interfaces of the stages match.
+  glValidateProgramPipeline(pipeline_id_);
+  GLint valid = GL_FALSE;
+  glGetProgramPipelineiv(pipeline_id_, GL_VALIDATE_STATUS, &valid);
+  if (!valid) {
+    GLint info_log_length = 0;
+    glGetProgramPipelineiv(pipeline_id_, GL_INFO_LOG_LENGTH, &info_log_length);
+    error_info_log->resize(std::max(info_log_length, 1));
+    glGetProgramPipelineInfoLog(pipeline_id_, info_log_length, nullptr,
+                                &error_info_log->front());
+    glDeleteProgramPipelines(1, &pipeline_id_);
+    pipeline_id_ = 0;
+    return false;
+  }
+  vertex_stage_ = vertex_stage;
+  fragment_stage_ = fragment_stage;
+  return true;
+}
+
+bool ShaderPipeline::Use() const {
+  if (pipeline_id_ == 0) return false;
+  GlStateCache::Current()->UseProgram(0);
+  glBindProgramPipeline(pipeline_id_);
+  return true;
+}
+
+}  // namespace wvu
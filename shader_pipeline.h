@@ -0,0 +1,174 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SHADER_PIPELINE_H_
+#define GLUTILS_SHADER_PIPELINE_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+namespace wvu {
+// This class compiles a single shader stage into a separable program
+// (ARB_separate_shader_objects). A stage is compiled once and combined with
+// other stages by a ShaderPipeline at bind time, so N vertex and M fragment
+// stages need N + M compilations instead of N x M links. Since the stage is a
+// program object, it owns its uniforms, which are set with glProgramUniform*()
+// and do not require binding the stage.
+class ShaderStage {
+ public:
+  enum StageType { VERTEX, FRAGMENT };
+
+  // Returns true if the context supports separable programs.
+  static bool Supported();
+
+  ShaderStage() : program_id_(0), stage_type_(VERTEX) {}
+  ~ShaderStage();
+
+  // Compiles and links the source as a separable program of the given stage.
+  // Returns true if successful, otherwise the error information log is copied
+  // into error_info_log.
+  // Parameters:
+  //   stage_type  The stage of the shader.
+  //   source  The shader source.
+  //   error_info_log  A pointer to a string that holds the error log.
+  bool Create(const StageType stage_type,
+              const std::string& source,
+              std::string* error_info_log);
+
+  // Returns the id of the separable program object.
+  GLuint program_id() const {
+    return program_id_;
+  }
+
+  // Returns the stage of the shader.
+  StageType stage_type() const {
+    return stage_type_;
+  }
+
+  // Returns the location of the active uniform, or -1 if not found.
+  GLint GetUniformLocation(const std::string& uniform_name) const;
+
+  // Sets the value of a uniform of this stage. Returns false if the location is
+  // invalid.
+  bool SetUniform(const GLint location, const Eigen::Matrix4f& value);
+  bool SetUniform(const GLint location, const Eigen::Vector3f& value);
+  bool SetUniform(const GLint location, const GLfloat value);
+  bool SetUniform(const GLint location, const GLint value);
+
+ private:
+  // Queries the active uniforms of the linked program and caches them.
+  void IntrospectUniforms();
+
+  GLuint program_id_;
+  StageType stage_type_;
+  // Active uniform locations indexed by their names.
+  std::unordered_map<std::string, GLint> uniform_locations_;
+
+  ShaderStage(const ShaderStage&) = delete;
+  ShaderStage& operator=(const ShaderStage&) = delete;
+};
+
+// This class combines separately compiled shader stages into a program
+// pipeline object. Creating a pipeline does not compile or link any shader, so
+// materials sharing a vertex stage only pay for compiling it once. The pipeline
+// keeps shared handles to its stages, so they stay alive while it is in use.
+//
+// Example:
+//
+// std::shared_ptr<wvu::ShaderStage> vertex_stage(new wvu::ShaderStage);
+// std::shared_ptr<wvu::ShaderStage> fragment_stage(new wvu::ShaderStage);
+// std::string error_info_log;
+// if (!vertex_stage->Create(wvu::ShaderStage::VERTEX, vertex_shader_src,
+//                           &error_info_log) ||
+//     !fragment_stage->Create(wvu::ShaderStage::FRAGMENT,
+//                             fragment_shader_src, &error_info_log)) {
+//   LOG(ERROR) << error_info_log;
+// }
+// wvu::ShaderPipeline pipeline;
+// pipeline.Create(vertex_stage, fragment_stage, &error_info_log);
+// while (...) {  // Rendering loop.
+//   pipeline.Use();
+//   ...
+// }
+class ShaderPipeline {
+ public:
+  ShaderPipeline() : pipeline_id_(0) {}
+  ~ShaderPipeline();
+
+  // Creates the program pipeline from a vertex and a fragment stage, and
+  // validates it. Returns true if successful, otherwise the error information
+  // log is copied into error_info_log.
+  // Parameters:
+  //   vertex_stage  A separable vertex stage.
+  //   fragment_stage  A separable fragment stage.
+  //   error_info_log  A pointer to a string that holds the error log.
+  bool Create(const std::shared_ptr<ShaderStage>& vertex_stage,
+              const std::shared_ptr<ShaderStage>& fragment_stage,
+              std::string* error_info_log);
+
+  // Binds the pipeline for rendering. Any program bound with glUseProgram()
+  // takes precedence over a pipeline, so the function unbinds it. Returns false
+  // if the pipeline was not created.
+  bool Use() const;
+
+  // Returns the id of the program pipeline object.
+  GLuint pipeline_id() const {
+    return pipeline_id_;
+  }
+
+  // Returns the vertex stage of the pipeline.
+  const std::shared_ptr<ShaderStage>& vertex_stage() const {
+    return vertex_stage_;
+  }
+
+  // Returns the fragment stage of the pipeline.
+  const std::shared_ptr<ShaderStage>& fragment_stage() const {
+    return fragment_stage_;
+  }
+
+ private:
+  GLuint pipeline_id_;
+  std::shared_ptr<ShaderStage> vertex_stage_;
+  std::shared_ptr<ShaderStage> fragment_stage_;
+
+  ShaderPipeline(const ShaderPipeline&) = delete;
+  ShaderPipeline& operator=(const ShaderPipeline&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SHADER_PIPELINE_H_
@@ -0,0 +1,280 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "shader_preprocessor.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "shader_source.h"
+
+namespace wvu {
+namespace {
+// Maximum depth of nested includes. Deeper nesting is most likely a cycle.
+constexpr int kMaxIncludeDepth = 32;
+
+// Returns the directory of a filepath, including the trailing separator.
+std::string DirectoryOf(const std::string& filepath) {
+  const size_t separator = filepath.find_last_of('/');
+  if (separator == std::string::npos) return "";
+  return filepath.substr(0, separator + 1);
+}
+
+// Returns true if a file can be opened for reading.
+bool FileExists(const std::string& filepath) {
+  std::ifstream in(filepath);
+  return in.is_open();
+}
+
+// Returns true if the text in [begin, end) starts with the keyword followed by
+// a space or the end of the range, and moves begin past it.
+bool ConsumeKeyword(const char* keyword, const char** begin, const char* end) {
+  const size_t keyword_length = std::char_traits<char>::length(keyword);
+  if (static_cast<size_t>(end - *begin) < keyword_length ||
+      !std::equal(keyword, keyword + keyword_length, *begin)) {
+    return false;
+  }
+  const char* after = *begin + keyword_length;
+  if (after != end && *after != ' ' && *after != '\t') return false;
+  *begin = after;
+  return true;
+}
+
+// Returns the #line directive that makes the next line be line_number.
+std::string LineDirective(const int line_number) {
+  return "#line " + std::to_string(line_number) + "\n";
+}
+
+}  // namespace
+
+std::shared_ptr<const ShaderPreprocessor::Snippet>
+ShaderPreprocessor::GetSnippet(const std::string& filepath) {
+  const auto cached_snippet = snippets_.find(filepath);
+  if (cached_snippet != snippets_.end()) return cached_snippet->second;
+
+  std::shared_ptr<MappedFile> mapped_file = std::make_shared<MappedFile>();
+  if (!mapped_file->Open(filepath)) return nullptr;
+  std::shared_ptr<Snippet> snippet = std::make_shared<Snippet>();
+  snippet->mapped_file = mapped_file;
+  // Scan the lines looking for directives.
+  const char* data = mapped_file->data();
+  const size_t size = mapped_file->size();
+  int line_number = 1;
+  for (size_t line_begin = 0; line_begin < size; ++line_number) {
+    const char* line_end_ptr = static_cast<const char*>(
+        std::char_traits<char>::find(data + line_begin, size - line_begin,
+                                     '\n'));
+    const size_t line_end =
+        line_end_ptr == nullptr ? size : line_end_ptr - data + 1;
+    const char* begin = data + line_begin;
+    const char* end = data + line_end;
+    while (begin != end && (*begin == ' ' || *begin == '\t')) ++begin;
+    if (begin != end && *begin == '#') {
+      ++begin;
+      while (begin != end && (*begin == ' ' || *begin == '\t')) ++begin;
+      Directive directive;
+      directive.line_begin = line_begin;
+      directive.line_end = line_end;
+      directive.line_number = line_number;
+      if (ConsumeKeyword("version", &begin, end)) {
+        directive.type = Directive::VERSION;
+        snippet->directives.push_back(directive);
+      } else if (ConsumeKeyword("include", &begin, end)) {
+        // Extract the path between quotes or angle brackets.
+        const char* path_begin = std::find_if(
+            begin, end, [](const char c) { return c == '"' || c == '<'; });
+        if (path_begin != end) {
+          const char closing = *path_begin == '"' ? '"' : '>';
+          const char* path_end = std::find(path_begin + 1, end, closing);
+          if (path_end != end) {
+            directive.type = Directive::INCLUDE;
+            directive.argument.assign(path_begin + 1, path_end);
+            snippet->directives.push_back(directive);
+          }
+        }
+      }
+    }
+    line_begin = line_end;
+  }
+  snippets_[filepath] = snippet;
+  return snippet;
+}
+
+std::string ShaderPreprocessor::ResolveInclude(
+    const std::string& including_filepath,
+    const std::string& included_path) const {
+  if (!included_path.empty() && included_path[0] == '/') {
+    return FileExists(included_path) ? included_path : "";
+  }
+  const std::string relative_path =
+      DirectoryOf(including_filepath) + included_path;
+  if (FileExists(relative_path)) return relative_path;
+  for (const std::string& include_directory : include_directories_) {
+    const std::string filepath = include_directory + "/" + included_path;
+    if (FileExists(filepath)) return filepath;
+  }
+  return "";
+}
+
+std::string ShaderPreprocessor::DefinesText() const {
+  std::string text;
+  for (const auto& define : defines_) {
+    text += "#define " + define.first;
+    if (!define.second.empty()) {
+      text += " " + define.second;
+    }
+    text += "\n";
+  }
+  return text;
+}
+
+bool ShaderPreprocessor::ProcessSnippet(
+    const std::string& filepath,
+    const bool is_top_level,
+    std::vector<std::string>* include_stack,
+    ShaderSource* source,
+    std::vector<std::string>* dependencies,
+    std::string* error_info_log) {
+  if (std::find(include_stack->begin(), include_stack->end(), filepath) !=
+          include_stack->end() ||
+      include_stack->size() > kMaxIncludeDepth) {
+    if (error_info_log) {
+      *error_info_log = "Recursive include of " + filepath;
+    }
+    return false;
+  }
+  const std::shared_ptr<const Snippet> snippet = GetSnippet(filepath);
+  if (!snippet) {
+    if (error_info_log) {
+      *error_info_log = "Could not read " + filepath;
+    }
+    return false;
+  }
+  if (dependencies &&
+      std::find(dependencies->begin(), dependencies->end(), filepath) ==
+          dependencies->end()) {
+    dependencies->push_back(filepath);
+  }
+  include_stack->push_back(filepath);
+
+  const std::shared_ptr<const MappedFile>& mapped_file = snippet->mapped_file;
+  // The definitions go right after the #version directive of the top-level
+  // file, or at its beginning if it does not declare a version.
+  const bool has_version = std::any_of(
+      snippet->directives.begin(), snippet->directives.end(),
+      [](const Directive& directive) {
+        return directive.type == Directive::VERSION;
+      });
+  if (is_top_level && !has_version && !defines_.empty()) {
+    source->Append(DefinesText() + LineDirective(1));
+  }
+  bool defines_injected = !is_top_level || !has_version;
+  size_t position = 0;
+  for (const Directive& directive : snippet->directives) {
+    if (directive.type == Directive::VERSION) {
+      if (!is_top_level) {
+        // Only the top-level file can declare the version. Drop the line but
+        // keep the line numbers.
+        source->Append(mapped_file, position,
+                       directive.line_begin - position);
+        source->Append("\n");
+      } else {
+        // The #version directive must come first, so the definitions are
+        // injected right after it.
+        source->Append(mapped_file, position, directive.line_end - position);
+        if (!defines_injected && !defines_.empty()) {
+          source->Append(DefinesText() +
+                         LineDirective(directive.line_number + 1));
+        }
+      }
+      defines_injected = true;
+      position = directive.line_end;
+      continue;
+    }
+    // Include directive.
+    source->Append(mapped_file, position, directive.line_begin - position);
+    const std::string included_filepath =
+        ResolveInclude(filepath, directive.argument);
+    if (included_filepath.empty()) {
+      if (error_info_log) {
+        *error_info_log = filepath + ":" +
+            std::to_string(directive.line_number) + ": Could not find " +
+            directive.argument;
+      }
+      include_stack->pop_back();
+      return false;
+    }
+    source->Append(LineDirective(1));
+    if (!ProcessSnippet(included_filepath, false, include_stack, source,
+                        dependencies, error_info_log)) {
+      include_stack->pop_back();
+      return false;
+    }
+    // The included file may not end with a new line.
+    source->Append("\n" + LineDirective(directive.line_number + 1));
+    position = directive.line_end;
+  }
+  source->Append(mapped_file, position, mapped_file->size() - position);
+  include_stack->pop_back();
+  return true;
+}
+
+bool ShaderPreprocessor::Process(const std::string& filepath,
+                                 ShaderSource* source,
+                                 std::vector<std::string>* dependencies,
+                                 std::string* error_info_log) {
+  if (source == nullptr) return false;
+  if (dependencies) {
+    dependencies->clear();
+  }
+  ShaderSource processed_source;
+  std::vector<std::string> include_stack;
+  if (!ProcessSnippet(filepath, true, &include_stack, &processed_source,
+                      dependencies, error_info_log)) {
+    return false;
+  }
+  *source = processed_source;
+  return true;
+}
+
+void ShaderPreprocessor::Invalidate(const std::string& filepath) {
+  snippets_.erase(filepath);
+}
+
+}  // namespace wvu
@@ -0,0 +1,171 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SHADER_PREPROCESSOR_H_
+#define GLUTILS_SHADER_PREPROCESSOR_H_
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.h"
+#include "shader_source.h"
+
+namespace wvu {
+// This class assembles shader sources from files that include shared snippets
+// with the directive:
+//
+//   #include "relative/path/to/snippet.glsl"
+//
+// Included paths are resolved relative to the including file first, and then
+// relative to the include directories. The preprocessor also injects #define
+// directives right after the #version directive of the top-level file. The
+// assembled source views the memory-mapped files directly: every range of text
+// between directives becomes a piece of the ShaderSource, which is passed to
+// glShaderSource() as multiple strings. #line directives are inserted after
+// every include so that compilation errors report the lines of the original
+// files.
+// Parsed snippet files are cached until they are invalidated, so shaders
+// sharing snippets only map and parse them once. The preprocessor reports the
+// files every shader depends on, which ShaderWatcher uses for hot reloading.
+//
+// Example:
+//
+// wvu::ShaderPreprocessor preprocessor;
+// preprocessor.AddIncludeDirectory("/path/to/snippets");
+// preprocessor.SetDefine("NUM_LIGHTS", "4");
+// wvu::ShaderProgram shader_program;
+// shader_program.LoadVertexShaderFromFile("/path/to/shader.vert",
+//                                         &preprocessor);
+class ShaderPreprocessor {
+ public:
+  ShaderPreprocessor() {}
+  ~ShaderPreprocessor() {}
+
+  // Adds a directory where included files are searched.
+  void AddIncludeDirectory(const std::string& include_directory) {
+    include_directories_.push_back(include_directory);
+  }
+
+  // Sets a macro definition injected into every processed shader. Changing the
+  // definitions does not invalidate the cached snippets.
+  // Parameters:
+  //   name  The name of the macro.
+  //   value  The value of the macro. It can be empty.
+  void SetDefine(const std::string& name, const std::string& value) {
+    defines_[name] = value;
+  }
+
+  // Removes all the macro definitions.
+  void ClearDefines() {
+    defines_.clear();
+  }
+
+  // Assembles the shader source of the file at filepath, resolving its
+  // includes. Returns true if successful, and false otherwise, in which case
+  // the reason is copied into error_info_log.
+  // Parameters:
+  //   filepath  The path of the top-level shader file.
+  //   source  The assembled source.
+  //   dependencies  The paths of all the files the source depends on,
+  //     including filepath. It can be nullptr.
+  //   error_info_log  A pointer to a string that holds the error log.
+  bool Process(const std::string& filepath,
+               ShaderSource* source,
+               std::vector<std::string>* dependencies,
+               std::string* error_info_log);
+
+  // Drops the cached snippet of a file, so that it is read again the next time
+  // it is needed. Call this function when the file changes.
+  void Invalidate(const std::string& filepath);
+
+  // Drops all the cached snippets.
+  void InvalidateAll() {
+    snippets_.clear();
+  }
+
+ private:
+  // A preprocessor directive found in a snippet.
+  struct Directive {
+    enum Type { VERSION, INCLUDE };
+    Type type;
+    // Offset of the first character of the line holding the directive.
+    size_t line_begin;
+    // Offset of the first character after the line, including the new line.
+    size_t line_end;
+    // Line number of the directive, starting at 1.
+    int line_number;
+    // Included path for include directives.
+    std::string argument;
+  };
+
+  // A parsed file.
+  struct Snippet {
+    std::shared_ptr<const MappedFile> mapped_file;
+    std::vector<Directive> directives;
+  };
+
+  // Returns the cached snippet of a file, parsing it if needed. Returns
+  // nullptr if the file cannot be read.
+  std::shared_ptr<const Snippet> GetSnippet(const std::string& filepath);
+
+  // Appends the source of a snippet and its includes to source.
+  bool ProcessSnippet(const std::string& filepath,
+                      const bool is_top_level,
+                      std::vector<std::string>* include_stack,
+                      ShaderSource* source,
+                      std::vector<std::string>* dependencies,
+                      std::string* error_info_log);
+
+  // Resolves an included path. Returns an empty string if it does not exist.
+  std::string ResolveInclude(const std::string& including_filepath,
+                             const std::string& included_path) const;
+
+  // Returns the #define directives to inject.
+  std::string DefinesText() const;
+
+  // Directories where included files are searched.
+  std::vector<std::string> include_directories_;
+  // Macro definitions sorted by name, so that the injected text is stable.
+  std::map<std::string, std::string> defines_;
+  // Parsed files indexed by their paths.
+  std::unordered_map<std::string, std::shared_ptr<const Snippet> > snippets_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SHADER_PREPROCESSOR_H_
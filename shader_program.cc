@@ -34,48 +34,61 @@
 
 #include "shader_program.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 #include <GL/glew.h>
 
+#include "gl_debug_output.h"
+#include "instance_buffer.h"
+#include "mapped_file.h"
+#include "shader_preprocessor.h"
+#include "shader_source.h"
+
 namespace wvu {
 namespace {
 // Buffer size for the error log info.
 constexpr int kNumCharsInfoLog = 512;
 
-// Enumeration to select the shader types.
-enum ShaderType {
-  VERTEX = 0,
-  FRAGMENT = 1
+// OpenGL shader types indexed by ShaderProgram::ShaderType.
+constexpr GLenum kGlShaderTypes[ShaderProgram::NUM_SHADER_TYPES] = {
+  GL_VERTEX_SHADER,
+  GL_TESS_CONTROL_SHADER,
+  GL_TESS_EVALUATION_SHADER,
+  GL_GEOMETRY_SHADER,
+  GL_FRAGMENT_SHADER,
+  GL_COMPUTE_SHADER
 };
 
-// Compiles a shader that is contained in shader_src C++ string. The shader type
-// determines what shader we should compile. This function retrieves the errors
-// in case of compilation errors and stores it into info_log. This function
-// returns the shader id if successful, otherwise it returns zero.
-GLuint CompileShader(const std::string& shader_src,
-                     const ShaderType shader_type,
-                     std::string* info_log) {
+// Submits the compilation of a shader that is contained in shader_src. The
+// shader type determines what shader we should compile. This function does not
+// wait for the compilation to finish, and returns the id of the shader.
+GLuint SubmitShader(const ShaderSource& shader_src,
+                    const ShaderProgram::ShaderType shader_type) {
   // Create an id for shader using OpenGL glCreateShader().
-  GLuint shader_id = 0;
-  switch (shader_type) {
-    case VERTEX:
-      shader_id = glCreateShader(GL_VERTEX_SHADER);
-      break;
-    case FRAGMENT:
-      shader_id = glCreateShader(GL_FRAGMENT_SHADER);
-      break;
-  }
-  // Retrieving the pointer to the C string wrapped by shader_src.
-  // This is to comply with the signature of glShaderSource() function.
-  const char* shader_src_ptr = shader_src.c_str();
-  // Associates the vertex shader id with the vertex shader source pointed
-  // by vertex_shader_src_ptr.
-  glShaderSource(shader_id, 1, &shader_src_ptr, nullptr);
+  const GLuint shader_id = glCreateShader(kGlShaderTypes[shader_type]);
+  // Associates the shader id with the pieces of the shader source. The pieces
+  // are not NUL-terminated, so their lengths are passed explicitly.
+  glShaderSource(shader_id, shader_src.num_pieces(), shader_src.pieces(),
+                 shader_src.piece_lengths());
   // Compile the shader.
   glCompileShader(shader_id);
+  return shader_id;
+}
+
+// Verifies that the compilation of a shader was successful. Querying the
+// status waits for the compilation to finish. This function retrieves the
+// errors in case of compilation errors and stores it into info_log. Returns
+// true if the compilation was successful, and false otherwise.
+bool CheckShaderCompilation(const GLuint shader_id, std::string* info_log) {
   // Verify if the compilation was successful.
   GLint success = 0;
   // Retrieve if the compilation was successful. The function returns a non-zero
@@ -92,26 +105,94 @@ GLuint CompileShader(const std::string& shader_src,
       glGetShaderInfoLog(shader_id, kNumCharsInfoLog, nullptr,
                          &info_log->front());
     }
-    return 0;
+    return false;
+  }
+  return true;
+}
+
+// The first word of the SPIR-V modules.
+constexpr uint32_t kSpirvMagic = 0x07230203;
+
+// Submits the specialization of a SPIR-V module, which replaces the
+// compilation of a GLSL source: the driver only lowers the module to its own
+// code. The constants listed are set to their values, and the others keep
+// their defaults. The status is checked as the compilation status.
+GLuint SubmitSpirvShader(const MappedFile& spirv,
+                         const std::string& entry_point,
+                         const std::vector<GLuint>& constant_ids,
+                         const std::vector<GLuint>& constant_values,
+                         const ShaderProgram::ShaderType shader_type) {
+  const GLuint shader_id = glCreateShader(kGlShaderTypes[shader_type]);
+  glShaderBinary(1, &shader_id, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB,
+                 spirv.data(), static_cast<GLsizei>(spirv.size()));
+  if (GLEW_VERSION_4_6) {
+    glSpecializeShader(shader_id, entry_point.c_str(), constant_ids.size(),
+                       constant_ids.data(), constant_values.data());
+  } else {
+    glSpecializeShaderARB(shader_id, entry_point.c_str(), constant_ids.size(),
+                          constant_ids.data(), constant_values.data());
   }
   return shader_id;
 }
 
-// Creates a shader program. This function requires the ids of the vertex and
-// fragment shaders which were successfully compiled. The function can return
-// the error info log string in case of a failure. The function returns the
-// shader program id if successfull, and returns zero otherwise.
-GLuint CreateShaderProgram(const GLuint vertex_shader,
-                           const GLuint fragment_shader,
-                           std::string* info_log) {
+// Magic number identifying the program binary cache files.
+constexpr uint32_t kProgramBinaryMagic = 0x42505657;  // "WVPB".
+
+// Returns true if the driver can retrieve and load program binaries.
+bool ProgramBinariesSupported() {
+  if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) {
+    return false;
+  }
+  GLint num_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+  return num_formats > 0;
+}
+
+// Accumulates the bytes of data into a 64-bit FNV-1a hash.
+uint64_t HashBytes(const void* data, const size_t num_bytes, uint64_t hash) {
+  constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < num_bytes; ++i) {
+    hash = (hash ^ bytes[i]) * kFnvPrime;
+  }
+  return hash;
+}
+
+// Accumulates a string, including its terminating character, into a hash.
+uint64_t HashString(const char* str, const uint64_t hash) {
+  if (str == nullptr) return HashBytes("", 1, hash);
+  return HashBytes(str, std::strlen(str) + 1, hash);
+}
+
+// Submits the linkage of a shader program from the given shaders, skipping
+// the zero ids of the stages that are not part of the program. The shaders do
+// not need to be compiled yet, since OpenGL waits for their compilation. This
+// function does not wait for the linkage to finish, and returns the shader
+// program id. When retrievable is true, the driver is hinted that the program
+// binary will be retrieved after linking.
+GLuint SubmitShaderProgram(const GLuint* shaders,
+                           const int num_shaders,
+                           const bool retrievable) {
   // Create a program id.
   const GLuint shader_program = glCreateProgram();
-  // Attach to the program the vertex shader.
-  glAttachShader(shader_program, vertex_shader);
-  // Attach to the program the fragment shader.
-  glAttachShader(shader_program, fragment_shader);
-  // Link the both shaders to get a shader program.
+  if (retrievable) {
+    glProgramParameteri(shader_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
+  }
+  // Attach to the program the shaders of every stage.
+  for (int i = 0; i < num_shaders; ++i) {
+    if (shaders[i] != 0) glAttachShader(shader_program, shaders[i]);
+  }
+  // Link the shaders to get a shader program.
   glLinkProgram(shader_program);
+  return shader_program;
+}
+
+// Verifies that the linkage of a shader program was successful. Querying the
+// status waits for the linkage to finish. The function can return the error
+// info log string in case of a failure. Returns true if the linkage was
+// successful, and false otherwise.
+bool CheckProgramLinkage(const GLuint shader_program, std::string* info_log) {
   // Check if the operation was successful.
   GLint success = 0;
   // Get the status of the linkage procedure. The function returns a non-zero
@@ -125,64 +206,215 @@ GLuint CreateShaderProgram(const GLuint vertex_shader,
       glGetProgramInfoLog(shader_program, kNumCharsInfoLog, nullptr,
                           &info_log->front());
     }
+    return false;
+  }
+  return true;
+}
+
+// Accumulates the pieces of a shader source into a hash. The hash does not
+// depend on how the source is split into pieces.
+uint64_t HashShaderSource(const ShaderSource& source, uint64_t hash) {
+  for (GLsizei i = 0; i < source.num_pieces(); ++i) {
+    hash = HashBytes(source.pieces()[i], source.piece_lengths()[i], hash);
+  }
+  return HashBytes("", 1, hash);
+}
+
+// Creates a shader program. This function requires the ids of shaders which
+// were successfully compiled, or zero for the stages that are not part of the
+// program. The function can return the error info log string in case of a
+// failure. The function returns the shader program id if successfull, and
+// returns zero otherwise.
+GLuint CreateShaderProgram(const GLuint* shaders,
+                           const int num_shaders,
+                           const bool retrievable,
+                           std::string* info_log) {
+  const GLuint shader_program =
+      SubmitShaderProgram(shaders, num_shaders, retrievable);
+  if (!CheckProgramLinkage(shader_program, info_log)) {
+    glDeleteProgram(shader_program);
     return 0;
   }
   return shader_program;
 }
 
-// Releases the resources allocated for compilation of shaders.
-// Clear the shader sources strings.
-void ReleaseShaderResources(const GLuint vertex_shader,
-                            const GLuint fragment_shader) {
-  // Delete shaders and set them to 0.
-  glDeleteShader(vertex_shader);
-  glDeleteShader(fragment_shader);
+// Returns true if the driver can report whether a compilation or linkage
+// finished without waiting for it (KHR/ARB_parallel_shader_compile). The first
+// call also lets the driver use as many compiler threads as it wants.
+bool ParallelShaderCompileSupported() {
+  static const bool supported = []() -> bool {
+    if (GLEW_KHR_parallel_shader_compile) {
+      glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+      return true;
+    }
+    if (GLEW_ARB_parallel_shader_compile) {
+      glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+      return true;
+    }
+    return false;
+  }();
+  return supported;
 }
 
-// Loads a shader source from a file. The function receives the filepath
-// reads it, and returns the content of the file in loaded_file. Returns
-// true if successful, otherwise false.
-bool LoadShaderFromFile(const std::string& filepath,
-                        std::string* loaded_file) {
-  // Create an input file stream.
-  std::ifstream in(filepath);
-  // Verify if it is open and that we have a valid sink C++ string.
-  if (!in.is_open() || !loaded_file) {
+// Releases the resources allocated for compilation of shaders. Deleting the
+// zero id of a missing stage is ignored by OpenGL.
+void ReleaseShaderResources(const GLuint* shaders, const int num_shaders) {
+  for (int i = 0; i < num_shaders; ++i) {
+    glDeleteShader(shaders[i]);
+  }
+}
+
+// Loads a shader source from a file. The function receives the filepath,
+// maps it into memory, and returns a source viewing the mapping in
+// loaded_source. The contents are not copied. When a preprocessor is given,
+// the includes of the file are resolved. The files the source depends on are
+// returned in dependencies. Returns true if successful, otherwise false.
+bool LoadShaderSourceFromFile(const std::string& filepath,
+                              ShaderPreprocessor* preprocessor,
+                              ShaderSource* loaded_source,
+                              std::vector<std::string>* dependencies) {
+  if (!loaded_source) {
+    return false;
+  }
+  if (preprocessor) {
+    return preprocessor->Process(filepath, loaded_source, dependencies,
+                                 nullptr);
+  }
+  std::shared_ptr<MappedFile> mapped_file = std::make_shared<MappedFile>();
+  if (!mapped_file->Open(filepath)) {
     return false;
   }
-  // Create a string buffer to load the entire file in a single call.
-  std::stringstream string_buffer;
-  // Load the file in a single read.
-  string_buffer << in.rdbuf();
-  // Close the file.
-  in.close();
-  // Extract the string from the string buffer.
-  *loaded_file = string_buffer.str();
+  *loaded_source = ShaderSource(mapped_file);
+  dependencies->assign(1, filepath);
   return true;
 }
 
 }  // namespace
 
+bool ShaderProgram::LoadShaderFromString(const ShaderType shader_type,
+                                         const std::string& shader_source) {
+  Stage& stage = stages_[shader_type];
+  stage.source = ShaderSource(shader_source);
+  stage.path.clear();
+  stage.dependencies.clear();
+  return true;
+}
+
+bool ShaderProgram::LoadShaderFromFile(const ShaderType shader_type,
+                                       const std::string& shader_path,
+                                       ShaderPreprocessor* preprocessor) {
+  Stage& stage = stages_[shader_type];
+  if (!LoadShaderSourceFromFile(shader_path, preprocessor, &stage.source,
+                                &stage.dependencies)) {
+    return false;
+  }
+  stage.path = shader_path;
+  preprocessor_ = preprocessor;
+  return true;
+}
+
+bool ShaderProgram::LoadShaderFromSpirvFile(const ShaderType shader_type,
+                                            const std::string& spirv_path,
+                                            const std::string& entry_point) {
+  std::shared_ptr<MappedFile> spirv = std::make_shared<MappedFile>();
+  if (!spirv->Open(spirv_path) || spirv->size() < sizeof(kSpirvMagic) ||
+      spirv->size() % sizeof(uint32_t) != 0) {
+    return false;
+  }
+  uint32_t magic;
+  std::memcpy(&magic, spirv->data(), sizeof(magic));
+  if (magic != kSpirvMagic) {
+    return false;
+  }
+  Stage& stage = stages_[shader_type];
+  stage.spirv = spirv;
+  stage.entry_point = entry_point;
+  stage.constant_ids.clear();
+  stage.constant_values.clear();
+  return true;
+}
+
+void ShaderProgram::SetSpecializationConstant(const ShaderType shader_type,
+                                              const GLuint constant_id,
+                                              const GLuint value) {
+  Stage& stage = stages_[shader_type];
+  for (size_t i = 0; i < stage.constant_ids.size(); ++i) {
+    if (stage.constant_ids[i] == constant_id) {
+      stage.constant_values[i] = value;
+      return;
+    }
+  }
+  stage.constant_ids.push_back(constant_id);
+  stage.constant_values.push_back(value);
+}
+
+bool ShaderProgram::SpirvSupported() {
+  return GLEW_VERSION_4_6 || GLEW_ARB_gl_spirv;
+}
+
 bool ShaderProgram::LoadVertexShaderFromString(
     const std::string& vertex_shader_source) {
-  vertex_shader_src_ = vertex_shader_source;
-  return true;
+  return LoadShaderFromString(VERTEX, vertex_shader_source);
 }
 
 bool ShaderProgram::LoadFragmentShaderFromString(
     const std::string& fragment_shader_source) {
-  fragment_shader_src_ = fragment_shader_source;
-  return true;
+  return LoadShaderFromString(FRAGMENT, fragment_shader_source);
+}
+
+bool ShaderProgram::LoadComputeShaderFromString(
+    const std::string& compute_shader_source) {
+  return LoadShaderFromString(COMPUTE, compute_shader_source);
+}
+
+bool ShaderProgram::LoadComputeShaderFromFile(
+    const std::string& compute_shader_path) {
+  return LoadShaderFromFile(COMPUTE, compute_shader_path, nullptr);
 }
 
 bool ShaderProgram::LoadVertexShaderFromFile(
     const std::string& vertex_shader_path) {
-  return LoadShaderFromFile(vertex_shader_path, &vertex_shader_src_);
+  return LoadShaderFromFile(VERTEX, vertex_shader_path, nullptr);
 }
 
 bool ShaderProgram::LoadFragmentShaderFromFile(
     const std::string& fragment_shader_path) {
-  return LoadShaderFromFile(fragment_shader_path, &fragment_shader_src_);
+  return LoadShaderFromFile(FRAGMENT, fragment_shader_path, nullptr);
+}
+
+bool ShaderProgram::LoadVertexShaderFromFile(
+    const std::string& vertex_shader_path,
+    ShaderPreprocessor* preprocessor) {
+  return LoadShaderFromFile(VERTEX, vertex_shader_path, preprocessor);
+}
+
+bool ShaderProgram::LoadFragmentShaderFromFile(
+    const std::string& fragment_shader_path,
+    ShaderPreprocessor* preprocessor) {
+  return LoadShaderFromFile(FRAGMENT, fragment_shader_path, preprocessor);
+}
+
+std::vector<std::string> ShaderProgram::source_dependencies() const {
+  std::vector<std::string> dependencies;
+  for (const Stage& stage : stages_) {
+    for (const std::string& dependency : stage.dependencies) {
+      if (std::find(dependencies.begin(), dependencies.end(), dependency) ==
+          dependencies.end()) {
+        dependencies.push_back(dependency);
+      }
+    }
+  }
+  return dependencies;
+}
+
+bool ShaderProgram::loaded_from_files() const {
+  bool has_stages = false;
+  for (int i = 0; i < NUM_SHADER_TYPES; ++i) {
+    if (!has_shader(static_cast<ShaderType>(i))) continue;
+    if (stages_[i].path.empty() && stages_[i].spirv == nullptr) return false;
+    has_stages = true;
+  }
+  return has_stages;
 }
 
 bool ShaderProgram::Create(std::string* error_info_log) {
@@ -190,14 +422,35 @@ bool ShaderProgram::Create(std::string* error_info_log) {
   // method will report true. No need to build again. If different shader
   // sources are used, then a different instance should be called.
   if (created_) return true;
+  // Finish the build that CreateAsync() started.
+  if (build_pending_) {
+    return FinishAsyncBuild(error_info_log);
+  }
+  // Report the failure of a build that IsReady() finished.
+  if (async_build_failed_) {
+    async_build_failed_ = false;
+    if (error_info_log) {
+      *error_info_log = async_info_log_;
+    }
+    return false;
+  }
+  // Try to skip the compilation and linkage by loading a cached binary.
+  const std::string cache_filepath = ProgramBinaryCacheFilepath();
+  if (!cache_filepath.empty() && LoadProgramBinary(cache_filepath)) {
+    IntrospectUniforms();
+    LabelProgram();
+    loaded_from_binary_cache_ = true;
+    created_ = true;
+    return true;
+  }
   std::string info_log;
-  if (!BuildVertexShader(&info_log)) {
+  if (!ValidateStages(&info_log)) {
     if (error_info_log) {
       *error_info_log = info_log;
     }
     return false;
   }
-  if (!BuildFragmentShader(&info_log)) {
+  if (!BuildShaders(&info_log)) {
     if (error_info_log) {
       *error_info_log = info_log;
     }
@@ -209,26 +462,503 @@ bool ShaderProgram::Create(std::string* error_info_log) {
     }
     return false;
   }
+  if (!cache_filepath.empty()) {
+    StoreProgramBinary(cache_filepath);
+  }
+  IntrospectUniforms();
+  LabelProgram();
+  created_ = true;
+  return true;
+}
+
+bool ShaderProgram::CreateFromShaders(const GLuint vertex_shader,
+                                      const GLuint fragment_shader,
+                                      std::string* error_info_log) {
+  if (created_) return true;
+  const GLuint shaders[] = {vertex_shader, fragment_shader};
+  shader_program_id_ = CreateShaderProgram(shaders, 2, false, error_info_log);
+  if (shader_program_id_ == 0) {
+    return false;
+  }
+  // Detach the shaders so that deleting them releases their memory even if
+  // this program is still alive.
+  glDetachShader(shader_program_id_, vertex_shader);
+  glDetachShader(shader_program_id_, fragment_shader);
+  IntrospectUniforms();
+  LabelProgram();
+  created_ = true;
+  return true;
+}
+
+bool ShaderProgram::CreateAsync() {
+  if (created_ || build_pending_) return true;
+  async_build_failed_ = false;
+  if (!ValidateStages(&async_info_log_)) {
+    async_build_failed_ = true;
+    return false;
+  }
+  const std::string cache_filepath = ProgramBinaryCacheFilepath();
+  if (!cache_filepath.empty() && LoadProgramBinary(cache_filepath)) {
+    IntrospectUniforms();
+    LabelProgram();
+    loaded_from_binary_cache_ = true;
+    created_ = true;
+    return true;
+  }
+  // Query the support before submitting, so that the driver uses its compiler
+  // threads for this program.
+  ParallelShaderCompileSupported();
+  // Submit all the work without querying any status, which would wait for the
+  // driver to finish.
+  GLuint shaders[NUM_SHADER_TYPES];
+  for (int i = 0; i < NUM_SHADER_TYPES; ++i) {
+    Stage& stage = stages_[i];
+    stage.shader = has_shader(static_cast<ShaderType>(i)) ?
+        SubmitStage(static_cast<ShaderType>(i)) : 0;
+    shaders[i] = stage.shader;
+  }
+  shader_program_id_ = SubmitShaderProgram(shaders, NUM_SHADER_TYPES,
+                                           !cache_filepath.empty());
+  build_pending_ = true;
+  return true;
+}
+
+bool ShaderProgram::IsReady() {
+  if (!build_pending_) return true;
+  if (ParallelShaderCompileSupported()) {
+    GLint completed = GL_FALSE;
+    glGetProgramiv(shader_program_id_, GL_COMPLETION_STATUS_KHR, &completed);
+    if (!completed) return false;
+  }
+  // Without the extension, there is no way to know whether the driver finished
+  // without waiting for it.
+  async_build_failed_ = !FinishAsyncBuild(&async_info_log_);
+  return true;
+}
+
+bool ShaderProgram::FinishAsyncBuild(std::string* error_info_log) {
+  build_pending_ = false;
+  std::string info_log;
+  GLuint shaders[NUM_SHADER_TYPES];
+  bool success = true;
+  for (int i = 0; i < NUM_SHADER_TYPES; ++i) {
+    shaders[i] = stages_[i].shader;
+    stages_[i].shader = 0;
+    if (success && shaders[i] != 0) {
+      success = CheckShaderCompilation(shaders[i], &info_log);
+    }
+  }
+  success = success && CheckProgramLinkage(shader_program_id_, &info_log);
+  ReleaseShaderResources(shaders, NUM_SHADER_TYPES);
+  if (!success) {
+    glDeleteProgram(shader_program_id_);
+    shader_program_id_ = 0;
+    if (error_info_log) {
+      *error_info_log = info_log;
+    }
+    return false;
+  }
+  const std::string cache_filepath = ProgramBinaryCacheFilepath();
+  if (!cache_filepath.empty()) {
+    StoreProgramBinary(cache_filepath);
+  }
+  IntrospectUniforms();
+  LabelProgram();
   created_ = true;
   return true;
 }
 
-bool ShaderProgram::BuildVertexShader(std::string* info_log) {
-  vertex_shader_ = CompileShader(vertex_shader_src_, VERTEX, info_log);
-  return vertex_shader_ != 0;
+GLint ShaderProgram::GetUniformLocation(const std::string& uniform_name) const {
+  const auto it = uniforms_.find(uniform_name);
+  if (it == uniforms_.end()) {
+    return -1;
+  }
+  return it->second.location;
 }
 
-bool ShaderProgram::BuildFragmentShader(std::string* info_log) {
-  fragment_shader_ = CompileShader(fragment_shader_src_, FRAGMENT, info_log);
-  return fragment_shader_ != 0;
+bool ShaderProgram::ValidateStages(std::string* info_log) const {
+  const char* error = nullptr;
+  if (has_shader(COMPUTE)) {
+    for (int i = 0; i < NUM_SHADER_TYPES; ++i) {
+      if (i != COMPUTE && has_shader(static_cast<ShaderType>(i))) {
+        error = "A compute shader cannot be combined with other stages.";
+      }
+    }
+  } else if (!has_shader(VERTEX)) {
+    error = "The program does not have a vertex or compute shader.";
+  } else if (has_shader(TESS_CONTROL) && !has_shader(TESS_EVALUATION)) {
+    error = "A tessellation control shader requires an evaluation shader.";
+  }
+  // OpenGL does not link SPIR-V modules with GLSL shaders.
+  int num_spirv_stages = 0;
+  int num_stages = 0;
+  for (int i = 0; i < NUM_SHADER_TYPES; ++i) {
+    const ShaderType shader_type = static_cast<ShaderType>(i);
+    if (!has_shader(shader_type)) continue;
+    ++num_stages;
+    if (uses_spirv(shader_type)) ++num_spirv_stages;
+  }
+  if (error == nullptr && num_spirv_stages > 0) {
+    if (!SpirvSupported()) {
+      error = "SPIR-V shaders need OpenGL 4.6 or ARB_gl_spirv.";
+    } else if (num_spirv_stages < num_stages) {
+      error = "SPIR-V modules cannot be linked with GLSL shaders.";
+    }
+  }
+  if (error != nullptr) {
+    if (info_log) {
+      *info_log = error;
+    }
+    return false;
+  }
+  return true;
+}
+
+GLuint ShaderProgram::SubmitStage(const ShaderType shader_type) const {
+  const Stage& stage = stages_[shader_type];
+  if (uses_spirv(shader_type)) {
+    return SubmitSpirvShader(*stage.spirv, stage.entry_point,
+                             stage.constant_ids, stage.constant_values,
+                             shader_type);
+  }
+  return SubmitShader(stage.source, shader_type);
+}
+
+bool ShaderProgram::BuildShaders(std::string* info_log) {
+  for (int i = 0; i < NUM_SHADER_TYPES; ++i) {
+    Stage& stage = stages_[i];
+    if (!has_shader(static_cast<ShaderType>(i))) continue;
+    stage.shader = SubmitStage(static_cast<ShaderType>(i));
+    if (!CheckShaderCompilation(stage.shader, info_log)) {
+      glDeleteShader(stage.shader);
+      stage.shader = 0;
+      // Release the stages compiled so far.
+      for (Stage& compiled_stage : stages_) {
+        glDeleteShader(compiled_stage.shader);
+        compiled_stage.shader = 0;
+      }
+      return false;
+    }
+  }
+  return true;
 }
 
 bool ShaderProgram::LinkProgram(std::string* info_log) {
-  shader_program_id_ = CreateShaderProgram(vertex_shader_,
-                                           fragment_shader_,
+  GLuint shaders[NUM_SHADER_TYPES];
+  for (int i = 0; i < NUM_SHADER_TYPES; ++i) {
+    shaders[i] = stages_[i].shader;
+    stages_[i].shader = 0;
+  }
+  shader_program_id_ = CreateShaderProgram(shaders,
+                                           NUM_SHADER_TYPES,
+                                           !binary_cache_directory_.empty(),
                                            info_log);
-  ReleaseShaderResources(vertex_shader_, fragment_shader_);
+  ReleaseShaderResources(shaders, NUM_SHADER_TYPES);
   return shader_program_id_ != 0;
 }
 
+std::string ShaderProgram::ProgramBinaryCacheFilepath() const {
+  if (binary_cache_directory_.empty() || !ProgramBinariesSupported()) {
+    return "";
+  }
+  // The key covers the sources and the driver, since binaries are only valid
+  // for the driver that produced them.
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const Stage& stage : stages_) {
+    hash = HashShaderSource(stage.source, hash);
+    if (stage.spirv != nullptr) {
+      hash = HashBytes(stage.spirv->data(), stage.spirv->size(), hash);
+      hash = HashString(stage.entry_point.c_str(), hash);
+      hash = HashBytes(stage.constant_ids.data(),
+                       stage.constant_ids.size() * sizeof(GLuint), hash);
+      hash = HashBytes(stage.constant_values.data(),
+                       stage.constant_values.size() * sizeof(GLuint), hash);
+    }
+  }
+  hash = HashString(reinterpret_cast<const char*>(glGetString(GL_VENDOR)),
+                    hash);
+  hash = HashString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+                    hash);
+  hash = HashString(reinterpret_cast<const char*>(glGetString(GL_VERSION)),
+                    hash);
+  char filename[32];
+  std::snprintf(filename, sizeof(filename), "%016llx.bin",
+                static_cast<unsigned long long>(hash));
+  return binary_cache_directory_ + "/" + filename;
+}
+
+bool ShaderProgram::LoadProgramBinary(const std::string& cache_filepath) {
+  std::ifstream in(cache_filepath, std::ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+  uint32_t magic = 0;
+  GLenum binary_format = 0;
+  in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  in.read(reinterpret_cast<char*>(&binary_format), sizeof(binary_format));
+  if (!in || magic != kProgramBinaryMagic) {
+    return false;
+  }
+  const std::vector<char> binary((std::istreambuf_iterator<char>(in)),
+                                 std::istreambuf_iterator<char>());
+  if (binary.empty()) {
+    return false;
+  }
+  const GLuint program = glCreateProgram();
+  glProgramBinary(program, binary_format, binary.data(),
+                  static_cast<GLsizei>(binary.size()));
+  // The driver rejects binaries produced by a different driver version, in
+  // which case the program is built from source.
+  GLint success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    glDeleteProgram(program);
+    return false;
+  }
+  shader_program_id_ = program;
+  return true;
+}
+
+bool ShaderProgram::StoreProgramBinary(const std::string& cache_filepath) const {
+  GLint binary_length = 0;
+  glGetProgramiv(shader_program_id_, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+  if (binary_length <= 0) {
+    return false;
+  }
+  std::vector<char> binary(binary_length);
+  GLenum binary_format = 0;
+  glGetProgramBinary(shader_program_id_, binary_length, nullptr,
+                     &binary_format, binary.data());
+  // Write into a temporary file first, so that concurrent processes never read
+  // a partially written binary.
+  const std::string temporary_filepath = cache_filepath + ".tmp";
+  std::ofstream out(temporary_filepath, std::ios::binary);
+  if (!out.is_open()) {
+    return false;
+  }
+  const uint32_t magic = kProgramBinaryMagic;
+  out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+  out.write(reinterpret_cast<const char*>(&binary_format),
+            sizeof(binary_format));
+  out.write(binary.data(), binary.size());
+  out.close();
+  if (!out) {
+    std::remove(temporary_filepath.c_str());
+    return false;
+  }
+  return std::rename(temporary_filepath.c_str(), cache_filepath.c_str()) == 0;
+}
+
+void ShaderProgram::LabelProgram() const {
+  std::string label;
+  for (const Stage& stage : stages_) {
+    if (stage.path.empty()) continue;
+    if (!label.empty()) label += " ";
+    label += stage.path.substr(stage.path.find_last_of('/') + 1);
+  }
+  SetObjectLabel(GL_PROGRAM, shader_program_id_,
+                 label.empty() ? "program" : label);
+}
+
+void ShaderProgram::IntrospectUniforms() {
+  uniforms_.clear();
+  uniform_shadows_.clear();
+  GLint num_uniforms = 0;
+  glGetProgramiv(shader_program_id_, GL_ACTIVE_UNIFORMS, &num_uniforms);
+  GLint max_name_length = 0;
+  glGetProgramiv(shader_program_id_, GL_ACTIVE_UNIFORM_MAX_LENGTH,
+                 &max_name_length);
+  std::string name(std::max(max_name_length, 1), '\0');
+  for (GLint i = 0; i < num_uniforms; ++i) {
+    GLsizei name_length = 0;
+    UniformInfo info;
+    glGetActiveUniform(shader_program_id_, i, max_name_length, &name_length,
+                       &info.size, &info.type, &name.front());
+    const std::string uniform_name = name.substr(0, name_length);
+    // Uniforms inside uniform blocks do not have a location.
+    info.location = glGetUniformLocation(shader_program_id_,
+                                         uniform_name.c_str());
+    if (info.location < 0) continue;
+    uniforms_[uniform_name] = info;
+    // OpenGL reports arrays as "name[0]". Register the base name as well.
+    const std::string kArraySuffix = "[0]";
+    if (uniform_name.size() > kArraySuffix.size() &&
+        uniform_name.compare(uniform_name.size() - kArraySuffix.size(),
+                             kArraySuffix.size(), kArraySuffix) == 0) {
+      uniforms_[uniform_name.substr(
+          0, uniform_name.size() - kArraySuffix.size())] = info;
+    }
+    // Shadow copies are only kept for the first element of arrays.
+    if (info.location >= static_cast<GLint>(uniform_shadows_.size())) {
+      uniform_shadows_.resize(info.location + 1);
+    }
+    uniform_shadows_[info.location].active = true;
+  }
+
+  uniform_blocks_.clear();
+  GLint num_uniform_blocks = 0;
+  glGetProgramiv(shader_program_id_, GL_ACTIVE_UNIFORM_BLOCKS,
+                 &num_uniform_blocks);
+  GLint max_block_name_length = 0;
+  glGetProgramiv(shader_program_id_, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH,
+                 &max_block_name_length);
+  std::string block_name(std::max(max_block_name_length, 1), '\0');
+  for (GLint i = 0; i < num_uniform_blocks; ++i) {
+    GLsizei name_length = 0;
+    glGetActiveUniformBlockName(shader_program_id_, i, max_block_name_length,
+                                &name_length, &block_name.front());
+    uniform_blocks_[block_name.substr(0, name_length)] = i;
+  }
+
+  work_group_size_[0] = work_group_size_[1] = work_group_size_[2] = 0;
+  if (is_compute()) {
+    glGetProgramiv(shader_program_id_, GL_COMPUTE_WORK_GROUP_SIZE,
+                   work_group_size_);
+  }
+
+  reads_instance_transforms_ = false;
+  if (is_compute()) return;
+  GLint num_attributes = 0;
+  glGetProgramiv(shader_program_id_, GL_ACTIVE_ATTRIBUTES, &num_attributes);
+  GLint max_attribute_name_length = 0;
+  glGetProgramiv(shader_program_id_, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH,
+                 &max_attribute_name_length);
+  std::string attribute_name(std::max(max_attribute_name_length, 1), '\0');
+  for (GLint i = 0; i < num_attributes; ++i) {
+    GLsizei name_length = 0;
+    GLint size = 0;
+    GLenum type = GL_NONE;
+    glGetActiveAttrib(shader_program_id_, i, max_attribute_name_length,
+                      &name_length, &size, &type, &attribute_name.front());
+    if (type != GL_FLOAT_MAT4) continue;
+    const GLint location = glGetAttribLocation(
+        shader_program_id_, attribute_name.substr(0, name_length).c_str());
+    if (location == static_cast<GLint>(kInstanceTransformLocation)) {
+      reads_instance_transforms_ = true;
+    }
+  }
+}
+
+GLuint ShaderProgram::GetUniformBlockIndex(
+    const std::string& block_name) const {
+  const auto it = uniform_blocks_.find(block_name);
+  if (it == uniform_blocks_.end()) {
+    return GL_INVALID_INDEX;
+  }
+  return it->second;
+}
+
+bool ShaderProgram::BindUniformBlock(const std::string& block_name,
+                                     const GLuint binding_point) {
+  const GLuint block_index = GetUniformBlockIndex(block_name);
+  if (block_index == GL_INVALID_INDEX) {
+    return false;
+  }
+  glUniformBlockBinding(shader_program_id_, block_index, binding_point);
+  return true;
+}
+
+bool ShaderProgram::BindShaderStorageBlock(const std::string& block_name,
+                                           const GLuint binding_point) {
+  if (shader_program_id_ == 0) return false;
+  const GLuint block_index = glGetProgramResourceIndex(
+      shader_program_id_, GL_SHADER_STORAGE_BLOCK, block_name.c_str());
+  if (block_index == GL_INVALID_INDEX) {
+    return false;
+  }
+  glShaderStorageBlockBinding(shader_program_id_, block_index, binding_point);
+  return true;
+}
+
+bool ShaderProgram::UpdateUniformShadow(const GLint location,
+                                        const void* value,
+                                        const size_t num_bytes,
+                                        bool* is_active) {
+  *is_active = false;
+  if (location < 0 ||
+      location >= static_cast<GLint>(uniform_shadows_.size())) {
+    return false;
+  }
+  UniformShadow& shadow = uniform_shadows_[location];
+  *is_active = shadow.active;
+  if (!shadow.active) return false;
+  if (shadow.valid && std::memcmp(shadow.value, value, num_bytes) == 0) {
+    return false;
+  }
+  std::memcpy(shadow.value, value, num_bytes);
+  shadow.valid = true;
+  return true;
+}
+
+bool ShaderProgram::SetUniform(const GLint location,
+                               const Eigen::Matrix4f& value) {
+  bool is_active;
+  if (UpdateUniformShadow(location, value.data(), sizeof(value), &is_active)) {
+    glUniformMatrix4fv(location, 1, GL_FALSE, value.data());
+  }
+  return is_active;
+}
+
+bool ShaderProgram::SetUniform(const GLint location,
+                               const Eigen::Vector3f& value) {
+  bool is_active;
+  if (UpdateUniformShadow(location, value.data(), sizeof(value), &is_active)) {
+    glUniform3fv(location, 1, value.data());
+  }
+  return is_active;
+}
+
+bool ShaderProgram::SetUniform(const GLint location, const GLfloat value) {
+  bool is_active;
+  if (UpdateUniformShadow(location, &value, sizeof(value), &is_active)) {
+    glUniform1f(location, value);
+  }
+  return is_active;
+}
+
+bool ShaderProgram::SetUniform(const GLint location, const GLint value) {
+  bool is_active;
+  if (UpdateUniformShadow(location, &value, sizeof(value), &is_active)) {
+    glUniform1i(location, value);
+  }
+  return is_active;
+}
+
+bool ShaderProgram::Dispatch(const GLuint num_groups_x,
+                             const GLuint num_groups_y,
+                             const GLuint num_groups_z,
+                             const GLbitfield barriers) const {
+  if (!created_ || !is_compute()) {
+    return false;
+  }
+  glDispatchCompute(num_groups_x, num_groups_y, num_groups_z);
+  if (barriers != 0) {
+    glMemoryBarrier(barriers);
+  }
+  return true;
+}
+
+void ShaderProgram::InvalidateUniformShadows() {
+  for (UniformShadow& shadow : uniform_shadows_) {
+    shadow.valid = false;
+  }
+}
+
+void ShaderProgram::Swap(ShaderProgram* other) {
+  std::swap(stages_, other->stages_);
+  std::swap(preprocessor_, other->preprocessor_);
+  std::swap(shader_program_id_, other->shader_program_id_);
+  std::swap(created_, other->created_);
+  std::swap(binary_cache_directory_, other->binary_cache_directory_);
+  std::swap(loaded_from_binary_cache_, other->loaded_from_binary_cache_);
+  std::swap(build_pending_, other->build_pending_);
+  std::swap(async_build_failed_, other->async_build_failed_);
+  std::swap(async_info_log_, other->async_info_log_);
+  std::swap(uniforms_, other->uniforms_);
+  std::swap(uniform_shadows_, other->uniform_shadows_);
+  std::swap(uniform_blocks_, other->uniform_blocks_);
+  std::swap(work_group_size_, other->work_group_size_);
+  std::swap(reads_instance_transforms_, other->reads_instance_transforms_);
+}
+
 }  // namespace wvu
@@ -35,12 +35,22 @@
 #ifndef GLUTILS_SHADER_PROGRAM_H_
 #define GLUTILS_SHADER_PROGRAM_H_
 
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "gl_state_cache.h"
+#include "gpu_resources.h"
+#include "mapped_file.h"
+#include "shader_preprocessor.h"
+#include "shader_source.h"
 
 namespace wvu {
-// This class helps with the compilation of vertex and fragment shaders. The
-// class compiles the shaders and creates a shader program. The class keeps
+// This class helps with the compilation of shaders. The class compiles the
+// shaders of any set of stages and creates a shader program. The class keeps
 // the id of such a compiled and linked program. The class also provides a way
 // to use the shader by calling the Use() member function.
 // The class can load shaders from file or accept C++ strings holding the
@@ -81,28 +91,96 @@ namespace wvu {
 // }
 //
 // 4) Passing uniform variables to shader example:
-// When passing values to uniform variables in the shader program, the shader
-// program id is necessary. This class provides access to this id by calling the
-// accessor method shader_program_id().
+// When passing values to uniform variables in the shader program, the location
+// of the uniform variable is necessary. The class introspects all the active
+// uniforms once the program is linked, so retrieving a location does not query
+// OpenGL. Render loops should retrieve the location once and reuse it.
 //
 //  ...
 //  const GLint uniform_variable_location =
-//     glGetUniformLocation(shader_program_.shader_program_id(),
-//                          "uniform_variable_name");
+//     shader_program.GetUniformLocation("uniform_variable_name");
 //  ...
+//
+// 5) Caching the linked program binary:
+// When a cache directory is set prior calling Create(), the class looks for a
+// program binary previously stored for the same shader sources and OpenGL
+// driver, and skips the compilation and linkage when the driver accepts it.
+// Otherwise, the program is built from source and its binary is stored.
+//
+// wvu::ShaderProgram shader_program;
+// shader_program.SetProgramBinaryCacheDirectory("/path/to/cache");
+// ...
+// shader_program.Create(&error_info_log);
+//
+// 6) Creating and dispatching a compute shader program:
+// A program is built from the stages loaded prior calling Create(). A compute
+// shader cannot be combined with other stages.
+//
+// wvu::ShaderProgram culling_program;
+// culling_program.LoadComputeShaderFromString(compute_shader_string);
+// culling_program.Create(&error_info_log);
+// ...
+// culling_program.Use();
+// culling_program.Dispatch(num_groups, 1, 1, GL_COMMAND_BARRIER_BIT);
+//
+// 7) Loading precompiled SPIR-V modules:
+// The GLSL sources can be compiled offline into SPIR-V modules, e.g., with
+// ADD_SPIRV_SHADERS() of cmake/Modules/SpirvShaders.cmake, which the drivers
+// supporting SPIR-V (OpenGL 4.6 or ARB_gl_spirv) only specialize, skipping
+// their GLSL front end. A GLSL source loaded for the same stage is compiled
+// instead on the other drivers. The specialization constants of a module,
+// declared with layout (constant_id = N), replace the definitions patched into
+// the sources of the variants.
+//
+// wvu::ShaderProgram shader_program;
+// shader_program.LoadVertexShaderFromFile("/path/to/shader.vert");
+// shader_program.LoadShaderFromSpirvFile(wvu::ShaderProgram::VERTEX,
+//                                        "/path/to/shader.vert.spv");
+// shader_program.SetSpecializationConstant(wvu::ShaderProgram::VERTEX, 0, 1);
+// ...
+// shader_program.Create(&error_info_log);
+//
+// 8) Using the typed setters:
+// The setters keep a CPU-side copy of the last value passed to every uniform
+// and skip the OpenGL call when the value did not change. The shader program
+// must be in use (see Use()) when calling the setters.
+//
+//  shader_program.Use();
+//  shader_program.SetUniform(model_location, model_matrix);
 class ShaderProgram {
  public:
+  // Enumeration of the shader stages a program can be built from.
+  enum ShaderType {
+    VERTEX = 0,
+    TESS_CONTROL = 1,
+    TESS_EVALUATION = 2,
+    GEOMETRY = 3,
+    FRAGMENT = 4,
+    COMPUTE = 5,
+    NUM_SHADER_TYPES = 6
+  };
+
   // Default constructor.
   ShaderProgram() :
       // Initializing member attributes.
-      vertex_shader_src_(""), fragment_shader_src_(""),
-      vertex_shader_(0), fragment_shader_(0), shader_program_id_(0),
-      created_(false) {}
+      preprocessor_(nullptr), shader_program_id_(0),
+      created_(false), loaded_from_binary_cache_(false),
+      build_pending_(false), async_build_failed_(false),
+      reads_instance_transforms_(false) {
+    work_group_size_[0] = work_group_size_[1] = work_group_size_[2] = 0;
+  }
   // Destructor. Invoked automatically once the instance goes out of scope.
   virtual ~ShaderProgram() {
-    if (created_) {
-      // Once the shader program is not needed, we tell OpenGL to delete it.
-      glDeleteProgram(shader_program_id_);
+    if (build_pending_) {
+      // Delete the shaders of a build that was never verified.
+      for (const Stage& stage : stages_) {
+        glDeleteShader(stage.shader);
+      }
+    }
+    if (created_ || build_pending_) {
+      // Once the shader program is not needed, we tell OpenGL to delete it,
+      // after the frames in flight drawing with it (see gpu_resources.h).
+      GpuResources::Get()->Retire(GPU_PROGRAM, shader_program_id_);
     }
   }
 
@@ -113,6 +191,73 @@ class ShaderProgram {
     return shader_program_id_;
   }
 
+  // Loads the source code of a shader stage from a string. Returns true if
+  // successful, and false otherwise.
+  // Parameters:
+  //   shader_type  The stage of the shader.
+  //   shader_source  The C++ string containing the shader source.
+  bool LoadShaderFromString(const ShaderType shader_type,
+                            const std::string& shader_source);
+
+  // Loads a shader stage from a file. The file is memory-mapped and passed to
+  // OpenGL without copying it. When a preprocessor is given, the #include
+  // directives are resolved and its definitions injected (see
+  // ShaderPreprocessor). Returns true if successful, and false otherwise.
+  // Parameters:
+  //   shader_type  The stage of the shader.
+  //   shader_path  The filepath for the shader.
+  //   preprocessor  The preprocessor to use, or nullptr. It must outlive this
+  //     instance.
+  bool LoadShaderFromFile(const ShaderType shader_type,
+                          const std::string& shader_path,
+                          ShaderPreprocessor* preprocessor);
+
+  // Loads the SPIR-V module of a shader stage from a file, which is
+  // memory-mapped and passed to OpenGL without copying it. The GLSL source of
+  // the stage, if loaded, is kept for the drivers without SPIR-V. The modules
+  // keep the names of their uniforms and blocks unless they are stripped, in
+  // which case the shaders must declare explicit locations and bindings.
+  // Returns true if the file holds a SPIR-V module, and false otherwise.
+  // Parameters:
+  //   shader_type  The stage of the shader.
+  //   spirv_path  The filepath of the SPIR-V module.
+  //   entry_point  The name of the function of the stage in the module.
+  bool LoadShaderFromSpirvFile(const ShaderType shader_type,
+                               const std::string& spirv_path,
+                               const std::string& entry_point = "main");
+
+  // Sets the value of the specialization constant with the id constant_id in
+  // the SPIR-V module of a stage. Booleans are 0 or 1, and floats pass their
+  // bits. The constants not set keep the defaults of the module. Applies to
+  // the next Create().
+  void SetSpecializationConstant(const ShaderType shader_type,
+                                 const GLuint constant_id,
+                                 const GLuint value);
+
+  // Returns true if the driver accepts SPIR-V modules, i.e., with OpenGL 4.6 or
+  // ARB_gl_spirv.
+  static bool SpirvSupported();
+
+  // Returns true if a source or a SPIR-V module was loaded for the stage.
+  bool has_shader(const ShaderType shader_type) const {
+    return !stages_[shader_type].source.empty() ||
+        stages_[shader_type].spirv != nullptr;
+  }
+
+  // Returns true if the stage is built from its SPIR-V module, which is the
+  // case when the driver supports SPIR-V or the stage has no GLSL source.
+  bool uses_spirv(const ShaderType shader_type) const {
+    const Stage& stage = stages_[shader_type];
+    return stage.spirv != nullptr &&
+        (stage.source.empty() || SpirvSupported());
+  }
+
+  // Returns the filepath the stage was loaded from, or an empty string if it
+  // was loaded from a string.
+  const std::string& shader_path(const ShaderType shader_type) const {
+    return stages_[shader_type].path;
+  }
+
   // Loads a vertex shader source coude from a string. Returns true if
   // successful, and false otherwise.
   // Parameters:
@@ -126,23 +271,81 @@ class ShaderProgram {
   //     source.
   bool LoadFragmentShaderFromString(const std::string& fragment_shader_source);
 
-  // Loads a vertex shader from a file. Returns true if
+  // Loads a compute shader source code from a string. Returns true if
   // successful, and false otherwise.
   // Parameters:
+  //   compute_shader_source  The C++ string containing the compute shader
+  //     source.
+  bool LoadComputeShaderFromString(const std::string& compute_shader_source);
+
+  // Loads a compute shader from a file. The file is memory-mapped and passed
+  // to OpenGL without copying it. Returns true if successful, and false
+  // otherwise.
+  // Parameters:
+  //   compute_shader_path  The filepath for the compute shader.
+  bool LoadComputeShaderFromFile(const std::string& compute_shader_path);
+
+  // Loads a vertex shader from a file. The file is memory-mapped and passed to
+  // OpenGL without copying it. Returns true if successful, and false
+  // otherwise.
+  // Parameters:
   //   vertex_shader_path  The filepath for the vertex shader.
   bool LoadVertexShaderFromFile(const std::string& vertex_shader_path);
 
-  // Loads a fragment shader from a file. Returns true if
-  // successful, and false otherwise.
+  // Loads a fragment shader from a file. The file is memory-mapped and passed
+  // to OpenGL without copying it. Returns true if successful, and false
+  // otherwise.
   // Parameters:
   //   fragment_shader_path  The filepath for the fragment shader.
   bool LoadFragmentShaderFromFile(const std::string& fragment_shader_path);
 
+  // Loads a vertex shader from a file, resolving its #include directives and
+  // injecting the definitions of the preprocessor (see ShaderPreprocessor).
+  // The shader is passed to OpenGL as multiple strings viewing the mapped
+  // files. Returns true if successful, and false otherwise.
+  // Parameters:
+  //   vertex_shader_path  The filepath for the vertex shader.
+  //   preprocessor  The preprocessor to use. It must outlive this instance.
+  bool LoadVertexShaderFromFile(const std::string& vertex_shader_path,
+                                ShaderPreprocessor* preprocessor);
+
+  // Loads a fragment shader from a file, resolving its #include directives and
+  // injecting the definitions of the preprocessor (see ShaderPreprocessor).
+  // Returns true if successful, and false otherwise.
+  // Parameters:
+  //   fragment_shader_path  The filepath for the fragment shader.
+  //   preprocessor  The preprocessor to use. It must outlive this instance.
+  bool LoadFragmentShaderFromFile(const std::string& fragment_shader_path,
+                                  ShaderPreprocessor* preprocessor);
+
+  // Returns the filepaths of all the files the shaders were loaded from,
+  // including the included files.
+  std::vector<std::string> source_dependencies() const;
+
+  // Returns the preprocessor used to load the shaders, or nullptr if the
+  // shaders were not preprocessed.
+  ShaderPreprocessor* preprocessor() const {
+    return preprocessor_;
+  }
+
+  // Returns true if every loaded stage was loaded from a file.
+  bool loaded_from_files() const;
+
+  // Returns the filepaths the shaders were loaded from, or empty strings if
+  // the shaders were loaded from strings.
+  const std::string& vertex_shader_path() const {
+    return shader_path(VERTEX);
+  }
+  const std::string& fragment_shader_path() const {
+    return shader_path(FRAGMENT);
+  }
+
   // This function executes the following steps:
-  // 1. Compiles the vertex shader. If an error occurrs, the error information
-  //    log is copied into error_info_log pointer.
-  // 2. Compiles the fragment shader. If an error occurrs, the error information
-  //    log is copied into error_info_log pointer.
+  // 1. Verifies that the loaded stages form a program: either a compute
+  //    shader alone, or a vertex shader with optional tessellation, geometry
+  //    and fragment shaders. Tessellation requires an evaluation shader.
+  // 2. Compiles the shaders of the loaded stages. If an error occurrs, the
+  //    error information log is copied into error_info_log pointer.
   // 3. Links the shaders to form a shader program. If an error occurrs, the
   //    error information log is copied into error_info_log pointer.
   // 4. Cleans up temporary variables.
@@ -153,39 +356,269 @@ class ShaderProgram {
   //  error_info_log  A pointer to a string that holds the error log.
   bool Create(std::string* error_info_log);
 
+  // Links already compiled vertex and fragment shaders to form the shader
+  // program. The shaders are not deleted, so that the caller can share them
+  // across several programs (see ShaderLibrary). The function returns false
+  // when the linkage fails, and returns true otherwise.
+  // Parameters:
+  //  vertex_shader  The id of a compiled vertex shader.
+  //  fragment_shader  The id of a compiled fragment shader.
+  //  error_info_log  A pointer to a string that holds the error log.
+  bool CreateFromShaders(const GLuint vertex_shader,
+                         const GLuint fragment_shader,
+                         std::string* error_info_log);
+
+  // Starts building the shader program without waiting for the driver. The
+  // function submits the compilation of both shaders and the linkage of the
+  // program, and returns immediately. Use IsReady() to poll for completion, or
+  // Create() to wait for it and retrieve the error info log. This allows a
+  // render loop to keep presenting frames while a batch of programs builds.
+  // Returns true if the build was submitted or the program is created.
+  bool CreateAsync();
+
+  // Returns true if the program is not being built, i.e., if the build started
+  // by CreateAsync() finished. With KHR_parallel_shader_compile the function
+  // never waits for the driver; without it, the function waits for the build.
+  // Once ready, Use() succeeds if the build succeeded, and Create() reports
+  // the error info log if the build failed.
+  bool IsReady();
+
+  // Sets the directory where the linked program binaries are cached. The
+  // directory must exist. An empty directory disables the cache, which is the
+  // default. The cache is also disabled when the driver does not support
+  // program binaries (OpenGL 4.1 or ARB_get_program_binary).
+  // Parameters:
+  //   cache_directory  The directory storing the program binaries.
+  void SetProgramBinaryCacheDirectory(const std::string& cache_directory) {
+    binary_cache_directory_ = cache_directory;
+  }
+
+  // Returns the directory of the program binary cache.
+  const std::string& program_binary_cache_directory() const {
+    return binary_cache_directory_;
+  }
+
+  // Returns true if Create() obtained the program from the binary cache.
+  bool loaded_from_binary_cache() const {
+    return loaded_from_binary_cache_;
+  }
+
+  // Returns the location of the active uniform variable named uniform_name, or
+  // -1 if the program does not have such an active uniform. The locations are
+  // cached after linking the program, so this function does not call OpenGL.
+  // Array uniforms can be looked up with and without the "[0]" suffix.
+  // Parameters:
+  //   uniform_name  The name of the uniform variable in the shader source.
+  GLint GetUniformLocation(const std::string& uniform_name) const;
+
+  // Returns the number of active uniforms found after linking the program.
+  int num_active_uniforms() const {
+    return static_cast<int>(uniforms_.size());
+  }
+
+  // Typed setters for uniform variables. The functions compare the value
+  // against the last value set through these setters and only call OpenGL when
+  // the value changed. The shader program must be in use. Note that setting a
+  // uniform directly with glUniform*() bypasses the shadow copy; call
+  // InvalidateUniformShadows() after doing so. Returns false if the location
+  // does not correspond to an active uniform.
+  // Parameters:
+  //   location  The location of the uniform (see GetUniformLocation()).
+  //   value  The value to pass to the uniform.
+  bool SetUniform(const GLint location, const Eigen::Matrix4f& value);
+  bool SetUniform(const GLint location, const Eigen::Vector3f& value);
+  bool SetUniform(const GLint location, const GLfloat value);
+  bool SetUniform(const GLint location, const GLint value);
+
+  // Convenience setters that resolve the location from the cached uniforms.
+  template <typename ValueType>
+  bool SetUniform(const std::string& uniform_name, const ValueType& value) {
+    return SetUniform(GetUniformLocation(uniform_name), value);
+  }
+
+  // Forgets the shadow copies so that the next call to the setters always
+  // reaches OpenGL.
+  void InvalidateUniformShadows();
+
+  // Returns the index of the active uniform block named block_name, or
+  // GL_INVALID_INDEX if the program does not have such a block. The indices
+  // are cached after linking the program.
+  GLuint GetUniformBlockIndex(const std::string& block_name) const;
+
+  // Binds the uniform block named block_name to a uniform buffer binding point,
+  // so that the block reads the buffer bound with glBindBufferBase() to that
+  // binding point. Several programs bound to the same binding point share the
+  // buffer, which only needs to be uploaded once. Returns false if the program
+  // does not have such a block.
+  // Parameters:
+  //   block_name  The name of the uniform block in the shader source.
+  //   binding_point  The uniform buffer binding point.
+  bool BindUniformBlock(const std::string& block_name,
+                        const GLuint binding_point);
+
+  // Binds the shader storage block named block_name to a shader storage buffer
+  // binding point. Needs OpenGL 4.3 or ARB_program_interface_query. Returns
+  // false if the program does not have such a block.
+  // Parameters:
+  //   block_name  The name of the buffer block in the shader source.
+  //   binding_point  The shader storage buffer binding point.
+  bool BindShaderStorageBlock(const std::string& block_name,
+                              const GLuint binding_point);
+
+  // Exchanges the state of this shader program, including its program id and
+  // sources, with the state of other. This allows replacing a program with a
+  // newly built one (see ShaderWatcher) without invalidating pointers to it.
+  void Swap(ShaderProgram* other);
+
+  // Returns true if the program was built from a compute shader.
+  bool is_compute() const {
+    return has_shader(COMPUTE);
+  }
+
+  // Returns the local size of the work groups declared by the compute shader,
+  // or zeros if this is not a compute program.
+  const GLint* work_group_size() const {
+    return work_group_size_;
+  }
+
+  // Returns true if the vertex shader reads a per-instance model matrix, i.e.,
+  // declares an active mat4 attribute at kInstanceTransformLocation (see
+  // instance_buffer.h). Such programs draw every item of a RenderQueue
+  // instanced.
+  bool reads_instance_transforms() const {
+    return reads_instance_transforms_;
+  }
+
+  // Launches num_groups_x x num_groups_y x num_groups_z work groups of the
+  // compute program, which must be in use (see Use()). The barrier bits are
+  // passed to glMemoryBarrier() after the dispatch, so that the commands that
+  // consume the results see the writes of the shader. Pass 0 to skip the
+  // barrier, e.g., between independent dispatches. Returns false if this is
+  // not a created compute program.
+  // Parameters:
+  //   num_groups_x, num_groups_y, num_groups_z  The number of work groups.
+  //   barriers  The bitfield of GL_*_BARRIER_BIT values to issue.
+  bool Dispatch(const GLuint num_groups_x,
+                const GLuint num_groups_y,
+                const GLuint num_groups_z,
+                const GLbitfield barriers = GL_ALL_BARRIER_BITS) const;
+
   // This function activates the shader as the current one in OpenGL.
   // Returns true if the function successfully activates the shader program.
   bool Use() const {
     if (created_) {
-      // We set the shader program as active.
-      glUseProgram(shader_program_id_);
+      // We set the shader program as active. The call is skipped if the
+      // program is already in use.
+      GlStateCache::Current()->UseProgram(shader_program_id_);
       return true;
     }
     return false;
   }
 
  protected:
-  // Compiles the vertex shader.
-  bool BuildVertexShader(std::string* info_log);
-  // Compiles the fragment shader.
-  bool BuildFragmentShader(std::string* info_log);
+  // Verifies that the loaded stages form a valid program.
+  bool ValidateStages(std::string* info_log) const;
+  // Submits the compilation of the GLSL source of a stage, or the
+  // specialization of its SPIR-V module, without waiting for it. Returns the
+  // shader id.
+  GLuint SubmitStage(const ShaderType shader_type) const;
+  // Compiles the shaders of the loaded stages.
+  bool BuildShaders(std::string* info_log);
   // Links the shaders to form a shader program.
   bool LinkProgram(std::string* info_log);
+  // Verifies the build started by CreateAsync(), waiting for it if necessary.
+  bool FinishAsyncBuild(std::string* error_info_log);
+  // Loads the program from the binary cache. Returns true if successful.
+  bool LoadProgramBinary(const std::string& cache_filepath);
+  // Stores the binary of the linked program in the binary cache.
+  bool StoreProgramBinary(const std::string& cache_filepath) const;
+  // Returns the path of the cache file for the current shader sources and
+  // driver, or an empty string if the cache is disabled.
+  std::string ProgramBinaryCacheFilepath() const;
+  // Queries the active uniforms and uniform blocks of the linked program, the
+  // work group size of compute programs and whether the vertex shader reads
+  // instance transforms, and caches them.
+  void IntrospectUniforms();
+  // Names the program after the files of its stages, for the debug output and
+  // the debuggers.
+  void LabelProgram() const;
+  // Compares the value against the shadow copy of the uniform at location and
+  // updates the copy. Returns true when OpenGL needs to be called, and sets
+  // *is_active to whether location corresponds to an active uniform.
+  bool UpdateUniformShadow(const GLint location,
+                           const void* value,
+                           const size_t num_bytes,
+                           bool* is_active);
 
  private:
-  // Vertex shader program source.
-  std::string vertex_shader_src_;
-  // Fragment shader program source.
-  std::string fragment_shader_src_;
-  // Vertex shader id.
-  GLuint vertex_shader_;
-  // Fragment shader id.
-  GLuint fragment_shader_;
+  // A shader stage of the program.
+  struct Stage {
+    Stage() : shader(0) {}
+    // Shader source. Sources loaded from files view the memory-mapped file
+    // directly. Stages with an empty source are not part of the program.
+    ShaderSource source;
+    // Filepath of the shader source, if loaded from a file.
+    std::string path;
+    // Filepaths the shader source depends on, if loaded from a file.
+    std::vector<std::string> dependencies;
+    // SPIR-V module of the stage, if loaded, with the name of its entry point
+    // and the values of its specialization constants.
+    std::shared_ptr<const MappedFile> spirv;
+    std::string entry_point;
+    std::vector<GLuint> constant_ids;
+    std::vector<GLuint> constant_values;
+    // Shader id while building the program.
+    GLuint shader;
+  };
+  // Shader stages indexed by ShaderType.
+  Stage stages_[NUM_SHADER_TYPES];
+  // Preprocessor used to load the shaders from files. Not owned.
+  ShaderPreprocessor* preprocessor_;
   // Program shader id.
   GLuint shader_program_id_;
   // Created state variable. True when this shader program is created, and false
   // otherwise.
   bool created_;
+  // Directory of the program binary cache. Empty when the cache is disabled.
+  std::string binary_cache_directory_;
+  // True if the program was loaded from the program binary cache.
+  bool loaded_from_binary_cache_;
+  // True while the build started by CreateAsync() has not been verified.
+  bool build_pending_;
+  // True if the asynchronous build failed and Create() has not reported it.
+  bool async_build_failed_;
+  // Error info log of the failed asynchronous build.
+  std::string async_info_log_;
+
+  // Description of an active uniform variable.
+  struct UniformInfo {
+    // Location of the uniform variable in the program.
+    GLint location;
+    // OpenGL type of the uniform (e.g., GL_FLOAT_MAT4).
+    GLenum type;
+    // Number of elements for array uniforms, and 1 otherwise.
+    GLint size;
+  };
+  // Active uniforms indexed by their names.
+  std::unordered_map<std::string, UniformInfo> uniforms_;
+
+  // CPU-side copy of the last value of a uniform. The largest supported value
+  // is a 4x4 float matrix.
+  struct UniformShadow {
+    UniformShadow() : active(false), valid(false) {}
+    // True if the location corresponds to an active uniform.
+    bool active;
+    // True if value holds the last value passed to OpenGL.
+    bool valid;
+    GLfloat value[16];
+  };
+  // Shadow copies indexed by uniform location.
+  std::vector<UniformShadow> uniform_shadows_;
+  // Active uniform block indices indexed by their names.
+  std::unordered_map<std::string, GLuint> uniform_blocks_;
+  // Local size of the work groups of compute programs.
+  GLint work_group_size_[3];
+  bool reads_instance_transforms_;
 };
 
 }  // namespace wvu
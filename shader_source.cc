@@ -0,0 +1,88 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "shader_source.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "mapped_file.h"
+
+namespace wvu {
+
+void ShaderSource::Append(const std::string& text) {
+  if (text.empty()) return;
+  std::shared_ptr<const std::string> storage =
+      std::make_shared<const std::string>(text);
+  pieces_.push_back(storage->data());
+  piece_lengths_.push_back(static_cast<GLint>(storage->size()));
+  storage_.push_back(storage);
+}
+
+void ShaderSource::Append(const std::shared_ptr<const MappedFile>& mapped_file,
+                          const size_t offset,
+                          const size_t length) {
+  if (length == 0) return;
+  pieces_.push_back(mapped_file->data() + offset);
+  piece_lengths_.push_back(static_cast<GLint>(length));
+  storage_.push_back(mapped_file);
+}
+
+void ShaderSource::Append(const ShaderSource& other) {
+  storage_.insert(storage_.end(), other.storage_.begin(),
+                  other.storage_.end());
+  pieces_.insert(pieces_.end(), other.pieces_.begin(), other.pieces_.end());
+  piece_lengths_.insert(piece_lengths_.end(), other.piece_lengths_.begin(),
+                        other.piece_lengths_.end());
+}
+
+size_t ShaderSource::length() const {
+  size_t total_length = 0;
+  for (const GLint piece_length : piece_lengths_) {
+    total_length += piece_length;
+  }
+  return total_length;
+}
+
+std::string ShaderSource::ToString() const {
+  std::string text;
+  text.reserve(length());
+  for (size_t i = 0; i < pieces_.size(); ++i) {
+    text.append(pieces_[i], piece_lengths_[i]);
+  }
+  return text;
+}
+
+}  // namespace wvu
@@ -0,0 +1,120 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SHADER_SOURCE_H_
+#define GLUTILS_SHADER_SOURCE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "mapped_file.h"
+
+namespace wvu {
+// This class holds the source code of a shader as a sequence of pieces. Every
+// piece is either owned as a C++ string or viewed directly in a memory-mapped
+// file, in which case it is never copied. glShaderSource() receives all the
+// pieces as separate strings, along with their lengths, so assembling a shader
+// from several snippets does not concatenate them into a single buffer.
+// Copies of a ShaderSource share the underlying memory.
+class ShaderSource {
+ public:
+  // Creates an empty source.
+  ShaderSource() {}
+
+  // Creates a source holding a copy of text.
+  explicit ShaderSource(const std::string& text) {
+    Append(text);
+  }
+
+  // Creates a source viewing the contents of a mapped file.
+  explicit ShaderSource(const std::shared_ptr<const MappedFile>& mapped_file) {
+    Append(mapped_file, 0, mapped_file->size());
+  }
+
+  // Appends a copy of text as a new piece.
+  void Append(const std::string& text);
+
+  // Appends a range of a mapped file as a new piece, without copying it.
+  // Parameters:
+  //   mapped_file  The mapped file holding the piece.
+  //   offset  The offset of the first character of the piece.
+  //   length  The number of characters in the piece.
+  void Append(const std::shared_ptr<const MappedFile>& mapped_file,
+              const size_t offset,
+              const size_t length);
+
+  // Appends all the pieces of other.
+  void Append(const ShaderSource& other);
+
+  // Returns the number of pieces.
+  GLsizei num_pieces() const {
+    return static_cast<GLsizei>(pieces_.size());
+  }
+
+  // Returns the pointers to the pieces as expected by glShaderSource(). The
+  // pieces are not NUL-terminated.
+  const char* const* pieces() const {
+    return pieces_.data();
+  }
+
+  // Returns the lengths of the pieces as expected by glShaderSource().
+  const GLint* piece_lengths() const {
+    return piece_lengths_.data();
+  }
+
+  // Returns the total length of the source in characters.
+  size_t length() const;
+
+  bool empty() const {
+    return length() == 0;
+  }
+
+  // Returns a copy of the source as a single C++ string.
+  std::string ToString() const;
+
+ private:
+  // Storage of the pieces. Each entry keeps a string or a mapped file alive.
+  std::vector<std::shared_ptr<const void> > storage_;
+  // Pointers to the first character of each piece.
+  std::vector<const char*> pieces_;
+  // Lengths of the pieces.
+  std::vector<GLint> piece_lengths_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SHADER_SOURCE_H_
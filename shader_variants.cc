@@ -0,0 +1,182 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "shader_variants.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Names of the features of the ShaderFeature enumeration, indexed by bit.
+std::vector<std::string> DefaultFeatureDefines() {
+  return {"HAS_NORMALS", "SKINNING", "INSTANCING"};
+}
+
+}  // namespace
+
+ShaderVariantSet::ShaderVariantSet(const std::string& vertex_shader_source,
+                                   const std::string& fragment_shader_source)
+    : ShaderVariantSet(vertex_shader_source, fragment_shader_source,
+                       DefaultFeatureDefines()) {}
+
+ShaderVariantSet::ShaderVariantSet(
+    const std::string& vertex_shader_source,
+    const std::string& fragment_shader_source,
+    const std::vector<std::string>& feature_defines)
+    : vertex_shader_source_(vertex_shader_source),
+      fragment_shader_source_(fragment_shader_source),
+      feature_defines_(feature_defines) {
+  if (feature_defines_.size() > kMaxNumShaderFeatures) {
+    feature_defines_.resize(kMaxNumShaderFeatures);
+  }
+}
+
+std::string ShaderVariantSet::VariantSource(const std::string& source,
+                                            const uint32_t variant_key) const {
+  std::string defines;
+  for (size_t i = 0; i < feature_defines_.size(); ++i) {
+    if (variant_key & (1u << i)) {
+      defines += "#define " + feature_defines_[i] + "\n";
+    }
+  }
+  if (defines.empty()) return source;
+  // The definitions must go after the #version directive, which must be the
+  // first directive of the source.
+  size_t insert_position = 0;
+  const size_t version_position = source.find("#version");
+  if (version_position != std::string::npos) {
+    const size_t line_end = source.find('\n', version_position);
+    insert_position =
+        line_end == std::string::npos ? source.size() : line_end + 1;
+  }
+  std::string variant_source = source;
+  variant_source.insert(insert_position, defines);
+  return variant_source;
+}
+
+ShaderProgram* ShaderVariantSet::NewVariant(const uint32_t variant_key) {
+  std::unique_ptr<ShaderProgram>& variant = variants_[variant_key];
+  variant.reset(new ShaderProgram);
+  variant->SetProgramBinaryCacheDirectory(binary_cache_directory_);
+  variant->LoadVertexShaderFromString(
+      VariantSource(vertex_shader_source_, variant_key));
+  variant->LoadFragmentShaderFromString(
+      VariantSource(fragment_shader_source_, variant_key));
+  // The modules replace the sources on the drivers supporting SPIR-V, so the
+  // GLSL sources are only patched and compiled on the others.
+  if (!vertex_spirv_path_.empty() && ShaderProgram::SpirvSupported() &&
+      variant->LoadShaderFromSpirvFile(ShaderProgram::VERTEX,
+                                       vertex_spirv_path_) &&
+      variant->LoadShaderFromSpirvFile(ShaderProgram::FRAGMENT,
+                                       fragment_spirv_path_)) {
+    for (size_t i = 0; i < feature_defines_.size(); ++i) {
+      if ((variant_key & (1u << i)) == 0) continue;
+      variant->SetSpecializationConstant(ShaderProgram::VERTEX, i, 1);
+      variant->SetSpecializationConstant(ShaderProgram::FRAGMENT, i, 1);
+    }
+  }
+  return variant.get();
+}
+
+ShaderProgram* ShaderVariantSet::GetVariant(const uint32_t variant_key,
+                                            std::string* error_info_log) {
+  const auto it = variants_.find(variant_key);
+  ShaderProgram* variant =
+      it != variants_.end() ? it->second.get() : NewVariant(variant_key);
+  // Create() finishes a pre-warmed build, and returns immediately for a built
+  // variant.
+  if (!variant->Create(error_info_log)) {
+    variants_.erase(variant_key);
+    return nullptr;
+  }
+  return variant;
+}
+
+void ShaderVariantSet::Prewarm(const std::vector<uint32_t>& variant_keys) {
+  for (const uint32_t variant_key : variant_keys) {
+    if (variants_.count(variant_key) > 0) continue;
+    NewVariant(variant_key)->CreateAsync();
+  }
+}
+
+bool ShaderVariantSet::ParseVariantKey(const std::string& feature_names,
+                                       uint32_t* variant_key) const {
+  *variant_key = 0;
+  std::istringstream names(feature_names);
+  std::string name;
+  while (names >> name) {
+    const auto feature =
+        std::find(feature_defines_.begin(), feature_defines_.end(), name);
+    if (feature == feature_defines_.end()) return false;
+    *variant_key |= 1u << (feature - feature_defines_.begin());
+  }
+  return true;
+}
+
+bool ShaderVariantSet::PrewarmFromManifest(const std::string& manifest_path,
+                                           std::string* error_info_log) {
+  std::ifstream manifest(manifest_path);
+  if (!manifest.is_open()) {
+    if (error_info_log) {
+      *error_info_log = "Could not read " + manifest_path;
+    }
+    return false;
+  }
+  std::vector<uint32_t> variant_keys;
+  std::string line;
+  for (int line_number = 1; std::getline(manifest, line); ++line_number) {
+    if (!line.empty() && line[0] == '#') continue;
+    uint32_t variant_key = 0;
+    if (!ParseVariantKey(line, &variant_key)) {
+      if (error_info_log) {
+        *error_info_log = manifest_path + ":" + std::to_string(line_number) +
+            ": Unknown shader feature in \"" + line + "\"";
+      }
+      return false;
+    }
+    variant_keys.push_back(variant_key);
+  }
+  Prewarm(variant_keys);
+  return true;
+}
+
+}  // namespace wvu
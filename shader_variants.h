@@ -0,0 +1,189 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SHADER_VARIANTS_H_
+#define GLUTILS_SHADER_VARIANTS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shader_program.h"
+
+namespace wvu {
+// Features that select a shader variant. Every feature is a bit of the variant
+// key, and enables a preprocessor definition in the variant sources (see
+// ShaderVariantSet::feature_define()).
+enum ShaderFeature : uint32_t {
+  HAS_NORMALS = 1u << 0,
+  SKINNING = 1u << 1,
+  INSTANCING = 1u << 2,
+};
+
+// Maximum number of features a variant key can combine.
+constexpr int kMaxNumShaderFeatures = 32;
+
+// Combines features into a variant key at compile time, e.g.,
+//   constexpr uint32_t kKey = MakeVariantKey(HAS_NORMALS, INSTANCING);
+constexpr uint32_t MakeVariantKey() {
+  return 0;
+}
+template <typename... Features>
+constexpr uint32_t MakeVariantKey(const ShaderFeature feature,
+                                  const Features... features) {
+  return static_cast<uint32_t>(feature) | MakeVariantKey(features...);
+}
+
+// This class builds the variants of a pair of vertex and fragment shader
+// sources. A variant is selected by a key whose bits enable features; the
+// sources of a variant receive a #define directive for every enabled feature,
+// right after their #version directive. Variants are compiled lazily the first
+// time they are requested. To avoid hitches on the first frame that uses a
+// variant, the common variants can be pre-warmed at startup, either by key or
+// from a manifest file. Pre-warming builds the variants in parallel with
+// ShaderProgram::CreateAsync().
+// A manifest lists one variant per line as the names of its features separated
+// by spaces, e.g., "HAS_NORMALS INSTANCING". An empty line is the variant with
+// no features, and lines starting with '#' are comments.
+// On the drivers supporting SPIR-V, the variants may instead specialize one
+// pair of modules compiled offline, where bit i of the key sets the boolean
+// specialization constant with the id i, e.g., declared as
+//   layout (constant_id = 0) const bool HAS_NORMALS = false;
+// so that no variant patches and compiles GLSL sources.
+//
+// Example:
+//
+// wvu::ShaderVariantSet variants(vertex_shader_src, fragment_shader_src);
+// variants.PrewarmFromManifest("/path/to/manifest", &error_info_log);
+// ...
+// wvu::ShaderProgram* shader_program =
+//     variants.GetVariant<wvu::MakeVariantKey(wvu::HAS_NORMALS)>(
+//         &error_info_log);
+class ShaderVariantSet {
+ public:
+  // Creates a set of variants whose features are defined as the names of the
+  // ShaderFeature enumeration (e.g., #define HAS_NORMALS).
+  ShaderVariantSet(const std::string& vertex_shader_source,
+                   const std::string& fragment_shader_source);
+
+  // Creates a set of variants with custom features. Bit i of a key enables the
+  // feature_defines[i] definition.
+  ShaderVariantSet(const std::string& vertex_shader_source,
+                   const std::string& fragment_shader_source,
+                   const std::vector<std::string>& feature_defines);
+
+  ~ShaderVariantSet() {}
+
+  // Sets the directory where the variants cache their program binaries (see
+  // ShaderProgram::SetProgramBinaryCacheDirectory()).
+  void SetProgramBinaryCacheDirectory(const std::string& cache_directory) {
+    binary_cache_directory_ = cache_directory;
+  }
+
+  // Sets the SPIR-V modules the variants specialize on the drivers supporting
+  // SPIR-V (see ShaderProgram::LoadShaderFromSpirvFile()). The variants set the
+  // specialization constants of their features to true, and keep the others
+  // to the defaults of the modules, which should be false. The GLSL sources
+  // are compiled on the other drivers. Must be called before requesting or
+  // pre-warming the variants.
+  void SetSpirvModules(const std::string& vertex_spirv_path,
+                       const std::string& fragment_spirv_path) {
+    vertex_spirv_path_ = vertex_spirv_path;
+    fragment_spirv_path_ = fragment_spirv_path;
+  }
+
+  // Returns the variant for the key, building it if necessary. If the variant
+  // is being pre-warmed, the function waits for it. Returns nullptr if the
+  // variant fails to build, in which case the error information log is copied
+  // into error_info_log.
+  // Parameters:
+  //   variant_key  The features of the variant (see MakeVariantKey()).
+  //   error_info_log  A pointer to a string that holds the error log.
+  ShaderProgram* GetVariant(const uint32_t variant_key,
+                            std::string* error_info_log);
+
+  // Returns the variant for a compile-time key.
+  template <uint32_t kVariantKey>
+  ShaderProgram* GetVariant(std::string* error_info_log) {
+    return GetVariant(kVariantKey, error_info_log);
+  }
+
+  // Starts building the variants of the keys without waiting for them.
+  void Prewarm(const std::vector<uint32_t>& variant_keys);
+
+  // Starts building the variants listed in a manifest file. Returns false if
+  // the manifest cannot be read or names an unknown feature.
+  bool PrewarmFromManifest(const std::string& manifest_path,
+                           std::string* error_info_log);
+
+  // Returns the key of the variant with the named features. Returns false if
+  // a name is not a feature of this set.
+  bool ParseVariantKey(const std::string& feature_names,
+                       uint32_t* variant_key) const;
+
+  // Returns the preprocessor definition of the feature at bit index.
+  const std::string& feature_define(const int index) const {
+    return feature_defines_[index];
+  }
+
+  // Returns the number of variants that were requested or pre-warmed.
+  int num_variants() const {
+    return static_cast<int>(variants_.size());
+  }
+
+ private:
+  // Returns the source with the definitions of the features in the key.
+  std::string VariantSource(const std::string& source,
+                            const uint32_t variant_key) const;
+  // Creates the program of a variant without building it.
+  ShaderProgram* NewVariant(const uint32_t variant_key);
+
+  const std::string vertex_shader_source_;
+  const std::string fragment_shader_source_;
+  // Preprocessor definitions indexed by the bit of their features.
+  std::vector<std::string> feature_defines_;
+  // Directory of the program binary cache of the variants.
+  std::string binary_cache_directory_;
+  // SPIR-V modules of the sources, or empty strings.
+  std::string vertex_spirv_path_;
+  std::string fragment_spirv_path_;
+  // Built or building variants indexed by their keys.
+  std::unordered_map<uint32_t, std::unique_ptr<ShaderProgram> > variants_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SHADER_VARIANTS_H_
@@ -0,0 +1,227 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "shader_watcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Returns the directory of a filepath.
+std::string DirectoryOf(const std::string& filepath) {
+  const size_t separator = filepath.find_last_of('/');
+  if (separator == std::string::npos) return ".";
+  if (separator == 0) return "/";
+  return filepath.substr(0, separator);
+}
+
+// Returns the filepath of a file in a directory as it would be referred to by
+// a filepath using the same directory.
+std::string JoinPath(const std::string& directory, const std::string& name) {
+  if (directory == ".") return name;
+  if (directory == "/") return "/" + name;
+  return directory + "/" + name;
+}
+
+}  // namespace
+
+ShaderWatcher::ShaderWatcher() : inotify_fd_(-1) {}
+
+ShaderWatcher::~ShaderWatcher() {
+#ifdef __linux__
+  if (inotify_fd_ >= 0) {
+    close(inotify_fd_);
+  }
+#endif
+}
+
+bool ShaderWatcher::Initialize() {
+#ifdef __linux__
+  if (inotify_fd_ >= 0) return true;
+  // The descriptor is non-blocking, so that polling never waits.
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  return inotify_fd_ >= 0;
+#else
+  return false;
+#endif
+}
+
+bool ShaderWatcher::WatchDirectory(const std::string& filepath) {
+#ifdef __linux__
+  const std::string directory = DirectoryOf(filepath);
+  for (const auto& watched_directory : watched_directories_) {
+    if (watched_directory.second == directory) return true;
+  }
+  const int watch_descriptor =
+      inotify_add_watch(inotify_fd_, directory.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (watch_descriptor < 0) return false;
+  watched_directories_[watch_descriptor] = directory;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ShaderWatcher::Watch(ShaderProgram* shader_program) {
+  if (inotify_fd_ < 0 || shader_program == nullptr ||
+      !shader_program->loaded_from_files()) {
+    return false;
+  }
+  for (const std::string& dependency :
+       shader_program->source_dependencies()) {
+    if (!WatchDirectory(dependency)) return false;
+  }
+  std::unique_ptr<WatchedProgram> watched_program(new WatchedProgram);
+  watched_program->program = shader_program;
+  watched_program->dirty = false;
+  watched_programs_.push_back(std::move(watched_program));
+  return true;
+}
+
+void ShaderWatcher::Unwatch(ShaderProgram* shader_program) {
+  watched_programs_.erase(
+      std::remove_if(watched_programs_.begin(), watched_programs_.end(),
+                     [shader_program](
+                         const std::unique_ptr<WatchedProgram>& watched) {
+                       return watched->program == shader_program;
+                     }),
+      watched_programs_.end());
+}
+
+void ShaderWatcher::ReadFileEvents() {
+#ifdef __linux__
+  // The buffer must be aligned to hold inotify_event structures.
+  alignas(inotify_event) char buffer[4096];
+  while (true) {
+    const ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+    if (length <= 0) break;
+    for (ssize_t offset = 0; offset < length;) {
+      const inotify_event* event =
+          reinterpret_cast<const inotify_event*>(buffer + offset);
+      offset += sizeof(inotify_event) + event->len;
+      const auto directory = watched_directories_.find(event->wd);
+      if (event->len == 0 || directory == watched_directories_.end()) {
+        continue;
+      }
+      const std::string filepath = JoinPath(directory->second, event->name);
+      for (const std::unique_ptr<WatchedProgram>& watched : watched_programs_) {
+        const std::vector<std::string> dependencies =
+            watched->program->source_dependencies();
+        if (std::find(dependencies.begin(), dependencies.end(), filepath) ==
+            dependencies.end()) {
+          continue;
+        }
+        watched->dirty = true;
+        // The cached snippet of the file is stale.
+        if (watched->program->preprocessor()) {
+          watched->program->preprocessor()->Invalidate(filepath);
+        }
+      }
+    }
+  }
+#endif
+}
+
+bool ShaderWatcher::StartRebuild(WatchedProgram* watched_program,
+                                 std::string* error_info_log) {
+  const ShaderProgram& program = *watched_program->program;
+  std::unique_ptr<ShaderProgram> pending_program(new ShaderProgram);
+  pending_program->SetProgramBinaryCacheDirectory(
+      program.program_binary_cache_directory());
+  for (int i = 0; i < ShaderProgram::NUM_SHADER_TYPES; ++i) {
+    const ShaderProgram::ShaderType shader_type =
+        static_cast<ShaderProgram::ShaderType>(i);
+    if (!program.has_shader(shader_type)) continue;
+    if (!pending_program->LoadShaderFromFile(shader_type,
+                                             program.shader_path(shader_type),
+                                             program.preprocessor())) {
+      if (error_info_log) {
+        *error_info_log = "Could not read " + program.shader_path(shader_type);
+      }
+      return false;
+    }
+  }
+  pending_program->CreateAsync();
+  watched_program->pending_program = std::move(pending_program);
+  return true;
+}
+
+int ShaderWatcher::Poll(std::string* error_info_log) {
+  if (inotify_fd_ < 0) return 0;
+  ReadFileEvents();
+  int num_swapped_programs = 0;
+  bool failed = false;
+  for (const std::unique_ptr<WatchedProgram>& watched : watched_programs_) {
+    // Restart the rebuild if the files changed while rebuilding.
+    if (watched->dirty) {
+      watched->dirty = false;
+      if (!StartRebuild(watched.get(), error_info_log)) {
+        failed = true;
+        continue;
+      }
+    }
+    ShaderProgram* pending_program = watched->pending_program.get();
+    if (pending_program == nullptr || !pending_program->IsReady()) {
+      continue;
+    }
+    // The program is ready, so Create() does not wait.
+    if (pending_program->Create(error_info_log)) {
+      watched->program->Swap(pending_program);
+      ++num_swapped_programs;
+      // The new sources may include files from other directories.
+      for (const std::string& dependency :
+           watched->program->source_dependencies()) {
+        WatchDirectory(dependency);
+      }
+    } else {
+      failed = true;
+    }
+    // Deletes the old program, or the program that failed to build.
+    watched->pending_program.reset();
+  }
+  return failed ? -1 : num_swapped_programs;
+}
+
+}  // namespace wvu
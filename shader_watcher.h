@@ -0,0 +1,122 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SHADER_WATCHER_H_
+#define GLUTILS_SHADER_WATCHER_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shader_program.h"
+
+namespace wvu {
+// This class watches the files of shader programs loaded from files, including
+// the files they include, and rebuilds a program when any of its files
+// changes. The rebuild happens in the
+// background using ShaderProgram::CreateAsync(), and the watched program keeps
+// its current OpenGL program until the new one links successfully. At that
+// point the programs are swapped (see ShaderProgram::Swap()), so pointers to
+// the watched program remain valid. If the new program fails to build, the old
+// program stays in use and the error is reported by Poll().
+// File watching uses inotify, and is only available on Linux.
+//
+// Example:
+//
+// wvu::ShaderWatcher shader_watcher;
+// if (shader_watcher.Initialize()) {
+//   shader_watcher.Watch(&shader_program);
+// }
+// while (...) {  // Rendering loop.
+//   std::string error_info_log;
+//   if (shader_watcher.Poll(&error_info_log) < 0) {
+//     LOG(ERROR) << error_info_log;
+//   }
+//   ...
+// }
+class ShaderWatcher {
+ public:
+  ShaderWatcher();
+  ~ShaderWatcher();
+
+  // Starts watching the file system. Returns false if file watching is not
+  // supported.
+  bool Initialize();
+
+  // Watches the files of the shader program. The program must have been loaded
+  // from files, and must outlive the watcher or be unwatched. Returns true if
+  // successful, and false otherwise.
+  bool Watch(ShaderProgram* shader_program);
+
+  // Stops watching the files of the shader program.
+  void Unwatch(ShaderProgram* shader_program);
+
+  // Processes the file changes and the programs being rebuilt. This function
+  // never waits for the driver or the file system, and should be called once
+  // per frame from the thread owning the OpenGL context. Returns the number of
+  // programs that were swapped, or -1 if a rebuild failed, in which case the
+  // error information log is copied into error_info_log.
+  int Poll(std::string* error_info_log);
+
+ private:
+  // A watched program and its rebuild state.
+  struct WatchedProgram {
+    ShaderProgram* program;
+    // True if a file changed since the last rebuild started.
+    bool dirty;
+    // The program being rebuilt.
+    std::unique_ptr<ShaderProgram> pending_program;
+  };
+
+  // Starts watching the directory of the filepath. Returns true if successful.
+  bool WatchDirectory(const std::string& filepath);
+  // Reads the pending file system events and marks the changed programs.
+  void ReadFileEvents();
+  // Starts rebuilding a program. Returns false if the files cannot be read.
+  bool StartRebuild(WatchedProgram* watched_program,
+                    std::string* error_info_log);
+
+  // File descriptor of the inotify instance, or -1 when not initialized.
+  int inotify_fd_;
+  // Watched directories indexed by their inotify watch descriptor. Watching
+  // directories rather than files handles editors that save by renaming.
+  std::unordered_map<int, std::string> watched_directories_;
+  // Watched programs.
+  std::vector<std::unique_ptr<WatchedProgram> > watched_programs_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SHADER_WATCHER_H_
@@ -0,0 +1,409 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "shadow_cascades.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "buffer_allocator.h"
+#include "frame_uniforms.h"
+#include "gl_state_cache.h"
+#include "render_queue.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// The center of a cascade moves in steps of about a tenth of its width.
+constexpr int kSnapStepsPerCascade = 10;
+// Depth bias of the casters, scaled by the slope of their faces and in units
+// of the depth resolution, so that the lit faces do not shadow themselves.
+constexpr float kSlopeDepthBias = 2.0f;
+constexpr float kConstantDepthBias = 4.0f;
+// Floats of the block of the receivers: the matrices, the splits and the
+// number of cascades.
+constexpr int kBlockSize = 16 * kMaxNumShadowCascades + 8;
+
+}  // namespace
+
+const char ShadowCascades::kBlockName[] = "ShadowCascades";
+const char ShadowCascades::kSamplerName[] = "shadow_cascades";
+
+ShadowCascades::ShadowCascades()
+    : resolution_(0),
+      num_cascades_(0),
+      split_lambda_(kDefaultShadowSplitLambda),
+      caster_distance_(-1.0f),
+      static_texture_id_(0),
+      texture_id_(0),
+      draw_framebuffer_id_(0),
+      read_framebuffer_id_(0),
+      buffer_id_(0) {}
+
+ShadowCascades::~ShadowCascades() {
+  Reset();
+}
+
+bool ShadowCascades::Initialize(const int resolution,
+                                const int num_cascades,
+                                std::string* error_info_log) {
+  if (texture_id_ != 0) {
+    *error_info_log = "The shadow cascades are already initialized.";
+    return false;
+  }
+  if (resolution <= 0 || num_cascades <= 0 ||
+      num_cascades > kMaxNumShadowCascades) {
+    *error_info_log = "Invalid number or resolution of shadow cascades.";
+    return false;
+  }
+  resolution_ = resolution;
+  num_cascades_ = num_cascades;
+  light_views_.assign(num_cascades_, Eigen::Matrix4f::Identity());
+  light_projections_.assign(num_cascades_, Eigen::Matrix4f::Identity());
+  light_view_projections_.assign(num_cascades_, Eigen::Matrix4f::Identity());
+  static_view_projections_.assign(num_cascades_, Eigen::Matrix4f::Identity());
+  static_valid_.assign(num_cascades_, false);
+  split_distances_.assign(num_cascades_, 0.0f);
+
+  // The cached layers are only copied, while the sampled layers compare the
+  // depths of the receivers, filtering the four nearest results.
+  GLuint texture_ids[2];
+  glGenTextures(2, texture_ids);
+  static_texture_id_ = texture_ids[0];
+  texture_id_ = texture_ids[1];
+  for (const GLuint texture_id : texture_ids) {
+    const bool sampled = texture_id == texture_id_;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, resolution_,
+                 resolution_, num_cascades_, 0, GL_DEPTH_COMPONENT, GL_FLOAT,
+                 nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                    sampled ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER,
+                    sampled ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (sampled) {
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE,
+                      GL_COMPARE_REF_TO_TEXTURE);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC,
+                      GL_LEQUAL);
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  // The framebuffers only have a depth attachment, the layer being drawn or
+  // copied.
+  glGenFramebuffers(1, &draw_framebuffer_id_);
+  glGenFramebuffers(1, &read_framebuffer_id_);
+  AttachLayer(GL_DRAW_FRAMEBUFFER, draw_framebuffer_id_, texture_id_, 0);
+  glDrawBuffer(GL_NONE);
+  const GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  AttachLayer(GL_READ_FRAMEBUFFER, read_framebuffer_id_, static_texture_id_, 0);
+  glReadBuffer(GL_NONE);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    *error_info_log =
+        "The shadow cascade framebuffer is incomplete: status " +
+        std::to_string(status) + ".";
+    Reset();
+    return false;
+  }
+
+  BufferAllocator* allocator = BufferAllocator::Get();
+  GlStateCache* gl_state = GlStateCache::Current();
+  buffer_id_ = allocator->CreateBuffer(UNIFORM_DATA);
+  const GLfloat block[kBlockSize] = {0.0f};
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, buffer_id_);
+  allocator->BufferData(buffer_id_, GL_UNIFORM_BUFFER, sizeof(block), block,
+                        GL_DYNAMIC_DRAW);
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, 0);
+  for (int i = 0; i < num_cascades_; ++i) {
+    cascade_uniforms_[i].reset(new FrameUniforms());
+    if (!cascade_uniforms_[i]->Initialize()) {
+      *error_info_log = "Could not create the shadow cascade uniforms.";
+      Reset();
+      return false;
+    }
+  }
+  return buffer_id_ != 0;
+}
+
+bool ShadowCascades::Attach(ShaderProgram* shader_program) const {
+  if (!shader_program->BindUniformBlock(kBlockName,
+                                        kShadowCascadesBindingPoint)) {
+    return false;
+  }
+  const GLint location = shader_program->GetUniformLocation(kSamplerName);
+  if (location < 0 || !shader_program->Use()) return false;
+  return shader_program->SetUniform(
+      location, static_cast<GLint>(kShadowCascadesTextureUnit));
+}
+
+void ShadowCascades::Update(const Eigen::Matrix4f& view,
+                            const Eigen::Matrix4f& projection,
+                            const Eigen::Vector3f& light_direction,
+                            const float shadow_distance) {
+  if (texture_id_ == 0) return;
+  // The depth row of a perspective projection is
+  // (-(f + n) / (f - n), -2 f n / (f - n)). Far planes at infinity have
+  // a = -1.
+  const float a = projection(2, 2);
+  const float b = projection(2, 3);
+  const float near_distance = b / (a - 1.0f);
+  const float end_distance = a > -1.0f ?
+      std::min(shadow_distance, b / (a + 1.0f)) : shadow_distance;
+  // The practical split scheme (Zhang et al., 2006) blends the logarithmic
+  // split, which keeps the texel density on the screen constant, with the
+  // uniform split, which keeps the near cascades from getting too thin.
+  for (int i = 0; i < num_cascades_; ++i) {
+    const float fraction = static_cast<float>(i + 1) / num_cascades_;
+    const float logarithmic =
+        near_distance * std::pow(end_distance / near_distance, fraction);
+    const float uniform =
+        near_distance + (end_distance - near_distance) * fraction;
+    split_distances_[i] =
+        split_lambda_ * logarithmic + (1.0f - split_lambda_) * uniform;
+  }
+
+  // The light looks along its direction, with any up vector not parallel to
+  // it.
+  const Eigen::Vector3f forward = light_direction.normalized();
+  const Eigen::Vector3f up_hint = std::abs(forward.y()) < 0.99f ?
+      Eigen::Vector3f::UnitY() : Eigen::Vector3f::UnitX();
+  const Eigen::Vector3f right = forward.cross(up_hint).normalized();
+  const Eigen::Vector3f up = right.cross(forward);
+  Eigen::Matrix3f light_rotation;
+  light_rotation.row(0) = right;
+  light_rotation.row(1) = up;
+  light_rotation.row(2) = -forward;
+  const Eigen::Matrix4f camera_to_world = view.inverse();
+  // The slices of the frustum have corners at a lateral distance of
+  // z * tan_extent from the axis, at the depth z.
+  const float tan_extent = std::sqrt(
+      1.0f / (projection(0, 0) * projection(0, 0)) +
+      1.0f / (projection(1, 1) * projection(1, 1)));
+  const float k2 = tan_extent * tan_extent;
+  const int snap_texels = std::max(resolution_ / kSnapStepsPerCascade, 1);
+
+  GLfloat block[kBlockSize] = {0.0f};
+  for (int i = 0; i < num_cascades_; ++i) {
+    const float slice_near = i == 0 ? near_distance : split_distances_[i - 1];
+    const float slice_far = split_distances_[i];
+    // The smallest sphere enclosing the slice is centered on the axis. Its
+    // size only depends on the splits, not on the orientation of the camera.
+    float center_distance = 0.5f * (slice_near + slice_far) * (1.0f + k2);
+    float radius;
+    if (center_distance >= slice_far) {
+      center_distance = slice_far;
+      radius = slice_far * tan_extent;
+    } else {
+      radius = std::sqrt(slice_near * slice_near * k2 +
+                         (center_distance - slice_near) *
+                         (center_distance - slice_near));
+    }
+    // The snapped center is within half a step of the sphere along every
+    // axis, so the view grows by a step to keep the sphere inside.
+    const float extent =
+        radius / (1.0f - 2.0f * snap_texels / static_cast<float>(resolution_));
+    const float step = snap_texels * 2.0f * extent / resolution_;
+    const Eigen::Vector4f center =
+        camera_to_world * Eigen::Vector4f(0.0f, 0.0f, -center_distance, 1.0f);
+    Eigen::Vector3f light_center = light_rotation * center.head<3>();
+    for (int j = 0; j < 3; ++j) {
+      light_center[j] = std::floor(light_center[j] / step + 0.5f) * step;
+    }
+    Eigen::Matrix4f light_view = Eigen::Matrix4f::Identity();
+    light_view.block<3, 3>(0, 0) = light_rotation;
+    light_view.block<3, 1>(0, 3) = -light_center;
+
+    // The near plane is moved towards the light by the caster distance, so
+    // that the casters outside the sphere still shadow it.
+    const float caster_distance =
+        caster_distance_ < 0.0f ? 2.0f * extent : caster_distance_;
+    Eigen::Matrix4f light_projection = Eigen::Matrix4f::Zero();
+    light_projection(0, 0) = 1.0f / extent;
+    light_projection(1, 1) = 1.0f / extent;
+    const float depth_range = 2.0f * extent + caster_distance;
+    light_projection(2, 2) = -2.0f / depth_range;
+    light_projection(2, 3) = caster_distance / depth_range;
+    light_projection(3, 3) = 1.0f;
+    light_views_[i] = light_view;
+    light_projections_[i] = light_projection;
+    light_view_projections_[i] = light_projection * light_view;
+    cascade_uniforms_[i]->Update(light_view, light_projection, 0.0f, 0.0f);
+
+    // The receivers map the clip space of the light to the texture
+    // coordinates and the depths in [0, 1].
+    Eigen::Matrix4f texture_matrix = Eigen::Matrix4f::Identity();
+    texture_matrix.block<3, 3>(0, 0) *= 0.5f;
+    texture_matrix.block<3, 1>(0, 3).setConstant(0.5f);
+    const Eigen::Matrix4f shadow_matrix =
+        texture_matrix * light_view_projections_[i];
+    std::copy(shadow_matrix.data(), shadow_matrix.data() + 16,
+              block + 16 * i);
+    block[16 * kMaxNumShadowCascades + i] = split_distances_[i];
+  }
+  block[16 * kMaxNumShadowCascades + 4] = num_cascades_;
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, buffer_id_);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), block);
+  gl_state->BindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void ShadowCascades::AttachLayer(const GLenum target,
+                                 const GLuint framebuffer_id,
+                                 const GLuint texture_id,
+                                 const int layer) const {
+  glBindFramebuffer(target, framebuffer_id);
+  glFramebufferTextureLayer(target, GL_DEPTH_ATTACHMENT, texture_id, 0,
+                            layer);
+}
+
+void ShadowCascades::Render(RenderQueue* static_casters,
+                            RenderQueue* dynamic_casters,
+                            ShaderProgram* depth_program,
+                            const FrameUniforms* frame_uniforms) {
+  statistics_ = ShadowCascadesStatistics();
+  if (texture_id_ == 0) return;
+  GlStateCache* gl_state = GlStateCache::Current();
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  GLint draw_framebuffer_id = 0;
+  GLint read_framebuffer_id = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_framebuffer_id);
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_framebuffer_id);
+  glViewport(0, 0, resolution_, resolution_);
+  gl_state->SetCapability(GL_DEPTH_TEST, true);
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(kSlopeDepthBias, kConstantDepthBias);
+  for (int i = 0; i < num_cascades_; ++i) {
+    // The cached layer is drawn again only if the light view moved.
+    if (!static_valid_[i] ||
+        static_view_projections_[i] != light_view_projections_[i]) {
+      AttachLayer(GL_DRAW_FRAMEBUFFER, draw_framebuffer_id_,
+                  static_texture_id_, i);
+      gl_state->DepthMask(true);
+      glClear(GL_DEPTH_BUFFER_BIT);
+      if (static_casters != nullptr) {
+        cascade_uniforms_[i]->Bind();
+        static_casters->ExecuteDepthPrepass(depth_program);
+        statistics_.num_static_draws +=
+            static_casters->depth_prepass_statistics().num_draws;
+      }
+      static_view_projections_[i] = light_view_projections_[i];
+      static_valid_[i] = true;
+      ++statistics_.num_static_cascade_updates;
+    }
+    AttachLayer(GL_READ_FRAMEBUFFER, read_framebuffer_id_, static_texture_id_,
+                i);
+    AttachLayer(GL_DRAW_FRAMEBUFFER, draw_framebuffer_id_, texture_id_, i);
+    glBlitFramebuffer(0, 0, resolution_, resolution_, 0, 0, resolution_,
+                      resolution_, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    if (dynamic_casters != nullptr) {
+      cascade_uniforms_[i]->Bind();
+      dynamic_casters->ExecuteDepthPrepass(depth_program);
+      statistics_.num_dynamic_draws +=
+          dynamic_casters->depth_prepass_statistics().num_draws;
+    }
+  }
+  glDisable(GL_POLYGON_OFFSET_FILL);
+  gl_state->DepthMask(true);
+  gl_state->DepthFunc(GL_LESS);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_framebuffer_id);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer_id);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  frame_uniforms->Bind();
+}
+
+void ShadowCascades::InvalidateStaticCasters() {
+  std::fill(static_valid_.begin(), static_valid_.end(), false);
+}
+
+void ShadowCascades::Bind() const {
+  GlStateCache::Current()->BindBufferBase(
+      GL_UNIFORM_BUFFER, kShadowCascadesBindingPoint, buffer_id_);
+  glActiveTexture(GL_TEXTURE0 + kShadowCascadesTextureUnit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id_);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void ShadowCascades::Reset() {
+  if (texture_id_ != 0) {
+    const GLuint texture_ids[2] = {static_texture_id_, texture_id_};
+    glDeleteTextures(2, texture_ids);
+  }
+  static_texture_id_ = 0;
+  texture_id_ = 0;
+  if (draw_framebuffer_id_ != 0) glDeleteFramebuffers(1, &draw_framebuffer_id_);
+  if (read_framebuffer_id_ != 0) glDeleteFramebuffers(1, &read_framebuffer_id_);
+  draw_framebuffer_id_ = 0;
+  read_framebuffer_id_ = 0;
+  BufferAllocator::Get()->DeleteBuffer(&buffer_id_);
+  for (std::unique_ptr<FrameUniforms>& uniforms : cascade_uniforms_) {
+    uniforms.reset();
+  }
+  num_cascades_ = 0;
+  static_valid_.clear();
+}
+
+std::string ShadowCascades::GlslDeclaration() {
+  return std::string("layout (std140) uniform ") + kBlockName + " {\n"
+      "  mat4 shadow_matrices[" + std::to_string(kMaxNumShadowCascades) +
+      "];\n"
+      "  vec4 shadow_splits;\n"
+      "  vec4 shadow_parameters;\n"
+      "};\n"
+      "uniform sampler2DArrayShadow " + kSamplerName + ";\n"
+      "float ShadowVisibility(vec3 world_position, float view_depth) {\n"
+      "  int num_cascades = int(shadow_parameters.x);\n"
+      "  int cascade = 0;\n"
+      "  while (cascade < num_cascades &&\n"
+      "         view_depth > shadow_splits[cascade]) {\n"
+      "    ++cascade;\n"
+      "  }\n"
+      "  if (cascade == num_cascades) return 1.0;\n"
+      "  vec4 position =\n"
+      "      shadow_matrices[cascade] * vec4(world_position, 1.0);\n"
+      "  return texture(" + kSamplerName +
+      ", vec4(position.xy, float(cascade), position.z));\n"
+      "}\n";
+}
+
+}  // namespace wvu
@@ -0,0 +1,255 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SHADOW_CASCADES_H_
+#define GLUTILS_SHADOW_CASCADES_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include "frame_uniforms.h"
+#include "render_queue.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Uniform buffer binding point reserved for the matrices of the cascades.
+constexpr GLuint kShadowCascadesBindingPoint = 3;
+
+// Texture unit reserved for the depth texture array of the cascades.
+constexpr GLuint kShadowCascadesTextureUnit = 2;
+
+// Maximum number of cascades of a ShadowCascades.
+constexpr int kMaxNumShadowCascades = 4;
+
+// Default blend between the logarithmic (1) and the uniform (0) split of the
+// shadow distance into cascades.
+constexpr float kDefaultShadowSplitLambda = 0.75f;
+
+// Counters of the last ShadowCascades::Render().
+struct ShadowCascadesStatistics {
+  // Cascades whose static casters were drawn again.
+  int num_static_cascade_updates = 0;
+  int num_static_draws = 0;
+  int num_dynamic_draws = 0;
+};
+
+// This class renders the shadows of a directional light into cascaded shadow
+// maps: the view frustum, up to the shadow distance, is split into
+// num_cascades slices, and each slice gets its own orthographic light view,
+// drawn into a layer of a depth texture array. The casters are drawn by
+// RenderQueue::ExecuteDepthPrepass() with a depth-only program, e.g., the one
+// of the depth prepass, which reads the light matrices from a FrameUniforms
+// block bound in place of the one of the camera.
+//
+// The casters are split into two queues. The static casters of a cascade are
+// drawn into a cached layer, which is only drawn again when the light matrix of
+// the cascade changes, or after InvalidateStaticCasters(). Every frame the
+// cached layers are copied into the sampled layers, and only the dynamic
+// casters are drawn on top of them. The light view of a cascade bounds the
+// sphere enclosing its slice, whose radius does not change when the camera
+// rotates, and its center is snapped to a grid of an eighth of the cascade, so
+// the matrices only change when the light changes or the camera moves across
+// that grid. The snapping also keeps the shadow edges from shimmering.
+//
+// The shaders receiving the shadows include GlslDeclaration() right after
+// their #version line, of 330 or later, which declares:
+//
+//   // Returns the fraction of the light reaching a point in world space, at
+//   // the distance view_depth in front of the camera.
+//   float ShadowVisibility(vec3 world_position, float view_depth);
+//
+// Example:
+//
+// wvu::ShadowCascades shadows;
+// shadows.Initialize(2048, 4, &error_info_log);
+// frame_uniforms.Attach(&depth_program);
+// shadows.Attach(&shader_program);
+// while (...) {  // Rendering loop.
+//   frame_uniforms.Update(view, projection, time, delta_time);
+//   shadows.Update(view, projection, light_direction, 50.0f);
+//   shadows.Render(&static_casters, &dynamic_casters, &depth_program,
+//                  &frame_uniforms);
+//   shadows.Bind();
+//   ...  // Draws.
+// }
+//
+// Adding, removing or moving static casters needs:
+//
+// shadows.InvalidateStaticCasters();
+class ShadowCascades {
+ public:
+  // Names of the uniform block and of the sampler in the shaders.
+  static const char kBlockName[];
+  static const char kSamplerName[];
+
+  ShadowCascades();
+  ~ShadowCascades();
+
+  // Creates the depth textures, the framebuffers and the uniform buffers.
+  // Returns true if successful.
+  // Parameters:
+  //   resolution  The width and height in texels of every cascade.
+  //   num_cascades  The number of cascades, at most kMaxNumShadowCascades.
+  bool Initialize(const int resolution,
+                  const int num_cascades,
+                  std::string* error_info_log);
+
+  // Binds the block of a program declaring GlslDeclaration() and sets its
+  // sampler to kShadowCascadesTextureUnit. Returns false if the program does
+  // not declare them.
+  bool Attach(ShaderProgram* shader_program) const;
+
+  // Computes the splits and the light matrices of the cascades for a camera,
+  // and uploads the matrices of the receivers.
+  // Parameters:
+  //   view  The view matrix of the camera.
+  //   projection  A symmetric perspective projection, e.g., of
+  //     ComputeProjectionMatrix().
+  //   light_direction  The direction the light travels, in world space.
+  //   shadow_distance  The distance from the camera covered by the cascades,
+  //     clamped to the far plane.
+  void Update(const Eigen::Matrix4f& view,
+              const Eigen::Matrix4f& projection,
+              const Eigen::Vector3f& light_direction,
+              const float shadow_distance);
+
+  // Draws the casters into the cascades, and binds the frame uniforms back.
+  // Restores the viewport and the framebuffers, and leaves the depth writes on
+  // and the depth function GL_LESS.
+  // Parameters:
+  //   static_casters  The casters that do not move, or nullptr for none.
+  //   dynamic_casters  The casters drawn every frame, or nullptr for none.
+  //   depth_program  The program drawing the depths of the casters, attached
+  //     to the FrameUniforms block.
+  //   frame_uniforms  The uniforms of the camera, bound after the pass.
+  void Render(RenderQueue* static_casters,
+              RenderQueue* dynamic_casters,
+              ShaderProgram* depth_program,
+              const FrameUniforms* frame_uniforms);
+
+  // Draws the static casters again on the next Render(), e.g., after they
+  // were added, removed or moved.
+  void InvalidateStaticCasters();
+
+  // Binds the matrices and the depth textures for the next draws.
+  void Bind() const;
+
+  // Deletes the textures, the framebuffers and the buffers.
+  void Reset();
+
+  // Returns the GLSL declaration of the block and of ShadowVisibility().
+  static std::string GlslDeclaration();
+
+  int num_cascades() const {
+    return num_cascades_;
+  }
+
+  // Returns the matrix mapping world space to the clip space of the light view
+  // of a cascade.
+  const Eigen::Matrix4f& light_view_projection(const int cascade) const {
+    return light_view_projections_[cascade];
+  }
+
+  // Returns the distance from the camera where a cascade ends.
+  float split_distance(const int cascade) const {
+    return split_distances_[cascade];
+  }
+
+  void set_split_lambda(const float split_lambda) {
+    split_lambda_ = split_lambda;
+  }
+
+  // Sets the distance behind the light view of a cascade, towards the light,
+  // whose casters still shadow it. Defaults to the diameter of the cascade.
+  void set_caster_distance(const float caster_distance) {
+    caster_distance_ = caster_distance;
+  }
+
+  // Returns the id of the texture array sampled by the receivers.
+  GLuint texture_id() const {
+    return texture_id_;
+  }
+
+  const ShadowCascadesStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // Attaches a layer of a depth texture array to a framebuffer.
+  void AttachLayer(const GLenum target,
+                   const GLuint framebuffer_id,
+                   const GLuint texture_id,
+                   const int layer) const;
+
+  int resolution_;
+  int num_cascades_;
+  float split_lambda_;
+  // Negative for the diameter of the cascades.
+  float caster_distance_;
+  // The cached static depths and the sampled depths, both depth texture
+  // arrays of num_cascades_ layers.
+  GLuint static_texture_id_;
+  GLuint texture_id_;
+  GLuint draw_framebuffer_id_;
+  GLuint read_framebuffer_id_;
+  // The matrices and the splits of the receivers.
+  GLuint buffer_id_;
+  // The light matrices in the layout of the FrameUniforms block, one buffer
+  // per cascade.
+  std::unique_ptr<FrameUniforms> cascade_uniforms_[kMaxNumShadowCascades];
+  std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >
+      light_views_;
+  std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >
+      light_projections_;
+  std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >
+      light_view_projections_;
+  // The light matrices the cached layers were drawn with.
+  std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >
+      static_view_projections_;
+  // True if the cached layer of a cascade holds the static casters.
+  std::vector<bool> static_valid_;
+  std::vector<float> split_distances_;
+  ShadowCascadesStatistics statistics_;
+
+  ShadowCascades(const ShadowCascades&) = delete;
+  ShadowCascades& operator=(const ShadowCascades&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SHADOW_CASCADES_H_
@@ -0,0 +1,134 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "shared_vertex_arrays.h"
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "gl_state_cache.h"
+#include "gpu_mesh.h"
+#include "vertex_format.h"
+
+namespace wvu {
+
+SharedVertexArrays::SharedVertexArrays()
+    : last_vertex_array_(0), num_buffer_changes_(0) {}
+
+SharedVertexArrays::~SharedVertexArrays() {
+  Reset();
+}
+
+bool SharedVertexArrays::Supported() {
+  return GLEW_VERSION_4_3 || GLEW_ARB_vertex_attrib_binding;
+}
+
+SharedVertexArrays::SharedVertexArray* SharedVertexArrays::Find(
+    const VertexLayout& layout) {
+  const int num_vertex_arrays = vertex_arrays_.size();
+  for (int i = 0; i < num_vertex_arrays; ++i) {
+    const int index = (last_vertex_array_ + i) % num_vertex_arrays;
+    if (vertex_arrays_[index].layout == layout) {
+      last_vertex_array_ = index;
+      return &vertex_arrays_[index];
+    }
+  }
+  SharedVertexArray vertex_array;
+  vertex_array.layout = layout;
+  if (DirectStateAccessSupported()) {
+    glCreateVertexArrays(1, &vertex_array.vertex_array_object_id);
+    layout.SetVertexArrayFormat(vertex_array.vertex_array_object_id, 0);
+  } else {
+    GlStateCache* gl_state = GlStateCache::Current();
+    glGenVertexArrays(1, &vertex_array.vertex_array_object_id);
+    gl_state->BindVertexArray(vertex_array.vertex_array_object_id);
+    for (int i = 0; i < layout.num_attributes(); ++i) {
+      const VertexAttribute& attribute = layout.attribute(i);
+      glVertexAttribFormat(attribute.semantic, attribute.num_components,
+                           attribute.type, attribute.normalized,
+                           attribute.offset);
+      glVertexAttribBinding(attribute.semantic, 0);
+      glEnableVertexAttribArray(attribute.semantic);
+    }
+    gl_state->BindVertexArray(0);
+  }
+  vertex_arrays_.push_back(vertex_array);
+  last_vertex_array_ = vertex_arrays_.size() - 1;
+  return &vertex_arrays_.back();
+}
+
+GLuint SharedVertexArrays::VertexArray(const VertexLayout& layout) {
+  return Find(layout)->vertex_array_object_id;
+}
+
+GLuint SharedVertexArrays::Bind(const GpuMesh& mesh) {
+  SharedVertexArray* vertex_array = Find(mesh.vertex_layout());
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindVertexArray(vertex_array->vertex_array_object_id);
+  if (vertex_array->vertex_buffer_object_id !=
+      mesh.vertex_buffer_object_id()) {
+    vertex_array->vertex_buffer_object_id = mesh.vertex_buffer_object_id();
+    glBindVertexBuffer(0, vertex_array->vertex_buffer_object_id, 0,
+                       vertex_array->layout.stride());
+    ++num_buffer_changes_;
+  }
+  // The element buffer binding is part of the vertex array state.
+  if (vertex_array->element_buffer_object_id !=
+      mesh.element_buffer_object_id()) {
+    vertex_array->element_buffer_object_id = mesh.element_buffer_object_id();
+    gl_state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                         vertex_array->element_buffer_object_id);
+    ++num_buffer_changes_;
+  }
+  return vertex_array->vertex_array_object_id;
+}
+
+void SharedVertexArrays::InvalidateBindings() {
+  for (SharedVertexArray& vertex_array : vertex_arrays_) {
+    vertex_array.vertex_buffer_object_id = 0;
+    vertex_array.element_buffer_object_id = 0;
+  }
+}
+
+void SharedVertexArrays::Reset() {
+  for (SharedVertexArray& vertex_array : vertex_arrays_) {
+    GlStateCache::Current()->DeleteVertexArrays(
+        1, &vertex_array.vertex_array_object_id);
+  }
+  vertex_arrays_.clear();
+  last_vertex_array_ = 0;
+}
+
+}  // namespace wvu
@@ -0,0 +1,131 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SHARED_VERTEX_ARRAYS_H_
+#define GLUTILS_SHARED_VERTEX_ARRAYS_H_
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "gpu_mesh.h"
+#include "vertex_format.h"
+
+namespace wvu {
+// This class keeps one vertex array object per vertex layout, instead of one
+// per mesh. With GL_ARB_vertex_attrib_binding (OpenGL 4.3), the format of the
+// attributes is set once per layout, and reads the vertices from a vertex
+// buffer binding point, so drawing another mesh of the same layout only
+// rebinds its vertex buffer with glBindVertexBuffer() and its element buffer,
+// which are cheaper than switching the whole vertex array object. Meshes
+// sharing their buffers, e.g., the ranges of a mega-buffer, rebind nothing.
+//
+// The vertex arrays read the vertices from binding point 0, and leave the
+// other binding points to the instanced attributes (see InstanceBuffer). The
+// objects are deleted with the class, which must happen while the context is
+// current; vertex array objects are not shared between contexts.
+//
+// Example:
+//
+// wvu::SharedVertexArrays vertex_arrays;
+// while (...) {  // Rendering loop.
+//   for (const wvu::GpuMesh& mesh : meshes) {
+//     vertex_arrays.Bind(mesh);
+//     glDrawElements(...);
+//   }
+// }
+class SharedVertexArrays {
+ public:
+  SharedVertexArrays();
+  ~SharedVertexArrays();
+
+  // Binds the vertex array object of the layout of the mesh, and binds the
+  // buffers of the mesh to it if they differ from the last ones. Returns the
+  // vertex array object.
+  GLuint Bind(const GpuMesh& mesh);
+
+  // Returns the vertex array object of the layout, creating it the first
+  // time, without binding it.
+  GLuint VertexArray(const VertexLayout& layout);
+
+  // Forgets the buffers bound to the vertex array objects, so that the next
+  // Bind() binds them again. Deleted buffers stay attached to the vertex array
+  // objects that are not bound, and new buffers may reuse their ids, so this
+  // is called once per frame, e.g., by the render queue.
+  void InvalidateBindings();
+
+  // Deletes the vertex array objects.
+  void Reset();
+
+  // Returns true if the context supports separate attribute formats.
+  static bool Supported();
+
+  int num_vertex_arrays() const {
+    return vertex_arrays_.size();
+  }
+
+  // Returns the number of times Bind() switched the vertex buffer or the
+  // element buffer of a vertex array object.
+  int num_buffer_changes() const {
+    return num_buffer_changes_;
+  }
+
+  void reset_num_buffer_changes() {
+    num_buffer_changes_ = 0;
+  }
+
+ private:
+  struct SharedVertexArray {
+    VertexLayout layout;
+    GLuint vertex_array_object_id = 0;
+    // The buffers bound to the vertex array object.
+    GLuint vertex_buffer_object_id = 0;
+    GLuint element_buffer_object_id = 0;
+  };
+
+  // Returns the entry of the layout, creating it the first time.
+  SharedVertexArray* Find(const VertexLayout& layout);
+
+  // Few layouts are in use, so they are searched linearly, from the last one
+  // found.
+  std::vector<SharedVertexArray> vertex_arrays_;
+  int last_vertex_array_;
+  int num_buffer_changes_;
+
+  SharedVertexArrays(const SharedVertexArrays&) = delete;
+  SharedVertexArrays& operator=(const SharedVertexArrays&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SHARED_VERTEX_ARRAYS_H_
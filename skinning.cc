@@ -0,0 +1,399 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "skinning.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "gpu_mesh.h"
+#include "job_system.h"
+#include "model.h"
+#include "quaternion_interpolation.h"
+#include "shader_program.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+// Number of poses of a palette job.
+constexpr int kPosesPerJob = 4;
+// Size of the work groups of the skinning shader.
+constexpr int kSkinningGroupSize = 64;
+// Words of a SkinnedVertex, read by the skinning shader.
+constexpr int kSkinnedVertexWords = 10;
+static_assert(sizeof(SkinnedVertex) == kSkinnedVertexWords * sizeof(GLuint),
+              "The skinning shader reads SkinnedVertex as 10 words.");
+
+// The vertices written by the skinning shader.
+struct PreSkinnedVertex {
+  GLfloat position[3];
+  GLfloat normal[3];
+  GLfloat texcoord[2];
+
+  static VertexLayout Layout() {
+    VertexLayout layout(sizeof(PreSkinnedVertex));
+    layout.AddAttribute(POSITION, 3, GL_FLOAT, GL_FALSE,
+                        offsetof(PreSkinnedVertex, position));
+    layout.AddAttribute(NORMAL, 3, GL_FLOAT, GL_FALSE,
+                        offsetof(PreSkinnedVertex, normal));
+    layout.AddAttribute(TEXCOORD, 2, GL_FLOAT, GL_FALSE,
+                        offsetof(PreSkinnedVertex, texcoord));
+    return layout;
+  }
+};
+
+// Skins the vertices of the bind pose into the vertices of the skinned mesh,
+// both read as arrays of words.
+const char kSkinningShaderHeader[] =
+    "#version 430\n"
+    "layout (local_size_x = 64) in;\n";
+
+const char kSkinningShader[] =
+    "layout (std430, binding = 0) readonly buffer BindPose {\n"
+    "  uint bind_pose[];\n"
+    "};\n"
+    "layout (std430, binding = 1) writeonly buffer Skinned {\n"
+    "  float skinned[];\n"
+    "};\n"
+    "uniform int first_joint;\n"
+    "uniform int num_vertices;\n"
+    "void main() {\n"
+    "  int i = int(gl_GlobalInvocationID.x);\n"
+    "  if (i >= num_vertices) return;\n"
+    "  int source = 10 * i;\n"
+    "  vec3 position = uintBitsToFloat(uvec3(\n"
+    "      bind_pose[source], bind_pose[source + 1], bind_pose[source + 2]));\n"
+    "  vec3 normal = uintBitsToFloat(uvec3(\n"
+    "      bind_pose[source + 3], bind_pose[source + 4],\n"
+    "      bind_pose[source + 5]));\n"
+    "  uint packed_joints = bind_pose[source + 8];\n"
+    "  vec4 joints = vec4(uvec4(packed_joints, packed_joints >> 8,\n"
+    "                           packed_joints >> 16, packed_joints >> 24) &\n"
+    "                     uvec4(0xFFu));\n"
+    "  vec4 weights = unpackUnorm4x8(bind_pose[source + 9]);\n"
+    "  position =\n"
+    "      SkinPoint(first_joint, joints, weights, vec4(position, 1.0));\n"
+    "  normal = normalize(\n"
+    "      SkinPoint(first_joint, joints, weights, vec4(normal, 0.0)));\n"
+    "  int destination = 8 * i;\n"
+    "  skinned[destination] = position.x;\n"
+    "  skinned[destination + 1] = position.y;\n"
+    "  skinned[destination + 2] = position.z;\n"
+    "  skinned[destination + 3] = normal.x;\n"
+    "  skinned[destination + 4] = normal.y;\n"
+    "  skinned[destination + 5] = normal.z;\n"
+    "  skinned[destination + 6] = uintBitsToFloat(bind_pose[source + 6]);\n"
+    "  skinned[destination + 7] = uintBitsToFloat(bind_pose[source + 7]);\n"
+    "}\n";
+
+}  // namespace
+
+const char JointPalettes::kBlockName[] = "JointPalettes";
+
+void BlendPoses(const SkeletonPose& from,
+                const SkeletonPose& to,
+                const float t,
+                SkeletonPose* result) {
+  const int num_joints = from.rotations.size();
+  result->resize(num_joints);
+  InterpolateQuaternions(from.rotations.data(), to.rotations.data(),
+                         num_joints, t, NLERP, result->rotations.data());
+  for (int i = 0; i < num_joints; ++i) {
+    result->translations[i] =
+        from.translations[i] + t * (to.translations[i] - from.translations[i]);
+  }
+}
+
+void ComputeJointPalette(const Skeleton& skeleton,
+                         const SkeletonPose& pose,
+                         JointTransforms* joint_transforms,
+                         GLfloat* palette) {
+  const int num_joints = skeleton.num_joints();
+  joint_transforms->resize(num_joints);
+  ComputeRigidTransforms(pose.rotations.data(), pose.translations.data(),
+                         num_joints, joint_transforms->data());
+  typedef Eigen::Matrix<float, 3, 4, Eigen::RowMajor> PaletteJoint;
+  for (int i = 0; i < num_joints; ++i) {
+    Eigen::Matrix4f& transform = (*joint_transforms)[i];
+    // The parents precede their children, so theirs are already chained.
+    const int parent = skeleton.parents[i];
+    if (parent >= 0) transform = (*joint_transforms)[parent] * transform;
+    Eigen::Map<PaletteJoint>(palette + i * kJointPaletteStride) =
+        (transform * skeleton.inverse_bind_poses[i]).topRows<3>();
+  }
+}
+
+JointPalettes::JointPalettes()
+    : storage_(false), max_num_joints_(0), num_joints_(0), buffer_id_(0) {}
+
+JointPalettes::~JointPalettes() {
+  Reset();
+}
+
+bool JointPalettes::StorageSupported() {
+  return GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object;
+}
+
+bool JointPalettes::Initialize(const int max_num_joints,
+                               std::string* error_info_log) {
+  if (buffer_id_ != 0) {
+    *error_info_log = "The joint palettes are already initialized.";
+    return false;
+  }
+  storage_ = StorageSupported();
+  if (max_num_joints <= 0 ||
+      (!storage_ && max_num_joints > kMaxNumUniformBlockJoints)) {
+    *error_info_log = "Invalid number of joints: " +
+        std::to_string(max_num_joints) + ". Uniform blocks hold at most " +
+        std::to_string(kMaxNumUniformBlockJoints) + " joints.";
+    return false;
+  }
+  max_num_joints_ = max_num_joints;
+  BufferAllocator* allocator = BufferAllocator::Get();
+  buffer_id_ = allocator->CreateBuffer(storage_ ? STORAGE_DATA : UNIFORM_DATA);
+  if (buffer_id_ == 0) {
+    *error_info_log = "Could not create the joint palette buffer.";
+    return false;
+  }
+  // A uniform buffer must hold the whole array of the block.
+  const GLenum target = storage_ ? GL_SHADER_STORAGE_BUFFER : GL_UNIFORM_BUFFER;
+  const int num_buffer_joints =
+      storage_ ? max_num_joints_ : kMaxNumUniformBlockJoints;
+  GlStateCache::Current()->BindBuffer(target, buffer_id_);
+  allocator->BufferData(buffer_id_, target,
+                        num_buffer_joints * kJointPaletteStride *
+                        sizeof(GLfloat), nullptr, GL_STREAM_DRAW);
+  GlStateCache::Current()->BindBuffer(target, 0);
+  return true;
+}
+
+bool JointPalettes::Attach(ShaderProgram* shader_program) const {
+  return storage_ ?
+      shader_program->BindShaderStorageBlock(kBlockName,
+                                             kJointPaletteStorageBindingPoint) :
+      shader_program->BindUniformBlock(kBlockName, kJointPaletteBindingPoint);
+}
+
+void JointPalettes::Update(const Skeleton& skeleton,
+                           const SkeletonPose* poses,
+                           const int num_poses,
+                           JobSystem* job_system) {
+  const int num_joints = skeleton.num_joints();
+  num_joints_ = 0;
+  if (buffer_id_ == 0 || num_joints == 0) return;
+  const int num_palettes = std::min(num_poses, max_num_joints_ / num_joints);
+  num_joints_ = num_palettes * num_joints;
+  palettes_.resize(num_joints_ * kJointPaletteStride);
+  if (num_palettes == 0) return;
+  const int num_threads = job_system != nullptr ? job_system->num_threads() : 1;
+  if (static_cast<int>(joint_transforms_.size()) < num_threads) {
+    joint_transforms_.resize(num_threads);
+  }
+  const auto compute = [&](const int begin, const int end) {
+    JointTransforms* joint_transforms = &joint_transforms_[
+        job_system != nullptr ? job_system->CurrentThreadIndex() : 0];
+    for (int i = begin; i < end; ++i) {
+      ComputeJointPalette(skeleton, poses[i], joint_transforms,
+                          palettes_.data() + i * num_joints *
+                          kJointPaletteStride);
+    }
+  };
+  if (job_system != nullptr) {
+    job_system->ParallelFor(num_palettes, kPosesPerJob, compute);
+  } else {
+    compute(0, num_palettes);
+  }
+
+  const GLenum target = storage_ ? GL_SHADER_STORAGE_BUFFER : GL_UNIFORM_BUFFER;
+  const int num_buffer_joints =
+      storage_ ? max_num_joints_ : kMaxNumUniformBlockJoints;
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(target, buffer_id_);
+  BufferAllocator::Get()->BufferData(
+      buffer_id_, target,
+      num_buffer_joints * kJointPaletteStride * sizeof(GLfloat), nullptr,
+      GL_STREAM_DRAW);
+  glBufferSubData(target, 0, palettes_.size() * sizeof(GLfloat),
+                  palettes_.data());
+  gl_state->BindBuffer(target, 0);
+}
+
+void JointPalettes::Bind() const {
+  if (storage_) {
+    GlStateCache::Current()->BindBufferBase(
+        GL_SHADER_STORAGE_BUFFER, kJointPaletteStorageBindingPoint,
+        buffer_id_);
+  } else {
+    GlStateCache::Current()->BindBufferBase(
+        GL_UNIFORM_BUFFER, kJointPaletteBindingPoint, buffer_id_);
+  }
+}
+
+void JointPalettes::Reset() {
+  BufferAllocator::Get()->DeleteBuffer(&buffer_id_);
+  max_num_joints_ = 0;
+  num_joints_ = 0;
+  palettes_.clear();
+}
+
+std::string JointPalettes::GlslDeclaration() {
+  std::string declaration;
+  if (StorageSupported()) {
+    declaration = std::string(
+        "#extension GL_ARB_shader_storage_buffer_object : enable\n"
+        "layout (std430) readonly buffer ") + kBlockName + " {\n"
+        "  vec4 joint_rows[];\n"
+        "};\n";
+  } else {
+    declaration = std::string("layout (std140) uniform ") + kBlockName +
+        " {\n"
+        "  vec4 joint_rows[" + std::to_string(3 * kMaxNumUniformBlockJoints) +
+        "];\n"
+        "};\n";
+  }
+  return declaration +
+      "vec3 SkinPoint(int first_joint, vec4 joints, vec4 weights,\n"
+      "               vec4 point) {\n"
+      "  vec3 result = vec3(0.0);\n"
+      "  for (int i = 0; i < 4; ++i) {\n"
+      "    int row = 3 * (first_joint + int(joints[i]));\n"
+      "    result += weights[i] * vec3(dot(joint_rows[row], point),\n"
+      "                                dot(joint_rows[row + 1], point),\n"
+      "                                dot(joint_rows[row + 2], point));\n"
+      "  }\n"
+      "  return result;\n"
+      "}\n";
+}
+
+PreSkinnedMesh::PreSkinnedMesh()
+    : bind_pose_buffer_id_(0), num_vertices_(0) {}
+
+PreSkinnedMesh::~PreSkinnedMesh() {
+  Reset();
+}
+
+bool PreSkinnedMesh::Supported() {
+  return (GLEW_VERSION_4_3 || GLEW_ARB_compute_shader) &&
+      (GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object);
+}
+
+bool PreSkinnedMesh::Initialize(const Model& model,
+                                std::string* error_info_log) {
+  if (mesh_.valid()) {
+    *error_info_log = "The skinned mesh is already initialized.";
+    return false;
+  }
+  if (!Supported()) {
+    *error_info_log = "Skinning in compute shaders needs OpenGL 4.3.";
+    return false;
+  }
+  const SkinnedVertex* vertices = model.vertices<SkinnedVertex>();
+  if (vertices == nullptr || model.cpu_data_released()) {
+    *error_info_log =
+        "The model must keep its vertices, with the SkinnedVertex layout.";
+    return false;
+  }
+  skinning_program_.LoadComputeShaderFromString(
+      std::string(kSkinningShaderHeader) + JointPalettes::GlslDeclaration() +
+      kSkinningShader);
+  if (!skinning_program_.Create(error_info_log) ||
+      !skinning_program_.BindShaderStorageBlock(
+          JointPalettes::kBlockName, kJointPaletteStorageBindingPoint)) {
+    return false;
+  }
+
+  // The skinned mesh starts in the bind pose.
+  num_vertices_ = model.num_vertices();
+  std::vector<PreSkinnedVertex> skinned_vertices(num_vertices_);
+  for (int i = 0; i < num_vertices_; ++i) {
+    std::copy(vertices[i].position, vertices[i].position + 3,
+              skinned_vertices[i].position);
+    std::copy(vertices[i].normal, vertices[i].normal + 3,
+              skinned_vertices[i].normal);
+    std::copy(vertices[i].texcoord, vertices[i].texcoord + 2,
+              skinned_vertices[i].texcoord);
+  }
+  Model skinned_model(model.orientation(), model.position(), skinned_vertices);
+  skinned_model.SetIndices(model.indices(), model.primitive_type());
+  skinned_model.set_closed(model.closed());
+  // A single copy: the shader writes it after the draws of the previous
+  // frame in the order of the commands, without waiting on the CPU.
+  mesh_ = SetDynamicVertexArrayObject(skinned_model, 1);
+
+  BufferAllocator* allocator = BufferAllocator::Get();
+  bind_pose_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, bind_pose_buffer_id_);
+  allocator->BufferData(bind_pose_buffer_id_, GL_SHADER_STORAGE_BUFFER,
+                        model.vertex_data().size(), model.vertex_data().data(),
+                        GL_STATIC_DRAW);
+  gl_state->BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  if (bind_pose_buffer_id_ == 0 || !mesh_.valid()) {
+    *error_info_log = "Could not create the skinning buffers.";
+    Reset();
+    return false;
+  }
+  return true;
+}
+
+void PreSkinnedMesh::Skin(const JointPalettes& palettes,
+                          const int first_joint) {
+  if (!mesh_.valid()) return;
+  GlStateCache* gl_state = GlStateCache::Current();
+  skinning_program_.Use();
+  skinning_program_.SetUniform("first_joint", static_cast<GLint>(first_joint));
+  skinning_program_.SetUniform("num_vertices",
+                               static_cast<GLint>(num_vertices_));
+  palettes.Bind();
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, bind_pose_buffer_id_);
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1,
+                           mesh_.vertex_buffer_object_id());
+  skinning_program_.Dispatch(
+      (num_vertices_ + kSkinningGroupSize - 1) / kSkinningGroupSize, 1, 1,
+      GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void PreSkinnedMesh::Reset() {
+  BufferAllocator::Get()->DeleteBuffer(&bind_pose_buffer_id_);
+  mesh_.Reset();
+  num_vertices_ = 0;
+}
+
+}  // namespace wvu
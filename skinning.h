@@ -0,0 +1,278 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SKINNING_H_
+#define GLUTILS_SKINNING_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include "gpu_mesh.h"
+#include "job_system.h"
+#include "model.h"
+#include "quaternion_interpolation.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Uniform block binding point of the joint palettes when shader storage
+// buffers are not supported.
+constexpr GLuint kJointPaletteBindingPoint = 4;
+
+// Shader storage buffer binding point of the joint palettes.
+constexpr GLuint kJointPaletteStorageBindingPoint = 6;
+
+// Number of floats of a joint of a palette: the three rows of its affine
+// transform.
+constexpr int kJointPaletteStride = 12;
+
+// Number of joints of the palettes in a uniform block. They take 12 KB, below
+// the 16 KB that every implementation supports.
+constexpr int kMaxNumUniformBlockJoints = 256;
+
+// Contiguous array of joint transforms. Eigen requires an aligned allocator
+// for the vectorizable Matrix4f.
+typedef std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >
+    JointTransforms;
+
+// The joints of a skinned mesh.
+struct Skeleton {
+  // The parent of every joint, or -1 for the roots. The parents precede their
+  // children.
+  std::vector<int> parents;
+  // The transforms from the model space to the space of every joint in the
+  // bind pose, i.e., the inverses of the bind poses of the joints.
+  JointTransforms inverse_bind_poses;
+
+  int num_joints() const {
+    return parents.size();
+  }
+};
+
+// The rotations and translations of the joints of a skeleton relative to
+// their parents, e.g., a keyframe of an animation.
+struct SkeletonPose {
+  Quaternions rotations;
+  std::vector<Eigen::Vector3f> translations;
+
+  void resize(const int num_joints) {
+    rotations.resize(num_joints, Eigen::Quaternionf::Identity());
+    translations.resize(num_joints, Eigen::Vector3f::Zero());
+  }
+};
+
+// Blends two poses of a skeleton, e.g., the keyframes around the time of an
+// animation, interpolating the rotations with NLERP (see
+// InterpolateQuaternions()) and the translations linearly. result may alias
+// from or to.
+void BlendPoses(const SkeletonPose& from,
+                const SkeletonPose& to,
+                const float t,
+                SkeletonPose* result);
+
+// Computes the joint palette of a pose: the transforms of the skinned
+// vertices from the bind pose to the pose, for every joint. The local
+// transforms are computed with the batched ComputeRigidTransforms(), then
+// chained from the roots and multiplied by the inverse bind poses.
+// Parameters:
+//   skeleton  The joints.
+//   pose  The pose of the joints.
+//   joint_transforms  The scratch storage of the transforms of the joints.
+//   palette  The kJointPaletteStride floats of every joint: the rows of the
+//     top 3x4 block of its transform.
+void ComputeJointPalette(const Skeleton& skeleton,
+                         const SkeletonPose& pose,
+                         JointTransforms* joint_transforms,
+                         GLfloat* palette);
+
+// This class holds the joint palettes of the skinned meshes of a frame in a
+// buffer that the shaders read, a shader storage buffer with OpenGL 4.3 or
+// ARB_shader_storage_buffer_object, and a uniform buffer of at most
+// kMaxNumUniformBlockJoints joints otherwise. Every joint takes three vec4
+// rows, which is the same layout in std140 and std430, so both blocks share
+// the buffer and the code. The palettes of many poses are computed in parallel
+// with the jobs of a JobSystem, and uploaded at once.
+//
+// The vertex shaders include GlslDeclaration(), which declares:
+//
+//   // Returns point (a position with w = 1, or a normal with w = 0) skinned
+//   // by the palette starting at first_joint.
+//   vec3 SkinPoint(int first_joint, vec4 joints, vec4 weights, vec4 point);
+//
+// The normals are transformed like the positions, which is exact for the
+// rigid transforms of the poses.
+//
+// Example:
+//
+// wvu::JointPalettes palettes;
+// palettes.Initialize(num_characters * skeleton.num_joints(),
+//                     &error_info_log);
+// palettes.Attach(&skinning_program);
+// while (...) {  // Rendering loop.
+//   ...  // Blend the poses of the characters.
+//   palettes.Update(skeleton, poses.data(), poses.size(), &job_system);
+//   palettes.Bind();
+//   for (int i = 0; i < num_characters; ++i) {
+//     skinning_program.SetUniform("first_joint",
+//                                 i * skeleton.num_joints());
+//     wvu::Draw(character_mesh);
+//   }
+// }
+class JointPalettes {
+ public:
+  // Name of the palette block in the shaders.
+  static const char kBlockName[];
+
+  JointPalettes();
+  ~JointPalettes();
+
+  // Creates the buffer of the palettes. Returns true if successful.
+  // Parameters:
+  //   max_num_joints  The number of joints of all the palettes of a frame.
+  bool Initialize(const int max_num_joints, std::string* error_info_log);
+
+  // Binds the palette block of a program declaring GlslDeclaration(). Returns
+  // false if the program does not declare it.
+  bool Attach(ShaderProgram* shader_program) const;
+
+  // Computes and uploads the palettes of the poses of a skeleton, one after
+  // the other, so that the palette of poses[i] starts at the joint
+  // i * skeleton.num_joints(). The poses beyond the capacity are dropped. The
+  // buffer is orphaned, so the upload does not wait for the previous draws.
+  // Parameters:
+  //   skeleton  The joints of the poses.
+  //   poses  The poses.
+  //   num_poses  The number of poses.
+  //   job_system  The job system computing one pose per job, or nullptr to
+  //     compute them on the calling thread.
+  void Update(const Skeleton& skeleton,
+              const SkeletonPose* poses,
+              const int num_poses,
+              JobSystem* job_system);
+
+  // Binds the palettes for the next draws and dispatches.
+  void Bind() const;
+
+  // Deletes the buffer.
+  void Reset();
+
+  // Returns the GLSL declaration of SkinPoint() for the path supported by the
+  // context.
+  static std::string GlslDeclaration();
+
+  // Returns true if the palettes are in a shader storage buffer.
+  static bool StorageSupported();
+
+  // Returns the number of joints of the last Update().
+  int num_joints() const {
+    return num_joints_;
+  }
+
+  // Returns the palettes of the last Update().
+  const std::vector<GLfloat>& palettes() const {
+    return palettes_;
+  }
+
+ private:
+  bool storage_;
+  int max_num_joints_;
+  int num_joints_;
+  GLuint buffer_id_;
+  std::vector<GLfloat> palettes_;
+  // The scratch transforms of every thread of the job system.
+  std::vector<JointTransforms> joint_transforms_;
+
+  JointPalettes(const JointPalettes&) = delete;
+  JointPalettes& operator=(const JointPalettes&) = delete;
+};
+
+// This class skins the vertices of a mesh in a compute shader into a mesh of
+// its own, once per frame, so that all the passes drawing the mesh, e.g., the
+// shadow cascades and the main pass, draw the same skinned vertices without
+// skinning them again. The skinned mesh has float positions, normals and
+// texture coordinates, and is drawn like any other GpuMesh, e.g., through a
+// RenderQueue. It needs compute shaders and shader storage buffers (see
+// Supported()).
+//
+// Example:
+//
+// wvu::PreSkinnedMesh character;
+// character.Initialize(model, &error_info_log);  // SkinnedVertex layout.
+// while (...) {  // Rendering loop.
+//   palettes.Update(skeleton, &pose, 1, &job_system);
+//   character.Skin(palettes, 0);
+//   shadows.Render(..., &casters, ...);  // Items drawing character.mesh().
+//   render_queue.Execute();
+// }
+class PreSkinnedMesh {
+ public:
+  PreSkinnedMesh();
+  ~PreSkinnedMesh();
+
+  // Uploads the vertices of the model, which must have the layout of
+  // SkinnedVertex and keep its CPU data, creates the skinned mesh with the
+  // indices of the model, and compiles the program. Returns true if
+  // successful.
+  bool Initialize(const Model& model, std::string* error_info_log);
+
+  // Skins the vertices with the palette starting at first_joint. The vertex
+  // reads of the next draws wait for the writes.
+  void Skin(const JointPalettes& palettes, const int first_joint);
+
+  // Deletes the buffers and the skinned mesh.
+  void Reset();
+
+  // Returns true if compute shaders and shader storage buffers are supported.
+  static bool Supported();
+
+  // Returns the skinned mesh.
+  const GpuMesh& mesh() const {
+    return mesh_;
+  }
+
+ private:
+  ShaderProgram skinning_program_;
+  GLuint bind_pose_buffer_id_;
+  int num_vertices_;
+  GpuMesh mesh_;
+
+  PreSkinnedMesh(const PreSkinnedMesh&) = delete;
+  PreSkinnedMesh& operator=(const PreSkinnedMesh&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SKINNING_H_
@@ -0,0 +1,181 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "spatial_hash.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <Eigen/Core>
+
+#include "assignment.h"
+#include "job_system.h"
+
+namespace wvu {
+
+SpatialHash::SpatialHash(const float cell_size)
+    : cell_size_(cell_size),
+      inverse_cell_size_(1.0f / cell_size),
+      x_bits_(0),
+      y_bits_(0),
+      x_mask_(0),
+      y_mask_(0),
+      z_mask_(0),
+      bucket_starts_(1, 0) {}
+
+void SpatialHash::Build(const Vector3fArray& positions,
+                        JobSystem* job_system) {
+  const int num_objects = positions.size();
+  // The bits of the buckets are shared among the axes in proportion to the
+  // number of cells the objects span along them, so that a flat scene does not
+  // fold its cells into a few buckets. Ties go to x, since the rows along x
+  // are read at once.
+  int num_bits = 0;
+  while ((1 << num_bits) < num_objects) ++num_bits;
+  float extents[3] = {1.0f, 1.0f, 1.0f};
+  if (num_objects > 0) {
+    const auto minmax_x = std::minmax_element(positions.x.begin(),
+                                              positions.x.end());
+    const auto minmax_y = std::minmax_element(positions.y.begin(),
+                                              positions.y.end());
+    const auto minmax_z = std::minmax_element(positions.z.begin(),
+                                              positions.z.end());
+    extents[0] += (*minmax_x.second - *minmax_x.first) * inverse_cell_size_;
+    extents[1] += (*minmax_y.second - *minmax_y.first) * inverse_cell_size_;
+    extents[2] += (*minmax_z.second - *minmax_z.first) * inverse_cell_size_;
+  }
+  int bits[3] = {0, 0, 0};
+  for (int bit = 0; bit < num_bits; ++bit) {
+    int axis = 0;
+    for (int i = 1; i < 3; ++i) {
+      if (extents[i] > extents[axis]) axis = i;
+    }
+    ++bits[axis];
+    extents[axis] *= 0.5f;
+  }
+  x_bits_ = bits[0];
+  y_bits_ = bits[1];
+  x_mask_ = (1 << bits[0]) - 1;
+  y_mask_ = (1 << bits[1]) - 1;
+  z_mask_ = (1 << bits[2]) - 1;
+  const int num_buckets = 1 << num_bits;
+  sorted_objects_.resize(num_objects);
+  sorted_positions_.resize(num_objects);
+  object_buckets_.resize(num_objects);
+  bucket_starts_.resize(num_buckets + 1);
+  if (num_objects == 0) return;
+
+  // Every chunk counts its objects per bucket, in its own histogram.
+  const int num_chunks = job_system == nullptr ? 1 :
+      std::max(1, std::min(job_system->num_threads(),
+                           num_objects / kMinSpatialHashChunkObjects));
+  const int chunk_size = (num_objects + num_chunks - 1) / num_chunks;
+  histograms_.resize(static_cast<size_t>(num_chunks) * num_buckets);
+  const auto parallel_for = [&](const int num_elements,
+                                const std::function<void(int, int)>& function) {
+    if (num_chunks == 1) {
+      function(0, num_elements);
+    } else {
+      job_system->ParallelFor(num_elements,
+                              (num_elements + num_chunks - 1) / num_chunks,
+                              function);
+    }
+  };
+  parallel_for(num_chunks, [&](const int begin, const int end) {
+    for (int chunk = begin; chunk < end; ++chunk) {
+      int* histogram = histograms_.data() +
+          static_cast<size_t>(chunk) * num_buckets;
+      std::fill(histogram, histogram + num_buckets, 0);
+      const int last = std::min((chunk + 1) * chunk_size, num_objects);
+      for (int i = chunk * chunk_size; i < last; ++i) {
+        const int bucket = Bucket(Cell(positions.x[i]), Cell(positions.y[i]),
+                                  Cell(positions.z[i]));
+        object_buckets_[i] = bucket;
+        ++histogram[bucket];
+      }
+    }
+  });
+
+  // The offsets of the chunks within every bucket, and the sizes of the
+  // buckets, summed into their starts.
+  parallel_for(num_buckets, [&](const int begin, const int end) {
+    for (int bucket = begin; bucket < end; ++bucket) {
+      int offset = 0;
+      for (int chunk = 0; chunk < num_chunks; ++chunk) {
+        int& count =
+            histograms_[static_cast<size_t>(chunk) * num_buckets + bucket];
+        const int chunk_count = count;
+        count = offset;
+        offset += chunk_count;
+      }
+      bucket_starts_[bucket + 1] = offset;
+    }
+  });
+  bucket_starts_[0] = 0;
+  for (int bucket = 0; bucket < num_buckets; ++bucket) {
+    bucket_starts_[bucket + 1] += bucket_starts_[bucket];
+  }
+
+  // Every chunk scatters its objects after those of the previous chunks, so
+  // the objects of a bucket stay in increasing order.
+  parallel_for(num_chunks, [&](const int begin, const int end) {
+    for (int chunk = begin; chunk < end; ++chunk) {
+      int* offsets = histograms_.data() +
+          static_cast<size_t>(chunk) * num_buckets;
+      const int last = std::min((chunk + 1) * chunk_size, num_objects);
+      for (int i = chunk * chunk_size; i < last; ++i) {
+        const int bucket = object_buckets_[i];
+        const int sorted_index = bucket_starts_[bucket] + offsets[bucket]++;
+        sorted_objects_[sorted_index] = i;
+        sorted_positions_.x[sorted_index] = positions.x[i];
+        sorted_positions_.y[sorted_index] = positions.y[i];
+        sorted_positions_.z[sorted_index] = positions.z[i];
+      }
+    }
+  });
+}
+
+int SpatialHash::QueryRadius(const Eigen::Vector3f& point,
+                             const float radius,
+                             std::vector<int>* objects) const {
+  const int num_objects_before = objects->size();
+  ForEachNeighbor(point, radius,
+                  [objects](const int object, const float squared_distance) {
+    objects->push_back(object);
+  });
+  return objects->size() - num_objects_before;
+}
+
+}  // namespace wvu
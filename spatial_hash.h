@@ -0,0 +1,244 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_SPATIAL_HASH_H_
+#define GLUTILS_SPATIAL_HASH_H_
+
+#include <cmath>
+#include <vector>
+#include <Eigen/Core>
+
+#include "assignment.h"
+#include "job_system.h"
+
+namespace wvu {
+// Objects per chunk of the build of a SpatialHash. Fewer objects are counted
+// and scattered on a single thread.
+constexpr int kMinSpatialHashChunkObjects = 16384;
+
+// This class finds the neighbors of moving objects, e.g., particles or agents,
+// in a uniform grid of cubic cells. The unbounded grid is folded into a table
+// of buckets whose dimensions are powers of two, i.e., the bucket of a cell
+// wraps its coordinates around the table, so that the memory is proportional
+// to the number of objects however far they spread, while the neighbor cells
+// along x remain in consecutive buckets. The table is rebuilt from the
+// positions every frame with a counting sort: the threads of a JobSystem
+// count the objects of their chunks per bucket, and then scatter them at the
+// offsets of their chunks, so the build needs no atomics and its order does
+// not depend on the number of threads. The objects are stored sorted by
+// bucket with their positions, so a query reads a contiguous range of objects
+// per row of cells it overlaps: 9 ranges with cells as large as the query
+// radius. Finding the neighbors of every object then takes linear time instead
+// of quadratic. The objects of far cells folded into the same buckets are
+// rejected by their distance.
+//
+// Example:
+//
+// wvu::SpatialHash spatial_hash(interaction_radius);
+// while (...) {  // Simulation loop.
+//   spatial_hash.Build(positions, &job_system);
+//   job_system.ParallelFor(num_agents, 256, [&](const int begin,
+//                                               const int end) {
+//     for (int i = begin; i < end; ++i) {
+//       // Consecutive queries in the sorted order read the same buckets.
+//       const int agent = spatial_hash.sorted_objects()[i];
+//       spatial_hash.ForEachNeighbor(
+//           position(agent), interaction_radius,
+//           [&](const int neighbor, const float squared_distance) {
+//         ...  // Steer the agent away from the neighbor.
+//       });
+//     }
+//   });
+// }
+class SpatialHash {
+ public:
+  // Parameters:
+  //   cell_size  The edge of the cells, e.g., the radius of the queries.
+  explicit SpatialHash(const float cell_size);
+  ~SpatialHash() {}
+
+  // Indexes the objects, replacing the previous ones. The objects are
+  // identified by their index in positions. The table has at least a bucket
+  // per object, and its dimensions follow the extent of the objects.
+  // Parameters:
+  //   positions  The positions of the objects.
+  //   job_system  The threads building the table. Can be nullptr, in which
+  //     case it is built on the calling thread.
+  void Build(const Vector3fArray& positions, JobSystem* job_system);
+
+  // Calls visitor(object, squared_distance) for every object within radius of
+  // point, including the object at the point, if any. Thread safe, e.g., to
+  // query the neighbors of all the objects in parallel.
+  template <typename Visitor>
+  void ForEachNeighbor(const Eigen::Vector3f& point,
+                       const float radius,
+                       const Visitor& visitor) const;
+
+  // Appends the objects within radius of point to objects, and returns how
+  // many were appended.
+  int QueryRadius(const Eigen::Vector3f& point,
+                  const float radius,
+                  std::vector<int>* objects) const;
+
+  float cell_size() const {
+    return cell_size_;
+  }
+
+  int num_objects() const {
+    return sorted_objects_.size();
+  }
+
+  int num_buckets() const {
+    return bucket_starts_.size() - 1;
+  }
+
+  // Returns the objects sorted by bucket, where the objects of nearby cells
+  // are close, e.g., to query the neighbors of every object in this order.
+  const std::vector<int>& sorted_objects() const {
+    return sorted_objects_;
+  }
+
+ private:
+  // Returns the cell of a coordinate along an axis.
+  int Cell(const float coordinate) const {
+    return static_cast<int>(std::floor(coordinate * inverse_cell_size_));
+  }
+
+  // Returns the bucket of the cell (x, y, z), whose coordinates wrap around
+  // the table.
+  int Bucket(const int x, const int y, const int z) const {
+    return (x & x_mask_) | ((y & y_mask_) << x_bits_) |
+        ((z & z_mask_) << (x_bits_ + y_bits_));
+  }
+
+  // Calls visitor for the objects of the buckets [first_bucket, last_bucket]
+  // within radius of point.
+  template <typename Visitor>
+  void VisitBuckets(const int first_bucket,
+                    const int last_bucket,
+                    const Eigen::Vector3f& point,
+                    const float squared_radius,
+                    const Visitor& visitor) const;
+
+  float cell_size_;
+  float inverse_cell_size_;
+  // The bits of the cell coordinates in the bucket, and their masks.
+  int x_bits_;
+  int y_bits_;
+  int x_mask_;
+  int y_mask_;
+  int z_mask_;
+  // The first sorted object of every bucket, followed by the number of
+  // objects.
+  std::vector<int> bucket_starts_;
+  // The objects and their positions, sorted by bucket.
+  std::vector<int> sorted_objects_;
+  Vector3fArray sorted_positions_;
+  // The bucket of every object, and the counts of the buckets per chunk, kept
+  // to build without allocating.
+  std::vector<int> object_buckets_;
+  std::vector<int> histograms_;
+
+  SpatialHash(const SpatialHash&) = delete;
+  SpatialHash& operator=(const SpatialHash&) = delete;
+};
+
+template <typename Visitor>
+void SpatialHash::VisitBuckets(const int first_bucket,
+                               const int last_bucket,
+                               const Eigen::Vector3f& point,
+                               const float squared_radius,
+                               const Visitor& visitor) const {
+  const float* x = sorted_positions_.x.data();
+  const float* y = sorted_positions_.y.data();
+  const float* z = sorted_positions_.z.data();
+  const int end = bucket_starts_[last_bucket + 1];
+  for (int i = bucket_starts_[first_bucket]; i < end; ++i) {
+    const float dx = x[i] - point.x();
+    const float dy = y[i] - point.y();
+    const float dz = z[i] - point.z();
+    const float squared_distance = dx * dx + dy * dy + dz * dz;
+    if (squared_distance <= squared_radius) {
+      visitor(sorted_objects_[i], squared_distance);
+    }
+  }
+}
+
+template <typename Visitor>
+void SpatialHash::ForEachNeighbor(const Eigen::Vector3f& point,
+                                  const float radius,
+                                  const Visitor& visitor) const {
+  if (sorted_objects_.empty()) return;
+  int min_x = Cell(point.x() - radius);
+  int min_y = Cell(point.y() - radius);
+  int min_z = Cell(point.z() - radius);
+  int max_x = Cell(point.x() + radius);
+  int max_y = Cell(point.y() + radius);
+  int max_z = Cell(point.z() + radius);
+  // A range as long as the table along an axis covers all of it, once.
+  if (max_x - min_x >= x_mask_) {
+    min_x = 0;
+    max_x = x_mask_;
+  }
+  if (max_y - min_y >= y_mask_) {
+    min_y = 0;
+    max_y = y_mask_;
+  }
+  if (max_z - min_z >= z_mask_) {
+    min_z = 0;
+    max_z = z_mask_;
+  }
+  const float squared_radius = radius * radius;
+  // The cells of a row along x are consecutive buckets, or two ranges of them
+  // if the row wraps around the table.
+  const int first_x = min_x & x_mask_;
+  const int last_x = max_x & x_mask_;
+  for (int z = min_z; z <= max_z; ++z) {
+    for (int y = min_y; y <= max_y; ++y) {
+      const int row = Bucket(0, y, z);
+      if (first_x <= last_x) {
+        VisitBuckets(row + first_x, row + last_x, point, squared_radius,
+                     visitor);
+      } else {
+        VisitBuckets(row + first_x, row + x_mask_, point, squared_radius,
+                     visitor);
+        VisitBuckets(row, row + last_x, point, squared_radius, visitor);
+      }
+    }
+  }
+}
+
+}  // namespace wvu
+
+#endif  // GLUTILS_SPATIAL_HASH_H_
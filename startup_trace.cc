@@ -0,0 +1,211 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "startup_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "huge_pages.h"
+
+namespace wvu {
+namespace {
+// Returns the string as a JSON string literal.
+std::string JsonString(const std::string& value) {
+  std::string json = "\"";
+  for (const char c : value) {
+    if (c == '"' || c == '\\') json += '\\';
+    json += c;
+  }
+  return json + "\"";
+}
+
+}  // namespace
+
+StartupTrace::StartupTrace() : epoch_(std::chrono::steady_clock::now()) {}
+
+double StartupTrace::Now() const {
+  return std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now() - epoch_).count();
+}
+
+int StartupTrace::AddPhase(const std::string& name, const int depth) {
+  Phase phase;
+  phase.name = name;
+  phase.depth = depth;
+  phase.begin_us = Now();
+  phase.end_us = -1.0;
+  phase.begin_faults = CurrentPageFaults();
+  phases_.push_back(phase);
+  return phases_.size() - 1;
+}
+
+int StartupTrace::BeginPhase(const std::string& name) {
+  const int phase = AddPhase(name, open_phases_.size());
+  open_phases_.push_back(phase);
+  return phase;
+}
+
+int StartupTrace::BeginAsyncPhase(const std::string& name) {
+  return AddPhase(name, -1);
+}
+
+void StartupTrace::EndPhase(const int phase) {
+  if (phase < 0 || phase >= static_cast<int>(phases_.size()) ||
+      phases_[phase].end_us >= 0.0) {
+    return;
+  }
+  const double now = Now();
+  const PageFaultCounts faults = CurrentPageFaults();
+  phases_[phase].end_us = now;
+  phases_[phase].end_faults = faults;
+  if (phases_[phase].depth < 0) return;
+  // The nested phases still in progress end with it.
+  while (!open_phases_.empty()) {
+    const int open_phase = open_phases_.back();
+    open_phases_.pop_back();
+    if (open_phase == phase) break;
+    phases_[open_phase].end_us = now;
+    phases_[open_phase].end_faults = faults;
+  }
+}
+
+void StartupTrace::SetNote(const int phase, const std::string& note) {
+  if (phase < 0 || phase >= static_cast<int>(phases_.size())) return;
+  phases_[phase].note = note;
+}
+
+double StartupTrace::total_ms() const {
+  double end_us = 0.0;
+  for (const Phase& phase : phases_) end_us = std::max(end_us, phase.end_us);
+  return 1e-3 * end_us;
+}
+
+std::string StartupTrace::Report() const {
+  const double total = total_ms();
+  std::ostringstream report;
+  report << std::fixed << std::setprecision(3);
+  for (const Phase& phase : phases_) {
+    report << "\n  " << std::string(2 * std::max(phase.depth, 0), ' ')
+           << phase.name << ": ";
+    if (phase.end_us < 0.0) {
+      report << "in progress";
+    } else {
+      const double duration = 1e-3 * (phase.end_us - phase.begin_us);
+      report << duration << " ms";
+      if (total > 0.0) {
+        report << std::setprecision(1) << " (" << 100.0 * duration / total
+               << "%)" << std::setprecision(3);
+      }
+      const int64_t num_minor_faults = phase.end_faults.num_minor_faults -
+          phase.begin_faults.num_minor_faults;
+      const int64_t num_major_faults = phase.end_faults.num_major_faults -
+          phase.begin_faults.num_major_faults;
+      if (num_minor_faults + num_major_faults > 0) {
+        report << ", " << num_minor_faults + num_major_faults
+               << " page faults (" << num_major_faults << " major)";
+      }
+    }
+    if (phase.depth < 0) report << ", async";
+    if (!phase.note.empty()) report << ", " << phase.note;
+    report << ".";
+  }
+  report << "\n  total: " << total << " ms.";
+  return report.str();
+}
+
+bool StartupTrace::WriteChromeTrace(const std::string& filepath,
+                                    std::string* error_info_log) const {
+  const std::string temporary_filepath = filepath + ".tmp";
+  std::ofstream out(temporary_filepath);
+  if (!out.is_open()) {
+    *error_info_log = "Could not open " + temporary_filepath;
+    return false;
+  }
+  // The synchronous phases are complete events ("ph": "X"), which nest. The
+  // asynchronous ones are pairs of async events ("ph": "b" and "e"), drawn on
+  // rows of their own.
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+      << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": 0, "
+      << "\"args\": {\"name\": \"startup\"}}";
+  for (int i = 0; i < static_cast<int>(phases_.size()); ++i) {
+    const Phase& phase = phases_[i];
+    if (phase.end_us < 0.0) continue;
+    const std::string args = "{\"note\": " + JsonString(phase.note) +
+        ", \"minor_page_faults\": " +
+        std::to_string(phase.end_faults.num_minor_faults -
+                       phase.begin_faults.num_minor_faults) +
+        ", \"major_page_faults\": " +
+        std::to_string(phase.end_faults.num_major_faults -
+                       phase.begin_faults.num_major_faults) + "}";
+    if (phase.depth >= 0) {
+      out << ",\n{\"name\": " << JsonString(phase.name)
+          << ", \"cat\": \"startup\", \"ph\": \"X\", \"pid\": 0, \"tid\": 0"
+          << ", \"ts\": " << phase.begin_us
+          << ", \"dur\": " << phase.end_us - phase.begin_us
+          << ", \"args\": " << args << "}";
+    } else {
+      out << ",\n{\"name\": " << JsonString(phase.name)
+          << ", \"cat\": \"startup\", \"ph\": \"b\", \"id\": " << i
+          << ", \"pid\": 0, \"tid\": 0, \"ts\": " << phase.begin_us
+          << ", \"args\": " << args << "}"
+          << ",\n{\"name\": " << JsonString(phase.name)
+          << ", \"cat\": \"startup\", \"ph\": \"e\", \"id\": " << i
+          << ", \"pid\": 0, \"tid\": 0, \"ts\": " << phase.end_us << "}";
+    }
+  }
+  out << "\n]}\n";
+  out.close();
+  if (!out) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + temporary_filepath;
+    return false;
+  }
+  if (std::rename(temporary_filepath.c_str(), filepath.c_str()) != 0) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not rename " + temporary_filepath;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace wvu
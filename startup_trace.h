@@ -0,0 +1,154 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_STARTUP_TRACE_H_
+#define GLUTILS_STARTUP_TRACE_H_
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "huge_pages.h"
+
+namespace wvu {
+// This class times the phases of the start of the program, e.g., the
+// initialization of GLFW and GLEW, the creation of the window and the
+// compilation of the shaders, so that the dominant costs can be found and the
+// effect of the caches confirmed. The phases are timed with
+// std::chrono::steady_clock from the creation of the trace, nest, and can be
+// written as a chrome://tracing (or Perfetto) JSON trace. Phases that overlap
+// others without nesting, e.g., an upload running on another thread, are
+// begun with BeginAsyncPhase() and drawn on their own rows. The trace is not
+// thread safe: the phases are begun and ended on one thread. The page faults of
+// the process during each phase are counted too, e.g., those of mapping and
+// reading the assets; they include the faults of the other threads.
+//
+// Example:
+//
+// wvu::StartupTrace startup_trace;
+// {
+//   wvu::ScopedStartupPhase phase(&startup_trace, "glfwInit");
+//   glfwInit();
+// }
+// const int upload_phase = startup_trace.BeginAsyncPhase("mesh upload");
+// ...
+// startup_trace.EndPhase(upload_phase);
+// LOG(INFO) << "Startup:" << startup_trace.Report();
+// startup_trace.WriteChromeTrace("startup.json", &error_info_log);
+class StartupTrace {
+ public:
+  StartupTrace();
+  ~StartupTrace() {}
+
+  // Starts a phase nested in the phases in progress. Returns the id of the
+  // phase.
+  int BeginPhase(const std::string& name);
+
+  // Starts a phase that may outlive the phases in progress. Returns the id of
+  // the phase.
+  int BeginAsyncPhase(const std::string& name);
+
+  // Stops a phase, and the phases nested in it that are still in progress.
+  void EndPhase(const int phase);
+
+  // Attaches a note to a phase, e.g., whether a program came from the binary
+  // cache. It is shown in the report and in the arguments of the trace event.
+  void SetNote(const int phase, const std::string& note);
+
+  // Returns the milliseconds from the creation of the trace to the end of the
+  // last phase that ended.
+  double total_ms() const;
+
+  // Returns the duration of each phase and its share of the total, indented by
+  // nesting, in the order the phases began.
+  std::string Report() const;
+
+  // Writes the phases as a Chrome trace event JSON file. Returns true if
+  // successful.
+  bool WriteChromeTrace(const std::string& filepath,
+                        std::string* error_info_log) const;
+
+ private:
+  struct Phase {
+    std::string name;
+    std::string note;
+    // Number of synchronous phases around it, or -1 if asynchronous.
+    int depth;
+    // Microseconds since the creation of the trace. The end is negative while
+    // the phase is in progress.
+    double begin_us;
+    double end_us;
+    // The page faults of the process at the begin and at the end.
+    PageFaultCounts begin_faults;
+    PageFaultCounts end_faults;
+  };
+
+  // Returns the microseconds since the creation of the trace.
+  double Now() const;
+
+  int AddPhase(const std::string& name, const int depth);
+
+  std::chrono::steady_clock::time_point epoch_;
+  std::vector<Phase> phases_;
+  // The synchronous phases in progress, from the outermost.
+  std::vector<int> open_phases_;
+
+  StartupTrace(const StartupTrace&) = delete;
+  StartupTrace& operator=(const StartupTrace&) = delete;
+};
+
+// Times a phase of a trace during its lifetime.
+class ScopedStartupPhase {
+ public:
+  ScopedStartupPhase(StartupTrace* trace, const std::string& name)
+      : trace_(trace), phase_(trace->BeginPhase(name)) {}
+  ~ScopedStartupPhase() {
+    trace_->EndPhase(phase_);
+  }
+
+  int phase() const {
+    return phase_;
+  }
+
+ private:
+  StartupTrace* trace_;
+  const int phase_;
+
+  ScopedStartupPhase(const ScopedStartupPhase&) = delete;
+  ScopedStartupPhase& operator=(const ScopedStartupPhase&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_STARTUP_TRACE_H_
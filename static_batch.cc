@@ -0,0 +1,302 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "static_batch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/LU>
+
+#include "assignment.h"
+#include "gpu_mesh.h"
+#include "model.h"
+#include "render_queue.h"
+#include "transforms.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+// A model to merge, with its state and its cell.
+struct MergedModel {
+  int model;
+  int state;
+  int num_vertices;
+  // The coordinates of the cell of the center of its bounds.
+  int cell[3];
+
+  bool operator<(const MergedModel& other) const {
+    return std::tie(state, cell[0], cell[1], cell[2], model) <
+        std::tie(other.state, other.cell[0], other.cell[1], other.cell[2],
+                 other.model);
+  }
+
+  bool SameChunk(const MergedModel& other) const {
+    return state == other.state && cell[0] == other.cell[0] &&
+        cell[1] == other.cell[1] && cell[2] == other.cell[2];
+  }
+};
+
+// Returns true if the models can be merged into one mesh.
+bool SameState(const StaticModel& x, const StaticModel& y) {
+  return x.shader_program == y.shader_program &&
+      x.texture_id == y.texture_id &&
+      x.model->vertex_layout() == y.model->vertex_layout() &&
+      x.model->closed() == y.model->closed();
+}
+
+// Returns an error message if the model cannot be merged, or nullptr if it
+// can.
+const char* CheckStaticModel(const Model& model) {
+  if (model.primitive_type() != GL_TRIANGLES) {
+    return "The static models must be triangle lists.";
+  }
+  if (model.cpu_data_released()) {
+    return "The CPU data of a static model was released.";
+  }
+  const VertexAttribute* position =
+      model.vertex_layout().FindAttribute(POSITION);
+  if (position == nullptr || position->type != GL_FLOAT ||
+      position->num_components != 3) {
+    return "The static models must have 3 float positions.";
+  }
+  const VertexAttribute* normal = model.vertex_layout().FindAttribute(NORMAL);
+  if (normal != nullptr &&
+      (normal->type != GL_FLOAT || normal->num_components != 3)) {
+    return "The normals of the static models must be 3 floats.";
+  }
+  return nullptr;
+}
+
+// Appends the vertices of a model, transformed into world space, and its
+// indices, offset by the vertices already in the chunk.
+void AppendModel(const Model& model,
+                 std::vector<GLubyte>* vertex_data,
+                 std::vector<GLuint>* indices,
+                 Eigen::AlignedBox3f* bounds) {
+  const VertexLayout& layout = model.vertex_layout();
+  const GLsizei stride = layout.stride();
+  const GLuint first_vertex = vertex_data->size() / stride;
+  vertex_data->insert(vertex_data->end(), model.vertex_data().begin(),
+                      model.vertex_data().end());
+  const Eigen::Matrix4f& model_matrix = model.model_matrix();
+  const Eigen::Matrix3f normal_matrix =
+      model_matrix.topLeftCorner<3, 3>().inverse().transpose();
+  const VertexAttribute* position = layout.FindAttribute(POSITION);
+  const VertexAttribute* normal = layout.FindAttribute(NORMAL);
+  GLubyte* vertex = vertex_data->data() + first_vertex * stride;
+  for (int i = 0; i < model.num_vertices(); ++i, vertex += stride) {
+    Eigen::Vector3f point;
+    std::memcpy(point.data(), vertex + position->offset, sizeof(point));
+    point = (model_matrix * point.homogeneous()).head<3>();
+    std::memcpy(vertex + position->offset, point.data(), sizeof(point));
+    bounds->extend(point);
+    if (normal == nullptr) continue;
+    Eigen::Vector3f direction;
+    std::memcpy(direction.data(), vertex + normal->offset, sizeof(direction));
+    direction = (normal_matrix * direction).normalized();
+    std::memcpy(vertex + normal->offset, direction.data(), sizeof(direction));
+  }
+  // A mirroring transform reverses the winding of the triangles.
+  const bool flip = model_matrix.topLeftCorner<3, 3>().determinant() < 0.0f;
+  const std::vector<GLuint>& model_indices = model.indices();
+  for (size_t i = 0; i + 2 < model_indices.size(); i += 3) {
+    indices->push_back(first_vertex + model_indices[i]);
+    indices->push_back(first_vertex + model_indices[flip ? i + 2 : i + 1]);
+    indices->push_back(first_vertex + model_indices[flip ? i + 1 : i + 2]);
+  }
+}
+
+}  // namespace
+
+bool BuildStaticChunks(const std::vector<StaticModel>& models,
+                       const StaticBatchOptions& options,
+                       std::vector<StaticModel>* states,
+                       StaticChunks* chunks,
+                       std::string* error_info_log) {
+  states->clear();
+  chunks->clear();
+  if (options.chunk_size <= 0.0f || options.max_chunk_vertices <= 0) {
+    *error_info_log = "The chunks must have a positive size.";
+    return false;
+  }
+  // The models are sorted by state and by cell, so that the models of a
+  // chunk are consecutive.
+  std::vector<MergedModel> merged_models(models.size());
+  for (int i = 0; i < static_cast<int>(models.size()); ++i) {
+    const Model& model = *models[i].model;
+    const char* error = CheckStaticModel(model);
+    if (error != nullptr) {
+      *error_info_log = error;
+      return false;
+    }
+    MergedModel& merged_model = merged_models[i];
+    merged_model.model = i;
+    merged_model.num_vertices = model.num_vertices();
+    // The states are few, so they are searched linearly.
+    merged_model.state = 0;
+    while (merged_model.state < static_cast<int>(states->size()) &&
+           !SameState((*states)[merged_model.state], models[i])) {
+      ++merged_model.state;
+    }
+    if (merged_model.state == static_cast<int>(states->size())) {
+      states->push_back(models[i]);
+    }
+    Eigen::AlignedBox3f bounds;
+    for (int j = 0; j < model.num_vertices(); ++j) {
+      bounds.extend(model.VertexPosition(j));
+    }
+    const Eigen::Vector3f center =
+        (model.model_matrix() * bounds.center().homogeneous()).head<3>();
+    for (int k = 0; k < 3; ++k) {
+      merged_model.cell[k] = std::floor(center[k] / options.chunk_size);
+    }
+  }
+  std::sort(merged_models.begin(), merged_models.end());
+
+  for (size_t begin = 0; begin < merged_models.size();) {
+    // The chunk ends at the next cell, or before exceeding the vertices. A
+    // chunk has at least one model.
+    size_t end = begin + 1;
+    int num_vertices = merged_models[begin].num_vertices;
+    while (end < merged_models.size() &&
+           merged_models[end].SameChunk(merged_models[begin]) &&
+           num_vertices + merged_models[end].num_vertices <=
+           options.max_chunk_vertices) {
+      num_vertices += merged_models[end].num_vertices;
+      ++end;
+    }
+    const Model& first_model = *models[merged_models[begin].model].model;
+    int num_indices = 0;
+    for (size_t i = begin; i < end; ++i) {
+      num_indices += models[merged_models[i].model].model->num_indices();
+    }
+    std::vector<GLubyte> vertex_data;
+    vertex_data.reserve(num_vertices * first_model.vertex_layout().stride());
+    std::vector<GLuint> indices;
+    indices.reserve(num_indices);
+    chunks->emplace_back();
+    StaticChunk& chunk = chunks->back();
+    chunk.state = merged_models[begin].state;
+    chunk.num_models = end - begin;
+    for (size_t i = begin; i < end; ++i) {
+      AppendModel(*models[merged_models[i].model].model, &vertex_data,
+                  &indices, &chunk.bounds);
+    }
+    chunk.model = Model(Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(),
+                        first_model.vertex_layout(), std::move(vertex_data),
+                        std::move(indices));
+    chunk.model.set_closed(first_model.closed());
+    begin = end;
+  }
+  return true;
+}
+
+bool StaticBatch::Build(const std::vector<StaticModel>& models,
+                        const StaticBatchOptions& options,
+                        std::string* error_info_log) {
+  Reset();
+  std::vector<StaticModel> states;
+  StaticChunks chunks;
+  if (!BuildStaticChunks(models, options, &states, &chunks, error_info_log)) {
+    return false;
+  }
+  const int num_chunks = chunks.size();
+  meshes_.reserve(num_chunks);
+  items_.resize(num_chunks);
+  bounds_.resize(num_chunks);
+  centers_.resize(num_chunks);
+  half_extents_.resize(num_chunks);
+  for (int i = 0; i < num_chunks; ++i) {
+    StaticChunk& chunk = chunks[i];
+    meshes_.push_back(SetVertexArrayObject(chunk.model));
+    chunk.model.ReleaseCpuData();
+    RenderItem& item = items_[i];
+    item.shader_program = states[chunk.state].shader_program;
+    item.texture_id = states[chunk.state].texture_id;
+    item.num_indices = chunk.model.num_indices();
+    bounds_[i] = chunk.bounds;
+    const Eigen::Vector3f center = chunk.bounds.center();
+    const Eigen::Vector3f half_extent = 0.5f * chunk.bounds.sizes();
+    centers_.x[i] = center.x();
+    centers_.y[i] = center.y();
+    centers_.z[i] = center.z();
+    half_extents_.x[i] = half_extent.x();
+    half_extents_.y[i] = half_extent.y();
+    half_extents_.z[i] = half_extent.z();
+  }
+  // The meshes do not move once all of them are created.
+  for (int i = 0; i < num_chunks; ++i) {
+    items_[i].mesh = &meshes_[i];
+  }
+  num_models_ = models.size();
+  return true;
+}
+
+void StaticBatch::Reset() {
+  meshes_.clear();
+  items_.clear();
+  bounds_.clear();
+  centers_.resize(0);
+  half_extents_.resize(0);
+  visibility_.clear();
+  num_visible_chunks_ = 0;
+  num_models_ = 0;
+}
+
+void StaticBatch::AddVisible(const FrustumPlanes& planes,
+                             const Eigen::Vector3f& viewpoint,
+                             const float far_distance,
+                             RenderQueue* render_queue) {
+  num_visible_chunks_ = 0;
+  if (items_.empty()) return;
+  CullBoxes(planes, centers_, half_extents_, &visibility_);
+  for (int i = 0; i < num_chunks(); ++i) {
+    if ((visibility_[i / 32] & (1u << (i % 32))) == 0) continue;
+    items_[i].depth =
+        std::min(bounds_[i].exteriorDistance(viewpoint) / far_distance, 1.0f);
+    ++num_visible_chunks_;
+  }
+  render_queue->AddVisible(items_, visibility_);
+}
+
+}  // namespace wvu
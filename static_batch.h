@@ -0,0 +1,188 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_STATIC_BATCH_H_
+#define GLUTILS_STATIC_BATCH_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include "assignment.h"
+#include "gpu_mesh.h"
+#include "model.h"
+#include "render_queue.h"
+#include "shader_program.h"
+#include "transforms.h"
+
+namespace wvu {
+// A model that never moves, with the state drawing it.
+struct StaticModel {
+  // The model, whose vertices are transformed by its model matrix. Not owned.
+  const Model* model = nullptr;
+  // The program and the material texture drawing the model. Not owned.
+  ShaderProgram* shader_program = nullptr;
+  GLuint texture_id = 0;
+};
+
+struct StaticBatchOptions {
+  // Edge of the cubic cells of the world that split the merged models into
+  // chunks, so that the chunks out of the view are culled. A model belongs to
+  // the cell of the center of its bounds, so the chunks may overlap.
+  float chunk_size = 32.0f;
+  // The most vertices of a chunk. A cell with more vertices is split into
+  // several chunks. The default keeps the indices of the chunks in 16 bits. A
+  // model with more vertices makes a chunk on its own.
+  int max_chunk_vertices = kMaxNumVerticesForShortIndices;
+};
+
+// The static models of a state in a cell, merged into one mesh in world
+// space.
+struct StaticChunk {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  // The index of the state of the chunk in the states of the batch.
+  int state = 0;
+  int num_models = 0;
+  // The bounds of the vertices, in world space.
+  Eigen::AlignedBox3f bounds;
+  // The merged mesh, whose model matrix is the identity.
+  Model model;
+};
+
+typedef std::vector<StaticChunk, Eigen::aligned_allocator<StaticChunk> >
+    StaticChunks;
+
+// Merges static models drawn with the same program, texture and vertex layout
+// into chunks. The positions are transformed by the model matrices and the
+// normals by their inverse transposes, and the triangles of mirrored models
+// are flipped, so that the chunks keep the front faces of the models. Closed
+// and open models are not merged together, since the back faces of the
+// chunks are only culled if all of their models are closed. The models must be
+// triangle lists with float positions, and float normals if they have
+// normals. The other attributes are copied.
+// Parameters:
+//   models  The static models. Their CPU data must not be released.
+//   options  The size of the chunks.
+//   states  The distinct program, texture and layout of the chunks, whose
+//     models are the first model of each state.
+//   chunks  The merged chunks, sorted by state and by cell.
+//   error_info_log  A pointer to a string that holds the error log.
+bool BuildStaticChunks(const std::vector<StaticModel>& models,
+                       const StaticBatchOptions& options,
+                       std::vector<StaticModel>* states,
+                       StaticChunks* chunks,
+                       std::string* error_info_log);
+
+// This class draws the models of a scene that never move with a handful of
+// draws: the models are merged at load into chunks by BuildStaticChunks(),
+// and every chunk is uploaded as one mesh and drawn with one draw of a
+// RenderQueue item. The chunks out of the frustum are culled every frame by
+// their bounds with CullBoxes(). The CPU data of the chunks is released once
+// uploaded, while the models may be released by the caller once built.
+//
+// Merging trades the culling and the levels of detail of the models for fewer
+// draws, so it suits many small props whose draws cost more than their
+// vertices. Moving a static model needs a new Build().
+//
+// Example:
+//
+// std::vector<wvu::StaticModel> props = ...;
+// wvu::StaticBatch static_batch;
+// static_batch.Build(props, wvu::StaticBatchOptions(), &error_info_log);
+// while (...) {  // Rendering loop.
+//   render_queue.Clear();
+//   static_batch.AddVisible(
+//       wvu::ExtractFrustumPlanes(camera.view_projection()),
+//       camera.position(), camera.far(), &render_queue);
+//   ...  // Add the moving models.
+//   render_queue.Execute();
+// }
+class StaticBatch {
+ public:
+  StaticBatch() {}
+  ~StaticBatch() {}
+
+  // Merges and uploads the models, replacing the previous chunks. The context
+  // must be current. Returns true if successful.
+  bool Build(const std::vector<StaticModel>& models,
+             const StaticBatchOptions& options,
+             std::string* error_info_log);
+
+  // Deletes the meshes of the chunks.
+  void Reset();
+
+  // Adds the items of the chunks in the frustum to a render queue. Their
+  // depth is the distance of their bounds to the viewpoint divided by the far
+  // distance.
+  void AddVisible(const FrustumPlanes& planes,
+                  const Eigen::Vector3f& viewpoint,
+                  const float far_distance,
+                  RenderQueue* render_queue);
+
+  int num_chunks() const {
+    return meshes_.size();
+  }
+
+  // Returns the number of chunks added by the last AddVisible().
+  int num_visible_chunks() const {
+    return num_visible_chunks_;
+  }
+
+  // Returns the number of models merged into the chunks.
+  int num_models() const {
+    return num_models_;
+  }
+
+ private:
+  std::vector<GpuMesh> meshes_;
+  RenderItems items_;
+  std::vector<Eigen::AlignedBox3f> bounds_;
+  // The bounds of the chunks for CullBoxes().
+  Vector3fArray centers_;
+  Vector3fArray half_extents_;
+  std::vector<uint32_t> visibility_;
+  int num_visible_chunks_ = 0;
+  int num_models_ = 0;
+
+  StaticBatch(const StaticBatch&) = delete;
+  StaticBatch& operator=(const StaticBatch&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_STATIC_BATCH_H_
@@ -0,0 +1,192 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "stripifier.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+#include "model.h"
+
+namespace wvu {
+namespace {
+
+// Triangles adjacent to each directed edge. A directed edge (a, b) belongs to
+// the triangle that traverses a then b in its winding.
+class EdgeMap {
+ public:
+  explicit EdgeMap(const std::vector<GLuint>& indices) {
+    const int num_triangles = indices.size() / 3;
+    edges_.reserve(3 * num_triangles);
+    for (int t = 0; t < num_triangles; ++t) {
+      for (int k = 0; k < 3; ++k) {
+        edges_.emplace(Key(indices[3 * t + k], indices[3 * t + (k + 1) % 3]),
+                       t);
+      }
+    }
+  }
+
+  // Returns a triangle not yet used which traverses (a, b), or -1.
+  int FindUnused(const GLuint a,
+                 const GLuint b,
+                 const std::vector<bool>& used) const {
+    const auto range = edges_.equal_range(Key(a, b));
+    for (auto it = range.first; it != range.second; ++it) {
+      if (!used[it->second]) return it->second;
+    }
+    return -1;
+  }
+
+ private:
+  static uint64_t Key(const GLuint a, const GLuint b) {
+    return (static_cast<uint64_t>(a) << 32) | b;
+  }
+
+  std::unordered_multimap<uint64_t, int> edges_;
+};
+
+// Returns the vertex of triangle t that is neither a nor b.
+GLuint ThirdVertex(const std::vector<GLuint>& indices,
+                   const int t,
+                   const GLuint a,
+                   const GLuint b) {
+  for (int k = 0; k < 3; ++k) {
+    const GLuint v = indices[3 * t + k];
+    if (v != a && v != b) return v;
+  }
+  return indices[3 * t];
+}
+
+// Grows a strip starting at triangle t with the given rotation of its
+// vertices. Marks the triangles of the strip as used in used and returns the
+// strip.
+std::vector<GLuint> GrowStrip(const std::vector<GLuint>& indices,
+                              const EdgeMap& edges,
+                              const int t,
+                              const int rotation,
+                              std::vector<bool>* used) {
+  std::vector<GLuint> strip;
+  for (int k = 0; k < 3; ++k) {
+    strip.push_back(indices[3 * t + (k + rotation) % 3]);
+  }
+  (*used)[t] = true;
+  while (true) {
+    const size_t n = strip.size();
+    // The next triangle of the strip is (s[n-2], s[n-1], v) for even
+    // positions and (s[n-1], s[n-2], v) for odd ones, so it must traverse its
+    // shared edge in that order to keep the winding.
+    const bool even = (n - 2) % 2 == 0;
+    const GLuint edge_begin = even ? strip[n - 2] : strip[n - 1];
+    const GLuint edge_end = even ? strip[n - 1] : strip[n - 2];
+    const int next = edges.FindUnused(edge_begin, edge_end, *used);
+    if (next < 0) break;
+    (*used)[next] = true;
+    strip.push_back(ThirdVertex(indices, next, edge_begin, edge_end));
+  }
+  return strip;
+}
+
+}  // namespace
+
+void Stripify(const std::vector<GLuint>& indices,
+              std::vector<GLuint>* strip_indices,
+              StripificationReport* report) {
+  const int num_triangles = indices.size() / 3;
+  const EdgeMap edges(indices);
+  std::vector<bool> used(num_triangles, false);
+  std::vector<GLuint> output;
+  output.reserve(indices.size());
+  int num_strips = 0;
+  for (int t = 0; t < num_triangles; ++t) {
+    if (used[t]) continue;
+    // Try the three rotations of the first triangle and keep the longest
+    // strip.
+    std::vector<GLuint> best_strip;
+    std::vector<bool> best_used;
+    for (int rotation = 0; rotation < 3; ++rotation) {
+      std::vector<bool> candidate_used = used;
+      std::vector<GLuint> strip =
+          GrowStrip(indices, edges, t, rotation, &candidate_used);
+      if (strip.size() > best_strip.size()) {
+        best_strip = std::move(strip);
+        best_used = std::move(candidate_used);
+      }
+    }
+    used = std::move(best_used);
+    if (num_strips > 0) {
+      output.push_back(kPrimitiveRestartIndex);
+    }
+    output.insert(output.end(), best_strip.begin(), best_strip.end());
+    ++num_strips;
+  }
+  if (report != nullptr) {
+    report->num_strips = num_strips;
+    report->num_list_indices = indices.size();
+    report->num_strip_indices = output.size();
+  }
+  *strip_indices = std::move(output);
+}
+
+bool StripifyModel(Model* model, StripificationReport* report) {
+  if (model->primitive_type() != GL_TRIANGLES || model->cpu_data_released()) {
+    return false;
+  }
+  std::vector<GLuint> strip_indices;
+  StripificationReport stripification_report;
+  Stripify(model->indices(), &strip_indices, &stripification_report);
+  if (report != nullptr) {
+    *report = stripification_report;
+  }
+  if (stripification_report.num_strip_indices >=
+      stripification_report.num_list_indices) {
+    return false;
+  }
+  model->SetIndices(std::move(strip_indices), GL_TRIANGLE_STRIP);
+  return true;
+}
+
+void EnablePrimitiveRestart(const GLenum index_type) {
+  if (GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility) {
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    return;
+  }
+  glEnable(GL_PRIMITIVE_RESTART);
+  glPrimitiveRestartIndex(index_type == GL_UNSIGNED_SHORT ?
+                          0xFFFF : kPrimitiveRestartIndex);
+}
+
+}  // namespace wvu
@@ -0,0 +1,78 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_STRIPIFIER_H_
+#define GLUTILS_STRIPIFIER_H_
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "model.h"
+
+namespace wvu {
+// Reports the outcome of a stripification.
+struct StripificationReport {
+  int num_strips = 0;
+  // Number of indices of the triangle list and of the strips, including the
+  // restart indices.
+  int num_list_indices = 0;
+  int num_strip_indices = 0;
+};
+
+// Converts a triangle list into triangle strips joined with
+// kPrimitiveRestartIndex. The strips keep the winding of the triangles. The
+// conversion greedily walks the triangles across shared edges, which works best
+// for regular grid-like meshes such as terrain.
+// Parameters:
+//   indices  The triangle list.
+//   strip_indices  The strips separated by restart indices.
+//   report  The number of strips and indices. Can be nullptr.
+void Stripify(const std::vector<GLuint>& indices,
+              std::vector<GLuint>* strip_indices,
+              StripificationReport* report);
+
+// Replaces the triangle list of the model with triangle strips if the strips
+// use fewer indices. Returns true if the model was converted. Drawing the model
+// requires primitive restart, see EnablePrimitiveRestart().
+bool StripifyModel(Model* model, StripificationReport* report);
+
+// Enables primitive restart with the restart index of the given index type,
+// i.e., the maximum value of the type. Uses GL_PRIMITIVE_RESTART_FIXED_INDEX
+// when available (OpenGL 4.3 or ARB_ES3_compatibility), and otherwise the
+// OpenGL 3.1 restart index.
+void EnablePrimitiveRestart(const GLenum index_type);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_STRIPIFIER_H_
@@ -0,0 +1,109 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "task.h"
+
+#include <functional>
+#include <thread>
+#include <utility>
+
+#include "job_system.h"
+#include "main_thread_queue.h"
+
+namespace wvu {
+
+TaskScheduler::TaskScheduler(JobSystem* job_system,
+                             MainThreadQueue* main_thread_queue)
+    : job_system_(job_system),
+      main_thread_queue_(main_thread_queue),
+      main_thread_id_(std::this_thread::get_id()),
+      num_jobs_(0),
+      num_main_thread_tasks_(0),
+      num_forwarded_jobs_(0) {}
+
+TaskScheduler::~TaskScheduler() {
+  job_system_->Wait(jobs_);
+}
+
+void TaskScheduler::Schedule(const TaskAffinity affinity,
+                             std::function<void()> function) {
+  if (affinity == MAIN_THREAD) {
+    num_main_thread_tasks_.fetch_add(1, std::memory_order_relaxed);
+    main_thread_queue_->Post(std::move(function));
+    return;
+  }
+  // The job system tells its workers apart, but not the main thread from the
+  // other threads.
+  if (job_system_->CurrentThreadIndex() == 0 &&
+      std::this_thread::get_id() != main_thread_id_) {
+    num_forwarded_jobs_.fetch_add(1, std::memory_order_relaxed);
+    main_thread_queue_->Post([this, function]() { SubmitJob(function); });
+    return;
+  }
+  SubmitJob(std::move(function));
+}
+
+int TaskScheduler::Dispatch() {
+  const int num_tasks = main_thread_queue_->Dispatch();
+  // Without workers, the jobs only run while the main thread waits for them.
+  if (job_system_->num_threads() == 1) job_system_->Wait(jobs_);
+  return num_tasks;
+}
+
+bool TaskScheduler::RunPending() {
+  const bool had_jobs = !jobs_.done();
+  if (had_jobs) job_system_->Wait(jobs_);
+  return main_thread_queue_->Dispatch() > 0 || had_jobs;
+}
+
+void TaskScheduler::Finish() {
+  while (RunPending()) {}
+}
+
+TaskSchedulerStatistics TaskScheduler::statistics() const {
+  TaskSchedulerStatistics statistics;
+  statistics.num_jobs = num_jobs_.load(std::memory_order_relaxed);
+  statistics.num_main_thread_tasks =
+      num_main_thread_tasks_.load(std::memory_order_relaxed);
+  statistics.num_forwarded_jobs =
+      num_forwarded_jobs_.load(std::memory_order_relaxed);
+  return statistics;
+}
+
+void TaskScheduler::SubmitJob(std::function<void()> function) {
+  num_jobs_.fetch_add(1, std::memory_order_relaxed);
+  job_system_->Run(std::move(function), &jobs_);
+}
+
+}  // namespace wvu
@@ -0,0 +1,380 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_TASK_H_
+#define GLUTILS_TASK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "job_system.h"
+#include "main_thread_queue.h"
+
+namespace wvu {
+// Where the function of a task runs.
+enum TaskAffinity {
+  // A job of the JobSystem, e.g., decompressing or decoding.
+  ANY_THREAD = 0,
+  // The main thread, through the MainThreadQueue, e.g., an OpenGL upload.
+  MAIN_THREAD = 1
+};
+
+// Counters of a TaskScheduler since its creation.
+struct TaskSchedulerStatistics {
+  int64_t num_jobs = 0;
+  int64_t num_main_thread_tasks = 0;
+  // Jobs scheduled by threads that may not submit jobs, e.g., the completion
+  // thread of a read, and submitted by the main thread instead.
+  int64_t num_forwarded_jobs = 0;
+};
+
+template <typename ValueType> class Task;
+template <typename ValueType> class Promise;
+
+// This class runs the functions of the tasks on the threads of their
+// affinity: the jobs of a JobSystem, or the main thread through a
+// MainThreadQueue. It adds no thread of its own. Only the thread that created
+// the JobSystem and its jobs may submit jobs, so the jobs scheduled by other
+// threads are posted to the main thread, which submits them. The scheduler
+// must be created by the thread that created the JobSystem, which is the main
+// thread dispatching the queue.
+class TaskScheduler {
+ public:
+  // The job system and the queue must outlive the scheduler.
+  TaskScheduler(JobSystem* job_system, MainThreadQueue* main_thread_queue);
+  // Waits for the jobs of the tasks. The main thread tasks not dispatched yet
+  // are left in the queue.
+  ~TaskScheduler();
+
+  // Returns a task of the result of function(result, error_info_log), run with
+  // the affinity. The task fails with error_info_log if function returns
+  // false. May be called from any thread.
+  template <typename ResultType>
+  Task<ResultType> Run(
+      const TaskAffinity affinity,
+      std::function<bool(ResultType* result, std::string* error_info_log)>
+          function);
+
+  // Runs the function with the affinity. May be called from any thread.
+  void Schedule(const TaskAffinity affinity, std::function<void()> function);
+
+  // Runs the tasks posted to the main thread, and the jobs if the job system
+  // has no workers, without waiting for the others. Replaces the calls to
+  // MainThreadQueue::Dispatch(), e.g., once per frame. Must only be called by
+  // the main thread. Returns the number of main thread tasks run.
+  int Dispatch();
+
+  // Waits for the jobs in flight and runs the tasks posted to the main thread.
+  // Must only be called by the main thread. Returns false if there was nothing
+  // to run.
+  bool RunPending();
+
+  // Runs the tasks until none is left, e.g., before the scheduler is deleted.
+  // The tasks waiting for a Promise fulfilled by another thread are not
+  // waited for.
+  void Finish();
+
+  TaskSchedulerStatistics statistics() const;
+
+ private:
+  void SubmitJob(std::function<void()> function);
+
+  JobSystem* job_system_;
+  MainThreadQueue* main_thread_queue_;
+  const std::thread::id main_thread_id_;
+  // The jobs of the tasks in flight.
+  JobCounter jobs_;
+  std::atomic<int64_t> num_jobs_;
+  std::atomic<int64_t> num_main_thread_tasks_;
+  std::atomic<int64_t> num_forwarded_jobs_;
+
+  TaskScheduler(const TaskScheduler&) = delete;
+  TaskScheduler& operator=(const TaskScheduler&) = delete;
+};
+
+namespace internal {
+// The state shared by a task, its promise and its continuations.
+template <typename ValueType>
+struct TaskState {
+  explicit TaskState(TaskScheduler* scheduler) : scheduler(scheduler) {}
+
+  // Sets the value, or the error if value is nullptr, and schedules the
+  // continuations. Only the first completion counts.
+  void Complete(std::unique_ptr<ValueType> new_value,
+                const std::string& new_error) {
+    std::vector<Continuation> ready_continuations;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (ready) return;
+      value = std::move(new_value);
+      error = new_error;
+      ready = true;
+      ready_continuations.swap(continuations);
+    }
+    for (Continuation& continuation : ready_continuations) {
+      scheduler->Schedule(continuation.first, std::move(continuation.second));
+    }
+  }
+
+  // Schedules the continuation with the affinity once the state is ready.
+  void AddContinuation(const TaskAffinity affinity,
+                       std::function<void()> continuation) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!ready) {
+        continuations.emplace_back(affinity, std::move(continuation));
+        return;
+      }
+    }
+    scheduler->Schedule(affinity, std::move(continuation));
+  }
+
+  bool is_ready() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ready;
+  }
+
+  typedef std::pair<TaskAffinity, std::function<void()> > Continuation;
+
+  TaskScheduler* const scheduler;
+  std::mutex mutex;
+  // The value and the error are only written before ready is set, and only
+  // read after.
+  bool ready = false;
+  std::unique_ptr<ValueType> value;
+  std::string error;
+  std::vector<Continuation> continuations;
+};
+
+}  // namespace internal
+
+// The handle of a value computed asynchronously by a TaskScheduler, or of its
+// failure. Continuations chain the stages of a pipeline: each one runs with
+// its affinity once the previous stage succeeded, without blocking any thread,
+// and the failure of a stage skips the following ones and reaches the last
+// with its error. The value is passed to the continuations by const
+// reference, since a task may have several. The value types must be default
+// constructible and movable. Tasks are cheap to copy, and share the value.
+//
+// Example:
+//
+// wvu::TaskScheduler scheduler(&job_system, &main_thread_queue);
+// wvu::Promise<std::vector<uint8_t> > contents(&scheduler);
+// loader.Load("textures/rock.ktx", [contents](const std::string& name,
+//                                              std::vector<uint8_t>* data) {
+//   if (data == nullptr) contents.SetError("Could not load " + name);
+//   else contents.SetValue(std::move(*data));
+// });
+// contents.task()
+//     .Then<Image>(wvu::ANY_THREAD, [](const std::vector<uint8_t>& data,
+//                                       Image* image, std::string* error) {
+//       return DecodeImage(data, image, error);
+//     })
+//     .Then<GLuint>(wvu::MAIN_THREAD, [](const Image& image,
+//                                         GLuint* texture_id, std::string*) {
+//       *texture_id = UploadTexture(image);
+//       return true;
+//     })
+//     .Finally(wvu::MAIN_THREAD, [&](const GLuint* texture_id,
+//                                    const std::string& error) {
+//       if (texture_id != nullptr) materials.Register("rock", *texture_id);
+//       else LOG(ERROR) << error;
+//     });
+// while (...) {  // Rendering loop.
+//   loader.Update(false);
+//   scheduler.Dispatch();
+//   ...  // Render the frame.
+// }
+template <typename ValueType>
+class Task {
+ public:
+  // An invalid task, e.g., to be assigned.
+  Task() {}
+
+  bool valid() const {
+    return state_ != nullptr;
+  }
+
+  // Returns true if the task succeeded or failed.
+  bool ready() const {
+    return state_->is_ready();
+  }
+
+  // Returns true if the task is ready and failed.
+  bool failed() const {
+    return ready() && state_->value == nullptr;
+  }
+
+  // Returns the value of a task that succeeded, or nullptr if it is not ready
+  // or failed. The value lives as long as a task of it does.
+  const ValueType* value() const {
+    return ready() ? state_->value.get() : nullptr;
+  }
+
+  // Returns the error of a task that failed.
+  const std::string& error() const {
+    return state_->error;
+  }
+
+  // Returns a task of the result of function(value, result, error_info_log),
+  // run with the affinity once this task succeeded. The returned task fails
+  // with the error of this task, without running function, if this task
+  // failed, and with error_info_log if function returns false.
+  template <typename ResultType>
+  Task<ResultType> Then(
+      const TaskAffinity affinity,
+      std::function<bool(const ValueType& value,
+                         ResultType* result,
+                         std::string* error_info_log)> function) const;
+
+  // Runs function(value, error) with the affinity once this task is ready,
+  // e.g., to register the result or report the error. value is nullptr if the
+  // task failed.
+  void Finally(const TaskAffinity affinity,
+               std::function<void(const ValueType* value,
+                                  const std::string& error)> function) const;
+
+  // Runs the tasks of the scheduler until this task is ready. Must only be
+  // called by the main thread, outside of a task, e.g., at startup.
+  void Wait() const;
+
+ private:
+  friend class Promise<ValueType>;
+
+  explicit Task(std::shared_ptr<internal::TaskState<ValueType> > state)
+      : state_(std::move(state)) {}
+
+  std::shared_ptr<internal::TaskState<ValueType> > state_;
+};
+
+// The producer side of a task completed outside of the scheduler, e.g., by
+// the callback of a read. Promises are cheap to copy, so that callbacks may
+// capture them, and only the first SetValue() or SetError() of the copies
+// counts.
+template <typename ValueType>
+class Promise {
+ public:
+  explicit Promise(TaskScheduler* scheduler)
+      : state_(std::make_shared<internal::TaskState<ValueType> >(scheduler)) {}
+
+  Task<ValueType> task() const {
+    return Task<ValueType>(state_);
+  }
+
+  // Completes the task with the value. May be called from any thread.
+  void SetValue(ValueType value) const {
+    std::unique_ptr<ValueType> new_value(new ValueType(std::move(value)));
+    state_->Complete(std::move(new_value), std::string());
+  }
+
+  // Fails the task with the error. May be called from any thread.
+  void SetError(const std::string& error) const {
+    state_->Complete(nullptr, error);
+  }
+
+ private:
+  std::shared_ptr<internal::TaskState<ValueType> > state_;
+};
+
+template <typename ResultType>
+Task<ResultType> TaskScheduler::Run(
+    const TaskAffinity affinity,
+    std::function<bool(ResultType* result, std::string* error_info_log)>
+        function) {
+  const Promise<ResultType> promise(this);
+  Schedule(affinity, [promise, function]() {
+    ResultType result;
+    std::string error_info_log;
+    if (function(&result, &error_info_log)) {
+      promise.SetValue(std::move(result));
+    } else {
+      promise.SetError(error_info_log);
+    }
+  });
+  return promise.task();
+}
+
+template <typename ValueType>
+template <typename ResultType>
+Task<ResultType> Task<ValueType>::Then(
+    const TaskAffinity affinity,
+    std::function<bool(const ValueType& value,
+                       ResultType* result,
+                       std::string* error_info_log)> function) const {
+  const Promise<ResultType> promise(state_->scheduler);
+  const std::shared_ptr<internal::TaskState<ValueType> > state = state_;
+  state_->AddContinuation(affinity, [state, promise, function]() {
+    if (state->value == nullptr) {
+      promise.SetError(state->error);
+      return;
+    }
+    ResultType result;
+    std::string error_info_log;
+    if (function(*state->value, &result, &error_info_log)) {
+      promise.SetValue(std::move(result));
+    } else {
+      promise.SetError(error_info_log);
+    }
+  });
+  return promise.task();
+}
+
+template <typename ValueType>
+void Task<ValueType>::Finally(
+    const TaskAffinity affinity,
+    std::function<void(const ValueType* value,
+                       const std::string& error)> function) const {
+  const std::shared_ptr<internal::TaskState<ValueType> > state = state_;
+  state_->AddContinuation(affinity, [state, function]() {
+    function(state->value.get(), state->error);
+  });
+}
+
+template <typename ValueType>
+void Task<ValueType>::Wait() const {
+  while (!ready()) {
+    if (!state_->scheduler->RunPending()) std::this_thread::yield();
+  }
+}
+
+}  // namespace wvu
+
+#endif  // GLUTILS_TASK_H_
@@ -0,0 +1,545 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "terrain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "frame_uniforms.h"
+#include "gl_state_cache.h"
+#include "shader_program.h"
+#include "transforms.h"
+
+namespace wvu {
+namespace {
+// Attribute locations of the grid positions and of the patches.
+constexpr GLuint kGridPositionLocation = 0;
+constexpr GLuint kPatchNodeLocation = 1;
+constexpr GLuint kPatchMorphLocation = 2;
+// Floats per patch in the instance buffer.
+constexpr int kPatchStride = 5;
+// The largest bumps of GenerateHeightmap() span this fraction of the map.
+constexpr float kMaxCircleSize = 0.3f;
+
+// Displaces the grid by the heights, morphing the odd vertices onto the grid
+// of the next level (see TerrainParameters::morph_start).
+const std::string kTerrainVertexShader = std::string(
+    "#version 330 core\n"
+    "layout (location = 0) in vec2 grid_position;\n"
+    "layout (location = 1) in vec3 patch_node;\n"
+    "layout (location = 2) in vec2 morph_range;\n") +
+    FrameUniforms::GlslDeclaration() +
+    "uniform sampler2D heightmap;\n"
+    "uniform vec3 terrain_origin;\n"
+    "uniform float terrain_size;\n"
+    "uniform float height_scale;\n"
+    "uniform float grid_resolution;\n"
+    "out vec3 normal;\n"
+    "out float height;\n"
+    "float SampleHeight(vec2 xz) {\n"
+    "  vec2 size = vec2(textureSize(heightmap, 0));\n"
+    "  vec2 uv = (xz - terrain_origin.xz) / terrain_size;\n"
+    "  uv = (uv * (size - 1.0) + 0.5) / size;\n"
+    "  return textureLod(heightmap, uv, 0.0).r * height_scale;\n"
+    "}\n"
+    "void main() {\n"
+    "  vec2 xz = patch_node.xy + grid_position * patch_node.z;\n"
+    "  vec3 position = vec3(xz.x, terrain_origin.y + SampleHeight(xz), xz.y);\n"
+    "  float morph = clamp((distance(position, camera_position.xyz) -\n"
+    "                       morph_range.x) / (morph_range.y - morph_range.x),\n"
+    "                      0.0, 1.0);\n"
+    "  vec2 odd = fract(grid_position * grid_resolution * 0.5) * 2.0 /\n"
+    "      grid_resolution;\n"
+    "  xz = patch_node.xy + (grid_position - odd * morph) * patch_node.z;\n"
+    "  float y = SampleHeight(xz);\n"
+    "  vec2 texel = terrain_size / (vec2(textureSize(heightmap, 0)) - 1.0);\n"
+    "  float slope_x = (SampleHeight(xz + vec2(texel.x, 0.0)) -\n"
+    "                   SampleHeight(xz - vec2(texel.x, 0.0))) / texel.x;\n"
+    "  float slope_z = (SampleHeight(xz + vec2(0.0, texel.y)) -\n"
+    "                   SampleHeight(xz - vec2(0.0, texel.y))) / texel.y;\n"
+    "  normal = normalize(vec3(-0.5 * slope_x, 1.0, -0.5 * slope_z));\n"
+    "  height = y / height_scale;\n"
+    "  gl_Position =\n"
+    "      view_projection * vec4(xz.x, terrain_origin.y + y, xz.y, 1.0);\n"
+    "}\n";
+
+// Shades the grass of the valleys, the rock of the slopes and the peaks with
+// a fixed sun.
+const char kTerrainFragmentShader[] =
+    "#version 330 core\n"
+    "in vec3 normal;\n"
+    "in float height;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "  vec3 n = normalize(normal);\n"
+    "  vec3 grass = vec3(0.25, 0.4, 0.15);\n"
+    "  vec3 rock = vec3(0.45, 0.4, 0.35);\n"
+    "  vec3 albedo = mix(grass, rock, max(smoothstep(0.5, 0.8, height),\n"
+    "                                     smoothstep(0.8, 0.6, n.y)));\n"
+    "  float diffuse = max(dot(n, normalize(vec3(0.4, 1.0, 0.3))), 0.0);\n"
+    "  color = vec4(albedo * (0.25 + 0.75 * diffuse), 1.0);\n"
+    "}\n";
+
+// Returns true if the sphere touches the box.
+bool SphereTouchesBox(const Eigen::Vector3f& center,
+                      const float radius,
+                      const Eigen::Vector3f& box_min,
+                      const Eigen::Vector3f& box_max) {
+  const Eigen::Vector3f nearest = center.cwiseMax(box_min).cwiseMin(box_max);
+  return (center - nearest).squaredNorm() <= radius * radius;
+}
+
+}  // namespace
+
+void GenerateHeightmap(const int width,
+                       const int height,
+                       const int num_circles,
+                       const unsigned int seed,
+                       std::vector<float>* heights) {
+  heights->assign(width * height, 0.0f);
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  const int map_size = std::max(width, height);
+  for (int i = 0; i < num_circles; ++i) {
+    const float center_x = width * unit(generator);
+    const float center_z = height * unit(generator);
+    const float radius = 0.5f * kMaxCircleSize * map_size * unit(generator);
+    // A few more bumps than dents, as in the example.
+    const float displacement =
+        (unit(generator) < 0.1f ? -0.5f : 0.5f) * unit(generator);
+    const int min_x = std::max(static_cast<int>(center_x - radius), 0);
+    const int max_x = std::min(static_cast<int>(center_x + radius), width - 1);
+    const int min_z = std::max(static_cast<int>(center_z - radius), 0);
+    const int max_z = std::min(static_cast<int>(center_z + radius), height - 1);
+    for (int z = min_z; z <= max_z; ++z) {
+      for (int x = min_x; x <= max_x; ++x) {
+        const float dx = x - center_x;
+        const float dz = z - center_z;
+        const float distance = std::sqrt(dx * dx + dz * dz) / radius;
+        if (distance > 1.0f) continue;
+        (*heights)[z * width + x] +=
+            displacement * (1.0f + std::cos(distance * 3.14159265f));
+      }
+    }
+  }
+  // Rescale the heights to [0, 1].
+  const auto range = std::minmax_element(heights->begin(), heights->end());
+  const float min_height = *range.first;
+  const float height_range = std::max(*range.second - min_height, 1e-6f);
+  for (float& value : *heights) {
+    value = (value - min_height) / height_range;
+  }
+}
+
+Terrain::Terrain()
+    : width_(0),
+      height_(0),
+      height_texture_id_(0),
+      vertex_buffer_id_(0),
+      index_buffer_id_(0),
+      instance_buffer_id_(0),
+      vertex_array_id_(0),
+      num_patch_indices_(0),
+      instance_capacity_(0),
+      group_offsets_{0, 0, 0, 0, 0},
+      camera_position_(Eigen::Vector3f::Zero()),
+      frustum_planes_(Eigen::Matrix<float, 6, 4>::Zero()) {}
+
+Terrain::~Terrain() {
+  Reset();
+}
+
+bool Terrain::Initialize(const float* heights,
+                         const int width,
+                         const int height,
+                         const TerrainParameters& parameters,
+                         const FrameUniforms& frame_uniforms,
+                         std::string* error_info_log) {
+  if (vertex_array_id_ != 0) {
+    *error_info_log = "The terrain is already initialized.";
+    return false;
+  }
+  if (width < 2 || height < 2 || parameters.num_levels < 1 ||
+      parameters.patch_resolution < 2 ||
+      parameters.patch_resolution % 2 != 0 || parameters.size <= 0.0f) {
+    *error_info_log = "Invalid terrain heightmap or parameters.";
+    return false;
+  }
+  parameters_ = parameters;
+  width_ = width;
+  height_ = height;
+  heights_.assign(heights, heights + width * height);
+  shader_program_.LoadVertexShaderFromString(kTerrainVertexShader);
+  shader_program_.LoadFragmentShaderFromString(kTerrainFragmentShader);
+  if (!shader_program_.Create(error_info_log) ||
+      !frame_uniforms.Attach(&shader_program_)) {
+    return false;
+  }
+
+  // The bounds of the finest nodes cover the heights around them, and every
+  // coarser node merges the bounds of its children.
+  node_bounds_.resize(parameters_.num_levels);
+  for (int level = 0; level < parameters_.num_levels; ++level) {
+    const int num_nodes = NumNodes(level);
+    NodeBounds& bounds = node_bounds_[level];
+    bounds.min_heights.assign(num_nodes * num_nodes,
+                              std::numeric_limits<float>::max());
+    bounds.max_heights.assign(num_nodes * num_nodes,
+                              std::numeric_limits<float>::lowest());
+    for (int z = 0; z < num_nodes; ++z) {
+      for (int x = 0; x < num_nodes; ++x) {
+        float& min_height = bounds.min_heights[z * num_nodes + x];
+        float& max_height = bounds.max_heights[z * num_nodes + x];
+        if (level > 0) {
+          const NodeBounds& children = node_bounds_[level - 1];
+          for (int child = 0; child < 4; ++child) {
+            const int index = (2 * z + child / 2) * 2 * num_nodes +
+                2 * x + child % 2;
+            min_height = std::min(min_height, children.min_heights[index]);
+            max_height = std::max(max_height, children.max_heights[index]);
+          }
+          continue;
+        }
+        const float scale_x = static_cast<float>(width_ - 1) / num_nodes;
+        const float scale_z = static_cast<float>(height_ - 1) / num_nodes;
+        const int min_u = static_cast<int>(std::floor(x * scale_x));
+        const int max_u = std::min(
+            static_cast<int>(std::ceil((x + 1) * scale_x)), width_ - 1);
+        const int min_v = static_cast<int>(std::floor(z * scale_z));
+        const int max_v = std::min(
+            static_cast<int>(std::ceil((z + 1) * scale_z)), height_ - 1);
+        for (int v = min_v; v <= max_v; ++v) {
+          for (int u = min_u; u <= max_u; ++u) {
+            const float value = heights_[v * width_ + u];
+            min_height = std::min(min_height, value);
+            max_height = std::max(max_height, value);
+          }
+        }
+      }
+    }
+  }
+  for (NodeBounds& bounds : node_bounds_) {
+    for (float& value : bounds.min_heights) {
+      value = parameters_.origin.y() + value * parameters_.height_scale;
+    }
+    for (float& value : bounds.max_heights) {
+      value = parameters_.origin.y() + value * parameters_.height_scale;
+    }
+  }
+  const float lod_distance = parameters_.lod_distance > 0.0f ?
+      parameters_.lod_distance : 4.0f * NodeSize(0);
+  lod_ranges_.resize(parameters_.num_levels);
+  for (int level = 0; level < parameters_.num_levels; ++level) {
+    lod_ranges_[level] = lod_distance * (1 << level);
+  }
+
+  // The grid patch, with the indices of its quarters one after the other.
+  const int resolution = parameters_.patch_resolution;
+  std::vector<GLfloat> grid_positions;
+  grid_positions.reserve(2 * (resolution + 1) * (resolution + 1));
+  for (int z = 0; z <= resolution; ++z) {
+    for (int x = 0; x <= resolution; ++x) {
+      grid_positions.push_back(static_cast<float>(x) / resolution);
+      grid_positions.push_back(static_cast<float>(z) / resolution);
+    }
+  }
+  std::vector<GLuint> indices;
+  indices.reserve(6 * resolution * resolution);
+  const int half = resolution / 2;
+  for (int quarter = 0; quarter < 4; ++quarter) {
+    const int first_x = (quarter % 2) * half;
+    const int first_z = (quarter / 2) * half;
+    for (int z = first_z; z < first_z + half; ++z) {
+      for (int x = first_x; x < first_x + half; ++x) {
+        const GLuint corner = z * (resolution + 1) + x;
+        const GLuint next_row = corner + resolution + 1;
+        // Counterclockwise seen from above.
+        indices.insert(indices.end(), {corner, next_row, corner + 1,
+                                       corner + 1, next_row, next_row + 1});
+      }
+    }
+  }
+  num_patch_indices_ = indices.size();
+
+  GlStateCache* gl_state = GlStateCache::Current();
+  BufferAllocator* allocator = BufferAllocator::Get();
+  glGenVertexArrays(1, &vertex_array_id_);
+  vertex_buffer_id_ = allocator->CreateBuffer(VERTEX_DATA);
+  index_buffer_id_ = allocator->CreateBuffer(INDEX_DATA);
+  instance_buffer_id_ = allocator->CreateBuffer(VERTEX_DATA);
+  gl_state->BindVertexArray(vertex_array_id_);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, vertex_buffer_id_);
+  allocator->BufferData(vertex_buffer_id_, GL_ARRAY_BUFFER,
+                        grid_positions.size() * sizeof(GLfloat),
+                        grid_positions.data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(kGridPositionLocation, 2, GL_FLOAT, GL_FALSE, 0,
+                        nullptr);
+  glEnableVertexAttribArray(kGridPositionLocation);
+  gl_state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_id_);
+  allocator->BufferData(index_buffer_id_, GL_ELEMENT_ARRAY_BUFFER,
+                        indices.size() * sizeof(GLuint), indices.data(),
+                        GL_STATIC_DRAW);
+  // The pointers of the patches are set per group when drawing.
+  glEnableVertexAttribArray(kPatchNodeLocation);
+  glEnableVertexAttribArray(kPatchMorphLocation);
+  glVertexAttribDivisor(kPatchNodeLocation, 1);
+  glVertexAttribDivisor(kPatchMorphLocation, 1);
+  gl_state->BindVertexArray(0);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // The heights are filtered linearly, so the patches between the texels
+  // follow the same surface as HeightAt().
+  glGenTextures(1, &height_texture_id_);
+  glBindTexture(GL_TEXTURE_2D, height_texture_id_);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width_, height_, 0, GL_RED,
+               GL_FLOAT, heights_.data());
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  shader_program_.Use();
+  shader_program_.SetUniform("heightmap", static_cast<GLint>(0));
+  shader_program_.SetUniform("terrain_origin", parameters_.origin);
+  shader_program_.SetUniform("terrain_size", parameters_.size);
+  shader_program_.SetUniform("height_scale", parameters_.height_scale);
+  shader_program_.SetUniform("grid_resolution",
+                             static_cast<GLfloat>(resolution));
+  if (vertex_buffer_id_ == 0 || index_buffer_id_ == 0 ||
+      instance_buffer_id_ == 0 || height_texture_id_ == 0) {
+    *error_info_log = "Could not create the terrain buffers.";
+    Reset();
+    return false;
+  }
+  return true;
+}
+
+void Terrain::ComputeNodeBox(const int level,
+                             const int x,
+                             const int z,
+                             Eigen::Vector3f* box_min,
+                             Eigen::Vector3f* box_max) const {
+  const float size = NodeSize(level);
+  const int index = z * NumNodes(level) + x;
+  *box_min = Eigen::Vector3f(parameters_.origin.x() + x * size,
+                             node_bounds_[level].min_heights[index],
+                             parameters_.origin.z() + z * size);
+  *box_max = Eigen::Vector3f(box_min->x() + size,
+                             node_bounds_[level].max_heights[index],
+                             box_min->z() + size);
+}
+
+void Terrain::AddPatch(const int level,
+                       const int x,
+                       const int z,
+                       const int group) {
+  const float size = NodeSize(level);
+  std::vector<GLfloat>& patches = patch_groups_[group];
+  patches.push_back(parameters_.origin.x() + x * size);
+  patches.push_back(parameters_.origin.z() + z * size);
+  patches.push_back(size);
+  // The coarsest level has no next level to morph into.
+  if (level == parameters_.num_levels - 1) {
+    patches.push_back(0.5f * std::numeric_limits<float>::max());
+    patches.push_back(std::numeric_limits<float>::max());
+    return;
+  }
+  const float previous_range = level > 0 ? lod_ranges_[level - 1] : 0.0f;
+  patches.push_back(previous_range + parameters_.morph_start *
+                    (lod_ranges_[level] - previous_range));
+  patches.push_back(lod_ranges_[level]);
+}
+
+bool Terrain::SelectNode(const int level,
+                         const int x,
+                         const int z,
+                         const bool root) {
+  Eigen::Vector3f box_min, box_max;
+  ComputeNodeBox(level, x, z, &box_min, &box_max);
+  if (!root && !SphereTouchesBox(camera_position_, lod_ranges_[level],
+                                 box_min, box_max)) {
+    return false;
+  }
+  // The box is outside a plane when its corner farthest along the normal is.
+  for (int i = 0; i < 6; ++i) {
+    const Eigen::Vector3f normal = frustum_planes_.row(i).head<3>();
+    Eigen::Vector3f corner;
+    for (int j = 0; j < 3; ++j) {
+      corner[j] = normal[j] >= 0.0f ? box_max[j] : box_min[j];
+    }
+    if (normal.dot(corner) + frustum_planes_(i, 3) < 0.0f) {
+      ++statistics_.num_culled_nodes;
+      return true;
+    }
+  }
+  if (level == 0 || !SphereTouchesBox(camera_position_,
+                                      lod_ranges_[level - 1], box_min,
+                                      box_max)) {
+    AddPatch(level, x, z, 0);
+    return true;
+  }
+  // The children beyond the range of their level leave their quarter to this
+  // node.
+  for (int child = 0; child < 4; ++child) {
+    if (!SelectNode(level - 1, 2 * x + child % 2, 2 * z + child / 2, false)) {
+      AddPatch(level, x, z, 1 + child);
+    }
+  }
+  return true;
+}
+
+void Terrain::Update(const Eigen::Vector3f& camera_position,
+                     const Eigen::Matrix4f& view_projection) {
+  statistics_ = TerrainStatistics();
+  if (vertex_array_id_ == 0) return;
+  camera_position_ = camera_position;
+  frustum_planes_ = ExtractFrustumPlanes(view_projection);
+  for (std::vector<GLfloat>& patches : patch_groups_) patches.clear();
+  SelectNode(parameters_.num_levels - 1, 0, 0, true);
+
+  // Upload the groups one after the other.
+  int num_patches = 0;
+  for (int group = 0; group < kNumPatchGroups; ++group) {
+    group_offsets_[group] = num_patches;
+    const int group_size = patch_groups_[group].size() / kPatchStride;
+    num_patches += group_size;
+    statistics_.num_triangles += static_cast<int64_t>(group_size) *
+        (group == 0 ? num_patch_indices_ : num_patch_indices_ / 4) / 3;
+  }
+  statistics_.num_patches = num_patches;
+  if (num_patches == 0) return;
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, instance_buffer_id_);
+  if (num_patches > instance_capacity_) {
+    // Grow geometrically to amortize the reallocations.
+    instance_capacity_ = std::max(num_patches, 2 * instance_capacity_);
+  }
+  BufferAllocator::Get()->BufferData(
+      instance_buffer_id_, GL_ARRAY_BUFFER,
+      instance_capacity_ * kPatchStride * sizeof(GLfloat), nullptr,
+      GL_STREAM_DRAW);
+  for (int group = 0; group < kNumPatchGroups; ++group) {
+    const std::vector<GLfloat>& patches = patch_groups_[group];
+    if (patches.empty()) continue;
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    group_offsets_[group] * kPatchStride * sizeof(GLfloat),
+                    patches.size() * sizeof(GLfloat), patches.data());
+  }
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Terrain::Render() {
+  GlStateCache* gl_state = GlStateCache::Current();
+  if (statistics_.num_patches == 0) return;
+  gl_state->SetCapability(GL_DEPTH_TEST, true);
+  gl_state->SetCapability(GL_CULL_FACE, true);
+  // The terrain is opaque, even after a depth prepass.
+  gl_state->DepthMask(true);
+  shader_program_.Use();
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, height_texture_id_);
+  gl_state->BindVertexArray(vertex_array_id_);
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, instance_buffer_id_);
+  const GLsizei stride = kPatchStride * sizeof(GLfloat);
+  for (int group = 0; group < kNumPatchGroups; ++group) {
+    const int num_patches = patch_groups_[group].size() / kPatchStride;
+    if (num_patches == 0) continue;
+    // The instanced attributes start at the first patch of the group.
+    const uintptr_t offset = group_offsets_[group] * stride;
+    glVertexAttribPointer(kPatchNodeLocation, 3, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const GLvoid*>(offset));
+    glVertexAttribPointer(
+        kPatchMorphLocation, 2, GL_FLOAT, GL_FALSE, stride,
+        reinterpret_cast<const GLvoid*>(offset + 3 * sizeof(GLfloat)));
+    const int num_indices =
+        group == 0 ? num_patch_indices_ : num_patch_indices_ / 4;
+    const uintptr_t first_index =
+        group == 0 ? 0 : (group - 1) * num_patch_indices_ / 4;
+    glDrawElementsInstanced(
+        GL_TRIANGLES, num_indices, GL_UNSIGNED_INT,
+        reinterpret_cast<const GLvoid*>(first_index * sizeof(GLuint)),
+        num_patches);
+  }
+  gl_state->BindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+float Terrain::HeightAt(const float x, const float z) const {
+  if (heights_.empty()) return parameters_.origin.y();
+  const float u = std::min(std::max(
+      (x - parameters_.origin.x()) / parameters_.size, 0.0f), 1.0f) *
+      (width_ - 1);
+  const float v = std::min(std::max(
+      (z - parameters_.origin.z()) / parameters_.size, 0.0f), 1.0f) *
+      (height_ - 1);
+  const int u0 = std::min(static_cast<int>(u), width_ - 2);
+  const int v0 = std::min(static_cast<int>(v), height_ - 2);
+  const float s = u - u0;
+  const float t = v - v0;
+  const float* row = heights_.data() + v0 * width_ + u0;
+  const float height = (1.0f - t) * ((1.0f - s) * row[0] + s * row[1]) +
+      t * ((1.0f - s) * row[width_] + s * row[width_ + 1]);
+  return parameters_.origin.y() + height * parameters_.height_scale;
+}
+
+void Terrain::Reset() {
+  if (vertex_array_id_ != 0) {
+    GlStateCache::Current()->DeleteVertexArrays(1, &vertex_array_id_);
+  }
+  vertex_array_id_ = 0;
+  if (height_texture_id_ != 0) glDeleteTextures(1, &height_texture_id_);
+  height_texture_id_ = 0;
+  BufferAllocator* allocator = BufferAllocator::Get();
+  allocator->DeleteBuffer(&vertex_buffer_id_);
+  allocator->DeleteBuffer(&index_buffer_id_);
+  allocator->DeleteBuffer(&instance_buffer_id_);
+  instance_capacity_ = 0;
+  heights_.clear();
+  node_bounds_.clear();
+  for (std::vector<GLfloat>& patches : patch_groups_) patches.clear();
+  statistics_ = TerrainStatistics();
+}
+
+}  // namespace wvu
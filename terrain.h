@@ -0,0 +1,232 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_TERRAIN_H_
+#define GLUTILS_TERRAIN_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "frame_uniforms.h"
+#include "shader_program.h"
+
+namespace wvu {
+// The extent and the levels of detail of a Terrain.
+struct TerrainParameters {
+  // The corner of the terrain with the smallest x and z, at height zero.
+  Eigen::Vector3f origin = Eigen::Vector3f::Zero();
+  // The width and the depth of the terrain in world units.
+  float size = 1024.0f;
+  // The height of the heights of one.
+  float height_scale = 64.0f;
+  // The number of quads along each side of the grid patch. Must be even, so
+  // that the patches can morph into the grid of the next level.
+  int patch_resolution = 32;
+  // The number of levels of the quadtree. The root covers the terrain, and
+  // every level halves the size of the patches.
+  int num_levels = 6;
+  // The distance up to which the finest level is drawn, doubling at every
+  // coarser level, or zero for four times the size of the finest patches.
+  float lod_distance = 0.0f;
+  // The fraction of the range of a level after which its patches morph into
+  // the next one.
+  float morph_start = 0.7f;
+};
+
+// Counters of the last Terrain::Update().
+struct TerrainStatistics {
+  int num_patches = 0;
+  // Nodes of the quadtree outside the view frustum.
+  int num_culled_nodes = 0;
+  int64_t num_triangles = 0;
+};
+
+// Fills width x height heights in [0, 1] by displacing the ground with
+// num_circles random circular bumps and dents, as the heightmap example of
+// GLFW does.
+void GenerateHeightmap(const int width,
+                       const int height,
+                       const int num_circles,
+                       const unsigned int seed,
+                       std::vector<float>* heights);
+
+// This class renders a terrain from a heightmap with the continuous distance-
+// dependent level of detail method (CDLOD, Strugar 2010). The heights live in
+// a floating-point texture, and the only geometry is one grid patch, drawn
+// once per selected node of a quadtree, with the offset and the size of the
+// node as instanced attributes. The vertex shader displaces the grid by the
+// heights. The nodes are selected every frame by their distance to the camera:
+// each level is drawn up to a distance that doubles with the level, and the
+// patches near the end of their range morph their odd vertices onto the grid
+// of the next level, so the levels meet without cracks or popping. The nodes
+// outside the view frustum are skipped, using the bounds of their heights.
+// The memory of the terrain is the heights and a fixed patch, whatever its
+// size.
+//
+// Example:
+//
+// std::vector<float> heights;
+// wvu::GenerateHeightmap(1025, 1025, 400, 1, &heights);
+// wvu::Terrain terrain;
+// terrain.Initialize(heights.data(), 1025, 1025, wvu::TerrainParameters(),
+//                    frame_uniforms, &error_info_log);
+// while (...) {  // Rendering loop.
+//   terrain.Update(camera_position, projection * view);
+//   terrain.Render();
+// }
+class Terrain {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  Terrain();
+  ~Terrain();
+
+  // Uploads the heights and the grid patch, and compiles the program. Returns
+  // true if successful.
+  // Parameters:
+  //   heights  The width x height heights, row by row along x, scaled by the
+  //     height scale of the parameters.
+  //   width  The number of heights along x, at least two.
+  //   height  The number of heights along z, at least two.
+  //   parameters  The extent and the levels of detail of the terrain.
+  //   frame_uniforms  The uniforms of the camera, attached to the program.
+  bool Initialize(const float* heights,
+                  const int width,
+                  const int height,
+                  const TerrainParameters& parameters,
+                  const FrameUniforms& frame_uniforms,
+                  std::string* error_info_log);
+
+  // Selects the patches to draw from a camera, and uploads them.
+  // Parameters:
+  //   camera_position  The position of the camera in world space.
+  //   view_projection  The matrix transforming world to clip coordinates.
+  void Update(const Eigen::Vector3f& camera_position,
+              const Eigen::Matrix4f& view_projection);
+
+  // Draws the patches of the last Update().
+  void Render();
+
+  // Deletes the texture, the buffers and the vertex array.
+  void Reset();
+
+  // Returns the height of the terrain at a point of the xz plane, filtered as
+  // the vertex shader does, e.g., to keep a camera above the ground.
+  float HeightAt(const float x, const float z) const;
+
+  const TerrainParameters& parameters() const {
+    return parameters_;
+  }
+
+  const TerrainStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // The whole nodes and their four quarters.
+  static constexpr int kNumPatchGroups = 5;
+
+  // The bounds of the heights of every node of a level, in world units.
+  struct NodeBounds {
+    std::vector<float> min_heights;
+    std::vector<float> max_heights;
+  };
+
+  // Adds the node (x, z) of a level, or its children, to the patches.
+  // Returns false if the node is beyond the range of its level, so that its
+  // parent draws its area.
+  bool SelectNode(const int level,
+                  const int x,
+                  const int z,
+                  const bool root);
+
+  // Adds the node (x, z) of a level to a group of patches.
+  void AddPatch(const int level, const int x, const int z, const int group);
+
+  // Returns the number of nodes along a side of a level. Level 0 is the
+  // finest.
+  int NumNodes(const int level) const {
+    return 1 << (parameters_.num_levels - 1 - level);
+  }
+
+  // Returns the world size of a node of a level.
+  float NodeSize(const int level) const {
+    return parameters_.size / NumNodes(level);
+  }
+
+  // Computes the bounds of the node (x, z) of a level in world space.
+  void ComputeNodeBox(const int level,
+                      const int x,
+                      const int z,
+                      Eigen::Vector3f* box_min,
+                      Eigen::Vector3f* box_max) const;
+
+  TerrainParameters parameters_;
+  int width_;
+  int height_;
+  std::vector<float> heights_;
+  std::vector<NodeBounds> node_bounds_;
+  // The distance up to which every level is drawn.
+  std::vector<float> lod_ranges_;
+  ShaderProgram shader_program_;
+  GLuint height_texture_id_;
+  GLuint vertex_buffer_id_;
+  GLuint index_buffer_id_;
+  GLuint instance_buffer_id_;
+  GLuint vertex_array_id_;
+  int num_patch_indices_;
+  // Capacity in patches of the instance buffer.
+  int instance_capacity_;
+  // The patches selected by the last Update(), five floats each: the offset
+  // along x and z, the size and the morph range. The first group draws whole
+  // nodes, and the others one of their quarters, whose indices are
+  // contiguous in the index buffer.
+  std::vector<GLfloat> patch_groups_[kNumPatchGroups];
+  // The first patch of every group in the instance buffer.
+  int group_offsets_[kNumPatchGroups];
+  // The camera and the frustum planes of the selection.
+  Eigen::Vector3f camera_position_;
+  Eigen::Matrix<float, 6, 4> frustum_planes_;
+  TerrainStatistics statistics_;
+
+  Terrain(const Terrain&) = delete;
+  Terrain& operator=(const Terrain&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_TERRAIN_H_
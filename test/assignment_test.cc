@@ -0,0 +1,395 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+// The tests of the functions of assignment.h. The scalar functions are
+// compared against Eigen, and the batched kernels against the scalar
+// functions, on array sizes that exercise the remainders of the SIMD loops.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include "gtest/gtest.h"
+
+#include "assignment.h"
+
+namespace wvu {
+namespace {
+constexpr float kTolerance = 1e-5f;
+// Array sizes below, at and above the SIMD widths.
+const int kArraySizes[] = {1, 3, 4, 7, 8, 9, 33};
+
+float RandomFloat(std::mt19937* generator) {
+  return std::uniform_real_distribution<float>(-1.0f, 1.0f)(*generator);
+}
+
+Vector3fArray RandomVector3fArray(const int size, std::mt19937* generator) {
+  Vector3fArray vectors;
+  vectors.resize(size);
+  for (int i = 0; i < size; ++i) {
+    vectors.x[i] = RandomFloat(generator);
+    vectors.y[i] = RandomFloat(generator);
+    vectors.z[i] = RandomFloat(generator);
+  }
+  return vectors;
+}
+
+Eigen::Vector3f GetVector(const Vector3fArray& vectors, const int i) {
+  return Eigen::Vector3f(vectors.x[i], vectors.y[i], vectors.z[i]);
+}
+
+TEST(AssignmentTest, Add3dPoints) {
+  const Eigen::Vector3f x(1.0f, 2.0f, 3.0f);
+  const Eigen::Vector3f y(-4.0f, 5.0f, 0.5f);
+  EXPECT_TRUE(Add3dPoints(x, y).isApprox(x + y));
+}
+
+TEST(AssignmentTest, Add4dPoints) {
+  const Eigen::Vector4f x(1.0f, 2.0f, 3.0f, 1.0f);
+  const Eigen::Vector4f y(-4.0f, 5.0f, 0.5f, 0.0f);
+  EXPECT_TRUE(Add4dPoints(x, y).isApprox(x + y));
+}
+
+TEST(AssignmentTest, Multiply4x4Matrices) {
+  const Eigen::Matrix4f x = Eigen::Matrix4f::Random();
+  const Eigen::Matrix4f y = Eigen::Matrix4f::Random();
+  EXPECT_TRUE(Multiply4x4Matrices(x, y).isApprox(x * y));
+}
+
+TEST(AssignmentTest, MultiplyVectorAndMatrix) {
+  const Eigen::Matrix4f x = Eigen::Matrix4f::Random();
+  const Eigen::Vector4f y = Eigen::Vector4f::Random();
+  EXPECT_TRUE(MultiplyVectorAndMatrix(x, y).isApprox(x * y));
+}
+
+TEST(AssignmentTest, ComputeDotProduct) {
+  const Eigen::Vector3f x(1.0f, 2.0f, 3.0f);
+  const Eigen::Vector3f y(-4.0f, 5.0f, 0.5f);
+  EXPECT_NEAR(ComputeDotProduct(x, y), x.dot(y), kTolerance);
+}
+
+TEST(AssignmentTest, ComputeCrossProduct) {
+  const Eigen::Vector3f x(1.0f, 2.0f, 3.0f);
+  const Eigen::Vector3f y(-4.0f, 5.0f, 0.5f);
+  EXPECT_TRUE(ComputeCrossProduct(x, y).isApprox(x.cross(y)));
+}
+
+TEST(AssignmentTest, CalculateAngleBetweenTwoVectors) {
+  EXPECT_NEAR(CalculateAngleBetweenTwoVectors(Eigen::Vector3f::UnitX(),
+                                              Eigen::Vector3f::UnitY()),
+              M_PI / 2.0, kTolerance);
+  EXPECT_NEAR(CalculateAngleBetweenTwoVectors(Eigen::Vector3f::UnitX(),
+                                              -Eigen::Vector3f::UnitX()),
+              M_PI, kTolerance);
+  // Nearly parallel vectors, where the arc cosine loses the precision.
+  EXPECT_NEAR(CalculateAngleBetweenTwoVectors(
+                  Eigen::Vector3f::UnitX(), Eigen::Vector3f(1.0f, 1e-4f, 0.0f)),
+              1e-4f, 1e-7f);
+}
+
+TEST(AssignmentTest, MultiplyVectorArrayAndMatrix) {
+  std::mt19937 generator(5);
+  const Eigen::Matrix4f x = Eigen::Matrix4f::Random();
+  for (const int size : kArraySizes) {
+    Vector4fArray y;
+    y.resize(size);
+    for (int i = 0; i < size; ++i) {
+      y.x[i] = RandomFloat(&generator);
+      y.y[i] = RandomFloat(&generator);
+      y.z[i] = RandomFloat(&generator);
+      y.w[i] = 1.0f;
+    }
+    Vector4fArray result;
+    MultiplyVectorArrayAndMatrix(x, y, &result);
+    ASSERT_EQ(result.size(), size);
+    for (int i = 0; i < size; ++i) {
+      const Eigen::Vector4f expected = MultiplyVectorAndMatrix(
+          x, Eigen::Vector4f(y.x[i], y.y[i], y.z[i], y.w[i]));
+      EXPECT_NEAR(result.x[i], expected.x(), kTolerance);
+      EXPECT_NEAR(result.y[i], expected.y(), kTolerance);
+      EXPECT_NEAR(result.z[i], expected.z(), kTolerance);
+      EXPECT_NEAR(result.w[i], expected.w(), kTolerance);
+    }
+  }
+}
+
+TEST(AssignmentTest, Multiply4x4MatrixArray) {
+  const Eigen::Matrix4f x = Eigen::Matrix4f::Random();
+  for (const int size : kArraySizes) {
+    std::vector<Eigen::Matrix4f> y(size);
+    for (Eigen::Matrix4f& matrix : y) matrix = Eigen::Matrix4f::Random();
+    std::vector<Eigen::Matrix4f> result(size);
+    Multiply4x4MatrixArray(x, y.data(), size, result.data());
+    for (int i = 0; i < size; ++i) {
+      EXPECT_TRUE(result[i].isApprox(Multiply4x4Matrices(x, y[i]), 1e-5f));
+    }
+    // The result may alias the input.
+    Multiply4x4MatrixArray(x, y.data(), size, y.data());
+    for (int i = 0; i < size; ++i) {
+      EXPECT_TRUE(y[i].isApprox(result[i]));
+    }
+  }
+}
+
+TEST(AssignmentTest, ComputeDotProducts) {
+  std::mt19937 generator(7);
+  for (const int size : kArraySizes) {
+    const Vector3fArray x = RandomVector3fArray(size, &generator);
+    const Vector3fArray y = RandomVector3fArray(size, &generator);
+    std::vector<float> result;
+    ComputeDotProducts(x, y, &result);
+    ASSERT_EQ(result.size(), size);
+    for (int i = 0; i < size; ++i) {
+      EXPECT_NEAR(result[i],
+                  ComputeDotProduct(GetVector(x, i), GetVector(y, i)),
+                  kTolerance);
+    }
+  }
+}
+
+TEST(AssignmentTest, ComputeCrossProducts) {
+  std::mt19937 generator(11);
+  for (const int size : kArraySizes) {
+    const Vector3fArray x = RandomVector3fArray(size, &generator);
+    const Vector3fArray y = RandomVector3fArray(size, &generator);
+    Vector3fArray result;
+    ComputeCrossProducts(x, y, &result);
+    ASSERT_EQ(result.size(), size);
+    for (int i = 0; i < size; ++i) {
+      const Eigen::Vector3f expected =
+          ComputeCrossProduct(GetVector(x, i), GetVector(y, i));
+      EXPECT_LT((GetVector(result, i) - expected).norm(), kTolerance);
+    }
+  }
+}
+
+TEST(AssignmentTest, CalculateAnglesBetweenVectors) {
+  std::mt19937 generator(13);
+  for (const int size : kArraySizes) {
+    const Vector3fArray x = RandomVector3fArray(size, &generator);
+    const Vector3fArray y = RandomVector3fArray(size, &generator);
+    std::vector<float> exact_angles, fast_angles;
+    CalculateAnglesBetweenVectors(x, y, EXACT_ANGLE, &exact_angles);
+    CalculateAnglesBetweenVectors(x, y, FAST_ANGLE, &fast_angles);
+    ASSERT_EQ(exact_angles.size(), size);
+    ASSERT_EQ(fast_angles.size(), size);
+    for (int i = 0; i < size; ++i) {
+      const float expected =
+          CalculateAngleBetweenTwoVectors(GetVector(x, i), GetVector(y, i));
+      EXPECT_NEAR(exact_angles[i], expected, kTolerance);
+      EXPECT_NEAR(fast_angles[i], expected, 2e-5f);
+    }
+  }
+}
+
+// The spheres and boxes whose centers are within their bounds of every plane
+// are visible, with every instruction set.
+TEST(AssignmentTest, CullSpheresAndBoxes) {
+  const SimdInstructionSet default_instruction_set =
+      ActiveSimdInstructionSet();
+  std::mt19937 generator(19);
+  Eigen::Matrix<float, 6, 4> planes = Eigen::Matrix<float, 6, 4>::Random();
+  for (int p = 0; p < 6; ++p) {
+    planes.row(p).head<3>().normalize();
+    planes(p, 3) = 0.5f;
+  }
+  for (int set = 0; set < NUM_SIMD_INSTRUCTION_SETS; ++set) {
+    const SimdInstructionSet instruction_set =
+        static_cast<SimdInstructionSet>(set);
+    if (!SimdInstructionSetSupported(instruction_set)) continue;
+    ASSERT_TRUE(SetSimdInstructionSet(instruction_set));
+    SCOPED_TRACE(SimdInstructionSetName(instruction_set));
+    for (const int size : {1, 7, 8, 9, 33, 100}) {
+      const Vector3fArray centers = RandomVector3fArray(size, &generator);
+      Vector3fArray half_extents = RandomVector3fArray(size, &generator);
+      std::vector<float> radii(size);
+      for (int i = 0; i < size; ++i) {
+        half_extents.x[i] = 0.1f * std::abs(half_extents.x[i]);
+        half_extents.y[i] = 0.1f * std::abs(half_extents.y[i]);
+        half_extents.z[i] = 0.1f * std::abs(half_extents.z[i]);
+        radii[i] = 0.1f * std::abs(RandomFloat(&generator));
+      }
+      std::vector<uint32_t> sphere_visibility, box_visibility;
+      CullSpheres(planes, centers, radii, &sphere_visibility);
+      CullBoxes(planes, centers, half_extents, &box_visibility);
+      ASSERT_EQ(sphere_visibility.size(), (size + 31) / 32);
+      ASSERT_EQ(box_visibility.size(), (size + 31) / 32);
+      for (int i = 0; i < size; ++i) {
+        const Eigen::Vector4f center = GetVector(centers, i).homogeneous();
+        const Eigen::Matrix<float, 6, 1> distances = planes * center;
+        const Eigen::Matrix<float, 6, 1> box_bounds =
+            planes.leftCols<3>().cwiseAbs() * GetVector(half_extents, i);
+        const bool sphere_visible = (distances.array() >= -radii[i]).all();
+        const bool box_visible = (distances + box_bounds).minCoeff() >= 0.0f;
+        EXPECT_EQ((sphere_visibility[i / 32] >> (i % 32)) & 1,
+                  sphere_visible ? 1u : 0u) << "Sphere " << i;
+        EXPECT_EQ((box_visibility[i / 32] >> (i % 32)) & 1,
+                  box_visible ? 1u : 0u) << "Box " << i;
+      }
+    }
+  }
+  EXPECT_TRUE(SetSimdInstructionSet(default_instruction_set));
+}
+
+// Returns the distance along the ray to the triangle i, or infinity if the ray
+// misses it, from the plane of the triangle and the barycentric coordinates
+// of the point hit.
+float DistanceToTriangle(const Eigen::Vector3f& origin,
+                         const Eigen::Vector3f& direction,
+                         const TriangleArray& triangles,
+                         const int i) {
+  const Eigen::Vector3f vertex = GetVector(triangles.vertices, i);
+  const Eigen::Vector3f first_edge = GetVector(triangles.first_edges, i);
+  const Eigen::Vector3f second_edge = GetVector(triangles.second_edges, i);
+  const Eigen::Vector3f normal = first_edge.cross(second_edge);
+  const float distance =
+      normal.dot(vertex - origin) / normal.dot(direction);
+  const Eigen::Vector3f point = origin + distance * direction - vertex;
+  const float u = point.cross(second_edge).dot(normal) / normal.squaredNorm();
+  const float v = first_edge.cross(point).dot(normal) / normal.squaredNorm();
+  if (distance < 0.0f || u < 0.0f || v < 0.0f || u + v > 1.0f) {
+    return std::numeric_limits<float>::infinity();
+  }
+  return distance;
+}
+
+// The rays hit the nearest triangle of the range, with every instruction set.
+TEST(AssignmentTest, IntersectRayWithTriangles) {
+  const SimdInstructionSet default_instruction_set =
+      ActiveSimdInstructionSet();
+  std::mt19937 generator(23);
+  for (int set = 0; set < NUM_SIMD_INSTRUCTION_SETS; ++set) {
+    const SimdInstructionSet instruction_set =
+        static_cast<SimdInstructionSet>(set);
+    if (!SimdInstructionSetSupported(instruction_set)) continue;
+    ASSERT_TRUE(SetSimdInstructionSet(instruction_set));
+    SCOPED_TRACE(SimdInstructionSetName(instruction_set));
+    for (const int size : kArraySizes) {
+      TriangleArray triangles;
+      triangles.vertices = RandomVector3fArray(size, &generator);
+      triangles.first_edges = RandomVector3fArray(size, &generator);
+      triangles.second_edges = RandomVector3fArray(size, &generator);
+      for (int begin = 0; begin < std::min(size, 2); ++begin) {
+        // A ray through the centroid of the last triangle hits at least it.
+        const Eigen::Vector3f origin(RandomFloat(&generator),
+                                     RandomFloat(&generator), 4.0f);
+        const Eigen::Vector3f centroid =
+            GetVector(triangles.vertices, size - 1) +
+            (GetVector(triangles.first_edges, size - 1) +
+             GetVector(triangles.second_edges, size - 1)) / 3.0f;
+        const Eigen::Vector3f direction = centroid - origin;
+        float expected_distance = std::numeric_limits<float>::infinity();
+        for (int i = begin; i < size; ++i) {
+          expected_distance = std::min(
+              expected_distance,
+              DistanceToTriangle(origin, direction, triangles, i));
+        }
+        float distance = std::numeric_limits<float>::infinity();
+        const int triangle = IntersectRayWithTriangles(
+            origin, direction, triangles, begin, size, &distance);
+        ASSERT_GE(triangle, begin);
+        ASSERT_LT(triangle, size);
+        EXPECT_NEAR(distance, expected_distance, kTolerance);
+        EXPECT_NEAR(DistanceToTriangle(origin, direction, triangles, triangle),
+                    expected_distance, kTolerance);
+        // No triangle is nearer than the maximum distance.
+        float max_distance = 0.5f * expected_distance;
+        EXPECT_EQ(IntersectRayWithTriangles(origin, direction, triangles,
+                                            begin, size, &max_distance), -1);
+        EXPECT_EQ(max_distance, 0.5f * expected_distance);
+      }
+    }
+  }
+  EXPECT_TRUE(SetSimdInstructionSet(default_instruction_set));
+}
+
+TEST(AssignmentTest, SimdInstructionSets) {
+  EXPECT_TRUE(SimdInstructionSetSupported(SCALAR));
+  EXPECT_TRUE(SimdInstructionSetSupported(ActiveSimdInstructionSet()));
+  EXPECT_FALSE(SimdInstructionSetSupported(NUM_SIMD_INSTRUCTION_SETS));
+  EXPECT_FALSE(SetSimdInstructionSet(NUM_SIMD_INSTRUCTION_SETS));
+}
+
+// Every supported instruction set computes the same results as the scalar
+// functions.
+TEST(AssignmentTest, BatchedKernelsOfEveryInstructionSet) {
+  const SimdInstructionSet default_instruction_set =
+      ActiveSimdInstructionSet();
+  std::mt19937 generator(17);
+  const Eigen::Matrix4f matrix = Eigen::Matrix4f::Random();
+  for (int set = 0; set < NUM_SIMD_INSTRUCTION_SETS; ++set) {
+    const SimdInstructionSet instruction_set =
+        static_cast<SimdInstructionSet>(set);
+    if (!SimdInstructionSetSupported(instruction_set)) continue;
+    ASSERT_TRUE(SetSimdInstructionSet(instruction_set));
+    EXPECT_EQ(ActiveSimdInstructionSet(), instruction_set);
+    SCOPED_TRACE(SimdInstructionSetName(instruction_set));
+    for (const int size : kArraySizes) {
+      const Vector3fArray x = RandomVector3fArray(size, &generator);
+      const Vector3fArray y = RandomVector3fArray(size, &generator);
+      std::vector<float> dot_products;
+      Vector3fArray cross_products;
+      ComputeDotProducts(x, y, &dot_products);
+      ComputeCrossProducts(x, y, &cross_products);
+      Vector4fArray points;
+      points.x = x.x;
+      points.y = x.y;
+      points.z = x.z;
+      points.w.assign(size, 1.0f);
+      Vector4fArray transformed_points;
+      MultiplyVectorArrayAndMatrix(matrix, points, &transformed_points);
+      for (int i = 0; i < size; ++i) {
+        const Eigen::Vector3f lhs = GetVector(x, i);
+        const Eigen::Vector3f rhs = GetVector(y, i);
+        EXPECT_NEAR(dot_products[i], ComputeDotProduct(lhs, rhs), kTolerance);
+        EXPECT_LT((GetVector(cross_products, i) -
+                   ComputeCrossProduct(lhs, rhs)).norm(), kTolerance);
+        const Eigen::Vector4f expected =
+            MultiplyVectorAndMatrix(matrix, lhs.homogeneous());
+        EXPECT_NEAR(transformed_points.x[i], expected.x(), kTolerance);
+        EXPECT_NEAR(transformed_points.y[i], expected.y(), kTolerance);
+        EXPECT_NEAR(transformed_points.z[i], expected.z(), kTolerance);
+        EXPECT_NEAR(transformed_points.w[i], expected.w(), kTolerance);
+      }
+    }
+  }
+  EXPECT_TRUE(SetSimdInstructionSet(default_instruction_set));
+}
+
+}  // namespace
+}  // namespace wvu
@@ -0,0 +1,201 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+// Unit tests of the classes needing OpenGL. The tests share the hidden context
+// of GlTestEnvironment, so each one costs the work it tests, and return early
+// when no context can be created.
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include "gtest/gtest.h"
+
+#include "buffer_allocator.h"
+#include "gpu_mesh.h"
+#include "model.h"
+#include "offscreen_framebuffer.h"
+#include "render_queue.h"
+#include "shader_program.h"
+#include "test/gl_test_environment.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+// Draws the positions transformed by the model uniform in the color uniform.
+constexpr char kVertexShaderSource[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "uniform mat4 model;\n"
+    "void main() {\n"
+    "  gl_Position = model * vec4(position, 1.0);\n"
+    "}\n";
+constexpr char kFragmentShaderSource[] =
+    "#version 330 core\n"
+    "uniform vec3 color;\n"
+    "out vec4 fragment_color;\n"
+    "void main() {\n"
+    "  fragment_color = vec4(color, 1.0);\n"
+    "}\n";
+
+// The size of the framebuffers of the draws.
+constexpr int kFramebufferSize = 16;
+
+bool CreateProgram(ShaderProgram* program, std::string* error_info_log) {
+  program->LoadVertexShaderFromString(kVertexShaderSource);
+  program->LoadFragmentShaderFromString(kFragmentShaderSource);
+  return program->Create(error_info_log);
+}
+
+// The square [-1, 1]^2 of clip space, i.e., the whole viewport, as 2
+// triangles.
+Model CreateQuad() {
+  std::vector<GLuint> indices = { 0, 1, 2, 2, 1, 3 };
+  const std::vector<PositionVertex> vertices = {
+    {{-1.0f, -1.0f, 0.0f}}, {{1.0f, -1.0f, 0.0f}},
+    {{-1.0f, 1.0f, 0.0f}}, {{1.0f, 1.0f, 0.0f}}
+  };
+  return Model(Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), vertices,
+               std::move(indices));
+}
+
+// Returns the RGBA color of the pixel (x, y) of the bound read framebuffer.
+std::vector<GLubyte> ReadPixel(const int x, const int y) {
+  std::vector<GLubyte> color(4, 0);
+  glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color.data());
+  return color;
+}
+
+}  // namespace
+
+TEST_F(GlTest, ShaderProgramFindsItsUniforms) {
+  if (!ContextAvailable()) return;
+  ShaderProgram program;
+  std::string error_info_log;
+  ASSERT_TRUE(CreateProgram(&program, &error_info_log)) << error_info_log;
+  EXPECT_NE(program.shader_program_id(), 0u);
+  EXPECT_GE(program.GetUniformLocation("model"), 0);
+  EXPECT_GE(program.GetUniformLocation("color"), 0);
+  EXPECT_EQ(program.GetUniformLocation("missing"), -1);
+  EXPECT_EQ(program.num_active_uniforms(), 2);
+  ASSERT_TRUE(program.Use());
+  EXPECT_TRUE(program.SetUniform("color", Eigen::Vector3f(1.0f, 0.0f, 0.0f)));
+  glUseProgram(0);
+}
+
+TEST_F(GlTest, ShaderProgramReportsCompileErrors) {
+  if (!ContextAvailable()) return;
+  ShaderProgram program;
+  program.LoadVertexShaderFromString(kVertexShaderSource);
+  program.LoadFragmentShaderFromString(
+      "#version 330 core\n"
+      "out vec4 fragment_color;\n"
+      "void main() {\n"
+      "  fragment_color = undeclared;\n"
+      "}\n");
+  std::string error_info_log;
+  EXPECT_FALSE(program.Create(&error_info_log));
+  EXPECT_FALSE(error_info_log.empty());
+}
+
+TEST_F(GlTest, BufferAllocatorTracksTheBytesOfItsBuffers) {
+  if (!ContextAvailable()) return;
+  BufferAllocator* allocator = BufferAllocator::Get();
+  const BufferMemoryStatistics before = allocator->statistics();
+  const std::vector<GLfloat> data = { 1.0f, 2.0f, 3.0f, 4.0f };
+  const GLsizeiptr size = data.size() * sizeof(data[0]);
+  GLuint buffer_id = allocator->CreateBuffer(VERTEX_DATA);
+  ASSERT_NE(buffer_id, 0u);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+  allocator->BufferData(buffer_id, GL_ARRAY_BUFFER, size, data.data(),
+                        GL_STATIC_DRAW);
+  const BufferMemoryStatistics after = allocator->statistics();
+  EXPECT_EQ(after.num_buffers, before.num_buffers + 1);
+  EXPECT_EQ(after.live_bytes[VERTEX_DATA],
+            before.live_bytes[VERTEX_DATA] + size);
+  EXPECT_EQ(after.total_live_bytes, before.total_live_bytes + size);
+
+  std::vector<GLfloat> read_data(data.size(), 0.0f);
+  glGetBufferSubData(GL_ARRAY_BUFFER, 0, size, read_data.data());
+  EXPECT_EQ(read_data, data);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  allocator->DeleteBuffer(&buffer_id);
+  EXPECT_EQ(buffer_id, 0u);
+  EXPECT_EQ(allocator->statistics().total_live_bytes,
+            before.total_live_bytes);
+}
+
+TEST_F(GlTest, RenderQueueDrawsItsItems) {
+  if (!ContextAvailable()) return;
+  ShaderProgram program;
+  std::string error_info_log;
+  ASSERT_TRUE(CreateProgram(&program, &error_info_log)) << error_info_log;
+  ASSERT_TRUE(program.Use());
+  program.SetUniform("color", Eigen::Vector3f(1.0f, 0.0f, 0.0f));
+  const Model quad = CreateQuad();
+  const GpuMesh mesh = SetVertexArrayObject(quad);
+  ASSERT_TRUE(mesh.valid());
+  OffscreenFramebuffer framebuffer;
+  ASSERT_TRUE(framebuffer.Initialize(kFramebufferSize, kFramebufferSize,
+                                     &error_info_log)) << error_info_log;
+  framebuffer.Bind();
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  // Two items of the same program, each covering the left half of the
+  // viewport: the second one is moved to the right half.
+  RenderQueue render_queue("model");
+  RenderItem item;
+  item.shader_program = &program;
+  item.mesh = &mesh;
+  item.num_indices = mesh.num_indices();
+  item.model(0, 0) = 0.5f;
+  item.model(0, 3) = -0.5f;
+  render_queue.Add(item);
+  item.model(0, 3) = 0.5f;
+  render_queue.Add(item);
+  render_queue.Execute();
+
+  EXPECT_EQ(render_queue.statistics().num_draws, 2);
+  EXPECT_EQ(render_queue.statistics().num_program_changes, 1);
+  EXPECT_EQ(render_queue.statistics().num_triangles, 4);
+  const std::vector<GLubyte> red = { 255, 0, 0, 255 };
+  EXPECT_EQ(ReadPixel(kFramebufferSize / 4, kFramebufferSize / 2), red);
+  EXPECT_EQ(ReadPixel(3 * kFramebufferSize / 4, kFramebufferSize / 2), red);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glBindVertexArray(0);
+  glUseProgram(0);
+}
+
+}  // namespace wvu
@@ -0,0 +1,156 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "test/gl_test_environment.h"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glog/logging.h>
+#include "gtest/gtest.h"
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+
+namespace wvu {
+namespace {
+// Creates a hidden window with a core context of the given version. Returns
+// nullptr if the driver does not have it.
+GLFWwindow* CreateHiddenWindow(const int major, const int minor) {
+  glfwDefaultWindowHints();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  return glfwCreateWindow(kGlTestWindowSize, kGlTestWindowSize, "gl_test",
+                          nullptr, nullptr);
+}
+
+// The environment is owned by gtest once added.
+::testing::Environment* const kGlTestEnvironment =
+    ::testing::AddGlobalTestEnvironment(new GlTestEnvironment);
+
+}  // namespace
+
+GLFWwindow* GlTestEnvironment::window_ = nullptr;
+
+void GlTestEnvironment::SetUp() {
+  if (!glfwInit()) {
+    LOG(WARNING) << "Could not initialize GLFW, the OpenGL tests do not run.";
+    return;
+  }
+  window_ = CreateHiddenWindow(4, 5);
+  if (window_ == nullptr) window_ = CreateHiddenWindow(3, 3);
+  if (window_ == nullptr) {
+    LOG(WARNING) << "Could not create an OpenGL context, the OpenGL tests do "
+                 << "not run.";
+    return;
+  }
+  glfwMakeContextCurrent(window_);
+  glfwSwapInterval(0);
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK) {
+    LOG(WARNING) << "Could not initialize GLEW, the OpenGL tests do not run.";
+    glfwDestroyWindow(window_);
+    window_ = nullptr;
+    return;
+  }
+  // GLEW may leave an error of its queries.
+  while (glGetError() != GL_NO_ERROR) {}
+  LOG(INFO) << "OpenGL tests on " << glGetString(GL_RENDERER) << ", "
+            << glGetString(GL_VERSION);
+}
+
+void GlTestEnvironment::TearDown() {
+  if (window_ != nullptr) glfwDestroyWindow(window_);
+  window_ = nullptr;
+  glfwTerminate();
+}
+
+void GlTest::SetUp() {
+  if (!GlTestEnvironment::ContextAvailable()) return;
+  ResetGlState();
+  num_buffers_ = BufferAllocator::Get()->statistics().num_buffers;
+}
+
+void GlTest::TearDown() {
+  if (!GlTestEnvironment::ContextAvailable()) return;
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), glGetError());
+  EXPECT_EQ(num_buffers_, BufferAllocator::Get()->statistics().num_buffers)
+      << "The test leaked buffers.";
+}
+
+bool GlTest::ContextAvailable() {
+  if (!GlTestEnvironment::ContextAvailable()) {
+    LOG(WARNING) << "No OpenGL context, the test does not run.";
+  }
+  return GlTestEnvironment::ContextAvailable();
+}
+
+void GlTest::ResetGlState() {
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, kGlTestWindowSize, kGlTestWindowSize);
+  glUseProgram(0);
+  glBindVertexArray(0);
+  const GLenum buffer_targets[] = {
+    GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER,
+    GL_COPY_WRITE_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER
+  };
+  for (const GLenum target : buffer_targets) glBindBuffer(target, 0);
+  if (GLEW_VERSION_4_3) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+  }
+  if (GLEW_VERSION_4_0) glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  const GLenum capabilities[] = {
+    GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_SCISSOR_TEST, GL_STENCIL_TEST,
+    GL_PRIMITIVE_RESTART
+  };
+  for (const GLenum capability : capabilities) glDisable(capability);
+  glDepthMask(GL_TRUE);
+  glDepthFunc(GL_LESS);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glBlendFunc(GL_ONE, GL_ZERO);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  GlStateCache::Current()->Invalidate();
+  // The errors of the previous tests were reported by them.
+  while (glGetError() != GL_NO_ERROR) {}
+}
+
+}  // namespace wvu
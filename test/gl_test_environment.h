@@ -0,0 +1,113 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_TEST_GL_TEST_ENVIRONMENT_H_
+#define GLUTILS_TEST_GL_TEST_ENVIRONMENT_H_
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "gtest/gtest.h"
+
+namespace wvu {
+// Size of the default framebuffer of the hidden window of the tests.
+constexpr int kGlTestWindowSize = 64;
+
+// This global environment creates one OpenGL context for all the tests of a
+// run, so that they do not pay for glfwInit(), a window and glewInit() each:
+// a hidden window with an OpenGL 4.5 core context, or 3.3 if the driver does
+// not have 4.5, current on the main thread until the end of the run. It is
+// registered by linking test/gl_test_environment.cc into the test, before
+// main() runs, so the runner of test/test_main.cc needs no change. The tests
+// run without any context when none can be created, e.g., on a machine
+// without a display, and the tests of GlTest return early.
+class GlTestEnvironment : public ::testing::Environment {
+ public:
+  GlTestEnvironment() {}
+  ~GlTestEnvironment() override {}
+
+  void SetUp() override;
+  void TearDown() override;
+
+  // Returns true if the context of the run was created.
+  static bool ContextAvailable() {
+    return window_ != nullptr;
+  }
+
+  // Returns the hidden window whose context is current, or nullptr.
+  static GLFWwindow* window() {
+    return window_;
+  }
+
+ private:
+  static GLFWwindow* window_;
+
+  GlTestEnvironment(const GlTestEnvironment&) = delete;
+  GlTestEnvironment& operator=(const GlTestEnvironment&) = delete;
+};
+
+// The fixture of the tests needing OpenGL. Every test starts from the default
+// state of a fresh context: the default framebuffer and its viewport bound, no
+// program, vertex array, buffer nor texture bound, the tests and the blending
+// off, the state cache of the thread invalidated and no pending error. Every
+// test fails if it leaves an OpenGL error, or buffers of the BufferAllocator
+// it created and did not delete.
+//
+// Example:
+//
+// TEST_F(GlTest, DrawsTheQuad) {
+//   if (!ContextAvailable()) return;
+//   ...
+// }
+class GlTest : public ::testing::Test {
+ protected:
+  GlTest() : num_buffers_(0) {}
+
+  void SetUp() override;
+  void TearDown() override;
+
+  // Returns true if the context was created, or logs why the test does not
+  // run.
+  static bool ContextAvailable();
+
+  // Restores the default state of the context.
+  static void ResetGlState();
+
+ private:
+  // The live buffers of the BufferAllocator when the test started.
+  int num_buffers_;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_TEST_GL_TEST_ENVIRONMENT_H_
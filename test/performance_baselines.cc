@@ -0,0 +1,89 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "test/performance_baselines.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace wvu {
+namespace {
+// Machine class of the baselines used when a class has none for a test.
+const char kDefaultMachineClass[] = "default";
+
+}  // namespace
+
+bool PerformanceBaselines::Load(const std::string& filepath,
+                                std::string* error_info_log) {
+  std::ifstream file(filepath);
+  if (!file) {
+    *error_info_log = "Could not open " + filepath;
+    return false;
+  }
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    ++line_number;
+    std::istringstream stream(line);
+    std::string machine_class;
+    if (!(stream >> machine_class) || machine_class[0] == '#') continue;
+    std::string test_name;
+    PerformanceBaseline baseline;
+    if (!(stream >> test_name >> baseline.milliseconds >> baseline.tolerance) ||
+        baseline.milliseconds <= 0.0 || baseline.tolerance < 0.0) {
+      std::ostringstream error;
+      error << filepath << ":" << line_number << ": invalid baseline.";
+      *error_info_log = error.str();
+      return false;
+    }
+    baselines_[std::make_pair(machine_class, test_name)] = baseline;
+  }
+  return true;
+}
+
+bool PerformanceBaselines::Find(const std::string& machine_class,
+                                const std::string& test_name,
+                                PerformanceBaseline* baseline) const {
+  auto iterator = baselines_.find(std::make_pair(machine_class, test_name));
+  if (iterator == baselines_.end()) {
+    iterator = baselines_.find(std::make_pair(kDefaultMachineClass, test_name));
+  }
+  if (iterator == baselines_.end()) return false;
+  *baseline = iterator->second;
+  return true;
+}
+
+}  // namespace wvu
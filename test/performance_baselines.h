@@ -0,0 +1,92 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_TEST_PERFORMANCE_BASELINES_H_
+#define GLUTILS_TEST_PERFORMANCE_BASELINES_H_
+
+#include <map>
+#include <string>
+#include <utility>
+
+namespace wvu {
+// The expected duration of a performance test on a class of machines, and the
+// fraction above it that the test tolerates before reporting a regression.
+struct PerformanceBaseline {
+  double milliseconds = 0.0;
+  double tolerance = 0.0;
+
+  // Returns the longest duration that passes.
+  double max_milliseconds() const {
+    return milliseconds * (1.0 + tolerance);
+  }
+};
+
+// This class holds the baselines of the performance tests of several machine
+// classes, read from a text file with one baseline per line:
+//
+// # machine_class  test_name  milliseconds  tolerance
+// default  InstancedCubes  4.0  1.0
+// gtx1080  InstancedCubes  0.5  0.5
+//
+// Lines starting with # are comments. The tests of a machine class without a
+// baseline of their own use the baseline of the "default" class.
+class PerformanceBaselines {
+ public:
+  PerformanceBaselines() {}
+  ~PerformanceBaselines() {}
+
+  // Reads the baselines of a file. Returns true if successful.
+  // Parameters:
+  //   filepath  The path of the baselines file.
+  //   error_info_log  A pointer to a string that holds the error log.
+  bool Load(const std::string& filepath, std::string* error_info_log);
+
+  // Finds the baseline of a test on a machine class, falling back to the
+  // default class. Returns true if found.
+  bool Find(const std::string& machine_class,
+            const std::string& test_name,
+            PerformanceBaseline* baseline) const;
+
+ private:
+  // Baselines by machine class and test name.
+  std::map<std::pair<std::string, std::string>, PerformanceBaseline>
+      baselines_;
+
+  PerformanceBaselines(const PerformanceBaselines&) = delete;
+  PerformanceBaselines& operator=(const PerformanceBaselines&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_TEST_PERFORMANCE_BASELINES_H_
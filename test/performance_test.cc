@@ -0,0 +1,459 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+// Performance regression tests. Each test measures the median duration of an
+// operation and fails when it exceeds the baseline of the machine class of
+// --perf_machine_class by more than its tolerance (see
+// test/performance_baselines.txt). The tests needing OpenGL share the hidden
+// context of GlTestEnvironment, and pass without measuring when no context can
+// be created.
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include "gtest/gtest.h"
+
+#include "assignment.h"
+#include "bounding_volume_hierarchy.h"
+#include "camera.h"
+#include "gpu_mesh.h"
+#include "instance_buffer.h"
+#include "job_system.h"
+#include "mesh_normals.h"
+#include "mesh_picking.h"
+#include "model.h"
+#include "offscreen_framebuffer.h"
+#include "shader_program.h"
+#include "spatial_hash.h"
+#include "test/gl_test_environment.h"
+#include "test/performance_baselines.h"
+#include "transforms.h"
+#include "vertex_format.h"
+#include "visibility_cache.h"
+
+DEFINE_string(perf_machine_class, "default",
+              "Machine class of the baselines the measurements are compared "
+              "to.");
+DEFINE_string(perf_baselines_file, GLUTILS_PERF_BASELINES_FILE,
+              "File of the baselines of the performance tests.");
+DEFINE_int32(perf_repetitions, 21,
+             "Measurements of each test. The median is compared to the "
+             "baseline.");
+
+namespace wvu {
+namespace {
+const std::string vertex_shader_src =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 position;\n"
+    "layout (location = 12) in mat4 instance_model;\n"
+    "uniform mat4 view_projection;\n"
+    "void main() {\n"
+    "gl_Position = view_projection * instance_model * vec4(position, 1.0f);\n"
+    "}\n";
+
+const std::string fragment_shader_src =
+    "#version 330 core\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "color = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
+    "}\n";
+
+const PerformanceBaselines& Baselines() {
+  static PerformanceBaselines* baselines = []() {
+    PerformanceBaselines* baselines = new PerformanceBaselines;
+    std::string error_info_log;
+    if (!baselines->Load(FLAGS_perf_baselines_file, &error_info_log)) {
+      LOG(ERROR) << error_info_log;
+    }
+    return baselines;
+  }();
+  return *baselines;
+}
+
+// Returns the median duration of the function in milliseconds, after a warm
+// up call.
+double MedianMilliseconds(const std::function<void()>& function) {
+  function();
+  std::vector<double> durations(std::max(FLAGS_perf_repetitions, 1));
+  for (double& duration : durations) {
+    const std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    function();
+    duration = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - begin).count();
+  }
+  std::nth_element(durations.begin(),
+                   durations.begin() + durations.size() / 2,
+                   durations.end());
+  return durations[durations.size() / 2];
+}
+
+// Fails the test if the duration exceeds the tolerance band of its baseline.
+void ExpectWithinBaseline(const std::string& test_name,
+                          const double milliseconds) {
+  PerformanceBaseline baseline;
+  ASSERT_TRUE(Baselines().Find(FLAGS_perf_machine_class, test_name,
+                               &baseline))
+      << "No baseline of " << test_name << " for the machine class "
+      << FLAGS_perf_machine_class;
+  LOG(INFO) << test_name << ": " << milliseconds << " ms, baseline "
+            << baseline.milliseconds << " ms.";
+  EXPECT_LE(milliseconds, baseline.max_milliseconds())
+      << test_name << " regressed: " << milliseconds << " ms against a "
+      << "baseline of " << baseline.milliseconds << " ms with a tolerance of "
+      << 100.0 * baseline.tolerance << "%.";
+}
+
+// Removes a directory and the files in it.
+void RemoveDirectory(const std::string& directory) {
+  DIR* stream = opendir(directory.c_str());
+  if (stream == nullptr) return;
+  while (const dirent* entry = readdir(stream)) {
+    const std::string name = entry->d_name;
+    if (name != "." && name != "..") unlink((directory + "/" + name).c_str());
+  }
+  closedir(stream);
+  rmdir(directory.c_str());
+}
+
+// The unit cube of draw_triangle.cc.
+Model CreateCube() {
+  std::vector<GLuint> indices = {
+    0, 1, 3, 0, 3, 2, 2, 3, 5, 2, 5, 4, 4, 5, 7, 4, 7, 6,
+    0, 1, 7, 0, 7, 6, 0, 2, 4, 0, 4, 6, 1, 3, 5, 1, 5, 7
+  };
+  const std::vector<PositionVertex> vertices = {
+    {{0.0f, 1.0f, 0.0f}}, {{0.0f, 0.0f, 0.0f}},
+    {{1.0f, 1.0f, 0.0f}}, {{1.0f, 0.0f, 0.0f}},
+    {{1.0f, 1.0f, -1.0f}}, {{1.0f, 0.0f, -1.0f}},
+    {{0.0f, 1.0f, -1.0f}}, {{0.0f, 0.0f, -1.0f}}
+  };
+  return Model(Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), vertices,
+               std::move(indices));
+}
+
+// The size of the grid of CreateGrid(), whose squares are 2 triangles.
+constexpr int kGridSize = 708;
+
+// A terrain-like grid of a million triangles, of squares of unit size along x
+// and z, and random heights.
+Model CreateGrid(std::mt19937* generator) {
+  std::uniform_real_distribution<float> height(-0.5f, 0.5f);
+  std::vector<PositionVertex> vertices;
+  for (int y = 0; y <= kGridSize; ++y) {
+    for (int x = 0; x <= kGridSize; ++x) {
+      vertices.push_back({{static_cast<float>(x), height(*generator),
+                           static_cast<float>(y)}});
+    }
+  }
+  std::vector<GLuint> indices;
+  for (int y = 0; y < kGridSize; ++y) {
+    for (int x = 0; x < kGridSize; ++x) {
+      const GLuint corner = y * (kGridSize + 1) + x;
+      const GLuint next_row = corner + kGridSize + 1;
+      indices.insert(indices.end(), {corner, corner + 1, next_row,
+                                     corner + 1, next_row + 1, next_row});
+    }
+  }
+  return Model(Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero(), vertices,
+               std::move(indices));
+}
+
+// The bounds of a million objects scattered over a square kilometer.
+std::vector<Eigen::AlignedBox3f> CreateObjectBounds(std::mt19937* generator) {
+  constexpr int kNumObjects = 1 << 20;
+  std::uniform_real_distribution<float> coordinate(-500.0f, 500.0f);
+  std::uniform_real_distribution<float> half_size(0.1f, 2.0f);
+  std::vector<Eigen::AlignedBox3f> object_bounds(kNumObjects);
+  for (Eigen::AlignedBox3f& bounds : object_bounds) {
+    const Eigen::Vector3f center(coordinate(*generator),
+                                 0.1f * coordinate(*generator),
+                                 coordinate(*generator));
+    const Eigen::Vector3f extent(half_size(*generator), half_size(*generator),
+                                 half_size(*generator));
+    bounds = Eigen::AlignedBox3f(center - extent, center + extent);
+  }
+  return object_bounds;
+}
+
+bool CreateProgram(ShaderProgram* program, std::string* error_info_log) {
+  program->LoadVertexShaderFromString(vertex_shader_src);
+  program->LoadFragmentShaderFromString(fragment_shader_src);
+  return program->Create(error_info_log);
+}
+
+// The tests of this fixture share the hidden window of the run (see
+// test/gl_test_environment.h).
+class GlPerformanceTest : public GlTest {};
+
+}  // namespace
+
+TEST(PerformanceTest, CrossProducts) {
+  constexpr int kNumVectors = 1 << 20;
+  Vector3fArray x, y, result;
+  x.resize(kNumVectors);
+  y.resize(kNumVectors);
+  for (int i = 0; i < kNumVectors; ++i) {
+    x.x[i] = y.y[i] = 1.0f;
+    x.y[i] = y.z[i] = static_cast<float>(i) / kNumVectors;
+    x.z[i] = y.x[i] = 0.5f;
+  }
+  ExpectWithinBaseline("CrossProducts", MedianMilliseconds([&]() {
+    ComputeCrossProducts(x, y, &result);
+  }));
+}
+
+// Culls a million objects scattered over a square kilometer with the view
+// frustum of a camera seeing a few thousand of them.
+TEST(PerformanceTest, BoundingVolumeHierarchyFrustumQuery) {
+  std::mt19937 generator(7);
+  const std::vector<Eigen::AlignedBox3f> object_bounds =
+      CreateObjectBounds(&generator);
+  BoundingVolumeHierarchy bvh;
+  bvh.Build(object_bounds);
+  Eigen::Matrix4f view = Eigen::Matrix4f::Identity();
+  view(2, 3) = -10.0f;
+  const Eigen::Matrix4f view_projection =
+      ComputeProjectionMatrix(0.785398f, 16.0f / 9.0f, 0.1f, 100.0f) * view;
+  std::vector<int> visible_objects;
+  visible_objects.reserve(object_bounds.size());
+  ExpectWithinBaseline("BoundingVolumeHierarchyFrustumQuery",
+                       MedianMilliseconds([&]() {
+    visible_objects.clear();
+    bvh.QueryFrustum(view_projection, &visible_objects);
+  }));
+  EXPECT_GT(visible_objects.size(), 0u);
+}
+
+// Culls the objects of BoundingVolumeHierarchyFrustumQuery from a camera
+// walking through them, a hundred of which move every frame.
+TEST(PerformanceTest, VisibilityCacheUpdate) {
+  std::mt19937 generator(7);
+  std::vector<Eigen::AlignedBox3f> object_bounds =
+      CreateObjectBounds(&generator);
+  BoundingVolumeHierarchy bvh;
+  bvh.Build(object_bounds);
+  VisibilityCache visibility;
+  visibility.Initialize(&bvh);
+  Camera camera;
+  camera.SetPerspective(0.785398f, 16.0f / 9.0f, 0.1f, 100.0f);
+  std::uniform_int_distribution<int> object(0, object_bounds.size() - 1);
+  std::uniform_real_distribution<float> offset(-0.1f, 0.1f);
+  Eigen::Vector3f camera_position(0.0f, 1.0f, 0.0f);
+  ExpectWithinBaseline("VisibilityCacheUpdate", MedianMilliseconds([&]() {
+    for (int i = 0; i < 100; ++i) {
+      const int moved_object = object(generator);
+      object_bounds[moved_object].translate(
+          Eigen::Vector3f(offset(generator), 0.0f, offset(generator)));
+      bvh.UpdateBounds(moved_object, object_bounds[moved_object]);
+      visibility.MarkDirty(moved_object);
+    }
+    bvh.Refit();
+    camera_position.z() -= 0.1f;
+    camera.SetPosition(camera_position);
+    visibility.Update(camera);
+  }));
+  // The cache keeps all the objects in the frustum.
+  std::vector<int> visible_objects;
+  bvh.QueryFrustum(camera.view_projection(), &visible_objects);
+  std::vector<uint8_t> cached(object_bounds.size(), 0);
+  for (const int visible_object : visibility.visible_objects()) {
+    cached[visible_object] = 1;
+  }
+  int num_missing_objects = 0;
+  for (const int visible_object : visible_objects) {
+    if (!cached[visible_object]) ++num_missing_objects;
+  }
+  EXPECT_GT(visible_objects.size(), 0u);
+  EXPECT_EQ(num_missing_objects, 0);
+}
+
+// Computes the angle-weighted normals of the grid on all the hardware threads.
+TEST(PerformanceTest, ComputeVertexNormals) {
+  std::mt19937 generator(13);
+  const Model grid = CreateGrid(&generator);
+  JobSystem job_system;
+  std::string error_info_log;
+  bool computed = true;
+  ExpectWithinBaseline("ComputeVertexNormals", MedianMilliseconds([&]() {
+    Model model = grid;
+    computed &= ComputeVertexNormals(ANGLE_WEIGHTED_NORMALS, NORMAL_SNORM10,
+                                     &job_system, &model, &error_info_log);
+  }));
+  EXPECT_TRUE(computed) << error_info_log;
+}
+
+// Picks the grid with a thousand rays cast down from above it.
+TEST(PerformanceTest, MeshPickerRaycast) {
+  constexpr int kNumRays = 1000;
+  std::mt19937 generator(11);
+  const Model grid = CreateGrid(&generator);
+  MeshPicker picker;
+  ASSERT_TRUE(picker.Build(grid));
+  std::uniform_real_distribution<float> coordinate(0.0f, kGridSize);
+  std::vector<Eigen::Vector3f> origins(kNumRays), directions(kNumRays);
+  for (int i = 0; i < kNumRays; ++i) {
+    origins[i] = Eigen::Vector3f(coordinate(generator), 20.0f,
+                                 coordinate(generator));
+    directions[i] = Eigen::Vector3f(coordinate(generator), 0.0f,
+                                    coordinate(generator)) - origins[i];
+  }
+  int num_hits = 0;
+  ExpectWithinBaseline("MeshPickerRaycast", MedianMilliseconds([&]() {
+    num_hits = 0;
+    MeshHit hit;
+    for (int i = 0; i < kNumRays; ++i) {
+      if (picker.Raycast(origins[i], directions[i], 10.0f, &hit)) ++num_hits;
+    }
+  }));
+  EXPECT_EQ(num_hits, kNumRays);
+}
+
+// Rebuilds the spatial hash of a hundred thousand agents on a plane, and finds
+// the neighbors of all of them, as a crowd simulation does every frame.
+TEST(PerformanceTest, SpatialHashNeighbors) {
+  constexpr int kNumAgents = 100000;
+  constexpr float kRadius = 1.0f;
+  std::mt19937 generator(17);
+  std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+  Vector3fArray positions;
+  positions.resize(kNumAgents);
+  for (int i = 0; i < kNumAgents; ++i) {
+    positions.x[i] = coordinate(generator);
+    positions.y[i] = 0.01f * coordinate(generator);
+    positions.z[i] = coordinate(generator);
+  }
+  JobSystem job_system;
+  SpatialHash spatial_hash(kRadius);
+  std::vector<int> num_neighbors(kNumAgents);
+  ExpectWithinBaseline("SpatialHashNeighbors", MedianMilliseconds([&]() {
+    spatial_hash.Build(positions, &job_system);
+    job_system.ParallelFor(kNumAgents, 1024, [&](const int begin,
+                                                 const int end) {
+      for (int i = begin; i < end; ++i) {
+        const int agent = spatial_hash.sorted_objects()[i];
+        int count = 0;
+        spatial_hash.ForEachNeighbor(
+            Eigen::Vector3f(positions.x[agent], positions.y[agent],
+                            positions.z[agent]),
+            kRadius, [&count](const int neighbor, const float distance) {
+          ++count;
+        });
+        num_neighbors[agent] = count;
+      }
+    });
+  }));
+  // Every agent finds itself.
+  EXPECT_EQ(*std::min_element(num_neighbors.begin(), num_neighbors.end()), 1);
+}
+
+TEST_F(GlPerformanceTest, InstancedCubes) {
+  if (!ContextAvailable()) return;
+  constexpr int kNumCubes = 1000;
+  constexpr int kGridSize = 32;
+  const Model cube = CreateCube();
+  GpuMesh mesh = SetVertexArrayObject(cube);
+  InstanceBuffer instances;
+  ASSERT_TRUE(instances.Initialize());
+  instances.Attach(mesh);
+  InstanceTransforms transforms(kNumCubes, Eigen::Matrix4f::Identity());
+  for (int i = 0; i < kNumCubes; ++i) {
+    transforms[i](0, 3) = 1.5f * (i % kGridSize - 0.5f * kGridSize);
+    transforms[i](1, 3) = 1.5f * (i / kGridSize - 0.5f * kGridSize);
+  }
+  std::string error_info_log;
+  ShaderProgram program;
+  ASSERT_TRUE(CreateProgram(&program, &error_info_log)) << error_info_log;
+  OffscreenFramebuffer framebuffer;
+  ASSERT_TRUE(framebuffer.Initialize(1280, 720, &error_info_log))
+      << error_info_log;
+  framebuffer.Bind();
+  program.Use();
+  // An orthographic view of the grid, which fits in clip space.
+  Eigen::Matrix4f view_projection = Eigen::Matrix4f::Identity();
+  view_projection.topLeftCorner<3, 3>() *= 1.0f / (kGridSize * 1.5f);
+  program.SetUniform(program.GetUniformLocation("view_projection"),
+                     view_projection);
+  glEnable(GL_DEPTH_TEST);
+  // The transforms are uploaded every frame, as an animated scene would.
+  ExpectWithinBaseline("InstancedCubes", MedianMilliseconds([&]() {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    instances.Update(transforms.data(), kNumCubes);
+    DrawInstanced(mesh, instances);
+    glFinish();
+  }));
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), glGetError());
+}
+
+TEST_F(GlPerformanceTest, ShaderProgramBinaryCacheHit) {
+  if (!ContextAvailable()) return;
+  char directory_template[] = "/tmp/glutils_perf_XXXXXX";
+  const char* directory = mkdtemp(directory_template);
+  ASSERT_TRUE(directory != nullptr);
+  std::string error_info_log;
+  {
+    // Stores the binary.
+    ShaderProgram program;
+    program.SetProgramBinaryCacheDirectory(directory);
+    ASSERT_TRUE(CreateProgram(&program, &error_info_log)) << error_info_log;
+  }
+  bool cache_hit = true;
+  const double milliseconds = MedianMilliseconds([&]() {
+    ShaderProgram program;
+    program.SetProgramBinaryCacheDirectory(directory);
+    CreateProgram(&program, &error_info_log);
+    cache_hit = cache_hit && program.loaded_from_binary_cache();
+  });
+  RemoveDirectory(directory);
+  if (!cache_hit) {
+    LOG(WARNING) << "The driver does not support program binaries, the test "
+                 << "is not measured.";
+    return;
+  }
+  ExpectWithinBaseline("ShaderProgramBinaryCacheHit", milliseconds);
+}
+
+}  // namespace wvu
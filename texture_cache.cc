@@ -0,0 +1,295 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "texture_cache.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#define WVU_HAS_STAT
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+#include "texture_source.h"
+
+namespace wvu {
+namespace {
+
+// Returns the lowercase extension of a path, without the dot.
+std::string FileExtension(const std::string& filepath) {
+  const size_t dot = filepath.find_last_of('.');
+  const size_t slash = filepath.find_last_of('/');
+  if (dot == std::string::npos ||
+      (slash != std::string::npos && dot < slash)) {
+    return "";
+  }
+  std::string extension = filepath.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](const unsigned char c) { return std::tolower(c); });
+  return extension;
+}
+
+// Reads the next number of a Netpbm header, skipping the whitespace and the
+// comments before it.
+bool ReadNetpbmNumber(std::istream* in, int* number) {
+  while (true) {
+    const int c = in->peek();
+    if (c == '#') {
+      std::string comment;
+      std::getline(*in, comment);
+    } else if (std::isspace(c)) {
+      in->get();
+    } else {
+      break;
+    }
+  }
+  return static_cast<bool>(*in >> *number);
+}
+
+}  // namespace
+
+bool DecodeNetpbmImage(const std::string& filepath,
+                       int* width,
+                       int* height,
+                       std::vector<GLubyte>* texels,
+                       std::string* error_info_log) {
+  std::ifstream in(filepath, std::ios::binary);
+  if (!in.is_open()) {
+    *error_info_log = "Could not open " + filepath;
+    return false;
+  }
+  char magic[2];
+  int max_value = 0;
+  if (!in.read(magic, 2) || magic[0] != 'P' ||
+      (magic[1] != '5' && magic[1] != '6') ||
+      !ReadNetpbmNumber(&in, width) || !ReadNetpbmNumber(&in, height) ||
+      !ReadNetpbmNumber(&in, &max_value) || *width <= 0 || *height <= 0) {
+    *error_info_log = filepath + " is not a binary PPM or PGM image.";
+    return false;
+  }
+  if (max_value != 255) {
+    *error_info_log = filepath + " does not have 8-bit samples.";
+    return false;
+  }
+  // A single whitespace separates the header from the samples.
+  in.get();
+  const int num_channels = magic[1] == '6' ? 3 : 1;
+  const size_t num_texels = static_cast<size_t>(*width) * *height;
+  std::vector<char> samples(num_texels * num_channels);
+  if (!in.read(samples.data(), samples.size())) {
+    *error_info_log = filepath + " is truncated.";
+    return false;
+  }
+  texels->resize(num_texels * 4);
+  for (size_t i = 0; i < num_texels; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      (*texels)[4 * i + c] =
+          samples[i * num_channels + (num_channels == 3 ? c : 0)];
+    }
+    (*texels)[4 * i + 3] = 255;
+  }
+  return true;
+}
+
+TextureCache::TextureCache(const std::string& cache_directory)
+    : cache_directory_(cache_directory),
+      stop_(false),
+      next_id_(0),
+      num_running_(0) {
+  decoders_["ppm"] = DecodeNetpbmImage;
+  decoders_["pgm"] = DecodeNetpbmImage;
+}
+
+TextureCache::~TextureCache() {
+  Stop();
+}
+
+void TextureCache::SetDecoder(const std::string& extension,
+                              ImageDecoder decoder) {
+  decoders_[FileExtension("." + extension)] = std::move(decoder);
+}
+
+bool TextureCache::Initialize(const int num_threads,
+                              std::string* error_info_log) {
+  if (!threads_.empty()) {
+    *error_info_log = "The texture cache is already running.";
+    return false;
+  }
+  const int num_workers = num_threads > 0 ? num_threads :
+      std::max<int>(std::thread::hardware_concurrency() - 1, 1);
+  stop_ = false;
+  for (int i = 0; i < num_workers; ++i) {
+    threads_.emplace_back(&TextureCache::Run, this);
+  }
+  return true;
+}
+
+int TextureCache::Load(const std::string& image_filepath) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  QueuedLoad load;
+  load.id = next_id_++;
+  load.image_filepath = image_filepath;
+  queued_.push_back(std::move(load));
+  condition_.notify_one();
+  return next_id_ - 1;
+}
+
+int TextureCache::TakeCompletedTextures(
+    std::vector<CompletedTextureLoad>* loads) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int num_completed = completed_.size();
+  for (CompletedTextureLoad& load : completed_) {
+    loads->push_back(std::move(load));
+  }
+  completed_.clear();
+  return num_completed;
+}
+
+void TextureCache::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  for (std::thread& thread : threads_) thread.join();
+  threads_.clear();
+  queued_.clear();
+}
+
+int TextureCache::num_pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queued_.size() + num_running_ + completed_.size();
+}
+
+std::string TextureCache::CacheFilepath(
+    const std::string& image_filepath) const {
+  std::string key = image_filepath;
+#ifdef WVU_HAS_STAT
+  struct stat file_status;
+  if (stat(image_filepath.c_str(), &file_status) != 0) return "";
+  key += ":" + std::to_string(file_status.st_size) + ":" +
+      std::to_string(file_status.st_mtime);
+#else
+  std::ifstream in(image_filepath, std::ios::binary | std::ios::ate);
+  if (!in.is_open()) return "";
+  key += ":" + std::to_string(in.tellg());
+#endif
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.ktx",
+                static_cast<unsigned long long>(std::hash<std::string>()(key)));
+  return cache_directory_ + "/" + name;
+}
+
+std::string TextureCache::ContentCacheFilepath(
+    const uint64_t content_hash, const std::string& extension) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.",
+                static_cast<unsigned long long>(content_hash));
+  return cache_directory_ + "/" + name + extension;
+}
+
+void TextureCache::Run() {
+  while (true) {
+    QueuedLoad load;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return stop_ || !queued_.empty(); });
+      if (stop_) break;
+      load = std::move(queued_.front());
+      queued_.pop_front();
+      ++num_running_;
+    }
+    CompletedTextureLoad completed = Execute(load);
+    std::lock_guard<std::mutex> lock(mutex_);
+    --num_running_;
+    completed_.push_back(std::move(completed));
+  }
+}
+
+CompletedTextureLoad TextureCache::Execute(const QueuedLoad& load) const {
+  CompletedTextureLoad completed;
+  completed.id = load.id;
+  const std::string cache_filepath = CacheFilepath(load.image_filepath);
+  if (cache_filepath.empty()) {
+    completed.error_info_log = "Could not read " + load.image_filepath;
+    return completed;
+  }
+  std::unique_ptr<KtxTextureSource> source(new KtxTextureSource);
+  std::string error_info_log;
+  if (source->Open(cache_filepath, &error_info_log)) {
+    completed.cache_hit = true;
+    completed.source = std::move(source);
+    return completed;
+  }
+  const auto decoder = decoders_.find(FileExtension(load.image_filepath));
+  if (decoder == decoders_.end()) {
+    completed.error_info_log = "No decoder for " + load.image_filepath;
+    return completed;
+  }
+  int width = 0;
+  int height = 0;
+  std::vector<std::vector<GLubyte> > levels(1);
+  if (!decoder->second(load.image_filepath, &width, &height, &levels[0],
+                       &completed.error_info_log)) {
+    return completed;
+  }
+  GenerateMipLevels(width, height, &levels);
+  // The file is written through a temporary file, so a crash never leaves a
+  // partial file behind for the next runs.
+  if (!WriteKtxFile(TEXTURE_FORMAT_RGBA8, width, height, levels,
+                    cache_filepath, &completed.error_info_log)) {
+    return completed;
+  }
+  // The written file is mapped too, so the decoded texels are not kept in
+  // memory.
+  source.reset(new KtxTextureSource);
+  if (!source->Open(cache_filepath, &completed.error_info_log)) {
+    return completed;
+  }
+  completed.source = std::move(source);
+  return completed;
+}
+
+}  // namespace wvu
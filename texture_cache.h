@@ -0,0 +1,186 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_TEXTURE_CACHE_H_
+#define GLUTILS_TEXTURE_CACHE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+
+#include "texture_source.h"
+
+namespace wvu {
+// Decodes an image file into RGBA8 texels, rows from the top. Returns true if
+// successful.
+// Parameters:
+//   filepath  The path of the image.
+//   width  The width of the image.
+//   height  The height of the image.
+//   texels  The width x height RGBA8 texels.
+//   error_info_log  The reason of the failure.
+typedef std::function<bool(const std::string& filepath,
+                           int* width,
+                           int* height,
+                           std::vector<GLubyte>* texels,
+                           std::string* error_info_log)> ImageDecoder;
+
+// Decodes a binary Netpbm image: a PPM (P6) or a PGM (P5) with 8-bit samples.
+bool DecodeNetpbmImage(const std::string& filepath,
+                       int* width,
+                       int* height,
+                       std::vector<GLubyte>* texels,
+                       std::string* error_info_log);
+
+// A texture whose load finished, ready to be added to a TextureManager.
+struct CompletedTextureLoad {
+  // The id returned by TextureCache::Load().
+  int id = -1;
+  // The levels of the texture, mapped from the cache file, or nullptr if the
+  // load failed.
+  std::unique_ptr<TextureSource> source;
+  // True if the texture was read from the cache without decoding the image.
+  bool cache_hit = false;
+  // The reason of the failure.
+  std::string error_info_log;
+};
+
+// This class decodes images on worker threads into KTX files of a cache
+// directory, holding their mip levels in a GPU-ready format, and maps the
+// cached files in the later runs, which skip the decoding entirely. The name
+// of a cached file hashes the path, the size and the modification time of its
+// image, so editing the image decodes it again. The decoders are chosen by the
+// extension of the images; Netpbm images are decoded by default, and other
+// formats, e.g., PNG or JPEG, by the decoders of the application. The images
+// are cached as RGBA8 levels; KTX files compressed offline are loaded as they
+// are by KtxTextureSource.
+//
+// Example:
+//
+// wvu::TextureCache texture_cache("/path/to/cache");
+// texture_cache.SetDecoder("png", DecodePng);
+// texture_cache.Initialize(0, &error_info_log);
+// texture_cache.Load("/path/to/brick.png");
+// while (...) {  // Rendering loop.
+//   std::vector<wvu::CompletedTextureLoad> completed;
+//   texture_cache.TakeCompletedTextures(&completed);
+//   for (wvu::CompletedTextureLoad& load : completed) {
+//     texture_manager.Add(std::move(load.source), &error_info_log);
+//   }
+//   ...  // Draw the textures loaded so far.
+// }
+class TextureCache {
+ public:
+  // Parameters:
+  //   cache_directory  The directory of the cached KTX files. It must exist.
+  explicit TextureCache(const std::string& cache_directory);
+  ~TextureCache();
+
+  // Sets the decoder of the images with an extension, e.g., "png". Must be
+  // called before Initialize().
+  void SetDecoder(const std::string& extension, ImageDecoder decoder);
+
+  // Starts the worker threads. Returns true if successful.
+  // Parameters:
+  //   num_threads  The number of worker threads. Zero uses one thread per
+  //     hardware thread, leaving one to the render thread.
+  //   error_info_log  The reason of the failure.
+  bool Initialize(const int num_threads, std::string* error_info_log);
+
+  // Queues the load of an image, and returns the id of the load.
+  int Load(const std::string& image_filepath);
+
+  // Appends the loads that finished to loads, in the order they finished.
+  // Never waits for the workers. Returns the number of loads appended.
+  int TakeCompletedTextures(std::vector<CompletedTextureLoad>* loads);
+
+  // Stops the worker threads once they finish their current load. The loads
+  // not started yet are dropped. The destructor stops the threads too.
+  void Stop();
+
+  // Returns the number of loads not taken yet.
+  int num_pending() const;
+
+  // Returns the path of the cached file of an image, or an empty string if
+  // the image cannot be read.
+  std::string CacheFilepath(const std::string& image_filepath) const;
+
+  // Returns the path of the cached file of data derived from content of the
+  // hash, e.g., the HashContent() of an image and of the parameters of its
+  // processing, with the extension, e.g., "ktx".
+  std::string ContentCacheFilepath(const uint64_t content_hash,
+                                   const std::string& extension) const;
+
+ private:
+  // An image waiting for a worker.
+  struct QueuedLoad {
+    int id;
+    std::string image_filepath;
+  };
+
+  // Body of the worker threads.
+  void Run();
+
+  // Maps the cached file of an image, decoding the image into it first if it
+  // is not cached.
+  CompletedTextureLoad Execute(const QueuedLoad& load) const;
+
+  const std::string cache_directory_;
+  // Decoders by extension, only written before the threads start.
+  std::map<std::string, ImageDecoder> decoders_;
+  std::vector<std::thread> threads_;
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stop_;
+  int next_id_;
+  // Loads started but not finished.
+  int num_running_;
+  std::deque<QueuedLoad> queued_;
+  std::vector<CompletedTextureLoad> completed_;
+
+  TextureCache(const TextureCache&) = delete;
+  TextureCache& operator=(const TextureCache&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_TEXTURE_CACHE_H_
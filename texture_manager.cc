@@ -0,0 +1,236 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "texture_manager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+#include "gpu_resources.h"
+#include "texture_source.h"
+
+namespace wvu {
+namespace {
+
+int LevelDimension(const int dimension, const int level) {
+  return std::max(dimension >> level, 1);
+}
+
+// Returns the size in bytes of a level of a source.
+size_t SourceLevelSize(const TextureSource& source, const int level) {
+  return TextureLevelSize(source.format(),
+                          LevelDimension(source.width(), level),
+                          LevelDimension(source.height(), level));
+}
+
+}  // namespace
+
+TextureManager::TextureManager(const int resident_size)
+    : resident_size_(std::max(resident_size, 1)),
+      texture_storage_supported_(GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+}
+
+TextureManager::~TextureManager() {
+  Reset();
+}
+
+int TextureManager::Add(std::unique_ptr<TextureSource> source,
+                        std::string* error_info_log) {
+  const TextureFormat format = source->format();
+  if (!TextureFormatSupported(format)) {
+    *error_info_log = std::string("The format ") + TextureFormatName(format) +
+        " is not supported.";
+    return -1;
+  }
+  if (source->num_levels() <= 0) {
+    *error_info_log = "The texture has no levels.";
+    return -1;
+  }
+  Texture texture;
+  texture.immutable = texture_storage_supported_;
+  const int num_levels = source->num_levels();
+  texture.resident_level = num_levels;
+  texture.source = std::move(source);
+  glGenTextures(1, &texture.texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture.texture_id);
+  if (texture.immutable) {
+    glTexStorage2D(GL_TEXTURE_2D, num_levels, TextureInternalFormat(format),
+                   texture.source->width(), texture.source->height());
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, num_levels - 1);
+  // The coarsest level is uploaded even if it is larger than resident_size_.
+  int level = num_levels - 1;
+  size_t resident_bytes = 0;
+  while (level >= 0) {
+    if (!UploadLevel(level, &texture)) {
+      glDeleteTextures(1, &texture.texture_id);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      *error_info_log = "Could not read the level " + std::to_string(level) +
+          " of the texture.";
+      return -1;
+    }
+    resident_bytes += SourceLevelSize(*texture.source, level);
+    --level;
+    if (level < 0 ||
+        std::max(LevelDimension(texture.source->width(), level),
+                 LevelDimension(texture.source->height(), level)) >
+        resident_size_) {
+      break;
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  statistics_.resident_bytes += resident_bytes;
+  texture.requested_level = texture.resident_level;
+  textures_.push_back(std::move(texture));
+  return textures_.size() - 1;
+}
+
+void TextureManager::RequestScreenSize(const int texture,
+                                       const float size_in_pixels) {
+  const TextureSource& source = *textures_[texture].source;
+  const float size_in_texels = std::max(source.width(), source.height());
+  // The level whose size is closest to the covered pixels, from above, so the
+  // texels are never magnified more than by the trilinear filter.
+  const int level = size_in_pixels > 0.0f ?
+      static_cast<int>(std::floor(std::log2(std::max(
+          size_in_texels / size_in_pixels, 1.0f)))) :
+      source.num_levels() - 1;
+  RequestLevel(texture, level);
+}
+
+void TextureManager::RequestLevel(const int texture, const int level) {
+  Texture& entry = textures_[texture];
+  const int clamped_level =
+      std::min(std::max(level, 0), entry.source->num_levels() - 1);
+  entry.requested_level = std::min(entry.requested_level, clamped_level);
+}
+
+bool TextureManager::Update(const size_t max_bytes) {
+  statistics_.uploaded_bytes = 0;
+  statistics_.num_uploaded_levels = 0;
+  bool success = true;
+  while (true) {
+    // The smallest pending level of all the textures is uploaded first, so
+    // that every texture sharpens before any reaches its finest level.
+    Texture* next = nullptr;
+    size_t next_size = 0;
+    for (Texture& texture : textures_) {
+      if (texture.requested_level >= texture.resident_level) continue;
+      const size_t size =
+          SourceLevelSize(*texture.source, texture.resident_level - 1);
+      if (next == nullptr || size < next_size) {
+        next = &texture;
+        next_size = size;
+      }
+    }
+    if (next == nullptr) break;
+    if (statistics_.num_uploaded_levels > 0 &&
+        statistics_.uploaded_bytes + next_size > max_bytes) {
+      break;
+    }
+    glBindTexture(GL_TEXTURE_2D, next->texture_id);
+    if (!UploadLevel(next->resident_level - 1, next)) {
+      // The level is not requested again.
+      next->requested_level = next->resident_level;
+      success = false;
+      continue;
+    }
+    statistics_.uploaded_bytes += next_size;
+    statistics_.resident_bytes += next_size;
+    ++statistics_.num_uploaded_levels;
+  }
+  if (statistics_.num_uploaded_levels > 0) glBindTexture(GL_TEXTURE_2D, 0);
+  statistics_.num_pending_levels = 0;
+  for (const Texture& texture : textures_) {
+    statistics_.num_pending_levels +=
+        std::max(texture.resident_level - texture.requested_level, 0);
+  }
+  return success;
+}
+
+void TextureManager::Reset() {
+  for (Texture& texture : textures_) {
+    GpuResources::Get()->Retire(GPU_TEXTURE, texture.texture_id);
+  }
+  textures_.clear();
+  statistics_ = TextureStreamingStatistics();
+}
+
+bool TextureManager::UploadLevel(const int level, Texture* texture) {
+  TextureSource* source = texture->source.get();
+  const GLubyte* data = nullptr;
+  size_t size = 0;
+  if (!source->GetLevel(level, &data, &size) ||
+      size != SourceLevelSize(*source, level)) {
+    return false;
+  }
+  const TextureFormat format = source->format();
+  const GLenum internal_format = TextureInternalFormat(format);
+  const int width = LevelDimension(source->width(), level);
+  const int height = LevelDimension(source->height(), level);
+  if (IsCompressedTextureFormat(format)) {
+    if (texture->immutable) {
+      glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height,
+                                internal_format, size, data);
+    } else {
+      glCompressedTexImage2D(GL_TEXTURE_2D, level, internal_format, width,
+                             height, 0, size, data);
+    }
+  } else {
+    if (texture->immutable) {
+      glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, GL_RGBA,
+                      TextureTexelType(format), data);
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, level, internal_format, width, height, 0,
+                   GL_RGBA, TextureTexelType(format), data);
+    }
+  }
+  // The finer levels are not uploaded yet, so sampling starts at this one.
+  texture->resident_level = level;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,176 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_TEXTURE_MANAGER_H_
+#define GLUTILS_TEXTURE_MANAGER_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "texture_source.h"
+
+namespace wvu {
+// Default size of the coarsest levels uploaded when a texture is added, so
+// that it can be sampled before any of its finer levels is streamed.
+constexpr int kDefaultResidentTextureSize = 64;
+
+// Default number of bytes of texels uploaded per call to
+// TextureManager::Update().
+constexpr size_t kDefaultTextureStreamingBytesPerFrame = 1 << 20;
+
+// Counters of the texels held by a TextureManager.
+struct TextureStreamingStatistics {
+  // Bytes of the levels uploaded so far.
+  size_t resident_bytes = 0;
+  // Levels requested but not uploaded yet.
+  int num_pending_levels = 0;
+  // Bytes and levels uploaded by the last call to Update().
+  size_t uploaded_bytes = 0;
+  int num_uploaded_levels = 0;
+};
+
+// This class owns the textures of a scene and streams their mip levels. A
+// texture is added with its coarsest levels, up to resident_size texels wide,
+// and its finer levels are uploaded on demand, when the texture covers enough
+// pixels on the screen to sample them, coarse to fine and within a budget of
+// bytes per frame. The sampler clamps GL_TEXTURE_BASE_LEVEL to the finest
+// resident level, so that the missing levels are never sampled.
+// The storage of a texture holds its whole mip chain, so the memory of the
+// levels is allocated once with glTexStorage2D (OpenGL 4.2 or
+// ARB_texture_storage), and the driver does not validate the completeness of
+// the texture on every draw. Without immutable storage, each level is
+// allocated when it is uploaded. Compressed formats are uploaded as they are,
+// with glCompressedTexSubImage2D, and stay compressed on the GPU.
+//
+// Example:
+//
+// wvu::TextureManager texture_manager;
+// std::unique_ptr<wvu::KtxTextureSource> source(new wvu::KtxTextureSource);
+// if (!source->Open("/path/to/texture.ktx", &error_info_log)) {
+//   LOG(ERROR) << error_info_log;
+// }
+// const int texture = texture_manager.Add(std::move(source), &error_info_log);
+// while (...) {  // Rendering loop.
+//   texture_manager.RequestScreenSize(texture, projected_size_in_pixels);
+//   texture_manager.Update();
+//   glBindTexture(GL_TEXTURE_2D, texture_manager.texture_id(texture));
+//   ...  // Draws.
+// }
+class TextureManager {
+ public:
+  // The context must be current, since the support of immutable storage is
+  // checked here.
+  // Parameters:
+  //   resident_size  The size in texels of the finest level uploaded when a
+  //     texture is added.
+  explicit TextureManager(
+      const int resident_size = kDefaultResidentTextureSize);
+  ~TextureManager();
+
+  // Creates the texture of a source and uploads its coarsest levels. The
+  // context must be current. Returns the index of the texture, or -1 if the
+  // format is not supported by the context or a level cannot be read.
+  // Parameters:
+  //   source  The levels of the texture, read again when they are streamed.
+  //   error_info_log  The reason of the failure.
+  int Add(std::unique_ptr<TextureSource> source, std::string* error_info_log);
+
+  // Requests the levels of a texture sampled when it covers size_in_pixels
+  // pixels on the screen, along its largest side. The requests only add
+  // levels: the uploaded levels stay resident.
+  void RequestScreenSize(const int texture, const float size_in_pixels);
+
+  // Requests the levels of a texture down to level, 0 being the finest.
+  void RequestLevel(const int texture, const int level);
+
+  // Uploads the requested levels, coarse to fine, until max_bytes bytes were
+  // uploaded. At least one level is uploaded if any is pending, so that large
+  // levels are not starved by the budget. Returns false if a level could not
+  // be read; the texture keeps its resident levels then.
+  bool Update(const size_t max_bytes = kDefaultTextureStreamingBytesPerFrame);
+
+  // Deletes the textures.
+  void Reset();
+
+  int num_textures() const {
+    return textures_.size();
+  }
+
+  GLuint texture_id(const int texture) const {
+    return textures_[texture].texture_id;
+  }
+
+  // Returns the finest level of a texture uploaded so far.
+  int resident_level(const int texture) const {
+    return textures_[texture].resident_level;
+  }
+
+  // Returns the finest level of a texture requested so far.
+  int requested_level(const int texture) const {
+    return textures_[texture].requested_level;
+  }
+
+  const TextureStreamingStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  struct Texture {
+    std::unique_ptr<TextureSource> source;
+    GLuint texture_id = 0;
+    // True if the levels were allocated with glTexStorage2D.
+    bool immutable = false;
+    int resident_level = 0;
+    int requested_level = 0;
+  };
+
+  // Uploads a level of a texture and makes it the finest level sampled.
+  bool UploadLevel(const int level, Texture* texture);
+
+  const int resident_size_;
+  // True if the context supports glTexStorage2D.
+  bool texture_storage_supported_;
+  std::vector<Texture> textures_;
+  TextureStreamingStatistics statistics_;
+
+  TextureManager(const TextureManager&) = delete;
+  TextureManager& operator=(const TextureManager&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_TEXTURE_MANAGER_H_
@@ -0,0 +1,366 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "texture_source.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+#include "mapped_file.h"
+
+namespace wvu {
+namespace {
+// Properties of a texture format.
+struct TextureFormatInfo {
+  const char* name;
+  GLenum internal_format;
+  // Size of a block of texels, 1x1 for the uncompressed formats.
+  int block_size;
+  int bytes_per_block;
+};
+
+const TextureFormatInfo kTextureFormats[NUM_TEXTURE_FORMATS] = {
+  {"RGBA8", GL_RGBA8, 1, 4},
+  {"BC1", GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 4, 8},
+  {"BC3", GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 4, 16},
+  {"BC7", GL_COMPRESSED_RGBA_BPTC_UNORM, 4, 16},
+  {"ETC2_RGB8", GL_COMPRESSED_RGB8_ETC2, 4, 8},
+  {"ETC2_RGBA8", GL_COMPRESSED_RGBA8_ETC2_EAC, 4, 16},
+  {"ASTC_4X4", GL_COMPRESSED_RGBA_ASTC_4x4_KHR, 4, 16},
+  {"RGBA16F", GL_RGBA16F, 1, 8}
+};
+
+// The identifier at the start of the KTX 1.1 files.
+const uint8_t kKtxIdentifier[12] = {
+  0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+// Written as a uint32 by the writer, so it reads back swapped in files of the
+// other endianness.
+constexpr uint32_t kKtxEndianness = 0x04030201;
+
+// The fields of the KTX header following its identifier.
+struct KtxHeader {
+  uint32_t endianness;
+  uint32_t gl_type;
+  uint32_t gl_type_size;
+  uint32_t gl_format;
+  uint32_t gl_internal_format;
+  uint32_t gl_base_internal_format;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t number_of_array_elements;
+  uint32_t number_of_faces;
+  uint32_t number_of_mipmap_levels;
+  uint32_t bytes_of_key_value_data;
+};
+
+static_assert(sizeof(kKtxIdentifier) + sizeof(KtxHeader) == 64,
+              "The KTX header must have 64 bytes.");
+
+// The size of a level, in texels, rounded down to 1.
+int LevelDimension(const int dimension, const int level) {
+  return std::max(dimension >> level, 1);
+}
+
+}  // namespace
+
+const char* TextureFormatName(const TextureFormat format) {
+  return kTextureFormats[format].name;
+}
+
+GLenum TextureInternalFormat(const TextureFormat format) {
+  return kTextureFormats[format].internal_format;
+}
+
+GLenum TextureTexelType(const TextureFormat format) {
+  return format == TEXTURE_FORMAT_RGBA16F ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE;
+}
+
+bool IsCompressedTextureFormat(const TextureFormat format) {
+  return kTextureFormats[format].block_size > 1;
+}
+
+bool FindTextureFormat(const GLenum internal_format, TextureFormat* format) {
+  for (int i = 0; i < NUM_TEXTURE_FORMATS; ++i) {
+    if (kTextureFormats[i].internal_format == internal_format) {
+      *format = static_cast<TextureFormat>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TextureFormatSupported(const TextureFormat format) {
+  switch (format) {
+    case TEXTURE_FORMAT_RGBA8:
+    case TEXTURE_FORMAT_RGBA16F:
+      return true;
+    case TEXTURE_FORMAT_BC1:
+    case TEXTURE_FORMAT_BC3:
+      return GLEW_EXT_texture_compression_s3tc;
+    case TEXTURE_FORMAT_BC7:
+      return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+    case TEXTURE_FORMAT_ETC2_RGB8:
+    case TEXTURE_FORMAT_ETC2_RGBA8:
+      return GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility;
+    case TEXTURE_FORMAT_ASTC_4X4:
+      return GLEW_KHR_texture_compression_astc_ldr;
+    default:
+      return false;
+  }
+}
+
+size_t TextureLevelSize(const TextureFormat format,
+                        const int width,
+                        const int height) {
+  const TextureFormatInfo& info = kTextureFormats[format];
+  const size_t num_blocks_x = (width + info.block_size - 1) / info.block_size;
+  const size_t num_blocks_y = (height + info.block_size - 1) / info.block_size;
+  return num_blocks_x * num_blocks_y * info.bytes_per_block;
+}
+
+int NumMipLevels(const int width, const int height) {
+  int num_levels = 1;
+  while ((std::max(width, height) >> num_levels) > 0) ++num_levels;
+  return num_levels;
+}
+
+void GenerateMipLevels(const int width,
+                       const int height,
+                       std::vector<std::vector<GLubyte> >* levels) {
+  constexpr int kNumChannels = 4;
+  levels->resize(NumMipLevels(width, height));
+  for (size_t level = 1; level < levels->size(); ++level) {
+    const int previous_width = LevelDimension(width, level - 1);
+    const int previous_height = LevelDimension(height, level - 1);
+    const int level_width = LevelDimension(width, level);
+    const int level_height = LevelDimension(height, level);
+    const std::vector<GLubyte>& previous = (*levels)[level - 1];
+    std::vector<GLubyte>& texels = (*levels)[level];
+    texels.resize(level_width * level_height * kNumChannels);
+    for (int y = 0; y < level_height; ++y) {
+      // The odd rows and columns of the previous level are dropped, and the
+      // levels of a side of one texel repeat it.
+      const int y0 = std::min(2 * y, previous_height - 1);
+      const int y1 = std::min(2 * y + 1, previous_height - 1);
+      for (int x = 0; x < level_width; ++x) {
+        const int x0 = std::min(2 * x, previous_width - 1);
+        const int x1 = std::min(2 * x + 1, previous_width - 1);
+        for (int c = 0; c < kNumChannels; ++c) {
+          const int sum =
+              previous[(y0 * previous_width + x0) * kNumChannels + c] +
+              previous[(y0 * previous_width + x1) * kNumChannels + c] +
+              previous[(y1 * previous_width + x0) * kNumChannels + c] +
+              previous[(y1 * previous_width + x1) * kNumChannels + c];
+          texels[(y * level_width + x) * kNumChannels + c] = (sum + 2) / 4;
+        }
+      }
+    }
+  }
+}
+
+bool WriteKtxFile(const TextureFormat format,
+                  const int width,
+                  const int height,
+                  const std::vector<std::vector<GLubyte> >& levels,
+                  const std::string& filepath,
+                  std::string* error_info_log) {
+  for (size_t level = 0; level < levels.size(); ++level) {
+    if (levels[level].size() !=
+        TextureLevelSize(format, LevelDimension(width, level),
+                         LevelDimension(height, level))) {
+      *error_info_log = "Invalid size of the level " + std::to_string(level);
+      return false;
+    }
+  }
+  KtxHeader header;
+  header.endianness = kKtxEndianness;
+  // Compressed textures have no type nor format.
+  const bool compressed = IsCompressedTextureFormat(format);
+  header.gl_type = compressed ? 0 : TextureTexelType(format);
+  header.gl_type_size = format == TEXTURE_FORMAT_RGBA16F ? 2 : 1;
+  header.gl_format = compressed ? 0 : GL_RGBA;
+  header.gl_internal_format = TextureInternalFormat(format);
+  header.gl_base_internal_format = GL_RGBA;
+  header.pixel_width = width;
+  header.pixel_height = height;
+  header.pixel_depth = 0;
+  header.number_of_array_elements = 0;
+  header.number_of_faces = 1;
+  header.number_of_mipmap_levels = levels.size();
+  header.bytes_of_key_value_data = 0;
+
+  const std::string temporary_filepath = filepath + ".tmp";
+  std::ofstream out(temporary_filepath, std::ios::binary);
+  if (!out.is_open()) {
+    *error_info_log = "Could not open " + temporary_filepath;
+    return false;
+  }
+  out.write(reinterpret_cast<const char*>(kKtxIdentifier),
+            sizeof(kKtxIdentifier));
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  const char padding[3] = {0, 0, 0};
+  for (const std::vector<GLubyte>& texels : levels) {
+    const uint32_t image_size = texels.size();
+    out.write(reinterpret_cast<const char*>(&image_size), sizeof(image_size));
+    out.write(reinterpret_cast<const char*>(texels.data()), image_size);
+    out.write(padding, (4 - image_size % 4) % 4);
+  }
+  out.close();
+  if (!out) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + temporary_filepath;
+    return false;
+  }
+  if (std::rename(temporary_filepath.c_str(), filepath.c_str()) != 0) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not rename " + temporary_filepath;
+    return false;
+  }
+  return true;
+}
+
+MemoryTextureSource::MemoryTextureSource(
+    const TextureFormat format,
+    const int width,
+    const int height,
+    std::vector<std::vector<GLubyte> > levels)
+    : format_(format),
+      width_(width),
+      height_(height),
+      levels_(std::move(levels)) {}
+
+bool MemoryTextureSource::GetLevel(const int level,
+                                   const GLubyte** data,
+                                   size_t* size) {
+  if (level < 0 || level >= num_levels()) return false;
+  const size_t expected_size =
+      TextureLevelSize(format_, LevelDimension(width_, level),
+                       LevelDimension(height_, level));
+  if (levels_[level].size() != expected_size) return false;
+  *data = levels_[level].data();
+  *size = levels_[level].size();
+  return true;
+}
+
+bool KtxTextureSource::Open(const std::string& filepath,
+                            std::string* error_info_log) {
+  if (!file_.Open(filepath)) {
+    *error_info_log = "Could not map " + filepath;
+    return false;
+  }
+  const size_t file_size = file_.size();
+  if (file_size < sizeof(kKtxIdentifier) + sizeof(KtxHeader) ||
+      std::memcmp(file_.data(), kKtxIdentifier, sizeof(kKtxIdentifier)) != 0) {
+    *error_info_log = filepath + " is not a KTX file.";
+    return false;
+  }
+  // The mapping is page-aligned, so the header can be read in place.
+  const KtxHeader* header = reinterpret_cast<const KtxHeader*>(
+      file_.data() + sizeof(kKtxIdentifier));
+  if (header->endianness != kKtxEndianness) {
+    *error_info_log = filepath + " is big-endian.";
+    return false;
+  }
+  if (!FindTextureFormat(header->gl_internal_format, &format_)) {
+    *error_info_log = filepath + " has the unsupported internal format " +
+        std::to_string(header->gl_internal_format);
+    return false;
+  }
+  if (header->pixel_width == 0 || header->pixel_height == 0 ||
+      header->pixel_depth > 1 || header->number_of_array_elements > 0 ||
+      header->number_of_faces != 1) {
+    *error_info_log = filepath + " is not a 2D texture.";
+    return false;
+  }
+  width_ = header->pixel_width;
+  height_ = header->pixel_height;
+  // Zero levels ask the reader to generate the mip levels, which the manager
+  // does not do, so only level 0 is read.
+  const int num_levels = std::min<int>(
+      std::max<uint32_t>(header->number_of_mipmap_levels, 1),
+      NumMipLevels(width_, height_));
+  size_t offset = sizeof(kKtxIdentifier) + sizeof(KtxHeader);
+  if (header->bytes_of_key_value_data > file_size - offset) {
+    *error_info_log = filepath + " is corrupted.";
+    return false;
+  }
+  offset += header->bytes_of_key_value_data;
+  level_offsets_.clear();
+  level_sizes_.clear();
+  for (int level = 0; level < num_levels; ++level) {
+    uint32_t image_size;
+    if (file_size - offset < sizeof(image_size)) {
+      *error_info_log = filepath + " is truncated.";
+      return false;
+    }
+    std::memcpy(&image_size, file_.data() + offset, sizeof(image_size));
+    offset += sizeof(image_size);
+    const size_t expected_size =
+        TextureLevelSize(format_, LevelDimension(width_, level),
+                         LevelDimension(height_, level));
+    if (image_size != expected_size || image_size > file_size - offset) {
+      *error_info_log = filepath + " has an invalid level " +
+          std::to_string(level);
+      return false;
+    }
+    level_offsets_.push_back(offset);
+    level_sizes_.push_back(image_size);
+    // The levels are padded to 4 bytes.
+    offset += (image_size + 3) / 4 * 4;
+    offset = std::min(offset, file_size);
+  }
+  return true;
+}
+
+bool KtxTextureSource::GetLevel(const int level,
+                                const GLubyte** data,
+                                size_t* size) {
+  if (level < 0 || level >= num_levels()) return false;
+  *data = reinterpret_cast<const GLubyte*>(file_.data()) +
+      level_offsets_[level];
+  *size = level_sizes_[level];
+  return true;
+}
+
+}  // namespace wvu
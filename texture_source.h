@@ -0,0 +1,246 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_TEXTURE_SOURCE_H_
+#define GLUTILS_TEXTURE_SOURCE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "mapped_file.h"
+
+namespace wvu {
+// Formats of the texels of a texture. The compressed formats store blocks of
+// texels, which the GPU samples without decompressing them, so they take a
+// fraction of the memory and of the bandwidth of RGBA8.
+enum TextureFormat {
+  // 4 bytes per texel.
+  TEXTURE_FORMAT_RGBA8 = 0,
+  // BC1 (DXT1), 8 bytes per 4x4 block. Needs EXT_texture_compression_s3tc.
+  TEXTURE_FORMAT_BC1 = 1,
+  // BC3 (DXT5), 16 bytes per 4x4 block. Needs EXT_texture_compression_s3tc.
+  TEXTURE_FORMAT_BC3 = 2,
+  // BC7, 16 bytes per 4x4 block. Needs OpenGL 4.2 or
+  // ARB_texture_compression_bptc.
+  TEXTURE_FORMAT_BC7 = 3,
+  // ETC2, 8 bytes per 4x4 block. Needs OpenGL 4.3 or ARB_ES3_compatibility.
+  TEXTURE_FORMAT_ETC2_RGB8 = 4,
+  // ETC2 with EAC alpha, 16 bytes per 4x4 block. Needs OpenGL 4.3 or
+  // ARB_ES3_compatibility.
+  TEXTURE_FORMAT_ETC2_RGBA8 = 5,
+  // ASTC, 16 bytes per 4x4 block. Needs KHR_texture_compression_astc_ldr.
+  TEXTURE_FORMAT_ASTC_4X4 = 6,
+  // Half floats, 8 bytes per texel, for colors past 1, e.g., prefiltered
+  // environment maps.
+  TEXTURE_FORMAT_RGBA16F = 7,
+  NUM_TEXTURE_FORMATS = 8
+};
+
+// Returns the name of a format, e.g., "BC7".
+const char* TextureFormatName(const TextureFormat format);
+
+// Returns the OpenGL internal format of a format.
+GLenum TextureInternalFormat(const TextureFormat format);
+
+// Returns the type of the components of the texels of an uncompressed format,
+// passed to glTexSubImage2D() with GL_RGBA.
+GLenum TextureTexelType(const TextureFormat format);
+
+// Returns true if the format is stored in blocks.
+bool IsCompressedTextureFormat(const TextureFormat format);
+
+// Finds the format of an OpenGL internal format. Returns false if the library
+// does not support it.
+bool FindTextureFormat(const GLenum internal_format, TextureFormat* format);
+
+// Returns true if the context samples textures of the format. The context
+// must be current.
+bool TextureFormatSupported(const TextureFormat format);
+
+// Returns the size in bytes of a mip level of width x height texels.
+size_t TextureLevelSize(const TextureFormat format,
+                        const int width,
+                        const int height);
+
+// Returns the number of levels of a full mip chain, down to 1x1.
+int NumMipLevels(const int width, const int height);
+
+// Generates the mip levels of RGBA8 texels, each averaging the 2x2 texels of
+// the previous one, down to 1x1.
+// Parameters:
+//   width  The width of level 0.
+//   height  The height of level 0.
+//   levels  Holds level 0 on input, and all the levels on output.
+void GenerateMipLevels(const int width,
+                       const int height,
+                       std::vector<std::vector<GLubyte> >* levels);
+
+// Writes the levels of a texture into a KTX 1.1 file at filepath, which
+// KtxTextureSource reads. The file is written into a temporary file first,
+// which is then renamed, so readers never observe a partially written file.
+// Returns true if successful.
+// Parameters:
+//   format  The format of the texels.
+//   width  The width of level 0.
+//   height  The height of level 0.
+//   levels  The texels of each level, from level 0.
+//   filepath  The path of the KTX file.
+//   error_info_log  The reason of the failure.
+bool WriteKtxFile(const TextureFormat format,
+                  const int width,
+                  const int height,
+                  const std::vector<std::vector<GLubyte> >& levels,
+                  const std::string& filepath,
+                  std::string* error_info_log);
+
+// The texels of a texture and its mip levels, which TextureManager reads on
+// demand. Level 0 is the finest, and each level halves the size of the
+// previous one, rounding down, down to 1x1.
+class TextureSource {
+ public:
+  virtual ~TextureSource() {}
+
+  virtual TextureFormat format() const = 0;
+  virtual int width() const = 0;
+  virtual int height() const = 0;
+  virtual int num_levels() const = 0;
+
+  // Points data to the texels of a level, which stay valid as long as the
+  // source. Returns false if the level cannot be read.
+  virtual bool GetLevel(const int level,
+                        const GLubyte** data,
+                        size_t* size) = 0;
+};
+
+// A texture whose levels are held in memory, e.g., generated by the program.
+class MemoryTextureSource : public TextureSource {
+ public:
+  // Parameters:
+  //   format  The format of the texels.
+  //   width  The width of level 0.
+  //   height  The height of level 0.
+  //   levels  The texels of each level, from level 0. They are moved when
+  //     passed as an rvalue.
+  MemoryTextureSource(const TextureFormat format,
+                      const int width,
+                      const int height,
+                      std::vector<std::vector<GLubyte> > levels);
+  ~MemoryTextureSource() override {}
+
+  TextureFormat format() const override {
+    return format_;
+  }
+
+  int width() const override {
+    return width_;
+  }
+
+  int height() const override {
+    return height_;
+  }
+
+  int num_levels() const override {
+    return levels_.size();
+  }
+
+  bool GetLevel(const int level,
+                const GLubyte** data,
+                size_t* size) override;
+
+ private:
+  const TextureFormat format_;
+  const int width_;
+  const int height_;
+  std::vector<std::vector<GLubyte> > levels_;
+
+  MemoryTextureSource(const MemoryTextureSource&) = delete;
+  MemoryTextureSource& operator=(const MemoryTextureSource&) = delete;
+};
+
+// A texture read from a KTX 1.1 file, the Khronos container of compressed
+// textures and their mip levels (see
+// https://registry.khronos.org/KTX/specs/1.0/ktxspec.v1.html). The file is
+// mapped, so the levels are only paged in when they are uploaded. Only 2D
+// textures without array layers or cube faces, in little-endian files, are
+// supported.
+class KtxTextureSource : public TextureSource {
+ public:
+  KtxTextureSource() : format_(TEXTURE_FORMAT_RGBA8), width_(0), height_(0) {}
+  ~KtxTextureSource() override {}
+
+  // Maps the file and validates the sizes of its levels. Returns true if
+  // successful.
+  // Parameters:
+  //   filepath  The path of the KTX file.
+  //   error_info_log  The reason of the failure.
+  bool Open(const std::string& filepath, std::string* error_info_log);
+
+  TextureFormat format() const override {
+    return format_;
+  }
+
+  int width() const override {
+    return width_;
+  }
+
+  int height() const override {
+    return height_;
+  }
+
+  int num_levels() const override {
+    return level_offsets_.size();
+  }
+
+  bool GetLevel(const int level,
+                const GLubyte** data,
+                size_t* size) override;
+
+ private:
+  MappedFile file_;
+  TextureFormat format_;
+  int width_;
+  int height_;
+  // Offset and size in the file of the texels of each level.
+  std::vector<size_t> level_offsets_;
+  std::vector<size_t> level_sizes_;
+
+  KtxTextureSource(const KtxTextureSource&) = delete;
+  KtxTextureSource& operator=(const KtxTextureSource&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_TEXTURE_SOURCE_H_
@@ -0,0 +1,212 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "thread_placement.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // __linux__
+
+namespace wvu {
+namespace {
+#ifdef __linux__
+// Parses a CPU list of the kernel, e.g., "0-3,8-11".
+std::vector<int> ParseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  size_t begin = 0;
+  while (begin < list.size()) {
+    size_t end = list.find(',', begin);
+    if (end == std::string::npos) end = list.size();
+    const std::string range = list.substr(begin, end - begin);
+    begin = end + 1;
+    const size_t dash = range.find('-');
+    const int first = std::atoi(range.c_str());
+    const int last = dash == std::string::npos ? first :
+        std::atoi(range.c_str() + dash + 1);
+    for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+#endif  // __linux__
+
+}  // namespace
+
+int CpuTopology::NodeOfCpu(const int cpu) const {
+  for (int node = 0; node < num_nodes(); ++node) {
+    if (std::binary_search(node_cpus[node].begin(), node_cpus[node].end(),
+                           cpu)) {
+      return node;
+    }
+  }
+  return -1;
+}
+
+CpuTopology QueryCpuTopology() {
+  CpuTopology topology;
+#ifdef __linux__
+  // The node directories are numbered, possibly with gaps.
+  std::vector<int> node_ids;
+  DIR* directory = opendir("/sys/devices/system/node");
+  if (directory != nullptr) {
+    while (const dirent* entry = readdir(directory)) {
+      if (std::strncmp(entry->d_name, "node", 4) == 0 &&
+          entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+        node_ids.push_back(std::atoi(entry->d_name + 4));
+      }
+    }
+    closedir(directory);
+  }
+  std::sort(node_ids.begin(), node_ids.end());
+  for (const int node_id : node_ids) {
+    std::ifstream file("/sys/devices/system/node/node" +
+                       std::to_string(node_id) + "/cpulist");
+    std::string list;
+    if (!std::getline(file, list)) continue;
+    std::vector<int> cpus = ParseCpuList(list);
+    // Nodes of memory only have no CPUs.
+    if (cpus.empty()) continue;
+    std::sort(cpus.begin(), cpus.end());
+    topology.node_cpus.push_back(cpus);
+  }
+#endif  // __linux__
+  if (topology.node_cpus.empty()) {
+    const int num_cpus = std::max<int>(std::thread::hardware_concurrency(), 1);
+    topology.node_cpus.resize(1);
+    for (int cpu = 0; cpu < num_cpus; ++cpu) {
+      topology.node_cpus[0].push_back(cpu);
+    }
+  }
+  return topology;
+}
+
+ThreadPlacement PlanThreadPlacement(const CpuTopology& topology,
+                                   const int main_cpu,
+                                   const int num_workers) {
+  ThreadPlacement placement;
+  placement.main_cpu = main_cpu;
+  if (num_workers <= 0 || topology.num_nodes() == 0) return placement;
+  // The CPUs of the node of the main thread first, then those of the next
+  // nodes, without the CPU of the main thread.
+  const int first_node = std::max(topology.NodeOfCpu(main_cpu), 0);
+  std::vector<int> cpus;
+  for (int i = 0; i < topology.num_nodes(); ++i) {
+    for (const int cpu :
+         topology.node_cpus[(first_node + i) % topology.num_nodes()]) {
+      if (cpu != main_cpu) cpus.push_back(cpu);
+    }
+  }
+  if (cpus.empty()) return placement;
+  for (int i = 0; i < num_workers; ++i) {
+    placement.worker_cpus.push_back(cpus[i % cpus.size()]);
+  }
+  return placement;
+}
+
+bool PinCurrentThread(const std::vector<int>& cpus,
+                      std::string* error_info_log) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const int cpu : cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      *error_info_log = "Invalid CPU " + std::to_string(cpu) + ".";
+      return false;
+    }
+    CPU_SET(cpu, &set);
+  }
+  const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (error != 0) {
+    *error_info_log = std::string("Could not set the CPU affinity: ") +
+        std::strerror(error) + ".";
+    return false;
+  }
+  return true;
+#else
+  *error_info_log = "Pinning threads is only supported on Linux.";
+  return false;
+#endif  // __linux__
+}
+
+bool SetCurrentThreadNiceness(const int niceness,
+                              std::string* error_info_log) {
+#ifdef __linux__
+  // Linux applies the niceness of a thread id to that thread only.
+  const id_t thread_id = static_cast<id_t>(syscall(SYS_gettid));
+  if (setpriority(PRIO_PROCESS, thread_id, niceness) != 0) {
+    *error_info_log = "Could not set the niceness to " +
+        std::to_string(niceness) + ": " + std::strerror(errno) + ".";
+    return false;
+  }
+  return true;
+#else
+  *error_info_log = "Setting the niceness of threads is only supported on "
+      "Linux.";
+  return false;
+#endif  // __linux__
+}
+
+int CurrentCpu() {
+#ifdef __linux__
+  return sched_getcpu();
+#else
+  return -1;
+#endif  // __linux__
+}
+
+bool PlaceMainThread(const ThreadPlacement& placement,
+                     std::string* error_info_log) {
+  if (placement.main_cpu >= 0 &&
+      !PinCurrentThread(std::vector<int>(1, placement.main_cpu),
+                        error_info_log)) {
+    return false;
+  }
+  return placement.main_niceness == 0 ||
+      SetCurrentThreadNiceness(placement.main_niceness, error_info_log);
+}
+
+}  // namespace wvu
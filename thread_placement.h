@@ -0,0 +1,103 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_THREAD_PLACEMENT_H_
+#define GLUTILS_THREAD_PLACEMENT_H_
+
+#include <string>
+#include <vector>
+
+namespace wvu {
+// The CPUs of the NUMA nodes of the machine.
+struct CpuTopology {
+  // The CPUs of each node, in increasing order. A single node holds all the
+  // CPUs when the kernel reports no nodes.
+  std::vector<std::vector<int> > node_cpus;
+
+  int num_nodes() const {
+    return node_cpus.size();
+  }
+
+  // Returns the node of a CPU, or -1 if the CPU is unknown.
+  int NodeOfCpu(const int cpu) const;
+};
+
+// Reads the topology from /sys/devices/system/node on Linux. Elsewhere, or
+// without NUMA support, returns one node of std::thread::hardware_concurrency()
+// CPUs.
+CpuTopology QueryCpuTopology();
+
+// Where the threads of the renderer run: the thread of the OpenGL context on a
+// core of its own, at a raised priority, and the workers of the JobSystem on
+// the other cores of the same NUMA node, so that the threads are not migrated
+// and their memory stays local.
+struct ThreadPlacement {
+  // The CPU of the main thread, or -1 to leave it to the scheduler.
+  int main_cpu = -1;
+  // The niceness of the main thread, from -20 to 19. Negative values raise
+  // the priority, and need CAP_SYS_NICE or a matching RLIMIT_NICE.
+  int main_niceness = 0;
+  // The CPU of each worker, or none to leave them to the scheduler.
+  std::vector<int> worker_cpus;
+};
+
+// Places the main thread on main_cpu and num_workers workers on the other CPUs
+// of its node, and then of the next nodes if the node has too few. Workers
+// beyond the number of CPUs share them. A negative main_cpu leaves the main
+// thread unpinned and fills the nodes from the first one.
+ThreadPlacement PlanThreadPlacement(const CpuTopology& topology,
+                                   const int main_cpu,
+                                   const int num_workers);
+
+// Restricts the calling thread to a set of CPUs. Returns true if successful.
+// Linux only; elsewhere it fails.
+bool PinCurrentThread(const std::vector<int>& cpus,
+                      std::string* error_info_log);
+
+// Sets the niceness of the calling thread. Returns true if successful.
+// Linux only, where the niceness is per thread; elsewhere it fails.
+bool SetCurrentThreadNiceness(const int niceness, std::string* error_info_log);
+
+// Returns the CPU running the calling thread, or -1 if unknown.
+int CurrentCpu();
+
+// Applies the placement of the main thread to the calling thread. Returns true
+// if successful.
+bool PlaceMainThread(const ThreadPlacement& placement,
+                     std::string* error_info_log);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_THREAD_PLACEMENT_H_
@@ -0,0 +1,226 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "tiled_renderer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "framebuffer_readback.h"
+#include "offscreen_framebuffer.h"
+#include "transforms.h"
+
+namespace wvu {
+namespace {
+
+// Bytes of a pixel of the image, and of a pixel read back.
+constexpr int kBytesPerImagePixel = 3;
+constexpr int kBytesPerReadbackPixel = 4;
+
+}  // namespace
+
+Eigen::Matrix4f ComputeImageTileProjection(const float field_of_view,
+                                           const int image_width,
+                                           const int image_height,
+                                           const float near,
+                                           const float far,
+                                           const ImageTile& tile) {
+  // The planes of the whole image at the near plane, split at the pixels of
+  // the tile. The pixels are square.
+  const float top = near / ComputeCotangent(0.5f * field_of_view);
+  const float pixel_size = 2.0f * top / image_height;
+  const float right = 0.5f * pixel_size * image_width;
+  const float tile_left = -right + tile.x * pixel_size;
+  const float tile_top = top - tile.y * pixel_size;
+  return ComputeProjectionMatrix(tile_left,
+                                 tile_left + tile.width * pixel_size,
+                                 tile_top,
+                                 tile_top - tile.height * pixel_size,
+                                 near, far);
+}
+
+TiledRenderer::TiledRenderer()
+    : tile_size_(0), image_data_offset_(0), image_width_(0) {}
+
+TiledRenderer::~TiledRenderer() {}
+
+bool TiledRenderer::Initialize(const int tile_size,
+                               std::string* error_info_log) {
+  Reset();
+  GLint max_renderbuffer_size = 0;
+  glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_renderbuffer_size);
+  GLint max_viewport_size[2] = {0, 0};
+  glGetIntegerv(GL_MAX_VIEWPORT_DIMS, max_viewport_size);
+  tile_size_ = std::min({tile_size, max_renderbuffer_size,
+                         max_viewport_size[0], max_viewport_size[1]});
+  if (tile_size_ <= 0) {
+    *error_info_log = "Invalid tile size.";
+    return false;
+  }
+  if (!framebuffer_.Initialize(tile_size_, tile_size_, error_info_log)) {
+    return false;
+  }
+  readback_.reset(new FramebufferReadback);
+  if (!readback_->Initialize(tile_size_, tile_size_,
+                             kDefaultNumReadbackBuffers,
+                             [this](const ReadbackFrame& frame) {
+                               WriteTile(frame);
+                             })) {
+    Reset();
+    *error_info_log = "Could not create the readback buffers.";
+    return false;
+  }
+  return true;
+}
+
+bool TiledRenderer::Render(const int width,
+                           const int height,
+                           const float field_of_view,
+                           const float near,
+                           const float far,
+                           const std::string& filepath,
+                           const DrawFunction& draw,
+                           std::string* error_info_log) {
+  statistics_ = TiledRenderStatistics();
+  if (readback_ == nullptr) {
+    *error_info_log = "The tiled renderer is not initialized.";
+    return false;
+  }
+  if (width <= 0 || height <= 0) {
+    *error_info_log = "Invalid image size.";
+    return false;
+  }
+  const std::string temporary_filepath = filepath + ".tmp";
+  image_.open(temporary_filepath,
+              std::ios::binary | std::ios::out | std::ios::trunc);
+  if (!image_.is_open()) {
+    *error_info_log = "Could not open " + temporary_filepath;
+    return false;
+  }
+  const std::string header = "P6\n" + std::to_string(width) + " " +
+      std::to_string(height) + "\n255\n";
+  image_.write(header.data(), header.size());
+  image_data_offset_ = header.size();
+  image_width_ = width;
+  row_.resize(static_cast<size_t>(tile_size_) * kBytesPerImagePixel);
+  // The tiles go row by row from the top-left corner, so that the writes of
+  // consecutive tiles are close in the file.
+  tiles_.clear();
+  for (int y = 0; y < height; y += tile_size_) {
+    for (int x = 0; x < width; x += tile_size_) {
+      ImageTile tile;
+      tile.x = x;
+      tile.y = y;
+      tile.width = std::min(tile_size_, width - x);
+      tile.height = std::min(tile_size_, height - y);
+      tiles_.push_back(tile);
+    }
+  }
+
+  GLint previous_framebuffer_ids[2] = {0, 0};
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer_ids[0]);
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous_framebuffer_ids[1]);
+  GLint previous_viewport[4];
+  glGetIntegerv(GL_VIEWPORT, previous_viewport);
+  const int num_waits = readback_->num_waits();
+  // The tiles smaller than the framebuffer, at the right and bottom edges of
+  // the image, are drawn into its bottom-left corner.
+  for (size_t i = 0; i < tiles_.size(); ++i) {
+    const ImageTile& tile = tiles_[i];
+    framebuffer_.Bind();
+    glViewport(0, 0, tile.width, tile.height);
+    draw(ComputeImageTileProjection(field_of_view, width, height, near, far,
+                                    tile));
+    // The draws may bind other framebuffers, e.g., of post effects.
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_.framebuffer_id());
+    readback_->ReadPixels(i);
+  }
+  readback_->Finish();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous_framebuffer_ids[0]);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previous_framebuffer_ids[1]);
+  glViewport(previous_viewport[0], previous_viewport[1],
+             previous_viewport[2], previous_viewport[3]);
+  statistics_.num_tiles = tiles_.size();
+  statistics_.num_readback_waits = readback_->num_waits() - num_waits;
+
+  image_.close();
+  if (!image_) {
+    image_.clear();
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not write " + temporary_filepath;
+    return false;
+  }
+  if (std::rename(temporary_filepath.c_str(), filepath.c_str()) != 0) {
+    std::remove(temporary_filepath.c_str());
+    *error_info_log = "Could not rename " + temporary_filepath;
+    return false;
+  }
+  return true;
+}
+
+void TiledRenderer::Reset() {
+  readback_.reset();
+  framebuffer_.Reset();
+  tile_size_ = 0;
+  tiles_.clear();
+}
+
+void TiledRenderer::WriteTile(const ReadbackFrame& frame) {
+  const ImageTile& tile = tiles_[frame.frame];
+  for (int row = 0; row < tile.height; ++row) {
+    // The rows are read back from the bottom up, and written from the top
+    // down.
+    const GLubyte* pixels = frame.pixels +
+        static_cast<size_t>(row) * frame.width * kBytesPerReadbackPixel;
+    for (int x = 0; x < tile.width; ++x) {
+      for (int c = 0; c < kBytesPerImagePixel; ++c) {
+        row_[x * kBytesPerImagePixel + c] =
+            pixels[x * kBytesPerReadbackPixel + c];
+      }
+    }
+    const uint64_t image_row = tile.y + tile.height - 1 - row;
+    image_.seekp(image_data_offset_ +
+                 (image_row * image_width_ + tile.x) * kBytesPerImagePixel);
+    image_.write(row_.data(), tile.width * kBytesPerImagePixel);
+  }
+}
+
+}  // namespace wvu
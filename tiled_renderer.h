@@ -0,0 +1,178 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_TILED_RENDERER_H_
+#define GLUTILS_TILED_RENDERER_H_
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "framebuffer_readback.h"
+#include "offscreen_framebuffer.h"
+
+namespace wvu {
+// Default width and height of the tiles of a TiledRenderer.
+constexpr int kDefaultRenderTileSize = 2048;
+
+// A tile of an image, in pixels. Row 0 of the image is the top row.
+struct ImageTile {
+  int x = 0;
+  int y = 0;
+  int width = 0;
+  int height = 0;
+};
+
+// Returns the projection of the pixels of a tile within the frustum of the
+// whole image, through the six-parameter ComputeProjectionMatrix(), so that
+// the tiles put together show the image of the whole frustum.
+// Parameters:
+//   field_of_view  The vertical field of view of the image, in radians.
+//   image_width  The width of the image in pixels.
+//   image_height  The height of the image in pixels.
+//   near  The distance to the near plane.
+//   far  The distance to the far plane.
+//   tile  The tile of the image.
+Eigen::Matrix4f ComputeImageTileProjection(const float field_of_view,
+                                           const int image_width,
+                                           const int image_height,
+                                           const float near,
+                                           const float far,
+                                           const ImageTile& tile);
+
+// Counters of the last TiledRenderer::Render().
+struct TiledRenderStatistics {
+  int num_tiles = 0;
+  // The times a tile waited for the read of an earlier tile to free its
+  // buffer.
+  int num_readback_waits = 0;
+};
+
+// This class renders images larger than the framebuffers of the GPU, e.g.,
+// 32768x32768 posters, tile by tile. Every tile is drawn into the same
+// offscreen framebuffer with an off-center frustum covering its pixels, and
+// read back asynchronously (see framebuffer_readback.h) while the next tiles
+// are drawn. The completed tiles are written straight into their rows of a
+// binary PPM (P6) file, so only the tiles in flight are held in memory,
+// whatever the size of the image. The file is written into a temporary file
+// first, which is then renamed.
+//
+// Example:
+//
+// wvu::TiledRenderer renderer;
+// if (!renderer.Initialize(wvu::kDefaultRenderTileSize, &error_info_log)) {
+//   LOG(ERROR) << error_info_log;
+// }
+// renderer.Render(32768, 32768, camera.field_of_view(), camera.near(),
+//                 camera.far(), "poster.ppm",
+//                 [&](const Eigen::Matrix4f& projection) {
+//   ...  // Clears and draws the scene with projection and camera.view().
+// }, &error_info_log);
+class TiledRenderer {
+ public:
+  // Clears and draws a tile. The framebuffer of the tile and its viewport are
+  // bound.
+  typedef std::function<void(const Eigen::Matrix4f& projection)> DrawFunction;
+
+  TiledRenderer();
+  ~TiledRenderer();
+
+  // Creates the framebuffer of the tiles and the readback buffers. The tiles
+  // are at most tile_size pixels wide and high, less if the GPU does not
+  // support framebuffers as large. Returns true if successful.
+  // Parameters:
+  //   tile_size  The width and height of the tiles in pixels.
+  //   error_info_log  A pointer to a string that holds the error log.
+  bool Initialize(const int tile_size, std::string* error_info_log);
+
+  // Renders an image of width x height pixels into a PPM file at filepath,
+  // calling draw once per tile. Restores the framebuffer bindings and the
+  // viewport. Returns true if successful.
+  // Parameters:
+  //   width  The width of the image in pixels.
+  //   height  The height of the image in pixels.
+  //   field_of_view  The vertical field of view of the image, in radians.
+  //   near  The distance to the near plane.
+  //   far  The distance to the far plane.
+  //   filepath  The path of the image.
+  //   draw  Draws the tiles.
+  //   error_info_log  A pointer to a string that holds the error log.
+  bool Render(const int width,
+              const int height,
+              const float field_of_view,
+              const float near,
+              const float far,
+              const std::string& filepath,
+              const DrawFunction& draw,
+              std::string* error_info_log);
+
+  // Deletes the framebuffer and the readback buffers.
+  void Reset();
+
+  int tile_size() const {
+    return tile_size_;
+  }
+
+  const TiledRenderStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // Writes the rows of a tile read back into the image.
+  void WriteTile(const ReadbackFrame& frame);
+
+  OffscreenFramebuffer framebuffer_;
+  // Recreated by Initialize(), since its buffers are only created once.
+  std::unique_ptr<FramebufferReadback> readback_;
+  int tile_size_;
+  // The image being rendered, and its tiles, by the number of their read.
+  std::ofstream image_;
+  uint64_t image_data_offset_;
+  int image_width_;
+  std::vector<ImageTile> tiles_;
+  std::vector<char> row_;
+  TiledRenderStatistics statistics_;
+
+  TiledRenderer(const TiledRenderer&) = delete;
+  TiledRenderer& operator=(const TiledRenderer&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_TILED_RENDERER_H_
@@ -0,0 +1,268 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_TRANSFORMS_H_
+#define GLUTILS_TRANSFORMS_H_
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace wvu {
+constexpr float kPi = 3.14159265358979323846f;
+constexpr float kHalfPi = 0.5f * kPi;
+
+namespace internal {
+// Number of terms of the Taylor series of the sine and cosine. The angles are
+// reduced to [-pi, pi], where 12 terms are exact to the float precision.
+constexpr int kNumTaylorTerms = 12;
+
+// Reduces an angle to [-pi, pi].
+constexpr float ReduceAngle(const float angle) {
+  return angle - 2.0f * kPi *
+      static_cast<float>(static_cast<long long>(
+          (angle + (angle < 0.0f ? -kPi : kPi)) / (2.0f * kPi)));
+}
+
+// Adds the terms k and higher of the series, whose k-th term is term.
+constexpr float SineSeries(const float squared_angle,
+                           const float term,
+                           const int k) {
+  return k == kNumTaylorTerms ? 0.0f :
+      term + SineSeries(squared_angle,
+                        -term * squared_angle / ((2 * k + 2) * (2 * k + 3)),
+                        k + 1);
+}
+
+constexpr float CosineSeries(const float squared_angle,
+                             const float term,
+                             const int k) {
+  return k == kNumTaylorTerms ? 0.0f :
+      term + CosineSeries(squared_angle,
+                          -term * squared_angle / ((2 * k + 1) * (2 * k + 2)),
+                          k + 1);
+}
+
+constexpr float ReducedSine(const float angle) {
+  return SineSeries(angle * angle, angle, 0);
+}
+
+constexpr float ReducedCosine(const float angle) {
+  return CosineSeries(angle * angle, 1.0f, 0);
+}
+
+}  // namespace internal
+
+// Sine and cosine that can be evaluated at compile time, e.g., for the
+// projection of a camera with a constant field of view. At run time they are
+// slower than std::sin() and std::cos().
+constexpr float ConstexprSine(const float angle) {
+  return internal::ReducedSine(internal::ReduceAngle(angle));
+}
+
+constexpr float ConstexprCosine(const float angle) {
+  return internal::ReducedCosine(internal::ReduceAngle(angle));
+}
+
+// Computes the cotangent of an angle in radians. C++ does not provide the
+// cotangent, and the tangent is not constexpr, so it is the ratio of the cosine
+// and the sine.
+constexpr float ComputeCotangent(const float angle) {
+  return ConstexprCosine(angle) / ConstexprSine(angle);
+}
+
+// The non-zero entries of a perspective projection matrix:
+//   | x_scale  0        0        0        |
+//   | 0        y_scale  0        0        |
+//   | 0        0        z_scale  z_offset |
+//   | 0        0        -1       0        |
+// The entries are computed by constexpr functions, so the projections of
+// constant cameras fold into constants.
+struct PerspectiveProjection {
+  float x_scale;
+  float y_scale;
+  float z_scale;
+  float z_offset;
+};
+
+// Computes the OpenGL perspective projection, which maps the depths between
+// the near and far planes to [-1, 1].
+// Parameters:
+//   field_of_view  The vertical field of view in radians.
+//   aspect_ratio  The width of the viewport divided by its height.
+//   near  The distance to the near plane.
+//   far  The distance to the far plane.
+constexpr PerspectiveProjection ComputePerspectiveProjection(
+    const float field_of_view,
+    const float aspect_ratio,
+    const float near,
+    const float far) {
+  return PerspectiveProjection{
+    ComputeCotangent(0.5f * field_of_view) / aspect_ratio,
+    ComputeCotangent(0.5f * field_of_view),
+    -(far + near) / (far - near),
+    -2.0f * far * near / (far - near)};
+}
+
+// Computes the limit of the perspective projection when the far plane goes to
+// infinity, so no geometry is clipped by distance.
+constexpr PerspectiveProjection ComputeInfinitePerspectiveProjection(
+    const float field_of_view,
+    const float aspect_ratio,
+    const float near) {
+  return PerspectiveProjection{
+    ComputeCotangent(0.5f * field_of_view) / aspect_ratio,
+    ComputeCotangent(0.5f * field_of_view),
+    -1.0f,
+    -2.0f * near};
+}
+
+// Reversed-Z projections map the near plane to depth 1 and the far plane to
+// depth 0. The precision of floating-point depth buffers is highest near 0,
+// which compensates the 1/z distribution of the depths, so the precision is
+// almost uniform in distance. They require clip-space depths in [0, 1]
+// (glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE), OpenGL 4.5 or
+// ARB_clip_control), a GL_DEPTH_COMPONENT32F depth buffer, glClearDepth(0.0)
+// and glDepthFunc(GL_GREATER).
+constexpr PerspectiveProjection ComputeReversedZPerspectiveProjection(
+    const float field_of_view,
+    const float aspect_ratio,
+    const float near,
+    const float far) {
+  return PerspectiveProjection{
+    ComputeCotangent(0.5f * field_of_view) / aspect_ratio,
+    ComputeCotangent(0.5f * field_of_view),
+    near / (far - near),
+    far * near / (far - near)};
+}
+
+// Reversed-Z projection with the far plane at infinity. The depth is
+// near / distance, which never reaches 0.
+constexpr PerspectiveProjection ComputeReversedZInfinitePerspectiveProjection(
+    const float field_of_view,
+    const float aspect_ratio,
+    const float near) {
+  return PerspectiveProjection{
+    ComputeCotangent(0.5f * field_of_view) / aspect_ratio,
+    ComputeCotangent(0.5f * field_of_view),
+    0.0f,
+    near};
+}
+
+// Returns the matrix of a perspective projection.
+inline Eigen::Matrix4f ToMatrix(const PerspectiveProjection& projection) {
+  Eigen::Matrix4f projection_matrix;
+  projection_matrix << projection.x_scale, 0.0f, 0.0f, 0.0f,
+      0.0f, projection.y_scale, 0.0f, 0.0f,
+      0.0f, 0.0f, projection.z_scale, projection.z_offset,
+      0.0f, 0.0f, -1.0f, 0.0f;
+  return projection_matrix;
+}
+
+// Computes the OpenGL projection matrix of a frustum, given the planes at the
+// near plane.
+inline Eigen::Matrix4f ComputeProjectionMatrix(const float left,
+                                               const float right,
+                                               const float top,
+                                               const float bottom,
+                                               const float near,
+                                               const float far) {
+  Eigen::Matrix4f projection = Eigen::Matrix4f::Zero();
+  projection(0, 0) = 2.0f * near / (right - left);
+  projection(1, 1) = 2.0f * near / (top - bottom);
+  projection(2, 2) = -(far + near) / (far - near);
+  projection(0, 2) = (right + left) / (right - left);
+  projection(1, 2) = (top + bottom) / (top - bottom);
+  projection(2, 3) = -2.0f * far * near / (far - near);
+  projection(3, 2) = -1.0f;
+  return projection;
+}
+
+// Computes the OpenGL projection matrix of a symmetric frustum. See
+// ComputePerspectiveProjection().
+inline Eigen::Matrix4f ComputeProjectionMatrix(const float field_of_view,
+                                               const float aspect_ratio,
+                                               const float near,
+                                               const float far) {
+  return ToMatrix(
+      ComputePerspectiveProjection(field_of_view, aspect_ratio, near, far));
+}
+
+// The planes of a frustum, one per row as (a, b, c, d), in the order left,
+// right, bottom, top, near and far. A point p is inside the frustum when
+// plane.dot(p.homogeneous()) >= 0 for all the planes.
+typedef Eigen::Matrix<float, 6, 4> FrustumPlanes;
+
+// Extracts the planes of the frustum of a matrix mapping to clip space, e.g.,
+// the projection * view matrix of a camera (Gribb and Hartmann). The normals of
+// the planes are normalized, so the planes give the signed distance of a point
+// to them, as testing spheres needs.
+inline FrustumPlanes ExtractFrustumPlanes(const Eigen::Matrix4f& clip_matrix) {
+  FrustumPlanes planes;
+  for (int i = 0; i < 3; ++i) {
+    planes.row(2 * i) = clip_matrix.row(3) + clip_matrix.row(i);
+    planes.row(2 * i + 1) = clip_matrix.row(3) - clip_matrix.row(i);
+  }
+  for (int i = 0; i < 6; ++i) {
+    planes.row(i) /= planes.row(i).head<3>().norm();
+  }
+  return planes;
+}
+
+// Computes the matrix translating by offset.
+inline Eigen::Matrix4f ComputeTranslation(const Eigen::Vector3f& offset) {
+  Eigen::Matrix4f transformation = Eigen::Matrix4f::Identity();
+  transformation.col(3) = offset.homogeneous();
+  return transformation;
+}
+
+// Computes the matrix rotating by angle radians around a unit axis.
+inline Eigen::Matrix4f ComputeRotation(const Eigen::Vector3f& axis,
+                                       const float angle) {
+  Eigen::Matrix4f transformation = Eigen::Matrix4f::Identity();
+  transformation.block<3, 3>(0, 0) =
+      Eigen::AngleAxisf(angle, axis).toRotationMatrix();
+  return transformation;
+}
+
+// Computes the matrix of the rotation of a unit quaternion. Unlike the
+// angle-axis overload, it does not evaluate sines and cosines.
+inline Eigen::Matrix4f ComputeRotation(const Eigen::Quaternionf& rotation) {
+  Eigen::Matrix4f transformation = Eigen::Matrix4f::Identity();
+  transformation.block<3, 3>(0, 0) = rotation.toRotationMatrix();
+  return transformation;
+}
+
+}  // namespace wvu
+
+#endif  // GLUTILS_TRANSFORMS_H_
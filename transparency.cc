@@ -0,0 +1,233 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "transparency.h"
+
+#include <string>
+#include <GL/glew.h>
+
+#include "gl_state_cache.h"
+#include "shader_program.h"
+
+namespace wvu {
+namespace {
+// Covers the viewport with a single triangle, from gl_VertexID alone.
+const char kCompositeVertexShader[] =
+    "#version 330 core\n"
+    "void main() {\n"
+    "  vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+    "  gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+// The weighted average of the colors, blended over the scene by the
+// revealage.
+const char kCompositeFragmentShader[] =
+    "#version 330 core\n"
+    "uniform sampler2D accumulation;\n"
+    "uniform sampler2D weights;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "  ivec2 texel = ivec2(gl_FragCoord.xy);\n"
+    "  vec4 sum = texelFetch(accumulation, texel, 0);\n"
+    "  // Nothing transparent covers the pixel.\n"
+    "  if (sum.a >= 1.0) discard;\n"
+    "  float weight = texelFetch(weights, texel, 0).r;\n"
+    "  color = vec4(sum.rgb / clamp(weight, 1e-4, 5e4), sum.a);\n"
+    "}\n";
+
+}  // namespace
+
+WeightedBlendedTransparency::WeightedBlendedTransparency()
+    : framebuffer_id_(0),
+      accumulation_texture_id_(0),
+      weight_texture_id_(0),
+      depth_renderbuffer_id_(0),
+      vertex_array_id_(0),
+      width_(0),
+      height_(0) {}
+
+WeightedBlendedTransparency::~WeightedBlendedTransparency() {
+  Reset();
+}
+
+bool WeightedBlendedTransparency::Initialize(const int width,
+                                             const int height,
+                                             std::string* error_info_log) {
+  ResetTargets();
+  if (width <= 0 || height <= 0) {
+    *error_info_log = "Invalid transparency target size " +
+        std::to_string(width) + "x" + std::to_string(height) + ".";
+    return false;
+  }
+  if (composite_program_.shader_program_id() == 0) {
+    composite_program_.LoadVertexShaderFromString(kCompositeVertexShader);
+    composite_program_.LoadFragmentShaderFromString(kCompositeFragmentShader);
+    if (!composite_program_.Create(error_info_log)) return false;
+    composite_program_.Use();
+    composite_program_.SetUniform("accumulation", static_cast<GLint>(0));
+    composite_program_.SetUniform("weights", static_cast<GLint>(1));
+  }
+  width_ = width;
+  height_ = height;
+  const auto create_target = [this](const GLenum internal_format,
+                                    const GLenum format) {
+    GLuint texture_id = 0;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width_, height_, 0,
+                 format, GL_HALF_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return texture_id;
+  };
+  accumulation_texture_id_ = create_target(GL_RGBA16F, GL_RGBA);
+  weight_texture_id_ = create_target(GL_R16F, GL_RED);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glGenRenderbuffers(1, &depth_renderbuffer_id_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_id_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width_, height_);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer_id_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         accumulation_texture_id_, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                         weight_texture_id_, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_renderbuffer_id_);
+  const GLenum draw_buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(2, draw_buffers);
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (vertex_array_id_ == 0) glGenVertexArrays(1, &vertex_array_id_);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    *error_info_log = "The transparency framebuffer is incomplete: status " +
+        std::to_string(status) + ".";
+    ResetTargets();
+    return false;
+  }
+  return true;
+}
+
+void WeightedBlendedTransparency::Begin(const GLuint scene_framebuffer_id) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, scene_framebuffer_id);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_id_);
+  glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_,
+                    GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+  glViewport(0, 0, width_, height_);
+  // No color, full revealage, and no weights.
+  gl_state->ColorMask(true);
+  const GLfloat accumulation_clear[] = {0.0f, 0.0f, 0.0f, 1.0f};
+  const GLfloat weight_clear[] = {0.0f, 0.0f, 0.0f, 0.0f};
+  glClearBufferfv(GL_COLOR, 0, accumulation_clear);
+  glClearBufferfv(GL_COLOR, 1, weight_clear);
+  gl_state->SetCapability(GL_DEPTH_TEST, true);
+  gl_state->DepthMask(false);
+  gl_state->DepthFunc(GL_LESS);
+  gl_state->SetCapability(GL_CULL_FACE, false);
+  // The colors and the weights add up, and the alpha of the accumulation
+  // multiplies the transmittances.
+  gl_state->SetCapability(GL_BLEND, true);
+  gl_state->BlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO,
+                              GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void WeightedBlendedTransparency::Composite(
+    const GLuint scene_framebuffer_id) {
+  GlStateCache* gl_state = GlStateCache::Current();
+  glBindFramebuffer(GL_FRAMEBUFFER, scene_framebuffer_id);
+  glViewport(0, 0, width_, height_);
+  gl_state->SetCapability(GL_DEPTH_TEST, false);
+  // The scene keeps the revealage of its color.
+  gl_state->BlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+  composite_program_.Use();
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, weight_texture_id_);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, accumulation_texture_id_);
+  gl_state->BindVertexArray(vertex_array_id_);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  gl_state->SetCapability(GL_BLEND, false);
+  gl_state->SetCapability(GL_DEPTH_TEST, true);
+  gl_state->DepthMask(true);
+}
+
+void WeightedBlendedTransparency::ResetTargets() {
+  if (framebuffer_id_ != 0) glDeleteFramebuffers(1, &framebuffer_id_);
+  if (accumulation_texture_id_ != 0) {
+    glDeleteTextures(1, &accumulation_texture_id_);
+  }
+  if (weight_texture_id_ != 0) glDeleteTextures(1, &weight_texture_id_);
+  if (depth_renderbuffer_id_ != 0) {
+    glDeleteRenderbuffers(1, &depth_renderbuffer_id_);
+  }
+  framebuffer_id_ = 0;
+  accumulation_texture_id_ = 0;
+  weight_texture_id_ = 0;
+  depth_renderbuffer_id_ = 0;
+  width_ = 0;
+  height_ = 0;
+}
+
+void WeightedBlendedTransparency::Reset() {
+  ResetTargets();
+  if (vertex_array_id_ != 0) {
+    GlStateCache::Current()->DeleteVertexArrays(1, &vertex_array_id_);
+  }
+  vertex_array_id_ = 0;
+}
+
+std::string WeightedBlendedTransparency::GlslDeclaration() {
+  // The weight of equation (10) of the paper, with the window depth.
+  return
+      "layout (location = 0) out vec4 transparency_accumulation;\n"
+      "layout (location = 1) out vec4 transparency_weight;\n"
+      "void WriteTransparentFragment(vec4 color) {\n"
+      "  float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) *\n"
+      "                       1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0),\n"
+      "                       1e-2, 3e3);\n"
+      "  transparency_accumulation =\n"
+      "      vec4(color.rgb * color.a * weight, color.a);\n"
+      "  transparency_weight = vec4(color.a * weight);\n"
+      "}\n";
+}
+
+}  // namespace wvu
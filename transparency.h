@@ -0,0 +1,148 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_TRANSPARENCY_H_
+#define GLUTILS_TRANSPARENCY_H_
+
+#include <string>
+#include <GL/glew.h>
+
+#include "shader_program.h"
+
+namespace wvu {
+// This class draws transparent surfaces in any order with weighted blended
+// order-independent transparency (McGuire and Bavoil, 2013), so the
+// transparent instances of a scene need no back-to-front sort every frame. The
+// transparent fragments are blended into two targets: the sum of their
+// premultiplied colors and the product of their transmittances (the
+// revealage) in a GL_RGBA16F texture, and the sum of their alphas in a
+// GL_R16F texture, each fragment weighted by its alpha and its depth so that
+// the nearest opaque-looking layers dominate. One blend function covers both
+// targets, so no per-target blending (OpenGL 4.0) is needed. The composite
+// pass then blends the weighted average color over the opaque scene by the
+// revealage. The result approximates the sorted blend: it is exact for
+// layers of the same color, and close for the few layers of a pixel that
+// matter.
+//
+// The transparent pass tests the depths of the opaque scene, copied into its
+// own depth buffer, without writing them.
+//
+// The fragment shaders of the transparent surfaces include GlslDeclaration(),
+// which declares the outputs of the pass and:
+//
+//   // Writes a fragment of a (not premultiplied) color and an alpha.
+//   void WriteTransparentFragment(vec4 color);
+//
+// Example:
+//
+// wvu::WeightedBlendedTransparency transparency;
+// transparency.Initialize(width, height, &error_info_log);
+// while (...) {  // Rendering loop.
+//   ...  // Draw the opaque scene into scene framebuffer.
+//   transparency.Begin(scene_framebuffer_id);
+//   transparent_queue.Execute();  // Sorted by state only.
+//   transparency.Composite(scene_framebuffer_id);
+// }
+class WeightedBlendedTransparency {
+ public:
+  WeightedBlendedTransparency();
+  ~WeightedBlendedTransparency();
+
+  // Creates the targets, and compiles the composite program. The targets are
+  // created again with the new size after a resize. Returns true if
+  // successful.
+  // Parameters:
+  //   width  The width of the scene framebuffer in pixels.
+  //   height  The height of the scene framebuffer in pixels.
+  //   error_info_log  The reason of the failure.
+  bool Initialize(const int width,
+                  const int height,
+                  std::string* error_info_log);
+
+  // Starts the transparent pass: copies the depths of the scene framebuffer,
+  // which must have the size of the targets and a GL_DEPTH24_STENCIL8 depth
+  // buffer (as the default framebuffer of GLFW and OffscreenFramebuffer do),
+  // clears the targets and binds them. Leaves the depth test on without depth
+  // writes, the culling off and the blending of the pass on.
+  void Begin(const GLuint scene_framebuffer_id);
+
+  // Blends the transparent surfaces over the scene framebuffer, and leaves it
+  // bound with the blending off and the depth writes on.
+  void Composite(const GLuint scene_framebuffer_id);
+
+  // Deletes the targets and the framebuffer.
+  void Reset();
+
+  // Returns the GLSL declaration of the outputs of the transparent fragment
+  // shaders, and of WriteTransparentFragment().
+  static std::string GlslDeclaration();
+
+  int width() const {
+    return width_;
+  }
+
+  int height() const {
+    return height_;
+  }
+
+  GLuint accumulation_texture_id() const {
+    return accumulation_texture_id_;
+  }
+
+  GLuint weight_texture_id() const {
+    return weight_texture_id_;
+  }
+
+ private:
+  // Deletes the OpenGL objects of the targets.
+  void ResetTargets();
+
+  ShaderProgram composite_program_;
+  GLuint framebuffer_id_;
+  GLuint accumulation_texture_id_;
+  GLuint weight_texture_id_;
+  GLuint depth_renderbuffer_id_;
+  // The empty vertex array of the full-screen triangle of the composite.
+  GLuint vertex_array_id_;
+  int width_;
+  int height_;
+
+  WeightedBlendedTransparency(const WeightedBlendedTransparency&) = delete;
+  WeightedBlendedTransparency& operator=(const WeightedBlendedTransparency&) =
+      delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_TRANSPARENCY_H_
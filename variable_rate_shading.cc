@@ -0,0 +1,268 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "variable_rate_shading.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+namespace {
+// The palette of the shading rate image, in the order of ShadingRate.
+constexpr GLenum kShadingRatePalette[NUM_SHADING_RATES] = {
+  GL_SHADING_RATE_1_INVOCATION_PER_PIXEL_NV,
+  GL_SHADING_RATE_1_INVOCATION_PER_2X1_PIXELS_NV,
+  GL_SHADING_RATE_1_INVOCATION_PER_1X2_PIXELS_NV,
+  GL_SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV,
+  GL_SHADING_RATE_1_INVOCATION_PER_4X2_PIXELS_NV,
+  GL_SHADING_RATE_1_INVOCATION_PER_2X4_PIXELS_NV,
+  GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV
+};
+// The pixels shaded by an invocation of each rate.
+constexpr int kPixelsPerInvocation[NUM_SHADING_RATES] = {1, 2, 2, 4, 8, 8, 16};
+// Speeds of the image, in pixels per frame, above which the motion blur hides
+// the detail lost by shading blocks of 2x2 and 4x4 pixels.
+constexpr float kMotionSpeed2x2 = 8.0f;
+constexpr float kMotionSpeed4x4 = 24.0f;
+
+// Returns the coarsest of two rates.
+ShadingRate CoarsestRate(const ShadingRate a, const ShadingRate b) {
+  return std::max(a, b);
+}
+
+}  // namespace
+
+VariableRateShading::VariableRateShading()
+    : texture_id_(0), width_(0), height_(0), tile_width_(0), tile_height_(0),
+      num_columns_(0), num_rows_(0), center_x_(0.5f), center_y_(0.5f),
+      inner_radius_(kDefaultShadingRateInnerRadius),
+      outer_radius_(kDefaultShadingRateOuterRadius),
+      motion_pixels_per_frame_(0.0f) {}
+
+VariableRateShading::~VariableRateShading() {
+  Reset();
+}
+
+bool VariableRateShading::Supported() {
+  return GLEW_NV_shading_rate_image;
+}
+
+bool VariableRateShading::Initialize(const int width,
+                                     const int height,
+                                     std::string* error_info_log) {
+  if (!Supported()) {
+    *error_info_log = "NV_shading_rate_image is not supported.";
+    return false;
+  }
+  Reset();
+  GLint tile_width = 0;
+  GLint tile_height = 0;
+  glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_WIDTH_NV, &tile_width);
+  glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV, &tile_height);
+  if (tile_width <= 0 || tile_height <= 0) {
+    *error_info_log = "Invalid shading rate image tiles.";
+    return false;
+  }
+  tile_width_ = tile_width;
+  tile_height_ = tile_height;
+  // Every viewport has its own palette, and the split views draw into many.
+  GLint num_viewports = 1;
+  glGetIntegerv(GL_MAX_VIEWPORTS, &num_viewports);
+  for (int viewport = 0; viewport < num_viewports; ++viewport) {
+    glShadingRateImagePaletteNV(viewport, 0, NUM_SHADING_RATES,
+                                kShadingRatePalette);
+  }
+  return Resize(width, height, error_info_log);
+}
+
+bool VariableRateShading::Resize(const int width,
+                                 const int height,
+                                 std::string* error_info_log) {
+  if (width <= 0 || height <= 0) {
+    *error_info_log = "Invalid framebuffer of " + std::to_string(width) +
+        "x" + std::to_string(height) + " pixels.";
+    return false;
+  }
+  if (tile_width_ == 0) {
+    *error_info_log = "The shading rate image is not initialized.";
+    return false;
+  }
+  if (texture_id_ != 0 && width == width_ && height == height_) return true;
+  if (texture_id_ != 0) glDeleteTextures(1, &texture_id_);
+  width_ = width;
+  height_ = height;
+  num_columns_ = (width + tile_width_ - 1) / tile_width_;
+  num_rows_ = (height + tile_height_ - 1) / tile_height_;
+  glGenTextures(1, &texture_id_);
+  glBindTexture(GL_TEXTURE_2D, texture_id_);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, num_columns_, num_rows_);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  // The new texture has no rates yet.
+  rates_.assign(num_columns_ * num_rows_, SHADING_RATE_1X1);
+  uploaded_rates_.clear();
+  regions_.clear();
+  return true;
+}
+
+void VariableRateShading::SetPeriphery(const float center_x,
+                                       const float center_y,
+                                       const float inner_radius,
+                                       const float outer_radius) {
+  center_x_ = center_x;
+  center_y_ = center_y;
+  inner_radius_ = std::max(inner_radius, 0.0f);
+  outer_radius_ = std::max(outer_radius, inner_radius_);
+}
+
+void VariableRateShading::AddRegion(const int x,
+                                    const int y,
+                                    const int width,
+                                    const int height,
+                                    const ShadingRate rate) {
+  if (tile_width_ == 0 || width <= 0 || height <= 0) return;
+  // The tiles partially covered keep their rate, since their other pixels may
+  // be visible. The tiles past the framebuffer are not.
+  Region region;
+  region.first_column = std::max((x + tile_width_ - 1) / tile_width_, 0);
+  region.first_row = std::max((y + tile_height_ - 1) / tile_height_, 0);
+  region.end_column = x + width >= width_ ? num_columns_ :
+      std::min((x + width) / tile_width_, num_columns_);
+  region.end_row = y + height >= height_ ? num_rows_ :
+      std::min((y + height) / tile_height_, num_rows_);
+  region.rate = rate;
+  if (region.first_column < region.end_column &&
+      region.first_row < region.end_row) {
+    regions_.push_back(region);
+  }
+}
+
+void VariableRateShading::Update() {
+  if (texture_id_ == 0) return;
+  const int num_uploads = statistics_.num_uploads;
+  statistics_ = VariableRateShadingStatistics();
+  statistics_.num_uploads = num_uploads;
+
+  ShadingRate motion_rate = SHADING_RATE_1X1;
+  if (motion_pixels_per_frame_ >= kMotionSpeed4x4) {
+    motion_rate = SHADING_RATE_4X4;
+  } else if (motion_pixels_per_frame_ >= kMotionSpeed2x2) {
+    motion_rate = SHADING_RATE_2X2;
+  }
+  const float center_x = center_x_ * width_;
+  const float center_y = center_y_ * height_;
+  const float half_diagonal = 0.5f * std::hypot(static_cast<float>(width_),
+                                                static_cast<float>(height_));
+  for (int row = 0; row < num_rows_; ++row) {
+    for (int column = 0; column < num_columns_; ++column) {
+      ShadingRate rate = motion_rate;
+      if (outer_radius_ > 0.0f) {
+        // The distance of the point of the tile nearest to the center, so
+        // that the tiles touching the inner circle shade every pixel.
+        const float left = static_cast<float>(column * tile_width_);
+        const float bottom = static_cast<float>(row * tile_height_);
+        const float x =
+            std::min(std::max(center_x, left), left + tile_width_);
+        const float y =
+            std::min(std::max(center_y, bottom), bottom + tile_height_);
+        const float distance =
+            std::hypot(x - center_x, y - center_y) / half_diagonal;
+        if (distance > outer_radius_) {
+          rate = SHADING_RATE_4X4;
+        } else if (distance > inner_radius_) {
+          rate = CoarsestRate(rate, SHADING_RATE_2X2);
+        }
+      }
+      rates_[row * num_columns_ + column] = rate;
+    }
+  }
+  for (const Region& region : regions_) {
+    for (int row = region.first_row; row < region.end_row; ++row) {
+      for (int column = region.first_column; column < region.end_column;
+           ++column) {
+        GLubyte& rate = rates_[row * num_columns_ + column];
+        rate = CoarsestRate(static_cast<ShadingRate>(rate), region.rate);
+      }
+    }
+  }
+
+  statistics_.num_tiles = rates_.size();
+  float invocations = 0.0f;
+  for (const GLubyte rate : rates_) {
+    ++statistics_.num_tiles_per_rate[rate];
+    invocations += 1.0f / kPixelsPerInvocation[rate];
+  }
+  statistics_.invocations_per_pixel = invocations / statistics_.num_tiles;
+
+  if (rates_ == uploaded_rates_) return;
+  glBindTexture(GL_TEXTURE_2D, texture_id_);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, num_columns_, num_rows_,
+                  GL_RED_INTEGER, GL_UNSIGNED_BYTE, rates_.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  uploaded_rates_ = rates_;
+  ++statistics_.num_uploads;
+}
+
+void VariableRateShading::Enable() const {
+  if (texture_id_ == 0) return;
+  glBindShadingRateImageNV(texture_id_);
+  glEnable(GL_SHADING_RATE_IMAGE_NV);
+}
+
+void VariableRateShading::Disable() const {
+  if (texture_id_ == 0) return;
+  glDisable(GL_SHADING_RATE_IMAGE_NV);
+  glBindShadingRateImageNV(0);
+}
+
+void VariableRateShading::Reset() {
+  if (texture_id_ != 0) {
+    glDeleteTextures(1, &texture_id_);
+    texture_id_ = 0;
+  }
+  width_ = 0;
+  height_ = 0;
+  num_columns_ = 0;
+  num_rows_ = 0;
+  regions_.clear();
+  rates_.clear();
+  uploaded_rates_.clear();
+  statistics_ = VariableRateShadingStatistics();
+}
+
+}  // namespace wvu
@@ -0,0 +1,223 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_VARIABLE_RATE_SHADING_H_
+#define GLUTILS_VARIABLE_RATE_SHADING_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+namespace wvu {
+// The shading rates of the tiles of the framebuffer, from the finest to the
+// coarsest: the fragment shader runs once per block of the given pixels.
+enum ShadingRate {
+  SHADING_RATE_1X1 = 0,
+  SHADING_RATE_2X1 = 1,
+  SHADING_RATE_1X2 = 2,
+  SHADING_RATE_2X2 = 3,
+  SHADING_RATE_4X2 = 4,
+  SHADING_RATE_2X4 = 5,
+  SHADING_RATE_4X4 = 6,
+  NUM_SHADING_RATES = 7
+};
+
+// Default radii of the periphery, in fractions of the half diagonal of the
+// framebuffer from the center of attention: the tiles within the inner radius
+// shade every pixel, the tiles between the radii shade blocks of 2x2 pixels,
+// and the tiles beyond the outer radius blocks of 4x4 pixels.
+constexpr float kDefaultShadingRateInnerRadius = 0.5f;
+constexpr float kDefaultShadingRateOuterRadius = 0.8f;
+
+// Counters of the last VariableRateShading::Update().
+struct VariableRateShadingStatistics {
+  int num_tiles = 0;
+  // Number of tiles of each rate.
+  int num_tiles_per_rate[NUM_SHADING_RATES] = {};
+  // Fragment shader invocations per pixel of the framebuffer, e.g., 0.25 if
+  // every tile shades blocks of 2x2 pixels.
+  float invocations_per_pixel = 1.0f;
+  // Number of uploads of the shading rate image, which changes only when the
+  // rates of its tiles change.
+  int num_uploads = 0;
+};
+
+// This class shades the low-importance regions of the framebuffer at coarser
+// rates with NV_shading_rate_image, which reads the rate of each tile of the
+// framebuffer, typically of 16x16 pixels, from an R8UI texture of palette
+// indices. The palette lists the ShadingRate values in order, so the texels
+// are the rates themselves. The rate of a tile is the coarsest of:
+//   - The periphery: the rate grows with the distance of the tile from the
+//     center of attention, where the eyes of the viewer most likely are.
+//   - The motion: the renderer reports how fast the image moves, in pixels per
+//     frame, and fast motion, blurred on screen, coarsens the whole
+//     framebuffer.
+//   - The regions: rectangles with a rate, e.g., the tiles covered by an
+//     overlay. Only the tiles fully inside a region take its rate.
+// The image is rebuilt on the CPU at every Update(), which takes a few
+// microseconds even at 4K (240x135 tiles), and uploaded only when it changes.
+//
+// The coarse rates only cut the cost of the fragment shaders, so they help
+// the fill-rate-bound passes, e.g., the scene drawn at 4K; the passes reading
+// every pixel, e.g., the post-processing, or drawing text should run with the
+// shading rate image disabled.
+//
+// Example:
+//
+// wvu::VariableRateShading variable_rate_shading;
+// if (!variable_rate_shading.Initialize(width, height, &error_info_log)) {
+//   ...
+// }
+// while (...) {  // Rendering loop.
+//   variable_rate_shading.SetMotion(camera_motion_pixels);
+//   variable_rate_shading.ClearRegions();
+//   variable_rate_shading.AddRegion(0, height - 120, 256, 120,
+//                                   wvu::SHADING_RATE_4X4);  // Overlay.
+//   variable_rate_shading.Update();
+//   variable_rate_shading.Enable();
+//   RenderScene(...);
+//   variable_rate_shading.Disable();
+//   ...  // Post-processing, overlay.
+// }
+class VariableRateShading {
+ public:
+  VariableRateShading();
+  ~VariableRateShading();
+
+  // Returns true if NV_shading_rate_image is supported.
+  static bool Supported();
+
+  // Creates the shading rate image of a framebuffer, and sets the palette of
+  // the rates. The context must be current. Returns true if successful.
+  bool Initialize(const int width,
+                  const int height,
+                  std::string* error_info_log);
+
+  // Recreates the shading rate image for a new framebuffer size, if it
+  // changed. Returns true if successful.
+  bool Resize(const int width,
+              const int height,
+              std::string* error_info_log);
+
+  // Sets the center of attention, in fractions of the framebuffer from its
+  // lower-left corner, and the radii of the periphery. An outer radius of 0
+  // turns the periphery off.
+  void SetPeriphery(const float center_x,
+                    const float center_y,
+                    const float inner_radius,
+                    const float outer_radius);
+
+  // Sets the speed of the image, in pixels per frame.
+  void SetMotion(const float pixels_per_frame) {
+    motion_pixels_per_frame_ = pixels_per_frame;
+  }
+
+  // Sets the rate of the tiles inside a rectangle of the framebuffer, in
+  // pixels from its lower-left corner, until ClearRegions().
+  void AddRegion(const int x,
+                 const int y,
+                 const int width,
+                 const int height,
+                 const ShadingRate rate);
+
+  void ClearRegions() {
+    regions_.clear();
+  }
+
+  // Computes the rate of every tile, and uploads the shading rate image if it
+  // changed.
+  void Update();
+
+  // Binds the shading rate image, and enables it for the next draws.
+  void Enable() const;
+
+  // Disables the shading rate image: the next draws shade every pixel.
+  void Disable() const;
+
+  // Deletes the shading rate image.
+  void Reset();
+
+  // Returns the rates of the tiles of the last Update(), row by row from the
+  // lower-left tile.
+  const std::vector<GLubyte>& rates() const {
+    return rates_;
+  }
+
+  int tile_width() const {
+    return tile_width_;
+  }
+
+  int tile_height() const {
+    return tile_height_;
+  }
+
+  const VariableRateShadingStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // A rectangle of tiles with a rate.
+  struct Region {
+    int first_column;
+    int first_row;
+    int end_column;
+    int end_row;
+    ShadingRate rate;
+  };
+
+  GLuint texture_id_;
+  int width_;
+  int height_;
+  int tile_width_;
+  int tile_height_;
+  int num_columns_;
+  int num_rows_;
+  float center_x_;
+  float center_y_;
+  float inner_radius_;
+  float outer_radius_;
+  float motion_pixels_per_frame_;
+  std::vector<Region> regions_;
+  // The rates of the tiles, and the ones uploaded into the texture.
+  std::vector<GLubyte> rates_;
+  std::vector<GLubyte> uploaded_rates_;
+  VariableRateShadingStatistics statistics_;
+
+  VariableRateShading(const VariableRateShading&) = delete;
+  VariableRateShading& operator=(const VariableRateShading&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_VARIABLE_RATE_SHADING_H_
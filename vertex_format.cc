@@ -0,0 +1,203 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <GL/glew.h>
+
+namespace wvu {
+
+GLsizei VertexComponentSize(const GLenum type) {
+  switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+      return 1;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+      return 2;
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+GLsizei VertexAttributeSize(const GLenum type, const GLint num_components) {
+  if (type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV) {
+    return num_components == 4 ? 4 : 0;
+  }
+  return num_components * VertexComponentSize(type);
+}
+
+bool VertexLayout::AddAttribute(const VertexSemantic semantic,
+                                const GLint num_components,
+                                const GLenum type,
+                                const GLboolean normalized,
+                                const GLuint offset) {
+  if (num_attributes_ == kMaxNumVertexAttributes ||
+      FindAttribute(semantic) != nullptr) {
+    return false;
+  }
+  if (num_components < 1 || num_components > 4) {
+    return false;
+  }
+  const GLsizei attribute_size = VertexAttributeSize(type, num_components);
+  if (attribute_size == 0 ||
+      offset + attribute_size > static_cast<GLuint>(stride_)) {
+    return false;
+  }
+  VertexAttribute& attribute = attributes_[num_attributes_++];
+  attribute.semantic = semantic;
+  attribute.num_components = num_components;
+  attribute.type = type;
+  attribute.normalized = normalized;
+  attribute.offset = offset;
+  return true;
+}
+
+const VertexAttribute* VertexLayout::FindAttribute(
+    const VertexSemantic semantic) const {
+  for (int i = 0; i < num_attributes_; ++i) {
+    if (attributes_[i].semantic == semantic) {
+      return &attributes_[i];
+    }
+  }
+  return nullptr;
+}
+
+void VertexLayout::SetAttributePointers() const {
+  for (int i = 0; i < num_attributes_; ++i) {
+    const VertexAttribute& attribute = attributes_[i];
+    // OpenGL expects the offset into the bound buffer as a pointer.
+    const GLvoid* offset_ptr = reinterpret_cast<const GLvoid*>(
+        static_cast<uintptr_t>(attribute.offset));
+    glVertexAttribPointer(attribute.semantic, attribute.num_components,
+                          attribute.type, attribute.normalized, stride_,
+                          offset_ptr);
+    glEnableVertexAttribArray(attribute.semantic);
+  }
+}
+
+void VertexLayout::SetVertexArrayFormat(const GLuint vertex_array_object_id,
+                                        const GLuint binding_index) const {
+  for (int i = 0; i < num_attributes_; ++i) {
+    const VertexAttribute& attribute = attributes_[i];
+    glVertexArrayAttribFormat(vertex_array_object_id, attribute.semantic,
+                              attribute.num_components, attribute.type,
+                              attribute.normalized, attribute.offset);
+    glVertexArrayAttribBinding(vertex_array_object_id, attribute.semantic,
+                               binding_index);
+    glEnableVertexArrayAttrib(vertex_array_object_id, attribute.semantic);
+  }
+}
+
+bool VertexLayout::operator==(const VertexLayout& other) const {
+  if (stride_ != other.stride_ || num_attributes_ != other.num_attributes_) {
+    return false;
+  }
+  for (int i = 0; i < num_attributes_; ++i) {
+    const VertexAttribute& a = attributes_[i];
+    const VertexAttribute& b = other.attributes_[i];
+    if (a.semantic != b.semantic || a.num_components != b.num_components ||
+        a.type != b.type || a.normalized != b.normalized ||
+        a.offset != b.offset) {
+      return false;
+    }
+  }
+  return true;
+}
+
+VertexLayout PositionVertex::Layout() {
+  VertexLayout layout(sizeof(PositionVertex));
+  layout.AddAttribute(POSITION, 3, GL_FLOAT, GL_FALSE,
+                      offsetof(PositionVertex, position));
+  return layout;
+}
+
+VertexLayout StandardVertex::Layout() {
+  VertexLayout layout(sizeof(StandardVertex));
+  layout.AddAttribute(POSITION, 3, GL_FLOAT, GL_FALSE,
+                      offsetof(StandardVertex, position));
+  layout.AddAttribute(NORMAL, 3, GL_FLOAT, GL_FALSE,
+                      offsetof(StandardVertex, normal));
+  layout.AddAttribute(TEXCOORD, 2, GL_FLOAT, GL_FALSE,
+                      offsetof(StandardVertex, texcoord));
+  layout.AddAttribute(COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                      offsetof(StandardVertex, color));
+  return layout;
+}
+
+VertexLayout SkinnedVertex::Layout() {
+  VertexLayout layout(sizeof(SkinnedVertex));
+  layout.AddAttribute(POSITION, 3, GL_FLOAT, GL_FALSE,
+                      offsetof(SkinnedVertex, position));
+  layout.AddAttribute(NORMAL, 3, GL_FLOAT, GL_FALSE,
+                      offsetof(SkinnedVertex, normal));
+  layout.AddAttribute(TEXCOORD, 2, GL_FLOAT, GL_FALSE,
+                      offsetof(SkinnedVertex, texcoord));
+  layout.AddAttribute(JOINTS, 4, GL_UNSIGNED_BYTE, GL_FALSE,
+                      offsetof(SkinnedVertex, joints));
+  layout.AddAttribute(WEIGHTS, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                      offsetof(SkinnedVertex, weights));
+  return layout;
+}
+
+void QuantizeJointWeights(const float weights[4], GLubyte quantized[4]) {
+  float sum = 0.0f;
+  int largest = 0;
+  for (int i = 0; i < 4; ++i) {
+    sum += std::max(weights[i], 0.0f);
+    if (weights[i] > weights[largest]) largest = i;
+  }
+  if (sum <= 0.0f) {
+    quantized[0] = 255;
+    quantized[1] = quantized[2] = quantized[3] = 0;
+    return;
+  }
+  int remainder = 255;
+  for (int i = 0; i < 4; ++i) {
+    quantized[i] = static_cast<GLubyte>(
+        std::max(weights[i], 0.0f) / sum * 255.0f + 0.5f);
+    remainder -= quantized[i];
+  }
+  quantized[largest] = static_cast<GLubyte>(quantized[largest] + remainder);
+}
+
+}  // namespace wvu
@@ -0,0 +1,200 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_VERTEX_FORMAT_H_
+#define GLUTILS_VERTEX_FORMAT_H_
+
+#include <cstddef>
+#include <GL/glew.h>
+
+namespace wvu {
+// Semantics of the vertex attributes. The value of a semantic is also the
+// attribute location the shaders must use for it, e.g.,
+// layout (location = 0) in vec3 position;
+enum VertexSemantic {
+  POSITION = 0,
+  NORMAL = 1,
+  TEXCOORD = 2,
+  COLOR = 3,
+  // The joints influencing a skinned vertex and their weights (see
+  // skinning.h).
+  JOINTS = 4,
+  WEIGHTS = 5,
+};
+
+// Maximum number of attributes in a vertex layout.
+constexpr int kMaxNumVertexAttributes = 8;
+
+// Describes one attribute of an interleaved vertex: its semantic, its
+// components and where it lives inside the vertex.
+struct VertexAttribute {
+  VertexSemantic semantic;
+  // Number of components, e.g., 3 for a position.
+  GLint num_components;
+  // Type of each component, e.g., GL_FLOAT.
+  GLenum type;
+  // Whether integer components are normalized to [0, 1] or [-1, 1].
+  GLboolean normalized;
+  // Offset in bytes from the start of the vertex.
+  GLuint offset;
+};
+
+// This class describes the memory layout of an interleaved vertex, i.e., the
+// attributes of a vertex and the size in bytes of a vertex (the stride). The
+// same layout describes the vertex storage of a Model and configures the
+// attribute pointers of a vertex array object, so both always agree.
+// The layout does not allocate memory and is cheap to copy.
+//
+// Example:
+//
+// struct MyVertex {
+//   GLfloat position[3];
+//   GLubyte color[4];
+// };
+// wvu::VertexLayout layout(sizeof(MyVertex));
+// layout.AddAttribute(wvu::POSITION, 3, GL_FLOAT, GL_FALSE,
+//                     offsetof(MyVertex, position));
+// layout.AddAttribute(wvu::COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+//                     offsetof(MyVertex, color));
+class VertexLayout {
+ public:
+  VertexLayout() : stride_(0), num_attributes_(0) {}
+  explicit VertexLayout(const GLsizei stride)
+      : stride_(stride), num_attributes_(0) {}
+
+  // Adds an attribute to the layout. Returns false if the layout is full, the
+  // semantic is already in the layout, or the attribute does not fit in the
+  // vertex.
+  bool AddAttribute(const VertexSemantic semantic,
+                    const GLint num_components,
+                    const GLenum type,
+                    const GLboolean normalized,
+                    const GLuint offset);
+
+  // Returns the attribute with the given semantic, or nullptr if the layout
+  // does not have it.
+  const VertexAttribute* FindAttribute(const VertexSemantic semantic) const;
+
+  // Configures the attribute pointers of the currently bound vertex array
+  // object for the buffer currently bound to GL_ARRAY_BUFFER, and enables the
+  // attributes. Integer attributes that are not normalized are read as floats.
+  void SetAttributePointers() const;
+
+  // Sets the formats of the attributes of the vertex array object, read from
+  // the buffer at binding_index, and enables them, without binding the vertex
+  // array object (direct state access). The buffer is attached separately
+  // with glVertexArrayVertexBuffer() and the stride of the layout. Needs
+  // OpenGL 4.5 or GL_ARB_direct_state_access.
+  void SetVertexArrayFormat(const GLuint vertex_array_object_id,
+                            const GLuint binding_index) const;
+
+  // Returns the size in bytes of a vertex.
+  GLsizei stride() const {
+    return stride_;
+  }
+
+  int num_attributes() const {
+    return num_attributes_;
+  }
+
+  const VertexAttribute& attribute(const int i) const {
+    return attributes_[i];
+  }
+
+  bool operator==(const VertexLayout& other) const;
+  bool operator!=(const VertexLayout& other) const {
+    return !(*this == other);
+  }
+
+ private:
+  GLsizei stride_;
+  int num_attributes_;
+  VertexAttribute attributes_[kMaxNumVertexAttributes];
+};
+
+// Returns the size in bytes of a component of the given type, or 0 if the type
+// is not supported. Packed types (e.g., GL_INT_2_10_10_10_REV) do not have a
+// component size.
+GLsizei VertexComponentSize(const GLenum type);
+
+// Returns the size in bytes of an attribute with num_components of the given
+// type, or 0 if the type is not supported. Packed types hold four components
+// in four bytes.
+GLsizei VertexAttributeSize(const GLenum type, const GLint num_components);
+
+// Vertex types. Each type provides its layout through Layout(), so the CPU-side
+// storage and the attribute setup derive from the same description.
+
+// A vertex holding only a position.
+struct PositionVertex {
+  GLfloat position[3];
+
+  static VertexLayout Layout();
+};
+
+// A vertex holding a position, a normal, texture coordinates and an RGBA
+// color. The color is stored in normalized bytes.
+struct StandardVertex {
+  GLfloat position[3];
+  GLfloat normal[3];
+  GLfloat texcoord[2];
+  GLubyte color[4];
+
+  static VertexLayout Layout();
+};
+
+// A vertex of a skinned mesh: a standard vertex, without color, influenced by
+// up to four joints. The joint indices are bytes read as floats, so a
+// skeleton has at most 256 joints, and the weights are normalized bytes that
+// sum to 255 (see QuantizeJointWeights()). A vertex with fewer joints gives
+// the others a zero weight.
+struct SkinnedVertex {
+  GLfloat position[3];
+  GLfloat normal[3];
+  GLfloat texcoord[2];
+  GLubyte joints[4];
+  GLubyte weights[4];
+
+  static VertexLayout Layout();
+};
+
+// Quantizes four joint weights into the normalized bytes of a SkinnedVertex.
+// The weights are normalized first, and the rounding error goes to the largest
+// weight, so the bytes sum to exactly 255 and the skinned vertices do not
+// shrink. All zero weights give the whole weight to the first joint.
+void QuantizeJointWeights(const float weights[4], GLubyte quantized[4]);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_VERTEX_FORMAT_H_
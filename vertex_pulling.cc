@@ -0,0 +1,416 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#include "vertex_pulling.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "buffer_allocator.h"
+#include "gl_state_cache.h"
+#include "gpu_resources.h"
+#include "mesh_batch.h"
+#include "model.h"
+#include "shader_program.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+// Formats of the attributes decoded by PullAttribute().
+enum PulledFormat {
+  PULLED_NONE = 0,
+  PULLED_FLOAT32 = 1,
+  PULLED_FLOAT16 = 2,
+  PULLED_UNORM16 = 3,
+  PULLED_SNORM10 = 4,
+  PULLED_UNORM8 = 5,
+};
+
+// The record of a mesh, in the std430 layout of PulledMesh.
+struct PulledMeshRecord {
+  GLuint first_word;
+  GLuint stride_words;
+  GLuint padding[2];
+  // The descriptors of the position, the normal, the texture coordinates and
+  // the color, see EncodeAttribute().
+  GLuint attributes[4];
+  GLfloat position_scale[4];
+  GLfloat position_offset[4];
+};
+
+// The semantics of the attributes of a record, in their order.
+const VertexSemantic kPulledSemantics[] = {POSITION, NORMAL, TEXCOORD, COLOR};
+
+// Returns the descriptor of an attribute decoded by PullAttribute(): its
+// format in bits 0-7, its number of components in bits 8-15 and its offset in
+// bytes in bits 16-31. Returns PULLED_NONE if the shader does not decode it.
+GLuint EncodeAttribute(const VertexAttribute& attribute) {
+  if (attribute.offset % 4 != 0 || attribute.offset > 0xFFFF ||
+      attribute.num_components < 1 || attribute.num_components > 4) {
+    return PULLED_NONE;
+  }
+  PulledFormat format = PULLED_NONE;
+  switch (attribute.type) {
+    case GL_FLOAT:
+      if (!attribute.normalized) format = PULLED_FLOAT32;
+      break;
+    case GL_HALF_FLOAT:
+      format = PULLED_FLOAT16;
+      break;
+    case GL_UNSIGNED_SHORT:
+      if (attribute.normalized) format = PULLED_UNORM16;
+      break;
+    case GL_INT_2_10_10_10_REV:
+      if (attribute.normalized) format = PULLED_SNORM10;
+      break;
+    case GL_UNSIGNED_BYTE:
+      if (attribute.normalized) format = PULLED_UNORM8;
+      break;
+  }
+  if (format == PULLED_NONE) return PULLED_NONE;
+  return format | (attribute.num_components << 8) | (attribute.offset << 16);
+}
+
+// The word of the vertex is the first word of its mesh plus its index in the
+// low bits of gl_VertexID times the stride, and its mesh is in the high bits.
+const char kGlslDeclaration[] =
+    "struct PulledMesh {\n"
+    "  uint first_word;\n"
+    "  uint stride_words;\n"
+    "  uvec2 padding;\n"
+    "  uvec4 attributes;\n"
+    "  vec4 position_scale;\n"
+    "  vec4 position_offset;\n"
+    "};\n"
+    "layout (std430) readonly buffer PulledVertices {\n"
+    "  uint pulled_words[];\n"
+    "};\n"
+    "layout (std430) readonly buffer PulledMeshes {\n"
+    "  PulledMesh pulled_meshes[];\n"
+    "};\n"
+    "struct PulledVertex {\n"
+    "  vec3 position;\n"
+    "  vec3 normal;\n"
+    "  vec2 texcoord;\n"
+    "  vec4 color;\n"
+    "};\n"
+    "vec4 PullAttribute(uint vertex_word, uint descriptor, vec4 value) {\n"
+    "  uint format = descriptor & 0xFFu;\n"
+    "  uint num_components = (descriptor >> 8u) & 0xFFu;\n"
+    "  uint word = vertex_word + (descriptor >> 16u) / 4u;\n"
+    "  if (format == 1u) {\n"
+    "    for (uint i = 0u; i < num_components; ++i) {\n"
+    "      value[i] = uintBitsToFloat(pulled_words[word + i]);\n"
+    "    }\n"
+    "  } else if (format == 2u || format == 3u) {\n"
+    "    for (uint i = 0u; i < num_components; ++i) {\n"
+    "      uint bits =\n"
+    "          (pulled_words[word + i / 2u] >> (16u * (i % 2u))) & 0xFFFFu;\n"
+    "      value[i] = format == 2u ? unpackHalf2x16(bits).x :\n"
+    "                                float(bits) / 65535.0f;\n"
+    "    }\n"
+    "  } else if (format == 4u) {\n"
+    "    int packed = int(pulled_words[word]);\n"
+    "    ivec3 components =\n"
+    "        ivec3(packed << 22, packed << 12, packed << 2) >> 22;\n"
+    "    value.xyz = max(vec3(components) / 511.0f, -1.0f);\n"
+    "  } else if (format == 5u) {\n"
+    "    vec4 components = unpackUnorm4x8(pulled_words[word]);\n"
+    "    for (uint i = 0u; i < num_components; ++i) {\n"
+    "      value[i] = components[i];\n"
+    "    }\n"
+    "  }\n"
+    "  return value;\n"
+    "}\n"
+    "PulledVertex PullVertex() {\n"
+    "  uint vertex_id = uint(gl_VertexID);\n"
+    "  PulledMesh mesh = pulled_meshes[vertex_id >> PULLED_VERTEX_BITS];\n"
+    "  uint vertex_word = mesh.first_word + mesh.stride_words *\n"
+    "      (vertex_id & ((1u << PULLED_VERTEX_BITS) - 1u));\n"
+    "  PulledVertex vertex;\n"
+    "  vertex.position = mesh.position_offset.xyz +\n"
+    "      mesh.position_scale.xyz *\n"
+    "      PullAttribute(vertex_word, mesh.attributes.x, vec4(0.0f)).xyz;\n"
+    "  vertex.normal = PullAttribute(vertex_word, mesh.attributes.y,\n"
+    "                                vec4(0.0f, 0.0f, 1.0f, 0.0f)).xyz;\n"
+    "  vertex.texcoord =\n"
+    "      PullAttribute(vertex_word, mesh.attributes.z, vec4(0.0f)).xy;\n"
+    "  vertex.color =\n"
+    "      PullAttribute(vertex_word, mesh.attributes.w, vec4(1.0f));\n"
+    "  return vertex;\n"
+    "}\n";
+
+}  // namespace
+
+const char PulledMeshBatch::kVerticesBlockName[] = "PulledVertices";
+const char PulledMeshBatch::kMeshesBlockName[] = "PulledMeshes";
+
+PulledMeshBatch::PulledMeshBatch()
+    : vertex_buffer_id_(0), index_buffer_id_(0), mesh_buffer_id_(0),
+      indirect_buffer_id_(0), vertex_array_object_id_(0),
+      max_vertex_bytes_(0), max_num_indices_(0), max_num_meshes_(0),
+      num_vertex_bytes_(0), num_indices_(0), indirect_capacity_(0) {}
+
+PulledMeshBatch::~PulledMeshBatch() {
+  Reset();
+}
+
+bool PulledMeshBatch::Supported() {
+  if (!GLEW_VERSION_4_3) return false;
+  // OpenGL 4.3 only requires the storage blocks in the compute shaders.
+  GLint max_vertex_blocks = 0;
+  glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &max_vertex_blocks);
+  return max_vertex_blocks >= 2;
+}
+
+bool PulledMeshBatch::Initialize(const GLsizeiptr max_vertex_bytes,
+                                 const int max_num_indices,
+                                 const int max_num_meshes,
+                                 std::string* error_info_log) {
+  Reset();
+  if (!Supported()) {
+    *error_info_log = "Vertex pulling needs OpenGL 4.3 and storage blocks "
+        "in the vertex shaders.";
+    return false;
+  }
+  if (max_vertex_bytes <= 0 || max_num_indices <= 0 || max_num_meshes <= 0 ||
+      max_num_meshes > (1 << (31 - kPulledVertexBits))) {
+    *error_info_log = "Invalid capacity of the pulled mesh batch.";
+    return false;
+  }
+  max_vertex_bytes_ = max_vertex_bytes;
+  max_num_indices_ = max_num_indices;
+  max_num_meshes_ = max_num_meshes;
+  BufferAllocator* allocator = BufferAllocator::Get();
+  GlStateCache* gl_state = GlStateCache::Current();
+  vertex_buffer_id_ = allocator->CreateBuffer(VERTEX_DATA);
+  mesh_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+  index_buffer_id_ = allocator->CreateBuffer(INDEX_DATA);
+  indirect_buffer_id_ = allocator->CreateBuffer(STORAGE_DATA);
+  if (vertex_buffer_id_ == 0 || mesh_buffer_id_ == 0 ||
+      index_buffer_id_ == 0 || indirect_buffer_id_ == 0) {
+    *error_info_log = "Could not create the buffers of the batch.";
+    Reset();
+    return false;
+  }
+  // The copy targets do not change the index buffer of the bound vertex
+  // array.
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer_id_);
+  allocator->BufferData(vertex_buffer_id_, GL_COPY_WRITE_BUFFER,
+                        max_vertex_bytes, nullptr, GL_STATIC_DRAW);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, mesh_buffer_id_);
+  allocator->BufferData(mesh_buffer_id_, GL_COPY_WRITE_BUFFER,
+                        max_num_meshes * sizeof(PulledMeshRecord), nullptr,
+                        GL_STATIC_DRAW);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, index_buffer_id_);
+  allocator->BufferData(index_buffer_id_, GL_COPY_WRITE_BUFFER,
+                        static_cast<GLsizeiptr>(max_num_indices) *
+                        sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  // The vertex array only holds the index buffer: the vertices have no
+  // attribute formats.
+  glGenVertexArrays(1, &vertex_array_object_id_);
+  gl_state->BindVertexArray(vertex_array_object_id_);
+  gl_state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_id_);
+  gl_state->BindVertexArray(0);
+  return true;
+}
+
+int PulledMeshBatch::AddMesh(const Model& model,
+                             const Eigen::Matrix4f* dequantization,
+                             std::string* error_info_log) {
+  if (vertex_array_object_id_ == 0) {
+    *error_info_log = "The batch is not initialized.";
+    return -1;
+  }
+  if (model.primitive_type() != GL_TRIANGLES) {
+    *error_info_log = "Only triangle lists can be batched.";
+    return -1;
+  }
+  if (model.cpu_data_released()) {
+    *error_info_log = "The vertices of the model were released.";
+    return -1;
+  }
+  const VertexLayout& layout = model.vertex_layout();
+  if (layout.stride() % 4 != 0) {
+    *error_info_log = "The stride of the vertices is not a multiple of 4.";
+    return -1;
+  }
+  PulledMeshRecord record = {};
+  for (int i = 0; i < 4; ++i) {
+    const VertexAttribute* attribute =
+        layout.FindAttribute(kPulledSemantics[i]);
+    if (attribute == nullptr) continue;
+    record.attributes[i] = EncodeAttribute(*attribute);
+    if (record.attributes[i] == PULLED_NONE) {
+      *error_info_log = "The format of the attribute " +
+          std::to_string(kPulledSemantics[i]) + " is not pulled.";
+      return -1;
+    }
+  }
+  if (record.attributes[0] == PULLED_NONE) {
+    *error_info_log = "The model has no positions.";
+    return -1;
+  }
+  const GLsizeiptr num_bytes = model.vertex_data().size();
+  if (num_meshes() == max_num_meshes_ ||
+      model.num_vertices() > (1 << kPulledVertexBits) ||
+      num_vertex_bytes_ + num_bytes > max_vertex_bytes_ ||
+      num_indices_ + model.num_indices() > max_num_indices_) {
+    *error_info_log = "The batch is full.";
+    return -1;
+  }
+  const int mesh_id = num_meshes();
+  record.first_word = num_vertex_bytes_ / 4;
+  record.stride_words = layout.stride() / 4;
+  for (int i = 0; i < 3; ++i) {
+    record.position_scale[i] =
+        dequantization != nullptr ? (*dequantization)(i, i) : 1.0f;
+    record.position_offset[i] =
+        dequantization != nullptr ? (*dequantization)(i, 3) : 0.0f;
+  }
+
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer_id_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, num_vertex_bytes_, num_bytes,
+                  model.vertex_data().data());
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, mesh_buffer_id_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, mesh_id * sizeof(record),
+                  sizeof(record), &record);
+  // The indices stay relative to the first vertex of the mesh.
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, index_buffer_id_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER,
+                  static_cast<GLintptr>(num_indices_) * sizeof(GLuint),
+                  model.num_indices() * sizeof(GLuint),
+                  model.indices().data());
+  gl_state->BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  MeshAllocation allocation;
+  allocation.first_vertex = mesh_id << kPulledVertexBits;
+  allocation.num_vertices = model.num_vertices();
+  allocation.first_index = num_indices_;
+  allocation.num_indices = model.num_indices();
+  meshes_.push_back(allocation);
+  num_vertex_bytes_ += num_bytes;
+  num_indices_ += model.num_indices();
+  return mesh_id;
+}
+
+void PulledMeshBatch::ClearDraws() {
+  commands_.clear();
+}
+
+void PulledMeshBatch::AddDraw(const int mesh_id,
+                              const int instance_count,
+                              const int base_instance) {
+  AddDrawRange(mesh_id, 0, meshes_[mesh_id].num_indices, instance_count,
+               base_instance);
+}
+
+void PulledMeshBatch::AddDrawRange(const int mesh_id,
+                                   const int first_index,
+                                   const int num_indices,
+                                   const int instance_count,
+                                   const int base_instance) {
+  const MeshAllocation& allocation = meshes_[mesh_id];
+  DrawElementsIndirectCommand command;
+  command.count = num_indices;
+  command.instance_count = instance_count;
+  command.first_index = allocation.first_index + first_index;
+  command.base_vertex = allocation.first_vertex;
+  command.base_instance = base_instance;
+  commands_.push_back(command);
+}
+
+void PulledMeshBatch::Submit() {
+  if (commands_.empty() || vertex_array_object_id_ == 0) return;
+  GlStateCache* gl_state = GlStateCache::Current();
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                           kPulledVerticesBindingPoint, vertex_buffer_id_);
+  gl_state->BindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                           kPulledMeshesBindingPoint, mesh_buffer_id_);
+  gl_state->BindVertexArray(vertex_array_object_id_);
+  gl_state->BindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_id_);
+  const int num_commands = commands_.size();
+  if (num_commands > indirect_capacity_) {
+    indirect_capacity_ = std::max(num_commands, 2 * indirect_capacity_);
+  }
+  // Reallocating orphans the commands of the previous frame.
+  BufferAllocator::Get()->BufferData(
+      indirect_buffer_id_, GL_DRAW_INDIRECT_BUFFER,
+      indirect_capacity_ * sizeof(DrawElementsIndirectCommand), nullptr,
+      GL_STREAM_DRAW);
+  glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+                  num_commands * sizeof(DrawElementsIndirectCommand),
+                  commands_.data());
+  glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+                              num_commands, 0);
+}
+
+bool PulledMeshBatch::Attach(ShaderProgram* shader_program) const {
+  return shader_program->BindShaderStorageBlock(
+             kVerticesBlockName, kPulledVerticesBindingPoint) &&
+      shader_program->BindShaderStorageBlock(kMeshesBlockName,
+                                             kPulledMeshesBindingPoint);
+}
+
+void PulledMeshBatch::Reset() {
+  GpuResources::Get()->Retire(GPU_VERTEX_ARRAY, vertex_array_object_id_);
+  vertex_array_object_id_ = 0;
+  BufferAllocator* allocator = BufferAllocator::Get();
+  allocator->DeleteBuffer(&vertex_buffer_id_);
+  allocator->DeleteBuffer(&mesh_buffer_id_);
+  allocator->DeleteBuffer(&index_buffer_id_);
+  allocator->DeleteBuffer(&indirect_buffer_id_);
+  max_vertex_bytes_ = 0;
+  max_num_indices_ = 0;
+  max_num_meshes_ = 0;
+  num_vertex_bytes_ = 0;
+  num_indices_ = 0;
+  indirect_capacity_ = 0;
+  meshes_.clear();
+  commands_.clear();
+}
+
+std::string PulledMeshBatch::GlslDeclaration() {
+  return "#define PULLED_VERTEX_BITS " + std::to_string(kPulledVertexBits) +
+      "u\n" + kGlslDeclaration;
+}
+
+}  // namespace wvu
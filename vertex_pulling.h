@@ -0,0 +1,244 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+
+#ifndef GLUTILS_VERTEX_PULLING_H_
+#define GLUTILS_VERTEX_PULLING_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "mesh_batch.h"
+#include "model.h"
+#include "shader_program.h"
+
+namespace wvu {
+// Shader storage buffer binding points of the vertices and of the meshes of a
+// PulledMeshBatch.
+constexpr GLuint kPulledVerticesBindingPoint = 7;
+constexpr GLuint kPulledMeshesBindingPoint = 8;
+
+// Bits of gl_VertexID holding the vertex of a mesh; the others hold the
+// mesh, which each draw passes as its base vertex. A batch holds at most
+// 2^(31 - kPulledVertexBits) meshes of at most 2^kPulledVertexBits vertices.
+constexpr int kPulledVertexBits = 20;
+
+// This class packs meshes of any vertex layout into one shader storage
+// buffer, and draws them all with a single glMultiDrawElementsIndirect()
+// call: the vertex shaders fetch the attributes of their vertex from the
+// buffer themselves (programmable vertex pulling), instead of through the
+// attribute formats of a vertex array object. Meshes with float, half float
+// and quantized vertices (see vertex_quantization.h) are mixed in one draw
+// with no vertex array switch between them, where a MeshBatch needs one
+// batch per layout.
+//
+// Each mesh keeps its vertices as they are, and its record in a second
+// storage buffer describes their stride and the format and offset of each
+// attribute, which the shader decodes: 32-bit and 16-bit floats, unsigned
+// normalized 16-bit and 8-bit components, and signed normalized 10-bit
+// normals. The quantized positions are also dequantized in the shader, with
+// the scale and offset of the mesh, so all the meshes share the model
+// matrices. The position, normal, texture coordinates and color are pulled;
+// the other attributes are ignored. The vertex offsets and strides must be
+// multiples of 4 bytes, as those of QuantizeModel() are.
+//
+// The indices of each mesh stay relative to its first vertex, and the mesh is
+// passed in the high bits of the base vertex of its draws (see
+// kPulledVertexBits), so the base instance is left to the per-instance
+// attributes of the draws, e.g., an InstanceBuffer attached to
+// vertex_array_object_id(). Needs OpenGL 4.3, see Supported().
+//
+// The vertex shaders include GlslDeclaration() right after their #version
+// line, which declares:
+//
+//   struct PulledVertex {
+//     vec3 position;
+//     vec3 normal;     // (0, 0, 1) if the mesh has no normals.
+//     vec2 texcoord;   // (0, 0) if the mesh has no texture coordinates.
+//     vec4 color;      // (1, 1, 1, 1) if the mesh has no colors.
+//   };
+//   // Returns the attributes of the vertex of gl_VertexID.
+//   PulledVertex PullVertex();
+//
+// Example:
+//
+// wvu::PulledMeshBatch batch;
+// batch.Initialize(64 << 20, 1 << 22, 1024, &error_info_log);
+// const int rock = batch.AddMesh(rock_model, nullptr, &error_info_log);
+// const int tree = batch.AddMesh(quantized_tree_model, &dequantization,
+//                                &error_info_log);
+// program.LoadVertexShaderFromString(
+//     "#version 430 core\n" + wvu::PulledMeshBatch::GlslDeclaration() +
+//     "layout (location = 12) in mat4 instance_model;\n"
+//     "void main() {\n"
+//     "  PulledVertex vertex = PullVertex();\n"
+//     "  gl_Position = view_projection * instance_model *\n"
+//     "      vec4(vertex.position, 1.0f);\n"
+//     "}\n");
+// ...
+// batch.Attach(&program);
+// instances.Attach(batch.vertex_array_object_id());
+// while (...) {  // Rendering loop.
+//   batch.ClearDraws();
+//   batch.AddDraw(rock, 1, instances.base_instance());
+//   batch.AddDraw(tree, 1, instances.base_instance() + 1);
+//   program.Use();
+//   batch.Submit();
+// }
+class PulledMeshBatch {
+ public:
+  // Name of the storage blocks in the shaders.
+  static const char kVerticesBlockName[];
+  static const char kMeshesBlockName[];
+
+  PulledMeshBatch();
+  ~PulledMeshBatch();
+
+  // Allocates the buffers. Returns true if successful.
+  // Parameters:
+  //   max_vertex_bytes  The capacity of the vertex buffer in bytes.
+  //   max_num_indices  The capacity of the index buffer in indices.
+  //   max_num_meshes  The capacity of the mesh records.
+  //   error_info_log  The reason of the failure.
+  bool Initialize(const GLsizeiptr max_vertex_bytes,
+                  const int max_num_indices,
+                  const int max_num_meshes,
+                  std::string* error_info_log);
+
+  // Copies the vertices, the indices and the record of the model into the
+  // buffers. Returns the id of the mesh in the batch, or -1 if the model is
+  // not a triangle list, has no pulled position, an attribute the shader
+  // does not decode, or does not fit.
+  // Parameters:
+  //   model  The model, whose vertices are not released.
+  //   dequantization  The scale and translation mapping the positions into
+  //     model space, e.g., the transform of QuantizeModel(), or nullptr if
+  //     the positions are not quantized.
+  //   error_info_log  The reason of the failure.
+  int AddMesh(const Model& model,
+              const Eigen::Matrix4f* dequantization,
+              std::string* error_info_log);
+
+  // Removes the recorded draws.
+  void ClearDraws();
+
+  // Records a draw of instance_count instances of a mesh. The instance
+  // attributes are read from base_instance on.
+  void AddDraw(const int mesh_id,
+               const int instance_count,
+               const int base_instance);
+
+  // Records a draw of a range of the indices of a mesh.
+  void AddDrawRange(const int mesh_id,
+                    const int first_index,
+                    const int num_indices,
+                    const int instance_count,
+                    const int base_instance);
+
+  // Binds the storage buffers, uploads the recorded commands and draws them
+  // with the current program, in one call.
+  void Submit();
+
+  // Binds the storage blocks of a program declaring GlslDeclaration().
+  // Returns false if the program does not declare them.
+  bool Attach(ShaderProgram* shader_program) const;
+
+  // Deletes the buffers and the meshes.
+  void Reset();
+
+  // Returns the GLSL declaration of PullVertex(). Needs GLSL 4.30.
+  static std::string GlslDeclaration();
+
+  // Returns true if the context has indirect draws and shader storage
+  // buffers in the vertex shaders.
+  static bool Supported();
+
+  // Returns the location of a mesh in the buffers: its first index and its
+  // number of indices and vertices. first_vertex is the base vertex of its
+  // draws, which holds the mesh in its high bits.
+  const MeshAllocation& mesh(const int mesh_id) const {
+    return meshes_[mesh_id];
+  }
+
+  int num_meshes() const {
+    return meshes_.size();
+  }
+
+  // Returns the bytes of the vertex buffer used by the meshes.
+  GLsizeiptr num_vertex_bytes() const {
+    return num_vertex_bytes_;
+  }
+
+  int num_indices() const {
+    return num_indices_;
+  }
+
+  const std::vector<DrawElementsIndirectCommand>& commands() const {
+    return commands_;
+  }
+
+  // Returns the vertex array object of the draws, which only holds the index
+  // buffer, and the per-instance attributes attached to it.
+  GLuint vertex_array_object_id() const {
+    return vertex_array_object_id_;
+  }
+
+  GLuint vertex_buffer_id() const {
+    return vertex_buffer_id_;
+  }
+
+ private:
+  GLuint vertex_buffer_id_;
+  GLuint index_buffer_id_;
+  GLuint mesh_buffer_id_;
+  GLuint indirect_buffer_id_;
+  GLuint vertex_array_object_id_;
+  GLsizeiptr max_vertex_bytes_;
+  int max_num_indices_;
+  int max_num_meshes_;
+  GLsizeiptr num_vertex_bytes_;
+  int num_indices_;
+  int indirect_capacity_;
+  std::vector<MeshAllocation> meshes_;
+  std::vector<DrawElementsIndirectCommand> commands_;
+
+  PulledMeshBatch(const PulledMeshBatch&) = delete;
+  PulledMeshBatch& operator=(const PulledMeshBatch&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_VERTEX_PULLING_H_
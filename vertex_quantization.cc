@@ -0,0 +1,346 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "vertex_quantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "model.h"
+#include "vertex_format.h"
+
+namespace wvu {
+namespace {
+
+// Rounds the size up to a multiple of 4 bytes, which keeps every attribute
+// aligned as most drivers prefer.
+GLuint AlignTo4(const GLuint size) {
+  return (size + 3) & ~3u;
+}
+
+// Reads the float components of an attribute of a vertex.
+void ReadFloats(const GLubyte* vertex,
+                const VertexAttribute& attribute,
+                float* values) {
+  std::memcpy(values, vertex + attribute.offset,
+              attribute.num_components * sizeof(float));
+}
+
+float AngleBetween(const float* a, const float* b) {
+  const Eigen::Vector3f u(a[0], a[1], a[2]);
+  const Eigen::Vector3f v(b[0], b[1], b[2]);
+  const float norms = u.norm() * v.norm();
+  if (norms == 0.0f) return 0.0f;
+  return std::acos(std::max(-1.0f, std::min(1.0f, u.dot(v) / norms)));
+}
+
+}  // namespace
+
+GLushort FloatToHalf(const float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+  uint32_t mantissa = bits & 0x7FFFFF;
+  if (((bits >> 23) & 0xFF) == 0xFF) {
+    // Infinity or NaN.
+    return static_cast<GLushort>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+  }
+  if (exponent >= 31) {
+    // Overflow to infinity.
+    return static_cast<GLushort>(sign | 0x7C00);
+  }
+  if (exponent <= 0) {
+    // Subnormal half or zero.
+    if (exponent < -10) return static_cast<GLushort>(sign);
+    mantissa |= 0x800000;
+    const uint32_t shift = 14 - exponent;
+    uint32_t half_mantissa = mantissa >> shift;
+    // Round to nearest, ties to even.
+    const uint32_t remainder = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half_mantissa & 1))) {
+      ++half_mantissa;
+    }
+    return static_cast<GLushort>(sign | half_mantissa);
+  }
+  uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+  const uint32_t remainder = mantissa & 0x1FFF;
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+    // A carry into the exponent is the correct rounding.
+    ++half;
+  }
+  return static_cast<GLushort>(half);
+}
+
+float HalfToFloat(const GLushort value) {
+  const uint32_t sign = (value & 0x8000) << 16;
+  const uint32_t exponent = (value >> 10) & 0x1F;
+  const uint32_t mantissa = value & 0x3FF;
+  float result;
+  if (exponent == 0) {
+    result = std::ldexp(static_cast<float>(mantissa), -24);
+  } else if (exponent == 31) {
+    result = mantissa ? NAN : INFINITY;
+  } else {
+    result = std::ldexp(static_cast<float>(mantissa | 0x400),
+                        static_cast<int>(exponent) - 25);
+  }
+  uint32_t bits;
+  std::memcpy(&bits, &result, sizeof(bits));
+  bits |= sign;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+uint32_t PackSnorm10(const float* values) {
+  uint32_t packed = 0;
+  for (int i = 0; i < 3; ++i) {
+    const float clamped = std::max(-1.0f, std::min(1.0f, values[i]));
+    const int32_t quantized =
+        static_cast<int32_t>(std::lround(clamped * 511.0f));
+    packed |= (static_cast<uint32_t>(quantized) & 0x3FF) << (10 * i);
+  }
+  return packed;
+}
+
+void UnpackSnorm10(const uint32_t packed, float* values) {
+  for (int i = 0; i < 3; ++i) {
+    int32_t quantized = (packed >> (10 * i)) & 0x3FF;
+    // Sign-extend the 10-bit value.
+    if (quantized & 0x200) quantized -= 0x400;
+    values[i] = std::max(-1.0f, quantized / 511.0f);
+  }
+}
+
+bool QuantizeModel(const Model& model,
+                   const QuantizationOptions& options,
+                   Model* quantized_model,
+                   Eigen::Matrix4f* dequantization,
+                   QuantizationReport* report,
+                   std::string* error_info_log) {
+  const VertexLayout& layout = model.vertex_layout();
+  const VertexAttribute* position = layout.FindAttribute(POSITION);
+  if (position == nullptr || position->type != GL_FLOAT ||
+      position->num_components != 3) {
+    *error_info_log = "The model must have 3D float positions.";
+    return false;
+  }
+  if (model.cpu_data_released()) {
+    *error_info_log = "The vertices of the model were released.";
+    return false;
+  }
+  const int num_vertices = model.num_vertices();
+  const GLubyte* src = model.vertex_data().data();
+
+  // Compute the bounding box used to quantize the positions.
+  Eigen::Vector3f min_corner = Eigen::Vector3f::Constant(INFINITY);
+  Eigen::Vector3f max_corner = Eigen::Vector3f::Constant(-INFINITY);
+  for (int i = 0; i < num_vertices; ++i) {
+    const Eigen::Vector3f p = model.VertexPosition(i);
+    min_corner = min_corner.cwiseMin(p);
+    max_corner = max_corner.cwiseMax(p);
+  }
+  if (num_vertices == 0) {
+    min_corner.setZero();
+    max_corner.setZero();
+  }
+  // Avoid dividing by zero for flat meshes.
+  const Eigen::Vector3f extent =
+      (max_corner - min_corner).cwiseMax(Eigen::Vector3f::Constant(1e-20f));
+
+  // Build the compact layout. Every attribute is aligned to 4 bytes.
+  struct AttributeMapping {
+    const VertexAttribute* source;
+    GLenum type;
+    GLint num_components;
+    GLboolean normalized;
+    GLuint offset;
+  };
+  std::vector<AttributeMapping> mappings;
+  GLuint offset = 0;
+  for (int i = 0; i < layout.num_attributes(); ++i) {
+    const VertexAttribute& attribute = layout.attribute(i);
+    AttributeMapping mapping = {&attribute, attribute.type,
+                                attribute.num_components, attribute.normalized,
+                                0};
+    if (attribute.type == GL_FLOAT) {
+      switch (attribute.semantic) {
+        case POSITION:
+          if (options.position_precision == POSITION_FLOAT16) {
+            mapping.type = GL_HALF_FLOAT;
+          } else if (options.position_precision == POSITION_QUANTIZED16) {
+            mapping.type = GL_UNSIGNED_SHORT;
+            mapping.normalized = GL_TRUE;
+          }
+          break;
+        case NORMAL:
+          if (options.normal_precision == NORMAL_FLOAT16) {
+            mapping.type = GL_HALF_FLOAT;
+          } else if (options.normal_precision == NORMAL_SNORM10) {
+            if (attribute.num_components != 3) {
+              *error_info_log = "Packed normals require 3D normals.";
+              return false;
+            }
+            mapping.type = GL_INT_2_10_10_10_REV;
+            mapping.num_components = 4;
+            mapping.normalized = GL_TRUE;
+          }
+          break;
+        case TEXCOORD:
+          if (options.texcoord_precision == TEXCOORD_FLOAT16) {
+            mapping.type = GL_HALF_FLOAT;
+          } else if (options.texcoord_precision == TEXCOORD_UNORM16) {
+            mapping.type = GL_UNSIGNED_SHORT;
+            mapping.normalized = GL_TRUE;
+          }
+          break;
+        default:
+          break;
+      }
+    }
+    mapping.offset = offset;
+    offset += AlignTo4(
+        VertexAttributeSize(mapping.type, mapping.num_components));
+    mappings.push_back(mapping);
+  }
+  VertexLayout quantized_layout(offset);
+  for (const AttributeMapping& mapping : mappings) {
+    quantized_layout.AddAttribute(mapping.source->semantic,
+                                  mapping.num_components, mapping.type,
+                                  mapping.normalized, mapping.offset);
+  }
+
+  // Encode the vertices and measure the errors.
+  QuantizationReport quantization_report;
+  quantization_report.original_stride = layout.stride();
+  quantization_report.quantized_stride = quantized_layout.stride();
+  std::vector<GLubyte> data(num_vertices * quantized_layout.stride(), 0);
+  for (int i = 0; i < num_vertices; ++i) {
+    const GLubyte* src_vertex = src + i * layout.stride();
+    GLubyte* dst_vertex = data.data() + i * quantized_layout.stride();
+    for (const AttributeMapping& mapping : mappings) {
+      const VertexAttribute& attribute = *mapping.source;
+      GLubyte* dst = dst_vertex + mapping.offset;
+      if (mapping.type == attribute.type) {
+        std::memcpy(dst, src_vertex + attribute.offset,
+                    VertexAttributeSize(attribute.type,
+                                        attribute.num_components));
+        continue;
+      }
+      float values[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      float decoded[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      ReadFloats(src_vertex, attribute, values);
+      if (mapping.type == GL_HALF_FLOAT) {
+        GLushort halfs[4];
+        for (int c = 0; c < attribute.num_components; ++c) {
+          halfs[c] = FloatToHalf(values[c]);
+          decoded[c] = HalfToFloat(halfs[c]);
+        }
+        std::memcpy(dst, halfs, attribute.num_components * sizeof(GLushort));
+      } else if (mapping.type == GL_INT_2_10_10_10_REV) {
+        const uint32_t packed = PackSnorm10(values);
+        UnpackSnorm10(packed, decoded);
+        std::memcpy(dst, &packed, sizeof(packed));
+      } else if (attribute.semantic == POSITION) {
+        GLushort quantized[3];
+        for (int c = 0; c < 3; ++c) {
+          const float t = (values[c] - min_corner[c]) / extent[c];
+          quantized[c] = static_cast<GLushort>(
+              std::lround(std::max(0.0f, std::min(1.0f, t)) * 65535.0f));
+          decoded[c] = min_corner[c] + quantized[c] / 65535.0f * extent[c];
+        }
+        std::memcpy(dst, quantized, sizeof(quantized));
+      } else {
+        GLushort quantized[4];
+        for (int c = 0; c < attribute.num_components; ++c) {
+          if (values[c] < 0.0f || values[c] > 1.0f) {
+            *error_info_log =
+                "Texture coordinates outside [0, 1] cannot be stored in "
+                "unsigned normalized integers.";
+            return false;
+          }
+          quantized[c] =
+              static_cast<GLushort>(std::lround(values[c] * 65535.0f));
+          decoded[c] = quantized[c] / 65535.0f;
+        }
+        std::memcpy(dst, quantized,
+                    attribute.num_components * sizeof(GLushort));
+      }
+      // Accumulate the error of the attribute.
+      if (attribute.semantic == POSITION) {
+        const float error = (Eigen::Vector3f(values[0], values[1], values[2]) -
+                             Eigen::Vector3f(decoded[0], decoded[1],
+                                             decoded[2])).norm();
+        quantization_report.max_position_error =
+            std::max(quantization_report.max_position_error, error);
+      } else if (attribute.semantic == NORMAL) {
+        quantization_report.max_normal_error =
+            std::max(quantization_report.max_normal_error,
+                     AngleBetween(values, decoded));
+      } else if (attribute.semantic == TEXCOORD) {
+        for (int c = 0; c < attribute.num_components; ++c) {
+          quantization_report.max_texcoord_error =
+              std::max(quantization_report.max_texcoord_error,
+                       std::abs(values[c] - decoded[c]));
+        }
+      }
+    }
+  }
+
+  if (dequantization != nullptr) {
+    dequantization->setIdentity();
+    if (quantized_layout.FindAttribute(POSITION)->type == GL_UNSIGNED_SHORT) {
+      dequantization->block<3, 3>(0, 0) = extent.asDiagonal();
+      dequantization->block<3, 1>(0, 3) = min_corner;
+    }
+  }
+  if (report != nullptr) {
+    *report = quantization_report;
+  }
+  *quantized_model = Model(model.orientation(), model.position(),
+                           quantized_layout, std::move(data),
+                           std::vector<GLuint>());
+  quantized_model->SetIndices(model.indices(), model.primitive_type());
+  return true;
+}
+
+}  // namespace wvu
@@ -0,0 +1,135 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_VERTEX_QUANTIZATION_H_
+#define GLUTILS_VERTEX_QUANTIZATION_H_
+
+#include <cstdint>
+#include <string>
+#include <GL/glew.h>
+#include <Eigen/Core>
+
+#include "model.h"
+
+namespace wvu {
+// Precision of positions after quantization.
+enum PositionPrecision {
+  // 32-bit floats (no compression).
+  POSITION_FLOAT32,
+  // 16-bit floats (GL_HALF_FLOAT).
+  POSITION_FLOAT16,
+  // 16-bit unsigned integers relative to the bounding box of the mesh. The
+  // shader reads positions in [0, 1]^3, and the dequantization transform maps
+  // them back into the model space.
+  POSITION_QUANTIZED16,
+};
+
+// Precision of normals after quantization.
+enum NormalPrecision {
+  NORMAL_FLOAT32,
+  NORMAL_FLOAT16,
+  // Signed normalized 10-bit components (GL_INT_2_10_10_10_REV).
+  NORMAL_SNORM10,
+};
+
+// Precision of texture coordinates after quantization.
+enum TexcoordPrecision {
+  TEXCOORD_FLOAT32,
+  TEXCOORD_FLOAT16,
+  // Unsigned normalized 16-bit components. Only valid for coordinates in
+  // [0, 1].
+  TEXCOORD_UNORM16,
+};
+
+// Selects the precision of each attribute. Attributes that are not stored in
+// floats, e.g., byte colors, are copied as they are.
+struct QuantizationOptions {
+  PositionPrecision position_precision = POSITION_QUANTIZED16;
+  NormalPrecision normal_precision = NORMAL_SNORM10;
+  TexcoordPrecision texcoord_precision = TEXCOORD_FLOAT16;
+};
+
+// Reports the outcome of a quantization.
+struct QuantizationReport {
+  // Maximum distance between an original and a decoded position, in model
+  // space units.
+  float max_position_error = 0.0f;
+  // Maximum angle in radians between an original and a decoded normal.
+  float max_normal_error = 0.0f;
+  // Maximum absolute difference between original and decoded texture
+  // coordinates.
+  float max_texcoord_error = 0.0f;
+  // Size in bytes of a vertex before and after the quantization.
+  int original_stride = 0;
+  int quantized_stride = 0;
+};
+
+// Quantizes the vertices of model into quantized_model, which gets a compact
+// layout with the selected precision per attribute. The attribute locations do
+// not change, so the same shaders work: normalized integer attributes are read
+// as floats. The indices, orientation and position are copied.
+// With POSITION_QUANTIZED16 the shader receives positions in the unit cube, and
+// dequantization must be folded into the model matrix:
+//   model_matrix = model_matrix * dequantization;
+// Returns false if the model does not have float positions or the options are
+// not valid for the model, in which case the error is copied into
+// error_info_log.
+// Parameters:
+//   model  The model to quantize.
+//   options  The precision of each attribute.
+//   quantized_model  The model holding the quantized vertices.
+//   dequantization  The transform mapping decoded positions into the model
+//     space. Identity unless the positions are quantized. Can be nullptr.
+//   report  The quantization errors and sizes. Can be nullptr.
+//   error_info_log  A pointer to a string that holds the error log.
+bool QuantizeModel(const Model& model,
+                   const QuantizationOptions& options,
+                   Model* quantized_model,
+                   Eigen::Matrix4f* dequantization,
+                   QuantizationReport* report,
+                   std::string* error_info_log);
+
+// Conversions between 32-bit and 16-bit floats. The conversion to 16 bits
+// rounds to the nearest representable value.
+GLushort FloatToHalf(const float value);
+float HalfToFloat(const GLushort value);
+
+// Packs the 3 components of a normalized vector into a GL_INT_2_10_10_10_REV
+// value, and decodes them back.
+uint32_t PackSnorm10(const float* values);
+void UnpackSnorm10(const uint32_t packed, float* values);
+
+}  // namespace wvu
+
+#endif  // GLUTILS_VERTEX_QUANTIZATION_H_
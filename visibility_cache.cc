@@ -0,0 +1,273 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#include "visibility_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "assignment.h"
+#include "bounding_volume_hierarchy.h"
+#include "camera.h"
+#include "transforms.h"
+
+namespace wvu {
+namespace {
+
+// Classification of a box against a frustum.
+enum BoxClassification {
+  BOX_OUTSIDE = 0,
+  BOX_CROSSING = 1,
+  BOX_INSIDE = 2
+};
+
+BoxClassification ClassifyBox(const FrustumPlanes& planes,
+                              const Eigen::Vector3f& center,
+                              const Eigen::Vector3f& half_extent) {
+  BoxClassification classification = BOX_INSIDE;
+  for (int i = 0; i < planes.rows(); ++i) {
+    const Eigen::Vector3f normal = planes.row(i).head<3>().transpose();
+    const float distance = normal.dot(center) + planes(i, 3);
+    const float extent = normal.cwiseAbs().dot(half_extent);
+    if (distance + extent < 0.0f) return BOX_OUTSIDE;
+    if (distance - extent < 0.0f) classification = BOX_CROSSING;
+  }
+  return classification;
+}
+
+// Collects the objects of a group whose bits are set.
+void CollectVisibleObjects(const std::vector<int>& objects,
+                           const std::vector<uint32_t>& visibility,
+                           std::vector<int>* visible_objects) {
+  visible_objects->clear();
+  for (int i = 0; i < static_cast<int>(objects.size()); ++i) {
+    if ((visibility[i / 32] >> (i % 32)) & 1u) {
+      visible_objects->push_back(objects[i]);
+    }
+  }
+}
+
+}  // namespace
+
+VisibilityCache::VisibilityCache(const VisibilityCacheOptions& options)
+    : options_(options),
+      bvh_(nullptr),
+      next_group_(0),
+      num_rotated_groups_(0),
+      camera_version_(0),
+      camera_lens_(Eigen::Vector4f::Zero()) {}
+
+void VisibilityCache::Initialize(const BoundingVolumeHierarchy* bvh) {
+  bvh_ = bvh;
+  const int num_objects = bvh->num_objects();
+  const int group_size = std::max(options_.group_size, 1);
+  const int num_groups = (num_objects + group_size - 1) / group_size;
+  const std::vector<int>& ordered_objects = bvh->ordered_objects();
+  groups_.resize(num_groups);
+  object_groups_.resize(num_objects);
+  object_slots_.resize(num_objects);
+  for (int i = 0; i < num_groups; ++i) {
+    Group& group = groups_[i];
+    const int first = i * group_size;
+    const int end = std::min(first + group_size, num_objects);
+    group.objects.assign(ordered_objects.begin() + first,
+                         ordered_objects.begin() + end);
+    group.centers.resize(end - first);
+    group.half_extents.resize(end - first);
+    group.visibility.assign((end - first + 31) / 32, 0);
+    group.bounds.setEmpty();
+    group.visible_objects.clear();
+    group.stale = true;
+    group.changed = true;
+    for (int j = first; j < end; ++j) {
+      object_groups_[ordered_objects[j]] = i;
+      object_slots_[ordered_objects[j]] = j - first;
+      ReadBounds(ordered_objects[j]);
+    }
+  }
+  num_rotated_groups_ = std::min(
+      num_groups, (options_.num_rotated_objects + group_size - 1) / group_size);
+  dirty_objects_.clear();
+  dirty_flags_.assign(num_objects, 0);
+  next_group_ = 0;
+  camera_version_ = 0;
+  visible_objects_.clear();
+}
+
+void VisibilityCache::MarkDirty(const int object) {
+  if (dirty_flags_[object]) return;
+  dirty_flags_[object] = 1;
+  dirty_objects_.push_back(object);
+}
+
+void VisibilityCache::Update(const Camera& camera) {
+  statistics_ = VisibilityCacheStatistics();
+  statistics_.num_dirty_objects = dirty_objects_.size();
+  const Eigen::Vector4f lens(camera.field_of_view(), camera.aspect_ratio(),
+                             camera.near(), camera.far());
+  if (lens != camera_lens_) {
+    camera_lens_ = lens;
+    for (Group& group : groups_) group.stale = true;
+  }
+  const bool camera_changed = camera.Changed(&camera_version_);
+  if (camera_changed) {
+    // The frustum fits in the ball through its far corners.
+    const float tangent = std::tan(0.5f * camera.field_of_view());
+    const float corner_distance = camera.far() * std::sqrt(
+        1.0f + tangent * tangent *
+        (1.0f + camera.aspect_ratio() * camera.aspect_ratio()));
+    for (Group& group : groups_) {
+      if (!group.stale &&
+          ComputeDrift(camera, corner_distance, group) > options_.margin) {
+        group.stale = true;
+      }
+    }
+  }
+  for (const Group& group : groups_) {
+    if (group.stale) ++statistics_.num_stale_groups;
+  }
+  // The rotation drops the objects that left the view, which the stale groups
+  // do not catch while the camera drifts within the margin.
+  if (camera_changed && !groups_.empty()) {
+    for (int i = 0; i < num_rotated_groups_; ++i) {
+      groups_[next_group_].stale = true;
+      next_group_ = (next_group_ + 1) % groups_.size();
+    }
+  }
+
+  // The stale groups test their dirty objects with the others.
+  for (const int object : dirty_objects_) {
+    dirty_flags_[object] = 0;
+    ReadBounds(object);
+    if (!groups_[object_groups_[object]].stale) TestObject(object);
+  }
+  dirty_objects_.clear();
+  FrustumPlanes planes = camera.frustum_planes();
+  planes.col(3).array() += options_.margin;
+  for (Group& group : groups_) {
+    if (group.stale) TestGroup(planes, camera, &group);
+  }
+
+  visible_objects_.clear();
+  for (Group& group : groups_) {
+    if (group.changed) {
+      CollectVisibleObjects(group.objects, group.visibility,
+                            &group.visible_objects);
+      group.changed = false;
+    }
+    visible_objects_.insert(visible_objects_.end(),
+                            group.visible_objects.begin(),
+                            group.visible_objects.end());
+  }
+  statistics_.num_visible_objects = visible_objects_.size();
+}
+
+void VisibilityCache::TestGroup(const FrustumPlanes& planes,
+                                const Camera& camera,
+                                Group* group) {
+  // Most groups are wholly outside or inside the frustum.
+  switch (ClassifyBox(planes, group->bounds.center(),
+                      0.5f * group->bounds.sizes())) {
+    case BOX_OUTSIDE:
+      std::fill(group->visibility.begin(), group->visibility.end(), 0u);
+      break;
+    case BOX_INSIDE:
+      std::fill(group->visibility.begin(), group->visibility.end(), ~0u);
+      break;
+    case BOX_CROSSING:
+      CullBoxes(planes, group->centers, group->half_extents,
+                &group->visibility);
+      statistics_.num_tested_objects += group->objects.size();
+      break;
+  }
+  group->planes = planes;
+  group->camera_position = camera.position();
+  group->camera_orientation = camera.orientation();
+  group->stale = false;
+  group->changed = true;
+  ++statistics_.num_tested_groups;
+}
+
+void VisibilityCache::ReadBounds(const int object) {
+  Group& group = groups_[object_groups_[object]];
+  const int slot = object_slots_[object];
+  const Eigen::AlignedBox3f& bounds = bvh_->bounds(object);
+  const Eigen::Vector3f center = bounds.center();
+  const Eigen::Vector3f half_extent = 0.5f * bounds.sizes();
+  group.centers.x[slot] = center.x();
+  group.centers.y[slot] = center.y();
+  group.centers.z[slot] = center.z();
+  group.half_extents.x[slot] = half_extent.x();
+  group.half_extents.y[slot] = half_extent.y();
+  group.half_extents.z[slot] = half_extent.z();
+  group.bounds.extend(bounds);
+}
+
+void VisibilityCache::TestObject(const int object) {
+  Group& group = groups_[object_groups_[object]];
+  const int slot = object_slots_[object];
+  const Eigen::Vector3f center(group.centers.x[slot], group.centers.y[slot],
+                               group.centers.z[slot]);
+  const Eigen::Vector3f half_extent(group.half_extents.x[slot],
+                                    group.half_extents.y[slot],
+                                    group.half_extents.z[slot]);
+  const uint32_t bit = 1u << (slot % 32);
+  if (ClassifyBox(group.planes, center, half_extent) == BOX_OUTSIDE) {
+    group.visibility[slot / 32] &= ~bit;
+  } else {
+    group.visibility[slot / 32] |= bit;
+  }
+  group.changed = true;
+  ++statistics_.num_tested_objects;
+}
+
+float VisibilityCache::ComputeDrift(const Camera& camera,
+                                    const float corner_distance,
+                                    const Group& group) const {
+  // The normals of the planes turn by the chord of the rotation, 2 sin(angle /
+  // 2), where the cosine of the half angle is the dot product of the
+  // quaternions.
+  const float translation =
+      (camera.position() - group.camera_position).norm();
+  const float cosine = std::min(
+      1.0f, std::abs(camera.orientation().dot(group.camera_orientation)));
+  const float chord = 2.0f * std::sqrt(1.0f - cosine * cosine);
+  return translation + chord * corner_distance;
+}
+
+}  // namespace wvu
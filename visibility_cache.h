@@ -0,0 +1,198 @@
+// Copyright (C) 2016 West Virginia University.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+//
+//     * Neither the name of West Virginia University nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Please contact the author of this library if you have any questions.
+// Author: Victor Fragoso (victor.fragoso@mail.wvu.edu)
+
+#ifndef GLUTILS_VISIBILITY_CACHE_H_
+#define GLUTILS_VISIBILITY_CACHE_H_
+
+#include <cstdint>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "assignment.h"
+#include "bounding_volume_hierarchy.h"
+#include "camera.h"
+#include "transforms.h"
+
+namespace wvu {
+// Parameters of a VisibilityCache.
+struct VisibilityCacheOptions {
+  // The distance by which the frustum is enlarged when the objects are tested,
+  // and by which the camera may drift before their results are stale.
+  float margin = 1.0f;
+  // The number of objects per group.
+  int group_size = 256;
+  // The number of objects whose groups are re-tested in turn every frame
+  // while the camera moves, besides the stale ones, which bounds the time a
+  // group keeps objects that left the view.
+  int num_rotated_objects = 4096;
+};
+
+// Counters of the last VisibilityCache::Update().
+struct VisibilityCacheStatistics {
+  int num_visible_objects = 0;
+  // Objects tested against a frustum, and the groups they were in.
+  int num_tested_objects = 0;
+  int num_tested_groups = 0;
+  // Groups re-tested because their results were stale, e.g., the camera
+  // drifted by more than the margin or its lens changed.
+  int num_stale_groups = 0;
+  int num_dirty_objects = 0;
+};
+
+// This class keeps the objects of a BoundingVolumeHierarchy visible from a
+// camera across frames, re-testing only a few of them per frame. The objects
+// are split into groups of consecutive leaves, so the objects of a group are
+// close and the box of the group rejects or accepts most of them at once. A
+// group is tested against the frustum enlarged by a margin, and remembers the
+// pose of the camera it was tested with. While the planes of the frustum moved
+// by less than the margin since then, every object visible from the camera
+// passed the enlarged test, so the result of the group still holds. The
+// motion of the planes near the camera is bounded by the translation plus the
+// rotation of the camera times the distance to the far corners of the frustum.
+// Every frame, the groups whose results are stale, a rotating subset of the
+// others, and the dirty objects are tested with the batched CullBoxes()
+// kernels. The visible objects are conservative: they include every object in
+// the frustum, and a few up to margin outside it.
+//
+// Example:
+//
+// wvu::VisibilityCache visibility;
+// visibility.Initialize(&bvh);
+// while (...) {  // Rendering loop.
+//   bvh.UpdateBounds(moved_object, moved_object_bounds);
+//   bvh.Refit();
+//   visibility.MarkDirty(moved_object);
+//   visibility.Update(camera);
+//   for (const int object : visibility.visible_objects()) {
+//     ...  // Queue the draw of the object.
+//   }
+// }
+class VisibilityCache {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  explicit VisibilityCache(
+      const VisibilityCacheOptions& options = VisibilityCacheOptions());
+  ~VisibilityCache() {}
+
+  // Groups the objects of the hierarchy and reads their bounds. All the
+  // results are stale. Must be called again when the hierarchy is built
+  // again.
+  // Parameters:
+  //   bvh  The hierarchy of the objects. Not owned.
+  void Initialize(const BoundingVolumeHierarchy* bvh);
+
+  // Marks an object whose bounds changed in the hierarchy, so its bounds are
+  // read and tested at the next Update(). The objects that move must be marked
+  // every time, since the results of their groups are kept.
+  void MarkDirty(const int object);
+
+  // Updates the visible objects from the camera. Nothing is tested while the
+  // camera does not change and no object is dirty.
+  void Update(const Camera& camera);
+
+  // Returns the objects visible from the camera of the last update.
+  const std::vector<int>& visible_objects() const {
+    return visible_objects_;
+  }
+
+  const VisibilityCacheStatistics& statistics() const {
+    return statistics_;
+  }
+
+ private:
+  // A group of consecutive objects of the hierarchy. The objects are stored in
+  // the order of the leaves, with their boxes, as the kernels read them.
+  struct Group {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    std::vector<int> objects;
+    Vector3fArray centers;
+    Vector3fArray half_extents;
+    // The bounds of the objects, which grow as they move.
+    Eigen::AlignedBox3f bounds;
+    std::vector<uint32_t> visibility;
+    std::vector<int> visible_objects;
+    // The enlarged frustum of the last test, and the camera pose it came from.
+    FrustumPlanes planes;
+    Eigen::Vector3f camera_position;
+    Eigen::Quaternionf camera_orientation;
+    bool stale;
+    // True if the visible objects of the group need to be collected again.
+    bool changed;
+  };
+
+  // Tests the box of a group, and its objects if the box crosses the frustum.
+  void TestGroup(const FrustumPlanes& planes,
+                 const Camera& camera,
+                 Group* group);
+
+  // Reads the bounds of an object.
+  void ReadBounds(const int object);
+
+  // Tests a dirty object against the frustum of the last test of its group.
+  void TestObject(const int object);
+
+  // Returns the distance the planes may have moved by within corner_distance
+  // of the camera since the test of a group.
+  float ComputeDrift(const Camera& camera,
+                     const float corner_distance,
+                     const Group& group) const;
+
+  const VisibilityCacheOptions options_;
+  const BoundingVolumeHierarchy* bvh_;
+  std::vector<Group, Eigen::aligned_allocator<Group> > groups_;
+  // The group of every object, and its index in the group.
+  std::vector<int> object_groups_;
+  std::vector<int> object_slots_;
+  std::vector<int> dirty_objects_;
+  std::vector<uint8_t> dirty_flags_;
+  // The next group of the rotation, and the number of groups rotated per
+  // frame.
+  int next_group_;
+  int num_rotated_groups_;
+  // The version and the lens of the camera of the last update.
+  int64_t camera_version_;
+  Eigen::Vector4f camera_lens_;
+  std::vector<int> visible_objects_;
+  VisibilityCacheStatistics statistics_;
+
+  VisibilityCache(const VisibilityCache&) = delete;
+  VisibilityCache& operator=(const VisibilityCache&) = delete;
+};
+
+}  // namespace wvu
+
+#endif  // GLUTILS_VISIBILITY_CACHE_H_